@@ -18,6 +18,20 @@ def AciCommandLookUp(CommandOpCode):
         AciAccessAddressGet.OpCode: "AccessAddressGet",
         AciChannelGet.OpCode: "ChannelGet",
         AciIntervalMinMsGet.OpCode: "IntervalMinMsGet",
+        AciBatch.OpCode: "Batch",
+        AciBaudrateSet.OpCode: "BaudrateSet",
+        AciEventMaskSet.OpCode: "EventMaskSet",
+        AciEventFormatSet.OpCode: "EventFormatSet",
+        AciShardSet.OpCode: "ShardSet",
+        AciValueHistoryGet.OpCode: "ValueHistoryGet",
+        AciMirrorStart.OpCode: "MirrorStart",
+        AciHandleStatsGet.OpCode: "HandleStatsGet",
+        AciNeighborGet.OpCode: "NeighborGet",
+        AciSnifferSet.OpCode: "SnifferSet",
+        AciDfuWindowed.OpCode: "DfuWindowed",
+        AciIsrStatsGet.OpCode: "IsrStatsGet",
+        AciPropagationStatsGet.OpCode: "PropagationStatsGet",
+        AciValuesSet.OpCode: "ValuesSet",
     }
 
     if CommandOpCode in commandNameLUT:
@@ -136,6 +150,65 @@ class AciDfuData(AciCommandPkt):
         else:
             super(AciDfuData, self).__init__(length=length,OpCode=self.OpCode, data = data)
 
+class AciDfuWindowed(AciCommandPkt):
+    OpCode = 0x68
+    MAX_DFU_LENGTH = AciDfuData.MAX_DFU_LENGTH + 1
+    def __init__(self, seq, data=[]):
+        payload = [seq & 0xFF]
+        payload.extend(data)
+        if len(payload) + 1 > self.MAX_DFU_LENGTH:
+            logging.error("DFU_WINDOWED command can have a maximum of %d byte packet size (including the opcode), not %d",self.MAX_DFU_LENGTH,len(payload) + 1)
+        else:
+            super(AciDfuWindowed, self).__init__(length=len(payload) + 1, OpCode=self.OpCode, data=payload)
+
+class AciStatsGet(AciCommandPkt):
+    OpCode = 0x79
+    Length = 2
+    def __init__(self, offset=0):
+        super(AciStatsGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[offset])
+
+class AciHandleStatsGet(AciCommandPkt):
+    OpCode = 0x6B
+    Length = 4
+    def __init__(self, handle, reset=False):
+        payload = valueToByteArray(handle,2)
+        payload.extend(valueToByteArray(int(reset),1))
+        super(AciHandleStatsGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
+
+class AciIsrStatsGet(AciCommandPkt):
+    OpCode = 0x67
+    Length = 4
+    def __init__(self, isr, latency=False, reset=False):
+        payload = [isr & 0xFF, int(latency), int(reset)]
+        super(AciIsrStatsGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
+
+class AciPropagationStatsGet(AciCommandPkt):
+    OpCode = 0x66
+    Length = 2
+    def __init__(self, reset=False):
+        payload = [int(reset)]
+        super(AciPropagationStatsGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
+
+class AciValuesSet(AciCommandPkt):
+    OpCode = 0x65
+    MAX_LENGTH = 36
+    def __init__(self, values):
+        payload = []
+        for handle, data in values:
+            payload.extend(valueToByteArray(handle,2))
+            payload.append(len(data))
+            payload.extend(data)
+        if len(payload) + 1 > self.MAX_LENGTH:
+            logging.error("VALUES_SET command can have a maximum of %d byte packet size (including the opcode), not %d", self.MAX_LENGTH, len(payload) + 1)
+        else:
+            super(AciValuesSet, self).__init__(length=len(payload) + 1, OpCode=self.OpCode, data=payload)
+
+class AciNeighborGet(AciCommandPkt):
+    OpCode = 0x6A
+    Length = 2
+    def __init__(self, index=0):
+        super(AciNeighborGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[index & 0xFF])
+
 class AciValueGet(AciCommandPkt):
     OpCode = 0x7A
     Length = 3
@@ -143,6 +216,14 @@ class AciValueGet(AciCommandPkt):
         payload = valueToByteArray(handle,2)
         super(AciValueGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
 
+class AciValueHistoryGet(AciCommandPkt):
+    OpCode = 0x62
+    Length = 5
+    def __init__(self, handle, version=0):
+        payload = valueToByteArray(handle,2)
+        payload.extend(valueToByteArray(version,2))
+        super(AciValueHistoryGet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
+
 class AciBuildVersionGet(AciCommandPkt):
     OpCode = 0x7B
     Length = 1
@@ -166,3 +247,66 @@ class AciIntervalMinMsGet(AciCommandPkt):
     Length = 1
     def __init__(self):
         super(AciIntervalMinMsGet, self).__init__(length=self.Length,OpCode=self.OpCode)
+
+class AciBaudrateSet(AciCommandPkt):
+    OpCode = 0x6E
+    Length = 5
+    BAUDRATES = (115200, 230400, 250000, 460800, 921600, 1000000)
+    def __init__(self, baudrate):
+        if baudrate not in self.BAUDRATES:
+            logging.error("Unsupported baudrate %d, must be one of %s", baudrate, str(self.BAUDRATES))
+        payload = valueToByteArray(baudrate,4)
+        super(AciBaudrateSet, self).__init__(length=self.Length, OpCode=self.OpCode, data=payload)
+
+class AciEventMaskSet(AciCommandPkt):
+    OpCode = 0x6D
+    Length = 2
+    NEW = 0x01
+    UPDATE = 0x02
+    CONFLICTING = 0x04
+    TX = 0x08
+    ALL = 0x0F
+    def __init__(self, mask):
+        super(AciEventMaskSet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[mask & 0xFF])
+
+class AciEventFormatSet(AciCommandPkt):
+    OpCode = 0x64
+    Length = 2
+    FULL = 0x00
+    COMPACT = 0x01
+    VERSIONED = 0x02
+    def __init__(self, format):
+        super(AciEventFormatSet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[format & 0xFF])
+
+class AciShardSet(AciCommandPkt):
+    OpCode = 0x63
+    Length = 3
+    def __init__(self, count, index):
+        super(AciShardSet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[count & 0xFF, index & 0xFF])
+
+class AciSnifferSet(AciCommandPkt):
+    OpCode = 0x69
+    Length = 2
+    def __init__(self, enable):
+        super(AciSnifferSet, self).__init__(length=self.Length, OpCode=self.OpCode, data=[1 if enable else 0])
+
+class AciMirrorStart(AciCommandPkt):
+    OpCode = 0x6C
+    Length = 1
+    def __init__(self):
+        super(AciMirrorStart, self).__init__(length=self.Length, OpCode=self.OpCode)
+
+class AciBatch(AciCommandPkt):
+    OpCode = 0x6F
+    MAX_BATCH_LENGTH = 36
+    BATCH_COMMANDS = (AciValueSet.OpCode, AciValueGet.OpCode, AciFlagSet.OpCode)
+    def __init__(self, commands, token=0):
+        payload = [token & 0xFF]
+        for cmd in commands:
+            if cmd.OpCode not in self.BATCH_COMMANDS:
+                logging.error("%s can't be part of a batch", cmd.__class__.__name__)
+            payload.extend(cmd.serialize())
+        if len(payload) + 1 > self.MAX_BATCH_LENGTH:
+            logging.error("BATCH command can have a maximum of %d byte packet size (including the opcode), not %d",self.MAX_BATCH_LENGTH,len(payload) + 1)
+        else:
+            super(AciBatch, self).__init__(length=len(payload) + 1, OpCode=self.OpCode, data=payload)
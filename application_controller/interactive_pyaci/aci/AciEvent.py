@@ -1,17 +1,27 @@
 import logging
 from aci import AciCommand
 
-MAX_DATA_LENGTH = 30
+MAX_DATA_LENGTH = 48 # sniffer events are the longest
 
 def AciEventDeserialize(pkt):
     eventLUT = {
         0x81: AciDeviceStarted,
         0x82: AciEchoRsp,
+        0x78: AciEventDfu,
         0x84: AciCmdRsp,
         0xB3: AciEventNew,
         0xB4: AciEventUpdate,
         0xB5: AciEventConflicting,
-        0xB6: AciEventTX
+        0xB6: AciEventTX,
+        0xB7: AciEventOverflow,
+        0xB8: AciEventSnapshot,
+        0xB9: AciEventSnapshotEnd,
+        0xBA: AciEventSniffer,
+        0xBB: AciEventDfuAck,
+        0xBC: AciEventCompact,
+        0xBD: AciEventVersioned,
+        0xBE: AciEventHistory,
+        0xBF: AciEventHistoryEnd
     }
 
     opcode = pkt[1]
@@ -99,8 +109,8 @@ class AciEventNew(AciEventPkt):
         if self.Len < 3:
             logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
         else:
-            self.ValueHandle = pkt[2]
-            self.Data = pkt[3:]
+            self.ValueHandle = pkt[2] | (pkt[3] << 8)
+            self.Data = pkt[4:]
 
     def __repr__(self):
         return str.format("I am %s and my Lenght is %d, OpCode is 0x%02x, ValueHandle is 0x%02x, and Data is %s" %(self.__class__.__name__, self.Len, self.OpCode, self.ValueHandle, self.Data))
@@ -118,4 +128,187 @@ class AciEventConflicting(AciEventNew):
 class AciEventTX(AciEventNew):
     #OpCode = 0xB6
     def __init__(self,pkt):
-        super(AciEventTX, self).__init__(pkt)
\ No newline at end of file
+        super(AciEventTX, self).__init__(pkt)
+
+COMPACT_OPCODES = (0xB3, 0xB4, 0xB5, 0xB6) # by record type
+
+def _varint_parse(data, i):
+    value = 0
+    shift = 0
+    while True:
+        value |= (data[i] & 0x7F) << shift
+        shift += 7
+        i += 1
+        if not data[i - 1] & 0x80:
+            return value, i
+
+def AciCompactRecordsParse(data):
+    """Split the records of a compact event into (opcode, handle, version delta, data) tuples."""
+    records = []
+    handle = None
+    i = 0
+    while i < len(data):
+        header = data[i]
+        i += 1
+        record_type = header >> 6
+        length = header & 0x1F
+        if length == 0x1F:
+            length = data[i]
+            i += 1
+        if header & 0x20:
+            handle = (handle + 1) & 0xFFFF
+        else:
+            handle, i = _varint_parse(data, i)
+        version_delta = 0
+        if COMPACT_OPCODES[record_type] != 0xB6:
+            version_delta, i = _varint_parse(data, i)
+        records.append((COMPACT_OPCODES[record_type], handle, version_delta, data[i:i + length]))
+        i += length
+    return records
+
+class AciEventOverflow(AciEventPkt):
+    #OpCode = 0xB7
+    def __init__(self,pkt):
+        super(AciEventOverflow, self).__init__(pkt)
+        if self.Len != 11:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            counts = [pkt[2 + 2*i] | (pkt[3 + 2*i] << 8) for i in range(5)]
+            (self.DroppedNew, self.DroppedUpdate, self.DroppedConflicting,
+                self.DroppedTX, self.CoalescedUpdate) = counts
+
+    def __repr__(self):
+        return str.format("I am %s, dropped new: %d, update: %d, conflicting: %d, tx: %d, coalesced updates: %d" %(self.__class__.__name__, self.DroppedNew, self.DroppedUpdate, self.DroppedConflicting, self.DroppedTX, self.CoalescedUpdate))
+
+class AciEventCompact(AciEventPkt):
+    #OpCode = 0xBC
+    def __init__(self,pkt):
+        super(AciEventCompact, self).__init__(pkt)
+        self.Events = []
+        try:
+            records = AciCompactRecordsParse(pkt[2:])
+        except (IndexError, TypeError):
+            logging.error("Invalid records in %s event: %s", self.__class__.__name__, str(pkt))
+            return
+        for (opcode, handle, version_delta, data) in records:
+            evt = AciEventDeserialize([3 + len(data), opcode, handle & 0xFF, handle >> 8] + list(data))
+            evt.VersionDelta = version_delta
+            self.Events.append(evt)
+
+    def __repr__(self):
+        return str.format("I am %s, events: %s" %(self.__class__.__name__, str(self.Events)))
+
+class AciEventVersioned(AciEventPkt):
+    #OpCode = 0xBD
+    def __init__(self,pkt):
+        super(AciEventVersioned, self).__init__(pkt)
+        self.Events = []
+        if self.Len < 6 or pkt[2] not in COMPACT_OPCODES[:3]:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+            return
+        evt = AciEventDeserialize([self.Len - 3, pkt[2], pkt[3], pkt[4]] + list(pkt[7:]))
+        evt.Version = pkt[5] | (pkt[6] << 8)
+        self.Events.append(evt)
+
+    def __repr__(self):
+        return str.format("I am %s, events: %s" %(self.__class__.__name__, str(self.Events)))
+
+class AciEventSnapshot(AciEventPkt):
+    #OpCode = 0xB8
+    def __init__(self,pkt):
+        super(AciEventSnapshot, self).__init__(pkt)
+        if self.Len < 5:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.ValueHandle = pkt[2] | (pkt[3] << 8)
+            self.Version = pkt[4] | (pkt[5] << 8)
+            self.Data = pkt[6:]
+
+    def __repr__(self):
+        return str.format("I am %s, ValueHandle is 0x%02x, Version is %d, and Data is %s" %(self.__class__.__name__, self.ValueHandle, self.Version, self.Data))
+
+class AciEventSnapshotEnd(AciEventPkt):
+    #OpCode = 0xB9
+    def __init__(self,pkt):
+        super(AciEventSnapshotEnd, self).__init__(pkt)
+        if self.Len != 3:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.Count = pkt[2] | (pkt[3] << 8)
+
+    def __repr__(self):
+        return str.format("I am %s, the snapshot had %d values" %(self.__class__.__name__, self.Count))
+
+class AciEventHistory(AciEventPkt):
+    #OpCode = 0xBE
+    def __init__(self,pkt):
+        super(AciEventHistory, self).__init__(pkt)
+        if self.Len < 9:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.ValueHandle = pkt[2] | (pkt[3] << 8)
+            self.Version = pkt[4] | (pkt[5] << 8)
+            self.Timestamp = pkt[6] | (pkt[7] << 8) | (pkt[8] << 16) | (pkt[9] << 24)
+            self.Data = pkt[10:]
+
+    def __repr__(self):
+        return str.format("I am %s, ValueHandle is 0x%02x, Version is %d, Timestamp is %d, and Data is %s" %(self.__class__.__name__, self.ValueHandle, self.Version, self.Timestamp, self.Data))
+
+class AciEventHistoryEnd(AciEventPkt):
+    #OpCode = 0xBF
+    def __init__(self,pkt):
+        super(AciEventHistoryEnd, self).__init__(pkt)
+        if self.Len != 8:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.ValueHandle = pkt[2] | (pkt[3] << 8)
+            self.Count = pkt[4]
+            self.TimeNow = pkt[5] | (pkt[6] << 8) | (pkt[7] << 16) | (pkt[8] << 24)
+
+    def __repr__(self):
+        return str.format("I am %s, the history of ValueHandle 0x%02x had %d versions" %(self.__class__.__name__, self.ValueHandle, self.Count))
+
+class AciEventSniffer(AciEventPkt):
+    #OpCode = 0xBA
+    FLAG_CRC_OK = 0x01
+    def __init__(self,pkt):
+        super(AciEventSniffer, self).__init__(pkt)
+        if self.Len < 11:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.Timestamp = pkt[2] | (pkt[3] << 8) | (pkt[4] << 16) | (pkt[5] << 24)
+            self.Rssi = pkt[6] - 256 if pkt[6] > 127 else pkt[6]
+            self.CrcOk = bool(pkt[7] & self.FLAG_CRC_OK)
+            self.Channel = pkt[8]
+            self.Lost = pkt[9]
+            self.Pdu = pkt[10:]
+
+    def __repr__(self):
+        return str.format("I am %s, Timestamp is %d, Rssi is %d, CrcOk is %s, Channel is %d, Lost is %d and Pdu is %s" %(self.__class__.__name__, self.Timestamp, self.Rssi, self.CrcOk, self.Channel, self.Lost, self.Pdu))
+
+class AciEventDfu(AciEventPkt):
+    #OpCode = 0x78
+    def __init__(self,pkt):
+        super(AciEventDfu, self).__init__(pkt)
+        if self.Len < 3:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.PacketType = pkt[2] | (pkt[3] << 8)
+            self.Payload = pkt[4:]
+
+    def __repr__(self):
+        return str.format("I am %s, PacketType is 0x%04x, and Payload is %s" %(self.__class__.__name__, self.PacketType, self.Payload))
+
+class AciEventDfuAck(AciEventPkt):
+    #OpCode = 0xBB
+    def __init__(self,pkt):
+        super(AciEventDfuAck, self).__init__(pkt)
+        if self.Len != 4:
+            logging.error("Invalid length for %s event: %s", self.__class__.__name__, str(pkt))
+        else:
+            self.NextSeq = pkt[2]
+            self.Credit = pkt[3]
+            self.StatusCode = pkt[4]
+
+    def __repr__(self):
+        return str.format("I am %s, NextSeq is %d, Credit is %d, and StatusCode is %s" %(self.__class__.__name__, self.NextSeq, self.Credit, AciStatusLookUp(self.StatusCode)))
@@ -0,0 +1,70 @@
+"""Host side copy of the values cached on a mesh device.
+
+The MirrorStart command makes the device stream a snapshot of every value in
+its handle cache, followed by a snapshot end event, while the new and update
+events keep flowing. All events share the device's serial queue, and each
+snapshot event is read from the cache when it's queued, so applying the events
+in the order they arrive leaves the mirror equal to the device cache:
+
+    mirror = AciMirror.AciMirror(on_change=lambda handle, data: print(handle, data))
+    mirror.attach(acidev)
+    acidev.write_aci_cmd(AciCommand.AciMirrorStart())
+
+attach() takes both an AciUart device and an AciAsyncDevice. If the device
+reports dropped value events, the mirror is no longer in sync, and a new
+MirrorStart brings it back.
+"""
+import logging
+from aci import AciEvent
+
+
+class AciMirror(object):
+    def __init__(self, on_change=None):
+        self.values = {}        # handle -> data
+        self.versions = {}      # handle -> version, from the last snapshot
+        self.synced = False
+        self.on_change = on_change
+        self._snapshot_count = 0
+
+    def attach(self, acidev):
+        if hasattr(acidev, 'AddPacketRecipient'):
+            acidev.AddPacketRecipient(self.event_handle)
+        else:
+            acidev.add_event_handler(self.event_handle)
+
+    def get(self, handle):
+        return self.values.get(handle)
+
+    def event_handle(self, evt):
+        if isinstance(evt, AciEvent.AciEventSnapshot):
+            if self._snapshot_count == 0:
+                self.synced = False
+            self._snapshot_count += 1
+            self.versions[evt.ValueHandle] = evt.Version
+            self._value_set(evt.ValueHandle, evt.Data)
+        elif isinstance(evt, AciEvent.AciEventSnapshotEnd):
+            if evt.Count != self._snapshot_count:
+                logging.error("Mirror got %d snapshot values, the device sent %d",
+                        self._snapshot_count, evt.Count)
+            else:
+                self.synced = True
+            self._snapshot_count = 0
+        elif isinstance(evt, (AciEvent.AciEventNew, AciEvent.AciEventUpdate)) and \
+                not isinstance(evt, (AciEvent.AciEventConflicting, AciEvent.AciEventTX)):
+            self.versions.pop(evt.ValueHandle, None)
+            self._value_set(evt.ValueHandle, evt.Data)
+        elif isinstance(evt, AciEvent.AciEventOverflow):
+            if evt.DroppedNew or evt.DroppedUpdate:
+                logging.info("Mirror lost value events, restart the mirror to sync")
+                self.synced = False
+
+    def _value_set(self, handle, data):
+        data = list(data)
+        if self.values.get(handle) == data:
+            return
+        self.values[handle] = data
+        if self.on_change:
+            self.on_change(handle, data)
+
+    def __repr__(self):
+        return '%s(%d values, synced=%s)' % (self.__class__.__name__, len(self.values), self.synced)
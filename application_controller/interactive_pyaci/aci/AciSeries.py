@@ -0,0 +1,115 @@
+"""Host side decoder for time series values.
+
+A node that enables a handle as a time series (rbc_mesh_series_enable())
+batches its samples into the value of the handle, so each value event holds
+several timestamped samples:
+
+    follower = AciSeries.SeriesFollower(on_sample=lambda handle, index, timestamp_ms, value: print(handle, value))
+    follower.add(0x10)
+    follower.attach(acidev)
+
+A batch is the index of its first sample, the timestamp and the value of that
+sample, followed by the timestamp and value deltas of the other samples. Each
+number is an unsigned LEB128 varint, and the values and value deltas are
+zigzag encoded. The mesh only guarantees that the newest version of a value
+arrives, so the follower counts the samples of the batches it missed.
+
+attach() takes both an AciUart device and an AciAsyncDevice.
+"""
+import threading
+from aci import AciEvent
+
+VARINT_MAX_LEN = 5
+
+
+def varint_decode(data, offset):
+    """Decode the varint at offset, returns (number, next offset)."""
+    number = 0
+    for i in range(VARINT_MAX_LEN):
+        if offset >= len(data):
+            raise ValueError("Time series value ends in a varint")
+        byte = data[offset]
+        offset += 1
+        number |= (byte & 0x7F) << (7 * i)
+        if byte & 0x80 == 0:
+            return (number & 0xFFFFFFFF, offset)
+    raise ValueError("Time series varint too long")
+
+
+def zigzag_decode(number):
+    return (number >> 1) ^ -(number & 1)
+
+
+def int32(number):
+    number &= 0xFFFFFFFF
+    return number - 0x100000000 if number & 0x80000000 else number
+
+
+def unpack(data):
+    """Decode a time series value, returns (first_index, [(timestamp_ms, value), ...])."""
+    data = bytearray(data)
+    (first_index, offset) = varint_decode(data, 0)
+    (timestamp_ms, offset) = varint_decode(data, offset)
+    (value, offset) = varint_decode(data, offset)
+    value = zigzag_decode(value)
+    samples = [(timestamp_ms, value)]
+    while offset < len(data):
+        (timestamp_delta, offset) = varint_decode(data, offset)
+        (value_delta, offset) = varint_decode(data, offset)
+        timestamp_ms = (timestamp_ms + timestamp_delta) & 0xFFFFFFFF
+        value = int32(value + zigzag_decode(value_delta))
+        samples.append((timestamp_ms, value))
+    return (first_index, samples)
+
+
+class SeriesFollower(object):
+    def __init__(self, on_sample=None):
+        self.handles = set()
+        self.next_index = {}    # handle -> index of the next sample expected
+        self.on_sample = on_sample
+        self.samples = 0
+        self.missed = 0         # samples in batches that never arrived
+        self.invalid = 0
+        self._lock = threading.Lock() # AciUart devices call in from their own threads
+
+    def add(self, handle):
+        self.handles.add(handle)
+
+    def attach(self, acidev):
+        if hasattr(acidev, 'AddPacketRecipient'):
+            acidev.AddPacketRecipient(self.event_handle)
+        else:
+            acidev.add_event_handler(self.event_handle)
+
+    def event_handle(self, evt):
+        if isinstance(evt, AciEvent.AciEventConflicting) or isinstance(evt, AciEvent.AciEventTX):
+            return
+        if isinstance(evt, AciEvent.AciEventNew) and evt.ValueHandle in self.handles:
+            self.value_handle(evt.ValueHandle, evt.Data)
+
+    def value_handle(self, handle, data):
+        """Pass on the samples of a batch that haven't been seen before."""
+        try:
+            (first_index, samples) = unpack(data)
+        except ValueError:
+            with self._lock:
+                self.invalid += 1
+            return
+        with self._lock:
+            next_index = self.next_index.get(handle)
+            if next_index is not None and first_index > next_index:
+                self.missed += first_index - next_index
+            if next_index is not None and first_index < next_index and first_index != 0:
+                # samples already passed on, only the tail is new
+                samples = samples[next_index - first_index:]
+                first_index = next_index
+            self.next_index[handle] = first_index + len(samples)
+            self.samples += len(samples)
+        if self.on_sample:
+            for (i, (timestamp_ms, value)) in enumerate(samples):
+                self.on_sample(handle, first_index + i, timestamp_ms, value)
+
+    def __repr__(self):
+        return '%s(%d handles, samples=%d, missed=%d, invalid=%d)' % (
+                self.__class__.__name__, len(self.handles), self.samples,
+                self.missed, self.invalid)
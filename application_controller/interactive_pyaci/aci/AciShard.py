@@ -0,0 +1,99 @@
+"""Host side merger for several gateway nodes that each forward a handle shard.
+
+A single gateway forwards every update in the mesh over its serial link, which
+caps the update rate the host can follow. With the ShardSet command, a gateway
+only forwards the handles where handle % count == index, so a set of gateways
+can split the handle space between them:
+
+    merger = AciShard.ShardMerger(on_change=lambda handle, version, data: print(handle, data))
+    for (index, acidev) in enumerate(gateways):
+        merger.attach(acidev)
+        acidev.write_aci_cmd(AciCommand.AciShardSet(count=len(gateways), index=index))
+        acidev.write_aci_cmd(AciCommand.AciEventFormatSet(AciCommand.AciEventFormatSet.VERSIONED))
+
+Giving several gateways the same shard makes them cover for each other. The
+versioned event format tells the merger the version of each value, so the
+copies from the other gateways, and updates that arrive after a newer version,
+are dropped. Values set on a gateway itself are reported without a version,
+and are passed on as they are.
+
+attach() takes both an AciUart device and an AciAsyncDevice.
+"""
+import logging
+import threading
+from aci import AciEvent
+
+LOLLIPOP_LIMIT = 200 # MESH_VALUE_LOLLIPOP_LIMIT in the device
+VERSION_RING_SIZE = 0x10000 - LOLLIPOP_LIMIT
+VERSION_NONE = 0 # values set on the gateway, which get their version later
+
+
+def version_delta(old_version, new_version):
+    """Version difference the way the device compares versions: the versions
+    below the lollipop limit increase to the limit, and the rest form a ring."""
+    delta = new_version - old_version
+    if old_version >= LOLLIPOP_LIMIT and new_version >= LOLLIPOP_LIMIT:
+        if delta > 0x7FFF:
+            delta -= VERSION_RING_SIZE
+        elif delta < -0x7FFF:
+            delta += VERSION_RING_SIZE
+    return delta
+
+
+class ShardMerger(object):
+    def __init__(self, on_change=None):
+        self.values = {}        # handle -> data
+        self.versions = {}      # handle -> newest version passed on
+        self.on_change = on_change
+        self.forwarded = 0
+        self.duplicates = 0     # versions already passed on, from another gateway
+        self.stale = 0          # versions older than one passed on
+        self.conflicts = 0
+        self._lock = threading.Lock() # AciUart devices call in from their own threads
+
+    def attach(self, acidev):
+        if hasattr(acidev, 'AddPacketRecipient'):
+            acidev.AddPacketRecipient(self.event_handle)
+        else:
+            acidev.add_event_handler(self.event_handle)
+
+    def get(self, handle):
+        return self.values.get(handle)
+
+    def event_handle(self, evt):
+        if isinstance(evt, AciEvent.AciEventConflicting):
+            with self._lock:
+                self.conflicts += 1
+            return
+        if isinstance(evt, AciEvent.AciEventSnapshot):
+            self.value_handle(evt.ValueHandle, evt.Version, evt.Data)
+        elif isinstance(evt, AciEvent.AciEventNew) and not isinstance(evt, AciEvent.AciEventTX):
+            if not hasattr(evt, 'Version'):
+                logging.warning("Unversioned value event from a gateway, set the versioned event format")
+            self.value_handle(evt.ValueHandle, getattr(evt, 'Version', VERSION_NONE), evt.Data)
+
+    def value_handle(self, handle, version, data):
+        """Pass a value on, unless a gateway already did for this or a newer version.
+
+        Returns whether the value was passed on."""
+        with self._lock:
+            if version != VERSION_NONE and handle in self.versions:
+                delta = version_delta(self.versions[handle], version)
+                if delta == 0:
+                    self.duplicates += 1
+                    return False
+                if delta < 0:
+                    self.stale += 1
+                    return False
+            if version != VERSION_NONE:
+                self.versions[handle] = version
+            self.values[handle] = list(data)
+            self.forwarded += 1
+        if self.on_change:
+            self.on_change(handle, version, list(data))
+        return True
+
+    def __repr__(self):
+        return '%s(%d values, forwarded=%d, duplicates=%d, stale=%d, conflicts=%d)' % (
+                self.__class__.__name__, len(self.values), self.forwarded,
+                self.duplicates, self.stale, self.conflicts)
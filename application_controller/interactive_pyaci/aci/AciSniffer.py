@@ -0,0 +1,125 @@
+"""PCAP capture of the packets a mesh device receives.
+
+A device built with RBC_MESH_SNIFFER streams every packet it receives as a
+sniffer event once the SnifferSet command has started the capture. The
+capture writes them to a PCAP file that Wireshark opens as Bluetooth LE link
+layer traffic:
+
+    capture = AciSniffer.AciSniffer('mesh.pcap')
+    capture.attach(acidev)
+    acidev.write_aci_cmd(AciCommand.AciSnifferSet(True))
+    ...
+    acidev.write_aci_cmd(AciCommand.AciSnifferSet(False))
+    capture.close()
+
+The device sends the PDU without the access address and the CRC, they are
+filled in on the host. Packets that failed their CRC check on the device are
+marked as such, and get a CRC computed over the corrupted PDU. attach() takes
+both an AciUart device and an AciAsyncDevice.
+"""
+import logging
+import struct
+import time
+from aci import AciEvent
+
+LINKTYPE_BLUETOOTH_LE_LL_WITH_PHDR = 256
+ADV_ACCESS_ADDRESS = 0x8E89BED6
+
+# flags of the LE pseudo header
+PHDR_FLAG_DEWHITENED = 0x0001
+PHDR_FLAG_SIGNAL_VALID = 0x0002
+PHDR_FLAG_REF_AA_VALID = 0x0010
+PHDR_FLAG_CRC_CHECKED = 0x0400
+PHDR_FLAG_CRC_VALID = 0x0800
+
+
+def rf_channel(channel_index):
+    """Map a BLE channel index to the RF channel of the pseudo header, 0 at 2402MHz."""
+    if channel_index == 37:
+        return 0
+    if channel_index == 38:
+        return 12
+    if channel_index == 39:
+        return 39
+    if channel_index <= 10:
+        return channel_index + 1
+    return channel_index + 2
+
+
+def crc24(data, init=0x555555):
+    """BLE link layer CRC over the PDU, in transmission order."""
+    crc = init
+    for byte in data:
+        for bit in range(8):
+            feedback = ((crc >> 23) ^ (byte >> bit)) & 1
+            crc = (crc << 1) & 0xFFFFFF
+            if feedback:
+                crc ^= 0x00065B
+    # the CRC goes out most significant bit first, reverse it to get the
+    # on-air bit order, least significant bit of the first byte first
+    out = 0
+    for bit in range(24):
+        if crc & (1 << bit):
+            out |= 1 << (23 - bit)
+    return out
+
+
+class AciSniffer(object):
+    def __init__(self, filename, access_address=ADV_ACCESS_ADDRESS):
+        self.access_address = access_address
+        self.packet_count = 0
+        self.lost_count = 0
+        self._file = open(filename, 'wb')
+        self._file.write(struct.pack('<IHHiIII', 0xA1B2C3D4, 2, 4, 0, 0, 0xFFFF,
+                LINKTYPE_BLUETOOTH_LE_LL_WITH_PHDR))
+        self._time_base = None  # host time of the first packet, in us
+        self._last_timestamp = 0
+        self._wraps = 0
+
+    def attach(self, acidev):
+        if hasattr(acidev, 'AddPacketRecipient'):
+            acidev.AddPacketRecipient(self.event_handle)
+        else:
+            acidev.add_event_handler(self.event_handle)
+
+    def close(self):
+        if self._file:
+            self._file.close()
+            self._file = None
+
+    def event_handle(self, evt):
+        if not isinstance(evt, AciEvent.AciEventSniffer) or not self._file:
+            return
+        if evt.Lost:
+            self.lost_count += evt.Lost
+            logging.info("Sniffer lost %d packets", evt.Lost)
+        self._write(evt)
+
+    def _time_get(self, timestamp):
+        # the device timestamp wraps every 71 minutes, and starts at a random
+        # point relative to the host time.
+        if self._time_base is None:
+            self._time_base = int(time.time() * 1000000) - timestamp
+        elif timestamp < self._last_timestamp:
+            self._wraps += 1
+        self._last_timestamp = timestamp
+        return self._time_base + (self._wraps << 32) + timestamp
+
+    def _write(self, evt):
+        pdu = bytes(bytearray(evt.Pdu))
+        flags = PHDR_FLAG_DEWHITENED | PHDR_FLAG_SIGNAL_VALID | PHDR_FLAG_REF_AA_VALID | PHDR_FLAG_CRC_CHECKED
+        if evt.CrcOk:
+            flags |= PHDR_FLAG_CRC_VALID
+        phdr = struct.pack('<BbbBIH', rf_channel(evt.Channel), evt.Rssi, 0, 0,
+                self.access_address, flags)
+        crc = crc24(bytearray(pdu))
+        packet = phdr + struct.pack('<I', self.access_address) + pdu + struct.pack('<I', crc)[:3]
+
+        us = self._time_get(evt.Timestamp)
+        self._file.write(struct.pack('<IIII', us // 1000000, us % 1000000, len(packet), len(packet)))
+        self._file.write(packet)
+        self._file.flush()
+        self.packet_count += 1
+
+    def __repr__(self):
+        return '%s(%d packets, %d lost)' % (self.__class__.__name__, self.packet_count, self.lost_count)
@@ -0,0 +1,98 @@
+"""Traffic trace for the replay tool in nRF51/rbc_mesh/sim.
+
+Records the packets a device built with RBC_MESH_SNIFFER receives, together
+with the value set, enable and disable commands sent to it, in the text
+format that mesh_replay reads:
+
+    trace = AciTrace.AciTrace('office.trace')
+    trace.attach(acidev)
+    acidev.write_aci_cmd(AciCommand.AciSnifferSet(True))
+    ...
+    acidev.write_aci_cmd(AciCommand.AciSnifferSet(False))
+    trace.close()
+
+The packets are timestamped by the device, the commands when they're written
+to the serial port. Both are put on the host clock, and the trace starts at 0.
+Records that come in out of order because of the serial latency get the time
+of the previous record, as the replay requires a nondecreasing time. The
+commands are only seen on an AciUart device.
+"""
+import binascii
+import time
+from aci import AciEvent
+from aci import AciCommand
+
+TRACE_TIME_MAX = 1 << 31
+
+
+class AciTrace(object):
+    def __init__(self, filename):
+        self.record_count = 0
+        self.lost_count = 0
+        self._file = open(filename, 'w')
+        self._file.write('# mesh traffic trace, %s\n' % time.strftime('%Y-%m-%d %H:%M:%S'))
+        self._start = None          # host time of the first record, in us
+        self._time_base = None      # host time of device timestamp 0, in us
+        self._last_timestamp = 0
+        self._wraps = 0
+        self._last_time = 0
+
+    def attach(self, acidev):
+        if hasattr(acidev, 'AddPacketRecipient'):
+            acidev.AddPacketRecipient(self.event_handle)
+            acidev.AddCommandRecipient(self.command_handle)
+        else:
+            acidev.add_event_handler(self.event_handle)
+
+    def close(self):
+        if self._file:
+            self._file.close()
+            self._file = None
+
+    def event_handle(self, evt):
+        if not isinstance(evt, AciEvent.AciEventSniffer) or not self._file:
+            return
+        self.lost_count += evt.Lost
+        if evt.Lost:
+            self._file.write('# lost %d packets\n' % evt.Lost)
+        pdu = binascii.hexlify(bytes(bytearray(evt.Pdu))).decode()
+        self._write(self._device_time_get(evt.Timestamp),
+                'rx %d %d %d %s' % (evt.Channel, -evt.Rssi, 1 if evt.CrcOk else 0, pdu))
+
+    def command_handle(self, data):
+        if not self._file or len(data) < 4:
+            return
+        opcode = data[1]
+        handle = data[2] | (data[3] << 8)
+        now = int(time.time() * 1000000)
+        if opcode == AciCommand.AciValueSet.OpCode:
+            value = binascii.hexlify(bytes(bytearray(data[4:data[0] + 1]))).decode()
+            self._write(now, 'set %04x %s' % (handle, value if value else '-'))
+        elif opcode == AciCommand.AciValueEnable.OpCode:
+            self._write(now, 'enable %04x' % handle)
+        elif opcode == AciCommand.AciValueDisable.OpCode:
+            self._write(now, 'disable %04x' % handle)
+
+    def _device_time_get(self, timestamp):
+        # the device timestamp wraps every 71 minutes, and starts at a random
+        # point relative to the host time.
+        if self._time_base is None:
+            self._time_base = int(time.time() * 1000000) - timestamp
+        elif timestamp < self._last_timestamp:
+            self._wraps += 1
+        self._last_timestamp = timestamp
+        return self._time_base + (self._wraps << 32) + timestamp
+
+    def _write(self, us, record):
+        if self._start is None:
+            self._start = us
+        trace_time = max(us - self._start, self._last_time)
+        if trace_time >= TRACE_TIME_MAX:
+            return
+        self._last_time = trace_time
+        self._file.write('%d %s\n' % (trace_time, record))
+        self._file.flush()
+        self.record_count += 1
+
+    def __repr__(self):
+        return '%s(%d records, %d lost)' % (self.__class__.__name__, self.record_count, self.lost_count)
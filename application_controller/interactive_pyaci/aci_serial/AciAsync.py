@@ -0,0 +1,307 @@
+"""asyncio client for the mesh ACI.
+
+Unlike AciUart, commands don't block on their response. Up to `window`
+commands are in flight at a time (the device queues SERIAL_QUEUE_SIZE
+commands), and responses are matched to their commands by opcode, in the order
+the commands were sent, as the device handles its commands in order. Events
+are parsed in place in the receive buffer, and are only turned into AciEvent
+objects for the handlers that ask for them:
+
+    async def main():
+        aci = await AciAsyncUart.open('/dev/ttyACM0', baudrate=115200)
+        aci.add_value_handler(lambda opcode, handle, data: print(handle, bytes(data)))
+        rsps = await asyncio.gather(*[aci.value_set(h, [h & 0xFF]) for h in range(1, 200)])
+
+Requires python 3.5 or newer. The serial port is watched with
+loop.add_reader(), so this only runs on POSIX systems.
+"""
+import asyncio
+import collections
+import logging
+import os
+import traceback
+
+from serial import Serial
+from aci import AciEvent, AciCommand
+
+DEVICE_QUEUE_SIZE = 4
+
+EVT_OPCODE_DEVICE_STARTED = 0x81
+EVT_OPCODE_ECHO_RSP = 0x82
+EVT_OPCODE_CMD_RSP = 0x84
+EVT_OPCODES_VALUE = (0xB3, 0xB4, 0xB5, 0xB6)
+EVT_OPCODE_COMPACT = 0xBC
+EVT_OPCODE_VERSIONED = 0xBD
+
+STATUS_SUCCESS = 0x00
+
+# Responses that don't come as a cmd_rsp, by the opcode of the command they answer.
+RESPONSE_COMMAND_LUT = {
+    EVT_OPCODE_ECHO_RSP: AciCommand.AciEcho.OpCode,
+    EVT_OPCODE_DEVICE_STARTED: AciCommand.AciRadioReset.OpCode,
+}
+
+
+class AciTimeout(Exception):
+    pass
+
+
+class _Request(object):
+    def __init__(self, future, opcode, batch=None):
+        self.future = future
+        self.opcode = opcode
+        self.batch = batch      # batch request this is part of, if any
+        self.inner = []         # value_get requests inside this batch
+        self.timer = None
+
+
+class AciAsyncDevice(object):
+    """Transport independent part of the client: deframing, response matching
+    and event dispatch. Transports call data_received() with whatever they
+    read, and implement _write()."""
+    def __init__(self, loop=None, window=DEVICE_QUEUE_SIZE, timeout=1.0):
+        self.loop = loop or asyncio.get_event_loop()
+        self.timeout = timeout
+        self._window = asyncio.Semaphore(window)
+        self._pending = collections.defaultdict(collections.deque)
+        self._rx_buf = bytearray()
+        self._raw_handlers = []
+        self._value_handlers = []
+        self._event_handlers = []
+
+    def add_raw_handler(self, function):
+        """function(frame) gets every frame as a memoryview into the receive
+        buffer, which is only valid for the duration of the call."""
+        self._raw_handlers.append(function)
+
+    def add_value_handler(self, function):
+        """function(opcode, handle, data) gets every new, update, conflicting
+        and TX event, with data as a memoryview only valid for the call."""
+        self._value_handlers.append(function)
+
+    def add_event_handler(self, function):
+        """function(event) gets every event as an AciEvent object, including
+        command responses."""
+        self._event_handlers.append(function)
+
+    async def submit(self, cmd):
+        """Send a command once there's room in the window, and return a future
+        for its response event."""
+        if not isinstance(cmd, AciCommand.AciCommandPkt):
+            raise TypeError('%r is not an AciCommandPkt' % cmd)
+        await self._window.acquire()
+        pkt = cmd.serialize()
+        req = _Request(self.loop.create_future(), cmd.OpCode)
+        req.future.add_done_callback(lambda fut: self._window.release())
+        self._pending[req.opcode].append(req)
+        if cmd.OpCode == AciCommand.AciBatch.OpCode:
+            self._batch_inner_add(req, pkt)
+        req.timer = self.loop.call_later(self.timeout, self._expire, req)
+        self._write(bytes(pkt))
+        return req.future
+
+    async def command(self, cmd):
+        """Send a command and wait for its response event."""
+        return await (await self.submit(cmd))
+
+    async def echo(self, data):
+        return await self.command(AciCommand.AciEcho(data=list(data), length=len(data) + 1))
+
+    async def value_set(self, handle, data):
+        return await self.command(AciCommand.AciValueSet(handle, list(data), length=len(data) + 3))
+
+    async def value_get(self, handle):
+        return await self.command(AciCommand.AciValueGet(handle))
+
+    async def flag_set(self, handle, flag_index, flag_value):
+        return await self.command(AciCommand.AciFlagSet(handle, flag_index, flag_value))
+
+    async def batch(self, commands, token=0):
+        return await self.command(AciCommand.AciBatch(commands, token))
+
+    def data_received(self, data):
+        self._rx_buf += data
+        buf = self._rx_buf
+        pos = 0
+        with memoryview(buf) as view:
+            while pos < len(buf) and pos + buf[pos] < len(buf):
+                length = buf[pos]
+                if length == 0:
+                    pos += 1
+                    continue
+                frame = view[pos:pos + length + 1]
+                try:
+                    self._frame_received(frame)
+                except Exception:
+                    logging.error('Exception with frame %r', bytes(frame))
+                    logging.error('traceback: %s', traceback.format_exc())
+                pos += length + 1
+                try:
+                    frame.release()
+                except BufferError:
+                    pass
+        try:
+            del buf[:pos]
+        except BufferError:
+            # a handler kept a view of the buffer
+            self._rx_buf = bytearray(buf[pos:])
+
+    def _write(self, data):
+        raise NotImplementedError
+
+    def _frame_received(self, frame):
+        if len(frame) < 2:
+            return
+        opcode = frame[1]
+        for fun in self._raw_handlers:
+            fun(frame)
+
+        if opcode == EVT_OPCODE_COMPACT:
+            try:
+                records = AciEvent.AciCompactRecordsParse(frame[2:])
+            except (IndexError, TypeError):
+                logging.error('Invalid compact event: %r', bytes(frame))
+                return
+            for (record_opcode, handle, _, data) in records:
+                for fun in self._value_handlers:
+                    fun(record_opcode, handle, data)
+            if self._event_handlers:
+                for evt in AciEvent.AciEventDeserialize(list(frame)).Events:
+                    for fun in self._event_handlers:
+                        fun(evt)
+            return
+
+        if opcode == EVT_OPCODE_VERSIONED and len(frame) >= 7:
+            handle = frame[3] | (frame[4] << 8)
+            for fun in self._value_handlers:
+                fun(frame[2], handle, frame[7:])
+            if self._event_handlers:
+                for evt in AciEvent.AciEventDeserialize(list(frame)).Events:
+                    for fun in self._event_handlers:
+                        fun(evt)
+            return
+
+        if opcode in EVT_OPCODES_VALUE and len(frame) >= 4:
+            handle = frame[2] | (frame[3] << 8)
+            data = frame[4:]
+            for fun in self._value_handlers:
+                fun(opcode, handle, data)
+            # value events never answer a command
+            if not self._event_handlers:
+                return
+
+        req = None
+        if opcode == EVT_OPCODE_CMD_RSP and len(frame) >= 4:
+            req = self._request_pop(frame[2])
+        elif opcode in RESPONSE_COMMAND_LUT:
+            req = self._request_pop(RESPONSE_COMMAND_LUT[opcode])
+
+        if req is None and not self._event_handlers:
+            return
+
+        evt = AciEvent.AciEventDeserialize(list(frame))
+        if req is not None:
+            self._request_done(req, evt)
+        for fun in self._event_handlers:
+            fun(evt)
+
+    def _request_pop(self, opcode):
+        queue = self._pending.get(opcode)
+        if queue:
+            return queue.popleft()
+        return None
+
+    def _request_remove(self, req):
+        try:
+            self._pending[req.opcode].remove(req)
+        except ValueError:
+            pass
+
+    def _request_done(self, req, evt):
+        if req.timer:
+            req.timer.cancel()
+        if req.batch is not None:
+            req.batch.inner.remove(req)
+        # a batch stops at the first failing command, so value_gets after it
+        # won't get a response.
+        for inner in req.inner:
+            self._request_remove(inner)
+            if not inner.future.done():
+                inner.future.set_result(None)
+        req.inner = []
+        if not req.future.done():
+            req.future.set_result(evt)
+
+    def _expire(self, req):
+        self._request_remove(req)
+        for inner in req.inner:
+            self._request_remove(inner)
+            if not inner.future.done():
+                inner.future.set_exception(AciTimeout('batch timed out'))
+        req.inner = []
+        if not req.future.done():
+            req.future.set_exception(AciTimeout('no response to command 0x%02x' % req.opcode))
+
+    def _batch_inner_add(self, req, pkt):
+        """The value_gets in a batch respond with their own cmd_rsp, ahead of
+        the batch response. Queue them up so they don't answer a standalone
+        value_get sent earlier or later."""
+        pos = 3 # length, opcode, token
+        while pos < len(pkt) and pkt[pos] > 0:
+            if pkt[pos + 1] == AciCommand.AciValueGet.OpCode:
+                inner = _Request(self.loop.create_future(), AciCommand.AciValueGet.OpCode, batch=req)
+                req.inner.append(inner)
+                self._pending[inner.opcode].append(inner)
+            pos += pkt[pos] + 1
+
+
+class AciAsyncUart(AciAsyncDevice):
+    def __init__(self, port, baudrate=115200, rtscts=False, loop=None, **kwargs):
+        AciAsyncDevice.__init__(self, loop=loop, **kwargs)
+        logging.debug("Opening port %s, baudrate %s, rtscts %s", port, baudrate, rtscts)
+        self.serial = Serial(port=port, baudrate=baudrate, rtscts=rtscts, timeout=0, write_timeout=0)
+        self._fd = self.serial.fileno()
+        self._tx_buf = bytearray()
+        self.loop.add_reader(self._fd, self._read_ready)
+
+    @classmethod
+    async def open(cls, port, **kwargs):
+        return cls(port, loop=asyncio.get_event_loop(), **kwargs)
+
+    def close(self):
+        self.loop.remove_reader(self._fd)
+        if self._tx_buf:
+            self.loop.remove_writer(self._fd)
+        self.serial.close()
+
+    def _read_ready(self):
+        try:
+            data = os.read(self._fd, 4096)
+        except (BlockingIOError, InterruptedError):
+            return
+        if data:
+            self.data_received(data)
+
+    def _write(self, data):
+        if not self._tx_buf:
+            try:
+                written = os.write(self._fd, data)
+            except (BlockingIOError, InterruptedError):
+                written = 0
+            data = data[written:]
+            if not data:
+                return
+            self.loop.add_writer(self._fd, self._write_ready)
+        self._tx_buf += data
+
+    def _write_ready(self):
+        try:
+            written = os.write(self._fd, self._tx_buf)
+        except (BlockingIOError, InterruptedError):
+            return
+        del self._tx_buf[:written]
+        if not self._tx_buf:
+            self.loop.remove_writer(self._fd)
+
+    def __repr__(self):
+        return '%s(port="%s", baudrate=%s)' % (self.__class__.__name__, self.serial.port, self.serial.baudrate)
@@ -0,0 +1,198 @@
+"""CRC checked framing for the UART transport, for devices built with
+SERIAL_UART_FRAMED.
+
+Every ACI packet goes out as a SLIP delimited frame with a header of frame
+type, sequence number and the sequence number expected next from the peer,
+and a CRC-16 trailer. Corrupt frames are dropped. A gap in the sequence
+numbers is answered with a NACK for each missing frame, so only the lost
+frames are sent again, and frames after the gap are held until it's filled.
+
+A device keeps its sequence numbers across host connections, so the host
+starts with a sync frame, and only trusts the device's frames once it has
+answered with its own sync.
+"""
+import time
+import logging
+
+SLIP_END = 0xC0
+SLIP_ESC = 0xDB
+SLIP_ESC_END = 0xDC
+SLIP_ESC_ESC = 0xDD
+
+FRAME_TYPE_DATA = 0x00
+FRAME_TYPE_ACK = 0x01
+FRAME_TYPE_NACK = 0x02
+FRAME_TYPE_SYNC = 0x03
+
+EVT_OPCODE_DEVICE_STARTED = 0x81
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16-CCITT, as computed by the device."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+def slip_encode(frame):
+    out = bytearray([SLIP_END])
+    for byte in frame:
+        if byte == SLIP_END:
+            out += bytearray([SLIP_ESC, SLIP_ESC_END])
+        elif byte == SLIP_ESC:
+            out += bytearray([SLIP_ESC, SLIP_ESC_ESC])
+        else:
+            out.append(byte)
+    out.append(SLIP_END)
+    return out
+
+class Framer(object):
+    RETX_COUNT = 16 # commands kept until the device acks them
+
+    def __init__(self, write, timeout=0.5, device_retx_count=4):
+        """device_retx_count must match SERIAL_UART_RETX_COUNT in the device build."""
+        self._write = write
+        self.timeout = timeout
+        self.device_retx_count = device_retx_count
+        self.tx_seq = 0
+        self.rx_seq = 0
+        self._sent = {} # seq: [packet, time sent]
+        self._held = {} # seq: packet received after a gap
+        self._nacked = set()
+        self._rx_buf = bytearray()
+        self._rx_escape = False
+        self.crc_errors = 0
+        self.retransmits = 0
+        self.lost = 0
+        self._synced = False
+        self._sync_time = 0
+
+    def sync(self):
+        """Start the sequence numbers over with a device that may have been
+        running for a while. Commands sent before are dropped."""
+        self._synced = False
+        self._sync_time = time.time()
+        self._sent.clear()
+        self._held.clear()
+        self._nacked.clear()
+        self._frame_write(FRAME_TYPE_SYNC, self.tx_seq)
+
+    def send(self, pkt):
+        seq = self.tx_seq
+        self.tx_seq = (seq + 1) & 0xFF
+        self._sent[seq] = [bytearray(pkt), time.time()]
+        if len(self._sent) > self.RETX_COUNT:
+            logging.warning('Device hasn\'t acked %d commands', len(self._sent))
+            del self._sent[min(self._sent, key=lambda s: (s - seq) & 0xFF)]
+        self._frame_write(FRAME_TYPE_DATA, seq, pkt)
+
+    def receive(self, data):
+        """Feed received bytes, returns the ACI packets that are now complete and in order."""
+        pkts = []
+        for byte in bytearray(data):
+            if byte == SLIP_END:
+                if self._rx_buf:
+                    pkts.extend(self._frame_received(self._rx_buf))
+                self._rx_buf = bytearray()
+                self._rx_escape = False
+            elif byte == SLIP_ESC:
+                self._rx_escape = True
+            else:
+                if self._rx_escape:
+                    byte = {SLIP_ESC_END: SLIP_END, SLIP_ESC_ESC: SLIP_ESC}.get(byte, byte)
+                    self._rx_escape = False
+                self._rx_buf.append(byte)
+        return pkts
+
+    def poll(self):
+        """Resend commands the device hasn't acked in time, and ask for events
+        that are due. Call this regularly."""
+        now = time.time()
+        if not self._synced and now - self._sync_time > self.timeout:
+            self._frame_write(FRAME_TYPE_SYNC, self.tx_seq)
+            self._sync_time = now
+        expired = [seq for seq in self._sent if now - self._sent[seq][1] > self.timeout]
+        for seq in sorted(expired, key=lambda s: (s - self.tx_seq) & 0xFF):
+            self._sent[seq][1] = now
+            self.retransmits += 1
+            self._frame_write(FRAME_TYPE_DATA, seq, self._sent[seq][0])
+        if expired or self._held:
+            # the device resends the events we're missing, if it still has them
+            self._nacked.clear()
+            self._frame_write(FRAME_TYPE_ACK, 0)
+
+    def _frame_write(self, frame_type, seq, payload=bytearray()):
+        frame = bytearray([frame_type, seq, self.rx_seq]) + bytearray(payload)
+        crc = crc16(frame)
+        self._write(slip_encode(frame + bytearray([crc & 0xFF, crc >> 8])))
+
+    def _frame_received(self, frame):
+        if len(frame) < 5 or crc16(frame[:-2]) != (frame[-2] | (frame[-1] << 8)):
+            self.crc_errors += 1
+            return []
+        (frame_type, seq, ack) = frame[:3]
+        if frame_type == FRAME_TYPE_SYNC:
+            self.rx_seq = seq
+            self._held.clear()
+            self._nacked.clear()
+            self._synced = True
+        elif not self._synced and not (frame_type == FRAME_TYPE_DATA and seq == 0 and
+                len(frame) > 6 and frame[4] == EVT_OPCODE_DEVICE_STARTED):
+            # the acks and events of an earlier connection, which would
+            # take our new commands as old ones
+            return []
+        for sent_seq in list(self._sent):
+            if 0 < ((ack - sent_seq) & 0xFF) <= 128:
+                del self._sent[sent_seq]
+
+        if frame_type == FRAME_TYPE_NACK:
+            if seq in self._sent:
+                self.retransmits += 1
+                self._sent[seq][1] = time.time()
+                self._frame_write(FRAME_TYPE_DATA, seq, self._sent[seq][0])
+            return []
+        if frame_type != FRAME_TYPE_DATA:
+            return []
+
+        pkt = frame[3:-2]
+        if len(pkt) > 1 and pkt[1] == EVT_OPCODE_DEVICE_STARTED and seq == 0:
+            # the device restarted its sequence numbers
+            self.rx_seq = 0
+            self.tx_seq = 0
+            self._sent.clear()
+            self._held.clear()
+            self._synced = True
+        ahead = (seq - self.rx_seq) & 0xFF
+        if ahead == 0:
+            pkts = [pkt]
+            self.rx_seq = (self.rx_seq + 1) & 0xFF
+            self._nacked.discard(seq)
+            while self.rx_seq in self._held:
+                pkts.append(self._held.pop(self.rx_seq))
+                self.rx_seq = (self.rx_seq + 1) & 0xFF
+            return pkts
+        if ahead < 128:
+            self._held[seq] = pkt
+            if ahead >= self.device_retx_count:
+                return self._gap_skip(seq)
+            for missing in range(ahead):
+                missing_seq = (self.rx_seq + missing) & 0xFF
+                if missing_seq not in self._held and missing_seq not in self._nacked:
+                    self._nacked.add(missing_seq)
+                    self._frame_write(FRAME_TYPE_NACK, missing_seq)
+        return []
+
+    def _gap_skip(self, newest_seq):
+        """Give up on the events the device no longer keeps, and return the
+        ones held behind them."""
+        pkts = []
+        while self.device_retx_count <= ((newest_seq - self.rx_seq) & 0xFF) < 128 or self.rx_seq in self._held:
+            if self.rx_seq in self._held:
+                pkts.append(self._held.pop(self.rx_seq))
+            else:
+                self.lost += 1
+                logging.warning('Lost event %d', self.rx_seq)
+            self._nacked.discard(self.rx_seq)
+            self.rx_seq = (self.rx_seq + 1) & 0xFF
+        return pkts
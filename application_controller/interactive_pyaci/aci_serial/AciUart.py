@@ -5,6 +5,7 @@ import threading
 import collections
 from serial import Serial
 from aci import AciEvent, AciCommand
+from aci_serial import AciFrame
 
 EVT_Q_BUF = 16
 
@@ -53,9 +54,14 @@ class AciDevice(object):
                 logging.error('Exception in pkt handler %r', fun)
                 logging.error('traceback: %s', traceback.format_exc())
 
-    def write_aci_cmd(self, cmd):
+    def write_aci_cmd(self, cmd, wait=True):
+        """Send a command. With wait=False the command is pipelined: the call
+        returns right away, and the response arrives through the packet
+        recipients. Tag batches with a token to match their responses."""
         if isinstance(cmd,AciCommand.AciCommandPkt):
             self.WriteData(cmd.serialize())
+            if not wait:
+                return
             retval = self.Wait(self)
             print("Event received: %s" %retval)
             if retval == None:
@@ -66,19 +72,24 @@ class AciDevice(object):
 
 
 class AciUart(threading.Thread, AciDevice):
-    def __init__(self, port, baudrate=115200, device_name=None, rtscts=False):
+    def __init__(self, port, baudrate=115200, device_name=None, rtscts=False, framed=False):
         self.events_queue = collections.deque(maxlen = EVT_Q_BUF)
         threading.Thread.__init__(self)
         if not device_name:
             device_name = port
         AciDevice.__init__(self, device_name)
 
-        self._write_lock = threading.Lock()
+        # the framer resends frames from the reader thread
+        self._write_lock = threading.RLock()
+        self.framer = AciFrame.Framer(self._frame_write) if framed else None
 
         logging.debug("log Opening port %s, baudrate %s, rtscts %s", port, baudrate, rtscts)
         self.serial = Serial(port=port, baudrate=baudrate, rtscts=rtscts, timeout=0.1)
 
         self.keep_running = True
+        if self.framer:
+            # the device may have kept running since the last connection
+            self.framer.sync()
         self.start()
 
     def __del__(self):
@@ -88,6 +99,14 @@ class AciUart(threading.Thread, AciDevice):
         self.keep_running = False
 
     def get_packet_from_uart(self):
+        if self.framer:
+            while self.keep_running:
+                for pkt in self.framer.receive(self.serial.read(self.serial.in_waiting or 1)):
+                    yield pkt
+                with self._write_lock:
+                    self.framer.poll()
+            return
+
         tmp = bytearray([])
         while self.keep_running:
             tmp += bytearray(self.serial.read())
@@ -112,7 +131,15 @@ class AciUart(threading.Thread, AciDevice):
                 logging.error('traceback: %s', traceback.format_exc())
                 parsedPacket = None
 
-            if parsedPacket:
+            # compact and versioned events are handed on as the value events they hold
+            if isinstance(parsedPacket, (AciEvent.AciEventCompact, AciEvent.AciEventVersioned)):
+                parsedPackets = parsedPacket.Events
+            elif parsedPacket:
+                parsedPackets = [parsedPacket]
+            else:
+                parsedPackets = []
+
+            for parsedPacket in parsedPackets:
                 self.events_queue.append(parsedPacket)
                 logging.debug('parsedPacket %r %s', parsedPacket, parsedPacket)
                 self.ProcessPacket(parsedPacket)
@@ -123,8 +150,47 @@ class AciUart(threading.Thread, AciDevice):
     def WriteData(self, data):
         with self._write_lock:
             if self.keep_running:
-                self.serial.write(bytearray(data))
+                if self.framer:
+                    self.framer.send(data)
+                else:
+                    self.serial.write(bytearray(data))
                 self.ProcessCommand(data)
 
+    def _frame_write(self, frame):
+        with self._write_lock:
+            if self.keep_running:
+                self.serial.write(frame)
+
+    def baudrate_switch(self, baudrate):
+        """Negotiate a new baudrate with the device. The device acknowledges
+        at the current baudrate before switching, and the switch is verified
+        with an echo at the new baudrate. Hardware flow control is required
+        above 115200 baud."""
+        self.WriteData(AciCommand.AciBaudrateSet(baudrate).serialize())
+        rsp = self._event_wait(lambda evt: isinstance(evt, AciEvent.AciCmdRsp) and evt.CommandOpCode == AciCommand.AciBaudrateSet.OpCode)
+        if rsp is None or rsp.StatusCode != 0:
+            logging.error('Device rejected baudrate %d: %r', baudrate, rsp)
+            return False
+
+        with self._write_lock:
+            self.serial.baudrate = baudrate
+            if baudrate > 115200:
+                self.serial.rtscts = True
+
+        echo_data = [0xBA, 0x0D]
+        self.WriteData(AciCommand.AciEcho(data=echo_data, length=len(echo_data) + 1).serialize())
+        if self._event_wait(lambda evt: isinstance(evt, AciEvent.AciEchoRsp) and evt.Data == echo_data) is None:
+            logging.error('No echo at %d baud', baudrate)
+            return False
+        return True
+
+    def _event_wait(self, match, timeout=1):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            for evt in self.Wait(self, timeout) or []:
+                if match(evt):
+                    return evt
+        return None
+
     def __repr__(self):
         return '%s(port="%s", baudrate=%s, device_name="%s")' % (self.__class__.__name__, self.serial.port, self.serial.baudrate, self.device_name)
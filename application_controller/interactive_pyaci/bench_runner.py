@@ -0,0 +1,226 @@
+"""Host runner for the mesh benchmark firmware in nRF51/examples/Bandwidth_test.
+
+Connect one node running the benchmark firmware over UART, and run e.g.
+    python bench_runner.py -d /dev/ttyACM0 --first 1 --last 20 --sink 100 \\
+        --payload 14,23 --interval 100,500 --ack both --duration 30 -o results.csv
+
+Every combination of payload length, update interval and ack mode is run as a
+separate benchmark round. The runner writes the round configuration to the
+benchmark config handle, collects the source reports the connected node
+forwards over the ACI for the round duration, and appends one CSV row with the
+delivery ratio, round trip latency percentiles and source airtime per round.
+"""
+from __future__ import print_function
+import csv
+import itertools
+import logging
+import struct
+import sys
+import threading
+import time
+from argparse import ArgumentParser
+
+from aci import AciCommand, AciEvent
+from aci_serial import AciUart
+
+BENCH_CONFIG_HANDLE = 0xFFE0
+BENCH_ACK_HANDLE_OFFSET = 0x4000
+BENCH_FLAG_ACK = (1 << 0)
+BENCH_FLAG_NO_RELAY = (1 << 1)
+BENCH_FLAG_ACK_BITMAP = (1 << 2)
+
+CONFIG_FORMAT = "<BBBBHHHH"
+REPORT_FORMAT = "<HBBIHHH"
+REPORT_SIZE = struct.calcsize(REPORT_FORMAT)
+VALUE_MAX_LEN = 23
+ACK_BITMAP_SOURCES_MAX = (VALUE_MAX_LEN - 2) * 8
+
+# preamble, access address, header, advertisement address, mesh AD header and CRC
+PACKET_OVERHEAD_BYTES = 1 + 4 + 2 + 6 + 8 + 3
+US_PER_BYTE = 8
+
+CSV_FIELDS = [
+    "round", "payload_len", "interval_ms", "ack", "no_relay", "duration_s",
+    "sources_heard", "updates_sent", "updates_seen", "delivery_ratio",
+    "latency_samples", "latency_p50_ms", "latency_p90_ms", "latency_p99_ms", "latency_max_ms",
+    "source_tx", "source_airtime_pct",
+]
+
+
+class SourceState(object):
+    def __init__(self):
+        self.seqs = set()
+        self.max_seq = 0
+        self.ack_count = 0
+        self.tx_count = 0
+        self.rtts = dict()
+
+
+class BenchRound(object):
+    def __init__(self, round_id, first_handle, last_handle):
+        self.round_id = round_id
+        self.first_handle = first_handle
+        self.last_handle = last_handle
+        self.sources = dict()
+        self.lock = threading.Lock()
+
+    def packet_handler(self, evt):
+        if not isinstance(evt, AciEvent.AciEventNew):
+            return
+        if evt.ValueHandle < self.first_handle or evt.ValueHandle > self.last_handle:
+            return
+        if len(evt.Data) < REPORT_SIZE:
+            return
+        (seq, round_id, _, rtt_us, rtt_seq, ack_count, tx_count) = struct.unpack_from(
+            REPORT_FORMAT, bytearray(evt.Data))
+        if round_id != self.round_id:
+            return
+
+        with self.lock:
+            src = self.sources.setdefault(evt.ValueHandle, SourceState())
+            src.seqs.add(seq)
+            if seq >= src.max_seq:
+                src.max_seq = seq
+                src.ack_count = ack_count
+                src.tx_count = tx_count
+            if rtt_seq != 0:
+                src.rtts[rtt_seq] = rtt_us
+
+
+def percentile(sorted_values, fraction):
+    if len(sorted_values) == 0:
+        return ""
+    return sorted_values[int(fraction * (len(sorted_values) - 1))]
+
+
+def ms(value_us):
+    if value_us == "":
+        return ""
+    return "%.2f" % (value_us / 1000.0)
+
+
+def round_summarize(bench_round, payload_len, interval_ms, ack, no_relay, duration_s):
+    with bench_round.lock:
+        sources = list(bench_round.sources.values())
+
+    updates_sent = sum(src.max_seq for src in sources)
+    updates_seen = sum(len(src.seqs) for src in sources)
+    if ack:
+        # a report carries the acknowledgements of the updates before it
+        acked = sum(src.ack_count for src in sources)
+        expected = sum(max(src.max_seq - 1, 0) for src in sources)
+    else:
+        acked = updates_seen
+        expected = updates_sent
+    rtts = sorted(itertools.chain.from_iterable(src.rtts.values() for src in sources))
+    source_tx = sum(src.tx_count for src in sources)
+    airtime_us = source_tx * (PACKET_OVERHEAD_BYTES + payload_len) * US_PER_BYTE
+
+    return {
+        "round": bench_round.round_id,
+        "payload_len": payload_len,
+        "interval_ms": interval_ms,
+        "ack": ack,
+        "no_relay": int(no_relay),
+        "duration_s": duration_s,
+        "sources_heard": len(sources),
+        "updates_sent": updates_sent,
+        "updates_seen": updates_seen,
+        "delivery_ratio": "%.4f" % (float(acked) / expected) if expected else "",
+        "latency_samples": len(rtts),
+        "latency_p50_ms": ms(percentile(rtts, 0.5)),
+        "latency_p90_ms": ms(percentile(rtts, 0.9)),
+        "latency_p99_ms": ms(percentile(rtts, 0.99)),
+        "latency_max_ms": ms(rtts[-1]) if rtts else "",
+        "source_tx": source_tx,
+        "source_airtime_pct": "%.3f" % (100.0 * airtime_us / (duration_s * 1000000.0)),
+    }
+
+
+def config_send(acidev, round_id, flags, payload_len, first_handle, last_handle, sink_id, interval_ms):
+    data = list(bytearray(struct.pack(CONFIG_FORMAT, round_id, flags, payload_len, 0,
+                                      first_handle, last_handle, sink_id, interval_ms)))
+    acidev.write_aci_cmd(AciCommand.AciValueSet(handle=BENCH_CONFIG_HANDLE, data=data, length=len(data) + 3))
+
+
+def int_list(value):
+    return [int(v, 0) for v in value.split(",")]
+
+
+ACK_OFF = 0
+ACK_ON = 1
+ACK_BITMAP = 2
+ACK_FLAGS = {
+    ACK_OFF: 0,
+    ACK_ON: BENCH_FLAG_ACK,
+    ACK_BITMAP: BENCH_FLAG_ACK | BENCH_FLAG_ACK_BITMAP,
+}
+
+
+def ack_modes(value):
+    return {"on": [ACK_ON], "off": [ACK_OFF], "both": [ACK_OFF, ACK_ON], "bitmap": [ACK_BITMAP]}[value]
+
+
+def main():
+    parser = ArgumentParser(description="Runs mesh benchmark rounds and writes the results as CSV.")
+    parser.add_argument("-d", "--device", required=True, help="Serial port of the connected node, e.g. COM216")
+    parser.add_argument("-b", "--baudrate", default="115200", help="Baud rate")
+    parser.add_argument("--first", type=int, required=True, help="First source node ID")
+    parser.add_argument("--last", type=int, required=True, help="Last source node ID")
+    parser.add_argument("--sink", type=int, default=0xFFFF, help="Node ID of the acknowledging node")
+    parser.add_argument("--payload", type=int_list, default=[REPORT_SIZE],
+                        help="Comma separated payload lengths, %d-%d bytes" % (REPORT_SIZE, VALUE_MAX_LEN))
+    parser.add_argument("--interval", type=int_list, default=[100], help="Comma separated update intervals in ms")
+    parser.add_argument("--ack", choices=["on", "off", "both", "bitmap"], default="on",
+                        help="Ack mode, bitmap has the sink ack all sources in one value per interval")
+    parser.add_argument("--no-relay", action="store_true", help="Only sources and sink retransmit (single hop)")
+    parser.add_argument("--duration", type=int, default=30, help="Duration of each round in seconds")
+    parser.add_argument("--settle", type=int, default=5, help="Idle time between rounds in seconds")
+    parser.add_argument("--repeat", type=int, default=1, help="Number of runs of each combination")
+    parser.add_argument("-o", "--output", default="bench_results.csv", help="CSV file to append the results to")
+    options = parser.parse_args()
+
+    for payload_len in options.payload:
+        if payload_len < REPORT_SIZE or payload_len > VALUE_MAX_LEN:
+            parser.error("payload length must be in the range %d-%d" % (REPORT_SIZE, VALUE_MAX_LEN))
+    if options.last >= BENCH_ACK_HANDLE_OFFSET or options.first > options.last:
+        parser.error("invalid source range")
+    if options.ack == "bitmap" and options.last - options.first >= ACK_BITMAP_SOURCES_MAX:
+        parser.error("the ack bitmap holds at most %d sources" % ACK_BITMAP_SOURCES_MAX)
+
+    acidev = AciUart.AciUart(port=options.device, baudrate=options.baudrate)
+    round_id = int(time.time()) % 254 + 1
+
+    try:
+        with open(options.output, "a") as f:
+            writer = csv.DictWriter(f, fieldnames=CSV_FIELDS)
+            if f.tell() == 0:
+                writer.writeheader()
+
+            runs = itertools.product(range(options.repeat), options.payload, options.interval, ack_modes(options.ack))
+            for (_, payload_len, interval_ms, ack) in runs:
+                flags = ACK_FLAGS[ack] | (BENCH_FLAG_NO_RELAY if options.no_relay else 0)
+                bench_round = BenchRound(round_id, options.first, options.last)
+                acidev.AddPacketRecipient(bench_round.packet_handler)
+
+                config_send(acidev, round_id, flags, payload_len, options.first, options.last,
+                            options.sink, interval_ms)
+                time.sleep(options.duration)
+                acidev._pack_recipients.remove(bench_round.packet_handler)
+
+                result = round_summarize(bench_round, payload_len, interval_ms, ack, options.no_relay,
+                                         options.duration)
+                writer.writerow(result)
+                f.flush()
+                print(", ".join("%s=%s" % (k, result[k]) for k in CSV_FIELDS))
+
+                round_id = round_id % 255 + 1
+                config_send(acidev, 0, 0, REPORT_SIZE, 0, 0, 0xFFFF, 1)
+                time.sleep(options.settle)
+    finally:
+        acidev.stop()
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING)
+    main()
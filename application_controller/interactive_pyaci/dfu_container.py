@@ -0,0 +1,246 @@
+"""DFU container files, made offline and streamed by dfu_runner.py.
+
+A container holds everything the host needs for a transfer, so it only has to
+add the packet headers at send time:
+
+    python dfu_container.py app.hex -o app.mdfu --type app --start-address 0x18000 \\
+        --company-id 0x59 --app-id 1 --app-version 2 --signature app.sig
+
+The image is padded to whole words and cut into segments the way the targets
+number them. The first segment ends at the first segment aligned address after
+the start address, and the signature follows the image in whole segments.
+The container also stores the SHA256 of every flash page of the image, and
+the digest the targets check the signature against. The digest covers the
+transfer header and the image, in the same order as signature_hash_start() in
+dfu_mesh.c. Anyone holding the container can check a page or the whole image
+against it without the source files.
+
+All fields are little endian:
+
+    magic "MDFU", version (1 byte), type, segment size, page size shift (1 byte each)
+    start address, image length in bytes (4 bytes each)
+    FWID length (1 byte), FWID
+    segment count, signature length, page count (2 bytes each)
+    digest (32 bytes)
+    page hashes (32 bytes each)
+    segments, each a length (2 bytes) and the segment data
+"""
+from __future__ import print_function
+import hashlib
+import struct
+from argparse import ArgumentParser
+
+MAGIC = b"MDFU"
+VERSION = 1
+DFU_TYPES = {"sd": 1, "bootloader": 2, "app": 4}
+START_ADDRESS_UNKNOWN = 0xFFFFFFFF
+HEADER_FORMAT = "<4sBBBBII"
+COUNTS_FORMAT = "<HHH"
+HASH_LEN = 32
+
+
+def segment_length(segment_size):
+    return 16 << segment_size
+
+
+def image_pad(image):
+    if len(image) % 4:
+        image += b"\xff" * (4 - len(image) % 4)
+    return image
+
+
+def segments_cut(image, start_address, segment_size, signature=b""):
+    seg_len = segment_length(segment_size)
+    start = 0 if start_address == START_ADDRESS_UNKNOWN else start_address
+    first_len = seg_len - (start & (seg_len - 1))
+    segments = []
+    offset = 0
+    while offset < len(image):
+        chunk_len = first_len if offset == 0 else seg_len
+        segments.append(image[offset:offset + chunk_len])
+        offset += chunk_len
+    for i in range(0, len(signature), seg_len):
+        segments.append(signature[i:i + seg_len])
+    return segments
+
+
+def fwid_pack(dfu_type, company_id=0, app_id=0, app_version=0, bl_id=0, bl_version=0, sd_version=0):
+    if dfu_type == "app":
+        return struct.pack("<IHI", company_id, app_id, app_version)
+    if dfu_type == "bootloader":
+        return struct.pack("<BB", bl_id, bl_version)
+    return struct.pack("<H", sd_version)
+
+
+def transfer_digest(dfu_type, start_address, image, fwid):
+    header = struct.pack("<BIIB", DFU_TYPES[dfu_type], start_address, len(image), 0)
+    return hashlib.sha256(header + fwid + image).digest()
+
+
+def page_hashes(image, start_address, page_size):
+    """Hash every flash page the image covers, the first and last only over
+    the part the image fills."""
+    start = 0 if start_address == START_ADDRESS_UNKNOWN else start_address
+    hashes = []
+    offset = 0
+    while offset < len(image):
+        chunk_len = page_size - ((start + offset) & (page_size - 1))
+        hashes.append(hashlib.sha256(image[offset:offset + chunk_len]).digest())
+        offset += chunk_len
+    return hashes
+
+
+def hex_parse(text):
+    """Parse an Intel hex file into its start address and contiguous data,
+    with any gaps filled with 0xFF."""
+    records = {}
+    base = 0
+    for line in text.splitlines():
+        line = line.strip()
+        if not line.startswith(":"):
+            continue
+        raw = bytearray.fromhex(line[1:])
+        (count, addr, rec_type) = (raw[0], (raw[1] << 8) | raw[2], raw[3])
+        data = bytes(raw[4:4 + count])
+        if rec_type == 0x00:
+            records[base + addr] = data
+        elif rec_type == 0x02:
+            base = ((data[0] << 8) | data[1]) << 4
+        elif rec_type == 0x04:
+            base = ((data[0] << 8) | data[1]) << 16
+        elif rec_type == 0x01:
+            break
+    if len(records) == 0:
+        raise ValueError("no data in the hex file")
+    start = min(records)
+    end = max(addr + len(data) for (addr, data) in records.items())
+    image = bytearray(b"\xff" * (end - start))
+    for (addr, data) in records.items():
+        image[addr - start:addr - start + len(data)] = data
+    return (start, bytes(image))
+
+
+class Container(object):
+    def __init__(self, dfu_type, start_address, image, fwid, segment_size=0, signature=b"", page_size=1024):
+        self.dfu_type = dfu_type
+        self.start_address = start_address
+        self.image = image_pad(image)
+        self.fwid = fwid
+        self.segment_size = segment_size
+        self.signature = signature
+        self.page_size = page_size
+        self.segments = segments_cut(self.image, start_address, segment_size, signature)
+        self.page_hashes = page_hashes(self.image, start_address, page_size)
+        self.digest = transfer_digest(dfu_type, start_address, self.image, fwid)
+
+    def serialize(self):
+        type_id = DFU_TYPES[self.dfu_type]
+        page_shift = self.page_size.bit_length() - 1
+        out = struct.pack(HEADER_FORMAT, MAGIC, VERSION, type_id, self.segment_size, page_shift,
+                          self.start_address, len(self.image))
+        out += struct.pack("<B", len(self.fwid)) + self.fwid
+        out += struct.pack(COUNTS_FORMAT, len(self.segments), len(self.signature), len(self.page_hashes))
+        out += self.digest + b"".join(self.page_hashes)
+        for segment in self.segments:
+            out += struct.pack("<H", len(segment)) + segment
+        return out
+
+    @staticmethod
+    def deserialize(data):
+        (magic, version, type_id, segment_size, page_shift, start_address, length) = \
+            struct.unpack_from(HEADER_FORMAT, data)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError("not a version %d DFU container" % VERSION)
+        offset = struct.calcsize(HEADER_FORMAT)
+        fwid_len = data[offset]
+        fwid = data[offset + 1:offset + 1 + fwid_len]
+        offset += 1 + fwid_len
+        (segment_count, signature_length, page_count) = struct.unpack_from(COUNTS_FORMAT, data, offset)
+        offset += struct.calcsize(COUNTS_FORMAT)
+        digest = data[offset:offset + HASH_LEN]
+        offset += HASH_LEN
+        hashes = [data[offset + i * HASH_LEN:offset + (i + 1) * HASH_LEN] for i in range(page_count)]
+        offset += page_count * HASH_LEN
+        segments = []
+        for _ in range(segment_count):
+            (segment_len,) = struct.unpack_from("<H", data, offset)
+            segments.append(data[offset + 2:offset + 2 + segment_len])
+            offset += 2 + segment_len
+
+        self = Container.__new__(Container)
+        self.dfu_type = [name for (name, value) in DFU_TYPES.items() if value == type_id][0]
+        self.start_address = start_address
+        self.segment_size = segment_size
+        self.page_size = 1 << page_shift
+        self.fwid = fwid
+        self.segments = segments
+        self.page_hashes = hashes
+        self.digest = digest
+        self.image = b"".join(segments)[:length]
+        self.signature = b"".join(segments)[length:length + signature_length]
+        if len(self.image) != length or len(self.signature) != signature_length:
+            raise ValueError("truncated DFU container")
+        return self
+
+    def verify(self):
+        """Check the segments against the page hashes and the digest."""
+        return (page_hashes(self.image, self.start_address, self.page_size) == self.page_hashes and
+                transfer_digest(self.dfu_type, self.start_address, self.image, self.fwid) == self.digest)
+
+
+def load(file_name):
+    with open(file_name, "rb") as f:
+        container = Container.deserialize(bytearray(f.read()))
+    if not container.verify():
+        raise ValueError("%s doesn't match its hashes" % file_name)
+    return container
+
+
+def main():
+    parser = ArgumentParser(description="Packs a firmware image into a DFU container for dfu_runner.py.")
+    parser.add_argument("image", help="Intel hex or binary image file")
+    parser.add_argument("-o", "--output", required=True, help="Container file to write")
+    parser.add_argument("--signature", help="Binary file with the signature of the transfer digest")
+    parser.add_argument("--type", choices=sorted(DFU_TYPES.keys()), default="app", help="Type of the transfer")
+    parser.add_argument("--start-address", type=lambda v: int(v, 0),
+                        help="Address of the image, taken from hex files by default")
+    parser.add_argument("--company-id", type=lambda v: int(v, 0), default=0, help="Company ID of the app")
+    parser.add_argument("--app-id", type=lambda v: int(v, 0), default=0, help="App ID of the app")
+    parser.add_argument("--app-version", type=lambda v: int(v, 0), default=0, help="Version of the app")
+    parser.add_argument("--bl-id", type=lambda v: int(v, 0), default=0, help="ID of the bootloader")
+    parser.add_argument("--bl-version", type=lambda v: int(v, 0), default=0, help="Version of the bootloader")
+    parser.add_argument("--sd-version", type=lambda v: int(v, 0), default=0, help="Version of the SoftDevice")
+    parser.add_argument("--segment-size", type=int, default=0, help="Segments are 16 << size bytes")
+    parser.add_argument("--page-size", type=int, default=1024, help="Flash page size, 4096 on nRF52")
+    options = parser.parse_args()
+
+    if options.page_size & (options.page_size - 1):
+        parser.error("the page size must be a power of two")
+    if options.image.lower().endswith(".hex"):
+        with open(options.image, "r") as f:
+            (hex_start, image) = hex_parse(f.read())
+    else:
+        with open(options.image, "rb") as f:
+            image = f.read()
+        hex_start = START_ADDRESS_UNKNOWN
+    start_address = hex_start if options.start_address is None else options.start_address
+    signature = b""
+    if options.signature:
+        with open(options.signature, "rb") as f:
+            signature = f.read()
+        if len(signature) % segment_length(options.segment_size):
+            parser.error("the signature must fill whole segments")
+
+    fwid = fwid_pack(options.type, options.company_id, options.app_id, options.app_version,
+                     options.bl_id, options.bl_version, options.sd_version)
+    container = Container(options.type, start_address, image, fwid, options.segment_size, signature,
+                          options.page_size)
+    with open(options.output, "wb") as f:
+        f.write(container.serialize())
+    print("%s: %d bytes in %d segments, %d pages, digest %s" % (
+        options.output, len(container.image), len(container.segments), len(container.page_hashes),
+        container.digest.hex() if hasattr(container.digest, "hex") else container.digest.encode("hex")))
+
+
+if __name__ == "__main__":
+    main()
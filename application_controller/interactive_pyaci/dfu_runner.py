@@ -0,0 +1,344 @@
+"""Host DFU tool that feeds one image to the mesh through several serial gateways
+at once.
+
+Connect a node to each mesh region over UART, and run e.g.
+    python dfu_runner.py -d /dev/ttyACM0,/dev/ttyACM1,/dev/ttyACM2 \\
+        --image app.bin --type app --start-address 0x18000 \\
+        --company-id 0x59 --app-id 1 --app-version 2 --signature app.sig
+
+or stream a container made offline by dfu_container.py, which is already cut
+into segments and checked against its hashes:
+    python dfu_runner.py -d /dev/ttyACM0,/dev/ttyACM1 --container app.mdfu
+
+Every gateway gets the same transaction, so regions that overlap see the same
+packets and treat them as the same transfer. Each gateway is streamed to in its
+own thread. Up to --window DFU commands are in flight on each serial link. The
+device answers every DFU command with a command response, in order, so a
+failed command can be matched to its packet and sent again. If the firmware is
+built with DFU_PROGRESS_BEACON, the gateways forward the progress reports of
+the mesh. The tool then stops as soon as every gateway reports that nothing is
+missing, instead of waiting for --wait seconds.
+
+With --windowed, the packets go out as windowed DFU commands instead. The
+device doesn't answer each of them, but acknowledges them in batches, and
+gives the number of packets it has room for in its flash queue. The link then
+runs at the line rate instead of being bound by the round trip of each
+command. After a loss, the gateway goes back to the first packet the device
+hasn't accepted.
+"""
+from __future__ import print_function
+import collections
+import logging
+import random
+import struct
+import sys
+import threading
+import time
+from argparse import ArgumentParser
+
+import dfu_container
+from aci import AciCommand, AciEvent
+from aci_serial import AciUart
+from dfu_container import DFU_TYPES, START_ADDRESS_UNKNOWN, segment_length
+
+DFU_PACKET_TYPE_PROGRESS = 0xFFF6
+DFU_PACKET_TYPE_DATA = 0xFFFC
+DFU_PACKET_TYPE_STATE = 0xFFFD
+
+START_FLAG_FIRST = (1 << 2)
+START_FLAG_LAST = (1 << 3)
+START_FLAG_SEGMENT_SIZE_POS = 4
+
+DATA_HEADER_LEN = 2 + 2 + 4  # packet type, segment, transaction ID
+PROGRESS_FORMAT = "<HIB"
+STATUS_SUCCESS = 0x00
+STATUS_BUSY = 0x86
+STATUS_INVALID_DATA = 0x87
+RETRIES_MAX = 8
+PROBE_S = 0.1  # time to wait for a windowed acknowledgement before asking again
+
+
+def state_packet(container, authority, transaction_id):
+    return struct.pack("<HBBI", DFU_PACKET_TYPE_STATE, DFU_TYPES[container.dfu_type], authority & 0x07,
+                       transaction_id) + bytes(container.fwid)
+
+
+def start_packet(container, transaction_id):
+    flags = START_FLAG_FIRST | START_FLAG_LAST | (container.segment_size << START_FLAG_SEGMENT_SIZE_POS)
+    return struct.pack("<HHIIIHB", DFU_PACKET_TYPE_DATA, 0, transaction_id, container.start_address,
+                       len(container.image) // 4, len(container.signature), flags)
+
+
+def transfer_packets(container, transaction_id):
+    """Put headers on the start packet and every segment of the transfer, in order."""
+    packets = [start_packet(container, transaction_id)]
+    for (i, segment) in enumerate(container.segments):
+        packets.append(struct.pack("<HHI", DFU_PACKET_TYPE_DATA, i + 1, transaction_id) + bytes(segment))
+    return packets
+
+
+class Gateway(object):
+    def __init__(self, port, baudrate, window, transaction_id):
+        self.port = port
+        self.window = window
+        self.transaction_id = transaction_id
+        self.cond = threading.Condition()
+        self.outstanding = collections.deque()  # (packet, retries), in the order they were sent
+        self.retries = collections.deque()
+        self.sent = 0
+        self.failed = 0
+        self.missing = None  # from the last progress report for our transaction
+        self.acks = collections.deque()
+        self.acidev = AciUart.AciUart(port=port, baudrate=baudrate)
+        self.acidev.AddPacketRecipient(self.event_handle)
+
+    def event_handle(self, evt):
+        if isinstance(evt, AciEvent.AciCmdRsp) and evt.CommandOpCode == AciCommand.AciDfuData.OpCode:
+            with self.cond:
+                if len(self.outstanding) > 0:
+                    (packet, retries) = self.outstanding.popleft()
+                    if evt.StatusCode != STATUS_SUCCESS:
+                        if retries < RETRIES_MAX:
+                            self.retries.append((packet, retries + 1))
+                        else:
+                            self.failed += 1
+                            logging.error("%s: gave up on a DFU packet: %s", self.port,
+                                          AciEvent.AciStatusLookUp(evt.StatusCode))
+                self.cond.notify_all()
+        elif isinstance(evt, AciEvent.AciEventDfuAck):
+            with self.cond:
+                self.acks.append(evt)
+                self.cond.notify_all()
+        elif isinstance(evt, AciEvent.AciEventDfu) and evt.PacketType == DFU_PACKET_TYPE_PROGRESS:
+            payload = bytearray(evt.Payload)
+            if len(payload) < struct.calcsize(PROGRESS_FORMAT):
+                return
+            (missing, transaction_id, _) = struct.unpack_from(PROGRESS_FORMAT, payload)
+            if transaction_id == self.transaction_id:
+                with self.cond:
+                    self.missing = missing
+                    self.cond.notify_all()
+
+    def _send(self, packet, retries, timeout):
+        with self.cond:
+            deadline = time.time() + timeout
+            while len(self.outstanding) >= self.window and time.time() < deadline:
+                self.cond.wait(deadline - time.time())
+            if len(self.outstanding) >= self.window:
+                # the responses got lost on the way, don't wait for them forever
+                logging.warning("%s: no response to %d DFU commands", self.port, len(self.outstanding))
+                self.outstanding.clear()
+            self.outstanding.append((packet, retries))
+        data = list(bytearray(packet))
+        self.acidev.write_aci_cmd(AciCommand.AciDfuData(data=data, length=len(data) + 1), wait=False)
+        self.sent += 1
+
+    def stream(self, packets, interval_s, timeout):
+        for packet in packets:
+            while True:
+                with self.cond:
+                    retry = self.retries.popleft() if len(self.retries) > 0 else None
+                if retry is None:
+                    break
+                self._send(retry[0], retry[1], timeout)
+                time.sleep(interval_s)
+            self._send(packet, 0, timeout)
+            time.sleep(interval_s)
+
+        # send the retries of the last window
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            with self.cond:
+                if len(self.retries) > 0:
+                    retry = self.retries.popleft()
+                elif len(self.outstanding) == 0:
+                    return
+                else:
+                    self.cond.wait(deadline - time.time())
+                    continue
+            self._send(retry[0], retry[1], timeout)
+            time.sleep(interval_s)
+
+    def _send_windowed(self, seq, packet):
+        data = list(bytearray(packet))
+        self.acidev.write_aci_cmd(AciCommand.AciDfuWindowed(seq, data), wait=False)
+        self.sent += 1
+
+    def stream_windowed(self, packets, timeout):
+        """Go-back-N over the windowed DFU commands. Packet i has sequence
+        number i, modulo 256."""
+        with self.cond:
+            self.acks.clear()
+        base = 0        # first packet the device hasn't accepted
+        next_index = 0  # next packet to send
+        end = 0         # one past the furthest packet sent
+        credit = 0
+        rewound_at = None
+        retries = 0
+        opened = False
+        deadline = time.time() + timeout
+        self._send_windowed(0, b"")  # open the window
+        while base < len(packets):
+            while next_index < len(packets) and next_index < base + credit:
+                self._send_windowed(next_index, packets[next_index])
+                next_index += 1
+                end = max(end, next_index)
+
+            with self.cond:
+                if len(self.acks) == 0:
+                    self.cond.wait(PROBE_S)
+                ack = self.acks.popleft() if len(self.acks) > 0 else None
+
+            if ack is None:
+                if time.time() > deadline:
+                    logging.error("%s: no acknowledgement from the device, giving up", self.port)
+                    self.failed += len(packets) - base
+                    return
+                if not opened:
+                    self._send_windowed(0, b"")
+                    continue
+                # ask for the window again, with the first packet it's missing
+                rewound_at = None
+                next_index = base
+                credit = 1
+                continue
+
+            opened = True
+            advance = (ack.NextSeq - base) & 0xFF
+            if advance > end - base:
+                continue  # stale
+            base += advance
+            credit = ack.Credit
+            deadline = time.time() + timeout
+            if advance > 0:
+                retries = 0
+            if ack.StatusCode in (STATUS_BUSY, STATUS_INVALID_DATA):
+                if base != rewound_at:
+                    rewound_at = base
+                    next_index = base
+                    retries += 1
+                    if retries > RETRIES_MAX:
+                        logging.error("%s: the device keeps rejecting packet %d", self.port, base)
+                        self.failed += len(packets) - base
+                        return
+                if ack.StatusCode == STATUS_BUSY:
+                    credit = 0  # probe again after a while
+            elif ack.StatusCode != STATUS_SUCCESS:
+                self.failed += 1
+                logging.error("%s: the device rejected packet %d: %s", self.port, base - 1,
+                              AciEvent.AciStatusLookUp(ack.StatusCode))
+
+    def stop(self):
+        self.acidev.stop()
+
+
+def main():
+    parser = ArgumentParser(description="Streams a DFU image to the mesh through several serial gateways in parallel.")
+    parser.add_argument("-d", "--devices", required=True, help="Comma separated serial ports of the gateway nodes")
+    parser.add_argument("-b", "--baudrate", default="115200", help="Baud rate")
+    parser.add_argument("--image", help="Binary image file to transfer")
+    parser.add_argument("--container", help="DFU container to transfer, made by dfu_container.py")
+    parser.add_argument("--signature", help="Binary file with the signature of the image")
+    parser.add_argument("--type", choices=sorted(DFU_TYPES.keys()), default="app", help="Type of the transfer")
+    parser.add_argument("--start-address", type=lambda v: int(v, 0), default=START_ADDRESS_UNKNOWN,
+                        help="Address of the image, left to the targets by default")
+    parser.add_argument("--company-id", type=lambda v: int(v, 0), default=0, help="Company ID of the app")
+    parser.add_argument("--app-id", type=lambda v: int(v, 0), default=0, help="App ID of the app")
+    parser.add_argument("--app-version", type=lambda v: int(v, 0), default=0, help="Version of the app")
+    parser.add_argument("--bl-id", type=lambda v: int(v, 0), default=0, help="ID of the bootloader")
+    parser.add_argument("--bl-version", type=lambda v: int(v, 0), default=0, help="Version of the bootloader")
+    parser.add_argument("--sd-version", type=lambda v: int(v, 0), default=0, help="Version of the SoftDevice")
+    parser.add_argument("--authority", type=int, default=1, help="Authority of the transfer, 1-7")
+    parser.add_argument("--transaction-id", type=lambda v: int(v, 0), help="Transaction ID, random by default")
+    parser.add_argument("--segment-size", type=int, default=0,
+                        help="Segments are 16 << size bytes, larger sizes need RBC_MESH_LONG_PACKETS")
+    parser.add_argument("--window", type=int, default=8, help="DFU commands in flight on each serial link")
+    parser.add_argument("--interval", type=int, default=30, help="Time between DFU packets on each gateway in ms")
+    parser.add_argument("--start-delay", type=int, default=3,
+                        help="Seconds between the state beacon and the first data, for the targets to join")
+    parser.add_argument("--wait", type=int, default=60,
+                        help="Seconds to wait for the mesh to finish once all data is sent")
+    parser.add_argument("--timeout", type=float, default=2.0, help="Seconds to wait for a command response")
+    parser.add_argument("--windowed", action="store_true",
+                        help="Stream the data as windowed DFU commands, acknowledged in batches")
+    options = parser.parse_args()
+
+    if options.authority < 1 or options.authority > 7:
+        parser.error("the authority must be in the range 1-7")
+    if options.window < 1:
+        parser.error("the window must hold at least one command")
+    if (options.image is None) == (options.container is None):
+        parser.error("give either an image or a container")
+
+    if options.container:
+        try:
+            container = dfu_container.load(options.container)
+        except ValueError as e:
+            parser.error(str(e))
+    else:
+        with open(options.image, "rb") as f:
+            image = f.read()
+        signature = b""
+        if options.signature:
+            with open(options.signature, "rb") as f:
+                signature = f.read()
+            if len(signature) % segment_length(options.segment_size):
+                parser.error("the signature must fill whole segments")
+        fwid = dfu_container.fwid_pack(options.type, options.company_id, options.app_id, options.app_version,
+                                       options.bl_id, options.bl_version, options.sd_version)
+        container = dfu_container.Container(options.type, options.start_address, image, fwid,
+                                            options.segment_size, signature)
+    if DATA_HEADER_LEN + segment_length(container.segment_size) + 1 > AciCommand.AciDfuData.MAX_DFU_LENGTH:
+        parser.error("segment size %d doesn't fit in a DFU command" % container.segment_size)
+
+    transaction_id = options.transaction_id
+    if transaction_id is None:
+        transaction_id = random.randint(1, 0xFFFFFFFF)
+    packets = transfer_packets(container, transaction_id)
+    print("Transaction 0x%08x: %d bytes in %d segments" % (transaction_id, len(container.image), len(packets) - 1))
+
+    gateways = [Gateway(port, options.baudrate, options.window, transaction_id)
+                for port in options.devices.split(",")]
+    begin = time.time()
+    try:
+        state = state_packet(container, options.authority, transaction_id)
+        for gateway in gateways:
+            gateway.stream([state], 0, options.timeout)
+        time.sleep(options.start_delay)
+
+        if options.windowed:
+            threads = [threading.Thread(target=gateway.stream_windowed, args=(packets, options.timeout))
+                       for gateway in gateways]
+        else:
+            threads = [threading.Thread(target=gateway.stream,
+                                        args=(packets, options.interval / 1000.0, options.timeout))
+                       for gateway in gateways]
+        for thread in threads:
+            thread.daemon = True
+            thread.start()
+        while any(thread.is_alive() for thread in threads):
+            time.sleep(1)
+            print(", ".join("%s: %d/%d sent" % (gw.port, gw.sent, len(packets)) for gw in gateways))
+        print("All data sent in %.1f s" % (time.time() - begin))
+
+        deadline = time.time() + options.wait
+        while time.time() < deadline:
+            if all(gw.missing == 0 for gw in gateways):
+                print("The mesh reports the transfer complete after %.1f s" % (time.time() - begin))
+                break
+            print(", ".join("%s: %s missing" % (gw.port, "?" if gw.missing is None else gw.missing)
+                            for gw in gateways))
+            time.sleep(1)
+    finally:
+        for gateway in gateways:
+            gateway.stop()
+
+    failed = sum(gw.failed for gw in gateways)
+    if failed:
+        print("%d packets were rejected by the gateways" % failed)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING)
+    main()
@@ -3,6 +3,8 @@ import IPython
 from argparse import ArgumentParser
 from traitlets import config
 from aci import AciCommand
+from aci import AciSniffer
+from aci import AciTrace
 from aci_serial import AciUart
 
 class Interactive(object):
@@ -67,6 +69,58 @@ class Interactive(object):
     def MinIntervalGet(self):
         self.acidev.write_aci_cmd(AciCommand.AciIntervalMinMsGet())
 
+    def EventMaskSet(self, Mask):
+        self.acidev.write_aci_cmd(AciCommand.AciEventMaskSet(Mask))
+
+    def EventFormatSet(self, Compact):
+        format = AciCommand.AciEventFormatSet.COMPACT if Compact else AciCommand.AciEventFormatSet.FULL
+        self.acidev.write_aci_cmd(AciCommand.AciEventFormatSet(format))
+
+    def ValueHistoryGet(self, Handle, Version=0):
+        self.acidev.write_aci_cmd(AciCommand.AciValueHistoryGet(handle=Handle, version=Version))
+
+    def ShardSet(self, Count, Index):
+        self.acidev.write_aci_cmd(AciCommand.AciShardSet(count=Count, index=Index))
+
+    def MirrorStart(self):
+        self.acidev.write_aci_cmd(AciCommand.AciMirrorStart())
+
+    def HandleStatsGet(self, Handle, Reset=False):
+        self.acidev.write_aci_cmd(AciCommand.AciHandleStatsGet(handle=Handle, reset=Reset))
+
+    def IsrStatsGet(self, Isr, Latency=False, Reset=False):
+        self.acidev.write_aci_cmd(AciCommand.AciIsrStatsGet(isr=Isr, latency=Latency, reset=Reset))
+
+    def PropagationStatsGet(self, Reset=False):
+        self.acidev.write_aci_cmd(AciCommand.AciPropagationStatsGet(reset=Reset))
+
+    def ValuesSet(self, Values):
+        self.acidev.write_aci_cmd(AciCommand.AciValuesSet(values=Values))
+
+    def NeighborGet(self, Index=0):
+        self.acidev.write_aci_cmd(AciCommand.AciNeighborGet(index=Index))
+
+    def BaudrateSet(self, Baudrate):
+        return self.acidev.baudrate_switch(Baudrate)
+
+    def SnifferStart(self, Filename):
+        self.sniffer = AciSniffer.AciSniffer(Filename)
+        self.sniffer.attach(self.acidev)
+        self.acidev.write_aci_cmd(AciCommand.AciSnifferSet(True))
+
+    def SnifferStop(self):
+        self.acidev.write_aci_cmd(AciCommand.AciSnifferSet(False))
+        self.sniffer.close()
+
+    def TraceStart(self, Filename):
+        self.trace = AciTrace.AciTrace(Filename)
+        self.trace.attach(self.acidev)
+        self.acidev.write_aci_cmd(AciCommand.AciSnifferSet(True))
+
+    def TraceStop(self):
+        self.acidev.write_aci_cmd(AciCommand.AciSnifferSet(False))
+        self.trace.close()
+
 def get_ipython_config(device):
     # import os, sys, IPython
 
@@ -81,7 +135,10 @@ def start_ipython(options):
     comports = options.device.split(',')
     d = list()
     for dev_com in comports:
-        d.append(Interactive(AciUart.AciUart(port=dev_com, baudrate=options.baudrate)))
+        dev = Interactive(AciUart.AciUart(port=dev_com, baudrate=options.baudrate, rtscts=options.rtscts, framed=options.framed))
+        if options.switch_baudrate:
+            dev.BaudrateSet(int(options.switch_baudrate))
+        d.append(dev)
 
     IPython.embed(config=get_ipython_config(options.device))
     for dev in d:
@@ -92,5 +149,8 @@ if __name__ == '__main__':
     parser = ArgumentParser()
     parser.add_argument("-d", "--device", dest="device", required=True, help="Device Communication port, e.g. COM216")
     parser.add_argument("-b", "--baudrate", dest="baudrate", required=False, default='115200', help="Baud rate")
+    parser.add_argument("-r", "--rtscts", dest="rtscts", action="store_true", default=False, help="Use RTS/CTS flow control")
+    parser.add_argument("-f", "--framed", dest="framed", action="store_true", default=False, help="Use CRC checked frames, for devices built with SERIAL_UART_FRAMED")
+    parser.add_argument("-s", "--switch-baudrate", dest="switch_baudrate", required=False, default=None, help="Baud rate to negotiate with the device after connecting, up to 1000000")
     options = parser.parse_args()
     start_ipython(options)
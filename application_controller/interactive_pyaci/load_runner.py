@@ -0,0 +1,340 @@
+"""Host load generator for capacity tests with several serial-attached nodes.
+
+Connect any number of nodes running a serial (ACI) build, e.g. the BLE Gateway
+example, all initialized on the same access address, and run e.g.
+    python load_runner.py -d /dev/ttyACM0,/dev/ttyACM1,/dev/ttyACM2 --rate 2 \\
+        --model bursty --burst 5 --handles 1-64 --handle-dist zipf --payload 8,23 \\
+        --duration 60 --events events.csv -o load_results.csv
+
+Every publishing node sets values on the handles of the traffic model, and
+every node reports the updates it gets over the ACI. Each published value
+starts with the index of the publishing device and a sequence number, so the
+runner can match each update a node reports with the publish that caused it.
+Latencies are measured on the host clock, from writing the value set command
+to receiving the update from the other node, and include both serial delays.
+
+A value may be overwritten by a newer version before a node has heard the old
+one, which the mesh allows. Such publishes count as superseded on that node,
+and the coverage is the share of publishes that were delivered or superseded
+on every other node.
+
+Traffic models, per publishing node:
+    poisson: single publishes with exponentially distributed gaps, --rate per second.
+    bursty: bursts of --burst publishes --burst-gap ms apart, with the burst
+        starts exponentially distributed so the average rate is still --rate.
+"""
+from __future__ import print_function
+import bisect
+import csv
+import logging
+import random
+import struct
+import threading
+import time
+from argparse import ArgumentParser
+
+from aci import AciCommand, AciEvent
+from aci_serial import AciUart
+
+TAG_FORMAT = "<BI"
+TAG_SIZE = struct.calcsize(TAG_FORMAT)
+VALUE_MAX_LEN = 23
+
+CSV_FIELDS = [
+    "nodes", "publishers", "model", "rate_per_s", "handles", "handle_dist", "duration_s",
+    "published", "set_rejected", "expected", "delivered", "superseded",
+    "delivery_ratio", "coverage",
+    "latency_samples", "latency_p50_ms", "latency_p90_ms", "latency_p99_ms", "latency_max_ms",
+]
+
+EVENT_FIELDS = ["time_s", "device", "event", "handle", "origin", "seq", "length"]
+
+
+class Publish(object):
+    def __init__(self, origin, seq, handle, length, sent):
+        self.origin = origin
+        self.seq = seq
+        self.handle = handle
+        self.length = length
+        self.sent = sent
+
+
+class LoadRun(object):
+    """Publishes and receptions of one run, shared by the node threads."""
+    def __init__(self, device_count, event_writer=None):
+        self.device_count = device_count
+        self.lock = threading.Lock()
+        self.publishes = dict()
+        self.handle_publishes = dict()
+        self.received = [dict() for _ in range(device_count)]
+        self.set_rejected = 0
+        self.start = time.time()
+        self.event_writer = event_writer
+
+    def event_log(self, now, device, event, handle, origin, seq, length):
+        if self.event_writer is not None:
+            self.event_writer.writerow({
+                "time_s": "%.6f" % (now - self.start), "device": device, "event": event,
+                "handle": handle, "origin": origin, "seq": seq, "length": length,
+            })
+
+    def publish_add(self, publish):
+        with self.lock:
+            self.publishes[(publish.origin, publish.seq)] = publish
+            self.handle_publishes.setdefault(publish.handle, []).append(publish)
+            self.event_log(publish.sent, publish.origin, "publish", publish.handle, publish.origin,
+                           publish.seq, publish.length)
+
+    def packet_handler(self, device, evt):
+        now = time.time()
+        if isinstance(evt, AciEvent.AciCmdRsp):
+            if evt.CommandOpCode == AciCommand.AciValueSet.OpCode and evt.StatusCode != 0:
+                with self.lock:
+                    self.set_rejected += 1
+            return
+        if not isinstance(evt, AciEvent.AciEventNew) or isinstance(evt, AciEvent.AciEventTX):
+            return
+        if len(evt.Data) < TAG_SIZE:
+            return
+        (origin, seq) = struct.unpack_from(TAG_FORMAT, bytearray(evt.Data))
+        if origin >= self.device_count or origin == device:
+            return
+        with self.lock:
+            self.received[device].setdefault((origin, seq), now)
+            self.event_log(now, device, "update", evt.ValueHandle, origin, seq, len(evt.Data))
+
+
+class TrafficModel(object):
+    def __init__(self, options, rng):
+        self.rng = rng
+        self.options = options
+        (first, last) = options.handles
+        self.handles = list(range(first, last + 1))
+        weights = [1.0] * len(self.handles)
+        if options.handle_dist == "zipf":
+            weights = [1.0 / (i + 1) ** options.zipf_s for i in range(len(self.handles))]
+        self.cumulative = []
+        total = 0.0
+        for weight in weights:
+            total += weight
+            self.cumulative.append(total)
+
+    def handle_get(self):
+        index = bisect.bisect_left(self.cumulative, self.rng.random() * self.cumulative[-1])
+        return self.handles[min(index, len(self.handles) - 1)]
+
+    def payload_len_get(self):
+        return self.rng.choice(self.options.payload)
+
+    def gaps(self):
+        """Yield the time to wait before each publish, in seconds."""
+        if self.options.model == "poisson":
+            while True:
+                yield self.rng.expovariate(self.options.rate)
+        else:
+            burst_gap = self.options.burst_gap / 1000.0
+            burst_rate = self.options.rate / self.options.burst
+            while True:
+                yield self.rng.expovariate(burst_rate)
+                for _ in range(self.options.burst - 1):
+                    yield burst_gap
+
+
+def publisher(acidev, device, load_run, model, stop_time):
+    seq = 0
+    deadline = time.time()
+    for gap in model.gaps():
+        deadline += gap
+        if deadline >= stop_time:
+            break
+        delay = deadline - time.time()
+        if delay > 0:
+            time.sleep(delay)
+        seq += 1
+        handle = model.handle_get()
+        length = model.payload_len_get()
+        data = bytearray(struct.pack(TAG_FORMAT, device, seq))
+        data += bytearray(model.rng.getrandbits(8) for _ in range(length - TAG_SIZE))
+        load_run.publish_add(Publish(device, seq, handle, length, time.time()))
+        acidev.write_aci_cmd(AciCommand.AciValueSet(handle=handle, data=list(data), length=len(data) + 3),
+                             wait=False)
+
+
+def percentile(sorted_values, fraction):
+    if len(sorted_values) == 0:
+        return ""
+    return sorted_values[int(fraction * (len(sorted_values) - 1))]
+
+
+def ms(value_s):
+    if value_s == "":
+        return ""
+    return "%.2f" % (value_s * 1000.0)
+
+
+def run_summarize(load_run, options, publishers):
+    with load_run.lock:
+        publishes = list(load_run.publishes.values())
+        received = [dict(r) for r in load_run.received]
+        handle_publishes = dict((h, list(p)) for (h, p) in load_run.handle_publishes.items())
+        set_rejected = load_run.set_rejected
+
+    expected = 0
+    delivered = 0
+    superseded = 0
+    latencies = []
+    node_delivered = [0] * load_run.device_count
+    node_expected = [0] * load_run.device_count
+    for publish in publishes:
+        newer = [p for p in handle_publishes[publish.handle] if p.sent > publish.sent]
+        for device in range(load_run.device_count):
+            if device == publish.origin:
+                continue
+            expected += 1
+            node_expected[device] += 1
+            rx_time = received[device].get((publish.origin, publish.seq))
+            if rx_time is not None:
+                delivered += 1
+                node_delivered[device] += 1
+                latencies.append(rx_time - publish.sent)
+            elif any((p.origin, p.seq) in received[device] for p in newer):
+                superseded += 1
+    latencies.sort()
+
+    result = {
+        "nodes": load_run.device_count,
+        "publishers": len(publishers),
+        "model": options.model,
+        "rate_per_s": options.rate,
+        "handles": "%d-%d" % options.handles,
+        "handle_dist": options.handle_dist,
+        "duration_s": options.duration,
+        "published": len(publishes),
+        "set_rejected": set_rejected,
+        "expected": expected,
+        "delivered": delivered,
+        "superseded": superseded,
+        "delivery_ratio": "%.4f" % (float(delivered) / expected) if expected else "",
+        "coverage": "%.4f" % (float(delivered + superseded) / expected) if expected else "",
+        "latency_samples": len(latencies),
+        "latency_p50_ms": ms(percentile(latencies, 0.5)),
+        "latency_p90_ms": ms(percentile(latencies, 0.9)),
+        "latency_p99_ms": ms(percentile(latencies, 0.99)),
+        "latency_max_ms": ms(latencies[-1]) if latencies else "",
+    }
+    node_ratios = [("%.4f" % (float(node_delivered[d]) / node_expected[d])) if node_expected[d] else ""
+                   for d in range(load_run.device_count)]
+    return (result, node_ratios, latencies)
+
+
+def histogram_print(latencies, bucket_ms):
+    if len(latencies) == 0:
+        return
+    buckets = dict()
+    for latency in latencies:
+        bucket = int(latency * 1000.0 / bucket_ms)
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+    peak = max(buckets.values())
+    for bucket in range(max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        print("%6d-%-6d ms %7d %s" % (bucket * bucket_ms, (bucket + 1) * bucket_ms, count,
+                                      "#" * int(50.0 * count / peak)))
+
+
+def handle_range(value):
+    (first, _, last) = value.partition("-")
+    first = int(first, 0)
+    last = int(last, 0) if last else first
+    if first > last:
+        raise ValueError("invalid handle range")
+    return (first, last)
+
+
+def int_list(value):
+    return [int(v, 0) for v in value.split(",")]
+
+
+def main():
+    parser = ArgumentParser(description="Drives several nodes with a traffic model and measures propagation.")
+    parser.add_argument("-d", "--devices", required=True, help="Comma separated serial ports of the nodes")
+    parser.add_argument("-b", "--baudrate", default="115200", help="Baud rate")
+    parser.add_argument("--rtscts", action="store_true", help="Enable RTS/CTS flow control")
+    parser.add_argument("--publishers", type=int_list,
+                        help="Comma separated indexes of the devices that publish, all by default")
+    parser.add_argument("--model", choices=["poisson", "bursty"], default="poisson", help="Traffic model")
+    parser.add_argument("--rate", type=float, default=1.0, help="Average publishes per second per publisher")
+    parser.add_argument("--burst", type=int, default=5, help="Publishes per burst in the bursty model")
+    parser.add_argument("--burst-gap", type=float, default=10.0, help="Time between publishes in a burst, in ms")
+    parser.add_argument("--handles", type=handle_range, default=(1, 16), help="Handle range to publish on, e.g. 1-64")
+    parser.add_argument("--handle-dist", choices=["uniform", "zipf"], default="uniform",
+                        help="Distribution of the publishes over the handles")
+    parser.add_argument("--zipf-s", type=float, default=1.0, help="Exponent of the zipf distribution")
+    parser.add_argument("--payload", type=int_list, default=[VALUE_MAX_LEN],
+                        help="Comma separated payload lengths to pick from, %d-%d bytes" % (TAG_SIZE, VALUE_MAX_LEN))
+    parser.add_argument("--duration", type=float, default=30, help="Publishing time in seconds")
+    parser.add_argument("--drain", type=float, default=5, help="Time to wait for late updates after publishing")
+    parser.add_argument("--seed", type=int, help="Seed of the traffic model, for repeatable runs")
+    parser.add_argument("--bucket", type=int, default=10, help="Latency histogram bucket width in ms")
+    parser.add_argument("--events", help="CSV file to write every publish and update to")
+    parser.add_argument("-o", "--output", default="load_results.csv", help="CSV file to append the summary to")
+    options = parser.parse_args()
+
+    ports = options.devices.split(",")
+    publishers = options.publishers if options.publishers is not None else list(range(len(ports)))
+    for payload_len in options.payload:
+        if payload_len < TAG_SIZE or payload_len > VALUE_MAX_LEN:
+            parser.error("payload length must be in the range %d-%d" % (TAG_SIZE, VALUE_MAX_LEN))
+    if any(p < 0 or p >= len(ports) for p in publishers):
+        parser.error("publisher index out of range")
+    if options.rate <= 0 or options.burst < 1:
+        parser.error("the rate and burst size must be positive")
+
+    rng = random.Random(options.seed)
+    event_file = open(options.events, "w") if options.events else None
+    event_writer = None
+    if event_file is not None:
+        event_writer = csv.DictWriter(event_file, fieldnames=EVENT_FIELDS)
+        event_writer.writeheader()
+    load_run = LoadRun(len(ports), event_writer)
+
+    acidevs = []
+    try:
+        for (device, port) in enumerate(ports):
+            acidev = AciUart.AciUart(port=port, baudrate=options.baudrate, rtscts=options.rtscts)
+            acidev.AddPacketRecipient(lambda evt, device=device: load_run.packet_handler(device, evt))
+            acidevs.append(acidev)
+
+        stop_time = time.time() + options.duration
+        threads = []
+        for device in publishers:
+            model = TrafficModel(options, random.Random(rng.getrandbits(32)))
+            thread = threading.Thread(target=publisher, args=(acidevs[device], device, load_run, model, stop_time))
+            thread.daemon = True
+            thread.start()
+            threads.append(thread)
+        for thread in threads:
+            thread.join()
+        time.sleep(options.drain)
+    finally:
+        for acidev in acidevs:
+            acidev.stop()
+
+    (result, node_ratios, latencies) = run_summarize(load_run, options, publishers)
+    if event_file is not None:
+        with load_run.lock:
+            event_file.close()
+    with open(options.output, "a") as f:
+        writer = csv.DictWriter(f, fieldnames=CSV_FIELDS)
+        if f.tell() == 0:
+            writer.writeheader()
+        writer.writerow(result)
+
+    print(", ".join("%s=%s" % (k, result[k]) for k in CSV_FIELDS))
+    for (device, port) in enumerate(ports):
+        print("%s: delivery_ratio=%s" % (port, node_ratios[device]))
+    histogram_print(latencies, options.bucket)
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING)
+    main()
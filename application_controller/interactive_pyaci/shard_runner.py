@@ -0,0 +1,82 @@
+"""Host service that follows the mesh through several gateway nodes.
+
+Connect the gateways, nodes running a serial (ACI) build such as the BLE
+Gateway example, all initialized on the same access address, and run e.g.
+    python shard_runner.py -d /dev/ttyACM0,/dev/ttyACM1,/dev/ttyACM2,/dev/ttyACM3 --shards 2
+
+The handle space is split in --shards shards, one per gateway by default, and
+the gateways are given the shards in turn, so with more gateways than shards
+each shard is forwarded by several gateways. The value events of all gateways
+are merged by handle and version, and each new version is printed once, or
+written to a CSV file with --output. With --mirror, every gateway first sends
+the values of its shard that it has cached.
+"""
+from __future__ import print_function
+import csv
+import logging
+import sys
+import threading
+import time
+from argparse import ArgumentParser
+
+from aci import AciCommand, AciShard
+from aci_serial import AciUart
+
+CSV_FIELDS = ["time_s", "handle", "version", "data"]
+
+
+def main():
+    parser = ArgumentParser(description="Merges the value events of several gateways that each forward a handle shard.")
+    parser.add_argument("-d", "--devices", required=True, help="Comma separated serial ports of the gateways")
+    parser.add_argument("-b", "--baudrate", default="115200", help="Baud rate")
+    parser.add_argument("--rtscts", action="store_true", help="Enable RTS/CTS flow control")
+    parser.add_argument("--shards", type=int, help="Number of handle shards, one per gateway by default")
+    parser.add_argument("--mirror", action="store_true", help="Start with the values the gateways have cached")
+    parser.add_argument("--duration", type=float, help="Time to run in seconds, until interrupted by default")
+    parser.add_argument("-o", "--output", help="CSV file to write the merged values to, instead of printing them")
+    options = parser.parse_args()
+
+    ports = options.devices.split(",")
+    shards = options.shards if options.shards is not None else len(ports)
+    if shards < 1 or shards > min(len(ports), 255):
+        parser.error("every shard needs a gateway")
+
+    out_file = open(options.output, "w") if options.output else None
+    writer = csv.DictWriter(out_file if out_file else sys.stdout, fieldnames=CSV_FIELDS)
+    writer.writeheader()
+    write_lock = threading.Lock()
+    start = time.time()
+
+    def value_write(handle, version, data):
+        with write_lock:
+            writer.writerow({"time_s": "%.6f" % (time.time() - start), "handle": handle,
+                             "version": version, "data": bytearray(data).hex()})
+
+    merger = AciShard.ShardMerger(on_change=value_write)
+    acidevs = []
+    try:
+        for (device, port) in enumerate(ports):
+            acidev = AciUart.AciUart(port=port, baudrate=options.baudrate, rtscts=options.rtscts)
+            acidevs.append(acidev)
+            merger.attach(acidev)
+            acidev.write_aci_cmd(AciCommand.AciShardSet(count=shards, index=device % shards))
+            acidev.write_aci_cmd(AciCommand.AciEventFormatSet(AciCommand.AciEventFormatSet.VERSIONED))
+            if options.mirror:
+                acidev.write_aci_cmd(AciCommand.AciMirrorStart())
+
+        stop_time = time.time() + options.duration if options.duration else None
+        while stop_time is None or time.time() < stop_time:
+            time.sleep(0.1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for acidev in acidevs:
+            acidev.stop()
+        if out_file is not None:
+            out_file.close()
+    print(merger, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING)
+    main()
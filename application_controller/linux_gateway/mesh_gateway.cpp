@@ -0,0 +1,584 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mesh_gateway.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/* Value events share the layout of the update event. */
+#define VALUE_EVT_OVERHEAD      (3) /**< Opcode and handle. */
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool baudrate_to_speed(uint32_t baudrate, speed_t* p_speed)
+{
+    static const struct
+    {
+        uint32_t baudrate;
+        speed_t speed;
+    } speeds[] =
+    {
+        {115200,  B115200},
+        {230400,  B230400},
+        {460800,  B460800},
+        {921600,  B921600},
+        {1000000, B1000000},
+    };
+    for (uint32_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); ++i)
+    {
+        if (speeds[i].baudrate == baudrate)
+        {
+            *p_speed = speeds[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief Read a varint, returns the bytes used, or 0 if it runs past the end. */
+static uint32_t varint_get(const uint8_t* p_data, uint32_t len, uint32_t* p_value)
+{
+    *p_value = 0;
+    for (uint32_t i = 0; i < len && i < 5; ++i)
+    {
+        *p_value |= (uint32_t) (p_data[i] & 0x7F) << (7 * i);
+        if (!(p_data[i] & 0x80))
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/** @brief Command opcode a response opcode answers, or 0 for events that don't answer a command. */
+static uint8_t response_command_opcode(const serial_evt_t& evt)
+{
+    switch (evt.opcode)
+    {
+        case SERIAL_EVT_OPCODE_CMD_RSP:
+            return (evt.length >= 3) ? evt.params.cmd_rsp.command_opcode : 0;
+        case SERIAL_EVT_OPCODE_ECHO_RSP:
+            return SERIAL_CMD_OPCODE_ECHO;
+        case SERIAL_EVT_OPCODE_DEVICE_STARTED:
+            return SERIAL_CMD_OPCODE_RADIO_RESET;
+        default:
+            return 0;
+    }
+}
+
+mesh_gateway::mesh_gateway(uint32_t window, uint32_t timeout_ms) :
+    m_fd(-1),
+    m_epoll_fd(-1),
+    m_running(false),
+    m_tx_waiting(false),
+    m_window(window),
+    m_timeout_ms(timeout_ms),
+    m_tx_len(0),
+    m_tx_pos(0),
+    m_rx_len(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+mesh_gateway::~mesh_gateway()
+{
+    close();
+}
+
+bool mesh_gateway::open(const char* p_port, uint32_t baudrate, bool rtscts)
+{
+    speed_t speed;
+    if (!baudrate_to_speed(baudrate, &speed))
+    {
+        return false;
+    }
+
+    int fd = ::open(p_port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (rtscts)
+    {
+        tio.c_cflag |= CRTSCTS;
+    }
+    else
+    {
+        tio.c_cflag &= ~CRTSCTS;
+    }
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return open_fd(fd);
+}
+
+bool mesh_gateway::open_fd(int fd)
+{
+    close();
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        ::close(fd);
+        ::close(m_epoll_fd);
+        m_epoll_fd = -1;
+        return false;
+    }
+    m_fd = fd;
+    return true;
+}
+
+void mesh_gateway::close(void)
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_epoll_fd);
+        ::close(m_fd);
+        m_fd = -1;
+        m_epoll_fd = -1;
+    }
+    m_queued.clear();
+    m_in_flight.clear();
+    m_tx_len = 0;
+    m_tx_pos = 0;
+    m_rx_len = 0;
+    m_tx_waiting = false;
+}
+
+int mesh_gateway::poll_timeout_get(int timeout_ms) const
+{
+    if (m_in_flight.empty())
+    {
+        return timeout_ms;
+    }
+    uint64_t now = now_ms();
+    uint64_t deadline = m_in_flight.front().deadline_ms;
+    int until_deadline = (deadline > now) ? (int) (deadline - now) : 0;
+    return (timeout_ms < 0 || until_deadline < timeout_ms) ? until_deadline : timeout_ms;
+}
+
+int mesh_gateway::poll(int timeout_ms)
+{
+    if (m_fd < 0)
+    {
+        return -1;
+    }
+
+    struct epoll_event ev;
+    int count = epoll_wait(m_epoll_fd, &ev, 1, poll_timeout_get(timeout_ms));
+    if (count < 0 && errno != EINTR)
+    {
+        return -1;
+    }
+
+    uint64_t events_before = m_stats.events;
+    if (count > 0)
+    {
+        if (ev.events & (EPOLLERR | EPOLLHUP))
+        {
+            close();
+            return -1;
+        }
+        if (ev.events & EPOLLIN)
+        {
+            rx_handle();
+        }
+        if (m_fd >= 0 && (ev.events & EPOLLOUT))
+        {
+            tx_flush();
+        }
+    }
+    if (m_fd < 0)
+    {
+        return -1;
+    }
+    timeouts_check();
+    tx_fill();
+    return (int) (m_stats.events - events_before);
+}
+
+void mesh_gateway::run(void)
+{
+    m_running = true;
+    while (m_running && poll(-1) >= 0)
+    {
+    }
+    m_running = false;
+}
+
+bool mesh_gateway::command_send(const serial_cmd_t& cmd, rsp_cb_t cb)
+{
+    if (m_fd < 0 || cmd.length == 0)
+    {
+        return false;
+    }
+    m_queued.push_back(request_t());
+    request_t& req = m_queued.back();
+    memcpy(req.cmd, &cmd, cmd.length + 1);
+    req.cb = cb;
+    req.deadline_ms = 0;
+    m_stats.commands++;
+    tx_fill();
+    return true;
+}
+
+bool mesh_gateway::echo(const uint8_t* p_data, uint8_t len, rsp_cb_t cb)
+{
+    serial_cmd_t cmd;
+    if (len > sizeof(cmd.params.echo.data))
+    {
+        return false;
+    }
+    cmd.length = 1 + len;
+    cmd.opcode = SERIAL_CMD_OPCODE_ECHO;
+    memcpy(cmd.params.echo.data, p_data, len);
+    return command_send(cmd, cb);
+}
+
+bool mesh_gateway::value_set(uint16_t handle, const uint8_t* p_data, uint8_t len, rsp_cb_t cb)
+{
+    serial_cmd_t cmd;
+    if (len > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return false;
+    }
+    cmd.length = 3 + len;
+    cmd.opcode = SERIAL_CMD_OPCODE_VALUE_SET;
+    cmd.params.value_set.handle = handle;
+    memcpy(cmd.params.value_set.value, p_data, len);
+    return command_send(cmd, cb);
+}
+
+bool mesh_gateway::value_get(uint16_t handle, rsp_cb_t cb)
+{
+    serial_cmd_t cmd;
+    cmd.length = 1 + sizeof(cmd.params.value_get);
+    cmd.opcode = SERIAL_CMD_OPCODE_VALUE_GET;
+    cmd.params.value_get.handle = handle;
+    return command_send(cmd, cb);
+}
+
+bool mesh_gateway::event_mask_set(uint8_t mask, rsp_cb_t cb)
+{
+    serial_cmd_t cmd;
+    cmd.length = 1 + sizeof(cmd.params.event_mask_set);
+    cmd.opcode = SERIAL_CMD_OPCODE_EVENT_MASK_SET;
+    cmd.params.event_mask_set.mask = mask;
+    return command_send(cmd, cb);
+}
+
+bool mesh_gateway::event_format_set(aci_evt_format_t format, rsp_cb_t cb)
+{
+    serial_cmd_t cmd;
+    cmd.length = 1 + sizeof(cmd.params.event_format_set);
+    cmd.opcode = SERIAL_CMD_OPCODE_EVENT_FORMAT_SET;
+    cmd.params.event_format_set.format = format;
+    return command_send(cmd, cb);
+}
+
+void mesh_gateway::rx_handle(void)
+{
+    while (m_fd >= 0)
+    {
+        uint32_t space = sizeof(m_rx_buf) - m_rx_len;
+        ssize_t count = read(m_fd, &m_rx_buf[m_rx_len], space);
+        if (count <= 0)
+        {
+            if (count == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                close();
+            }
+            return;
+        }
+        m_stats.bytes_rx += count;
+        m_rx_len += count;
+
+        /* dispatch every complete frame in place, then move the tail of a
+           partial one to the front */
+        uint32_t pos = 0;
+        while (pos < m_rx_len && m_rx_len - pos >= (uint32_t) m_rx_buf[pos] + 1)
+        {
+            if (m_rx_buf[pos] == 0)
+            {
+                m_stats.invalid++;
+                pos++;
+                continue;
+            }
+            evt_dispatch(*(const serial_evt_t*) &m_rx_buf[pos]);
+            if (m_fd < 0)
+            {
+                return;
+            }
+            pos += m_rx_buf[pos] + 1;
+        }
+        if (pos > 0)
+        {
+            memmove(m_rx_buf, &m_rx_buf[pos], m_rx_len - pos);
+            m_rx_len -= pos;
+        }
+        if ((uint32_t) count < space)
+        {
+            /* the port had no more to give */
+            return;
+        }
+    }
+}
+
+void mesh_gateway::evt_dispatch(const serial_evt_t& evt)
+{
+    m_stats.events++;
+    switch (evt.opcode)
+    {
+        case SERIAL_EVT_OPCODE_EVENT_NEW:
+        case SERIAL_EVT_OPCODE_EVENT_UPDATE:
+        case SERIAL_EVT_OPCODE_EVENT_CONFLICTING:
+        case SERIAL_EVT_OPCODE_EVENT_TX:
+            if (evt.length >= VALUE_EVT_OVERHEAD)
+            {
+                m_stats.values++;
+                if (m_value_cb)
+                {
+                    m_value_cb(evt.opcode, evt.params.event_update.handle,
+                               evt.params.event_update.data, evt.length - VALUE_EVT_OVERHEAD);
+                }
+            }
+            break;
+
+        case SERIAL_EVT_OPCODE_EVENT_COMPACT:
+            compact_dispatch(evt);
+            break;
+
+        default:
+            break;
+    }
+
+    uint8_t command_opcode = response_command_opcode(evt);
+    if (command_opcode != 0)
+    {
+        response_dispatch(command_opcode, &evt);
+    }
+    if (m_evt_cb)
+    {
+        m_evt_cb(evt);
+    }
+}
+
+void mesh_gateway::compact_dispatch(const serial_evt_t& evt)
+{
+    static const uint8_t opcodes[] =
+    {
+        SERIAL_EVT_OPCODE_EVENT_NEW,
+        SERIAL_EVT_OPCODE_EVENT_UPDATE,
+        SERIAL_EVT_OPCODE_EVENT_CONFLICTING,
+        SERIAL_EVT_OPCODE_EVENT_TX,
+    };
+    const uint8_t* p_records = evt.params.event_compact.records;
+    uint32_t len = evt.length - 1;
+    uint32_t pos = 0;
+    uint32_t handle = 0;
+    while (pos < len)
+    {
+        uint8_t header = p_records[pos++];
+        uint8_t type = header >> SERIAL_EVT_COMPACT_TYPE_POS;
+        uint32_t data_len = header & SERIAL_EVT_COMPACT_LEN_MASK;
+        if (data_len == SERIAL_EVT_COMPACT_LEN_EXT)
+        {
+            if (pos >= len)
+            {
+                break;
+            }
+            data_len = p_records[pos++];
+        }
+        if (header & SERIAL_EVT_COMPACT_FLAG_NEXT_HANDLE)
+        {
+            handle = (handle + 1) & 0xFFFF;
+        }
+        else
+        {
+            uint32_t used = varint_get(&p_records[pos], len - pos, &handle);
+            if (used == 0)
+            {
+                break;
+            }
+            pos += used;
+        }
+        if (type != SERIAL_EVT_COMPACT_TYPE_TX)
+        {
+            uint32_t version_delta;
+            uint32_t used = varint_get(&p_records[pos], len - pos, &version_delta);
+            if (used == 0)
+            {
+                break;
+            }
+            pos += used;
+        }
+        if (data_len > len - pos)
+        {
+            break;
+        }
+        m_stats.values++;
+        if (m_value_cb)
+        {
+            m_value_cb(opcodes[type], (uint16_t) handle, &p_records[pos], data_len);
+        }
+        pos += data_len;
+    }
+    if (pos != len)
+    {
+        m_stats.invalid++;
+    }
+}
+
+void mesh_gateway::response_dispatch(uint8_t command_opcode, const serial_evt_t* p_evt)
+{
+    for (std::deque<request_t>::iterator it = m_in_flight.begin(); it != m_in_flight.end(); ++it)
+    {
+        if (it->cmd[1] == command_opcode)
+        {
+            rsp_cb_t cb = it->cb;
+            m_in_flight.erase(it);
+            m_stats.responses++;
+            if (cb)
+            {
+                cb(p_evt);
+            }
+            return;
+        }
+    }
+}
+
+void mesh_gateway::timeouts_check(void)
+{
+    uint64_t now = now_ms();
+    while (!m_in_flight.empty() && m_in_flight.front().deadline_ms <= now)
+    {
+        rsp_cb_t cb = m_in_flight.front().cb;
+        m_in_flight.pop_front();
+        m_stats.timeouts++;
+        if (cb)
+        {
+            cb(NULL);
+        }
+    }
+}
+
+void mesh_gateway::tx_fill(void)
+{
+    if (m_tx_pos > 0)
+    {
+        memmove(m_tx_buf, &m_tx_buf[m_tx_pos], m_tx_len - m_tx_pos);
+        m_tx_len -= m_tx_pos;
+        m_tx_pos = 0;
+    }
+    uint64_t deadline = now_ms() + m_timeout_ms;
+    while (!m_queued.empty() && m_in_flight.size() < m_window)
+    {
+        request_t& req = m_queued.front();
+        uint32_t len = req.cmd[0] + 1;
+        if (m_tx_len + len > sizeof(m_tx_buf))
+        {
+            break;
+        }
+        memcpy(&m_tx_buf[m_tx_len], req.cmd, len);
+        m_tx_len += len;
+        req.deadline_ms = deadline;
+        m_in_flight.push_back(req);
+        m_queued.pop_front();
+    }
+    tx_flush();
+}
+
+void mesh_gateway::tx_flush(void)
+{
+    while (m_fd >= 0 && m_tx_pos < m_tx_len)
+    {
+        ssize_t count = write(m_fd, &m_tx_buf[m_tx_pos], m_tx_len - m_tx_pos);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN)
+            {
+                close();
+                return;
+            }
+            break;
+        }
+        m_tx_pos += count;
+    }
+    if (m_tx_pos == m_tx_len)
+    {
+        m_tx_pos = 0;
+        m_tx_len = 0;
+    }
+
+    /* only wait for the port to drain while there's something to write */
+    bool waiting = (m_tx_len > 0);
+    if (m_fd >= 0 && waiting != m_tx_waiting)
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | (waiting ? (uint32_t) EPOLLOUT : 0);
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, m_fd, &ev);
+        m_tx_waiting = waiting;
+    }
+}
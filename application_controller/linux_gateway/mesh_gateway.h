@@ -0,0 +1,146 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MESH_GATEWAY_H__
+#define MESH_GATEWAY_H__
+
+/** @file
+ *  @brief Linux host for the mesh ACI on a UART.
+ *
+ *  The gateway runs on epoll, either in its own loop (run()), or in the
+ *  application's: add fd() to the application's epoll set, and call poll(0)
+ *  when it's readable. Events are parsed in place in the receive buffer, and
+ *  handed to the callbacks as references into it, which are valid until the
+ *  callback returns. Commands are pipelined: up to `window` commands are in
+ *  flight, and responses are matched to their commands by opcode, in the
+ *  order the commands were sent, as the device handles its commands in order.
+ *  The gateway isn't thread safe, all calls must come from the loop's thread.
+ */
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+
+#include "serial_handler.h"
+
+#ifndef MESH_GATEWAY_WINDOW
+/** @brief Commands in flight by default, the device queues 4. */
+#define MESH_GATEWAY_WINDOW     (4)
+#endif
+
+#define MESH_GATEWAY_RX_BUF_SIZE    (64 * 1024)
+
+class mesh_gateway
+{
+public:
+    /** Response callback. Gets NULL if the command timed out. */
+    typedef std::function<void(const serial_evt_t* p_rsp)> rsp_cb_t;
+    /** Event callback, for every event from the device, responses included. */
+    typedef std::function<void(const serial_evt_t& evt)> evt_cb_t;
+    /** Value callback, for the value events and the records of compact events alike. */
+    typedef std::function<void(uint8_t opcode, uint16_t handle, const uint8_t* p_data, uint8_t len)> value_cb_t;
+
+    typedef struct
+    {
+        uint64_t bytes_rx;
+        uint64_t events;
+        uint64_t values;        /**< Value events and compact event records. */
+        uint64_t commands;
+        uint64_t responses;
+        uint64_t timeouts;
+        uint64_t invalid;       /**< Zero length frames and bad compact records. */
+    } stats_t;
+
+    explicit mesh_gateway(uint32_t window = MESH_GATEWAY_WINDOW, uint32_t timeout_ms = 1000);
+    ~mesh_gateway();
+
+    /** @brief Open a serial port, raw 8N1 at one of the device's baudrates. */
+    bool open(const char* p_port, uint32_t baudrate = 115200, bool rtscts = false);
+    /** @brief Use an open file descriptor, e.g. a socket for testing. Takes ownership. */
+    bool open_fd(int fd);
+    void close(void);
+
+    /** @brief Epoll descriptor to watch from an external loop, readable when poll() has work. */
+    int fd(void) const { return m_epoll_fd; }
+
+    /**
+    * @brief Wait up to timeout_ms for I/O, then handle it: dispatch the events
+    *   received, send queued commands and expire the late ones.
+    *
+    * @return The number of events dispatched, or -1 if the port failed.
+    */
+    int poll(int timeout_ms);
+    /** @brief Run poll() until stop() is called from a callback, or the port fails. */
+    void run(void);
+    void stop(void) { m_running = false; }
+
+    void evt_cb_set(evt_cb_t cb) { m_evt_cb = cb; }
+    void value_cb_set(value_cb_t cb) { m_value_cb = cb; }
+
+    /** @brief Queue a command. Its length field must be set. */
+    bool command_send(const serial_cmd_t& cmd, rsp_cb_t cb = rsp_cb_t());
+
+    bool echo(const uint8_t* p_data, uint8_t len, rsp_cb_t cb = rsp_cb_t());
+    bool value_set(uint16_t handle, const uint8_t* p_data, uint8_t len, rsp_cb_t cb = rsp_cb_t());
+    bool value_get(uint16_t handle, rsp_cb_t cb = rsp_cb_t());
+    bool event_mask_set(uint8_t mask, rsp_cb_t cb = rsp_cb_t());
+    bool event_format_set(aci_evt_format_t format, rsp_cb_t cb = rsp_cb_t());
+
+    /** @brief Commands sent or queued that haven't been answered. */
+    uint32_t pending(void) const { return m_in_flight.size() + m_queued.size(); }
+    const stats_t& stats(void) const { return m_stats; }
+
+private:
+    typedef struct
+    {
+        uint8_t cmd[256];
+        rsp_cb_t cb;
+        uint64_t deadline_ms;
+    } request_t;
+
+    void rx_handle(void);
+    void evt_dispatch(const serial_evt_t& evt);
+    void compact_dispatch(const serial_evt_t& evt);
+    void response_dispatch(uint8_t command_opcode, const serial_evt_t* p_evt);
+    void tx_fill(void);
+    void tx_flush(void);
+    void timeouts_check(void);
+    int poll_timeout_get(int timeout_ms) const;
+
+    int m_fd;
+    int m_epoll_fd;
+    bool m_running;
+    bool m_tx_waiting;          /**< Waiting for the port to take more bytes. */
+    uint32_t m_window;
+    uint32_t m_timeout_ms;
+    evt_cb_t m_evt_cb;
+    value_cb_t m_value_cb;
+    std::deque<request_t> m_queued;
+    std::deque<request_t> m_in_flight;
+    uint8_t m_tx_buf[MESH_GATEWAY_WINDOW * 256];
+    uint32_t m_tx_len;
+    uint32_t m_tx_pos;
+    uint8_t m_rx_buf[MESH_GATEWAY_RX_BUF_SIZE];
+    uint32_t m_rx_len;
+    stats_t m_stats;
+};
+
+#endif /* MESH_GATEWAY_H__ */
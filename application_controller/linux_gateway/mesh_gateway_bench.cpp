@@ -0,0 +1,285 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ *  @brief Throughput benchmark for the gateway.
+ *
+ *  With --port, keeps the device busy with pipelined value sets for the
+ *  duration, and reports the command and event rates. Without it, a thread
+ *  plays the device on a socket pair: it answers every command, and streams
+ *  update events as fast as the gateway takes them, which measures the host
+ *  side alone.
+ */
+
+#include "mesh_gateway.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+typedef struct
+{
+    int fd;
+    bool compact;
+    volatile bool done;
+} loopback_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t update_evt_put(uint8_t* p_buf, uint16_t handle, bool compact)
+{
+    if (compact)
+    {
+        /* three 4 byte records for consecutive handles */
+        uint8_t* p = p_buf;
+        *(p++) = 0;
+        *(p++) = SERIAL_EVT_OPCODE_EVENT_COMPACT;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            *(p++) = (SERIAL_EVT_COMPACT_TYPE_UPDATE << SERIAL_EVT_COMPACT_TYPE_POS) |
+                     ((i > 0) ? SERIAL_EVT_COMPACT_FLAG_NEXT_HANDLE : 0) | 4;
+            if (i == 0)
+            {
+                *(p++) = 0x80 | (handle & 0x7F);
+                *(p++) = (handle >> 7) & 0x7F;
+            }
+            *(p++) = 1;
+            memset(p, 0x55, 4);
+            p += 4;
+        }
+        p_buf[0] = (uint8_t) (p - p_buf - 1);
+        return p - p_buf;
+    }
+    serial_evt_t* p_evt = (serial_evt_t*) p_buf;
+    p_evt->length = 3 + 4;
+    p_evt->opcode = SERIAL_EVT_OPCODE_EVENT_UPDATE;
+    p_evt->params.event_update.handle = handle;
+    memset(p_evt->params.event_update.data, 0x55, 4);
+    return p_evt->length + 1;
+}
+
+/** Device stand-in: answers commands, and fills the rest of the link with events. */
+static void* loopback_device(void* p_context)
+{
+    loopback_t* p_loopback = (loopback_t*) p_context;
+    uint8_t rx[4096];
+    uint32_t rx_len = 0;
+    uint8_t tx[4096];
+    uint16_t handle = 0;
+
+    while (!p_loopback->done)
+    {
+        uint32_t tx_len = 0;
+        ssize_t count = recv(p_loopback->fd, &rx[rx_len], sizeof(rx) - rx_len, MSG_DONTWAIT);
+        if (count > 0)
+        {
+            rx_len += count;
+        }
+        uint32_t pos = 0;
+        while (pos < rx_len && rx_len - pos >= (uint32_t) rx[pos] + 1)
+        {
+            const serial_cmd_t* p_cmd = (const serial_cmd_t*) &rx[pos];
+            serial_evt_t* p_rsp = (serial_evt_t*) &tx[tx_len];
+            if (p_cmd->opcode == SERIAL_CMD_OPCODE_ECHO)
+            {
+                memcpy(p_rsp, p_cmd, p_cmd->length + 1);
+                p_rsp->opcode = SERIAL_EVT_OPCODE_ECHO_RSP;
+            }
+            else
+            {
+                p_rsp->length = 3;
+                p_rsp->opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+                p_rsp->params.cmd_rsp.command_opcode = p_cmd->opcode;
+                p_rsp->params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+            }
+            tx_len += p_rsp->length + 1;
+            pos += rx[pos] + 1;
+        }
+        memmove(rx, &rx[pos], rx_len - pos);
+        rx_len -= pos;
+
+        while (tx_len + 64 < sizeof(tx))
+        {
+            tx_len += update_evt_put(&tx[tx_len], handle, p_loopback->compact);
+            handle = (handle + 3) & 0x7FFF;
+        }
+        for (uint32_t sent = 0; sent < tx_len && !p_loopback->done; )
+        {
+            count = send(p_loopback->fd, &tx[sent], tx_len - sent, 0);
+            if (count <= 0)
+            {
+                return NULL;
+            }
+            sent += count;
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char* p_name)
+{
+    printf("Usage: %s [--port <tty> [--baudrate <baud>] [--rtscts]] [--compact] [--duration <s>] [--window <n>]\n", p_name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* p_port = NULL;
+    uint32_t baudrate = 115200;
+    bool rtscts = false;
+    bool compact = false;
+    double duration = 5.0;
+    uint32_t window = MESH_GATEWAY_WINDOW;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--port") && i + 1 < argc)
+        {
+            p_port = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--baudrate") && i + 1 < argc)
+        {
+            baudrate = strtoul(argv[++i], NULL, 0);
+        }
+        else if (!strcmp(argv[i], "--rtscts"))
+        {
+            rtscts = true;
+        }
+        else if (!strcmp(argv[i], "--compact"))
+        {
+            compact = true;
+        }
+        else if (!strcmp(argv[i], "--duration") && i + 1 < argc)
+        {
+            duration = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+        {
+            window = strtoul(argv[++i], NULL, 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    mesh_gateway gateway(window);
+    loopback_t loopback;
+    pthread_t device_thread;
+    memset(&loopback, 0, sizeof(loopback));
+
+    if (p_port)
+    {
+        if (!gateway.open(p_port, baudrate, rtscts))
+        {
+            printf("Couldn't open %s at %u baud\n", p_port, baudrate);
+            return 1;
+        }
+        if (compact)
+        {
+            gateway.event_format_set(ACI_EVT_FORMAT_COMPACT, [](const serial_evt_t* p_rsp) {
+                if (p_rsp == NULL || p_rsp->params.cmd_rsp.status != ACI_STATUS_SUCCESS)
+                {
+                    printf("The device has no compact events, using the full format\n");
+                }
+            });
+        }
+    }
+    else
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0 || !gateway.open_fd(sv[0]))
+        {
+            printf("Couldn't set up the loopback\n");
+            return 1;
+        }
+        loopback.fd = sv[1];
+        loopback.compact = compact;
+        pthread_create(&device_thread, NULL, loopback_device, &loopback);
+    }
+
+    uint64_t rsp_count = 0;
+    uint64_t rsp_errors = 0;
+    uint64_t value_bytes = 0;
+    gateway.value_cb_set([&](uint8_t opcode, uint16_t handle, const uint8_t* p_data, uint8_t len) {
+        value_bytes += len;
+    });
+    mesh_gateway::rsp_cb_t rsp_cb = [&](const serial_evt_t* p_rsp) {
+        if (p_rsp && p_rsp->params.cmd_rsp.status == ACI_STATUS_SUCCESS)
+        {
+            rsp_count++;
+        }
+        else
+        {
+            rsp_errors++;
+        }
+    };
+
+    uint8_t value[4] = {0};
+    uint16_t handle = 1;
+    double start = now_s();
+    double end = start + duration;
+    while (now_s() < end)
+    {
+        /* keep the pipeline full */
+        while (gateway.pending() < window)
+        {
+            value[0]++;
+            gateway.value_set(handle, value, sizeof(value), rsp_cb);
+            handle = (handle % 100) + 1;
+        }
+        if (gateway.poll(10) < 0)
+        {
+            printf("The port failed\n");
+            break;
+        }
+    }
+    double elapsed = now_s() - start;
+
+    const mesh_gateway::stats_t& stats = gateway.stats();
+    printf("%.1f s: %.0f commands/s (%llu failed), %.0f events/s, %.0f values/s, %.2f MB/s of values, %.2f MB/s received, %llu invalid\n",
+           elapsed,
+           rsp_count / elapsed,
+           (unsigned long long) rsp_errors,
+           stats.events / elapsed,
+           stats.values / elapsed,
+           value_bytes / elapsed / 1e6,
+           stats.bytes_rx / elapsed / 1e6,
+           (unsigned long long) stats.invalid);
+
+    if (!p_port)
+    {
+        loopback.done = true;
+        gateway.close();
+        pthread_join(device_thread, NULL);
+        close(loopback.fd);
+    }
+    return 0;
+}
@@ -26,14 +26,38 @@
   *  @brief parsing a subset of the mesh_rbc commands into spi messages 
   *  and enqueues them to be sent.
   */
+#ifdef RBC_MESH_SPI_NONBLOCKING
+#include "rbc_mesh_spi.h"
+#else
 #include "hal_aci_tl.h"
 #include "lib_aci.h"
+#include "boards.h"
+#endif
 #include "serial_evt.h"
 #include "serial_command.h"
 
-#include "boards.h"
-
 #include "rbc_mesh_interface.h"
+#include <string.h>
+
+#ifdef RBC_MESH_SPI_NONBLOCKING
+typedef struct
+{
+    uint8_t status_byte;
+    uint8_t buffer[HAL_ACI_MAX_LENGTH + 1];
+} aci_msg_t;
+
+static bool msg_send(aci_msg_t* p_msg)
+{
+    return rbc_mesh_spi_cmd_send(p_msg->buffer);
+}
+#else
+typedef hal_aci_data_t aci_msg_t;
+
+static bool msg_send(aci_msg_t* p_msg)
+{
+    return hal_aci_tl_send(p_msg);
+}
+#endif
 
 static void unaligned_memcpy(uint8_t* p_dst, uint8_t const* p_src, uint8_t len){
   while(len--)
@@ -46,14 +70,14 @@ bool rbc_mesh_echo(uint8_t* buffer, int len){
 	if (len > HAL_ACI_MAX_LENGTH - 1 || len < 0)
 		return false;
     
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = len + 1; // account for opcode
     p_cmd->opcode = SERIAL_CMD_OPCODE_ECHO;
     memcpy(p_cmd->params.echo.data, buffer, len);
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_init(
@@ -61,7 +85,7 @@ bool rbc_mesh_init(
 	uint8_t chanNr,
         uint32_t int_min_ms){
 	
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 10;
@@ -70,29 +94,29 @@ bool rbc_mesh_init(
     p_cmd->params.init.channel = chanNr;
     p_cmd->params.init.int_min = int_min_ms;
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_start(void)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_START;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_stop(void)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_STOP;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_value_set(uint16_t handle, uint8_t* buffer, int len){
@@ -100,7 +124,7 @@ bool rbc_mesh_value_set(uint16_t handle, uint8_t* buffer, int len){
 	if (len > HAL_ACI_MAX_LENGTH - 1 || len < 1)
 		return false;
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = len + 2; // account for opcode and handle 
@@ -108,95 +132,106 @@ bool rbc_mesh_value_set(uint16_t handle, uint8_t* buffer, int len){
     p_cmd->params.value_set.handle = handle;
     memcpy(p_cmd->params.value_set.value, buffer, len);
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 
 bool rbc_mesh_value_enable(uint16_t handle){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 2;
     p_cmd->opcode = SERIAL_CMD_OPCODE_VALUE_ENABLE;
     p_cmd->params.value_enable.handle = handle;
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_value_disable(uint16_t handle){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 2;
     p_cmd->opcode = SERIAL_CMD_OPCODE_VALUE_DISABLE;
     p_cmd->params.value_enable.handle = handle;
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_value_get(uint16_t handle){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 2;
     p_cmd->opcode = SERIAL_CMD_OPCODE_VALUE_GET;
     p_cmd->params.value_enable.handle = handle;
 
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 
 bool rbc_mesh_build_version_get(){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_BUILD_VERSION_GET;
 	
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 
 bool rbc_mesh_access_addr_get(){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_ACCESS_ADDR_GET;
 	
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_channel_get(){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_CHANNEL_GET;
 	
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_interval_min_get(){
 
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
 
     p_cmd->length = 1;
     p_cmd->opcode = SERIAL_CMD_OPCODE_INTERVAL_GET;
 	
-	return hal_aci_tl_send(&msg_for_mesh);
+	return msg_send(&msg_for_mesh);
+}
+
+bool rbc_mesh_stats_get(uint8_t offset)
+{
+    aci_msg_t msg_for_mesh;
+    serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
+    p_cmd->length = 2;
+    p_cmd->opcode = SERIAL_CMD_OPCODE_STATS_GET;
+    p_cmd->params.stats_get.offset = offset;
+
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_tx_event_flag_set(uint16_t handle, bool value)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
     p_cmd->length = 5;
     p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_SET;
@@ -204,12 +239,12 @@ bool rbc_mesh_tx_event_flag_set(uint16_t handle, bool value)
     p_cmd->params.flag_set.flag = ACI_FLAG_TX_EVENT;
     p_cmd->params.flag_set.value = value;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_persistent_flag_set(uint16_t handle, bool value)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
     p_cmd->length = 5;
     p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_SET;
@@ -217,38 +252,95 @@ bool rbc_mesh_persistent_flag_set(uint16_t handle, bool value)
     p_cmd->params.flag_set.flag = ACI_FLAG_PERSISTENT;
     p_cmd->params.flag_set.value = value;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_tx_event_flag_get(uint16_t handle)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
     p_cmd->length = 4;
     p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_GET;
     p_cmd->params.flag_get.handle = handle;
     p_cmd->params.flag_get.flag = ACI_FLAG_TX_EVENT;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
 }
 
 bool rbc_mesh_persistent_flag_get(uint16_t handle)
 {
-    hal_aci_data_t msg_for_mesh;
+    aci_msg_t msg_for_mesh;
     serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
     p_cmd->length = 4;
     p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_GET;
     p_cmd->params.flag_get.handle = handle;
     p_cmd->params.flag_get.flag = ACI_FLAG_PERSISTENT;
 
-    return hal_aci_tl_send(&msg_for_mesh);
+    return msg_send(&msg_for_mesh);
+}
+
+bool rbc_mesh_trickle_class_set(uint16_t handle, uint8_t trickle_class)
+{
+    aci_msg_t msg_for_mesh;
+    serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
+    p_cmd->length = 5;
+    p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_SET;
+    p_cmd->params.flag_set.handle = handle;
+    p_cmd->params.flag_set.flag = ACI_FLAG_TRICKLE_CLASS;
+    p_cmd->params.flag_set.value = trickle_class;
+
+    return msg_send(&msg_for_mesh);
 }
 
+bool rbc_mesh_trickle_class_get(uint16_t handle)
+{
+    aci_msg_t msg_for_mesh;
+    serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
+    p_cmd->length = 4;
+    p_cmd->opcode = SERIAL_CMD_OPCODE_FLAG_GET;
+    p_cmd->params.flag_get.handle = handle;
+    p_cmd->params.flag_get.flag = ACI_FLAG_TRICKLE_CLASS;
+
+    return msg_send(&msg_for_mesh);
+}
+
+#ifdef RBC_MESH_SPI_NONBLOCKING
+bool rbc_mesh_evt_get(serial_evt_t* p_evt){
+    return (rbc_mesh_spi_evt_get((uint8_t*) p_evt, sizeof(serial_evt_t)) > 0);
+}
+
+void rbc_mesh_hw_init(rbc_mesh_spi_pins_t* pins){
+
+    rbc_mesh_spi_init(pins);
+}
+
+void rbc_mesh_poll(void)
+{
+    rbc_mesh_spi_poll();
+}
+
+void rbc_mesh_radio_reset()
+{
+    aci_msg_t msg_for_mesh;
+    serial_cmd_t* p_cmd = (serial_cmd_t*) msg_for_mesh.buffer;
+
+    p_cmd->length = 1;
+    p_cmd->opcode = SERIAL_CMD_OPCODE_RADIO_RESET;
+
+    (void) msg_send(&msg_for_mesh);
+}
+#else
 bool rbc_mesh_evt_get(serial_evt_t* p_evt){
     hal_aci_data_t msg;
     bool status = hal_aci_tl_event_get(&msg);
     if (status)
-        memcpy((uint8_t*) p_evt, msg.buffer, sizeof(serial_evt_t));
+    {
+        /* only copy the event itself, not the entire buffer */
+        uint8_t len = msg.buffer[0] + 1;
+        if (len > sizeof(serial_evt_t))
+            len = sizeof(serial_evt_t);
+        memcpy((uint8_t*) p_evt, msg.buffer, len);
+    }
 
     return status;
 }
@@ -262,4 +354,5 @@ void rbc_mesh_radio_reset()
 {
     lib_aci_radio_reset();
 }
+#endif
 
@@ -23,6 +23,11 @@
 #define MESH_INTERFACE_H__
 
 #include "serial_evt.h"
+#ifdef RBC_MESH_SPI_NONBLOCKING
+#include "rbc_mesh_spi.h"
+#else
+#include "lib_aci.h"
+#endif
 
 /** @brief executes an echo-test
  *  @details
@@ -137,6 +142,15 @@ bool rbc_mesh_channel_get();
  */
 bool rbc_mesh_interval_min_get();
 
+/** @brief read a chunk of the slave's runtime statistics
+ *  @details
+ *  promts the slave to return up to RBC_MESH_VALUE_MAX_LEN bytes of its
+ *  rbc_mesh_stats_t structure, starting at the given byte offset
+ *  @return True if the data was successfully queued for sending,
+ *  false if there is no more space to store messages to send.
+ */
+bool rbc_mesh_stats_get(uint8_t offset);
+
 /** @brief read the advertising intervall
  *  @details
  *  promts the slave to return the advertising intervall
@@ -173,6 +187,22 @@ bool rbc_mesh_tx_event_flag_get(uint16_t handle);
  */
 bool rbc_mesh_persistent_flag_get(uint16_t handle);
 
+/** @brief set the Trickle parameter class of a handle
+ *  @details
+ *  lower classes get to transmit first when the radio queue is busy
+ *  @return True if the data was successfully queued for sending,
+ *  false if there is no more space to store messages to send.
+ */
+bool rbc_mesh_trickle_class_set(uint16_t handle, uint8_t trickle_class);
+
+/** @brief read the Trickle parameter class of a handle
+ *  @details
+ *  promts the slave to return the handle's Trickle parameter class
+ *  @return True if the data was successfully queued for sending,
+ *  false if there is no more space to store messages to send.
+ */
+bool rbc_mesh_trickle_class_get(uint16_t handle);
+
 /** @brief checkes if new events arrived
  *  @details
  *  checks for new events and takes them off the queue
@@ -181,12 +211,28 @@ bool rbc_mesh_persistent_flag_get(uint16_t handle);
  */
 bool rbc_mesh_evt_get(serial_evt_t* p_evt);
 
+#ifdef RBC_MESH_SPI_NONBLOCKING
+/** @brief initialisation of local hardware
+ *  @details
+ *  Sets the SPI-pins, and attaches the RDYN interrupt if there is one
+ *  @param pins struct containing pin configuration
+ */
+void rbc_mesh_hw_init(rbc_mesh_spi_pins_t* pins);
+
+/** @brief runs the SPI transport
+ *  @details
+ *  needs to be called in the main loop. Does the SPI transactions if the
+ *  RDYN pin has no interrupt, and retries requests the slave missed
+ */
+void rbc_mesh_poll(void);
+#else
 /** @brief initialisation of local hardware
  *  @details
  *  Sets the SPI-pins
  *  @param pins struct containing pin configuration
  */
 void rbc_mesh_hw_init(aci_pins_t* pins);
+#endif
 
 /** @brief Transmit a reset command to the slave
  *  @details 
@@ -0,0 +1,315 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+ /** @file
+  *  @brief Interrupt driven ACI SPI transport.
+  *
+  *  The master pulls REQN (the slave's chip select) low to request a
+  *  transaction, and the slave pulls RDYN low when it's ready, or when it has
+  *  events for the master. Each transaction carries all queued commands that
+  *  fit on MOSI, and drains events from MISO until the slave sends a 0
+  *  length byte. The slave only drops the events that were clocked out
+  *  completely, so a transaction cut short by a full event ring just delays
+  *  the rest.
+  */
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "rbc_mesh_spi.h"
+
+#define CMD_RING_MASK   (RBC_MESH_SPI_CMD_RING_SIZE - 1)
+#define EVT_RING_MASK   (RBC_MESH_SPI_EVT_RING_SIZE - 1)
+
+/** Longest frame the slave sends, with its length byte. */
+#define EVT_FRAME_MAX   (40)
+
+#if (RBC_MESH_SPI_CMD_RING_SIZE & CMD_RING_MASK) || RBC_MESH_SPI_CMD_RING_SIZE > 128
+#error "RBC_MESH_SPI_CMD_RING_SIZE must be a power of two, no larger than 128"
+#endif
+#if (RBC_MESH_SPI_EVT_RING_SIZE & EVT_RING_MASK) || RBC_MESH_SPI_EVT_RING_SIZE > 128 || RBC_MESH_SPI_EVT_RING_SIZE < 64
+#error "RBC_MESH_SPI_EVT_RING_SIZE must be a power of two, from 64 to 128"
+#endif
+
+/* Ring indexes run freely and wrap at 256, the fill level is head - tail.
+ * Each index only has one writer: the main context produces commands and
+ * consumes events, the interrupt does the opposite. */
+static uint8_t m_cmd_ring[RBC_MESH_SPI_CMD_RING_SIZE];
+static volatile uint8_t m_cmd_head;
+static volatile uint8_t m_cmd_tail;
+static uint8_t m_evt_ring[RBC_MESH_SPI_EVT_RING_SIZE];
+static volatile uint8_t m_evt_head;
+static volatile uint8_t m_evt_tail;
+
+static rbc_mesh_spi_pins_t m_pins;
+static SPISettings m_spi_settings;
+static volatile bool m_busy;
+static volatile bool m_requesting;
+static volatile bool m_rdyn_deferred; /**< RDYN came while the event ring was full. */
+static uint32_t m_request_time;
+static volatile uint32_t m_evt_stalls;
+
+static uint8_t evt_free_get(void)
+{
+    return RBC_MESH_SPI_EVT_RING_SIZE - (uint8_t) (m_evt_head - m_evt_tail);
+}
+
+static void evt_push(const uint8_t* p_frame, uint8_t len)
+{
+    uint8_t head = m_evt_head;
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        m_evt_ring[(uint8_t) (head + i) & EVT_RING_MASK] = p_frame[i];
+    }
+    m_evt_head = head + len; /* publish */
+}
+
+/** Length of the commands to send in the next transaction. Every event byte
+ * received while clocking out commands must fit in the event ring, so the
+ * commands are bounded by the free space in the ring. */
+static uint8_t cmd_xfer_len_get(void)
+{
+    uint8_t max_len = evt_free_get();
+    if (max_len > RBC_MESH_SPI_XFER_MAX)
+    {
+        max_len = RBC_MESH_SPI_XFER_MAX;
+    }
+
+    uint8_t len = 0;
+    uint8_t tail = m_cmd_tail;
+    while ((uint8_t) (m_cmd_head - tail) > len)
+    {
+        uint8_t frame_len = m_cmd_ring[(uint8_t) (tail + len) & CMD_RING_MASK] + 1;
+        if (len + frame_len > max_len)
+        {
+            break;
+        }
+        len += frame_len;
+    }
+    return len;
+}
+
+static void request(void)
+{
+    m_requesting = true;
+    m_request_time = millis();
+    digitalWrite(m_pins.reqn_pin, LOW);
+}
+
+/** Run a transaction. RDYN must be low. */
+static void xfer(void)
+{
+    uint8_t cmd_len = cmd_xfer_len_get();
+    uint8_t cmd_tail = m_cmd_tail;
+    uint8_t frame[EVT_FRAME_MAX];
+    uint8_t frame_len = 0;
+    uint8_t frame_pos = 0;
+    bool evt_more = true;
+    bool stalled = false;
+
+    digitalWrite(m_pins.reqn_pin, LOW);
+    SPI.beginTransaction(m_spi_settings);
+    for (uint16_t pos = 0; pos < RBC_MESH_SPI_XFER_MAX && (pos < cmd_len || evt_more); ++pos)
+    {
+        uint8_t out = (pos < cmd_len ? m_cmd_ring[(uint8_t) (cmd_tail + pos) & CMD_RING_MASK] : 0);
+        uint8_t in = SPI.transfer(out);
+
+        if (pos == 0 || !evt_more)
+        {
+            /* status byte, or the rest of the commands */
+            continue;
+        }
+        if (frame_len == 0)
+        {
+            if (in == 0)
+            {
+                evt_more = false;
+            }
+            else if (in + 1 > EVT_FRAME_MAX || in + 1 > evt_free_get())
+            {
+                /* stop before the event is complete, the slave resends it */
+                evt_more = false;
+                stalled = true;
+                m_evt_stalls++;
+            }
+            else
+            {
+                frame[0] = in;
+                frame_len = in + 1;
+                frame_pos = 1;
+            }
+        }
+        else
+        {
+            frame[frame_pos++] = in;
+            if (frame_pos == frame_len)
+            {
+                evt_push(frame, frame_len);
+                frame_len = 0;
+            }
+        }
+    }
+    SPI.endTransaction();
+    digitalWrite(m_pins.reqn_pin, HIGH);
+
+    m_cmd_tail = cmd_tail + cmd_len;
+    m_requesting = false;
+    /* the slave holds the event back and raises RDYN again, this is picked
+       up once events are consumed */
+    m_rdyn_deferred = stalled;
+}
+
+/** Run a transaction from the main context, if the slave is ready. */
+static void xfer_try(void)
+{
+    noInterrupts();
+    if (m_busy || digitalRead(m_pins.rdyn_pin) != LOW)
+    {
+        interrupts();
+        return;
+    }
+    m_busy = true;
+    interrupts();
+
+    xfer();
+
+    m_busy = false;
+    if (m_cmd_head != m_cmd_tail)
+    {
+        request();
+    }
+}
+
+static void rdyn_isr(void)
+{
+    if (m_busy)
+    {
+        return;
+    }
+    if (evt_free_get() < EVT_FRAME_MAX)
+    {
+        /* no room, let the slave wait until events are consumed, instead of
+           stalling again and again */
+        m_rdyn_deferred = true;
+        return;
+    }
+    m_busy = true;
+    xfer();
+    m_busy = false;
+    if (m_cmd_head != m_cmd_tail)
+    {
+        request();
+    }
+}
+
+void rbc_mesh_spi_init(const rbc_mesh_spi_pins_t* p_pins)
+{
+    m_pins = *p_pins;
+    m_cmd_head = m_cmd_tail = 0;
+    m_evt_head = m_evt_tail = 0;
+    m_busy = false;
+    m_requesting = false;
+    m_rdyn_deferred = false;
+    m_evt_stalls = 0;
+
+    pinMode(m_pins.reqn_pin, OUTPUT);
+    digitalWrite(m_pins.reqn_pin, HIGH);
+    pinMode(m_pins.rdyn_pin, INPUT_PULLUP);
+
+    m_spi_settings = SPISettings(m_pins.spi_clock_hz, LSBFIRST, SPI_MODE0);
+    SPI.begin();
+
+    if (m_pins.interrupt_number >= 0)
+    {
+        SPI.usingInterrupt(m_pins.interrupt_number);
+        attachInterrupt(m_pins.interrupt_number, rdyn_isr, FALLING);
+    }
+}
+
+bool rbc_mesh_spi_cmd_send(const uint8_t* p_cmd)
+{
+    uint8_t len = p_cmd[0] + 1;
+    uint8_t head = m_cmd_head;
+    if (len > RBC_MESH_SPI_XFER_MAX ||
+        (uint8_t) (head - m_cmd_tail) + len > RBC_MESH_SPI_CMD_RING_SIZE)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        m_cmd_ring[(uint8_t) (head + i) & CMD_RING_MASK] = p_cmd[i];
+    }
+    m_cmd_head = head + len; /* publish */
+
+    noInterrupts();
+    bool idle = !m_busy && !m_requesting;
+    interrupts();
+    if (idle)
+    {
+        request();
+    }
+    return true;
+}
+
+uint8_t rbc_mesh_spi_evt_get(uint8_t* p_evt, uint8_t max_len)
+{
+    uint8_t tail = m_evt_tail;
+    if (m_evt_head == tail)
+    {
+        return 0;
+    }
+
+    uint8_t len = m_evt_ring[tail & EVT_RING_MASK] + 1;
+    for (uint8_t i = 0; i < len && i < max_len; ++i)
+    {
+        p_evt[i] = m_evt_ring[(uint8_t) (tail + i) & EVT_RING_MASK];
+    }
+    m_evt_tail = tail + len; /* release */
+
+    if (m_rdyn_deferred && evt_free_get() >= EVT_FRAME_MAX)
+    {
+        m_rdyn_deferred = false;
+        xfer_try();
+    }
+    return (len < max_len ? len : max_len);
+}
+
+uint32_t rbc_mesh_spi_evt_stalls_get(void)
+{
+    return m_evt_stalls;
+}
+
+void rbc_mesh_spi_poll(void)
+{
+    if ((m_pins.interrupt_number < 0 || m_rdyn_deferred) &&
+        evt_free_get() >= EVT_FRAME_MAX)
+    {
+        m_rdyn_deferred = false;
+        xfer_try();
+    }
+
+    if (m_requesting && !m_busy &&
+        (uint32_t) (millis() - m_request_time) > RBC_MESH_SPI_REQ_TIMEOUT_MS)
+    {
+        /* the slave missed the falling edge, give it a new one */
+        digitalWrite(m_pins.reqn_pin, HIGH);
+        request();
+    }
+}
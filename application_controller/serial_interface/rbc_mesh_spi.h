@@ -0,0 +1,90 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _RBC_MESH_SPI_H__
+#define _RBC_MESH_SPI_H__
+
+ /** @file
+  *  @brief Interrupt driven ACI SPI transport, an alternative to the nRF8001
+  *  hal_aci_tl that doesn't need lib_aci. Commands and events are stored back
+  *  to back in byte rings, so a queued value set only takes its own length.
+  */
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Size of the command ring in bytes. Power of two, max 128. */
+#ifndef RBC_MESH_SPI_CMD_RING_SIZE
+#define RBC_MESH_SPI_CMD_RING_SIZE  (64)
+#endif
+
+/** @brief Size of the event ring in bytes. Power of two, 64 to 128. */
+#ifndef RBC_MESH_SPI_EVT_RING_SIZE
+#define RBC_MESH_SPI_EVT_RING_SIZE  (128)
+#endif
+
+/** @brief Longest SPI transaction. Must not exceed the slave's transaction
+ *  buffer, which holds the status byte and four frames. */
+#ifndef RBC_MESH_SPI_XFER_MAX
+#define RBC_MESH_SPI_XFER_MAX       (153)
+#endif
+
+/** @brief Time to wait for RDYN after a request, before the request is
+ *  repeated by rbc_mesh_spi_poll(). */
+#ifndef RBC_MESH_SPI_REQ_TIMEOUT_MS
+#define RBC_MESH_SPI_REQ_TIMEOUT_MS (20)
+#endif
+
+typedef struct
+{
+    uint8_t reqn_pin;
+    uint8_t rdyn_pin;
+    int8_t interrupt_number;    /**< External interrupt on the RDYN pin, or -1 to poll. */
+    uint32_t spi_clock_hz;
+} rbc_mesh_spi_pins_t;
+
+/** @brief Set up the pins and the SPI peripheral, and attach the RDYN
+ *  interrupt. */
+void rbc_mesh_spi_init(const rbc_mesh_spi_pins_t* p_pins);
+
+/** @brief Queue a command for the slave, and request a transaction.
+ *  @param p_cmd Command in serial format, starting with its length byte.
+ *  @return True if the command was queued, false if the ring is full.
+ */
+bool rbc_mesh_spi_cmd_send(const uint8_t* p_cmd);
+
+/** @brief Take the oldest event off the event ring.
+ *  @param p_evt Buffer for the event, in serial format.
+ *  @param max_len Size of the buffer. Longer events are truncated.
+ *  @return Number of bytes copied to p_evt, 0 if there were no events.
+ */
+uint8_t rbc_mesh_spi_evt_get(uint8_t* p_evt, uint8_t max_len);
+
+/** @brief Number of times the slave had to hold back an event because the
+ *  event ring was full. The slave resends these events, so they're only
+ *  delayed, not lost. */
+uint32_t rbc_mesh_spi_evt_stalls_get(void);
+
+/** @brief Run the transport from the main loop. Does the transactions when
+ *  there's no RDYN interrupt, and repeats requests the slave missed. Cheap
+ *  to call as often as convenient.
+ */
+void rbc_mesh_spi_poll(void);
+
+#endif /* _RBC_MESH_SPI_H__ */
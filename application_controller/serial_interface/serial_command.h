@@ -38,6 +38,7 @@ typedef enum
     SERIAL_CMD_OPCODE_STOP                  = 0x75,
     SERIAL_CMD_OPCODE_FLAG_SET              = 0x76,
     SERIAL_CMD_OPCODE_FLAG_GET              = 0x77,
+    SERIAL_CMD_OPCODE_STATS_GET             = 0x79,
 
     SERIAL_CMD_OPCODE_VALUE_GET             = 0x7A,
     SERIAL_CMD_OPCODE_BUILD_VERSION_GET     = 0x7B,
@@ -94,6 +95,11 @@ typedef struct
     uint16_t handle;
 } __packed serial_cmd_params_value_get_t;
 
+typedef struct 
+{
+    uint8_t offset;
+} __packed serial_cmd_params_stats_get_t;
+
 
 typedef struct 
 {
@@ -109,6 +115,7 @@ typedef struct
         serial_cmd_params_value_enable_t    value_enable;
         serial_cmd_params_value_disable_t   value_disable;
         serial_cmd_params_value_get_t       value_get;
+        serial_cmd_params_stats_get_t       stats_get;
     } __packed params;
 } __packed  serial_cmd_t;
 
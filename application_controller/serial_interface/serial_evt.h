@@ -82,6 +82,13 @@ typedef struct
     uint8_t data[RBC_MESH_VALUE_MAX_LEN];
 } __packed serial_evt_cmd_rsp_params_val_get_t;
 
+typedef struct
+{
+    uint8_t offset;
+    uint8_t total_len;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed serial_evt_cmd_rsp_params_stats_get_t;
+
 
 /****** EVT PARAMS ******/
 typedef struct
@@ -101,6 +108,7 @@ typedef struct
         serial_evt_cmd_rsp_params_flag_get_t flag;
         serial_evt_cmd_rsp_params_adv_int_t adv_int;
         serial_evt_cmd_rsp_params_val_get_t val_get;
+        serial_evt_cmd_rsp_params_stats_get_t stats_get;
     } __packed response;        
 } __packed serial_evt_params_cmd_rsp_t;
 
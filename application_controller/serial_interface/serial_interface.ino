@@ -21,9 +21,10 @@
 #include <EEPROM.h>
 #include <SPI.h>
 #include <stdint.h>
-#include "lib_aci.h"
-
 #include "rbc_mesh_interface.h"
+#ifndef RBC_MESH_SPI_NONBLOCKING
+#include "lib_aci.h"
+#endif
 
 #define ACCESS_ADDR     (0xA541A68F)
 
@@ -80,6 +81,22 @@ int get_val_req(String args){
     return rbc_mesh_value_get(handle);
 }
 
+#ifdef RBC_MESH_SPI_NONBLOCKING
+rbc_mesh_spi_pins_t pins;
+
+// arduino conform init function
+void setup(void)
+{
+  Serial.begin(9600);
+
+  pins.reqn_pin         = 9;
+  pins.rdyn_pin         = 8;
+  pins.interrupt_number = -1; // pin 8 has no external interrupt, rbc_mesh_poll() does the transfers
+  pins.spi_clock_hz     = 2000000;
+
+  rbc_mesh_hw_init(&pins);
+}
+#else
 aci_pins_t pins;
 
 // arduino conform init function
@@ -105,6 +122,7 @@ void setup(void)
 
   rbc_mesh_hw_init(&pins);
 }
+#endif
 
 // sending intialization commands to SPI slave
 // alternating sending of commands and waiting for response
@@ -134,6 +152,9 @@ void initConnectionSlowly(){
 // arduino conform main loop
 void loop() {
     static bool newMessage = false;
+#ifdef RBC_MESH_SPI_NONBLOCKING
+    rbc_mesh_poll();
+#endif
     // send next initialization command to SPI slave until we leave init state
     if (state == STATE_INIT && newMessage) {
         initConnectionSlowly();
@@ -26,14 +26,38 @@
 
 #define __packed __attribute__((__packed__)) 
 
+/* Uncomment to use the interrupt driven SPI transport in rbc_mesh_spi.cpp
+ * instead of the nRF8001 library's hal_aci_tl. */
+/* #define RBC_MESH_SPI_NONBLOCKING */
+
 typedef __packed enum
 {
-    ACI_FLAG_PERSISTENT = 0x00,
-    ACI_FLAG_TX_EVENT   = 0x01
+    ACI_FLAG_PERSISTENT     = 0x00,
+    ACI_FLAG_TX_EVENT       = 0x01,
+    ACI_FLAG_TRICKLE_CLASS  = 0x02
 } aci_flag_t;
 
 
 #define RBC_MESH_VALUE_MAX_LEN (23)
 
+#ifdef RBC_MESH_SPI_NONBLOCKING
+/* Otherwise provided by lib_aci */
+typedef __packed enum
+{
+  ACI_STATUS_SUCCESS                                        = 0x00,
+  ACI_STATUS_ERROR_UNKNOWN                                  = 0x80,
+  ACI_STATUS_ERROR_INTERNAL                                 = 0x81,
+  ACI_STATUS_ERROR_CMD_UNKNOWN                              = 0x82,
+  ACI_STATUS_ERROR_DEVICE_STATE_INVALID                     = 0x83,
+  ACI_STATUS_ERROR_INVALID_LENGTH                           = 0x84,
+  ACI_STATUS_ERROR_INVALID_PARAMETER                        = 0x85,
+  ACI_STATUS_ERROR_BUSY                                     = 0x86,
+  ACI_STATUS_ERROR_INVALID_DATA                             = 0x87,
+  ACI_STATUS_ERROR_PIPE_INVALID                             = 0x90,
+  ACI_STATUS_RESERVED_START                                 = 0xF0,
+  ACI_STATUS_RESERVED_END                                   = 0xFF
+} aci_status_code_t;
+#endif
+
 #endif /* _SERIAL_INTERNAL_H__ */
 
@@ -86,6 +86,7 @@ typedef struct
 static fifo_t               m_flash_fifo;
 static flash_queue_entry_t  m_flash_fifo_buf[FLASH_FIFO_SIZE];
 static bool                 m_go_to_app;
+static bool                 m_bank_swap;    /**< Flashing a bank the application asked for, and going back when done. */
 static timeout_action_t     m_timeout_action;
 
 #ifdef RTT_LOG
@@ -144,6 +145,24 @@ static void interrupts_disable(void)
     }
 }
 
+/** Hand the chip over to the application at the given address. Doesn't return. */
+static void app_start(uint32_t app_start_addr)
+{
+    interrupts_disable();
+
+    sd_mbr_command_t com = {SD_MBR_COMMAND_INIT_SD, };
+
+    uint32_t err_code = sd_mbr_command(&com);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = sd_softdevice_vector_table_base_set(app_start_addr);
+    APP_ERROR_CHECK(err_code);
+#ifdef DEBUG_LEDS
+    NRF_GPIO->OUTSET = LEDS_MASK;
+#endif
+    bootloader_util_app_start(app_start_addr);
+}
+
 /** Interrupt indicating new serial command */
 #ifdef RBC_MESH_SERIAL
 void SWI2_IRQHandler(void)
@@ -208,6 +227,18 @@ void FLASH_HANDLER_IRQHandler(void)
         bl_cmd_t idle_cmd;
         idle_cmd.type = BL_CMD_TYPE_FLASH_ALL_COMPLETE;
         bl_cmd_handler(&idle_cmd);
+
+        /* Go straight back once the bank is in place, instead of waiting
+           for the yield timeout. */
+        if (m_bank_swap && !dfu_bank_transfer_in_progress())
+        {
+            m_bank_swap = false;
+            if (dfu_mesh_app_is_valid())
+            {
+                __LOG("Bank swap done.\n");
+                m_go_to_app = true;
+            }
+        }
     }
     if (fifo_is_empty(&m_flash_fifo) && m_go_to_app)
     {
@@ -371,6 +402,7 @@ static uint32_t bl_evt_handler(bl_evt_t* p_evt)
                     relay_cmd.params.dfu.start.relay.fwid = p_evt->params.dfu.req.fwid;
                     relay_cmd.params.dfu.start.relay.type = p_evt->params.dfu.req.dfu_type;
                     relay_cmd.params.dfu.start.relay.transaction_id = p_evt->params.dfu.req.transaction_id;
+                    relay_cmd.params.dfu.start.relay.p_bank_start = NULL;
                     bootloader_cmd_send(&relay_cmd);
                 }
             }
@@ -450,6 +482,55 @@ static uint32_t bl_evt_handler(bl_evt_t* p_evt)
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
+void bootloader_fast_boot(void)
+{
+    if (NRF_POWER->GPREGRET != RBC_MESH_GPREGRET_CODE_GO_TO_APP)
+    {
+        return;
+    }
+
+    /* Nothing is initialized yet, the lookups read the info page directly. */
+    bl_info_entry_t* p_flags_entry   = bootloader_info_entry_get(BL_INFO_TYPE_FLAGS);
+    bl_info_entry_t* p_version_entry = bootloader_info_entry_get(BL_INFO_TYPE_VERSION);
+    bl_info_entry_t* p_segment_entry = bootloader_info_entry_get(BL_INFO_TYPE_SEGMENT_APP);
+    if (p_flags_entry == NULL ||
+        p_version_entry == NULL ||
+        p_segment_entry == NULL)
+    {
+        return;
+    }
+
+    /* The intact flags are only set once a transfer has been verified, and
+       are our record of the firmware being valid. */
+    if (!p_flags_entry->flags.sd_intact ||
+        !p_flags_entry->flags.app_intact ||
+        !p_flags_entry->flags.bl_intact ||
+        p_version_entry->version.app.app_version == APP_VERSION_INVALID ||
+        p_segment_entry->segment.start == 0xFFFFFFFF ||
+        *((uint32_t*) p_segment_entry->segment.start) == 0xFFFFFFFF)
+    {
+        return;
+    }
+
+    /* Bank flash operations must be resumed by the full bootloader. */
+    for (uint32_t i = DFU_TYPE_SD; i <= DFU_TYPE_APP; i <<= 1)
+    {
+        bl_info_entry_t* p_bank_entry = bootloader_info_entry_get((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + i));
+        if (p_bank_entry && p_bank_entry->bank.state != BL_INFO_BANK_STATE_IDLE)
+        {
+            return;
+        }
+    }
+
+    /* So is the trial of a new application. */
+    if (dfu_bank_rollback_pending())
+    {
+        return;
+    }
+
+    app_start(p_segment_entry->segment.start);
+}
+
 void bootloader_init(void)
 {
     rtc_init();
@@ -481,10 +562,15 @@ void bootloader_init(void)
 
     bool dfu_bank_flash_start;
     dfu_bank_scan(&dfu_bank_flash_start);
+    if (!dfu_bank_flash_start)
+    {
+        dfu_bank_flash_start = dfu_bank_rollback_boot();
+    }
     if (dfu_bank_flash_start)
     {
         /* A bank is to be flashed. Attempt to go to app if possible. */
         NRF_POWER->GPREGRET = RBC_MESH_GPREGRET_CODE_GO_TO_APP;
+        m_bank_swap = true;
     }
 }
 
@@ -553,6 +639,11 @@ uint32_t bootloader_cmd_send(bl_cmd_t* p_bl_cmd)
     return bl_cmd_handler(p_bl_cmd);
 }
 
+uint32_t bootloader_flash_available_slots(void)
+{
+    return FLASH_FIFO_SIZE - fifo_get_len(&m_flash_fifo);
+}
+
 void bootloader_abort(dfu_end_t end_reason)
 {
     __LOG("ABORT...\n");
@@ -563,23 +654,16 @@ void bootloader_abort(dfu_end_t end_reason)
         case DFU_END_ERROR_TIMEOUT:
         case DFU_END_FWID_VALID:
         case DFU_END_ERROR_MBR_CALL_FAILED:
-            if (p_segment_entry && dfu_mesh_app_is_valid())
+            if (dfu_bank_transfer_in_progress())
+            {
+                /* the application is only partially in place */
+                __LOG("->Bank flash in progress.\n");
+            }
+            else if (p_segment_entry && dfu_mesh_app_is_valid())
             {
                 if (fifo_is_empty(&m_flash_fifo))
                 {
-                    interrupts_disable();
-
-                    sd_mbr_command_t com = {SD_MBR_COMMAND_INIT_SD, };
-
-                    uint32_t err_code = sd_mbr_command(&com);
-                    APP_ERROR_CHECK(err_code);
-
-                    err_code = sd_softdevice_vector_table_base_set(p_segment_entry->segment.start);
-                    APP_ERROR_CHECK(err_code);
-#ifdef DEBUG_LEDS
-                    NRF_GPIO->OUTSET = LEDS_MASK;
-#endif
-                    bootloader_util_app_start(p_segment_entry->segment.start);
+                    app_start(p_segment_entry->segment.start);
                 }
                 else
                 {
@@ -134,7 +134,8 @@ uint32_t bl_cmd_handler(bl_cmd_t* p_bl_cmd)
             return dfu_mesh_relay(
                     p_bl_cmd->params.dfu.start.relay.type,
                     &p_bl_cmd->params.dfu.start.relay.fwid,
-                    p_bl_cmd->params.dfu.start.relay.transaction_id);
+                    p_bl_cmd->params.dfu.start.relay.transaction_id,
+                    p_bl_cmd->params.dfu.start.relay.p_bank_start);
 
         case BL_CMD_TYPE_DFU_START_SOURCE:
             return NRF_ERROR_NOT_SUPPORTED;
@@ -148,6 +149,12 @@ uint32_t bl_cmd_handler(bl_cmd_t* p_bl_cmd)
                 return dfu_bank_flash(p_bl_cmd->params.dfu.bank_flash.bank_dfu_type);
             }
 
+        case BL_CMD_TYPE_DFU_ROLLBACK_CONFIRM:
+            return dfu_bank_rollback_confirm();
+
+        case BL_CMD_TYPE_DFU_ROLLBACK:
+            return dfu_bank_rollback();
+
         case BL_CMD_TYPE_INFO_GET:
             p_bl_cmd->params.info.get.p_entry =
                 bootloader_info_entry_get(p_bl_cmd->params.info.get.type);
@@ -53,7 +53,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PIN_INIT            (5)
 
 #define INFO_WRITE_BUFLEN   (128)
-#define INFO_CACHE_SIZE     (0)
+#define INFO_INDEX_TYPES    (0x40) /**< Entry types below this are indexed, the rest are looked up by walking the page. */
+#define INFO_INDEX_NONE     (0x0000) /**< There's no entry of this type, offset 0 is the page metadata. */
 
 typedef enum
 {
@@ -97,12 +98,6 @@ typedef struct
     bool wait_for_idle;
 } info_copy_t;
 
-typedef struct
-{
-    bl_info_type_t type;
-    uint16_t offset;
-} info_cache_entry_t;
-
 static bootloader_info_t*               mp_bl_info_page;
 static bootloader_info_t*               mp_bl_info_bank_page;
 static uint8_t                          mp_info_entry_buffer[INFO_WRITE_BUFLEN] __attribute__((aligned(4)));
@@ -113,49 +108,14 @@ static bl_info_state_t                  m_state;
 static bool                             m_write_in_progress;
 static info_copy_t                      m_info_copy;
 static void*                            mp_write_pos;
-#if INFO_CACHE_SIZE > 0
-static info_cache_entry_t               m_info_cache[INFO_CACHE_SIZE];
-static uint8_t                          m_info_cache_index;
-#endif
+static uint16_t                         m_info_index[INFO_INDEX_TYPES]; /**< Page offset of the entry of each type, or INFO_INDEX_NONE. */
+static bool                             m_info_index_valid;
 #ifdef RTT_LOG
 static char*                            mp_copy_state_str[] = {"IDLE", "ERASE", "METAWRITE", "DATAWRITE", "WAIT FOR IDLE"};
 #endif
 /******************************************************************************
 * Static functions
 ******************************************************************************/
-static bl_info_entry_t* info_entry_get_from_cache(bl_info_type_t type)
-{
-#if INFO_CACHE_SIZE > 0
-#ifdef RTT_LOG
-    static uint32_t hits = 0, misses = 0;
-#endif
-    for (uint32_t i = 0; i < INFO_CACHE_SIZE; ++i)
-    {
-        if (m_info_cache[i].type == type)
-        {
-            __LOG("INFO CACHE HIT! Hits/misses: %u/%u\n", ++hits, misses);
-            return (bl_info_entry_t*) ((uint32_t) mp_bl_info_page + m_info_cache[i].offset);
-        }
-    }
-    ++misses;
-#endif
-    return NULL;
-}
-
-static void info_entry_cache_invalidate(bl_info_type_t type)
-{
-#if INFO_CACHE_SIZE > 0
-    for (uint32_t i = 0; i < INFO_CACHE_SIZE; ++i)
-    {
-        if (m_info_cache[i].type == type)
-        {
-            m_info_cache[i].type = BL_INFO_TYPE_INVALID;
-        }
-    }
-#endif
-}
-
-
 static inline info_buffer_t* bootloader_info_iterate(info_buffer_t* p_buf)
 {
     return (info_buffer_t*) (((uint32_t) p_buf) + ((uint32_t) p_buf->header.len) * 4);
@@ -192,6 +152,84 @@ static bl_info_entry_t* info_entry_get(bootloader_info_t* p_bl_info_page, bl_inf
     return &p_buffer->entry;
 }
 
+/** Build the entry index by walking the info page once. Only the first entry
+  of each type is indexed, like when walking the page for a single type. */
+static void info_index_build(void)
+{
+    memset(m_info_index, INFO_INDEX_NONE, sizeof(m_info_index));
+    m_info_index_valid = false;
+
+    if (mp_bl_info_page->metadata.metadata_len == 0xFF)
+    {
+        return;
+    }
+
+    info_buffer_t* p_buffer =
+        (info_buffer_t*)
+        ((uint32_t) mp_bl_info_page + mp_bl_info_page->metadata.metadata_len);
+
+    uint32_t iterations = 0;
+    while ((uint32_t) p_buffer + HEADER_LEN <= ((uint32_t) mp_bl_info_page) + PAGE_SIZE &&
+            ++iterations <= PAGE_SIZE / 2)
+    {
+        bl_info_type_t type = (bl_info_type_t) p_buffer->header.type;
+        if (type == BL_INFO_TYPE_LAST || type == BL_INFO_TYPE_UNUSED)
+        {
+            break;
+        }
+        if (type != BL_INFO_TYPE_INVALID &&
+            type < INFO_INDEX_TYPES &&
+            m_info_index[type] == INFO_INDEX_NONE)
+        {
+            m_info_index[type] = (uint32_t) &p_buffer->entry - (uint32_t) mp_bl_info_page;
+        }
+        p_buffer = bootloader_info_iterate(p_buffer);
+    }
+    m_info_index_valid = true;
+}
+
+/** Point the index at the given entry, or mark the type as absent with NULL. */
+static void info_index_set(bl_info_type_t type, bl_info_entry_t* p_entry)
+{
+    if (type < INFO_INDEX_TYPES)
+    {
+        m_info_index[type] = (p_entry ? (uint32_t) p_entry - (uint32_t) mp_bl_info_page : INFO_INDEX_NONE);
+    }
+}
+
+/**
+* Look up an entry in the index. Entries that are still being written, or have
+* been replaced without the index knowing, are looked up in the page instead.
+*
+* @param[in] type Type to look up.
+* @param[out] pp_entry The indexed entry, or NULL if there's none.
+*
+* @return Whether the index could answer the lookup.
+*/
+static bool info_index_get(bl_info_type_t type, bl_info_entry_t** pp_entry)
+{
+    if (!m_info_index_valid && m_state == BL_INFO_STATE_IDLE && !m_write_in_progress)
+    {
+        info_index_build();
+    }
+    if (!m_info_index_valid || type >= INFO_INDEX_TYPES)
+    {
+        return false;
+    }
+    if (m_info_index[type] == INFO_INDEX_NONE)
+    {
+        *pp_entry = NULL;
+        return true;
+    }
+    info_buffer_t* p_buffer = (info_buffer_t*) ((uint32_t) mp_bl_info_page + m_info_index[type] - HEADER_LEN);
+    if (p_buffer->header.type != type)
+    {
+        return false;
+    }
+    *pp_entry = &p_buffer->entry;
+    return true;
+}
+
 static uint32_t entry_header_invalidate(bootloader_info_header_t* p_header)
 {
     /* TODO: optimization: check if the write only adds 0-bits to the current value,
@@ -515,9 +553,7 @@ static uint32_t backup(void)
 /** Pull in all entries from the bank. */
 static uint32_t recover(void)
 {
-#if INFO_CACHE_SIZE > 0
-    memset(&m_info_cache, 0, sizeof(m_info_cache));
-#endif
+    m_info_index_valid = false;
     uint32_t error_code = copy_page(mp_bl_info_page, mp_bl_info_bank_page);
     if (error_code == NRF_SUCCESS)
     {
@@ -603,6 +639,13 @@ uint32_t bootloader_info_init(uint32_t* p_bl_info_page, uint32_t* p_bl_info_bank
         APP_ERROR_CHECK(flash_write((uint32_t*) mp_bl_info_page,
                             (uint8_t*) mp_bl_info_bank_page,
                             (uint32_t) p_first_unused + 4 - (uint32_t) mp_bl_info_bank_page));
+        /* The index is built when the restored page has been written. */
+        m_write_in_progress = true;
+        m_info_index_valid = false;
+    }
+    else
+    {
+        info_index_build();
     }
 
     m_state = BL_INFO_STATE_IDLE;
@@ -616,18 +659,18 @@ bootloader_info_t* bootloader_info_get(void)
 
 bl_info_entry_t* bootloader_info_entry_get(bl_info_type_t type)
 {
-    bl_info_entry_t* p_entry = info_entry_get_from_cache(type);
-    if (p_entry != NULL)
+    bl_info_entry_t* p_entry = NULL;
+    if (info_index_get(type, &p_entry))
     {
         return p_entry;
     }
     p_entry = info_entry_get((bootloader_info_t*) BOOTLOADER_INFO_ADDRESS, type);
-#if INFO_CACHE_SIZE > 0
-    if (p_entry != NULL)
+    /* Keep pointing at entries that are still being written, they'll show
+       up in the page when the write is done. */
+    if (p_entry != NULL && m_info_index_valid && m_state == BL_INFO_STATE_IDLE)
     {
-        m_info_cache[(m_info_cache_index++) & (INFO_CACHE_SIZE - 1)] = (info_cache_entry_t) { type, (uint32_t) p_entry - (uint32_t) BOOTLOADER_INFO_ADDRESS };
+        info_index_set(type, p_entry);
     }
-#endif
     return p_entry;
 }
 
@@ -674,9 +717,9 @@ bl_info_entry_t* bootloader_info_entry_put(bl_info_type_t type,
     mp_write_pos = (uint8_t*) mp_write_pos + ((length + HEADER_LEN + 3) & ~0x03);
 
     /* invalidate old entry of this type */
+    info_index_set(type, &p_new_buf->entry);
     if (p_old_header != NULL)
     {
-        info_entry_cache_invalidate(type);
         if (entry_header_invalidate(p_old_header) != NRF_SUCCESS)
         {
             APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
@@ -709,8 +752,12 @@ uint32_t bootloader_info_entry_overwrite(bl_info_type_t type, bl_info_entry_t* p
 uint32_t bootloader_info_entry_invalidate(bl_info_type_t type)
 {
     __LOG("INVALIDATE 0x%x\n", type);
-    info_entry_cache_invalidate(type);
-    return entry_invalidate((bootloader_info_t*) BOOTLOADER_INFO_ADDRESS, type);
+    uint32_t error_code = entry_invalidate((bootloader_info_t*) BOOTLOADER_INFO_ADDRESS, type);
+    if (error_code == NRF_SUCCESS)
+    {
+        info_index_set(type, NULL);
+    }
+    return error_code;
 }
 
 uint32_t bootloader_info_reset(void)
@@ -719,6 +766,7 @@ uint32_t bootloader_info_reset(void)
 
     __LOG("RESET\n");
     m_state = BL_INFO_STATE_RESET;
+    m_info_index_valid = false;
     mp_write_pos = mp_bl_info_page->data;
     return backup();
 }
@@ -755,6 +803,7 @@ void bootloader_info_on_flash_op_end(flash_op_type_t type, void* p_context)
             /* done recovering */
             mp_write_pos = bootloader_info_first_unused_get(mp_bl_info_page);
             m_state = BL_INFO_STATE_IDLE;
+            info_index_build();
         }
     }
 }
@@ -49,20 +49,310 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /*****************************************************************************
 * Local defines
 *****************************************************************************/
+#ifndef DFU_BANK_COPY_CHUNK_PAGES
+/** @brief Number of pages copied from the bank to the application between
+ * each progress checkpoint. */
+#define DFU_BANK_COPY_CHUNK_PAGES   (4)
+#endif
+
+#ifdef DFU_BANK_ROLLBACK
+#ifndef DFU_BANK_ROLLBACK_ADDR
+#error "DFU_BANK_ROLLBACK requires a page aligned DFU_BANK_ROLLBACK_ADDR for the copy of the previous application"
+#endif
+#ifndef DFU_BANK_ROLLBACK_SIZE
+/** @brief Size of the rollback slot. Applications that don't fit are
+ * replaced without keeping a copy. */
+#define DFU_BANK_ROLLBACK_SIZE      (0x20000)
+#endif
+#endif
 
+#define DFU_BANK_COPY_RETRIES       (3)
+#define COPY_OFFSET_UNKNOWN         (0xFFFFFFFF)
 /*****************************************************************************
 * Local typedefs
 *****************************************************************************/
-
+/** State of the bank to application copy. */
+typedef struct
+{
+    uint32_t offset;        /**< Offset of the first byte not yet verified, or COPY_OFFSET_UNKNOWN. */
+    uint32_t chunk_length;  /**< Length of the chunk being flashed, or 0. */
+    uint8_t  retries;       /**< Number of failed verifications of the current chunk. */
+} bank_copy_t;
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
 static bl_info_bank_t*  mp_bank_entry;
 static dfu_type_t       m_dfu_type;
 static bool             m_waiting_for_idle;
+static bank_copy_t      m_copy = {COPY_OFFSET_UNKNOWN, 0, 0};
+#ifdef DFU_BANK_ROLLBACK
+static bool             m_rollback_pending; /**< The rollback bank entry is being written, flash it when it's in place. */
+#endif
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
+/** Get the number of bytes of the given copy that have already been copied and
+  verified, according to the persistent progress entry. */
+static uint32_t copy_progress_get(uint32_t* p_key, uint32_t length)
+{
+    bl_info_entry_t* p_progress = bootloader_info_entry_get(BL_INFO_TYPE_BANK_PROGRESS);
+    if (p_progress == NULL ||
+        p_progress->bank_progress.p_bank_addr != p_key ||
+        p_progress->bank_progress.length > length)
+    {
+        return 0;
+    }
+    return p_progress->bank_progress.length;
+}
+
+/**
+* Copy a flash region to a page aligned destination, one chunk at a time. Each
+* chunk is verified after it's been flashed, and its progress is stored in the
+* bootloader info under the given key, so that an interrupted copy can resume
+* from the last verified chunk. Control returns to the bootloader between the
+* chunks.
+*
+* @return Whether the entire region has been copied and verified.
+*/
+static bool region_copy(uint32_t* p_key, uint32_t src, uint32_t dst, uint32_t length)
+{
+    if (m_copy.offset == COPY_OFFSET_UNKNOWN)
+    {
+        m_copy.offset = copy_progress_get(p_key, length);
+        m_copy.chunk_length = 0;
+        m_copy.retries = 0;
+        __LOG("Bank: Copy from offset 0x%x\n", m_copy.offset);
+    }
+
+    if (m_copy.chunk_length > 0)
+    {
+        /* the flash went idle, the chunk in flight is done. */
+        if (memcmp((uint8_t*) dst + m_copy.offset,
+                    (uint8_t*) src + m_copy.offset,
+                    m_copy.chunk_length) == 0)
+        {
+            if (!bootloader_info_available())
+            {
+                return false;
+            }
+            bl_info_entry_t progress_entry;
+            progress_entry.bank_progress.p_bank_addr = p_key;
+            progress_entry.bank_progress.length = m_copy.offset + m_copy.chunk_length;
+            if (!bootloader_info_entry_put(BL_INFO_TYPE_BANK_PROGRESS,
+                        &progress_entry,
+                        BL_INFO_LEN_BANK_PROGRESS))
+            {
+                return false;
+            }
+            m_copy.offset += m_copy.chunk_length;
+            m_copy.retries = 0;
+        }
+        else
+        {
+            __LOG(RTT_CTRL_TEXT_RED "Bank: Verification failed @0x%x\n", dst + m_copy.offset);
+            APP_ERROR_CHECK_BOOL(++m_copy.retries < DFU_BANK_COPY_RETRIES);
+        }
+        m_copy.chunk_length = 0;
+    }
+
+    if (m_copy.offset >= length)
+    {
+        m_copy.offset = COPY_OFFSET_UNKNOWN;
+        return true;
+    }
+
+    uint32_t chunk_length = length - m_copy.offset;
+    if (chunk_length > DFU_BANK_COPY_CHUNK_PAGES * PAGE_SIZE)
+    {
+        chunk_length = DFU_BANK_COPY_CHUNK_PAGES * PAGE_SIZE;
+    }
+
+    bl_evt_t flash_evt;
+    flash_evt.type = BL_EVT_TYPE_FLASH_ERASE;
+    flash_evt.params.flash.erase.start_addr = dst + m_copy.offset;
+    flash_evt.params.flash.erase.length = ((chunk_length + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1)); /* Pad the rest of the page */
+    if (bootloader_evt_send(&flash_evt) != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    flash_evt.type = BL_EVT_TYPE_FLASH_WRITE;
+    flash_evt.params.flash.write.p_data = (uint8_t*) src + m_copy.offset;
+    flash_evt.params.flash.write.length = chunk_length;
+    flash_evt.params.flash.write.start_addr = dst + m_copy.offset;
+    if (bootloader_evt_send(&flash_evt) != NRF_SUCCESS)
+    {
+        /* the erase will be redone with the next attempt. */
+        return false;
+    }
+    m_copy.chunk_length = chunk_length;
+    return false;
+}
+
+#ifdef DFU_BANK_ROLLBACK
+/** Get the length of the application at the given address, up to the last
+  word that isn't erased before the limit. */
+static uint32_t app_length_get(uint32_t app_start, uint32_t limit)
+{
+    uint32_t* p_end = (uint32_t*) limit;
+    while (p_end > (uint32_t*) app_start && *(p_end - 1) == 0xFFFFFFFF)
+    {
+        p_end--;
+    }
+    return ((uint32_t) p_end - app_start);
+}
+
+/**
+* Copy the running application to the rollback slot before the bank replaces
+* it, and store its length, firmware ID and signature in the rollback entry.
+* The copy is only replaced once the application it holds has been confirmed,
+* otherwise it's the last application known to work.
+*
+* @return Whether the bank may be copied to the application area.
+*/
+static bool rollback_save(bl_info_bank_t* p_bank_entry, uint32_t app_start)
+{
+    if (p_bank_entry->p_bank_addr == (uint32_t*) DFU_BANK_ROLLBACK_ADDR)
+    {
+        /* Restoring the copy. */
+        return true;
+    }
+
+    uint32_t bank_start = (uint32_t) p_bank_entry->p_bank_addr;
+    bool bank_in_slot = (DFU_BANK_ROLLBACK_ADDR < bank_start + p_bank_entry->length &&
+                         bank_start < DFU_BANK_ROLLBACK_ADDR + DFU_BANK_ROLLBACK_SIZE);
+
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    if (p_rollback_entry != NULL)
+    {
+        if (!bank_in_slot &&
+            p_rollback_entry->bank.state != (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_CONFIRMED)
+        {
+            return true;
+        }
+        /* The copy is older than the running application, or the bank was
+           transferred on top of it. */
+        (void) bootloader_info_entry_invalidate(BL_INFO_TYPE_ROLLBACK);
+        return false;
+    }
+
+    uint32_t limit = app_start + DFU_BANK_ROLLBACK_SIZE;
+    if (bank_start > app_start && bank_start < limit)
+    {
+        limit = bank_start;
+    }
+    if (DFU_BANK_ROLLBACK_ADDR > app_start && DFU_BANK_ROLLBACK_ADDR < limit)
+    {
+        limit = DFU_BANK_ROLLBACK_ADDR;
+    }
+    uint32_t length = app_length_get(app_start, limit);
+    if (length == 0 || length == DFU_BANK_ROLLBACK_SIZE || bank_in_slot)
+    {
+        __LOG(RTT_CTRL_TEXT_RED "Rollback: No room for the application (0x%x bytes)\n", length);
+        return true;
+    }
+
+    if (!region_copy((uint32_t*) DFU_BANK_ROLLBACK_ADDR, app_start, DFU_BANK_ROLLBACK_ADDR, length))
+    {
+        return false;
+    }
+
+    if (!bootloader_info_available())
+    {
+        return false;
+    }
+    bl_info_entry_t* p_version_entry = bootloader_info_entry_get(BL_INFO_TYPE_VERSION);
+    bl_info_entry_t* p_signature_entry = bootloader_info_entry_get(BL_INFO_TYPE_SIGNATURE_APP);
+    APP_ERROR_CHECK_BOOL(p_version_entry != NULL);
+
+    bl_info_entry_t rollback_entry;
+    memset(&rollback_entry, 0xFF, sizeof(bl_info_bank_t));
+    rollback_entry.bank.p_bank_addr = (uint32_t*) DFU_BANK_ROLLBACK_ADDR;
+    rollback_entry.bank.length = length;
+    rollback_entry.bank.fwid.app = p_version_entry->version.app;
+    rollback_entry.bank.has_signature = (p_signature_entry != NULL);
+    rollback_entry.bank.state = (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_SAVED;
+    if (p_signature_entry != NULL)
+    {
+        memcpy(rollback_entry.bank.signature, p_signature_entry->signature, BL_INFO_LEN_SIGNATURE);
+    }
+    (void) bootloader_info_entry_put(BL_INFO_TYPE_ROLLBACK,
+            &rollback_entry,
+            (rollback_entry.bank.has_signature ? BL_INFO_LEN_BANK_SIGNED : BL_INFO_LEN_BANK));
+    __LOG("Rollback: Saved 0x%x bytes of the application\n", length);
+
+    /* Let the entry land before the application area gets erased. */
+    return false;
+}
+
+/** Update the rollback entry once the bank has been flashed to the
+  application area. */
+static bool rollback_on_flashed(bl_info_bank_t* p_bank_entry)
+{
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    if (p_rollback_entry == NULL)
+    {
+        return true;
+    }
+    if (p_bank_entry->p_bank_addr == (uint32_t*) DFU_BANK_ROLLBACK_ADDR)
+    {
+        /* The previous application is back, and the copy is redundant. */
+        return (bootloader_info_entry_invalidate(BL_INFO_TYPE_ROLLBACK) == NRF_SUCCESS);
+    }
+
+    bl_info_entry_t rollback_entry;
+    memcpy(&rollback_entry, p_rollback_entry, sizeof(bl_info_bank_t));
+    rollback_entry.bank.state = (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_TRIAL;
+    switch ((bl_info_rollback_state_t) p_rollback_entry->bank.state)
+    {
+        case BL_INFO_ROLLBACK_STATE_SAVED:
+            return (bootloader_info_entry_overwrite(BL_INFO_TYPE_ROLLBACK, &rollback_entry) == NRF_SUCCESS);
+
+        case BL_INFO_ROLLBACK_STATE_BOOTED:
+            /* Replaced an application that never confirmed itself. The new
+               one gets its own trial, the state can't go back in place. */
+            return (bootloader_info_available() &&
+                    bootloader_info_entry_put(BL_INFO_TYPE_ROLLBACK,
+                        &rollback_entry,
+                        (rollback_entry.bank.has_signature ? BL_INFO_LEN_BANK_SIGNED : BL_INFO_LEN_BANK)) != NULL);
+
+        default:
+            return true;
+    }
+}
+
+/** Put a bank entry for the copy of the previous application. It's flashed
+  from dfu_bank_on_flash_idle() once the entry is in place. */
+static uint32_t rollback_start(void)
+{
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    if (p_rollback_entry == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (mp_bank_entry != NULL || m_rollback_pending)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (!bootloader_info_available())
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    bl_info_entry_t bank_entry;
+    memcpy(&bank_entry, p_rollback_entry, sizeof(bl_info_bank_t));
+    bank_entry.bank.state = BL_INFO_BANK_STATE_IDLE;
+    if (!bootloader_info_entry_put(BL_INFO_TYPE_BANK_APP,
+                &bank_entry,
+                (bank_entry.bank.has_signature ? BL_INFO_LEN_BANK_SIGNED : BL_INFO_LEN_BANK)))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    __LOG("Rollback: Restore the previous application\n");
+    m_rollback_pending = true;
+    return NRF_SUCCESS;
+}
+#endif
 
 static void flash_bank_entry(void)
 {
@@ -79,6 +369,12 @@ static void flash_bank_entry(void)
         case BL_INFO_BANK_STATE_IDLE:
             {
                 m_waiting_for_idle = true;
+                m_copy.offset = COPY_OFFSET_UNKNOWN;
+                /* A fresh copy shouldn't resume from a previous bank's progress. */
+                if (bootloader_info_entry_get(BL_INFO_TYPE_BANK_PROGRESS) != NULL)
+                {
+                    (void) bootloader_info_entry_invalidate(BL_INFO_TYPE_BANK_PROGRESS);
+                }
                 bank_entry_replacement.bank.state = BL_INFO_BANK_STATE_FLASH_FW;
                 bootloader_info_entry_overwrite((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + m_dfu_type), &bank_entry_replacement);
 
@@ -165,29 +461,23 @@ static void flash_bank_entry(void)
                     }
                     else
                     {
-                        /* Erase, Flash the FW, flash FW flag, flash the signature, erase the bank entry. */
+                        /* Copy the FW chunk by chunk, flash FW flag, flash the signature, erase the bank entry. */
                         bl_info_entry_t* p_app_entry = bootloader_info_entry_get(BL_INFO_TYPE_SEGMENT_APP);
 
                         APP_ERROR_CHECK_BOOL(p_app_entry != NULL);
                         APP_ERROR_CHECK_BOOL(IS_PAGE_ALIGNED(p_app_entry->segment.start));
 
-                        /* Erase existing FW */
-                        bl_evt_t flash_evt;
-                        flash_evt.type = BL_EVT_TYPE_FLASH_ERASE;
-                        flash_evt.params.flash.erase.start_addr = p_app_entry->segment.start;
-                        flash_evt.params.flash.erase.length = ((p_bank_entry->length + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1)); /* Pad the rest of the page */
-                        if (bootloader_evt_send(&flash_evt) != NRF_SUCCESS)
+#ifdef DFU_BANK_ROLLBACK
+                        if (!rollback_save(p_bank_entry, p_app_entry->segment.start))
                         {
                             m_waiting_for_idle = true;
                             return;
                         }
-
-                        /* Flash bank */
-                        flash_evt.type = BL_EVT_TYPE_FLASH_WRITE;
-                        flash_evt.params.flash.write.p_data = (uint8_t*) p_bank_entry->p_bank_addr;
-                        flash_evt.params.flash.write.length = p_bank_entry->length;
-                        flash_evt.params.flash.write.start_addr = p_app_entry->segment.start;
-                        if (bootloader_evt_send(&flash_evt) != NRF_SUCCESS)
+#endif
+                        if (!region_copy(p_bank_entry->p_bank_addr,
+                                    (uint32_t) p_bank_entry->p_bank_addr,
+                                    p_app_entry->segment.start,
+                                    p_bank_entry->length))
                         {
                             m_waiting_for_idle = true;
                             return;
@@ -273,12 +563,23 @@ static void flash_bank_entry(void)
             }
             /* deliberate fallthrough */
         case BL_INFO_BANK_STATE_FLASHED:
+#ifdef DFU_BANK_ROLLBACK
+            if (m_dfu_type == DFU_TYPE_APP && !rollback_on_flashed(p_bank_entry))
+            {
+                m_waiting_for_idle = true;
+                return;
+            }
+#endif
             /* We may invalidate the bank entry in the device page now,
                it's all redundant. */
             __LOG("Bank: Invalidate.\n");
             if (bootloader_info_entry_invalidate((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + m_dfu_type)) == NRF_SUCCESS)
             {
                 __LOG("Bank invalidated.\n");
+                if (bootloader_info_entry_get(BL_INFO_TYPE_BANK_PROGRESS) != NULL)
+                {
+                    (void) bootloader_info_entry_invalidate(BL_INFO_TYPE_BANK_PROGRESS);
+                }
                 mp_bank_entry = NULL; /* reset the static bank pointer, as we no longer need it. */
             }
             else
@@ -360,8 +661,29 @@ bool dfu_bank_is_available(dfu_type_t dfu_type)
 
 void dfu_bank_on_flash_idle(void)
 {
+#ifdef DFU_BANK_ROLLBACK
+    if (m_rollback_pending && bootloader_info_available())
+    {
+        m_rollback_pending = false;
+        APP_ERROR_CHECK(dfu_bank_flash(DFU_TYPE_APP));
+        return;
+    }
+#endif
     if (mp_bank_entry != NULL && m_waiting_for_idle)
     {
+        if (!bootloader_info_available())
+        {
+            /* The info page is being moved, wait for it to finish. */
+            return;
+        }
+        /* The bank entry may have moved since the last step. */
+        bl_info_entry_t* p_bank_entry = bootloader_info_entry_get((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + m_dfu_type));
+        if (p_bank_entry == NULL)
+        {
+            mp_bank_entry = NULL;
+            return;
+        }
+        mp_bank_entry = &p_bank_entry->bank;
         m_waiting_for_idle = false;
         flash_bank_entry();
     }
@@ -369,5 +691,90 @@ void dfu_bank_on_flash_idle(void)
 
 bool dfu_bank_transfer_in_progress(void)
 {
+#ifdef DFU_BANK_ROLLBACK
+    /* a pending rollback flashes its bank once the info page is idle */
+    if (m_rollback_pending)
+    {
+        return true;
+    }
+#endif
     return (mp_bank_entry != NULL);
 }
+
+bool dfu_bank_rollback_boot(void)
+{
+#ifdef DFU_BANK_ROLLBACK
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    if (p_rollback_entry == NULL)
+    {
+        return false;
+    }
+    bl_info_entry_t rollback_entry;
+    switch ((bl_info_rollback_state_t) p_rollback_entry->bank.state)
+    {
+        case BL_INFO_ROLLBACK_STATE_TRIAL:
+            /* First boot of the new application, it has to confirm itself
+               before the next one. */
+            memcpy(&rollback_entry, p_rollback_entry, sizeof(bl_info_bank_t));
+            rollback_entry.bank.state = (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_BOOTED;
+            return (bootloader_info_entry_overwrite(BL_INFO_TYPE_ROLLBACK, &rollback_entry) == NRF_SUCCESS);
+
+        case BL_INFO_ROLLBACK_STATE_BOOTED:
+            __LOG(RTT_CTRL_TEXT_RED "Rollback: The application never confirmed itself\n");
+            return (rollback_start() == NRF_SUCCESS);
+
+        default:
+            return false;
+    }
+#else
+    return false;
+#endif
+}
+
+uint32_t dfu_bank_rollback_confirm(void)
+{
+#ifdef DFU_BANK_ROLLBACK
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    if (p_rollback_entry == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    switch ((bl_info_rollback_state_t) p_rollback_entry->bank.state)
+    {
+        case BL_INFO_ROLLBACK_STATE_CONFIRMED:
+            return NRF_SUCCESS;
+        case BL_INFO_ROLLBACK_STATE_BOOTED:
+            {
+                bl_info_entry_t rollback_entry;
+                memcpy(&rollback_entry, p_rollback_entry, sizeof(bl_info_bank_t));
+                rollback_entry.bank.state = (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_CONFIRMED;
+                return bootloader_info_entry_overwrite(BL_INFO_TYPE_ROLLBACK, &rollback_entry);
+            }
+        default:
+            return NRF_ERROR_INVALID_STATE;
+    }
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t dfu_bank_rollback(void)
+{
+#ifdef DFU_BANK_ROLLBACK
+    return rollback_start();
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+bool dfu_bank_rollback_pending(void)
+{
+#ifdef DFU_BANK_ROLLBACK
+    bl_info_entry_t* p_rollback_entry = bootloader_info_entry_get(BL_INFO_TYPE_ROLLBACK);
+    return (p_rollback_entry != NULL &&
+            (p_rollback_entry->bank.state == (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_TRIAL ||
+             p_rollback_entry->bank.state == (bl_info_bank_state_t) BL_INFO_ROLLBACK_STATE_BOOTED));
+#else
+    return false;
+#endif
+}
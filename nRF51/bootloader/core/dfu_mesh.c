@@ -40,6 +40,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "dfu_util.h"
 #include "dfu_bank.h"
 #include "boards.h"
+#ifdef DFU_SIGNATURE_BENCHMARK
+#include "bootloader_rtc.h"
+#endif
 
 /*****************************************************************************
 * Local defines
@@ -53,7 +56,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define TX_REPEATS_REQ              (TX_REPEATS_DEFAULT)
 #define TX_REPEATS_START            (TX_REPEATS_DEFAULT);
 
+#ifdef DFU_TRICKLE_BEACON
+#define TX_INTERVAL_TYPE_FWID       (BL_RADIO_INTERVAL_TYPE_TRICKLE)
+#else
 #define TX_INTERVAL_TYPE_FWID       (BL_RADIO_INTERVAL_TYPE_REGULAR_SLOW)
+#endif
 #define TX_INTERVAL_TYPE_DFU_REQ    (BL_RADIO_INTERVAL_TYPE_REGULAR_SLOW)
 #define TX_INTERVAL_TYPE_READY      (BL_RADIO_INTERVAL_TYPE_REGULAR)
 #define TX_INTERVAL_TYPE_DATA       (BL_RADIO_INTERVAL_TYPE_EXPONENTIAL)
@@ -67,10 +74,61 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define START_ADDRESS_UNKNOWN       (0xFFFFFFFF)
 
-#define REQ_CACHE_SIZE              (4)
+#define REQ_CACHE_SIZE              (8)
 #define REQ_RX_COUNT_RETRY          (8)
 
 #define DATA_REQ_SEGMENT_NONE            (0)
+#define DATA_REQ_BITMAP_BITS        (DFU_REQ_BITMAP_LEN * 8)
+
+#define PARITY_GROUP_FIRST(segment) ((((segment) - 1) / DFU_PARITY_GROUP_SIZE) * DFU_PARITY_GROUP_SIZE + 1)
+
+#if defined(DFU_PARITY) && (DFU_PARITY_GROUP_SIZE < 2 || DFU_PARITY_GROUP_SIZE > 32)
+#error "DFU_PARITY_GROUP_SIZE must be between 2 and 32"
+#endif
+
+#ifdef DFU_PROGRESS_BEACON
+#ifndef DFU_PROGRESS_STEP
+/** Number of received segments between the progress reports of a target. */
+#define DFU_PROGRESS_STEP           (64)
+#endif
+#ifndef DFU_PROGRESS_WINDOW
+/** Number of progress reports a node merges before it reports the result. */
+#define DFU_PROGRESS_WINDOW         (8)
+#endif
+#ifndef DFU_PROGRESS_AGE_MAX
+/** Number of merges a report may go through. Reports that relays merge back
+  and forth die out after this many rounds. */
+#define DFU_PROGRESS_AGE_MAX        (8)
+#endif
+#define TX_REPEATS_PROGRESS         (TX_REPEATS_DEFAULT)
+#define TX_REPEATS_PROGRESS_DONE    (6) /**< A target's final report, it won't send another. */
+#define TX_INTERVAL_TYPE_PROGRESS   (BL_RADIO_INTERVAL_TYPE_REGULAR)
+#endif
+
+#ifdef DFU_PACING
+#ifndef DFU_PACING_WINDOW
+/** Number of new data segments between each adjustment of the data repeats. */
+#define DFU_PACING_WINDOW           (16)
+#endif
+#ifndef DFU_PACING_REPEATS_MAX
+#define DFU_PACING_REPEATS_MAX      (6)
+#endif
+#define DFU_PACING_REPEATS_MIN      (1)
+#ifndef DFU_PACING_BACKLOG_SEGMENTS
+/** A copy of a segment this far behind the newest one shows that the relays are lagging. */
+#define DFU_PACING_BACKLOG_SEGMENTS (8)
+#endif
+#if (DFU_PACING_REPEATS_MAX < TX_REPEATS_DEFAULT || DFU_PACING_REPEATS_MAX > 12)
+#error "DFU_PACING_REPEATS_MAX must be between TX_REPEATS_DEFAULT and 12, the transports' limit for exponential intervals"
+#endif
+#endif
+
+#ifdef DFU_PASSTHROUGH
+#ifndef DFU_PASSTHROUGH_TRANSACTIONS
+/** Number of other transactions we forward while we're busy with our own. */
+#define DFU_PASSTHROUGH_TRANSACTIONS (4)
+#endif
+#endif
 
 /*****************************************************************************
 * Local typedefs
@@ -91,16 +149,19 @@ typedef struct
     uint32_t*       p_start_addr;
     uint32_t*       p_bank_addr;
     uint32_t*       p_indicated_start_addr;
-    uint32_t*       p_last_requested_entry;
     uint32_t        length;
     uint32_t        signature_length;
     uint8_t         signature[DFU_SIGNATURE_LEN];
     uint8_t         signature_bitmap;
     uint16_t        segments_remaining;
     uint16_t        segment_count;
+    uint8_t         segment_size;   /**< Segments are DFU_SEGMENT_LENGTH(segment_size) bytes long. */
     fwid_union_t    target_fwid_union;
     bool            segment_is_valid_after_transfer;
     bool            flood;
+    bool            diff;
+    bool            source;         /**< The transfer is fed to us over serial. */
+    uint32_t*       p_cache_addr;   /**< Bank a relay keeps a copy of the transfer in, or NULL. */
 } transaction_t;
 
 typedef struct
@@ -122,6 +183,55 @@ typedef struct
     uint16_t segment;
     uint16_t rx_count;
 } req_cache_entry_t;
+
+typedef struct
+{
+    uint16_t last_segment;  /**< Newest segment in the outstanding request. */
+    uint16_t rx_count;      /**< Data packets received since the request went out. */
+} data_req_t;
+
+#ifdef DFU_PROGRESS_BEACON
+/** Progress reports merged since our last report. */
+typedef struct
+{
+    uint16_t missing;           /**< Most segments missing in the merged reports. */
+    uint8_t  age;               /**< Oldest age of the merged reports. */
+    uint8_t  count;             /**< Number of merged reports. */
+    bool     heard;             /**< Whether any reports have been heard in the transfer. */
+    bool     data_done;         /**< Source only: all data segments have been fed to us. */
+} progress_t;
+#endif
+
+#ifdef DFU_PACING
+/** Feedback heard on the mesh during the current pacing window. */
+typedef struct
+{
+    uint8_t  repeats;           /**< Repeats of each relayed transfer packet. */
+    uint8_t  window_segments;   /**< New segments in the window. */
+    uint16_t newest_segment;
+    uint16_t missing;           /**< Segments requested by other nodes. */
+    uint16_t backlog;           /**< Late copies of old segments. */
+} pacing_t;
+#endif
+
+#ifdef DFU_PASSTHROUGH
+/** Transactions heard while we're busy with our own, the oldest is replaced when it's full. */
+typedef struct
+{
+    uint32_t transaction_ids[DFU_PASSTHROUGH_TRANSACTIONS];
+    uint8_t  count;
+    uint8_t  next;              /**< Entry to replace with the next transaction. */
+} passthrough_t;
+#endif
+
+#ifdef DFU_PARITY
+typedef struct
+{
+    uint16_t first_segment;         /**< First segment of the group being accumulated, 0 when idle. */
+    uint32_t received;              /**< Bitmap of the group segments included so far. */
+    uint8_t  data[DFU_SEGMENT_LENGTH_MAX];  /**< XOR of the included segments. */
+} parity_accumulator_t;
+#endif
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
@@ -131,7 +241,20 @@ static bl_info_pointers_t       m_bl_info_pointers;
 static req_cache_entry_t        m_req_cache[REQ_CACHE_SIZE];
 static uint8_t                  m_req_index;
 static uint8_t                  m_tx_slots;
-static bool                     m_data_req_segment;
+static data_req_t               m_data_req;
+#ifdef DFU_PARITY
+static parity_accumulator_t     m_parity;
+#endif
+#ifdef DFU_PACING
+static pacing_t                 m_pacing;
+#endif
+#ifdef DFU_PROGRESS_BEACON
+static progress_t               m_progress;
+#endif
+#ifdef DFU_PASSTHROUGH
+static passthrough_t            m_passthrough;
+#endif
+static sha256_context_t         m_hash_context; /**< Signature hash, fed with the bank during the transfer. */
 
 #ifdef RTT_LOG
 static const char*              m_state_strs[] =
@@ -219,11 +342,13 @@ static uint32_t segment_count_from_start_packet(dfu_packet_t* p_packet)
     {
         start_address = 0; /* It'll be aligned. */
     }
-    uint32_t segment_count = ((p_packet->payload.start.length * 4) + (start_address & 0x0F) - 1) / 16 + 1;
+    const uint8_t segment_size = p_packet->payload.start.segment_size;
+    uint32_t segment_count = (((p_packet->payload.start.length * 4) +
+                (start_address & (DFU_SEGMENT_LENGTH(segment_size) - 1)) - 1) >> DFU_SEGMENT_SHIFT(segment_size)) + 1;
 
     if (p_packet->payload.start.signature_length != 0)
     {
-        segment_count += p_packet->payload.start.signature_length / SEGMENT_LENGTH;
+        segment_count += p_packet->payload.start.signature_length >> DFU_SEGMENT_SHIFT(segment_size);
     }
     if (segment_count > 0xFFFF)
     {
@@ -234,6 +359,12 @@ static uint32_t segment_count_from_start_packet(dfu_packet_t* p_packet)
     return segment_count;
 }
 
+/** Number of segments in the transaction that aren't part of the signature. */
+static uint16_t data_segment_count(void)
+{
+    return m_transaction.segment_count - (m_transaction.signature_length >> DFU_SEGMENT_SHIFT(m_transaction.segment_size));
+}
+
 #define SET_STATE(s) set_state(s, __LINE__)
 static void set_state(dfu_state_t state, uint16_t line)
 {
@@ -286,6 +417,35 @@ static void packet_tx_dynamic(dfu_packet_t* p_packet,
     }
 }
 
+/** Hash the transaction header of the signature, and let the transfer
+  module feed the bank to the hash as it's written. */
+static void signature_hash_start(void)
+{
+    sha256_init(&m_hash_context);
+    sha256_update(&m_hash_context, (uint8_t*) &m_transaction.type, 1);
+    sha256_update(&m_hash_context, (uint8_t*) &m_transaction.p_indicated_start_addr, 4);
+    sha256_update(&m_hash_context, (uint8_t*) &m_transaction.length, 4);
+    uint8_t padding = 0;
+    sha256_update(&m_hash_context, &padding, 1);
+
+    switch (m_transaction.type)
+    {
+        case DFU_TYPE_APP:
+            sha256_update(&m_hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_APP);
+            break;
+        case DFU_TYPE_SD:
+            sha256_update(&m_hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_SD);
+            break;
+        case DFU_TYPE_BOOTLOADER:
+            sha256_update(&m_hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_BL);
+            break;
+        default:
+            break;
+    }
+
+    dfu_transfer_sha256_start(&m_hash_context);
+}
+
 static bool signature_check(void)
 {
     __LOG("Verifying signature... ");
@@ -304,36 +464,22 @@ static bool signature_check(void)
     }
 
     uint8_t hash[uECC_BYTES];
-    sha256_context_t hash_context;
-    sha256_init(&hash_context);
-    sha256_update(&hash_context, (uint8_t*) &m_transaction.type, 1);
-    sha256_update(&hash_context, (uint8_t*) &m_transaction.p_indicated_start_addr, 4);
-    sha256_update(&hash_context, (uint8_t*) &m_transaction.length, 4);
-    uint8_t padding = 0;
-    sha256_update(&hash_context, &padding, 1);
-
-    switch (m_transaction.type)
-    {
-        case DFU_TYPE_APP:
-            sha256_update(&hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_APP);
-            break;
-        case DFU_TYPE_SD:
-            sha256_update(&hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_SD);
-            break;
-        case DFU_TYPE_BOOTLOADER:
-            sha256_update(&hash_context, (uint8_t*) &m_transaction.target_fwid_union, DFU_FWID_LEN_BL);
-            break;
-        default:
-            break;
-    }
-
-    dfu_transfer_sha256(&hash_context);
+    /* the bank was hashed while it was written, only the tail is left. */
+    dfu_transfer_sha256(&m_hash_context);
 #if NORDIC_SDK_VERSION >= 11
-    sha256_final(&hash_context, hash, false);
+    sha256_final(&m_hash_context, hash, false);
 #else
-    sha256_final(&hash_context, hash);
+    sha256_final(&m_hash_context, hash);
+#endif
+#ifdef DFU_SIGNATURE_BENCHMARK
+    const uint32_t verify_start = NRF_RTC0->COUNTER;
 #endif
     bool success = (bool) (uECC_verify(m_bl_info_pointers.p_ecdsa_public_key, hash, m_transaction.signature));
+#ifdef DFU_SIGNATURE_BENCHMARK
+    /* RTC resolution, good to about 500 cycles on nRF51 and 2000 on nRF52. */
+    const uint32_t verify_ticks = (NRF_RTC0->COUNTER - verify_start) & RTC_MASK;
+    __LOG("(%d cycles) ", (uint32_t) (((uint64_t) verify_ticks * SystemCoreClock) / 32768ULL));
+#endif
     if (success)
     {
         __LOG("OK\n");
@@ -422,12 +568,182 @@ static void beacon_set(beacon_type_t type)
     }
 }
 
+#ifdef DFU_PACING
+static void pacing_reset(void)
+{
+    memset(&m_pacing, 0, sizeof(m_pacing));
+    m_pacing.repeats = TX_REPEATS_DATA;
+}
+
+/** Adjust the repeats at the end of each window. Lagging relays mean that the
+  air is busy, so we back off. Missing segments without a backlog mean that
+  the links are lossy, so we add redundancy. A clean window lets us drop a
+  repeat, which frees up the air for the next segments. */
+static void pacing_window_end(void)
+{
+    if (m_pacing.backlog > 0 || m_pacing.missing == 0)
+    {
+        if (m_pacing.repeats > DFU_PACING_REPEATS_MIN)
+        {
+            m_pacing.repeats--;
+        }
+    }
+    else if (m_pacing.repeats < DFU_PACING_REPEATS_MAX)
+    {
+        m_pacing.repeats++;
+    }
+    __LOG("Pacing: %u missing, %u late -> %u repeats\n",
+            m_pacing.missing, m_pacing.backlog, m_pacing.repeats);
+    m_pacing.window_segments = 0;
+    m_pacing.missing = 0;
+    m_pacing.backlog = 0;
+}
+
+/** Register a data packet of the transaction, new or one we've seen before. */
+static void pacing_data_rx(uint16_t segment, bool is_new)
+{
+    if (segment == 0)
+    {
+        return;
+    }
+    if (!is_new)
+    {
+        if (segment + DFU_PACING_BACKLOG_SEGMENTS < m_pacing.newest_segment &&
+            m_pacing.backlog < UINT16_MAX)
+        {
+            m_pacing.backlog++;
+        }
+    }
+    else if (segment > m_pacing.newest_segment)
+    {
+        m_pacing.newest_segment = segment;
+        if (++m_pacing.window_segments >= DFU_PACING_WINDOW)
+        {
+            pacing_window_end();
+        }
+    }
+}
+
+static void pacing_missing_rx(uint32_t count)
+{
+    m_pacing.missing = (m_pacing.missing + count > UINT16_MAX) ? UINT16_MAX : m_pacing.missing + count;
+}
+#endif
+
 static void relay_packet(dfu_packet_t* p_packet, uint16_t length)
 {
+#ifdef DFU_PACING
+    packet_tx_dynamic(p_packet, length, TX_INTERVAL_TYPE_DATA, m_pacing.repeats);
+#else
     packet_tx_dynamic(p_packet, length, TX_INTERVAL_TYPE_DATA, TX_REPEATS_DATA);
+#endif
     packet_cache_put(p_packet);
 }
 
+/** End our relay role in the transfer. */
+static void relay_end(void)
+{
+    if (m_transaction.p_cache_addr != NULL)
+    {
+        dfu_transfer_end();
+        m_transaction.p_cache_addr = NULL;
+    }
+    send_end_evt(DFU_END_SUCCESS);
+}
+
+#ifdef DFU_PROGRESS_BEACON
+static void progress_reset(void)
+{
+    memset(&m_progress, 0, sizeof(m_progress));
+}
+
+static void progress_tx(uint16_t missing, uint8_t age, uint8_t repeats)
+{
+    dfu_packet_t progress_packet;
+    progress_packet.packet_type = DFU_PACKET_TYPE_PROGRESS;
+    progress_packet.payload.progress.missing = missing;
+    progress_packet.payload.progress.transaction_id = m_transaction.transaction_id;
+    progress_packet.payload.progress.age = age;
+    packet_tx_dynamic(&progress_packet, DFU_PACKET_LEN_PROGRESS, TX_INTERVAL_TYPE_PROGRESS, repeats);
+}
+
+/** Report the merged progress, along with our own if we're a target. The
+  source ends the transfer once the whole network reports that it's done,
+  instead of waiting for the data timeout. */
+static void progress_report(void)
+{
+    uint16_t missing = m_progress.missing;
+    uint8_t age = m_progress.age;
+    if (m_state == DFU_STATE_TARGET && m_transaction.segments_remaining > missing)
+    {
+        missing = m_transaction.segments_remaining;
+    }
+    m_progress.missing = 0;
+    m_progress.age = 0;
+    m_progress.count = 0;
+
+    if (m_transaction.source)
+    {
+#ifdef RBC_MESH_SERIAL
+        dfu_packet_t progress_packet;
+        progress_packet.packet_type = DFU_PACKET_TYPE_PROGRESS;
+        progress_packet.payload.progress.missing = missing;
+        progress_packet.payload.progress.transaction_id = m_transaction.transaction_id;
+        progress_packet.payload.progress.age = age;
+        bl_evt_t tx_evt;
+        tx_evt.type = BL_EVT_TYPE_TX_SERIAL;
+        tx_evt.params.tx.serial.p_dfu_packet = &progress_packet;
+        tx_evt.params.tx.serial.length = DFU_PACKET_LEN_PROGRESS;
+        bootloader_evt_send(&tx_evt);
+#endif
+        if (missing == 0 && m_progress.data_done && m_state == DFU_STATE_RELAY)
+        {
+            __LOG("Network reports the transfer complete\n");
+            relay_end();
+        }
+    }
+    else if (age < DFU_PROGRESS_AGE_MAX)
+    {
+        progress_tx(missing, age + 1, TX_REPEATS_PROGRESS);
+    }
+}
+
+static void handle_progress_packet(dfu_packet_t* p_packet)
+{
+    if (p_packet->payload.progress.transaction_id != m_transaction.transaction_id ||
+        (m_state != DFU_STATE_TARGET && m_state != DFU_STATE_RELAY))
+    {
+        return;
+    }
+    if (p_packet->payload.progress.missing > m_progress.missing)
+    {
+        m_progress.missing = p_packet->payload.progress.missing;
+    }
+    if (p_packet->payload.progress.age > m_progress.age)
+    {
+        m_progress.age = p_packet->payload.progress.age;
+    }
+    m_progress.heard = true;
+    if (++m_progress.count >= DFU_PROGRESS_WINDOW)
+    {
+        progress_report();
+    }
+}
+
+/** Report our own progress as a target whenever it passes a step. */
+static void progress_target_update(uint16_t previous_remaining)
+{
+    if (m_transaction.segments_remaining == 0)
+    {
+        progress_tx(0, 0, TX_REPEATS_PROGRESS_DONE);
+    }
+    else if (previous_remaining / DFU_PROGRESS_STEP != m_transaction.segments_remaining / DFU_PROGRESS_STEP)
+    {
+        progress_report();
+    }
+}
+#endif
+
 static void send_bank_notifications(void)
 {
     const bl_info_type_t bank_types[] =
@@ -470,6 +786,11 @@ static void send_bank_notifications(void)
 /********** STATE MACHINE ENTRY POINTS ***********/
 static void start_find_fwid(void)
 {
+    if (m_transaction.p_cache_addr != NULL)
+    {
+        /* an aborted relay leaves its cache transfer behind */
+        dfu_transfer_end();
+    }
     beacon_set(BEACON_TYPE_FWID);
     SET_STATE(DFU_STATE_FIND_FWID);
     memset(&m_transaction, 0, sizeof(transaction_t));
@@ -509,6 +830,57 @@ static void start_ready(dfu_packet_t* p_ready_packet)
     beacon_set(state_beacon_type(m_transaction.type));
 }
 
+/** Get the section a transfer of the given type goes into. */
+static bl_info_segment_t* type_segment_get(dfu_type_t type)
+{
+    switch (type)
+    {
+        case DFU_TYPE_APP:
+            return m_bl_info_pointers.p_segment_app;
+        case DFU_TYPE_SD:
+            return m_bl_info_pointers.p_segment_sd;
+        case DFU_TYPE_BOOTLOADER:
+            return m_bl_info_pointers.p_segment_bl;
+        default:
+            APP_ERROR_CHECK(NRF_ERROR_NOT_SUPPORTED);
+            return NULL;
+    }
+}
+
+/** Invalidate the info of all banks overlapping with the given area, and
+  return the address of the first bank. */
+static uint32_t* overlapping_banks_invalidate(uint32_t* p_addr, uint32_t length)
+{
+    const bl_info_entry_t* p_banks[] =
+    {
+        bootloader_info_entry_get(BL_INFO_TYPE_BANK_SD),
+        bootloader_info_entry_get(BL_INFO_TYPE_BANK_BL),
+        bootloader_info_entry_get(BL_INFO_TYPE_BANK_APP),
+    };
+    uint32_t* p_first_bank = (uint32_t*) 0xFFFFFFFF;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        /* if a bank is overlapping, we should erase info pointing to it. */
+        if (p_banks[i])
+        {
+            if (section_overlap(
+                (uint32_t) p_banks[i]->bank.p_bank_addr, 
+                p_banks[i]->bank.length, 
+                (uint32_t) p_addr, 
+                length))
+            {
+                __LOG("Invalidate bank type %s (%d)\n", m_dfu_type_strs[(1 << i)], i);
+                APP_ERROR_CHECK(bootloader_info_entry_invalidate((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + (1 << i))));
+            }
+            if (p_banks[i]->bank.p_bank_addr < p_first_bank)
+            {
+                p_first_bank = p_banks[i]->bank.p_bank_addr;
+            }
+        }
+    }
+    return p_first_bank;
+}
+
 static void start_target(void)
 {
     SET_STATE(DFU_STATE_TARGET);
@@ -532,33 +904,7 @@ static void start_target(void)
     if (m_transaction.p_bank_addr != m_transaction.p_start_addr)
     {
         /* check whether we're destroying some bank: */
-        const bl_info_entry_t* p_banks[] =
-        {
-            bootloader_info_entry_get(BL_INFO_TYPE_BANK_SD),
-            bootloader_info_entry_get(BL_INFO_TYPE_BANK_BL),
-            bootloader_info_entry_get(BL_INFO_TYPE_BANK_APP),
-        };
-        uint32_t* p_first_bank = (uint32_t*) 0xFFFFFFFF;
-        for (uint32_t i = 0; i < 3; ++i)
-        {
-            /* if a bank is overlapping, we should erase info pointing to it. */
-            if (p_banks[i])
-            {
-                if (section_overlap(
-                    (uint32_t) p_banks[i]->bank.p_bank_addr, 
-                    p_banks[i]->bank.length, 
-                    (uint32_t) m_transaction.p_bank_addr, 
-                    m_transaction.length))
-                {
-                    __LOG("Invalidate bank type %s (%d)\n", m_dfu_type_strs[(1 << i)], i);
-                    APP_ERROR_CHECK(bootloader_info_entry_invalidate((bl_info_type_t) (BL_INFO_TYPE_BANK_BASE + (1 << i))));
-                }
-                if (p_banks[i]->bank.p_bank_addr < p_first_bank)
-                {
-                    p_first_bank = p_banks[i]->bank.p_bank_addr;
-                }
-            }
-        }
+        uint32_t* p_first_bank = overlapping_banks_invalidate(m_transaction.p_bank_addr, m_transaction.length);
 
         /* Look for any section data inside the new bank-section. If found, we
            are about to invalidate the application, and should mark it. Don't
@@ -610,8 +956,14 @@ static void start_target(void)
                 m_transaction.p_start_addr,
                 m_transaction.p_bank_addr,
                 m_transaction.length,
+                m_transaction.segment_size,
                 m_transaction.segment_is_valid_after_transfer) == NRF_SUCCESS)
     {
+        if (m_bl_info_pointers.p_ecdsa_public_key != NULL)
+        {
+            signature_hash_start();
+        }
+
         bl_evt_t abort_evt;
         abort_evt.type = BL_EVT_TYPE_TX_ABORT;
         abort_evt.params.tx.abort.tx_slot = TX_SLOT_BEACON;
@@ -642,23 +994,27 @@ static void start_rampdown(void)
 }
 
 /*************** Packet handlers ******************/
-static void target_rx_start(dfu_packet_t* p_packet, bool* p_do_relay)
+/** Check whether we can build the image of a delta transfer from the current application. */
+static bool diff_is_applicable(dfu_packet_t* p_packet, uint16_t length)
 {
-    bl_info_segment_t* p_segment = NULL;
-    switch (m_transaction.type)
+    if (m_transaction.type != DFU_TYPE_APP ||
+        length < DFU_PACKET_LEN_START_DIFF ||
+        m_bl_info_pointers.p_fwid == NULL ||
+        m_bl_info_pointers.p_fwid->app.app_version != p_packet->payload.start.base_app_version)
     {
-        case DFU_TYPE_APP:
-            p_segment = m_bl_info_pointers.p_segment_app;
-            break;
-        case DFU_TYPE_SD:
-            p_segment = m_bl_info_pointers.p_segment_sd;
-            break;
-        case DFU_TYPE_BOOTLOADER:
-            p_segment = m_bl_info_pointers.p_segment_bl;
-            break;
-        default:
-            APP_ERROR_CHECK(NRF_ERROR_NOT_SUPPORTED);
+        return false;
+    }
+    if (m_bl_info_pointers.p_flags != NULL && !m_bl_info_pointers.p_flags->app_intact)
+    {
+        return false;
     }
+    /* The current application is the source, it can't be overwritten during the transfer. */
+    return (m_transaction.p_bank_addr != m_transaction.p_start_addr);
+}
+
+static void target_rx_start(dfu_packet_t* p_packet, uint16_t length, bool* p_do_relay)
+{
+    bl_info_segment_t* p_segment = type_segment_get(m_transaction.type);
 
     m_transaction.p_indicated_start_addr = (uint32_t*) p_packet->payload.start.start_address;
     uint32_t start_address = p_packet->payload.start.start_address;
@@ -670,24 +1026,32 @@ static void target_rx_start(dfu_packet_t* p_packet, bool* p_do_relay)
     uint32_t segment_count = segment_count_from_start_packet(p_packet);
 
     m_transaction.segments_remaining                = segment_count;
+    m_transaction.segment_size                      = p_packet->payload.start.segment_size;
     m_transaction.segment_count                     = segment_count;
     m_transaction.p_start_addr                      = (uint32_t*) start_address;
     m_transaction.length                            = p_packet->payload.start.length * 4;
     m_transaction.signature_length                  = p_packet->payload.start.signature_length;
     m_transaction.segment_is_valid_after_transfer   = p_packet->payload.start.last;
-    m_transaction.p_last_requested_entry            = NULL;
     m_transaction.signature_bitmap                  = 0;
+    m_transaction.diff                              = p_packet->payload.start.diff;
+    m_data_req.last_segment                         = DATA_REQ_SEGMENT_NONE;
 
     /* Reset all transfer specific caches. */
     memset(m_req_cache, 0, REQ_CACHE_SIZE * sizeof(m_req_cache[0]));
     packet_cache_flush();
+#ifdef DFU_PARITY
+    m_parity.first_segment = 0;
+#endif
 
-    /* If no bank was specified, we either have to do it single-banked or find a bank */
+    /* If no bank was specified, we either have to do it single-banked or find
+       a bank. The running application can't be written over, so transfers
+       received in the application always get a bank, and are flashed in a
+       swap through the bootloader once they've been verified. */
     if (m_transaction.p_bank_addr == (uint32_t*) 0xFFFFFFFF)
     {
-        if (m_transaction.type == DFU_TYPE_BOOTLOADER)
+        if (m_transaction.type == DFU_TYPE_BOOTLOADER || bootloader_is_in_application())
         {
-            __LOG("Placing BL bank at end of application segment.\n");
+            __LOG("Placing bank at end of application segment.\n");
             uint32_t upper_limit =
                 (m_bl_info_pointers.p_segment_app->start) +
                 (m_bl_info_pointers.p_segment_app->length);
@@ -728,17 +1092,34 @@ static void target_rx_start(dfu_packet_t* p_packet, bool* p_do_relay)
 
     __LOG("Set transaction parameters:\n");
     __LOG("\ttype:       %s\n", m_dfu_type_strs[(uint32_t) m_transaction.type]);
-    __LOG("\tsegments:   %u\n", segment_count);
+    __LOG("\tsegments:   %u (%u bytes)\n", segment_count, DFU_SEGMENT_LENGTH(m_transaction.segment_size));
     __LOG("\tstart addr: 0x%x\n", start_address);
     __LOG("\tbank addr:  0x%x\n", m_transaction.p_bank_addr);
     __LOG("\tlength:     %u\n", m_transaction.length);
     __LOG("\tsigned:     %s\n", m_transaction.signature_length > 0 ? "YES" : "NO");
+    __LOG("\tdelta:      %s\n", m_transaction.diff ? "YES" : "NO");
 
-    if ((uint32_t) m_transaction.p_start_addr >= p_segment->start &&
+    if (m_transaction.segment_size > DFU_SEGMENT_SIZE_MAX)
+    {
+        __LOG(RTT_CTRL_TEXT_RED "ERROR: Segments are too long.\n");
+        tid_cache_entry_put(p_packet->payload.start.transaction_id);
+        start_req(m_transaction.type, &m_transaction.target_fwid_union);
+    }
+    else if (m_transaction.diff && !diff_is_applicable(p_packet, length))
+    {
+        __LOG(RTT_CTRL_TEXT_RED "ERROR: Delta doesn't apply to the current application.\n");
+        tid_cache_entry_put(p_packet->payload.start.transaction_id);
+        start_req(m_transaction.type, &m_transaction.target_fwid_union);
+    }
+    else if ((uint32_t) m_transaction.p_start_addr >= p_segment->start &&
         (uint32_t) m_transaction.p_start_addr + m_transaction.length <= p_segment->start + p_segment->length)
     {
         start_target();
         *p_do_relay = true;
+#ifdef DFU_PROGRESS_BEACON
+        progress_reset();
+        progress_tx(m_transaction.segments_remaining, 0, TX_REPEATS_PROGRESS);
+#endif
     }
     else
     {
@@ -748,37 +1129,148 @@ static void target_rx_start(dfu_packet_t* p_packet, bool* p_do_relay)
     }
 }
 
+/** Request the missing segments before the given one, in a single request. */
+static void data_req_send(uint16_t rx_segment)
+{
+    /* don't request the previous packet yet */
+    uint16_t segment_limit = (m_transaction.segment_count == rx_segment) ? rx_segment + 1 : rx_segment - 1;
+    dfu_packet_t req_packet;
+    uint16_t first_segment;
+    uint32_t missing_count = dfu_transfer_get_missing_bitmap(
+            m_transaction.p_start_addr,
+            segment_limit,
+            &first_segment,
+            req_packet.payload.req_data_bitmap.bitmap,
+            DFU_REQ_BITMAP_LEN);
+
+    if (missing_count == 0)
+    {
+        return;
+    }
+
+    m_data_req.last_segment = first_segment;
+    m_data_req.rx_count = 0;
+    req_packet.payload.req_data_bitmap.segment = first_segment;
+    req_packet.payload.req_data_bitmap.transaction_id = m_transaction.transaction_id;
+    if (missing_count == 1)
+    {
+        /* Plain request, understood by all versions. */
+        req_packet.packet_type = DFU_PACKET_TYPE_DATA_REQ;
+        packet_tx_dynamic(&req_packet, DFU_PACKET_LEN_DATA_REQ, TX_INTERVAL_TYPE_REQ, TX_REPEATS_REQ);
+    }
+    else
+    {
+        req_packet.packet_type = DFU_PACKET_TYPE_DATA_REQ_BITMAP;
+        for (uint32_t i = 0; i < DATA_REQ_BITMAP_BITS; ++i)
+        {
+            if (req_packet.payload.req_data_bitmap.bitmap[i / 8] & (1 << (i & 0x07)))
+            {
+                m_data_req.last_segment = first_segment + 1 + i;
+            }
+        }
+        packet_tx_dynamic(&req_packet, DFU_PACKET_LEN_DATA_REQ_BITMAP, TX_INTERVAL_TYPE_REQ, TX_REPEATS_REQ);
+    }
+    __LOG("TX REQ FOR 0x%x-0x%x (%u)\n", first_segment, m_data_req.last_segment, missing_count);
+}
+
+/** Check whether we've lost any entries, and request them. Gives up on the
+  outstanding request if its last segment doesn't show up in time. */
+static void data_req_check(uint16_t rx_segment)
+{
+    if (m_data_req.last_segment != DATA_REQ_SEGMENT_NONE &&
+        m_data_req.rx_count++ >= REQ_RX_COUNT_RETRY)
+    {
+        m_data_req.last_segment = DATA_REQ_SEGMENT_NONE;
+    }
+    if (m_data_req.last_segment == DATA_REQ_SEGMENT_NONE)
+    {
+        data_req_send(rx_segment);
+    }
+}
+
+/** Fill a run of segments from the current application in a delta transfer. */
+static uint32_t target_rx_copy(dfu_packet_t* p_packet)
+{
+    const uint16_t data_segments = data_segment_count();
+    const uint16_t segment_first = p_packet->payload.copy.segment;
+    const uint16_t segment_count = p_packet->payload.copy.segment_count;
+    const uint16_t segment_last = segment_first + segment_count - 1;
+    if (segment_first == 0 ||
+        segment_count == 0 ||
+        segment_count > DFU_COPY_SEGMENTS_MAX ||
+        segment_last > data_segments)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    uint32_t* p_addr = addr_from_seg(segment_first, m_transaction.p_start_addr, m_transaction.segment_size);
+    uint32_t end_addr = (uint32_t) m_transaction.p_start_addr + m_transaction.length;
+    if (segment_last < data_segments)
+    {
+        end_addr = (uint32_t) addr_from_seg(segment_last + 1, m_transaction.p_start_addr, m_transaction.segment_size);
+    }
+    uint32_t length = end_addr - (uint32_t) p_addr;
+
+    /* The source must be inside the current application, and not in the bank we're filling. */
+    uint32_t src_addr = p_packet->payload.copy.src_addr;
+    if (src_addr < m_bl_info_pointers.p_segment_app->start ||
+        src_addr + length > m_bl_info_pointers.p_segment_app->start + m_bl_info_pointers.p_segment_app->length ||
+        section_overlap(src_addr, length, (uint32_t) m_transaction.p_bank_addr, m_transaction.length))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint32_t error_code = dfu_transfer_copy((uint32_t) p_addr, (const uint32_t*) src_addr, length);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    if (m_data_req.last_segment >= segment_first &&
+        m_data_req.last_segment <= segment_last)
+    {
+        m_data_req.last_segment = DATA_REQ_SEGMENT_NONE;
+    }
+    send_progress_event(segment_last, m_transaction.segment_count);
+    m_transaction.segments_remaining -= segment_count;
+#ifdef DFU_PROGRESS_BEACON
+    progress_target_update(m_transaction.segments_remaining + segment_count);
+#endif
+    data_req_check(segment_last);
+    return NRF_SUCCESS;
+}
+
 static uint32_t target_rx_data(dfu_packet_t* p_packet, uint16_t length, bool* p_do_relay)
 {
     uint32_t* p_addr = NULL;
     uint32_t error_code = NRF_ERROR_NULL;
 
-    if (p_packet->payload.data.segment <=
-            m_transaction.segment_count - m_transaction.signature_length / SEGMENT_LENGTH)
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transaction.segment_size);
+    if (p_packet->payload.data.segment <= data_segment_count())
     {
-        if (m_data_req_segment == p_packet->payload.data.segment)
+        if (m_data_req.last_segment == p_packet->payload.data.segment)
         {
-            m_data_req_segment = DATA_REQ_SEGMENT_NONE;
+            m_data_req.last_segment = DATA_REQ_SEGMENT_NONE;
         }
-        p_addr = addr_from_seg(p_packet->payload.data.segment, m_transaction.p_start_addr);
+        p_addr = addr_from_seg(p_packet->payload.data.segment, m_transaction.p_start_addr, m_transaction.segment_size);
         error_code = dfu_transfer_data((uint32_t) p_addr,
                 p_packet->payload.data.data,
-                length - (DFU_PACKET_LEN_DATA - SEGMENT_LENGTH));
+                length - DFU_PACKET_LEN_DATA_HEADER);
     }
     else /* treat signature packets at the end */
     {
-        uint32_t index = p_packet->payload.data.segment -
-            (m_transaction.segment_count - m_transaction.signature_length / SEGMENT_LENGTH) - 1;
-        if (index >= m_transaction.signature_length / SEGMENT_LENGTH ||
+        uint32_t index = p_packet->payload.data.segment - data_segment_count() - 1;
+        if (index >= (m_transaction.signature_length >> DFU_SEGMENT_SHIFT(m_transaction.segment_size)) ||
+                length - DFU_PACKET_LEN_DATA_HEADER > segment_length ||
                 m_transaction.signature_bitmap & (1 << index))
         {
             error_code = NRF_ERROR_INVALID_STATE;
         }
         else
         {
-            memcpy(&m_transaction.signature[index * SEGMENT_LENGTH],
+            memcpy(&m_transaction.signature[index * segment_length],
                     p_packet->payload.data.data,
-                    length - (DFU_PACKET_LEN_DATA - SEGMENT_LENGTH));
+                    length - DFU_PACKET_LEN_DATA_HEADER);
 
             __LOG("Signature packet #%u\n", index);
             m_transaction.signature_bitmap |= (1 << index);
@@ -792,37 +1284,134 @@ static uint32_t target_rx_data(dfu_packet_t* p_packet, uint16_t length, bool* p_
     }
     send_progress_event(p_packet->payload.data.segment, m_transaction.segment_count);
     m_transaction.segments_remaining--;
+#ifdef DFU_PROGRESS_BEACON
+    progress_target_update(m_transaction.segments_remaining + 1);
+#endif
     *p_do_relay = true;
-    /* check whether we've lost any entries, and request them */
-    uint32_t* p_req_entry = NULL;
-    uint32_t req_entry_len = 0;
-
-    if (m_data_req_segment == DATA_REQ_SEGMENT_NONE)
-    {
-        if (dfu_transfer_get_oldest_missing_entry(
-                    m_transaction.p_last_requested_entry,
-                    &p_req_entry,
-                    &req_entry_len) &&
-                (
-                 /* don't request the previous packet yet */
-                 ADDR_SEGMENT(p_req_entry, m_transaction.p_start_addr) < p_packet->payload.data.segment - 1 ||
-                 m_transaction.segment_count == p_packet->payload.data.segment
-                )
-           )
+    data_req_check(p_packet->payload.data.segment);
+    return error_code;
+}
+
+/** Start keeping a copy of the relayed transfer, so that we can answer
+  requests for it. */
+static void relay_cache_start(dfu_packet_t* p_packet)
+{
+    uint32_t start_address = p_packet->payload.start.start_address;
+    if (start_address == START_ADDRESS_UNKNOWN)
+    {
+        start_address = type_segment_get(m_transaction.type)->start;
+    }
+    m_transaction.p_start_addr      = (uint32_t*) start_address;
+    m_transaction.length            = p_packet->payload.start.length * 4;
+    m_transaction.signature_length  = p_packet->payload.start.signature_length;
+    m_transaction.segment_size      = p_packet->payload.start.segment_size;
+
+    if ((uint32_t) m_transaction.p_cache_addr + m_transaction.length > BOOTLOADERADDR() ||
+        section_overlap(start_address, m_transaction.length,
+                        (uint32_t) m_transaction.p_cache_addr, m_transaction.length))
+    {
+        __LOG(RTT_CTRL_TEXT_RED "ERROR: Relay cache doesn't fit.\n");
+        m_transaction.p_cache_addr = NULL;
+        return;
+    }
+
+    (void) overlapping_banks_invalidate(m_transaction.p_cache_addr, m_transaction.length);
+    memset(m_req_cache, 0, REQ_CACHE_SIZE * sizeof(m_req_cache[0]));
+    if (dfu_transfer_cache_start(m_transaction.p_start_addr,
+                m_transaction.p_cache_addr,
+                m_transaction.length,
+                m_transaction.segment_size) != NRF_SUCCESS)
+    {
+        m_transaction.p_cache_addr = NULL;
+    }
+}
+
+/** Store a relayed segment in the relay cache, if we keep one. */
+static void relay_cache_store(dfu_packet_t* p_packet, uint16_t length)
+{
+    if (m_transaction.p_cache_addr == NULL)
+    {
+        return;
+    }
+    if (p_packet->payload.data.segment == 0)
+    {
+        /* the start packet is repeated, only set up the cache once. */
+        if (m_transaction.p_start_addr == NULL)
         {
-            dfu_packet_t req_packet;
-            req_packet.packet_type = DFU_PACKET_TYPE_DATA_REQ;
-            req_packet.payload.req_data.segment = ADDR_SEGMENT(p_req_entry, m_transaction.p_start_addr);
-            req_packet.payload.req_data.transaction_id = m_transaction.transaction_id;
-
-            packet_tx_dynamic(&req_packet, DFU_PACKET_LEN_DATA_REQ, TX_INTERVAL_TYPE_REQ, TX_REPEATS_REQ);
-            m_transaction.p_last_requested_entry = (uint32_t*) p_req_entry;
-            m_data_req_segment = req_packet.payload.req_data.segment;
-            __LOG("TX REQ FOR 0x%x\n", m_data_req_segment);
+            relay_cache_start(p_packet);
+        }
+    }
+    else if (m_transaction.p_start_addr != NULL &&
+             p_packet->payload.data.segment <= data_segment_count())
+    {
+        /* best effort, the segment is relayed no matter what. */
+        (void) dfu_transfer_data(
+                (uint32_t) addr_from_seg(p_packet->payload.data.segment, m_transaction.p_start_addr, m_transaction.segment_size),
+                p_packet->payload.data.data,
+                length - DFU_PACKET_LEN_DATA_HEADER);
+    }
+}
+
+/** Check whether the relay cache can answer a request for the given segment. */
+static bool relay_cache_has_entry(uint16_t segment)
+{
+    return (m_transaction.p_cache_addr != NULL &&
+            m_transaction.p_start_addr != NULL &&
+            dfu_transfer_has_entry(addr_from_seg(segment, m_transaction.p_start_addr, m_transaction.segment_size), NULL, 0));
+}
+
+#ifdef DFU_PARITY
+/** Add a segment we've accepted or relayed to the parity group it belongs to,
+  and send the group's parity packet once it's complete. Segments are expected
+  to arrive roughly in order, a group is dropped when a newer one starts. */
+static void parity_accumulate(dfu_packet_t* p_packet, uint16_t length)
+{
+    uint16_t segment = p_packet->payload.data.segment;
+    uint16_t first_segment = PARITY_GROUP_FIRST(segment);
+    if (first_segment != m_parity.first_segment)
+    {
+        m_parity.first_segment = first_segment;
+        m_parity.received = 0;
+        memset(m_parity.data, 0, DFU_SEGMENT_LENGTH_MAX);
+    }
+
+    uint32_t bit = (1UL << (segment - first_segment));
+    if (m_parity.received & bit)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < length - DFU_PACKET_LEN_DATA_HEADER && i < DFU_SEGMENT_LENGTH_MAX; ++i)
+    {
+        m_parity.data[i] ^= p_packet->payload.data.data[i];
+    }
+    m_parity.received |= bit;
+
+    /* The last group is cut short by the end of the transfer. */
+    uint32_t group_size = DFU_PARITY_GROUP_SIZE;
+    if (m_transaction.segment_count != 0 &&
+        first_segment + DFU_PARITY_GROUP_SIZE - 1 > m_transaction.segment_count)
+    {
+        group_size = m_transaction.segment_count - first_segment + 1;
+    }
+
+    if (m_parity.received == (uint32_t) ((1ULL << group_size) - 1))
+    {
+        dfu_packet_t parity_packet;
+        parity_packet.packet_type = DFU_PACKET_TYPE_DATA_PARITY;
+        parity_packet.payload.parity.segment = first_segment;
+        parity_packet.payload.parity.transaction_id = m_transaction.transaction_id;
+        memcpy(parity_packet.payload.parity.data, m_parity.data, DFU_SEGMENT_LENGTH(m_transaction.segment_size));
+        m_parity.first_segment = 0;
+
+        /* Someone else may have beaten us to it. */
+        if (!packet_in_cache(&parity_packet))
+        {
+            __LOG("TX PARITY 0x%x\n", first_segment);
+            relay_packet(&parity_packet, DFU_PACKET_LEN_DATA_HEADER + DFU_SEGMENT_LENGTH(m_transaction.segment_size));
         }
     }
-    return error_code;
 }
+#endif
 
 static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
 {
@@ -832,8 +1421,24 @@ static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
     }
     if (packet_in_cache(p_packet))
     {
+#ifdef DFU_PACING
+        pacing_data_rx(p_packet->payload.data.segment, false);
+#endif
         return;
     }
+#ifdef DFU_PACING
+    if (p_packet->payload.data.segment == 0)
+    {
+        pacing_reset();
+    }
+    pacing_data_rx(p_packet->payload.data.segment, true);
+#endif
+#ifdef DFU_PROGRESS_BEACON
+    if (p_packet->payload.data.segment == 0)
+    {
+        progress_reset();
+    }
+#endif
     
     bool do_relay = false;
 
@@ -842,7 +1447,7 @@ static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
         case DFU_STATE_READY:
             if (p_packet->payload.start.segment == 0)
             {
-                target_rx_start(p_packet, &do_relay);
+                target_rx_start(p_packet, length, &do_relay);
             }
             else
             {
@@ -872,7 +1477,9 @@ static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
             if (p_packet->payload.data.segment == 0)
             {
                 m_transaction.segment_count = segment_count_from_start_packet(p_packet);
+                m_transaction.segment_size = p_packet->payload.start.segment_size;
             }
+            relay_cache_store(p_packet, length);
             SET_STATE(DFU_STATE_RELAY);
             tx_abort(TX_SLOT_BEACON);
             bl_evt_t relay_evt;
@@ -889,7 +1496,9 @@ static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
             if (p_packet->payload.data.segment == 0)
             {
                 m_transaction.segment_count = segment_count_from_start_packet(p_packet);
+                m_transaction.segment_size = p_packet->payload.start.segment_size;
             }
+            relay_cache_store(p_packet, length);
             send_progress_event(p_packet->payload.data.segment, m_transaction.segment_count);
             do_relay = true;
             break;
@@ -901,6 +1510,43 @@ static void handle_data_packet(dfu_packet_t* p_packet, uint16_t length)
     if (do_relay)
     {
         relay_packet(p_packet, length);
+#ifdef DFU_PARITY
+        if (p_packet->payload.data.segment > 0)
+        {
+            parity_accumulate(p_packet, length);
+        }
+#endif
+    }
+}
+
+static void handle_data_copy_packet(dfu_packet_t* p_packet)
+{
+    if (p_packet->payload.copy.transaction_id != m_transaction.transaction_id ||
+        packet_in_cache(p_packet))
+    {
+        return;
+    }
+
+    switch (m_state)
+    {
+        case DFU_STATE_TARGET:
+            /* Failed copies aren't cached, so that a repeated packet can retry. */
+            if (m_transaction.diff && target_rx_copy(p_packet) == NRF_SUCCESS)
+            {
+                relay_packet(p_packet, DFU_PACKET_LEN_DATA_COPY);
+            }
+            if (m_transaction.segments_remaining == 0)
+            {
+                start_rampdown();
+            }
+            break;
+
+        case DFU_STATE_RELAY:
+            relay_packet(p_packet, DFU_PACKET_LEN_DATA_COPY);
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -1009,10 +1655,30 @@ static void handle_state_packet(dfu_packet_t* p_packet)
 
 }
 
+#ifdef DFU_TRICKLE_BEACON
+/** Whether the given FWID runs another version of our bootloader or app. */
+static bool fwid_is_inconsistent(fwid_t* p_fwid)
+{
+    const fwid_t* p_own = m_bl_info_pointers.p_fwid;
+    return ((p_fwid->bootloader.id == p_own->bootloader.id &&
+             p_fwid->bootloader.ver != p_own->bootloader.ver) ||
+            (p_fwid->app.company_id == p_own->app.company_id &&
+             p_fwid->app.app_id == p_own->app.app_id &&
+             p_fwid->app.app_version != p_own->app.app_version));
+}
+#endif
+
 static void handle_fwid_packet(dfu_packet_t* p_packet)
 {
     if (m_state == DFU_STATE_FIND_FWID)
     {
+#ifdef DFU_TRICKLE_BEACON
+        /* Restart the beacon interval, so that outdated nodes find us quickly. */
+        if (fwid_is_inconsistent(&p_packet->payload.fwid))
+        {
+            beacon_set(BEACON_TYPE_FWID);
+        }
+#endif
         /* always upgrade bootloader first */
         if (bootloader_is_newer(p_packet->payload.fwid.bootloader))
         {
@@ -1052,12 +1718,66 @@ static void handle_fwid_packet(dfu_packet_t* p_packet)
     }
 }
 
+/** Respond to a request for the given segment, unless we did so recently.
+  Returns whether a response was sent. */
+static bool data_req_serve(uint16_t segment)
+{
+    req_cache_entry_t* p_req_entry = NULL;
+    /* check that we haven't served this request recently. */
+    for (uint32_t i = 0; i < REQ_CACHE_SIZE; ++i)
+    {
+        if (m_req_cache[i].segment == segment)
+        {
+            if (m_req_cache[i].rx_count++ < REQ_RX_COUNT_RETRY)
+            {
+                return false;
+            }
+            p_req_entry = &m_req_cache[i];
+            break;
+        }
+    }
+    /* serve request */
+    bool served = false;
+    dfu_packet_t dfu_rsp;
+    if (
+        dfu_transfer_has_entry(
+            (uint32_t*) SEGMENT_ADDR(segment, m_transaction.p_start_addr, m_transaction.segment_size),
+            dfu_rsp.payload.rsp_data.data, DFU_SEGMENT_LENGTH(m_transaction.segment_size))
+       )
+    {
+        dfu_rsp.packet_type = DFU_PACKET_TYPE_DATA_RSP;
+        dfu_rsp.payload.rsp_data.segment = segment;
+        dfu_rsp.payload.rsp_data.transaction_id = m_transaction.transaction_id;
+
+        packet_tx_dynamic(&dfu_rsp,
+                DFU_PACKET_LEN_DATA_HEADER + DFU_SEGMENT_LENGTH(m_transaction.segment_size),
+                TX_INTERVAL_TYPE_RSP, TX_REPEATS_RSP);
+        served = true;
+    }
+
+    /* log our attempt at responding */
+    if (!p_req_entry)
+    {
+        p_req_entry = &m_req_cache[(m_req_index++) & (REQ_CACHE_SIZE - 1)];
+        p_req_entry->segment = segment;
+    }
+    p_req_entry->rx_count = 0;
+    return served;
+}
+
 static void handle_data_req_packet(dfu_packet_t* p_packet)
 {
     if (p_packet->payload.data.transaction_id == m_transaction.transaction_id)
     {
         __LOG("RX data REQ #%u\n", p_packet->payload.data.segment);
-        if (m_state == DFU_STATE_RELAY)
+#ifdef DFU_PACING
+        if (!packet_in_cache(p_packet))
+        {
+            pacing_missing_rx(1);
+        }
+#endif
+        if (m_state == DFU_STATE_RELAY &&
+            !relay_cache_has_entry(p_packet->payload.req_data.segment))
         {
             /* only relay new packets, look for it in cache */
             if (!packet_in_cache(p_packet))
@@ -1067,48 +1787,65 @@ static void handle_data_req_packet(dfu_packet_t* p_packet)
         }
         else
         {
-            req_cache_entry_t* p_req_entry = NULL;
-            /* check that we haven't served this request recently. */
-            for (uint32_t i = 0; i < REQ_CACHE_SIZE; ++i)
+            (void) data_req_serve(p_packet->payload.req_data.segment);
+        }
+    }
+}
+
+static void handle_data_req_bitmap_packet(dfu_packet_t* p_packet)
+{
+    if (p_packet->payload.req_data_bitmap.transaction_id == m_transaction.transaction_id)
+    {
+        __LOG("RX data REQ bitmap #%u\n", p_packet->payload.req_data_bitmap.segment);
+#ifdef DFU_PACING
+        if (!packet_in_cache(p_packet))
+        {
+            uint32_t missing = 1;
+            for (uint32_t i = 0; i < DATA_REQ_BITMAP_BITS; ++i)
             {
-                if (m_req_cache[i].segment == p_packet->payload.req_data.segment)
-                {
-                    if (m_req_cache[i].rx_count++ < REQ_RX_COUNT_RETRY)
-                    {
-                        return;
-                    }
-                    p_req_entry = &m_req_cache[i];
-                    break;
-                }
+                missing += !!(p_packet->payload.req_data_bitmap.bitmap[i / 8] & (1 << (i & 0x07)));
             }
-            /* serve request */
-            dfu_packet_t dfu_rsp;
-            if (
-                dfu_transfer_has_entry(
-                    (uint32_t*) SEGMENT_ADDR(p_packet->payload.req_data.segment, m_transaction.p_start_addr),
-                    dfu_rsp.payload.rsp_data.data, SEGMENT_LENGTH)
-               )
+            pacing_missing_rx(missing);
+        }
+#endif
+        if (m_state == DFU_STATE_RELAY &&
+            !relay_cache_has_entry(p_packet->payload.req_data_bitmap.segment))
+        {
+            /* only relay new packets, look for it in cache */
+            if (!packet_in_cache(p_packet))
             {
-                dfu_rsp.packet_type = DFU_PACKET_TYPE_DATA_RSP;
-                dfu_rsp.payload.rsp_data.segment = p_packet->payload.req_data.segment;
-                dfu_rsp.payload.rsp_data.transaction_id = p_packet->payload.req_data.transaction_id;
-
-                packet_tx_dynamic(&dfu_rsp, DFU_PACKET_LEN_DATA_RSP, TX_INTERVAL_TYPE_RSP, TX_REPEATS_RSP);
+                relay_packet(p_packet, DFU_PACKET_LEN_DATA_REQ_BITMAP);
             }
-
-            /* log our attempt at responding */
-            if (!p_req_entry)
+        }
+        else
+        {
+            /* Answer with a burst, limited by the TX slots we can fill without
+               overwriting our own responses. Slot 0 is reserved for the beacon.
+               The relay cache may not hold everything, the segments it can't
+               serve will be requested again. */
+            uint32_t rsp_count = 0;
+            if (data_req_serve(p_packet->payload.req_data_bitmap.segment))
+            {
+                rsp_count++;
+            }
+            for (uint32_t i = 0; i < DATA_REQ_BITMAP_BITS && rsp_count < m_tx_slots - 1u; ++i)
             {
-                p_req_entry = &m_req_cache[(m_req_index++) & (REQ_CACHE_SIZE - 1)];
-                p_req_entry->segment = p_packet->payload.req_data.segment;
+                if ((p_packet->payload.req_data_bitmap.bitmap[i / 8] & (1 << (i & 0x07))) &&
+                    data_req_serve(p_packet->payload.req_data_bitmap.segment + 1 + i))
+                {
+                    rsp_count++;
+                }
             }
-            p_req_entry->rx_count = 0;
         }
     }
 }
 
 static void handle_data_rsp_packet(dfu_packet_t* p_packet, uint16_t length)
 {
+    if (p_packet->payload.rsp_data.transaction_id != m_transaction.transaction_id)
+    {
+        return;
+    }
     if (m_state == DFU_STATE_RELAY)
     {
         /* only relay new packets, look for it in cache */
@@ -1116,6 +1853,7 @@ static void handle_data_rsp_packet(dfu_packet_t* p_packet, uint16_t length)
         {
             send_progress_event(m_transaction.segment_count - m_transaction.segments_remaining + 1,
                     m_transaction.segment_count);
+            relay_cache_store(p_packet, length);
             relay_packet(p_packet, length);
         }
     }
@@ -1125,6 +1863,203 @@ static void handle_data_rsp_packet(dfu_packet_t* p_packet, uint16_t length)
     }
 }
 
+#ifdef DFU_PARITY
+/** Length of the given segment's data, the first and last data segments may be cut short. */
+static uint32_t segment_length_get(uint16_t segment)
+{
+    uint16_t data_segments = data_segment_count();
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transaction.segment_size);
+    if (segment > data_segments)
+    {
+        return segment_length;
+    }
+    uint32_t start_addr = (uint32_t) addr_from_seg(segment, m_transaction.p_start_addr, m_transaction.segment_size);
+    uint32_t end_addr = (start_addr & ~(segment_length - 1)) + segment_length;
+    uint32_t transfer_end_addr = (uint32_t) m_transaction.p_start_addr + m_transaction.length;
+    if (end_addr > transfer_end_addr)
+    {
+        end_addr = transfer_end_addr;
+    }
+    return end_addr - start_addr;
+}
+
+/** Get the zero-padded contents of a segment we've received. */
+static bool segment_data_get(uint16_t segment, uint8_t* p_data)
+{
+    uint16_t data_segments = data_segment_count();
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transaction.segment_size);
+    memset(p_data, 0, segment_length);
+    if (segment <= data_segments)
+    {
+        return dfu_transfer_has_entry(addr_from_seg(segment, m_transaction.p_start_addr, m_transaction.segment_size),
+                p_data, segment_length_get(segment));
+    }
+    uint32_t index = segment - data_segments - 1;
+    if (m_transaction.signature_bitmap & (1 << index))
+    {
+        memcpy(p_data, &m_transaction.signature[index * segment_length], segment_length);
+        return true;
+    }
+    return false;
+}
+
+/** Rebuild the segment missing from a parity group, if there's only one. */
+static void parity_decode(dfu_packet_t* p_packet)
+{
+    uint16_t first_segment = p_packet->payload.parity.segment;
+    if (first_segment == 0 ||
+        first_segment > m_transaction.segment_count ||
+        PARITY_GROUP_FIRST(first_segment) != first_segment)
+    {
+        return;
+    }
+    uint16_t last_segment = first_segment + DFU_PARITY_GROUP_SIZE - 1;
+    if (last_segment > m_transaction.segment_count)
+    {
+        last_segment = m_transaction.segment_count;
+    }
+
+    dfu_packet_t data_packet;
+    uint16_t missing_segment = 0;
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transaction.segment_size);
+    memcpy(data_packet.payload.data.data, p_packet->payload.parity.data, segment_length);
+    for (uint16_t segment = first_segment; segment <= last_segment; ++segment)
+    {
+        uint8_t segment_data[DFU_SEGMENT_LENGTH_MAX];
+        if (segment_data_get(segment, segment_data))
+        {
+            for (uint32_t i = 0; i < segment_length; ++i)
+            {
+                data_packet.payload.data.data[i] ^= segment_data[i];
+            }
+        }
+        else if (missing_segment == 0)
+        {
+            missing_segment = segment;
+        }
+        else
+        {
+            return; /* more than one segment missing, can't recover. */
+        }
+    }
+
+    if (missing_segment != 0)
+    {
+        __LOG("Recovered 0x%x from parity\n", missing_segment);
+        data_packet.packet_type = DFU_PACKET_TYPE_DATA;
+        data_packet.payload.data.segment = missing_segment;
+        data_packet.payload.data.transaction_id = m_transaction.transaction_id;
+        handle_data_packet(&data_packet,
+                DFU_PACKET_LEN_DATA_HEADER + segment_length_get(missing_segment));
+    }
+}
+
+static void handle_data_parity_packet(dfu_packet_t* p_packet)
+{
+    if (p_packet->payload.parity.transaction_id != m_transaction.transaction_id ||
+        packet_in_cache(p_packet))
+    {
+        return;
+    }
+
+    if (m_state == DFU_STATE_TARGET || m_state == DFU_STATE_RELAY)
+    {
+        /* relay before decoding, so that the rebuilt segment won't make us
+           send this parity packet again. */
+        relay_packet(p_packet, DFU_PACKET_LEN_DATA_HEADER + DFU_SEGMENT_LENGTH(m_transaction.segment_size));
+    }
+    if (m_state == DFU_STATE_TARGET)
+    {
+        parity_decode(p_packet);
+    }
+}
+#endif /* DFU_PARITY */
+
+#ifdef DFU_PASSTHROUGH
+/** Get the transaction a packet belongs to. Returns false for packets that
+  aren't part of a transaction. */
+static bool packet_transaction_id_get(dfu_packet_t* p_packet, uint32_t* p_transaction_id)
+{
+    switch (p_packet->packet_type)
+    {
+        case DFU_PACKET_TYPE_STATE:
+            *p_transaction_id = p_packet->payload.state.transaction_id;
+            return (p_packet->payload.state.authority > 0);
+        case DFU_PACKET_TYPE_DATA:
+            *p_transaction_id = p_packet->payload.data.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_DATA_REQ:
+            *p_transaction_id = p_packet->payload.req_data.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_DATA_REQ_BITMAP:
+            *p_transaction_id = p_packet->payload.req_data_bitmap.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_DATA_RSP:
+            *p_transaction_id = p_packet->payload.rsp_data.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_DATA_COPY:
+            *p_transaction_id = p_packet->payload.copy.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_DATA_PARITY:
+            *p_transaction_id = p_packet->payload.parity.transaction_id;
+            return true;
+        case DFU_PACKET_TYPE_PROGRESS:
+            *p_transaction_id = p_packet->payload.progress.transaction_id;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool passthrough_has_entry(uint32_t transaction_id)
+{
+    for (uint32_t i = 0; i < m_passthrough.count; ++i)
+    {
+        if (m_passthrough.transaction_ids[i] == transaction_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Forward packets of other transactions while we're busy with our own, so
+* that transfers to different products can run through the mesh at the same
+* time. Transactions are picked up from their ready beacons, and their
+* packets are relayed as they are, without being stored or served.
+*/
+static void passthrough_rx(dfu_packet_t* p_packet, uint16_t length)
+{
+    uint32_t transaction_id;
+    if (m_state == DFU_STATE_INITIALIZED ||
+        m_state == DFU_STATE_FIND_FWID ||
+        !packet_transaction_id_get(p_packet, &transaction_id) ||
+        transaction_id == m_transaction.transaction_id)
+    {
+        return;
+    }
+    if (!passthrough_has_entry(transaction_id))
+    {
+        if (p_packet->packet_type != DFU_PACKET_TYPE_STATE)
+        {
+            return;
+        }
+        __LOG("Passthrough: Transaction 0x%x\n", transaction_id);
+        m_passthrough.transaction_ids[m_passthrough.next] = transaction_id;
+        m_passthrough.next = (m_passthrough.next + 1) % DFU_PASSTHROUGH_TRANSACTIONS;
+        if (m_passthrough.count < DFU_PASSTHROUGH_TRANSACTIONS)
+        {
+            m_passthrough.count++;
+        }
+    }
+    if (!packet_in_cache(p_packet))
+    {
+        relay_packet(p_packet, length);
+    }
+}
+#endif /* DFU_PASSTHROUGH */
+
 /*****************************************************************************
 * Interface Functions
 *****************************************************************************/
@@ -1136,6 +2071,12 @@ void dfu_mesh_init(uint8_t tx_slots)
     memset(m_req_cache, 0, REQ_CACHE_SIZE * sizeof(m_req_cache[0]));
     m_req_index = 0;
     m_tx_slots = tx_slots;
+#ifdef DFU_PACING
+    pacing_reset();
+#endif
+#ifdef DFU_PROGRESS_BEACON
+    progress_reset();
+#endif
 
     get_info_pointers();
 }
@@ -1188,7 +2129,7 @@ uint32_t dfu_mesh_req(dfu_type_t type, fwid_union_t* p_fwid, uint32_t* p_bank_ad
     return NRF_SUCCESS;
 }
 
-uint32_t dfu_mesh_relay(dfu_type_t type, fwid_union_t* p_fwid, uint32_t transaction_id)
+uint32_t dfu_mesh_relay(dfu_type_t type, fwid_union_t* p_fwid, uint32_t transaction_id, uint32_t* p_cache_addr)
 {
     if (m_state != DFU_STATE_FIND_FWID &&
         m_state != DFU_STATE_DFU_REQ)
@@ -1201,6 +2142,8 @@ uint32_t dfu_mesh_relay(dfu_type_t type, fwid_union_t* p_fwid, uint32_t transact
     SET_STATE(DFU_STATE_RELAY_CANDIDATE);
     m_transaction.type = type;
     m_transaction.transaction_id = transaction_id;
+    m_transaction.p_cache_addr = p_cache_addr;
+    m_transaction.p_start_addr = NULL;
     fwid_union_cpy(
             &m_transaction.target_fwid_union,
             p_fwid,
@@ -1236,20 +2179,55 @@ uint32_t dfu_mesh_rx(dfu_packet_t* p_packet, uint16_t length, bool from_serial)
 
         case DFU_PACKET_TYPE_DATA:
             handle_data_packet(p_packet, length);
+#ifdef DFU_PROGRESS_BEACON
+            if (from_serial)
+            {
+                m_transaction.source = true;
+                if (m_transaction.segment_count > 0 &&
+                    p_packet->payload.data.segment == m_transaction.segment_count)
+                {
+                    m_progress.data_done = true;
+                }
+            }
+#endif
             break;
 
         case DFU_PACKET_TYPE_DATA_REQ:
             handle_data_req_packet(p_packet);
             break;
 
+        case DFU_PACKET_TYPE_DATA_REQ_BITMAP:
+            handle_data_req_bitmap_packet(p_packet);
+            break;
+
         case DFU_PACKET_TYPE_DATA_RSP:
             handle_data_rsp_packet(p_packet, length);
             break;
 
+        case DFU_PACKET_TYPE_DATA_COPY:
+            handle_data_copy_packet(p_packet);
+            break;
+
+#ifdef DFU_PARITY
+        case DFU_PACKET_TYPE_DATA_PARITY:
+            handle_data_parity_packet(p_packet);
+            break;
+#endif
+
+#ifdef DFU_PROGRESS_BEACON
+        case DFU_PACKET_TYPE_PROGRESS:
+            handle_progress_packet(p_packet);
+            break;
+#endif
+
         default:
             /* don't care */
             break;
     }
+#ifdef DFU_PASSTHROUGH
+    /* after our own handling, which may have made the transaction ours. */
+    passthrough_rx(p_packet, length);
+#endif
     return NRF_SUCCESS;
 }
 
@@ -1284,7 +2262,7 @@ void dfu_mesh_timeout(void)
             break;
         case DFU_STATE_RELAY:
         case DFU_STATE_RELAY_CANDIDATE:
-            send_end_evt(DFU_END_SUCCESS);
+            relay_end();
             break;
         default:
             break;
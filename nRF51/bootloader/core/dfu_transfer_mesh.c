@@ -44,6 +44,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *****************************************************************************/
 #define INVALID_SEGMENT_INDEX   (0xFFFF)
 #define MISSING_BITFIELD_WIDTH  (64ULL)
+/** Number of segments that may wait for their flash write at once. */
+#define WRITE_BUFFER_COUNT      (4)
 
 /*****************************************************************************
 * Local typedefs
@@ -51,18 +53,37 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 typedef uint64_t bitfield_t;
 
+/** Segment staged for a flash write. */
+typedef struct
+{
+    uint32_t        data[DFU_SEGMENT_LENGTH_MAX / sizeof(uint32_t)];
+    uint16_t        segment;    /**< Segment in the buffer, or INVALID_SEGMENT_INDEX if free. */
+} write_buffer_t;
+
+/** Segments being copied from the current image by a delta transfer. */
+typedef struct
+{
+    const uint32_t* p_src;      /**< Source of the copy, or NULL if no copy is in progress. */
+    uint16_t        segment_first;
+    uint16_t        segment_last;
+} copy_run_t;
+
 typedef struct
 {
     uint32_t*       p_start_addr;
     uint32_t*       p_bank_addr;
     uint16_t        segment_count;
+    uint8_t         segment_size;       /**< See DFU_SEGMENT_LENGTH(). */
     bool            final_transfer;
     uint32_t        size;
     uint32_t*       p_write_pointer;
     bitfield_t      missing_segments;
-    uint8_t         write_buffer[SEGMENT_LENGTH];
+    write_buffer_t  write_buffers[WRITE_BUFFER_COUNT];
+    copy_run_t      copy;
     uint16_t        segment_max;
-    uint16_t        segment_prev;
+    sha256_context_t* p_hash_context;   /**< Context fed with the bank while it's written, or NULL. */
+    uint32_t        hash_offset;        /**< Number of bank bytes fed to the hash context. */
+    bool            cache_only;         /**< Relay cache, failures don't end the DFU. */
 } dfu_transfer_t;
 
 /*****************************************************************************
@@ -77,7 +98,38 @@ static dfu_transfer_t m_transfer;
 static void transfer_abort(dfu_end_t end_reason)
 {
     m_transfer.segment_max = INVALID_SEGMENT_INDEX;
-    send_end_evt(end_reason);
+    if (!m_transfer.cache_only)
+    {
+        send_end_evt(end_reason);
+    }
+}
+
+static void write_buffers_reset(void)
+{
+    for (uint32_t i = 0; i < WRITE_BUFFER_COUNT; ++i)
+    {
+        m_transfer.write_buffers[i].segment = INVALID_SEGMENT_INDEX;
+    }
+}
+
+/** Get the buffer holding the given segment, or a free one for INVALID_SEGMENT_INDEX. */
+static write_buffer_t* write_buffer_get(uint16_t segment)
+{
+    for (uint32_t i = 0; i < WRITE_BUFFER_COUNT; ++i)
+    {
+        if (m_transfer.write_buffers[i].segment == segment)
+        {
+            return &m_transfer.write_buffers[i];
+        }
+    }
+    return NULL;
+}
+
+static bool segment_is_copying(uint16_t segment)
+{
+    return (m_transfer.copy.p_src != NULL &&
+            segment >= m_transfer.copy.segment_first &&
+            segment <= m_transfer.copy.segment_last);
 }
 
 static bool segment_is_missing(uint16_t segment)
@@ -93,6 +145,77 @@ static bool segment_is_missing(uint16_t segment)
     return !!((1ULL << (m_transfer.segment_max - segment)) & m_transfer.missing_segments);
 }
 
+static bool segment_is_written(uint16_t segment)
+{
+    return (segment <= m_transfer.segment_max &&
+            !segment_is_missing(segment) &&
+            !segment_is_copying(segment) &&
+            write_buffer_get(segment) == NULL);
+}
+
+/** Segments that have arrived, but haven't been written yet. */
+static bool segment_is_pending(uint16_t segment)
+{
+    return (segment_is_copying(segment) || write_buffer_get(segment) != NULL);
+}
+
+/** Move the newest segment up to the given one, marking the skipped ones as
+  missing. Aborts the transfer if it would lose track of missing segments. */
+static bool segment_max_advance(uint16_t segment)
+{
+    if (segment <= m_transfer.segment_max)
+    {
+        return true;
+    }
+    /* Ensure that we don't shift out any set bits: Mask the shift on the
+     * MSB side (ie only look at the part that will overflow), and check
+     * whether there are any bits set in that section. */
+    uint16_t segment_offset = segment - m_transfer.segment_max;
+    bitfield_t shift_mask = (segment_offset >= MISSING_BITFIELD_WIDTH) ? ~0ULL : (1ULL << segment_offset) - 1ULL;
+    if (segment_offset >= MISSING_BITFIELD_WIDTH
+            ? (m_transfer.missing_segments != 0)
+            : (m_transfer.missing_segments & (shift_mask << (MISSING_BITFIELD_WIDTH - segment_offset))))
+    {
+        transfer_abort(DFU_END_ERROR_PACKET_LOSS);
+        return false;
+    }
+    /* Offset the bitfield to match the new segment_max, and set all bits
+     * that we skipped to 1, as they're considered missing. */
+    m_transfer.missing_segments = (segment_offset >= MISSING_BITFIELD_WIDTH)
+        ? shift_mask
+        : ((m_transfer.missing_segments << segment_offset) | shift_mask);
+    m_transfer.missing_segments &= ~1ULL; /* The newest segment isn't missing. */
+    m_transfer.segment_max = segment;
+    return true;
+}
+
+/** Feed the hash context with the segments that have been written in order. */
+static void hash_advance(void)
+{
+    if (m_transfer.p_hash_context == NULL)
+    {
+        return;
+    }
+    while (m_transfer.hash_offset < m_transfer.size)
+    {
+        uint32_t addr = (uint32_t) m_transfer.p_start_addr + m_transfer.hash_offset;
+        uint16_t segment = ADDR_SEGMENT(addr, m_transfer.p_start_addr, m_transfer.segment_size);
+        if (!segment_is_written(segment))
+        {
+            break;
+        }
+        uint32_t end = SEGMENT_ADDR(segment + 1, m_transfer.p_start_addr, m_transfer.segment_size);
+        if (end > (uint32_t) m_transfer.p_start_addr + m_transfer.size)
+        {
+            end = (uint32_t) m_transfer.p_start_addr + m_transfer.size;
+        }
+        sha256_update(m_transfer.p_hash_context,
+                (uint8_t*) m_transfer.p_bank_addr + m_transfer.hash_offset,
+                end - addr);
+        m_transfer.hash_offset += end - addr;
+    }
+}
+
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
@@ -100,22 +223,32 @@ void dfu_transfer_init(void)
 {
     memset(&m_transfer, 0, sizeof(dfu_transfer_t));
     m_transfer.segment_max = INVALID_SEGMENT_INDEX;
+    write_buffers_reset();
 }
 
 uint32_t dfu_transfer_start(
         uint32_t* p_start_addr,
         uint32_t* p_bank_addr,
         uint32_t size,
+        uint8_t segment_size,
         bool final_transfer)
 {
     dfu_transfer_init();
-    uint16_t segment_count = (((size + (uint32_t) p_start_addr) & 0xFFFFFFF0) - ((uint32_t) p_start_addr & 0xFFFFFFF0)) / 16;
+    /* a target transfer, dfu_transfer_cache_start() sets it again for a relay cache */
+    m_transfer.cache_only = false;
+    uint32_t segment_mask = ~(DFU_SEGMENT_LENGTH(segment_size) - 1);
+    uint16_t segment_count = (((size + (uint32_t) p_start_addr) & segment_mask) - ((uint32_t) p_start_addr & segment_mask))
+        >> DFU_SEGMENT_SHIFT(segment_size);
 
     if (PAGE_OFFSET(p_start_addr) != 0 ||
         PAGE_OFFSET(p_bank_addr) != 0)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
+    if (segment_size > DFU_SEGMENT_SIZE_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
 
     if (p_bank_addr == NULL)
     {
@@ -132,70 +265,141 @@ uint32_t dfu_transfer_start(
 
     m_transfer.p_start_addr = p_start_addr;
     m_transfer.segment_count = segment_count;
+    m_transfer.segment_size = segment_size;
     m_transfer.final_transfer = final_transfer;
     m_transfer.p_write_pointer = m_transfer.p_start_addr;
     m_transfer.size = size;
     m_transfer.missing_segments = 0;
-    m_transfer.segment_prev = INVALID_SEGMENT_INDEX;
     m_transfer.segment_max = 0;
     return NRF_SUCCESS;
 }
 
+uint32_t dfu_transfer_cache_start(
+        uint32_t* p_start_addr,
+        uint32_t* p_bank_addr,
+        uint32_t size,
+        uint8_t segment_size)
+{
+    if (p_bank_addr == NULL || p_bank_addr == p_start_addr)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    uint32_t error_code = dfu_transfer_start(p_start_addr, p_bank_addr, size, segment_size, false);
+    if (error_code == NRF_SUCCESS)
+    {
+        m_transfer.cache_only = true;
+    }
+    return error_code;
+}
+
 uint32_t dfu_transfer_data(uint32_t p_addr, uint8_t* p_data, uint16_t length)
 {
     if (m_transfer.segment_max == INVALID_SEGMENT_INDEX)
     {
         return NRF_ERROR_INVALID_STATE;
     }
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transfer.segment_size);
     /* Data block must be segment-aligned. */
-    if ((p_addr & (SEGMENT_LENGTH - 1)) != 0 ||
+    if ((p_addr & (segment_length - 1)) != 0 ||
             p_addr          < (uint32_t) m_transfer.p_start_addr ||
             p_addr + length > (uint32_t) m_transfer.p_start_addr + m_transfer.size)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
-    if (length > SEGMENT_LENGTH || (length & 0x03))
+    if (length > segment_length || (length & 0x03))
     {
         return NRF_ERROR_INVALID_LENGTH;
     }
-    if (m_transfer.segment_prev != INVALID_SEGMENT_INDEX)
+
+    uint16_t segment = ADDR_SEGMENT(p_addr, m_transfer.p_start_addr, m_transfer.segment_size);
+
+    if (!segment_is_missing(segment) || segment_is_pending(segment))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    /* Segments keep arriving while the previous ones are written. */
+    write_buffer_t* p_buffer = write_buffer_get(INVALID_SEGMENT_INDEX);
+    if (p_buffer == NULL)
     {
         return NRF_ERROR_BUSY;
     }
 
-    uint16_t segment = ADDR_SEGMENT(p_addr, m_transfer.p_start_addr);
+    if (!segment_max_advance(segment))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
 
-    if (!segment_is_missing(segment))
+    p_buffer->segment = segment;
+    memcpy(p_buffer->data, p_data, length);
+    if (flash_write(
+            (void*) ((uint32_t) m_transfer.p_bank_addr + (p_addr - (uint32_t) m_transfer.p_start_addr)),
+            p_buffer->data,
+            length) != NRF_SUCCESS)
+    {
+        p_buffer->segment = INVALID_SEGMENT_INDEX;
+        transfer_abort(DFU_END_ERROR_NO_MEM);
+        return NRF_ERROR_INTERNAL;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t dfu_transfer_copy(uint32_t p_addr, const uint32_t* p_src, uint16_t length)
+{
+    if (m_transfer.segment_max == INVALID_SEGMENT_INDEX)
     {
         return NRF_ERROR_INVALID_STATE;
     }
+    const uint32_t segment_length = DFU_SEGMENT_LENGTH(m_transfer.segment_size);
+    if ((p_addr & (segment_length - 1)) != 0 ||
+            !IS_WORD_ALIGNED(p_src) ||
+            p_addr          < (uint32_t) m_transfer.p_start_addr ||
+            p_addr + length > (uint32_t) m_transfer.p_start_addr + m_transfer.size)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (length == 0 || length > DFU_COPY_SEGMENTS_MAX * segment_length || (length & 0x03))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (m_transfer.copy.p_src != NULL)
+    {
+        return NRF_ERROR_BUSY;
+    }
 
-    if (segment > m_transfer.segment_max)
+    uint16_t segment_first = ADDR_SEGMENT(p_addr, m_transfer.p_start_addr, m_transfer.segment_size);
+    uint16_t segment_last = ADDR_SEGMENT(p_addr + length - 1, m_transfer.p_start_addr, m_transfer.segment_size);
+    for (uint16_t segment = segment_first; segment <= segment_last; ++segment)
+    {
+        if (!segment_is_missing(segment) || segment_is_pending(segment))
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+    }
+
+    if (!segment_max_advance(segment_last))
     {
-        /* Ensure that we don't shift out any set bits: Mask the shift on the
-         * MSB side (ie only look at the part that will overflow), and check
-         * whether there are any bits set in that section. */
-        uint16_t segment_offset = segment - m_transfer.segment_max;
-        bitfield_t shift_mask = (1ULL << segment_offset) - 1ULL;
-        if (m_transfer.missing_segments & (shift_mask << (MISSING_BITFIELD_WIDTH - segment_offset)))
+        return NRF_ERROR_NOT_FOUND;
+    }
+    /* The copied segments stay missing until the write is done. */
+    for (uint16_t segment = segment_first; segment <= segment_last; ++segment)
+    {
+        uint32_t offset = m_transfer.segment_max - segment;
+        if (offset < MISSING_BITFIELD_WIDTH)
         {
-            transfer_abort(DFU_END_ERROR_PACKET_LOSS);
-            return NRF_ERROR_NOT_FOUND;
+            m_transfer.missing_segments |= (1ULL << offset);
         }
-        /* Offset the bitfield to match the new segment_max, and set all bits
-         * that we skipped to 1, as they're considered missing. */
-        m_transfer.missing_segments = (m_transfer.missing_segments << segment_offset) | shift_mask;
-        m_transfer.missing_segments &= ~1ULL; /* The newest segment isn't missing. */
-        m_transfer.segment_max = segment;
     }
 
-    m_transfer.segment_prev = segment;
-    memcpy(m_transfer.write_buffer, p_data, length);
+    m_transfer.copy.p_src = p_src;
+    m_transfer.copy.segment_first = segment_first;
+    m_transfer.copy.segment_last = segment_last;
     if (flash_write(
             (void*) ((uint32_t) m_transfer.p_bank_addr + (p_addr - (uint32_t) m_transfer.p_start_addr)),
-            m_transfer.write_buffer,
+            (void*) p_src,
             length) != NRF_SUCCESS)
     {
+        m_transfer.copy.p_src = NULL;
         transfer_abort(DFU_END_ERROR_NO_MEM);
         return NRF_ERROR_INTERNAL;
     }
@@ -208,16 +412,37 @@ bool dfu_transfer_has_entry(uint32_t* p_addr, uint8_t* p_out_buffer, uint16_t le
     {
         return false;
     }
-    uint16_t segment = ADDR_SEGMENT(p_addr, m_transfer.p_start_addr);
+    uint16_t segment = ADDR_SEGMENT(p_addr, m_transfer.p_start_addr, m_transfer.segment_size);
     if (segment > m_transfer.segment_max)
     {
         return false;
     }
+    /* Segments waiting for their write are served from their buffer. */
+    write_buffer_t* p_buffer = write_buffer_get(segment);
+    if (p_buffer != NULL)
+    {
+        if (p_out_buffer && len)
+        {
+            memcpy(p_out_buffer, p_buffer->data, len);
+        }
+        return true;
+    }
+    /* Copied segments are served from their source. */
+    if (segment_is_copying(segment))
+    {
+        if (p_out_buffer && len)
+        {
+            memcpy(p_out_buffer,
+                    (uint8_t*) m_transfer.copy.p_src + ((uint32_t) (segment - m_transfer.copy.segment_first) << DFU_SEGMENT_SHIFT(m_transfer.segment_size)),
+                    len);
+        }
+        return true;
+    }
     if (!segment_is_missing(segment))
     {
         if (p_out_buffer && len)
         {
-            uint32_t* p_storage_addr = (uint32_t*) SEGMENT_ADDR(segment, m_transfer.p_bank_addr);
+            uint32_t* p_storage_addr = (uint32_t*) SEGMENT_ADDR(segment, m_transfer.p_bank_addr, m_transfer.segment_size);
             memcpy(p_out_buffer, p_storage_addr, len);
         }
         return true;
@@ -239,11 +464,11 @@ bool dfu_transfer_get_oldest_missing_entry(
         if (m_transfer.missing_segments & (1ULL << i))
         {
             uint16_t segment = m_transfer.segment_max - i;
-            uint32_t addr = SEGMENT_ADDR(segment, m_transfer.p_start_addr);
+            uint32_t addr = SEGMENT_ADDR(segment, m_transfer.p_start_addr, m_transfer.segment_size);
             if (addr >= (uint32_t) p_start_addr)
             {
                 *pp_entry = (uint32_t*) addr;
-                *p_len = SEGMENT_LENGTH;
+                *p_len = DFU_SEGMENT_LENGTH(m_transfer.segment_size);
                 return true;
             }
         }
@@ -251,30 +476,130 @@ bool dfu_transfer_get_oldest_missing_entry(
     return false;
 }
 
+uint32_t dfu_transfer_get_missing_bitmap(
+        uint32_t* p_start_addr,
+        uint16_t segment_limit,
+        uint16_t* p_segment,
+        uint8_t* p_bitmap,
+        uint32_t bitmap_len)
+{
+    if (m_transfer.segment_max == INVALID_SEGMENT_INDEX)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    memset(p_bitmap, 0, bitmap_len);
+    for (int32_t i = MISSING_BITFIELD_WIDTH - 1; i >= 0; i--)
+    {
+        if (m_transfer.missing_segments & (1ULL << i))
+        {
+            uint16_t segment = m_transfer.segment_max - i;
+            if (segment >= segment_limit)
+            {
+                break;
+            }
+            if (SEGMENT_ADDR(segment, m_transfer.p_start_addr, m_transfer.segment_size) < (uint32_t) p_start_addr ||
+                segment_is_pending(segment))
+            {
+                continue;
+            }
+            if (count == 0)
+            {
+                *p_segment = segment;
+            }
+            else
+            {
+                uint32_t bit = segment - *p_segment - 1;
+                if (bit >= bitmap_len * 8)
+                {
+                    break;
+                }
+                p_bitmap[bit / 8] |= (1 << (bit & 0x07));
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t dfu_transfer_sha256_start(sha256_context_t* p_hash_context)
+{
+    if (m_transfer.segment_max == INVALID_SEGMENT_INDEX)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_hash_context == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    m_transfer.p_hash_context = p_hash_context;
+    m_transfer.hash_offset = 0;
+    hash_advance();
+    return NRF_SUCCESS;
+}
+
 uint32_t dfu_transfer_sha256(sha256_context_t* p_hash_context)
 {
     if (m_transfer.segment_max == INVALID_SEGMENT_INDEX)
     {
         return NRF_ERROR_INVALID_STATE;
     }
+    uint32_t offset = 0;
+    if (p_hash_context == m_transfer.p_hash_context)
+    {
+        /* only the part that wasn't hashed during the transfer is left. */
+        hash_advance();
+        offset = m_transfer.hash_offset;
+        m_transfer.p_hash_context = NULL;
+    }
+    if (offset == m_transfer.size)
+    {
+        return NRF_SUCCESS;
+    }
     return sha256_update(p_hash_context,
-                  (uint8_t*) m_transfer.p_bank_addr,
-                  m_transfer.size);
+                  (uint8_t*) m_transfer.p_bank_addr + offset,
+                  m_transfer.size - offset);
 }
 
 void dfu_transfer_end(void)
 {
     memset(&m_transfer, 0, sizeof(m_transfer));
     m_transfer.segment_max = INVALID_SEGMENT_INDEX;
+    write_buffers_reset();
 }
 
 void dfu_transfer_flash_write_complete(uint8_t* p_write_src)
 {
-    if (p_write_src == m_transfer.write_buffer)
+    if (m_transfer.copy.p_src != NULL && p_write_src == (uint8_t*) m_transfer.copy.p_src)
+    {
+        for (uint16_t segment = m_transfer.copy.segment_first; segment <= m_transfer.copy.segment_last; ++segment)
+        {
+            uint32_t offset = m_transfer.segment_max - segment;
+            if (offset < MISSING_BITFIELD_WIDTH)
+            {
+                m_transfer.missing_segments &= ~(1ULL << offset);
+            }
+        }
+        m_transfer.copy.p_src = NULL;
+        hash_advance();
+        return;
+    }
+
+    for (uint32_t i = 0; i < WRITE_BUFFER_COUNT; ++i)
     {
-        uint32_t offset = m_transfer.segment_max - m_transfer.segment_prev;
-        m_transfer.missing_segments &= ~(1 << offset);
-        m_transfer.segment_prev = INVALID_SEGMENT_INDEX;
+        write_buffer_t* p_buffer = &m_transfer.write_buffers[i];
+        if (p_write_src == (uint8_t*) p_buffer->data &&
+            p_buffer->segment != INVALID_SEGMENT_INDEX)
+        {
+            uint32_t offset = m_transfer.segment_max - p_buffer->segment;
+            if (offset < MISSING_BITFIELD_WIDTH)
+            {
+                m_transfer.missing_segments &= ~(1ULL << offset);
+            }
+            p_buffer->segment = INVALID_SEGMENT_INDEX;
+            hash_advance();
+            break;
+        }
     }
 }
 
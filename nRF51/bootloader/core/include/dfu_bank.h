@@ -63,5 +63,42 @@ void dfu_bank_on_flash_idle(void);
 
 bool dfu_bank_transfer_in_progress(void);
 
+/**
+ * Advance the rollback state at boot, when built with DFU_BANK_ROLLBACK. A
+ * new application gets a single boot to confirm itself with
+ * dfu_bank_rollback_confirm(), the next boot flashes the copy of the previous
+ * application back.
+ *
+ * @return Whether flash operations were started, and the bootloader should
+ * wait for them before going to the application.
+ */
+bool dfu_bank_rollback_boot(void);
+
+/**
+ * Mark the running application as good, so it won't be rolled back.
+ *
+ * @return NRF_SUCCESS The application is confirmed.
+ * @return NRF_ERROR_NOT_FOUND There's no copy of a previous application.
+ * @return NRF_ERROR_INVALID_STATE The application hasn't been started yet.
+ * @return NRF_ERROR_NOT_SUPPORTED The bootloader was built without DFU_BANK_ROLLBACK.
+ */
+uint32_t dfu_bank_rollback_confirm(void);
+
+/**
+ * Flash the copy of the previous application back. If called from the
+ * application, this will trigger a restart of the chip.
+ *
+ * @return NRF_SUCCESS The copy will be flashed once its bank entry is in place.
+ * @return NRF_ERROR_NOT_FOUND There's no copy of a previous application.
+ * @return NRF_ERROR_INVALID_STATE A bank flash is already underway.
+ * @return NRF_ERROR_BUSY The bootloader info is being moved, try again later.
+ * @return NRF_ERROR_NOT_SUPPORTED The bootloader was built without DFU_BANK_ROLLBACK.
+ */
+uint32_t dfu_bank_rollback(void);
+
+/** Check whether a new application is on trial, and has to be started by the
+  full bootloader. */
+bool dfu_bank_rollback_pending(void);
+
 #endif /* DFU_BANK_H__ */
 
@@ -40,10 +40,29 @@ uint32_t dfu_transfer_start(
         uint32_t* p_start_addr,
         uint32_t* p_bank_addr,
         uint32_t size,
+        uint8_t segment_size,
         bool final_transfer);
 
+/**
+* Start a best-effort transfer into a cache bank, for relays. Unlike
+* dfu_transfer_start(), losing track of a missing segment silently drops the
+* cache instead of ending the DFU.
+*/
+uint32_t dfu_transfer_cache_start(
+        uint32_t* p_start_addr,
+        uint32_t* p_bank_addr,
+        uint32_t size,
+        uint8_t segment_size);
+
 uint32_t dfu_transfer_data(uint32_t p_addr, uint8_t* p_data, uint16_t length);
 
+/**
+* Fill the segments at p_addr with data from the current image, for delta
+* transfers. p_src must stay valid until the write is done, and the segments
+* are served from it until then.
+*/
+uint32_t dfu_transfer_copy(uint32_t p_addr, const uint32_t* p_src, uint16_t length);
+
 bool dfu_transfer_has_entry(uint32_t* p_addr, uint8_t* p_out_buffer, uint16_t len);
 
 bool dfu_transfer_get_oldest_missing_entry(
@@ -51,6 +70,32 @@ bool dfu_transfer_get_oldest_missing_entry(
         uint32_t** pp_entry,
         uint32_t* p_len);
 
+/**
+* Get the oldest missing segment at or after p_start_addr, along with a bitmap
+* of the missing segments following it. Bit n (LSB first) of p_bitmap marks
+* segment *p_segment + 1 + n as missing. Segments from segment_limit and up
+* are left out.
+*
+* @return The number of missing segments described, 0 if none are missing.
+*/
+uint32_t dfu_transfer_get_missing_bitmap(
+        uint32_t* p_start_addr,
+        uint16_t segment_limit,
+        uint16_t* p_segment,
+        uint8_t* p_bitmap,
+        uint32_t bitmap_len);
+
+/**
+* Feed the given hash context with the bank contents as they are written in
+* order, so that only the tail is left for dfu_transfer_sha256(). The context
+* must stay valid until then, or until the transfer ends.
+*/
+uint32_t dfu_transfer_sha256_start(sha256_context_t* p_hash_context);
+
+/**
+* Feed the given hash context with the bank contents. Only hashes the part
+* that's left if the context was passed to dfu_transfer_sha256_start().
+*/
 uint32_t dfu_transfer_sha256(sha256_context_t* p_hash_context);
 
 void dfu_transfer_end(void);
@@ -34,10 +34,25 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #include "bl_if.h"
 
+#ifndef BOOTLOADER_FAST_BOOT
+/** @brief Whether to start the application straight away at reset when the
+ * bootloader has nothing to do, without setting up clocks and radio. */
+#define BOOTLOADER_FAST_BOOT    (1)
+#endif
+
+/**
+* Start the application immediately if it's valid, the retention register asks
+* for it and no bank flash operation is in progress. Only reads the bootloader
+* info, and may be called before anything else is initialized. Returns if the
+* bootloader has to run.
+*/
+void bootloader_fast_boot(void);
 void bootloader_init(void);
 void bootloader_enable(void);
 uint32_t bootloader_cmd_send(bl_cmd_t* p_bl_cmd);
 void bootloader_timeout(void);
+/** Get the number of free entries in the flash operation queue. */
+uint32_t bootloader_flash_available_slots(void);
 
 void bootloader_abort(dfu_end_t end_reason);
 
@@ -42,7 +42,8 @@ typedef enum
 {
     TX_INTERVAL_TYPE_EXPONENTIAL,
     TX_INTERVAL_TYPE_REGULAR,
-    TX_INTERVAL_TYPE_REGULAR_SLOW
+    TX_INTERVAL_TYPE_REGULAR_SLOW,
+    TX_INTERVAL_TYPE_TRICKLE
 } tx_interval_type_t;
 
 typedef void(*release_cb_t)(mesh_packet_t* p_packet);
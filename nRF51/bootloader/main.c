@@ -115,6 +115,10 @@ static void init_clock(void)
 
 int main(void)
 {
+#if BOOTLOADER_FAST_BOOT
+    /* Skip the clock and transport setup when we're just passing through. */
+    bootloader_fast_boot();
+#endif
     init_clock();
 
     NVIC_SetPriority(SWI2_IRQn, 2);
@@ -47,6 +47,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INTERVAL                        (3277) /* ticks */
 #define REDUNDANCY_MAX                  (3)
 #define TX_EVT_BITFIELD_HANDLE_START    (0xFFF0)
+#define TX_SLOT_NONE                    (0xFF)
+#define TX_ACKS_MAX                     (0xFF)
+#define TRICKLE_INTERVAL_MIN            (10 * INTERVAL) /* ticks */
+#define TRICKLE_DOUBLINGS_MAX           (6)
+
+#ifndef TX_ACKS_PER_REPEAT
+/** @brief Number of copies of a packet we have to hear from our neighbours
+ * before one of its remaining repeats is dropped. */
+#define TX_ACKS_PER_REPEAT              (REDUNDANCY_MAX)
+#endif
 /******************************************************************************
 * Static typedefs
 ******************************************************************************/
@@ -58,7 +68,9 @@ typedef struct
     uint8_t repeats;
     uint8_t count;
     uint8_t type;
-    uint8_t redundancy;
+    uint8_t redundancy; /**< Copies heard from neighbours since the last transmission. */
+    uint8_t acks;       /**< Copies heard from neighbours since the packet was ordered. */
+    uint8_t next;       /**< Next slot in the schedule, or TX_SLOT_NONE. */
 } tx_t;
 /******************************************************************************
 * Static globals
@@ -68,6 +80,7 @@ static tx_t             m_tx[TRANSPORT_TX_SLOTS];
 static fifo_t           m_rx_fifo;
 static mesh_packet_t*   m_rx_fifo_buf[RADIO_RX_FIFO_LEN];
 static uint32_t         m_ticks_at_order_time;
+static uint8_t          m_tx_head = TX_SLOT_NONE; /**< Slot with the earliest transmission. */
 static prng_t           m_prng;
 static bool             m_started = false;
 uint16_t                m_tx_evt_bitfield; /**< Bitfield of events for each handle in the reserved handle range 0xFFF0-0xFFFE. */
@@ -75,12 +88,26 @@ uint16_t                m_tx_evt_bitfield; /**< Bitfield of events for each hand
 * Static functions
 ******************************************************************************/
 static void radio_tx_cb(uint8_t* p_data);
-static void radio_rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi);
+static void radio_rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi, uint32_t timestamp, uint8_t channel);
 static void radio_idle_cb(void);
 
+/** Length of the current interval of a trickle slot. The count holds the
+  number of doublings since the slot was ordered or reset. */
+static uint32_t trickle_interval_get(const tx_t* p_tx)
+{
+    return (TRICKLE_INTERVAL_MIN << p_tx->count);
+}
+
 static void set_next_tx(tx_t* p_tx)
 {
-    if (p_tx->type == TX_INTERVAL_TYPE_EXPONENTIAL)
+    if (p_tx->type == TX_INTERVAL_TYPE_TRICKLE)
+    {
+        /* somewhere in the second half of the interval */
+        const uint32_t interval = trickle_interval_get(p_tx);
+        p_tx->ticks_next = (p_tx->ticks_start + interval / 2 +
+            (rand_prng_get(&m_prng) % (interval / 2))) & RTC_MASK;
+    }
+    else if (p_tx->type == TX_INTERVAL_TYPE_EXPONENTIAL)
     {
         uint32_t offset         = (INTERVAL <<  p_tx->count) - INTERVAL;
         uint32_t offset_next    = (INTERVAL << (p_tx->count + 1)) - INTERVAL;
@@ -98,6 +125,91 @@ static void set_next_tx(tx_t* p_tx)
     }
 }
 
+/** Check whether the given slot is scheduled before the other. Deadlines are
+  compared relative to the last order time, which no pending slot precedes. */
+static bool tx_is_before(const tx_t* p_tx, const tx_t* p_other)
+{
+    return (((p_tx->ticks_next - m_ticks_at_order_time) & RTC_MASK) <
+            ((p_other->ticks_next - m_ticks_at_order_time) & RTC_MASK));
+}
+
+/** Insert a slot into the schedule, sorted by deadline. */
+static void schedule_insert(uint8_t slot)
+{
+    uint8_t* p_link = &m_tx_head;
+    while (*p_link != TX_SLOT_NONE && !tx_is_before(&m_tx[slot], &m_tx[*p_link]))
+    {
+        p_link = &m_tx[*p_link].next;
+    }
+    m_tx[slot].next = *p_link;
+    *p_link = slot;
+}
+
+/** Take a slot out of the schedule, if it's in it. */
+static void schedule_remove(uint8_t slot)
+{
+    uint8_t* p_link = &m_tx_head;
+    while (*p_link != TX_SLOT_NONE)
+    {
+        if (*p_link == slot)
+        {
+            *p_link = m_tx[slot].next;
+            m_tx[slot].next = TX_SLOT_NONE;
+            return;
+        }
+        p_link = &m_tx[*p_link].next;
+    }
+}
+
+/** Number of repeats left for the given slot, considering the copies our
+  neighbours have already sent for us. The packet is always sent at least
+  once before it's considered done. */
+static uint32_t tx_repeats_get(const tx_t* p_tx)
+{
+    if (p_tx->repeats == TX_REPEATS_INF)
+    {
+        return TX_REPEATS_INF;
+    }
+    uint32_t dropped = p_tx->acks / TX_ACKS_PER_REPEAT;
+    if (dropped + 1 >= p_tx->repeats)
+    {
+        return 1;
+    }
+    return p_tx->repeats - dropped;
+}
+
+/** Register neighbour copies of the packets we're sending. Identical packets
+  heard back act as implicit acknowledgements, and let us suppress our own
+  transmissions in dense areas. */
+static void tx_echo_register(mesh_packet_t* p_packet)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < TRANSPORT_TX_SLOTS; ++i)
+    {
+        if (m_tx[i].p_packet != NULL)
+        {
+            mesh_adv_data_t* p_tx_adv_data = mesh_packet_adv_data_get(m_tx[i].p_packet);
+            if (p_tx_adv_data != NULL &&
+                p_tx_adv_data->adv_data_length == p_adv_data->adv_data_length &&
+                memcmp(p_tx_adv_data, p_adv_data, p_adv_data->adv_data_length + 1) == 0)
+            {
+                if (m_tx[i].redundancy < REDUNDANCY_MAX)
+                {
+                    m_tx[i].redundancy++;
+                }
+                if (m_tx[i].acks < TX_ACKS_MAX)
+                {
+                    m_tx[i].acks++;
+                }
+            }
+        }
+    }
+}
+
 static void order_scan(void)
 {
     radio_event_t evt;
@@ -135,7 +247,7 @@ static void radio_tx_cb(uint8_t* p_data)
     mesh_packet_ref_count_dec((mesh_packet_t*) p_data);
 }
 
-static void radio_rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi)
+static void radio_rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi, uint32_t timestamp, uint8_t channel)
 {
     if (success &&
         fifo_push(&m_rx_fifo, &p_data) == NRF_SUCCESS)
@@ -158,30 +270,29 @@ static void radio_idle_cb(void)
 
 static void order_next_rtc(void)
 {
-    const uint32_t ticks_now = NRF_RTC0->COUNTER;
-    uint32_t earliest = (ticks_now - 1) & RTC_MASK;
-
-    for (uint32_t i = 0; i < TRANSPORT_TX_SLOTS; ++i)
+    if (m_tx_head == TX_SLOT_NONE)
     {
-        if (m_tx[i].p_packet != NULL &&
-            ((m_tx[i].ticks_next - ticks_now) & RTC_MASK) <
-            ((earliest - ticks_now) & RTC_MASK))
-        {
-            earliest = m_tx[i].ticks_next & RTC_MASK;
-        }
+        NRF_RTC0->INTENCLR = (1 << (RTC_TRANSPORT_CH + RTC_INTENCLR_COMPARE0_Pos));
+        return;
     }
 
-    if (earliest != ((ticks_now - 1) & RTC_MASK))
+    const uint32_t ticks_now = NRF_RTC0->COUNTER;
+    uint32_t earliest = m_tx[m_tx_head].ticks_next & RTC_MASK;
+
+    if (((earliest - m_ticks_at_order_time) & RTC_MASK) <=
+        ((ticks_now - m_ticks_at_order_time) & RTC_MASK))
     {
-        NRF_RTC0->INTENSET = (1 << (RTC_TRANSPORT_CH + RTC_INTENSET_COMPARE0_Pos));
-        NRF_RTC0->EVENTS_COMPARE[RTC_TRANSPORT_CH] = 0;
-        NRF_RTC0->CC[RTC_TRANSPORT_CH] = earliest;
-        m_ticks_at_order_time = ticks_now;
+        /* Already due, but not handled yet. Keep the order time, so that the
+           schedule stays sorted, and fire as soon as possible. */
+        earliest = (ticks_now + RTC_MARGIN) & RTC_MASK;
     }
     else
     {
-        NRF_RTC0->INTENCLR = (1 << (RTC_TRANSPORT_CH + RTC_INTENCLR_COMPARE0_Pos));
+        m_ticks_at_order_time = ticks_now;
     }
+    NRF_RTC0->INTENSET = (1 << (RTC_TRANSPORT_CH + RTC_INTENSET_COMPARE0_Pos));
+    NRF_RTC0->EVENTS_COMPARE[RTC_TRANSPORT_CH] = 0;
+    NRF_RTC0->CC[RTC_TRANSPORT_CH] = earliest;
 }
 /******************************************************************************
 * IRQ handlers
@@ -192,6 +303,7 @@ void SWI0_IRQHandler(void)
     while (fifo_pop(&m_rx_fifo, &p_packet) == NRF_SUCCESS)
     {
         APP_ERROR_CHECK_BOOL(mesh_packet_ref_count_get(p_packet) == 1);
+        tx_echo_register(p_packet);
         m_rx_cb(p_packet);
         mesh_packet_ref_count_dec(p_packet);
     }
@@ -219,13 +331,18 @@ void transport_init(rx_cb_t rx_cb, uint32_t access_addr)
     m_rx_cb = rx_cb;
     m_tx_evt_bitfield = 0;
     memset(m_tx, 0, sizeof(tx_t) * TRANSPORT_TX_SLOTS);
+    for (uint32_t i = 0; i < TRANSPORT_TX_SLOTS; ++i)
+    {
+        m_tx[i].next = TX_SLOT_NONE;
+    }
+    m_tx_head = TX_SLOT_NONE;
 
     m_rx_fifo.elem_array = m_rx_fifo_buf;
     m_rx_fifo.elem_size = sizeof(mesh_packet_t*);
     m_rx_fifo.array_len = RADIO_RX_FIFO_LEN;
     m_rx_fifo.memcpy_fptr = NULL;
     fifo_init(&m_rx_fifo);
-    mesh_packet_init();
+    APP_ERROR_CHECK(mesh_packet_init(NULL, 0));
 
     APP_ERROR_CHECK(rand_prng_seed(&m_prng));
 
@@ -268,14 +385,23 @@ bool transport_tx(mesh_packet_t* p_packet, uint8_t slot, uint8_t repeats, tx_int
     if (p_tx->p_packet)
     {
         mesh_packet_ref_count_dec(p_tx->p_packet);
+        schedule_remove(slot);
+    }
+    if (m_tx_head == TX_SLOT_NONE)
+    {
+        /* nothing scheduled, the last order time may be arbitrarily old. */
+        m_ticks_at_order_time = NRF_RTC0->COUNTER;
     }
     mesh_packet_ref_count_inc(p_packet);
     p_tx->p_packet = p_packet;
     p_tx->repeats = repeats;
     p_tx->count = 0;
+    p_tx->redundancy = 0;
+    p_tx->acks = 0;
     p_tx->ticks_start = NRF_RTC0->COUNTER;
     p_tx->type = type;
     set_next_tx(p_tx);
+    schedule_insert(slot);
     order_next_rtc();
     _ENABLE_IRQS(was_masked);
     return true;
@@ -283,13 +409,19 @@ bool transport_tx(mesh_packet_t* p_packet, uint8_t slot, uint8_t repeats, tx_int
 
 void transport_tx_reset(uint8_t slot)
 {
-    if (slot < TRANSPORT_TX_SLOTS)
+    if (slot < TRANSPORT_TX_SLOTS && m_tx[slot].p_packet != NULL)
     {
+        uint32_t was_masked;
+        _DISABLE_IRQS(was_masked);
         tx_t* p_tx = &m_tx[slot];
+        schedule_remove(slot);
         p_tx->count = 0;
+        p_tx->acks = 0;
         p_tx->ticks_start = NRF_RTC0->COUNTER;
         set_next_tx(p_tx);
+        schedule_insert(slot);
         order_next_rtc();
+        _ENABLE_IRQS(was_masked);
     }
 }
 
@@ -299,7 +431,10 @@ void transport_tx_skip(uint8_t slot)
     if (slot < TRANSPORT_TX_SLOTS)
     {
         tx_t* p_tx = &m_tx[slot];
-        p_tx->redundancy++;
+        if (p_tx->redundancy < REDUNDANCY_MAX)
+        {
+            p_tx->redundancy++;
+        }
     }
     NVIC_EnableIRQ(RTC0_IRQn);
 }
@@ -308,11 +443,13 @@ void transport_tx_abort(uint8_t slot)
 {
     NVIC_DisableIRQ(RTC0_IRQn);
 
-    if (slot < TRANSPORT_TX_SLOTS)
+    if (slot < TRANSPORT_TX_SLOTS && m_tx[slot].p_packet != NULL)
     {
         tx_t* p_tx = &m_tx[slot];
+        schedule_remove(slot);
         mesh_packet_ref_count_dec(p_tx->p_packet);
         memset(p_tx, 0, sizeof(tx_t));
+        p_tx->next = TX_SLOT_NONE;
 
         order_next_rtc();
     }
@@ -323,50 +460,65 @@ void transport_rtc_irq_handler(void)
 {
     const uint32_t ticks_now = NRF_RTC0->COUNTER + RTC_MARGIN;
 
-    for (uint32_t i = 0; i < TRANSPORT_TX_SLOTS; ++i)
+    /* The schedule is sorted, only the head has to be checked. */
+    while (m_tx_head != TX_SLOT_NONE &&
+        ((ticks_now - m_tx[m_tx_head].ticks_next) & RTC_MASK) <=
+        ((ticks_now - m_ticks_at_order_time) & RTC_MASK))
     {
-        if (m_tx[i].p_packet != NULL &&
-            ((ticks_now - m_tx[i].ticks_next) & RTC_MASK) <=
-            ((ticks_now - m_ticks_at_order_time) & RTC_MASK))
-        {
-            radio_event_t radio_evt;
-            radio_evt.event_type = RADIO_EVENT_TYPE_TX;
-            radio_evt.packet_ptr = (uint8_t*) m_tx[i].p_packet;
-            radio_evt.access_address = 0;
+        const uint8_t slot = m_tx_head;
+        tx_t* p_tx = &m_tx[slot];
+        m_tx_head = p_tx->next;
+        p_tx->next = TX_SLOT_NONE;
+
+        radio_event_t radio_evt;
+        radio_evt.event_type = RADIO_EVENT_TYPE_TX;
+        radio_evt.packet_ptr = (uint8_t*) p_tx->p_packet;
+        radio_evt.access_address = 0;
 
 #ifdef DEBUG_LEDS
-            NRF_GPIO->OUT ^= LED_1;
+        NRF_GPIO->OUT ^= LED_1;
 #endif
-            uint8_t radio_refs = 0;
-            if (m_tx[i].redundancy < REDUNDANCY_MAX)
+        uint8_t radio_refs = 0;
+        if (p_tx->redundancy < REDUNDANCY_MAX)
+        {
+            for (radio_evt.channel = 37; radio_evt.channel <= 39; ++radio_evt.channel)
             {
-                for (radio_evt.channel = 37; radio_evt.channel <= 39; ++radio_evt.channel)
+                if (radio_order(&radio_evt) == NRF_SUCCESS)
                 {
-                    if (radio_order(&radio_evt) == NRF_SUCCESS)
-                    {
-                        radio_refs++;
-                        mesh_packet_ref_count_inc(m_tx[i].p_packet);
-                    }
+                    radio_refs++;
+                    mesh_packet_ref_count_inc(p_tx->p_packet);
                 }
             }
+        }
 
-            m_tx[i].redundancy = 0;
+        p_tx->redundancy = 0;
 
-            if (m_tx[i].count++ == 0xFF)
+        if (p_tx->type == TX_INTERVAL_TYPE_TRICKLE)
+        {
+            /* the next interval starts where this one ends */
+            p_tx->ticks_start = (p_tx->ticks_start + trickle_interval_get(p_tx)) & RTC_MASK;
+            if (p_tx->count < TRICKLE_DOUBLINGS_MAX)
             {
-                m_tx[i].ticks_start = (m_tx[i].ticks_start + INTERVAL * 2 * 0x100) & RTC_MASK;
+                p_tx->count++;
             }
+        }
+        else if (p_tx->count++ == 0xFF)
+        {
+            p_tx->ticks_start = (p_tx->ticks_start + INTERVAL * 2 * 0x100) & RTC_MASK;
+        }
 
-            if (m_tx[i].count < m_tx[i].repeats || m_tx[i].repeats == TX_REPEATS_INF)
-            {
-                /* exponentially increasing intervals, geometric series. */
-                set_next_tx(&m_tx[i]);
-            }
-            else
-            {
-                mesh_packet_ref_count_dec(m_tx[i].p_packet);
-                memset(&m_tx[i], 0, sizeof(tx_t));
-            }
+        const uint32_t repeats = tx_repeats_get(p_tx);
+        if (p_tx->type == TX_INTERVAL_TYPE_TRICKLE || p_tx->count < repeats || repeats == TX_REPEATS_INF)
+        {
+            /* exponentially increasing intervals, geometric series. */
+            set_next_tx(p_tx);
+            schedule_insert(slot);
+        }
+        else
+        {
+            mesh_packet_ref_count_dec(p_tx->p_packet);
+            memset(p_tx, 0, sizeof(tx_t));
+            p_tx->next = TX_SLOT_NONE;
         }
     }
     order_next_rtc();
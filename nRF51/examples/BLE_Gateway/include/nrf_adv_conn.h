@@ -35,7 +35,37 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdint.h>
 
+/* The gateway advertises at NRF_ADV_CONN_FAST_INTERVAL after boot and after a
+   disconnect, and doubles the interval every NRF_ADV_CONN_STAGE_TIMEOUT_S
+   seconds up to NRF_ADV_CONN_SLOW_INTERVAL, so an unconnected gateway costs
+   the mesh few timeslots. Intervals are in 625us units. */
+#ifndef NRF_ADV_CONN_FAST_INTERVAL
+#define NRF_ADV_CONN_FAST_INTERVAL      (320)   /* 200ms */
+#endif
+#ifndef NRF_ADV_CONN_SLOW_INTERVAL
+#define NRF_ADV_CONN_SLOW_INTERVAL      (2048)  /* 1.28s */
+#endif
+#ifndef NRF_ADV_CONN_FAST_TIMEOUT_S
+#define NRF_ADV_CONN_FAST_TIMEOUT_S     (30)
+#endif
+#ifndef NRF_ADV_CONN_STAGE_TIMEOUT_S
+#define NRF_ADV_CONN_STAGE_TIMEOUT_S    (30)
+#endif
+
+/* Above NRF_ADV_CONN_LOAD_PAUSE_RATE mesh value events per second, counted
+   with nrf_adv_conn_mesh_rx() over an advertising stage, the gateway drops to
+   NRF_ADV_CONN_PAUSE_INTERVAL until the load goes down. 0 turns this off. */
+#ifndef NRF_ADV_CONN_LOAD_PAUSE_RATE
+#define NRF_ADV_CONN_LOAD_PAUSE_RATE    (0)
+#endif
+#ifndef NRF_ADV_CONN_PAUSE_INTERVAL
+#define NRF_ADV_CONN_PAUSE_INTERVAL     (0x4000) /* 10.24s, the longest allowed */
+#endif
+
 void nrf_adv_conn_init(void);
 void nrf_adv_conn_evt_handler(ble_evt_t *evt);
 
+/* Count a value event from the mesh, for the load based pause. */
+void nrf_adv_conn_mesh_rx(void);
+
 #endif /* __NRF_ADV_CONN_H__ */
@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "led_config.h"
 
 #include "rbc_mesh.h"
+#include "mesh_gatt.h"
 
 #include "ble.h"
 #include "ble_advdata.h"
@@ -42,9 +43,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
-                            
-#define BLE_ADV_INTERVAL_750MS (800)
-#define BLE_ADV_INTERVAL_200MS (320)
+
+#if (NRF_ADV_CONN_FAST_INTERVAL > NRF_ADV_CONN_SLOW_INTERVAL || \
+     NRF_ADV_CONN_SLOW_INTERVAL > NRF_ADV_CONN_PAUSE_INTERVAL || \
+     NRF_ADV_CONN_PAUSE_INTERVAL > BLE_GAP_ADV_INTERVAL_MAX)
+#error "The advertising intervals must grow from fast to slow to pause, up to BLE_GAP_ADV_INTERVAL_MAX"
+#endif
 
 /*****************************************************************************
 * Static Globals
@@ -61,11 +65,18 @@ static ble_gap_adv_params_t ble_adv_params = {
     NULL,                      /* No Whitelist */
 #endif
     BLE_GAP_ADV_FP_ANY,        /* Don't filter */
-    BLE_ADV_INTERVAL_200MS,    /* Advertising interval set to intentionally disrupt the timeslot example */
-    0,                         /* Timeout in seconds */
+    NRF_ADV_CONN_FAST_INTERVAL, /* Advertising interval, backed off in adv_start() */
+    NRF_ADV_CONN_FAST_TIMEOUT_S, /* Timeout in seconds, ends the stage */
     {0, 0, 0}
 };
 
+/* Advertising stages since boot or the last disconnect */
+static uint8_t m_adv_stage;
+/* Mesh value events since the current stage started */
+static volatile uint32_t m_mesh_rx_count;
+/* Connected GATT clients, advertising goes on until all links are taken */
+static uint8_t m_conn_count;
+
 static ble_advdata_t ble_adv_data;
 static ble_gap_sec_params_t ble_gap_bond_params = {
     .bond = 0,                         /* Don't perform bonding */
@@ -79,6 +90,35 @@ static ble_gap_sec_params_t ble_gap_bond_params = {
 /*****************************************************************************
 * Static Functions
 *****************************************************************************/
+
+/* Start advertising for the current stage. */
+static void adv_start(void)
+{
+    uint32_t interval = NRF_ADV_CONN_FAST_INTERVAL;
+    for (uint32_t i = 0; i < m_adv_stage && interval < NRF_ADV_CONN_SLOW_INTERVAL; ++i)
+    {
+        interval *= 2;
+    }
+    if (interval > NRF_ADV_CONN_SLOW_INTERVAL)
+    {
+        interval = NRF_ADV_CONN_SLOW_INTERVAL;
+    }
+#if (NRF_ADV_CONN_LOAD_PAUSE_RATE > 0)
+    /* The first stage is never paused, a fresh boot or disconnect is when a
+       central is most likely to come back. The count covers the stage that
+       just timed out, which is as long as the previous timeout. */
+    if (m_adv_stage > 0 &&
+        m_mesh_rx_count > (uint32_t) NRF_ADV_CONN_LOAD_PAUSE_RATE * ble_adv_params.timeout)
+    {
+        interval = NRF_ADV_CONN_PAUSE_INTERVAL;
+    }
+#endif
+    m_mesh_rx_count = 0;
+    ble_adv_params.timeout = (m_adv_stage == 0) ? NRF_ADV_CONN_FAST_TIMEOUT_S : NRF_ADV_CONN_STAGE_TIMEOUT_S;
+
+    ble_adv_params.interval = interval;
+    APP_ERROR_CHECK(sd_ble_gap_adv_start(&ble_adv_params));
+}
  
 static void ble_gatts_event_handler(ble_evt_t* evt)
 {
@@ -104,10 +144,34 @@ static void ble_gap_event_handler(ble_evt_t* evt)
     switch (evt->header.evt_id)
     {
     case BLE_GAP_EVT_CONNECTED:
+        /* the SoftDevice stops advertising on every new connection */
+        m_conn_count++;
+        if (m_conn_count < MESH_GATT_CONN_COUNT_MAX)
+        {
+            m_adv_stage = 0;
+            adv_start();
+        }
         break;
 
     case BLE_GAP_EVT_DISCONNECTED:
-        sd_ble_gap_adv_start(&ble_adv_params);
+        /* still advertising if there was a free link */
+        if (m_conn_count-- == MESH_GATT_CONN_COUNT_MAX)
+        {
+            m_adv_stage = 0;
+            adv_start();
+        }
+        break;
+
+    case BLE_GAP_EVT_TIMEOUT:
+        if (evt->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_ADVERTISING)
+        {
+            /* back off to the next stage */
+            if (m_adv_stage < UINT8_MAX)
+            {
+                m_adv_stage++;
+            }
+            adv_start();
+        }
         break;
 
     case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
@@ -136,6 +200,14 @@ void nrf_adv_conn_init(void)
     ble_enable_params_t ble_enable;
     ble_enable.gatts_enable_params.attr_tab_size = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
     ble_enable.gatts_enable_params.service_changed = 0;
+#if (MESH_GATT_CONN_COUNT_MAX > 1)
+    ble_enable.gap_enable_params.periph_conn_count = MESH_GATT_CONN_COUNT_MAX;
+    ble_enable.gap_enable_params.central_conn_count = 0;
+    ble_enable.gap_enable_params.central_sec_count = 0;
+    ble_enable.gap_enable_params.p_device_name = NULL;
+    ble_enable.common_enable_params.vs_uuid_count = 1;
+    ble_enable.common_enable_params.p_conn_bw_counts = NULL;
+#endif
     
 #if NORDIC_SDK_VERSION >= 11
     uint32_t ram_base = RAM_R1_BASE;
@@ -180,11 +252,16 @@ void nrf_adv_conn_init(void)
     APP_ERROR_CHECK(error_code);
 
     /* Start advertising */
-    error_code = sd_ble_gap_adv_start(&ble_adv_params);
-    APP_ERROR_CHECK(error_code);
+    m_adv_stage = 0;
+    adv_start();
 }
 
 
+void nrf_adv_conn_mesh_rx(void)
+{
+    m_mesh_rx_count++;
+}
+
 void nrf_adv_conn_evt_handler(ble_evt_t* evt)
 {
     switch (evt->header.evt_id & 0xF0)
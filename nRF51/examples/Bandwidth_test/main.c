@@ -28,10 +28,34 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 
+/**
+* @file Mesh throughput and latency benchmark. A single firmware image for all
+*   nodes on the bench, configured at runtime by a host runner (see
+*   application_controller/interactive_pyaci/bench_runner.py) over the serial
+*   ACI. The host writes a @ref bench_config_t to the config handle on the node
+*   it's connected to, and the configuration propagates to all other nodes
+*   through the mesh:
+*   - Nodes with a node ID in the configured handle range are sources, and
+*     update the value with their node ID as handle at the configured rate,
+*     with a @ref bench_report_t as payload.
+*   - The node with the configured sink ID acknowledges every source update on
+*     the source handle + @ref BENCH_ACK_HANDLE_OFFSET when ack mode is on.
+*     Sources measure the round trip time of every acknowledged update. With
+*     the ack bitmap flag, the sink instead collects the acknowledgements of
+*     all sources in a @ref bench_ack_bitmap_t on @ref BENCH_ACK_BITMAP_HANDLE,
+*     sent once per update interval. Sources missing from it send their update
+*     again.
+*   - All other nodes relay, unless the no-relay flag is set.
+*   The node connected to the host only observes the reports, and forwards
+*   them over the ACI. Its node ID must be outside the source range, and not be
+*   the sink.
+*/
+
 #include "rbc_mesh.h"
-#include "nrf_adv_conn.h"
 #include "led_config.h"
 #include "mesh_aci.h"
+#include "mesh_log.h"
+#include "toolchain.h"
 
 #include "softdevice_handler.h"
 #include "app_error.h"
@@ -40,64 +64,87 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
-#include <stdio.h>
-
-#include "SEGGER_RTT.h"
-
-#if defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-#include "handle.h"
-#endif
-
-/* Debug macros for debugging with logic analyzer */
-#define SET_PIN(x) NRF_GPIO->OUTSET = (1 << (x))
-#define CLEAR_PIN(x) NRF_GPIO->OUTCLR = (1 << (x))
-#define TICK_PIN(x) do { SET_PIN((x)); CLEAR_PIN((x)); }while(0)
 
 #define MESH_ACCESS_ADDR        (RBC_MESH_ACCESS_ADDRESS_BLE_ADV)
 #define MESH_INTERVAL_MIN_MS    (100)
 #define MESH_CHANNEL            (38)
 #define MESH_CLOCK_SOURCE       (NRF_CLOCK_LFCLKSRC_XTAL_75_PPM)
 
+#define BENCH_CONFIG_HANDLE     (0xFFE0)    /**< Handle the host writes the benchmark configuration to. */
+#define BENCH_ACK_HANDLE_OFFSET (0x4000)    /**< Offset from a source handle to the handle its updates are acknowledged on. */
+#define BENCH_ACK_BITMAP_HANDLE (0xFFE1)    /**< Handle the sink sends the ack bitmap on. */
+#define BENCH_NODE_ID_ADDR      (0x3F000)   /**< Flash word holding the node ID, written when flashing the bench. */
+#define BENCH_RTC_FREQ_HZ       (32768)
 
-#if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)
-
-#define NODE_NUMBER  105
-#define SLAVE_NUMBER (NODE_NUMBER-1)
-
-static char UpBuffer0[BUFFER_SIZE_UP];
-static uint8_t packet_array [300] ;
-static uint16_t packet_index = 0 ;
-static uint32_t packet_count[NODE_NUMBER] __attribute__((at(0x20004688)));
-static uint8_t handle_array [NODE_NUMBER] ;
-static uint8_t flag [NODE_NUMBER];
-static uint8_t last_value[NODE_NUMBER];
-static uint8_t present_value [NODE_NUMBER];
-static uint32_t global_packet_count = 0;
-
-#endif
-
-#if defined(WITH_ACK_SLAVE)
-
-static char UpBuffer0[BUFFER_SIZE_UP];
-uint32_t node_handle;
-static uint32_t total_tx_number __attribute__((at(0x20004688)));
-static uint32_t packet_rcv __attribute__((at(0x2000468C))) ;
-static uint8_t node_data [RBC_MESH_VALUE_MAX_LEN ] ;
-static uint32_t tx_time=0;
-static uint8_t control=0;
+#if BENCH_CONFIG_HANDLE > RBC_MESH_APP_MAX_HANDLE || BENCH_ACK_BITMAP_HANDLE > RBC_MESH_APP_MAX_HANDLE
+#error "The bench handles are reserved in this build, build without RBC_MESH_BOOTSTRAP, RBC_MESH_NETWORK_CODING and RBC_MESH_CONFIG_PUSH"
 #endif
 
-#if defined(WITHOUT_ACK_SLAVE)
+#define BENCH_FLAG_ACK          (1 << 0)    /**< The sink acknowledges every source update. */
+#define BENCH_FLAG_NO_RELAY     (1 << 1)    /**< Nodes only retransmit the values they own, for single hop tests. */
+#define BENCH_FLAG_ACK_BITMAP   (1 << 2)    /**< The sink acknowledges all sources in one bitmap per interval. */
 
-static char UpBuffer0[BUFFER_SIZE_UP];
-uint32_t node_handle ;
-static uint8_t node_data [RBC_MESH_VALUE_MAX_LEN ] ;
-static uint32_t packet_count __attribute__((at(0x20004688)));
-static uint32_t packet_rcv __attribute__((at(0x2000468C))) ;
+#define BENCH_ACK_BITMAP_LEN    (RBC_MESH_VALUE_MAX_LEN - 2) /**< Bytes of source bits in the ack bitmap. */
 
-#endif
+/** Log format IDs, the format strings are in log_formats.txt. */
+#define BENCH_LOG_CONFIG        (MESH_LOG_ID_APP_BASE + 0)
+#define BENCH_LOG_FIRST_TX      (MESH_LOG_ID_APP_BASE + 1)
+#define BENCH_LOG_ACK           (MESH_LOG_ID_APP_BASE + 2)
+#define BENCH_LOG_RESEND        (MESH_LOG_ID_APP_BASE + 3)
 
+/** Benchmark configuration, as written to @ref BENCH_CONFIG_HANDLE by the host. */
+typedef __packed_armcc struct
+{
+    uint8_t round;          /**< Benchmark round, changed by the host for every run. 0 stops all sources. */
+    uint8_t flags;          /**< BENCH_FLAG_* */
+    uint8_t payload_len;    /**< Length of the source updates, at least sizeof(bench_report_t). */
+    uint8_t reserved;
+    uint16_t first_handle;  /**< First source handle. */
+    uint16_t last_handle;   /**< Last source handle. */
+    uint16_t sink_id;       /**< Node ID of the acknowledging node. */
+    uint16_t interval_ms;   /**< Time between two updates from each source. */
+} __packed_gcc bench_config_t;
+
+/** Source update payload, padded with zeros to the configured payload length. */
+typedef __packed_armcc struct
+{
+    uint16_t seq;           /**< Sequence number of the update, starting at 1 every round. */
+    uint8_t round;          /**< Round the update belongs to. */
+    uint8_t reserved;
+    uint32_t rtt_us;        /**< Round trip time of the last acknowledged update, 0 if none. */
+    uint16_t rtt_seq;       /**< Sequence number the round trip time was measured for. */
+    uint16_t ack_count;     /**< Number of updates acknowledged this round. */
+    uint16_t tx_count;      /**< Number of transmissions of the source value this round, saturating. */
+} __packed_gcc bench_report_t;
+
+/** Acknowledgement payload, written by the sink. */
+typedef __packed_armcc struct
+{
+    uint16_t seq;
+    uint8_t round;
+} __packed_gcc bench_ack_t;
 
+/** Ack bitmap payload, written by the sink once per update interval. */
+typedef __packed_armcc struct
+{
+    uint8_t round;
+    uint8_t poll;           /**< Incremented for every bitmap. */
+    uint8_t bitmap[BENCH_ACK_BITMAP_LEN]; /**< Bit n is set if source first_handle + n has sent an update since the last bitmap. */
+} __packed_gcc bench_ack_bitmap_t;
+
+static bench_config_t m_config;
+static uint16_t m_node_id = RBC_MESH_INVALID_HANDLE;
+static uint16_t m_seq;
+static bool m_seq_tx_stamped;
+static uint32_t m_seq_tx_time_us;
+static uint16_t m_rtt_seq;
+static uint16_t m_ack_seq;
+static uint32_t m_rtt_us;
+static uint16_t m_ack_count;
+static uint16_t m_tx_count;
+static bench_ack_bitmap_t m_ack_bitmap; /**< Sink: the bitmap being collected. Sources: the last poll seen in poll. */
+static uint32_t m_interval_ticks;
+static volatile bool m_update_due;
 
 /**
 * @brief General error handler.
@@ -147,224 +194,279 @@ void HardFault_Handler(void)
 void sd_ble_evt_handler(ble_evt_t* p_ble_evt)
 {
     rbc_mesh_ble_evt_handler(p_ble_evt);
-    nrf_adv_conn_evt_handler(p_ble_evt);
 }
+
+/** @brief Update timer, sets the update flag for the main loop. */
+void RTC1_IRQHandler(void)
+{
+    if (NRF_RTC1->EVENTS_COMPARE[0])
+    {
+        NRF_RTC1->EVENTS_COMPARE[0] = 0;
+        NRF_RTC1->CC[0] = (NRF_RTC1->CC[0] + m_interval_ticks) & RTC_COUNTER_COUNTER_Msk;
+        m_update_due = true;
+    }
+}
+
+static void update_timer_init(void)
+{
+    NRF_RTC1->PRESCALER = 0;
+    NRF_RTC1->EVTENSET = RTC_EVTENSET_COMPARE0_Msk;
+    NRF_RTC1->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+    NVIC_SetPriority(RTC1_IRQn, 3);
+    NVIC_EnableIRQ(RTC1_IRQn);
+    NRF_RTC1->TASKS_START = 1;
+}
+
+static void update_timer_start(uint16_t interval_ms)
+{
+    m_interval_ticks = ((uint32_t) interval_ms * BENCH_RTC_FREQ_HZ) / 1000;
+    if (m_interval_ticks == 0)
+    {
+        m_interval_ticks = 1;
+    }
+    NRF_RTC1->EVENTS_COMPARE[0] = 0;
+    NRF_RTC1->CC[0] = (NRF_RTC1->COUNTER + m_interval_ticks) & RTC_COUNTER_COUNTER_Msk;
+    NRF_RTC1->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+}
+
+static void update_timer_stop(void)
+{
+    NRF_RTC1->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+    m_update_due = false;
+}
+
+static bool is_source(void)
+{
+    return (m_config.round != 0 &&
+            m_node_id >= m_config.first_handle &&
+            m_node_id <= m_config.last_handle);
+}
+
+static bool is_sink(void)
+{
+    return (m_config.round != 0 && m_node_id == m_config.sink_id);
+}
+
+static bool is_source_handle(rbc_mesh_value_handle_t handle)
+{
+    return (handle >= m_config.first_handle && handle <= m_config.last_handle);
+}
+
+static bool is_ack_bitmap(void)
+{
+    return ((m_config.flags & (BENCH_FLAG_ACK | BENCH_FLAG_ACK_BITMAP)) ==
+            (BENCH_FLAG_ACK | BENCH_FLAG_ACK_BITMAP));
+}
+
+/** Send the report for the current sequence number. */
+static void source_report_send(void)
+{
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+    bench_report_t* p_report = (bench_report_t*) data;
+
+    memset(data, 0, sizeof(data));
+    p_report->seq = m_seq;
+    p_report->round = m_config.round;
+    p_report->rtt_us = m_rtt_us;
+    p_report->rtt_seq = m_rtt_seq;
+    p_report->ack_count = m_ack_count;
+    p_report->tx_count = m_tx_count;
+
+    APP_ERROR_CHECK(rbc_mesh_value_set(m_node_id, data, m_config.payload_len));
+}
+
+static void source_update_send(void)
+{
+    m_seq++;
+    m_seq_tx_stamped = false;
+    source_report_send();
+}
+
+/** Acknowledge the current update, the first time it's acknowledged. */
+static void source_ack_rx(uint16_t seq, uint32_t timestamp_us)
+{
+    if (seq == m_ack_seq)
+    {
+        return;
+    }
+    m_ack_seq = seq;
+    m_ack_count++;
+    /* only the current update has a known transmit time */
+    if (seq == m_seq && m_seq_tx_stamped)
+    {
+        m_rtt_us = timestamp_us - m_seq_tx_time_us;
+        m_rtt_seq = seq;
+    }
+    MESH_LOG(BENCH_LOG_ACK, seq, (m_rtt_seq == seq ? m_rtt_us : 0));
+    nrf_gpio_pin_toggle(LED_START);
+}
+
+/** Check the source's bit in a new ack bitmap. A clear bit polls the source
+ * for its update again. */
+static void source_ack_bitmap_rx(const bench_ack_bitmap_t* p_bitmap, uint32_t timestamp_us)
+{
+    if (p_bitmap->round != m_config.round || p_bitmap->poll == m_ack_bitmap.poll)
+    {
+        return;
+    }
+    m_ack_bitmap.poll = p_bitmap->poll;
+
+    uint32_t bit = m_node_id - m_config.first_handle;
+    if (p_bitmap->bitmap[bit / 8] & (1 << (bit % 8)))
+    {
+        source_ack_rx(m_seq, timestamp_us);
+    }
+    else if (m_seq_tx_stamped && m_ack_seq != m_seq)
+    {
+        /* the sink missed the update, keep its transmit time for the round trip */
+        MESH_LOG(BENCH_LOG_RESEND, m_seq, p_bitmap->poll);
+        source_report_send();
+    }
+}
+
+/** Send the collected ack bitmap, and start a new one. Sent even if it's
+ * empty, as the clear bits poll the sources again. */
+static void sink_ack_bitmap_send(void)
+{
+    m_ack_bitmap.round = m_config.round;
+    m_ack_bitmap.poll++;
+    APP_ERROR_CHECK(rbc_mesh_value_set(BENCH_ACK_BITMAP_HANDLE, (uint8_t*) &m_ack_bitmap, sizeof(m_ack_bitmap)));
+    memset(m_ack_bitmap.bitmap, 0, sizeof(m_ack_bitmap.bitmap));
+}
+
+/** Apply a new configuration from the host. Invalid configurations stop the benchmark. */
+static void config_apply(uint8_t* p_data, uint8_t len)
+{
+    bench_config_t config;
+    memset(&config, 0, sizeof(config));
+    if (len >= sizeof(config))
+    {
+        memcpy(&config, p_data, sizeof(config));
+    }
+
+    if (config.round == m_config.round)
+    {
+        return;
+    }
+
+    if (config.payload_len < sizeof(bench_report_t) ||
+        config.payload_len > RBC_MESH_VALUE_MAX_LEN ||
+        config.first_handle > config.last_handle ||
+        config.last_handle >= BENCH_ACK_HANDLE_OFFSET ||
+        ((config.flags & BENCH_FLAG_ACK_BITMAP) &&
+         config.last_handle - config.first_handle >= BENCH_ACK_BITMAP_LEN * 8) ||
+        config.interval_ms == 0)
+    {
+        config.round = 0;
+    }
+
+    update_timer_stop();
+    MESH_LOG(BENCH_LOG_CONFIG, config.round | (config.flags << 8) | (config.payload_len << 16), config.interval_ms);
+    m_config = config;
+    m_seq = 0;
+    m_rtt_seq = 0;
+    m_ack_seq = 0;
+    m_rtt_us = 0;
+    m_ack_count = 0;
+    m_tx_count = 0;
+    memset(&m_ack_bitmap, 0, sizeof(m_ack_bitmap));
+
+    if (is_source())
+    {
+        source_update_send();
+        APP_ERROR_CHECK(rbc_mesh_tx_event_set(m_node_id, true));
+        update_timer_start(m_config.interval_ms);
+    }
+    else if (is_sink() && is_ack_bitmap())
+    {
+        update_timer_start(m_config.interval_ms);
+    }
+}
+
 /**
-* @brief RBC_MESH framework event handler. Defined in rbc_mesh.h. Handles
-*   events coming from the mesh. Sets LEDs according to data
+* @brief RBC_MESH framework event handler. Runs the benchmark roles.
 *
-* @param[in] evt RBC event propagated from framework
+* @param[in] p_evt RBC event propagated from framework
 */
 static void rbc_mesh_event_handler(rbc_mesh_event_t* p_evt)
 {
-    TICK_PIN(28);
-    
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)|| defined (WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-    
-	uint32_t error_code;
-	char time_buffer[100];
-	int index_count = 0;
-    
-    #endif
-	
-	
     switch (p_evt->type)
     {
         case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
-					
-                  #if defined(WITH_ACK_MASTER)
-				  error_code = rbc_mesh_value_set(p_evt->params.rx.value_handle,&p_evt->params.rx.p_data[0],1);
-                  APP_ERROR_CHECK(error_code);
-                  break;
-                  #endif
-                  
-                  #if defined(WITHOUT_ACK_MASTER)
-                  error_code =rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-                  APP_ERROR_CHECK(error_code);
-                  break;
-                  #endif
-          
-					
         case RBC_MESH_EVENT_TYPE_NEW_VAL:
-				  
-                  #if defined(WITH_ACK_MASTER)	   				      
-				  error_code = rbc_mesh_value_set(p_evt->params.rx.value_handle,&p_evt->params.rx.p_data[0],1);
-                  APP_ERROR_CHECK(error_code);
-                  break;
-                  #endif
-        
-                  #if defined(WITHOUT_ACK_MASTER)
-                  error_code =rbc_mesh_value_disable(p_evt->params.rx.value_handle); 
-                  APP_ERROR_CHECK(error_code);        
-                  #endif
-        
-                  #if defined (WITH_ACK_SLAVE)
-        
-                  packet_rcv= packet_rcv+1;
-				  if(p_evt->params.rx.value_handle!= node_handle)
-							   {
-								    rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-							   }
-				  else if (p_evt->params.rx.value_handle == node_handle)
-							   {
-									if (p_evt->params.rx.p_data[0] >= node_data[0] )
-										 {										 
-											 node_data[0] = p_evt->params.rx.p_data[0] + 1 ;	
-											 error_code = rbc_mesh_value_set(node_handle,&node_data[0],RBC_MESH_VALUE_MAX_LEN);
-											 APP_ERROR_CHECK(error_code);
-											 error_code = rbc_mesh_tx_event_set(node_handle, true);
-                                             APP_ERROR_CHECK(error_code);				 
-											 index_count= snprintf (time_buffer,100, " hdl %d <%d> Rx <%d> rabout<%dus> \n",p_evt->params.rx.value_handle,p_evt->params.rx.timestamp_us,p_evt->params.rx.p_data[0],p_evt->params.rx.timestamp_us-tx_time );
-											 control=0;
-											 SEGGER_RTT_Write(0, time_buffer,index_count );
-											 SEGGER_RTT_printf(0,"\n");
-											 nrf_gpio_pin_toggle(LED_2);
-											 
-									     }
-							   }
-							
-				  break;
-
-                  #endif
-        
-                  #if defined (WITHOUT_ACK_SLAVE)
-                     packet_rcv= packet_rcv+1;
-				     if(p_evt->params.rx.value_handle!= node_handle)
-					     {
-						    rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-					     }
-							
-					break;         
-                  #endif
-        				   
         case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
-					
-                  #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)	
-        
-				    if (p_evt->params.rx.value_handle == handle_array[p_evt->params.rx.value_handle])
-						{
-								if (flag [p_evt->params.rx.value_handle] == 0)
-								 {
-									 last_value  [p_evt->params.rx.value_handle] = p_evt->params.rx.p_data[0] ;
-									 flag [p_evt->params.rx.value_handle] = 1;
-								 }
-					
-								else if (flag [p_evt->params.rx.value_handle] == 1)
-								 {
-									 present_value [p_evt->params.rx.value_handle] = p_evt->params.rx.p_data[0] ;
-
-								 }
-								
-								if ((present_value[p_evt->params.rx.value_handle] > last_value[p_evt->params.rx.value_handle])|| (present_value[p_evt->params.rx.value_handle] == 0))
-									
-								 { 
-									 if (packet_index == 300 ) 
-										    packet_index = 0 ;
-									 
-									 packet_array [packet_index] = last_value [p_evt->params.rx.value_handle] ;
-									 packet_count[p_evt->params.rx.value_handle] ++ ;
-									 global_packet_count ++;
-									 packet_index ++ ;
-									 
-                                     #if defined(WITH_ACK_MASTER)
-									 last_value[p_evt->params.rx.value_handle] = present_value[p_evt->params.rx.value_handle] ;
-                                     #endif
-                                     
-                                     #if defined(WITHOUT_ACK_MASTER)
-                                     last_value[p_evt->params.rx.value_handle] = p_evt->params.rx.p_data[0] ;
-									 #endif
-								 }
-							}
-						
-					  #if defined(WITH_ACK_MASTER)	
-				      error_code = rbc_mesh_value_set(p_evt->params.rx.value_handle,&p_evt->params.rx.p_data[0],1);
-                      APP_ERROR_CHECK(error_code);
-                      index_count= snprintf (time_buffer,150, " M: hdl %d <%d> Rx <%d> tx ver <%d> vdlta <%d>\n",p_evt->params.rx.value_handle,p_evt->params.rx.timestamp_us,p_evt->params.rx.p_data[0],p_evt->params.rx.p_data[0],p_evt->params.rx.version_delta); 
-                      #endif
-                            
-                      #if defined(WITHOUT_ACK_MASTER)	
-                      error_code =rbc_mesh_value_disable(p_evt->params.rx.value_handle); 
-                      APP_ERROR_CHECK(error_code);
-                      index_count= snprintf (time_buffer,50, " M:hdl %d <%d> Rx %d %d vdlta <%d> \n",p_evt->params.rx.value_handle,p_evt->params.rx.timestamp_us,p_evt->params.rx.p_data[0],packet_count[p_evt->params.rx.value_handle],p_evt->params.rx.version_delta);     
-                      #endif
-                            
-                      SEGGER_RTT_Write(0, time_buffer,index_count );
-					  nrf_gpio_pin_toggle(LED_1);
-							
-                      break;
-                   #endif
-                            
-                   #if defined (WITH_ACK_SLAVE) 
-                            
-                      packet_rcv= packet_rcv+1;
-				      if(p_evt->params.rx.value_handle!= node_handle)
-							   {
-								    rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-							   }
-					  else if (p_evt->params.rx.value_handle == node_handle)
-							   {
-									if (p_evt->params.rx.p_data[0] >= node_data[0] )
-										 {
-											 node_data[0] = p_evt->params.rx.p_data[0] + 1 ;	
-											 uint32_t error_code = rbc_mesh_value_set(node_handle,&node_data[0],RBC_MESH_VALUE_MAX_LEN);
-											 APP_ERROR_CHECK(error_code);
-											 error_code = rbc_mesh_tx_event_set(node_handle, true);
-                                             APP_ERROR_CHECK(error_code);
-                                             index_count= snprintf (time_buffer,100, " hdl %d <%d> Rx <%d> vdlta <%d> rabout<%dus> \n",p_evt->params.rx.value_handle,p_evt->params.rx.timestamp_us,p_evt->params.rx.p_data[0],p_evt->params.rx.version_delta,p_evt->params.rx.timestamp_us-tx_time );
-											 control=0;
-											 SEGGER_RTT_Write(0, time_buffer,index_count );
-											 SEGGER_RTT_printf(0,"\n");
-											 nrf_gpio_pin_toggle(LED_3);
-											 
-									    }
-							   }
-            
-                     break;                            
-                   #endif   
-  
-                   #if defined (WITHOUT_ACK_SLAVE)
-                      packet_rcv= packet_rcv+1;
-				      if(p_evt->params.rx.value_handle!= node_handle)
-					     {
-						    rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-					     }
-            
-                     break;
-                   #endif                               
-                            
-                            
-        case RBC_MESH_EVENT_TYPE_TX:	
-            
-             #if defined (WITH_ACK_SLAVE)
-              if (control==0)
-					 {
-						tx_time = p_evt->params.tx.timestamp_us ;
-						control=1;
-					 } 
-
-              index_count= snprintf (time_buffer,100, " hdl %d <%d> Tx <%d> \n",p_evt->params.rx.value_handle,p_evt->params.tx.timestamp_us,node_data[0]);					
-     		  SEGGER_RTT_Write(0, time_buffer,index_count );
-              total_tx_number ++;
-	          nrf_gpio_pin_toggle(LED_1);
-              break;
-             #endif
-            #if defined (WITHOUT_ACK_SLAVE)
-              if(p_evt->params.rx.value_handle!= node_handle)
-				{
-					rbc_mesh_value_disable(p_evt->params.rx.value_handle);
-				}
-			  packet_count=packet_count +1 ;	 
-			  node_data[0] = node_data[0] + 1 ;	 
-			  error_code = rbc_mesh_value_set(node_handle,&node_data[0],RBC_MESH_VALUE_MAX_LEN);
-			  APP_ERROR_CHECK(error_code); 		  
-              index_count= snprintf (time_buffer,50, " hdl %d <%d> Tx %d  %d\n",p_evt->params.tx.value_handle,p_evt->params.tx.timestamp_us,p_evt->params.tx.p_data[0],packet_count);
-			  SEGGER_RTT_Write(0, time_buffer,index_count );			
-              nrf_gpio_pin_toggle(LED_1);	 
-	  		  break;       
-            #endif
-        case RBC_MESH_EVENT_TYPE_INITIALIZED:
-            /* init BLE gateway softdevice application: */
-            nrf_adv_conn_init();
+        {
+            rbc_mesh_value_handle_t handle = p_evt->params.rx.value_handle;
+            if (handle == BENCH_CONFIG_HANDLE)
+            {
+                config_apply(p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            }
+            else if (is_sink() && is_source_handle(handle) && (m_config.flags & BENCH_FLAG_ACK))
+            {
+                bench_report_t report;
+                if (p_evt->params.rx.data_len >= sizeof(report))
+                {
+                    memcpy(&report, p_evt->params.rx.p_data, sizeof(report));
+                    if (report.round == m_config.round)
+                    {
+                        if (is_ack_bitmap())
+                        {
+                            uint32_t bit = handle - m_config.first_handle;
+                            m_ack_bitmap.bitmap[bit / 8] |= (1 << (bit % 8));
+                        }
+                        else
+                        {
+                            bench_ack_t ack = {report.seq, report.round};
+                            APP_ERROR_CHECK(rbc_mesh_value_set(handle + BENCH_ACK_HANDLE_OFFSET, (uint8_t*) &ack, sizeof(ack)));
+                        }
+                    }
+                }
+            }
+            else if (is_source() && is_ack_bitmap() && handle == BENCH_ACK_BITMAP_HANDLE)
+            {
+                if (p_evt->params.rx.data_len >= sizeof(bench_ack_bitmap_t))
+                {
+                    bench_ack_bitmap_t bitmap;
+                    memcpy(&bitmap, p_evt->params.rx.p_data, sizeof(bitmap));
+                    source_ack_bitmap_rx(&bitmap, p_evt->params.rx.timestamp_us);
+                }
+            }
+            else if (is_source() && handle == m_node_id + BENCH_ACK_HANDLE_OFFSET)
+            {
+                bench_ack_t ack;
+                memcpy(&ack, p_evt->params.rx.p_data, sizeof(ack));
+                if (p_evt->params.rx.data_len >= sizeof(ack) &&
+                    ack.round == m_config.round)
+                {
+                    source_ack_rx(ack.seq, p_evt->params.rx.timestamp_us);
+                }
+            }
+            else if ((m_config.flags & BENCH_FLAG_NO_RELAY) &&
+                     handle != m_node_id &&
+                     !(is_sink() && is_source_handle(handle)))
+            {
+                (void) rbc_mesh_value_disable(handle);
+            }
+            break;
+        }
+
+        case RBC_MESH_EVENT_TYPE_TX:
+            if (is_source() && p_evt->params.tx.value_handle == m_node_id)
+            {
+                if (!m_seq_tx_stamped)
+                {
+                    m_seq_tx_time_us = p_evt->params.tx.timestamp_us;
+                    m_seq_tx_stamped = true;
+                    MESH_LOG(BENCH_LOG_FIRST_TX, m_seq, m_seq_tx_time_us);
+                }
+                if (m_tx_count < UINT16_MAX)
+                {
+                    m_tx_count++;
+                }
+            }
+            break;
+
+        default:
             break;
     }
 }
@@ -381,56 +483,23 @@ void gpio_init(void)
     {
         nrf_gpio_pin_set(LED_START + i);
     }
-
-#if defined(BOARD_PCA10001) || defined(BOARD_PCA10028)
-    nrf_gpio_range_cfg_output(0, 32);
-#endif
-
-
-
-}
-
-
-void LFCK_clock_initialization()
-{
-    /* Start 32KHz crystal oscillator */
-    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
-    NRF_CLOCK->TASKS_LFCLKSTART    = 1;
-
-    /* Wait for the external oscillator to start up */
-    while (NRF_CLOCK->EVENTS_LFCLKSTARTED == 0)
-    {
-     
-    }		
 }
 
-
 /** @brief main function */
 int main(void)
 {
     /* init leds and pins */
     gpio_init();
-    NRF_GPIO->OUTSET = (1 << 4);
+
     /* Enable Softdevice (including sd_ble before framework */
     SOFTDEVICE_HANDLER_INIT(MESH_CLOCK_SOURCE, NULL);
-    softdevice_ble_evt_handler_set(sd_ble_evt_handler); /* app-defined event handler, as we need to send it to the nrf_adv_conn module and the rbc_mesh */
+    softdevice_ble_evt_handler_set(sd_ble_evt_handler);
     softdevice_sys_evt_handler_set(rbc_mesh_sd_evt_handler);
-    
-    
-    
-    
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)	
-    
-    for (uint8_t i=0;i<NODE_NUMBER;i++)
-		{
-		    handle_array[i]= i;
-			flag[i]=0;
-			last_value[i]=0;
-			present_value[i]=0;
-			packet_count[i] = 0;
-		}
-    #endif
-        
+
+#ifdef RBC_MESH_SERIAL
+    mesh_aci_init();
+#endif
+
     rbc_mesh_init_params_t init_params;
 
     init_params.access_addr = MESH_ACCESS_ADDR;
@@ -438,73 +507,55 @@ int main(void)
     init_params.channel = MESH_CHANNEL;
     init_params.lfclksrc = MESH_CLOCK_SOURCE;
     init_params.tx_power = RBC_MESH_TXPOWER_0dBm;
-		
+    init_params.p_memory = NULL;
+    init_params.relay_only = false;
+    init_params.p_subscriptions = NULL;
+    init_params.subscription_count = 0;
+    init_params.radio_mode = RBC_MESH_RADIO_MODE_BLE_1MBIT;
+
     uint32_t error_code = rbc_mesh_init(init_params);
     APP_ERROR_CHECK(error_code);
 
-	
-	ble_gap_addr_t my_addr_new;
-    error_code = sd_ble_gap_address_get(&my_addr_new);
-    APP_ERROR_CHECK(error_code);
-	
-    #if defined (WITH_ACK_SLAVE)
-        
-    total_tx_number=0;
-    for (uint8_t i=0; i < RBC_MESH_VALUE_MAX_LEN ; i++)
-		{
-			node_data[i] = 1 ;  
-		}
-		
-    error_code = rbc_mesh_value_set(node_handle,&node_data[0],(RBC_MESH_VALUE_MAX_LEN-1));
+    uint32_t node_id = *((uint32_t*) BENCH_NODE_ID_ADDR);
+    if (node_id <= RBC_MESH_APP_MAX_HANDLE)
+    {
+        m_node_id = node_id;
+    }
+
+    /* keep the configuration in the cache, source values must never push it out */
+    error_code = rbc_mesh_persistence_set(BENCH_CONFIG_HANDLE, true);
     APP_ERROR_CHECK(error_code);
-    error_code = rbc_mesh_tx_event_set(node_handle, true);
-    APP_ERROR_CHECK(error_code);	
-    error_code =rbc_mesh_persistence_set(node_handle, true);
-	APP_ERROR_CHECK(error_code);    
-      
-    #endif   
-
-    #if defined (WITHOUT_ACK_SLAVE)  
-    packet_count=0;
-    for (uint8_t i=0; i < RBC_MESH_VALUE_MAX_LEN ; i++)
-	  {
-		node_data[i] = 1 ;  
-	  }
-		
-    error_code = rbc_mesh_value_set(node_handle,&node_data[0],(RBC_MESH_VALUE_MAX_LEN-1));
-	APP_ERROR_CHECK(error_code);	
-    error_code = rbc_mesh_tx_event_set(node_handle,true);
-    APP_ERROR_CHECK(error_code);	
-	error_code = rbc_mesh_persistence_set(node_handle, true);
-	APP_ERROR_CHECK(error_code);
-    #endif
-      
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)|| defined (WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)    
-    SEGGER_RTT_Init();
-    SEGGER_RTT_ConfigUpBuffer(0, "UpBuffer0", UpBuffer0, BUFFER_SIZE_UP, SEGGER_RTT_MODE_NO_BLOCK_SKIP);
-    #else
-    /* init BLE gateway softdevice application: */
-    nrf_adv_conn_init();
-    #endif 
+
+    update_timer_init();
+
+#ifdef RBC_MESH_SERIAL
+    APP_ERROR_CHECK(mesh_aci_start());
+#endif
 
     /* fetch events */
     rbc_mesh_event_t evt;
     while (true)
     {
+        if (m_update_due)
+        {
+            m_update_due = false;
+            if (is_source())
+            {
+                source_update_send();
+            }
+            else if (is_sink() && is_ack_bitmap())
+            {
+                sink_ack_bitmap_send();
+            }
+        }
+
         if (rbc_mesh_event_get(&evt) == NRF_SUCCESS)
         {
             rbc_mesh_event_handler(&evt);
             rbc_mesh_event_release(&evt);
         }
 
+        MESH_LOG_FLUSH();
         sd_app_evt_wait();
     }
-
 }
-
-
-
-
-
-
-
@@ -0,0 +1,495 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file On-target microbenchmark of the framework's hot paths. Times
+*   the core data structure operations with TIMER2, over a range of handle
+*   cache sizes and fill levels, and writes the results to RTT channel 0 as
+*   CSV lines:
+*
+*       bench,<name>,<handle cache entries>,<fill %>,<iterations>,<min>,<avg>,<max>
+*
+*   The times are in 16MHz timer ticks, which equal CPU cycles on the nRF51,
+*   with the measurement overhead subtracted.
+*/
+
+#include "rbc_mesh.h"
+#include "fifo.h"
+#include "mesh_packet.h"
+#include "handle_storage.h"
+#include "version_handler.h"
+#include "trickle.h"
+#include "timeslot.h"
+#include "event_handler.h"
+#include "SEGGER_RTT.h"
+
+#include "softdevice_handler.h"
+#include "app_error.h"
+#include "nrf.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MESH_ACCESS_ADDR        (0xA541A68F)
+#define MESH_INTERVAL_MIN_MS    (100)
+#define MESH_CHANNEL            (38)
+#define MESH_CLOCK_SRC          (NRF_CLOCK_LFCLKSRC_XTAL_75_PPM)
+
+/** Number of timed calls per measurement. */
+#define BENCH_ITERATIONS        (64)
+/** Largest handle cache in the sweep. The data cache is half the size. */
+#define BENCH_CACHE_ENTRIES_MAX (128)
+/** Memory for the largest caches, checked against handle_storage_memory_size_get() at runtime. */
+#define BENCH_CACHE_MEMORY_SIZE (6144)
+/** Length of the FIFO in the FIFO benchmark. */
+#define BENCH_FIFO_LENGTH       (16)
+/** Payload length of the benchmark values. */
+#define BENCH_VALUE_LENGTH      (8)
+
+typedef struct
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint32_t count;
+} bench_result_t;
+
+static const uint16_t m_cache_sizes[] = {16, 32, 64, BENCH_CACHE_ENTRIES_MAX};
+static const uint8_t m_fill_levels[] = {25, 50, 100};
+
+static uint32_t m_cache_memory[BENCH_CACHE_MEMORY_SIZE / sizeof(uint32_t)];
+static uint16_t m_versions[BENCH_CACHE_ENTRIES_MAX];
+static uint32_t m_timer_overhead;
+static uint32_t m_prng = 1;
+static uint32_t m_time;
+
+/** @brief General error handler. */
+static inline void error_loop(void)
+{
+    __disable_irq();
+    while (true)
+    {
+        __WFE();
+    }
+}
+
+/**
+* @brief Softdevice crash handler, never returns
+*
+* @param[in] pc Program counter at which the assert failed
+* @param[in] line_num Line where the error check failed
+* @param[in] p_file_name File where the error check failed
+*/
+void sd_assert_handler(uint32_t pc, uint16_t line_num, const uint8_t* p_file_name)
+{
+    error_loop();
+}
+
+/**
+* @brief App error handle callback. Called whenever an APP_ERROR_CHECK() fails.
+*   Never returns.
+*
+* @param[in] error_code The error code sent to APP_ERROR_CHECK()
+* @param[in] line_num Line where the error check failed
+* @param[in] p_file_name File where the error check failed
+*/
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+    SEGGER_RTT_printf(0, "error,0x%x,%s,%u\n", error_code, p_file_name, line_num);
+    error_loop();
+}
+
+/** @brief Hardware fault handler. */
+void HardFault_Handler(void)
+{
+    error_loop();
+}
+
+/** @brief Deterministic PRNG for picking handles, so runs are comparable. */
+static uint32_t prng_get(void)
+{
+    m_prng = m_prng * 1664525 + 1013904223;
+    return m_prng >> 8;
+}
+
+/** @brief Handle of the given cache entry, spread out over the handle range. */
+static rbc_mesh_value_handle_t bench_handle(uint32_t index)
+{
+    return (rbc_mesh_value_handle_t) (index * 97 + 1);
+}
+
+static void timer_init(void)
+{
+    NRF_TIMER2->TASKS_STOP = 1;
+    NRF_TIMER2->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER2->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    NRF_TIMER2->PRESCALER = 0;
+    NRF_TIMER2->INTENCLR = 0xFFFFFFFF;
+    NRF_TIMER2->TASKS_CLEAR = 1;
+    NRF_TIMER2->TASKS_START = 1;
+}
+
+/** @brief Start a measurement. Deferred framework work is held back until bench_stop(). */
+static inline uint32_t bench_start(void)
+{
+    event_handler_critical_section_begin();
+    NRF_TIMER2->TASKS_CAPTURE[0] = 1;
+    return NRF_TIMER2->CC[0];
+}
+
+static inline void bench_stop(bench_result_t* p_result, uint32_t start)
+{
+    NRF_TIMER2->TASKS_CAPTURE[1] = 1;
+    uint32_t ticks = (NRF_TIMER2->CC[1] - start) & 0xFFFF;
+    event_handler_critical_section_end();
+
+    ticks = (ticks > m_timer_overhead) ? ticks - m_timer_overhead : 0;
+    if (p_result->count == 0 || ticks < p_result->min)
+    {
+        p_result->min = ticks;
+    }
+    if (ticks > p_result->max)
+    {
+        p_result->max = ticks;
+    }
+    p_result->sum += ticks;
+    p_result->count++;
+}
+
+static void result_print(const char* p_name, uint16_t cache_entries, uint8_t fill, bench_result_t* p_result)
+{
+    SEGGER_RTT_printf(0, "bench,%s,%u,%u,%u,%u,%u,%u\n",
+            p_name, cache_entries, fill, p_result->count,
+            p_result->min, (p_result->count > 0) ? p_result->sum / p_result->count : 0, p_result->max);
+    memset(p_result, 0, sizeof(bench_result_t));
+}
+
+/** @brief Release the events the framework has queued for the application. */
+static void events_drain(void)
+{
+    rbc_mesh_event_t evt;
+    while (rbc_mesh_event_get(&evt) == NRF_SUCCESS)
+    {
+        rbc_mesh_event_release(&evt);
+    }
+}
+
+static void timer_overhead_calibrate(void)
+{
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    m_timer_overhead = 0;
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+    {
+        bench_stop(&result, bench_start());
+    }
+    m_timer_overhead = result.min;
+    SEGGER_RTT_printf(0, "overhead,%u\n", m_timer_overhead);
+}
+
+static void bench_fifo(void)
+{
+    static rbc_mesh_event_t fifo_buffer[BENCH_FIFO_LENGTH];
+    fifo_t fifo;
+    fifo.elem_array = fifo_buffer;
+    fifo.elem_size = sizeof(rbc_mesh_event_t);
+    fifo.array_len = BENCH_FIFO_LENGTH;
+    fifo.memcpy_fptr = NULL;
+
+    rbc_mesh_event_t evt;
+    memset(&evt, 0, sizeof(evt));
+    bench_result_t push;
+    bench_result_t pop;
+    memset(&push, 0, sizeof(push));
+    memset(&pop, 0, sizeof(pop));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* one slot is left free for the push */
+        uint32_t fill = ((BENCH_FIFO_LENGTH - 1) * m_fill_levels[f]) / 100;
+        fifo_init(&fifo);
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            APP_ERROR_CHECK(fifo_push(&fifo, &evt));
+        }
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            uint32_t start = bench_start();
+            uint32_t error_code = fifo_push(&fifo, &evt);
+            bench_stop(&push, start);
+            APP_ERROR_CHECK(error_code);
+
+            start = bench_start();
+            error_code = fifo_pop(&fifo, &evt);
+            bench_stop(&pop, start);
+            APP_ERROR_CHECK(error_code);
+        }
+        result_print("fifo_push", BENCH_FIFO_LENGTH, m_fill_levels[f], &push);
+        result_print("fifo_pop", BENCH_FIFO_LENGTH, m_fill_levels[f], &pop);
+    }
+}
+
+static void bench_packet_pool(void)
+{
+    static mesh_packet_t* p_held[RBC_MESH_PACKET_POOL_SIZE];
+    bench_result_t acquire;
+    bench_result_t release;
+    memset(&acquire, 0, sizeof(acquire));
+    memset(&release, 0, sizeof(release));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* one packet is left free for the acquire */
+        uint32_t fill = ((RBC_MESH_PACKET_POOL_SIZE - 1) * m_fill_levels[f]) / 100;
+        APP_ERROR_CHECK(mesh_packet_init(NULL, 0));
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            (void) mesh_packet_acquire(&p_held[i]);
+        }
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            mesh_packet_t* p_packet = NULL;
+            uint32_t start = bench_start();
+            bool acquired = mesh_packet_acquire(&p_packet);
+            bench_stop(&acquire, start);
+            if (!acquired)
+            {
+                APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+            }
+
+            start = bench_start();
+            (void) mesh_packet_ref_count_dec(p_packet);
+            bench_stop(&release, start);
+        }
+        result_print("mesh_packet_acquire", RBC_MESH_PACKET_POOL_SIZE, m_fill_levels[f], &acquire);
+        result_print("mesh_packet_release", RBC_MESH_PACKET_POOL_SIZE, m_fill_levels[f], &release);
+    }
+    APP_ERROR_CHECK(mesh_packet_init(NULL, 0));
+}
+
+static void bench_trickle(void)
+{
+    bench_result_t timeout;
+    memset(&timeout, 0, sizeof(timeout));
+    trickle_t trickle;
+    memset(&trickle, 0, sizeof(trickle));
+    trickle_timer_reset(&trickle, m_time);
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+    {
+        bool do_tx;
+        uint32_t time_now = trickle.t;
+        uint32_t start = bench_start();
+        trickle_tx_timeout(&trickle, &do_tx, time_now);
+        bench_stop(&timeout, start);
+        if (do_tx)
+        {
+            trickle_tx_register(&trickle, time_now);
+        }
+    }
+    result_print("trickle_tx_timeout", 1, 100, &timeout);
+}
+
+/** @brief Feed a value to the version handler, as the transport does. */
+static uint32_t value_rx(rbc_mesh_value_handle_t handle, uint16_t version, uint32_t crc,
+        bench_result_t* p_result)
+{
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    uint8_t data[BENCH_VALUE_LENGTH];
+    memset(data, (uint8_t) version, sizeof(data));
+    uint32_t error_code = mesh_packet_build(p_packet, handle, version, data, sizeof(data));
+    if (error_code == NRF_SUCCESS)
+    {
+        m_time += 1000;
+        if (p_result != NULL)
+        {
+            uint32_t start = bench_start();
+            error_code = vh_rx(p_packet, crc, m_time, 50);
+            bench_stop(p_result, start);
+        }
+        else
+        {
+            error_code = vh_rx(p_packet, crc, m_time, 50);
+        }
+    }
+    mesh_packet_ref_count_dec(p_packet);
+    events_drain();
+    return error_code;
+}
+
+static void bench_handle_cache(uint16_t cache_entries)
+{
+    handle_storage_memory_t memory;
+    memory.p_memory = m_cache_memory;
+    memory.handle_cache_entries = cache_entries;
+    memory.data_cache_entries = cache_entries / 2;
+    memory.pinned_data_entries = 0;
+    if (handle_storage_memory_size_get(memory.handle_cache_entries, memory.data_cache_entries) > sizeof(m_cache_memory))
+    {
+        SEGGER_RTT_printf(0, "skip,%u\n", cache_entries);
+        return;
+    }
+
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* start from empty caches and pool at each fill level */
+        events_drain();
+        APP_ERROR_CHECK(mesh_packet_init(NULL, 0));
+        APP_ERROR_CHECK(vh_init(MESH_INTERVAL_MIN_MS * 1000, MESH_ACCESS_ADDR, MESH_CHANNEL,
+                    RBC_MESH_TXPOWER_0dBm, &memory));
+
+        uint32_t fill = (cache_entries * m_fill_levels[f]) / 100;
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            m_versions[i] = 1;
+            (void) value_rx(bench_handle(i), m_versions[i], prng_get(), NULL);
+        }
+
+        /* lookups of cached handles, and of handles that aren't in the cache */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            handle_info_t info;
+            uint32_t index = prng_get() % fill;
+            uint32_t start = bench_start();
+            uint32_t error_code = handle_storage_info_get(bench_handle(index), &info);
+            bench_stop(&result, start);
+            if (error_code == NRF_SUCCESS && info.p_packet != NULL)
+            {
+                mesh_packet_ref_count_dec(info.p_packet);
+            }
+        }
+        result_print("handle_lookup_hit", cache_entries, m_fill_levels[f], &result);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            handle_info_t info;
+            uint32_t start = bench_start();
+            uint32_t error_code = handle_storage_info_get(bench_handle(BENCH_CACHE_ENTRIES_MAX + i), &info);
+            bench_stop(&result, start);
+            if (error_code == NRF_SUCCESS && info.p_packet != NULL)
+            {
+                mesh_packet_ref_count_dec(info.p_packet);
+            }
+        }
+        result_print("handle_lookup_miss", cache_entries, m_fill_levels[f], &result);
+
+        /* newer versions of cached handles, the full receive path */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            m_versions[index]++;
+            (void) value_rx(bench_handle(index), m_versions[index], prng_get(), &result);
+        }
+        result_print("vh_rx_new_version", cache_entries, m_fill_levels[f], &result);
+
+        /* retransmissions of the current versions from other nodes */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            (void) value_rx(bench_handle(index), m_versions[index], prng_get(), &result);
+        }
+        result_print("vh_rx_consistent", cache_entries, m_fill_levels[f], &result);
+
+        /* the same packet received twice, caught by the duplicate filter */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            uint32_t crc = prng_get();
+            (void) value_rx(bench_handle(index), m_versions[index], crc, NULL);
+            (void) value_rx(bench_handle(index), m_versions[index], crc, &result);
+        }
+        result_print("vh_rx_duplicate", cache_entries, m_fill_levels[f], &result);
+
+        /* handles that aren't in the cache, evicting the least recently used */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+        {
+            (void) value_rx(bench_handle(BENCH_CACHE_ENTRIES_MAX + i), 1, prng_get(), &result);
+        }
+        result_print("vh_rx_new_handle", cache_entries, m_fill_levels[f], &result);
+    }
+}
+
+int main(void)
+{
+    /* Enable Softdevice (including sd_ble before framework */
+    SOFTDEVICE_HANDLER_INIT(MESH_CLOCK_SRC, NULL);
+    softdevice_ble_evt_handler_set(rbc_mesh_ble_evt_handler);
+
+    SEGGER_RTT_ConfigUpBuffer(0, NULL, NULL, 0, SEGGER_RTT_MODE_BLOCK_IF_FIFO_FULL);
+
+    rbc_mesh_init_params_t init_params;
+    init_params.access_addr = MESH_ACCESS_ADDR;
+    init_params.interval_min_ms = MESH_INTERVAL_MIN_MS;
+    init_params.channel = MESH_CHANNEL;
+    init_params.lfclksrc = MESH_CLOCK_SRC;
+    init_params.tx_power = RBC_MESH_TXPOWER_0dBm;
+    init_params.p_memory = NULL;
+    init_params.relay_only = false;
+    init_params.p_subscriptions = NULL;
+    init_params.subscription_count = 0;
+    init_params.radio_mode = RBC_MESH_RADIO_MODE_BLE_1MBIT;
+
+    uint32_t error_code;
+    error_code = rbc_mesh_init(init_params);
+    APP_ERROR_CHECK(error_code);
+
+    /* Run the benchmarks outside the timeslots, so the radio doesn't interfere */
+    error_code = rbc_mesh_stop();
+    APP_ERROR_CHECK(error_code);
+    while (timeslot_is_in_ts())
+    {
+    }
+
+    timer_init();
+    SEGGER_RTT_WriteString(0, "# bench,name,cache entries,fill %,iterations,min,avg,max\n");
+    timer_overhead_calibrate();
+
+    bench_fifo();
+    bench_packet_pool();
+    bench_trickle();
+    for (uint32_t i = 0; i < sizeof(m_cache_sizes) / sizeof(m_cache_sizes[0]); ++i)
+    {
+        bench_handle_cache(m_cache_sizes[i]);
+    }
+    SEGGER_RTT_WriteString(0, "done\n");
+
+    while (true)
+    {
+        events_drain();
+        sd_app_evt_wait();
+    }
+}
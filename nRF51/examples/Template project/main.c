@@ -131,6 +131,11 @@ int main(void)
     init_params.channel = MESH_CHANNEL;
     init_params.lfclksrc = MESH_CLOCK_SRC;
     init_params.tx_power = RBC_MESH_TXPOWER_0dBm;
+    init_params.p_memory = NULL;
+    init_params.relay_only = false;
+    init_params.p_subscriptions = NULL;
+    init_params.subscription_count = 0;
+    init_params.radio_mode = RBC_MESH_RADIO_MODE_BLE_1MBIT;
 
     uint32_t error_code;
     error_code = rbc_mesh_init(init_params);
@@ -0,0 +1,18 @@
+# Builds the Template project with every framework build profile (see
+# rbc_mesh/profiles.mk) and prints the flash (text + data) and RAM (data + bss)
+# footprint of each.
+CURRDIR=$(pwd)
+cd "Template project/gcc"
+export TARGET_BOARD=${TARGET_BOARD:-BOARD_PCA10031}
+printf "%-16s %8s %8s %8s %8s %8s\n" profile text data bss flash ram
+for p in minimal_relay sensor_leaf gateway dfu_relay ; do
+	make clean > /dev/null
+	if ! make RBC_MESH_PROFILE=$p > /dev/null ; then
+		echo "$p: build failed"
+		continue
+	fi
+	set -- $(make -s RBC_MESH_PROFILE=$p echosize | awk '$NF ~ /\.elf$/ { print $1, $2, $3 }')
+	printf "%-16s %8d %8d %8d %8d %8d\n" $p $1 $2 $3 $(($1 + $2)) $(($2 + $3))
+done
+make clean > /dev/null
+cd "$CURRDIR"
@@ -54,6 +54,8 @@ typedef enum
     BL_CMD_TYPE_DFU_ABORT,
     BL_CMD_TYPE_DFU_BANK_FLASH,                 /**< Tell the bootloader to flash a bank. App will restart afterwards. */
     BL_CMD_TYPE_DFU_BANK_INFO_GET,              /**< Get info on the bank of the given type. */
+    BL_CMD_TYPE_DFU_ROLLBACK_CONFIRM,           /**< Mark the running application as good, so it won't be rolled back. */
+    BL_CMD_TYPE_DFU_ROLLBACK,                   /**< Flash the copy of the previous application. App will restart afterwards. */
 
     /* info opcodes */
     BL_CMD_TYPE_INFO_GET = 0x30,
@@ -109,6 +111,7 @@ typedef enum
     BL_RADIO_INTERVAL_TYPE_EXPONENTIAL,
     BL_RADIO_INTERVAL_TYPE_REGULAR,
     BL_RADIO_INTERVAL_TYPE_REGULAR_SLOW,
+    BL_RADIO_INTERVAL_TYPE_TRICKLE,         /**< Interval doubles while neighbours send the same packet, never ends. */
 } bl_radio_interval_type_t;
 
 typedef enum
@@ -192,6 +195,7 @@ struct bl_cmd
                     dfu_type_t      type;
                     fwid_union_t    fwid;
                     uint32_t        transaction_id; /**< Set to 0 if unknown */
+                    uint32_t*       p_bank_start;   /**< Bank to keep a copy of the transfer in, or NULL. */
                 } relay;
             } start;
             struct
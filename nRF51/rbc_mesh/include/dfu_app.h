@@ -71,7 +71,9 @@ uint32_t dfu_rx(dfu_packet_t* p_packet, uint32_t length);
 * Request a DFU transfer.
 *
 * The DFU transfer will run alongside the application, and store the firmware
-* in the given bank.
+* in the given bank. The transfer is verified in the bank before the bank is
+* reported as available, and the application keeps running until it calls
+* @ref dfu_bank_flash().
 *
 * Generates events:
 *   @RBC_MESH_EVT_DFU_BANK_AVAILABLE: The DFU transfer is finished, and is
@@ -82,6 +84,9 @@ uint32_t dfu_rx(dfu_packet_t* p_packet, uint32_t length);
 *
 * @param[in] type DFU type to request.
 * @param[in] p_fwid Firmware ID to request.
+* @param[in] p_bank_addr Page aligned address of a free flash area large
+* enough for the transfer, or 0xFFFFFFFF to place the bank at the end of the
+* application segment.
 *
 * @return NRF_SUCCESS The dfu module has started requesting the given transfer.
 * @return NRF_ERROR_NULL The FWID pointer provided was NULL.
@@ -119,6 +124,24 @@ uint32_t dfu_request(dfu_type_t type,
 uint32_t dfu_relay(dfu_type_t type,
         fwid_union_t* p_fwid);
 
+/**
+* Relay an ongoing transfer like @ref dfu_relay(), and keep a copy of it in
+* the given bank while relaying. Requests for missing segments from nearby
+* devices are then answered from the copy, instead of being passed on towards
+* the source. The copy is scratch data, it's never flashed, and it's dropped
+* if the device loses track of the transfer.
+*
+* @param[in] type DFU type to request.
+* @param[in] p_fwid Firmware ID to request.
+* @param[in] p_bank_addr Page aligned address of a free flash area large
+* enough for the transfer, or NULL to only relay.
+*
+* @return See @ref dfu_relay().
+*/
+uint32_t dfu_relay_cached(dfu_type_t type,
+        fwid_union_t* p_fwid,
+        uint32_t* p_bank_addr);
+
 /**
 * Abort the ongoing dfu operation.
 *
@@ -151,6 +174,10 @@ uint32_t dfu_bank_info_get(dfu_type_t type, dfu_bank_info_t* p_bank_info);
 * @warning This will trigger a restart of the chip. All non-volatile memory
 * will be lost during this call. If successful, this never returns.
 *
+* Application banks are copied into place by the bootloader, which starts the
+* new application as soon as the copy is done. The copy is stored page by
+* page, and resumes where it left off if the device loses power.
+*
 * @param[in] bank_type The dfu type of the bank to be flashed. There can only
 * be one bank of each dfu type.
 *
@@ -159,6 +186,34 @@ uint32_t dfu_bank_info_get(dfu_type_t type, dfu_bank_info_t* p_bank_info);
 */
 uint32_t dfu_bank_flash(dfu_type_t bank_type);
 
+/**
+* Mark the running application as good. When the bootloader is built with
+* DFU_BANK_ROLLBACK, it keeps a copy of the previous application, and a new
+* application only gets one boot to call this. If it doesn't, the bootloader
+* flashes the previous application back on the next boot.
+*
+* @return NRF_SUCCESS The application is confirmed, or was already.
+* @return NRF_ERROR_NOT_FOUND There's no copy of a previous application.
+* @return NRF_ERROR_NOT_SUPPORTED The bootloader doesn't keep a rollback copy.
+* @return NRF_ERROR_NOT_AVAILABLE The dfu functionality is not available.
+*/
+uint32_t dfu_rollback_confirm(void);
+
+/**
+* Flash the copy of the previous application back, even if the running one
+* has been confirmed. Like @ref dfu_bank_flash(), this restarts the device
+* once the bootloader is ready to copy it, and the copy resumes if the device
+* loses power.
+*
+* @return NRF_SUCCESS The rollback has started.
+* @return NRF_ERROR_NOT_FOUND There's no copy of a previous application.
+* @return NRF_ERROR_INVALID_STATE A bank is being flashed.
+* @return NRF_ERROR_BUSY The bootloader info is busy, try again later.
+* @return NRF_ERROR_NOT_SUPPORTED The bootloader doesn't keep a rollback copy.
+* @return NRF_ERROR_NOT_AVAILABLE The dfu functionality is not available.
+*/
+uint32_t dfu_rollback(void);
+
 /**
 * Get the current state of the DFU module.
 *
@@ -61,11 +61,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define WORD_SIZE          (4)
 
 
-#define SEGMENT_ADDR(segment_id, start_addr) ((segment_id == 1)? \
+/** Address of a segment of the given size, see the start packet. */
+#define SEGMENT_ADDR(segment_id, start_addr, segment_size) ((segment_id == 1)? \
                                                 (uint32_t) start_addr : \
-                                                (((uint32_t) start_addr) & 0xFFFFFFF0) + ((segment_id) - 1) * 16)
+                                                (((uint32_t) start_addr) & ~(DFU_SEGMENT_LENGTH(segment_size) - 1)) + \
+                                                (((uint32_t) (segment_id) - 1) << DFU_SEGMENT_SHIFT(segment_size)))
 
-#define ADDR_SEGMENT(addr, start_addr) (uint32_t)(((((uint32_t) addr) - ((uint32_t) start_addr & 0xFFFFFFFF0)) >> 4) + 1)
+#define ADDR_SEGMENT(addr, start_addr, segment_size) (uint32_t)(((((uint32_t) addr) - \
+                                                ((uint32_t) start_addr & ~(DFU_SEGMENT_LENGTH(segment_size) - 1))) \
+                                                >> DFU_SEGMENT_SHIFT(segment_size)) + 1)
 
 #define PAGE_ALIGN(p_pointer)       (((uint32_t) p_pointer) & (~((uint32_t) (PAGE_SIZE - 1))))
 #define PAGE_OFFSET(p_pointer)      (((uint32_t) p_pointer) & (PAGE_SIZE - 1))
@@ -79,7 +83,36 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define BOOTLOADER_INFO_ADDRESS     (FLASH_SIZE - 1 * PAGE_SIZE)
 #define BOOTLOADER_INFO_BANK_ADDRESS (FLASH_SIZE - 2 * PAGE_SIZE)
 
-#define SEGMENT_LENGTH              (16)
+#define SEGMENT_LENGTH              (16) /**< Length of segment size 0, the smallest segment. */
+#define DFU_SEGMENT_SHIFT(size)     (4 + (size))
+#define DFU_SEGMENT_LENGTH(size)    (1UL << DFU_SEGMENT_SHIFT(size)) /**< Length of the segments of a transfer, given the segment size in its start packet. */
+
+#ifndef DFU_SEGMENT_SIZE_MAX
+/** Largest segment size a node takes part in. A 16 byte segment fills a
+  legacy advertisement packet, longer segments need long packets. */
+#ifdef RBC_MESH_LONG_PACKETS
+#define DFU_SEGMENT_SIZE_MAX        (2)
+#else
+#define DFU_SEGMENT_SIZE_MAX        (0)
+#endif
+#endif
+
+#if !defined(RBC_MESH_LONG_PACKETS) && DFU_SEGMENT_SIZE_MAX > 0
+#error "Segments longer than 16 bytes require RBC_MESH_LONG_PACKETS"
+#endif
+#if DFU_SEGMENT_SIZE_MAX > 2
+#error "DFU_SEGMENT_SIZE_MAX must be at most 2, the signature must span whole segments"
+#endif
+
+#define DFU_SEGMENT_LENGTH_MAX      (DFU_SEGMENT_LENGTH(DFU_SEGMENT_SIZE_MAX))
+#define DFU_REQ_BITMAP_LEN          (8) /**< Number of bytes in a missing segment bitmap. */
+
+#define DFU_COPY_SEGMENTS_MAX       (32) /**< Max number of segments a delta transfer may copy from the current image at once. */
+
+#ifndef DFU_PARITY_GROUP_SIZE
+/** Number of consecutive segments covered by each parity packet when built with DFU_PARITY. */
+#define DFU_PARITY_GROUP_SIZE       (8)
+#endif
 
 #define DFU_AUTHORITY_MAX           (0x07)
 
@@ -92,9 +125,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define DFU_PACKET_LEN_STATE_BL     (2 + 1 + 1 + 4 + DFU_FWID_LEN_BL)
 #define DFU_PACKET_LEN_STATE_APP    (2 + 1 + 1 + 4 + DFU_FWID_LEN_APP)
 #define DFU_PACKET_LEN_START        (2 + 2 + 4 + 4 + 4 + 2 + 1)
+#define DFU_PACKET_LEN_START_DIFF   (DFU_PACKET_LEN_START + 4)
+#define DFU_PACKET_LEN_DATA_HEADER  (2 + 2 + 4) /**< Length of a data, response or parity packet in front of the segment. */
 #define DFU_PACKET_LEN_DATA         (2 + 2 + 4 + SEGMENT_LENGTH)
 #define DFU_PACKET_LEN_DATA_REQ     (2 + 2 + 4)
 #define DFU_PACKET_LEN_DATA_RSP     (2 + 2 + 4 + SEGMENT_LENGTH)
+#define DFU_PACKET_LEN_DATA_REQ_BITMAP (2 + 2 + 4 + DFU_REQ_BITMAP_LEN)
+#define DFU_PACKET_LEN_DATA_PARITY  (2 + 2 + 4 + SEGMENT_LENGTH)
+#define DFU_PACKET_LEN_DATA_COPY    (2 + 2 + 4 + 4 + 2)
+#define DFU_PACKET_LEN_PROGRESS     (2 + 2 + 4 + 1)
 
 #define DFU_PACKET_ADV_OVERHEAD     (1 /* adv_type */ + 2 /* UUID */) /* overhead inside adv data */
 #define DFU_PACKET_OVERHEAD         (MESH_PACKET_BLE_OVERHEAD + 1 + DFU_PACKET_ADV_OVERHEAD) /* dfu packet total overhead */
@@ -110,12 +149,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define BL_INFO_LEN_SIGNATURE       (DFU_SIGNATURE_LEN)
 #define BL_INFO_LEN_BANK_SIGNED     (sizeof(bl_info_bank_t))
 #define BL_INFO_LEN_BANK            (BL_INFO_LEN_BANK_SIGNED - DFU_SIGNATURE_LEN)
+#define BL_INFO_LEN_BANK_PROGRESS   (sizeof(bl_info_bank_progress_t))
 
 typedef uint16_t segment_t;
 typedef uint16_t seq_t;
 
 typedef enum
 {
+    DFU_PACKET_TYPE_PROGRESS    = 0xFFF6,
+    DFU_PACKET_TYPE_DATA_COPY   = 0xFFF7,
+    DFU_PACKET_TYPE_DATA_PARITY = 0xFFF8,
+    DFU_PACKET_TYPE_DATA_REQ_BITMAP = 0xFFF9,
     DFU_PACKET_TYPE_DATA_RSP    = 0xFFFA,
     DFU_PACKET_TYPE_DATA_REQ    = 0xFFFB,
     DFU_PACKET_TYPE_DATA        = 0xFFFC,
@@ -183,17 +227,19 @@ typedef struct __attribute((packed))
             uint32_t start_address;
             uint32_t length; /* in words */
             uint16_t signature_length;
-            uint8_t diff        : 1;
+            uint8_t diff        : 1; /**< Delta transfer, unchanged segments are copied from the current image. */
             uint8_t single_bank : 1;
             uint8_t first       : 1;
             uint8_t last        : 1;
-            uint8_t _rfu        : 4;
+            uint8_t segment_size : 2; /**< Segments are DFU_SEGMENT_LENGTH(segment_size) bytes long. */
+            uint8_t _rfu        : 2;
+            uint32_t base_app_version; /**< Application version the delta applies to, only present with diff. */
         } start;
         struct __attribute((packed))
         {
             uint16_t segment;
             uint32_t transaction_id;
-            uint8_t data[SEGMENT_LENGTH];
+            uint8_t data[DFU_SEGMENT_LENGTH_MAX];
         } data;
         struct __attribute((packed))
         {
@@ -201,11 +247,36 @@ typedef struct __attribute((packed))
             uint32_t transaction_id;
         } req_data;
         struct __attribute((packed))
+        {
+            uint16_t segment; /**< Oldest missing segment. */
+            uint32_t transaction_id;
+            uint8_t bitmap[DFU_REQ_BITMAP_LEN]; /**< Bit n (LSB first) marks segment + 1 + n as missing. */
+        } req_data_bitmap;
+        struct __attribute((packed))
+        {
+            uint16_t segment; /**< First segment in the parity group. */
+            uint32_t transaction_id;
+            uint8_t data[DFU_SEGMENT_LENGTH_MAX]; /**< XOR of the zero-padded segments in the group. */
+        } parity;
+        struct __attribute((packed))
+        {
+            uint16_t segment; /**< First segment to fill. */
+            uint32_t transaction_id;
+            uint32_t src_addr; /**< Address of the data in the current image. */
+            uint16_t segment_count;
+        } copy;
+        struct __attribute((packed))
         {
             uint16_t segment;
             uint32_t transaction_id;
-            uint8_t data[SEGMENT_LENGTH];
+            uint8_t data[DFU_SEGMENT_LENGTH_MAX];
         } rsp_data;
+        struct __attribute((packed))
+        {
+            uint16_t missing; /**< Most segments missing in any node the report covers, 0 if they're all done. */
+            uint32_t transaction_id;
+            uint8_t age;      /**< Number of times the report has been merged by relays. */
+        } progress;
     } payload;
 } dfu_packet_t;
 
@@ -230,6 +301,8 @@ typedef enum
     BL_INFO_TYPE_BANK_BL            = 0x22,
     BL_INFO_TYPE_BANK_APP           = 0x24,
     BL_INFO_TYPE_BANK_BL_INFO       = 0x28,
+    BL_INFO_TYPE_BANK_PROGRESS      = 0x30, /**< Progress of an ongoing bank copy. */
+    BL_INFO_TYPE_ROLLBACK           = 0x31, /**< Copy of the previous application, laid out as a bank. */
 
     BL_INFO_TYPE_TEST               = 0x100,
 
@@ -325,6 +398,18 @@ typedef enum
     BL_INFO_BANK_STATE_FLASHED      = 0xF8, /**< The bank has been flashed, and can be invalidated. */
 } bl_info_bank_state_t;
 
+/**
+ * State of the rollback copy of the previous application. Written the same
+ * way as the bank states.
+ */
+typedef enum
+{
+    BL_INFO_ROLLBACK_STATE_SAVED     = 0xFF, /**< The previous application has been copied, the new one is being flashed. */
+    BL_INFO_ROLLBACK_STATE_TRIAL     = 0xFE, /**< The new application is in place, but hasn't been started. */
+    BL_INFO_ROLLBACK_STATE_BOOTED    = 0xFC, /**< The new application has been started, but hasn't confirmed itself. */
+    BL_INFO_ROLLBACK_STATE_CONFIRMED = 0xF8, /**< The new application confirmed itself, the copy is only kept for manual rollbacks. */
+} bl_info_rollback_state_t;
+
 typedef struct
 {
     uint32_t*               p_bank_addr;
@@ -335,6 +420,14 @@ typedef struct
     uint8_t                 signature[BL_INFO_LEN_SIGNATURE];
 } bl_info_bank_t;
 
+/** Progress of a bank being copied to its destination, to resume the copy
+  after a reset. */
+typedef struct
+{
+    uint32_t*               p_bank_addr;    /**< Bank being copied. */
+    uint32_t                length;         /**< Number of bytes copied and verified. */
+} bl_info_bank_progress_t;
+
 typedef union
 {
     uint8_t             public_key[BL_INFO_LEN_PUBLIC_KEY];
@@ -343,6 +436,7 @@ typedef union
     bl_info_version_t   version;
     bl_info_flags_t     flags;
     bl_info_bank_t      bank;
+    bl_info_bank_progress_t bank_progress;
 } bl_info_entry_t;
 
 #endif /* DFU_TYPES_H__ */
@@ -51,7 +51,7 @@ bool ready_packet_is_upgrade(dfu_packet_t* p_packet);
 
 bool ready_packet_matches_our_req(dfu_packet_t* p_packet, dfu_type_t dfu_type_req, fwid_union_t* p_fwid_req);
 
-uint32_t* addr_from_seg(uint16_t segment, uint32_t* p_start_addr);
+uint32_t* addr_from_seg(uint16_t segment, uint32_t* p_start_addr, uint8_t segment_size);
 
 bool app_is_newer(app_id_t* p_app_id);
 
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 #ifndef _EVENT_HANDLER_H__
 #define _EVENT_HANDLER_H__
+#include "rbc_mesh.h"
 #include "radio_control.h"
 #include "timer.h"
 #include "timer_scheduler.h"
@@ -96,6 +97,14 @@ void event_handler_init(void);
 /** @brief Queue an asynchronous event for execution later */
 uint32_t event_handler_push(async_event_t* evt);
 
+/** @brief Signal that there are received packets waiting in the transport RX
+  queue. The event handler will process all of them in one run. */
+void event_handler_rx_signal(void);
+
+/** @brief Signal that there's work waiting in a queue the event handler
+  polls, without going through the event queues, see mesh_app_cmd.h. */
+void event_handler_signal(void);
+
 /** @brief called from ts handler upon ts exit */
 void event_handler_on_ts_end(void);
 
@@ -106,5 +115,12 @@ void event_handler_critical_section_begin(void);
 
 void event_handler_critical_section_end(void);
 
+/** @brief Fill in the internal event counters of the given statistics
+  structure. Other fields are left untouched. */
+void event_handler_stats_get(rbc_mesh_stats_t* p_stats);
+
+/** Get the RAM used by the internal event queues. */
+uint32_t event_handler_ram_size_get(void);
+
 #endif /* _EVENT_HANDLER_H__ */
 
@@ -52,10 +52,39 @@ uint32_t fifo_pop(fifo_t* p_fifo, void* p_elem);
 uint32_t fifo_peek_at(fifo_t* p_fifo, void* p_elem, uint32_t elem);
 uint32_t fifo_peek(fifo_t* p_fifo, void* p_elem);
 void fifo_flush(fifo_t* p_fifo);
+/* get a pointer to the element at the given position from the oldest element,
+   or NULL if there's none. Only valid until the element is popped. */
+void* fifo_elem_ref_at(fifo_t* p_fifo, uint32_t elem);
 uint32_t fifo_get_len(fifo_t* p_fifo);
 bool fifo_is_full(fifo_t* p_fifo);
 bool fifo_is_empty(fifo_t* p_fifo);
 
+/*
+   Lock-free single-producer/single-consumer interface. The producer only
+   writes the head index, and the consumer only writes the tail index, so
+   neither side needs to mask IRQs, as long as there's exactly one producer
+   context and one consumer context for the given FIFO instance. The SPSC
+   functions must not be mixed with the locking push/pop functions on the
+   same instance.
+*/
+
+/* copying push/pop for SPSC FIFOs */
+uint32_t fifo_spsc_push(fifo_t* p_fifo, const void* p_elem);
+uint32_t fifo_spsc_pop(fifo_t* p_fifo, void* p_elem);
+
+/* zero-copy producer interface: get a pointer to the next free slot, fill it
+   in place, and make it visible to the consumer with fifo_commit(). */
+uint32_t fifo_reserve(fifo_t* p_fifo, void** pp_elem);
+void fifo_commit(fifo_t* p_fifo);
+
+/* zero-copy consumer interface: get a pointer to the oldest element, use it
+   in place, and give the slot back to the producer with fifo_release(). As the
+   consumer side only writes the tail index, these may also be used together
+   with the locking fifo_push() by any number of producers, as long as there's
+   a single consumer context. */
+uint32_t fifo_peek_ref(fifo_t* p_fifo, void** pp_elem);
+void fifo_release(fifo_t* p_fifo);
+
 
 
 #endif /* _FIFO_H_ */
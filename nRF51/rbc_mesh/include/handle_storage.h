@@ -50,10 +50,32 @@ typedef enum
     HANDLE_FLAG_PERSISTENT,
     HANDLE_FLAG_TX_EVENT,
     HANDLE_FLAG_DISABLED,
+    HANDLE_FLAG_URGENT,
     HANDLE_FLAG__MAX
 } handle_flag_t;
 
-uint32_t handle_storage_init(uint32_t min_interval_us);
+/** Caller supplied memory for the handle and data caches. */
+typedef struct
+{
+    void* p_memory;                 /**< Word aligned memory of handle_storage_memory_size_get() bytes. */
+    uint16_t handle_cache_entries;  /**< Number of handle cache entries, at least data_cache_entries. */
+    uint16_t data_cache_entries;    /**< Number of data cache entries. */
+    uint16_t pinned_data_entries;   /**< Number of data cache entries reserved for persistent handles, at most data_cache_entries. */
+} handle_storage_memory_t;
+
+/** Get the size of the memory needed for caches of the given sizes. */
+uint32_t handle_storage_memory_size_get(uint16_t handle_cache_entries, uint16_t data_cache_entries);
+
+/** Get the RAM used by the handle cache and its index, and by the data cache and its TX lists. */
+void handle_storage_ram_get(uint32_t* p_handle_cache, uint32_t* p_data_cache);
+
+/**
+* Initialize the handle storage. Uses the built-in caches of
+*   RBC_MESH_HANDLE_CACHE_ENTRIES and RBC_MESH_DATA_CACHE_ENTRIES entries,
+*   with RBC_MESH_PINNED_DATA_ENTRIES of the data entries reserved for
+*   persistent handles, if p_memory is NULL.
+*/
+uint32_t handle_storage_init(uint32_t min_interval_us, const handle_storage_memory_t* p_memory);
 
 uint32_t handle_storage_min_interval_set(uint32_t min_interval_us);
 
@@ -66,8 +88,23 @@ uint32_t handle_storage_info_get(uint16_t handle, handle_info_t* p_info);
 /** MUST BE CALLED FROM EVENT HANDLER CONTEXT */
 uint32_t handle_storage_info_set(uint16_t handle, handle_info_t* p_info);
 
+/**
+* Check a payload against the fingerprint of an evicted value. Only available
+*   with RBC_MESH_VALUE_FINGERPRINT.
+*
+* @return NRF_SUCCESS The value has a fingerprint of the given version, and
+*   p_match tells whether the payload matches it.
+* @return NRF_ERROR_NOT_FOUND The value is cached, or has no fingerprint of
+*   the given version.
+*/
+uint32_t handle_storage_fingerprint_check(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length, bool* p_match);
+
 uint32_t handle_storage_local_packet_push(mesh_packet_t* p_packet);
 
+/** Apply a local update right away, instead of through the event queue.
+  MUST BE CALLED FROM EVENT HANDLER CONTEXT, or in an event handler critical section. */
+void handle_storage_local_packet_apply(mesh_packet_t* p_packet);
+
 /** MUST BE CALLED FROM EVENT HANDLER CONTEXT */
 uint32_t handle_storage_flag_set(uint16_t handle, handle_flag_t flag, bool value);
 
@@ -75,12 +112,101 @@ uint32_t handle_storage_flag_set_async(uint16_t handle, handle_flag_t flag, bool
 
 uint32_t handle_storage_flag_get(uint16_t handle, handle_flag_t flag, bool* p_value);
 
+/** MUST BE CALLED FROM EVENT HANDLER CONTEXT, OR IN AN EVENT HANDLER CRITICAL SECTION */
+uint32_t handle_storage_trickle_class_set(uint16_t handle, uint8_t trickle_class);
+
+uint32_t handle_storage_trickle_class_get(uint16_t handle, uint8_t* p_trickle_class);
+
+/**
+* Make the handles in the given range start out in the given Trickle class
+*   when they enter the handle cache, instead of the default class. Handles
+*   already in the cache are moved to the class. There's room for
+*   RBC_MESH_INSTANCES_MAX ranges, which must not overlap.
+*/
+uint32_t handle_storage_class_range_add(const rbc_mesh_handle_range_t* p_range, uint8_t trickle_class);
+
 uint32_t handle_storage_rx_consistent(uint16_t handle, uint32_t timestamp);
 
 uint32_t handle_storage_rx_inconsistent(uint16_t handle, uint32_t timestamp);
 
+/**
+* Register the reception of a copy of the given version of a value, without
+*   looking at its contents. Returns NRF_ERROR_INVALID_STATE if the stored
+*   version differs, in which case the packet must be processed in full.
+*/
+uint32_t handle_storage_rx_duplicate(uint16_t handle, uint16_t version, uint32_t timestamp);
+
+/**
+* Get a digest of the handle/version pairs of all values that are currently
+*   being transmitted, and the number of such values.
+*
+* @param[out] p_digest Digest of the stored values.
+* @param[out] p_count Number of values covered by the digest.
+*/
+uint32_t handle_storage_summary_get(uint32_t* p_digest, uint16_t* p_count);
+
+/**
+* Get the handle/version pairs of the values that are currently being
+*   transmitted, in ascending handle order, starting at the given handle.
+*
+* @param[in] first_handle Lowest handle to include.
+* @param[out] p_handles Array of *p_count handles to fill.
+* @param[out] p_versions Array of *p_count versions to fill.
+* @param[in,out] p_count Size of the arrays, and the number of pairs returned.
+*/
+uint32_t handle_storage_versions_get(uint16_t first_handle, uint16_t* p_handles, uint16_t* p_versions, uint32_t* p_count);
+
+/**
+* Order a single transmission of the given value within the given delay,
+*   regardless of the consistent receptions in the current Trickle interval.
+*   The interval itself isn't restarted.
+*
+* @param[in] handle Handle of the value to transmit.
+* @param[in] time_now Earliest time of the transmission.
+* @param[in] max_delay_us Upper bound of the random delay.
+*
+* @return NRF_SUCCESS The transmission was ordered, or one is already pending.
+* @return NRF_ERROR_NOT_FOUND The value isn't being transmitted.
+*/
+uint32_t handle_storage_repair_order(uint16_t handle, uint32_t time_now, uint32_t max_delay_us);
+
+/**
+* Iterate over the persistent handles that have a value.
+*
+* @param[in,out] p_iterator Iterator, set to 0 to get the first handle.
+* @param[out] p_handle Handle of the value.
+* @param[out] p_info Version and packet of the value. The packet must be
+*   released by the caller.
+*
+* @return NRF_SUCCESS A value was found.
+* @return NRF_ERROR_NOT_FOUND There are no more persistent values.
+*/
+uint32_t handle_storage_persistent_get(uint32_t* p_iterator, uint16_t* p_handle, handle_info_t* p_info);
+
+/**
+* Iterate over all handles that have a value, like
+*   handle_storage_persistent_get().
+*/
+uint32_t handle_storage_value_next_get(uint32_t* p_iterator, uint16_t* p_handle, handle_info_t* p_info);
+
+/**
+* Call the given function for every application handle in the handle cache,
+*   most recently used first, until it returns false. The whole walk is done
+*   in an event handler critical section.
+*/
+uint32_t handle_storage_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context);
+
+/** Register a consistent reception for all values that are currently being
+  transmitted, after a summary beacon matching our own. */
+void handle_storage_rx_consistent_all(uint32_t timestamp);
+
 uint32_t handle_storage_next_timeout_get(bool* p_found_value);
 
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+/** Get the earliest Trickle timeout of the values of urgent handles. */
+uint32_t handle_storage_urgent_timeout_get(bool* p_found_value);
+#endif
+
 /**
 * Get a list of packets ready for transmit at the timestamp provided. Each
 *   packet is returned with a reference, which must be freed when the packet
@@ -100,5 +226,71 @@ uint32_t handle_storage_tx_packets_get(uint32_t time_now, mesh_packet_t** pp_pac
 */
 uint32_t handle_storage_transmitted(uint16_t handle, uint32_t timestamp);
 
+/**
+* Copy the airtime statistics of the given handle, and optionally clear them.
+*   Only available with RBC_MESH_HANDLE_STATS.
+*/
+uint32_t handle_storage_stats_get(uint16_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset);
+
+/** Function called for each value that expires in handle_storage_ttl_tick(). */
+typedef void (*handle_storage_expiry_cb_t)(rbc_mesh_value_handle_t handle);
+
+/**
+* Set the time-to-live of the given handle in ticks, 0 for none. The
+*   countdown restarts with every new version. Only available with
+*   RBC_MESH_VALUE_TTL.
+*
+* MUST BE CALLED FROM EVENT HANDLER CONTEXT, OR IN AN EVENT HANDLER CRITICAL SECTION
+*/
+uint32_t handle_storage_ttl_set(uint16_t handle, uint16_t ttl_ticks);
+
+/**
+* Count down the time-to-live of all values by a tick, and drop the values
+*   that have expired. Calls the given callback for each expired value, and
+*   returns the number of them.
+*
+* MUST BE CALLED FROM EVENT HANDLER CONTEXT, OR IN AN EVENT HANDLER CRITICAL SECTION
+*/
+uint32_t handle_storage_ttl_tick(handle_storage_expiry_cb_t callback);
+
+/**
+* Set the write-combining window of the given handle in ms, 0 for none. Only
+*   available with RBC_MESH_WRITE_COMBINING.
+*
+* MUST BE CALLED FROM EVENT HANDLER CONTEXT, OR IN AN EVENT HANDLER CRITICAL SECTION
+*/
+uint32_t handle_storage_write_combine_set(uint16_t handle, uint16_t window_ms);
+
+/**
+* Set the number of hops new local versions of the given handle may travel.
+*   Only available with RBC_MESH_HOP_SCOPES.
+*
+* MUST BE CALLED FROM EVENT HANDLER CONTEXT, OR IN AN EVENT HANDLER CRITICAL SECTION
+*/
+uint32_t handle_storage_hop_scope_set(uint16_t handle, uint8_t hops);
+
+/**
+* Raise the hops left in the stored copy of the given version, when a copy
+*   with more hops left than the first one has been received. Only available
+*   with RBC_MESH_HOP_SCOPES.
+*
+* MUST BE CALLED FROM EVENT HANDLER CONTEXT
+*/
+uint32_t handle_storage_hops_left_raise(uint16_t handle, uint16_t version, uint8_t hops_left);
+
+/**
+* Reorder the handle cache in least recently used order, with the data entries
+*   in the order of their handles, so the hot entries are next to each other
+*   in RAM. Renumbers the cache entries, so iterators of
+*   handle_storage_value_next_get() that are in use may skip or repeat
+*   handles, just like they may across evictions. Only available with
+*   RBC_MESH_CACHE_COMPACTION, and not with RBC_MESH_STATIC_HANDLES.
+*
+* @return NRF_SUCCESS The caches are in order.
+* @return NRF_ERROR_BUSY The persistent values are being copied in flash.
+* @return NRF_ERROR_NOT_SUPPORTED Compaction isn't part of the build.
+*/
+uint32_t handle_storage_compact(void);
+
 
 #endif /* _HANDLE_STORAGE_H__ */
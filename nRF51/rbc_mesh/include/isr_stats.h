@@ -0,0 +1,111 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef ISR_STATS_H__
+#define ISR_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+#include "timer.h"
+
+/**
+* @file Duration and latency histograms of the framework interrupt handlers.
+*   Enabled with the RBC_MESH_ISR_STATS define, and never in the bootloader.
+*   When disabled, the macros expand to nothing. Handlers are only timed in
+*   timeslots, since timer_now() stands still between them.
+*/
+
+#if defined(RBC_MESH_ISR_STATS) && !defined(BOOTLOADER)
+
+/** Start timing a handler. Must be in the same scope as ISR_STATS_END. */
+#define ISR_STATS_BEGIN(isr)            timestamp_t isr_stats_start__ = isr_stats_begin(isr)
+/** Stop timing a handler. */
+#define ISR_STATS_END(isr)              isr_stats_end((isr), isr_stats_start__)
+/** Register the latency of a handler that knows when it should have run. */
+#define ISR_STATS_LATENCY(isr, time)    isr_stats_latency((isr), (time))
+/** Note the time a handler was pended, for its latency. */
+#define ISR_STATS_PEND(isr)             isr_stats_pend(isr)
+
+/**
+* Start timing a handler, and register its latency if it's been pended with
+* isr_stats_pend().
+*
+* @param[in] isr The handler that starts.
+*
+* @return The start timestamp, to pass to isr_stats_end().
+*/
+timestamp_t isr_stats_begin(rbc_mesh_isr_t isr);
+
+/**
+* Register the duration of a handler.
+*
+* @param[in] isr The handler that ends.
+* @param[in] start The timestamp returned by isr_stats_begin().
+*/
+void isr_stats_end(rbc_mesh_isr_t isr, timestamp_t start);
+
+/**
+* Register the latency of a handler, from the time it should have run.
+*
+* @param[in] isr The handler.
+* @param[in] trigger_time Time the handler was due.
+*/
+void isr_stats_latency(rbc_mesh_isr_t isr, timestamp_t trigger_time);
+
+/**
+* Note the time a software interrupt was pended. Only the first pend before
+* the handler runs counts.
+*
+* @param[in] isr The handler that was pended.
+*/
+void isr_stats_pend(rbc_mesh_isr_t isr);
+
+/**
+* Get the statistics of a handler.
+*
+* @param[in] isr The handler.
+* @param[out] p_stats Statistics structure to fill.
+* @param[in] reset Clear the statistics of the handler after copying them.
+*
+* @return NRF_SUCCESS The statistics were copied.
+* @return NRF_ERROR_INVALID_PARAM The handler doesn't exist.
+*/
+uint32_t isr_stats_get(rbc_mesh_isr_t isr, rbc_mesh_isr_stats_t* p_stats, bool reset);
+
+#else
+
+#define ISR_STATS_BEGIN(isr)
+#define ISR_STATS_END(isr)
+#define ISR_STATS_LATENCY(isr, time)
+#define ISR_STATS_PEND(isr)
+
+#endif
+
+#endif /* ISR_STATS_H__ */
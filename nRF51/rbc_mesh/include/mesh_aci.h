@@ -36,6 +36,30 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef MESH_ACI_PENDING_UPDATE_COUNT
+/** @brief Number of handles that can have an update event waiting for room
+    in the serial queue. Newer updates to a waiting handle replace the old. */
+#define MESH_ACI_PENDING_UPDATE_COUNT   (8)
+#endif
+
+#ifndef MESH_ACI_DFU_WINDOW
+/** @brief Windowed serial DFU packets the host may send ahead of an
+    acknowledgement. Also limited by the free slots in the flash queue. */
+#define MESH_ACI_DFU_WINDOW             (8)
+#endif
+
+#ifndef MESH_ACI_DFU_ACK_INTERVAL
+/** @brief Windowed serial DFU packets covered by each cumulative
+    acknowledgement, when they're all accepted. */
+#define MESH_ACI_DFU_ACK_INTERVAL       (4)
+#endif
+
+#ifndef MESH_ACI_DFU_FLASH_RESERVE
+/** @brief Flash queue slots kept out of the window, for the page erases and
+    the writes of the mesh's own DFU packets. */
+#define MESH_ACI_DFU_FLASH_RESERVE      (2)
+#endif
+
 typedef __packed_armcc enum
 {
   ACI_STATUS_SUCCESS                                        = 0x00,
@@ -54,10 +78,31 @@ typedef __packed_armcc enum
 
 typedef __packed_armcc enum
 {
-    ACI_FLAG_PERSISTENT = 0x00,
-    ACI_FLAG_TX_EVENT   = 0x01
+    ACI_FLAG_PERSISTENT     = 0x00,
+    ACI_FLAG_TX_EVENT       = 0x01,
+    ACI_FLAG_TRICKLE_CLASS  = 0x02,
+    ACI_FLAG_URGENT         = 0x03,
+    ACI_FLAG_HISTORY        = 0x04
 } __packed_gcc aci_flag_t;
 
+/** @brief Event types that can be forwarded to the host. */
+typedef __packed_armcc enum
+{
+    ACI_EVT_MASK_NEW            = (1 << 0),
+    ACI_EVT_MASK_UPDATE         = (1 << 1),
+    ACI_EVT_MASK_CONFLICTING    = (1 << 2),
+    ACI_EVT_MASK_TX             = (1 << 3),
+    ACI_EVT_MASK_ALL            = 0x0F
+} __packed_gcc aci_evt_mask_t;
+
+/** @brief Formats the value events can be sent to the host in. */
+typedef __packed_armcc enum
+{
+    ACI_EVT_FORMAT_FULL         = 0x00, /**< An event per value. */
+    ACI_EVT_FORMAT_COMPACT      = 0x01, /**< Values packed together in compact events. */
+    ACI_EVT_FORMAT_VERSIONED    = 0x02  /**< An event per value, with the value's version. */
+} __packed_gcc aci_evt_format_t;
+
 
 /** @brief Initialize serial handler */
 void mesh_aci_init(void);
@@ -71,4 +116,10 @@ void mesh_aci_command_check(void);
 /** @brief rbc_mesh event handler */
 void mesh_aci_rbc_event_handler(rbc_mesh_event_t* p_evt);
 
+/**
+* @brief Send the events that didn't fit in the serial queue. Called by the
+*   serial handler when room frees up after a rejected event.
+*/
+void mesh_aci_event_flush(void);
+
 #endif /* _MESH_ACI_H__ */
@@ -0,0 +1,96 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_ACK_H__
+#define MESH_ACK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_ACK Acknowledged delivery
+ * Addressed messages with end-to-end acknowledgements, on top of the
+ * broadcast values, when RBC_MESH_ACK is defined. Each node sends its
+ * messages on a handle of its own:
+ *
+ *   msg_handle_base + node: [dst 2][seq 1][data]
+ *
+ * and acknowledges the messages it receives on another handle, with a list
+ * of the last message from each recent sender:
+ *
+ *   ack_handle_base + node: ([src 2][seq 1])*
+ *
+ * A sender has one message in flight at a time, so the sequence number of
+ * the last message from a source acknowledges it, and the list carries the
+ * same as a bitmap of received messages would, without tying the node IDs
+ * to bit positions. Acknowledgements are collected for RBC_MESH_ACK_DELAY_MS
+ * before they go out, and entries are kept in the list for as long as their
+ * sender may retransmit.
+ *
+ * The service works on the app events: rbc_mesh_event_push() passes all
+ * events through mesh_ack_event_handle(), which turns the value updates on
+ * the service handles into message and acknowledgement events.
+ * @{
+ */
+
+/**
+ * Start the service. Must be called from the application context.
+ *
+ * @param[in] p_params Service parameters.
+ *
+ * @return NRF_SUCCESS The service was started.
+ * @return NRF_ERROR_NULL p_params is NULL.
+ * @return NRF_ERROR_INVALID_ADDR The handle ranges overlap, or go beyond
+ *   RBC_MESH_APP_MAX_HANDLE.
+ * @return NRF_ERROR_INVALID_PARAM The node ID is outside the node count.
+ * @return Error codes from enabling TX events on the message handle.
+ */
+uint32_t mesh_ack_init(const rbc_mesh_ack_params_t* p_params);
+
+/**
+ * Send a message, see rbc_mesh_ack_send(). Must be called from the
+ * application context.
+ */
+uint32_t mesh_ack_send(uint16_t node_id, const uint8_t* p_data, uint8_t len);
+
+/**
+ * Process an app event before it's queued. Events on the service handles
+ * are either consumed, or rewritten in place to an acknowledged delivery
+ * event.
+ *
+ * @param[in,out] p_evt Event about to be pushed to the app event queue.
+ *
+ * @return Whether the event was consumed, and shouldn't be queued.
+ */
+bool mesh_ack_event_handle(rbc_mesh_event_t* p_evt);
+
+/** @} */
+
+#endif /* MESH_ACK_H__ */
@@ -0,0 +1,76 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_APP_CMD_H__
+#define MESH_APP_CMD_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_APP_CMD Application command queue
+ * Lock-free queue of value commands from the application context to the
+ * mesh context, when RBC_MESH_APP_COMMAND_QUEUE is defined. The application
+ * side only writes the queue head and the mesh side only writes the tail,
+ * so neither masks interrupts or holds back the other. The commands are
+ * carried out in the event handler, and their results are handed back
+ * through an @ref rbc_mesh_future_t.
+ * @{
+ */
+
+/** Initialize the command queue. */
+void mesh_app_cmd_init(void);
+
+/**
+ * Queue a value update, see rbc_mesh_value_set_async(). Must only be called
+ * from a single application context.
+ */
+uint32_t mesh_app_cmd_value_set(rbc_mesh_value_handle_t handle, const uint8_t* p_data, uint16_t length, rbc_mesh_future_t* p_future);
+
+/**
+ * Queue a value read, see rbc_mesh_value_get_async(). Must only be called
+ * from a single application context.
+ */
+uint32_t mesh_app_cmd_value_get(rbc_mesh_value_handle_t handle, uint8_t* p_data, uint16_t* p_length, rbc_mesh_future_t* p_future);
+
+/**
+ * Carry out queued commands. Called from the event handler.
+ *
+ * @param[in] max_count Maximum number of commands to carry out.
+ *
+ * @return The number of commands carried out.
+ */
+uint32_t mesh_app_cmd_process(uint32_t max_count);
+
+/** Get the number of commands waiting in the queue. */
+uint32_t mesh_app_cmd_length(void);
+
+/** @} */
+
+#endif /* MESH_APP_CMD_H__ */
@@ -0,0 +1,69 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_BRIDGE_H__
+#define MESH_BRIDGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_BRIDGE Mesh bridge
+ * Forwards values between two meshes running on the same node, when
+ * RBC_MESH_BRIDGE is defined. Each filter table entry maps a range of
+ * handles on one side to a range of peer handles on the other. New versions
+ * received on one side are applied to the matching handle on the other side
+ * as local updates, so both handles keep their own version numbers and
+ * Trickle timers, and each mesh only carries the values that belong to it.
+ *
+ * The bridge works on the app events: rbc_mesh_event_push() passes all
+ * events through mesh_bridge_event_handle() before they're filtered for the
+ * application. Local updates don't make any events, so a forwarded value
+ * never comes back over the bridge.
+ * @{
+ */
+
+/**
+ * Add a filter table entry, see rbc_mesh_bridge_add(). Must be called from
+ * the application context.
+ */
+uint32_t mesh_bridge_add(const rbc_mesh_bridge_entry_t* p_entry);
+
+/**
+ * Forward the value in the given app event over the bridge, if its handle is
+ * bridged. The event is left as it is.
+ *
+ * @param[in] p_evt Event about to be pushed to the app event queue.
+ */
+void mesh_bridge_event_handle(const rbc_mesh_event_t* p_evt);
+
+/** @} */
+
+#endif /* MESH_BRIDGE_H__ */
@@ -0,0 +1,78 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_CONFIG_H__
+#define MESH_CONFIG_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+#include "mesh_packet.h"
+
+/**
+ * @defgroup MESH_CONFIG Mesh wide configuration
+ * Spreads changes of the min-interval, the Trickle classes and the radio
+ * parameters through the mesh when RBC_MESH_CONFIG_PUSH is defined. Each
+ * setting is a record with its own sequence number:
+ *
+ *   [record ID][seq 2][settings 7][MIC 4]
+ *
+ * The MIC is the start of the AES-ECB encryption of the first ten bytes
+ * under the configuration key, which all nodes share. A record is applied
+ * when its sequence number is newer than the one the node has. Every node
+ * sends the records it knows in turn, one every RBC_MESH_CONFIG_INTERVAL_US.
+ * The radio record carries the time left until its switch, which each node
+ * counts down and signs again before it sends it on.
+ * @{
+ */
+
+/** Set the configuration key, see rbc_mesh_config_key_set(). Must be called
+  from the application context. */
+uint32_t mesh_config_key_set(const uint8_t* p_key);
+
+/** Push a new min-interval, see rbc_mesh_config_interval_push(). Must be
+  called from the application context. */
+uint32_t mesh_config_interval_push(uint32_t interval_min_ms);
+
+/** Push a new Trickle class setup, see rbc_mesh_config_trickle_class_push().
+  Must be called from the application context. */
+uint32_t mesh_config_trickle_class_push(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy);
+
+/** Schedule a radio parameter switch, see rbc_mesh_config_radio_push(). Must
+  be called from the application context. */
+uint32_t mesh_config_radio_push(uint32_t access_address, uint8_t channel, uint32_t switch_delay_ms);
+
+/** Handle a received configuration beacon. Called from the event handler. */
+uint32_t mesh_config_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @} */
+
+#endif /* MESH_CONFIG_H__ */
@@ -0,0 +1,118 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_CRYPT_H__
+#define MESH_CRYPT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mesh_packet.h"
+
+/**
+ * @defgroup MESH_CRYPT Packet encryption
+ * Encrypts and authenticates application values on air with the AES-CCM
+ * peripheral when RBC_MESH_ENCRYPTION is defined. The encryption is done at
+ * the radio boundary: packets are kept in clear in the packet pool and the
+ * handle cache, encrypted into a separate buffer right before they're put on
+ * air, and decrypted in place in the radio callback. An encrypted value takes
+ * the place of the mesh AD structure in the advertisement:
+ *
+ *   [length][0x16][MESH_UUID_ENCRYPTED][seq 4][handle, version, data][MIC 4]
+ *
+ * The CCM nonce is made from the sequence number and the advertiser address
+ * of the packet. Every transmission, including relays, is encrypted by the
+ * sending node with its own address and a fresh sequence number.
+ *
+ * Replays are rejected with a window of the last 32 sequence numbers of each
+ * sender, in a small cache indexed by the sender address and evicted in LRU
+ * order. The window is checked before the CCM runs, and only advanced once
+ * the MIC has passed.
+ * @{
+ */
+
+/** UUID of the encrypted mesh AD structures. */
+#define MESH_UUID_ENCRYPTED             (0xFEE5)
+/** Size of the encryption key. */
+#define MESH_CRYPT_KEY_LEN              (16)
+/** Bytes added to a mesh AD structure by the encryption. */
+#define MESH_CRYPT_OVERHEAD             (4 /* seq */ + 4 /* MIC */)
+
+/**
+ * Set the network key, and start the sequence numbers at a random value.
+ * Must be called from the application context, after the SoftDevice has
+ * been enabled.
+ *
+ * @param[in] p_key MESH_CRYPT_KEY_LEN byte key, shared by all nodes.
+ *
+ * @return NRF_SUCCESS The key was set.
+ * @return NRF_ERROR_NULL p_key is NULL.
+ * @return Error codes from reading the device address or the HW RNG.
+ */
+uint32_t mesh_crypt_key_set(const uint8_t* p_key);
+
+/** Whether a key has been set with mesh_crypt_key_set(). */
+bool mesh_crypt_key_is_set(void);
+
+/**
+ * Check whether the packet carries an application value that must be
+ * encrypted on air.
+ */
+bool mesh_crypt_packet_is_protected(mesh_packet_t* p_packet);
+
+/**
+ * Build the on-air version of the given packet. Busy waits on the CCM
+ * peripheral, must be called from within the timeslot.
+ *
+ * @param[in] p_packet Clear packet, as queued for the radio.
+ * @param[out] p_out Word aligned buffer for the encrypted packet.
+ *
+ * @return Whether the packet was encrypted into p_out. Packets that don't
+ *   carry an application value are sent as they are, and false is returned.
+ */
+bool mesh_crypt_encrypt(mesh_packet_t* p_packet, mesh_packet_t* p_out);
+
+/**
+ * Authenticate and decrypt a received packet in place. Busy waits on the CCM
+ * peripheral, must be called from within the timeslot.
+ *
+ * @param[in,out] p_packet Received packet.
+ *
+ * @return NRF_SUCCESS The packet was decrypted, or doesn't carry an
+ *   application value.
+ * @return NRF_ERROR_INVALID_DATA The MIC check failed, or the packet carries
+ *   an application value in clear.
+ * @return NRF_ERROR_INVALID_STATE No key has been set.
+ * @return NRF_ERROR_FORBIDDEN The sequence number has already been received
+ *   from the sender, or is too far behind to tell.
+ */
+uint32_t mesh_crypt_decrypt(mesh_packet_t* p_packet);
+
+/** @} */
+
+#endif /* MESH_CRYPT_H__ */
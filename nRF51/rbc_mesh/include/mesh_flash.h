@@ -37,12 +37,62 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 typedef void(*mesh_flash_op_cb_t)(flash_op_type_t type, void* p_location);
 
-uint32_t mesh_flash_init(mesh_flash_op_cb_t cb);
-uint32_t mesh_flash_op_push(flash_op_type_t type, const flash_op_t* p_op);
-uint32_t mesh_flash_op_available_slots(void);
+/** Modules pushing flash operations. Each user is only notified of the end of its own operations. */
+typedef enum
+{
+    MESH_FLASH_USER_DFU,        /**< Device firmware updates, low priority. */
+    MESH_FLASH_USER_VALUES,     /**< Persistent value storage, see RBC_MESH_PERSISTENT_STORAGE. High priority. */
+    MESH_FLASH_USERS
+} mesh_flash_user_t;
+
+/** Priorities of the flash operations. High priority operations preempt the
+ * low priority ones between the chunks they're split into, but can't starve
+ * them completely. */
+typedef enum
+{
+    MESH_FLASH_PRIORITY_HIGH,   /**< Short, latency sensitive operations. */
+    MESH_FLASH_PRIORITY_LOW,    /**< Bulk operations, filling the remaining time. */
+    MESH_FLASH_PRIORITIES
+} mesh_flash_priority_t;
+
+/** Queue latency statistics for one priority. */
+typedef struct
+{
+    uint32_t operations;        /**< Number of operations started. */
+    uint32_t latency_avg_us;    /**< Moving average of the time from push to start of an operation. */
+    uint32_t latency_max_us;    /**< Longest time from push to start of an operation. */
+} mesh_flash_stats_t;
+
+/**
+ * Initialize the flash module, and register the end-of-operation callback for
+ * the given user. The first call flushes the operation queue, later calls only
+ * register their callback.
+ *
+ * @param[in] user User registering its callback.
+ * @param[in] cb Callback for the end of the user's operations, and for the
+ *   flash going idle.
+ */
+uint32_t mesh_flash_init(mesh_flash_user_t user, mesh_flash_op_cb_t cb);
+uint32_t mesh_flash_op_push(mesh_flash_user_t user, flash_op_type_t type, const flash_op_t* p_op);
+uint32_t mesh_flash_op_available_slots(mesh_flash_user_t user);
 bool mesh_flash_in_progress(void);
+/** Check whether the given user has operations that haven't been reported as ended. */
+bool mesh_flash_user_in_progress(mesh_flash_user_t user);
 void mesh_flash_op_execute(timestamp_t available_time);
 
+/**
+ * Get the queue latency statistics of the given priority. Times are measured
+ * with the timeslot timer, and don't include the time between timeslots.
+ *
+ * @param[in] priority Priority to get the statistics of.
+ * @param[out] p_stats Statistics structure to fill.
+ *
+ * @return NRF_SUCCESS The statistics were copied.
+ * @return NRF_ERROR_INVALID_PARAM The priority is invalid.
+ * @return NRF_ERROR_NULL p_stats is NULL.
+ */
+uint32_t mesh_flash_stats_get(mesh_flash_priority_t priority, mesh_flash_stats_t* p_stats);
+
 /**
  * Suspend or unsuspend flash operations. Safe for multiple users.
  *
@@ -44,6 +44,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MESH_SRV_UUID                   (0xFEE4) /* Mesh service UUID (16bit) */
 #define MESH_MD_CHAR_UUID               (0x0004) /* Mesh metadata characteristic UUID (128bit) */
 #define MESH_VALUE_CHAR_UUID            (0x0005) /* Mesh value characteristic UUID (128bit) */
+#define MESH_BULK_CHAR_UUID             (0x0006) /* Mesh bulk value characteristic UUID (128bit) */
 
 #define MESH_MD_CHAR_LEN                (9) /* Total length of Mesh metadata characteristic data */
 #define MESH_MD_CHAR_AA_OFFSET          (0) /* Metadata characteristic Access Address offset */
@@ -52,6 +53,39 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define CONN_HANDLE_INVALID             (0xFFFF)
 
+#ifndef MESH_GATT_BULK_ATT_MTU
+#if defined(NRF52) && (NORDIC_SDK_VERSION >= 12)
+/** @brief ATT MTU to offer in MTU exchanges, bounds the bulk characteristic
+ * payload. */
+#define MESH_GATT_BULK_ATT_MTU          (247)
+#else
+#define MESH_GATT_BULK_ATT_MTU          (GATT_MTU_SIZE_DEFAULT)
+#endif
+#endif
+
+#define MESH_GATT_BULK_MAX_LEN          (MESH_GATT_BULK_ATT_MTU - 3) /* Max length of a bulk characteristic write or notification */
+
+#ifndef MESH_GATT_NOTIFICATION_QUEUE_LENGTH
+/** @brief Number of handles that may wait for a value notification while the
+ * SoftDevice is out of TX buffers. Updates to a waiting handle replace its
+ * queued value. */
+#define MESH_GATT_NOTIFICATION_QUEUE_LENGTH (8)
+#endif
+
+#ifndef MESH_GATT_CONN_COUNT_MAX
+/** @brief Number of GATT clients that may be connected at the same time. Each
+ * gets its own notification queue and subscription filter. More than one
+ * requires a SoftDevice with several peripheral links, like the S132, enabled
+ * with at least as many peripheral connections. */
+#define MESH_GATT_CONN_COUNT_MAX        (1)
+#endif
+
+#if (MESH_GATT_CONN_COUNT_MAX < 1)
+#error "MESH_GATT_CONN_COUNT_MAX must be at least 1"
+#elif (MESH_GATT_CONN_COUNT_MAX > 1) && !defined(NRF52)
+#error "The nRF51 SoftDevices only support a single peripheral connection"
+#endif
+
 /**
 * @brief Global mesh metadata characteristic type
 */
@@ -64,6 +98,15 @@ typedef struct
 
 uint32_t mesh_gatt_init(uint32_t access_address, uint8_t channel, uint32_t interval_min_ms);
 
+/**
+* @brief Notify the connected GATT clients that subscribe to the handle of a
+*   new value. The notification is queued for each client until the SoftDevice
+*   has a free TX buffer, and a queued notification for the same handle is
+*   replaced by the new value.
+*
+* @return NRF_ERROR_NO_MEM if the notification queue of a client is full, the
+*   other clients still get the value.
+*/
 uint32_t mesh_gatt_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length);
 
 void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt);
@@ -0,0 +1,123 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_GROUP_H__
+#define MESH_GROUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_GROUP Value groups
+ * Versions related values together, when RBC_MESH_VALUE_GROUPS is defined.
+ * The components of a group are packed into the value of the group handle,
+ * each as a length byte followed by its contents, so they share a version
+ * number and a Trickle instance, go out in the same packet and arrive in the
+ * same event. The component handles only exist in the group, and updates and
+ * reads of a single component go through the group value.
+ *
+ * Group updates are applied to the handle storage in place, through
+ * vh_local_update_batch(), so a component update always builds on the
+ * previous one, even before the event handler has run.
+ * @{
+ */
+
+/**
+ * Add a value group, see rbc_mesh_group_add(). Must be called from the
+ * application context.
+ */
+uint32_t mesh_group_add(rbc_mesh_value_handle_t group_handle, const rbc_mesh_value_handle_t* p_components, uint8_t count);
+
+/**
+ * Check whether the given handle is a value group.
+ *
+ * @param[in] handle Handle to check.
+ *
+ * @return Whether the handle is a value group.
+ */
+bool mesh_group_is_group(rbc_mesh_value_handle_t handle);
+
+/**
+ * Check whether the given handle is a component of a value group.
+ *
+ * @param[in] handle Handle to check.
+ *
+ * @return Whether the handle is a component of a value group.
+ */
+bool mesh_group_is_component(rbc_mesh_value_handle_t handle);
+
+/**
+ * Set all components of a group as a new version of the group, see
+ * rbc_mesh_group_set(). Must be called from the application context.
+ */
+uint32_t mesh_group_local_update(rbc_mesh_value_handle_t group_handle, uint8_t* const* pp_data, const uint16_t* p_lengths);
+
+/**
+ * Set a single component as a new version of its group, with the other
+ * components left as they are. Components that have never been set are
+ * empty. Must be called from the application context.
+ *
+ * @param[in] handle Handle of the component.
+ * @param[in] data Component contents.
+ * @param[in] length Length of the component contents.
+ *
+ * @return NRF_SUCCESS The group was updated.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a component of a group.
+ * @return NRF_ERROR_INVALID_LENGTH The group value would be too long.
+ * @return NRF_ERROR_NO_MEM Out of packets.
+ */
+uint32_t mesh_group_component_set(rbc_mesh_value_handle_t handle, const uint8_t* data, uint16_t length);
+
+/**
+ * Get a copy of a single component from the current group value.
+ *
+ * @param[in] handle Handle of the component.
+ * @param[out] data Buffer to copy the component into.
+ * @param[in,out] p_length Size of the buffer, set to the length of the
+ *   component.
+ *
+ * @return NRF_SUCCESS The component was copied.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a component of a group, or
+ *   the group has no value.
+ * @return NRF_ERROR_INVALID_LENGTH The buffer is too short.
+ */
+uint32_t mesh_group_component_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length);
+
+/** Split a group value into its components, see rbc_mesh_group_unpack(). */
+uint32_t mesh_group_unpack(rbc_mesh_value_handle_t group_handle,
+        const uint8_t* p_data,
+        uint16_t length,
+        const uint8_t** pp_data,
+        uint16_t* p_lengths,
+        uint8_t* p_count);
+
+/** @} */
+
+#endif /* MESH_GROUP_H__ */
@@ -0,0 +1,62 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_HEALTH_H__
+#define MESH_HEALTH_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_HEALTH Health monitor
+ * Checks the framework statistics against application set thresholds when
+ * RBC_MESH_HEALTH_MONITOR is defined. Every RBC_MESH_HEALTH_INTERVAL_MS, the
+ * queue drops, packet pool exhaustion, timeslot denials and late versions
+ * since the previous check are compared with their thresholds, and the
+ * application gets an @ref RBC_MESH_EVENT_TYPE_HEALTH event when the set of
+ * alarms changes. The report can also be published as a mesh value, so
+ * overloaded nodes show up at a gateway.
+ * @{
+ */
+
+/**
+ * Set the threshold of a metric, see rbc_mesh_health_threshold_set(). Must
+ * be called from the application context.
+ */
+uint32_t mesh_health_threshold_set(rbc_mesh_health_metric_t metric, uint16_t threshold);
+
+/**
+ * Set the handle the health report is published on, see
+ * rbc_mesh_health_handle_set(). Must be called from the application context.
+ */
+uint32_t mesh_health_handle_set(rbc_mesh_value_handle_t handle);
+
+/** @} */
+
+#endif /* MESH_HEALTH_H__ */
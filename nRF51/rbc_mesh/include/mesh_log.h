@@ -0,0 +1,98 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+#ifndef MESH_LOG_H__
+#define MESH_LOG_H__
+
+#include <stdint.h>
+#include "toolchain.h"
+
+/**
+* @file Deferred binary log for application and framework events, enabled
+*   with the RBC_MESH_LOG define. When disabled, the log macros expand to
+*   nothing.
+*
+*   A log call only stores a format ID, a timer_now() timestamp and two
+*   arguments in a RAM queue, so it's safe and cheap in any IRQ level, and
+*   never blocks. The records are written to a dedicated RTT up-buffer by
+*   mesh_log_flush(), which should be called from the application's main loop.
+*   The format strings only exist on the host, in a format file passed to
+*   scripts/mesh_log_decode.py. Records that don't fit in the queue are
+*   dropped, and the number of dropped records is reported in a
+*   MESH_LOG_ID_DROPPED record once there is room again.
+*/
+
+/** Format IDs reserved by the framework. Values are part of the host decoder
+  protocol. */
+typedef enum
+{
+    MESH_LOG_ID_DROPPED     = 0x0000, /**< Records were dropped, arg0 is the number of dropped records. */
+    MESH_LOG_ID_APP_BASE    = 0x0100, /**< First format ID available to the application. */
+} mesh_log_id_t;
+
+/** One log record, as streamed over RTT. */
+typedef __packed_armcc struct
+{
+    uint32_t timestamp; /**< timer_now() at the time of the call. */
+    uint16_t id;        /**< Format ID. */
+    uint16_t reserved;
+    uint32_t args[2];
+} __packed_gcc mesh_log_record_t;
+
+#ifdef RBC_MESH_LOG
+
+#define MESH_LOG(id, arg0, arg1)    mesh_log_event((id), (uint32_t) (arg0), (uint32_t) (arg1))
+#define MESH_LOG_FLUSH()            mesh_log_flush()
+
+/** Set up the log queue and the RTT up-buffer used for the log. */
+void mesh_log_init(void);
+
+/** Queue a single log record. Safe to call from any IRQ level. */
+void mesh_log_event(uint16_t id, uint32_t arg0, uint32_t arg1);
+
+/**
+* Write the queued records to RTT, until the queue is empty or the RTT buffer
+* is full. Must only be called from one context, typically the main loop.
+*
+* @return The number of records written.
+*/
+uint32_t mesh_log_flush(void);
+
+/** Get the total number of records dropped since the log was initialized. */
+uint32_t mesh_log_dropped_count_get(void);
+
+#else
+
+#define MESH_LOG(id, arg0, arg1)
+#define MESH_LOG_FLUSH()
+
+#endif /* RBC_MESH_LOG */
+
+#endif /* MESH_LOG_H__ */
@@ -0,0 +1,82 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_NEIGHBOR_H__
+#define MESH_NEIGHBOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_NEIGHBOR Neighbor table
+ * Keeps a table of the nodes this node hears directly when
+ * RBC_MESH_NEIGHBOR_TABLE is defined. Every received mesh packet updates the
+ * entry of its advertiser address with an RSSI moving average, the time of
+ * the packet and a packet counter. Relays advertise with their own address,
+ * so the table shows the radio links of the node, not the origin of the
+ * values. The table is filled in the order the neighbors are first heard,
+ * and a new neighbor replaces the one that has been quiet for the longest
+ * once the table is full.
+ * @{
+ */
+
+/**
+ * Register a received mesh packet. Must be called from the event handler
+ * context.
+ *
+ * @param[in] p_addr Advertiser address of the packet.
+ * @param[in] rssi RSSI of the packet, as reported by the radio (in -dBm).
+ * @param[in] timestamp Time of reception.
+ */
+void mesh_neighbor_rx(const ble_gap_addr_t* p_addr, uint8_t rssi, uint32_t timestamp);
+
+/**
+ * Copy an entry of the table, see rbc_mesh_neighbor_get(). May be called
+ * from any context.
+ */
+uint32_t mesh_neighbor_get(uint8_t index, rbc_mesh_neighbor_t* p_neighbor);
+
+/**
+ * Count the neighbors heard recently. May be called from any context.
+ *
+ * @param[in] time_now Current time.
+ * @param[in] max_age_us Longest time since the last packet for a neighbor to
+ *   count.
+ *
+ * @return Number of neighbors heard within max_age_us.
+ */
+uint8_t mesh_neighbor_count_get(uint32_t time_now, uint32_t max_age_us);
+
+/** Empty the table. May be called from any context. */
+void mesh_neighbor_table_clear(void);
+
+/** @} */
+
+#endif /* MESH_NEIGHBOR_H__ */
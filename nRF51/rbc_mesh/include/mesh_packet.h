@@ -39,10 +39,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define MESH_UUID                           (0xFEE4)
 #define MESH_ADV_DATA_TYPE                  (0x16)
-#define BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH   (31)
+#define BLE_ADV_PACKET_LEGACY_PAYLOAD_MAX_LENGTH (31)
+#ifdef RBC_MESH_LONG_PACKETS
+/* long enough for a single mesh adv data structure with the longest value */
+#define BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH   (1 + MESH_PACKET_ADV_OVERHEAD + RBC_MESH_VALUE_MAX_LEN)
+#else
+#define BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH   (BLE_ADV_PACKET_LEGACY_PAYLOAD_MAX_LENGTH)
+#endif
 
 #define MESH_PACKET_BLE_OVERHEAD            (BLE_GAP_ADDR_LEN)                                                      /* overhead before advertisement payload */
-#define MESH_PACKET_ADV_OVERHEAD            (1 /* adv_type */ + 2 /* UUID */ + 2 /* handle */ + 2 /* version */)    /* overhead inside adv data */
+#define MESH_PACKET_ADV_OVERHEAD            (1 /* adv_type */ + 2 /* UUID */ + 2 /* handle */ + 2 /* version */ + RBC_MESH_HOP_SCOPE_OVERHEAD + RBC_MESH_ORIGIN_TIME_OVERHEAD)    /* overhead inside adv data */
 #define MESH_PACKET_OVERHEAD                (MESH_PACKET_BLE_OVERHEAD + 1 + MESH_PACKET_ADV_OVERHEAD)               /* mesh packet total overhead */
 /******************************************************************************
 * Public typedefs
@@ -71,6 +77,12 @@ typedef __packed_armcc struct
     uint16_t                mesh_uuid;
     rbc_mesh_value_handle_t handle;
     uint16_t                version;
+#ifdef RBC_MESH_HOP_SCOPES
+    uint8_t                 hops_left;  /**< Number of times the value may still be relayed, or RBC_MESH_HOP_SCOPE_UNLIMITED. */
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+    uint16_t                origin_time; /**< Mesh time the version was set at, in RBC_MESH_ORIGIN_TIME_UNIT_US, or RBC_MESH_ORIGIN_TIME_NONE. */
+#endif
     uint8_t                 data[RBC_MESH_VALUE_MAX_LEN];
 } __packed_gcc mesh_adv_data_t;
 
@@ -92,12 +104,42 @@ typedef __packed_armcc struct
 /******************************************************************************
 * Interface functions
 ******************************************************************************/
-void mesh_packet_init(void);
+/** Get the size of the memory needed for a packet pool of the given size. */
+uint32_t mesh_packet_memory_size_get(uint16_t pool_size);
+
+/**
+* Initialize the packet pool with the given memory of
+*   mesh_packet_memory_size_get() bytes. Uses the built-in pool of
+*   RBC_MESH_PACKET_POOL_SIZE packets if p_memory is NULL.
+*/
+uint32_t mesh_packet_init(void* p_memory, uint16_t pool_size);
 
 void mesh_packet_on_ts_begin(void);
 
 bool mesh_packet_acquire(mesh_packet_t** pp_packet);
 
+/**
+* Acquire a packet for the radio to receive into. Unlike mesh_packet_acquire(),
+*   fails without an error check when fewer than
+*   RBC_MESH_PACKET_POOL_RX_RESERVE + 1 packets are free, so reception sheds
+*   load before the rest of the framework runs out.
+*/
+bool mesh_packet_acquire_rx(mesh_packet_t** pp_packet);
+
+/**
+* Set the longest payload of the packets originating from this node, at most
+*   BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH. Bounds the values
+*   mesh_packet_adv_data_append() will add to a packet, and the local values
+*   the version handler accepts. Received packets may still be longer.
+*/
+void mesh_packet_payload_max_set(uint8_t length);
+
+/** Get the longest payload of the packets originating from this node. */
+uint8_t mesh_packet_payload_max_get(void);
+
+/** Get a snapshot of the packet pool usage statistics. */
+void mesh_packet_pool_stats_get(rbc_mesh_packet_pool_stats_t* p_stats);
+
 /** Get pointer to start of packet which p_buf_pointer is pointing into */
 mesh_packet_t* mesh_packet_get_aligned(void* p_buf_pointer);
 
@@ -117,8 +159,19 @@ uint32_t mesh_packet_build(mesh_packet_t* p_packet,
 
 uint32_t mesh_packet_adv_data_sanitize(mesh_packet_t* p_packet);
 
+/** Get the first mesh adv data structure in the packet, or NULL if there's
+  none. The offset is cached per pool slot when the packet is built or first
+  parsed, so repeated lookups on the same packet don't walk the AD structures. */
 mesh_adv_data_t* mesh_packet_adv_data_get(mesh_packet_t* p_packet);
 
+/** Get the mesh adv data structure following p_adv_data in the packet, or NULL
+  if p_adv_data is the last one. Used to iterate over aggregated packets. */
+mesh_adv_data_t* mesh_packet_adv_data_next_get(mesh_packet_t* p_packet, mesh_adv_data_t* p_adv_data);
+
+/** Append a copy of the given mesh adv data structure to the packet payload.
+  Returns NRF_ERROR_NO_MEM if it doesn't fit. */
+uint32_t mesh_packet_adv_data_append(mesh_packet_t* p_packet, const mesh_adv_data_t* p_adv_data);
+
 rbc_mesh_value_handle_t mesh_packet_handle_get(mesh_packet_t* p_packet);
 
 bool mesh_packet_has_additional_data(mesh_packet_t* p_packet);
@@ -0,0 +1,89 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_SCHEDULE_H__
+#define MESH_SCHEDULE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_SCHEDULE Scheduled values
+ * Holds the events of selected values until the mesh time given in front of
+ * their payload, when RBC_MESH_SCHEDULED_VALUES is defined. The value itself
+ * is stored and relayed as soon as it arrives, only the application event is
+ * delayed, so every synchronized node raises it at the same instant however
+ * many hops it is from the origin. Each scheduled handle holds at most one
+ * event, a newer version replaces a pending one.
+ * @{
+ */
+
+/** Remove all scheduled handles. */
+void mesh_schedule_init(void);
+
+/**
+ * Have the values of the given handle take effect at their activation time.
+ *
+ * @param[in] handle Handle to schedule.
+ *
+ * @return NRF_SUCCESS The handle is scheduled, or was already.
+ * @return NRF_ERROR_NO_MEM All RBC_MESH_SCHEDULED_HANDLES_MAX entries are in use.
+ */
+uint32_t mesh_schedule_enable(rbc_mesh_value_handle_t handle);
+
+/** Whether the given handle is scheduled. */
+bool mesh_schedule_is_scheduled(rbc_mesh_value_handle_t handle);
+
+/**
+ * Hold a value event of a scheduled handle until its activation time. Called
+ * on every event pushed to the application.
+ *
+ * @param[in] p_evt Event to check.
+ *
+ * @return Whether the event was taken, and must not be queued.
+ */
+bool mesh_schedule_event_handle(rbc_mesh_event_t* p_evt);
+
+/**
+ * Raise an update event for a value this node set, at the activation time
+ * in front of it, like the other nodes do.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[in] p_data Value contents, starting with the activation time.
+ * @param[in] length Length of the value contents.
+ *
+ * @return NRF_SUCCESS The event will be raised at the activation time.
+ * @return NRF_ERROR_NO_MEM There's no packet to hold the value in.
+ */
+uint32_t mesh_schedule_local(rbc_mesh_value_handle_t handle, uint8_t* p_data, uint8_t length);
+
+/** @} */
+
+#endif /* MESH_SCHEDULE_H__ */
@@ -0,0 +1,127 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_SEGMENT_H__
+#define MESH_SEGMENT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+#include "mesh_packet.h"
+#include "transport_control.h"
+
+/**
+ * @defgroup MESH_SEGMENT Segmented values
+ * Carries values longer than RBC_MESH_VALUE_MAX_LEN on a single handle. Each
+ * packet of a segmented value carries a segment header byte in front of its
+ * payload, with the segment index in the lower nibble, and the index of the
+ * last segment in the upper nibble. All segments share the version number and
+ * Trickle instance of the handle in the handle storage, and the Trickle
+ * transmissions of the handle go through the segments in turn.
+ * @{
+ */
+
+/** Reset all segmented value entries. */
+void mesh_segment_init(void);
+
+/**
+ * Make the given handle a segmented value.
+ *
+ * @param[in] handle Handle to carry a segmented value.
+ *
+ * @return NRF_SUCCESS The handle is a segmented value.
+ * @return NRF_ERROR_NO_MEM There are no free segmented value entries.
+ */
+uint32_t mesh_segment_enable(rbc_mesh_value_handle_t handle);
+
+/**
+ * Check whether the given handle is a segmented value.
+ *
+ * @param[in] handle Handle to check.
+ *
+ * @return Whether the handle is a segmented value.
+ */
+bool mesh_segment_is_segmented(rbc_mesh_value_handle_t handle);
+
+/**
+ * Set the contents of a segmented value, and push it to the handle storage
+ * as a local update.
+ *
+ * @param[in] handle Handle of the segmented value.
+ * @param[in] data Value contents.
+ * @param[in] length Length of the value contents.
+ *
+ * @return NRF_SUCCESS The value was updated.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a segmented value.
+ * @return NRF_ERROR_INVALID_LENGTH The length exceeds RBC_MESH_SEGMENTED_VALUE_MAX_LEN.
+ * @return NRF_ERROR_NO_MEM Out of packets or event queue space.
+ */
+uint32_t mesh_segment_local_update(rbc_mesh_value_handle_t handle, const uint8_t* data, uint16_t length);
+
+/**
+ * Get a copy of a complete segmented value.
+ *
+ * @param[in] handle Handle of the segmented value.
+ * @param[out] data Buffer to copy the value into.
+ * @param[out] p_length Length of the copied value.
+ *
+ * @return NRF_SUCCESS The value was copied.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a segmented value, or isn't complete.
+ */
+uint32_t mesh_segment_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length);
+
+/**
+ * Process a received segment. MUST BE CALLED FROM EVENT HANDLER CONTEXT.
+ *
+ * @param[in] p_packet Received packet, carrying a segment of a segmented value.
+ * @param[in] timestamp Time of reception.
+ * @param[in] rssi RSSI of the received packet.
+ *
+ * @return NRF_SUCCESS The segment was processed.
+ * @return NRF_ERROR_INVALID_DATA The segment is malformed.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a segmented value.
+ */
+uint32_t mesh_segment_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi);
+
+/**
+ * Transmit the next RBC_MESH_SEGMENTS_PER_TX segments of a segmented value.
+ * MUST BE CALLED FROM EVENT HANDLER CONTEXT.
+ *
+ * @param[in] p_packet The packet stored for the handle in the handle storage.
+ * @param[in] p_tx_config TX configuration to transmit the segments with.
+ *
+ * @return NRF_SUCCESS At least one segment was queued for transmission.
+ * @return NRF_ERROR_NOT_FOUND The handle is not a segmented value, or has no segments.
+ * @return NRF_ERROR_NO_MEM No segments could be queued.
+ */
+uint32_t mesh_segment_tx(mesh_packet_t* p_packet, const tc_tx_config_t* p_tx_config);
+
+/** @} */
+
+#endif /* MESH_SEGMENT_H__ */
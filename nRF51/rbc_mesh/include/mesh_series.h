@@ -0,0 +1,84 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_SERIES_H__
+#define MESH_SERIES_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_SERIES Time series values
+ * Batches timestamped samples into the value of a handle, when
+ * RBC_MESH_TIME_SERIES is defined. A batch is encoded as
+ *
+ *     varint first_index, varint timestamp_ms, zigzag varint value,
+ *     { varint timestamp delta, zigzag varint value delta } ...
+ *
+ * where a varint is an unsigned LEB128 number and the deltas are taken from
+ * the previous sample, modulo 2^32. The number of samples follows from the
+ * length of the value.
+ *
+ * The batch is built in place and published through vh_local_update() when
+ * it's full, so the series only costs one version per batch.
+ * @{
+ */
+
+/**
+ * Make a handle a time series, see rbc_mesh_series_enable(). Must be called
+ * from the application context.
+ */
+uint32_t mesh_series_enable(rbc_mesh_value_handle_t handle, uint8_t batch_count);
+
+/**
+ * Check whether the given handle is a time series.
+ *
+ * @param[in] handle Handle to check.
+ *
+ * @return Whether the handle is a time series.
+ */
+bool mesh_series_is_series(rbc_mesh_value_handle_t handle);
+
+/** Add a sample to a time series, see rbc_mesh_series_sample_add(). */
+uint32_t mesh_series_sample_add(rbc_mesh_value_handle_t handle, uint32_t timestamp_ms, int32_t value);
+
+/** Publish the pending samples of a time series, see rbc_mesh_series_flush(). */
+uint32_t mesh_series_flush(rbc_mesh_value_handle_t handle);
+
+/** Decode a time series value, see rbc_mesh_series_unpack(). */
+uint32_t mesh_series_unpack(const uint8_t* p_data,
+        uint16_t length,
+        uint32_t* p_first_index,
+        rbc_mesh_series_sample_t* p_samples,
+        uint8_t* p_count);
+
+/** @} */
+
+#endif /* MESH_SERIES_H__ */
@@ -0,0 +1,103 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_SHADOW_H__
+#define MESH_SHADOW_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_SHADOW Value shadow table
+ * Keeps a copy of selected values that the application can read without
+ * locks, when RBC_MESH_VALUE_SHADOW is defined. The handle storage writes
+ * every new value of a shadowed handle to its entry, between two increments
+ * of the entry's sequence number, so the number is odd while the entry is
+ * being written. A reader copies the entry out and checks that the sequence
+ * number was even and unchanged over the copy, and tries again if not.
+ *
+ * All writes come from the event handler context, or from an event handler
+ * critical section, so there's only ever one writer. Readers in a lower
+ * priority context never see an odd sequence number, as the write completes
+ * before they get to run again. Readers in a higher priority context might,
+ * and get NRF_ERROR_BUSY instead of waiting for a write that can't finish.
+ * @{
+ */
+
+/** Remove all entries from the shadow table. */
+void mesh_shadow_init(void);
+
+/**
+ * Add the given handle to the shadow table, with its current value. Must be
+ * called from the application context.
+ *
+ * @param[in] handle Handle to shadow.
+ *
+ * @return NRF_SUCCESS The handle is shadowed.
+ * @return NRF_ERROR_NO_MEM The shadow table is full.
+ */
+uint32_t mesh_shadow_add(rbc_mesh_value_handle_t handle);
+
+/**
+ * Write a new value to the shadow entry of the given handle, if it has one.
+ * MUST BE CALLED FROM EVENT HANDLER CONTEXT, or in an event handler critical
+ * section.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[in] p_data Value contents.
+ * @param[in] length Length of the value contents.
+ */
+void mesh_shadow_write(rbc_mesh_value_handle_t handle, const uint8_t* p_data, uint8_t length);
+
+/**
+ * Mark the shadow entry of the given handle as having no value, if it has
+ * one. Same context rules as mesh_shadow_write().
+ *
+ * @param[in] handle Handle of the value.
+ */
+void mesh_shadow_invalidate(rbc_mesh_value_handle_t handle);
+
+/**
+ * Read a shadowed value without locks. May be called from any context.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[out] data Buffer to copy the value into.
+ * @param[in,out] p_length Size of the buffer, set to the length of the value.
+ *
+ * @return NRF_SUCCESS The value was copied.
+ * @return NRF_ERROR_NOT_FOUND The handle isn't shadowed, or has no value.
+ * @return NRF_ERROR_INVALID_LENGTH The buffer is too short.
+ * @return NRF_ERROR_BUSY The entry kept changing during the read, or is
+ *   being written by a context the caller interrupted.
+ */
+uint32_t mesh_shadow_read(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length);
+
+/** @} */
+
+#endif /* MESH_SHADOW_H__ */
@@ -0,0 +1,72 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_SNIFFER_H__
+#define MESH_SNIFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup MESH_SNIFFER Packet capture
+ * Streams every packet the radio receives to the serial host when
+ * RBC_MESH_SNIFFER is defined, as sniffer events. Packets are captured in
+ * the radio callback, before decryption and filtering, including the ones
+ * that fail their CRC check. The capture queue is drained into the serial
+ * queue from the event handler. Packets that arrive while the capture queue
+ * is full are counted, and the count is reported in the next sniffer event.
+ * @{
+ */
+
+/** Start or stop the capture. Starts out stopped. */
+void mesh_sniffer_enable(bool enable);
+
+/** Whether the capture is running. */
+bool mesh_sniffer_is_enabled(void);
+
+/**
+ * Capture a received packet. Must be called from the radio callback.
+ *
+ * @param[in] p_packet The received packet.
+ * @param[in] crc_ok Whether the packet passed its CRC check.
+ * @param[in] rssi RSSI of the packet, as reported by the radio (in -dBm).
+ * @param[in] timestamp Time of the packet's access address.
+ * @param[in] channel BLE channel index the packet was received on.
+ */
+void mesh_sniffer_rx(const uint8_t* p_packet, bool crc_ok, uint8_t rssi, uint32_t timestamp, uint8_t channel);
+
+/**
+ * Send captured packets until the serial queue is full. Must be called from
+ * the event handler context.
+ */
+void mesh_sniffer_flush(void);
+
+/** @} */
+
+#endif /* MESH_SNIFFER_H__ */
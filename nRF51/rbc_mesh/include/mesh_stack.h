@@ -0,0 +1,56 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_STACK_H__
+#define MESH_STACK_H__
+
+#include <stdint.h>
+
+/**
+* @file Stack watermark, enabled with the RBC_MESH_STACK_WATERMARK define.
+*   The free part of the stack is painted with a known pattern, and the
+*   deepest word that has been overwritten since gives the peak stack usage.
+*   The stack bounds come from the startup files: the STACK section with
+*   ARMCC, and __StackLimit and __StackTop with GCC.
+*/
+
+#ifdef RBC_MESH_STACK_WATERMARK
+
+/** Paint the stack below the current stack pointer. */
+void mesh_stack_paint(void);
+
+/** Get the size of the stack in bytes. */
+uint32_t mesh_stack_size_get(void);
+
+/** Get the largest number of stack bytes used since mesh_stack_paint(). */
+uint32_t mesh_stack_used_get(void);
+
+#endif /* RBC_MESH_STACK_WATERMARK */
+
+#endif /* MESH_STACK_H__ */
@@ -0,0 +1,102 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_TRACE_H__
+#define MESH_TRACE_H__
+
+#include <stdint.h>
+#include "toolchain.h"
+
+/**
+* @file Binary trace of timestamped enter and exit events in the framework hot
+*   paths, streamed to the host over a dedicated RTT up-buffer. Enabled with
+*   the RBC_MESH_TRACE define. When disabled, the trace macros expand to
+*   nothing.
+*
+*   Each record is a packed mesh_trace_record_t, timestamped with timer_now().
+*   The timer only runs in timeslots, so records outside timeslots share the
+*   end time of the previous timeslot. Records that don't fit in the RTT buffer
+*   are dropped, and the number of dropped records is reported in a
+*   MESH_TRACE_POINT_OVERFLOW record once there is room again. Decode the
+*   stream with scripts/mesh_trace_decode.py.
+*/
+
+/** Traced code sections. Values are part of the host decoder protocol. */
+typedef enum
+{
+    MESH_TRACE_POINT_OVERFLOW           = 0x00, /**< Records were dropped, data is the number of dropped records. */
+    MESH_TRACE_POINT_TIMESLOT           = 0x01, /**< Timeslot start to end. */
+    MESH_TRACE_POINT_TS_SIGNAL          = 0x02, /**< Softdevice radio signal callback, data is the signal type. */
+    MESH_TRACE_POINT_RADIO_IRQ          = 0x03, /**< Radio event handler. */
+    MESH_TRACE_POINT_EVENT              = 0x04, /**< Internal async event execution, data is the event type. */
+    MESH_TRACE_POINT_RX_PACKET          = 0x05, /**< Received packet processing. */
+    MESH_TRACE_POINT_TX                 = 0x06, /**< Periodic transmission of all due values. */
+    MESH_TRACE_POINT_HANDLE_STORAGE_TX  = 0x07, /**< Fetching the due values from the handle storage, exit data is the number of values. */
+    MESH_TRACE_POINT_DATA_ENTRY_ALLOC   = 0x08, /**< Data cache entry allocation. */
+    MESH_TRACE_POINT_FLASH_OP           = 0x09, /**< Flash operation, data is the operation type. */
+} mesh_trace_point_t;
+
+/** Record types. */
+typedef enum
+{
+    MESH_TRACE_TYPE_ENTER   = 0x00,
+    MESH_TRACE_TYPE_EXIT    = 0x01,
+    MESH_TRACE_TYPE_MARK    = 0x02,
+} mesh_trace_type_t;
+
+/** One trace record, as streamed over RTT. */
+typedef __packed_armcc struct
+{
+    uint32_t timestamp; /**< timer_now() at the time of the event. */
+    uint8_t point;      /**< @ref mesh_trace_point_t. */
+    uint8_t type;       /**< @ref mesh_trace_type_t. */
+    uint16_t data;      /**< Point specific data. */
+} __packed_gcc mesh_trace_record_t;
+
+#ifdef RBC_MESH_TRACE
+
+#define TRACE_BEGIN(point, data)    mesh_trace_event((point), MESH_TRACE_TYPE_ENTER, (data))
+#define TRACE_END(point, data)      mesh_trace_event((point), MESH_TRACE_TYPE_EXIT, (data))
+#define TRACE_MARK(point, data)     mesh_trace_event((point), MESH_TRACE_TYPE_MARK, (data))
+
+/** Configure the RTT up-buffer used for the trace. */
+void mesh_trace_init(void);
+
+/** Log a single trace record. Safe to call from any IRQ level. */
+void mesh_trace_event(mesh_trace_point_t point, mesh_trace_type_t type, uint16_t data);
+
+#else
+
+#define TRACE_BEGIN(point, data)
+#define TRACE_END(point, data)
+#define TRACE_MARK(point, data)
+
+#endif /* RBC_MESH_TRACE */
+
+#endif /* MESH_TRACE_H__ */
@@ -0,0 +1,57 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_TRICKLE_TUNE_H__
+#define MESH_TRICKLE_TUNE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup MESH_TRICKLE_TUNE Trickle auto tune
+ * Adjusts the default Trickle parameters to the neighborhood of the node
+ * when RBC_MESH_TRICKLE_AUTO_TUNE is defined. The redundancy constant
+ * follows the number of neighbors in the neighbor table: a node with few
+ * neighbors transmits in every interval, while a node with many neighbors
+ * holds back as soon as one of them has sent the same version. The maximum
+ * interval follows the share of consistent receptions: a converged, dense
+ * neighborhood stretches it, while a sparse or churning one shortens it, so
+ * missed updates are caught sooner.
+ * @{
+ */
+
+/**
+ * Enable or disable the auto tune, see rbc_mesh_trickle_auto_tune_set().
+ * Must be called from the application context.
+ */
+void mesh_trickle_tune_set(bool enable);
+
+/** @} */
+
+#endif /* MESH_TRICKLE_TUNE_H__ */
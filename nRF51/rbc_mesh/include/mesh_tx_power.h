@@ -0,0 +1,63 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_TX_POWER_H__
+#define MESH_TX_POWER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup MESH_TX_POWER TX power control
+ * Picks the TX power of the node from the neighbor table when
+ * RBC_MESH_TX_POWER_CONTROL is defined. The framework can't tell what power
+ * a neighbor transmits at, so the path loss to each neighbor is estimated
+ * from its RSSI as if it transmitted at the highest power. The RSSI the
+ * neighbor receives this node at is then estimated as the current power
+ * minus the path loss, and the power is set to the lowest level that keeps
+ * RBC_MESH_TX_POWER_CONTROL_NEIGHBORS neighbors above the RSSI target.
+ * @{
+ */
+
+/**
+ * Enable or disable the control, see rbc_mesh_tx_power_control_set(). Must
+ * be called from the application context.
+ */
+void mesh_tx_power_control_set(bool enable);
+
+/**
+ * Set the highest TX power. Sets the TX power right away if the control is
+ * disabled, or if the current power is above the new maximum.
+ */
+void mesh_tx_power_max_set(rbc_mesh_txpower_t tx_power);
+
+/** @} */
+
+#endif /* MESH_TX_POWER_H__ */
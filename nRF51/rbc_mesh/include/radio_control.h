@@ -32,8 +32,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _RADIO_CONTROL_H__
 #include <stdint.h>
 #include <stdbool.h>
-/** @brief callbacks for after radio event is complete */
-typedef void (*radio_rx_cb_t)(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi);
+/** @brief callbacks for after radio event is complete. The RX timestamp is
+    the time of the address event, 0 in the bootloader. The channel is the
+    BLE channel index the packet was received on. */
+typedef void (*radio_rx_cb_t)(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi, uint32_t timestamp, uint8_t channel);
 typedef void (*radio_tx_cb_t)(uint8_t* p_data);
 
 /** @brief callback for when the radio is out of things to do */
@@ -46,6 +48,30 @@ typedef enum
     RADIO_EVENT_TYPE_RX_PREEMPTABLE /**< Will be aborted when a new event comes in */
 } radio_event_type_t;
 
+/** @brief Queueing class of a radio event, see RBC_MESH_RADIO_PRIORITY.
+    Events of a higher class are queued ahead of the lower classes. */
+typedef enum
+{
+    RADIO_PRIORITY_BULK,            /**< Bulk transfers, such as DFU data. */
+    RADIO_PRIORITY_NORMAL,          /**< Regular values and RX. */
+    RADIO_PRIORITY_HIGH             /**< Urgent values and DFU control packets. */
+} radio_priority_t;
+
+/** @brief On-air bit rate of the radio. */
+typedef enum
+{
+    RADIO_MODE_BLE_1MBIT,           /**< BLE 1 Mbit, supported by all devices. */
+    RADIO_MODE_BLE_2MBIT            /**< BLE 2 Mbit, nRF52 only. */
+} radio_mode_t;
+
+/** @brief Accumulated radio time by state, in microseconds. */
+typedef struct
+{
+    uint64_t rx_us;                 /**< Receiver on, after ramp-up. */
+    uint64_t tx_us;                 /**< Transmitter on, after ramp-up. */
+    uint64_t ramp_up_us;            /**< Ramping up for RX and TX. */
+} radio_time_t;
+
 /**
 * @brief executable radio event type
 */
@@ -53,11 +79,13 @@ typedef struct
 {
     uint8_t* packet_ptr;            /**< Packet pointer to use. */
 
-    /** Access address index to operate on. Must be either 0 (the default BLE advertisement address) or 1 (the alternate address set through a call to radio_alt_aa_set()).  */
+    /** Access address index to operate on. Must be either 0 (the default BLE advertisement address), 1 (the alternate address set through a call to radio_alt_aa_set()) or an address set with radio_aa_prefix_set(). */
     uint8_t access_address;
     radio_event_type_t event_type;  /**< RX/TX */
     uint8_t channel;                /**< Channel to execute event on */
     uint8_t tx_power;               /**< Transmit power for TX events */
+    uint8_t priority;               /**< Queueing class of TX events, see radio_priority_t. Only used with RBC_MESH_RADIO_PRIORITY, RX is always queued as RADIO_PRIORITY_NORMAL. */
+    uint8_t overtaken;              /**< Number of times the queued event has been overtaken. Set by radio_order(). */
 } radio_event_t;
 
 /**
@@ -72,6 +100,20 @@ void radio_init(radio_idle_cb_t idle_cb,
                 radio_rx_cb_t   rx_cb,
                 radio_tx_cb_t   tx_cb);
 
+/**
+* @brief Set the bit rate of the radio. Takes effect at the next call to
+*   radio_init(), so it should be set before the first timeslot.
+*
+* @param[in] mode Radio mode to use.
+*/
+void radio_mode_set(radio_mode_t mode);
+
+/**
+* @brief Get the time to reserve for a radio event with a full length packet,
+*   including the radio ramp-up, in the current radio mode.
+*/
+uint32_t radio_event_duration_get(void);
+
 /**
 * @brief Set the alternate access address.
 *
@@ -84,19 +126,71 @@ void radio_init(radio_idle_cb_t idle_cb,
 */
 void radio_alt_aa_set(uint32_t access_address);
 
+/**
+* @brief Enable one of the extra logical addresses, 2 to 7. These share the
+*   three low bytes of the alternate access address, and only differ in the
+*   top (prefix) byte. Reception is enabled on all extra addresses.
+*
+* @param[in] logical_address Logical address to set, 2 to 7.
+* @param[in] prefix Top byte of the access address.
+*
+* @return NRF_SUCCESS The address was set.
+* @return NRF_ERROR_INVALID_ADDR The logical address is out of range.
+*/
+uint32_t radio_aa_prefix_set(uint8_t logical_address, uint8_t prefix);
+
+/**
+* @brief Get the logical address the last packet was received on. Only valid
+*   in the RX callback.
+*/
+uint8_t radio_rx_address_get(void);
+
 /**
 * @brief Schedule a radio event (tx/rx)
 *
 * @param[in] radio_event pointer to user-created radio event to be queued.
-*   Is copied into queue, may be stack allocated
+*   Is copied into queue, may be stack allocated. With
+*   RBC_MESH_RADIO_PRIORITY, the event is queued ahead of the events of a
+*   lower class, but never ahead of the ongoing event, and never ahead of an
+*   event that has been overtaken RBC_MESH_RADIO_OVERTAKE_MAX times.
 */
 uint32_t radio_order(radio_event_t* radio_event);
 
+/**
+* @brief Get the number of events in the radio queue, including the ongoing
+*   event.
+*/
+uint32_t radio_queue_len_get(void);
+
+/**
+* @brief Get whether the radio queue holds any events other than a
+*   preemptable RX, which would be aborted by the next event anyway.
+*/
+bool radio_queue_busy(void);
+
 /**
 * @brief Disable the radio. Overrides any ongoing rx or tx procedures
 */
 void radio_disable(void);
 
+/**
+* @brief Get the number of times a transmission has been deferred because
+*   the channel was busy. Always 0 without RBC_MESH_LISTEN_BEFORE_TALK.
+*/
+uint32_t radio_tx_deferred_count_get(void);
+
+/**
+* @brief Get the time the radio has spent in each state, counted from the
+*   RXEN or TXEN task to the end of the event. The ongoing event is counted
+*   once it ends. Always 0 without RBC_MESH_RADIO_TIME_STATS.
+*
+* @param[out] p_time Radio time structure to fill.
+*/
+void radio_time_get(radio_time_t* p_time);
+
+/** @brief Get the RAM used by the radio event queue and TX buffers. */
+uint32_t radio_ram_size_get(void);
+
 
 /**
 * @brief Radio event handler, checks any relevant events generated by the radio, and acts accordingly
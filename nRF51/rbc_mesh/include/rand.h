@@ -75,6 +75,17 @@ uint32_t rand_prng_seed(prng_t* p_prng);
  */
 uint32_t rand_prng_get(prng_t* p_prng);
 
+/**
+ * Mix fresh random bytes from the HW RNG module into a seeded PRNG instance, without waiting for
+ * them. Meant to be called at regular intervals from a context where Softdevice calls are allowed.
+ *
+ * @param[in,out] p_prng The PRNG instance to reseed.
+ *
+ * @return NRF_SUCCESS The PRNG instance was reseeded.
+ * @return NRF_ERROR_BUSY Not enough random bytes were ready, the instance is unchanged.
+ */
+uint32_t rand_prng_reseed(prng_t* p_prng);
+
 /**
  * Get a variable length array of random bytes from the HW RNG module.
  *
@@ -85,6 +96,21 @@ uint32_t rand_prng_get(prng_t* p_prng);
  */
 uint32_t rand_hw_rng_get(uint8_t* p_result, uint16_t len);
 
+/**
+ * Get a variable length array of random bytes from the HW RNG module, without waiting for them.
+ *
+ * @note The Softdevice keeps its own pool of random bytes, filled in the background. Without the
+ *       Softdevice, the first call starts filling a pool of RAND_POOL_SIZE bytes from the RNG
+ *       interrupt, and later calls are served from it.
+ *
+ * @param[out] p_result An array to copy the random values to. Must be at least of length len.
+ * @param[in] len The number of bytes to be copied into the p_result parameter.
+ *
+ * @return NRF_SUCCESS The p_result parameter was successfully filled with len number of random bytes.
+ * @return NRF_ERROR_BUSY Fewer than len random bytes were ready, nothing was copied.
+ */
+uint32_t rand_hw_rng_try_get(uint8_t* p_result, uint16_t len);
+
 /** @} */
 
 #endif /* RAND_H__ */
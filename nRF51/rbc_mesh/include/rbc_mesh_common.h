@@ -111,6 +111,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     #define PIN_OUT(val,bitcount)
 #endif
 
+/** Round a memory size up to the next multiple of a word. */
+#define MEMORY_WORD_ALIGN(size)     ((((uint32_t) (size)) + 3) & ~3UL)
+
 #define CHECK_FP(fp) if ((uint32_t)fp < 0x18000UL || (uint32_t)fp > 0x20000000UL){APP_ERROR_CHECK(NRF_ERROR_INVALID_ADDR);}
 
 #endif /* _RBC_MESH_COMMON_H__ */
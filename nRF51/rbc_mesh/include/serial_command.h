@@ -40,6 +40,21 @@ typedef __packed_armcc enum
 {
     SERIAL_CMD_OPCODE_ECHO                  = 0x02,
     SERIAL_CMD_OPCODE_RADIO_RESET           = 0x0E,
+
+    SERIAL_CMD_OPCODE_VALUE_HISTORY_GET     = 0x62,
+    SERIAL_CMD_OPCODE_SHARD_SET             = 0x63,
+    SERIAL_CMD_OPCODE_EVENT_FORMAT_SET      = 0x64,
+    SERIAL_CMD_OPCODE_VALUES_SET            = 0x65,
+    SERIAL_CMD_OPCODE_PROPAGATION_STATS_GET = 0x66,
+    SERIAL_CMD_OPCODE_ISR_STATS_GET         = 0x67,
+    SERIAL_CMD_OPCODE_DFU_WINDOWED          = 0x68,
+    SERIAL_CMD_OPCODE_SNIFFER_SET           = 0x69,
+    SERIAL_CMD_OPCODE_NEIGHBOR_GET          = 0x6A,
+    SERIAL_CMD_OPCODE_HANDLE_STATS_GET      = 0x6B,
+    SERIAL_CMD_OPCODE_MIRROR_START          = 0x6C,
+    SERIAL_CMD_OPCODE_EVENT_MASK_SET        = 0x6D,
+    SERIAL_CMD_OPCODE_BAUDRATE_SET          = 0x6E,
+    SERIAL_CMD_OPCODE_BATCH                 = 0x6F,
     
     SERIAL_CMD_OPCODE_INIT                  = 0x70,
     SERIAL_CMD_OPCODE_VALUE_SET             = 0x71,
@@ -50,6 +65,7 @@ typedef __packed_armcc enum
     SERIAL_CMD_OPCODE_FLAG_SET              = 0x76,
     SERIAL_CMD_OPCODE_FLAG_GET              = 0x77,
     SERIAL_CMD_OPCODE_DFU                   = 0x78,
+    SERIAL_CMD_OPCODE_STATS_GET             = 0x79,
 
     SERIAL_CMD_OPCODE_VALUE_GET             = 0x7A,
     SERIAL_CMD_OPCODE_BUILD_VERSION_GET     = 0x7B,
@@ -111,6 +127,88 @@ typedef __packed_armcc struct
     dfu_packet_t packet;
 } __packed_gcc serial_cmd_params_dfu_t;
 
+typedef __packed_armcc struct 
+{
+    uint8_t seq;         /**< Sequence number of the packet. Without a packet, opens the window at this number. */
+    dfu_packet_t packet;
+} __packed_gcc serial_cmd_params_dfu_windowed_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t offset; /**< Byte offset into the rbc_mesh_stats_t structure. */
+} __packed_gcc serial_cmd_params_stats_get_t;
+
+typedef __packed_armcc struct 
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t reset; /**< Clear the counters of the handle after reading them. */
+} __packed_gcc serial_cmd_params_handle_stats_get_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t isr;        /**< Interrupt handler, see @ref rbc_mesh_isr_t. */
+    uint8_t histogram;  /**< 0 for the duration histogram, 1 for the latency histogram. */
+    uint8_t reset;      /**< Clear the statistics of the handler after reading them. */
+} __packed_gcc serial_cmd_params_isr_stats_get_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t reset;      /**< Clear the histogram after reading it. */
+} __packed_gcc serial_cmd_params_propagation_stats_get_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t index; /**< Index into the neighbor table. */
+} __packed_gcc serial_cmd_params_neighbor_get_t;
+
+typedef __packed_armcc struct 
+{
+    uint32_t baudrate; /**< New baudrate in bits per second. */
+} __packed_gcc serial_cmd_params_baudrate_set_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t mask; /**< Bitmask of the event types to forward, see @ref aci_evt_mask_t. */
+} __packed_gcc serial_cmd_params_event_mask_set_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t format; /**< Format of the value events, see @ref aci_evt_format_t. */
+} __packed_gcc serial_cmd_params_event_format_set_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t count; /**< Number of shards the handles are split in, 0 or 1 to forward all handles. */
+    uint8_t index; /**< Shard to forward, the handles where handle % count == index. */
+} __packed_gcc serial_cmd_params_shard_set_t;
+
+typedef __packed_armcc struct 
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t version; /**< Newest version the host has, the history after it is sent. */
+} __packed_gcc serial_cmd_params_value_history_get_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t enable; /**< 1 to start streaming received packets, 0 to stop. */
+} __packed_gcc serial_cmd_params_sniffer_set_t;
+
+#define SERIAL_CMD_BATCH_MAX_LEN    (SERIAL_DATA_MAX_LEN - 2) /**< Space for commands in a batch command. */
+
+typedef __packed_armcc struct 
+{
+    uint8_t token;  /**< Returned in the batch response, to match responses to pipelined batches. */
+    uint8_t commands[SERIAL_CMD_BATCH_MAX_LEN]; /**< Back to back commands, each with its own length and opcode. */
+} __packed_gcc serial_cmd_params_batch_t;
+
+#define SERIAL_CMD_VALUES_SET_MAX_LEN   (SERIAL_DATA_MAX_LEN - 1) /**< Space for values in a values set command. */
+#define SERIAL_CMD_VALUES_SET_MAX_COUNT (SERIAL_CMD_VALUES_SET_MAX_LEN / 3) /**< Highest number of values in a values set command. */
+
+typedef __packed_armcc struct 
+{
+    uint8_t values[SERIAL_CMD_VALUES_SET_MAX_LEN]; /**< Back to back values, each a handle, a length byte and the value. */
+} __packed_gcc serial_cmd_params_values_set_t;
+
 
 
 
@@ -129,6 +227,20 @@ typedef __packed_armcc struct
         serial_cmd_params_value_disable_t   value_disable;
         serial_cmd_params_value_get_t       value_get;
         serial_cmd_params_dfu_t             dfu;
+        serial_cmd_params_dfu_windowed_t    dfu_windowed;
+        serial_cmd_params_stats_get_t       stats_get;
+        serial_cmd_params_handle_stats_get_t handle_stats_get;
+        serial_cmd_params_isr_stats_get_t   isr_stats_get;
+        serial_cmd_params_propagation_stats_get_t propagation_stats_get;
+        serial_cmd_params_neighbor_get_t    neighbor_get;
+        serial_cmd_params_batch_t           batch;
+        serial_cmd_params_values_set_t      values_set;
+        serial_cmd_params_baudrate_set_t    baudrate_set;
+        serial_cmd_params_event_mask_set_t  event_mask_set;
+        serial_cmd_params_event_format_set_t event_format_set;
+        serial_cmd_params_shard_set_t       shard_set;
+        serial_cmd_params_value_history_get_t value_history_get;
+        serial_cmd_params_sniffer_set_t     sniffer_set;
     } __packed_gcc params;
 } __packed_gcc  serial_cmd_t;
 
@@ -46,6 +46,15 @@ typedef __packed_armcc enum
     SERIAL_EVT_OPCODE_EVENT_UPDATE          = 0xB4,
     SERIAL_EVT_OPCODE_EVENT_CONFLICTING     = 0xB5,
     SERIAL_EVT_OPCODE_EVENT_TX              = 0xB6,
+    SERIAL_EVT_OPCODE_EVENT_OVERFLOW        = 0xB7,
+    SERIAL_EVT_OPCODE_EVENT_SNAPSHOT        = 0xB8,
+    SERIAL_EVT_OPCODE_EVENT_SNAPSHOT_END    = 0xB9,
+    SERIAL_EVT_OPCODE_EVENT_SNIFFER         = 0xBA,
+    SERIAL_EVT_OPCODE_DFU_ACK               = 0xBB,
+    SERIAL_EVT_OPCODE_EVENT_COMPACT         = 0xBC,
+    SERIAL_EVT_OPCODE_EVENT_VERSIONED       = 0xBD,
+    SERIAL_EVT_OPCODE_EVENT_HISTORY         = 0xBE,
+    SERIAL_EVT_OPCODE_EVENT_HISTORY_END     = 0xBF,
     SERIAL_EVT_OPCODE_DFU                   = 0x78
 } __packed_gcc serial_evt_opcode_t;
 
@@ -99,6 +108,52 @@ typedef __packed_armcc struct
     uint16_t packet_type;
 } __packed_gcc serial_evt_cmd_rsp_params_dfu_t;
 
+typedef __packed_armcc struct
+{
+    uint8_t offset;     /**< Byte offset of the first data byte into the rbc_mesh_stats_t structure. */
+    uint8_t total_len;  /**< Size of the rbc_mesh_stats_t structure. */
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed_gcc serial_evt_cmd_rsp_params_stats_get_t;
+
+typedef __packed_armcc struct
+{
+    rbc_mesh_value_handle_t handle;
+    rbc_mesh_handle_stats_t stats;
+} __packed_gcc serial_evt_cmd_rsp_params_handle_stats_get_t;
+
+typedef __packed_armcc struct
+{
+    uint8_t isr;
+    uint8_t histogram;          /**< 0 for durations, 1 for latencies. */
+    uint16_t max_us;            /**< Longest duration or latency, in microseconds. */
+    uint16_t margin_overruns;   /**< Runs longer than the timeslot end margin. */
+    uint16_t buckets[RBC_MESH_ISR_HIST_BUCKETS];
+} __packed_gcc serial_evt_cmd_rsp_params_isr_stats_get_t;
+
+typedef __packed_armcc struct
+{
+    uint32_t count;             /**< New versions with an origin time. */
+    uint16_t unstamped;         /**< New versions without an origin time. */
+    uint16_t max_ms;            /**< Longest propagation delay, in milliseconds. */
+    uint16_t buckets[RBC_MESH_PROPAGATION_HIST_BUCKETS];
+} __packed_gcc serial_evt_cmd_rsp_params_propagation_stats_get_t;
+
+typedef __packed_armcc struct
+{
+    uint8_t index;          /**< Index of the entry in the neighbor table. */
+    uint8_t addr_type;
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+    int8_t rssi;            /**< RSSI average in dBm. */
+    uint32_t packet_count;
+    uint32_t age_us;        /**< Time since the last packet from the neighbor. */
+} __packed_gcc serial_evt_cmd_rsp_params_neighbor_get_t;
+
+typedef __packed_armcc struct
+{
+    uint8_t token;          /**< Token of the batch command. */
+    uint8_t command_count;  /**< Number of commands that were executed successfully. */
+} __packed_gcc serial_evt_cmd_rsp_params_batch_t;
+
 /****** EVT PARAMS ******/
 typedef __packed_armcc struct
 {
@@ -118,6 +173,12 @@ typedef __packed_armcc struct
         serial_evt_cmd_rsp_params_int_min_t int_min;
         serial_evt_cmd_rsp_params_val_get_t val_get;
         serial_evt_cmd_rsp_params_dfu_t dfu;
+        serial_evt_cmd_rsp_params_stats_get_t stats_get;
+        serial_evt_cmd_rsp_params_handle_stats_get_t handle_stats_get;
+        serial_evt_cmd_rsp_params_isr_stats_get_t isr_stats_get;
+        serial_evt_cmd_rsp_params_propagation_stats_get_t propagation_stats_get;
+        serial_evt_cmd_rsp_params_neighbor_get_t neighbor_get;
+        serial_evt_cmd_rsp_params_batch_t batch;
     } __packed_gcc response;        
 } __packed_gcc serial_evt_params_cmd_rsp_t;
 
@@ -145,6 +206,72 @@ typedef __packed_armcc struct
     uint8_t data[RBC_MESH_VALUE_MAX_LEN];
 } __packed_gcc serial_evt_params_event_tx_t;
 
+typedef __packed_armcc struct 
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed_gcc serial_evt_params_event_snapshot_t;
+
+typedef __packed_armcc struct 
+{
+    uint8_t event_opcode;   /**< Opcode of the value event this stands in for: NEW, UPDATE or CONFLICTING. */
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;       /**< Version of the value, or 0 for values set on the device. */
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed_gcc serial_evt_params_event_versioned_t;
+
+typedef __packed_armcc struct 
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;
+    uint32_t timestamp;     /**< Time the version was stored, on the device clock in microseconds. */
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed_gcc serial_evt_params_event_history_t;
+
+typedef __packed_armcc struct 
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t count;          /**< Number of history events sent. */
+    uint32_t time_now;      /**< Device clock when the history ended, to age the timestamps by. */
+} __packed_gcc serial_evt_params_event_history_end_t;
+
+typedef __packed_armcc struct 
+{
+    uint16_t count; /**< Number of snapshot events in the snapshot. */
+} __packed_gcc serial_evt_params_event_snapshot_end_t;
+
+/* Each record of a compact event starts with a header byte, with the event
+   type in the top two bits, the same handle flag and the data length. A length
+   of SERIAL_EVT_COMPACT_LEN_EXT is followed by a length byte. The handle
+   follows as a varint, 7 bits per byte with the lowest bits first, unless the
+   flag says the handle is the one after the previous record's. NEW, UPDATE
+   and CONFLICTING records then carry the version increase as a varint, and
+   all records end with the data. */
+#define SERIAL_EVT_COMPACT_TYPE_NEW         (0x00)
+#define SERIAL_EVT_COMPACT_TYPE_UPDATE      (0x01)
+#define SERIAL_EVT_COMPACT_TYPE_CONFLICTING (0x02)
+#define SERIAL_EVT_COMPACT_TYPE_TX          (0x03)
+#define SERIAL_EVT_COMPACT_TYPE_POS         (6)
+#define SERIAL_EVT_COMPACT_FLAG_NEXT_HANDLE (1 << 5) /**< The handle is the previous record's plus one, and is left out. */
+#define SERIAL_EVT_COMPACT_LEN_MASK         (0x1F)
+#define SERIAL_EVT_COMPACT_LEN_EXT          (0x1F)   /**< The data length is in the next byte. */
+#define SERIAL_EVT_COMPACT_MAX_LEN          (RBC_MESH_VALUE_MAX_LEN + 2) /**< Record bytes in a compact event, no longer than a full value event. */
+
+typedef __packed_armcc struct 
+{
+    uint8_t records[SERIAL_EVT_COMPACT_MAX_LEN]; /**< Value event records, see SERIAL_EVT_COMPACT_*. */
+} __packed_gcc serial_evt_params_event_compact_t;
+
+typedef __packed_armcc struct 
+{
+    uint16_t dropped_new;           /**< NEW events dropped since the last overflow event. */
+    uint16_t dropped_update;        /**< UPDATE events dropped since the last overflow event. */
+    uint16_t dropped_conflicting;   /**< CONFLICTING events dropped since the last overflow event. */
+    uint16_t dropped_tx;            /**< TX events dropped since the last overflow event. */
+    uint16_t coalesced_update;      /**< UPDATE events replaced by a newer update to the same handle. */
+} __packed_gcc serial_evt_params_event_overflow_t;
+
 typedef __packed_armcc struct 
 {
     operating_mode_t operating_mode;
@@ -152,11 +279,32 @@ typedef __packed_armcc struct
     uint8_t data_credit_available;
 } __packed_gcc serial_evt_params_event_device_started_t;
 
+#define SERIAL_EVT_SNIFFER_FLAG_CRC_OK  (1 << 0) /**< The packet passed its CRC check. */
+#define SERIAL_EVT_SNIFFER_OVERHEAD     (8)      /**< Sniffer event parameters ahead of the PDU. */
+#define SERIAL_EVT_SNIFFER_PDU_MAX_LEN  (39)     /**< Header, advertiser address and payload. */
+
+typedef __packed_armcc struct 
+{
+    uint32_t timestamp;     /**< Time of the packet's access address, in microseconds. */
+    int8_t rssi;            /**< RSSI in dBm. */
+    uint8_t flags;          /**< Bitfield of SERIAL_EVT_SNIFFER_FLAG_* values. */
+    uint8_t channel;        /**< BLE channel index the packet was received on. */
+    uint8_t lost;           /**< Packets lost since the previous sniffer event, because the capture queue was full. Saturates at 255. */
+    uint8_t pdu[SERIAL_EVT_SNIFFER_PDU_MAX_LEN]; /**< The PDU as it was on air, without the access address and the CRC. */
+} __packed_gcc serial_evt_params_event_sniffer_t;
+
 typedef __packed_armcc struct 
 {
     dfu_packet_t packet;
 } __packed_gcc serial_evt_params_dfu_t;
 
+typedef __packed_armcc struct 
+{
+    uint8_t next_seq;           /**< Sequence number of the first packet not yet accepted. */
+    uint8_t credit;             /**< Packets the host may send from next_seq on. */
+    aci_status_code_t status;   /**< ACI_STATUS_ERROR_BUSY or ACI_STATUS_ERROR_INVALID_DATA when the host should resend from next_seq, otherwise the status of the last accepted packet. */
+} __packed_gcc serial_evt_params_dfu_ack_t;
+
 typedef __packed_armcc struct 
 {
     uint8_t length;
@@ -169,8 +317,19 @@ typedef __packed_armcc struct
         serial_evt_params_event_update_t            event_update;
         serial_evt_params_event_conflicting_t       event_conflicting;
         serial_evt_params_event_tx_t                event_tx;
+        serial_evt_params_event_overflow_t          event_overflow;
+        serial_evt_params_event_snapshot_t          event_snapshot;
+        serial_evt_params_event_snapshot_end_t      event_snapshot_end;
+        serial_evt_params_event_compact_t           event_compact;
+        serial_evt_params_event_versioned_t         event_versioned;
+        serial_evt_params_event_history_t           event_history;
+        serial_evt_params_event_history_end_t       event_history_end;
         serial_evt_params_event_device_started_t    device_started;
+#ifdef RBC_MESH_SNIFFER
+        serial_evt_params_event_sniffer_t           event_sniffer;
+#endif
         serial_evt_params_dfu_t                     dfu;
+        serial_evt_params_dfu_ack_t                 dfu_ack;
 	} __packed_gcc params;
 } __packed_gcc serial_evt_t;
 
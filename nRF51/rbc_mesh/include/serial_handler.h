@@ -30,7 +30,36 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _SERIAL_HANDLER_H__
 #define _SERIAL_HANDLER_H__
 
+#ifndef SERIAL_DATA_MAX_LEN
+/** @brief Longest serial frame, excluding the length byte. Bounds the number
+ * of commands that fit in a batch command. Sniffer events carry a full
+ * advertisement PDU, and need a longer frame. Long packet builds grow the
+ * frame by the extra value length. */
+#if defined(RBC_MESH_LONG_PACKETS)
+#define SERIAL_DATA_MAX_LEN  ((RBC_MESH_VALUE_MAX_LEN + 13 > 48) ? (RBC_MESH_VALUE_MAX_LEN + 13) : 48)
+#elif defined(RBC_MESH_SNIFFER)
+#define SERIAL_DATA_MAX_LEN  (48)
+#else
 #define SERIAL_DATA_MAX_LEN  (36)
+#endif
+#endif
+
+/** @brief Define SERIAL_UART_FRAMED to protect the UART transport with CRC
+ * checked frames. Each frame is SLIP delimited, and carries a sequence
+ * number, the sequence number the sender expects next from its peer, and a
+ * CRC-16. Corrupt frames are dropped, and the receiver asks for the missing
+ * sequence numbers alone, so a bit error doesn't stall the link. The host
+ * needs to use the same framing. */
+#ifdef SERIAL_UART_FRAMED
+#ifndef SERIAL_UART_RETX_COUNT
+/** @brief Number of sent events the UART keeps for retransmission, must be a
+ * power of two. */
+#define SERIAL_UART_RETX_COUNT  (4)
+#endif
+#if (SERIAL_UART_RETX_COUNT & (SERIAL_UART_RETX_COUNT - 1)) || SERIAL_UART_RETX_COUNT > 32
+#error "SERIAL_UART_RETX_COUNT must be a power of two, up to 32"
+#endif
+#endif
 
 #include "serial_evt.h"
 #include "serial_command.h"
@@ -55,6 +84,22 @@ bool serial_handler_event_send(serial_evt_t* evt);
 
 bool serial_handler_command_get(serial_cmd_t* evt);
 
+/**
+* @brief Switch the serial line to a new baudrate. The switch happens once the
+*   TX queue has been emptied, so that a response queued right after this call
+*   still goes out at the old baudrate.
+*
+* @param[in] baudrate New baudrate in bits per second.
+*
+* @return NRF_SUCCESS The switch is pending.
+* @return NRF_ERROR_INVALID_PARAM The baudrate isn't supported.
+* @return NRF_ERROR_NOT_SUPPORTED The serial transport has no baudrate.
+*/
+uint32_t serial_handler_baudrate_set(uint32_t baudrate);
+
+/** @brief Get the RAM used by the serial queues and transfer buffers. */
+uint32_t serial_handler_ram_size_get(void);
+
 
 
 
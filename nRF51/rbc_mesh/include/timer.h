@@ -46,11 +46,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define TIMER_INDEX_TS_END      (0)
 /** Timer index for scheduler timing */
 #define TIMER_INDEX_SCHEDULER   (1)
-/** Timer index for radio timing */
+/** Timer index for radio timing, multiplexing the virtual timers */
 #define TIMER_INDEX_RADIO       (2)
 /** Timer index for getting timestamps */
 #define TIMER_INDEX_TIMESTAMP   (3)
 
+/** Number of virtual timers, see timer_virtual_order(). */
+#ifndef TIMER_VIRTUAL_COUNT
+#define TIMER_VIRTUAL_COUNT     (4)
+#endif
+/** Virtual timer index for the radio's listen before talk backoff */
+#define TIMER_VIRTUAL_RADIO_LBT (0)
+
 /** Get timestamp - ref, including rollover. */
 #define TIMER_DIFF(timestamp, reference) ((uint32_t)(timestamp-reference) > UINT32_MAX / 2 ? (uint32_t)(reference-timestamp) : (uint32_t)(timestamp-reference))
 
@@ -140,15 +147,70 @@ uint32_t timer_order_ppi(uint8_t timer,
  */
 uint32_t timer_abort(uint8_t timer);
 
+/**
+ * Order a virtual timer with callback. The virtual timers share the
+ * TIMER_INDEX_RADIO compare register, which is always set up for the
+ * earliest of them, so that radio related deadlines get callbacks straight
+ * from the TIMER0 interrupt, without going through the timer scheduler.
+ *
+ * @param[in] timer Virtual timer index, below TIMER_VIRTUAL_COUNT. Overrides any previous timeout on this index.
+ * @param[in] time Timestamp at which the callback should be called. Times
+ *  that have already passed fire as soon as possible.
+ * @param[in] callback Function pointer to the callback function called when the timer triggers.
+ * @param[in] attributes Timer attributes to apply to the timer event. May be used as a bitfield.
+ *
+ * @return NRF_SUCCESS The callback was successfully scheduled.
+ * @return NRF_ERROR_NULL The callback was NULL.
+ * @return NRF_ERROR_INVALID_FLAGS The supplied attributes were invalid.
+ * @return NRF_ERROR_INVALID_PARAM The timer parameter was outside the range of virtual timers.
+ */
+uint32_t timer_virtual_order(uint8_t timer,
+                             timestamp_t time,
+                             timer_callback_t callback,
+                             timer_attr_t attributes);
+
+/**
+ * Abort the virtual timer with given index.
+ *
+ * @param[in] timer Virtual timer index to abort.
+ *
+ * @return NRF_SUCCESS The timer was successfully aborted.
+ * @return NRF_ERROR_INVALID_PARAM The timer parameter was outside the range of virtual timers.
+ * @return NRF_ERROR_NOT_FOUND The given timer wasn't scheduled.
+ */
+uint32_t timer_virtual_abort(uint8_t timer);
+
 /**
 * Get current timestamp from HF timer. This timestamp is directly
 *   related to the time used to order timers, and may be used to order
-*   relative timers.
+*   relative timers. Outside the timeslots, this is the end of the previous
+*   timeslot, or the time extrapolated from RTC1 with TIMER_SCH_RTC.
 *
 * @return 32bit timestamp relative to global epoch.
 */
 timestamp_t timer_now(void);
 
+/**
+* Capture the time of the next occurrence of a hardware event through PPI,
+*   without the interrupt latency of a timestamp taken in software. The
+*   capture is only valid within the current timeslot, and replaces any
+*   previous capture.
+*
+* @param[in] p_event Event register to capture, e.g. &NRF_RADIO->EVENTS_ADDRESS.
+*            The event must be cleared before the call, and stay set once it
+*            has happened.
+*/
+void timer_event_capture_order(volatile uint32_t* p_event);
+
+/**
+* Get the time of the event ordered with timer_event_capture_order().
+*
+* @param[out] p_time Time of the event.
+*
+* @return Whether the event has happened since the capture was ordered.
+*/
+bool timer_event_capture_get(timestamp_t* p_time);
+
 /**
 * Initialize timer hardware. Must be called at the beginning of each
 *   SD granted timeslot. Flushes all timer slots.
@@ -167,4 +229,35 @@ void timer_on_ts_begin(timestamp_t timeslot_start_time);
 */
 void timer_on_ts_end(timestamp_t timeslot_end_time);
 
+#ifdef RBC_MESH_TIME_SYNC
+/**
+* Convert a local timestamp to mesh time, compensating for the estimated
+*   rate difference to the mesh time root.
+*
+* @param[in] local_time Local timestamp to convert.
+*
+* @return The mesh time at the given local time.
+*/
+timestamp_t timer_mesh_time_get(timestamp_t local_time);
+
+/**
+* Align the mesh time with a received reference. The rate difference to the
+*   reference is estimated from the error since the previous alignment.
+*
+* @param[in] local_time Local time the reference was valid at.
+* @param[in] mesh_time Reference mesh time.
+*
+* @return The error in the mesh time that was corrected, in microseconds.
+*/
+int32_t timer_mesh_time_sync(timestamp_t local_time, timestamp_t mesh_time);
+
+/**
+* Stop following the current reference. The mesh time continues from its
+*   current value, at the rate of the local clock.
+*
+* @param[in] local_time Current local time.
+*/
+void timer_mesh_time_reset(timestamp_t local_time);
+#endif
+
 #endif /* TIMER_H__ */
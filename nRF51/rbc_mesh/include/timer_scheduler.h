@@ -37,6 +37,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /**
  * @defgroup TIMER_SCHEDULER Asynchronous event scheduler.
  * Scalable event scheduling on the high frequency timer.
+ *
+ * The events are kept in a sorted linked list by default. Define
+ * TIMER_SCH_WHEEL to keep them in a hashed timing wheel instead, with
+ * constant time insertion, abort and reschedule. The wheel size and bucket
+ * width are set with TIMER_SCH_WHEEL_SIZE and TIMER_SCH_WHEEL_TICK_SHIFT.
+ *
+ * All timers that expire at the same time are dispatched from a single
+ * event, which calls their callbacks in order of expiry.
+ *
+ * The high frequency timer only runs inside the timeslots, so timers that
+ * expire between two timeslots fire at the start of the next one. Define
+ * TIMER_SCH_RTC to have the scheduler's timeouts between the timeslots set
+ * up on RTC1 instead, which keeps running while the CPU sleeps, and wakes
+ * it only when a timer is due. timer_now() is then extrapolated from RTC1
+ * between the timeslots, instead of returning the end of the previous one.
+ * RTC1 is also used by the SDK's app_timer, and the two can't be combined.
  * @{
  */
 
@@ -59,8 +75,21 @@ typedef struct timer_event
     timestamp_t         interval;  /**< Interval in us between each fire for periodic timers, or 0 if single-shot */
     void *              p_context; /**< Pointer to data passed on to the callback. */
     struct timer_event* p_next;    /**< Pointer to next event in linked list. Only for internal usage. */
+#ifdef TIMER_SCH_WHEEL
+    struct timer_event** pp_prev;  /**< Pointer to the link pointing to this event, or NULL if not scheduled. Only for internal usage. */
+#endif
 } timer_event_t;
 
+/**
+ * Timer scheduler statistics.
+ */
+typedef struct
+{
+    uint32_t fired;         /**< Number of timer callbacks that have been called. */
+    uint32_t deferred;      /**< Number of times expired timers had to be deferred, because the event queue was full. */
+    timestamp_t max_latency;/**< Longest time in us between a timer's timeout and its callback being called. */
+} timer_sch_stats_t;
+
 /**
  * Initialize the scheduler module.
  *
@@ -79,6 +108,9 @@ uint32_t timer_sch_init(void);
  *  @ref timer_sch_reschedule function. If any other changes are needed, abort the event, change the
  *  parameter, and schedule it again.
  *
+ * @note With the TIMER_SCH_WHEEL backend, the event structure must be zero
+ *  initialized before it is given to the scheduler for the first time.
+ *
  * @return NRF_SUCCESS The event has been scheduled successfully.
  * @return NRF_ERROR_NULL The given event is a NULL-pointer.
  * @return NRF_ERROR_NO_MEM The asynchronous bearer event scheduler has run out of space, and the action
@@ -111,6 +143,13 @@ uint32_t timer_sch_abort(timer_event_t* p_timer_evt);
  */
 uint32_t timer_sch_reschedule(timer_event_t* p_timer_evt, timestamp_t new_timestamp);
 
+/**
+ * Get the timer scheduler statistics.
+ *
+ * @param[out] p_stats Statistics structure to fill.
+ */
+void timer_sch_stats_get(timer_sch_stats_t* p_stats);
+
 /** @} */
 
 #endif /* TIMER_SCHEDULER_H__ */
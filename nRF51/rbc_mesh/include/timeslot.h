@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 
 #include "timer.h"
+#include "rbc_mesh.h"
 #include "nrf_sdm.h"
 
 /**
@@ -109,6 +110,58 @@ timestamp_t timeslot_remaining_time_get(void);
  */
 bool timeslot_is_in_ts(void);
 
+/**
+ * Get the time between the end timer and the end of the timeslot. A handler
+ * that runs longer than this while the end timer is due may keep the
+ * framework in the timeslot past its end.
+ *
+ * @return The end margin in microseconds.
+ */
+uint32_t timeslot_end_margin_get(void);
+
+/**
+ * Get the timeslot statistics.
+ *
+ * @param[out] p_stats Statistics structure to fill.
+ */
+void timeslot_stats_get(rbc_mesh_timeslot_stats_t* p_stats);
+
+/**
+ * Get the time spent in timeslots, including the ongoing one.
+ *
+ * @return Accumulated length of the timeslots in microseconds.
+ */
+uint64_t timeslot_total_time_get(void);
+
+/**
+ * Set the scan duty cycle. Takes effect when the current timeslot ends.
+ *
+ * @param[in] window_us Length of the duty-cycled timeslots.
+ * @param[in] interval_us Time between the start of two duty-cycled
+ *   timeslots, or 0 to scan continuously.
+ */
+void timeslot_scan_duty_cycle_set(uint32_t window_us, uint32_t interval_us);
+
+/**
+ * Set the interval of the active GATT connection. While connected, timeslots
+ *   and their extensions are kept short enough to fit between two connection
+ *   events, instead of being canceled by them.
+ *
+ * @param[in] interval_us Connection interval, or 0 when there's no
+ *   connection.
+ */
+void timeslot_conn_interval_set(uint32_t interval_us);
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+/**
+ * Set the latency mode cadence. Takes effect when the current timeslot ends.
+ *
+ * @param[in] period_us Time between the starts of the high priority
+ *   timeslots, or 0 to turn the latency mode off.
+ */
+void timeslot_latency_mode_set(uint32_t period_us);
+#endif
+
 /** @} */
 
 #endif /* TIMESLOT_H__ */
@@ -42,6 +42,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     #define _DISABLE_IRQS(_was_masked) _was_masked = __disable_irq()
     #define _ENABLE_IRQS(_was_masked) if (!_was_masked) { __enable_irq(); }
 
+#elif defined(__linux__)
+
+/* host builds of the core modules, for the tools in sim/ */
+    #define __packed_armcc
+    #define __packed_gcc __attribute__((packed))
+
+    #define _DISABLE_IRQS(_was_masked) _was_masked = __disable_irq()
+    #define _ENABLE_IRQS(_was_masked) if (!_was_masked) { __enable_irq(); }
+
 #elif defined(__GNUC__)
 
     #define __packed_armcc
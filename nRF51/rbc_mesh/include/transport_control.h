@@ -58,6 +58,12 @@ typedef struct
 } tc_tx_config_t;
 
 
+/** Returned by tc_instance_get() for handles in the primary mesh. */
+#define TC_INSTANCE_NONE    (0xFF)
+
+/** @brief Function pointer type for the TX ready callback, see tc_tx_ready_wait(). */
+typedef void (*tc_tx_ready_cb_t)(void);
+
 /** @brief Function pointer type for packet peek callback. */
 typedef void (*packet_peek_cb_t)(mesh_packet_t* p_packet,
                                  uint32_t crc,
@@ -78,13 +84,54 @@ void tc_on_ts_begin(void);
 * @params[in] p_packet Pointer to a BLE-packet to send.
 * @params[in] p_tx_config TX configuration for the transmission.
 *
+* @note If the framework is built with RBC_MESH_MULTICHANNEL, transmissions on a
+*   single channel ignore the first_channel parameter, and go out on the next
+*   advertisement channel in turn.
+*
 * @return NRF_SUCCESS The packets was scheduled for transmission on all indicated channels.
 * @return NRF_ERROR_NO_MEM One or more packets failed.
+* @return NRF_ERROR_BUSY The packet is a DFU packet, and was held back to
+*   leave the airtime to values. Only returned with RBC_MESH_DFU_QOS.
 */
 uint32_t tc_tx(mesh_packet_t* p_packet, const tc_tx_config_t* p_tx_config);
 
+/**
+* @brief Get the number of packets tc_tx() can take right now with the given
+*   configuration, as each channel in the map takes a radio queue slot. Only
+*   available with RBC_MESH_TX_BACKPRESSURE.
+*
+* @param[in] p_tx_config TX configuration for the transmissions.
+*
+* @return The number of packets that fit in the radio queue.
+*/
+uint32_t tc_tx_slots_get(const tc_tx_config_t* p_tx_config);
+
+/**
+* @brief Have the given callback called from the mesh context the next time
+*   a transmission leaves the radio queue. Only available with
+*   RBC_MESH_TX_BACKPRESSURE.
+*
+* @param[in] callback Function to call once, replaces any earlier one.
+*/
+void tc_tx_ready_wait(tc_tx_ready_cb_t callback);
+
 void tc_packet_handler(uint8_t* data, uint32_t crc, uint32_t timestamp, uint8_t rssi);
 
+/**
+* @brief Process received packets waiting in the RX queue. Called from the
+*   event handler after the radio has signaled new packets.
+*
+* @param[in] max_count Maximum number of packets to process.
+*
+* @return The number of packets processed.
+*/
+uint32_t tc_rx_queue_process(uint32_t max_count);
+
+/**
+* @brief Get the number of received packets waiting in the RX queue.
+*/
+uint32_t tc_rx_queue_length(void);
+
 /**
 * @brief Set packet peek function pointer. Every received packet will be
 *   passed to the peek function before being processed by the stack -
@@ -102,4 +149,111 @@ void tc_packet_handler(uint8_t* data, uint32_t crc, uint32_t timestamp, uint8_t
 */
 void tc_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb);
 
+/**
+* @brief Set the handle filter applied to received packets in the radio
+*   callback. See rbc_mesh_rx_filter_set() for the semantics. The parameters
+*   must have been validated by the caller.
+*
+* @param[in] mode Filter mode.
+* @param[in] p_ranges Array of handle ranges.
+* @param[in] range_count Number of ranges, at most RBC_MESH_RX_FILTER_RANGES_MAX.
+*/
+void tc_rx_filter_set(rbc_mesh_rx_filter_mode_t mode,
+        const rbc_mesh_handle_range_t* p_ranges,
+        uint8_t range_count);
+
+/**
+* @brief Add a mesh instance. The parameters are checked against the primary
+*   access address and the other instances, see rbc_mesh_instance_add().
+*
+* @param[in] access_address Access address of the instance.
+* @param[in] p_handles Handles that belong to the instance.
+*
+* @return NRF_SUCCESS The instance was added.
+* @return NRF_ERROR_INVALID_ADDR The address or the handle range can't be used.
+* @return NRF_ERROR_NO_MEM There are already RBC_MESH_INSTANCES_MAX instances.
+*/
+uint32_t tc_instance_add(uint32_t access_address, const rbc_mesh_handle_range_t* p_handles);
+
+/**
+* @brief Get the instance of the given handle, as the radio logical address
+*   it's sent on. Values with handles from different instances can't share a
+*   packet.
+*
+* @return The logical address, or TC_INSTANCE_NONE for the primary mesh.
+*/
+uint8_t tc_instance_get(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Fill in the RX and TX packet counters of the given statistics
+*   structure. Other fields are left untouched.
+*
+* @param[out] p_stats Statistics structure to fill.
+*/
+void tc_stats_get(rbc_mesh_stats_t* p_stats);
+
+/**
+* @brief Close the current channel quality period, and update the CRC failure
+*   rate of every channel with enough receptions in it. Only available with
+*   RBC_MESH_CHANNEL_QUALITY.
+*
+* @return Map of the channels in use with a failure rate at or above
+*   RBC_MESH_CHANNEL_BLACKLIST_PERCENT, with channel 37 in bit 0.
+*/
+uint8_t tc_channel_quality_update(void);
+
+/**
+* @brief Set the advertisement channels to scan and transmit on, with channel
+*   37 in bit 0. An empty map is ignored. Only available with
+*   RBC_MESH_CHANNEL_QUALITY.
+*/
+void tc_channel_map_set(uint8_t channel_map);
+
+/** @brief Get the advertisement channels in use. Only available with RBC_MESH_CHANNEL_QUALITY. */
+uint8_t tc_channel_map_get(void);
+
+/**
+* @brief Get the reception statistics of an advertisement channel. Only
+*   available with RBC_MESH_CHANNEL_QUALITY.
+*
+* @return NRF_SUCCESS The statistics were copied.
+* @return NRF_ERROR_INVALID_PARAM The channel isn't an advertisement channel.
+*/
+uint32_t tc_channel_stats_get(uint8_t channel, rbc_mesh_channel_stats_t* p_stats);
+
+/**
+* @brief Set the share of the airtime DFU packets may take while values are
+*   being sent. Only available with RBC_MESH_DFU_QOS.
+*
+* @param[in] percent Share in percent, from 1 to 100.
+*
+* @return NRF_SUCCESS The share was set.
+* @return NRF_ERROR_INVALID_PARAM The share is out of range.
+*/
+uint32_t tc_dfu_share_set(uint8_t percent);
+
+/**
+* @brief Start waiting for the transmissions of the next local update of the
+*   given handle, see rbc_mesh_value_set_notify(). Must be called right before
+*   the update is queued, and the version is taken in the mesh context once
+*   the updates queued before it are done. Only available with
+*   RBC_MESH_TX_NOTIFY.
+*
+* @param[in] handle Handle of the update.
+* @param[in] tx_count Number of transmissions to wait for, 0 counts as 1.
+* @param[in,out] p_future Future to set done after the transmissions.
+*
+* @return NRF_SUCCESS The future is pending.
+* @return NRF_ERROR_NO_MEM There are no free notification slots, or the
+*   event queue is full.
+*/
+uint32_t tc_tx_notify_add(rbc_mesh_value_handle_t handle, uint8_t tx_count, rbc_mesh_future_t* p_future);
+
+/**
+* @brief Stop waiting on a future added with tc_tx_notify_add(), after its
+*   update failed. The future isn't set done. Only available with
+*   RBC_MESH_TX_NOTIFY.
+*/
+void tc_tx_notify_cancel(rbc_mesh_future_t* p_future);
+
 #endif /* _TRANSPORT_CONTROL_H__ */
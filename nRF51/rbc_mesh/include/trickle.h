@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "nrf.h"
 #endif
 #include "toolchain.h"
+#include "rbc_mesh.h"
 #include <stdint.h>
 #include <stdbool.h>
 /**
@@ -43,8 +44,36 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *   http://tools.ietf.org/html/rfc6206
 */
 
+/** Maximum interval multiple of classes of static values, see
+  trickle_class_setup(). */
+#define TRICKLE_I_MAX_UNBOUNDED (0xFFFFFFFF)
+
+#ifdef RBC_MESH_COMPACT_TRICKLE
+#define TRICKLE_C_DISABLED  (0x07)
+#else
 #define TRICKLE_C_DISABLED  (0xFF)
+#endif
 
+#ifdef RBC_MESH_COMPACT_TRICKLE
+/**
+* @brief Compact trickle instance type. The times are kept as the lower 16 bits
+*   of the time in ticks of (1 << RBC_MESH_TRICKLE_TICK_SHIFT) us, which all
+*   instances share as their epoch. A time is taken as the one closest to the
+*   time it's read at, so an instance's times must be within half the tick
+*   range of the current time, which the interval cap ensures.
+*/
+typedef __packed_armcc struct
+{
+    uint16_t        t;              /* Ticks of t */
+    uint16_t        i;              /* Ticks of the end of the current interval */
+    uint8_t         i_exp : 5;      /* The interval is i_min doubled this many times, capped at i_max */
+    uint8_t         c : 3;          /* Consistent messages counter */
+    uint8_t         param_class;    /* Parameter class, see trickle_class_setup() */
+#ifdef RBC_MESH_HANDLE_STATS
+    uint16_t        reset_count;    /* Number of interval resets, saturates at 0xFFFF */
+#endif
+} __packed_gcc trickle_t;
+#else
 /**
 * @brief trickle instance type. Contains all values necessary for maintaining
 *   an isolated version of the algorithm
@@ -55,7 +84,12 @@ typedef __packed_armcc struct
     uint32_t        i;              /* Absolute value of i. Equals g_trickle_time (at set time) + i_relative */
     uint32_t        i_relative;     /* Relative value of i. Represents the actual i value in IETF RFC6206 */
     uint8_t         c;              /* Consistent messages counter */
+    uint8_t         param_class;    /* Parameter class, see trickle_class_setup() */
+#ifdef RBC_MESH_HANDLE_STATS
+    uint16_t        reset_count;    /* Number of interval resets, saturates at 0xFFFF */
+#endif
 } __packed_gcc trickle_t;
+#endif
 
 
 /** 
@@ -64,12 +98,45 @@ typedef __packed_armcc struct
 */
 void trickle_setup(uint32_t i_min, uint32_t i_max, uint8_t k);
 
+/**
+* @brief Set the parameters of a trickle class. Classes that aren't configured
+*   explicitly use the parameters given in trickle_setup().
+*
+* @param[in] param_class Class to configure, below RBC_MESH_TRICKLE_CLASS_COUNT.
+* @param[in] i_min Minimum interval in us.
+* @param[in] i_max Maximum interval, as a multiple of i_min, or
+*   TRICKLE_I_MAX_UNBOUNDED for the longest interval the timer can handle.
+*   Instances in unbounded classes are suppressed for the whole interval by
+*   trickle_rx_summary_consistent().
+* @param[in] k Redundancy constant.
+*
+* @return NRF_SUCCESS The class was configured.
+* @return NRF_ERROR_INVALID_PARAM One of the parameters was out of range.
+*/
+uint32_t trickle_class_setup(uint8_t param_class, uint32_t i_min, uint32_t i_max, uint8_t k);
+
+/**
+* @brief Move the given trickle instance to another parameter class. Restarts
+*   the instance's interval at the class' minimum interval.
+*/
+void trickle_class_set(trickle_t* trickle, uint8_t param_class, uint32_t time_now);
+
+/** @brief Get the parameter class of the given trickle instance. */
+uint8_t trickle_class_get(trickle_t* trickle);
+
 /**
 * @brief Register a consistent RX on the given trickle algorithm instance.
 *   Increments the instance's C value.
 */
 void trickle_rx_consistent(trickle_t* id, uint32_t time_now);
 
+/**
+* @brief Register a summary beacon matching our own on the given trickle
+*   algorithm instance. Counts as a consistent RX, and suppresses the rest of
+*   the interval for instances in unbounded classes.
+*/
+void trickle_rx_summary_consistent(trickle_t* id, uint32_t time_now);
+
 /**
 * @brief register an inconsistent RX on the given trickle algorithm instance.
 *   Resets interval time.
@@ -95,6 +162,36 @@ void trickle_tx_register(trickle_t* trickle, uint32_t time_now);
 */
 void trickle_tx_timeout(trickle_t* trickle, bool* out_do_tx, uint32_t time_now);
 
+/**
+* @brief Order the next TX of the given trickle instance at a random time
+*   within the given delay, regardless of the interval. The interval and
+*   consistency counter are left untouched.
+*
+* @param[in] trickle pointer to trickle algorithm instance object.
+* @param[in] time_now Earliest time of the TX.
+* @param[in] max_delay_us Upper bound of the random delay. 0 orders the TX
+*   at time_now.
+*/
+void trickle_tx_order(trickle_t* trickle, uint32_t time_now, uint32_t max_delay_us);
+
+#ifdef RBC_MESH_COMPACT_TRICKLE
+/**
+* @brief Get the time of the next TX of the given trickle instance. Only
+*   available with RBC_MESH_COMPACT_TRICKLE, the time is the t field otherwise.
+*
+* @param[in] trickle pointer to trickle algorithm instance object.
+* @param[in] time_ref The current time, the TX time is taken as the one
+*   closest to it.
+*/
+uint32_t trickle_tx_time_get(const trickle_t* trickle, uint32_t time_ref);
+
+/**
+* @brief Check whether the next TX of one trickle instance is due before the
+*   next TX of another. Only available with RBC_MESH_COMPACT_TRICKLE.
+*/
+bool trickle_tx_is_earlier(const trickle_t* trickle, const trickle_t* ref);
+#endif
+
 /**
 * @brief Disable the given trickle instance. It will always report that it is 
 *   not to perform a transmit when checked.
@@ -112,4 +209,29 @@ void trickle_enable(trickle_t* trickle);
 */
 bool trickle_is_enabled(trickle_t* trickle);
 
+/**
+* @brief return the number of trickle interval resets since boot, across all
+*   trickle instances.
+*/
+uint32_t trickle_reset_count_get(void);
+
+/**
+* @brief Get the number of consistent and inconsistent receptions since boot,
+*   across all trickle instances.
+*/
+void trickle_rx_count_get(uint32_t* p_consistent, uint32_t* p_inconsistent);
+
+/**
+* @brief Adjust the parameters of the classes that haven't been explicitly
+*   configured with trickle_class_setup(). The new parameters take effect
+*   as the instances start their next interval.
+*
+* @param[in] active Whether to adjust the parameters. The configured
+*   parameters are used as they are when false.
+* @param[in] k Redundancy constant to use instead of the configured one.
+* @param[in] i_max_shift The configured maximum interval is doubled this
+*   many times, or halved if negative, to at least i_min.
+*/
+void trickle_tune_set(bool active, uint8_t k, int8_t i_max_shift);
+
 #endif /* _TRICKLE_H__ */
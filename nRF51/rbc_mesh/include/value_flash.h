@@ -0,0 +1,93 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef VALUE_FLASH_H__
+#define VALUE_FLASH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup VALUE_FLASH Persistent value storage
+ * Keeps the values of the persistent handles in flash when
+ * RBC_MESH_PERSISTENT_STORAGE is defined. The values are appended as records
+ * to a log in one of RBC_MESH_PERSISTENT_FLASH_PAGES flash pages at
+ * RBC_MESH_PERSISTENT_FLASH_ADDR, the last record of a handle being the
+ * current one. An update costs a few words of flash writes. The next page in
+ * the ring is erased while the flash is idle, and once the appends have used
+ * up most of the active page, the current persistent values are copied over
+ * from the handle cache, before the next page is marked active.
+ * All flash operations go through the mesh_flash module.
+ * @{
+ */
+
+/**
+ * Initialize the persistent storage, and restore the values of the active
+ *   flash page to the handle cache, as persistent handles. Must be called
+ *   after the handle storage has been initialized.
+ *
+ * @return NRF_SUCCESS The storage was initialized.
+ * @return NRF_ERROR_INVALID_ADDR RBC_MESH_PERSISTENT_FLASH_ADDR isn't page aligned.
+ */
+uint32_t value_flash_init(void);
+
+/**
+ * Store a new value for a persistent handle. The value is written to flash
+ *   asynchronously.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[in] version Version of the value.
+ * @param[in] p_data Value payload.
+ * @param[in] length Length of the payload, at most RBC_MESH_VALUE_MAX_LEN.
+ */
+void value_flash_store(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length);
+
+/**
+ * Remove the stored value of a handle that is no longer persistent.
+ *
+ * @param[in] handle Handle of the value.
+ */
+void value_flash_remove(uint16_t handle);
+
+/**
+ * Get whether the persistent values are being copied to a new page. The copy
+ *   walks the handle cache between flash operations.
+ */
+bool value_flash_is_compacting(void);
+
+/**
+ * Get the number of persistent values that were left out of the flash log
+ *   because they didn't fit a page, since value_flash_init().
+ */
+uint32_t value_flash_drop_count_get(void);
+
+/** @} */
+
+#endif /* VALUE_FLASH_H__ */
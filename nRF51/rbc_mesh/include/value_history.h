@@ -0,0 +1,87 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef VALUE_HISTORY_H__
+#define VALUE_HISTORY_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup VALUE_HISTORY Value history
+ * Keeps the last RBC_MESH_VALUE_HISTORY_DEPTH versions of selected values in
+ * a ring per handle, apart from the data cache, when RBC_MESH_VALUE_HISTORY
+ * is defined. A host that lost its connection can fetch the versions it
+ * missed, instead of only the current one. A won conflict replaces the
+ * contents of the version it won over.
+ * @{
+ */
+
+/** Remove all histories. */
+void value_history_init(void);
+
+/**
+ * Start a history for the given handle.
+ *
+ * @param[in] handle Handle to keep the history of.
+ *
+ * @return NRF_SUCCESS The handle has a history, or already had.
+ * @return NRF_ERROR_NO_MEM All RBC_MESH_VALUE_HISTORY_HANDLES_MAX histories are in use.
+ */
+uint32_t value_history_enable(rbc_mesh_value_handle_t handle);
+
+/**
+ * Add a version to the history of its handle, if it has one. Called by the
+ * handle storage for every value it stores, in event handler context. A
+ * value stored again as it was is left out.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[in] version Version of the value.
+ * @param[in] p_data Value contents.
+ * @param[in] length Length of the value contents.
+ * @param[in] timestamp Time the version was stored.
+ */
+void value_history_put(rbc_mesh_value_handle_t handle, uint16_t version, const uint8_t* p_data, uint8_t length, uint32_t timestamp);
+
+/**
+ * Get the oldest version in a history that is newer than the given one.
+ *
+ * @param[in] handle Handle of the history.
+ * @param[in] after_version Version to get the next one of.
+ * @param[out] p_entry The next version.
+ *
+ * @return NRF_SUCCESS The entry was copied to p_entry.
+ * @return NRF_ERROR_INVALID_ADDR The handle has no history.
+ * @return NRF_ERROR_NOT_FOUND The history has no newer version.
+ */
+uint32_t value_history_get(rbc_mesh_value_handle_t handle, uint16_t after_version, rbc_mesh_history_entry_t* p_entry);
+
+/** @} */
+
+#endif /* VALUE_HISTORY_H__ */
@@ -0,0 +1,82 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef VALUE_RETAIN_H__
+#define VALUE_RETAIN_H__
+
+#include <stdint.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup VALUE_RETAIN Retained value copy
+ * Keeps a copy of the cached values and their versions in a RAM area that
+ * survives soft resets, when RBC_MESH_RETAINED_RAM is defined. The area at
+ * RBC_MESH_RETAINED_RAM_ADDR starts with a header with a CRC over the area
+ * layout, followed by fixed size slots with a CRC each, which the handle
+ * storage updates in place with every new value. A slot that was torn by
+ * the reset fails its CRC and is skipped, the value is relearned from the
+ * neighbors like any other.
+ * @{
+ */
+
+/**
+ * Restore the values of a valid retained area to the handle cache, and start
+ *   the area over with the current contents of the handle cache. Must be
+ *   called after the handle storage has been initialized, and after the
+ *   persistent values have been restored, as the retained values are at
+ *   least as new.
+ *
+ * @return NRF_SUCCESS The area was initialized.
+ * @return NRF_ERROR_INVALID_ADDR RBC_MESH_RETAINED_RAM_ADDR isn't word aligned.
+ */
+uint32_t value_retain_init(void);
+
+/**
+ * Copy a new value to the retained area. MUST BE CALLED FROM EVENT HANDLER
+ *   CONTEXT, or in an event handler critical section.
+ *
+ * @param[in] handle Handle of the value.
+ * @param[in] version Version of the value.
+ * @param[in] p_data Value payload.
+ * @param[in] length Length of the payload. Values longer than
+ *   RBC_MESH_RETAINED_VALUE_MAX_LEN aren't retained.
+ */
+void value_retain_store(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length);
+
+/**
+ * Remove the retained copy of a value that has left the handle cache. Same
+ *   context rules as value_retain_store().
+ *
+ * @param[in] handle Handle of the value.
+ */
+void value_retain_remove(uint16_t handle);
+
+/** @} */
+
+#endif /* VALUE_RETAIN_H__ */
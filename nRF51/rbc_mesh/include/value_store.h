@@ -0,0 +1,100 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef VALUE_STORE_H__
+#define VALUE_STORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbc_mesh.h"
+
+/**
+ * @defgroup VALUE_STORE Compact value store
+ * Keeps the payload bytes of the cached values when RBC_MESH_COMPACT_VALUE_STORE
+ * is defined, so that the data cache doesn't need a full packet per value. The
+ * store is split in pages of VALUE_STORE_PAGE_SIZE bytes. Each page is handed
+ * to one slab class when that class runs out of slots, and given back once all
+ * its slots are freed. Values are referred to by a 16 bit reference, holding
+ * the page index and the slot within the page.
+ * @{
+ */
+
+/** Size of a value store page. Divisible by all slab class slot sizes. */
+#define VALUE_STORE_PAGE_SIZE           (96)
+/** Number of slab classes, see value_store.c for the slot sizes. */
+#define VALUE_STORE_SLAB_CLASSES        (4)
+/** Highest number of pages, limited by the page index in the references. */
+#define VALUE_STORE_PAGES_MAX           (0x07FE)
+/** Reference for values without payload bytes, never points to a slot. */
+#define VALUE_STORE_REF_NONE            (0xFFFF)
+
+/** Number of pages for a data cache of the given size. Reserves
+  RBC_MESH_VALUE_STORE_BYTES_PER_ENTRY bytes per entry, and one page for each
+  slab class to cover the partially filled pages. */
+#define VALUE_STORE_PAGE_COUNT(data_cache_entries) \
+    ((((uint32_t) (data_cache_entries) * RBC_MESH_VALUE_STORE_BYTES_PER_ENTRY + VALUE_STORE_PAGE_SIZE - 1) / VALUE_STORE_PAGE_SIZE) + \
+     VALUE_STORE_SLAB_CLASSES)
+
+/** Get the size of the memory needed for a value store of the given number of pages. */
+uint32_t value_store_memory_size_get(uint16_t page_count);
+
+/**
+ * Initialize the value store with the given memory of
+ *   value_store_memory_size_get() bytes. Uses the built-in store for
+ *   RBC_MESH_DATA_CACHE_ENTRIES values if p_memory is NULL.
+ *
+ * @param[in] p_memory Word aligned memory for the store, or NULL.
+ * @param[in] page_count Number of pages in p_memory, ignored if p_memory is NULL.
+ *
+ * @return NRF_SUCCESS The store was initialized.
+ * @return NRF_ERROR_NULL p_memory is NULL and RBC_MESH_EXTERNAL_MEMORY is defined.
+ * @return NRF_ERROR_INVALID_PARAM The page count is 0 or above VALUE_STORE_PAGES_MAX.
+ */
+uint32_t value_store_init(void* p_memory, uint16_t page_count);
+
+/**
+ * Allocate a slot for a value of the given length.
+ *
+ * @param[in] length Length of the value in bytes, at most RBC_MESH_VALUE_MAX_LEN.
+ * @param[out] p_ref Reference to the allocated slot. Set to
+ *   VALUE_STORE_REF_NONE for zero length values.
+ *
+ * @return Whether there was room for the value.
+ */
+bool value_store_alloc(uint8_t length, uint16_t* p_ref);
+
+/** Free a slot allocated with value_store_alloc(). Does nothing for VALUE_STORE_REF_NONE. */
+void value_store_free(uint16_t ref);
+
+/** Get a pointer to the bytes of the slot behind the given reference. */
+uint8_t* value_store_data_get(uint16_t ref);
+
+/** @} */
+
+#endif /* VALUE_STORE_H__ */
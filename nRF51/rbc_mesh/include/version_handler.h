@@ -33,33 +33,132 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rbc_mesh.h"
 #include "ble_gap.h"
 #include "mesh_packet.h"
+#include "handle_storage.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+/** @brief: Get the difference between two version numbers, taking the lollipop counter into account. */
+int16_t version_delta(uint16_t old_version, uint16_t new_version);
+
 uint32_t vh_init(uint32_t min_interval_us,
                  uint32_t access_address,
                  uint8_t channel,
-                 rbc_mesh_txpower_t tx_power);
+                 rbc_mesh_txpower_t tx_power,
+                 const handle_storage_memory_t* p_cache_memory);
+
+/** @brief: Handle a received delta update packet. Only available with RBC_MESH_DELTA_UPDATES. */
+uint32_t vh_delta_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi);
+
+/** @brief: Handle a received coded packet. Only available with RBC_MESH_NETWORK_CODING. */
+uint32_t vh_netcode_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi);
+
+/** @brief: Copy the coded packet counters to the stats. Only available with RBC_MESH_NETWORK_CODING. */
+void vh_netcode_stats_get(rbc_mesh_stats_t* p_stats);
+
+/** @brief: Handle a received summary beacon. Only available with RBC_MESH_SUMMARY_BEACON. */
+uint32_t vh_summary_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @brief: Handle a received version page. Only available with RBC_MESH_VERSION_REPAIR. */
+uint32_t vh_repair_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @brief: Handle a received bootstrap message. Only available with RBC_MESH_BOOTSTRAP. */
+uint32_t vh_bootstrap_rx(mesh_packet_t* p_packet, uint32_t timestamp);
+
+/** @brief: Note a neighbor heard by its summary beacon, as a candidate to
+  bootstrap from. Only available with RBC_MESH_BOOTSTRAP. */
+void vh_bootstrap_neighbor_rx(const uint8_t* p_addr, uint8_t rssi);
+
+/** @brief: Handle a received time sync beacon. Only available with RBC_MESH_TIME_SYNC. */
+uint32_t vh_time_sync_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @brief: Get the current mesh time. Only available with RBC_MESH_TIME_SYNC. */
+void vh_time_get(rbc_mesh_time_t* p_time);
+
+/** @brief: Handle a received channel map beacon. Only available with RBC_MESH_CHANNEL_QUALITY. */
+uint32_t vh_channel_map_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @brief: Get the propagation delay histogram. Only available with RBC_MESH_ORIGIN_TIME. */
+void vh_propagation_stats_get(rbc_mesh_propagation_stats_t* p_stats, bool reset);
+
+/** @brief: Get the number of new versions that took longer than
+  RBC_MESH_HEALTH_LATENCY_SLO_MS to get here. Only available with
+  RBC_MESH_ORIGIN_TIME and RBC_MESH_HEALTH_MONITOR. */
+uint32_t vh_propagation_late_count_get(void);
+
+/** @brief: Handle a received latency probe. Only available with RBC_MESH_LATENCY_PROBE. */
+uint32_t vh_probe_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp);
+
+/** @brief: Send a latency probe. Only available with RBC_MESH_LATENCY_PROBE. */
+uint32_t vh_probe_send(uint16_t target, uint8_t* p_seq);
 
 uint32_t vh_min_interval_set(uint32_t min_interval_us);
 
+/** @brief: Move the radio and the value transmissions to a new access address and channel. */
+void vh_radio_params_set(uint32_t access_address, uint8_t channel);
+
 void vh_tx_power_set(rbc_mesh_txpower_t tx_power);
 
-uint32_t vh_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi);
+rbc_mesh_txpower_t vh_tx_power_get(void);
+
+/** @brief: Handle a received packet. The CRC is used to recognize packets
+  identical to a recent one, see RBC_MESH_RX_DUPLICATE_CACHE_SIZE. */
+uint32_t vh_rx(mesh_packet_t* p_packet, uint32_t crc, uint32_t timestamp, uint8_t rssi);
+
+/** @brief: Get the number of received packets short-circuited as duplicates. */
+uint32_t vh_rx_duplicate_count_get(void);
+
+/** @brief: Set the tie-breaker for same-version conflicts, NULL for the
+  built-in order. See RBC_MESH_CONFLICT_RESOLUTION. */
+uint32_t vh_conflict_resolver_set(rbc_mesh_conflict_resolver_t resolver);
+
+/** @brief: Set or remove the hook for new versions of a handle. See RBC_MESH_RX_HOOKS. */
+uint32_t vh_rx_hook_set(rbc_mesh_value_handle_t handle, rbc_mesh_rx_hook_t hook);
+
+/** @brief: Copy the value hook counters to the stats. Only available with RBC_MESH_RX_HOOKS. */
+void vh_rx_hook_stats_get(rbc_mesh_stats_t* p_stats);
 
 uint32_t vh_local_update(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length);
 
+/** @brief: Update several local values, with a single transmit order for all of them. */
+uint32_t vh_local_update_batch(const rbc_mesh_value_handle_t* p_handles, uint8_t* const* pp_data, const uint16_t* p_lengths, uint32_t count);
+
 uint32_t vh_on_timeslot_begin(void);
 
 uint32_t vh_order_update(uint32_t time_now);
 
+/** @brief: Get the time of the next scheduled Trickle transmission, if any. */
+bool vh_next_tx_time_get(uint32_t* p_time);
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+/** @brief: Get the time of the next scheduled Trickle transmission of an urgent handle, if any. */
+bool vh_urgent_tx_time_get(uint32_t* p_time);
+#endif
+
 /** @brief: Make copy of payload for given handle. */
 uint32_t vh_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* length);
 
+/**
+* @brief: Make copy of the next stored value. Set the iterator to 0 to get the
+*   first value. Returns NRF_ERROR_NOT_FOUND when there are no more values.
+*/
+uint32_t vh_value_next_get(uint32_t* p_iterator,
+        rbc_mesh_value_handle_t* p_handle,
+        uint16_t* p_version,
+        uint8_t* data,
+        uint16_t* length);
+
 uint32_t vh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event);
 
 uint32_t vh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* is_doing_tx_event);
 
+uint32_t vh_urgent_flag_set(rbc_mesh_value_handle_t handle, bool urgent);
+
+uint32_t vh_urgent_flag_get(rbc_mesh_value_handle_t handle, bool* p_urgent);
+
+uint32_t vh_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context);
+
+uint32_t vh_cache_compact(void);
+
 uint32_t vh_value_enable(rbc_mesh_value_handle_t handle);
 
 uint32_t vh_value_disable(rbc_mesh_value_handle_t handle);
@@ -70,5 +169,21 @@ uint32_t vh_value_persistence_set(rbc_mesh_value_handle_t handle, bool persisten
 
 uint32_t vh_value_persistence_get(rbc_mesh_value_handle_t handle, bool* p_persistent);
 
+/** @brief: Configure a Trickle parameter class. i_max is a multiple of i_min. */
+uint32_t vh_trickle_class_config(uint8_t trickle_class, uint32_t i_min_us, uint32_t i_max, uint8_t k);
+
+uint32_t vh_trickle_class_set(rbc_mesh_value_handle_t handle, uint8_t trickle_class);
+
+uint32_t vh_trickle_class_get(rbc_mesh_value_handle_t handle, uint8_t* p_trickle_class);
+
+uint32_t vh_handle_stats_get(rbc_mesh_value_handle_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset);
+
+/** @brief: Set the time-to-live of a value in RBC_MESH_VALUE_TTL_TICK_MS ticks, 0 for none. */
+uint32_t vh_value_ttl_set(rbc_mesh_value_handle_t handle, uint16_t ttl_ticks);
+
+uint32_t vh_write_combine_set(rbc_mesh_value_handle_t handle, uint16_t window_ms);
+
+uint32_t vh_hop_scope_set(rbc_mesh_value_handle_t handle, uint8_t hops);
+
 #endif /* _VERSION_HANDLER_H__ */
 
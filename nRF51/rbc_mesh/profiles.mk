@@ -0,0 +1,42 @@
+#------------------------------------------------------------------------------
+# Framework build profiles
+#
+# Set RBC_MESH_PROFILE to pick the framework subsystems for a kind of node in
+# one go, instead of setting the USE_* options one by one:
+#
+#   minimal_relay  Relays the mesh and nothing else. No mesh GATT service,
+#                  serial interface or DFU, and a short app event queue, as
+#                  relay-only nodes don't queue app events.
+#   sensor_leaf    Sets and reads its own values. No mesh GATT service,
+#                  serial interface or DFU.
+#   gateway        Gives phones and a host access to the mesh, through the
+#                  mesh GATT service and the serial interface.
+#   dfu_relay      Relays the mesh and DFU transfers. No mesh GATT service or
+#                  serial interface.
+#
+# Include this file before the USE_* defaults of the makefile. USE_* options
+# given on the command line or in the environment still win over the profile.
+# examples/profile_sizes.sh builds every profile and prints its footprint.
+#------------------------------------------------------------------------------
+
+ifeq ($(RBC_MESH_PROFILE),)
+else ifeq ($(RBC_MESH_PROFILE), minimal_relay)
+	USE_GATT             ?= "no"
+	USE_RBC_MESH_SERIAL  ?= "no"
+	USE_DFU              ?= "no"
+	CFLAGS += -D RBC_MESH_APP_EVENT_QUEUE_LENGTH=2
+else ifeq ($(RBC_MESH_PROFILE), sensor_leaf)
+	USE_GATT             ?= "no"
+	USE_RBC_MESH_SERIAL  ?= "no"
+	USE_DFU              ?= "no"
+else ifeq ($(RBC_MESH_PROFILE), gateway)
+	USE_GATT             ?= "yes"
+	USE_RBC_MESH_SERIAL  ?= "yes"
+	USE_DFU              ?= "no"
+else ifeq ($(RBC_MESH_PROFILE), dfu_relay)
+	USE_GATT             ?= "no"
+	USE_RBC_MESH_SERIAL  ?= "no"
+	USE_DFU              ?= "yes"
+else
+$(error Unknown RBC_MESH_PROFILE $(RBC_MESH_PROFILE), use minimal_relay, sensor_leaf, gateway or dfu_relay)
+endif
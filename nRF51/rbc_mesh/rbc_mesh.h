@@ -44,9 +44,96 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define RBC_MESH_ACCESS_ADDRESS_BLE_ADV             (0x8E89BED6) /**< BLE spec defined access address. */
 #define RBC_MESH_INTERVAL_MIN_MIN_MS                (5) /**< Lowest min-interval allowed. */
 #define RBC_MESH_INTERVAL_MIN_MAX_MS                (60000) /**< Highest min-interval allowed. */
-#define RBC_MESH_VALUE_MAX_LEN                      (23) /**< Longest legal payload. */
+#define RBC_MESH_INTERVAL_MAX_UNBOUNDED             (0xFFFFFFFF) /**< Max-interval of Trickle classes for static values, see rbc_mesh_trickle_class_config(). */
+
+/** @brief Define RBC_MESH_HOP_SCOPES to let values be limited to a number of
+  hops from the node that updated them, see rbc_mesh_hop_scope_set(). Every
+  mesh packet carries the number of hops its value may still travel, which
+  takes a byte from the value payload. Changes the packet format, all nodes in
+  the mesh must be built with the same setting. */
+#ifdef RBC_MESH_HOP_SCOPES
+    /** @brief Hop scope of values that haven't been given one. Values with this
+      scope are relayed by every node, like without RBC_MESH_HOP_SCOPES. */
+    #define RBC_MESH_HOP_SCOPE_UNLIMITED            (0xFF)
+    /** @brief Bytes added to each mesh AD structure by the hop count. */
+    #define RBC_MESH_HOP_SCOPE_OVERHEAD             (1)
+#else
+    #define RBC_MESH_HOP_SCOPE_OVERHEAD             (0)
+#endif
+
+/** @brief Define RBC_MESH_ORIGIN_TIME to stamp every local value version with
+  the mesh time it was set at, so that the nodes it reaches can tell how long
+  it took, see rbc_mesh_propagation_stats_get(). The stamp takes two bytes
+  from the value payload, and counts RBC_MESH_ORIGIN_TIME_UNIT_US units, so
+  delays of more than 33 seconds can't be told from clock differences. Changes the packet format, all
+  nodes in the mesh must be built with the same setting. Requires
+  RBC_MESH_TIME_SYNC. */
+#ifdef RBC_MESH_ORIGIN_TIME
+    #ifndef RBC_MESH_TIME_SYNC
+        #error "RBC_MESH_ORIGIN_TIME requires RBC_MESH_TIME_SYNC"
+    #endif
+    /** @brief Bytes added to each mesh AD structure by the origin time. */
+    #define RBC_MESH_ORIGIN_TIME_OVERHEAD           (2)
+    /** @brief Resolution of the origin time, in microseconds. A power of two,
+      so that the stamp wraps with the 32 bit mesh time. */
+    #define RBC_MESH_ORIGIN_TIME_UNIT_US            (1024)
+    /** @brief Origin time of versions that weren't stamped at their origin,
+      like segments and values restored from flash. */
+    #define RBC_MESH_ORIGIN_TIME_NONE               (0xFFFF)
+    /** @brief Upper limit of the first propagation histogram bucket, in
+      milliseconds. Each of the following buckets is twice as wide as the one
+      before. */
+    #ifndef RBC_MESH_PROPAGATION_HIST_FIRST_MS
+        #define RBC_MESH_PROPAGATION_HIST_FIRST_MS  (16)
+    #endif
+#else
+    #define RBC_MESH_ORIGIN_TIME_OVERHEAD           (0)
+#endif
+
+#ifdef RBC_MESH_ENCRYPTION
+#define RBC_MESH_LEGACY_VALUE_MAX_LEN               (15 - RBC_MESH_HOP_SCOPE_OVERHEAD - RBC_MESH_ORIGIN_TIME_OVERHEAD) /**< Longest payload of a legacy length packet, shortened by the sequence number and MIC of the encryption. */
+#else
+#define RBC_MESH_LEGACY_VALUE_MAX_LEN               (23 - RBC_MESH_HOP_SCOPE_OVERHEAD - RBC_MESH_ORIGIN_TIME_OVERHEAD) /**< Longest payload of a legacy length packet. */
+#endif
+
+/** @brief Define RBC_MESH_LONG_PACKETS to let mesh packets exceed the 37
+  byte limit of BLE advertisements, for values of up to
+  RBC_MESH_LONG_VALUE_MAX_LEN bytes. nRF52 only. Nodes built without it can't
+  receive the longer packets, see @ref rbc_mesh_long_packets_set() for meshes
+  that mix the two. Every packet in the pool is sized for the longest value,
+  so the packet pool takes up correspondingly more RAM. The framework's own
+  messages keep their legacy length. */
+#ifdef RBC_MESH_LONG_PACKETS
+    #ifndef RBC_MESH_LONG_VALUE_MAX_LEN
+        #define RBC_MESH_LONG_VALUE_MAX_LEN         (100)
+    #endif
+    #if !defined(NRF52)
+        #error "RBC_MESH_LONG_PACKETS requires an nRF52"
+    #endif
+    #ifdef RBC_MESH_ENCRYPTION
+        #error "RBC_MESH_LONG_PACKETS can't be combined with RBC_MESH_ENCRYPTION"
+    #endif
+    #if (RBC_MESH_LONG_VALUE_MAX_LEN <= RBC_MESH_LEGACY_VALUE_MAX_LEN) || (RBC_MESH_LONG_VALUE_MAX_LEN > 241 - RBC_MESH_HOP_SCOPE_OVERHEAD - RBC_MESH_ORIGIN_TIME_OVERHEAD)
+        #error "RBC_MESH_LONG_VALUE_MAX_LEN must be longer than the legacy payload, and at most 241, less the hop scope and origin time overheads"
+    #endif
+#define RBC_MESH_VALUE_MAX_LEN                      (RBC_MESH_LONG_VALUE_MAX_LEN) /**< Longest legal payload. */
+#else
+#define RBC_MESH_VALUE_MAX_LEN                      (RBC_MESH_LEGACY_VALUE_MAX_LEN) /**< Longest legal payload. */
+#endif
 #define RBC_MESH_INVALID_HANDLE                     (0xFFFF) /**< Designated "invalid" handle, may never be used */
+#if defined(RBC_MESH_BOOTSTRAP) || defined(RBC_MESH_NETWORK_CODING) || defined(RBC_MESH_CONFIG_PUSH)
+/* the handles above 0xFFEF are all taken, these features use the 16 below them */
+#define RBC_MESH_APP_MAX_HANDLE                     (0xFFDF) /**< Upper limit to application defined handles. The last 32 handles are reserved for mesh-maintenance. */
+#else
 #define RBC_MESH_APP_MAX_HANDLE                     (0xFFEF) /**< Upper limit to application defined handles. The last 16 handles are reserved for mesh-maintenance. */
+#endif
+#define RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN            (RBC_MESH_LEGACY_VALUE_MAX_LEN - 1) /**< Payload in each segment of a segmented value, after the segment header. */
+#define RBC_MESH_SEGMENT_COUNT_MAX                  (12) /**< Highest number of segments in a segmented value. */
+#if defined(RBC_MESH_ENCRYPTION) || defined(RBC_MESH_HOP_SCOPES) || defined(RBC_MESH_ORIGIN_TIME)
+#define RBC_MESH_SEGMENTED_VALUE_MAX_LEN            (RBC_MESH_SEGMENT_COUNT_MAX * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN) /**< Longest legal segmented value payload. */
+#else
+#define RBC_MESH_SEGMENTED_VALUE_MAX_LEN            (255) /**< Longest legal segmented value payload. */
+#endif
 
 #define RBC_MESH_GPREGRET_CODE_GO_TO_APP            (0x00) /**< Retention register code for immediately starting application when entering bootloader. The default behavior. */
 #define RBC_MESH_GPREGRET_CODE_FORCED_REBOOT        (0x01) /**< Retention register code for telling the bootloader it's been started on purpose */
@@ -58,33 +145,167 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
    If a handle falls out of the data cache, the device will stop broadcasting it.
    If a handle falls out of the handle cache, the device will not know whether updates
    to the handle are new or old.
+   The caches, the app event queue and the packet pool are sized by the defines
+   below, unless the application supplies its own memory for them in
+   rbc_mesh_init_params_t::p_memory. The sizes are then set at runtime.
 */
 
+/** @brief Define RBC_MESH_EXTERNAL_MEMORY to leave out the built-in caches,
+  app event queue and packet pool. The application must then supply the memory
+  for them in rbc_mesh_init_params_t::p_memory. */
+
+/** @brief Define RBC_MESH_STATIC_HANDLES to the name of a header listing a
+  fixed set of value handles, for builds that never use any other handles.
+  The header must define RBC_MESH_STATIC_HANDLE_LIST(X), which calls
+  X(handle, max_length) once for each handle, e.g.
+
+  #define RBC_MESH_STATIC_HANDLE_LIST(X) \
+      X(0x0001, 4) \
+      X(0x0002, 23)
+
+  Each handle then has its own handle and data cache entry, looked up with a
+  switch on the handle, and the LRU handle cache, handle index and data entry
+  eviction are left out. The cache sizes follow from the list. Values for
+  handles that aren't in the list are rejected with NRF_ERROR_NO_MEM, and
+  values longer than the handle's max_length with NRF_ERROR_INVALID_LENGTH. */
+#ifdef RBC_MESH_STATIC_HANDLES
+    #include RBC_MESH_STATIC_HANDLES
+    #ifndef RBC_MESH_STATIC_HANDLE_LIST
+        #error "The RBC_MESH_STATIC_HANDLES header must define RBC_MESH_STATIC_HANDLE_LIST"
+    #endif
+    #if defined(RBC_MESH_HANDLE_CACHE_ENTRIES) || defined(RBC_MESH_DATA_CACHE_ENTRIES)
+        #error "The cache sizes are set by the static handle list"
+    #endif
+    #ifdef RBC_MESH_EXTERNAL_MEMORY
+        #error "RBC_MESH_STATIC_HANDLES can't be combined with RBC_MESH_EXTERNAL_MEMORY"
+    #endif
+    #define RBC_MESH_STATIC_HANDLE_COUNT_ONE(handle, max_length) + 1
+    /** @brief Number of handles in the static handle list. */
+    #define RBC_MESH_STATIC_HANDLE_COUNT            (0 RBC_MESH_STATIC_HANDLE_LIST(RBC_MESH_STATIC_HANDLE_COUNT_ONE))
+    #define RBC_MESH_HANDLE_CACHE_ENTRIES           RBC_MESH_STATIC_HANDLE_COUNT
+    #define RBC_MESH_DATA_CACHE_ENTRIES             RBC_MESH_STATIC_HANDLE_COUNT
+#endif
+
 /** @brief Default value for the number of handle cache entries */
 #ifndef RBC_MESH_HANDLE_CACHE_ENTRIES
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)
-          #define RBC_MESH_HANDLE_CACHE_ENTRIES           (105)
-    #else
-          #define RBC_MESH_HANDLE_CACHE_ENTRIES           (10)
-    #endif      
+    #define RBC_MESH_HANDLE_CACHE_ENTRIES           (10)
 #endif
 
 /** @brief Default value for the number of data cache entries */
 #ifndef RBC_MESH_DATA_CACHE_ENTRIES
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)
-         #define RBC_MESH_DATA_CACHE_ENTRIES             (105)
-    #else
-         #define RBC_MESH_DATA_CACHE_ENTRIES             (10)
+    #define RBC_MESH_DATA_CACHE_ENTRIES             (10)
+#endif
+
+/** @brief Default value for the number of data cache entries reserved for
+  persistent handles. The values of non-persistent handles never take these
+  entries, and are evicted in least recently updated order when the rest of
+  the data cache is full. The values of persistent handles are never
+  evicted. */
+#ifndef RBC_MESH_PINNED_DATA_ENTRIES
+    #define RBC_MESH_PINNED_DATA_ENTRIES            (0)
+#endif
+
+#define RBC_MESH_EVICTION_LRU                       (0) /**< Evict the least recently updated value. */
+#define RBC_MESH_EVICTION_LFU                       (1) /**< Evict the least frequently updated value, with the update counts aging over time. */
+#define RBC_MESH_EVICTION_TTL                       (2) /**< Evict the least recently updated value, but only once it's been left alone for RBC_MESH_EVICTION_TTL_US. */
+#define RBC_MESH_EVICTION_2Q                        (3) /**< Keep values that have only been seen once in a probation queue, and evict from it first. */
+
+/** @brief Policy for picking which non-persistent value to drop from the
+  data cache when it's full. LRU suits most networks, the others protect
+  frequently updated values from bursts of one-off handles. */
+#ifndef RBC_MESH_EVICTION_POLICY
+    #define RBC_MESH_EVICTION_POLICY                RBC_MESH_EVICTION_LRU
+#endif
+
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+    /** @brief Number of value updates between each halving of the LFU
+      update counts. */
+    #ifndef RBC_MESH_EVICTION_LFU_AGING_PERIOD
+        #define RBC_MESH_EVICTION_LFU_AGING_PERIOD  (64)
+    #endif
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_TTL)
+    /** @brief Time in us a value is kept in the data cache after it was last
+      updated. New values that don't fit are dropped until an entry expires. */
+    #ifndef RBC_MESH_EVICTION_TTL_US
+        #define RBC_MESH_EVICTION_TTL_US            (30000000)
+    #endif
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+    /** @brief Share of the evictable data cache entries the probation queue
+      may hold before its values are evicted ahead of the others. */
+    #ifndef RBC_MESH_EVICTION_2Q_PROBATION_PERCENT
+        #define RBC_MESH_EVICTION_2Q_PROBATION_PERCENT  (25)
+    #endif
+#elif (RBC_MESH_EVICTION_POLICY != RBC_MESH_EVICTION_LRU)
+    #error "Unknown RBC_MESH_EVICTION_POLICY"
+#endif
+
+/** @brief Number of slots in the handle cache lookup index. Must be power of
+  two, and larger than the number of handle cache entries. Keeping it at
+  least twice the number of handle cache entries keeps the probe sequences
+  short. */
+#ifndef RBC_MESH_HANDLE_INDEX_SIZE
+    #define RBC_MESH_HANDLE_INDEX_SIZE              (32)
+#endif
+
+/** @brief Define RBC_MESH_CACHE_COMPACTION to enable rbc_mesh_cache_compact(),
+  which puts the handle and data caches back in least recently used order.
+  After long uptimes with many handles coming and going, the LRU list jumps
+  all over the cache arrays. Not available with RBC_MESH_STATIC_HANDLES, their
+  entries have fixed places. */
+
+/** @brief Define RBC_MESH_COMPACT_VALUE_STORE to keep the cached values as
+  bare payload bytes in a slab allocated value store, instead of as full
+  packets from the packet pool. The advertisement is rebuilt each time the
+  value is transmitted or read. This roughly halves the RAM per data cache
+  entry, but values are dropped from the data cache when the store runs full. */
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    /** @brief Value store bytes reserved per data cache entry. Raise it if
+      most values are longer, to avoid early data cache evictions. */
+    #ifndef RBC_MESH_VALUE_STORE_BYTES_PER_ENTRY
+        #define RBC_MESH_VALUE_STORE_BYTES_PER_ENTRY    (12)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_COMPACT_TRICKLE to keep the Trickle state of each
+  data cache entry in 6 bytes instead of 14, to make room for a higher
+  RBC_MESH_DATA_CACHE_ENTRIES. The timeouts are kept as 16 bit tick counts
+  that all entries share the epoch of, the interval as the number of times
+  i_min has been doubled, and the consistency counter in 3 bits. This limits
+  the redundancy constant k to 6, makes the timeouts accurate to a tick, and
+  caps the longest interval at a quarter of the tick range. */
+#ifdef RBC_MESH_COMPACT_TRICKLE
+    /** @brief The Trickle ticks are (1 << RBC_MESH_TRICKLE_TICK_SHIFT) us
+      long. The default 16.4 ms ticks allow intervals of up to 268 s, which
+      covers the default i_max of 2048 times a 100 ms minimum interval.
+      Lower it for finer timeouts if the intervals are shorter. */
+    #ifndef RBC_MESH_TRICKLE_TICK_SHIFT
+        #define RBC_MESH_TRICKLE_TICK_SHIFT         (14)
+    #endif
+    #if (RBC_MESH_TRICKLE_TICK_SHIFT > 17)
+        #error "RBC_MESH_TRICKLE_TICK_SHIFT can't be above 17, the ticks would go past half the timer range"
     #endif
 #endif
 
 /** @brief Length of app-event FIFO. Must be power of two. */
 #ifndef RBC_MESH_APP_EVENT_QUEUE_LENGTH
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)
-         #define RBC_MESH_APP_EVENT_QUEUE_LENGTH         (64)
-    #else
-         #define RBC_MESH_APP_EVENT_QUEUE_LENGTH         (8)
-    #endif
+    #define RBC_MESH_APP_EVENT_QUEUE_LENGTH         (8)
+#endif
+
+/** @brief Longest value to copy into the application events, instead of
+  keeping a reference to the packet it came in. The packet is released as soon
+  as the event is queued, at the cost of this many bytes in every app event
+  queue entry. At RBC_MESH_VALUE_MAX_LEN, no queued event holds a packet, and
+  the packet pool leaves out the app event queue. 0 to always reference the
+  packet. */
+#ifndef RBC_MESH_EVENT_INLINE_DATA_LEN
+    #define RBC_MESH_EVENT_INLINE_DATA_LEN          (0)
+#endif
+
+/** @brief Number of packets the app event queue takes from the packet pool. */
+#if (RBC_MESH_EVENT_INLINE_DATA_LEN >= RBC_MESH_VALUE_MAX_LEN)
+    #define RBC_MESH_EVENT_PACKETS(app_event_queue_length)  (0)
+#else
+    #define RBC_MESH_EVENT_PACKETS(app_event_queue_length)  (app_event_queue_length)
 #endif
 
 /** @brief Length of low level radio event FIFO. Must be power of two. */
@@ -92,524 +313,3551 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     #define RBC_MESH_RADIO_QUEUE_LENGTH             (8)
 #endif
 
-/** @brief Length of internal async-event FIFO. Must be power of two. */
+/** @brief Define RBC_MESH_TX_BACKPRESSURE to only take as many due values for
+  transmission as the radio queue has room for. Values that don't fit keep
+  their Trickle state, instead of losing their transmission to a full queue,
+  and the next transmission round starts as soon as a radio queue slot frees
+  up, rather than on the next Trickle timeout. */
+#ifdef RBC_MESH_TX_BACKPRESSURE
+    /** @brief Time to wait for a radio queue slot before trying again,
+      in case the slot's notification is lost to a full event queue. */
+    #ifndef RBC_MESH_TX_BACKPRESSURE_RETRY_US
+        #define RBC_MESH_TX_BACKPRESSURE_RETRY_US   (10000)
+    #endif
+#endif
+
+/** @brief Length of each of the internal async-event FIFOs, there's one
+  per event priority class. Must be power of two. */
 #ifndef RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH
     #define RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH    (8)
 #endif
 
+/** @brief Number of internal events dispatched from higher priority classes
+  while events of a lower class are waiting, before the lower class gets to
+  dispatch one. See rbc_mesh_event_class_stats_t. */
+#ifndef RBC_MESH_EVENT_STARVATION_LIMIT
+    #define RBC_MESH_EVENT_STARVATION_LIMIT         (8)
+#endif
+
+/** @brief Length of the FIFO of received packets waiting for processing. Must be power of two. */
+#ifndef RBC_MESH_RX_QUEUE_LENGTH
+    #define RBC_MESH_RX_QUEUE_LENGTH                (8)
+#endif
+
+/** @brief Number of packets the data cache takes from the packet pool. With
+  the compact value store, the cached values only hold a packet for the TX
+  round they are transmitted in. */
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    #define RBC_MESH_CACHE_PACKETS(data_cache_entries)  (RBC_MESH_RADIO_QUEUE_LENGTH)
+#else
+    #define RBC_MESH_CACHE_PACKETS(data_cache_entries)  (data_cache_entries)
+#endif
+
+/** @brief Number of recently received packets to remember by CRC. Exact
+  copies of these are registered as consistent receptions without running
+  through the version and payload checks. Set to 0 to disable the cache. */
+#ifndef RBC_MESH_RX_DUPLICATE_CACHE_SIZE
+    #define RBC_MESH_RX_DUPLICATE_CACHE_SIZE        (8)
+#endif
+
+/** @brief Number of handle ranges the RX filter can hold, see
+  rbc_mesh_rx_filter_set(). */
+#ifndef RBC_MESH_RX_FILTER_RANGES_MAX
+    #define RBC_MESH_RX_FILTER_RANGES_MAX           (4)
+#endif
+
+/** @brief Number of mesh instances that can run next to the primary mesh,
+  see rbc_mesh_instance_add(). Each instance takes one of the radio's logical
+  addresses, which caps it at 6. */
+#ifndef RBC_MESH_INSTANCES_MAX
+    #define RBC_MESH_INSTANCES_MAX                  (2)
+#endif
+
+#if (RBC_MESH_INSTANCES_MAX > 6)
+    #error "The radio only has logical addresses for 6 mesh instances"
+#endif
+
+/** @brief Shortest scan window accepted by rbc_mesh_scan_duty_cycle_set(),
+  in microseconds. Shorter windows would mostly be spent on the timeslot
+  safety margins. */
+#define RBC_MESH_SCAN_WINDOW_MIN_US                 (3000)
+
+/** @brief Longest scan interval accepted by rbc_mesh_scan_duty_cycle_set(),
+  in microseconds. */
+#define RBC_MESH_SCAN_INTERVAL_MAX_US               (10000000)
+
+/** @brief Define RBC_MESH_STANDALONE to run the framework without a
+  SoftDevice, for dedicated relays and gateways that don't need BLE
+  connections. The framework takes the radio, TIMER0 and the clocks for
+  itself, and stays in one continuous timeslot from rbc_mesh_start() to
+  rbc_mesh_stop(), without timeslot negotiation or end margins. The mesh GATT
+  service, duty-cycled scanning and Softdevice events aren't available. The
+  application must not enable the SoftDevice, and is responsible for
+  calibrating an RC low frequency clock source. */
+#if defined(RBC_MESH_STANDALONE) && defined(SOFTDEVICE_PRESENT)
+    #error "RBC_MESH_STANDALONE can't be used with a SoftDevice"
+#endif
+
+/** @brief Define RBC_MESH_NO_GATT to leave the mesh GATT service out of
+  SoftDevice builds, for nodes that no phone ever connects to. mesh_gatt.c is
+  then reduced to stubs, and its notification queues and connection state are
+  left out of RAM. The application may still run its own BLE services, and the
+  timeslots still fit around its connections. Set by the minimal_relay,
+  sensor_leaf and dfu_relay build profiles in rbc_mesh/profiles.mk. */
+
+/** @brief Define RBC_MESH_TIMESLOT_CHAINING to request each timeslot as a
+  normal request starting right after the current one, rather than as an
+  earliest request, while scanning continuously without a GATT connection.
+  Shortens the time between timeslots, when the mesh can't receive, see
+  rbc_mesh_timeslot_stats_t::rx_gap_ms_per_hour. Falls back to earliest
+  requests when the SoftDevice blocks the chained timeslot. */
+#ifdef RBC_MESH_TIMESLOT_CHAINING
+    /** @brief Time from the end of a timeslot to the start of the chained
+      one, in microseconds. */
+    #ifndef RBC_MESH_TIMESLOT_CHAIN_GAP_US
+        #define RBC_MESH_TIMESLOT_CHAIN_GAP_US      (200)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TIMESLOT_WORK_AWARE to size timeslot extensions by
+  the pending work while scanning continuously. A timeslot without queued
+  transmissions, flash operations or a Trickle transmission coming up isn't
+  extended, and the radio sleeps for RBC_MESH_TIMESLOT_IDLE_SLEEP_US before
+  the next timeslot. A backlog in the radio queue or the flash queue extends
+  the timeslot in the largest steps. Trades some reception time on an idle
+  mesh for lower current. */
+#ifdef RBC_MESH_TIMESLOT_WORK_AWARE
+    /** @brief Time between an idle timeslot and the next one, in
+      microseconds. Cut short by upcoming Trickle transmissions. */
+    #ifndef RBC_MESH_TIMESLOT_IDLE_SLEEP_US
+        #define RBC_MESH_TIMESLOT_IDLE_SLEEP_US     (20000)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TIMESLOT_LATENCY_MODE to let latency-critical
+  nodes request their timeslots at high priority on a regular cadence, see
+  rbc_mesh_latency_mode_set(). The cadence is moved to start a timeslot right
+  before the Trickle transmissions of urgent handles, so they go out on time
+  rather than whenever the SoftDevice grants the next timeslot. The achieved
+  jitter is reported in the timeslot statistics. */
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    /** @brief Shortest cadence accepted by rbc_mesh_latency_mode_set(), in
+      microseconds. */
+    #ifndef RBC_MESH_LATENCY_PERIOD_MIN_US
+        #define RBC_MESH_LATENCY_PERIOD_MIN_US      (5000)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_RX_DOUBLE_BUFFER to keep a spare packet for the
+  scanner. Once a packet has been received, the radio restarts the scan in
+  the spare packet by itself, while the received one is handed off, instead
+  of waiting for the CPU to set up a new reception. Packets from neighbors
+  that transmit right after each other are less likely to be missed. Takes one
+  packet from the pool. */
+#ifdef RBC_MESH_RX_DOUBLE_BUFFER
+    #define RBC_MESH_RX_SPARE_PACKETS               (1)
+#else
+    #define RBC_MESH_RX_SPARE_PACKETS               (0)
+#endif
+
 /** @brief Size of packet pool. Only accounts for one packet in the app-space at a time. */
 #ifndef RBC_MESH_PACKET_POOL_SIZE
-    #define RBC_MESH_PACKET_POOL_SIZE               (RBC_MESH_DATA_CACHE_ENTRIES +\
-                                                     RBC_MESH_APP_EVENT_QUEUE_LENGTH + \
+    #define RBC_MESH_PACKET_POOL_SIZE               (RBC_MESH_CACHE_PACKETS(RBC_MESH_DATA_CACHE_ENTRIES) +\
+                                                     RBC_MESH_EVENT_PACKETS(RBC_MESH_APP_EVENT_QUEUE_LENGTH) + \
                                                      RBC_MESH_RADIO_QUEUE_LENGTH + \
                                                      RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH +\
+                                                     RBC_MESH_RX_QUEUE_LENGTH +\
+                                                     RBC_MESH_RX_SPARE_PACKETS +\
                                                      3)
 #endif
 
-#if (RBC_MESH_HANDLE_CACHE_ENTRIES < RBC_MESH_DATA_CACHE_ENTRIES)
-    #error "The number of handle cache entries cannot be lower than the number of data entries"
+/** @brief Number of packets in the pool the radio can't take for reception.
+  Keeps packets for local values, cache updates and events when the pool runs
+  low, e.g. when the application is slow to release events. The radio stops
+  listening instead, until packets are released. */
+#ifndef RBC_MESH_PACKET_POOL_RX_RESERVE
+    #define RBC_MESH_PACKET_POOL_RX_RESERVE         (2)
 #endif
 
-/**
-* @brief Rebroadcast value handle type
-*
-* @detailed Handle type used to identify a value in the mesh, is consistent
-*   throughout the network
-*/
-typedef uint16_t rbc_mesh_value_handle_t;
+/** @brief Number of segmented values the framework can keep. Segmented values
+  carry up to RBC_MESH_SEGMENTED_VALUE_MAX_LEN bytes on a single handle. Each
+  entry costs about RBC_MESH_SEGMENTED_VALUE_MAX_LEN bytes of RAM. Set to 0 to
+  disable the feature. */
+#ifndef RBC_MESH_SEGMENTED_VALUE_ENTRIES
+    #define RBC_MESH_SEGMENTED_VALUE_ENTRIES        (0)
+#endif
 
-/** @brief Event type enum. Identifies framework generated events */
-typedef enum
-{
-    RBC_MESH_EVENT_TYPE_UPDATE_VAL,             /**< Another node has updated the value. Parameters in rx sub-structure. */
-    RBC_MESH_EVENT_TYPE_CONFLICTING_VAL,        /**< Another node has a conflicting version of the value. Parameters in rx sub-structure.  */
-    RBC_MESH_EVENT_TYPE_NEW_VAL,                /**< A previously unallocated value has been received and allocated. Parameters in rx sub-structure. */
-    RBC_MESH_EVENT_TYPE_INITIALIZED,            /**< The framework has been initialized internally (most likely via serial interface). No parameters. */
-    RBC_MESH_EVENT_TYPE_TX,                     /**< The indicated handle was transmitted. Parameters in tx sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_NEW_FW_AVAILABLE,   /**< The dfu module has detected that a newer version of the current firmware is available. Parameters in dfu.new_fw sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_RELAY_REQ,          /**< A DFU transfer is about to start in the network, and our device is able to act as a relay. Parameters in dfu.relay_req sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_SOURCE_REQ,         /**< A DFU transfer is about to start in the network, and our device is able to act as a source. Parameters in dfu.source_req sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_START,              /**< The dfu module has started its target role. Parameters in dfu.start sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_END,                /**< The dfu module has ended its target role. Paramters in dfu.end sub-structure. */
-    RBC_MESH_EVENT_TYPE_DFU_BANK_AVAILABLE,     /**< The dfu module found a bank available for flashing. Parameters in dfu.bank sub-structure. */
-} rbc_mesh_event_type_t;
+/** @brief Number of segments of a segmented value to transmit each time its
+  Trickle timer fires. */
+#ifndef RBC_MESH_SEGMENTS_PER_TX
+    #define RBC_MESH_SEGMENTS_PER_TX                (3)
+#endif
 
-/** @brief The various states of the mesh framework. */
-typedef enum
-{
-    MESH_STATE_UNINITIALIZED,   /**< The mesh hasn't been initialized. */
-    MESH_STATE_RUNNING,         /**< The mesh is currently running as normal. */
-    MESH_STATE_STOPPED          /**< The mesh operation has been stopped. */
-} rbc_mesh_state_t;
+#if (RBC_MESH_SEGMENTS_PER_TX >= RBC_MESH_RADIO_QUEUE_LENGTH)
+    #error "Can't transmit more segments at once than the radio queue can hold"
+#endif
 
-/** @brief OpenMesh framework generated event. */
-typedef struct
-{
-    rbc_mesh_event_type_t type;                     /**< See @ref rbc_mesh_event_type_t */
-    union
-    {
-        struct
-        {
-            rbc_mesh_value_handle_t value_handle;   /**< Handle of the value the event is generated for. */
-            uint8_t* p_data;                        /**< Current data array contained at the event handle location. */
-            uint8_t data_len;                       /**< Length of data array. */
-            int8_t rssi;                            /**< RSSI of received data, in range of -100dBm to ~-40dBm. */
-            ble_gap_addr_t ble_adv_addr;            /**< Advertisement address of the device we got the update from. */
-            uint16_t version_delta;                 /**< Version number increase since last update. */
-            uint32_t timestamp_us;                  /**< Timestamp of the received packet. */
-        } rx;
-        struct
-        {
-            rbc_mesh_value_handle_t value_handle;   /**< Handle of the value the event is generated for. */
-            uint8_t* p_data;                        /**< Data array transmitted. */
-            uint8_t data_len;                       /**< Length of data array. */
-            uint32_t timestamp_us;                  /** Timestamp of the sent packet. */
-        } tx;
-        union
-        {
-            struct
-            {
-                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
-                fwid_union_t new_fwid;              /**< Firmware ID of the new firmware. */
-                fwid_union_t current_fwid;          /**< ID of the firmware of the given type currently on the device. */
-            } new_fw;
-            struct
-            {
-                dfu_type_t dfu_type;                /**< DFU type of the transfer. */
-                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
-                uint8_t authority;                  /**< Authority level of the transfer. */
-            } relay_req;
-            struct
-            {
-                dfu_type_t dfu_type;                /**< DFU type of the transfer. */
-                fwid_union_t current_fwid;          /**< ID of the firmware of the given type currently on the device. */
-            } source_req;
-            struct
-            {
-                dfu_role_t role;                    /**< The device's role in the transfer. */
-                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
-                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
-            } start;
-            struct
-            {
-                dfu_role_t role;                    /**< The device's role in the transfer. */
-                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
-                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
-                dfu_end_t end_reason;               /**< Reason for the end event. */
-            } end;
-            struct
-            {
-                dfu_type_t dfu_type;                /**< DFU type of the bank. */
-                fwid_union_t fwid;                  /**< Firmware ID of the bank. */
-                uint32_t* p_start_addr;             /**< Start address of the bank. */
-                uint32_t length;                    /**< Length of the firmware in the bank. */
-                bool is_signed;                     /**< Flag indicating whether the bank is signed with an encryption key. */
-            } bank;
-        } dfu;
-    } params;
-} rbc_mesh_event_t;
+/** @brief Define RBC_MESH_MULTICHANNEL to rotate the mesh transmissions across
+  the three advertisement channels, and scan the channels in
+  RBC_MESH_SCAN_PATTERN, instead of using the single mesh channel given in
+  @ref rbc_mesh_init_params_t. All nodes in the mesh should use the same mode. */
+#ifdef RBC_MESH_MULTICHANNEL
+    /** @brief Channels to scan, in order. The scanner moves to the next channel
+      every time it is restarted. */
+    #ifndef RBC_MESH_SCAN_PATTERN
+        #define RBC_MESH_SCAN_PATTERN               {37, 38, 39}
+    #endif
+#endif
 
-/** Radio TX power enum */
-typedef enum
-{
-    RBC_MESH_TXPOWER_0dBm     = 0x00UL, /**< 0dBm. */
-    RBC_MESH_TXPOWER_Pos4dBm  = 0x04UL, /**< +4dBm. */
-    RBC_MESH_TXPOWER_Neg30dBm = 0xD8UL, /**< -30dBm. */
-    RBC_MESH_TXPOWER_Neg20dBm = 0xECUL, /**< -20dBm. */
-    RBC_MESH_TXPOWER_Neg16dBm = 0xF0UL, /**< -16dBm. */
-    RBC_MESH_TXPOWER_Neg12dBm = 0xF4UL, /**< -12dBm. */
-    RBC_MESH_TXPOWER_Neg8dBm  = 0xF8UL, /**< -8dBm. */
-    RBC_MESH_TXPOWER_Neg4dBm  = 0xFCUL, /**< -4dBm. */
-} rbc_mesh_txpower_t;
+/** @brief Define RBC_MESH_CHANNEL_QUALITY to count the receptions and CRC
+  failures on each advertisement channel, and take channels with too many
+  failures out of use. The nodes share the resulting channel map in a beacon
+  on a reserved handle, and all of them follow the most recent one, so they
+  keep scanning the channels the others transmit on. A channel that has been
+  taken out is tried again after a while. See rbc_mesh_channel_stats_get().
+  Requires RBC_MESH_MULTICHANNEL. */
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    #ifndef RBC_MESH_MULTICHANNEL
+        #error "RBC_MESH_CHANNEL_QUALITY requires RBC_MESH_MULTICHANNEL"
+    #endif
+    /** @brief Reserved handle carrying the channel map beacon. */
+    #define RBC_MESH_CHANNEL_MAP_HANDLE             (0xFFF5)
+    /** @brief Length of the channel map beacon payload: the map of used
+      advertisement channels, with channel 37 in bit 0, and an 8 bit
+      sequence number. */
+    #define RBC_MESH_CHANNEL_MAP_PAYLOAD_LEN        (2)
+    /** @brief Interval between channel map beacons in microseconds. */
+    #ifndef RBC_MESH_CHANNEL_MAP_INTERVAL_US
+        #define RBC_MESH_CHANNEL_MAP_INTERVAL_US    (2000000)
+    #endif
+    /** @brief Length of the periods the CRC failure rate of each channel is
+      measured over, in microseconds. At most one channel is taken out per
+      period. */
+    #ifndef RBC_MESH_CHANNEL_QUALITY_PERIOD_US
+        #define RBC_MESH_CHANNEL_QUALITY_PERIOD_US  (10000000)
+    #endif
+    /** @brief Fewest receptions on a channel in a period to judge it by. */
+    #ifndef RBC_MESH_CHANNEL_QUALITY_MIN_SAMPLES
+        #define RBC_MESH_CHANNEL_QUALITY_MIN_SAMPLES (32)
+    #endif
+    /** @brief Share of failed receptions, in percent, at which a channel is
+      taken out. */
+    #ifndef RBC_MESH_CHANNEL_BLACKLIST_PERCENT
+        #define RBC_MESH_CHANNEL_BLACKLIST_PERCENT  (40)
+    #endif
+    /** @brief Time a channel stays out before all channels are tried again,
+      in microseconds. */
+    #ifndef RBC_MESH_CHANNEL_BLACKLIST_TIME_US
+        #define RBC_MESH_CHANNEL_BLACKLIST_TIME_US  (120000000)
+    #endif
+    #if (RBC_MESH_CHANNEL_QUALITY_PERIOD_US < RBC_MESH_CHANNEL_MAP_INTERVAL_US)
+        #error "RBC_MESH_CHANNEL_QUALITY_PERIOD_US can't be shorter than RBC_MESH_CHANNEL_MAP_INTERVAL_US"
+    #endif
+#endif
 
-/**
-* @brief Initialization parameter struct for the rbc_mesh_init() function.
-*
-* @param[in] access_addr The access address the mesh will work on. This must be the
-*    same for all nodes in the mesh. RBC_MESH_ACCESS_ADDRESS_BLE_ADV gives the mesh
-*    the same access address as regular BLE advertisements, which makes the
-*    traffic visible to external BLE devices (Note that other access addresses
-*    does not provide any data security, the traffic is merely ignored by
-*    regular BLE radios). Multiple meshes may in theory work concurrently in
-*    the same area with different access addresses, but will be prone to
-*    on-air collisions, and it is recommended to use separate channels for this.
-* @param[in] channel The BLE channel the mesh works on. It is strongly recommended
-*    to use one of the three adv channels 37, 38 or 39, as others may be prone
-*    to on-air collisions with WiFi channels. Separate meshes may work
-*    concurrently without packet collision if they are assigned to different
-*    channels. Must be between 1 and 39.
-* @param[in] interval_min_ms The minimum tx interval for nodes in the network in
-*    millis. Must be between 5 and 60000.
-* @param[in] lfclksrc The LF-clock source parameter supplied to the
-*    softdevice_enable function.
-* @param[in] tx_power The transmit power used in the mesh. See @rbc_mesh_tx_power_t.
-*/
-typedef struct
-{
-    uint32_t access_addr;
-    uint8_t channel;
-    uint32_t interval_min_ms;
-#if (NORDIC_SDK_VERSION >= 11)
-	nrf_clock_lf_cfg_t lfclksrc;
-#else
-	nrf_clock_lfclksrc_t lfclksrc;
+/** @brief Define RBC_MESH_EVENT_COALESCING to let a new or updated value event
+  replace a pending new or updated value event for the same handle in the app
+  event queue, instead of taking up a new slot. A slow application will then
+  only miss intermediate versions of a value, instead of losing the latest one
+  when the queue fills up. The version delta of the merged events is summed. */
+
+/** @brief Define RBC_MESH_TX_EVENT_COALESCING to let a TX event replace a
+  pending TX event for the same handle in the app event queue, instead of
+  taking up a new slot. Handles that repeat often then hold at most two slots
+  each, leaving the queue to value events. The tx_count of the merged events
+  is summed, so no transmissions go uncounted. */
+
+/** @brief Number of Trickle parameter classes values can be assigned to. When
+  more values are due for transmission than the radio queue can take, values
+  in lower classes are transmitted first. */
+#ifndef RBC_MESH_TRICKLE_CLASS_COUNT
+    #define RBC_MESH_TRICKLE_CLASS_COUNT            (4)
 #endif
-    rbc_mesh_txpower_t tx_power;
-} rbc_mesh_init_params_t;
 
-typedef enum
-{
-    BLE_PACKET_TYPE_ADV_IND,
-    BLE_PACKET_TYPE_ADV_DIRECT_IND,
-    BLE_PACKET_TYPE_ADV_NONCONN_IND,
-    BLE_PACKET_TYPE_SCAN_REQ,
-    BLE_PACKET_TYPE_SCAN_RSP,
-    BLE_PACKET_TYPE_CONN_REQ,
-    BLE_PACKET_TYPE_ADV_DISCOVER_IND
-} ble_packet_type_t;
+/** @brief Trickle parameter class of values that haven't been assigned one.
+  Uses the interval given in @ref rbc_mesh_init_params_t unless reconfigured. */
+#ifndef RBC_MESH_TRICKLE_CLASS_DEFAULT
+    #define RBC_MESH_TRICKLE_CLASS_DEFAULT          (1)
+#endif
 
-/** @brief Packet peek callback parameters. */
+#if (RBC_MESH_TRICKLE_CLASS_DEFAULT >= RBC_MESH_TRICKLE_CLASS_COUNT)
+    #error "The default Trickle class must be one of the Trickle classes"
+#endif
+
+/** @brief Define RBC_MESH_SUMMARY_BEACON to periodically broadcast a digest of
+  all values the node is transmitting. When a node receives a digest identical
+  to its own, it counts it as a consistent reception for all its values, which
+  suppresses their Trickle transmissions while the network is idle. */
+#ifdef RBC_MESH_SUMMARY_BEACON
+    /** @brief Reserved handle carrying the summary beacon. */
+    #define RBC_MESH_SUMMARY_HANDLE                 (0xFFF0)
+    /** @brief Length of the summary beacon payload: a 32 bit digest and a 16
+      bit value count. */
+    #define RBC_MESH_SUMMARY_PAYLOAD_LEN            (6)
+    /** @brief Interval between summary beacons in microseconds. */
+    #ifndef RBC_MESH_SUMMARY_INTERVAL_US
+        #define RBC_MESH_SUMMARY_INTERVAL_US        (500000)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_DELTA_UPDATES to let local value updates that only
+  change a few bytes be broadcast as short patches against the previous version
+  for their first Trickle transmissions. Nodes that don't have the previous
+  version ignore the patches, and pick up the full value later. */
+#ifdef RBC_MESH_DELTA_UPDATES
+    /** @brief Reserved handle carrying delta updates. */
+    #define RBC_MESH_DELTA_HANDLE                   (0xFFF1)
+    /** @brief Delta update header length: handle, base version, value length
+      and patch offset. */
+    #define RBC_MESH_DELTA_OVERHEAD                 (6)
+    /** @brief Number of values that may have a delta update pending at once. */
+    #ifndef RBC_MESH_DELTA_ENTRIES
+        #define RBC_MESH_DELTA_ENTRIES              (4)
+    #endif
+    /** @brief Number of Trickle transmissions sent as a delta before falling
+      back to the full value. */
+    #ifndef RBC_MESH_DELTA_TX_COUNT
+        #define RBC_MESH_DELTA_TX_COUNT             (4)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_NETWORK_CODING to let relays XOR two received
+  values that came from different neighbors into a single packet. Each of the
+  two neighbors decodes the value it lacks with the one it sent, and nodes
+  that have one of the values do the same. Nodes that have both count the
+  packet as a consistent reception of each, and nodes that have neither
+  ignore it and pick up the values from the plain transmissions that follow.
+  Cuts the relay transmissions when many values change at once. */
+#ifdef RBC_MESH_NETWORK_CODING
+    /** @brief Reserved handle carrying the coded packets. */
+    #define RBC_MESH_NETCODE_HANDLE                 (0xFFEE)
+    /** @brief Coded packet header length: the handle and version of the
+      first value, the handle of the second value and the length of both. */
+    #define RBC_MESH_NETCODE_OVERHEAD               (8)
+    /** @brief Number of received values remembered along with the neighbor
+      they came from, which are the values a relay may code. */
+    #ifndef RBC_MESH_NETCODE_ENTRIES
+        #define RBC_MESH_NETCODE_ENTRIES            (8)
+    #endif
+    /** @brief Number of Trickle transmissions of a received value that may
+      go out coded, before it's only sent plain. */
+    #ifndef RBC_MESH_NETCODE_TX_COUNT
+        #define RBC_MESH_NETCODE_TX_COUNT           (2)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TIME_SYNC to keep a mesh wide time base, see
+  rbc_mesh_time_get(). All nodes periodically broadcast their mesh time on a
+  reserved handle, and follow the node with the lowest device address in the
+  network, directly or through the neighbor closest to it. The rate
+  difference to that node's clock is tracked to keep the mesh time between
+  beacons. Only the root advances the beacon sequence number, so relayed
+  beacons of a root that has left the network don't keep it alive. */
+#ifdef RBC_MESH_TIME_SYNC
+    /** @brief Reserved handle carrying the time sync beacon. */
+    #define RBC_MESH_TIME_SYNC_HANDLE               (0xFFF2)
+    /** @brief Length of the time sync beacon payload: a 32 bit root ID, a 32
+      bit mesh timestamp, an 8 bit hop count and an 8 bit sequence number. */
+    #define RBC_MESH_TIME_SYNC_PAYLOAD_LEN          (10)
+    /** @brief Interval between time sync beacons in microseconds. */
+    #ifndef RBC_MESH_TIME_SYNC_INTERVAL_US
+        #define RBC_MESH_TIME_SYNC_INTERVAL_US      (1000000)
+    #endif
+    /** @brief Time without beacons from the current time root before the
+      node takes over as root, in microseconds. */
+    #ifndef RBC_MESH_TIME_SYNC_TIMEOUT_US
+        #define RBC_MESH_TIME_SYNC_TIMEOUT_US       (5 * RBC_MESH_TIME_SYNC_INTERVAL_US)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_VERSION_REPAIR to repair inconsistencies with
+  version pages rather than Trickle resets. A node hearing an older version of
+  one of its values answers with a single, rate limited transmission instead
+  of restarting the value's Trickle interval. A node hearing a summary beacon
+  that differs from its own broadcasts the handle/version pairs of all its
+  values, a page at a time, and the neighbors only send the values they have
+  newer versions of, or that are missing from a page. Requires
+  RBC_MESH_SUMMARY_BEACON. */
+#ifdef RBC_MESH_VERSION_REPAIR
+    #ifndef RBC_MESH_SUMMARY_BEACON
+        #error "RBC_MESH_VERSION_REPAIR requires RBC_MESH_SUMMARY_BEACON"
+    #endif
+    /** @brief Reserved handle carrying the version pages. */
+    #define RBC_MESH_REPAIR_HANDLE                  (0xFFF3)
+    /** @brief Version page header length: first and last handle covered. */
+    #define RBC_MESH_REPAIR_PAGE_OVERHEAD           (4)
+    /** @brief Number of handle/version pairs in a version page. */
+    #define RBC_MESH_REPAIR_PAGE_ENTRIES            ((RBC_MESH_LEGACY_VALUE_MAX_LEN - RBC_MESH_REPAIR_PAGE_OVERHEAD) / 4)
+    /** @brief Interval between version pages in microseconds. Repair
+      transmissions are spread over the same interval. */
+    #ifndef RBC_MESH_REPAIR_INTERVAL_US
+        #define RBC_MESH_REPAIR_INTERVAL_US         (200000)
+    #endif
+    /** @brief Highest number of repair transmissions per repair interval.
+      Inconsistencies beyond the limit are left to the next version page. */
+    #ifndef RBC_MESH_REPAIR_TX_MAX
+        #define RBC_MESH_REPAIR_TX_MAX              (4)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_BOOTSTRAP to have a node that starts with an empty
+  handle cache ask a single neighbor for all its values, instead of learning
+  them as the neighbors' Trickle timers expire. The node listens for
+  RBC_MESH_BOOTSTRAP_LISTEN_US, and asks the neighbor it heard at the
+  strongest RSSI. The neighbor sends its values in handle order, a batch per
+  interval, which go out in aggregated packets with RBC_MESH_AGGREGATED_TX.
+  After each batch it tells the node where the next one starts, and the node
+  asks again from there if the transfer stalls. The rest of the mesh only
+  hears the transfer as repeated transmissions of values it already has.
+  Requires RBC_MESH_SUMMARY_BEACON, as the summary beacons are what the new
+  node hears its neighbors by. */
+#ifdef RBC_MESH_BOOTSTRAP
+    #ifndef RBC_MESH_SUMMARY_BEACON
+        #error "RBC_MESH_BOOTSTRAP requires RBC_MESH_SUMMARY_BEACON"
+    #endif
+    /** @brief Reserved handle carrying the bootstrap requests. Below the
+      16 framework handles, as DFU uses 0xFFF6 and up. */
+    #define RBC_MESH_BOOTSTRAP_HANDLE               (0xFFEF)
+    /** @brief Length of the bootstrap message payload: an 8 bit type, the
+      device address of the node it is for and a 16 bit handle. */
+    #define RBC_MESH_BOOTSTRAP_PAYLOAD_LEN          (9)
+    /** @brief Time a new node listens for neighbors before asking one of
+      them, in microseconds. */
+    #ifndef RBC_MESH_BOOTSTRAP_LISTEN_US
+        #define RBC_MESH_BOOTSTRAP_LISTEN_US        (500000)
+    #endif
+    /** @brief Interval between the batches of values sent to a new node, in
+      microseconds. */
+    #ifndef RBC_MESH_BOOTSTRAP_INTERVAL_US
+        #define RBC_MESH_BOOTSTRAP_INTERVAL_US      (100000)
+    #endif
+    /** @brief Number of values in each batch. */
+    #ifndef RBC_MESH_BOOTSTRAP_BATCH
+        #define RBC_MESH_BOOTSTRAP_BATCH            (6)
+    #endif
+    /** @brief Time a new node waits for the next value from the neighbor
+      before asking again, from the handle after the last one it got, in
+      microseconds. */
+    #ifndef RBC_MESH_BOOTSTRAP_TIMEOUT_US
+        #define RBC_MESH_BOOTSTRAP_TIMEOUT_US       (1000000)
+    #endif
+    /** @brief Number of times a new node asks again before it leaves the
+      rest to Trickle. */
+    #ifndef RBC_MESH_BOOTSTRAP_RETRIES
+        #define RBC_MESH_BOOTSTRAP_RETRIES          (3)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_CONFIG_PUSH to let a node change the min-interval,
+  the Trickle classes and the radio parameters of the whole mesh, see
+  rbc_mesh_config_interval_push(). Each setting is a record with its own
+  sequence number, signed with a configuration key all nodes share, see
+  rbc_mesh_config_key_set(). Nodes apply a record with a newer sequence
+  number than the one they have, and keep sending the records they know in a
+  beacon on a reserved handle, one per interval, so nodes that join later get
+  them too. A change of access address or channel is counted down in the
+  beacons, and every node switches at the same time. The records are kept in
+  RAM only, a node that restarts runs on its built in parameters until it
+  hears the beacons again. */
+#ifdef RBC_MESH_CONFIG_PUSH
+    /** @brief Reserved handle carrying the configuration beacon. Below the
+      16 framework handles, as DFU uses 0xFFF6 and up. */
+    #define RBC_MESH_CONFIG_HANDLE                  (0xFFED)
+    /** @brief Length of the configuration beacon payload: an 8 bit record
+      ID, a 16 bit sequence number, 7 bytes of settings and a 32 bit MIC. */
+    #define RBC_MESH_CONFIG_PAYLOAD_LEN             (14)
+    /** @brief Length of the configuration key. */
+    #define RBC_MESH_CONFIG_KEY_LEN                 (16)
+    /** @brief Interval between configuration beacons in microseconds. */
+    #ifndef RBC_MESH_CONFIG_INTERVAL_US
+        #define RBC_MESH_CONFIG_INTERVAL_US         (2000000)
+    #endif
+    /** @brief Unit of the radio switch countdown in the beacons, in
+      milliseconds. The countdown can't exceed 0xFFFF units. */
+    #define RBC_MESH_CONFIG_SWITCH_UNIT_MS          (10)
+    #if (RBC_MESH_CONFIG_PAYLOAD_LEN > RBC_MESH_LEGACY_VALUE_MAX_LEN)
+        #error "The configuration beacon doesn't fit in a legacy packet with these packet options"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_LATENCY_PROBE to measure the latency of multi-hop
+  paths, see rbc_mesh_probe_send(). A probe floods the mesh on a reserved
+  handle, and each relay appends its node ID and the time the probe spent on
+  it. The target reports the path in an @ref RBC_MESH_EVENT_TYPE_PROBE event,
+  and sends the probe back, so that the origin gets the round trip time and
+  the return path. */
+#ifdef RBC_MESH_LATENCY_PROBE
+    /** @brief Reserved handle carrying the latency probes. */
+    #define RBC_MESH_PROBE_HANDLE                   (0xFFF4)
+    /** @brief Highest number of relays a probe passes through. */
+    #ifndef RBC_MESH_PROBE_TTL
+        #define RBC_MESH_PROBE_TTL                  (16)
+    #endif
+    /** @brief Number of recent probes remembered, to relay each probe only
+      once. */
+    #ifndef RBC_MESH_PROBE_CACHE_SIZE
+        #define RBC_MESH_PROBE_CACHE_SIZE           (8)
+    #endif
+#endif
+/** @brief Latency probe header length: origin, target, sequence number,
+  flags, hop count and origin timestamp. */
+#define RBC_MESH_PROBE_OVERHEAD                     (11)
+/** @brief Number of relays a latency probe has room for. Relays beyond these
+  are counted, but not listed. */
+#define RBC_MESH_PROBE_HOPS_MAX                     ((RBC_MESH_LEGACY_VALUE_MAX_LEN - RBC_MESH_PROBE_OVERHEAD) / 4)
+/** @brief Unit of the relay delays in a latency probe, in microseconds. */
+#define RBC_MESH_PROBE_DELAY_UNIT_US                (100)
+
+/** @brief Define RBC_MESH_SNIFFER to be able to stream every received packet
+  to the serial host, including the ones with a bad CRC, the ones for other
+  mesh instances and the ones the RX filter drops. The host starts and stops
+  the capture with the sniffer set command, see the serial interface
+  documentation. Longer serial frames are needed for the capture, the
+  interactive_pyaci application controller can write them to a PCAP file. */
+#ifdef RBC_MESH_SNIFFER
+    #ifndef RBC_MESH_SERIAL
+        #error "RBC_MESH_SNIFFER requires RBC_MESH_SERIAL"
+    #endif
+    /** @brief Number of captured packets waiting for the serial queue. Must be
+      power of two. */
+    #ifndef RBC_MESH_SNIFFER_QUEUE_LENGTH
+        #define RBC_MESH_SNIFFER_QUEUE_LENGTH       (16)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_RADIO_PRIORITY to order the radio queue by
+  transmission class instead of first come, first served. Urgent values and
+  the DFU control packets are queued ahead of the regular values and RX, and
+  the DFU data goes last. Each queued event may only be overtaken a limited
+  number of times, which bounds the wait of the scanner and the lower classes
+  under sustained high priority traffic. */
+#ifdef RBC_MESH_RADIO_PRIORITY
+    /** @brief Number of times a queued radio event may be overtaken by events
+      of a higher class, before it keeps its place in the queue. */
+    #ifndef RBC_MESH_RADIO_OVERTAKE_MAX
+        #define RBC_MESH_RADIO_OVERTAKE_MAX         (2)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_LISTEN_BEFORE_TALK to check the channel before each
+  transmission. If the ongoing scan is receiving a packet, or the RSSI on the
+  channel is above the threshold, the transmission is deferred until the
+  packet ends, or for a short random backoff. Deferred transmissions are
+  counted in rbc_mesh_stats_t::tx_deferred. */
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+    /** @brief RSSI at which the channel is considered busy, in -dBm. */
+    #ifndef RBC_MESH_LBT_RSSI_THRESHOLD
+        #define RBC_MESH_LBT_RSSI_THRESHOLD         (80)
+    #endif
+    /** @brief Upper limit for the random backoff after a busy channel, in
+      microseconds. */
+    #ifndef RBC_MESH_LBT_BACKOFF_MAX_US
+        #define RBC_MESH_LBT_BACKOFF_MAX_US         (1000)
+    #endif
+    /** @brief Number of times a transmission may be deferred before it is
+      sent regardless of the channel. */
+    #ifndef RBC_MESH_LBT_DEFERRALS_MAX
+        #define RBC_MESH_LBT_DEFERRALS_MAX          (3)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_RADIO_TIME_STATS to account the time the radio
+  spends ramping up, receiving and transmitting in the timeslots, see
+  rbc_mesh_radio_stats_t. Reads the timer at the start and end of every radio
+  event. */
+
+/** @brief Define RBC_MESH_RSSI_RELAY_SUPPRESSION to let packets received at a
+  high RSSI count as several consistent receptions in the Trickle algorithm.
+  Nodes close to the sender of a value get their transmissions suppressed
+  first, and the nodes at the edge of its range become the ones relaying
+  it. A new value received at a high RSSI counts as consistent receptions
+  beyond the first one. */
+#ifdef RBC_MESH_RSSI_RELAY_SUPPRESSION
+    /** @brief RSSI above which the sender is considered close, in -dBm. */
+    #ifndef RBC_MESH_RSSI_SUPPRESS_THRESHOLD
+        #define RBC_MESH_RSSI_SUPPRESS_THRESHOLD    (60)
+    #endif
+    /** @brief Number of consistent receptions a packet from a close sender
+      counts as. */
+    #ifndef RBC_MESH_RSSI_SUPPRESS_WEIGHT
+        #define RBC_MESH_RSSI_SUPPRESS_WEIGHT       (2)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_PERSISTENT_STORAGE to keep the values of the
+  persistent handles in flash, see rbc_mesh_persistence_set(). The values are
+  appended to a log in a ring of flash pages, and restored to the handle
+  cache with their versions in rbc_mesh_init(), so a rebooted device rejoins
+  the mesh with the values it had, instead of relearning them from its
+  neighbors. Persistent values that don't fit a page are left out, and
+  counted in the persistent_drop field of rbc_mesh_stats_get(). Requires
+  mesh_flash.c and nrf_flash.c in the build. */
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    /** @brief Page aligned start address of the RBC_MESH_PERSISTENT_FLASH_PAGES
+      flash pages reserved for the value log. Must be outside the
+      application and bootloader. */
+    #ifndef RBC_MESH_PERSISTENT_FLASH_ADDR
+        #error "RBC_MESH_PERSISTENT_FLASH_ADDR must be defined to use RBC_MESH_PERSISTENT_STORAGE"
+    #endif
+    /** @brief Number of value updates that can wait for their flash write.
+      Updates to a handle that's already waiting replace the waiting value. */
+    #ifndef RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH
+        #define RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH  (4)
+    #endif
+    /** @brief Number of flash pages the value log rotates through. Each
+      compaction moves the log to the next page, so the erases are spread
+      over all of them. */
+    #ifndef RBC_MESH_PERSISTENT_FLASH_PAGES
+        #define RBC_MESH_PERSISTENT_FLASH_PAGES         (2)
+    #endif
+    #if (RBC_MESH_PERSISTENT_FLASH_PAGES < 2)
+        #error "RBC_MESH_PERSISTENT_FLASH_PAGES must be at least 2"
+    #endif
+    /** @brief Percentage of the free log space that may be used by appends
+      before the log is compacted in the background, while the flash is
+      otherwise idle. */
+    #ifndef RBC_MESH_PERSISTENT_COMPACT_THRESHOLD
+        #define RBC_MESH_PERSISTENT_COMPACT_THRESHOLD   (75)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_RETAINED_RAM to keep a copy of the cached values
+  and their versions in a RAM area that survives soft resets, such as the
+  NVIC_SystemReset() after a DFU, a watchdog reset or a reset from a fault
+  handler. rbc_mesh_init() restores the values if the CRC protected header of
+  the area checks out, so the node comes back with the versions its neighbors
+  have, instead of relearning all values and setting off Trickle resets
+  across the mesh. After a power-on reset the area is started over. */
+#ifdef RBC_MESH_RETAINED_RAM
+    /** @brief Word aligned start address of the RBC_MESH_RETAINED_RAM_SIZE
+      bytes of RAM reserved for the copy. Must be left out of the RAM region
+      of the linker script, so the startup code doesn't clear it. */
+    #ifndef RBC_MESH_RETAINED_RAM_ADDR
+        #error "RBC_MESH_RETAINED_RAM_ADDR must be defined to use RBC_MESH_RETAINED_RAM"
+    #endif
+    /** @brief Size of the retained area in bytes. After the 12 byte area
+      header, each value takes 8 bytes and RBC_MESH_RETAINED_VALUE_MAX_LEN
+      rounded up to an even number. Values that don't fit are relearned from
+      the neighbors after a reset. */
+    #ifndef RBC_MESH_RETAINED_RAM_SIZE
+        #define RBC_MESH_RETAINED_RAM_SIZE          (1024)
+    #endif
+    /** @brief Longest value that is retained. */
+    #ifndef RBC_MESH_RETAINED_VALUE_MAX_LEN
+        #define RBC_MESH_RETAINED_VALUE_MAX_LEN     (RBC_MESH_LEGACY_VALUE_MAX_LEN)
+    #endif
+    #if (RBC_MESH_RETAINED_VALUE_MAX_LEN > RBC_MESH_VALUE_MAX_LEN)
+        #error "RBC_MESH_RETAINED_VALUE_MAX_LEN can't be longer than RBC_MESH_VALUE_MAX_LEN"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_AGGREGATED_TX to pack several short values that are
+  due for transmission at the same time into a single advertisement packet, as
+  separate mesh AD structures. Aggregated packets are always accepted on
+  reception, regardless of this flag. */
+
+/** @brief Define RBC_MESH_ENCRYPTION to encrypt and authenticate all
+  application values on air with the AES-CCM peripheral, see
+  rbc_mesh_encryption_key_set(). Values are shortened to 15 bytes to make room
+  for the sequence number and MIC in the advertisement. Application values
+  received in clear, or failing the MIC check, are dropped and counted in
+  rbc_mesh_stats_t::rx_auth_fail. DFU and other mesh maintenance packets are
+  still sent in clear. */
+#ifdef RBC_MESH_ENCRYPTION
+    /** @brief Number of senders to keep a sequence number window for, to
+      reject replayed packets. Every node relaying values counts as a sender,
+      the least recently heard sender is forgotten when the cache is full.
+      Each entry takes 24 bytes. */
+    #ifndef RBC_MESH_REPLAY_CACHE_ENTRIES
+        #define RBC_MESH_REPLAY_CACHE_ENTRIES       (16)
+    #endif
+    /** @brief Number of slots in the replay cache hash index. Must be a power
+      of two, larger than RBC_MESH_REPLAY_CACHE_ENTRIES, and at most 256. */
+    #ifndef RBC_MESH_REPLAY_INDEX_SIZE
+        #define RBC_MESH_REPLAY_INDEX_SIZE          (32)
+    #endif
+    /** @brief Time a sender can be quiet before its window starts over, in
+      microseconds. Lets a rebooted node, with a new sequence number, back in. */
+    #ifndef RBC_MESH_REPLAY_STALE_US
+        #define RBC_MESH_REPLAY_STALE_US            (10000000)
+    #endif
+    #if (RBC_MESH_REPLAY_INDEX_SIZE <= RBC_MESH_REPLAY_CACHE_ENTRIES) || \
+        (RBC_MESH_REPLAY_INDEX_SIZE & (RBC_MESH_REPLAY_INDEX_SIZE - 1)) || \
+        (RBC_MESH_REPLAY_INDEX_SIZE > 256)
+        #error "RBC_MESH_REPLAY_INDEX_SIZE must be a power of two, larger than RBC_MESH_REPLAY_CACHE_ENTRIES and at most 256"
+    #endif
+#endif
+/** @brief Define RBC_MESH_ACK to enable the acknowledged delivery service,
+  see rbc_mesh_ack_init(). */
+#ifdef RBC_MESH_ACK
+    /** @brief Time to wait for an acknowledgement before a message is sent
+      again, in milliseconds. */
+    #ifndef RBC_MESH_ACK_TIMEOUT_MS
+        #define RBC_MESH_ACK_TIMEOUT_MS             (500)
+    #endif
+    /** @brief Number of times a message is sent again before it's reported
+      as failed. */
+    #ifndef RBC_MESH_ACK_RETRIES
+        #define RBC_MESH_ACK_RETRIES                (3)
+    #endif
+    /** @brief Time a receiver collects acknowledgements before it updates its
+      acknowledgement value, in milliseconds. Acknowledgements to several
+      senders in this time go out in the same update. */
+    #ifndef RBC_MESH_ACK_DELAY_MS
+        #define RBC_MESH_ACK_DELAY_MS               (10)
+    #endif
+    /** @brief Number of senders a receiver remembers the last message of, to
+      acknowledge them and drop repeated messages. */
+    #ifndef RBC_MESH_ACK_SOURCES
+        #define RBC_MESH_ACK_SOURCES                (8)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_BRIDGE to let the node forward values between two
+  of the meshes it runs, see rbc_mesh_bridge_add(). */
+#ifdef RBC_MESH_BRIDGE
+    /** @brief Number of entries in the bridge filter table. */
+    #ifndef RBC_MESH_BRIDGE_ENTRIES_MAX
+        #define RBC_MESH_BRIDGE_ENTRIES_MAX         (4)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_VALUE_GROUPS to version related values together,
+  and send them in a single value, see rbc_mesh_group_add(). */
+#ifdef RBC_MESH_VALUE_GROUPS
+    /** @brief Number of value groups. */
+    #ifndef RBC_MESH_GROUPS_MAX
+        #define RBC_MESH_GROUPS_MAX                 (4)
+    #endif
+    /** @brief Highest number of components in a value group. */
+    #ifndef RBC_MESH_GROUP_COMPONENTS_MAX
+        #define RBC_MESH_GROUP_COMPONENTS_MAX       (4)
+    #endif
+    #if (RBC_MESH_GROUP_COMPONENTS_MAX > RBC_MESH_VALUE_MAX_LEN)
+        #error "The length bytes of RBC_MESH_GROUP_COMPONENTS_MAX components must fit in a value"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TIME_SERIES to batch timestamped samples into
+  delta encoded values, see rbc_mesh_series_enable(). */
+#ifdef RBC_MESH_TIME_SERIES
+    /** @brief Number of time series handles. */
+    #ifndef RBC_MESH_SERIES_MAX
+        #define RBC_MESH_SERIES_MAX                 (4)
+    #endif
+#endif
+
+/** @brief Highest number of samples in a time series value, when every
+  sample after the first takes the shortest encoding of two bytes. */
+#define RBC_MESH_SERIES_SAMPLES_MAX                 (1 + (RBC_MESH_VALUE_MAX_LEN - 3) / 2)
+
+/** @brief Define RBC_MESH_VALUE_SHADOW to keep a copy of selected values
+  that rbc_mesh_value_get() reads without masking the mesh, see
+  rbc_mesh_value_shadow_add(). */
+#ifdef RBC_MESH_VALUE_SHADOW
+    /** @brief Number of shadowed values. */
+    #ifndef RBC_MESH_VALUE_SHADOW_ENTRIES
+        #define RBC_MESH_VALUE_SHADOW_ENTRIES       (8)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_SCHEDULED_VALUES to have selected values take
+  effect at a given mesh time on all nodes, rather than when they arrive, see
+  rbc_mesh_value_set_at(). Requires RBC_MESH_TIME_SYNC. */
+#ifdef RBC_MESH_SCHEDULED_VALUES
+    #ifndef RBC_MESH_TIME_SYNC
+        #error "RBC_MESH_SCHEDULED_VALUES requires RBC_MESH_TIME_SYNC"
+    #endif
+    /** @brief Length of the activation time in front of scheduled values. */
+    #define RBC_MESH_SCHEDULE_OVERHEAD              (4)
+    /** @brief Number of handles carrying scheduled values. */
+    #ifndef RBC_MESH_SCHEDULED_HANDLES_MAX
+        #define RBC_MESH_SCHEDULED_HANDLES_MAX      (4)
+    #endif
+    /** @brief Longest time ahead a value can be scheduled, in microseconds.
+      Values received with an activation time further ahead, or in the past,
+      take effect at once. */
+    #ifndef RBC_MESH_SCHEDULE_MAX_AHEAD_US
+        #define RBC_MESH_SCHEDULE_MAX_AHEAD_US      (60000000)
+    #endif
+    #if (RBC_MESH_SCHEDULE_MAX_AHEAD_US > 0x7FFFFFFF)
+        #error "RBC_MESH_SCHEDULE_MAX_AHEAD_US must be less than half the mesh time range"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_VALUE_HISTORY to keep the last versions of selected
+  values, for hosts catching up on the updates they missed, see
+  rbc_mesh_value_history_enable(). */
+#ifdef RBC_MESH_VALUE_HISTORY
+    /** @brief Number of handles with a history. */
+    #ifndef RBC_MESH_VALUE_HISTORY_HANDLES_MAX
+        #define RBC_MESH_VALUE_HISTORY_HANDLES_MAX  (4)
+    #endif
+    /** @brief Number of versions kept per handle. */
+    #ifndef RBC_MESH_VALUE_HISTORY_DEPTH
+        #define RBC_MESH_VALUE_HISTORY_DEPTH        (8)
+    #endif
+    #if (RBC_MESH_VALUE_HISTORY_DEPTH < 1 || RBC_MESH_VALUE_HISTORY_DEPTH > 255)
+        #error "RBC_MESH_VALUE_HISTORY_DEPTH must be in the range 1-255"
+    #endif
+#endif
+
+#define RBC_MESH_ACK_MSG_OVERHEAD                   (3) /**< Destination and sequence number in front of each acknowledged message. */
+#define RBC_MESH_ACK_MSG_MAX_LEN                    (RBC_MESH_LEGACY_VALUE_MAX_LEN - RBC_MESH_ACK_MSG_OVERHEAD) /**< Longest acknowledged message. */
+
+/** @brief Define RBC_MESH_CONFLICT_RESOLUTION to settle two payloads
+  published with the same version in the framework, instead of raising
+  @ref RBC_MESH_EVENT_TYPE_CONFLICTING_VAL. Every node keeps the same winner,
+  and the losing nodes take it as an @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL with
+  a version_delta of 0, see rbc_mesh_conflict_resolver_set(). */
+
+/** @brief Define RBC_MESH_VALUE_FINGERPRINT to keep a 16 bit fingerprint of
+  the payload of values whose data cache entry gets evicted. Copies of the
+  same version heard later are checked against it, so a conflicting payload
+  is recognized without the value being cached, and matching copies are
+  taken as consistent without allocating a data entry. Takes two bytes per
+  handle cache entry. */
+
+/** @brief Define RBC_MESH_RX_HOOKS to let the application react to new
+  versions of a handle right in the mesh context, without waiting for the
+  application event queue, see rbc_mesh_rx_hook_set(). Meant for simple
+  actuators, like setting a GPIO from a value. */
+#ifdef RBC_MESH_RX_HOOKS
+    /** @brief Number of handles that can have a hook at the same time. */
+    #ifndef RBC_MESH_RX_HOOKS_MAX
+        #define RBC_MESH_RX_HOOKS_MAX               (4)
+    #endif
+    /** @brief Longest time a hook may take, in microseconds. A hook that
+      takes longer is removed. */
+    #ifndef RBC_MESH_RX_HOOK_BUDGET_US
+        #define RBC_MESH_RX_HOOK_BUDGET_US          (100)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_DFU_QOS to keep DFU transfers from crowding out
+  the application values. While values are being sent, DFU packets only get
+  their share of the airtime, and never fill the last radio queue slots, see
+  rbc_mesh_dfu_share_set(). Requires MESH_DFU. */
+#ifdef RBC_MESH_DFU_QOS
+    /** @brief Default share of the airtime DFU packets may take while
+      values are being sent, in percent. */
+    #ifndef RBC_MESH_DFU_SHARE_PERCENT
+        #define RBC_MESH_DFU_SHARE_PERCENT          (30)
+    #endif
+    /** @brief Length of the window the airtime of each kind of packet is
+      measured over. The value traffic of the last window counts as demand
+      in the current one. */
+    #ifndef RBC_MESH_DFU_QOS_WINDOW_US
+        #define RBC_MESH_DFU_QOS_WINDOW_US          (200000)
+    #endif
+    /** @brief Number of radio queue slots DFU packets may not take. */
+    #ifndef RBC_MESH_DFU_QOS_RADIO_RESERVE
+        #define RBC_MESH_DFU_QOS_RADIO_RESERVE      (3)
+    #endif
+    #if (RBC_MESH_DFU_SHARE_PERCENT < 1 || RBC_MESH_DFU_SHARE_PERCENT > 100)
+        #error "RBC_MESH_DFU_SHARE_PERCENT must be between 1 and 100"
+    #endif
+    #if (RBC_MESH_DFU_QOS_RADIO_RESERVE + 3 > RBC_MESH_RADIO_QUEUE_LENGTH)
+        #error "RBC_MESH_DFU_QOS_RADIO_RESERVE must leave room for a DFU packet on all three channels"
+    #endif
+#endif
+
+/** @brief Number of times a new version of an urgent value is sent before
+  it falls back to Trickle, see rbc_mesh_urgent_flag_set(). */
+#ifndef RBC_MESH_URGENT_BURST_COUNT
+    #define RBC_MESH_URGENT_BURST_COUNT             (3)
+#endif
+/** @brief Time between the transmissions in an urgent burst, in microseconds.
+  A relay sends its first transmission of a new urgent version within this
+  time of receiving it, the local node sends it right away. */
+#ifndef RBC_MESH_URGENT_BURST_INTERVAL_US
+    #define RBC_MESH_URGENT_BURST_INTERVAL_US       (10000)
+#endif
+#if (RBC_MESH_URGENT_BURST_COUNT > 255)
+    #error "RBC_MESH_URGENT_BURST_COUNT must be at most 255"
+#endif
+
+/** @brief Define RBC_MESH_HANDLE_STATS to count transmissions, receptions and
+  Trickle resets for each value in the data cache, see
+  rbc_mesh_handle_stats_get(). Takes 8 bytes of RAM per data cache entry. */
+
+/** @brief Define RBC_MESH_VALUE_TTL to let values expire when they haven't
+  been updated for a while, see rbc_mesh_value_ttl_set(). Expired values are
+  no longer transmitted, and their data cache entries are freed. */
+#ifdef RBC_MESH_VALUE_TTL
+    /** @brief Resolution of the value time-to-live in ms. The values are
+      checked for expiry once every tick. */
+    #ifndef RBC_MESH_VALUE_TTL_TICK_MS
+        #define RBC_MESH_VALUE_TTL_TICK_MS          (1000)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_WRITE_COMBINING to let rapid local updates of a
+  value share a version, see rbc_mesh_write_combine_set(). */
+#ifdef RBC_MESH_WRITE_COMBINING
+    #ifdef RBC_MESH_DELTA_UPDATES
+        #error "RBC_MESH_WRITE_COMBINING can't be combined with RBC_MESH_DELTA_UPDATES"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_NEIGHBOR_TABLE to keep track of the nodes this node
+  hears directly, with their signal strength, see rbc_mesh_neighbor_get(). */
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+    /** @brief Number of neighbors in the table. When the table is full, the
+      neighbor that has been quiet for the longest is replaced. Takes 20 bytes
+      of RAM per entry. */
+    #ifndef RBC_MESH_NEIGHBOR_TABLE_SIZE
+        #define RBC_MESH_NEIGHBOR_TABLE_SIZE        (16)
+    #endif
+    /** @brief Weight of each new RSSI sample in the neighbor RSSI average, as
+      a power of two: the average moves 1/2^n of the way towards every new
+      sample. */
+    #ifndef RBC_MESH_NEIGHBOR_RSSI_WEIGHT_SHIFT
+        #define RBC_MESH_NEIGHBOR_RSSI_WEIGHT_SHIFT (3)
+    #endif
+    #if (RBC_MESH_NEIGHBOR_TABLE_SIZE == 0) || (RBC_MESH_NEIGHBOR_TABLE_SIZE > 255)
+        #error "RBC_MESH_NEIGHBOR_TABLE_SIZE must be between 1 and 255"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TX_POWER_CONTROL to let the framework pick the TX
+  power from the neighbor table, see rbc_mesh_tx_power_control_set().
+  Requires RBC_MESH_NEIGHBOR_TABLE. */
+#ifdef RBC_MESH_TX_POWER_CONTROL
+    #ifndef RBC_MESH_NEIGHBOR_TABLE
+        #error "RBC_MESH_TX_POWER_CONTROL requires RBC_MESH_NEIGHBOR_TABLE"
+    #endif
+    /** @brief Time between two TX power adjustments, in milliseconds.
+      Neighbors that haven't been heard for three intervals are left out. */
+    #ifndef RBC_MESH_TX_POWER_CONTROL_INTERVAL_MS
+        #define RBC_MESH_TX_POWER_CONTROL_INTERVAL_MS   (5000)
+    #endif
+    /** @brief Number of neighbors that must be kept in range, for redundancy. */
+    #ifndef RBC_MESH_TX_POWER_CONTROL_NEIGHBORS
+        #define RBC_MESH_TX_POWER_CONTROL_NEIGHBORS     (3)
+    #endif
+    /** @brief Weakest RSSI the neighbors should receive this node at, in dBm. */
+    #ifndef RBC_MESH_TX_POWER_CONTROL_RSSI_TARGET
+        #define RBC_MESH_TX_POWER_CONTROL_RSSI_TARGET   (-80)
+    #endif
+    /** @brief Headroom above the RSSI target required before the power is
+      lowered, in dB. Keeps the power from toggling between two levels. */
+    #ifndef RBC_MESH_TX_POWER_CONTROL_MARGIN_DB
+        #define RBC_MESH_TX_POWER_CONTROL_MARGIN_DB     (6)
+    #endif
+    #if (RBC_MESH_TX_POWER_CONTROL_NEIGHBORS == 0) || (RBC_MESH_TX_POWER_CONTROL_NEIGHBORS > RBC_MESH_NEIGHBOR_TABLE_SIZE)
+        #error "RBC_MESH_TX_POWER_CONTROL_NEIGHBORS must be between 1 and RBC_MESH_NEIGHBOR_TABLE_SIZE"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TRICKLE_AUTO_TUNE to let the framework adjust the
+  Trickle parameters to the density of the mesh, see
+  rbc_mesh_trickle_auto_tune_set(). Requires RBC_MESH_NEIGHBOR_TABLE. */
+#ifdef RBC_MESH_TRICKLE_AUTO_TUNE
+    #ifndef RBC_MESH_NEIGHBOR_TABLE
+        #error "RBC_MESH_TRICKLE_AUTO_TUNE requires RBC_MESH_NEIGHBOR_TABLE"
+    #endif
+    /** @brief Time between two adjustments, in milliseconds. Neighbors that
+      haven't been heard for three intervals are left out. */
+    #ifndef RBC_MESH_TRICKLE_AUTO_TUNE_INTERVAL_MS
+        #define RBC_MESH_TRICKLE_AUTO_TUNE_INTERVAL_MS  (10000)
+    #endif
+    /** @brief Number of neighbors at or below which the mesh is considered
+      sparse, and the Trickle redundancy constant is at its highest. */
+    #ifndef RBC_MESH_TRICKLE_AUTO_TUNE_SPARSE_NEIGHBORS
+        #define RBC_MESH_TRICKLE_AUTO_TUNE_SPARSE_NEIGHBORS (2)
+    #endif
+    /** @brief Number of neighbors at or above which the mesh is considered
+      dense, and the Trickle redundancy constant is 1. */
+    #ifndef RBC_MESH_TRICKLE_AUTO_TUNE_DENSE_NEIGHBORS
+        #define RBC_MESH_TRICKLE_AUTO_TUNE_DENSE_NEIGHBORS  (8)
+    #endif
+    /** @brief Highest Trickle redundancy constant picked. */
+    #ifndef RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX
+        #define RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX        (4)
+    #endif
+    /** @brief Number of times the maximum Trickle interval may be doubled or
+      halved from the configured one. */
+    #ifndef RBC_MESH_TRICKLE_AUTO_TUNE_I_MAX_SHIFT
+        #define RBC_MESH_TRICKLE_AUTO_TUNE_I_MAX_SHIFT  (2)
+    #endif
+    #if (RBC_MESH_TRICKLE_AUTO_TUNE_SPARSE_NEIGHBORS >= RBC_MESH_TRICKLE_AUTO_TUNE_DENSE_NEIGHBORS)
+        #error "RBC_MESH_TRICKLE_AUTO_TUNE_SPARSE_NEIGHBORS must be below RBC_MESH_TRICKLE_AUTO_TUNE_DENSE_NEIGHBORS"
+    #endif
+    #if (RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX == 0) || (RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX >= 0xFF)
+        #error "RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX must be between 1 and 254"
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_HEALTH_MONITOR to let the framework check its own
+  statistics against thresholds, and tell the application when the node gets
+  overloaded, see rbc_mesh_health_threshold_set(). */
+#ifdef RBC_MESH_HEALTH_MONITOR
+    /** @brief Time between two checks, in milliseconds. The thresholds are
+      counted per check. */
+    #ifndef RBC_MESH_HEALTH_INTERVAL_MS
+        #define RBC_MESH_HEALTH_INTERVAL_MS             (10000)
+    #endif
+    /** @brief Propagation delay above which a new version counts as late for
+      @ref RBC_MESH_HEALTH_LATE_VERSIONS, in milliseconds. */
+    #ifndef RBC_MESH_HEALTH_LATENCY_SLO_MS
+        #define RBC_MESH_HEALTH_LATENCY_SLO_MS          (1000)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_APP_COMMAND_QUEUE to let the application queue
+  value updates and reads to the mesh without masking interrupts, see
+  rbc_mesh_value_set_async() and rbc_mesh_value_get_async(). */
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+    /** @brief Length of the application command queue. Must be power of two. */
+    #ifndef RBC_MESH_APP_COMMAND_QUEUE_LENGTH
+        #define RBC_MESH_APP_COMMAND_QUEUE_LENGTH   (8)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_TX_NOTIFY to have value updates report their
+  transmissions through a future, see rbc_mesh_value_set_notify(). */
+#ifdef RBC_MESH_TX_NOTIFY
+    /** @brief Number of updates that can wait for their transmissions at once. */
+    #ifndef RBC_MESH_TX_NOTIFY_MAX
+        #define RBC_MESH_TX_NOTIFY_MAX              (4)
+    #endif
+#endif
+
+#if defined(RBC_MESH_ENCRYPTION) && defined(RBC_MESH_AGGREGATED_TX)
+    #error "RBC_MESH_ENCRYPTION only supports a single value per packet, and can't be combined with RBC_MESH_AGGREGATED_TX"
+#endif
+
+/** @brief Define RBC_MESH_TRACE to stream timestamped enter and exit records
+  for the framework hot paths over RTT, see mesh_trace.h. Requires
+  SEGGER_RTT.c in the build. */
+#ifdef RBC_MESH_TRACE
+    /** @brief RTT up-buffer index used for the trace. Buffer 0 is left for
+      terminal output. */
+    #ifndef RBC_MESH_TRACE_RTT_CHANNEL
+        #define RBC_MESH_TRACE_RTT_CHANNEL          (1)
+    #endif
+    /** @brief Size of the RTT trace buffer in bytes. Each record takes 8
+      bytes. */
+    #ifndef RBC_MESH_TRACE_BUFFER_SIZE
+        #define RBC_MESH_TRACE_BUFFER_SIZE          (1024)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_LOG to queue binary log records with MESH_LOG(), and
+  write them to RTT from the main loop with MESH_LOG_FLUSH(), see mesh_log.h.
+  Requires SEGGER_RTT.c in the build. */
+#ifdef RBC_MESH_LOG
+    /** @brief RTT up-buffer index used for the log. Buffer 0 is left for
+      terminal output, and buffer 1 for the trace. */
+    #ifndef RBC_MESH_LOG_RTT_CHANNEL
+        #define RBC_MESH_LOG_RTT_CHANNEL            (2)
+    #endif
+    /** @brief Number of records the log queue holds between two flushes.
+      Each record takes 16 bytes. Must be a power of two. */
+    #ifndef RBC_MESH_LOG_QUEUE_LENGTH
+        #define RBC_MESH_LOG_QUEUE_LENGTH           (32)
+    #endif
+    /** @brief Size of the RTT log buffer in bytes. */
+    #ifndef RBC_MESH_LOG_BUFFER_SIZE
+        #define RBC_MESH_LOG_BUFFER_SIZE            (512)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_ISR_STATS to time the radio, timer, event and serial
+  interrupt handlers, see rbc_mesh_isr_stats_get(). Handlers are only timed
+  in timeslots, as the timer stops between them. */
+#ifdef RBC_MESH_ISR_STATS
+    /** @brief Upper limit of the first histogram bucket, in microseconds.
+      Each of the following buckets is twice as wide as the one before. */
+    #ifndef RBC_MESH_ISR_HIST_FIRST_US
+        #define RBC_MESH_ISR_HIST_FIRST_US          (16)
+    #endif
+#endif
+
+/** @brief Define RBC_MESH_STACK_WATERMARK to paint the stack in
+  rbc_mesh_init() and report the peak stack usage in rbc_mesh_ram_stats_get().
+  The stack bounds are taken from the ARMCC STACK section or the GCC
+  __StackLimit and __StackTop symbols of the startup files. */
+
+#if (RBC_MESH_HANDLE_CACHE_ENTRIES < RBC_MESH_DATA_CACHE_ENTRIES)
+    #error "The number of handle cache entries cannot be lower than the number of data entries"
+#endif
+
+#if (RBC_MESH_PINNED_DATA_ENTRIES > RBC_MESH_DATA_CACHE_ENTRIES)
+    #error "The number of pinned data entries cannot be higher than the number of data entries"
+#endif
+
+#ifdef RBC_MESH_STATIC_HANDLES
+    #if (RBC_MESH_STATIC_HANDLE_COUNT == 0)
+        #error "The static handle list can't be empty"
+    #endif
+#else
+    #if (RBC_MESH_HANDLE_INDEX_SIZE <= RBC_MESH_HANDLE_CACHE_ENTRIES)
+        #error "The handle index must have more slots than there are handle cache entries"
+    #endif
+
+    #if (RBC_MESH_HANDLE_INDEX_SIZE & (RBC_MESH_HANDLE_INDEX_SIZE - 1))
+        #error "The handle index size must be a power of two"
+    #endif
+#endif
+
+/**
+* @brief Rebroadcast value handle type
+*
+* @detailed Handle type used to identify a value in the mesh, is consistent
+*   throughout the network
+*/
+typedef uint16_t rbc_mesh_value_handle_t;
+
+/** @brief Event type enum. Identifies framework generated events */
+typedef enum
+{
+    RBC_MESH_EVENT_TYPE_UPDATE_VAL,             /**< Another node has updated the value. Parameters in rx sub-structure. */
+    RBC_MESH_EVENT_TYPE_CONFLICTING_VAL,        /**< Another node has a conflicting version of the value. Parameters in rx sub-structure.  */
+    RBC_MESH_EVENT_TYPE_NEW_VAL,                /**< A previously unallocated value has been received and allocated. Parameters in rx sub-structure. */
+    RBC_MESH_EVENT_TYPE_INITIALIZED,            /**< The framework has been initialized internally (most likely via serial interface). No parameters. */
+    RBC_MESH_EVENT_TYPE_TX,                     /**< The indicated handle was transmitted. Parameters in tx sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_NEW_FW_AVAILABLE,   /**< The dfu module has detected that a newer version of the current firmware is available. Parameters in dfu.new_fw sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_RELAY_REQ,          /**< A DFU transfer is about to start in the network, and our device is able to act as a relay. Parameters in dfu.relay_req sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_SOURCE_REQ,         /**< A DFU transfer is about to start in the network, and our device is able to act as a source. Parameters in dfu.source_req sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_START,              /**< The dfu module has started its target role. Parameters in dfu.start sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_END,                /**< The dfu module has ended its target role. Paramters in dfu.end sub-structure. */
+    RBC_MESH_EVENT_TYPE_DFU_BANK_AVAILABLE,     /**< The dfu module found a bank available for flashing. Parameters in dfu.bank sub-structure. */
+    RBC_MESH_EVENT_TYPE_ACK_MSG,                /**< An acknowledged message to this node has been received. Parameters in ack sub-structure. */
+    RBC_MESH_EVENT_TYPE_ACK_DELIVERED,          /**< The message from rbc_mesh_ack_send() has been acknowledged. Parameters in ack sub-structure. */
+    RBC_MESH_EVENT_TYPE_ACK_FAILED,             /**< The message from rbc_mesh_ack_send() wasn't acknowledged after RBC_MESH_ACK_RETRIES attempts. Parameters in ack sub-structure. */
+    RBC_MESH_EVENT_TYPE_VALUE_EXPIRED,          /**< The value wasn't updated within its time-to-live, and has been dropped. Handle in rx.value_handle, no data. */
+    RBC_MESH_EVENT_TYPE_PROBE,                  /**< A latency probe to this node, or the reply to one of its probes, has been received. Parameters in probe sub-structure. */
+    RBC_MESH_EVENT_TYPE_HEALTH,                 /**< The health monitor raised or cleared an alarm. Parameters in health sub-structure. */
+} rbc_mesh_event_type_t;
+
+/** @brief Statistics watched by the health monitor, see
+  rbc_mesh_health_threshold_set(). Each one is counted per
+  RBC_MESH_HEALTH_INTERVAL_MS. */
+typedef enum
+{
+    RBC_MESH_HEALTH_APP_QUEUE_DROP,             /**< Application events dropped because the application event queue was full. */
+    RBC_MESH_HEALTH_INTERNAL_QUEUE_DROP,        /**< Internal async events dropped because the event queue was full. */
+    RBC_MESH_HEALTH_RX_QUEUE_DROP,              /**< Received packets dropped because the RX queue was full. */
+    RBC_MESH_HEALTH_TX_QUEUE_DROP,              /**< Transmissions dropped because the radio queue was full. */
+    RBC_MESH_HEALTH_POOL_EXHAUSTED,             /**< Packet allocations that failed because the packet pool was empty. */
+    RBC_MESH_HEALTH_TIMESLOT_DENIED,            /**< Timeslot requests and extensions that were denied, blocked or canceled. */
+    RBC_MESH_HEALTH_LATE_VERSIONS,              /**< New versions that took longer than RBC_MESH_HEALTH_LATENCY_SLO_MS to get here. Requires RBC_MESH_ORIGIN_TIME. */
+    RBC_MESH_HEALTH_METRIC_COUNT
+} rbc_mesh_health_metric_t;
+
+/** @brief Length of the health report published on the handle set with
+  rbc_mesh_health_handle_set(): the alarms, then the count of each metric,
+  all 16 bit little endian. */
+#define RBC_MESH_HEALTH_REPORT_LEN                  (2 + 2 * RBC_MESH_HEALTH_METRIC_COUNT)
+
+/** @brief Where the value in a value event was set. */
+typedef enum
+{
+    RBC_MESH_EVENT_SOURCE_MESH,                 /**< Received from another node in the mesh. */
+    RBC_MESH_EVENT_SOURCE_GATT,                 /**< Written by a GATT client connected to this node. */
+    RBC_MESH_EVENT_SOURCE_SERIAL,               /**< Set by the host over the serial interface. */
+    RBC_MESH_EVENT_SOURCE_LOCAL,                /**< Set by the framework on this node, like a scheduled value taking effect. */
+} rbc_mesh_event_source_t;
+
+#define RBC_MESH_EVENT_SOURCE_MASK_ALL              (0x0F) /**< All event sources, see @ref rbc_mesh_event_source_mask_set. */
+
+/** @brief The various states of the mesh framework. */
+typedef enum
+{
+    MESH_STATE_UNINITIALIZED,   /**< The mesh hasn't been initialized. */
+    MESH_STATE_RUNNING,         /**< The mesh is currently running as normal. */
+    MESH_STATE_STOPPED          /**< The mesh operation has been stopped. */
+} rbc_mesh_state_t;
+
+/** @brief A relay on the path of a latency probe. */
 typedef struct
 {
-    ble_gap_addr_t adv_addr;        /**< Advertisement address of the received packet. */
-    ble_packet_type_t packet_type;  /**< BLE packet type of the received packet. */
-    uint8_t rssi;                   /**< Negative RSSI value of the received packet. */
-    uint8_t payload_len;            /**< Length of p_payload. */
-    uint8_t* p_payload;             /**< Advertisement packet payload (not including advertisement address) */
-    uint32_t crc;                   /**< CRC value of the received packet. */
-    uint64_t timestamp;             /**< Timestamp of the received packet. */
-} rbc_mesh_packet_peek_params_t;
+    uint16_t node_id;                               /**< Node ID of the relay. */
+    uint16_t delay;                                 /**< Time from the relay received the probe until it passed it on, in RBC_MESH_PROBE_DELAY_UNIT_US. Saturates at 0xFFFF. */
+} rbc_mesh_probe_hop_t;
 
-/** @brief Function pointer type for packet peek callback. */
-typedef void (*rbc_mesh_packet_peek_cb_t)(rbc_mesh_packet_peek_params_t* p_peek_params);
+/** @brief A version of a value in its history. */
+typedef struct
+{
+    uint16_t version;                               /**< Version number of the value. */
+    uint8_t data_len;                               /**< Length of the value. */
+    uint32_t timestamp_us;                          /**< Time the version was stored, on the device clock. */
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];           /**< Contents of the value. */
+} rbc_mesh_history_entry_t;
 
-/*****************************************************************************
-     Interface Functions
-*****************************************************************************/
+/** @brief OpenMesh framework generated event. */
+typedef struct
+{
+    rbc_mesh_event_type_t type;                     /**< See @ref rbc_mesh_event_type_t */
+    union
+    {
+        struct
+        {
+            rbc_mesh_value_handle_t value_handle;   /**< Handle of the value the event is generated for. */
+            uint8_t* p_data;                        /**< Current data array contained at the event handle location. */
+            uint8_t data_len;                       /**< Length of data array. */
+            int8_t rssi;                            /**< RSSI of received data, in range of -100dBm to ~-40dBm. */
+            ble_gap_addr_t ble_adv_addr;            /**< Advertisement address of the device we got the update from. */
+            uint16_t version_delta;                 /**< Version number increase since last update. */
+            uint16_t version;                       /**< Version number of the value, or 0 for values set on this device, which get their version later. */
+            rbc_mesh_event_source_t source;         /**< Where the value was set. */
+            uint32_t timestamp_us;                  /**< Timestamp of the received packet, taken by the timer hardware when its access address was received. */
+#ifdef RBC_MESH_ORIGIN_TIME
+            uint16_t propagation_ms;                /**< Time from the version was set at its origin until it got here, or RBC_MESH_ORIGIN_TIME_NONE if the version has no origin time. */
+#endif
+#if (RBC_MESH_EVENT_INLINE_DATA_LEN > 0)
+            uint8_t inline_data[RBC_MESH_EVENT_INLINE_DATA_LEN]; /**< Copy of values up to RBC_MESH_EVENT_INLINE_DATA_LEN bytes long, p_data points here for those. */
+#endif
+        } rx;
+        struct
+        {
+            rbc_mesh_value_handle_t value_handle;   /**< Handle of the value the event is generated for. */
+            uint8_t* p_data;                        /**< Data array transmitted. */
+            uint8_t data_len;                       /**< Length of data array. */
+            uint16_t tx_count;                      /**< Number of transmissions the event stands for. More than 1 when merged with RBC_MESH_TX_EVENT_COALESCING, data and timestamp are then from the last one. */
+            uint32_t timestamp_us;                  /** Timestamp of the sent packet. */
+#if (RBC_MESH_EVENT_INLINE_DATA_LEN > 0)
+            uint8_t inline_data[RBC_MESH_EVENT_INLINE_DATA_LEN]; /**< Copy of values up to RBC_MESH_EVENT_INLINE_DATA_LEN bytes long, p_data points here for those. */
+#endif
+        } tx;
+        struct
+        {
+            uint16_t node_id;                       /**< Sender of a received message, or destination of a sent message. */
+            uint8_t seq;                            /**< Sequence number of the message. */
+            uint8_t* p_data;                        /**< Message contents, only for @ref RBC_MESH_EVENT_TYPE_ACK_MSG. */
+            uint8_t data_len;                       /**< Length of the message contents. */
+            uint32_t timestamp_us;                  /**< Time the message or acknowledgement was received. */
+            uint32_t rtt_us;                        /**< Time from the first transmission of the message to its acknowledgement, only for @ref RBC_MESH_EVENT_TYPE_ACK_DELIVERED. */
+#if (RBC_MESH_EVENT_INLINE_DATA_LEN > 0)
+            uint8_t inline_data[RBC_MESH_EVENT_INLINE_DATA_LEN]; /**< Copy of messages up to RBC_MESH_EVENT_INLINE_DATA_LEN bytes long, p_data points here for those. */
+#endif
+        } ack;
+        struct
+        {
+            uint16_t origin;                        /**< Node ID of the node that sent the probe. */
+            uint16_t target;                        /**< Node ID of the node the probe was sent to. */
+            uint8_t seq;                            /**< Sequence number of the probe. */
+            bool is_reply;                          /**< Whether this is the target's reply, received by the origin. */
+            uint8_t hop_count;                      /**< Number of relays the probe passed through on the way here. */
+            uint8_t hop_entries;                    /**< Number of relays listed in hops, at most RBC_MESH_PROBE_HOPS_MAX. */
+            rbc_mesh_probe_hop_t hops[RBC_MESH_PROBE_HOPS_MAX]; /**< The first relays on the way here, in order. */
+            uint32_t timestamp_us;                  /**< Time the probe was received. */
+            uint32_t latency_us;                    /**< Round trip time for replies. One-way latency for probes in builds with RBC_MESH_TIME_SYNC, 0 without. */
+        } probe;
+        struct
+        {
+            uint16_t alarms;                        /**< Metrics above their threshold in the last check, one bit per @ref rbc_mesh_health_metric_t. */
+            uint16_t raised;                        /**< Alarms that weren't set in the previous health event. */
+            uint16_t counts[RBC_MESH_HEALTH_METRIC_COUNT]; /**< Count of each metric in the last check, saturated at 0xFFFF. */
+            uint32_t timestamp_us;                  /**< Time of the check. */
+        } health;
+        union
+        {
+            struct
+            {
+                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
+                fwid_union_t new_fwid;              /**< Firmware ID of the new firmware. */
+                fwid_union_t current_fwid;          /**< ID of the firmware of the given type currently on the device. */
+            } new_fw;
+            struct
+            {
+                dfu_type_t dfu_type;                /**< DFU type of the transfer. */
+                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
+                uint8_t authority;                  /**< Authority level of the transfer. */
+            } relay_req;
+            struct
+            {
+                dfu_type_t dfu_type;                /**< DFU type of the transfer. */
+                fwid_union_t current_fwid;          /**< ID of the firmware of the given type currently on the device. */
+            } source_req;
+            struct
+            {
+                dfu_role_t role;                    /**< The device's role in the transfer. */
+                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
+                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
+            } start;
+            struct
+            {
+                dfu_role_t role;                    /**< The device's role in the transfer. */
+                dfu_type_t dfu_type;                /**< DFU type of the new firmware. */
+                fwid_union_t fwid;                  /**< Firmware ID of the transfer. */
+                dfu_end_t end_reason;               /**< Reason for the end event. */
+            } end;
+            struct
+            {
+                dfu_type_t dfu_type;                /**< DFU type of the bank. */
+                fwid_union_t fwid;                  /**< Firmware ID of the bank. */
+                uint32_t* p_start_addr;             /**< Start address of the bank. */
+                uint32_t length;                    /**< Length of the firmware in the bank. */
+                bool is_signed;                     /**< Flag indicating whether the bank is signed with an encryption key. */
+            } bank;
+        } dfu;
+    } params;
+} rbc_mesh_event_t;
+
+/** Radio TX power enum */
+typedef enum
+{
+    RBC_MESH_TXPOWER_0dBm     = 0x00UL, /**< 0dBm. */
+    RBC_MESH_TXPOWER_Pos4dBm  = 0x04UL, /**< +4dBm. */
+    RBC_MESH_TXPOWER_Neg30dBm = 0xD8UL, /**< -30dBm. */
+    RBC_MESH_TXPOWER_Neg20dBm = 0xECUL, /**< -20dBm. */
+    RBC_MESH_TXPOWER_Neg16dBm = 0xF0UL, /**< -16dBm. */
+    RBC_MESH_TXPOWER_Neg12dBm = 0xF4UL, /**< -12dBm. */
+    RBC_MESH_TXPOWER_Neg8dBm  = 0xF8UL, /**< -8dBm. */
+    RBC_MESH_TXPOWER_Neg4dBm  = 0xFCUL, /**< -4dBm. */
+} rbc_mesh_txpower_t;
+
+/** Radio mode enum, the on-air bit rate of the mesh. */
+typedef enum
+{
+    RBC_MESH_RADIO_MODE_BLE_1MBIT,  /**< BLE 1 Mbit, supported by all devices. */
+    RBC_MESH_RADIO_MODE_BLE_2MBIT,  /**< BLE 2 Mbit, half the airtime per packet. nRF52 only. */
+} rbc_mesh_radio_mode_t;
+
+/**
+* @brief Application supplied memory for the framework caches, app event queue
+*   and packet pool. Lets a single firmware image size the framework for its
+*   role at runtime. The packet pool is sized to fit the data cache and all
+*   queues. Use @ref rbc_mesh_memory_size_get() to find the arena size needed
+*   for a given configuration.
+*/
+typedef struct
+{
+    void* p_arena;                      /**< Word aligned memory, must stay valid as long as the framework runs. */
+    uint32_t arena_size;                /**< Size of the arena in bytes. */
+    uint16_t handle_cache_entries;      /**< Number of handle cache entries. Must be at least the number of data cache entries, 0 to use the same number. */
+    uint16_t data_cache_entries;        /**< Number of data cache entries, 0 to fit as many as the arena can hold. */
+    uint16_t app_event_queue_length;    /**< Length of the app event queue. Must be a power of two, or 0 in relay-only mode. */
+    uint16_t pinned_data_entries;       /**< Number of data cache entries reserved for persistent handles. See RBC_MESH_PINNED_DATA_ENTRIES. */
+} rbc_mesh_memory_t;
+
+/** @brief Inclusive range of value handles. */
+typedef struct
+{
+    rbc_mesh_value_handle_t first;  /**< First handle in the range. */
+    rbc_mesh_value_handle_t last;   /**< Last handle in the range. */
+} rbc_mesh_handle_range_t;
+
+/**
+* @brief Initialization parameter struct for the rbc_mesh_init() function.
+*
+* @param[in] access_addr The access address the mesh will work on. This must be the
+*    same for all nodes in the mesh. RBC_MESH_ACCESS_ADDRESS_BLE_ADV gives the mesh
+*    the same access address as regular BLE advertisements, which makes the
+*    traffic visible to external BLE devices (Note that other access addresses
+*    does not provide any data security, the traffic is merely ignored by
+*    regular BLE radios). Multiple meshes may in theory work concurrently in
+*    the same area with different access addresses, but will be prone to
+*    on-air collisions, and it is recommended to use separate channels for this.
+* @param[in] channel The BLE channel the mesh works on. It is strongly recommended
+*    to use one of the three adv channels 37, 38 or 39, as others may be prone
+*    to on-air collisions with WiFi channels. Separate meshes may work
+*    concurrently without packet collision if they are assigned to different
+*    channels. Must be between 1 and 39. Ignored if the framework is built with
+*    RBC_MESH_MULTICHANNEL.
+* @param[in] interval_min_ms The minimum tx interval for nodes in the network in
+*    millis. Must be between 5 and 60000.
+* @param[in] lfclksrc The LF-clock source parameter supplied to the
+*    softdevice_enable function.
+* @param[in] tx_power The transmit power used in the mesh. See @rbc_mesh_tx_power_t.
+* @param[in] p_memory Memory for the caches, the app event queue and the packet
+*    pool, or NULL to use the built-in ones. See @ref rbc_mesh_memory_t.
+* @param[in] relay_only Run the device as a relay, for infrastructure nodes
+*    that never consume values. No events are passed to the application, and
+*    the app event queue may be left out of p_memory, leaving its RAM and the
+*    packets it would hold to the caches. Local value updates still work.
+* @param[in] p_subscriptions Handle ranges the application wants value events
+*    for, or NULL to get events for all handles. Values outside the ranges
+*    are still stored and relayed as usual, but don't raise
+*    @ref RBC_MESH_EVENT_TYPE_NEW_VAL, @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL,
+*    @ref RBC_MESH_EVENT_TYPE_CONFLICTING_VAL or
+*    @ref RBC_MESH_EVENT_TYPE_VALUE_EXPIRED events. The array must stay valid
+*    as long as the framework runs. Use @ref rbc_mesh_rx_filter_set() to
+*    stop relaying values as well.
+* @param[in] subscription_count Number of ranges in p_subscriptions.
+* @param[in] radio_mode The on-air bit rate of the mesh. See
+*    @ref rbc_mesh_radio_mode_t. Nodes in different modes can't hear each
+*    other, so this must be the same for all nodes in the mesh. The 2 Mbit
+*    mode halves the airtime of each packet, but is only available on the
+*    nRF52, and with a slightly shorter range.
+*/
+typedef struct
+{
+    uint32_t access_addr;
+    uint8_t channel;
+    uint32_t interval_min_ms;
+#if (NORDIC_SDK_VERSION >= 11)
+	nrf_clock_lf_cfg_t lfclksrc;
+#else
+	nrf_clock_lfclksrc_t lfclksrc;
+#endif
+    rbc_mesh_txpower_t tx_power;
+    const rbc_mesh_memory_t* p_memory;
+    bool relay_only;
+    const rbc_mesh_handle_range_t* p_subscriptions;
+    uint8_t subscription_count;
+    rbc_mesh_radio_mode_t radio_mode;
+} rbc_mesh_init_params_t;
+
+typedef enum
+{
+    BLE_PACKET_TYPE_ADV_IND,
+    BLE_PACKET_TYPE_ADV_DIRECT_IND,
+    BLE_PACKET_TYPE_ADV_NONCONN_IND,
+    BLE_PACKET_TYPE_SCAN_REQ,
+    BLE_PACKET_TYPE_SCAN_RSP,
+    BLE_PACKET_TYPE_CONN_REQ,
+    BLE_PACKET_TYPE_ADV_DISCOVER_IND
+} ble_packet_type_t;
+
+/** @brief Packet peek callback parameters. */
+typedef struct
+{
+    ble_gap_addr_t adv_addr;        /**< Advertisement address of the received packet. */
+    ble_packet_type_t packet_type;  /**< BLE packet type of the received packet. */
+    uint8_t rssi;                   /**< Negative RSSI value of the received packet. */
+    uint8_t payload_len;            /**< Length of p_payload. */
+    uint8_t* p_payload;             /**< Advertisement packet payload (not including advertisement address) */
+    uint32_t crc;                   /**< CRC value of the received packet. */
+    uint64_t timestamp;             /**< Timestamp of the received packet. */
+} rbc_mesh_packet_peek_params_t;
+
+/** @brief Function pointer type for packet peek callback. */
+typedef void (*rbc_mesh_packet_peek_cb_t)(rbc_mesh_packet_peek_params_t* p_peek_params);
+
+/** @brief RX filter modes, see rbc_mesh_rx_filter_set(). */
+typedef enum
+{
+    RBC_MESH_RX_FILTER_OFF,     /**< All mesh packets are processed. */
+    RBC_MESH_RX_FILTER_ACCEPT,  /**< Only values in the given handle ranges are processed. */
+    RBC_MESH_RX_FILTER_REJECT   /**< Values in the given handle ranges are dropped. */
+} rbc_mesh_rx_filter_mode_t;
+
+/** @brief Parameters of the acknowledged delivery service, see
+  rbc_mesh_ack_init(). All nodes must use the same handle ranges. */
+typedef struct
+{
+    uint16_t node_id;                           /**< ID of this node, unique among the nodes of the service. */
+    uint16_t node_count;                        /**< Number of node IDs, from 0 to node_count - 1. */
+    rbc_mesh_value_handle_t msg_handle_base;    /**< Node n sends its messages on handle msg_handle_base + n. */
+    rbc_mesh_value_handle_t ack_handle_base;    /**< Node n acknowledges messages on handle ack_handle_base + n. */
+} rbc_mesh_ack_params_t;
+
+/** @brief Parameters of an extra mesh instance, see rbc_mesh_instance_add(). */
+typedef struct
+{
+    uint32_t access_addr;           /**< Access address of the instance. Must share the three low bytes with the primary access address. */
+    rbc_mesh_handle_range_t handles; /**< Handles that belong to the instance. */
+    uint8_t trickle_class;          /**< Trickle parameter class of the values in the instance. */
+} rbc_mesh_instance_params_t;
+
+/** @brief Direction of the values crossing a bridge, see rbc_mesh_bridge_add(). */
+typedef enum
+{
+    RBC_MESH_BRIDGE_DIR_TO_PEER,    /**< Values are forwarded from the handles to the peer handles. */
+    RBC_MESH_BRIDGE_DIR_FROM_PEER,  /**< Values are forwarded from the peer handles to the handles. */
+    RBC_MESH_BRIDGE_DIR_BOTH        /**< Values are forwarded both ways. */
+} rbc_mesh_bridge_dir_t;
+
+/** @brief Bridge filter table entry, see rbc_mesh_bridge_add(). */
+typedef struct
+{
+    rbc_mesh_handle_range_t handles;    /**< Bridged handles on one side of the bridge. */
+    rbc_mesh_value_handle_t peer_first; /**< Handle on the other side of the first of the handles. The rest follow in order. */
+    rbc_mesh_bridge_dir_t direction;    /**< Direction of the forwarded values. */
+} rbc_mesh_bridge_entry_t;
+
+/** @brief A cached handle, see rbc_mesh_handles_iterate(). */
+typedef struct
+{
+    rbc_mesh_value_handle_t handle; /**< Value handle. */
+    uint16_t version;           /**< Version of the value. */
+    uint8_t trickle_class;      /**< Trickle parameter class of the value. */
+    bool persistent;            /**< The persistence flag is set. */
+    bool tx_event;              /**< The TX event flag is set. */
+    bool urgent;                /**< The urgent flag is set. */
+    bool enabled;               /**< The value is being retransmitted. */
+    bool has_value;             /**< The value is in the data cache. */
+    uint8_t data_len;           /**< Length of the value. */
+    const uint8_t* p_data;      /**< The value, only valid during the iterate callback. NULL if the handle has no value. */
+} rbc_mesh_handle_info_t;
+
+/** @brief Sample of a time series, see rbc_mesh_series_unpack(). */
+typedef struct
+{
+    uint32_t timestamp_ms;      /**< Timestamp the sample was added with, in milliseconds. */
+    int32_t value;              /**< Sample value. */
+} rbc_mesh_series_sample_t;
+
+/**
+* @brief Function pointer type for the handle iterate callback.
+*
+* @param[in] p_info The cached handle.
+* @param[in] p_context Context pointer given to rbc_mesh_handles_iterate().
+*
+* @return true to continue, false to stop the iteration.
+*/
+typedef bool (*rbc_mesh_handle_iterate_cb_t)(const rbc_mesh_handle_info_t* p_info, void* p_context);
+
+/**
+* @brief Completion callback of a queued application command, called from the
+*   mesh context.
+*
+* @param[in] error_code Result of the command.
+* @param[in] p_context Context pointer given in the rbc_mesh_future_t.
+*/
+typedef void (*rbc_mesh_future_cb_t)(uint32_t error_code, void* p_context);
+
+/**
+* @brief Function pointer type for the conflict resolver, see
+*   rbc_mesh_conflict_resolver_set(). Called from the mesh context when a
+*   value is received with the same version as the stored value, but a
+*   different payload.
+*
+* @param[in] handle Handle of the value.
+* @param[in] p_current The stored payload.
+* @param[in] current_len Length of p_current.
+* @param[in] p_received The received payload.
+* @param[in] received_len Length of p_received.
+*
+* @return true if the received payload replaces the stored one.
+*/
+typedef bool (*rbc_mesh_conflict_resolver_t)(rbc_mesh_value_handle_t handle,
+        const uint8_t* p_current, uint8_t current_len,
+        const uint8_t* p_received, uint8_t received_len);
+
+/**
+* @brief Function pointer type for value hooks, see rbc_mesh_rx_hook_set().
+*   Called from the mesh context when a new version of the value is received
+*   from the mesh.
+*
+* @param[in] handle Handle of the value.
+* @param[in] p_data The received payload, only valid during the call.
+* @param[in] data_len Length of p_data.
+*/
+typedef void (*rbc_mesh_rx_hook_t)(rbc_mesh_value_handle_t handle,
+        const uint8_t* p_data, uint8_t data_len);
+
+/** @brief Result of a queued application command, see
+  rbc_mesh_value_set_async(). Must stay valid until the command is done. */
+typedef struct
+{
+    volatile bool done;             /**< Set by the framework when the command has been carried out. */
+    uint32_t error_code;            /**< Result of the command, valid once done is set. Same as the return value of the blocking call. */
+    rbc_mesh_future_cb_t callback;  /**< Called from the mesh context when the command is done, or NULL. Set by the application. */
+    void* p_context;                /**< Passed on to the callback. Set by the application. */
+} rbc_mesh_future_t;
+
+/** @brief Packet pool usage statistics. */
+typedef struct
+{
+    uint16_t pool_size;         /**< Total number of packets in the pool. */
+    uint16_t in_use;            /**< Number of packets currently allocated. */
+    uint16_t high_water_mark;   /**< Highest number of packets allocated at the same time. */
+    uint32_t alloc_failures;    /**< Number of allocations that failed because the pool was empty. */
+    uint32_t rx_denied;         /**< Number of times the radio couldn't get a packet to listen with, because the pool was down to RBC_MESH_PACKET_POOL_RX_RESERVE packets. */
+} rbc_mesh_packet_pool_stats_t;
+
+/** @brief Timeslot statistics. */
+typedef struct
+{
+    uint32_t granted;           /**< Number of timeslots granted by the Softdevice. */
+    uint32_t extended;          /**< Number of successful timeslot extensions. */
+    uint32_t denied;            /**< Number of timeslot requests and extensions that were denied, blocked or canceled. */
+    uint8_t utilization;        /**< Percentage of the time since the first timeslot that has been spent in timeslots. */
+    uint16_t utilization_permille; /**< Same as utilization, in tenths of a percent. Shows the achieved radio duty cycle when duty-cycled scanning is enabled. */
+    uint32_t conn_collisions;   /**< Number of timeslot requests and extensions denied, blocked or canceled while a GATT connection was active. */
+    uint16_t conn_collision_permille; /**< Share of the timeslot requests and extensions made while connected that collided with the connection, in tenths of a percent. */
+    uint32_t chained;           /**< Number of timeslots requested to start right after the previous one, see RBC_MESH_TIMESLOT_CHAINING. */
+    uint32_t rx_gap_ms_per_hour; /**< Time between timeslots that were ordered back to back, when the mesh couldn't receive, in milliseconds per hour. Duty-cycle sleep isn't counted. */
+    uint32_t latency_starts;    /**< Number of timeslots ordered on the latency mode cadence, see rbc_mesh_latency_mode_set(). */
+    uint32_t latency_missed;    /**< Number of latency mode timeslots the SoftDevice blocked or canceled, and that started late as earliest requests. */
+    uint32_t latency_jitter_max_us; /**< Largest difference between the ordered and the actual start of a latency mode timeslot, in microseconds. */
+    uint32_t latency_jitter_avg_us; /**< Average difference between the ordered and the actual start of the latency mode timeslots, in microseconds. */
+} rbc_mesh_timeslot_stats_t;
+
+/** @brief Number of internal event priority classes. In order of priority:
+  timers, received packets, flag updates and application commands, and
+  generic events. */
+#define RBC_MESH_EVENT_CLASS_COUNT  (4)
+
+/** @brief Internal event queue statistics for a priority class. */
+typedef struct
+{
+    uint16_t queue_length;      /**< Number of events currently waiting. */
+    uint16_t high_water_mark;   /**< Highest number of events waiting at the same time. */
+    uint32_t promoted;          /**< Number of events dispatched ahead of higher priority classes, after waiting for RBC_MESH_EVENT_STARVATION_LIMIT dispatches. */
+} rbc_mesh_event_class_stats_t;
+
+/** @brief Interrupt handlers timed with RBC_MESH_ISR_STATS. */
+typedef enum
+{
+    RBC_MESH_ISR_RADIO,         /**< Radio events, radio_event_handler(). */
+    RBC_MESH_ISR_TIMER,         /**< Timer compare events, timer_event_handler(). */
+    RBC_MESH_ISR_EVENT,         /**< Internal async event dispatch, in the QDEC software interrupt. */
+    RBC_MESH_ISR_SERIAL,        /**< UART interrupt of the serial interface. */
+    RBC_MESH_ISR_COUNT
+} rbc_mesh_isr_t;
+
+/** @brief Number of buckets in the interrupt handler histograms. */
+#define RBC_MESH_ISR_HIST_BUCKETS   (8)
+
+/** @brief Timing statistics for an interrupt handler, see
+  rbc_mesh_isr_stats_get(). Bucket 0 counts the runs up to
+  RBC_MESH_ISR_HIST_FIRST_US, each of the next buckets twice the range of the
+  one before, and the last one everything above. The counters saturate at
+  0xFFFF. */
+typedef struct
+{
+    uint16_t duration_hist[RBC_MESH_ISR_HIST_BUCKETS]; /**< Time from the start to the end of the handler. */
+    uint16_t latency_hist[RBC_MESH_ISR_HIST_BUCKETS];  /**< Time from the trigger to the start of the handler. Only the timer and event handlers know their trigger time. */
+    uint16_t duration_max_us;   /**< Longest run of the handler, in microseconds. */
+    uint16_t latency_max_us;    /**< Longest latency of the handler, in microseconds. */
+    uint16_t margin_overruns;   /**< Number of runs longer than the timeslot end margin, which could have pushed the end timer past the end of the timeslot. */
+} rbc_mesh_isr_stats_t;
+
+/** @brief Number of buckets in the propagation delay histogram. */
+#define RBC_MESH_PROPAGATION_HIST_BUCKETS   (8)
+
+/** @brief Propagation delays of the versions this node has received, see
+  rbc_mesh_propagation_stats_get(). Bucket 0 counts the delays up to
+  RBC_MESH_PROPAGATION_HIST_FIRST_MS, each of the next buckets twice the range
+  of the one before, and the last one everything above. The 16 bit counters
+  saturate at 0xFFFF. */
+typedef struct
+{
+    uint32_t count;             /**< Number of new versions with an origin time. */
+    uint16_t unstamped;         /**< Number of new versions without an origin time. */
+    uint16_t max_ms;            /**< Longest propagation delay in milliseconds. */
+    uint16_t hist[RBC_MESH_PROPAGATION_HIST_BUCKETS]; /**< Propagation delay histogram. */
+} rbc_mesh_propagation_stats_t;
+
+/** @brief RAM used by the framework, in bytes, see rbc_mesh_ram_stats_get(). */
+typedef struct
+{
+    uint32_t stack_size;        /**< Size of the stack, 0 without RBC_MESH_STACK_WATERMARK. */
+    uint32_t stack_used;        /**< Deepest stack usage since rbc_mesh_init(), 0 without RBC_MESH_STACK_WATERMARK. */
+    uint32_t handle_cache;      /**< Handle cache and its lookup index. */
+    uint32_t data_cache;        /**< Data cache, its TX lists and the compact value store. */
+    uint32_t packet_pool;       /**< Packet pool. */
+    uint32_t event_queues;      /**< Internal event queues. */
+    uint32_t app_event_queue;   /**< Application event queue. */
+    uint32_t radio_queue;       /**< Radio event queue and TX buffers. */
+    uint32_t serial_buffers;    /**< Serial queues and transfer buffers, 0 without RBC_MESH_SERIAL. */
+} rbc_mesh_ram_stats_t;
+
+/** @brief Mesh time, see rbc_mesh_time_get(). */
+typedef struct
+{
+    uint32_t time_us;           /**< Current mesh time in microseconds. Wraps around after 2^32 us. */
+    uint32_t root_id;           /**< ID of the node the mesh time is taken from. */
+    uint8_t hops;               /**< Number of hops to the time root, 0 if this node is the root. */
+} rbc_mesh_time_t;
+
+/** @brief Radio time statistics. The radio time is only accounted with
+  RBC_MESH_RADIO_TIME_STATS, the other fields are 0 without it. Multiply by
+  the supply current in each state for the energy spent by the mesh. */
+typedef struct
+{
+    uint32_t timeslot_ms;       /**< Time spent in timeslots, in milliseconds. */
+    uint32_t rx_ms;             /**< Time the receiver was on, after ramp-up, in milliseconds. */
+    uint32_t tx_ms;             /**< Time the transmitter was on, after ramp-up, in milliseconds. */
+    uint32_t ramp_up_ms;        /**< Time spent ramping up the radio for RX and TX, in milliseconds. */
+    uint32_t idle_ms;           /**< Time in timeslots with the radio disabled, in milliseconds. */
+    uint16_t rx_permille;       /**< Share of the timeslot time the receiver was on, in tenths of a percent. */
+    uint16_t tx_permille;       /**< Share of the timeslot time spent transmitting, in tenths of a percent. */
+} rbc_mesh_radio_stats_t;
+
+/** @brief Runtime statistics for the whole framework. All counters are
+  cumulative since rbc_mesh_init(). */
+typedef struct
+{
+    uint32_t rx_ok;                 /**< Number of received packets passed on to the RX queue. */
+    uint32_t rx_crc_fail;           /**< Number of received packets with a CRC failure. */
+    uint32_t rx_queue_drop;         /**< Number of received packets dropped because the RX queue was full. */
+    uint32_t tx_ok;                 /**< Number of completed packet transmissions. */
+    uint32_t tx_queue_drop;         /**< Number of transmissions dropped because the radio queue was full. */
+    uint32_t internal_events;       /**< Number of processed internal async events. */
+    uint32_t internal_queue_drop;   /**< Number of internal async events dropped because the event queue was full. */
+    uint32_t app_new_val;           /**< Number of @ref RBC_MESH_EVENT_TYPE_NEW_VAL events pushed to the application. */
+    uint32_t app_update_val;        /**< Number of @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL events pushed to the application. */
+    uint32_t app_conflicting_val;   /**< Number of @ref RBC_MESH_EVENT_TYPE_CONFLICTING_VAL events pushed to the application. */
+    uint32_t app_tx;                /**< Number of @ref RBC_MESH_EVENT_TYPE_TX events pushed to the application. */
+    uint32_t app_queue_drop;        /**< Number of application events dropped because the application event queue was full. */
+    uint32_t trickle_resets;        /**< Number of Trickle interval resets. */
+    uint32_t rx_duplicates;         /**< Number of received packets recognized as copies of a recent packet. */
+    uint32_t rx_filtered;           /**< Number of received packets dropped by the RX filter. */
+    uint32_t tx_deferred;           /**< Number of times a transmission was deferred because the channel was busy, see RBC_MESH_LISTEN_BEFORE_TALK. */
+    uint32_t rx_auth_fail;          /**< Number of received application values dropped because they failed the MIC check or came in clear, see RBC_MESH_ENCRYPTION. */
+    uint32_t rx_replayed;           /**< Number of received encrypted packets dropped as replays of a sequence number, see RBC_MESH_ENCRYPTION. */
+    uint32_t rx_foreign;            /**< Number of received packets dropped in the radio callback because they carried no mesh data, like the advertisements of other devices. Only counted while no packet peek callback is set. */
+    uint32_t tx_dfu_held;           /**< Number of DFU transmissions held back to leave airtime for values, see RBC_MESH_DFU_QOS. */
+    uint32_t tx_coded;              /**< Number of coded packets sent in place of two value transmissions, see RBC_MESH_NETWORK_CODING. */
+    uint32_t rx_decoded;            /**< Number of values decoded from received coded packets, see RBC_MESH_NETWORK_CODING. */
+    uint32_t rx_hook_calls;         /**< Number of value hook calls, see RBC_MESH_RX_HOOKS. */
+    uint32_t rx_hook_overruns;      /**< Number of value hooks removed for taking longer than RBC_MESH_RX_HOOK_BUDGET_US, see RBC_MESH_RX_HOOKS. */
+    uint32_t persistent_drop;       /**< Number of persistent values left out of flash because they didn't fit a page, see RBC_MESH_PERSISTENT_STORAGE. */
+    rbc_mesh_packet_pool_stats_t packet_pool; /**< Packet pool usage. */
+    rbc_mesh_timeslot_stats_t timeslot;       /**< Timeslot utilization. */
+    rbc_mesh_event_class_stats_t event_class[RBC_MESH_EVENT_CLASS_COUNT]; /**< Internal event queues, in order of priority: timers, received packets, flag updates and application commands, and generic events. */
+    rbc_mesh_radio_stats_t radio;             /**< Radio time by state, see RBC_MESH_RADIO_TIME_STATS. */
+} rbc_mesh_stats_t;
+
+/** @brief Airtime statistics for a single value, see
+  rbc_mesh_handle_stats_get(). The counters saturate at 0xFFFF, and start
+  over when the value is evicted from the data cache. */
+typedef struct
+{
+    uint16_t tx;                /**< Number of transmissions of the value. */
+    uint16_t rx_consistent;     /**< Number of received copies of the current version. */
+    uint16_t rx_inconsistent;   /**< Number of received older or conflicting versions. */
+    uint16_t trickle_reset;     /**< Number of Trickle interval resets. */
+} rbc_mesh_handle_stats_t;
+
+/** @brief Reception statistics for an advertisement channel, see
+  rbc_mesh_channel_stats_get(). */
+typedef struct
+{
+    uint32_t rx_ok;             /**< Number of packets received on the channel with a valid CRC. */
+    uint32_t rx_crc_fail;       /**< Number of packets received on the channel with a CRC failure. */
+    uint8_t crc_fail_percent;   /**< Share of the receptions that failed the CRC check in the last period with enough receptions to judge by. */
+    int8_t crc_fail_rssi;       /**< Moving average of the RSSI of the receptions that failed the CRC check, in dBm, as a measure of the interference on the channel. 0 before the first failure. */
+    bool in_use;                /**< Whether the channel is in the mesh channel map. */
+} rbc_mesh_channel_stats_t;
+
+/** @brief A node heard directly by this node, see rbc_mesh_neighbor_get(). */
+typedef struct
+{
+    ble_gap_addr_t addr;        /**< Advertisement address of the neighbor. */
+    int8_t rssi;                /**< Moving average of the RSSI of the packets from the neighbor, in dBm. */
+    uint32_t packet_count;      /**< Number of mesh packets received from the neighbor. */
+    uint32_t last_rx_us;        /**< Timestamp of the last packet from the neighbor, in the same time base as the rx event timestamps. */
+} rbc_mesh_neighbor_t;
+
+/*****************************************************************************
+     Interface Functions
+*****************************************************************************/
+
+/**
+* @brief Initialize Rebroadcast module, must be called before any other
+*   rebroadcast function.
+*
+* @note The nRF51 Softdevice must be initialized by the application before
+*    the mesh framework intialization is called, or the function will
+*    return NRF_ERROR_SOFTDEVICE_NOT_ENABLED.
+*
+* @return NRF_SUCCESS the initialization is successful
+* @return NRF_ERROR_INVALID_PARAM a parameter does not meet its required range.
+* @return NRF_ERROR_INVALID_STATE the framework has already been initialized.
+* @return NRF_ERROR_SOFTDEVICE_NOT_ENABLED the Softdevice has not been enabled.
+* @return NRF_ERROR_NO_MEM the supplied arena is too small for the requested
+*    cache and queue sizes.
+* @return NRF_ERROR_INVALID_ADDR the supplied arena, or the retained area of
+*    RBC_MESH_RETAINED_RAM, isn't word aligned.
+* @return NRF_ERROR_NULL no memory was supplied, and the framework has been
+*    built with RBC_MESH_EXTERNAL_MEMORY.
+* @return NRF_ERROR_NOT_SUPPORTED the radio mode isn't supported by the chip.
+*/
+uint32_t rbc_mesh_init(rbc_mesh_init_params_t init_params);
+
+/**
+* @brief Get the arena size the framework needs for the given cache and queue
+*   sizes, see @ref rbc_mesh_memory_t.
+*
+* @param[in] handle_cache_entries Number of handle cache entries.
+* @param[in] data_cache_entries Number of data cache entries.
+* @param[in] app_event_queue_length Length of the app event queue.
+*
+* @return The number of bytes needed in rbc_mesh_memory_t::p_arena.
+*/
+uint32_t rbc_mesh_memory_size_get(uint16_t handle_cache_entries,
+        uint16_t data_cache_entries,
+        uint16_t app_event_queue_length);
+
+/**
+* @brief Get the current state of the mesh.
+*
+* @return The state of the mesh.
+*/
+rbc_mesh_state_t rbc_mesh_state_get(void);
+
+/**
+* @brief Start mesh radio activity after stopping it.
+*
+* @details This function is called automatically in the @ref rbc_mesh_init
+*   function, and only has to be explicitly called after a call to
+*   @ref rbc_mesh_stop.
+*
+* @return NRF_SUCCESS the mesh successfully started radio operation
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized, or
+*   the mesh is already running.
+*/
+uint32_t rbc_mesh_start(void);
+
+/**
+* @brief Stop mesh radio activity.
+*
+* @details Stop ordering timeslots from the Softdevice, effectively stopping
+*   all radio activity. This allows the chip to enter long-term low power
+*   operation.
+*
+* @note While other mesh calls will work locally, the device will not be able
+*   to transmit or receive anything to/from other devices in the network before
+*   being reactivated by a call to @ref rbc_mesh_start.
+*
+* @return NRF_SUCCESS the mesh successfully stopped all radio operation
+* @return NRF_ERROR_INVALID_STATE te framework has not been initialized, or
+*   the mesh operation is already stopped.
+*/
+uint32_t rbc_mesh_stop(void);
+
+/**
+* @brief Set the contents of the data array pointed to by the provided handle
+*
+* @note If the indicated handle-value pair is in a disabled state, it will
+*   automatically be enabled.
+* @note If the handle is a segmented value, this is equivalent to
+*   @ref rbc_mesh_segmented_value_set, and len may be up to
+*   RBC_MESH_SEGMENTED_VALUE_MAX_LEN.
+*
+* @param[in] handle The handle of the value we want to update.
+* @param[in] data Databuffer to be copied into the value slot
+* @param[in] len Length of the provided data. Must not exceed RBC_VALUE_MAX_LEN,
+*   or RBC_MESH_LEGACY_VALUE_MAX_LEN if long packets have been disabled with
+*   @ref rbc_mesh_long_packets_set().
+*
+* @return NRF_SUCCESS if the value has been successfully updated.
+* @return NRF_ERROR_INVALID_STATE if the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR if the handle is outside the range provided
+*    in @ref rbc_mesh_init.
+* @return NRF_ERROR_INVALID_LENGTH if len exceeds RBC_VALUE_MAX_LEN.
+*/
+uint32_t rbc_mesh_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len);
+
+/**
+* @brief Set several values in one pass, e.g. for a scene change in a
+*   lighting system. Behaves like a call to @ref rbc_mesh_value_set for each
+*   value, but takes the event handler critical section once and orders a
+*   single Trickle transmit update for the whole batch, and doesn't take up
+*   a place in the internal event queue for each value.
+*
+* @note Segmented values can't be set in a batch. With RBC_MESH_DELTA_UPDATES,
+*   values set in a batch are sent in full.
+*
+* @param[in] p_handles Handles of the values to set.
+* @param[in] pp_data Data of each value.
+* @param[in] p_lens Length of each value, as for @ref rbc_mesh_value_set.
+* @param[in] count Number of values in the batch.
+*
+* @return NRF_SUCCESS All values have been updated.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL One of the arrays is NULL.
+* @return NRF_ERROR_INVALID_ADDR One of the handles is outside the
+*   application range, or is a segmented value. No values have been set.
+* @return NRF_ERROR_INVALID_LENGTH One of the lengths exceeds the longest
+*   value. No values have been set.
+* @return NRF_ERROR_NO_MEM The packet pool ran out. The values before the
+*   failing one have been set.
+*/
+uint32_t rbc_mesh_values_set(const rbc_mesh_value_handle_t* p_handles, uint8_t* const* pp_data, const uint16_t* p_lens, uint32_t count);
+
+/**
+* @brief Start broadcasting the handle-value pair. If the handle has not been
+*   assigned a value yet, it will start broadcasting a version 0 value with
+*   0 length payload, so that adjacent nodes may push an updated version of
+*   the handle-value pair.
+*
+* @note The value broadcast is sent asynchronously, and a response is likely
+*   to be received after several milliseconds depending on the adv_int_ms
+*   value set in @ref rbc_mesh_init.
+*
+* @param[in] handle The handle to enable.
+*
+* @return NRF_SUCCESS A request was successfully scheduled for broadcast.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initiated.
+*/
+uint32_t rbc_mesh_value_enable(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Stop rebroadcasting the indicated handle-value pair.
+*
+* @note This will not stop the framework from updating the value in its local
+*   database upon external updates (and consequently give the application
+*   update events), but values will not be propagated to other nodes through
+*   this node before they are either written to or re-enabled.
+*
+* @param[in] handle Handle to stop broadcasting
+*
+* @return NRF_SUCCESS The handle was successfully taken off the broadcast list
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+*/
+uint32_t rbc_mesh_value_disable(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Set whether the given handle should be persistent in the handle cache.
+*
+* @note While non-persistent values may be forgotten by the handle cache, a
+*   persistent value will be retransmitted forever. Note that setting too many
+*   persistent values in the cache will reduce the framework's ability to
+*   retransmit non-persistent values, leading to more packet drops and poor
+*   throughput. It is therefore recommended to be conservative about the
+*   usage of this flag.
+* @note If a device is known to be the lone maintainer of a particular
+*   handle, it is recommended to let the handle be persistent in that device,
+*   as a reset in version numbers may cause a disrupt in communication.
+* @note With RBC_MESH_PERSISTENT_STORAGE, persistent values are also kept in
+*   flash, and are restored as persistent on the next rbc_mesh_init().
+*
+* @param[in] handle Handle to change the Persistent flag for.
+* @param[in] persistent Whether or not to let the value be persistent in the
+*   cache.
+*
+* @return NRF_SUCCESS the persistence configuration has been set successfully.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_NO_MEM the number of persistent values in the cache exceeds
+*   the cache size.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_persistence_set(rbc_mesh_value_handle_t handle, bool persistent);
+
+/**
+* @brief Set whether the given handle should produce TX events for each time
+*   the value is transmitted.
+*
+* @note In order to maintain high performance in the framework, it is
+*   recommended that the amount of values that have this flag set is kept
+*   as low as possible. The flag is set to 0 by default.
+* @note The TX event data-field is set to NULL, and any need to access the
+*   contents of the transmission must be done with the @ref
+*   rbc_mesh_value_get() function.
+*
+* @param[in] handle Handle to change TX event flag for
+* @param[in] do_tx_event The TX event configuration for the given value
+*
+* @return NRF_SUCCESS the TX event configuration has been set successfully
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+*/
+uint32_t rbc_mesh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event);
+
+/**
+* @brief Set whether new versions of the given handle are urgent. A new
+*   version of an urgent value is sent right away, and then
+*   RBC_MESH_URGENT_BURST_COUNT times RBC_MESH_URGENT_BURST_INTERVAL_US
+*   apart before it falls back to Trickle, regardless of the consistent
+*   copies heard in the meantime. Relays do the same as they receive a new
+*   version, so that the latency over several hops is bound by the burst
+*   interval, rather than the Trickle minimum interval.
+*
+* @note The flag isn't sent on air. All nodes that should relay the value
+*   quickly must set it for the handle. Keep the number of urgent values
+*   low, as every update costs a burst of transmissions in the whole mesh.
+*   The flag is set to 0 by default.
+*
+* @param[in] handle Handle to change the urgent flag for.
+* @param[in] urgent Whether new versions of the value are urgent.
+*
+* @return NRF_SUCCESS the urgent flag has been set successfully.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+*/
+uint32_t rbc_mesh_urgent_flag_set(rbc_mesh_value_handle_t handle, bool urgent);
+
+/**
+* @brief Get the contents of the data array pointed to by the provided handle
+*
+* @param[in] handle The handle of the value we want to update.
+* @param[out] data Databuffer to be copied into the value slot. Must be at least
+*    RBC_VALUE_MAX_LEN long.
+* @param[out] len Length of the copied data. Will not exceed RBC_VALUE_MAX_LEN.
+*
+* @return NRF_SUCCESS the value has been successfully fetched.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+*/
+uint32_t rbc_mesh_value_get(rbc_mesh_value_handle_t handle,
+    uint8_t* data,
+    uint16_t* len);
+
+/**
+* @brief Queue an update of a value, as with rbc_mesh_value_set(), without
+*   masking the mesh context. The data is copied, and the update is carried
+*   out in the mesh context, see RBC_MESH_APP_COMMAND_QUEUE.
+*
+* @note The commands are queued without locks, and must all be queued from
+*   the same application context.
+*
+* @param[in] handle The handle of the value to update.
+* @param[in] data New value data.
+* @param[in] len Length of the new value, at most RBC_MESH_VALUE_MAX_LEN.
+* @param[in,out] p_future Future to hand the result of rbc_mesh_value_set()
+*   back in, or NULL to ignore it.
+*
+* @return NRF_SUCCESS the update has been queued.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_INVALID_LENGTH len exceeds RBC_MESH_VALUE_MAX_LEN.
+* @return NRF_ERROR_NO_MEM the command queue is full.
+* @return NRF_ERROR_NOT_SUPPORTED the framework was built without
+*   RBC_MESH_APP_COMMAND_QUEUE.
+*/
+uint32_t rbc_mesh_value_set_async(rbc_mesh_value_handle_t handle,
+    const uint8_t* data,
+    uint16_t len,
+    rbc_mesh_future_t* p_future);
+
+/**
+* @brief Queue a read of a value, as with rbc_mesh_value_get(), without
+*   masking the mesh context. The data and length are written in the mesh
+*   context, before the future is set done.
+*
+* @note The commands are queued without locks, and must all be queued from
+*   the same application context.
+*
+* @param[in] handle The handle of the value to read.
+* @param[out] data Buffer to copy the value to, at least RBC_MESH_VALUE_MAX_LEN
+*   long. Must stay valid until the future is done.
+* @param[in,out] len Size of the buffer, set to the length of the value. Must
+*   stay valid until the future is done.
+* @param[in,out] p_future Future to hand the result of rbc_mesh_value_get()
+*   back in.
+*
+* @return NRF_SUCCESS the read has been queued.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_NULL a parameter was NULL.
+* @return NRF_ERROR_NO_MEM the command queue is full.
+* @return NRF_ERROR_NOT_SUPPORTED the framework was built without
+*   RBC_MESH_APP_COMMAND_QUEUE.
+*/
+uint32_t rbc_mesh_value_get_async(rbc_mesh_value_handle_t handle,
+    uint8_t* data,
+    uint16_t* len,
+    rbc_mesh_future_t* p_future);
+
+/**
+* @brief Update a value, as with rbc_mesh_value_set(), and set the given
+*   future done once the new version has been transmitted tx_count times.
+*   Transmissions of a newer version of the handle, from a later update or
+*   from another node, count as well. Replaces enabling TX events for the
+*   handle and matching them in the application.
+*
+* @note Each packet on air counts as one transmission, so a value sent on all
+*   three advertisement channels counts three times.
+* @note The future is only set done by a transmission. If the update can't be
+*   stored in the mesh context, or the handle is never transmitted, it stays
+*   pending, so the application should not wait on it forever.
+*
+* @param[in] handle The handle of the value to update.
+* @param[in] data New value data.
+* @param[in] len Length of the new value, at most RBC_MESH_VALUE_MAX_LEN.
+* @param[in] tx_count Number of transmissions to wait for, 0 counts as 1.
+* @param[in,out] p_future Future to set done, called back from the mesh
+*   context. Must stay valid until it's done.
+*
+* @return NRF_SUCCESS the value has been updated, and the future is pending.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR the handle is invalid, or is built from other
+*   values, like a segmented value, a value group or a time series.
+* @return NRF_ERROR_INVALID_LENGTH len exceeds RBC_MESH_VALUE_MAX_LEN.
+* @return NRF_ERROR_NULL p_future was NULL.
+* @return NRF_ERROR_NO_MEM RBC_MESH_TX_NOTIFY_MAX updates are already waiting
+*   for their transmissions. The value is left as it was.
+* @return NRF_ERROR_NOT_SUPPORTED the framework was built without
+*   RBC_MESH_TX_NOTIFY.
+*/
+uint32_t rbc_mesh_value_set_notify(rbc_mesh_value_handle_t handle,
+    uint8_t* data,
+    uint16_t len,
+    uint8_t tx_count,
+    rbc_mesh_future_t* p_future);
+
+/**
+* @brief Get current mesh access address
+*
+* @param[out] access_addr Pointer location to put access address in
+*
+* @return NRF_SUCCESS the value was fetched successfully
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+*/
+uint32_t rbc_mesh_access_address_get(uint32_t* access_address);
+
+/**
+* @brief Get current mesh channel
+*
+* @param[out] ch Pointer location to put mesh channel in
+*
+* @return NRF_SUCCESS the value was fetched successfully
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+*/
+uint32_t rbc_mesh_channel_get(uint8_t* ch);
+
+/**
+* @brief Get the mesh minimum transmit interval in ms
+*
+* @param[out] interval_min_ms Pointer location to put adv int in
+*
+* @return NRF_SUCCESS the value was fetched successfully
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+*/
+uint32_t rbc_mesh_interval_min_ms_get(uint32_t* interval_min_ms);
+
+/**
+* @brief get whether the given handle has its persistence flag set
+*
+* @param[in] handle The handle whose flag should be checked.
+* @param[out] is_persistent a pointer to a boolean to which the flag status will
+*   be copied.
+*
+* @return NRF_SUCCESS The flag status was successfully copied to the parameter.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initilalized.
+* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
+* @return NRF_ERROR_INVALID_ADDR The given handle is invalid.
+*/
+uint32_t rbc_mesh_persistence_get(rbc_mesh_value_handle_t handle, bool* is_persistent);
+
+/**
+* @brief get whether the given handle has its tx_event flag set
+*
+* @param[in] handle The handle whose flag should be checked.
+* @param[out] is_doing_tx_event a pointer to a boolean to which the flag status will
+*   be copied.
+*
+* @return NRF_SUCCESS The flag status was successfully copied to the parameter.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initilalized.
+* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
+* @return NRF_ERROR_INVALID_ADDR The given handle is invalid.
+*/
+uint32_t rbc_mesh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* is_doing_tx_event);
+
+/**
+* @brief get whether the given handle has its urgent flag set
+*
+* @param[in] handle The handle whose flag should be checked.
+* @param[out] p_urgent a pointer to a boolean to which the flag status will
+*   be copied.
+*
+* @return NRF_SUCCESS The flag status was successfully copied to the parameter.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initilalized.
+* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
+* @return NRF_ERROR_INVALID_ADDR The given handle is invalid.
+*/
+uint32_t rbc_mesh_urgent_flag_get(rbc_mesh_value_handle_t handle, bool* p_urgent);
+
+/**
+* @brief Call the given function for every handle in the handle cache, in
+*   least recently used order, most recently used first.
+*
+* @note The callback runs in an event handler critical section, so that the
+*   whole iteration sees a consistent cache, and mesh packets are not
+*   processed until it returns. Keep it short, and don't change values or
+*   handle flags from it.
+*
+* @param[in] callback Function to call for every handle.
+* @param[in] p_context Context pointer passed on to the callback.
+*
+* @return NRF_SUCCESS The iteration completed, or was stopped by the callback.
+* @return NRF_ERROR_NULL The callback is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+*/
+uint32_t rbc_mesh_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context);
+
+/**
+* @brief Take a snapshot of the most recently used handles in the handle
+*   cache, in the order of rbc_mesh_handles_iterate(). The snapshot doesn't
+*   contain the values, p_data is always NULL.
+*
+* @param[out] p_infos Array to copy the handles to.
+* @param[in,out] p_count The number of elements in the array. When returned,
+*   the number of handles copied to it.
+*
+* @return NRF_SUCCESS The snapshot was taken.
+* @return NRF_ERROR_NULL One of the parameters is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+*/
+uint32_t rbc_mesh_handles_snapshot(rbc_mesh_handle_info_t* p_infos, uint32_t* p_count);
+
+/**
+* @brief Reorder the handle and data caches in least recently used order, so
+*   the entries of the most recently used handles are next to each other in
+*   RAM, and the cache walks touch them in order. Only available with
+*   RBC_MESH_CACHE_COMPACTION.
+*
+* @note Takes time linear in the cache sizes, in an event handler critical
+*   section. Call it when the application is otherwise idle. An ongoing
+*   handle dump over the serial interface or the mesh GATT service may skip
+*   or repeat handles, as it may across cache evictions.
+*
+* @return NRF_SUCCESS The caches are in order.
+* @return NRF_ERROR_BUSY The persistent values are being moved to a new flash
+*   page, try again later.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CACHE_COMPACTION, or with RBC_MESH_STATIC_HANDLES.
+*/
+uint32_t rbc_mesh_cache_compact(void);
+
+/**
+* @brief Configure the Trickle parameters of a parameter class.
+*
+* @note Classes that haven't been configured follow the minimum interval of the
+*   default class, which is set in @ref rbc_mesh_init and @ref
+*   rbc_mesh_interval_min_ms_set.
+*
+* @param[in] trickle_class The class to configure, below
+*   RBC_MESH_TRICKLE_CLASS_COUNT.
+* @param[in] interval_min_ms Minimum transmit interval for values in the class.
+*   Must be between RBC_MESH_INTERVAL_MIN_MIN_MS and
+*   RBC_MESH_INTERVAL_MIN_MAX_MS.
+* @param[in] interval_max_ms Maximum transmit interval for values in the
+*   class. Must not be lower than interval_min_ms. Intervals are capped at
+*   about 9 minutes, or a quarter of the tick range with
+*   RBC_MESH_COMPACT_TRICKLE. RBC_MESH_INTERVAL_MAX_UNBOUNDED makes a class
+*   for static values, like configuration: their interval grows to the cap,
+*   and with RBC_MESH_SUMMARY_BEACON, a summary beacon matching the node's
+*   own suppresses their transmission for the rest of the interval. Once the
+*   mesh has converged, static values are then only sent in intervals
+*   without a matching beacon, like when a neighbor is missing one of them.
+* @param[in] redundancy Number of consistent receptions in an interval that
+*   will suppress the transmission of a value in the class.
+*
+* @return NRF_SUCCESS The class was configured.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_PARAM One of the parameters was out of range.
+*/
+uint32_t rbc_mesh_trickle_class_config(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy);
+
+/**
+* @brief Assign a value to a Trickle parameter class. The value's Trickle
+*   interval is restarted with the class parameters.
+*
+* @param[in] handle Handle of the value.
+* @param[in] trickle_class The class to assign the value to.
+*
+* @return NRF_SUCCESS The class was assigned.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+* @return NRF_ERROR_INVALID_PARAM The class is out of range.
+* @return NRF_ERROR_NO_MEM The handle cache is full of persistent values.
+*/
+uint32_t rbc_mesh_trickle_class_set(rbc_mesh_value_handle_t handle, uint8_t trickle_class);
+
+/**
+* @brief Get the Trickle parameter class of a value.
+*
+* @param[in] handle Handle of the value.
+* @param[out] p_trickle_class Pointer to the variable the class is copied to.
+*
+* @return NRF_SUCCESS The class was copied to the parameter.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+*/
+uint32_t rbc_mesh_trickle_class_get(rbc_mesh_value_handle_t handle, uint8_t* p_trickle_class);
+
+/**
+* @brief Enable or disable the Trickle parameter auto tune, see
+*   RBC_MESH_TRICKLE_AUTO_TUNE. Every RBC_MESH_TRICKLE_AUTO_TUNE_INTERVAL_MS,
+*   the redundancy constant k is set from the number of neighbors, from
+*   RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX in sparse areas down to 1 in dense
+*   areas. The maximum interval is halved when the node is in a sparse area
+*   or when most receptions are inconsistent, and doubled when it's in a
+*   dense area and nearly all receptions are consistent, within
+*   RBC_MESH_TRICKLE_AUTO_TUNE_I_MAX_SHIFT steps of the configured interval.
+*
+* @note Only the default parameters are tuned. Trickle classes configured
+*   with rbc_mesh_trickle_class_config() keep their parameters.
+*
+* @param[in] enable Whether the parameters should be tuned. The configured
+*   parameters are restored when disabled.
+*
+* @return NRF_SUCCESS The auto tune was enabled or disabled.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TRICKLE_AUTO_TUNE.
+*/
+uint32_t rbc_mesh_trickle_auto_tune_set(bool enable);
+
+/**
+* @brief Set the alarm threshold of a health monitor metric, see
+*   RBC_MESH_HEALTH_MONITOR. Every RBC_MESH_HEALTH_INTERVAL_MS, the monitor
+*   counts each metric since the previous check, and the alarm of a metric is
+*   set while its count is above the threshold. Every time the set of alarms
+*   changes, an @ref RBC_MESH_EVENT_TYPE_HEALTH event is pushed to the
+*   application, and the report is published on the health handle, if one
+*   has been set with rbc_mesh_health_handle_set(). An alarm therefore clears
+*   after one check within the threshold. The monitor only runs while at
+*   least one threshold is set.
+*
+* @note The health event goes through the application event queue, so an
+*   alarm on @ref RBC_MESH_HEALTH_APP_QUEUE_DROP may only get through once the
+*   application has caught up. It is then retried with the next check.
+*
+* @param[in] metric Metric to set the threshold of.
+* @param[in] threshold Highest count of the metric per check that doesn't
+*   raise the alarm, or 0 to stop watching the metric.
+*
+* @return NRF_SUCCESS The threshold was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_PARAM The metric is unknown.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_HEALTH_MONITOR, or the metric is
+*   @ref RBC_MESH_HEALTH_LATE_VERSIONS and the framework was built without
+*   RBC_MESH_ORIGIN_TIME.
+*/
+uint32_t rbc_mesh_health_threshold_set(rbc_mesh_health_metric_t metric, uint16_t threshold);
+
+/**
+* @brief Publish the health report of this node on a value handle, so
+*   operators can watch the whole mesh from a single gateway. The report is
+*   a regular value of RBC_MESH_HEALTH_REPORT_LEN bytes, with a new version
+*   every time the set of alarms changes. Give each node its own handle.
+*
+* @param[in] handle Handle to publish the report on, or
+*   RBC_MESH_INVALID_HANDLE to stop publishing.
+*
+* @return NRF_SUCCESS The handle was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_HEALTH_MONITOR.
+*/
+uint32_t rbc_mesh_health_handle_set(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Set the key the mesh wide configuration records are signed with.
+*   Nodes without a key ignore the configuration beacons, and don't send
+*   them. Must be the same on all nodes.
+*
+* @param[in] p_key RBC_MESH_CONFIG_KEY_LEN byte key.
+*
+* @return NRF_SUCCESS The key was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_key is NULL.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CONFIG_PUSH.
+*/
+uint32_t rbc_mesh_config_key_set(const uint8_t* p_key);
+
+/**
+* @brief Change the Trickle min-interval of every node in the mesh. Applied
+*   here right away, and on the other nodes as the configuration beacon
+*   reaches them.
+*
+* @note The record gets the sequence number after the newest this node has
+*   heard for it. A node that has just started should hear the beacons
+*   before it changes the configuration, or the other nodes may reject it.
+*
+* @param[in] interval_min_ms New min-interval, between
+*   RBC_MESH_INTERVAL_MIN_MIN_MS and RBC_MESH_INTERVAL_MIN_MAX_MS.
+*
+* @return NRF_SUCCESS The configuration has been changed.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized,
+*   or no configuration key has been set.
+* @return NRF_ERROR_INVALID_PARAM The interval is out of range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CONFIG_PUSH.
+*/
+uint32_t rbc_mesh_config_interval_push(uint32_t interval_min_ms);
+
+/**
+* @brief Change a Trickle class on every node in the mesh, as with
+*   rbc_mesh_trickle_class_config(). See rbc_mesh_config_interval_push() for
+*   how the change spreads.
+*
+* @param[in] trickle_class Class to configure.
+* @param[in] interval_min_ms Min-interval of the class, between
+*   RBC_MESH_INTERVAL_MIN_MIN_MS and RBC_MESH_INTERVAL_MIN_MAX_MS.
+* @param[in] interval_max_ms Max-interval of the class, at least
+*   interval_min_ms, or RBC_MESH_INTERVAL_MAX_UNBOUNDED.
+* @param[in] redundancy Redundancy constant of the class.
+*
+* @return NRF_SUCCESS The configuration has been changed.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized,
+*   or no configuration key has been set.
+* @return NRF_ERROR_INVALID_PARAM A parameter is out of range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CONFIG_PUSH.
+*/
+uint32_t rbc_mesh_config_trickle_class_push(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy);
+
+/**
+* @brief Move every node in the mesh to a new access address and channel at
+*   the same time. The countdown to the switch is sent along with the
+*   configuration beacons, so give the beacon time to reach the whole mesh,
+*   a few RBC_MESH_CONFIG_INTERVAL_US per hop. Nodes that miss it are left
+*   behind on the old parameters.
+*
+* @param[in] access_address New access address.
+* @param[in] channel New channel, below 40.
+* @param[in] switch_delay_ms Time until the switch, at most 0xFFFF times
+*   RBC_MESH_CONFIG_SWITCH_UNIT_MS.
+*
+* @return NRF_SUCCESS The switch has been scheduled.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized,
+*   or no configuration key has been set.
+* @return NRF_ERROR_INVALID_PARAM The channel or the delay is out of range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CONFIG_PUSH.
+*/
+uint32_t rbc_mesh_config_radio_push(uint32_t access_address, uint8_t channel, uint32_t switch_delay_ms);
+
+/**
+* @brief Set TX power for mesh packets.
+*
+* @note With TX power control enabled, this sets the highest power the
+*   control may pick, see rbc_mesh_tx_power_control_set().
+*
+* @param[in] tx_power TX power from @rbc_mesh_txpower_t enum.
+*/
+void rbc_mesh_tx_power_set(rbc_mesh_txpower_t tx_power);
+
+/**
+* @brief Get the TX power currently used for mesh packets.
+*
+* @param[out] p_tx_power Pointer to the variable the TX power is copied to.
+*
+* @return NRF_SUCCESS The TX power was copied.
+* @return NRF_ERROR_NULL The p_tx_power parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+*/
+uint32_t rbc_mesh_tx_power_get(rbc_mesh_txpower_t* p_tx_power);
+
+/**
+* @brief Enable or disable closed-loop TX power control, see
+*   RBC_MESH_TX_POWER_CONTROL. Every RBC_MESH_TX_POWER_CONTROL_INTERVAL_MS,
+*   the framework picks the lowest power at which the
+*   RBC_MESH_TX_POWER_CONTROL_NEIGHBORS strongest neighbors are estimated to
+*   receive this node above RBC_MESH_TX_POWER_CONTROL_RSSI_TARGET. The power
+*   is raised right away when the estimate drops below the target, and
+*   lowered one step at a time. The power set with rbc_mesh_tx_power_set()
+*   when the control is enabled is the highest power it will use, and is
+*   restored when the control is disabled.
+*
+* @note The control assumes symmetric links, and that the neighbors transmit
+*   at the highest power. Neighbors that run the control themselves make the
+*   estimate err on the high side, which keeps the redundancy.
+*
+* @param[in] enable Whether the TX power should be controlled.
+*
+* @return NRF_SUCCESS The control was enabled or disabled.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TX_POWER_CONTROL.
+*/
+uint32_t rbc_mesh_tx_power_control_set(bool enable);
+
+/**
+* @brief Enable or disable long packets, see RBC_MESH_LONG_PACKETS. Long
+*   packets are enabled by default. Disable them in meshes that have nodes
+*   built without RBC_MESH_LONG_PACKETS, like nRF51 nodes: local values are
+*   then limited to RBC_MESH_LEGACY_VALUE_MAX_LEN, and values are only
+*   aggregated within the legacy packet length. Long packets from other nodes
+*   are still received and relayed. May be called before rbc_mesh_init().
+*
+* @param[in] enable Whether this node may transmit long packets.
+*
+* @return NRF_SUCCESS Long packets were enabled or disabled.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_LONG_PACKETS.
+*/
+uint32_t rbc_mesh_long_packets_set(bool enable);
+
+/**
+* @brief Select the sources of the value events given to the application.
+*   New, update and conflicting value events from other sources are dropped
+*   before they're queued. An application that passes values between its GATT
+*   clients, serial host and the mesh can leave out the sources it forwards
+*   from, and doesn't get the values it just set echoed back as events.
+*
+* @param[in] source_mask Bitmask of (1 << @ref rbc_mesh_event_source_t),
+*   @ref RBC_MESH_EVENT_SOURCE_MASK_ALL by default.
+*
+* @return NRF_SUCCESS The mask was set.
+* @return NRF_ERROR_INVALID_PARAM The mask has bits outside
+*   RBC_MESH_EVENT_SOURCE_MASK_ALL.
+*/
+uint32_t rbc_mesh_event_source_mask_set(uint8_t source_mask);
+
+/**
+* @brief Event handler to be called upon Softdevice BLE event arrival.
+*
+* @details Event handler taking care of all mesh behavior related to BLE.
+*   Typical events to trigger processing or local changes are
+*   writes to the value characteristic or a change in connection status. The
+*   framework will give events to the application if the function triggers a
+*   write to a handle value or similar.
+*
+* @note This event may be called regardless of whether the event is relevant
+*   to the mesh or not - the framework will filter out uninteresting
+*   events and return NRF_SUCCESS.
+*
+* @param[in] p_evt BLE event received from softdevice.
+*/
+void rbc_mesh_ble_evt_handler(ble_evt_t* p_evt);
+
+/**
+* @brief Event handler to be called upon regular Softdevice event arrival.
+*
+* @details Event handler taking care of all mesh behavior related to the
+*   Softdevice. Events are expected to be in the range
+*
+* @note This event may be called regardless of whether the event is relevant
+*   to the mesh or not - the framework will filter out uninteresting
+*   events and return NRF_SUCCESS.
+*
+* @param[in] evt event received from Softdevice through the sd_evt_get() call.
+*/
+void rbc_mesh_sd_evt_handler(uint32_t evt);
+
+/**
+* @brief Get an event from the mesh.
+*
+* @param[out] p_evt A pointer to the struct the event should be copied to.
+*   May be set to NULL if the contents of the event isn't important.
+*
+* @return NRF_SUCCESS An event was successfully popped and copied into the
+*   p_evt-parameter.
+* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_event_get(rbc_mesh_event_t* p_evt);
+
+/**
+* @brief Get an event from the mesh, but don't remove it from the queue.
+*
+* @note This call has the same effect as the rbc_mesh_event_get call, except
+*   it does not remove the event from the queue. Repeated calls to the peek
+*   function will yield the same event.
+*
+* @param[out] p_evt A pointer to the struct the event should be copied to.
+*
+* @return NRF_SUCCESS An event was successfully popped and copied into the
+*   p_evt-parameter.
+* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
+* @return NRF_ERROR_NULL The p_evt parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_event_peek(rbc_mesh_event_t* p_evt);
+
+/**
+* @brief Get a pointer to the oldest event in the mesh event queue, without
+*   copying it.
+*
+* @details The event stays in the queue, and may be used in place until it
+*   is removed with @ref rbc_mesh_event_consume. Repeated calls yield the same
+*   event.
+*
+* @note Must not be mixed with @ref rbc_mesh_event_get, @ref
+*   rbc_mesh_events_get or @ref rbc_mesh_event_peek from another context.
+*
+* @param[out] pp_evt Pointer to the event pointer to set.
+*
+* @return NRF_SUCCESS The pointer was set to the oldest event.
+* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
+* @return NRF_ERROR_NULL The pp_evt parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_event_peek_ref(rbc_mesh_event_t** pp_evt);
+
+/**
+* @brief Remove the oldest event from the mesh event queue, and free the
+*   memory associated with it, like @ref rbc_mesh_event_release does. Any
+*   pointers to the event or its data fields are invalid after this call.
+*
+* @return NRF_SUCCESS The event was removed.
+* @return NRF_ERROR_NOT_FOUND The event queue is empty.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_event_consume(void);
+
+/**
+* @brief Get several events from the mesh in one call.
+*
+* @note Every event must be freed with @ref rbc_mesh_event_release, as with
+*   @ref rbc_mesh_event_get.
+*
+* @param[out] p_evts Array of events to copy the events to.
+* @param[in,out] p_count The number of events the array can hold. When
+*   returned, the number of events copied into the array.
+*
+* @return NRF_SUCCESS At least one event was copied into the array.
+* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
+* @return NRF_ERROR_NULL One of the parameters is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_events_get(rbc_mesh_event_t* p_evts, uint32_t* p_count);
+
+/**
+* @brief Free the memory associated with the given mesh event.
+*   Provides the same functionality as @rbc_mesh_packet_release, but hides the
+*   different event types and their parameters. Will work on any event.
+*
+* @details: In order to reduce the amount of data copying going on for each
+*   data packet, the various data fields of an rbc_mesh_event points directly
+*   to the framework packet pool. This memory is managed by the mesh_packet
+*   module, and must be explicitly released when the contents is no longer in
+*   use. Failure to do so will result in a NO_MEM error when the framework runs
+*   out of available packets in the packet pool.
+*
+* @param[in] p_evt Pointer to a mesh event fetched with rbc_mesh_event_get.
+*/
+void rbc_mesh_event_release(rbc_mesh_event_t* p_evt);
+
+/**
+* @brief Set packet peek function pointer. Every received packet will be
+*   passed to the peek function before being processed by the stack -
+*   including non-mesh packets. This allows the application to read
+*   out parameters like RSSI from nearby devices.
+*
+* @warning This is considered an advanced feature, and should be used with some
+*   care. The packet memory will be invalid after the function is finished, and
+*   users should not store any direct pointers to it. Also note that the
+*   function is called from APP_LOW priority, which means it takes away from
+*   stack-internal processing time. Excessive usage may lead to starvation of
+*   internal functionality, and potentially packet drops.
+*
+* @param[in] packet_peek_cb Function pointer to a packet-peek function.
+*/
+void rbc_mesh_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb);
+
+/**
+* @brief Set up a filter for received mesh packets, based on their value
+*   handles. The filter runs in the radio callback, so that filtered packets
+*   never take up space in the RX queue, or processing time in the event
+*   handler. Filtered values are neither reported to the application nor
+*   relayed by the device. Packets carrying several values are processed if
+*   any of the values pass. Non-mesh packets and framework handles above
+*   RBC_MESH_APP_MAX_HANDLE always pass, and filtered packets don't reach the
+*   packet peek function.
+*
+* @param[in] mode Whether to accept or reject the given handle ranges, or
+*   RBC_MESH_RX_FILTER_OFF to process all handles.
+* @param[in] p_ranges Array of handle ranges. Ignored with
+*   RBC_MESH_RX_FILTER_OFF.
+* @param[in] range_count Number of ranges in p_ranges, at most
+*   RBC_MESH_RX_FILTER_RANGES_MAX.
+*
+* @return NRF_SUCCESS The filter was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_ranges is NULL, and range_count isn't 0.
+* @return NRF_ERROR_INVALID_PARAM Invalid mode, too many ranges, or a range
+*   ends before it starts.
+*/
+uint32_t rbc_mesh_rx_filter_set(rbc_mesh_rx_filter_mode_t mode,
+        const rbc_mesh_handle_range_t* p_ranges,
+        uint8_t range_count);
+
+/**
+* @brief Add a mesh instance next to the primary mesh. The instance has its
+*   own access address and handle range, and its values use their own Trickle
+*   parameter class, so that, for example, a fast control mesh and a slow
+*   telemetry mesh can share the nodes. The radio listens on all instance
+*   addresses at once, and every value goes out on the address of the instance
+*   its handle belongs to. Values received on another instance's address are
+*   dropped, and counted as filtered. Handles outside all instance ranges
+*   belong to the primary mesh.
+*
+* @note The radio's logical addresses share their three low bytes, so the
+*   instance access addresses must equal the primary access address in all
+*   but the top byte. The primary mesh is sent with a zero top byte, so the
+*   top byte must be non-zero, and unique among the instances.
+* @note Configure the Trickle class with rbc_mesh_trickle_class_config(). It
+*   applies to the handles of the instance as they enter the handle cache.
+*
+* @param[in] p_params Parameters of the instance.
+*
+* @return NRF_SUCCESS The instance was added.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_params is NULL.
+* @return NRF_ERROR_INVALID_ADDR The access address can't be used, or the
+*   handle range is invalid or overlaps another instance.
+* @return NRF_ERROR_INVALID_PARAM The Trickle class is out of range.
+* @return NRF_ERROR_NO_MEM There are already RBC_MESH_INSTANCES_MAX instances.
+*/
+uint32_t rbc_mesh_instance_add(const rbc_mesh_instance_params_t* p_params);
+
+/**
+* @brief Add an entry to the bridge filter table, see RBC_MESH_BRIDGE. A
+*   bridge node runs the meshes on both sides, typically the primary mesh and
+*   an instance added with rbc_mesh_instance_add(), and forwards new versions
+*   of the bridged handles it receives from one side to the matching handles
+*   on the other side, as local updates. Each side keeps its own handle,
+*   version and Trickle timer, so the meshes only share the bridged values,
+*   and stay as small as the rest of their traffic.
+*
+* @note With RBC_MESH_BRIDGE_DIR_TO_PEER or RBC_MESH_BRIDGE_DIR_FROM_PEER,
+*   the receiving side is owned by the bridge: new versions created on that
+*   side are overwritten with the value from the sending side. Both ways, the
+*   last version to reach the bridge wins, and a restarted bridge may pick up
+*   an old value from the side it hears from first.
+*
+* @param[in] p_entry Filter table entry. The handles and the peer handles
+*   must each be within a single mesh instance, and not in the same one.
+*
+* @return NRF_SUCCESS The entry was added.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_entry is NULL.
+* @return NRF_ERROR_INVALID_ADDR The handle ranges are invalid, span several
+*   instances or are in the same instance.
+* @return NRF_ERROR_INVALID_PARAM The direction is invalid.
+* @return NRF_ERROR_NO_MEM There are already RBC_MESH_BRIDGE_ENTRIES_MAX
+*   entries in the table.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_BRIDGE.
+*/
+uint32_t rbc_mesh_bridge_add(const rbc_mesh_bridge_entry_t* p_entry);
+
+/**
+* @brief Set the tie-breaker for values published with the same version and
+*   different payloads, see RBC_MESH_CONFLICT_RESOLUTION. By default, the
+*   longer payload wins, and between payloads of the same length, the one
+*   that compares higher with memcmp. A node holding the losing payload takes
+*   the winner, a node holding the winning payload restarts its Trickle
+*   interval to spread it, so a conflict settles without new versions.
+*
+* @note The resolver must give the same verdict on every node, and must never
+*   let both payloads win, or the nodes swap values forever. It should only
+*   look at the payloads, which are the same everywhere.
+*
+* @param[in] resolver Resolver to use, or NULL for the default order.
+*
+* @return NRF_SUCCESS The resolver was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CONFLICT_RESOLUTION.
+*/
+uint32_t rbc_mesh_conflict_resolver_set(rbc_mesh_conflict_resolver_t resolver);
+
+/**
+* @brief Set a hook for new versions of a handle, see RBC_MESH_RX_HOOKS. The
+*   hook is called from the mesh context as soon as a new version has been
+*   received and stored, before its @ref RBC_MESH_EVENT_TYPE_NEW_VAL or
+*   @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL event is queued for the application,
+*   so the application can react well within a millisecond of the reception.
+*   The event is queued as usual. Local updates don't call the hook.
+*
+* @note The hook holds up all mesh processing while it runs. It must return
+*   within RBC_MESH_RX_HOOK_BUDGET_US, or it is removed, and counted in
+*   rbc_mesh_stats_t::rx_hook_overruns. It must not call the framework API,
+*   and should leave anything longer to the application event handler.
+*
+* @param[in] handle Handle to hook. Segmented handles can't be hooked.
+* @param[in] hook Hook to call, or NULL to remove the handle's hook.
+*
+* @return NRF_SUCCESS The hook was set or removed.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application range,
+*   or segmented.
+* @return NRF_ERROR_NO_MEM RBC_MESH_RX_HOOKS_MAX handles already have a hook.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_RX_HOOKS.
+*/
+uint32_t rbc_mesh_rx_hook_set(rbc_mesh_value_handle_t handle, rbc_mesh_rx_hook_t hook);
+
+/**
+* @brief Set the share of the airtime DFU transfers may take while
+*   application values are being sent, see RBC_MESH_DFU_QOS. When no values
+*   have been sent for a window, DFU may take all the airtime it wants.
+*   Lowering the share makes transfers slower, but keeps the value latency
+*   down while they run.
+*
+* @param[in] percent DFU share of the airtime, from 1 to 100. 100 turns the
+*   airtime budget off, but DFU still leaves the reserved radio queue slots to
+*   the values.
+*
+* @return NRF_SUCCESS The share was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_PARAM The share is out of range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_DFU_QOS.
+*/
+uint32_t rbc_mesh_dfu_share_set(uint8_t percent);
+
+/**
+* @brief Set the network key for the on-air encryption of application values,
+*   see RBC_MESH_ENCRYPTION. All nodes in the mesh must use the same key.
+*   Until a key is set, the node neither sends nor accepts application values.
+*
+* @note The CCM nonce is made from the sender address and a 32 bit sequence
+*   number, which starts at a random value every time the key is set. Replays
+*   of old packets are harmless to the values, as they carry old versions.
+*
+* @param[in] p_key 16 byte AES key.
+*
+* @return NRF_SUCCESS The key was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_key is NULL.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_ENCRYPTION.
+*/
+uint32_t rbc_mesh_encryption_key_set(const uint8_t* p_key);
+
+/**
+* @brief Start the acknowledged delivery service, see RBC_MESH_ACK. Each node
+*   sends addressed messages on a handle of its own, and acknowledges the
+*   messages it receives on another. A receiver acknowledges all messages it
+*   got within the last RBC_MESH_ACK_DELAY_MS in a single update of its
+*   acknowledgement handle, so a node receiving from many senders doesn't
+*   need a handle per sender. A sender only sends a message again if it isn't
+*   acknowledged within RBC_MESH_ACK_TIMEOUT_MS, and stops broadcasting it
+*   once it is.
+*
+* @note Messages are delivered at least once. A receiver drops repeated
+*   messages from the last RBC_MESH_ACK_SOURCES senders, but not after a
+*   reboot.
+* @note Value events on the service handles are handled by the service, and
+*   aren't passed on to the application.
+*
+* @param[in] p_params Parameters of the service.
+*
+* @return NRF_SUCCESS The service was started.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_params is NULL.
+* @return NRF_ERROR_INVALID_ADDR The handle ranges overlap, or go beyond
+*   RBC_MESH_APP_MAX_HANDLE.
+* @return NRF_ERROR_INVALID_PARAM The node ID is outside the node count.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_ACK.
+*/
+uint32_t rbc_mesh_ack_init(const rbc_mesh_ack_params_t* p_params);
+
+/**
+* @brief Send a message to another node of the acknowledged delivery
+*   service. Its outcome is reported with an
+*   @ref RBC_MESH_EVENT_TYPE_ACK_DELIVERED or @ref RBC_MESH_EVENT_TYPE_ACK_FAILED
+*   event, and there can only be one message in flight at a time.
+*
+* @param[in] node_id Destination node.
+* @param[in] p_data Message contents.
+* @param[in] len Length of the message, at most RBC_MESH_ACK_MSG_MAX_LEN.
+*
+* @return NRF_SUCCESS The message is on its way.
+* @return NRF_ERROR_INVALID_STATE The service has not been started.
+* @return NRF_ERROR_NULL p_data is NULL, and len isn't 0.
+* @return NRF_ERROR_INVALID_PARAM The node ID is outside the node count, or
+*   is this node's.
+* @return NRF_ERROR_INVALID_LENGTH len exceeds RBC_MESH_ACK_MSG_MAX_LEN.
+* @return NRF_ERROR_BUSY The previous message is still in flight.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_ACK.
+*/
+uint32_t rbc_mesh_ack_send(uint16_t node_id, const uint8_t* p_data, uint8_t len);
+
+/**
+* @brief Get an entry of the neighbor table, see RBC_MESH_NEIGHBOR_TABLE. The
+*   table holds every node this node has received mesh packets from directly,
+*   relayed or not, up to RBC_MESH_NEIGHBOR_TABLE_SIZE nodes. Iterate from
+*   index 0 until NRF_ERROR_NOT_FOUND is returned.
+*
+* @note The table is also available over the serial ACI.
+*
+* @param[in] index Index of the entry.
+* @param[out] p_neighbor Pointer to a structure the entry will be copied to.
+*
+* @return NRF_SUCCESS The entry was copied.
+* @return NRF_ERROR_NULL The p_neighbor parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_FOUND There's no entry at the given index.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_NEIGHBOR_TABLE.
+*/
+uint32_t rbc_mesh_neighbor_get(uint8_t index, rbc_mesh_neighbor_t* p_neighbor);
+
+/**
+* @brief Empty the neighbor table, for instance to measure the links again
+*   after a change of TX power.
+*
+* @return NRF_SUCCESS The table was emptied.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_NEIGHBOR_TABLE.
+*/
+uint32_t rbc_mesh_neighbor_table_clear(void);
+
+/**
+* @brief Duty cycle the radio, for battery powered devices. By default, the
+*   framework keeps the radio in RX whenever it isn't transmitting. With a
+*   scan interval, the framework only asks the Softdevice for a timeslot of
+*   window_us length every interval_us, and sleeps in between. The timeslots
+*   are moved forward to cover the device's own Trickle transmissions, and
+*   are only extended while there are transmissions waiting for the radio.
+*
+* @note The device only picks up packets sent while it is scanning. Values
+*   being updated by other devices will take longer to reach a duty-cycled
+*   device, and an interval_min_ms close to the scan interval makes the
+*   neighbours repeat their values often enough to be picked up.
+*
+* @note The achieved duty cycle is reported in the utilization fields of
+*   the timeslot statistics, see rbc_mesh_timeslot_stats_get().
+*
+* @param[in] window_us Length of each scan window in microseconds. At least
+*   RBC_MESH_SCAN_WINDOW_MIN_US. Ignored if interval_us is 0.
+* @param[in] interval_us Time between the start of two scan windows in
+*   microseconds, at most RBC_MESH_SCAN_INTERVAL_MAX_US. Set to 0 to scan
+*   continuously.
+*
+* @return NRF_SUCCESS The scan duty cycle was set, and will take effect from
+*   the next timeslot.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_PARAM The window is too short, the interval is
+*   too long, or the window is longer than the interval.
+* @return NRF_ERROR_NOT_SUPPORTED The framework runs without a SoftDevice,
+*   see RBC_MESH_STANDALONE.
+*/
+uint32_t rbc_mesh_scan_duty_cycle_set(uint32_t window_us, uint32_t interval_us);
+
+/**
+* @brief Give the mesh predictable per-hop latency, for latency-critical
+*   nodes like the relays of control handles. Instead of asking for the next
+*   timeslot as early as possible, and waiting for the SoftDevice to fit it
+*   in, the framework orders each timeslot at NRF_RADIO_PRIORITY_HIGH to
+*   start at a fixed time: period_us after the start of the previous one, or
+*   right before the next Trickle transmission of an urgent handle if that
+*   comes first, after which the cadence continues from there. Timeslots are
+*   still extended as usual. When duty-cycled, the period replaces the
+*   scan interval of rbc_mesh_scan_duty_cycle_set(), and the scan window is
+*   cut short if it doesn't fit in the period.
+*
+* @note High priority timeslots take radio time from the SoftDevice's own
+*   activity, like advertising, and from other timeslot users. Keep the mode
+*   to the nodes that need it.
+*
+* @note The achieved start time jitter and the number of missed cadence
+*   timeslots are reported in the latency fields of the timeslot statistics,
+*   see rbc_mesh_timeslot_stats_get().
+*
+* @param[in] period_us Time between the timeslot starts in microseconds,
+*   from RBC_MESH_LATENCY_PERIOD_MIN_US to RBC_MESH_SCAN_INTERVAL_MAX_US. Set
+*   to 0 to turn the latency mode off.
+*
+* @return NRF_SUCCESS The latency mode was set, and will take effect from the
+*   next timeslot.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_PARAM The period is out of range.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIMESLOT_LATENCY_MODE, or runs without a SoftDevice, see
+*   RBC_MESH_STANDALONE.
+*/
+uint32_t rbc_mesh_latency_mode_set(uint32_t period_us);
+
+/**
+* @brief Get usage statistics for the framework packet pool. Can be used to
+*   tune the RBC_MESH_PACKET_POOL_SIZE for the application.
+*
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
+*
+* @return NRF_SUCCESS The statistics were successfully copied.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+*/
+uint32_t rbc_mesh_packet_pool_stats_get(rbc_mesh_packet_pool_stats_t* p_stats);
 
 /**
-* @brief Initialize Rebroadcast module, must be called before any other
-*   rebroadcast function.
+* @brief Get statistics for the timeslots the framework has been granted by
+*   the Softdevice.
 *
-* @note The nRF51 Softdevice must be initialized by the application before
-*    the mesh framework intialization is called, or the function will
-*    return NRF_ERROR_SOFTDEVICE_NOT_ENABLED.
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
 *
-* @return NRF_SUCCESS the initialization is successful
-* @return NRF_ERROR_INVALID_PARAM a parameter does not meet its required range.
-* @return NRF_ERROR_INVALID_STATE the framework has already been initialized.
-* @return NRF_ERROR_SOFTDEVICE_NOT_ENABLED the Softdevice has not been enabled.
+* @return NRF_SUCCESS The statistics were successfully copied.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
 */
-uint32_t rbc_mesh_init(rbc_mesh_init_params_t init_params);
+uint32_t rbc_mesh_timeslot_stats_get(rbc_mesh_timeslot_stats_t* p_stats);
 
 /**
-* @brief Get the current state of the mesh.
+* @brief Get the mesh wide time base. Only available with RBC_MESH_TIME_SYNC.
+*   Unlike the framework's local timestamps, the mesh time is the same on all
+*   synchronized nodes, within the beacon propagation jitter, and may be used
+*   to schedule listening windows or transmissions across the network.
 *
-* @return The state of the mesh.
+* @note The framework's clock only runs inside its timeslots. Outside them,
+*   the mesh time at the end of the previous timeslot is returned.
+*
+* @param[out] p_time Pointer to a structure the mesh time will be copied to.
+*
+* @return NRF_SUCCESS The mesh time was copied.
+* @return NRF_ERROR_NULL The p_time parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIME_SYNC.
 */
-rbc_mesh_state_t rbc_mesh_state_get(void);
+uint32_t rbc_mesh_time_get(rbc_mesh_time_t* p_time);
 
 /**
-* @brief Start mesh radio activity after stopping it.
+* @brief Send a latency probe to another node. Only available with
+*   RBC_MESH_LATENCY_PROBE. The probe floods the mesh, and every relay that
+*   passes it on appends its node ID and the time the probe spent on it. The
+*   target gets the path in an @ref RBC_MESH_EVENT_TYPE_PROBE event, along
+*   with the one-way latency if the mesh time is synchronized, and sends the
+*   probe back. Once the reply arrives, this node gets an
+*   @ref RBC_MESH_EVENT_TYPE_PROBE event with the return path and the round
+*   trip time. The probe takes the fastest path, as the first copy to arrive
+*   is the one that's reported.
 *
-* @details This function is called automatically in the @ref rbc_mesh_init
-*   function, and only has to be explicitly called after a call to
-*   @ref rbc_mesh_stop.
+* @note The node ID of a device is the first two bytes of its factory device
+*   address, NRF_FICR->DEVICEADDR[0].
 *
-* @return NRF_SUCCESS the mesh successfully started radio operation
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized, or
-*   the mesh is already running.
+* @param[in] target Node ID of the node to probe.
+* @param[out] p_seq Sequence number of the probe, for matching it to the
+*   reply. May be NULL.
+*
+* @return NRF_SUCCESS The probe was sent.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The target is this node.
+* @return NRF_ERROR_NO_MEM There are no free packets, or the radio queue is
+*   full.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_LATENCY_PROBE.
 */
-uint32_t rbc_mesh_start(void);
+uint32_t rbc_mesh_probe_send(uint16_t target, uint8_t* p_seq);
 
 /**
-* @brief Stop mesh radio activity.
+* @brief Get runtime statistics for the whole framework, including the packet
+*   pool and timeslot statistics.
 *
-* @details Stop ordering timeslots from the Softdevice, effectively stopping
-*   all radio activity. This allows the chip to enter long-term low power
-*   operation.
+* @note The statistics are also available over the serial ACI and the mesh
+*   GATT service.
 *
-* @note While other mesh calls will work locally, the device will not be able
-*   to transmit or receive anything to/from other devices in the network before
-*   being reactivated by a call to @ref rbc_mesh_start.
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
 *
-* @return NRF_SUCCESS the mesh successfully stopped all radio operation
-* @return NRF_ERROR_INVALID_STATE te framework has not been initialized, or
-*   the mesh operation is already stopped.
+* @return NRF_SUCCESS The statistics were successfully copied.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
 */
-uint32_t rbc_mesh_stop(void);
+uint32_t rbc_mesh_stats_get(rbc_mesh_stats_t* p_stats);
 
 /**
-* @brief Set the contents of the data array pointed to by the provided handle
+* @brief Get the airtime statistics of a single value, to find the handles
+*   that take up the most of the channel.
 *
-* @note If the indicated handle-value pair is in a disabled state, it will
-*   automatically be enabled.
+* @note The statistics are also available over the serial ACI.
 *
-* @param[in] handle The handle of the value we want to update.
-* @param[in] data Databuffer to be copied into the value slot
-* @param[in] len Length of the provided data. Must not exceed RBC_VALUE_MAX_LEN.
+* @param[in] handle Handle of the value.
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
+* @param[in] reset Clear the counters of the value after copying them.
 *
-* @return NRF_SUCCESS if the value has been successfully updated.
-* @return NRF_ERROR_INVALID_STATE if the framework has not been initialized.
-* @return NRF_ERROR_INVALID_ADDR if the handle is outside the range provided
-*    in @ref rbc_mesh_init.
-* @return NRF_ERROR_INVALID_LENGTH if len exceeds RBC_VALUE_MAX_LEN.
+* @return NRF_SUCCESS The statistics were copied.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+* @return NRF_ERROR_NOT_FOUND The value is not in the data cache.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_HANDLE_STATS.
 */
-uint32_t rbc_mesh_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len);
+uint32_t rbc_mesh_handle_stats_get(rbc_mesh_value_handle_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset);
 
 /**
-* @brief Start broadcasting the handle-value pair. If the handle has not been
-*   assigned a value yet, it will start broadcasting a version 0 value with
-*   0 length payload, so that adjacent nodes may push an updated version of
-*   the handle-value pair.
+* @brief Get the timing statistics of an interrupt handler, to find the
+*   handlers that run long enough to make the framework miss the end of a
+*   timeslot.
 *
-* @note The value broadcast is sent asynchronously, and a response is likely
-*   to be received after several milliseconds depending on the adv_int_ms
-*   value set in @ref rbc_mesh_init.
+* @note The statistics are also available over the serial ACI.
 *
-* @param[in] handle The handle to enable.
+* @param[in] isr The handler to get the statistics of.
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
+* @param[in] reset Clear the statistics of the handler after reading them.
 *
-* @return NRF_SUCCESS A request was successfully scheduled for broadcast.
-* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
-* @return NRF_ERROR_INVALID_STATE The framework has not been initiated.
+* @return NRF_SUCCESS The statistics were copied successfully.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_PARAM The handler doesn't exist.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_ISR_STATS.
 */
-uint32_t rbc_mesh_value_enable(rbc_mesh_value_handle_t handle);
+uint32_t rbc_mesh_isr_stats_get(rbc_mesh_isr_t isr, rbc_mesh_isr_stats_t* p_stats, bool reset);
 
 /**
-* @brief Stop rebroadcasting the indicated handle-value pair.
+* @brief Get the RAM used by each part of the framework, and the stack
+*   watermark with RBC_MESH_STACK_WATERMARK, to size the caches and the stack
+*   against the RAM that's left.
 *
-* @note This will not stop the framework from updating the value in its local
-*   database upon external updates (and consequently give the application
-*   update events), but values will not be propagated to other nodes through
-*   this node before they are either written to or re-enabled.
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
 *
-* @param[in] handle Handle to stop broadcasting
+* @return NRF_SUCCESS The statistics were copied successfully.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+*/
+uint32_t rbc_mesh_ram_stats_get(rbc_mesh_ram_stats_t* p_stats);
+
+/**
+* @brief Get the histogram of the time new value versions took to get here
+*   from the node that set them, as measured with RBC_MESH_ORIGIN_TIME. Only
+*   the first copy of each version counts. The delays are only meaningful
+*   once the mesh time has settled on a single root, so reset the statistics
+*   when rbc_mesh_time_get() reports the expected root.
 *
-* @return NRF_SUCCESS The handle was successfully taken off the broadcast list
-* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @note The statistics are also available over the serial ACI.
+*
+* @param[out] p_stats Pointer to a structure the statistics will be copied to.
+* @param[in] reset Clear the statistics after reading them.
+*
+* @return NRF_SUCCESS The statistics were copied successfully.
+* @return NRF_ERROR_NULL The p_stats parameter is NULL.
 * @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_ORIGIN_TIME.
 */
-uint32_t rbc_mesh_value_disable(rbc_mesh_value_handle_t handle);
+uint32_t rbc_mesh_propagation_stats_get(rbc_mesh_propagation_stats_t* p_stats, bool reset);
 
 /**
-* @brief Set whether the given handle should be persistent in the handle cache.
+* @brief Set the time-to-live of a value. If the value doesn't get a new
+*   version within its time-to-live, it stops being transmitted, its data
+*   cache entry is freed, and an @ref RBC_MESH_EVENT_TYPE_VALUE_EXPIRED event
+*   is pushed to the application. The countdown restarts with every new
+*   version. Copies of the expired version from other nodes are still
+*   recognized, and don't bring the value back.
 *
-* @note While non-persistent values may be forgotten by the handle cache, a
-*   persistent value will be retransmitted forever. Note that setting too many
-*   persistent values in the cache will reduce the framework's ability to
-*   retransmit non-persistent values, leading to more packet drops and poor
-*   throughput. It is therefore recommended to be conservative about the
-*   usage of this flag.
-* @note If a device is known to be the lone maintainer of a particular
-*   handle, it is recommended to let the handle be persistent in that device,
-*   as a reset in version numbers may cause a disrupt in communication.
+* @param[in] handle Handle of the value.
+* @param[in] ttl_ms Time-to-live in ms, rounded up to a multiple of
+*   RBC_MESH_VALUE_TTL_TICK_MS, or 0 to keep the value until it's evicted.
 *
-* @param[in] handle Handle to change the Persistent flag for.
-* @param[in] persistent Whether or not to let the value be persistent in the
-*   cache.
+* @return NRF_SUCCESS The time-to-live was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+* @return NRF_ERROR_INVALID_PARAM The time-to-live is longer than 65535 ticks.
+* @return NRF_ERROR_NO_MEM The handle cache is full of persistent values.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_TTL.
+*/
+uint32_t rbc_mesh_value_ttl_set(rbc_mesh_value_handle_t handle, uint32_t ttl_ms);
+
+/**
+* @brief Set the write-combining window of a value. The first local update
+*   of the value goes out right away. Later updates within the window after
+*   a transmitted version share a single new version, which isn't
+*   transmitted before the window has passed. A burst of updates is then sent
+*   as its first and last value, and the value gets at most one new version
+*   and one Trickle reset per window.
 *
-* @return NRF_SUCCESS the persistence configuration has been set successfully.
-* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
-* @return NRF_ERROR_NO_MEM the number of persistent values in the cache exceeds
-*   the cache size.
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @note Leave the window at 0 for values where every update counts, like
+*   message or counter handles.
+*
+* @param[in] handle Handle of the value.
+* @param[in] window_ms Length of the window in ms, 0 to turn write-combining
+*   off.
+*
+* @return NRF_SUCCESS The window was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+* @return NRF_ERROR_NO_MEM The handle cache is full of persistent values.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_WRITE_COMBINING.
 */
-uint32_t rbc_mesh_persistence_set(rbc_mesh_value_handle_t handle, bool persistent);
+uint32_t rbc_mesh_write_combine_set(rbc_mesh_value_handle_t handle, uint16_t window_ms);
 
 /**
-* @brief Set whether the given handle should produce TX events for each time
-*   the value is transmitted.
+* @brief Set the hop scope of a value. New local versions of the value are
+*   relayed at most hops - 1 times, so that they only spend airtime in the
+*   part of the mesh they matter to. Nodes outside the scope never get the
+*   value. Every node relays a version with the largest hop count left of
+*   the copies it has received.
 *
-* @note In order to maintain high performance in the framework, it is
-*   recommended that the amount of values that have this flag set is kept
-*   as low as possible. The flag is set to 0 by default.
-* @note The TX event data-field is set to NULL, and any need to access the
-*   contents of the transmission must be done with the @ref
-*   rbc_mesh_value_get() function.
+* @note The scope is only applied to versions created by this node, and
+*   should be set to the same value on all nodes updating the handle.
+*   Segmented values aren't scoped.
 *
-* @param[in] handle Handle to change TX event flag for
-* @param[in] do_tx_event The TX event configuration for the given value
+* @param[in] handle Handle of the value.
+* @param[in] hops Number of hops the value travels, 1 to only reach the
+*   direct neighbors, or RBC_MESH_HOP_SCOPE_UNLIMITED to reach the whole mesh.
 *
-* @return NRF_SUCCESS the TX event configuration has been set successfully
+* @return NRF_SUCCESS The scope was set, and applies from the next local
+*   update of the value.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is invalid.
+* @return NRF_ERROR_INVALID_PARAM The scope is 0.
+* @return NRF_ERROR_NO_MEM The handle cache is full of persistent values.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_HOP_SCOPES.
+*/
+uint32_t rbc_mesh_hop_scope_set(rbc_mesh_value_handle_t handle, uint8_t hops);
+
+/**
+* @brief Make the given handle a segmented value. A segmented value carries up
+*   to RBC_MESH_SEGMENTED_VALUE_MAX_LEN bytes, split in segments of
+*   RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN bytes that share a single version
+*   number and Trickle timer. Received segments are reassembled, and the
+*   application gets a single RBC_MESH_EVENT_TYPE_NEW_VAL or
+*   RBC_MESH_EVENT_TYPE_UPDATE_VAL event once all segments of a version have
+*   arrived.
+*
+* @note All nodes in the mesh must enable the same handles as segmented
+*   values, as nodes that don't will treat each segment as a regular value.
+* @note The data pointer in the events for segmented values points to an
+*   internal buffer, which is only valid until the next update of the value.
+* @note Segmented values are not mirrored to the GATT service or the serial
+*   interface.
+*
+* @param[in] handle Handle to carry a segmented value.
+*
+* @return NRF_SUCCESS The handle is now a segmented value.
 * @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
-* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application handle range.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_SEGMENTED_VALUE_ENTRIES entries are in use.
 */
-uint32_t rbc_mesh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event);
+uint32_t rbc_mesh_segmented_value_enable(rbc_mesh_value_handle_t handle);
 
 /**
-* @brief Get the contents of the data array pointed to by the provided handle
+* @brief Set the contents of a segmented value, and start broadcasting it.
 *
-* @param[in] handle The handle of the value we want to update.
-* @param[out] data Databuffer to be copied into the value slot. Must be at least
-*    RBC_VALUE_MAX_LEN long.
-* @param[out] len Length of the copied data. Will not exceed RBC_VALUE_MAX_LEN.
+* @param[in] handle Handle of a segmented value.
+* @param[in] data Data to broadcast.
+* @param[in] len Length of the data. Must not exceed RBC_MESH_SEGMENTED_VALUE_MAX_LEN.
 *
-* @return NRF_SUCCESS the value has been successfully fetched.
+* @return NRF_SUCCESS The value was successfully updated.
 * @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
-* @return NRF_ERROR_INVALID_ADDR the handle is invalid.
+* @return NRF_ERROR_NOT_FOUND The handle is not a segmented value.
+* @return NRF_ERROR_INVALID_LENGTH len exceeds RBC_MESH_SEGMENTED_VALUE_MAX_LEN.
+* @return NRF_ERROR_NO_MEM The framework is out of packets or event queue space.
 */
-uint32_t rbc_mesh_value_get(rbc_mesh_value_handle_t handle,
-    uint8_t* data,
-    uint16_t* len);
+uint32_t rbc_mesh_segmented_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len);
 
 /**
-* @brief Get current mesh access address
+* @brief Get the contents of a segmented value. Only succeeds once all
+*   segments of the current version have been received.
 *
-* @param[out] access_addr Pointer location to put access address in
+* @param[in] handle Handle of a segmented value.
+* @param[out] data Buffer to copy the value to. Must be at least
+*   RBC_MESH_SEGMENTED_VALUE_MAX_LEN long.
+* @param[out] len Length of the copied data.
 *
-* @return NRF_SUCCESS the value was fetched successfully
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+* @return NRF_SUCCESS The value was successfully copied.
+* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_ERROR_NOT_FOUND The handle is not a segmented value, or it is not complete.
 */
-uint32_t rbc_mesh_access_address_get(uint32_t* access_address);
+uint32_t rbc_mesh_segmented_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* len);
 
 /**
-* @brief Get current mesh channel
+* @brief Make the given handle a value group, carrying the given component
+*   handles. The components are versioned and sent together in the value of
+*   the group handle, so receivers always see a consistent set of component
+*   values. Each component is a length byte followed by its contents, in the
+*   order they're given here, and all of them together must fit in
+*   RBC_MESH_VALUE_MAX_LEN bytes.
 *
-* @param[out] ch Pointer location to put mesh channel in
+* @note All nodes in the mesh must add the same groups.
+* @note The component handles are never sent on their own.
+*   rbc_mesh_value_set() on a component updates that component in the
+*   group, and rbc_mesh_value_get() reads it from the group value.
+* @note Receivers get a single RBC_MESH_EVENT_TYPE_NEW_VAL or
+*   RBC_MESH_EVENT_TYPE_UPDATE_VAL event on the group handle for each
+*   version, which can be split with rbc_mesh_group_unpack().
 *
-* @return NRF_SUCCESS the value was fetched successfully
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+* @param[in] group_handle Handle to carry the group.
+* @param[in] p_components Array of component handles.
+* @param[in] count Number of components, at most RBC_MESH_GROUP_COMPONENTS_MAX.
+*
+* @return NRF_SUCCESS The group was added.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_components is NULL.
+* @return NRF_ERROR_INVALID_PARAM count is 0 or above RBC_MESH_GROUP_COMPONENTS_MAX.
+* @return NRF_ERROR_INVALID_ADDR A handle is outside the application handle
+*   range, is a segmented value, is given twice or is already in a group.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_GROUPS_MAX groups are in use.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_GROUPS.
 */
-uint32_t rbc_mesh_channel_get(uint8_t* ch);
+uint32_t rbc_mesh_group_add(rbc_mesh_value_handle_t group_handle,
+    const rbc_mesh_value_handle_t* p_components,
+    uint8_t count);
 
 /**
-* @brief Get the mesh minimum transmit interval in ms
+* @brief Set all components of a value group at once, as a single new
+*   version of the group.
 *
-* @param[out] interval_min_ms Pointer location to put adv int in
+* @param[in] group_handle Handle of the group.
+* @param[in] pp_data Array of component contents, in the order of the
+*   components.
+* @param[in] p_lens Array of component lengths.
 *
-* @return NRF_SUCCESS the value was fetched successfully
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized
+* @return NRF_SUCCESS The group was updated.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL pp_data or p_lens is NULL.
+* @return NRF_ERROR_NOT_FOUND The handle is not a value group.
+* @return NRF_ERROR_INVALID_LENGTH The components don't fit in a value.
+* @return NRF_ERROR_NO_MEM The framework is out of packets.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_GROUPS.
 */
-uint32_t rbc_mesh_interval_min_ms_get(uint32_t* interval_min_ms);
+uint32_t rbc_mesh_group_set(rbc_mesh_value_handle_t group_handle,
+    uint8_t* const* pp_data,
+    const uint16_t* p_lens);
 
 /**
-* @brief get whether the given handle has its persistence flag set
+* @brief Split the value of a group into its components, without copying.
+*   Works on the data of the group events, and on the value read with
+*   rbc_mesh_value_get() on the group handle.
 *
-* @param[in] handle The handle whose flag should be checked.
-* @param[out] is_persistent a pointer to a boolean to which the flag status will
-*   be copied.
+* @param[in] group_handle Handle of the group.
+* @param[in] p_data Value of the group.
+* @param[in] len Length of the group value.
+* @param[out] pp_data Array of RBC_MESH_GROUP_COMPONENTS_MAX pointers, set
+*   to the contents of each component.
+* @param[out] p_lens Array of RBC_MESH_GROUP_COMPONENTS_MAX lengths, set to
+*   the length of each component.
+* @param[out] p_count Number of components in the group.
 *
-* @return NRF_SUCCESS The flag status was successfully copied to the parameter.
-* @return NRF_ERROR_INVALID_STATE The framework has not been initilalized.
-* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
-* @return NRF_ERROR_INVALID_ADDR The given handle is invalid.
+* @return NRF_SUCCESS The value was split.
+* @return NRF_ERROR_NULL A parameter is NULL.
+* @return NRF_ERROR_NOT_FOUND The handle is not a value group.
+* @return NRF_ERROR_INVALID_DATA The value doesn't match the components of
+*   the group.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_GROUPS.
 */
-uint32_t rbc_mesh_persistence_get(rbc_mesh_value_handle_t handle, bool* is_persistent);
+uint32_t rbc_mesh_group_unpack(rbc_mesh_value_handle_t group_handle,
+    const uint8_t* p_data,
+    uint16_t len,
+    const uint8_t** pp_data,
+    uint16_t* p_lens,
+    uint8_t* p_count);
 
 /**
-* @brief get whether the given handle has its tx_event flag set
+* @brief Make the given handle a time series, that batches timestamped
+*   samples into its value instead of making a new version for each. The
+*   samples are delta encoded, so a slowly changing reading takes two or three
+*   bytes per sample. The value is published as a new version once it holds
+*   batch_count samples, or once the next sample wouldn't fit in
+*   RBC_MESH_VALUE_MAX_LEN bytes.
 *
-* @param[in] handle The handle whose flag should be checked.
-* @param[out] is_doing_tx_event a pointer to a boolean to which the flag status will
-*   be copied.
+* @note Only the publishing node enables the series. Receivers get the
+*   batches in regular RBC_MESH_EVENT_TYPE_NEW_VAL and
+*   RBC_MESH_EVENT_TYPE_UPDATE_VAL events, and split them with
+*   rbc_mesh_series_unpack().
+* @note The mesh only guarantees that the newest version arrives. Every
+*   batch starts with the index of its first sample, so receivers can tell
+*   when they missed a batch. Pick batch_count so that a batch stays up for
+*   longer than it takes to propagate through the mesh.
+* @note rbc_mesh_value_set() is refused on a time series handle.
 *
-* @return NRF_SUCCESS The flag status was successfully copied to the parameter.
-* @return NRF_ERROR_INVALID_STATE The framework has not been initilalized.
-* @return NRF_ERROR_NOT_FOUND The given handle is not present in the cache.
-* @return NRF_ERROR_INVALID_ADDR The given handle is invalid.
+* @param[in] handle Handle to publish the series on.
+* @param[in] batch_count Number of samples per version, 0 to fill the value.
+*
+* @return NRF_SUCCESS The handle is a time series.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application handle
+*   range, is a segmented value, is in a value group or is already a time
+*   series.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_SERIES_MAX time series are in use.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIME_SERIES.
 */
-uint32_t rbc_mesh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* is_doing_tx_event);
+uint32_t rbc_mesh_series_enable(rbc_mesh_value_handle_t handle, uint8_t batch_count);
 
 /**
-* @brief Set TX power for mesh packets.
+* @brief Add a sample to a time series. Must be called from the application
+*   context. The timestamp is up to the application, e.g. the RTC or the mesh
+*   time in milliseconds. Timestamps that increase by small steps take the
+*   least space, and wrap around without trouble.
 *
-* @param[in] tx_power TX power from @rbc_mesh_txpower_t enum.
+* @note A batch that can't be published for lack of packets is kept, and
+*   published with the next sample or rbc_mesh_series_flush().
+*
+* @param[in] handle Handle of the time series.
+* @param[in] timestamp_ms Time of the sample, in milliseconds.
+* @param[in] value Sample value.
+*
+* @return NRF_SUCCESS The sample was added, and published if the batch is
+*   full.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_FOUND The handle is not a time series.
+* @return NRF_ERROR_NO_MEM The full batch couldn't be published to make
+*   room for the sample, and the sample was dropped.
+* @return NRF_ERROR_INVALID_LENGTH The sample doesn't fit in a value on its
+*   own, with the encryption and hop scope overhead.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIME_SERIES.
 */
-void rbc_mesh_tx_power_set(rbc_mesh_txpower_t tx_power);
+uint32_t rbc_mesh_series_sample_add(rbc_mesh_value_handle_t handle, uint32_t timestamp_ms, int32_t value);
 
 /**
-* @brief Event handler to be called upon Softdevice BLE event arrival.
+* @brief Publish the samples of a time series that haven't been published
+*   yet, without waiting for the batch to fill up. Must be called from the
+*   application context.
 *
-* @details Event handler taking care of all mesh behavior related to BLE.
-*   Typical events to trigger processing or local changes are
-*   writes to the value characteristic or a change in connection status. The
-*   framework will give events to the application if the function triggers a
-*   write to a handle value or similar.
+* @param[in] handle Handle of the time series.
 *
-* @note This event may be called regardless of whether the event is relevant
-*   to the mesh or not - the framework will filter out uninteresting
-*   events and return NRF_SUCCESS.
+* @return NRF_SUCCESS The samples were published, or there were none.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NOT_FOUND The handle is not a time series.
+* @return NRF_ERROR_NO_MEM The framework is out of packets, the samples are
+*   kept.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIME_SERIES.
+*/
+uint32_t rbc_mesh_series_flush(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Decode the samples of a time series value. Works on the data of the
+*   events on the series handle, and on the value read with
+*   rbc_mesh_value_get().
 *
-* @param[in] p_evt BLE event received from softdevice.
+* @param[in] p_data Value of the time series.
+* @param[in] len Length of the value.
+* @param[out] p_first_index Index of the first sample in the value, counted
+*   from the first sample the publisher added.
+* @param[out] p_samples Array to decode the samples into.
+* @param[in,out] p_count Length of the p_samples array, at most
+*   RBC_MESH_SERIES_SAMPLES_MAX is needed. Set to the number of samples.
+*
+* @return NRF_SUCCESS The value was decoded.
+* @return NRF_ERROR_NULL A parameter is NULL.
+* @return NRF_ERROR_INVALID_DATA The value is not a time series value.
+* @return NRF_ERROR_INVALID_LENGTH The value holds more than *p_count samples.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_TIME_SERIES.
 */
-void rbc_mesh_ble_evt_handler(ble_evt_t* p_evt);
+uint32_t rbc_mesh_series_unpack(const uint8_t* p_data,
+    uint16_t len,
+    uint32_t* p_first_index,
+    rbc_mesh_series_sample_t* p_samples,
+    uint8_t* p_count);
 
 /**
-* @brief Event handler to be called upon regular Softdevice event arrival.
+* @brief Keep a shadow copy of the given value, which the mesh updates with
+*   every new version. rbc_mesh_value_get() reads shadowed values without
+*   locks or interrupt masking, so polling them doesn't hold up the mesh,
+*   and takes the same time whatever the mesh is doing. A read that collides
+*   with an update from a context it interrupted falls back to the regular,
+*   locked path.
 *
-* @details Event handler taking care of all mesh behavior related to the
-*   Softdevice. Events are expected to be in the range
+* @note The fallback is the same locked read as for any other handle, so a
+*   shadowed handle may only be read from the contexts rbc_mesh_value_get()
+*   is allowed in otherwise. The shadow makes the read fast there, it doesn't
+*   make it safe from higher interrupt priorities.
 *
-* @note This event may be called regardless of whether the event is relevant
-*   to the mesh or not - the framework will filter out uninteresting
-*   events and return NRF_SUCCESS.
+* @param[in] handle Handle of the value to shadow.
 *
-* @param[in] evt event received from Softdevice through the sd_evt_get() call.
+* @return NRF_SUCCESS The value is shadowed, or was already.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application handle
+*   range, or is a segmented value.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_VALUE_SHADOW_ENTRIES entries are in use.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_SHADOW.
 */
-void rbc_mesh_sd_evt_handler(uint32_t evt);
+uint32_t rbc_mesh_value_shadow_add(rbc_mesh_value_handle_t handle);
 
 /**
-* @brief Get an event from the mesh.
+* @brief Get the reception statistics of an advertisement channel, and
+*   whether the channel is in use.
 *
-* @param[out] p_evt A pointer to the struct the event should be copied to.
-*   May be set to NULL if the contents of the event isn't important.
+* @param[in] channel Advertisement channel, 37 to 39.
+* @param[out] p_stats Statistics of the channel.
 *
-* @return NRF_SUCCESS An event was successfully popped and copied into the
-*   p_evt-parameter.
-* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @return NRF_SUCCESS The statistics were copied.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_stats is NULL.
+* @return NRF_ERROR_INVALID_PARAM The channel isn't an advertisement channel.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_CHANNEL_QUALITY.
 */
-uint32_t rbc_mesh_event_get(rbc_mesh_event_t* p_evt);
+uint32_t rbc_mesh_channel_stats_get(uint8_t channel, rbc_mesh_channel_stats_t* p_stats);
 
 /**
-* @brief Get an event from the mesh, but don't remove it from the queue.
+* @brief Have the values of the given handle take effect at the mesh time
+*   they carry, see rbc_mesh_value_set_at(). The
+*   @ref RBC_MESH_EVENT_TYPE_NEW_VAL and @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL
+*   events of the handle are held until then, so all nodes raise them at the
+*   same time, however many hops they are from the origin. Must be enabled
+*   on all nodes that act on the value.
 *
-* @note This call has the same effect as the rbc_mesh_event_get call, except
-*   it does not remove the event from the queue. Repeated calls to the peek
-*   function will yield the same event.
+* @param[in] handle Handle of the scheduled value.
 *
-* @param[out] p_evt A pointer to the struct the event should be copied to.
+* @return NRF_SUCCESS The handle is scheduled, or was already.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application handle
+*   range, or is a segmented value or part of a value group.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_SCHEDULED_HANDLES_MAX entries are in
+*   use.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_SCHEDULED_VALUES.
+*/
+uint32_t rbc_mesh_scheduled_value_enable(rbc_mesh_value_handle_t handle);
+
+/**
+* @brief Set a scheduled value, to take effect at the given mesh time. The
+*   value is sent right away, with the activation time in its first
+*   RBC_MESH_SCHEDULE_OVERHEAD bytes, and the nodes raise its event at the
+*   activation time, with the activation time stripped from the data. This
+*   node raises an @ref RBC_MESH_EVENT_TYPE_UPDATE_VAL event for its own
+*   value at the same time. Nodes that get the value after its activation
+*   time raise the event at once.
 *
-* @return NRF_SUCCESS An event was successfully popped and copied into the
-*   p_evt-parameter.
-* @return NRF_ERROR_NOT_FOUND No events ready to be pulled.
-* @return NRF_ERROR_NULL The p_evt parameter is NULL.
-* @return NRF_ERROR_INVALID_STATE the framework has not been initialized.
+* @note Leave enough time for the value to reach the furthest node, a few
+*   Trickle intervals per hop. rbc_mesh_value_get() returns the value with
+*   the activation time in front of it.
+*
+* @param[in] handle Handle of the scheduled value.
+* @param[in] data Value contents.
+* @param[in] len Length of the value contents, at most RBC_MESH_VALUE_MAX_LEN
+*   - RBC_MESH_SCHEDULE_OVERHEAD.
+* @param[in] activation_time_us Mesh time the value takes effect at, see
+*   rbc_mesh_time_get().
+*
+* @return NRF_SUCCESS The value was set.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle isn't scheduled.
+* @return NRF_ERROR_NULL data is NULL, and len isn't 0.
+* @return NRF_ERROR_INVALID_LENGTH The value is too long.
+* @return NRF_ERROR_INVALID_PARAM The activation time is more than
+*   RBC_MESH_SCHEDULE_MAX_AHEAD_US ahead.
+* @return NRF_ERROR_NO_MEM The value was set, but there was no packet to
+*   hold this node's own event.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_SCHEDULED_VALUES.
 */
-uint32_t rbc_mesh_event_peek(rbc_mesh_event_t* p_evt);
+uint32_t rbc_mesh_value_set_at(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len, uint32_t activation_time_us);
 
 /**
-* @brief Free the memory associated with the given mesh event.
-*   Provides the same functionality as @rbc_mesh_packet_release, but hides the
-*   different event types and their parameters. Will work on any event.
+* @brief Keep the last RBC_MESH_VALUE_HISTORY_DEPTH versions of the given
+*   handle, received or set locally, for rbc_mesh_value_history_get(). The
+*   history starts with the next version stored.
 *
-* @details: In order to reduce the amount of data copying going on for each
-*   data packet, the various data fields of an rbc_mesh_event points directly
-*   to the framework packet pool. This memory is managed by the mesh_packet
-*   module, and must be explicitly released when the contents is no longer in
-*   use. Failure to do so will result in a NO_MEM error when the framework runs
-*   out of available packets in the packet pool.
+* @param[in] handle Handle to keep the history of.
 *
-* @param[in] p_evt Pointer to a mesh event fetched with rbc_mesh_event_get.
+* @return NRF_SUCCESS The handle has a history, or already had.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_INVALID_ADDR The handle is outside the application handle
+*   range, or is a segmented value or part of a value group.
+* @return NRF_ERROR_NO_MEM All RBC_MESH_VALUE_HISTORY_HANDLES_MAX histories are
+*   in use.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_HISTORY.
 */
-void rbc_mesh_event_release(rbc_mesh_event_t* p_evt);
+uint32_t rbc_mesh_value_history_enable(rbc_mesh_value_handle_t handle);
 
 /**
-* @brief Set packet peek function pointer. Every received packet will be
-*   passed to the peek function before being processed by the stack -
-*   including non-mesh packets. This allows the application to read
-*   out parameters like RSSI from nearby devices.
+* @brief Get the oldest version in the history of a handle that is newer than
+*   the given version. Call again with the version returned to walk the
+*   history from oldest to newest. If the first version returned isn't the
+*   one right after the given version, the versions in between were either
+*   never seen by this node or have left the history.
 *
-* @warning This is considered an advanced feature, and should be used with some
-*   care. The packet memory will be invalid after the function is finished, and
-*   users should not store any direct pointers to it. Also note that the
-*   function is called from APP_LOW priority, which means it takes away from
-*   stack-internal processing time. Excessive usage may lead to starvation of
-*   internal functionality, and potentially packet drops.
+* @param[in] handle Handle to get the history of.
+* @param[in] after_version Newest version the caller already has, 0 for the
+*   whole history.
+* @param[out] p_entry The version, its contents and the time it was stored.
 *
-* @param[in] packet_peek_cb Function pointer to a packet-peek function.
+* @return NRF_SUCCESS The entry was copied to p_entry.
+* @return NRF_ERROR_INVALID_STATE The framework has not been initialized.
+* @return NRF_ERROR_NULL p_entry is NULL.
+* @return NRF_ERROR_INVALID_ADDR The handle has no history.
+* @return NRF_ERROR_NOT_FOUND The history has no newer version.
+* @return NRF_ERROR_NOT_SUPPORTED The framework was built without
+*   RBC_MESH_VALUE_HISTORY.
 */
-void rbc_mesh_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb);
+uint32_t rbc_mesh_value_history_get(rbc_mesh_value_handle_t handle, uint16_t after_version, rbc_mesh_history_entry_t* p_entry);
 
 #endif /* _RBC_MESH_H__ */
 
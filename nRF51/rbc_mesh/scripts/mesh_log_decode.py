@@ -0,0 +1,80 @@
+"""Decoder for the deferred binary log streamed over RTT (see mesh_log.h).
+
+Capture the log channel to a file, e.g. with
+    JLinkRTTLogger -Device NRF51822_XXAA -If SWD -Speed 4000 -RTTChannel 2 log.bin
+and run
+    python mesh_log_decode.py log.bin formats.txt
+
+The format file maps the application's format IDs to printf style format
+strings, one per line, with the ID first:
+    0x0100 ack seq=%u rtt=%u us
+Each format takes up to two arguments. Lines starting with # are ignored.
+"""
+from __future__ import print_function
+import struct
+import sys
+
+RECORD_FORMAT = "<IHHII"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+ID_DROPPED = 0x0000
+FORMATS = {
+    ID_DROPPED: "*** %u records dropped ***",
+}
+
+
+def formats_load(file_name):
+    formats = dict(FORMATS)
+    with open(file_name, "r") as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            (log_id, _, fmt) = line.partition(" ")
+            formats[int(log_id, 0)] = fmt.strip()
+    return formats
+
+
+def records_get(data):
+    for offset in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+        (timestamp, log_id, _, arg0, arg1) = struct.unpack_from(RECORD_FORMAT, data, offset)
+        yield (timestamp, log_id, arg0, arg1)
+
+
+def record_format(formats, log_id, arg0, arg1):
+    fmt = formats.get(log_id)
+    if fmt is None:
+        return "ID_0x%04X 0x%08X 0x%08X" % (log_id, arg0, arg1)
+    args = (arg0, arg1)[:fmt.count("%") - 2 * fmt.count("%%")]
+    try:
+        return fmt % args
+    except (TypeError, ValueError):
+        return "%s [0x%08X 0x%08X]" % (fmt, arg0, arg1)
+
+
+def decode(data, formats):
+    dropped = 0
+    count = 0
+    for timestamp, log_id, arg0, arg1 in records_get(data):
+        if log_id == ID_DROPPED:
+            dropped += arg0
+        count += 1
+        print("%10d %s" % (timestamp, record_format(formats, log_id, arg0, arg1)))
+
+    if len(data) % RECORD_SIZE:
+        print("Warning: %d trailing bytes ignored" % (len(data) % RECORD_SIZE))
+    print("\n%d records, %d dropped on target" % (count, dropped))
+
+
+def main():
+    if len(sys.argv) not in (2, 3) or "-h" in sys.argv:
+        print("Usage: mesh_log_decode.py <log file> [format file]")
+        exit(1)
+
+    formats = formats_load(sys.argv[2]) if len(sys.argv) == 3 else dict(FORMATS)
+    with open(sys.argv[1], "rb") as log_file:
+        decode(log_file.read(), formats)
+
+
+if __name__ == "__main__":
+    main()
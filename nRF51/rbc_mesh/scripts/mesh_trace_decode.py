@@ -0,0 +1,146 @@
+"""Decoder for the binary mesh trace streamed over RTT (see mesh_trace.h).
+
+Capture the trace channel to a file, e.g. with
+    JLinkRTTLogger -Device NRF51822_XXAA -If SWD -Speed 4000 -RTTChannel 1 trace.bin
+and run
+    python mesh_trace_decode.py trace.bin [-v]
+
+Prints a latency histogram for every traced section, built from matching
+enter and exit records, and an interval histogram for marker records.
+"""
+from __future__ import print_function
+import struct
+import sys
+
+RECORD_FORMAT = "<IBBH"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+TYPE_ENTER = 0
+TYPE_EXIT = 1
+TYPE_MARK = 2
+
+POINT_OVERFLOW = 0
+POINT_NAMES = {
+    0x00: "OVERFLOW",
+    0x01: "TIMESLOT",
+    0x02: "TS_SIGNAL",
+    0x03: "RADIO_IRQ",
+    0x04: "EVENT",
+    0x05: "RX_PACKET",
+    0x06: "TX",
+    0x07: "HANDLE_STORAGE_TX",
+    0x08: "DATA_ENTRY_ALLOC",
+    0x09: "FLASH_OP",
+}
+
+HISTOGRAM_WIDTH = 50
+
+
+def point_name(point):
+    return POINT_NAMES.get(point, "POINT_0x%02X" % point)
+
+
+def time_diff(later, earlier):
+    return (later - earlier) & 0xFFFFFFFF
+
+
+def records_get(data):
+    for offset in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+        yield struct.unpack_from(RECORD_FORMAT, data, offset)
+
+
+def bucket_get(value):
+    """Power of two bucket index: bucket n holds values in [2^(n-1), 2^n)."""
+    bucket = 0
+    while value > 0:
+        value >>= 1
+        bucket += 1
+    return bucket
+
+
+def bucket_label(bucket):
+    if bucket == 0:
+        return "0"
+    return "%d-%d" % (1 << (bucket - 1), (1 << bucket) - 1)
+
+
+def percentile(sorted_values, fraction):
+    index = int(fraction * (len(sorted_values) - 1))
+    return sorted_values[index]
+
+
+def histogram_print(title, values):
+    values = sorted(values)
+    print("%s: count %d, min %d us, avg %d us, p50 %d us, p99 %d us, max %d us" % (
+        title, len(values), values[0], sum(values) // len(values),
+        percentile(values, 0.5), percentile(values, 0.99), values[-1]))
+
+    buckets = {}
+    for value in values:
+        bucket = bucket_get(value)
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+    largest = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        bar = "#" * ((count * HISTOGRAM_WIDTH + largest - 1) // largest)
+        print("  %14s us | %-*s %d" % (bucket_label(bucket), HISTOGRAM_WIDTH, bar, count))
+    print()
+
+
+def decode(data, verbose):
+    pending = {}    # point -> enter timestamp, sections of the same point don't nest
+    last_mark = {}  # point -> timestamp of last marker
+    durations = {}  # point -> list of enter-exit times
+    intervals = {}  # point -> list of marker intervals
+    dropped = 0
+    unmatched = 0
+
+    for timestamp, point, record_type, record_data in records_get(data):
+        if verbose:
+            print("%10d %-18s %-5s %d" % (timestamp, point_name(point),
+                  ("ENTER", "EXIT", "MARK")[record_type] if record_type <= TYPE_MARK else "?",
+                  record_data))
+
+        if point == POINT_OVERFLOW:
+            # records are missing, the open sections can't be matched
+            dropped += record_data
+            unmatched += len(pending)
+            pending.clear()
+            last_mark.clear()
+        elif record_type == TYPE_ENTER:
+            pending[point] = timestamp
+        elif record_type == TYPE_EXIT:
+            enter_time = pending.pop(point, None)
+            if enter_time is None:
+                unmatched += 1
+            else:
+                durations.setdefault(point, []).append(time_diff(timestamp, enter_time))
+        elif record_type == TYPE_MARK:
+            if point in last_mark:
+                intervals.setdefault(point, []).append(time_diff(timestamp, last_mark[point]))
+            last_mark[point] = timestamp
+
+    if len(data) % RECORD_SIZE:
+        print("Warning: %d trailing bytes ignored" % (len(data) % RECORD_SIZE))
+    print("%d records, %d dropped on target, %d unmatched enter/exit records\n" % (
+        len(data) // RECORD_SIZE, dropped, unmatched + len(pending)))
+
+    for point in sorted(durations):
+        histogram_print("%s duration" % point_name(point), durations[point])
+    for point in sorted(intervals):
+        histogram_print("%s interval" % point_name(point), intervals[point])
+
+
+def main():
+    args = [arg for arg in sys.argv[1:] if not arg.startswith("-")]
+    if len(args) != 1 or "-h" in sys.argv:
+        print("Usage: mesh_trace_decode.py <trace file> [-v]")
+        print("\t-v\tPrint every record")
+        exit(1)
+
+    with open(args[0], "rb") as trace_file:
+        decode(trace_file.read(), "-v" in sys.argv)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,24 @@
+/* Host build stand-in for the SDK error handler, aborts the simulation. */
+#ifndef SIM_APP_ERROR_H__
+#define SIM_APP_ERROR_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nrf_error.h"
+
+#define APP_ERROR_CHECK(err_code) do { \
+        uint32_t _err = (err_code); \
+        if (_err != NRF_SUCCESS) { \
+            fprintf(stderr, "%s:%d: error 0x%x\n", __FILE__, __LINE__, (unsigned) _err); \
+            abort(); \
+        } \
+    } while (0)
+
+#define APP_ERROR_CHECK_BOOL(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed\n", __FILE__, __LINE__); \
+            abort(); \
+        } \
+    } while (0)
+
+#endif /* SIM_APP_ERROR_H__ */
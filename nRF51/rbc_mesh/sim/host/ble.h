@@ -0,0 +1,24 @@
+/* Host build stand-in for the Softdevice BLE header. */
+#ifndef SIM_BLE_H__
+#define SIM_BLE_H__
+
+#include <stdint.h>
+
+#define BLE_GAP_ADDR_LEN    (6)
+
+typedef struct
+{
+    uint8_t addr_type;
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+} ble_gap_addr_t;
+
+typedef struct
+{
+    struct
+    {
+        uint16_t evt_id;
+        uint16_t evt_len;
+    } header;
+} ble_evt_t;
+
+#endif /* SIM_BLE_H__ */
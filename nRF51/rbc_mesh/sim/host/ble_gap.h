@@ -0,0 +1,8 @@
+/* Host build stand-in for the Softdevice GAP header, the address type is in
+   ble.h. */
+#ifndef SIM_BLE_GAP_H__
+#define SIM_BLE_GAP_H__
+
+#include "ble.h"
+
+#endif /* SIM_BLE_GAP_H__ */
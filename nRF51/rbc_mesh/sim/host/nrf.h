@@ -0,0 +1,23 @@
+/* Host build stand-in for the nRF51 device header, only provides what the
+   simulated core modules need. */
+#ifndef SIM_NRF_H__
+#define SIM_NRF_H__
+
+#include <stdint.h>
+
+#define __ASM           __asm__
+#define __NOP()
+#define __enable_irq()
+#define __disable_irq() (0)
+#define __DMB()         __sync_synchronize()
+
+/** Device address registers, backed by the tool that needs them. */
+typedef struct
+{
+    uint32_t DEVICEADDRTYPE;
+    uint32_t DEVICEADDR[2];
+} NRF_FICR_Type;
+
+extern NRF_FICR_Type* NRF_FICR;
+
+#endif /* SIM_NRF_H__ */
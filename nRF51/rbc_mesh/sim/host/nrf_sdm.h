@@ -0,0 +1,9 @@
+/* Host build stand-in for the Softdevice manager header. */
+#ifndef SIM_NRF_SDM_H__
+#define SIM_NRF_SDM_H__
+
+#include "nrf_error.h"
+
+typedef uint8_t nrf_clock_lfclksrc_t;
+
+#endif /* SIM_NRF_SDM_H__ */
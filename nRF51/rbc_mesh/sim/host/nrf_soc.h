@@ -0,0 +1,11 @@
+/* Host build stand-in for the Softdevice SoC header. */
+#ifndef SIM_NRF_SOC_H__
+#define SIM_NRF_SOC_H__
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+uint32_t sd_rand_application_bytes_available_get(uint8_t* p_bytes_available);
+uint32_t sd_rand_application_vector_get(uint8_t* p_buff, uint8_t length);
+
+#endif /* SIM_NRF_SOC_H__ */
@@ -0,0 +1,535 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file Host microbenchmark of the framework's core modules. Runs the
+*   hot API calls of fifo.c, mesh_packet.c, trickle.c, handle_storage.c and
+*   version_handler.c in a loop on the host, with the rest of the framework
+*   replaced by the stand-ins in mesh_host.c, and reports the time and the
+*   number of packet allocations per call. The handle storage and version
+*   handler calls run on a range of cache sizes and fill levels.
+*
+*   Packet allocations are counted by wrapping mesh_packet_acquire() at link
+*   time. The core modules don't allocate any other memory at runtime.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "rbc_mesh.h"
+#include "mesh_host.h"
+#include "transport_control.h"
+#include "version_handler.h"
+#include "handle_storage.h"
+#include "mesh_packet.h"
+#include "trickle.h"
+#include "fifo.h"
+
+/*****************************************************************************
+* Local defines
+*****************************************************************************/
+/** Length of the FIFO in the FIFO benchmark. */
+#define BENCH_FIFO_LENGTH       (16)
+/** Payload length of the benchmark values. */
+#define BENCH_VALUE_LENGTH      (8)
+/** Packets in the pool beyond the ones the data cache holds. */
+#define BENCH_POOL_SLACK        (16)
+
+/*****************************************************************************
+* Local typedefs
+*****************************************************************************/
+typedef struct
+{
+    uint32_t iterations;
+    uint32_t seed;
+    bool csv;
+    bool memory;
+} bench_config_t;
+
+typedef struct
+{
+    uint64_t ns;
+    uint32_t allocs;
+    uint32_t count;
+} bench_result_t;
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static bench_config_t m_config =
+{
+    .iterations = 10000,
+    .seed       = 1,
+    .csv        = false,
+    .memory     = false,
+};
+
+static const uint16_t m_cache_sizes[] = {16, 64, 256, 1024};
+static const uint8_t m_fill_levels[] = {25, 50, 100};
+
+static uint32_t m_alloc_count;
+static uint64_t m_timer_overhead;
+static uint32_t m_time;
+static uint32_t m_prng;
+static uint16_t* mp_versions;
+static void* mp_pool_memory;
+static void* mp_cache_memory;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static uint64_t time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static uint32_t prng_get(void)
+{
+    m_prng = m_prng * 1664525 + 1013904223;
+    return m_prng >> 8;
+}
+
+/** Handle of the given cache entry, spread out over the handle range. */
+static rbc_mesh_value_handle_t bench_handle(uint32_t index)
+{
+    return (rbc_mesh_value_handle_t) ((index * 97 + 1) % RBC_MESH_APP_MAX_HANDLE);
+}
+
+static inline uint64_t bench_start(bench_result_t* p_result)
+{
+    p_result->allocs -= m_alloc_count;
+    return time_ns();
+}
+
+static inline void bench_stop(bench_result_t* p_result, uint64_t start)
+{
+    uint64_t ns = time_ns() - start;
+    p_result->allocs += m_alloc_count;
+    p_result->ns += (ns > m_timer_overhead) ? ns - m_timer_overhead : 0;
+    p_result->count++;
+}
+
+static void result_print(const char* p_name, uint32_t entries, uint32_t fill, bench_result_t* p_result)
+{
+    double ns_per_op = (p_result->count > 0) ? (double) p_result->ns / p_result->count : 0;
+    double allocs_per_op = (p_result->count > 0) ? (double) p_result->allocs / p_result->count : 0;
+    if (m_config.csv)
+    {
+        printf("%s,%u,%u,%u,%.1f,%.2f\n", p_name, entries, fill, p_result->count, ns_per_op, allocs_per_op);
+    }
+    else
+    {
+        printf("%-22s %8u %5u%% %10.1f ns/op %6.2f allocs/op\n", p_name, entries, fill, ns_per_op, allocs_per_op);
+    }
+    memset(p_result, 0, sizeof(bench_result_t));
+}
+
+static void timer_overhead_calibrate(void)
+{
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    m_timer_overhead = 0;
+    for (uint32_t i = 0; i < m_config.iterations; ++i)
+    {
+        bench_stop(&result, bench_start(&result));
+    }
+    m_timer_overhead = result.ns / result.count;
+}
+
+/** Set up the framework with caches of the given size, and a packet pool to fill them. */
+static void framework_init(uint16_t handle_entries, uint16_t data_entries)
+{
+    uint16_t pool_size = data_entries + BENCH_POOL_SLACK;
+    free(mp_pool_memory);
+    mp_pool_memory = malloc(mesh_packet_memory_size_get(pool_size));
+
+    handle_storage_memory_t memory;
+    memory.handle_cache_entries = handle_entries;
+    memory.data_cache_entries = data_entries;
+    memory.pinned_data_entries = 0;
+    free(mp_cache_memory);
+    mp_cache_memory = malloc(handle_storage_memory_size_get(handle_entries, data_entries));
+    memory.p_memory = mp_cache_memory;
+
+    mesh_host_init(m_config.seed);
+    if (mp_pool_memory == NULL || mp_cache_memory == NULL ||
+        mesh_packet_init(mp_pool_memory, pool_size) != NRF_SUCCESS)
+    {
+        fprintf(stderr, "Framework init failed\n");
+        exit(1);
+    }
+    tc_init(RBC_MESH_ACCESS_ADDRESS_BLE_ADV, 38);
+    if (vh_init(100000, RBC_MESH_ACCESS_ADDRESS_BLE_ADV, 38, RBC_MESH_TXPOWER_0dBm, &memory) != NRF_SUCCESS)
+    {
+        fprintf(stderr, "Framework init failed\n");
+        exit(1);
+    }
+    tc_on_ts_begin();
+    (void) vh_on_timeslot_begin();
+    mesh_host_events_run();
+}
+
+static void bench_fifo(void)
+{
+    rbc_mesh_event_t fifo_buffer[BENCH_FIFO_LENGTH];
+    fifo_t fifo;
+    fifo.elem_array = fifo_buffer;
+    fifo.elem_size = sizeof(rbc_mesh_event_t);
+    fifo.array_len = BENCH_FIFO_LENGTH;
+    fifo.memcpy_fptr = NULL;
+
+    rbc_mesh_event_t evt;
+    memset(&evt, 0, sizeof(evt));
+    bench_result_t push;
+    bench_result_t pop;
+    memset(&push, 0, sizeof(push));
+    memset(&pop, 0, sizeof(pop));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* one slot is left free for the push */
+        uint32_t fill = ((BENCH_FIFO_LENGTH - 1) * m_fill_levels[f]) / 100;
+        fifo_init(&fifo);
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            (void) fifo_push(&fifo, &evt);
+        }
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            uint64_t start = bench_start(&push);
+            (void) fifo_push(&fifo, &evt);
+            bench_stop(&push, start);
+
+            start = bench_start(&pop);
+            (void) fifo_pop(&fifo, &evt);
+            bench_stop(&pop, start);
+        }
+        result_print("fifo_push", BENCH_FIFO_LENGTH, m_fill_levels[f], &push);
+        result_print("fifo_pop", BENCH_FIFO_LENGTH, m_fill_levels[f], &pop);
+    }
+}
+
+static void bench_packet_pool(void)
+{
+    const uint16_t data_entries = 64;
+    const uint16_t pool_size = data_entries + BENCH_POOL_SLACK;
+    framework_init(data_entries * 2, data_entries);
+    mesh_packet_t** pp_held = malloc(sizeof(mesh_packet_t*) * pool_size);
+    bench_result_t acquire;
+    bench_result_t release;
+    memset(&acquire, 0, sizeof(acquire));
+    memset(&release, 0, sizeof(release));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* one packet is left free for the acquire */
+        uint32_t fill = ((pool_size - 1) * m_fill_levels[f]) / 100;
+        (void) mesh_packet_init(mp_pool_memory, pool_size);
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            (void) mesh_packet_acquire(&pp_held[i]);
+        }
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            mesh_packet_t* p_packet = NULL;
+            uint64_t start = bench_start(&acquire);
+            (void) mesh_packet_acquire(&p_packet);
+            bench_stop(&acquire, start);
+
+            start = bench_start(&release);
+            (void) mesh_packet_ref_count_dec(p_packet);
+            bench_stop(&release, start);
+        }
+        result_print("mesh_packet_acquire", pool_size, m_fill_levels[f], &acquire);
+        result_print("mesh_packet_release", pool_size, m_fill_levels[f], &release);
+    }
+    free(pp_held);
+}
+
+static void bench_trickle(void)
+{
+    bench_result_t timeout;
+    memset(&timeout, 0, sizeof(timeout));
+    trickle_t trickle;
+    memset(&trickle, 0, sizeof(trickle));
+    trickle_timer_reset(&trickle, m_time);
+
+    for (uint32_t i = 0; i < m_config.iterations; ++i)
+    {
+        bool do_tx;
+        uint32_t time_now = trickle.t;
+        uint64_t start = bench_start(&timeout);
+        trickle_tx_timeout(&trickle, &do_tx, time_now);
+        bench_stop(&timeout, start);
+        if (do_tx)
+        {
+            trickle_tx_register(&trickle, time_now);
+        }
+    }
+    result_print("trickle_tx_timeout", 1, 100, &timeout);
+}
+
+/** Feed a value to the version handler, as the transport does. */
+static void value_rx(rbc_mesh_value_handle_t handle, uint16_t version, uint32_t crc, bench_result_t* p_result)
+{
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        fprintf(stderr, "Packet pool exhausted\n");
+        exit(1);
+    }
+    uint8_t data[BENCH_VALUE_LENGTH];
+    memset(data, (uint8_t) version, sizeof(data));
+    (void) mesh_packet_build(p_packet, handle, version, data, sizeof(data));
+
+    m_time += 1000;
+    mesh_host_time_set(m_time);
+    if (p_result != NULL)
+    {
+        uint64_t start = bench_start(p_result);
+        (void) vh_rx(p_packet, crc, m_time, 50);
+        bench_stop(p_result, start);
+    }
+    else
+    {
+        (void) vh_rx(p_packet, crc, m_time, 50);
+    }
+    mesh_packet_ref_count_dec(p_packet);
+    mesh_host_events_run();
+}
+
+static void bench_handle_cache(uint16_t cache_entries)
+{
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    for (uint32_t f = 0; f < sizeof(m_fill_levels); ++f)
+    {
+        /* start from empty caches at each fill level */
+        framework_init(cache_entries, cache_entries / 2);
+        m_prng = m_config.seed;
+
+        uint32_t fill = (cache_entries * m_fill_levels[f]) / 100;
+        for (uint32_t i = 0; i < fill; ++i)
+        {
+            mp_versions[i] = 1;
+            value_rx(bench_handle(i), mp_versions[i], prng_get(), NULL);
+        }
+
+        /* lookups of cached handles, and of handles that aren't in the cache */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            handle_info_t info;
+            uint32_t index = prng_get() % fill;
+            uint64_t start = bench_start(&result);
+            uint32_t error_code = handle_storage_info_get(bench_handle(index), &info);
+            bench_stop(&result, start);
+            if (error_code == NRF_SUCCESS && info.p_packet != NULL)
+            {
+                mesh_packet_ref_count_dec(info.p_packet);
+            }
+        }
+        result_print("handle_lookup_hit", cache_entries, m_fill_levels[f], &result);
+
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            handle_info_t info;
+            uint64_t start = bench_start(&result);
+            uint32_t error_code = handle_storage_info_get(bench_handle(cache_entries + (i % cache_entries)), &info);
+            bench_stop(&result, start);
+            if (error_code == NRF_SUCCESS && info.p_packet != NULL)
+            {
+                mesh_packet_ref_count_dec(info.p_packet);
+            }
+        }
+        result_print("handle_lookup_miss", cache_entries, m_fill_levels[f], &result);
+
+        /* newer versions of cached handles, the full receive path */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            mp_versions[index] = (mp_versions[index] % 0xFF00) + 1;
+            value_rx(bench_handle(index), mp_versions[index], prng_get(), &result);
+        }
+        result_print("vh_rx_new_version", cache_entries, m_fill_levels[f], &result);
+
+        /* retransmissions of the current versions from other nodes */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            value_rx(bench_handle(index), mp_versions[index], prng_get(), &result);
+        }
+        result_print("vh_rx_consistent", cache_entries, m_fill_levels[f], &result);
+
+        /* the same packet received twice, caught by the duplicate filter */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            uint32_t crc = prng_get();
+            value_rx(bench_handle(index), mp_versions[index], crc, NULL);
+            value_rx(bench_handle(index), mp_versions[index], crc, &result);
+        }
+        result_print("vh_rx_duplicate", cache_entries, m_fill_levels[f], &result);
+
+        /* local updates of cached handles */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            uint32_t index = prng_get() % fill;
+            uint8_t data[BENCH_VALUE_LENGTH];
+            memset(data, (uint8_t) i, sizeof(data));
+            m_time += 1000;
+            mesh_host_time_set(m_time);
+            uint64_t start = bench_start(&result);
+            (void) vh_local_update(bench_handle(index), data, sizeof(data));
+            bench_stop(&result, start);
+            mesh_host_events_run();
+        }
+        result_print("vh_local_update", cache_entries, m_fill_levels[f], &result);
+
+        /* handles that aren't in the cache, evicting the least recently used */
+        for (uint32_t i = 0; i < m_config.iterations; ++i)
+        {
+            value_rx(bench_handle(cache_entries + (i % cache_entries)), 1, prng_get(), &result);
+        }
+        result_print("vh_rx_new_handle", cache_entries, m_fill_levels[f], &result);
+    }
+}
+
+/** Print the memory the handle storage and packet pool take with each of the
+  benchmarked cache sizes, as set up by framework_init(). */
+static void memory_print(void)
+{
+    if (m_config.csv)
+    {
+        printf("entries,data_entries,cache_bytes,pool_bytes\n");
+    }
+    else
+    {
+        printf("%8s %12s %12s %12s\n", "entries", "data_entries", "cache_bytes", "pool_bytes");
+    }
+    for (uint32_t i = 0; i < sizeof(m_cache_sizes) / sizeof(m_cache_sizes[0]); ++i)
+    {
+        uint16_t handle_entries = m_cache_sizes[i];
+        uint16_t data_entries = handle_entries / 2;
+        uint32_t cache_bytes = handle_storage_memory_size_get(handle_entries, data_entries);
+        uint32_t pool_bytes = mesh_packet_memory_size_get(data_entries);
+        printf(m_config.csv ? "%u,%u,%u,%u\n" : "%8u %12u %12u %12u\n",
+                handle_entries, data_entries, cache_bytes, pool_bytes);
+    }
+}
+
+static void usage(const char* p_name)
+{
+    printf("Usage: %s [options]\n", p_name);
+    printf("  -n <count>    Calls per benchmark (default %u)\n", m_config.iterations);
+    printf("  -s <seed>     Seed for the framework PRNG and the handle picks (default %u)\n", m_config.seed);
+    printf("  -c            Print the results as CSV\n");
+    printf("  -m            Print the cache and packet pool memory of each cache size instead\n");
+}
+
+static void config_parse(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:cmh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': m_config.iterations = strtoul(optarg, NULL, 0); break;
+            case 's': m_config.seed = strtoul(optarg, NULL, 0); break;
+            case 'c': m_config.csv = true; break;
+            case 'm': m_config.memory = true; break;
+            default:
+                usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind != argc || m_config.iterations == 0)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+bool __real_mesh_packet_acquire(mesh_packet_t** pp_packet);
+
+/** Counts the packet allocations, see the Makefile. */
+bool __wrap_mesh_packet_acquire(mesh_packet_t** pp_packet)
+{
+    m_alloc_count++;
+    return __real_mesh_packet_acquire(pp_packet);
+}
+
+int main(int argc, char** argv)
+{
+    config_parse(argc, argv);
+    m_prng = m_config.seed;
+    if (m_config.memory)
+    {
+        memory_print();
+        return 0;
+    }
+
+    uint16_t max_entries = m_cache_sizes[sizeof(m_cache_sizes) / sizeof(m_cache_sizes[0]) - 1];
+    mp_versions = malloc(sizeof(uint16_t) * max_entries);
+    if (mp_versions == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    timer_overhead_calibrate();
+    if (m_config.csv)
+    {
+        printf("name,entries,fill,iterations,ns_per_op,allocs_per_op\n");
+    }
+    else
+    {
+        printf("%-22s %8s %6s %16s\n", "", "entries", "fill", "");
+    }
+
+    bench_fifo();
+    bench_packet_pool();
+    bench_trickle();
+    for (uint32_t i = 0; i < sizeof(m_cache_sizes) / sizeof(m_cache_sizes[0]); ++i)
+    {
+        bench_handle_cache(m_cache_sizes[i]);
+    }
+    return 0;
+}
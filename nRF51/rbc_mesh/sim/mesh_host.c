@@ -0,0 +1,410 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file Host stand-ins for the Softdevice and peripheral dependent modules,
+*   see mesh_host.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mesh_host.h"
+#include "transport_control.h"
+#include "handle_storage.h"
+#include "radio_control.h"
+#include "event_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+
+/*****************************************************************************
+* Local defines
+*****************************************************************************/
+/** Length of the async event queue, deep enough to never drop events. */
+#define EVENT_QUEUE_LENGTH      (256)
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static mesh_host_stats_t m_stats;
+static mesh_host_tx_cb_t m_tx_cb;
+static mesh_host_event_cb_t m_event_cb;
+
+static uint32_t m_time_now;
+static uint32_t m_prng_state;
+
+static async_event_t m_event_queue[EVENT_QUEUE_LENGTH];
+static uint32_t m_event_head;
+static uint32_t m_event_tail;
+static bool m_rx_signaled;
+
+static timer_event_t* mp_timers;
+
+static radio_idle_cb_t m_radio_idle_cb;
+static radio_rx_cb_t m_radio_rx_cb;
+static radio_tx_cb_t m_radio_tx_cb;
+static uint8_t* mp_rx_buffer;   /**< Packet of the ordered scan, if any. */
+static radio_event_t m_radio_tx_queue[RBC_MESH_RADIO_QUEUE_LENGTH];
+static uint32_t m_radio_tx_count;
+
+static NRF_FICR_Type m_ficr = { .DEVICEADDRTYPE = 1, .DEVICEADDR = { 0x1234ABCD, 0x5678 } };
+NRF_FICR_Type* NRF_FICR = &m_ficr;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+/** BLE link layer CRC of the PDU, as the radio reports it. */
+static uint32_t crc24_get(const uint8_t* p_data, uint32_t length)
+{
+    uint32_t crc = 0x555555;
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        for (uint32_t bit = 0; bit < 8; ++bit)
+        {
+            bool feedback = ((crc >> 23) ^ (p_data[i] >> bit)) & 1;
+            crc = (crc << 1) & 0xFFFFFF;
+            if (feedback)
+            {
+                crc ^= 0x00065B;
+            }
+        }
+    }
+    return crc;
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+void mesh_host_init(uint32_t seed)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_prng_state = seed;
+    m_time_now = 0;
+    m_event_head = 0;
+    m_event_tail = 0;
+    m_rx_signaled = false;
+    mp_timers = NULL;
+    mp_rx_buffer = NULL;
+    m_radio_tx_count = 0;
+}
+
+void mesh_host_callbacks_set(mesh_host_tx_cb_t tx_cb, mesh_host_event_cb_t event_cb)
+{
+    m_tx_cb = tx_cb;
+    m_event_cb = event_cb;
+}
+
+void mesh_host_time_set(uint32_t time)
+{
+    m_time_now = time;
+}
+
+/** Run all async events and received packets, and refill the radio. */
+void mesh_host_events_run(void)
+{
+    while (true)
+    {
+        if (m_rx_signaled)
+        {
+            m_rx_signaled = false;
+            (void) tc_rx_queue_process(UINT32_MAX);
+        }
+        else if (m_radio_tx_count > 0)
+        {
+            /* transmissions complete in the order they were queued, and before
+               the deferred work, like the radio does on the device */
+            radio_event_t tx_evt = m_radio_tx_queue[0];
+            m_radio_tx_count--;
+            memmove(&m_radio_tx_queue[0], &m_radio_tx_queue[1], m_radio_tx_count * sizeof(radio_event_t));
+            if (m_tx_cb != NULL)
+            {
+                m_tx_cb((const mesh_packet_t*) tx_evt.packet_ptr);
+            }
+            m_stats.tx++;
+            m_radio_tx_cb(tx_evt.packet_ptr);
+        }
+        else if (m_event_tail != m_event_head)
+        {
+            async_event_t evt = m_event_queue[m_event_tail];
+            m_event_tail = (m_event_tail + 1) % EVENT_QUEUE_LENGTH;
+            switch (evt.type)
+            {
+                case EVENT_TYPE_TIMER:
+                    evt.callback.timer.cb(evt.callback.timer.timestamp);
+                    break;
+                case EVENT_TYPE_TIMER_SCH:
+                    evt.callback.timer_sch.cb(evt.callback.timer_sch.timestamp,
+                                              evt.callback.timer_sch.p_context);
+                    break;
+                case EVENT_TYPE_GENERIC:
+                    evt.callback.generic.cb(evt.callback.generic.p_context);
+                    break;
+                case EVENT_TYPE_PACKET:
+                    tc_packet_handler(evt.callback.packet.payload,
+                                      evt.callback.packet.crc,
+                                      evt.callback.packet.timestamp,
+                                      evt.callback.packet.rssi);
+                    break;
+                case EVENT_TYPE_SET_FLAG:
+                    handle_storage_flag_set(evt.callback.set_flag.handle,
+                                            (handle_flag_t) evt.callback.set_flag.flag,
+                                            evt.callback.set_flag.value);
+                    break;
+            }
+        }
+        else if (mp_rx_buffer == NULL && m_radio_idle_cb != NULL)
+        {
+            m_radio_idle_cb();
+            if (mp_rx_buffer == NULL)
+            {
+                return; /* out of packets, try again on the next call */
+            }
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+bool mesh_host_timer_fire_next(uint32_t time)
+{
+    timer_event_t* p_next = NULL;
+    for (timer_event_t* p_timer = mp_timers; p_timer != NULL; p_timer = p_timer->p_next)
+    {
+        if (p_next == NULL || TIMER_OLDER_THAN(p_timer->timestamp, p_next->timestamp))
+        {
+            p_next = p_timer;
+        }
+    }
+    if (p_next == NULL || TIMER_OLDER_THAN(time, p_next->timestamp))
+    {
+        return false;
+    }
+
+    if (TIMER_OLDER_THAN(m_time_now, p_next->timestamp))
+    {
+        m_time_now = p_next->timestamp;
+    }
+    timestamp_t timestamp = p_next->timestamp;
+    (void) timer_sch_abort(p_next);
+    if (p_next->interval != TIMER_EVENT_INTERVAL_SINGLE_SHOT)
+    {
+        p_next->timestamp += p_next->interval;
+        (void) timer_sch_schedule(p_next);
+    }
+    p_next->cb(timestamp, p_next->p_context);
+    m_stats.timer_fires++;
+    mesh_host_events_run();
+    return true;
+}
+
+bool mesh_host_radio_rx(const uint8_t* p_pdu, uint8_t length, bool crc_ok, uint8_t rssi, uint8_t channel)
+{
+    if (mp_rx_buffer == NULL || length < 2 || length > 2 + BLE_GAP_ADDR_LEN + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
+    {
+        return false;
+    }
+    /* the radio puts the S1 padding byte between the header and the address */
+    uint8_t* p_buffer = mp_rx_buffer;
+    mp_rx_buffer = NULL;
+    memset(p_buffer, 0, sizeof(mesh_packet_t));
+    p_buffer[0] = p_pdu[0];
+    p_buffer[1] = p_pdu[1];
+    memcpy(((mesh_packet_t*) p_buffer)->addr, &p_pdu[2], length - 2);
+    m_radio_rx_cb(p_buffer, crc_ok, crc24_get(p_pdu, length), rssi, m_time_now, channel);
+    return true;
+}
+
+void mesh_host_stats_get(mesh_host_stats_t* p_stats)
+{
+    *p_stats = m_stats;
+}
+
+/*****************************************************************************
+* Stand-ins for the modules the host tools don't link
+*****************************************************************************/
+uint32_t timer_now(void)
+{
+    return m_time_now;
+}
+
+uint32_t timer_sch_schedule(timer_event_t* p_timer_evt)
+{
+    if (p_timer_evt == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    (void) timer_sch_abort(p_timer_evt);
+    p_timer_evt->p_next = mp_timers;
+    mp_timers = p_timer_evt;
+    return NRF_SUCCESS;
+}
+
+uint32_t timer_sch_abort(timer_event_t* p_timer_evt)
+{
+    if (p_timer_evt == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    for (timer_event_t** pp_timer = &mp_timers; *pp_timer != NULL; pp_timer = &(*pp_timer)->p_next)
+    {
+        if (*pp_timer == p_timer_evt)
+        {
+            *pp_timer = p_timer_evt->p_next;
+            break;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t timer_sch_reschedule(timer_event_t* p_timer_evt, timestamp_t new_timestamp)
+{
+    if (p_timer_evt == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    p_timer_evt->timestamp = new_timestamp;
+    return timer_sch_schedule(p_timer_evt);
+}
+
+uint32_t event_handler_push(async_event_t* evt)
+{
+    uint32_t next = (m_event_head + 1) % EVENT_QUEUE_LENGTH;
+    if (next == m_event_tail)
+    {
+        m_stats.event_drops++;
+        return NRF_ERROR_NO_MEM;
+    }
+    m_event_queue[m_event_head] = *evt;
+    m_event_head = next;
+    return NRF_SUCCESS;
+}
+
+void event_handler_rx_signal(void)
+{
+    m_rx_signaled = true;
+}
+
+void event_handler_critical_section_begin(void)
+{
+}
+
+void event_handler_critical_section_end(void)
+{
+}
+
+void radio_init(radio_idle_cb_t idle_cb, radio_rx_cb_t rx_cb, radio_tx_cb_t tx_cb)
+{
+    m_radio_idle_cb = idle_cb;
+    m_radio_rx_cb = rx_cb;
+    m_radio_tx_cb = tx_cb;
+}
+
+uint32_t radio_order(radio_event_t* radio_event)
+{
+    if (radio_event->event_type == RADIO_EVENT_TYPE_TX)
+    {
+        if (m_radio_tx_count == RBC_MESH_RADIO_QUEUE_LENGTH)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_radio_tx_queue[m_radio_tx_count++] = *radio_event;
+        return NRF_SUCCESS;
+    }
+    /* a single scan at a time */
+    if (mp_rx_buffer != NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    mp_rx_buffer = radio_event->packet_ptr;
+    return NRF_SUCCESS;
+}
+
+uint32_t radio_queue_len_get(void)
+{
+    /* only the transmissions queue up, the scan is kept apart */
+    return m_radio_tx_count;
+}
+
+void radio_alt_aa_set(uint32_t access_address)
+{
+}
+
+uint32_t radio_aa_prefix_set(uint8_t logical_address, uint8_t prefix)
+{
+    return NRF_SUCCESS;
+}
+
+uint8_t radio_rx_address_get(void)
+{
+    return 0;
+}
+
+void timeslot_restart(void)
+{
+}
+
+uint32_t mesh_gatt_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt)
+{
+    if (p_evt->type <= RBC_MESH_EVENT_TYPE_PROBE)
+    {
+        m_stats.app_events[p_evt->type]++;
+    }
+    if (m_event_cb != NULL)
+    {
+        m_event_cb(p_evt);
+    }
+    /* the event is consumed right away, so the packet references aren't taken */
+    return NRF_SUCCESS;
+}
+
+/* The framework PRNG is seeded through the Softdevice, from a fixed sequence. */
+uint32_t sd_rand_application_bytes_available_get(uint8_t* p_bytes_available)
+{
+    *p_bytes_available = 4;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_rand_application_vector_get(uint8_t* p_buff, uint8_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        m_prng_state = m_prng_state * 1103515245 + 12345;
+        p_buff[i] = (uint8_t) (m_prng_state >> 16);
+    }
+    return NRF_SUCCESS;
+}
+
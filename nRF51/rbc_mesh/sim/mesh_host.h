@@ -0,0 +1,107 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#ifndef MESH_HOST_H__
+#define MESH_HOST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rbc_mesh.h"
+#include "mesh_packet.h"
+
+/**
+* @file Host stand-ins for the parts of the framework that depend on the
+*   Softdevice and the nRF51 peripherals: the timer and timer scheduler, the
+*   event handler, the radio, the timeslots, the GATT service and the
+*   application event queue. Lets the host tools link the real transport,
+*   version handler and handle storage modules.
+*
+*   Time is virtual, and only moves with mesh_host_time_set() and the timers
+*   fired by mesh_host_timer_fire_next(). Async events are dispatched from one
+*   queue in the order they're pushed, without the priority classes of the
+*   event handler, and only when mesh_host_events_run() is called.
+*   Transmissions complete in mesh_host_events_run(), right after they're
+*   ordered, and the radio is always listening.
+*/
+
+/** Called with each packet the framework transmits. */
+typedef void (*mesh_host_tx_cb_t)(const mesh_packet_t* p_packet);
+
+/** Called with each event the framework pushes to the application. */
+typedef void (*mesh_host_event_cb_t)(const rbc_mesh_event_t* p_evt);
+
+typedef struct
+{
+    uint32_t tx;                    /**< Number of completed transmissions. */
+    uint32_t timer_fires;           /**< Number of scheduler timers fired. */
+    uint32_t event_drops;           /**< Number of async events dropped because the queue was full. */
+    uint32_t app_events[RBC_MESH_EVENT_TYPE_PROBE + 1]; /**< Number of application events of each type. */
+} mesh_host_stats_t;
+
+/**
+* Reset the stand-ins, and seed the PRNG the framework draws its random
+*   numbers from through the Softdevice.
+*/
+void mesh_host_init(uint32_t seed);
+
+/** Set the callbacks for transmitted packets and application events. Both may be NULL. */
+void mesh_host_callbacks_set(mesh_host_tx_cb_t tx_cb, mesh_host_event_cb_t event_cb);
+
+/** Move the virtual time forward. */
+void mesh_host_time_set(uint32_t time);
+
+/**
+* Run all async events and received packets, complete the ordered
+*   transmissions, and refill the radio, until there's nothing left to do.
+*/
+void mesh_host_events_run(void);
+
+/**
+* Fire the earliest scheduler timer, if it's due no later than the given time.
+*   Moves the time to the timer's timeout, and runs the events the timer
+*   caused.
+*
+* @return Whether a timer was fired.
+*/
+bool mesh_host_timer_fire_next(uint32_t time);
+
+/**
+* Hand a received PDU to the framework, as the radio would. The PDU is the
+*   header, advertiser address and payload, without the access address and
+*   CRC, which is computed here.
+*
+* @return Whether the radio had a receive buffer for the packet.
+*/
+bool mesh_host_radio_rx(const uint8_t* p_pdu, uint8_t length, bool crc_ok, uint8_t rssi, uint8_t channel);
+
+/** Get the stand-in statistics. */
+void mesh_host_stats_get(mesh_host_stats_t* p_stats);
+
+#endif /* MESH_HOST_H__ */
@@ -0,0 +1,554 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file Trace replay for regression benchmarking. Feeds a recorded trace of
+*   received packets and local API calls to a single node running the
+*   framework's transport_control.c, version_handler.c and handle_storage.c on
+*   the host, with the radio, timers, timeslots and event handler replaced by
+*   the deterministic stand-ins in mesh_host.c. Time only moves with the trace
+*   records and the scheduler timeouts, so a trace replays the same way on
+*   every run, for a given PRNG seed.
+*
+*   The framework events and the transmitted packets are logged in text form,
+*   so that the output of two releases can be compared with diff, and the CPU
+*   time spent on each record is reported with the packet and cache counters.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "rbc_mesh.h"
+#include "mesh_host.h"
+#include "transport_control.h"
+#include "version_handler.h"
+#include "mesh_packet.h"
+#include "timer.h"
+#include "trickle.h"
+
+/*****************************************************************************
+* Local defines
+*****************************************************************************/
+/** Longest trace line. */
+#define TRACE_LINE_MAX          (256)
+/** Longest PDU in a trace record: header, advertiser address and payload. */
+#define TRACE_PDU_MAX_LEN       (2 + BLE_GAP_ADDR_LEN + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
+
+/*****************************************************************************
+* Local typedefs
+*****************************************************************************/
+typedef enum
+{
+    TRACE_RECORD_RX,        /**< A packet came in over the air. */
+    TRACE_RECORD_SET,       /**< The application called rbc_mesh_value_set(). */
+    TRACE_RECORD_ENABLE,    /**< The application called rbc_mesh_value_enable(). */
+    TRACE_RECORD_DISABLE,   /**< The application called rbc_mesh_value_disable(). */
+} trace_record_type_t;
+
+typedef struct
+{
+    trace_record_type_t type;
+    uint32_t time;
+    uint16_t handle;
+    uint8_t channel;
+    uint8_t rssi;
+    bool crc_ok;
+    uint8_t length;
+    uint8_t data[TRACE_PDU_MAX_LEN];
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t access_address;
+    uint8_t channel;
+    uint32_t interval_min_ms;
+    uint32_t seed;
+    uint32_t tail_ms;
+    const char* p_trace_file;
+    const char* p_event_file;
+} replay_config_t;
+
+/** CPU time samples of a record type, in nanoseconds. */
+typedef struct
+{
+    uint64_t* p_samples;
+    uint32_t count;
+    uint32_t capacity;
+} cpu_samples_t;
+
+typedef struct
+{
+    uint32_t records;
+    uint32_t rx_records;
+    uint32_t rx_no_buffer;      /**< Traced packets that found no receive buffer. */
+    uint32_t local_calls;
+    uint32_t local_call_errors;
+} replay_stats_t;
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static replay_config_t m_config =
+{
+    .access_address     = RBC_MESH_ACCESS_ADDRESS_BLE_ADV,
+    .channel            = 38,
+    .interval_min_ms    = 100,
+    .seed               = 1,
+    .tail_ms            = 0,
+    .p_trace_file       = NULL,
+    .p_event_file       = NULL,
+};
+
+static replay_stats_t m_stats;
+static cpu_samples_t m_cpu_rx;
+static cpu_samples_t m_cpu_local;
+static cpu_samples_t m_cpu_timer;
+static uint64_t m_output_ns;    /**< CPU time spent logging, left out of the samples. */
+static FILE* mp_event_file;
+
+static uint32_t m_time_now;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void cpu_sample_add(cpu_samples_t* p_samples, uint64_t ns)
+{
+    if (p_samples->count == p_samples->capacity)
+    {
+        p_samples->capacity = (p_samples->capacity == 0) ? 1024 : p_samples->capacity * 2;
+        p_samples->p_samples = realloc(p_samples->p_samples, p_samples->capacity * sizeof(uint64_t));
+        if (p_samples->p_samples == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    p_samples->p_samples[p_samples->count++] = ns;
+}
+
+static void hex_print(FILE* p_file, const uint8_t* p_data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        fprintf(p_file, "%02x", p_data[i]);
+    }
+}
+
+/** Write a line to the event log, without counting the time it takes. */
+static void event_log(const char* p_type, uint16_t handle, const uint8_t* p_data, uint32_t length)
+{
+    if (mp_event_file == NULL)
+    {
+        return;
+    }
+    uint64_t start = cpu_time_ns();
+    fprintf(mp_event_file, "%u %s %04x ", timer_now(), p_type, handle);
+    hex_print(mp_event_file, p_data, length);
+    fputc('\n', mp_event_file);
+    m_output_ns += cpu_time_ns() - start;
+}
+
+/** Fire all scheduler timers that are due before the given time, in order. */
+static void timers_run(uint32_t time)
+{
+    while (true)
+    {
+        uint64_t start = cpu_time_ns();
+        uint64_t output_start = m_output_ns;
+        if (!mesh_host_timer_fire_next(time))
+        {
+            return;
+        }
+        m_time_now = timer_now();
+        cpu_sample_add(&m_cpu_timer, cpu_time_ns() - start - (m_output_ns - output_start));
+    }
+}
+
+static bool hex_parse(const char* p_hex, uint8_t* p_data, uint8_t* p_length, uint32_t max_length)
+{
+    uint32_t length = 0;
+    if (strcmp(p_hex, "-") == 0)
+    {
+        *p_length = 0;
+        return true;
+    }
+    while (p_hex[0] != '\0' && p_hex[1] != '\0')
+    {
+        unsigned byte;
+        if (length == max_length || sscanf(p_hex, "%2x", &byte) != 1)
+        {
+            return false;
+        }
+        p_data[length++] = (uint8_t) byte;
+        p_hex += 2;
+    }
+    *p_length = (uint8_t) length;
+    return (p_hex[0] == '\0');
+}
+
+/** Parse a trace line. Returns false for lines without a record. */
+static bool trace_line_parse(const char* p_line, uint32_t line_number, trace_record_t* p_record)
+{
+    char type[16];
+    char arg[4][TRACE_LINE_MAX];
+    int count = sscanf(p_line, "%u %15s %255s %255s %255s %255s",
+            &p_record->time, type, arg[0], arg[1], arg[2], arg[3]);
+    if (count <= 0 || p_line[0] == '#')
+    {
+        return false;
+    }
+
+    bool ok = false;
+    if (strcmp(type, "rx") == 0 && count == 6)
+    {
+        p_record->type = TRACE_RECORD_RX;
+        p_record->channel = (uint8_t) strtoul(arg[0], NULL, 0);
+        p_record->rssi = (uint8_t) strtoul(arg[1], NULL, 0);
+        p_record->crc_ok = (strtoul(arg[2], NULL, 0) != 0);
+        ok = hex_parse(arg[3], p_record->data, &p_record->length, TRACE_PDU_MAX_LEN) &&
+             p_record->length >= 2;
+    }
+    else if (strcmp(type, "set") == 0 && count == 4)
+    {
+        p_record->type = TRACE_RECORD_SET;
+        p_record->handle = (uint16_t) strtoul(arg[0], NULL, 16);
+        ok = hex_parse(arg[1], p_record->data, &p_record->length, RBC_MESH_VALUE_MAX_LEN);
+    }
+    else if ((strcmp(type, "enable") == 0 || strcmp(type, "disable") == 0) && count == 3)
+    {
+        p_record->type = (type[0] == 'e') ? TRACE_RECORD_ENABLE : TRACE_RECORD_DISABLE;
+        p_record->handle = (uint16_t) strtoul(arg[0], NULL, 16);
+        ok = true;
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%u: invalid record\n", m_config.p_trace_file, line_number);
+        exit(1);
+    }
+    return true;
+}
+
+static void record_replay(const trace_record_t* p_record)
+{
+    uint64_t start = cpu_time_ns();
+    uint64_t output_start = m_output_ns;
+    cpu_samples_t* p_samples = &m_cpu_local;
+
+    switch (p_record->type)
+    {
+        case TRACE_RECORD_RX:
+        {
+            m_stats.rx_records++;
+            if (!mesh_host_radio_rx(p_record->data, p_record->length, p_record->crc_ok,
+                        p_record->rssi, p_record->channel))
+            {
+                m_stats.rx_no_buffer++;
+                return;
+            }
+            p_samples = &m_cpu_rx;
+            break;
+        }
+        case TRACE_RECORD_SET:
+        {
+            m_stats.local_calls++;
+            uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+            memcpy(data, p_record->data, p_record->length);
+            if (vh_local_update(p_record->handle, data, p_record->length) != NRF_SUCCESS)
+            {
+                m_stats.local_call_errors++;
+            }
+            break;
+        }
+        case TRACE_RECORD_ENABLE:
+            m_stats.local_calls++;
+            if (vh_value_enable(p_record->handle) != NRF_SUCCESS)
+            {
+                m_stats.local_call_errors++;
+            }
+            break;
+        case TRACE_RECORD_DISABLE:
+            m_stats.local_calls++;
+            if (vh_value_disable(p_record->handle) != NRF_SUCCESS)
+            {
+                m_stats.local_call_errors++;
+            }
+            break;
+    }
+    mesh_host_events_run();
+
+    cpu_sample_add(p_samples, cpu_time_ns() - start - (m_output_ns - output_start));
+}
+
+static int sample_compare(const void* p_a, const void* p_b)
+{
+    uint64_t a = *(const uint64_t*) p_a;
+    uint64_t b = *(const uint64_t*) p_b;
+    return (a > b) - (a < b);
+}
+
+static void cpu_report(const char* p_label, cpu_samples_t* p_samples)
+{
+    if (p_samples->count == 0)
+    {
+        printf("%-20s -\n", p_label);
+        return;
+    }
+    qsort(p_samples->p_samples, p_samples->count, sizeof(uint64_t), sample_compare);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < p_samples->count; ++i)
+    {
+        sum += p_samples->p_samples[i];
+    }
+    printf("%-20s %u, avg %llu ns, p50 %llu ns, p99 %llu ns, max %llu ns\n", p_label,
+            p_samples->count,
+            (unsigned long long) (sum / p_samples->count),
+            (unsigned long long) p_samples->p_samples[p_samples->count / 2],
+            (unsigned long long) p_samples->p_samples[(p_samples->count * 99) / 100],
+            (unsigned long long) p_samples->p_samples[p_samples->count - 1]);
+}
+
+static void report(void)
+{
+    rbc_mesh_stats_t tc_stats;
+    memset(&tc_stats, 0, sizeof(tc_stats));
+    tc_stats_get(&tc_stats);
+    rbc_mesh_packet_pool_stats_t pool_stats;
+    mesh_packet_pool_stats_get(&pool_stats);
+    mesh_host_stats_t host_stats;
+    mesh_host_stats_get(&host_stats);
+
+    uint32_t cached = 0;
+    uint32_t iterator = 0;
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+    uint16_t length = RBC_MESH_VALUE_MAX_LEN;
+    while (vh_value_next_get(&iterator, &handle, &version, data, &length) == NRF_SUCCESS)
+    {
+        cached++;
+        length = RBC_MESH_VALUE_MAX_LEN;
+    }
+
+    printf("Trace:              %s, %u records, ended at %u us\n",
+            m_config.p_trace_file, m_stats.records, m_time_now);
+    printf("Received packets:   %u traced, %u without a buffer\n",
+            m_stats.rx_records, m_stats.rx_no_buffer);
+    printf("  ok/crc fail/foreign/filtered/queue drop: %u/%u/%u/%u/%u\n",
+            tc_stats.rx_ok, tc_stats.rx_crc_fail, tc_stats.rx_foreign, tc_stats.rx_filtered,
+            tc_stats.rx_queue_drop);
+    printf("  duplicates:       %u\n", vh_rx_duplicate_count_get());
+    printf("Local calls:        %u (%u failed)\n", m_stats.local_calls, m_stats.local_call_errors);
+    printf("Transmissions:      %u (%u dropped), %u timer fires\n",
+            host_stats.tx, tc_stats.tx_queue_drop, host_stats.timer_fires);
+    printf("Trickle resets:     %u\n", trickle_reset_count_get());
+    printf("Events new/update/conflicting/tx: %u/%u/%u/%u\n",
+            host_stats.app_events[RBC_MESH_EVENT_TYPE_NEW_VAL],
+            host_stats.app_events[RBC_MESH_EVENT_TYPE_UPDATE_VAL],
+            host_stats.app_events[RBC_MESH_EVENT_TYPE_CONFLICTING_VAL],
+            host_stats.app_events[RBC_MESH_EVENT_TYPE_TX]);
+    printf("Cache:              %u values at the end, new value events count the misses\n", cached);
+    printf("Packet pool:        %u packets, high water mark %u, %u allocation failures, %u RX denied\n",
+            pool_stats.pool_size, pool_stats.high_water_mark, pool_stats.alloc_failures, pool_stats.rx_denied);
+    printf("Internal events:    %u dropped\n", host_stats.event_drops);
+    printf("CPU time:\n");
+    cpu_report("  per packet", &m_cpu_rx);
+    cpu_report("  per local call", &m_cpu_local);
+    cpu_report("  per timer", &m_cpu_timer);
+}
+
+static void usage(const char* p_name)
+{
+    printf("Usage: %s [options] <trace file>\n", p_name);
+    printf("  -o <file>     Write the framework events and transmissions to the file\n");
+    printf("  -a <address>  Access address (default 0x%08x)\n", m_config.access_address);
+    printf("  -c <channel>  Radio channel (default %u)\n", m_config.channel);
+    printf("  -i <ms>       Minimum Trickle interval (default %u)\n", m_config.interval_min_ms);
+    printf("  -t <ms>       Time to keep running after the last record (default %u)\n", m_config.tail_ms);
+    printf("  -s <seed>     Seed for the framework PRNG (default %u)\n", m_config.seed);
+}
+
+static void config_parse(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "o:a:c:i:t:s:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o': m_config.p_event_file = optarg; break;
+            case 'a': m_config.access_address = strtoul(optarg, NULL, 0); break;
+            case 'c': m_config.channel = (uint8_t) strtoul(optarg, NULL, 0); break;
+            case 'i': m_config.interval_min_ms = strtoul(optarg, NULL, 0); break;
+            case 't': m_config.tail_ms = strtoul(optarg, NULL, 0); break;
+            case 's': m_config.seed = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    if (optind != argc - 1 || m_config.channel >= 40 || m_config.interval_min_ms == 0)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+    m_config.p_trace_file = argv[optind];
+}
+
+static void tx_log(const mesh_packet_t* p_packet)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get((mesh_packet_t*) p_packet);
+    if (p_adv_data != NULL)
+    {
+        event_log("radio_tx", p_adv_data->handle, p_adv_data->data,
+                p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+    }
+}
+
+static void app_event_log(const rbc_mesh_event_t* p_evt)
+{
+    switch (p_evt->type)
+    {
+        case RBC_MESH_EVENT_TYPE_NEW_VAL:
+            event_log("new", p_evt->params.rx.value_handle, p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            break;
+        case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+            event_log("update", p_evt->params.rx.value_handle, p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            break;
+        case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+            event_log("conflicting", p_evt->params.rx.value_handle, p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            break;
+        case RBC_MESH_EVENT_TYPE_TX:
+            event_log("tx", p_evt->params.tx.value_handle, p_evt->params.tx.p_data, p_evt->params.tx.data_len);
+            break;
+        case RBC_MESH_EVENT_TYPE_VALUE_EXPIRED:
+            event_log("expired", p_evt->params.rx.value_handle, NULL, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+int main(int argc, char** argv)
+{
+    config_parse(argc, argv);
+    mesh_host_init(m_config.seed);
+    mesh_host_callbacks_set(tx_log, app_event_log);
+
+    FILE* p_trace = fopen(m_config.p_trace_file, "r");
+    if (p_trace == NULL)
+    {
+        perror(m_config.p_trace_file);
+        return 1;
+    }
+    if (m_config.p_event_file != NULL)
+    {
+        mp_event_file = fopen(m_config.p_event_file, "w");
+        if (mp_event_file == NULL)
+        {
+            perror(m_config.p_event_file);
+            return 1;
+        }
+    }
+
+    if (mesh_packet_init(NULL, 0) != NRF_SUCCESS)
+    {
+        fprintf(stderr, "Framework init failed\n");
+        return 1;
+    }
+    tc_init(m_config.access_address, m_config.channel);
+    if (vh_init(m_config.interval_min_ms * 1000, m_config.access_address,
+                m_config.channel, RBC_MESH_TXPOWER_0dBm, NULL) != NRF_SUCCESS)
+    {
+        fprintf(stderr, "Framework init failed\n");
+        return 1;
+    }
+    tc_on_ts_begin();
+    (void) vh_on_timeslot_begin();
+    mesh_host_events_run();
+
+    char line[TRACE_LINE_MAX];
+    uint32_t line_number = 0;
+    trace_record_t record;
+    bool first = true;
+    while (fgets(line, sizeof(line), p_trace) != NULL)
+    {
+        line_number++;
+        if (!trace_line_parse(line, line_number, &record))
+        {
+            continue;
+        }
+        if (first)
+        {
+            /* the trace starts the clock */
+            m_time_now = record.time;
+            mesh_host_time_set(m_time_now);
+            first = false;
+        }
+        else if (TIMER_OLDER_THAN(record.time, m_time_now))
+        {
+            fprintf(stderr, "%s:%u: record goes back in time\n", m_config.p_trace_file, line_number);
+            return 1;
+        }
+        timers_run(record.time);
+        m_time_now = record.time;
+        mesh_host_time_set(m_time_now);
+        m_stats.records++;
+        record_replay(&record);
+    }
+    fclose(p_trace);
+
+    uint32_t end_time = m_time_now + m_config.tail_ms * 1000;
+    timers_run(end_time);
+    m_time_now = end_time;
+    mesh_host_time_set(m_time_now);
+
+    if (mp_event_file != NULL)
+    {
+        fclose(mp_event_file);
+    }
+    report();
+    return 0;
+}
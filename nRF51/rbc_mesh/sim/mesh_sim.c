@@ -0,0 +1,846 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file Discrete event simulator for the mesh value propagation. Runs the
+*   framework Trickle implementation (trickle.c) on a population of virtual
+*   nodes, with the radio, timer and timeslot modules replaced by a simple
+*   shared channel model:
+*   - Nodes are placed uniformly at random in a square area, and hear every
+*     node within the radio range.
+*   - All transmissions share one channel. A reception fails if another
+*     transmission reaches the receiver while it's in progress (collision), if
+*     the receiver starts transmitting itself (half duplex), or at random with
+*     the configured loss rate.
+*   - Nodes are always in a timeslot, and listen whenever they're not
+*     transmitting.
+*
+*   - Each node holds a limited number of Trickle driven values when a data
+*     cache size is set. A new value evicts the least recently updated one,
+*     whose version is remembered, but which is no longer transmitted.
+*
+*   Value updates are injected at random nodes, and the time it takes for each
+*   version to reach every node is reported, along with the packet counts,
+*   airtime and loss rates.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "trickle.h"
+#include "timer.h"
+#include "nrf_error.h"
+
+/*****************************************************************************
+* Local defines
+*****************************************************************************/
+/** Longest value payload, matching RBC_MESH_VALUE_MAX_LEN. */
+#define PAYLOAD_MAX_LEN         (23)
+/** Time on air for a mesh advertisement packet at 1Mbit, including preamble,
+  access address, header, advertiser address, mesh header and CRC. */
+#define PACKET_AIRTIME_US(payload_len)  (8 * (24 + (payload_len)))
+/** Radio ramp up time before each transmission. */
+#define RADIO_RAMP_UP_US        (140)
+/** Trickle parameters, matching the defaults in handle_storage.c. */
+#define DEFAULT_I_MAX           (2048)
+#define DEFAULT_K               (3)
+/** Latest simulated time, keeps all timestamps comparable with TIMER_OLDER_THAN(). */
+#define MAX_DURATION_S          (2000)
+/** Number of latency histogram buckets, bucket n holds latencies in [2^(n-1), 2^n) ms. */
+#define LATENCY_BUCKETS         (24)
+/** Marks a node that isn't receiving anything. */
+#define NODE_NONE               (UINT32_MAX)
+
+/*****************************************************************************
+* Local typedefs
+*****************************************************************************/
+typedef enum
+{
+    SIM_EVT_NODE_WAKE,      /**< Check the node's Trickle timers for due values. */
+    SIM_EVT_TX_START,       /**< A node starts transmitting a value. */
+    SIM_EVT_TX_END,         /**< A node is done transmitting a value. */
+    SIM_EVT_UPDATE,         /**< Inject a local value update. */
+} sim_evt_type_t;
+
+typedef struct
+{
+    uint32_t time;
+    uint32_t seq;           /**< Insertion order, keeps the event order stable for equal timestamps. */
+    uint32_t node;
+    uint16_t handle;
+    uint16_t version;
+    sim_evt_type_t type;
+} sim_evt_t;
+
+/** One value as it's stored on one node. */
+typedef struct
+{
+    trickle_t trickle;
+    uint32_t updated;       /**< Time of the last version update, for the data cache eviction. */
+    uint16_t version;
+    bool present;
+} sim_value_t;
+
+typedef struct
+{
+    float x;
+    float y;
+    uint32_t* p_neighbors;
+    uint32_t neighbor_count;
+    sim_value_t* p_values;
+    uint16_t* p_tx_queue;   /**< Handles waiting to be transmitted. */
+    uint32_t tx_queue_count;
+    uint32_t next_wake;     /**< Time of the valid wake event, later ones are stale. */
+    bool wake_pending;
+    bool transmitting;
+    uint32_t rx_count;      /**< Number of transmissions currently reaching this node. */
+    uint32_t rx_from;       /**< Transmitter of the reception the radio has locked on to. */
+    bool rx_ok;             /**< The locked on reception is still intact. */
+    uint32_t cached_count;  /**< Number of values with a data cache entry. */
+} sim_node_t;
+
+/** The time at which each version of a value was created. */
+typedef struct
+{
+    uint32_t* p_created;
+    uint16_t version;
+} sim_handle_t;
+
+typedef struct
+{
+    uint32_t node_count;
+    uint32_t handle_count;
+    float area_m;
+    float range_m;
+    float loss_rate;
+    uint32_t duration_s;
+    uint32_t i_min_ms;
+    uint32_t i_max;
+    uint8_t k;
+    uint8_t payload_len;
+    uint32_t data_cache_entries;    /**< Values with a Trickle timer per node, or 0 for all of them. */
+    uint32_t update_count;
+    uint32_t update_interval_ms;
+    uint32_t seed;
+    bool csv;
+} sim_config_t;
+
+typedef struct
+{
+    uint64_t tx;
+    uint64_t rx_attempts;
+    uint64_t rx_ok;
+    uint64_t rx_collision;
+    uint64_t rx_half_duplex;
+    uint64_t rx_random_loss;
+    uint64_t rx_consistent;
+    uint64_t rx_inconsistent;
+    uint64_t rx_new;
+    uint64_t evictions;
+    uint64_t reached;
+    uint64_t latency_sum_ms;
+    uint32_t latency_max_ms;
+    uint64_t latency_buckets[LATENCY_BUCKETS];
+} sim_stats_t;
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static sim_config_t m_config =
+{
+    .node_count         = 100,
+    .handle_count       = 4,
+    .area_m             = 100.0f,
+    .range_m            = 30.0f,
+    .loss_rate          = 0.05f,
+    .duration_s         = 60,
+    .i_min_ms           = 100,
+    .i_max              = DEFAULT_I_MAX,
+    .k                  = DEFAULT_K,
+    .payload_len        = PAYLOAD_MAX_LEN,
+    .data_cache_entries = 0,
+    .update_count       = 20,
+    .update_interval_ms = 1000,
+    .seed               = 1,
+    .csv                = false,
+};
+
+static sim_node_t* mp_nodes;
+static sim_handle_t* mp_handles;
+static sim_stats_t m_stats;
+
+static sim_evt_t* mp_evt_heap;
+static uint32_t m_evt_count;
+static uint32_t m_evt_capacity;
+static uint32_t m_evt_seq;
+
+static uint32_t m_time_now;
+static uint32_t m_prng_state;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static void* checked_calloc(size_t count, size_t size)
+{
+    void* p = calloc(count, size);
+    if (p == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+/** Channel model randomness, kept separate from the Trickle PRNG so that the
+  topology and update pattern are reproducible for a given seed. */
+static double sim_rand(void)
+{
+    return rand() / ((double) RAND_MAX + 1.0);
+}
+
+static bool evt_earlier(const sim_evt_t* p_a, const sim_evt_t* p_b)
+{
+    if (p_a->time != p_b->time)
+    {
+        return (p_a->time < p_b->time);
+    }
+    return (p_a->seq < p_b->seq);
+}
+
+static void evt_push(sim_evt_type_t type, uint32_t time, uint32_t node, uint16_t handle, uint16_t version)
+{
+    if (m_evt_count == m_evt_capacity)
+    {
+        m_evt_capacity = (m_evt_capacity == 0) ? 1024 : m_evt_capacity * 2;
+        mp_evt_heap = realloc(mp_evt_heap, m_evt_capacity * sizeof(sim_evt_t));
+        if (mp_evt_heap == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+
+    sim_evt_t evt = {time, m_evt_seq++, node, handle, version, type};
+    uint32_t pos = m_evt_count++;
+    while (pos > 0 && evt_earlier(&evt, &mp_evt_heap[(pos - 1) / 2]))
+    {
+        mp_evt_heap[pos] = mp_evt_heap[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    mp_evt_heap[pos] = evt;
+}
+
+static bool evt_pop(sim_evt_t* p_evt)
+{
+    if (m_evt_count == 0)
+    {
+        return false;
+    }
+
+    *p_evt = mp_evt_heap[0];
+    sim_evt_t last = mp_evt_heap[--m_evt_count];
+    uint32_t pos = 0;
+    while (true)
+    {
+        uint32_t child = 2 * pos + 1;
+        if (child >= m_evt_count)
+        {
+            break;
+        }
+        if (child + 1 < m_evt_count && evt_earlier(&mp_evt_heap[child + 1], &mp_evt_heap[child]))
+        {
+            child++;
+        }
+        if (!evt_earlier(&mp_evt_heap[child], &last))
+        {
+            break;
+        }
+        mp_evt_heap[pos] = mp_evt_heap[child];
+        pos = child;
+    }
+    mp_evt_heap[pos] = last;
+    return true;
+}
+
+/** Order a wake event for the earliest Trickle timeout of the node. */
+static void node_wake_order(uint32_t node)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    if (p_node->transmitting || p_node->tx_queue_count > 0)
+    {
+        /* re-evaluated when the transmissions are done */
+        return;
+    }
+
+    bool found = false;
+    uint32_t earliest = 0;
+    for (uint32_t h = 0; h < m_config.handle_count; ++h)
+    {
+        sim_value_t* p_value = &p_node->p_values[h];
+        if (p_value->present && trickle_is_enabled(&p_value->trickle) &&
+            (!found || TIMER_OLDER_THAN(p_value->trickle.t, earliest)))
+        {
+            earliest = p_value->trickle.t;
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        p_node->wake_pending = false;
+        return;
+    }
+    if (TIMER_OLDER_THAN(earliest, m_time_now))
+    {
+        earliest = m_time_now;
+    }
+    if (p_node->wake_pending && p_node->next_wake == earliest)
+    {
+        return;
+    }
+    p_node->next_wake = earliest;
+    p_node->wake_pending = true;
+    evt_push(SIM_EVT_NODE_WAKE, earliest, node, 0, 0);
+}
+
+static void latency_register(uint32_t latency_us)
+{
+    uint32_t latency_ms = latency_us / 1000;
+    uint32_t bucket = 0;
+    for (uint32_t v = latency_ms; v > 0 && bucket < LATENCY_BUCKETS - 1; v >>= 1)
+    {
+        bucket++;
+    }
+    m_stats.latency_buckets[bucket]++;
+    m_stats.latency_sum_ms += latency_ms;
+    if (latency_ms > m_stats.latency_max_ms)
+    {
+        m_stats.latency_max_ms = latency_ms;
+    }
+    m_stats.reached++;
+}
+
+/** Register that a node now has every version up to the given one. */
+static void versions_reached(uint16_t handle, uint16_t old_version, uint16_t new_version)
+{
+    for (uint32_t v = old_version + 1; v <= new_version; ++v)
+    {
+        latency_register(m_time_now - mp_handles[handle].p_created[v]);
+    }
+}
+
+/** Mirrors the data cache eviction in handle_storage.c: the least recently
+  updated value loses its Trickle timer, but its version is remembered. */
+static void data_cache_evict(uint32_t node)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    sim_value_t* p_oldest = NULL;
+    for (uint32_t h = 0; h < m_config.handle_count; ++h)
+    {
+        sim_value_t* p_value = &p_node->p_values[h];
+        if (trickle_is_enabled(&p_value->trickle) &&
+            (p_oldest == NULL || TIMER_OLDER_THAN(p_value->updated, p_oldest->updated)))
+        {
+            p_oldest = p_value;
+        }
+    }
+    if (p_oldest != NULL)
+    {
+        trickle_disable(&p_oldest->trickle);
+        p_node->cached_count--;
+        m_stats.evictions++;
+    }
+}
+
+/** Mirrors the value processing in version_handler.c. */
+static void value_rx(uint32_t node, uint16_t handle, uint16_t version)
+{
+    sim_value_t* p_value = &mp_nodes[node].p_values[handle];
+    if (!p_value->present || version > p_value->version)
+    {
+        versions_reached(handle, p_value->present ? p_value->version : 0, version);
+        if (!p_value->present || !trickle_is_enabled(&p_value->trickle))
+        {
+            if (m_config.data_cache_entries != 0 &&
+                mp_nodes[node].cached_count >= m_config.data_cache_entries)
+            {
+                data_cache_evict(node);
+            }
+            p_value->present = true;
+            trickle_enable(&p_value->trickle);
+            mp_nodes[node].cached_count++;
+        }
+        p_value->version = version;
+        p_value->updated = m_time_now;
+        trickle_timer_reset(&p_value->trickle, m_time_now);
+        m_stats.rx_new++;
+    }
+    else if (version < p_value->version)
+    {
+        if (trickle_is_enabled(&p_value->trickle))
+        {
+            trickle_rx_inconsistent(&p_value->trickle, m_time_now);
+        }
+        m_stats.rx_inconsistent++;
+    }
+    else
+    {
+        if (trickle_is_enabled(&p_value->trickle))
+        {
+            trickle_rx_consistent(&p_value->trickle, m_time_now);
+        }
+        m_stats.rx_consistent++;
+    }
+    node_wake_order(node);
+}
+
+/** Start transmitting the next queued value, if any. */
+static void tx_next(uint32_t node)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    if (p_node->tx_queue_count == 0)
+    {
+        node_wake_order(node);
+        return;
+    }
+
+    uint16_t handle = p_node->p_tx_queue[0];
+    memmove(&p_node->p_tx_queue[0], &p_node->p_tx_queue[1], (p_node->tx_queue_count - 1) * sizeof(uint16_t));
+    p_node->tx_queue_count--;
+    evt_push(SIM_EVT_TX_START, m_time_now + RADIO_RAMP_UP_US, node, handle, 0);
+}
+
+/** Mirrors handle_storage_tx_packets_get(). */
+static void node_wake(uint32_t node)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    if (!p_node->wake_pending || p_node->next_wake != m_time_now)
+    {
+        return; /* stale */
+    }
+    p_node->wake_pending = false;
+
+    for (uint32_t h = 0; h < m_config.handle_count; ++h)
+    {
+        sim_value_t* p_value = &p_node->p_values[h];
+        if (p_value->present && trickle_is_enabled(&p_value->trickle) &&
+            !TIMER_OLDER_THAN(m_time_now, p_value->trickle.t))
+        {
+            bool do_tx = false;
+            trickle_tx_timeout(&p_value->trickle, &do_tx, m_time_now);
+            if (do_tx)
+            {
+                p_node->p_tx_queue[p_node->tx_queue_count++] = h;
+            }
+        }
+    }
+    tx_next(node);
+}
+
+static void tx_start(uint32_t node, uint16_t handle)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    p_node->transmitting = true;
+    m_stats.tx++;
+
+    /* the node's own reception is lost when it switches to TX */
+    if (p_node->rx_from != NODE_NONE && p_node->rx_ok)
+    {
+        p_node->rx_ok = false;
+        m_stats.rx_half_duplex++;
+    }
+
+    for (uint32_t i = 0; i < p_node->neighbor_count; ++i)
+    {
+        sim_node_t* p_rx = &mp_nodes[p_node->p_neighbors[i]];
+        m_stats.rx_attempts++;
+        if (p_rx->transmitting)
+        {
+            m_stats.rx_half_duplex++;
+        }
+        else if (p_rx->rx_count > 0)
+        {
+            /* overlapping transmissions corrupt each other */
+            m_stats.rx_collision++;
+            if (p_rx->rx_from != NODE_NONE && p_rx->rx_ok)
+            {
+                p_rx->rx_ok = false;
+                m_stats.rx_collision++;
+            }
+        }
+        else
+        {
+            p_rx->rx_from = node;
+            p_rx->rx_ok = true;
+        }
+        p_rx->rx_count++;
+    }
+
+    evt_push(SIM_EVT_TX_END, m_time_now + PACKET_AIRTIME_US(m_config.payload_len), node, handle, p_node->p_values[handle].version);
+}
+
+static void tx_end(uint32_t node, uint16_t handle, uint16_t version)
+{
+    sim_node_t* p_node = &mp_nodes[node];
+    p_node->transmitting = false;
+
+    for (uint32_t i = 0; i < p_node->neighbor_count; ++i)
+    {
+        uint32_t rx_node = p_node->p_neighbors[i];
+        sim_node_t* p_rx = &mp_nodes[rx_node];
+        p_rx->rx_count--;
+        if (p_rx->rx_from == node)
+        {
+            p_rx->rx_from = NODE_NONE;
+            if (p_rx->rx_ok)
+            {
+                if (sim_rand() < m_config.loss_rate)
+                {
+                    m_stats.rx_random_loss++;
+                }
+                else
+                {
+                    m_stats.rx_ok++;
+                    value_rx(rx_node, handle, version);
+                }
+            }
+        }
+    }
+
+    trickle_tx_register(&p_node->p_values[handle].trickle, m_time_now);
+    tx_next(node);
+}
+
+static void local_update(uint32_t node, uint16_t handle)
+{
+    sim_value_t* p_value = &mp_nodes[node].p_values[handle];
+    sim_handle_t* p_handle = &mp_handles[handle];
+    if (p_handle->version == UINT16_MAX)
+    {
+        return;
+    }
+
+    uint16_t new_version = ++p_handle->version;
+    /* the update is based on what the node has, other nodes may have later versions */
+    if (p_value->present && p_value->version >= new_version)
+    {
+        p_handle->version--;
+        return;
+    }
+    p_handle->p_created[new_version] = m_time_now;
+    value_rx(node, handle, new_version);
+}
+
+static void topology_build(void)
+{
+    for (uint32_t i = 0; i < m_config.node_count; ++i)
+    {
+        mp_nodes[i].x = (float) (sim_rand() * m_config.area_m);
+        mp_nodes[i].y = (float) (sim_rand() * m_config.area_m);
+        mp_nodes[i].p_values = checked_calloc(m_config.handle_count, sizeof(sim_value_t));
+        mp_nodes[i].p_tx_queue = checked_calloc(m_config.handle_count, sizeof(uint16_t));
+        mp_nodes[i].rx_from = NODE_NONE;
+    }
+
+    uint32_t* p_scratch = checked_calloc(m_config.node_count, sizeof(uint32_t));
+    const float range_sq = m_config.range_m * m_config.range_m;
+    for (uint32_t i = 0; i < m_config.node_count; ++i)
+    {
+        uint32_t count = 0;
+        for (uint32_t j = 0; j < m_config.node_count; ++j)
+        {
+            float dx = mp_nodes[i].x - mp_nodes[j].x;
+            float dy = mp_nodes[i].y - mp_nodes[j].y;
+            if (i != j && dx * dx + dy * dy <= range_sq)
+            {
+                p_scratch[count++] = j;
+            }
+        }
+        mp_nodes[i].p_neighbors = checked_calloc(count > 0 ? count : 1, sizeof(uint32_t));
+        memcpy(mp_nodes[i].p_neighbors, p_scratch, count * sizeof(uint32_t));
+        mp_nodes[i].neighbor_count = count;
+    }
+    free(p_scratch);
+}
+
+static void report(void)
+{
+    uint64_t neighbors = 0;
+    for (uint32_t i = 0; i < m_config.node_count; ++i)
+    {
+        neighbors += mp_nodes[i].neighbor_count;
+    }
+    uint64_t versions = 0;
+    for (uint32_t h = 0; h < m_config.handle_count; ++h)
+    {
+        versions += mp_handles[h].version;
+    }
+    /* the originating node doesn't count as reached */
+    uint64_t expected = versions * (m_config.node_count - 1);
+    uint64_t reached = m_stats.reached - versions;
+    /* share of the simulated time each node spends transmitting, and hearing transmissions */
+    double node_time_us = (double) m_config.node_count * m_config.duration_s * 1000000.0;
+    double duty = (double) m_stats.tx * PACKET_AIRTIME_US(m_config.payload_len) / node_time_us;
+    double channel = (double) m_stats.rx_attempts * PACKET_AIRTIME_US(m_config.payload_len) / node_time_us;
+
+    if (m_config.csv)
+    {
+        printf("nodes,handles,payload,data_cache,update_ms,versions,coverage_pct,latency_avg_ms,latency_max_ms,"
+                "tx_per_node_s,rx_per_node_s,new_per_node_s,duty_pct,channel_pct,evictions\n");
+        printf("%u,%u,%u,%u,%u,%llu,%.1f,%llu,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%llu\n",
+                m_config.node_count, m_config.handle_count, m_config.payload_len,
+                m_config.data_cache_entries, m_config.update_interval_ms,
+                (unsigned long long) versions,
+                expected ? 100.0 * reached / expected : 0.0,
+                (unsigned long long) (m_stats.reached ? m_stats.latency_sum_ms / m_stats.reached : 0),
+                m_stats.latency_max_ms,
+                (double) m_stats.tx / m_config.node_count / m_config.duration_s,
+                (double) m_stats.rx_ok / m_config.node_count / m_config.duration_s,
+                (double) m_stats.rx_new / m_config.node_count / m_config.duration_s,
+                100.0 * duty, 100.0 * channel,
+                (unsigned long long) m_stats.evictions);
+        return;
+    }
+
+    printf("Nodes:              %u (avg %.1f neighbors)\n", m_config.node_count,
+            (double) neighbors / m_config.node_count);
+    printf("Trickle:            I_min %u ms, I_max %u x I_min, k %u\n",
+            m_config.i_min_ms, m_config.i_max, m_config.k);
+    printf("Simulated time:     %u s, %llu versions of %u handles\n",
+            m_config.duration_s, (unsigned long long) versions, m_config.handle_count);
+    printf("Transmissions:      %llu (%.2f per node per second)\n",
+            (unsigned long long) m_stats.tx,
+            (double) m_stats.tx / m_config.node_count / m_config.duration_s);
+    printf("Airtime:            %u us per packet, %.2f%% TX duty cycle, %.2f%% channel busy per node\n",
+            PACKET_AIRTIME_US(m_config.payload_len), 100.0 * duty, 100.0 * channel);
+    printf("Trickle resets:     %u\n", trickle_reset_count_get());
+    if (m_config.data_cache_entries != 0)
+    {
+        printf("Evictions:          %llu (%u data cache entries per node)\n",
+                (unsigned long long) m_stats.evictions, m_config.data_cache_entries);
+    }
+    printf("Receptions:         %llu of %llu (%.1f%%)\n",
+            (unsigned long long) m_stats.rx_ok, (unsigned long long) m_stats.rx_attempts,
+            m_stats.rx_attempts ? 100.0 * m_stats.rx_ok / m_stats.rx_attempts : 0.0);
+    printf("  collisions:       %llu (%.1f%%)\n", (unsigned long long) m_stats.rx_collision,
+            m_stats.rx_attempts ? 100.0 * m_stats.rx_collision / m_stats.rx_attempts : 0.0);
+    printf("  half duplex:      %llu (%.1f%%)\n", (unsigned long long) m_stats.rx_half_duplex,
+            m_stats.rx_attempts ? 100.0 * m_stats.rx_half_duplex / m_stats.rx_attempts : 0.0);
+    printf("  random loss:      %llu (%.1f%%)\n", (unsigned long long) m_stats.rx_random_loss,
+            m_stats.rx_attempts ? 100.0 * m_stats.rx_random_loss / m_stats.rx_attempts : 0.0);
+    printf("  new/consistent/inconsistent: %llu/%llu/%llu\n",
+            (unsigned long long) m_stats.rx_new,
+            (unsigned long long) m_stats.rx_consistent,
+            (unsigned long long) m_stats.rx_inconsistent);
+    printf("Coverage:           %llu of %llu node versions (%.1f%%)\n",
+            (unsigned long long) reached, (unsigned long long) expected,
+            expected ? 100.0 * reached / expected : 0.0);
+
+    if (reached == 0)
+    {
+        return;
+    }
+
+    printf("Propagation latency: avg %llu ms, max %u ms\n",
+            (unsigned long long) (m_stats.latency_sum_ms / m_stats.reached), m_stats.latency_max_ms);
+    /* the originating node registers as bucket 0 */
+    m_stats.latency_buckets[0] -= versions;
+    uint64_t largest = 0;
+    for (uint32_t b = 0; b < LATENCY_BUCKETS; ++b)
+    {
+        if (m_stats.latency_buckets[b] > largest)
+        {
+            largest = m_stats.latency_buckets[b];
+        }
+    }
+    uint64_t cumulative = 0;
+    for (uint32_t b = 0; b < LATENCY_BUCKETS; ++b)
+    {
+        if (m_stats.latency_buckets[b] == 0)
+        {
+            continue;
+        }
+        cumulative += m_stats.latency_buckets[b];
+        char label[32];
+        if (b == 0)
+        {
+            snprintf(label, sizeof(label), "0");
+        }
+        else
+        {
+            snprintf(label, sizeof(label), "%u-%u", 1u << (b - 1), (1u << b) - 1);
+        }
+        uint32_t width = (uint32_t) ((m_stats.latency_buckets[b] * 40 + largest - 1) / largest);
+        printf("  %13s ms | %-40.*s %6.2f%% (cum %6.2f%%)\n", label, width,
+                "########################################",
+                100.0 * m_stats.latency_buckets[b] / reached, 100.0 * cumulative / reached);
+    }
+}
+
+static void usage(const char* p_name)
+{
+    printf("Usage: %s [options]\n", p_name);
+    printf("  -n <count>    Number of nodes (default %u)\n", m_config.node_count);
+    printf("  -H <count>    Number of value handles (default %u)\n", m_config.handle_count);
+    printf("  -a <meters>   Side length of the square area (default %.0f)\n", m_config.area_m);
+    printf("  -r <meters>   Radio range (default %.0f)\n", m_config.range_m);
+    printf("  -l <rate>     Random packet loss rate, 0-1 (default %.2f)\n", m_config.loss_rate);
+    printf("  -d <seconds>  Simulated time (default %u, max %u)\n", m_config.duration_s, MAX_DURATION_S);
+    printf("  -i <ms>       Trickle I_min (default %u)\n", m_config.i_min_ms);
+    printf("  -I <factor>   Trickle I_max, as multiple of I_min (default %u)\n", m_config.i_max);
+    printf("  -k <count>    Trickle redundancy constant (default %u)\n", m_config.k);
+    printf("  -p <bytes>    Value payload length, 0-%u (default %u)\n", PAYLOAD_MAX_LEN, m_config.payload_len);
+    printf("  -C <entries>  Data cache entries per node, 0 for all handles (default %u)\n", m_config.data_cache_entries);
+    printf("  -u <count>    Number of value updates (default %u)\n", m_config.update_count);
+    printf("  -U <ms>       Time between value updates (default %u)\n", m_config.update_interval_ms);
+    printf("  -s <seed>     Seed for topology, updates and channel (default %u)\n", m_config.seed);
+    printf("  -c            Print the results as CSV\n");
+}
+
+static void config_parse(int argc, char** argv)
+{
+    int opt;
+    uint32_t payload_len = m_config.payload_len;
+    while ((opt = getopt(argc, argv, "n:H:a:r:l:d:i:I:k:p:C:u:U:s:ch")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': m_config.node_count = strtoul(optarg, NULL, 0); break;
+            case 'H': m_config.handle_count = strtoul(optarg, NULL, 0); break;
+            case 'a': m_config.area_m = strtof(optarg, NULL); break;
+            case 'r': m_config.range_m = strtof(optarg, NULL); break;
+            case 'l': m_config.loss_rate = strtof(optarg, NULL); break;
+            case 'd': m_config.duration_s = strtoul(optarg, NULL, 0); break;
+            case 'i': m_config.i_min_ms = strtoul(optarg, NULL, 0); break;
+            case 'I': m_config.i_max = strtoul(optarg, NULL, 0); break;
+            case 'k': m_config.k = (uint8_t) strtoul(optarg, NULL, 0); break;
+            case 'p': payload_len = strtoul(optarg, NULL, 0); break;
+            case 'C': m_config.data_cache_entries = strtoul(optarg, NULL, 0); break;
+            case 'u': m_config.update_count = strtoul(optarg, NULL, 0); break;
+            case 'U': m_config.update_interval_ms = strtoul(optarg, NULL, 0); break;
+            case 's': m_config.seed = strtoul(optarg, NULL, 0); break;
+            case 'c': m_config.csv = true; break;
+            default:
+                usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    if (m_config.node_count < 2 || m_config.handle_count == 0 || m_config.handle_count > UINT16_MAX ||
+        m_config.duration_s == 0 || m_config.duration_s > MAX_DURATION_S ||
+        m_config.i_min_ms == 0 || m_config.i_max == 0 ||
+        m_config.k == 0 || m_config.k == TRICKLE_C_DISABLED ||
+        m_config.loss_rate < 0.0f || m_config.loss_rate > 1.0f ||
+        payload_len > PAYLOAD_MAX_LEN)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+    m_config.payload_len = (uint8_t) payload_len;
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+/** Softdevice stand-ins for rand.c, so the Trickle timers follow the seed too. */
+uint32_t sd_rand_application_bytes_available_get(uint8_t* p_bytes_available)
+{
+    *p_bytes_available = 4;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_rand_application_vector_get(uint8_t* p_buff, uint8_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        m_prng_state = m_prng_state * 1103515245 + 12345;
+        p_buff[i] = (uint8_t) (m_prng_state >> 16);
+    }
+    return NRF_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    config_parse(argc, argv);
+    srand(m_config.seed);
+    m_prng_state = m_config.seed;
+
+    trickle_setup(m_config.i_min_ms * 1000, m_config.i_max, m_config.k);
+
+    mp_nodes = checked_calloc(m_config.node_count, sizeof(sim_node_t));
+    mp_handles = checked_calloc(m_config.handle_count, sizeof(sim_handle_t));
+    for (uint32_t h = 0; h < m_config.handle_count; ++h)
+    {
+        mp_handles[h].p_created = checked_calloc(UINT16_MAX + 1, sizeof(uint32_t));
+    }
+    topology_build();
+
+    for (uint32_t i = 0; i < m_config.update_count; ++i)
+    {
+        uint32_t time = 1000 + i * m_config.update_interval_ms * 1000;
+        if (time >= m_config.duration_s * 1000000)
+        {
+            break;
+        }
+        evt_push(SIM_EVT_UPDATE, time,
+                (uint32_t) (sim_rand() * m_config.node_count),
+                (uint16_t) (sim_rand() * m_config.handle_count), 0);
+    }
+
+    const uint32_t end_time = m_config.duration_s * 1000000;
+    sim_evt_t evt;
+    while (evt_pop(&evt) && evt.time < end_time)
+    {
+        m_time_now = evt.time;
+        switch (evt.type)
+        {
+            case SIM_EVT_NODE_WAKE:
+                node_wake(evt.node);
+                break;
+            case SIM_EVT_TX_START:
+                tx_start(evt.node, evt.handle);
+                break;
+            case SIM_EVT_TX_END:
+                tx_end(evt.node, evt.handle, evt.version);
+                break;
+            case SIM_EVT_UPDATE:
+                local_update(evt.node, evt.handle);
+                break;
+        }
+    }
+
+    report();
+    return 0;
+}
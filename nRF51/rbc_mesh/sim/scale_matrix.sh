@@ -0,0 +1,115 @@
+# Runs mesh_sim over a grid of node counts, handle counts, payload lengths,
+# publish intervals and cache sizes, adds the host CPU time and RAM of the
+# matching cache size from mesh_bench, and compares every row with the stored
+# baseline (scale_baseline.csv). See README.adoc.
+#
+#   ./scale_matrix.sh        print the report and flag regressions
+#   ./scale_matrix.sh -w     write the results as the new baseline
+#
+# The grid is set with the NODES, HANDLES, PAYLOADS, INTERVALS_MS and
+# CACHE_SIZES environment variables. CACHE_SIZES are handle cache entries,
+# each with a data cache of half the size, and must be sizes mesh_bench runs.
+cd "$(dirname "$0")"
+NODES=${NODES:-"50 200"}
+HANDLES=${HANDLES:-"16 64"}
+PAYLOADS=${PAYLOADS:-"8 23"}
+INTERVALS_MS=${INTERVALS_MS:-"100 1000"}
+CACHE_SIZES=${CACHE_SIZES:-"16 64 256"}
+DURATION_S=${DURATION_S:-30}
+BASELINE=${BASELINE:-scale_baseline.csv}
+TOLERANCE=${TOLERANCE:-20}
+CPU_TOLERANCE=${CPU_TOLERANCE:-50}
+BENCH_RUNS=${BENCH_RUNS:-5}
+
+if [ ! -x ./mesh_sim ] || [ ! -x ./mesh_bench ] ; then
+	echo "Build mesh_sim and mesh_bench first (make)"
+	exit 1
+fi
+
+RESULTS=$(mktemp)
+BENCH=$(mktemp)
+MEMORY=$(mktemp)
+trap 'rm -f "$RESULTS" "$BENCH" "$MEMORY"' EXIT
+# the fastest of a few runs, as the host timing of a single run is noisy
+for i in $(seq $BENCH_RUNS) ; do
+	./mesh_bench -c -n 10000 -s $i
+done | awk -F, '$1 ~ /^vh_rx_(new_version|consistent)$/ && $3 == 100 {
+	key = $1","$2
+	if (!(key in ns) || $5 < ns[key]) ns[key] = $5
+} END { for (key in ns) print key",100,0,"ns[key] }' > "$BENCH"
+./mesh_bench -c -m > "$MEMORY"
+
+echo "nodes,handles,payload,cache,interval_ms,coverage_pct,latency_avg_ms,latency_max_ms,duty_pct,channel_pct,cpu_us_per_s,ram_bytes" > "$RESULTS"
+for c in $CACHE_SIZES ; do
+	ram=$(awk -F, -v c=$c '$1 == c { print $3 + $4 }' "$MEMORY")
+	ns_new=$(awk -F, -v c=$c '$1 == "vh_rx_new_version" && $2 == c { print $5 }' "$BENCH")
+	ns_consistent=$(awk -F, -v c=$c '$1 == "vh_rx_consistent" && $2 == c { print $5 }' "$BENCH")
+	if [ -z "$ram" ] || [ -z "$ns_new" ] ; then
+		echo "mesh_bench doesn't run a cache of $c entries"
+		exit 1
+	fi
+	for n in $NODES ; do
+	for h in $HANDLES ; do
+	for p in $PAYLOADS ; do
+	for u in $INTERVALS_MS ; do
+		./mesh_sim -c -n $n -H $h -p $p -C $((c / 2)) -U $u -u $((DURATION_S * 1000 / u)) -d $DURATION_S | tail -n 1 |
+		awk -F, -v c=$c -v ram=$ram -v ns_new=$ns_new -v ns_consistent=$ns_consistent '{
+			# receptions of known versions are processed as consistent ones
+			cpu = ($12 * ns_new + ($11 - $12) * ns_consistent) / 1000
+			printf "%u,%u,%u,%u,%u,%.1f,%u,%u,%.2f,%.2f,%.1f,%u\n", $1, $2, $3, c, $5, $7, $8, $9, $13, $14, cpu, ram
+		}' >> "$RESULTS"
+	done
+	done
+	done
+	done
+done
+
+if [ "$1" = "-w" ] ; then
+	cp "$RESULTS" "$BASELINE"
+	echo "Wrote $BASELINE"
+	exit 0
+fi
+
+if [ ! -f "$BASELINE" ] ; then
+	echo "No baseline in $BASELINE, write one with -w"
+	exit 1
+fi
+
+# Higher is worse for every metric but the coverage. Rows without a baseline
+# row are reported as new.
+printf "%6s %7s %7s %5s %8s %8s %7s %7s %7s %7s %8s %8s\n" nodes handles payload cache interval coverage avg_ms max_ms duty channel cpu_us/s ram
+awk -F, -v tol=$TOLERANCE -v cpu_tol=$CPU_TOLERANCE '
+	function worse(name, now, base, limit) {
+		if (now > base * (1 + limit / 100) && now - base > 1) {
+			flags = flags sprintf(" %s %+.0f%%", name, base > 0 ? 100 * (now - base) / base : 100)
+		}
+	}
+	FNR == 1 { next }
+	NR == FNR { base[$1","$2","$3","$4","$5] = $0; next }
+	{
+		key = $1","$2","$3","$4","$5
+		flags = ""
+		if (!(key in base)) {
+			flags = " new"
+		} else {
+			split(base[key], b, ",")
+			if ($6 < b[6] - 1) {
+				flags = flags sprintf(" coverage %+.1f", $6 - b[6])
+			}
+			worse("latency_avg", $7, b[7], tol)
+			worse("latency_max", $8, b[8], tol)
+			worse("duty", $9, b[9], tol)
+			worse("channel", $10, b[10], tol)
+			worse("cpu", $11, b[11], cpu_tol)
+			worse("ram", $12, b[12], 0)
+		}
+		if (flags != "" && flags != " new") {
+			regressions++
+		}
+		printf "%6u %7u %7u %5u %8u %7.1f%% %7u %7u %6.2f%% %6.2f%% %8.1f %8u %s\n",
+			$1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, flags == "" ? "ok" : substr(flags, 2)
+	}
+	END {
+		printf "%u regressions against the baseline\n", regressions
+		exit (regressions > 0)
+	}' "$BASELINE" "$RESULTS"
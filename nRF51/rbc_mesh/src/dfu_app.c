@@ -65,6 +65,10 @@ extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_event);
 #define DFU_TX_INTERVAL_US          (100000)    /**< Time between transmits on regular interval, and base-interval on exponential. */
 #define DFU_TX_START_DELAY_MASK_US  (0xFFFF)    /**< Must be power of two. */
 #define DFU_TX_TIMER_MARGIN_US      (1000)      /**< Time margin for a timeout to be considered instant. */
+#define DFU_TX_HOLD_US              (5000)      /**< Time to wait before retrying a transmit the transport held back. */
+#define DFU_TX_TRICKLE_I_MIN_US     (1000000)   /**< Shortest interval of trickle transmits. */
+#define DFU_TX_TRICKLE_DOUBLINGS    (6)         /**< Number of times the trickle interval may double. */
+#define DFU_TX_TRICKLE_REDUNDANCY   (3)         /**< Number of copies heard in an interval that make our own transmit redundant. */
 
 #define TIMER_REQ_TIMEOUT           (100000000) /**< Time to wait before giving up on an ongoing request. */
 #define TIMER_START_TIMEOUT         ( 50000000) /**< Time to wait for first data during a transfer. */
@@ -79,7 +83,9 @@ typedef struct
     uint32_t order_time;
     bl_radio_interval_type_t interval_type;
     uint8_t repeats;
-    uint8_t tx_count;
+    uint8_t tx_count;           /**< Number of interval doublings for trickle transmits. */
+    uint8_t redundancy;         /**< Copies heard in the current trickle interval. */
+    uint32_t trickle_offset;    /**< Time of the transmit in the current trickle interval. */
 } dfu_tx_t;
 
 /*****************************************************************************
@@ -116,9 +122,57 @@ static uint32_t get_curr_fwid(dfu_type_t type, fwid_union_t* p_fwid)
     return NRF_SUCCESS;
 }
 
+static uint32_t trickle_interval_get(dfu_tx_t* p_tx)
+{
+    return (DFU_TX_TRICKLE_I_MIN_US << p_tx->tx_count);
+}
+
+/** Pick the time of the transmit in the second half of the current interval. */
+static void trickle_offset_set(dfu_tx_t* p_tx)
+{
+    uint32_t interval = trickle_interval_get(p_tx);
+    p_tx->trickle_offset = interval / 2 + (rand_prng_get(&m_prng) % (interval / 2));
+}
+
+/** Move a trickle transmit on to its next, longer interval. */
+static void trickle_interval_next(dfu_tx_t* p_tx)
+{
+    p_tx->order_time += trickle_interval_get(p_tx);
+    if (p_tx->tx_count < DFU_TX_TRICKLE_DOUBLINGS)
+    {
+        p_tx->tx_count++;
+    }
+    p_tx->redundancy = 0;
+    trickle_offset_set(p_tx);
+}
+
+/** Register received copies of our trickle transmits, which make our own
+  transmits redundant. */
+static void tx_echo_register(const dfu_packet_t* p_packet, uint32_t length)
+{
+    for (uint32_t i = 0; i < DFU_TX_SLOTS; ++i)
+    {
+        if (m_tx_slots[i].p_packet &&
+            m_tx_slots[i].interval_type == BL_RADIO_INTERVAL_TYPE_TRICKLE &&
+            m_tx_slots[i].redundancy < DFU_TX_TRICKLE_REDUNDANCY)
+        {
+            ble_ad_t* p_adv_data = (ble_ad_t*) m_tx_slots[i].p_packet->payload;
+            if (p_adv_data->adv_data_length == DFU_PACKET_ADV_OVERHEAD + length &&
+                memcmp(&m_tx_slots[i].p_packet->payload[4], p_packet, length) == 0)
+            {
+                m_tx_slots[i].redundancy++;
+            }
+        }
+    }
+}
+
 static uint32_t next_tx_timeout(dfu_tx_t* p_tx)
 {
-    if (p_tx->interval_type == BL_RADIO_INTERVAL_TYPE_EXPONENTIAL)
+    if (p_tx->interval_type == BL_RADIO_INTERVAL_TYPE_TRICKLE)
+    {
+        return (p_tx->order_time + p_tx->trickle_offset);
+    }
+    else if (p_tx->interval_type == BL_RADIO_INTERVAL_TYPE_EXPONENTIAL)
     {
         return (p_tx->order_time + DFU_TX_INTERVAL_US * ((1 << (p_tx->tx_count)) - 1));
     }
@@ -155,7 +209,23 @@ static void tx_timeout(uint32_t timestamp, void* p_context)
             uint32_t timeout = next_tx_timeout(&m_tx_slots[i]);
             if (TIMER_OLDER_THAN(timeout, (timestamp + DFU_TX_TIMER_MARGIN_US)))
             {
-                if (tc_tx(m_tx_slots[i].p_packet, &m_tx_config) == NRF_SUCCESS)
+                uint32_t error_code = NRF_SUCCESS;
+                if (m_tx_slots[i].redundancy < DFU_TX_TRICKLE_REDUNDANCY)
+                {
+                    error_code = tc_tx(m_tx_slots[i].p_packet, &m_tx_config);
+                }
+
+                if (error_code == NRF_ERROR_BUSY)
+                {
+                    /* leaving the air to values, keep the slot's schedule */
+                    timeout = timestamp + DFU_TX_HOLD_US;
+                }
+                else if (m_tx_slots[i].interval_type == BL_RADIO_INTERVAL_TYPE_TRICKLE)
+                {
+                    trickle_interval_next(&m_tx_slots[i]);
+                    timeout = next_tx_timeout(&m_tx_slots[i]);
+                }
+                else if (error_code == NRF_SUCCESS)
                 {
                     m_tx_slots[i].tx_count++;
 
@@ -271,7 +341,7 @@ uint32_t dfu_init(void)
     m_tx_config.tx_power = RBC_MESH_TXPOWER_0dBm;
 
 
-    mesh_flash_init(flash_op_complete);
+    mesh_flash_init(MESH_FLASH_USER_DFU, flash_op_complete);
 
     bl_cmd_t init_cmd =
     {
@@ -353,7 +423,7 @@ uint32_t dfu_rx(dfu_packet_t* p_packet, uint32_t length)
         return NRF_ERROR_INVALID_ADDR;
     }
 
-    if (mesh_flash_in_progress())
+    if (mesh_flash_user_in_progress(MESH_FLASH_USER_DFU))
     {
         return NRF_ERROR_BUSY;
     }
@@ -396,6 +466,13 @@ uint32_t dfu_request(dfu_type_t type,
 
 uint32_t dfu_relay(dfu_type_t type,
         fwid_union_t* p_fwid)
+{
+    return dfu_relay_cached(type, p_fwid, NULL);
+}
+
+uint32_t dfu_relay_cached(dfu_type_t type,
+        fwid_union_t* p_fwid,
+        uint32_t* p_bank_addr)
 {
     if (p_fwid == NULL)
     {
@@ -406,6 +483,7 @@ uint32_t dfu_relay(dfu_type_t type,
     cmd.params.dfu.start.relay.type = type;
     cmd.params.dfu.start.relay.fwid = *p_fwid;
     cmd.params.dfu.start.relay.transaction_id = 0;
+    cmd.params.dfu.start.relay.p_bank_start = p_bank_addr;
     uint32_t status = dfu_cmd_send(&cmd);
     if (status == NRF_SUCCESS)
     {
@@ -452,6 +530,20 @@ uint32_t dfu_bank_flash(dfu_type_t bank_type)
     return error_code;
 }
 
+uint32_t dfu_rollback_confirm(void)
+{
+    bl_cmd_t cmd;
+    cmd.type = BL_CMD_TYPE_DFU_ROLLBACK_CONFIRM;
+    return dfu_cmd_send(&cmd);
+}
+
+uint32_t dfu_rollback(void)
+{
+    bl_cmd_t cmd;
+    cmd.type = BL_CMD_TYPE_DFU_ROLLBACK;
+    return dfu_cmd_send(&cmd);
+}
+
 uint32_t dfu_state_get(dfu_transfer_state_t* p_dfu_transfer_state)
 {
     if (p_dfu_transfer_state == NULL)
@@ -473,6 +565,10 @@ uint32_t dfu_cmd_send(bl_cmd_t* p_cmd)
         __LOG(RTT_CTRL_TEXT_RED "ERROR: No CMD handler!\n");
         return NRF_ERROR_INVALID_STATE;
     }
+    if (p_cmd->type == BL_CMD_TYPE_RX)
+    {
+        tx_echo_register(p_cmd->params.rx.p_dfu_packet, p_cmd->params.rx.length);
+    }
     /* Suspend flash operations for the duration of the command to avoid
        premature flash-events disturbing the flow */
     mesh_flash_set_suspended(true);
@@ -612,7 +708,7 @@ uint32_t dfu_evt_handler(bl_evt_t* p_evt)
                     return NRF_ERROR_INVALID_LENGTH;
                 }
 
-                uint32_t error_code = mesh_flash_op_push(FLASH_OP_TYPE_ERASE, &p_evt->params.flash);
+                uint32_t error_code = mesh_flash_op_push(MESH_FLASH_USER_DFU, FLASH_OP_TYPE_ERASE, &p_evt->params.flash);
                 if (error_code == NRF_SUCCESS)
                 {
                     __LOG("\tErase flash at: 0x%x (length %d)\n", p_evt->params.flash.erase.start_addr, p_evt->params.flash.erase.length);
@@ -630,7 +726,7 @@ uint32_t dfu_evt_handler(bl_evt_t* p_evt)
                 {
                     return NRF_ERROR_INVALID_LENGTH;
                 }
-                uint32_t error_code = mesh_flash_op_push(FLASH_OP_TYPE_WRITE, &p_evt->params.flash);
+                uint32_t error_code = mesh_flash_op_push(MESH_FLASH_USER_DFU, FLASH_OP_TYPE_WRITE, &p_evt->params.flash);
                 if (error_code == NRF_SUCCESS)
                 {
                     __LOG("\tWrite flash at: 0x%x (length %d)\n", p_evt->params.flash.write.start_addr, p_evt->params.flash.write.length);
@@ -669,7 +765,12 @@ uint32_t dfu_evt_handler(bl_evt_t* p_evt)
                 m_tx_slots[p_evt->params.tx.radio.tx_slot].interval_type = p_evt->params.tx.radio.interval_type;
                 m_tx_slots[p_evt->params.tx.radio.tx_slot].repeats = p_evt->params.tx.radio.tx_count;
                 m_tx_slots[p_evt->params.tx.radio.tx_slot].tx_count = 0;
+                m_tx_slots[p_evt->params.tx.radio.tx_slot].redundancy = 0;
                 m_tx_slots[p_evt->params.tx.radio.tx_slot].order_time = time_now + DFU_TX_TIMER_MARGIN_US + (rand_prng_get(&m_prng) & (DFU_TX_START_DELAY_MASK_US));
+                if (p_evt->params.tx.radio.interval_type == BL_RADIO_INTERVAL_TYPE_TRICKLE)
+                {
+                    trickle_offset_set(&m_tx_slots[p_evt->params.tx.radio.tx_slot]);
+                }
 
                 /* Fire away */
                 if (!m_tx_scheduled || TIMER_DIFF(m_tx_slots[p_evt->params.tx.radio.tx_slot].order_time, time_now) < TIMER_DIFF(m_tx_timer_evt.timestamp, time_now))
@@ -157,16 +157,9 @@ bool ready_packet_matches_our_req(dfu_packet_t* p_packet, dfu_type_t dfu_type_re
                    dfu_type_req);
 }
 
-uint32_t* addr_from_seg(uint16_t segment, uint32_t* p_start_addr)
+uint32_t* addr_from_seg(uint16_t segment, uint32_t* p_start_addr, uint8_t segment_size)
 {
-    if (segment == 1)
-    {
-        return p_start_addr;
-    }
-    else
-    {
-        return (uint32_t*) (((segment - 1) << 4) + ((uint32_t) p_start_addr & 0xFFFFFFF0));
-    }
+    return (uint32_t*) SEGMENT_ADDR(segment, p_start_addr, segment_size);
 }
 
 bool app_is_newer(app_id_t* p_app_id)
@@ -29,6 +29,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 #include "event_handler.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
+#include "isr_stats.h"
 #include "app_error.h"
 #include "timeslot.h"
 #include "transport_control.h"
@@ -39,15 +41,30 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "handle_storage.h"
 #include <string.h>
 #include "rbc_mesh.h"
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+#include "mesh_app_cmd.h"
+#endif
 
 
 #define EVENT_HANDLER_IRQ       (QDEC_IRQn)
 
+/** Maximum number of received packets processed in one go, before the other
+    classes get a chance to run. */
+#define EVENT_HANDLER_RX_BATCH  (4)
 
+/** Event priority classes, highest priority first. Must match the
+    RBC_MESH_EVENT_CLASS_COUNT classes documented in rbc_mesh.h. */
+typedef enum
+{
+    EVENT_CLASS_TIMER,
+    EVENT_CLASS_RX,
+    EVENT_CLASS_FLAG,
+    EVENT_CLASS_GENERIC
+} event_class_t;
 
-static fifo_t g_async_evt_fifo;
+static fifo_t g_async_evt_fifo[RBC_MESH_EVENT_CLASS_COUNT];
 
-static async_event_t g_async_evt_fifo_buffer[RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH];
+static async_event_t g_async_evt_fifo_buffer[RBC_MESH_EVENT_CLASS_COUNT][RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH];
 static fifo_t g_async_evt_fifo_ts;
 
 static async_event_t g_async_evt_fifo_buffer_ts[RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH];
@@ -55,79 +72,49 @@ static bool g_is_initialized;
 static uint32_t g_critical = 0;
 
 
-#if defined(WITH_ACK_MASTER)
-static uint32_t event_handler_counter[5] __attribute__((at(0x200031D0)))={0};
-#endif
-
-#if defined(WITHOUT_ACK_MASTER)
-static uint32_t event_handler_counter[5]__attribute__((at(0x200028B8)))={0};
-#endif
-
-#if defined(WITH_ACK_SLAVE)
-static uint32_t event_handler_counter[5] __attribute__((at(0x200028CC))) ={0};
-#endif
-
-#if defined(WITHOUT_ACK_SLAVE)
-static uint32_t event_handler_counter[5] __attribute__((at(0x200028B4)))={0};
-#endif
+static uint32_t g_processed_count;
+static uint32_t g_drop_count;
+/** Number of dispatches each class has waited for, while it had pending events. */
+static uint32_t g_class_wait[RBC_MESH_EVENT_CLASS_COUNT];
+static rbc_mesh_event_class_stats_t g_class_stats[RBC_MESH_EVENT_CLASS_COUNT];
 
 /**
 * @brief execute asynchronous event, based on type
 */
 static void async_event_execute(async_event_t* p_evt)
 {
-
+    g_processed_count++;
+    TRACE_BEGIN(MESH_TRACE_POINT_EVENT, p_evt->type);
     switch (p_evt->type)
     {
         case EVENT_TYPE_TIMER:
             CHECK_FP(p_evt->callback.timer.cb);
             p_evt->callback.timer.cb(p_evt->callback.timer.timestamp);
-        
-            #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)||defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-		    event_handler_counter[0]++;
-            #endif
             break;
         case EVENT_TYPE_GENERIC:
             CHECK_FP(p_evt->callback.generic.cb);
             p_evt->callback.generic.cb(p_evt->callback.generic.p_context);
-        
-            #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)||defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-		    event_handler_counter[1]++;
-            #endif
-        
             break;
         case EVENT_TYPE_PACKET:
             tc_packet_handler(p_evt->callback.packet.payload,
                               p_evt->callback.packet.crc,
                               p_evt->callback.packet.timestamp,
                               p_evt->callback.packet.rssi);
-        
-            #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)||defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-		    event_handler_counter[2]++;
-            #endif
-        
             break;
         case EVENT_TYPE_SET_FLAG:
             handle_storage_flag_set(p_evt->callback.set_flag.handle,
                                     (handle_flag_t) p_evt->callback.set_flag.flag,
                                     p_evt->callback.set_flag.value);
-            #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)||defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-			event_handler_counter[3]++;
-            #endif
-        
             break;
         case EVENT_TYPE_TIMER_SCH:
             CHECK_FP(p_evt->callback.timer_sch.cb);
             p_evt->callback.timer_sch.cb(p_evt->callback.timer_sch.timestamp,
                                          p_evt->callback.timer_sch.p_context);
-        
-            #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)||defined(WITH_ACK_SLAVE)||defined(WITHOUT_ACK_SLAVE)
-		    event_handler_counter[4]++;
-            #endif
             break;
         default:
             break;
     }
+    TRACE_END(MESH_TRACE_POINT_EVENT, p_evt->type);
 }
 
 static bool event_fifo_pop(fifo_t* evt_fifo)
@@ -145,27 +132,149 @@ static bool event_fifo_pop(fifo_t* evt_fifo)
     return false;
 }
 
+/** Number of events waiting in the given class. Timer events from the
+    timeslot FIFO only count inside the timeslot. */
+static uint32_t class_length(event_class_t evt_class)
+{
+    uint32_t length = fifo_get_len(&g_async_evt_fifo[evt_class]);
+    switch (evt_class)
+    {
+        case EVENT_CLASS_TIMER:
+            if (timeslot_is_in_ts())
+            {
+                length += fifo_get_len(&g_async_evt_fifo_ts);
+            }
+            break;
+        case EVENT_CLASS_RX:
+            length += tc_rx_queue_length();
+            break;
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+        case EVENT_CLASS_FLAG:
+            length += mesh_app_cmd_length();
+            break;
+#endif
+        default:
+            break;
+    }
+    return length;
+}
+
+static void class_length_register(event_class_t evt_class, uint32_t length)
+{
+    if (length > g_class_stats[evt_class].high_water_mark)
+    {
+        g_class_stats[evt_class].high_water_mark = length;
+    }
+}
+
+/** Execute one event, or one batch of received packets, from the given class. */
+static bool class_dispatch(event_class_t evt_class)
+{
+    switch (evt_class)
+    {
+        case EVENT_CLASS_TIMER:
+            /* timeslot timers are the most time critical */
+            if (timeslot_is_in_ts() && event_fifo_pop(&g_async_evt_fifo_ts))
+            {
+                return true;
+            }
+            break;
+        case EVENT_CLASS_RX:
+            if (tc_rx_queue_process(EVENT_HANDLER_RX_BATCH) > 0)
+            {
+                return true;
+            }
+            break;
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+        case EVENT_CLASS_FLAG:
+            if (mesh_app_cmd_process(1) > 0)
+            {
+                return true;
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+    return event_fifo_pop(&g_async_evt_fifo[evt_class]);
+}
+
+static event_class_t class_get(event_type_t type)
+{
+    switch (type)
+    {
+        case EVENT_TYPE_TIMER:
+        case EVENT_TYPE_TIMER_SCH:
+            return EVENT_CLASS_TIMER;
+        case EVENT_TYPE_PACKET:
+            return EVENT_CLASS_RX;
+        case EVENT_TYPE_SET_FLAG:
+            return EVENT_CLASS_FLAG;
+        default:
+            return EVENT_CLASS_GENERIC;
+    }
+}
+
+static void irq_pend(void)
+{
+    ISR_STATS_PEND(RBC_MESH_ISR_EVENT);
+    NVIC_SetPendingIRQ(EVENT_HANDLER_IRQ);
+}
+
 /**
-* @brief Async event dispatcher, works in APP LOW
+* @brief Async event dispatcher, works in APP LOW. Always dispatches from the
+*   highest priority class with pending events, unless a lower class has been
+*   waiting for RBC_MESH_EVENT_STARVATION_LIMIT dispatches.
 */
 void QDEC_IRQHandler(void)
 {
+    ISR_STATS_BEGIN(RBC_MESH_ISR_EVENT);
     while (true)
     {
-        bool got_evt = false;
+        uint32_t pending = 0;
+        int32_t next = -1;
+        for (uint32_t i = 0; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
+        {
+            uint32_t length = class_length((event_class_t) i);
+            if (length > 0)
+            {
+                class_length_register((event_class_t) i, length);
+                pending |= (1 << i);
+                if (next < 0)
+                {
+                    next = i;
+                }
+            }
+        }
 
-        got_evt |= event_fifo_pop(&g_async_evt_fifo);
+        if (next < 0)
+        {
+            break;
+        }
 
-        if (timeslot_is_in_ts()) /* in timeslot */
+        /* bound the wait of the lower classes */
+        for (uint32_t i = next + 1; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
         {
-            got_evt |= event_fifo_pop(&g_async_evt_fifo_ts);
+            if ((pending & (1 << i)) && g_class_wait[i] >= RBC_MESH_EVENT_STARVATION_LIMIT)
+            {
+                g_class_stats[i].promoted++;
+                next = i;
+                break;
+            }
         }
 
-        if (!got_evt)
+        for (uint32_t i = 0; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
         {
-            break;
+            if (pending & (1 << i))
+            {
+                g_class_wait[i]++;
+            }
         }
+        g_class_wait[next] = 0;
+
+        (void) class_dispatch((event_class_t) next);
     }
+    ISR_STATS_END(RBC_MESH_ISR_EVENT);
 }
 
 void event_handler_init(void)
@@ -176,12 +285,14 @@ void event_handler_init(void)
         return;
     }
     /* init event queues */
-  
-     g_async_evt_fifo.array_len =RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH ;
-    g_async_evt_fifo.elem_array = g_async_evt_fifo_buffer;
-    g_async_evt_fifo.elem_size = sizeof(async_event_t);
-    g_async_evt_fifo.memcpy_fptr = NULL;
-    fifo_init(&g_async_evt_fifo);
+    for (uint32_t i = 0; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
+    {
+        g_async_evt_fifo[i].array_len = RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH;
+        g_async_evt_fifo[i].elem_array = g_async_evt_fifo_buffer[i];
+        g_async_evt_fifo[i].elem_size = sizeof(async_event_t);
+        g_async_evt_fifo[i].memcpy_fptr = NULL;
+        fifo_init(&g_async_evt_fifo[i]);
+    }
 
  
     g_async_evt_fifo_ts.array_len = RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH; 
@@ -213,7 +324,7 @@ uint32_t event_handler_push(async_event_t* p_evt)
     case EVENT_TYPE_PACKET:
     case EVENT_TYPE_SET_FLAG:
     case EVENT_TYPE_TIMER_SCH:
-        p_fifo = &g_async_evt_fifo;
+        p_fifo = &g_async_evt_fifo[class_get(p_evt->type)];
         break;
     case EVENT_TYPE_TIMER:
         p_fifo = &g_async_evt_fifo_ts;
@@ -224,17 +335,29 @@ uint32_t event_handler_push(async_event_t* p_evt)
     uint32_t result = fifo_push(p_fifo, p_evt);
     if (result != NRF_SUCCESS)
     {
+        g_drop_count++;
         return result;
     }
+    class_length_register(class_get(p_evt->type), fifo_get_len(p_fifo));
 
     /* trigger IRQ */
-    NVIC_SetPendingIRQ(EVENT_HANDLER_IRQ);
+    irq_pend();
 
     return NRF_SUCCESS;
 }
 
 
 
+void event_handler_rx_signal(void)
+{
+    irq_pend();
+}
+
+void event_handler_signal(void)
+{
+    irq_pend();
+}
+
 void event_handler_on_ts_end(void)
 {
     fifo_flush(&g_async_evt_fifo_ts);
@@ -242,10 +365,17 @@ void event_handler_on_ts_end(void)
 
 void event_handler_on_ts_begin(void)
 {
-    if (!fifo_is_empty(&g_async_evt_fifo) ||
-        !fifo_is_empty(&g_async_evt_fifo_ts))
+    for (uint32_t i = 0; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
     {
-        NVIC_SetPendingIRQ(EVENT_HANDLER_IRQ);
+        if (!fifo_is_empty(&g_async_evt_fifo[i]))
+        {
+            irq_pend();
+            return;
+        }
+    }
+    if (!fifo_is_empty(&g_async_evt_fifo_ts))
+    {
+        irq_pend();
     }
 }
 
@@ -271,3 +401,18 @@ void event_handler_critical_section_end(void)
     _ENABLE_IRQS(was_masked);
 }
 
+void event_handler_stats_get(rbc_mesh_stats_t* p_stats)
+{
+    p_stats->internal_events = g_processed_count;
+    p_stats->internal_queue_drop = g_drop_count;
+    for (uint32_t i = 0; i < RBC_MESH_EVENT_CLASS_COUNT; ++i)
+    {
+        p_stats->event_class[i] = g_class_stats[i];
+        p_stats->event_class[i].queue_length = class_length((event_class_t) i);
+    }
+}
+
+uint32_t event_handler_ram_size_get(void)
+{
+    return sizeof(g_async_evt_fifo_buffer) + sizeof(g_async_evt_fifo_buffer_ts);
+}
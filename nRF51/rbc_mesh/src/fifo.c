@@ -38,6 +38,10 @@
 #define FIFO_ELEM_AT(p_fifo, index) ((uint8_t*) ((uint8_t*) p_fifo->elem_array) + (p_fifo->elem_size) * (index))
 #define FIFO_IS_FULL(p_fifo) (p_fifo->tail + p_fifo->array_len == p_fifo->head)
 #define FIFO_IS_EMPTY(p_fifo) (p_fifo->tail == p_fifo->head)
+
+/* The index owned by the other side of an SPSC FIFO may change at any time,
+   must force a fresh read. */
+#define FIFO_INDEX_READ(index) (*((volatile uint32_t*) &(index)))
 /*****************************************************************************
  * Interface functions
  *****************************************************************************/
@@ -138,6 +142,15 @@ uint32_t fifo_peek(fifo_t* p_fifo, void* p_elem)
     return fifo_peek_at(p_fifo, p_elem, 0);
 }
 
+void* fifo_elem_ref_at(fifo_t* p_fifo, uint32_t elem)
+{
+    if (fifo_get_len(p_fifo) <= elem)
+    {
+        return NULL;
+    }
+    return FIFO_ELEM_AT(p_fifo, (p_fifo->tail + elem) & (p_fifo->array_len - 1));
+}
+
 void fifo_flush(fifo_t* p_fifo)
 {
     p_fifo->tail = p_fifo->head;
@@ -157,3 +170,92 @@ bool fifo_is_empty(fifo_t* p_fifo)
 {
     return FIFO_IS_EMPTY(p_fifo);
 }
+
+uint32_t fifo_reserve(fifo_t* p_fifo, void** pp_elem)
+{
+    if (pp_elem == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_fifo->head - FIFO_INDEX_READ(p_fifo->tail) >= p_fifo->array_len)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    *pp_elem = FIFO_ELEM_AT(p_fifo, p_fifo->head & (p_fifo->array_len - 1));
+    return NRF_SUCCESS;
+}
+
+void fifo_commit(fifo_t* p_fifo)
+{
+    /* the slot contents must be in place before the consumer sees the new head */
+    __DMB();
+    FIFO_INDEX_READ(p_fifo->head) = p_fifo->head + 1;
+}
+
+uint32_t fifo_peek_ref(fifo_t* p_fifo, void** pp_elem)
+{
+    if (pp_elem == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (FIFO_INDEX_READ(p_fifo->head) == p_fifo->tail)
+    {
+        return NRF_ERROR_NULL;
+    }
+    /* don't read the slot before the head */
+    __DMB();
+
+    *pp_elem = FIFO_ELEM_AT(p_fifo, p_fifo->tail & (p_fifo->array_len - 1));
+    return NRF_SUCCESS;
+}
+
+void fifo_release(fifo_t* p_fifo)
+{
+    /* the slot must be read out before the producer may reuse it */
+    __DMB();
+    FIFO_INDEX_READ(p_fifo->tail) = p_fifo->tail + 1;
+}
+
+uint32_t fifo_spsc_push(fifo_t* p_fifo, const void* p_elem)
+{
+    if (p_elem == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    void* p_dest;
+    uint32_t error_code = fifo_reserve(p_fifo, &p_dest);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    if (p_fifo->memcpy_fptr)
+        p_fifo->memcpy_fptr(p_dest, p_elem);
+    else
+        memcpy(p_dest, p_elem, p_fifo->elem_size);
+
+    fifo_commit(p_fifo);
+    return NRF_SUCCESS;
+}
+
+uint32_t fifo_spsc_pop(fifo_t* p_fifo, void* p_elem)
+{
+    void* p_src;
+    uint32_t error_code = fifo_peek_ref(p_fifo, &p_src);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    if (p_elem != NULL)
+    {
+        if (p_fifo->memcpy_fptr)
+            p_fifo->memcpy_fptr(p_elem, p_src);
+        else
+            memcpy(p_elem, p_src, p_fifo->elem_size);
+    }
+
+    fifo_release(p_fifo);
+    return NRF_SUCCESS;
+}
@@ -36,21 +36,78 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "event_handler.h"
 #include "fifo.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
 #include "timer.h"
 #include "app_error.h"
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+#include "value_store.h"
+#endif
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+#include "value_flash.h"
+#endif
+#ifdef RBC_MESH_VALUE_SHADOW
+#include "mesh_shadow.h"
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+#include "value_retain.h"
+#endif
+#ifdef RBC_MESH_VALUE_HISTORY
+#include "value_history.h"
+#endif
 
 #define MESH_TRICKLE_I_MAX              (2048)
 #define MESH_TRICKLE_K                  (3)
 
 
-#define HANDLE_CACHE_ENTRY_INVALID      (RBC_MESH_HANDLE_CACHE_ENTRIES)
-#define DATA_CACHE_ENTRY_INVALID        (RBC_MESH_DATA_CACHE_ENTRIES)
+#define HANDLE_CACHE_ENTRY_INVALID      (m_handle_cache_size)
+#define DATA_CACHE_ENTRY_INVALID        (m_data_cache_size)
+#define HANDLE_CACHE_ENTRIES_MAX        (0x7FFF) /**< Limited by the 15 bit linked list indexes. */
+#define DATA_CACHE_ENTRIES_MAX          (TX_HEAP_INDEX_INVALID - 1)
 
 #define CACHE_TASK_FIFO_SIZE            (8)
 
+#define TX_HEAP_INDEX_INVALID           (0xFFFF)
+#define TX_HEAP_PARENT(pos)             (((pos) - 1) / 2)
+#define TX_HEAP_CHILD_LEFT(pos)         (2 * (pos) + 1)
+#define TX_HEAP_TRICKLE(pos)            (&m_data_cache[m_tx_heap[pos]].trickle)
+#ifdef RBC_MESH_COMPACT_TRICKLE
+/* the compact TX times are only ordered against each other, or a reference time */
+#define TX_HEAP_EARLIER(pos, ref_pos)   trickle_tx_is_earlier(TX_HEAP_TRICKLE(pos), TX_HEAP_TRICKLE(ref_pos))
+#define TX_HEAP_T(pos, time_ref)        trickle_tx_time_get(TX_HEAP_TRICKLE(pos), time_ref)
+#else
+#define TX_HEAP_EARLIER(pos, ref_pos)   TIMER_OLDER_THAN(TX_HEAP_TRICKLE(pos)->t, TX_HEAP_TRICKLE(ref_pos)->t)
+#define TX_HEAP_T(pos, time_ref)        (TX_HEAP_TRICKLE(pos)->t)
+#endif
+
+#define HANDLE_INDEX_MASK               (m_handle_index_mask)
+#define HANDLE_INDEX_SLOT(handle)       ((((uint32_t) (handle) * 40503UL) >> 8) & HANDLE_INDEX_MASK) /**< Multiplicative hash */
+#define HANDLE_INDEX_NEXT(slot)         (((slot) + 1) & HANDLE_INDEX_MASK)
+
 #define HANDLE_CACHE_ITERATE(index)     do { index = m_handle_cache[index].index_next; } while (0)
 #define HANDLE_CACHE_ITERATE_BACK(index)     do { index = m_handle_cache[index].index_prev; } while (0)
 
+#ifdef RBC_MESH_STATIC_HANDLES
+#define STATIC_HANDLE_CASE(handle, max_length)      case (handle): return (uint16_t) (__COUNTER__ - STATIC_HANDLE_INDEX_BASE);
+#define STATIC_HANDLE_MAX_LENGTH(handle, max_length) (max_length),
+#endif
+
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+#define VALUE_LENGTH_NONE               (0xFF)
+#define DATA_ENTRY_HAS_VALUE(p_entry)   ((p_entry)->value_length != VALUE_LENGTH_NONE)
+#else
+#define DATA_ENTRY_HAS_VALUE(p_entry)   ((p_entry)->p_packet != NULL)
+#endif
+
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+#define DATA_QUEUE_PROBATION            (0) /**< Entries that have only had a single version since they were taken. */
+#define DATA_QUEUE_MAIN                 (1) /**< Entries that have been updated again, or were evicted before. */
+#define DATA_QUEUE_COUNT                (2)
+#define DATA_ENTRY_QUEUE(p_entry)       ((p_entry)->queue)
+#else
+#define DATA_QUEUE_COUNT                (1)
+#define DATA_ENTRY_QUEUE(p_entry)       ((void) (p_entry), 0)
+#endif
+
 /*****************************************************************************
 * Local Typedefs
 *****************************************************************************/
@@ -63,25 +120,137 @@ typedef struct
     uint16_t                index_prev : 15;    /** linked list index prev */
     uint16_t                persistent : 1;     /** Persistent flag */
     uint16_t                data_entry;         /** index of the associated data entry */
+    uint8_t                 trickle_class;      /** Trickle parameter class */
+    uint8_t                 urgent     : 1;     /** Urgent flag, new versions are burst before Trickle takes over */
+    uint8_t                 evicted    : 1;     /** The handle's data entry has been evicted since the entry was taken */
+    uint8_t                 fingerprinted : 1;  /** The fingerprint holds the payload of the current version, whose data entry was evicted */
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+    uint16_t                fingerprint;        /** payload fingerprint of the evicted version */
+#endif
+#ifdef RBC_MESH_VALUE_TTL
+    uint16_t                ttl;                /** time-to-live in ticks, or 0 if the value doesn't expire */
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+    uint16_t                combine_window_ms;  /** write-combining window, or 0 if local updates aren't combined */
+#endif
+#ifdef RBC_MESH_HOP_SCOPES
+    uint8_t                 hop_scope;          /** hops left in new local versions */
+#endif
 } handle_entry_t;
 
 typedef struct
 {
-    trickle_t trickle;
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    uint16_t value_ref;                         /** reference to the value payload in the value store */
+    uint8_t value_length;                       /** value payload length, or VALUE_LENGTH_NONE if there's no value */
+#else
     mesh_packet_t* p_packet;
+#endif
+    trickle_t trickle;                          /** packed, placed after the pointer to avoid padding */
+    uint16_t heap_index;                        /** position in the TX heap, or TX_HEAP_INDEX_INVALID */
+    uint16_t handle_entry;                      /** index of the owning handle entry, or HANDLE_CACHE_ENTRY_INVALID if free */
+    uint16_t lru_prev;                          /** next more recently updated evictable entry */
+    uint16_t lru_next;                          /** next less recently updated evictable entry, or next free entry */
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+    uint8_t use_count;                          /** number of version updates, halved every aging period */
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_TTL)
+    uint32_t updated;                           /** timestamp of the last version update */
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+    uint8_t queue;                              /** DATA_QUEUE_PROBATION or DATA_QUEUE_MAIN */
+#endif
+    uint8_t burst;                              /** remaining urgent burst transmissions of the current version */
+#ifdef RBC_MESH_HOP_SCOPES
+    uint8_t hops_left;                          /** hops left in the current version, it isn't relayed at 0 */
+#endif
+#if defined(RBC_MESH_ORIGIN_TIME) && defined(RBC_MESH_COMPACT_VALUE_STORE)
+    uint16_t origin_time;                       /** origin time of the current version, the value store only keeps the payload */
+#endif
+#ifdef RBC_MESH_VALUE_TTL
+    uint16_t ttl_left;                          /** ticks left until the current version expires */
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+    uint32_t combine_start;                     /** time of the last transmitted local version */
+    uint8_t combine_open : 1;                   /** combine_start is valid */
+    uint8_t combine_held : 1;                   /** the current local version is held back until the window has passed */
+#endif
+#ifdef RBC_MESH_HANDLE_STATS
+    uint16_t tx_count;                          /** number of transmissions */
+    uint16_t rx_consistent_count;               /** number of received copies of the current version */
+    uint16_t rx_inconsistent_count;             /** number of received older or conflicting versions */
+#endif
 } data_entry_t;
 
+/** List of evictable data entries. */
+typedef struct
+{
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+} data_list_t;
+
 /******************************************************************************
 * Static globals
 ******************************************************************************/
-static handle_entry_t   m_handle_cache[RBC_MESH_HANDLE_CACHE_ENTRIES];
-static data_entry_t     m_data_cache[RBC_MESH_DATA_CACHE_ENTRIES];
+static handle_entry_t*  m_handle_cache;
+static data_entry_t*    m_data_cache;
 static uint32_t         m_handle_cache_head;
 static uint32_t         m_handle_cache_tail;
+static uint16_t*        m_handle_index; /**< Open addressing handle->handle cache index lookup table. */
+static uint16_t*        m_tx_heap; /**< Min-heap of data entry indexes, ordered by trickle timeout. */
+static uint16_t*        m_tx_popped; /**< Scratch list of the entries taken out of the TX heap in a TX round. */
+static uint16_t         m_tx_heap_count;
+static uint16_t         m_data_entries_free; /**< Number of data entries without an owning handle entry. */
+static uint16_t         m_data_free_head; /**< First data entry in the free list. */
+static data_list_t      m_data_lru[DATA_QUEUE_COUNT]; /**< Data entries of non-persistent handles, most recently updated first. */
+static uint16_t         m_data_pinned_count; /**< Number of data entries owned by persistent handles. */
+static uint16_t         m_data_pinned_reserved; /**< Number of data entries only persistent handles may take. */
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+static uint16_t         m_lfu_touches; /**< Number of value updates since the use counts were last aged. */
+#endif
+static uint16_t         m_handle_cache_size;
+static uint16_t         m_data_cache_size;
+static uint16_t         m_handle_index_mask;
+static rbc_mesh_handle_range_t m_class_ranges[RBC_MESH_INSTANCES_MAX]; /**< Handle ranges with their own default Trickle class. */
+static uint8_t          m_class_range_classes[RBC_MESH_INSTANCES_MAX];
+static uint8_t          m_class_range_count;
+
+#ifndef RBC_MESH_EXTERNAL_MEMORY
+static handle_entry_t   m_handle_cache_default[RBC_MESH_HANDLE_CACHE_ENTRIES];
+static data_entry_t     m_data_cache_default[RBC_MESH_DATA_CACHE_ENTRIES];
+#ifndef RBC_MESH_STATIC_HANDLES
+static uint16_t         m_handle_index_default[RBC_MESH_HANDLE_INDEX_SIZE];
+#endif
+static uint16_t         m_tx_heap_default[RBC_MESH_DATA_CACHE_ENTRIES];
+static uint16_t         m_tx_popped_default[RBC_MESH_DATA_CACHE_ENTRIES];
+#endif
+#ifdef RBC_MESH_STATIC_HANDLES
+static const uint8_t    m_static_max_lengths[] = { RBC_MESH_STATIC_HANDLE_LIST(STATIC_HANDLE_MAX_LENGTH) }; /**< Longest accepted value for each static handle. */
+#endif
 
 /*****************************************************************************
 * Static Functions
 *****************************************************************************/
+/** Number of handle index slots for the given handle cache size: the
+  smallest power of two that's at least twice the number of entries. */
+static uint32_t handle_index_size_get(uint32_t handle_cache_entries)
+{
+    uint32_t size = 1;
+    while (size < 2 * handle_cache_entries)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+/** Number of value store pages for the given data cache size. */
+static uint16_t value_store_page_count(uint32_t data_cache_entries)
+{
+    uint32_t page_count = VALUE_STORE_PAGE_COUNT(data_cache_entries);
+    return (page_count > VALUE_STORE_PAGES_MAX) ? VALUE_STORE_PAGES_MAX : page_count;
+}
+#endif
+
 static void version_increment(uint16_t* version)
 {
     if (*version == UINT16_MAX)
@@ -94,340 +263,2107 @@ static void version_increment(uint16_t* version)
     }
 }
 
-static void data_entry_free(data_entry_t* p_data_entry)
+static void tx_heap_swap(uint32_t pos_a, uint32_t pos_b)
 {
-    if (p_data_entry == NULL)
-        return;
+    uint16_t temp = m_tx_heap[pos_a];
+    m_tx_heap[pos_a] = m_tx_heap[pos_b];
+    m_tx_heap[pos_b] = temp;
+    m_data_cache[m_tx_heap[pos_a]].heap_index = pos_a;
+    m_data_cache[m_tx_heap[pos_b]].heap_index = pos_b;
+}
 
-    if (p_data_entry->p_packet != NULL)
+static void tx_heap_sift_up(uint32_t pos)
+{
+    while (pos > 0 && TX_HEAP_EARLIER(pos, TX_HEAP_PARENT(pos)))
     {
-        mesh_packet_ref_count_dec(p_data_entry->p_packet); /* data cache ref remove */
-        p_data_entry->p_packet = NULL;
+        tx_heap_swap(pos, TX_HEAP_PARENT(pos));
+        pos = TX_HEAP_PARENT(pos);
     }
-    /* reset trickle params */
-    trickle_enable(&p_data_entry->trickle);
 }
 
-/** Allocate a new data entry. Will take the least recently updated entry if all are allocated.
-  Returns the index of the resulting entry. */
-static uint16_t data_entry_allocate(void)
+static void tx_heap_sift_down(uint32_t pos)
 {
-    static uint16_t allocated = 0;
-    TICK_PIN(7);
-
-    for (uint32_t i = allocated; i < RBC_MESH_DATA_CACHE_ENTRIES; ++i)
+    while (TX_HEAP_CHILD_LEFT(pos) < m_tx_heap_count)
     {
-        if (m_data_cache[i].p_packet == NULL)
+        uint32_t child = TX_HEAP_CHILD_LEFT(pos);
+        if (child + 1 < m_tx_heap_count &&
+            TX_HEAP_EARLIER(child + 1, child))
         {
-            trickle_timer_reset(&m_data_cache[i].trickle, 0);
-            allocated++;
-            return i;
+            child++;
         }
-    }
-
-    /* no unused entries, take the least recently updated (and disregard persistent handles) */
-    uint32_t handle_index = m_handle_cache_tail;
-    while (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID ||
-           m_handle_cache[handle_index].persistent)
-    {
-        HANDLE_CACHE_ITERATE_BACK(handle_index);
-
-        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+        if (!TX_HEAP_EARLIER(child, pos))
         {
-            return DATA_CACHE_ENTRY_INVALID;
+            break;
         }
+        tx_heap_swap(pos, child);
+        pos = child;
     }
-
-    uint32_t data_index = m_handle_cache[handle_index].data_entry;
-    APP_ERROR_CHECK_BOOL(data_index < RBC_MESH_DATA_CACHE_ENTRIES);
-
-    /* cleanup */
-    m_handle_cache[handle_index].data_entry = DATA_CACHE_ENTRY_INVALID;
-
-    data_entry_free(&m_data_cache[data_index]);
-    trickle_timer_reset(&m_data_cache[data_index].trickle, 0);
-    return data_index;
 }
 
-/** Get the index of the handle entry representing the given handle.
-  Returns HANDLE_CACHE_ENTRY_INVALID if not found */
-static uint16_t handle_entry_get(rbc_mesh_value_handle_t handle, bool shortcut)
+static void tx_heap_remove(uint16_t data_index)
 {
-    static uint16_t prev_index = HANDLE_CACHE_ENTRY_INVALID;
-    static uint16_t prev_handle = RBC_MESH_INVALID_HANDLE;
-
-    event_handler_critical_section_begin();
+    uint32_t pos = m_data_cache[data_index].heap_index;
+    m_data_cache[data_index].heap_index = TX_HEAP_INDEX_INVALID;
 
-    if (shortcut)
+    if (pos != --m_tx_heap_count)
     {
-        /* shortcut when accessing the same element in succession. */
-        if (prev_handle == handle &&
-            prev_index < RBC_MESH_HANDLE_CACHE_ENTRIES &&
-            m_handle_cache[prev_index].handle == handle)
-        {
-            event_handler_critical_section_end();
-            return prev_index;
-        }
+        /* fill the hole with the last element, and restore the heap property */
+        uint16_t moved_index = m_tx_heap[m_tx_heap_count];
+        m_tx_heap[pos] = moved_index;
+        m_data_cache[moved_index].heap_index = pos;
+        tx_heap_sift_up(pos);
+        tx_heap_sift_down(m_data_cache[moved_index].heap_index);
     }
+}
 
-    uint16_t i = m_handle_cache_head;
-
-    while (m_handle_cache[i].handle != handle)
+/** Update the given data entry's position in the TX heap. Must be called
+  whenever the entry's trickle timeout, enabled state or packet changes. Only
+  enabled entries with a packet, that are within their hop scope, are kept in
+  the heap. */
+static void data_entry_tx_heap_update(uint16_t data_index)
+{
+    data_entry_t* p_data_entry = &m_data_cache[data_index];
+    bool schedulable = (DATA_ENTRY_HAS_VALUE(p_data_entry) &&
+                        trickle_is_enabled(&p_data_entry->trickle));
+#ifdef RBC_MESH_HOP_SCOPES
+    /* out of scope versions are kept, but never transmitted */
+    schedulable = schedulable && (p_data_entry->hops_left != 0);
+#endif
+
+    if (p_data_entry->heap_index == TX_HEAP_INDEX_INVALID)
     {
-        if (m_handle_cache_tail == i)
+        if (schedulable)
         {
-            event_handler_critical_section_end();
-            return HANDLE_CACHE_ENTRY_INVALID; /* checked all entries */
+            p_data_entry->heap_index = m_tx_heap_count;
+            m_tx_heap[m_tx_heap_count++] = data_index;
+            tx_heap_sift_up(p_data_entry->heap_index);
         }
-        HANDLE_CACHE_ITERATE(i);
     }
+    else if (schedulable)
+    {
+        tx_heap_sift_up(p_data_entry->heap_index);
+        tx_heap_sift_down(p_data_entry->heap_index);
+    }
+    else
+    {
+        tx_heap_remove(data_index);
+    }
+}
 
-    if (shortcut)
+#ifdef RBC_MESH_HANDLE_STATS
+static void stats_count(uint16_t* p_counter)
+{
+    if (*p_counter != 0xFFFF)
     {
-        prev_handle = handle;
-        prev_index = i;
+        (*p_counter)++;
     }
+}
 
-    event_handler_critical_section_end();
-    return i;
+static void data_entry_stats_clear(data_entry_t* p_data_entry)
+{
+    p_data_entry->tx_count = 0;
+    p_data_entry->rx_consistent_count = 0;
+    p_data_entry->rx_inconsistent_count = 0;
+    p_data_entry->trickle.reset_count = 0;
 }
+#endif
 
-/** Moves the given handle to the head of the handle cache.
-  If it doesn't exist, it allocates the tail, and moves it to head.
-  Returns the index in the cache, or HANDLE_CACHE_ENTRY_INVALID if the cache
-  is full of persistent handles */
-static uint16_t handle_entry_to_head(rbc_mesh_value_handle_t handle)
+static void data_entry_value_clear(data_entry_t* p_data_entry)
 {
-    uint16_t i = handle_entry_get(handle, true);
-    if (i == HANDLE_CACHE_ENTRY_INVALID)
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    if (DATA_ENTRY_HAS_VALUE(p_data_entry))
     {
-        i = m_handle_cache_tail;
-        while (m_handle_cache[i].persistent)
-        {
-            HANDLE_CACHE_ITERATE_BACK(i);
-            if (i == HANDLE_CACHE_ENTRY_INVALID)
-            {
-                return i; /* reached the head without hitting a non-persistent handle */
-            }
-        }
-        /* clean up old data */
-        m_handle_cache[i].handle = handle;
-        m_handle_cache[i].tx_event = 0;
-        m_handle_cache[i].version = 0;
-        if (m_handle_cache[i].data_entry != DATA_CACHE_ENTRY_INVALID)
-        {
-            data_entry_free(&m_data_cache[m_handle_cache[i].data_entry]);
-            m_handle_cache[i].data_entry = DATA_CACHE_ENTRY_INVALID;
-        }
+        value_store_free(p_data_entry->value_ref);
+        p_data_entry->value_ref = VALUE_STORE_REF_NONE;
+        p_data_entry->value_length = VALUE_LENGTH_NONE;
     }
-    /* detach and move to head */
-    if (i != m_handle_cache_tail)
+#else
+    if (p_data_entry->p_packet != NULL)
     {
-        if (i != m_handle_cache_head)
-        {
-            m_handle_cache[m_handle_cache[i].index_next].index_prev = m_handle_cache[i].index_prev;
-        }
+        mesh_packet_ref_count_dec(p_data_entry->p_packet); /* data cache ref remove */
+        p_data_entry->p_packet = NULL;
     }
-    else
+#endif
+}
+
+static void data_entry_free(data_entry_t* p_data_entry)
+{
+    if (p_data_entry == NULL)
+        return;
+
+    data_entry_value_clear(p_data_entry);
+    /* reset trickle params */
+    trickle_enable(&p_data_entry->trickle);
+    data_entry_tx_heap_update(p_data_entry - &m_data_cache[0]);
+}
+
+#ifdef RBC_MESH_STATIC_HANDLES
+enum { STATIC_HANDLE_INDEX_BASE = __COUNTER__ + 1 };
+
+/** Get the fixed handle cache index of the given handle in the static handle
+  list. The compiler turns the switch into a jump table or a binary search.
+  Returns HANDLE_CACHE_ENTRY_INVALID if the handle isn't in the list. */
+static uint16_t static_index_get(rbc_mesh_value_handle_t handle)
+{
+    switch (handle)
     {
-        m_handle_cache_tail = m_handle_cache[i].index_prev;
-        m_handle_cache[i].index_next = HANDLE_CACHE_ENTRY_INVALID;
+        RBC_MESH_STATIC_HANDLE_LIST(STATIC_HANDLE_CASE)
+        default:
+            return HANDLE_CACHE_ENTRY_INVALID;
     }
+}
 
-    if (i != m_handle_cache_head)
+/** Get the index of the handle entry representing the given handle. The
+  entries of static handles only represent them once they've been taken into
+  use. Returns HANDLE_CACHE_ENTRY_INVALID if not found. */
+static uint16_t handle_index_find(rbc_mesh_value_handle_t handle)
+{
+    uint16_t i = static_index_get(handle);
+    if (i != HANDLE_CACHE_ENTRY_INVALID && m_handle_cache[i].handle != handle)
     {
-        if (m_handle_cache[i].index_prev != HANDLE_CACHE_ENTRY_INVALID)
-        {
-            m_handle_cache[m_handle_cache[i].index_prev].index_next = m_handle_cache[i].index_next;
-        }
-
-        m_handle_cache[i].index_prev = HANDLE_CACHE_ENTRY_INVALID;
-        m_handle_cache[i].index_next = m_handle_cache_head;
-        m_handle_cache[m_handle_cache_head].index_prev = i;
-        m_handle_cache_head = i;
+        return HANDLE_CACHE_ENTRY_INVALID;
     }
+    return i;
+}
 
-    m_handle_cache[m_handle_cache_head].index_prev = HANDLE_CACHE_ENTRY_INVALID;
-    m_handle_cache[m_handle_cache_tail].index_next = HANDLE_CACHE_ENTRY_INVALID;
+/** Static handles never lose their data entries. */
+static uint16_t data_entry_evict(uint16_t keep_data_index)
+{
+    return DATA_CACHE_ENTRY_INVALID;
+}
 
-    return i;
+/** Static handles get their data entries at init, so this only
+  returns the bound entry. */
+static uint16_t data_entry_allocate(uint16_t handle_index)
+{
+    return m_handle_cache[handle_index].data_entry;
 }
 
-void local_packet_push(void* p_context)
+static void data_entry_pin_set(uint16_t handle_index, bool pinned)
 {
-    mesh_packet_t* p_packet = (mesh_packet_t*) p_context;
-    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_packet);
-    if (p_adv != NULL)
+}
+
+static void data_entry_touch(uint16_t data_index)
+{
+}
+#else
+/** Get the index of the handle entry representing the given handle by looking
+  it up in the handle index. Returns HANDLE_CACHE_ENTRY_INVALID if not found. */
+static uint16_t handle_index_find(rbc_mesh_value_handle_t handle)
+{
+    uint32_t slot = HANDLE_INDEX_SLOT(handle);
+    while (m_handle_index[slot] != HANDLE_CACHE_ENTRY_INVALID)
     {
-        handle_info_t info =
-        {
-            .version = p_adv->version,
-            .p_packet = p_packet
-        };
-        uint16_t handle_index = handle_entry_get(p_adv->handle, true);
-        if (handle_index != HANDLE_CACHE_ENTRY_INVALID)
+        if (m_handle_cache[m_handle_index[slot]].handle == handle)
         {
-            info.version = m_handle_cache[handle_index].version;
-            version_increment(&info.version);
+            return m_handle_index[slot];
         }
-        p_adv->version = info.version;
-
-        handle_storage_info_set(p_adv->handle, &info);
+        slot = HANDLE_INDEX_NEXT(slot);
     }
-    mesh_packet_ref_count_dec(p_packet); /* for the event queue */
+    return HANDLE_CACHE_ENTRY_INVALID;
 }
 
-/*****************************************************************************
-* Interface Functions
-*****************************************************************************/
-uint32_t handle_storage_init(uint32_t min_interval_us)
+/** Add the handle of the given handle cache entry to the handle index. The
+  index always has at least one empty slot, so the probing will terminate. */
+static void handle_index_insert(uint16_t cache_index)
 {
-    event_handler_critical_section_begin();
-    uint32_t error_code = handle_storage_min_interval_set(min_interval_us);
-    if (error_code != NRF_SUCCESS)
+    uint32_t slot = HANDLE_INDEX_SLOT(m_handle_cache[cache_index].handle);
+    while (m_handle_index[slot] != HANDLE_CACHE_ENTRY_INVALID)
     {
-        event_handler_critical_section_end();
-        return error_code;
+        slot = HANDLE_INDEX_NEXT(slot);
     }
+    m_handle_index[slot] = cache_index;
+}
 
-    for (uint32_t i = 0; i < RBC_MESH_DATA_CACHE_ENTRIES; ++i)
+/** Remove the given handle from the handle index. Shifts the succeeding
+  entries in the probe sequence back to fill the hole, so the index never has
+  to deal with tombstones. */
+static void handle_index_remove(rbc_mesh_value_handle_t handle)
+{
+    uint32_t hole = HANDLE_INDEX_SLOT(handle);
+    while (m_handle_index[hole] != HANDLE_CACHE_ENTRY_INVALID &&
+           m_handle_cache[m_handle_index[hole]].handle != handle)
     {
-        m_data_cache[i].p_packet = NULL;
+        hole = HANDLE_INDEX_NEXT(hole);
     }
-
-    for (uint32_t i = 0; i < RBC_MESH_HANDLE_CACHE_ENTRIES; ++i)
+    if (m_handle_index[hole] == HANDLE_CACHE_ENTRY_INVALID)
     {
-        m_handle_cache[i].handle = RBC_MESH_INVALID_HANDLE;
-        m_handle_cache[i].version = 0;
-        m_handle_cache[i].persistent = 0;
-        m_handle_cache[i].tx_event = 0;
-        m_handle_cache[i].data_entry = DATA_CACHE_ENTRY_INVALID;
-        m_handle_cache[i].index_prev = i - 1;
-        m_handle_cache[i].index_next = i + 1;
+        return; /* not in the index */
     }
 
-    m_handle_cache_head = 0;
-    m_handle_cache_tail = RBC_MESH_HANDLE_CACHE_ENTRIES - 1;
-    m_handle_cache[m_handle_cache_head].index_prev = HANDLE_CACHE_ENTRY_INVALID;
-    m_handle_cache[m_handle_cache_tail].index_next = HANDLE_CACHE_ENTRY_INVALID;
-
-    event_handler_critical_section_end();
-    return NRF_SUCCESS;
-}
-
-uint32_t handle_storage_min_interval_set(uint32_t min_interval_us)
-{
-    if (min_interval_us < RBC_MESH_INTERVAL_MIN_MIN_MS * 1000 ||
-        min_interval_us > RBC_MESH_INTERVAL_MIN_MAX_MS * 1000)
+    for (uint32_t slot = HANDLE_INDEX_NEXT(hole);
+         m_handle_index[slot] != HANDLE_CACHE_ENTRY_INVALID;
+         slot = HANDLE_INDEX_NEXT(slot))
     {
-        return NRF_ERROR_INVALID_PARAM;
+        uint32_t home = HANDLE_INDEX_SLOT(m_handle_cache[m_handle_index[slot]].handle);
+        /* Only move the entry if its home slot isn't between the hole and the
+           entry's current slot (cyclically). */
+        if (((slot - home) & HANDLE_INDEX_MASK) >= ((slot - hole) & HANDLE_INDEX_MASK))
+        {
+            m_handle_index[hole] = m_handle_index[slot];
+            hole = slot;
+        }
     }
-    trickle_setup(min_interval_us, MESH_TRICKLE_I_MAX, MESH_TRICKLE_K);
-
-    return NRF_SUCCESS;
+    m_handle_index[hole] = HANDLE_CACHE_ENTRY_INVALID;
 }
 
-uint32_t handle_storage_info_get(uint16_t handle, handle_info_t* p_info)
+/** Take the given data entry out of the given evictable list. */
+static void data_list_remove(data_list_t* p_list, uint16_t data_index)
 {
-    if (p_info == NULL)
+    data_entry_t* p_entry = &m_data_cache[data_index];
+    if (p_entry->lru_prev == DATA_CACHE_ENTRY_INVALID)
     {
-        return NRF_ERROR_NULL;
+        p_list->head = p_entry->lru_next;
     }
-    memset(p_info, 0, sizeof(handle_info_t));
-    if (handle == RBC_MESH_INVALID_HANDLE)
+    else
     {
-        return NRF_ERROR_INVALID_ADDR;
+        m_data_cache[p_entry->lru_prev].lru_next = p_entry->lru_next;
     }
-    event_handler_critical_section_begin();
-
-    uint16_t handle_index = handle_entry_get(handle, false);
-    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    if (p_entry->lru_next == DATA_CACHE_ENTRY_INVALID)
     {
-        event_handler_critical_section_end();
-        return NRF_ERROR_NOT_FOUND;
+        p_list->tail = p_entry->lru_prev;
     }
-
-    p_info->version = m_handle_cache[handle_index].version;
-    if (m_handle_cache[handle_index].data_entry != DATA_CACHE_ENTRY_INVALID)
+    else
     {
-        if (mesh_packet_ref_count_inc(m_data_cache[m_handle_cache[handle_index].data_entry].p_packet))
-        {
-            p_info->p_packet = m_data_cache[m_handle_cache[handle_index].data_entry].p_packet;
-        }
+        m_data_cache[p_entry->lru_next].lru_prev = p_entry->lru_prev;
     }
-
-    event_handler_critical_section_end();
-    return NRF_SUCCESS;
+    p_list->count--;
 }
 
-uint32_t handle_storage_info_set(uint16_t handle, handle_info_t* p_info)
+/** Put the given data entry at the head of the given evictable list. */
+static void data_list_push(data_list_t* p_list, uint16_t data_index)
 {
-    if (p_info == NULL)
+    data_entry_t* p_entry = &m_data_cache[data_index];
+    p_entry->lru_prev = DATA_CACHE_ENTRY_INVALID;
+    p_entry->lru_next = p_list->head;
+    if (p_list->head == DATA_CACHE_ENTRY_INVALID)
     {
-        return NRF_ERROR_NULL;
+        p_list->tail = data_index;
     }
-    if (handle == RBC_MESH_INVALID_HANDLE)
+    else
     {
-        return NRF_ERROR_INVALID_ADDR;
+        m_data_cache[p_list->head].lru_prev = data_index;
     }
+    p_list->head = data_index;
+    p_list->count++;
+}
 
-    uint16_t handle_index = handle_entry_get(handle, true);
-    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-    {
-        /* couldn't find an existing entry, allocate one */
-        handle_index = handle_entry_to_head(handle);
-        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-        {
-            return NRF_ERROR_NO_MEM;
-        }
-    }
+/*
+   Eviction policy. The data entries of non-persistent handles are kept in
+   least recently updated order, in a single list, or in a probation list and
+   a main list with the 2Q policy. The policy decides where new and updated
+   entries go, and which entry to evict.
+*/
 
-    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+/** Start tracking the data entry of a non-persistent handle. The seen_before
+  flag tells whether the handle has been in the data cache before. */
+static void eviction_insert(uint16_t data_index, bool seen_before)
+{
+    data_entry_t* p_entry = &m_data_cache[data_index];
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+    p_entry->use_count = 1;
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_TTL)
+    p_entry->updated = timer_now();
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+    /* handles that come back after an eviction skip the probation */
+    p_entry->queue = (seen_before ? DATA_QUEUE_MAIN : DATA_QUEUE_PROBATION);
+#endif
+    data_list_push(&m_data_lru[DATA_ENTRY_QUEUE(p_entry)], data_index);
+}
 
-    if (data_index == DATA_CACHE_ENTRY_INVALID)
+/** Stop tracking the given data entry. */
+static void eviction_remove(uint16_t data_index)
+{
+    data_list_remove(&m_data_lru[DATA_ENTRY_QUEUE(&m_data_cache[data_index])], data_index);
+}
+
+/** Register a new version of the value in the given data entry. */
+static void eviction_touch(uint16_t data_index)
+{
+    data_entry_t* p_entry = &m_data_cache[data_index];
+    data_list_remove(&m_data_lru[DATA_ENTRY_QUEUE(p_entry)], data_index);
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+    if (p_entry->use_count < UINT8_MAX)
     {
-        data_index = data_entry_allocate();
-        if (data_index == DATA_CACHE_ENTRY_INVALID)
+        p_entry->use_count++;
+    }
+    if (++m_lfu_touches >= RBC_MESH_EVICTION_LFU_AGING_PERIOD)
+    {
+        /* age the counts, so handles that used to be busy eventually give way */
+        m_lfu_touches = 0;
+        for (uint32_t i = 0; i < m_data_cache_size; ++i)
         {
-            return NRF_ERROR_NO_MEM;
+            m_data_cache[i].use_count >>= 1;
         }
-        m_handle_cache[handle_index].data_entry = data_index;
     }
-    trickle_timer_reset(&m_data_cache[data_index].trickle, timer_now());
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_TTL)
+    p_entry->updated = timer_now();
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+    p_entry->queue = DATA_QUEUE_MAIN;
+#endif
+    data_list_push(&m_data_lru[DATA_ENTRY_QUEUE(p_entry)], data_index);
+}
 
-    m_handle_cache[handle_index].version = p_info->version;
-    if (m_data_cache[data_index].p_packet != NULL)
+/** Get the least recently updated entry in the given list, other than the
+  given entry. */
+static uint16_t eviction_tail_get(const data_list_t* p_list, uint16_t keep_data_index)
+{
+    uint16_t data_index = p_list->tail;
+    if (data_index != DATA_CACHE_ENTRY_INVALID && data_index == keep_data_index)
     {
-        mesh_packet_ref_count_dec(m_data_cache[data_index].p_packet);
+        data_index = m_data_cache[data_index].lru_prev;
     }
-
-    /* reference for the cache */
-    mesh_packet_ref_count_inc(p_info->p_packet);
-    m_data_cache[m_handle_cache[handle_index].data_entry].p_packet = p_info->p_packet;
-    return NRF_SUCCESS;
+    return data_index;
 }
 
+/** Pick the data entry to evict, other than the given entry. Returns
+  DATA_CACHE_ENTRY_INVALID if the policy won't evict anything. */
+static uint16_t eviction_victim_get(uint16_t keep_data_index)
+{
+#if (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_LFU)
+    /* least used entry, the least recently updated of them on a tie */
+    uint16_t victim = DATA_CACHE_ENTRY_INVALID;
+    for (uint16_t i = m_data_lru[0].tail; i != DATA_CACHE_ENTRY_INVALID; i = m_data_cache[i].lru_prev)
+    {
+        if (i != keep_data_index &&
+            (victim == DATA_CACHE_ENTRY_INVALID || m_data_cache[i].use_count < m_data_cache[victim].use_count))
+        {
+            victim = i;
+        }
+    }
+    return victim;
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_TTL)
+    /* values are always kept for the TTL after their last update */
+    uint16_t victim = eviction_tail_get(&m_data_lru[0], keep_data_index);
+    if (victim != DATA_CACHE_ENTRY_INVALID &&
+        (uint32_t) (timer_now() - m_data_cache[victim].updated) < RBC_MESH_EVICTION_TTL_US)
+    {
+        return DATA_CACHE_ENTRY_INVALID;
+    }
+    return victim;
+#elif (RBC_MESH_EVICTION_POLICY == RBC_MESH_EVICTION_2Q)
+    /* take from the probation list while it's over its share, so a burst of
+       one-off handles only pushes out other one-off handles */
+    uint32_t evictable = m_data_cache_size - m_data_pinned_reserved;
+    uint32_t probation_max = (evictable * RBC_MESH_EVICTION_2Q_PROBATION_PERCENT) / 100;
+    uint16_t victim = DATA_CACHE_ENTRY_INVALID;
+    if (m_data_lru[DATA_QUEUE_PROBATION].count > probation_max ||
+        m_data_lru[DATA_QUEUE_MAIN].count == 0)
+    {
+        victim = eviction_tail_get(&m_data_lru[DATA_QUEUE_PROBATION], keep_data_index);
+    }
+    if (victim == DATA_CACHE_ENTRY_INVALID)
+    {
+        victim = eviction_tail_get(&m_data_lru[DATA_QUEUE_MAIN], keep_data_index);
+    }
+    if (victim == DATA_CACHE_ENTRY_INVALID)
+    {
+        victim = eviction_tail_get(&m_data_lru[DATA_QUEUE_PROBATION], keep_data_index);
+    }
+    return victim;
+#else
+    return eviction_tail_get(&m_data_lru[0], keep_data_index);
+#endif
+}
+
+/** Move the data entry of a handle in or out of the pinned partition when
+  its persistent flag changes. Only data entries of non-persistent handles
+  are handled by the eviction policy. */
+static void data_entry_pin_set(uint16_t handle_index, bool pinned)
+{
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index == DATA_CACHE_ENTRY_INVALID ||
+        (bool) m_handle_cache[handle_index].persistent == pinned)
+    {
+        return;
+    }
+    if (pinned)
+    {
+        eviction_remove(data_index);
+        m_data_pinned_count++;
+    }
+    else
+    {
+        m_data_pinned_count--;
+        eviction_insert(data_index, true);
+    }
+}
+
+/** Register a new version in the given data entry. */
+static void data_entry_touch(uint16_t data_index)
+{
+    if (!m_handle_cache[m_data_cache[data_index].handle_entry].persistent)
+    {
+        eviction_touch(data_index);
+    }
+}
+
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+static uint16_t payload_fingerprint(const uint8_t* p_data, uint8_t length)
+{
+    /* FNV-1a, folded to 16 bits */
+    uint32_t hash = 2166136261UL ^ length;
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        hash ^= p_data[i];
+        hash *= 16777619UL;
+    }
+    return (uint16_t) (hash ^ (hash >> 16));
+}
+
+/** Get the fingerprint of the payload of the given data entry. Returns
+  false if the entry has no value. */
+static bool data_entry_fingerprint_get(uint16_t data_index, uint16_t* p_fingerprint)
+{
+    const data_entry_t* p_data_entry = &m_data_cache[data_index];
+    if (!DATA_ENTRY_HAS_VALUE(p_data_entry))
+    {
+        return false;
+    }
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    *p_fingerprint = payload_fingerprint(value_store_data_get(p_data_entry->value_ref), p_data_entry->value_length);
+#else
+    const mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_data_entry->p_packet);
+    if (p_adv == NULL)
+    {
+        return false;
+    }
+    *p_fingerprint = payload_fingerprint(p_adv->data, p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+#endif
+    return true;
+}
+#endif
+
+/** Detach the data entry of the given handle entry, and free it. */
+static void data_entry_release(uint16_t handle_index)
+{
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    APP_ERROR_CHECK_BOOL(data_index < m_data_cache_size);
+
+    if (m_handle_cache[handle_index].persistent)
+    {
+        m_data_pinned_count--;
+    }
+    else
+    {
+        eviction_remove(data_index);
+    }
+#ifdef RBC_MESH_VALUE_SHADOW
+    mesh_shadow_invalidate(m_handle_cache[handle_index].handle);
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+    value_retain_remove(m_handle_cache[handle_index].handle);
+#endif
+    m_handle_cache[handle_index].data_entry = DATA_CACHE_ENTRY_INVALID;
+    m_handle_cache[handle_index].fingerprinted = 0;
+    m_data_cache[data_index].handle_entry = HANDLE_CACHE_ENTRY_INVALID;
+    data_entry_free(&m_data_cache[data_index]);
+    m_data_cache[data_index].lru_next = m_data_free_head;
+    m_data_free_head = data_index;
+    m_data_entries_free++;
+}
+
+/** Free the data entry of a non-persistent handle picked by the eviction
+  policy, other than the given data entry. Returns the index of the freed
+  entry, or DATA_CACHE_ENTRY_INVALID if there's nothing to free. */
+static uint16_t data_entry_evict(uint16_t keep_data_index)
+{
+    uint16_t data_index = eviction_victim_get(keep_data_index);
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        return DATA_CACHE_ENTRY_INVALID;
+    }
+
+    uint16_t handle_index = m_data_cache[data_index].handle_entry;
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+    uint16_t fingerprint;
+    bool fingerprinted = data_entry_fingerprint_get(data_index, &fingerprint);
+#endif
+    data_entry_release(handle_index);
+    m_handle_cache[handle_index].evicted = 1;
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+    m_handle_cache[handle_index].fingerprinted = fingerprinted;
+    m_handle_cache[handle_index].fingerprint = fingerprint;
+#endif
+    return data_index;
+}
+
+/** Allocate a new data entry for the given handle entry. Will evict the
+  data entry of a non-persistent handle if there are no free entries the
+  handle may use. The entries reserved for the pinned partition are only
+  given to persistent handles. Returns the index of the resulting entry. */
+static uint16_t data_entry_allocate(uint16_t handle_index)
+{
+    TICK_PIN(7);
+    TRACE_MARK(MESH_TRACE_POINT_DATA_ENTRY_ALLOC, 0);
+
+    bool pinned = m_handle_cache[handle_index].persistent;
+    uint16_t reserved = 0;
+    if (!pinned && m_data_pinned_reserved > m_data_pinned_count)
+    {
+        reserved = m_data_pinned_reserved - m_data_pinned_count;
+    }
+
+    if (m_data_entries_free <= reserved)
+    {
+        /* no unused entries, evict one (and disregard persistent handles).
+           The evicted entry ends up first in the free list. */
+        if (data_entry_evict(DATA_CACHE_ENTRY_INVALID) == DATA_CACHE_ENTRY_INVALID)
+        {
+            return DATA_CACHE_ENTRY_INVALID;
+        }
+    }
+    uint16_t data_index = m_data_free_head;
+    m_data_free_head = m_data_cache[data_index].lru_next;
+
+    trickle_timer_reset(&m_data_cache[data_index].trickle, 0);
+#ifdef RBC_MESH_HANDLE_STATS
+    data_entry_stats_clear(&m_data_cache[data_index]);
+#endif
+    m_data_cache[data_index].burst = 0;
+#ifdef RBC_MESH_WRITE_COMBINING
+    m_data_cache[data_index].combine_open = 0;
+    m_data_cache[data_index].combine_held = 0;
+#endif
+    m_data_cache[data_index].handle_entry = handle_index;
+    m_handle_cache[handle_index].data_entry = data_index;
+    m_data_entries_free--;
+    if (pinned)
+    {
+        m_data_pinned_count++;
+    }
+    else
+    {
+        eviction_insert(data_index, m_handle_cache[handle_index].evicted);
+    }
+    return data_index;
+}
+#endif
+
+#ifdef RBC_MESH_VALUE_SHADOW
+/** Mirror the new value of the given data entry to the shadow table. */
+static void data_entry_shadow_update(const data_entry_t* p_data_entry, mesh_packet_t* p_packet)
+{
+    rbc_mesh_value_handle_t handle = m_handle_cache[p_data_entry->handle_entry].handle;
+    mesh_adv_data_t* p_adv = (p_packet == NULL ? NULL : mesh_packet_adv_data_get(p_packet));
+    if (p_adv == NULL || p_adv->adv_data_length < MESH_PACKET_ADV_OVERHEAD)
+    {
+        mesh_shadow_invalidate(handle);
+    }
+    else
+    {
+        mesh_shadow_write(handle, p_adv->data, p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+    }
+}
+#endif
+
+#ifdef RBC_MESH_RETAINED_RAM
+/** Copy the new value of the given data entry to the retained area. */
+static void data_entry_retain_update(const data_entry_t* p_data_entry, mesh_packet_t* p_packet)
+{
+    const handle_entry_t* p_handle_entry = &m_handle_cache[p_data_entry->handle_entry];
+    mesh_adv_data_t* p_adv = (p_packet == NULL ? NULL : mesh_packet_adv_data_get(p_packet));
+    if (p_adv == NULL || p_adv->adv_data_length < MESH_PACKET_ADV_OVERHEAD)
+    {
+        value_retain_remove(p_handle_entry->handle);
+    }
+    else
+    {
+        value_retain_store(p_handle_entry->handle,
+                p_handle_entry->version,
+                p_adv->data,
+                p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+    }
+}
+#endif
+
+/** Replace the value of the given data entry with the value in the given
+  packet. A NULL packet leaves the entry without a value. */
+static uint32_t data_entry_value_set(uint16_t data_index, mesh_packet_t* p_packet)
+{
+    data_entry_t* p_data_entry = &m_data_cache[data_index];
+    data_entry_value_clear(p_data_entry);
+#ifdef RBC_MESH_HOP_SCOPES
+    mesh_adv_data_t* p_scoped_adv = mesh_packet_adv_data_get(p_packet);
+    p_data_entry->hops_left = (p_scoped_adv == NULL ? RBC_MESH_HOP_SCOPE_UNLIMITED : p_scoped_adv->hops_left);
+#endif
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_packet);
+    if (p_adv == NULL)
+    {
+#ifdef RBC_MESH_VALUE_SHADOW
+        data_entry_shadow_update(p_data_entry, NULL);
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+        data_entry_retain_update(p_data_entry, NULL);
+#endif
+        return NRF_SUCCESS;
+    }
+    if (p_adv->adv_data_length < MESH_PACKET_ADV_OVERHEAD ||
+        p_adv->adv_data_length > MESH_PACKET_ADV_OVERHEAD + RBC_MESH_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    uint8_t length = p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+#ifdef RBC_MESH_ORIGIN_TIME
+    p_data_entry->origin_time = p_adv->origin_time;
+#endif
+    uint16_t ref;
+    while (!value_store_alloc(length, &ref))
+    {
+        /* make room by dropping other values */
+        if (data_entry_evict(data_index) == DATA_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+    if (length > 0)
+    {
+        memcpy(value_store_data_get(ref), p_adv->data, length);
+    }
+    p_data_entry->value_ref = ref;
+    p_data_entry->value_length = length;
+#else
+    if (p_packet != NULL)
+    {
+        mesh_packet_ref_count_inc(p_packet); /* reference for the cache */
+        p_data_entry->p_packet = p_packet;
+    }
+#endif
+#ifdef RBC_MESH_VALUE_SHADOW
+    data_entry_shadow_update(p_data_entry, p_packet);
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+    data_entry_retain_update(p_data_entry, p_packet);
+#endif
+    return NRF_SUCCESS;
+}
+
+/** Get a packet carrying the value of the given data entry, with a reference
+  for the caller. Returns NULL if the entry has no value, or the packet pool is
+  empty. */
+static mesh_packet_t* data_entry_packet_get(uint16_t data_index)
+{
+    data_entry_t* p_data_entry = &m_data_cache[data_index];
+    if (!DATA_ENTRY_HAS_VALUE(p_data_entry))
+    {
+        return NULL;
+    }
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    /* rebuild the advertisement from the handle entry and the stored payload */
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NULL;
+    }
+    handle_entry_t* p_handle_entry = &m_handle_cache[p_data_entry->handle_entry];
+    if (mesh_packet_build(p_packet,
+                p_handle_entry->handle,
+                p_handle_entry->version,
+                value_store_data_get(p_data_entry->value_ref),
+                p_data_entry->value_length) != NRF_SUCCESS)
+    {
+        mesh_packet_ref_count_dec(p_packet);
+        return NULL;
+    }
+#ifdef RBC_MESH_HOP_SCOPES
+    mesh_packet_adv_data_get(p_packet)->hops_left = p_data_entry->hops_left;
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+    mesh_packet_adv_data_get(p_packet)->origin_time = p_data_entry->origin_time;
+#endif
+    return p_packet;
+#else
+    mesh_packet_ref_count_inc(p_data_entry->p_packet);
+    return p_data_entry->p_packet;
+#endif
+}
+
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+/** Log the value of the given handle entry to flash, if it's persistent. */
+static void persistent_value_store(uint16_t handle_index)
+{
+    handle_entry_t* p_handle_entry = &m_handle_cache[handle_index];
+    if (!p_handle_entry->persistent || p_handle_entry->data_entry == DATA_CACHE_ENTRY_INVALID)
+    {
+        return;
+    }
+    mesh_packet_t* p_packet = data_entry_packet_get(p_handle_entry->data_entry);
+    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_packet);
+    if (p_adv != NULL)
+    {
+        value_flash_store(p_handle_entry->handle,
+                p_handle_entry->version,
+                p_adv->data,
+                p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+    }
+    if (p_packet != NULL)
+    {
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+#endif
+
+/** Get the index of the handle entry representing the given handle.
+  Returns HANDLE_CACHE_ENTRY_INVALID if not found */
+static uint16_t handle_entry_get(rbc_mesh_value_handle_t handle, bool shortcut)
+{
+    static uint16_t prev_index = HANDLE_CACHE_ENTRIES_MAX; /* never a valid index */
+    static uint16_t prev_handle = RBC_MESH_INVALID_HANDLE;
+
+    event_handler_critical_section_begin();
+
+    if (shortcut)
+    {
+        /* shortcut when accessing the same element in succession. */
+        if (prev_handle == handle &&
+            prev_index < m_handle_cache_size &&
+            m_handle_cache[prev_index].handle == handle)
+        {
+            event_handler_critical_section_end();
+            return prev_index;
+        }
+    }
+
+    uint16_t i = handle_index_find(handle);
+    if (i == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        event_handler_critical_section_end();
+        return HANDLE_CACHE_ENTRY_INVALID;
+    }
+
+    if (shortcut)
+    {
+        prev_handle = handle;
+        prev_index = i;
+    }
+
+    event_handler_critical_section_end();
+    return i;
+}
+
+/** Get the Trickle class new handle entries start out with. */
+static uint8_t class_default_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_class_range_count; ++i)
+    {
+        if (handle >= m_class_ranges[i].first && handle <= m_class_ranges[i].last)
+        {
+            return m_class_range_classes[i];
+        }
+    }
+    return RBC_MESH_TRICKLE_CLASS_DEFAULT;
+}
+
+#ifdef RBC_MESH_STATIC_HANDLES
+/** Get the handle entry of the given static handle, and take it into use if
+  this is the first time the handle is used. Returns the index in the cache,
+  or HANDLE_CACHE_ENTRY_INVALID if the handle isn't in the static list. */
+static uint16_t handle_entry_to_head(rbc_mesh_value_handle_t handle)
+{
+    uint16_t i = static_index_get(handle);
+    if (i != HANDLE_CACHE_ENTRY_INVALID && m_handle_cache[i].handle != handle)
+    {
+        uint16_t data_index = m_handle_cache[i].data_entry;
+        event_handler_critical_section_begin();
+        m_handle_cache[i].handle = handle;
+        event_handler_critical_section_end();
+        m_handle_cache[i].tx_event = 0;
+        m_handle_cache[i].urgent = 0;
+        m_handle_cache[i].evicted = 0;
+        m_handle_cache[i].fingerprinted = 0;
+#ifdef RBC_MESH_VALUE_TTL
+        m_handle_cache[i].ttl = 0;
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+        m_handle_cache[i].combine_window_ms = 0;
+#endif
+        m_handle_cache[i].version = 0;
+        m_handle_cache[i].trickle_class = class_default_get(handle);
+#ifdef RBC_MESH_HOP_SCOPES
+        m_handle_cache[i].hop_scope = RBC_MESH_HOP_SCOPE_UNLIMITED;
+#endif
+
+        trickle_timer_reset(&m_data_cache[data_index].trickle, 0);
+#ifdef RBC_MESH_HANDLE_STATS
+        data_entry_stats_clear(&m_data_cache[data_index]);
+#endif
+        m_data_cache[data_index].burst = 0;
+        m_data_cache[data_index].trickle.param_class = m_handle_cache[i].trickle_class;
+#ifdef RBC_MESH_WRITE_COMBINING
+        m_data_cache[data_index].combine_open = 0;
+        m_data_cache[data_index].combine_held = 0;
+#endif
+    }
+    return i;
+}
+#else
+/** Moves the given handle to the head of the handle cache.
+  If it doesn't exist, it allocates the tail, and moves it to head.
+  Returns the index in the cache, or HANDLE_CACHE_ENTRY_INVALID if the cache
+  is full of persistent handles */
+static uint16_t handle_entry_to_head(rbc_mesh_value_handle_t handle)
+{
+    uint16_t i = handle_entry_get(handle, true);
+    if (i == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        i = m_handle_cache_tail;
+        while (m_handle_cache[i].persistent)
+        {
+            HANDLE_CACHE_ITERATE_BACK(i);
+            if (i == HANDLE_CACHE_ENTRY_INVALID)
+            {
+                return i; /* reached the head without hitting a non-persistent handle */
+            }
+        }
+        /* clean up old data */
+        event_handler_critical_section_begin();
+        if (m_handle_cache[i].handle != RBC_MESH_INVALID_HANDLE)
+        {
+            handle_index_remove(m_handle_cache[i].handle);
+        }
+        m_handle_cache[i].handle = handle;
+        handle_index_insert(i);
+        event_handler_critical_section_end();
+        m_handle_cache[i].tx_event = 0;
+        m_handle_cache[i].urgent = 0;
+        m_handle_cache[i].evicted = 0;
+        m_handle_cache[i].fingerprinted = 0;
+#ifdef RBC_MESH_VALUE_TTL
+        m_handle_cache[i].ttl = 0;
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+        m_handle_cache[i].combine_window_ms = 0;
+#endif
+        m_handle_cache[i].version = 0;
+        m_handle_cache[i].trickle_class = class_default_get(handle);
+#ifdef RBC_MESH_HOP_SCOPES
+        m_handle_cache[i].hop_scope = RBC_MESH_HOP_SCOPE_UNLIMITED;
+#endif
+        if (m_handle_cache[i].data_entry != DATA_CACHE_ENTRY_INVALID)
+        {
+            data_entry_release(i);
+        }
+    }
+    /* detach and move to head */
+    if (i != m_handle_cache_tail)
+    {
+        if (i != m_handle_cache_head)
+        {
+            m_handle_cache[m_handle_cache[i].index_next].index_prev = m_handle_cache[i].index_prev;
+        }
+    }
+    else
+    {
+        m_handle_cache_tail = m_handle_cache[i].index_prev;
+        m_handle_cache[i].index_next = HANDLE_CACHE_ENTRY_INVALID;
+    }
+
+    if (i != m_handle_cache_head)
+    {
+        if (m_handle_cache[i].index_prev != HANDLE_CACHE_ENTRY_INVALID)
+        {
+            m_handle_cache[m_handle_cache[i].index_prev].index_next = m_handle_cache[i].index_next;
+        }
+
+        m_handle_cache[i].index_prev = HANDLE_CACHE_ENTRY_INVALID;
+        m_handle_cache[i].index_next = m_handle_cache_head;
+        m_handle_cache[m_handle_cache_head].index_prev = i;
+        m_handle_cache_head = i;
+    }
+
+    m_handle_cache[m_handle_cache_head].index_prev = HANDLE_CACHE_ENTRY_INVALID;
+    m_handle_cache[m_handle_cache_tail].index_next = HANDLE_CACHE_ENTRY_INVALID;
+
+    return i;
+}
+#endif
+
+#if defined(RBC_MESH_CACHE_COMPACTION) && !defined(RBC_MESH_STATIC_HANDLES)
+#define CACHE_COMPACTION
+#endif
+
+#ifdef CACHE_COMPACTION
+typedef union
+{
+    handle_entry_t handle_entry;
+    data_entry_t data_entry;
+} cache_entry_t;
+
+/** Map a cache index to its new place, leaving the invalid index alone. */
+static uint16_t compact_index_map(const uint16_t* p_new_index, uint16_t index, uint16_t size)
+{
+    return (index < size ? p_new_index[index] : index);
+}
+
+/** Move the entries of a cache to their new places, one permutation cycle
+  at a time. Uses up the map. */
+static void compact_entries_move(void* p_cache, uint32_t entry_size, uint16_t* p_new_index, uint16_t size)
+{
+    uint8_t* p_entries = (uint8_t*) p_cache;
+    cache_entry_t temp;
+    for (uint16_t i = 0; i < size; ++i)
+    {
+        while (p_new_index[i] != i)
+        {
+            uint16_t j = p_new_index[i];
+            memcpy(&temp, &p_entries[j * entry_size], entry_size);
+            memcpy(&p_entries[j * entry_size], &p_entries[i * entry_size], entry_size);
+            memcpy(&p_entries[i * entry_size], &temp, entry_size);
+            p_new_index[i] = p_new_index[j];
+            p_new_index[j] = j;
+        }
+    }
+}
+
+/** Fill the handle index from scratch. */
+static void handle_index_rebuild(void)
+{
+    for (uint32_t i = 0; i <= m_handle_index_mask; ++i)
+    {
+        m_handle_index[i] = HANDLE_CACHE_ENTRY_INVALID;
+    }
+    for (uint16_t i = 0; i < m_handle_cache_size; ++i)
+    {
+        if (m_handle_cache[i].handle != RBC_MESH_INVALID_HANDLE)
+        {
+            handle_index_insert(i);
+        }
+    }
+}
+
+/** Get the new place of every cache entry: handle entries in LRU order, and
+  data entries in the order of their handles, with the free entries last.
+  Returns whether the caches are in that order already. */
+static bool compact_maps_get(uint16_t* p_handle_map, uint16_t* p_data_map)
+{
+    bool in_order = true;
+    uint16_t handle_count = 0;
+    uint16_t data_count = 0;
+    for (uint16_t i = m_handle_cache_head;
+         i != HANDLE_CACHE_ENTRY_INVALID && handle_count < m_handle_cache_size;
+         i = m_handle_cache[i].index_next)
+    {
+        in_order = in_order && (i == handle_count);
+        p_handle_map[i] = handle_count++;
+        uint16_t data_index = m_handle_cache[i].data_entry;
+        if (data_index != DATA_CACHE_ENTRY_INVALID)
+        {
+            in_order = in_order && (data_index == data_count);
+            p_data_map[data_index] = data_count++;
+        }
+    }
+    for (uint16_t i = m_data_free_head;
+         i != DATA_CACHE_ENTRY_INVALID && data_count < m_data_cache_size;
+         i = m_data_cache[i].lru_next)
+    {
+        in_order = in_order && (i == data_count);
+        p_data_map[i] = data_count++;
+    }
+    APP_ERROR_CHECK_BOOL(handle_count == m_handle_cache_size && data_count == m_data_cache_size);
+    return in_order;
+}
+#endif
+
+#ifdef RBC_MESH_WRITE_COMBINING
+/** Merge a local update into the current version of the given handle if that
+  version is still held back. Returns whether the update was merged. */
+static bool local_update_merge(uint16_t handle_index, mesh_packet_t* p_packet)
+{
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index == DATA_CACHE_ENTRY_INVALID ||
+        !m_data_cache[data_index].combine_held)
+    {
+        return false;
+    }
+#ifdef RBC_MESH_STATIC_HANDLES
+    if (mesh_packet_adv_data_get(p_packet)->adv_data_length >
+        MESH_PACKET_ADV_OVERHEAD + m_static_max_lengths[handle_index])
+    {
+        return false; /* rejected by the regular path */
+    }
+#endif
+
+    mesh_packet_adv_data_get(p_packet)->version = m_handle_cache[handle_index].version;
+    if (data_entry_value_set(data_index, p_packet) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    data_entry_tx_heap_update(data_index);
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    persistent_value_store(handle_index);
+#endif
+    return true;
+}
+
+/** Hold the fresh local version of the given handle back until the
+  write-combining window has passed, if it's open. Returns whether the
+  version is held. */
+static bool local_update_hold(uint16_t handle_index, uint16_t data_index, uint32_t time_now)
+{
+    data_entry_t* p_data_entry = &m_data_cache[data_index];
+    uint32_t window_us = m_handle_cache[handle_index].combine_window_ms * 1000UL;
+    if (window_us == 0)
+    {
+        return false;
+    }
+
+    if (p_data_entry->combine_open &&
+        (uint32_t) (time_now - p_data_entry->combine_start) < window_us)
+    {
+        p_data_entry->combine_held = 1;
+        trickle_tx_order(&p_data_entry->trickle, p_data_entry->combine_start + window_us, 0);
+        data_entry_tx_heap_update(data_index);
+        return true;
+    }
+
+    /* goes out right away, and opens the window */
+    p_data_entry->combine_open = 1;
+    p_data_entry->combine_start = time_now;
+    return false;
+}
+#endif
+
+void local_packet_push(void* p_context)
+{
+    mesh_packet_t* p_packet = (mesh_packet_t*) p_context;
+    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_packet);
+    if (p_adv != NULL)
+    {
+        handle_info_t info =
+        {
+            .version = p_adv->version,
+            .p_packet = p_packet
+        };
+        uint16_t handle_index = handle_entry_get(p_adv->handle, true);
+        if (handle_index != HANDLE_CACHE_ENTRY_INVALID)
+        {
+#ifdef RBC_MESH_HOP_SCOPES
+            p_adv->hops_left = m_handle_cache[handle_index].hop_scope;
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+            if (local_update_merge(handle_index, p_packet))
+            {
+                mesh_packet_ref_count_dec(p_packet); /* for the event queue */
+                return;
+            }
+#endif
+            info.version = m_handle_cache[handle_index].version;
+            version_increment(&info.version);
+        }
+        p_adv->version = info.version;
+
+        if (handle_storage_info_set(p_adv->handle, &info) == NRF_SUCCESS)
+        {
+            handle_index = handle_entry_get(p_adv->handle, true);
+            uint16_t data_index = m_handle_cache[handle_index].data_entry;
+#ifdef RBC_MESH_WRITE_COMBINING
+            if (local_update_hold(handle_index, data_index, timer_now()))
+            {
+                mesh_packet_ref_count_dec(p_packet); /* for the event queue */
+                return;
+            }
+#endif
+            /* fresh local urgent values don't wait for the relay delay */
+            if (m_data_cache[data_index].burst > 0)
+            {
+                trickle_tx_order(&m_data_cache[data_index].trickle, timer_now(), 0);
+                data_entry_tx_heap_update(data_index);
+            }
+        }
+    }
+    mesh_packet_ref_count_dec(p_packet); /* for the event queue */
+}
+
+/*****************************************************************************
+* Interface Functions
+*****************************************************************************/
+uint32_t handle_storage_memory_size_get(uint16_t handle_cache_entries, uint16_t data_cache_entries)
+{
+    return MEMORY_WORD_ALIGN(sizeof(data_entry_t) * data_cache_entries) +
+           MEMORY_WORD_ALIGN(sizeof(handle_entry_t) * handle_cache_entries) +
+           MEMORY_WORD_ALIGN(sizeof(uint16_t) * handle_index_size_get(handle_cache_entries)) +
+           MEMORY_WORD_ALIGN(sizeof(uint16_t) * data_cache_entries) * 2
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+           + value_store_memory_size_get(value_store_page_count(data_cache_entries))
+#endif
+           ;
+}
+
+void handle_storage_ram_get(uint32_t* p_handle_cache, uint32_t* p_data_cache)
+{
+    *p_handle_cache = sizeof(handle_entry_t) * m_handle_cache_size;
+    if (m_handle_index != NULL)
+    {
+        *p_handle_cache += sizeof(uint16_t) * (m_handle_index_mask + 1);
+    }
+    *p_data_cache = sizeof(data_entry_t) * m_data_cache_size +
+                    sizeof(uint16_t) * m_data_cache_size * 2
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+                    + value_store_memory_size_get(value_store_page_count(m_data_cache_size))
+#endif
+                    ;
+}
+
+uint32_t handle_storage_init(uint32_t min_interval_us, const handle_storage_memory_t* p_memory)
+{
+    if (p_memory == NULL)
+    {
+#ifdef RBC_MESH_EXTERNAL_MEMORY
+        return NRF_ERROR_NULL;
+#else
+        m_handle_cache = m_handle_cache_default;
+        m_data_cache = m_data_cache_default;
+        m_tx_heap = m_tx_heap_default;
+        m_tx_popped = m_tx_popped_default;
+        m_handle_cache_size = RBC_MESH_HANDLE_CACHE_ENTRIES;
+        m_data_cache_size = RBC_MESH_DATA_CACHE_ENTRIES;
+        m_data_pinned_reserved = RBC_MESH_PINNED_DATA_ENTRIES;
+#ifndef RBC_MESH_STATIC_HANDLES
+        m_handle_index = m_handle_index_default;
+        m_handle_index_mask = RBC_MESH_HANDLE_INDEX_SIZE - 1;
+#endif
+#endif
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+        uint32_t error_code = value_store_init(NULL, 0);
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+#endif
+    }
+    else
+    {
+#ifdef RBC_MESH_STATIC_HANDLES
+        /* the caches are sized by the static handle list */
+        return NRF_ERROR_NOT_SUPPORTED;
+#endif
+        if (p_memory->p_memory == NULL)
+        {
+            return NRF_ERROR_NULL;
+        }
+        if (((uintptr_t) p_memory->p_memory) & 0x03)
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+        if (p_memory->data_cache_entries == 0 ||
+            p_memory->data_cache_entries > DATA_CACHE_ENTRIES_MAX ||
+            p_memory->handle_cache_entries < p_memory->data_cache_entries ||
+            p_memory->handle_cache_entries > HANDLE_CACHE_ENTRIES_MAX ||
+            p_memory->pinned_data_entries > p_memory->data_cache_entries)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        uint8_t* p_next = (uint8_t*) p_memory->p_memory;
+        m_data_cache = (data_entry_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(data_entry_t) * p_memory->data_cache_entries);
+        m_handle_cache = (handle_entry_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(handle_entry_t) * p_memory->handle_cache_entries);
+        m_handle_index = (uint16_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(uint16_t) * handle_index_size_get(p_memory->handle_cache_entries));
+        m_tx_heap = (uint16_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(uint16_t) * p_memory->data_cache_entries);
+        m_tx_popped = (uint16_t*) p_next;
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+        p_next += MEMORY_WORD_ALIGN(sizeof(uint16_t) * p_memory->data_cache_entries);
+        uint32_t error_code = value_store_init(p_next, value_store_page_count(p_memory->data_cache_entries));
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+#endif
+
+        m_handle_cache_size = p_memory->handle_cache_entries;
+        m_data_cache_size = p_memory->data_cache_entries;
+        m_data_pinned_reserved = p_memory->pinned_data_entries;
+        m_handle_index_mask = handle_index_size_get(p_memory->handle_cache_entries) - 1;
+    }
+
+    event_handler_critical_section_begin();
+    uint32_t error_code = handle_storage_min_interval_set(min_interval_us);
+    if (error_code != NRF_SUCCESS)
+    {
+        event_handler_critical_section_end();
+        return error_code;
+    }
+
+    for (uint32_t i = 0; i < m_data_cache_size; ++i)
+    {
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+        m_data_cache[i].value_ref = VALUE_STORE_REF_NONE;
+        m_data_cache[i].value_length = VALUE_LENGTH_NONE;
+#else
+        m_data_cache[i].p_packet = NULL;
+#endif
+        m_data_cache[i].heap_index = TX_HEAP_INDEX_INVALID;
+        m_data_cache[i].handle_entry = HANDLE_CACHE_ENTRY_INVALID;
+        m_data_cache[i].trickle.param_class = RBC_MESH_TRICKLE_CLASS_DEFAULT;
+        m_data_cache[i].lru_prev = DATA_CACHE_ENTRY_INVALID;
+        m_data_cache[i].lru_next = i + 1; /* chain all entries in the free list */
+    }
+    m_tx_heap_count = 0;
+    m_data_entries_free = m_data_cache_size;
+    m_data_free_head = 0;
+    for (uint32_t i = 0; i < DATA_QUEUE_COUNT; ++i)
+    {
+        m_data_lru[i].head = DATA_CACHE_ENTRY_INVALID;
+        m_data_lru[i].tail = DATA_CACHE_ENTRY_INVALID;
+        m_data_lru[i].count = 0;
+    }
+    m_data_pinned_count = 0;
+
+    for (uint32_t i = 0; i < m_handle_cache_size; ++i)
+    {
+        m_handle_cache[i].handle = RBC_MESH_INVALID_HANDLE;
+        m_handle_cache[i].version = 0;
+        m_handle_cache[i].persistent = 0;
+        m_handle_cache[i].tx_event = 0;
+        m_handle_cache[i].urgent = 0;
+        m_handle_cache[i].evicted = 0;
+        m_handle_cache[i].fingerprinted = 0;
+#ifdef RBC_MESH_VALUE_TTL
+        m_handle_cache[i].ttl = 0;
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+        m_handle_cache[i].combine_window_ms = 0;
+#endif
+        m_handle_cache[i].trickle_class = RBC_MESH_TRICKLE_CLASS_DEFAULT;
+#ifdef RBC_MESH_HOP_SCOPES
+        m_handle_cache[i].hop_scope = RBC_MESH_HOP_SCOPE_UNLIMITED;
+#endif
+        m_handle_cache[i].data_entry = DATA_CACHE_ENTRY_INVALID;
+        m_handle_cache[i].index_prev = i - 1;
+        m_handle_cache[i].index_next = i + 1;
+    }
+
+#ifdef RBC_MESH_STATIC_HANDLES
+    /* bind the entries for good, the handle list order never changes */
+    for (uint32_t i = 0; i < m_handle_cache_size; ++i)
+    {
+        m_handle_cache[i].data_entry = i;
+        m_data_cache[i].handle_entry = i;
+    }
+    m_data_entries_free = 0;
+#else
+    for (uint32_t i = 0; i <= m_handle_index_mask; ++i)
+    {
+        m_handle_index[i] = HANDLE_CACHE_ENTRY_INVALID;
+    }
+#endif
+
+    m_handle_cache_head = 0;
+    m_handle_cache_tail = m_handle_cache_size - 1;
+    m_handle_cache[m_handle_cache_head].index_prev = HANDLE_CACHE_ENTRY_INVALID;
+    m_handle_cache[m_handle_cache_tail].index_next = HANDLE_CACHE_ENTRY_INVALID;
+
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_min_interval_set(uint32_t min_interval_us)
+{
+    if (min_interval_us < RBC_MESH_INTERVAL_MIN_MIN_MS * 1000 ||
+        min_interval_us > RBC_MESH_INTERVAL_MIN_MAX_MS * 1000)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    trickle_setup(min_interval_us, MESH_TRICKLE_I_MAX, MESH_TRICKLE_K);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_info_get(uint16_t handle, handle_info_t* p_info)
+{
+    if (p_info == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    memset(p_info, 0, sizeof(handle_info_t));
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    event_handler_critical_section_begin();
+
+    uint16_t handle_index = handle_entry_get(handle, false);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        event_handler_critical_section_end();
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_info->version = m_handle_cache[handle_index].version;
+    if (m_handle_cache[handle_index].data_entry != DATA_CACHE_ENTRY_INVALID)
+    {
+        p_info->p_packet = data_entry_packet_get(m_handle_cache[handle_index].data_entry);
+    }
+
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_info_set(uint16_t handle, handle_info_t* p_info)
+{
+    if (p_info == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        /* couldn't find an existing entry, allocate one */
+        handle_index = handle_entry_to_head(handle);
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+
+#ifdef RBC_MESH_STATIC_HANDLES
+    if (p_info->p_packet != NULL)
+    {
+        mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_info->p_packet);
+        if (p_adv != NULL &&
+            p_adv->adv_data_length > MESH_PACKET_ADV_OVERHEAD + m_static_max_lengths[handle_index])
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+    }
+#endif
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        data_index = data_entry_allocate(handle_index);
+        if (data_index == DATA_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_data_cache[data_index].trickle.param_class = m_handle_cache[handle_index].trickle_class;
+    }
+    else if (m_handle_cache[handle_index].version != p_info->version)
+    {
+        data_entry_touch(data_index);
+    }
+    uint32_t time_now = timer_now();
+    trickle_timer_reset(&m_data_cache[data_index].trickle, time_now);
+
+    if (m_handle_cache[handle_index].version != p_info->version)
+    {
+#ifdef RBC_MESH_VALUE_TTL
+        m_data_cache[data_index].ttl_left = m_handle_cache[handle_index].ttl;
+#endif
+#ifdef RBC_MESH_WRITE_COMBINING
+        m_data_cache[data_index].combine_held = 0;
+#endif
+        m_data_cache[data_index].burst = 0;
+        if (m_handle_cache[handle_index].urgent)
+        {
+            /* send the new version out right away, with a random delay to
+               keep the relays that got it from the same packet apart */
+            m_data_cache[data_index].burst = RBC_MESH_URGENT_BURST_COUNT;
+            trickle_tx_order(&m_data_cache[data_index].trickle, time_now, RBC_MESH_URGENT_BURST_INTERVAL_US);
+        }
+    }
+    m_handle_cache[handle_index].version = p_info->version;
+    uint32_t error_code = data_entry_value_set(data_index, p_info->p_packet);
+    data_entry_tx_heap_update(data_index);
+#ifdef RBC_MESH_VALUE_HISTORY
+    mesh_adv_data_t* p_history_adv = mesh_packet_adv_data_get(p_info->p_packet);
+    if (error_code == NRF_SUCCESS && p_history_adv != NULL)
+    {
+        value_history_put(handle,
+                p_info->version,
+                p_history_adv->data,
+                p_history_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD,
+                time_now);
+    }
+#endif
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    if (error_code == NRF_SUCCESS)
+    {
+        persistent_value_store(handle_index);
+    }
+#endif
+    return error_code;
+}
+
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+uint32_t handle_storage_fingerprint_check(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length, bool* p_match)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID ||
+        !m_handle_cache[handle_index].fingerprinted ||
+        m_handle_cache[handle_index].data_entry != DATA_CACHE_ENTRY_INVALID ||
+        m_handle_cache[handle_index].version != version)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    *p_match = (payload_fingerprint(p_data, length) == m_handle_cache[handle_index].fingerprint);
+    return NRF_SUCCESS;
+}
+#endif
+
 uint32_t handle_storage_local_packet_push(mesh_packet_t* p_packet)
 {
-    if (p_packet == NULL)
+    if (p_packet == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    async_event_t evt;
+    evt.type = EVENT_TYPE_GENERIC;
+    evt.callback.generic.p_context = p_packet;
+    evt.callback.generic.cb = local_packet_push;
+    uint32_t error_code = event_handler_push(&evt);
+    if (error_code == NRF_SUCCESS)
+    {
+        mesh_packet_ref_count_inc(p_packet);
+    }
+    return error_code;
+}
+
+void handle_storage_local_packet_apply(mesh_packet_t* p_packet)
+{
+    mesh_packet_ref_count_inc(p_packet); /* taken by local_packet_push, like a queued event */
+    local_packet_push(p_packet);
+}
+
+uint32_t handle_storage_flag_set(uint16_t handle, handle_flag_t flag, bool value)
+{
+    if (flag >= HANDLE_FLAG__MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+
+    switch (flag)
+    {
+        case HANDLE_FLAG_PERSISTENT:
+            if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+            {
+                handle_index = handle_entry_to_head(handle);
+
+                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+                {
+                    return NRF_ERROR_NO_MEM;
+                }
+            }
+            data_entry_pin_set(handle_index, value);
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+            if (value && !m_handle_cache[handle_index].persistent)
+            {
+                m_handle_cache[handle_index].persistent = true;
+                persistent_value_store(handle_index);
+            }
+            else if (!value && m_handle_cache[handle_index].persistent)
+            {
+                value_flash_remove(handle);
+            }
+#endif
+            m_handle_cache[handle_index].persistent = value;
+            break;
+
+        case HANDLE_FLAG_TX_EVENT:
+            if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+            {
+                handle_index = handle_entry_to_head(handle);
+
+                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+                {
+                    return NRF_ERROR_NO_MEM;
+                }
+            }
+            m_handle_cache[handle_index].tx_event = value;
+            break;
+
+        case HANDLE_FLAG_URGENT:
+            if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+            {
+                handle_index = handle_entry_to_head(handle);
+
+                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+                {
+                    return NRF_ERROR_NO_MEM;
+                }
+            }
+            m_handle_cache[handle_index].urgent = value;
+            if (!value && m_handle_cache[handle_index].data_entry != DATA_CACHE_ENTRY_INVALID)
+            {
+                m_data_cache[m_handle_cache[handle_index].data_entry].burst = 0;
+            }
+            break;
+
+        case HANDLE_FLAG_DISABLED:
+            if (value)
+            {
+                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+                {
+                    return NRF_SUCCESS; /* the value is already disabled */
+                }
+                if (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
+                {
+                    return NRF_SUCCESS; /* the value is already disabled */
+                }
+                trickle_disable(&m_data_cache[m_handle_cache[handle_index].data_entry].trickle);
+                data_entry_tx_heap_update(m_handle_cache[handle_index].data_entry);
+            }
+            else
+            {
+                uint32_t error_code;
+                mesh_packet_t* p_packet = NULL;
+                if (!mesh_packet_acquire(&p_packet))
+                {
+                    return NRF_ERROR_NO_MEM;
+                }
+
+                error_code = mesh_packet_build(p_packet,
+                        handle,
+                        0,
+                        NULL,
+                        0);
+                if (error_code != NRF_SUCCESS)
+                {
+                    mesh_packet_ref_count_dec(p_packet);
+                    return error_code;
+                }
+
+                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+                {
+                    /* may safely run this function inline, as we're already in event handler */
+                    local_packet_push(p_packet);
+                    return NRF_SUCCESS;
+                }
+                else
+                {
+                    if (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
+                    {
+                        if (data_entry_allocate(handle_index) == DATA_CACHE_ENTRY_INVALID)
+                        {
+                            mesh_packet_ref_count_dec(p_packet);
+                            return NRF_ERROR_NO_MEM;
+                        }
+                        trickle_class_set(&m_data_cache[m_handle_cache[handle_index].data_entry].trickle,
+                                m_handle_cache[handle_index].trickle_class,
+                                timer_now());
+                    }
+                    /* don't overwrite the value if someone set it already. */
+                    if (!DATA_ENTRY_HAS_VALUE(&m_data_cache[m_handle_cache[handle_index].data_entry]))
+                    {
+                        error_code = data_entry_value_set(m_handle_cache[handle_index].data_entry, p_packet);
+                    }
+                    mesh_packet_ref_count_dec(p_packet);
+                    if (error_code != NRF_SUCCESS)
+                    {
+                        return error_code;
+                    }
+                    trickle_enable(&m_data_cache[m_handle_cache[handle_index].data_entry].trickle);
+                    data_entry_tx_heap_update(m_handle_cache[handle_index].data_entry);
+                }
+            }
+            break;
+        default:
+            return NRF_ERROR_INVALID_PARAM;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_flag_set_async(uint16_t handle, handle_flag_t flag, bool value)
+{
+    async_event_t evt;
+    evt.type = EVENT_TYPE_SET_FLAG;
+    evt.callback.set_flag.handle = handle;
+    evt.callback.set_flag.flag = flag;
+    evt.callback.set_flag.value = value;
+    return event_handler_push(&evt);
+}
+
+uint32_t handle_storage_flag_get(uint16_t handle, handle_flag_t flag, bool* p_value)
+{
+    if (flag >= HANDLE_FLAG__MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_value == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+
+    uint16_t handle_index = handle_entry_get(handle, false);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        event_handler_critical_section_end();
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    switch (flag)
+    {
+        case HANDLE_FLAG_PERSISTENT:
+            *p_value = m_handle_cache[handle_index].persistent;
+            break;
+        case HANDLE_FLAG_TX_EVENT:
+            *p_value = m_handle_cache[handle_index].tx_event;
+            break;
+        case HANDLE_FLAG_URGENT:
+            *p_value = m_handle_cache[handle_index].urgent;
+            break;
+        default:
+            event_handler_critical_section_end();
+            return NRF_ERROR_INVALID_PARAM;
+    }
+
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_rx_consistent(uint16_t handle, uint32_t timestamp)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    trickle_rx_consistent(&m_data_cache[data_index].trickle, timestamp);
+#ifdef RBC_MESH_HANDLE_STATS
+    stats_count(&m_data_cache[data_index].rx_consistent_count);
+#endif
+
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_rx_duplicate(uint16_t handle, uint16_t version, uint32_t timestamp)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (m_handle_cache[handle_index].version != version)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    trickle_rx_consistent(&m_data_cache[data_index].trickle, timestamp);
+#ifdef RBC_MESH_HANDLE_STATS
+    stats_count(&m_data_cache[data_index].rx_consistent_count);
+#endif
+
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_rx_inconsistent(uint16_t handle, uint32_t timestamp)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    trickle_rx_inconsistent(&m_data_cache[data_index].trickle, timestamp);
+#ifdef RBC_MESH_HANDLE_STATS
+    stats_count(&m_data_cache[data_index].rx_inconsistent_count);
+#endif
+    data_entry_tx_heap_update(data_index);
+
+    return NRF_SUCCESS;
+}
+uint32_t handle_storage_next_timeout_get(bool* p_found_value)
+{
+    *p_found_value = (m_tx_heap_count > 0);
+    if (m_tx_heap_count == 0)
+    {
+        return 0;
+    }
+    /* the earliest timeout is always at the top of the heap */
+    return TX_HEAP_T(0, timer_now());
+}
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+uint32_t handle_storage_urgent_timeout_get(bool* p_found_value)
+{
+    /* the heap is only ordered from the top, look through all of it */
+    uint32_t timeout = 0;
+    *p_found_value = false;
+    for (uint32_t i = 0; i < m_tx_heap_count; ++i)
+    {
+        uint16_t handle_index = m_data_cache[m_tx_heap[i]].handle_entry;
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID ||
+            !m_handle_cache[handle_index].urgent)
+        {
+            continue;
+        }
+        uint32_t t = TX_HEAP_T(i, timer_now());
+        if (!*p_found_value || TIMER_OLDER_THAN(t, timeout))
+        {
+            timeout = t;
+            *p_found_value = true;
+        }
+    }
+    return timeout;
+}
+#endif
+
+uint32_t handle_storage_tx_packets_get(uint32_t time_now, mesh_packet_t** pp_packets, uint32_t* p_count)
+{
+    /* Entries that have been taken out of the heap in this round are kept
+       out until the round is over, as an entry that is due for TX won't get
+       a new timeout until it's reported as transmitted. */
+    uint32_t popped_count = 0;
+    uint32_t count = 0;
+    TRACE_BEGIN(MESH_TRACE_POINT_HANDLE_STORAGE_TX, 0);
+
+    /* pop all due entries in timeout order */
+    while (m_tx_heap_count > 0 &&
+           !TIMER_OLDER_THAN(time_now, TX_HEAP_T(0, time_now)))
+    {
+        uint16_t data_index = m_tx_heap[0];
+        tx_heap_remove(data_index);
+        m_tx_popped[popped_count++] = data_index;
+    }
+
+    /* Fill the given slots class by class, so that the high priority values
+       get the slots when there are more values due than slots. Entries that
+       don't get a slot are put back untouched, to be picked up next time. */
+    for (uint32_t param_class = 0; param_class < RBC_MESH_TRICKLE_CLASS_COUNT; ++param_class)
+    {
+        for (uint32_t i = 0; i < popped_count && count < *p_count; ++i)
+        {
+            trickle_t* p_trickle = &m_data_cache[m_tx_popped[i]].trickle;
+            if (trickle_class_get(p_trickle) != param_class)
+            {
+                continue;
+            }
+
+            bool do_tx = false;
+            trickle_tx_timeout(p_trickle, &do_tx, time_now);
+            if (m_data_cache[m_tx_popped[i]].burst > 0 && trickle_is_enabled(p_trickle))
+            {
+                /* consistent copies from the neighbors don't suppress a burst */
+                do_tx = true;
+            }
+            if (do_tx)
+            {
+                /* return the packet with an additional reference */
+                mesh_packet_t* p_packet = data_entry_packet_get(m_tx_popped[i]);
+                if (p_packet != NULL)
+                {
+                    pp_packets[count++] = p_packet;
+                }
+            }
+        }
+    }
+
+    /* put the entries back with their new timeouts */
+    for (uint32_t i = 0; i < popped_count; ++i)
+    {
+        data_entry_tx_heap_update(m_tx_popped[i]);
+    }
+
+    *p_count = count;
+
+    TRACE_END(MESH_TRACE_POINT_HANDLE_STORAGE_TX, count);
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_transmitted(uint16_t handle, uint32_t timestamp)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    trickle_tx_register(&m_data_cache[data_index].trickle, timestamp);
+#ifdef RBC_MESH_WRITE_COMBINING
+    if (m_data_cache[data_index].combine_held)
+    {
+        /* the combined version is out, the next one waits for a full window */
+        m_data_cache[data_index].combine_held = 0;
+        m_data_cache[data_index].combine_start = timestamp;
+    }
+#endif
+    if (m_data_cache[data_index].burst > 0 &&
+        --m_data_cache[data_index].burst > 0)
+    {
+        /* next burst transmission in the second half of the burst interval */
+        trickle_tx_order(&m_data_cache[data_index].trickle,
+                timestamp + RBC_MESH_URGENT_BURST_INTERVAL_US / 2,
+                RBC_MESH_URGENT_BURST_INTERVAL_US / 2);
+    }
+#ifdef RBC_MESH_HANDLE_STATS
+    stats_count(&m_data_cache[data_index].tx_count);
+#endif
+    data_entry_tx_heap_update(data_index);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_summary_get(uint32_t* p_digest, uint16_t* p_count)
+{
+    if (p_digest == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    /* The digest is a sum of hashed handle/version pairs, which makes it
+       independent of the order the values are stored in. */
+    uint32_t digest = 0;
+    for (uint32_t i = 0; i < m_tx_heap_count; ++i)
+    {
+        /* entries in the heap always have a value, and an owning handle entry */
+        const handle_entry_t* p_handle_entry = &m_handle_cache[m_data_cache[m_tx_heap[i]].handle_entry];
+        uint32_t hash = (((uint32_t) p_handle_entry->handle) << 16) | p_handle_entry->version;
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6BUL;
+        hash ^= hash >> 13;
+        hash *= 0xC2B2AE35UL;
+        hash ^= hash >> 16;
+        digest += hash;
+    }
+
+    *p_digest = digest;
+    *p_count = m_tx_heap_count;
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_versions_get(uint16_t first_handle, uint16_t* p_handles, uint16_t* p_versions, uint32_t* p_count)
+{
+    if (p_handles == NULL || p_versions == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    /* insertion sort of the lowest handles in the heap into the given arrays */
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_tx_heap_count; ++i)
+    {
+        const handle_entry_t* p_handle_entry = &m_handle_cache[m_data_cache[m_tx_heap[i]].handle_entry];
+        if (p_handle_entry->handle < first_handle ||
+            (count == *p_count && (count == 0 || p_handle_entry->handle > p_handles[count - 1])))
+        {
+            continue;
+        }
+        uint32_t pos = (count < *p_count ? count++ : count - 1);
+        while (pos > 0 && p_handles[pos - 1] > p_handle_entry->handle)
+        {
+            p_handles[pos] = p_handles[pos - 1];
+            p_versions[pos] = p_versions[pos - 1];
+            pos--;
+        }
+        p_handles[pos] = p_handle_entry->handle;
+        p_versions[pos] = p_handle_entry->version;
+    }
+
+    *p_count = count;
+    return NRF_SUCCESS;
+}
+
+uint32_t handle_storage_repair_order(uint16_t handle, uint32_t time_now, uint32_t max_delay_us)
+{
+    uint16_t handle_index = handle_entry_get(handle, false);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index == DATA_CACHE_ENTRY_INVALID ||
+        m_data_cache[data_index].heap_index == TX_HEAP_INDEX_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    if (m_data_cache[data_index].burst == 0)
+    {
+        /* a single burst transmission isn't suppressed by consistent copies */
+        m_data_cache[data_index].burst = 1;
+        trickle_tx_order(&m_data_cache[data_index].trickle, time_now, max_delay_us);
+        data_entry_tx_heap_update(data_index);
+    }
+    return NRF_SUCCESS;
+}
+
+/** Iterate over the handles that have a value, optionally only the persistent ones. */
+static uint32_t value_next_get(uint32_t* p_iterator, uint16_t* p_handle, handle_info_t* p_info, bool persistent_only)
+{
+    if (p_iterator == NULL || p_handle == NULL || p_info == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    for (uint32_t i = *p_iterator; i < m_handle_cache_size; ++i)
+    {
+        const handle_entry_t* p_handle_entry = &m_handle_cache[i];
+        if ((p_handle_entry->persistent || !persistent_only) &&
+            p_handle_entry->handle != RBC_MESH_INVALID_HANDLE &&
+            p_handle_entry->data_entry != DATA_CACHE_ENTRY_INVALID)
+        {
+            mesh_packet_t* p_packet = data_entry_packet_get(p_handle_entry->data_entry);
+            if (p_packet != NULL)
+            {
+                *p_iterator = i + 1;
+                *p_handle = p_handle_entry->handle;
+                p_info->version = p_handle_entry->version;
+                p_info->p_packet = p_packet;
+                return NRF_SUCCESS;
+            }
+        }
+    }
+
+    *p_iterator = m_handle_cache_size;
+    return NRF_ERROR_NOT_FOUND;
+}
+
+uint32_t handle_storage_persistent_get(uint32_t* p_iterator, uint16_t* p_handle, handle_info_t* p_info)
+{
+    return value_next_get(p_iterator, p_handle, p_info, true);
+}
+
+uint32_t handle_storage_value_next_get(uint32_t* p_iterator, uint16_t* p_handle, handle_info_t* p_info)
+{
+    return value_next_get(p_iterator, p_handle, p_info, false);
+}
+
+uint32_t handle_storage_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context)
+{
+    if (callback == NULL)
     {
         return NRF_ERROR_NULL;
     }
-    async_event_t evt;
-    evt.type = EVENT_TYPE_GENERIC;
-    evt.callback.generic.p_context = p_packet;
-    evt.callback.generic.cb = local_packet_push;
-    uint32_t error_code = event_handler_push(&evt);
-    if (error_code == NRF_SUCCESS)
+
+    event_handler_critical_section_begin();
+    uint32_t i = m_handle_cache_head;
+    for (uint32_t count = 0; i != HANDLE_CACHE_ENTRY_INVALID && count < m_handle_cache_size; ++count)
+    {
+        const handle_entry_t* p_handle_entry = &m_handle_cache[i];
+        HANDLE_CACHE_ITERATE(i);
+        if (p_handle_entry->handle > RBC_MESH_APP_MAX_HANDLE)
+        {
+            /* unused entry, or mesh-maintenance */
+            continue;
+        }
+
+        rbc_mesh_handle_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.handle = p_handle_entry->handle;
+        info.version = p_handle_entry->version;
+        info.trickle_class = p_handle_entry->trickle_class;
+        info.persistent = p_handle_entry->persistent;
+        info.tx_event = p_handle_entry->tx_event;
+        info.urgent = p_handle_entry->urgent;
+        if (p_handle_entry->data_entry != DATA_CACHE_ENTRY_INVALID)
+        {
+            data_entry_t* p_data_entry = &m_data_cache[p_handle_entry->data_entry];
+            info.enabled = trickle_is_enabled(&p_data_entry->trickle);
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+            if (DATA_ENTRY_HAS_VALUE(p_data_entry))
+            {
+                info.has_value = true;
+                info.data_len = p_data_entry->value_length;
+                info.p_data = value_store_data_get(p_data_entry->value_ref);
+            }
+#else
+            mesh_adv_data_t* p_adv = (p_data_entry->p_packet == NULL ? NULL : mesh_packet_adv_data_get(p_data_entry->p_packet));
+            if (p_adv != NULL)
+            {
+                info.has_value = true;
+                info.data_len = p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+                info.p_data = p_adv->data;
+            }
+#endif
+        }
+
+        if (!callback(&info, p_context))
+        {
+            break;
+        }
+    }
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+void handle_storage_rx_consistent_all(uint32_t timestamp)
+{
+    /* trickle_rx_consistent doesn't change the timeout, the heap stays intact. */
+    for (uint32_t i = 0; i < m_tx_heap_count; ++i)
     {
-        mesh_packet_ref_count_inc(p_packet);
+        trickle_rx_summary_consistent(&m_data_cache[m_tx_heap[i]].trickle, timestamp);
     }
-    return error_code;
 }
 
-uint32_t handle_storage_flag_set(uint16_t handle, handle_flag_t flag, bool value)
+uint32_t handle_storage_trickle_class_set(uint16_t handle, uint8_t trickle_class)
 {
-    if (flag >= HANDLE_FLAG__MAX)
+    if (trickle_class >= RBC_MESH_TRICKLE_CLASS_COUNT)
     {
         return NRF_ERROR_INVALID_PARAM;
     }
@@ -437,121 +2373,64 @@ uint32_t handle_storage_flag_set(uint16_t handle, handle_flag_t flag, bool value
     }
 
     uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        handle_index = handle_entry_to_head(handle);
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
 
-    switch (flag)
+    m_handle_cache[handle_index].trickle_class = trickle_class;
+    uint16_t data_index = m_handle_cache[handle_index].data_entry;
+    if (data_index != DATA_CACHE_ENTRY_INVALID)
     {
-        case HANDLE_FLAG_PERSISTENT:
-            if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-            {
-                handle_index = handle_entry_to_head(handle);
+        trickle_class_set(&m_data_cache[data_index].trickle, trickle_class, timer_now());
+        data_entry_tx_heap_update(data_index);
+    }
 
-                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-                {
-                    return NRF_ERROR_NO_MEM;
-                }
-            }
-            m_handle_cache[handle_index].persistent = value;
-            break;
+    return NRF_SUCCESS;
+}
 
-        case HANDLE_FLAG_TX_EVENT:
-            if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-            {
-                handle_index = handle_entry_to_head(handle);
+uint32_t handle_storage_class_range_add(const rbc_mesh_handle_range_t* p_range, uint8_t trickle_class)
+{
+    if (trickle_class >= RBC_MESH_TRICKLE_CLASS_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (m_class_range_count >= RBC_MESH_INSTANCES_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
 
-                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-                {
-                    return NRF_ERROR_NO_MEM;
-                }
-            }
-            m_handle_cache[handle_index].tx_event = value;
-            break;
+    event_handler_critical_section_begin();
+    m_class_ranges[m_class_range_count] = *p_range;
+    m_class_range_classes[m_class_range_count] = trickle_class;
+    m_class_range_count++;
 
-        case HANDLE_FLAG_DISABLED:
-            if (value)
-            {
-                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-                {
-                    return NRF_SUCCESS; /* the value is already disabled */
-                }
-                if (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
-                {
-                    return NRF_SUCCESS; /* the value is already disabled */
-                }
-                trickle_disable(&m_data_cache[m_handle_cache[handle_index].data_entry].trickle);
-            }
-            else
+    /* move the handles that are already cached over to the class */
+    for (uint32_t i = 0; i < m_handle_cache_size; ++i)
+    {
+        if (m_handle_cache[i].handle >= p_range->first &&
+            m_handle_cache[i].handle <= p_range->last)
+        {
+            m_handle_cache[i].trickle_class = trickle_class;
+            uint16_t data_index = m_handle_cache[i].data_entry;
+            if (data_index != DATA_CACHE_ENTRY_INVALID)
             {
-                uint32_t error_code;
-                mesh_packet_t* p_packet = NULL;
-                if (!mesh_packet_acquire(&p_packet))
-                {
-                    return NRF_ERROR_NO_MEM;
-                }
-
-                error_code = mesh_packet_build(p_packet,
-                        handle,
-                        0,
-                        NULL,
-                        0);
-                if (error_code != NRF_SUCCESS)
-                {
-                    mesh_packet_ref_count_dec(p_packet);
-                    return error_code;
-                }
-
-                if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
-                {
-                    /* may safely run this function inline, as we're already in event handler */
-                    local_packet_push(p_packet);
-                    return NRF_SUCCESS;
-                }
-                else
-                {
-                    if (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
-                    {
-                        m_handle_cache[handle_index].data_entry = data_entry_allocate();
-                        if (m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
-                        {
-                            return NRF_ERROR_NO_MEM;
-                        }
-                    }
-                    if (m_data_cache[m_handle_cache[handle_index].data_entry].p_packet != NULL)
-                    {
-                        /* someone set the packet already, let's not overwrite it. */
-                        mesh_packet_ref_count_dec(p_packet);
-                    }
-                    else
-                    {
-                        m_data_cache[m_handle_cache[handle_index].data_entry].p_packet = p_packet;
-                    }
-                    trickle_enable(&m_data_cache[m_handle_cache[handle_index].data_entry].trickle);
-                }
+                trickle_class_set(&m_data_cache[data_index].trickle, trickle_class, timer_now());
+                data_entry_tx_heap_update(data_index);
             }
-            break;
-        default:
-            return NRF_ERROR_INVALID_PARAM;
+        }
     }
-
+    event_handler_critical_section_end();
     return NRF_SUCCESS;
 }
 
-uint32_t handle_storage_flag_set_async(uint16_t handle, handle_flag_t flag, bool value)
-{
-    async_event_t evt;
-    evt.type = EVENT_TYPE_SET_FLAG;
-    evt.callback.set_flag.handle = handle;
-    evt.callback.set_flag.flag = flag;
-    evt.callback.set_flag.value = value;
-    return event_handler_push(&evt);
-}
-
-uint32_t handle_storage_flag_get(uint16_t handle, handle_flag_t flag, bool* p_value)
+uint32_t handle_storage_trickle_class_get(uint16_t handle, uint8_t* p_trickle_class)
 {
-    if (flag >= HANDLE_FLAG__MAX)
-    {
-        return NRF_ERROR_INVALID_PARAM;
-    }
-    if (p_value == NULL)
+    if (p_trickle_class == NULL)
     {
         return NRF_ERROR_NULL;
     }
@@ -561,58 +2440,58 @@ uint32_t handle_storage_flag_get(uint16_t handle, handle_flag_t flag, bool* p_va
     }
 
     event_handler_critical_section_begin();
-
     uint16_t handle_index = handle_entry_get(handle, false);
     if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
     {
         event_handler_critical_section_end();
         return NRF_ERROR_NOT_FOUND;
     }
-
-    switch (flag)
-    {
-        case HANDLE_FLAG_PERSISTENT:
-            *p_value = m_handle_cache[handle_index].persistent;
-            break;
-        case HANDLE_FLAG_TX_EVENT:
-            *p_value = m_handle_cache[handle_index].tx_event;
-            break;
-        default:
-            event_handler_critical_section_end();
-            return NRF_ERROR_INVALID_PARAM;
-    }
-
+    *p_trickle_class = m_handle_cache[handle_index].trickle_class;
     event_handler_critical_section_end();
+
     return NRF_SUCCESS;
 }
 
-uint32_t handle_storage_rx_consistent(uint16_t handle, uint32_t timestamp)
+uint32_t handle_storage_stats_get(uint16_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset)
 {
+#ifdef RBC_MESH_HANDLE_STATS
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
     if (handle == RBC_MESH_INVALID_HANDLE)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
 
-    uint16_t handle_index = handle_entry_get(handle, true);
-    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    event_handler_critical_section_begin();
+    uint16_t handle_index = handle_entry_get(handle, false);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID ||
+        m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID)
     {
+        event_handler_critical_section_end();
         return NRF_ERROR_NOT_FOUND;
     }
-
-    uint16_t data_index = m_handle_cache[handle_index].data_entry;
-
-    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    data_entry_t* p_data_entry = &m_data_cache[m_handle_cache[handle_index].data_entry];
+    p_stats->tx = p_data_entry->tx_count;
+    p_stats->rx_consistent = p_data_entry->rx_consistent_count;
+    p_stats->rx_inconsistent = p_data_entry->rx_inconsistent_count;
+    p_stats->trickle_reset = p_data_entry->trickle.reset_count;
+    if (reset)
     {
-        return NRF_ERROR_NOT_FOUND;
+        data_entry_stats_clear(p_data_entry);
     }
-
-    trickle_rx_consistent(&m_data_cache[data_index].trickle, timestamp);
+    event_handler_critical_section_end();
 
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
 
-uint32_t handle_storage_rx_inconsistent(uint16_t handle, uint32_t timestamp)
+uint32_t handle_storage_ttl_set(uint16_t handle, uint16_t ttl_ticks)
 {
+#ifdef RBC_MESH_VALUE_TTL
     if (handle == RBC_MESH_INVALID_HANDLE)
     {
         return NRF_ERROR_INVALID_ADDR;
@@ -621,93 +2500,215 @@ uint32_t handle_storage_rx_inconsistent(uint16_t handle, uint32_t timestamp)
     uint16_t handle_index = handle_entry_get(handle, true);
     if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
     {
-        return NRF_ERROR_NOT_FOUND;
+        handle_index = handle_entry_to_head(handle);
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
     }
 
-    uint16_t data_index = m_handle_cache[handle_index].data_entry;
-
-    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    m_handle_cache[handle_index].ttl = ttl_ticks;
+    if (m_handle_cache[handle_index].data_entry != DATA_CACHE_ENTRY_INVALID)
     {
-        return NRF_ERROR_NOT_FOUND;
+        m_data_cache[m_handle_cache[handle_index].data_entry].ttl_left = ttl_ticks;
     }
-
-    trickle_rx_inconsistent(&m_data_cache[data_index].trickle, timestamp);
-
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
-uint32_t handle_storage_next_timeout_get(bool* p_found_value)
+
+uint32_t handle_storage_ttl_tick(handle_storage_expiry_cb_t callback)
 {
-    uint32_t time_earliest = 0;
-    *p_found_value = false;
-    for (uint32_t i = 0; i < RBC_MESH_DATA_CACHE_ENTRIES; ++i)
+    uint32_t expired = 0;
+#ifdef RBC_MESH_VALUE_TTL
+    for (uint32_t i = 0; i < m_data_cache_size; ++i)
     {
-        if (trickle_is_enabled(&m_data_cache[i].trickle) &&
-            m_data_cache[i].p_packet != NULL &&
-            (!(*p_found_value) || TIMER_OLDER_THAN(m_data_cache[i].trickle.t, time_earliest)))
+        uint16_t handle_index = m_data_cache[i].handle_entry;
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID ||
+            m_handle_cache[handle_index].ttl == 0 ||
+            !DATA_ENTRY_HAS_VALUE(&m_data_cache[i]))
         {
-            *p_found_value = true;
-            time_earliest = m_data_cache[i].trickle.t;
+            continue;
+        }
+        if (m_data_cache[i].ttl_left > 0)
+        {
+            m_data_cache[i].ttl_left--;
+            continue;
+        }
+
+        /* The handle entry stays, so the expired version isn't taken for a
+           new one when other nodes still have it. */
+        rbc_mesh_value_handle_t handle = m_handle_cache[handle_index].handle;
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+        if (m_handle_cache[handle_index].persistent)
+        {
+            value_flash_remove(handle);
+        }
+#endif
+#ifdef RBC_MESH_STATIC_HANDLES
+#ifdef RBC_MESH_VALUE_SHADOW
+        mesh_shadow_invalidate(handle);
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+        value_retain_remove(handle);
+#endif
+        data_entry_free(&m_data_cache[i]);
+#else
+        data_entry_release(handle_index);
+#endif
+        expired++;
+        if (callback != NULL)
+        {
+            callback(handle);
         }
     }
-    return time_earliest;
+#endif
+    return expired;
 }
 
-uint32_t handle_storage_tx_packets_get(uint32_t time_now, mesh_packet_t** pp_packets, uint32_t* p_count)
+uint32_t handle_storage_write_combine_set(uint16_t handle, uint16_t window_ms)
 {
-    /* Continue where we left off */
-    static uint16_t data_index = 0;
-
-    uint32_t count = 0;
-
-    for (uint32_t i = 0; i < RBC_MESH_DATA_CACHE_ENTRIES; ++i)
+#ifdef RBC_MESH_WRITE_COMBINING
+    if (handle == RBC_MESH_INVALID_HANDLE)
     {
-        while (data_index >= RBC_MESH_DATA_CACHE_ENTRIES)
-            data_index -= RBC_MESH_DATA_CACHE_ENTRIES;
+        return NRF_ERROR_INVALID_ADDR;
+    }
 
-        if ((m_data_cache[data_index].p_packet != NULL) &&
-            (trickle_is_enabled(&m_data_cache[data_index].trickle)) &&
-            !TIMER_OLDER_THAN(time_now, m_data_cache[data_index].trickle.t))
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        handle_index = handle_entry_to_head(handle);
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
         {
-            bool do_tx = false;
-            trickle_tx_timeout(&m_data_cache[data_index].trickle, &do_tx, time_now);
-            if (do_tx)
-            {
-                mesh_packet_ref_count_inc(m_data_cache[data_index].p_packet); /* return the packet with an additional reference */
-                pp_packets[count++] = m_data_cache[data_index].p_packet;
-                if (count == *p_count)
-                {
-                    /* packet array is full */
-                    data_index++;
-                    return NRF_SUCCESS;
-                }
-            }
+            return NRF_ERROR_NO_MEM;
         }
-        data_index++;
     }
-    *p_count = count;
 
+    m_handle_cache[handle_index].combine_window_ms = window_ms;
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
 
-uint32_t handle_storage_transmitted(uint16_t handle, uint32_t timestamp)
+uint32_t handle_storage_hop_scope_set(uint16_t handle, uint8_t hops)
 {
+#ifdef RBC_MESH_HOP_SCOPES
     if (handle == RBC_MESH_INVALID_HANDLE)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
+    if (hops == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
 
     uint16_t handle_index = handle_entry_get(handle, true);
     if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+    {
+        handle_index = handle_entry_to_head(handle);
+        if (handle_index == HANDLE_CACHE_ENTRY_INVALID)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+
+    m_handle_cache[handle_index].hop_scope = hops;
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t handle_storage_hops_left_raise(uint16_t handle, uint16_t version, uint8_t hops_left)
+{
+#ifdef RBC_MESH_HOP_SCOPES
+    uint16_t handle_index = handle_entry_get(handle, true);
+    if (handle_index == HANDLE_CACHE_ENTRY_INVALID ||
+        m_handle_cache[handle_index].data_entry == DATA_CACHE_ENTRY_INVALID ||
+        m_handle_cache[handle_index].version != version)
     {
         return NRF_ERROR_NOT_FOUND;
     }
 
     uint16_t data_index = m_handle_cache[handle_index].data_entry;
-    if (data_index == DATA_CACHE_ENTRY_INVALID)
+    data_entry_t* p_data_entry = &m_data_cache[data_index];
+    if (!DATA_ENTRY_HAS_VALUE(p_data_entry) ||
+        p_data_entry->hops_left == RBC_MESH_HOP_SCOPE_UNLIMITED ||
+        (hops_left != RBC_MESH_HOP_SCOPE_UNLIMITED && hops_left <= p_data_entry->hops_left))
     {
-        return NRF_ERROR_NOT_FOUND;
+        return NRF_SUCCESS;
     }
-    trickle_tx_register(&m_data_cache[data_index].trickle, timestamp);
 
+    p_data_entry->hops_left = hops_left;
+#ifndef RBC_MESH_COMPACT_VALUE_STORE
+    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_data_entry->p_packet);
+    if (p_adv != NULL)
+    {
+        p_adv->hops_left = hops_left;
+    }
+#endif
+    data_entry_tx_heap_update(data_index);
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t handle_storage_compact(void)
+{
+#ifdef CACHE_COMPACTION
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    if (value_flash_is_compacting())
+    {
+        /* the flash compaction walks the persistent values by cache index */
+        return NRF_ERROR_BUSY;
+    }
+#endif
+    event_handler_critical_section_begin();
+    /* The handle index is rebuilt afterwards, and has more slots than there
+       are handle entries. The popped list is only used in a TX round. */
+    uint16_t* p_handle_map = m_handle_index;
+    uint16_t* p_data_map = m_tx_popped;
+    if (!compact_maps_get(p_handle_map, p_data_map))
+    {
+        for (uint16_t i = 0; i < m_handle_cache_size; ++i)
+        {
+            handle_entry_t* p_entry = &m_handle_cache[i];
+            p_entry->index_next = compact_index_map(p_handle_map, p_entry->index_next, m_handle_cache_size);
+            p_entry->index_prev = compact_index_map(p_handle_map, p_entry->index_prev, m_handle_cache_size);
+            p_entry->data_entry = compact_index_map(p_data_map, p_entry->data_entry, m_data_cache_size);
+        }
+        m_handle_cache_head = compact_index_map(p_handle_map, m_handle_cache_head, m_handle_cache_size);
+        m_handle_cache_tail = compact_index_map(p_handle_map, m_handle_cache_tail, m_handle_cache_size);
+
+        for (uint16_t i = 0; i < m_data_cache_size; ++i)
+        {
+            data_entry_t* p_entry = &m_data_cache[i];
+            p_entry->handle_entry = compact_index_map(p_handle_map, p_entry->handle_entry, m_handle_cache_size);
+            p_entry->lru_prev = compact_index_map(p_data_map, p_entry->lru_prev, m_data_cache_size);
+            p_entry->lru_next = compact_index_map(p_data_map, p_entry->lru_next, m_data_cache_size);
+        }
+        m_data_free_head = compact_index_map(p_data_map, m_data_free_head, m_data_cache_size);
+        for (uint32_t i = 0; i < DATA_QUEUE_COUNT; ++i)
+        {
+            m_data_lru[i].head = compact_index_map(p_data_map, m_data_lru[i].head, m_data_cache_size);
+            m_data_lru[i].tail = compact_index_map(p_data_map, m_data_lru[i].tail, m_data_cache_size);
+        }
+        /* the heap keeps its order, the entries just have new indexes */
+        for (uint32_t i = 0; i < m_tx_heap_count; ++i)
+        {
+            m_tx_heap[i] = compact_index_map(p_data_map, m_tx_heap[i], m_data_cache_size);
+        }
+
+        compact_entries_move(m_handle_cache, sizeof(handle_entry_t), p_handle_map, m_handle_cache_size);
+        compact_entries_move(m_data_cache, sizeof(data_entry_t), p_data_map, m_data_cache_size);
+    }
+    handle_index_rebuild();
+    event_handler_critical_section_end();
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
@@ -0,0 +1,148 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+#include "isr_stats.h"
+#include "nrf_error.h"
+
+#if defined(RBC_MESH_ISR_STATS) && !defined(BOOTLOADER)
+
+#include "timeslot.h"
+#include "toolchain.h"
+#include <string.h>
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static rbc_mesh_isr_stats_t m_isr_stats[RBC_MESH_ISR_COUNT];
+static timestamp_t m_pend_time[RBC_MESH_ISR_COUNT];
+static uint32_t m_pended; /**< Bitmask of the handlers with a pend time. */
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static void hist_add(uint16_t* p_hist, uint16_t* p_max, uint32_t time_us)
+{
+    uint32_t bucket = 0;
+    uint32_t limit = RBC_MESH_ISR_HIST_FIRST_US;
+    while (time_us > limit && bucket < RBC_MESH_ISR_HIST_BUCKETS - 1)
+    {
+        limit <<= 1;
+        bucket++;
+    }
+    if (p_hist[bucket] < 0xFFFF)
+    {
+        p_hist[bucket]++;
+    }
+    if (time_us > *p_max)
+    {
+        *p_max = (time_us > 0xFFFF) ? 0xFFFF : (uint16_t) time_us;
+    }
+}
+
+/** Whether the timestamp was taken in the ongoing timeslot. */
+static bool in_this_timeslot(timestamp_t time)
+{
+    return (timeslot_is_in_ts() && (int32_t) (time - timeslot_start_time_get()) >= 0);
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+timestamp_t isr_stats_begin(rbc_mesh_isr_t isr)
+{
+    timestamp_t now = timer_now();
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    bool pended = ((m_pended & (1 << isr)) != 0);
+    timestamp_t pend_time = m_pend_time[isr];
+    m_pended &= ~(1 << isr);
+    _ENABLE_IRQS(was_masked);
+
+    if (pended && in_this_timeslot(pend_time))
+    {
+        hist_add(m_isr_stats[isr].latency_hist, &m_isr_stats[isr].latency_max_us, TIMER_DIFF(now, pend_time));
+    }
+    return now;
+}
+
+void isr_stats_end(rbc_mesh_isr_t isr, timestamp_t start)
+{
+    if (!in_this_timeslot(start))
+    {
+        return;
+    }
+    uint32_t duration = TIMER_DIFF(timer_now(), start);
+    hist_add(m_isr_stats[isr].duration_hist, &m_isr_stats[isr].duration_max_us, duration);
+    if (duration > timeslot_end_margin_get() && m_isr_stats[isr].margin_overruns < 0xFFFF)
+    {
+        m_isr_stats[isr].margin_overruns++;
+    }
+}
+
+void isr_stats_latency(rbc_mesh_isr_t isr, timestamp_t trigger_time)
+{
+    timestamp_t now = timer_now();
+    /* the timer may fire a tick early */
+    if (in_this_timeslot(trigger_time) && (int32_t) (now - trigger_time) >= 0)
+    {
+        hist_add(m_isr_stats[isr].latency_hist, &m_isr_stats[isr].latency_max_us, now - trigger_time);
+    }
+}
+
+void isr_stats_pend(rbc_mesh_isr_t isr)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (!(m_pended & (1 << isr)))
+    {
+        m_pend_time[isr] = timer_now();
+        m_pended |= (1 << isr);
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+uint32_t isr_stats_get(rbc_mesh_isr_t isr, rbc_mesh_isr_stats_t* p_stats, bool reset)
+{
+    if (isr >= RBC_MESH_ISR_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    memcpy(p_stats, &m_isr_stats[isr], sizeof(rbc_mesh_isr_stats_t));
+    if (reset)
+    {
+        memset(&m_isr_stats[isr], 0, sizeof(rbc_mesh_isr_stats_t));
+    }
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
+}
+
+#endif
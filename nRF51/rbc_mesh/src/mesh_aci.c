@@ -41,9 +41,14 @@
 #include "transport.h"
 #include "bootloader.h"
 #else
+#include "version_handler.h"
 #ifdef MESH_DFU
 #include "dfu_app.h"
 #include "dfu_types_mesh.h"
+#include "mesh_flash.h"
+#endif
+#ifdef RBC_MESH_SNIFFER
+#include "mesh_sniffer.h"
 #endif
 #endif
 
@@ -54,6 +59,73 @@
 /* event push isn't present in the API header file. */
 extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
 
+/*****************************************************************************
+ * Static types
+ *****************************************************************************/
+
+/** @brief Update event waiting for room in the serial queue. */
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;
+    uint8_t data_len;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} pending_update_t;
+
+/** @brief Drop counts for the next overflow event. Kept apart from the packed
+    event parameters to allow counting through aligned pointers. */
+typedef struct
+{
+    uint16_t dropped_new;
+    uint16_t dropped_update;
+    uint16_t dropped_conflicting;
+    uint16_t dropped_tx;
+    uint16_t coalesced_update;
+} overflow_count_t;
+
+/** @brief Receive window of the windowed serial DFU. */
+typedef struct
+{
+    uint8_t next_seq;   /**< Sequence number of the next packet to accept. */
+    uint8_t edge;       /**< End of the window given in the last acknowledgement. */
+    uint8_t unacked;    /**< Packets accepted since the last acknowledgement. */
+    bool gap_reported;  /**< A packet out of sequence has been reported since the last accepted packet. */
+} dfu_window_t;
+
+/*****************************************************************************
+ * Static globals
+ *****************************************************************************/
+
+static uint8_t m_evt_mask = ACI_EVT_MASK_ALL;
+/** Update events that didn't fit in the serial queue, oldest first. */
+static pending_update_t m_pending_updates[MESH_ACI_PENDING_UPDATE_COUNT];
+static uint32_t m_pending_update_count;
+static overflow_count_t m_overflow;
+static bool m_overflow_pending;
+#if defined(BOOTLOADER) || defined(MESH_DFU)
+static dfu_window_t m_dfu_window;
+#endif
+#ifndef BOOTLOADER
+static bool m_snapshot_active;
+static uint32_t m_snapshot_iterator;
+static uint16_t m_snapshot_count;
+static aci_evt_format_t m_evt_format = ACI_EVT_FORMAT_FULL;
+/** Compact event being filled. It's sent when the next record doesn't fit,
+    or when the event handler gets to the flush. */
+static serial_evt_t m_compact_evt;
+static uint8_t m_compact_len;
+static rbc_mesh_value_handle_t m_compact_prev_handle;
+static bool m_compact_flush_pending;
+/** Handle shard forwarded to the host, all handles when the count is 0 or 1. */
+static uint8_t m_shard_count;
+static uint8_t m_shard_index;
+/** Value history being streamed to the host. */
+static bool m_history_active;
+static rbc_mesh_value_handle_t m_history_handle;
+static uint16_t m_history_version;
+static uint8_t m_history_count;
+#endif
+
 #if (NORDIC_SDK_VERSION >= 11) 
 const nrf_clock_lf_cfg_t defaultClockSource = {.source        = NRF_CLOCK_LF_SRC_RC,   \
                                                .rc_ctiv       = 16,                    \
@@ -90,6 +162,765 @@ static aci_status_code_t error_code_translate(uint32_t nrf_error_code)
     }
 }
 
+static void drop_count_inc(uint16_t* p_count)
+{
+    if (*p_count < UINT16_MAX)
+    {
+        (*p_count)++;
+    }
+    m_overflow_pending = true;
+}
+
+/**
+* @brief Store an update event until there's room in the serial queue. Replaces
+*   any waiting update to the same handle, as the host only needs its newest
+*   state.
+*/
+static bool pending_update_put(rbc_mesh_value_handle_t handle, uint16_t version, uint8_t* p_data, uint8_t data_len)
+{
+    pending_update_t* p_update = NULL;
+    for (uint32_t i = 0; i < m_pending_update_count; ++i)
+    {
+        if (m_pending_updates[i].handle == handle)
+        {
+            p_update = &m_pending_updates[i];
+            drop_count_inc(&m_overflow.coalesced_update);
+            break;
+        }
+    }
+    if (p_update == NULL)
+    {
+        if (m_pending_update_count >= MESH_ACI_PENDING_UPDATE_COUNT)
+        {
+            return false;
+        }
+        p_update = &m_pending_updates[m_pending_update_count++];
+        p_update->handle = handle;
+    }
+    p_update->version = version;
+    p_update->data_len = data_len;
+    memcpy(p_update->data, p_data, data_len);
+    return true;
+}
+
+/**
+* @brief Fill a value event, as a versioned event in the versioned event
+*   format. TX events have no version, and are always sent as they are.
+*/
+static void value_evt_fill(serial_evt_t* p_evt,
+        serial_evt_opcode_t opcode,
+        rbc_mesh_value_handle_t handle,
+        uint16_t version,
+        const uint8_t* p_data,
+        uint8_t data_len)
+{
+#ifndef BOOTLOADER
+    if (m_evt_format == ACI_EVT_FORMAT_VERSIONED && opcode != SERIAL_EVT_OPCODE_EVENT_TX)
+    {
+        p_evt->opcode = SERIAL_EVT_OPCODE_EVENT_VERSIONED;
+        p_evt->length = 6 + data_len;
+        p_evt->params.event_versioned.event_opcode = opcode;
+        p_evt->params.event_versioned.handle = handle;
+        p_evt->params.event_versioned.version = version;
+        memcpy(p_evt->params.event_versioned.data, p_data, data_len);
+        return;
+    }
+#endif
+    /* all event parameter types are the same, just use event_update for all */
+    p_evt->opcode = opcode;
+    p_evt->length = 3 + data_len;
+    p_evt->params.event_update.handle = handle;
+    memcpy(p_evt->params.event_update.data, p_data, data_len);
+}
+
+/** @brief Whether the handle is in the shard forwarded to the host. */
+static bool shard_has_handle(rbc_mesh_value_handle_t handle)
+{
+#ifndef BOOTLOADER
+    return (m_shard_count <= 1 || (handle % m_shard_count) == m_shard_index);
+#else
+    return true;
+#endif
+}
+
+#ifndef BOOTLOADER
+static uint32_t compact_varint_len(uint32_t value)
+{
+    uint32_t len = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        len++;
+    }
+    return len;
+}
+
+static void compact_varint_put(uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        m_compact_evt.params.event_compact.records[m_compact_len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    m_compact_evt.params.event_compact.records[m_compact_len++] = (uint8_t) value;
+}
+
+/**
+* @brief Send the compact event, if it holds any records. Must be called with
+*   IRQs disabled.
+*
+* @return Whether the compact event is empty.
+*/
+static bool compact_send(void)
+{
+    if (m_compact_len == 0)
+    {
+        return true;
+    }
+    m_compact_evt.opcode = SERIAL_EVT_OPCODE_EVENT_COMPACT;
+    m_compact_evt.length = 1 + m_compact_len;
+    if (!serial_handler_event_send(&m_compact_evt))
+    {
+        return false;
+    }
+    m_compact_len = 0;
+    return true;
+}
+
+static void compact_flush_cb(void* p_context)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_compact_flush_pending = false;
+    /* picked up again in mesh_aci_event_flush() if the queue is full */
+    (void) compact_send();
+    _ENABLE_IRQS(was_masked);
+}
+
+/**
+* @brief Add a value event to the compact event, sending the compact event
+*   first if the record doesn't fit. Values too long for a record are sent as
+*   the given full event. Must be called with IRQs disabled.
+*
+* @return Whether the event was queued.
+*/
+static bool compact_put(serial_evt_t* p_full_evt, uint16_t version_delta)
+{
+    uint8_t type;
+    switch (p_full_evt->opcode)
+    {
+        case SERIAL_EVT_OPCODE_EVENT_NEW:
+            type = SERIAL_EVT_COMPACT_TYPE_NEW;
+            break;
+        case SERIAL_EVT_OPCODE_EVENT_UPDATE:
+            type = SERIAL_EVT_COMPACT_TYPE_UPDATE;
+            break;
+        case SERIAL_EVT_OPCODE_EVENT_CONFLICTING:
+            type = SERIAL_EVT_COMPACT_TYPE_CONFLICTING;
+            break;
+        default:
+            type = SERIAL_EVT_COMPACT_TYPE_TX;
+    }
+    rbc_mesh_value_handle_t handle = p_full_evt->params.event_update.handle;
+    uint8_t data_len = p_full_evt->length - 3;
+    bool next_handle = (m_compact_len > 0 && handle == (rbc_mesh_value_handle_t) (m_compact_prev_handle + 1));
+    uint32_t fixed_len = 1 + (data_len >= SERIAL_EVT_COMPACT_LEN_EXT ? 1 : 0) + data_len +
+        (type != SERIAL_EVT_COMPACT_TYPE_TX ? compact_varint_len(version_delta) : 0);
+    uint32_t handle_len = compact_varint_len(handle);
+
+    if (fixed_len + handle_len > SERIAL_EVT_COMPACT_MAX_LEN)
+    {
+        return (compact_send() && serial_handler_event_send(p_full_evt));
+    }
+    if (m_compact_len + fixed_len + (next_handle ? 0 : handle_len) > SERIAL_EVT_COMPACT_MAX_LEN)
+    {
+        if (!compact_send())
+        {
+            return false;
+        }
+        next_handle = false;
+    }
+
+    uint8_t* p_records = m_compact_evt.params.event_compact.records;
+    p_records[m_compact_len++] = (type << SERIAL_EVT_COMPACT_TYPE_POS) |
+                                 (next_handle ? SERIAL_EVT_COMPACT_FLAG_NEXT_HANDLE : 0) |
+                                 (data_len >= SERIAL_EVT_COMPACT_LEN_EXT ? SERIAL_EVT_COMPACT_LEN_EXT : data_len);
+    if (data_len >= SERIAL_EVT_COMPACT_LEN_EXT)
+    {
+        p_records[m_compact_len++] = data_len;
+    }
+    if (!next_handle)
+    {
+        compact_varint_put(handle);
+    }
+    if (type != SERIAL_EVT_COMPACT_TYPE_TX)
+    {
+        compact_varint_put(version_delta);
+    }
+    memcpy(&p_records[m_compact_len], p_full_evt->params.event_update.data, data_len);
+    m_compact_len += data_len;
+    m_compact_prev_handle = handle;
+
+    if (!m_compact_flush_pending)
+    {
+        /* events that come in before the flush share the compact event */
+        async_event_t async_evt;
+        async_evt.type = EVENT_TYPE_GENERIC;
+        async_evt.callback.generic.cb = compact_flush_cb;
+        async_evt.callback.generic.p_context = NULL;
+        m_compact_flush_pending = (event_handler_push(&async_evt) == NRF_SUCCESS);
+        if (!m_compact_flush_pending)
+        {
+            (void) compact_send();
+        }
+    }
+    return true;
+}
+#endif
+
+/**
+* @brief Send waiting updates, then the overflow event. Must be called with
+*   IRQs disabled.
+*
+* @return Whether everything was sent.
+*/
+static bool event_flush(void)
+{
+    serial_evt_t serial_evt;
+#ifndef BOOTLOADER
+    /* the compact event is older than the waiting events */
+    if ((m_pending_update_count > 0 || m_overflow_pending) && !compact_send())
+    {
+        return false;
+    }
+#endif
+    while (m_pending_update_count > 0)
+    {
+        value_evt_fill(&serial_evt,
+                       SERIAL_EVT_OPCODE_EVENT_UPDATE,
+                       m_pending_updates[0].handle,
+                       m_pending_updates[0].version,
+                       m_pending_updates[0].data,
+                       m_pending_updates[0].data_len);
+        if (!serial_handler_event_send(&serial_evt))
+        {
+            return false;
+        }
+        m_pending_update_count--;
+        memmove(&m_pending_updates[0],
+                &m_pending_updates[1],
+                m_pending_update_count * sizeof(pending_update_t));
+    }
+
+    if (m_overflow_pending)
+    {
+        serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_OVERFLOW;
+        serial_evt.length = 1 + sizeof(serial_evt_params_event_overflow_t);
+        serial_evt.params.event_overflow.dropped_new         = m_overflow.dropped_new;
+        serial_evt.params.event_overflow.dropped_update      = m_overflow.dropped_update;
+        serial_evt.params.event_overflow.dropped_conflicting = m_overflow.dropped_conflicting;
+        serial_evt.params.event_overflow.dropped_tx          = m_overflow.dropped_tx;
+        serial_evt.params.event_overflow.coalesced_update    = m_overflow.coalesced_update;
+        if (!serial_handler_event_send(&serial_evt))
+        {
+            return false;
+        }
+        memset(&m_overflow, 0, sizeof(m_overflow));
+        m_overflow_pending = false;
+    }
+    return true;
+}
+
+#ifndef BOOTLOADER
+/**
+* @brief Stream the next values of a mirror snapshot, until the serial queue is
+*   full. Values are read when their event is queued, so an update queued
+*   before a value's snapshot event is never newer than the snapshot.
+*/
+static void snapshot_continue(void)
+{
+    /* updates in the compact event may be older than the values read here */
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    bool compact_sent = compact_send();
+    _ENABLE_IRQS(was_masked);
+    if (!compact_sent)
+    {
+        return;
+    }
+
+    serial_evt_t serial_evt;
+    while (m_snapshot_active)
+    {
+        uint32_t iterator = m_snapshot_iterator;
+        rbc_mesh_value_handle_t handle;
+        uint16_t version;
+        uint16_t length = RBC_MESH_VALUE_MAX_LEN;
+        if (vh_value_next_get(&iterator,
+                    &handle,
+                    &version,
+                    serial_evt.params.event_snapshot.data,
+                    &length) == NRF_SUCCESS)
+        {
+            if (!shard_has_handle(handle))
+            {
+                m_snapshot_iterator = iterator;
+                continue;
+            }
+            serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_SNAPSHOT;
+            serial_evt.length = 5 + length;
+            serial_evt.params.event_snapshot.handle = handle;
+            serial_evt.params.event_snapshot.version = version;
+            if (!serial_handler_event_send(&serial_evt))
+            {
+                /* picked up again in mesh_aci_event_flush() */
+                return;
+            }
+            m_snapshot_iterator = iterator;
+            m_snapshot_count++;
+        }
+        else
+        {
+            serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_SNAPSHOT_END;
+            serial_evt.length = 1 + sizeof(serial_evt_params_event_snapshot_end_t);
+            serial_evt.params.event_snapshot_end.count = m_snapshot_count;
+            if (!serial_handler_event_send(&serial_evt))
+            {
+                return;
+            }
+            m_snapshot_active = false;
+        }
+    }
+}
+
+/**
+* @brief Stream the next versions of a value history, until the serial queue is
+*   full. Each version is looked up after the last one sent, so versions that
+*   leave the history while it's streamed are skipped, not sent twice.
+*/
+static void history_continue(void)
+{
+    serial_evt_t serial_evt;
+    while (m_history_active)
+    {
+        rbc_mesh_history_entry_t entry;
+        if (rbc_mesh_value_history_get(m_history_handle, m_history_version, &entry) == NRF_SUCCESS)
+        {
+            serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_HISTORY;
+            serial_evt.length = 9 + entry.data_len;
+            serial_evt.params.event_history.handle = m_history_handle;
+            serial_evt.params.event_history.version = entry.version;
+            serial_evt.params.event_history.timestamp = entry.timestamp_us;
+            memcpy(serial_evt.params.event_history.data, entry.data, entry.data_len);
+            if (!serial_handler_event_send(&serial_evt))
+            {
+                /* picked up again in mesh_aci_event_flush() */
+                return;
+            }
+            m_history_version = entry.version;
+            m_history_count++;
+        }
+        else
+        {
+            serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_HISTORY_END;
+            serial_evt.length = 1 + sizeof(serial_evt_params_event_history_end_t);
+            serial_evt.params.event_history_end.handle = m_history_handle;
+            serial_evt.params.event_history_end.count = m_history_count;
+            serial_evt.params.event_history_end.time_now = timer_now();
+            if (!serial_handler_event_send(&serial_evt))
+            {
+                return;
+            }
+            m_history_active = false;
+        }
+    }
+}
+#endif
+
+static uint32_t flag_set_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    switch ((aci_flag_t) p_serial_cmd->params.flag_set.flag)
+    {
+        case ACI_FLAG_PERSISTENT:
+#ifdef BOOTLOADER
+            return NRF_ERROR_INVALID_PARAM;
+#else
+            return rbc_mesh_persistence_set(p_serial_cmd->params.flag_set.handle,
+                    p_serial_cmd->params.flag_set.value);
+#endif
+
+        case ACI_FLAG_TX_EVENT:
+#ifdef BOOTLOADER
+            transport_tx_evt_set(
+                    p_serial_cmd->params.flag_set.handle,
+                    p_serial_cmd->params.flag_set.value);
+            return NRF_SUCCESS;
+#else
+            return rbc_mesh_tx_event_set(
+                    p_serial_cmd->params.flag_set.handle,
+                    p_serial_cmd->params.flag_set.value);
+#endif
+
+        case ACI_FLAG_TRICKLE_CLASS:
+#ifdef BOOTLOADER
+            return NRF_ERROR_INVALID_PARAM;
+#else
+            return rbc_mesh_trickle_class_set(
+                    p_serial_cmd->params.flag_set.handle,
+                    p_serial_cmd->params.flag_set.value);
+#endif
+
+        case ACI_FLAG_URGENT:
+#ifdef BOOTLOADER
+            return NRF_ERROR_INVALID_PARAM;
+#else
+            return rbc_mesh_urgent_flag_set(
+                    p_serial_cmd->params.flag_set.handle,
+                    p_serial_cmd->params.flag_set.value);
+#endif
+
+        case ACI_FLAG_HISTORY:
+#ifdef BOOTLOADER
+            return NRF_ERROR_INVALID_PARAM;
+#else
+            /* a history can't be turned off again */
+            if (!p_serial_cmd->params.flag_set.value)
+            {
+                return NRF_ERROR_INVALID_PARAM;
+            }
+            return rbc_mesh_value_history_enable(p_serial_cmd->params.flag_set.handle);
+#endif
+        default:
+            return NRF_ERROR_INVALID_PARAM;
+    }
+}
+
+#ifndef BOOTLOADER
+static uint32_t value_set_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    if (p_serial_cmd->length > sizeof(serial_cmd_params_value_set_t) + 1 ||
+        p_serial_cmd->length < sizeof(rbc_mesh_value_handle_t) + 1)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    mesh_packet_t* p_packet;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    const uint8_t data_len = p_serial_cmd->length - 1 - sizeof(rbc_mesh_value_handle_t);
+    uint32_t error_code = rbc_mesh_value_set(p_serial_cmd->params.value_set.handle,
+            p_serial_cmd->params.value_set.value,
+            data_len);
+
+    /* notify application */
+    if (error_code == NRF_SUCCESS)
+    {
+        rbc_mesh_event_t app_evt;
+        memcpy(p_packet->payload, p_serial_cmd->params.value_set.value, data_len);
+        memset(&app_evt, 0, sizeof(app_evt));
+        app_evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+        app_evt.params.rx.p_data = p_packet->payload;
+        app_evt.params.rx.data_len = data_len;
+        app_evt.params.rx.value_handle = p_serial_cmd->params.value_set.handle;
+        app_evt.params.rx.timestamp_us = timer_now();
+        app_evt.params.rx.source = RBC_MESH_EVENT_SOURCE_SERIAL;
+
+        error_code = rbc_mesh_event_push(&app_evt);
+    }
+    mesh_packet_ref_count_dec(p_packet);
+
+    return error_code;
+}
+
+/**
+* Set all values of a values set command in one batch, and notify the
+* application of each of them like a single value set does.
+*/
+static uint32_t values_set_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    rbc_mesh_value_handle_t handles[SERIAL_CMD_VALUES_SET_MAX_COUNT];
+    uint8_t* p_data[SERIAL_CMD_VALUES_SET_MAX_COUNT];
+    uint16_t lengths[SERIAL_CMD_VALUES_SET_MAX_COUNT];
+    uint32_t count = 0;
+
+    uint8_t* p_values = p_serial_cmd->params.values_set.values;
+    const uint32_t values_len = p_serial_cmd->length - 1; /* opcode */
+    uint32_t offset = 0;
+    while (offset < values_len)
+    {
+        if (offset + 3 > values_len ||
+            offset + 3 + p_values[offset + 2] > values_len)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        handles[count] = p_values[offset] | (p_values[offset + 1] << 8);
+        lengths[count] = p_values[offset + 2];
+        p_data[count] = &p_values[offset + 3];
+        offset += 3 + lengths[count];
+        count++;
+    }
+    if (count == 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t error_code = rbc_mesh_values_set(handles, p_data, lengths, count);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    /* notify application */
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mesh_packet_t* p_packet;
+        if (!mesh_packet_acquire(&p_packet))
+        {
+            break;
+        }
+        rbc_mesh_event_t app_evt;
+        memcpy(p_packet->payload, p_data[i], lengths[i]);
+        memset(&app_evt, 0, sizeof(app_evt));
+        app_evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+        app_evt.params.rx.p_data = p_packet->payload;
+        app_evt.params.rx.data_len = lengths[i];
+        app_evt.params.rx.value_handle = handles[i];
+        app_evt.params.rx.timestamp_us = timer_now();
+        app_evt.params.rx.source = RBC_MESH_EVENT_SOURCE_SERIAL;
+        (void) rbc_mesh_event_push(&app_evt);
+        mesh_packet_ref_count_dec(p_packet);
+    }
+    return NRF_SUCCESS;
+}
+
+static void value_get_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    serial_evt_t serial_evt;
+    serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+    serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+    serial_evt.length = RBC_MESH_VALUE_MAX_LEN; /* signal to the framework that we can fit the entire payload in our buffer */
+
+    if (p_serial_cmd->length != sizeof(serial_cmd_params_value_get_t) + 1)
+    {
+        serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+        serial_evt.length = 3;
+    }
+    else
+    {
+        uint32_t error_code = rbc_mesh_value_get(p_serial_cmd->params.value_get.handle,
+                serial_evt.params.cmd_rsp.response.val_get.data,
+                (uint16_t*) &serial_evt.length);
+
+        serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+
+        serial_evt.params.cmd_rsp.response.val_get.handle = p_serial_cmd->params.value_get.handle;
+        serial_evt.length += 1 + 1 + 1 + 2 ; /* opcode + command + status + handle */
+    }
+
+    serial_handler_event_send(&serial_evt);
+}
+
+/**
+* Execute the commands in a batch in order, stopping at the first failing
+* command. Value and flag sets are acknowledged by the single batch response,
+* value gets still produce their own response with the value.
+*/
+static void batch_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    serial_evt_t serial_evt;
+    serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+    serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+    serial_evt.length = 3;
+
+    if (p_serial_cmd->length < 2)
+    {
+        serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+        serial_handler_event_send(&serial_evt);
+        return;
+    }
+
+    const uint8_t* p_commands = p_serial_cmd->params.batch.commands;
+    const uint32_t commands_len = p_serial_cmd->length - 2; /* opcode + token */
+    uint32_t offset = 0;
+    uint8_t count = 0;
+    uint32_t error_code = NRF_SUCCESS;
+
+    while (offset < commands_len)
+    {
+        const uint8_t cmd_len = p_commands[offset];
+        if (cmd_len == 0 || offset + 1 + cmd_len > commands_len)
+        {
+            error_code = NRF_ERROR_INVALID_LENGTH;
+            break;
+        }
+
+        serial_cmd_t cmd;
+        memcpy(&cmd, &p_commands[offset], cmd_len + 1);
+        switch (cmd.opcode)
+        {
+            case SERIAL_CMD_OPCODE_VALUE_SET:
+                error_code = value_set_cmd_handle(&cmd);
+                break;
+
+            case SERIAL_CMD_OPCODE_VALUE_GET:
+                value_get_cmd_handle(&cmd);
+                break;
+
+            case SERIAL_CMD_OPCODE_FLAG_SET:
+                if (cmd.length != sizeof(serial_cmd_params_flag_set_t) + 1)
+                {
+                    error_code = NRF_ERROR_INVALID_LENGTH;
+                }
+                else
+                {
+                    error_code = flag_set_cmd_handle(&cmd);
+                }
+                break;
+
+            default:
+                error_code = NRF_ERROR_NOT_SUPPORTED;
+        }
+
+        if (error_code != NRF_SUCCESS)
+        {
+            break;
+        }
+        count++;
+        offset += 1 + cmd_len;
+    }
+
+    serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+    serial_evt.params.cmd_rsp.response.batch.token = p_serial_cmd->params.batch.token;
+    serial_evt.params.cmd_rsp.response.batch.command_count = count;
+    serial_evt.length += sizeof(serial_evt_cmd_rsp_params_batch_t);
+    serial_handler_event_send(&serial_evt);
+}
+#endif /* BOOTLOADER */
+
+#if defined(BOOTLOADER) || defined(MESH_DFU)
+static uint32_t dfu_packet_handle(dfu_packet_t* p_packet, uint16_t length)
+{
+#ifdef BOOTLOADER
+    bl_cmd_t rx_cmd;
+    rx_cmd.type = BL_CMD_TYPE_RX;
+    rx_cmd.params.rx.p_dfu_packet = p_packet;
+    rx_cmd.params.rx.length = length;
+    return bootloader_cmd_send(&rx_cmd);
+#else
+    uint32_t error_code = dfu_rx(p_packet, length);
+    if (error_code != NRF_SUCCESS)
+    {
+        __LOG(RTT_CTRL_TEXT_RED "BL Responded with error 0x%x\n", error_code);
+    }
+    return error_code;
+#endif
+}
+
+/** Packets the host may send beyond the last accepted one, limited by the
+    room in the flash queue that the packets end up in. */
+static uint8_t dfu_window_credit_get(void)
+{
+#ifdef BOOTLOADER
+    uint32_t slots = bootloader_flash_available_slots();
+#else
+    uint32_t slots = mesh_flash_op_available_slots(MESH_FLASH_USER_DFU);
+#endif
+    if (slots <= MESH_ACI_DFU_FLASH_RESERVE)
+    {
+        return 0;
+    }
+    slots -= MESH_ACI_DFU_FLASH_RESERVE;
+    return (slots < MESH_ACI_DFU_WINDOW) ? slots : MESH_ACI_DFU_WINDOW;
+}
+
+static void dfu_window_ack_send(aci_status_code_t status)
+{
+    serial_evt_t serial_evt;
+    serial_evt.opcode = SERIAL_EVT_OPCODE_DFU_ACK;
+    serial_evt.length = 1 + sizeof(serial_evt_params_dfu_ack_t);
+    serial_evt.params.dfu_ack.next_seq = m_dfu_window.next_seq;
+    serial_evt.params.dfu_ack.credit = dfu_window_credit_get();
+    serial_evt.params.dfu_ack.status = status;
+    if (serial_handler_event_send(&serial_evt))
+    {
+        m_dfu_window.edge = m_dfu_window.next_seq + serial_evt.params.dfu_ack.credit;
+        m_dfu_window.unacked = 0;
+    }
+}
+
+/**
+* Accept windowed DFU packets in sequence, without a response to each. The
+* host learns what got through from cumulative acknowledgements, sent every
+* MESH_ACI_DFU_ACK_INTERVAL packets, at the end of the window and at the
+* first problem. Packets out of sequence are dropped, and the host goes back
+* to the first unaccepted packet, as it does when the flash queue is full.
+*/
+static void dfu_windowed_cmd_handle(serial_cmd_t* p_serial_cmd)
+{
+    if (p_serial_cmd->length < 2)
+    {
+        serial_evt_t serial_evt;
+        serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+        serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+        serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+        serial_evt.length = 3;
+        serial_handler_event_send(&serial_evt);
+        return;
+    }
+
+    const uint8_t seq = p_serial_cmd->params.dfu_windowed.seq;
+    if (p_serial_cmd->length == 2)
+    {
+        /* no packet, the host opens a new window */
+        m_dfu_window.next_seq = seq;
+        m_dfu_window.gap_reported = false;
+        dfu_window_ack_send(ACI_STATUS_SUCCESS);
+        return;
+    }
+
+    if (seq != m_dfu_window.next_seq)
+    {
+        /* A packet we already have means our acknowledgement got lost, and
+           is always answered. Report a gap ahead once, the rest of the window
+           will miss it too. */
+        if ((uint8_t) (m_dfu_window.next_seq - seq) <= MESH_ACI_DFU_WINDOW ||
+            !m_dfu_window.gap_reported)
+        {
+            m_dfu_window.gap_reported = true;
+            dfu_window_ack_send(ACI_STATUS_ERROR_INVALID_DATA);
+        }
+        return;
+    }
+
+    if (dfu_window_credit_get() == 0)
+    {
+        dfu_window_ack_send(ACI_STATUS_ERROR_BUSY);
+        return;
+    }
+
+    uint32_t error_code = dfu_packet_handle(&p_serial_cmd->params.dfu_windowed.packet,
+            p_serial_cmd->length - SERIAL_PACKET_OVERHEAD - 1);
+    if (error_code == NRF_ERROR_NO_MEM || error_code == NRF_ERROR_BUSY)
+    {
+        dfu_window_ack_send(ACI_STATUS_ERROR_BUSY);
+        return;
+    }
+
+    m_dfu_window.next_seq++;
+    m_dfu_window.unacked++;
+    m_dfu_window.gap_reported = false;
+    if (error_code != NRF_SUCCESS ||
+        m_dfu_window.unacked >= MESH_ACI_DFU_ACK_INTERVAL ||
+        m_dfu_window.next_seq == m_dfu_window.edge)
+    {
+        dfu_window_ack_send(error_code_translate(error_code));
+    }
+}
+#endif
+
 /**
  * Handle events coming in on the serial line
  */
@@ -163,6 +994,12 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
 #else
                 init_params.lfclksrc = NRF_CLOCK_LFCLKSRC_XTAL_500_PPM; /* choose worst clock, just to be safe */
 #endif
+                init_params.tx_power = RBC_MESH_TXPOWER_0dBm;
+                init_params.p_memory = NULL;
+                init_params.relay_only = false;
+                init_params.p_subscriptions = NULL;
+                init_params.subscription_count = 0;
+                init_params.radio_mode = RBC_MESH_RADIO_MODE_BLE_1MBIT;
 
                 error_code = rbc_mesh_init(init_params);
 
@@ -181,219 +1018,458 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_START:
+        case SERIAL_CMD_OPCODE_START:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            error_code = rbc_mesh_start();
+            serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_STOP:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            error_code = rbc_mesh_stop();
+            serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_VALUE_SET:
+            {
+                serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+                serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+                serial_evt.length = 3;
+
+                serial_evt.params.cmd_rsp.status = error_code_translate(value_set_cmd_handle(p_serial_cmd));
+
+                serial_handler_event_send(&serial_evt);
+                break;
+            }
+
+        case SERIAL_CMD_OPCODE_VALUES_SET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            serial_evt.params.cmd_rsp.status = error_code_translate(values_set_cmd_handle(p_serial_cmd));
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_VALUE_ENABLE:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_enable_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                error_code = rbc_mesh_value_enable(p_serial_cmd->params.value_enable.handle);
+
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_VALUE_DISABLE:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_disable_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                error_code = rbc_mesh_value_disable(p_serial_cmd->params.value_enable.handle);
+
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_VALUE_GET:
+            value_get_cmd_handle(p_serial_cmd);
+            break;
+
+        case SERIAL_CMD_OPCODE_BUILD_VERSION_GET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 6;
+
+            if (p_serial_cmd->length != 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                serial_evt.params.cmd_rsp.response.build_version.major = VERSION_MAJOR;
+                serial_evt.params.cmd_rsp.response.build_version.minor_1 = VERSION_MINOR1;
+                serial_evt.params.cmd_rsp.response.build_version.minor_2 = VERSION_MINOR2;
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+            }
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_ACCESS_ADDR_GET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 7;
+
+            if (p_serial_cmd->length != 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                uint32_t access_addr;
+
+                error_code = rbc_mesh_access_address_get(&access_addr);
+                serial_evt.params.cmd_rsp.response.access_addr.access_addr = access_addr;
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
+
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_CHANNEL_GET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 4;
+
+            if (p_serial_cmd->length != 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                uint8_t channel;
+                uint32_t error_code = rbc_mesh_channel_get(&channel);
+                serial_evt.params.cmd_rsp.response.channel.channel = channel;
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
+
+            serial_handler_event_send(&serial_evt);
+
+            break;
+
+        case SERIAL_CMD_OPCODE_INTERVAL_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = 3;
+            serial_evt.length = 7;
 
-            error_code = rbc_mesh_start();
-            serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            if (p_serial_cmd->length != 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                uint32_t interval_min_ms;
+                error_code = rbc_mesh_interval_min_ms_get(&interval_min_ms);
+                serial_evt.params.cmd_rsp.response.int_min.int_min = interval_min_ms;
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
 
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_STOP:
+        case SERIAL_CMD_OPCODE_BATCH:
+            batch_cmd_handle(p_serial_cmd);
+            break;
+
+        case SERIAL_CMD_OPCODE_MIRROR_START:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
             serial_evt.length = 3;
 
-            error_code = rbc_mesh_stop();
-            serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
-
-            serial_handler_event_send(&serial_evt);
-            break;
-
-        case SERIAL_CMD_OPCODE_VALUE_SET:
+            if (p_serial_cmd->length != 1)
             {
-                serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
-                serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-                serial_evt.length = 3;
-
-                mesh_packet_t* p_packet;
-                if (mesh_packet_acquire(&p_packet))
-                {
-                    const uint8_t data_len = p_serial_cmd->length - 1 - sizeof(rbc_mesh_value_handle_t);
-
-                    if (p_serial_cmd->length > sizeof(serial_cmd_params_value_set_t) + 1)
-                    {
-                        serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
-                        error_code = NRF_ERROR_INVALID_LENGTH;
-                    }
-                    else
-                    {
-                        error_code = rbc_mesh_value_set(p_serial_cmd->params.value_set.handle,
-                                p_serial_cmd->params.value_set.value,
-                                data_len);
-
-                        serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
-                    }
-
-                    /* notify application */
-                    if (error_code == NRF_SUCCESS)
-                    {
-                        memcpy(p_packet->payload, p_serial_cmd->params.value_set.value, data_len);
-                        memset(&app_evt, 0, sizeof(app_evt));
-                        app_evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
-                        app_evt.params.rx.p_data = p_packet->payload;
-                        app_evt.params.rx.data_len = data_len;
-                        app_evt.params.rx.value_handle = p_serial_cmd->params.value_set.handle;
-                        app_evt.params.rx.timestamp_us = timer_now();
-
-                        error_code = rbc_mesh_event_push(&app_evt);
-                        mesh_packet_ref_count_dec(p_packet);
-
-                        serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
-                    }
-                }
-                else
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+                serial_handler_event_send(&serial_evt);
+            }
+            else
+            {
+                /* probe, to see that the framework is initialized */
+                uint32_t iterator = 0;
+                rbc_mesh_value_handle_t handle;
+                uint16_t version;
+                uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+                uint16_t length = RBC_MESH_VALUE_MAX_LEN;
+                error_code = vh_value_next_get(&iterator, &handle, &version, data, &length);
+                if (error_code == NRF_ERROR_INVALID_STATE)
                 {
-                    serial_evt.params.cmd_rsp.status = error_code_translate(NRF_ERROR_BUSY);
+                    serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_DEVICE_STATE_INVALID;
+                    serial_handler_event_send(&serial_evt);
+                    break;
                 }
 
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
                 serial_handler_event_send(&serial_evt);
-                break;
+
+                /* the mirror is kept up to date with the value events */
+                m_evt_mask |= (ACI_EVT_MASK_NEW | ACI_EVT_MASK_UPDATE);
+                m_snapshot_iterator = 0;
+                m_snapshot_count = 0;
+                m_snapshot_active = true;
+                snapshot_continue();
             }
+            break;
 
-        case SERIAL_CMD_OPCODE_VALUE_ENABLE:
+        case SERIAL_CMD_OPCODE_EVENT_FORMAT_SET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
             serial_evt.length = 3;
 
-            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_enable_t) + 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_event_format_set_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
+            else if (p_serial_cmd->params.event_format_set.format > ACI_EVT_FORMAT_VERSIONED)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_PARAMETER;
+            }
             else
             {
-                error_code = rbc_mesh_value_enable(p_serial_cmd->params.value_enable.handle);
-
-                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                uint32_t was_masked;
+                _DISABLE_IRQS(was_masked);
+                /* the records packed so far go out ahead of the response */
+                (void) compact_send();
+                m_evt_format = (aci_evt_format_t) p_serial_cmd->params.event_format_set.format;
+                _ENABLE_IRQS(was_masked);
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
             }
-
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_VALUE_DISABLE:
+        case SERIAL_CMD_OPCODE_VALUE_HISTORY_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
             serial_evt.length = 3;
 
-            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_disable_t) + 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_history_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+                serial_handler_event_send(&serial_evt);
             }
             else
             {
-                error_code = rbc_mesh_value_disable(p_serial_cmd->params.value_enable.handle);
+                rbc_mesh_history_entry_t entry;
+                error_code = rbc_mesh_value_history_get(p_serial_cmd->params.value_history_get.handle,
+                        p_serial_cmd->params.value_history_get.version,
+                        &entry);
+                if (error_code != NRF_SUCCESS && error_code != NRF_ERROR_NOT_FOUND)
+                {
+                    /* no history for the handle */
+                    serial_evt.params.cmd_rsp.status = (error_code == NRF_ERROR_INVALID_ADDR) ?
+                        ACI_STATUS_ERROR_INVALID_PARAMETER : error_code_translate(error_code);
+                    serial_handler_event_send(&serial_evt);
+                    break;
+                }
 
-                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+                serial_handler_event_send(&serial_evt);
+
+                /* a new request replaces the one being streamed */
+                m_history_handle = p_serial_cmd->params.value_history_get.handle;
+                m_history_version = p_serial_cmd->params.value_history_get.version;
+                m_history_count = 0;
+                m_history_active = true;
+                history_continue();
             }
+            break;
+
+        case SERIAL_CMD_OPCODE_SHARD_SET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
 
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_shard_set_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else if (p_serial_cmd->params.shard_set.count > 1 &&
+                     p_serial_cmd->params.shard_set.index >= p_serial_cmd->params.shard_set.count)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_PARAMETER;
+            }
+            else
+            {
+                m_shard_count = p_serial_cmd->params.shard_set.count;
+                m_shard_index = p_serial_cmd->params.shard_set.index;
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+            }
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_VALUE_GET:
+        case SERIAL_CMD_OPCODE_STATS_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = RBC_MESH_VALUE_MAX_LEN; /* signal to the framework that we can fit the entire payload in our buffer */
+            serial_evt.length = 3;
 
-            if (p_serial_cmd->length != sizeof(serial_cmd_params_value_get_t) + 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_stats_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
+            else if (p_serial_cmd->params.stats_get.offset >= sizeof(rbc_mesh_stats_t))
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_PARAMETER;
+            }
             else
             {
-                uint32_t error_code = rbc_mesh_value_get(p_serial_cmd->params.value_get.handle,
-                        serial_evt.params.cmd_rsp.response.val_get.data,
-                        (uint16_t*) &serial_evt.length);
-
+                /* the stats don't fit in one event, the host reads them in chunks */
+                rbc_mesh_stats_t stats;
+                error_code = rbc_mesh_stats_get(&stats);
                 serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
-
-                serial_evt.params.cmd_rsp.response.val_get.handle = p_serial_cmd->params.value_get.handle;
-                serial_evt.length += 1 + 1 + 1 + 2 ; /* opcode + command + status + handle */
+                if (error_code == NRF_SUCCESS)
+                {
+                    uint8_t offset = p_serial_cmd->params.stats_get.offset;
+                    uint8_t len = sizeof(rbc_mesh_stats_t) - offset;
+                    if (len > RBC_MESH_VALUE_MAX_LEN)
+                    {
+                        len = RBC_MESH_VALUE_MAX_LEN;
+                    }
+                    serial_evt.params.cmd_rsp.response.stats_get.offset = offset;
+                    serial_evt.params.cmd_rsp.response.stats_get.total_len = sizeof(rbc_mesh_stats_t);
+                    memcpy(serial_evt.params.cmd_rsp.response.stats_get.data, ((uint8_t*) &stats) + offset, len);
+                    serial_evt.length += 2 + len; /* offset + total_len + data */
+                }
             }
-            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
 
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_BUILD_VERSION_GET:
+        case SERIAL_CMD_OPCODE_HANDLE_STATS_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = 6;
+            serial_evt.length = 3;
 
-            if (p_serial_cmd->length != 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_handle_stats_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
             else
             {
-                serial_evt.params.cmd_rsp.response.build_version.major = VERSION_MAJOR;
-                serial_evt.params.cmd_rsp.response.build_version.minor_1 = VERSION_MINOR1;
-                serial_evt.params.cmd_rsp.response.build_version.minor_2 = VERSION_MINOR2;
-                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+                /* the response is packed, the counters can't be written in place */
+                rbc_mesh_handle_stats_t stats;
+                error_code = rbc_mesh_handle_stats_get(p_serial_cmd->params.handle_stats_get.handle,
+                        &stats,
+                        (p_serial_cmd->params.handle_stats_get.reset != 0));
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                if (error_code == NRF_SUCCESS)
+                {
+                    memcpy(&serial_evt.params.cmd_rsp.response.handle_stats_get.stats, &stats, sizeof(stats));
+                    serial_evt.params.cmd_rsp.response.handle_stats_get.handle = p_serial_cmd->params.handle_stats_get.handle;
+                    serial_evt.length += sizeof(serial_evt_cmd_rsp_params_handle_stats_get_t);
+                }
             }
 
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_ACCESS_ADDR_GET:
+        case SERIAL_CMD_OPCODE_ISR_STATS_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = 7;
+            serial_evt.length = 3;
 
-            if (p_serial_cmd->length != 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_isr_stats_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
+            else if (p_serial_cmd->params.isr_stats_get.histogram > 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_PARAMETER;
+            }
             else
             {
-                uint32_t access_addr;
-
-                error_code = rbc_mesh_access_address_get(&access_addr);
-                serial_evt.params.cmd_rsp.response.access_addr.access_addr = access_addr;
+                /* one histogram per response, the host asks for the other one before resetting */
+                rbc_mesh_isr_stats_t stats;
+                error_code = rbc_mesh_isr_stats_get((rbc_mesh_isr_t) p_serial_cmd->params.isr_stats_get.isr, &stats,
+                        (p_serial_cmd->params.isr_stats_get.reset != 0));
                 serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                if (error_code == NRF_SUCCESS)
+                {
+                    serial_evt_cmd_rsp_params_isr_stats_get_t* p_rsp = &serial_evt.params.cmd_rsp.response.isr_stats_get;
+                    bool latency = (p_serial_cmd->params.isr_stats_get.histogram == 1);
+                    p_rsp->isr = p_serial_cmd->params.isr_stats_get.isr;
+                    p_rsp->histogram = p_serial_cmd->params.isr_stats_get.histogram;
+                    p_rsp->max_us = (latency ? stats.latency_max_us : stats.duration_max_us);
+                    p_rsp->margin_overruns = stats.margin_overruns;
+                    memcpy(p_rsp->buckets, (latency ? stats.latency_hist : stats.duration_hist), sizeof(p_rsp->buckets));
+                    serial_evt.length += sizeof(serial_evt_cmd_rsp_params_isr_stats_get_t);
+                }
             }
 
             serial_handler_event_send(&serial_evt);
             break;
 
-        case SERIAL_CMD_OPCODE_CHANNEL_GET:
+        case SERIAL_CMD_OPCODE_PROPAGATION_STATS_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = 4;
+            serial_evt.length = 3;
 
-            if (p_serial_cmd->length != 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_propagation_stats_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
             else
             {
-                uint8_t channel;
-                uint32_t error_code = rbc_mesh_channel_get(&channel);
-                serial_evt.params.cmd_rsp.response.channel.channel = channel;
+                rbc_mesh_propagation_stats_t stats;
+                error_code = rbc_mesh_propagation_stats_get(&stats,
+                        (p_serial_cmd->params.propagation_stats_get.reset != 0));
                 serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                if (error_code == NRF_SUCCESS)
+                {
+                    serial_evt_cmd_rsp_params_propagation_stats_get_t* p_rsp = &serial_evt.params.cmd_rsp.response.propagation_stats_get;
+                    p_rsp->count = stats.count;
+                    p_rsp->unstamped = stats.unstamped;
+                    p_rsp->max_ms = stats.max_ms;
+                    memcpy(p_rsp->buckets, stats.hist, sizeof(p_rsp->buckets));
+                    serial_evt.length += sizeof(serial_evt_cmd_rsp_params_propagation_stats_get_t);
+                }
             }
 
             serial_handler_event_send(&serial_evt);
-
             break;
 
-        case SERIAL_CMD_OPCODE_INTERVAL_GET:
+        case SERIAL_CMD_OPCODE_NEIGHBOR_GET:
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
             serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
-            serial_evt.length = 7;
+            serial_evt.length = 3;
 
-            if (p_serial_cmd->length != 1)
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_neighbor_get_t) + 1)
             {
                 serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
             }
             else
             {
-                uint32_t interval_min_ms;
-                error_code = rbc_mesh_interval_min_ms_get(&interval_min_ms);
-                serial_evt.params.cmd_rsp.response.int_min.int_min = interval_min_ms;
+                rbc_mesh_neighbor_t neighbor;
+                error_code = rbc_mesh_neighbor_get(p_serial_cmd->params.neighbor_get.index, &neighbor);
                 serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                if (error_code == NRF_SUCCESS)
+                {
+                    /* the host doesn't share the device's clock, report how long ago the neighbor was heard */
+                    serial_evt_cmd_rsp_params_neighbor_get_t* p_rsp = &serial_evt.params.cmd_rsp.response.neighbor_get;
+                    p_rsp->index = p_serial_cmd->params.neighbor_get.index;
+                    p_rsp->addr_type = neighbor.addr.addr_type;
+                    memcpy(p_rsp->addr, neighbor.addr.addr, BLE_GAP_ADDR_LEN);
+                    p_rsp->rssi = neighbor.rssi;
+                    p_rsp->packet_count = neighbor.packet_count;
+                    p_rsp->age_us = timer_now() - neighbor.last_rx_us;
+                    serial_evt.length += sizeof(serial_evt_cmd_rsp_params_neighbor_get_t);
+                }
             }
 
             serial_handler_event_send(&serial_evt);
@@ -412,35 +1488,7 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
             }
             else
             {
-                switch ((aci_flag_t) p_serial_cmd->params.flag_set.flag)
-                {
-                    case ACI_FLAG_PERSISTENT:
-#ifdef BOOTLOADER
-                        error_code = NRF_ERROR_INVALID_PARAM;
-#else
-                        error_code = rbc_mesh_persistence_set(p_serial_cmd->params.flag_set.handle,
-                                p_serial_cmd->params.flag_set.value);
-#endif
-                        break;
-
-                    case ACI_FLAG_TX_EVENT:
-                        {
-#ifdef BOOTLOADER
-                            transport_tx_evt_set(
-                                    p_serial_cmd->params.flag_set.handle,
-                                    p_serial_cmd->params.flag_set.value);
-                            error_code = NRF_SUCCESS;
-#else
-                            error_code = rbc_mesh_tx_event_set(
-                                    p_serial_cmd->params.flag_set.handle,
-                                    p_serial_cmd->params.flag_set.value);
-#endif
-                        }
-                        break;
-                    default:
-                        error_code = NRF_ERROR_INVALID_PARAM;
-                }
-                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+                serial_evt.params.cmd_rsp.status = error_code_translate(flag_set_cmd_handle(p_serial_cmd));
             }
             serial_handler_event_send(&serial_evt);
             break;
@@ -458,6 +1506,7 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
             {
                 uint32_t error_code;
                 bool flag_status = false;
+                uint8_t flag_value = 0; /* for non-boolean flags */
                 switch ((aci_flag_t) p_serial_cmd->params.flag_set.flag)
                 {
                     case ACI_FLAG_PERSISTENT:
@@ -477,6 +1526,24 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
 #else
                         error_code = rbc_mesh_tx_event_flag_get(p_serial_cmd->params.flag_get.handle,
                                 &flag_status);
+#endif
+                        break;
+
+                    case ACI_FLAG_TRICKLE_CLASS:
+#ifdef BOOTLOADER
+                        error_code = NRF_ERROR_INVALID_PARAM;
+#else
+                        error_code = rbc_mesh_trickle_class_get(p_serial_cmd->params.flag_get.handle,
+                                &flag_value);
+#endif
+                        break;
+
+                    case ACI_FLAG_URGENT:
+#ifdef BOOTLOADER
+                        error_code = NRF_ERROR_INVALID_PARAM;
+#else
+                        error_code = rbc_mesh_urgent_flag_get(p_serial_cmd->params.flag_get.handle,
+                                &flag_status);
 #endif
                         break;
                     default:
@@ -485,7 +1552,69 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
                 }
                 serial_evt.params.cmd_rsp.response.flag.handle = p_serial_cmd->params.flag_get.handle;
                 serial_evt.params.cmd_rsp.response.flag.flag = p_serial_cmd->params.flag_get.flag;
-                serial_evt.params.cmd_rsp.response.flag.value = flag_status;
+                serial_evt.params.cmd_rsp.response.flag.value =
+                    (p_serial_cmd->params.flag_get.flag == ACI_FLAG_TRICKLE_CLASS) ? flag_value : flag_status;
+                serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
+            }
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_SNIFFER_SET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_sniffer_set_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+#ifdef RBC_MESH_SNIFFER
+                mesh_sniffer_enable(p_serial_cmd->params.sniffer_set.enable != 0);
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+#else
+                serial_evt.params.cmd_rsp.status = error_code_translate(NRF_ERROR_NOT_SUPPORTED);
+#endif
+            }
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_EVENT_MASK_SET:
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_event_mask_set_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else if (p_serial_cmd->params.event_mask_set.mask & ~ACI_EVT_MASK_ALL)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_PARAMETER;
+            }
+            else
+            {
+                m_evt_mask = p_serial_cmd->params.event_mask_set.mask;
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_SUCCESS;
+            }
+            serial_handler_event_send(&serial_evt);
+            break;
+
+        case SERIAL_CMD_OPCODE_BAUDRATE_SET:
+            /* The response goes out at the old baudrate, the host switches
+               when it gets it. */
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.length = 3;
+
+            if (p_serial_cmd->length != sizeof(serial_cmd_params_baudrate_set_t) + 1)
+            {
+                serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_INVALID_LENGTH;
+            }
+            else
+            {
+                error_code = serial_handler_baudrate_set(p_serial_cmd->params.baudrate_set.baudrate);
                 serial_evt.params.cmd_rsp.status = error_code_translate(error_code);
             }
             serial_handler_event_send(&serial_evt);
@@ -498,18 +1627,8 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
                 serial_evt.length = 5;
 
                 /* propagate to handler */
-#ifdef BOOTLOADER
-                bl_cmd_t rx_cmd;
-                rx_cmd.type = BL_CMD_TYPE_RX;
-                rx_cmd.params.rx.p_dfu_packet = &p_serial_cmd->params.dfu.packet;
-                rx_cmd.params.rx.length = p_serial_cmd->length - SERIAL_PACKET_OVERHEAD;
-                error_code = bootloader_cmd_send(&rx_cmd);
-#elif defined(MESH_DFU)
-                error_code = dfu_rx(&p_serial_cmd->params.dfu.packet, p_serial_cmd->length - SERIAL_PACKET_OVERHEAD);
-                if (error_code != NRF_SUCCESS)
-                {
-                    __LOG(RTT_CTRL_TEXT_RED "BL Responded with error 0x%x\n", error_code);
-                }
+#if defined(BOOTLOADER) || defined(MESH_DFU)
+                error_code = dfu_packet_handle(&p_serial_cmd->params.dfu.packet, p_serial_cmd->length - SERIAL_PACKET_OVERHEAD);
 #else
                 error_code = NRF_ERROR_NOT_SUPPORTED;
 #endif
@@ -521,6 +1640,18 @@ static void serial_command_handler(serial_cmd_t* p_serial_cmd)
             }
             break;
 
+        case SERIAL_CMD_OPCODE_DFU_WINDOWED:
+#if defined(BOOTLOADER) || defined(MESH_DFU)
+            dfu_windowed_cmd_handle(p_serial_cmd);
+#else
+            serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+            serial_evt.params.cmd_rsp.command_opcode = p_serial_cmd->opcode;
+            serial_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_CMD_UNKNOWN;
+            serial_evt.length = 3;
+            serial_handler_event_send(&serial_evt);
+#endif
+            break;
+
         default:
             __LOG("Unknown event!\n");
             serial_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
@@ -587,35 +1718,106 @@ void mesh_aci_command_check(void)
 void mesh_aci_rbc_event_handler(rbc_mesh_event_t* evt)
 {
     serial_evt_t serial_evt;
+    uint8_t mask;
+    uint16_t* p_drop_count;
     switch (evt->type)
     {
         case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
             serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_CONFLICTING;
+            mask = ACI_EVT_MASK_CONFLICTING;
+            p_drop_count = &m_overflow.dropped_conflicting;
             break;
 
         case RBC_MESH_EVENT_TYPE_NEW_VAL:
             serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_NEW;
+            mask = ACI_EVT_MASK_NEW;
+            p_drop_count = &m_overflow.dropped_new;
             break;
 
         case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
             serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_UPDATE;
+            mask = ACI_EVT_MASK_UPDATE;
+            p_drop_count = &m_overflow.dropped_update;
             break;
 
         case RBC_MESH_EVENT_TYPE_TX:
             serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_TX;
+            mask = ACI_EVT_MASK_TX;
+            p_drop_count = &m_overflow.dropped_tx;
             break;
 
         default:
-            break;
+            return;
     }
 
-    /* serial overhead: opcode + handle = 3 */
-    serial_evt.length = 3 + evt->params.rx.data_len;
+    if (!(m_evt_mask & mask) || !shard_has_handle(evt->params.rx.value_handle))
+    {
+        return;
+    }
 
-    /* all event parameter types are the same, just use event_update for all */
-    serial_evt.params.event_update.handle = evt->params.rx.value_handle;
-    memcpy(serial_evt.params.event_update.data, evt->params.rx.p_data, evt->params.rx.data_len);
+    const uint16_t version = (evt->type == RBC_MESH_EVENT_TYPE_TX) ? 0 : evt->params.rx.version;
+    value_evt_fill(&serial_evt,
+                   (serial_evt_opcode_t) serial_evt.opcode,
+                   evt->params.rx.value_handle,
+                   version,
+                   evt->params.rx.p_data,
+                   evt->params.rx.data_len);
+
+    /* TX events come from the radio context, the rest from the event handler. */
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    /* waiting events go first, to keep the order */
+    bool queued = event_flush();
+    if (queued)
+    {
+#ifndef BOOTLOADER
+        if (m_evt_format == ACI_EVT_FORMAT_COMPACT)
+        {
+            queued = compact_put(&serial_evt,
+                                 (evt->type == RBC_MESH_EVENT_TYPE_TX) ? 0 : evt->params.rx.version_delta);
+        }
+        else
+#endif
+        {
+            queued = serial_handler_event_send(&serial_evt);
+        }
+    }
+    if (!queued)
+    {
+        if (evt->type != RBC_MESH_EVENT_TYPE_UPDATE_VAL ||
+            !pending_update_put(evt->params.rx.value_handle,
+                                version,
+                                evt->params.rx.p_data,
+                                evt->params.rx.data_len))
+        {
+            drop_count_inc(p_drop_count);
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+}
 
-    serial_handler_event_send(&serial_evt);
+void mesh_aci_event_flush(void)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+#ifndef BOOTLOADER
+    bool flushed = (compact_send() && event_flush());
+#else
+    bool flushed = event_flush();
+#endif
+    _ENABLE_IRQS(was_masked);
+#ifndef BOOTLOADER
+    /* waiting updates are older than the values the snapshot reads */
+    if (flushed)
+    {
+        snapshot_continue();
+        history_continue();
+    }
+#ifdef RBC_MESH_SNIFFER
+    mesh_sniffer_flush();
+#endif
+#else
+    (void) flushed;
+#endif
 }
 
@@ -0,0 +1,457 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_ack.h"
+
+#ifdef RBC_MESH_ACK
+
+#include "version_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "rand.h"
+#include "toolchain.h"
+#include "app_error.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+/** Size of an acknowledgement entry: source and sequence number. */
+#define ACK_ENTRY_LEN               (3)
+/** Number of acknowledgement entries that fit in a value. */
+#define ACK_ENTRIES_MAX             (RBC_MESH_LEGACY_VALUE_MAX_LEN / ACK_ENTRY_LEN)
+#define ACK_TIMEOUT_US              (RBC_MESH_ACK_TIMEOUT_MS * 1000)
+#define ACK_DELAY_US                (RBC_MESH_ACK_DELAY_MS * 1000)
+/** Time an acknowledgement is repeated in the list, for as long as its
+ * sender may retransmit the message. */
+#define ACK_LIFETIME_US             (ACK_TIMEOUT_US * (RBC_MESH_ACK_RETRIES + 1))
+
+#define MSG_DST_OFFSET              (0)
+#define MSG_SEQ_OFFSET              (2)
+
+#if ACK_ENTRIES_MAX == 0
+#error "RBC_MESH_LEGACY_VALUE_MAX_LEN is too short for acknowledgements"
+#endif
+
+/* event push isn't present in the API header file. */
+extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+/** The message in flight. */
+typedef struct
+{
+    bool in_flight;
+    bool tx_seen;               /**< Whether first_tx is valid. */
+    uint16_t dst;
+    uint8_t seq;
+    uint8_t retries;
+    uint8_t len;                /**< Length of the message contents. */
+    timestamp_t first_tx;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN]; /**< The message, with its header. */
+} ack_tx_t;
+
+/** The last message received from a sender. */
+typedef struct
+{
+    bool in_use;
+    uint8_t seq;
+    uint16_t src;
+    timestamp_t acked_at;       /**< Last time the message was received. */
+} ack_source_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static bool m_is_initialized;
+static rbc_mesh_ack_params_t m_params;
+static ack_tx_t m_tx;
+static uint8_t m_next_seq;
+static timer_event_t m_retry_timer;
+static ack_source_t m_sources[RBC_MESH_ACK_SOURCES];
+static timer_event_t m_ack_timer;
+static bool m_ack_pending;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static inline uint16_t le16_get(const uint8_t* p_data)
+{
+    return (uint16_t) (p_data[0] | (p_data[1] << 8));
+}
+
+static inline void le16_set(uint8_t* p_data, uint16_t value)
+{
+    p_data[0] = (uint8_t) value;
+    p_data[1] = (uint8_t) (value >> 8);
+}
+
+/** Get the node of a handle in a service handle range, or node_count if it's outside. */
+static inline uint16_t handle_node_get(rbc_mesh_value_handle_t handle, rbc_mesh_value_handle_t base)
+{
+    if (handle < base || handle - base >= m_params.node_count)
+    {
+        return m_params.node_count;
+    }
+    return handle - base;
+}
+
+static inline rbc_mesh_value_handle_t msg_handle_get(void)
+{
+    return m_params.msg_handle_base + m_params.node_id;
+}
+
+/** Stop sending the message in flight, and build the event reporting its outcome. */
+static void tx_end(rbc_mesh_event_t* p_evt, rbc_mesh_event_type_t type, timestamp_t timestamp)
+{
+    p_evt->type = type;
+    p_evt->params.ack.node_id = m_tx.dst;
+    p_evt->params.ack.seq = m_tx.seq;
+    p_evt->params.ack.p_data = NULL;
+    p_evt->params.ack.data_len = m_tx.len;
+    p_evt->params.ack.timestamp_us = timestamp;
+    p_evt->params.ack.rtt_us = (m_tx.tx_seen ? timestamp - m_tx.first_tx : 0);
+
+    m_tx.in_flight = false;
+    (void) vh_value_disable(msg_handle_get());
+}
+
+static void retry_timeout(timestamp_t timestamp, void* p_context)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (!m_tx.in_flight)
+    {
+        _ENABLE_IRQS(was_masked);
+        return;
+    }
+    if (m_tx.retries >= RBC_MESH_ACK_RETRIES)
+    {
+        _ENABLE_IRQS(was_masked);
+        rbc_mesh_event_t evt;
+        tx_end(&evt, RBC_MESH_EVENT_TYPE_ACK_FAILED, timestamp);
+        (void) rbc_mesh_event_push(&evt);
+        return;
+    }
+    m_tx.retries++;
+    _ENABLE_IRQS(was_masked);
+
+    /* A new version restarts the trickle timers of the value around the
+     * mesh. If there's no room for it now, the next timeout will try again. */
+    (void) vh_local_update(msg_handle_get(), m_tx.data, m_tx.len + RBC_MESH_ACK_MSG_OVERHEAD);
+    APP_ERROR_CHECK(timer_sch_reschedule(&m_retry_timer, timestamp + ACK_TIMEOUT_US));
+}
+
+static void ack_timeout(timestamp_t timestamp, void* p_context)
+{
+    uint8_t acks[ACK_ENTRIES_MAX * ACK_ENTRY_LEN];
+    uint8_t count = 0;
+
+    m_ack_pending = false;
+    for (uint32_t i = 0; i < RBC_MESH_ACK_SOURCES && count < ACK_ENTRIES_MAX; ++i)
+    {
+        if (m_sources[i].in_use &&
+            TIMER_DIFF(timestamp, m_sources[i].acked_at) < ACK_LIFETIME_US)
+        {
+            le16_set(&acks[count * ACK_ENTRY_LEN], m_sources[i].src);
+            acks[count * ACK_ENTRY_LEN + 2] = m_sources[i].seq;
+            count++;
+        }
+    }
+
+    if (count > 0)
+    {
+        (void) vh_local_update(m_params.ack_handle_base + m_params.node_id, acks, count * ACK_ENTRY_LEN);
+    }
+}
+
+/**
+* Record a message from a sender, and order an acknowledgement for it.
+*
+* @return Whether the message is new, and should be delivered.
+*/
+static bool source_ack(uint16_t src, uint8_t seq, timestamp_t timestamp)
+{
+    ack_source_t* p_source = NULL;
+    for (uint32_t i = 0; i < RBC_MESH_ACK_SOURCES; ++i)
+    {
+        if (m_sources[i].in_use && m_sources[i].src == src)
+        {
+            p_source = &m_sources[i];
+            break;
+        }
+    }
+
+    bool is_new = true;
+    if (p_source != NULL)
+    {
+        is_new = (p_source->seq != seq);
+    }
+    else
+    {
+        /* take a free entry, or the sender we heard from the longest ago */
+        p_source = &m_sources[0];
+        for (uint32_t i = 0; i < RBC_MESH_ACK_SOURCES && p_source->in_use; ++i)
+        {
+            if (!m_sources[i].in_use ||
+                TIMER_OLDER_THAN(m_sources[i].acked_at, p_source->acked_at))
+            {
+                p_source = &m_sources[i];
+            }
+        }
+    }
+
+    p_source->in_use = true;
+    p_source->src = src;
+    p_source->seq = seq;
+    p_source->acked_at = timestamp;
+
+    /* the sender repeats the message if it missed the acknowledgement, ack
+     * duplicates again */
+    if (!m_ack_pending)
+    {
+        m_ack_pending = true;
+        APP_ERROR_CHECK(timer_sch_reschedule(&m_ack_timer, timestamp + ACK_DELAY_US));
+    }
+    return is_new;
+}
+
+/** @return Whether the event was consumed. */
+static bool msg_rx(rbc_mesh_event_t* p_evt, uint16_t src)
+{
+    const uint8_t* p_msg = p_evt->params.rx.p_data;
+    const uint8_t len = p_evt->params.rx.data_len;
+    const timestamp_t timestamp = p_evt->params.rx.timestamp_us;
+
+    if (src == m_params.node_id ||
+        p_evt->type == RBC_MESH_EVENT_TYPE_CONFLICTING_VAL ||
+        len < RBC_MESH_ACK_MSG_OVERHEAD ||
+        le16_get(&p_msg[MSG_DST_OFFSET]) != m_params.node_id)
+    {
+        return true;
+    }
+
+    const uint8_t seq = p_msg[MSG_SEQ_OFFSET];
+    if (!source_ack(src, seq, timestamp))
+    {
+        return true;
+    }
+
+    p_evt->type = RBC_MESH_EVENT_TYPE_ACK_MSG;
+    p_evt->params.ack.node_id = src;
+    p_evt->params.ack.seq = seq;
+    p_evt->params.ack.p_data = (uint8_t*) &p_msg[RBC_MESH_ACK_MSG_OVERHEAD]; /* the packet manager aligns it for the ref count */
+    p_evt->params.ack.data_len = len - RBC_MESH_ACK_MSG_OVERHEAD;
+    p_evt->params.ack.timestamp_us = timestamp;
+    p_evt->params.ack.rtt_us = 0;
+    return false;
+}
+
+/** @return Whether the event was consumed. */
+static bool ack_rx(rbc_mesh_event_t* p_evt, uint16_t src)
+{
+    const uint8_t* p_acks = p_evt->params.rx.p_data;
+    const uint8_t len = p_evt->params.rx.data_len;
+    const timestamp_t timestamp = p_evt->params.rx.timestamp_us;
+
+    if (!m_tx.in_flight || src != m_tx.dst)
+    {
+        return true;
+    }
+
+    for (uint32_t i = 0; i + ACK_ENTRY_LEN <= len; i += ACK_ENTRY_LEN)
+    {
+        if (le16_get(&p_acks[i]) == m_params.node_id &&
+            p_acks[i + 2] == m_tx.seq)
+        {
+            (void) timer_sch_abort(&m_retry_timer);
+            tx_end(p_evt, RBC_MESH_EVENT_TYPE_ACK_DELIVERED, timestamp);
+            return false;
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_ack_init(const rbc_mesh_ack_params_t* p_params)
+{
+    if (p_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_params->node_id >= p_params->node_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((uint32_t) p_params->msg_handle_base + p_params->node_count - 1 > RBC_MESH_APP_MAX_HANDLE ||
+        (uint32_t) p_params->ack_handle_base + p_params->node_count - 1 > RBC_MESH_APP_MAX_HANDLE ||
+        (p_params->msg_handle_base < p_params->ack_handle_base + p_params->node_count &&
+         p_params->ack_handle_base < p_params->msg_handle_base + p_params->node_count))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint32_t error_code = vh_tx_event_set(p_params->msg_handle_base + p_params->node_id, true);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    /* a random start keeps receivers from taking the first messages after a
+     * reboot for repeats of the last ones before it */
+    if (rand_hw_rng_get(&m_next_seq, 1) != NRF_SUCCESS)
+    {
+        m_next_seq = 0;
+    }
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_params = *p_params;
+    memset(&m_tx, 0, sizeof(m_tx));
+    memset(m_sources, 0, sizeof(m_sources));
+    m_ack_pending = false;
+    memset(&m_retry_timer, 0, sizeof(m_retry_timer));
+    m_retry_timer.cb = retry_timeout;
+    memset(&m_ack_timer, 0, sizeof(m_ack_timer));
+    m_ack_timer.cb = ack_timeout;
+    m_is_initialized = true;
+    _ENABLE_IRQS(was_masked);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_ack_send(uint16_t node_id, const uint8_t* p_data, uint8_t len)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_data == NULL && len > 0)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (node_id >= m_params.node_count || node_id == m_params.node_id)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (len > RBC_MESH_ACK_MSG_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (m_tx.in_flight)
+    {
+        _ENABLE_IRQS(was_masked);
+        return NRF_ERROR_BUSY;
+    }
+    m_tx.in_flight = true;
+    m_tx.tx_seen = false;
+    m_tx.dst = node_id;
+    m_tx.seq = m_next_seq++;
+    m_tx.retries = 0;
+    m_tx.len = len;
+    _ENABLE_IRQS(was_masked);
+
+    le16_set(&m_tx.data[MSG_DST_OFFSET], node_id);
+    m_tx.data[MSG_SEQ_OFFSET] = m_tx.seq;
+    if (len > 0)
+    {
+        memcpy(&m_tx.data[RBC_MESH_ACK_MSG_OVERHEAD], p_data, len);
+    }
+
+    uint32_t error_code = vh_local_update(msg_handle_get(), m_tx.data, len + RBC_MESH_ACK_MSG_OVERHEAD);
+    if (error_code == NRF_SUCCESS)
+    {
+        error_code = timer_sch_reschedule(&m_retry_timer, timer_now() + ACK_TIMEOUT_US);
+    }
+    if (error_code != NRF_SUCCESS)
+    {
+        m_tx.in_flight = false;
+    }
+    return error_code;
+}
+
+bool mesh_ack_event_handle(rbc_mesh_event_t* p_evt)
+{
+    if (!m_is_initialized)
+    {
+        return false;
+    }
+
+    switch (p_evt->type)
+    {
+        case RBC_MESH_EVENT_TYPE_NEW_VAL:
+        case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+        case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+        {
+            const rbc_mesh_value_handle_t handle = p_evt->params.rx.value_handle;
+            uint16_t node = handle_node_get(handle, m_params.msg_handle_base);
+            if (node < m_params.node_count)
+            {
+                return msg_rx(p_evt, node);
+            }
+            node = handle_node_get(handle, m_params.ack_handle_base);
+            if (node < m_params.node_count)
+            {
+                return ack_rx(p_evt, node);
+            }
+            return false;
+        }
+        case RBC_MESH_EVENT_TYPE_TX:
+        {
+            const rbc_mesh_value_handle_t handle = p_evt->params.tx.value_handle;
+            if (handle == msg_handle_get())
+            {
+                /* may come from the radio, while the app is starting a new message */
+                uint32_t was_masked;
+                _DISABLE_IRQS(was_masked);
+                if (m_tx.in_flight && !m_tx.tx_seen)
+                {
+                    m_tx.first_tx = p_evt->params.tx.timestamp_us;
+                    m_tx.tx_seen = true;
+                }
+                _ENABLE_IRQS(was_masked);
+                return true;
+            }
+            return (handle_node_get(handle, m_params.msg_handle_base) < m_params.node_count ||
+                    handle_node_get(handle, m_params.ack_handle_base) < m_params.node_count);
+        }
+        default:
+            return false;
+    }
+}
+
+#endif /* RBC_MESH_ACK */
@@ -0,0 +1,185 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_app_cmd.h"
+
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+
+#include <string.h>
+#include "rbc_mesh.h"
+#include "event_handler.h"
+#include "fifo.h"
+#include "nrf_error.h"
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef enum
+{
+    APP_CMD_VALUE_SET,
+    APP_CMD_VALUE_GET
+} app_cmd_type_t;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t length;                     /**< Length of the value to set. */
+    rbc_mesh_value_handle_t handle;
+    rbc_mesh_future_t* p_future;
+    union
+    {
+        uint8_t data[RBC_MESH_VALUE_MAX_LEN]; /**< Copy of the value to set. */
+        struct
+        {
+            uint8_t* p_data;
+            uint16_t* p_length;
+        } get;
+    } params;
+} app_cmd_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static fifo_t       m_cmd_fifo;
+static app_cmd_t    m_cmd_fifo_buffer[RBC_MESH_APP_COMMAND_QUEUE_LENGTH];
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint32_t cmd_push(const app_cmd_t* p_cmd)
+{
+    if (p_cmd->p_future != NULL)
+    {
+        p_cmd->p_future->done = false;
+    }
+    uint32_t error_code = fifo_spsc_push(&m_cmd_fifo, p_cmd);
+    if (error_code == NRF_SUCCESS)
+    {
+        event_handler_signal();
+    }
+    return error_code;
+}
+
+static void cmd_complete(rbc_mesh_future_t* p_future, uint32_t error_code)
+{
+    if (p_future == NULL)
+    {
+        return;
+    }
+    /* the application may reuse the future as soon as it's done */
+    rbc_mesh_future_cb_t callback = p_future->callback;
+    void* p_context = p_future->p_context;
+    p_future->error_code = error_code;
+    p_future->done = true;
+    if (callback != NULL)
+    {
+        callback(error_code, p_context);
+    }
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_app_cmd_init(void)
+{
+    m_cmd_fifo.array_len = RBC_MESH_APP_COMMAND_QUEUE_LENGTH;
+    m_cmd_fifo.elem_array = m_cmd_fifo_buffer;
+    m_cmd_fifo.elem_size = sizeof(app_cmd_t);
+    m_cmd_fifo.memcpy_fptr = NULL;
+    fifo_init(&m_cmd_fifo);
+}
+
+uint32_t mesh_app_cmd_value_set(rbc_mesh_value_handle_t handle, const uint8_t* p_data, uint16_t length, rbc_mesh_future_t* p_future)
+{
+    if (p_data == NULL && length > 0)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (length > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    app_cmd_t cmd;
+    cmd.type = APP_CMD_VALUE_SET;
+    cmd.handle = handle;
+    cmd.length = length;
+    cmd.p_future = p_future;
+    memcpy(cmd.params.data, p_data, length);
+    return cmd_push(&cmd);
+}
+
+uint32_t mesh_app_cmd_value_get(rbc_mesh_value_handle_t handle, uint8_t* p_data, uint16_t* p_length, rbc_mesh_future_t* p_future)
+{
+    if (p_data == NULL || p_length == NULL || p_future == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    app_cmd_t cmd;
+    cmd.type = APP_CMD_VALUE_GET;
+    cmd.handle = handle;
+    cmd.length = 0;
+    cmd.p_future = p_future;
+    cmd.params.get.p_data = p_data;
+    cmd.params.get.p_length = p_length;
+    return cmd_push(&cmd);
+}
+
+uint32_t mesh_app_cmd_process(uint32_t max_count)
+{
+    uint32_t count = 0;
+    app_cmd_t* p_cmd;
+    while (count < max_count && fifo_peek_ref(&m_cmd_fifo, (void**) &p_cmd) == NRF_SUCCESS)
+    {
+        uint32_t error_code;
+        switch (p_cmd->type)
+        {
+            case APP_CMD_VALUE_SET:
+                error_code = rbc_mesh_value_set(p_cmd->handle, p_cmd->params.data, p_cmd->length);
+                break;
+            case APP_CMD_VALUE_GET:
+                error_code = rbc_mesh_value_get(p_cmd->handle, p_cmd->params.get.p_data, p_cmd->params.get.p_length);
+                break;
+            default:
+                error_code = NRF_ERROR_INVALID_PARAM;
+                break;
+        }
+        rbc_mesh_future_t* p_future = p_cmd->p_future;
+        fifo_release(&m_cmd_fifo);
+        cmd_complete(p_future, error_code);
+        count++;
+    }
+    return count;
+}
+
+uint32_t mesh_app_cmd_length(void)
+{
+    return fifo_get_len(&m_cmd_fifo);
+}
+
+#endif /* RBC_MESH_APP_COMMAND_QUEUE */
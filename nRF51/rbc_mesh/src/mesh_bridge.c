@@ -0,0 +1,161 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_bridge.h"
+
+#ifdef RBC_MESH_BRIDGE
+
+#include "version_handler.h"
+#include "transport_control.h"
+#include "event_handler.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static rbc_mesh_bridge_entry_t  m_entries[RBC_MESH_BRIDGE_ENTRIES_MAX];
+static uint8_t                  m_entry_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+/** Check that all handles in the range are in the same instance, and return it. */
+static bool range_instance_get(rbc_mesh_value_handle_t first, rbc_mesh_value_handle_t last, uint8_t* p_instance)
+{
+    if (first > last || last > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return false;
+    }
+    *p_instance = tc_instance_get(first);
+    for (uint32_t handle = first + 1; handle <= last; ++handle)
+    {
+        if (tc_instance_get(handle) != *p_instance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Copy the value of the source handle to the destination handle. */
+static void value_forward(rbc_mesh_value_handle_t src, rbc_mesh_value_handle_t dst)
+{
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+    uint16_t length = sizeof(data);
+    if (vh_value_get(src, data, &length) == NRF_SUCCESS)
+    {
+        /* loses the value if the packet pool is empty, the next version
+           gets another chance */
+        (void) vh_local_update(dst, data, length);
+    }
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_bridge_add(const rbc_mesh_bridge_entry_t* p_entry)
+{
+    if (p_entry == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_entry->direction > RBC_MESH_BRIDGE_DIR_BOTH)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    uint32_t peer_last = (uint32_t) p_entry->peer_first + (p_entry->handles.last - p_entry->handles.first);
+    uint8_t instance;
+    uint8_t peer_instance;
+    if (p_entry->handles.first > p_entry->handles.last ||
+        peer_last > RBC_MESH_APP_MAX_HANDLE ||
+        !range_instance_get(p_entry->handles.first, p_entry->handles.last, &instance) ||
+        !range_instance_get(p_entry->peer_first, peer_last, &peer_instance) ||
+        instance == peer_instance)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    if (m_entry_count >= RBC_MESH_BRIDGE_ENTRIES_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    event_handler_critical_section_begin();
+    m_entries[m_entry_count++] = *p_entry;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+void mesh_bridge_event_handle(const rbc_mesh_event_t* p_evt)
+{
+    if (p_evt->type != RBC_MESH_EVENT_TYPE_NEW_VAL &&
+        p_evt->type != RBC_MESH_EVENT_TYPE_UPDATE_VAL)
+    {
+        return;
+    }
+
+    const rbc_mesh_value_handle_t handle = p_evt->params.rx.value_handle;
+    for (uint32_t i = 0; i < m_entry_count; ++i)
+    {
+        const rbc_mesh_bridge_entry_t* p_entry = &m_entries[i];
+        const uint16_t peer_offset = handle - p_entry->peer_first;
+        const uint16_t offset = handle - p_entry->handles.first;
+        const uint16_t count = p_entry->handles.last - p_entry->handles.first;
+        if (offset <= count)
+        {
+            if (p_entry->direction == RBC_MESH_BRIDGE_DIR_FROM_PEER)
+            {
+                /* this side belongs to the bridge, put the peer's value back */
+                value_forward(p_entry->peer_first + offset, handle);
+            }
+            else
+            {
+                (void) vh_local_update(p_entry->peer_first + offset,
+                        p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            }
+        }
+        else if (peer_offset <= count)
+        {
+            if (p_entry->direction == RBC_MESH_BRIDGE_DIR_TO_PEER)
+            {
+                value_forward(p_entry->handles.first + peer_offset, handle);
+            }
+            else
+            {
+                (void) vh_local_update(p_entry->handles.first + peer_offset,
+                        p_evt->params.rx.p_data, p_evt->params.rx.data_len);
+            }
+        }
+    }
+}
+
+#endif /* RBC_MESH_BRIDGE */
@@ -0,0 +1,431 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_config.h"
+
+#ifdef RBC_MESH_CONFIG_PUSH
+
+#include "version_handler.h"
+#include "transport_control.h"
+#include "event_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "trickle.h"
+#ifdef SOFTDEVICE_PRESENT
+#include "nrf_soc.h"
+#else
+#include "nrf.h"
+#endif
+#include "app_error.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define CONFIG_RECORD_INTERVAL      (0)
+#define CONFIG_RECORD_RADIO         (1)
+#define CONFIG_RECORD_CLASS_FIRST   (2)
+#define CONFIG_RECORD_COUNT         (CONFIG_RECORD_CLASS_FIRST + RBC_MESH_TRICKLE_CLASS_COUNT)
+
+#define CONFIG_SETTINGS_LEN         (7)
+#define CONFIG_SIGNED_LEN           (3 + CONFIG_SETTINGS_LEN) /**< Record ID, sequence number and settings. */
+#define CONFIG_MIC_LEN              (4)
+#define CONFIG_SWITCH_UNIT_US       (RBC_MESH_CONFIG_SWITCH_UNIT_MS * 1000)
+#define CONFIG_SWITCH_UNITS_MAX     (0xFFFF)
+
+#if (CONFIG_SIGNED_LEN + CONFIG_MIC_LEN != RBC_MESH_CONFIG_PAYLOAD_LEN)
+#error "The configuration record layout doesn't match RBC_MESH_CONFIG_PAYLOAD_LEN"
+#endif
+
+/** Extern declarations of the hidden api functions that apply the settings. */
+extern void rbc_mesh_radio_params_apply(uint32_t access_addr, uint8_t channel);
+extern void rbc_mesh_interval_min_apply(uint32_t interval_min_ms);
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+#ifdef SOFTDEVICE_PRESENT
+typedef nrf_ecb_hal_data_t ecb_data_t;
+#else
+/** Data block for the ECB peripheral, same layout as the SoftDevice's nrf_ecb_hal_data_t. */
+typedef struct
+{
+    uint8_t key[16];
+    uint8_t cleartext[16];
+    uint8_t ciphertext[16];
+} ecb_data_t;
+#endif
+
+/** Settings of each record, little endian:
+  - interval: min-interval in ms (4)
+  - radio: access address (4), channel (1), switch countdown (2)
+  - Trickle class: min-interval in ms (2), max-interval in ms (4), redundancy (1) */
+typedef struct
+{
+    bool known;
+    uint16_t seq;
+    uint8_t settings[CONFIG_SETTINGS_LEN];
+} config_record_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static config_record_t  m_records[CONFIG_RECORD_COUNT];
+static uint8_t          m_key[RBC_MESH_CONFIG_KEY_LEN];
+static bool             m_key_set;
+static bool             m_beaconing;
+static uint8_t          m_tx_next;          /**< Record to send in the next beacon, if known. */
+static timer_event_t    m_beacon_timer;
+static timer_event_t    m_switch_timer;
+static bool             m_switch_pending;
+static uint32_t         m_switch_time;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint32_t uint32_get(const uint8_t* p_data)
+{
+    return ((uint32_t) p_data[0] |
+            ((uint32_t) p_data[1] << 8) |
+            ((uint32_t) p_data[2] << 16) |
+            ((uint32_t) p_data[3] << 24));
+}
+
+static void uint32_put(uint32_t value, uint8_t* p_data)
+{
+    p_data[0] = (uint8_t) value;
+    p_data[1] = (uint8_t) (value >> 8);
+    p_data[2] = (uint8_t) (value >> 16);
+    p_data[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t ecb_block_encrypt(ecb_data_t* p_ecb)
+{
+#ifdef SOFTDEVICE_PRESENT
+    return sd_ecb_block_encrypt(p_ecb);
+#else
+    /* the framework owns the peripherals when there's no SoftDevice (RBC_MESH_STANDALONE) */
+    NRF_ECB->ECBDATAPTR = (uint32_t) (uintptr_t) p_ecb;
+    NRF_ECB->EVENTS_ENDECB = 0;
+    NRF_ECB->EVENTS_ERRORECB = 0;
+    NRF_ECB->TASKS_STARTECB = 1;
+    while (NRF_ECB->EVENTS_ENDECB == 0 && NRF_ECB->EVENTS_ERRORECB == 0)
+    {
+    }
+    /* aborted if the radio needed the AES core for CCM or AAR */
+    bool aborted = (NRF_ECB->EVENTS_ERRORECB != 0);
+    NRF_ECB->EVENTS_ENDECB = 0;
+    NRF_ECB->EVENTS_ERRORECB = 0;
+    return (aborted ? NRF_ERROR_BUSY : NRF_SUCCESS);
+#endif
+}
+
+static uint32_t mic_get(const uint8_t* p_signed, uint8_t* p_mic)
+{
+    ecb_data_t ecb;
+    memcpy(ecb.key, m_key, RBC_MESH_CONFIG_KEY_LEN);
+    memset(ecb.cleartext, 0, sizeof(ecb.cleartext));
+    memcpy(ecb.cleartext, p_signed, CONFIG_SIGNED_LEN);
+    uint32_t error_code = ecb_block_encrypt(&ecb);
+    if (error_code == NRF_SUCCESS)
+    {
+        memcpy(p_mic, ecb.ciphertext, CONFIG_MIC_LEN);
+    }
+    return error_code;
+}
+
+static bool interval_is_valid(uint32_t interval_min_ms)
+{
+    return (interval_min_ms >= RBC_MESH_INTERVAL_MIN_MIN_MS &&
+            interval_min_ms <= RBC_MESH_INTERVAL_MIN_MAX_MS);
+}
+
+/** Check records from other nodes the same way as our own, they may have been
+  built with other limits. */
+static bool settings_are_valid(uint8_t record, const uint8_t* p_settings)
+{
+    switch (record)
+    {
+        case CONFIG_RECORD_INTERVAL:
+            return interval_is_valid(uint32_get(&p_settings[0]));
+        case CONFIG_RECORD_RADIO:
+            return (p_settings[4] < 40);
+        default:
+        {
+            uint32_t interval_min_ms = (uint32_t) p_settings[0] | ((uint32_t) p_settings[1] << 8);
+            return (interval_is_valid(interval_min_ms) &&
+                    uint32_get(&p_settings[2]) >= interval_min_ms);
+        }
+    }
+}
+
+static void radio_switch(timestamp_t timestamp, void* p_context)
+{
+    m_switch_pending = false;
+    const uint8_t* p_settings = m_records[CONFIG_RECORD_RADIO].settings;
+    rbc_mesh_radio_params_apply(uint32_get(&p_settings[0]), p_settings[4]);
+}
+
+static void record_apply(uint8_t record, const uint8_t* p_settings, uint32_t time_now)
+{
+    switch (record)
+    {
+        case CONFIG_RECORD_INTERVAL:
+            rbc_mesh_interval_min_apply(uint32_get(&p_settings[0]));
+            break;
+        case CONFIG_RECORD_RADIO:
+        {
+            uint32_t countdown = (uint32_t) p_settings[5] | ((uint32_t) p_settings[6] << 8);
+            if (countdown == 0)
+            {
+                if (m_switch_pending)
+                {
+                    m_switch_pending = false;
+                    (void) timer_sch_abort(&m_switch_timer);
+                }
+                radio_switch(time_now, NULL);
+            }
+            else
+            {
+                m_switch_pending = true;
+                m_switch_time = time_now + countdown * CONFIG_SWITCH_UNIT_US;
+                m_switch_timer.cb = radio_switch;
+                m_switch_timer.interval = TIMER_EVENT_INTERVAL_SINGLE_SHOT;
+                APP_ERROR_CHECK(timer_sch_reschedule(&m_switch_timer, m_switch_time));
+            }
+            break;
+        }
+        default:
+        {
+            uint32_t interval_min_ms = (uint32_t) p_settings[0] | ((uint32_t) p_settings[1] << 8);
+            uint32_t interval_max_ms = uint32_get(&p_settings[2]);
+            (void) vh_trickle_class_config(record - CONFIG_RECORD_CLASS_FIRST,
+                    interval_min_ms * 1000, /* ms -> us */
+                    (interval_max_ms == RBC_MESH_INTERVAL_MAX_UNBOUNDED) ? TRICKLE_I_MAX_UNBOUNDED : interval_max_ms / interval_min_ms,
+                    p_settings[6]);
+            break;
+        }
+    }
+}
+
+/** Fill in the next known record, returns false if there are none. */
+static bool beacon_build(uint8_t* p_payload, uint32_t time_now)
+{
+    uint8_t record = m_tx_next;
+    for (uint32_t i = 0; i < CONFIG_RECORD_COUNT && !m_records[record].known; ++i)
+    {
+        record = (record + 1) % CONFIG_RECORD_COUNT;
+    }
+    if (!m_records[record].known)
+    {
+        return false;
+    }
+    m_tx_next = (record + 1) % CONFIG_RECORD_COUNT;
+
+    p_payload[0] = record;
+    p_payload[1] = (uint8_t) m_records[record].seq;
+    p_payload[2] = (uint8_t) (m_records[record].seq >> 8);
+    memcpy(&p_payload[3], m_records[record].settings, CONFIG_SETTINGS_LEN);
+    if (record == CONFIG_RECORD_RADIO)
+    {
+        uint32_t countdown = 0;
+        if (m_switch_pending && TIMER_OLDER_THAN(time_now, m_switch_time))
+        {
+            /* rounded up, so nobody switches before us */
+            countdown = (TIMER_DIFF(m_switch_time, time_now) + CONFIG_SWITCH_UNIT_US - 1) / CONFIG_SWITCH_UNIT_US;
+        }
+        p_payload[8] = (uint8_t) countdown;
+        p_payload[9] = (uint8_t) (countdown >> 8);
+    }
+    return (mic_get(p_payload, &p_payload[CONFIG_SIGNED_LEN]) == NRF_SUCCESS);
+}
+
+static void beacon_tx(timestamp_t timestamp, void* p_context)
+{
+    uint8_t payload[RBC_MESH_CONFIG_PAYLOAD_LEN];
+    if (!beacon_build(payload, timer_now()))
+    {
+        return;
+    }
+
+    uint32_t access_address;
+    uint8_t channel;
+    APP_ERROR_CHECK(rbc_mesh_access_address_get(&access_address));
+    APP_ERROR_CHECK(rbc_mesh_channel_get(&channel));
+    tc_tx_config_t tx_config;
+    tx_config.alt_access_address = (access_address != RBC_MESH_ACCESS_ADDRESS_BLE_ADV);
+    tx_config.first_channel = channel;
+    tx_config.channel_map = 1; /* Only the first channel */
+    tx_config.tx_power = vh_tx_power_get();
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_CONFIG_HANDLE,
+                    0,
+                    payload,
+                    RBC_MESH_CONFIG_PAYLOAD_LEN) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+
+static void record_store(uint8_t record, uint16_t seq, const uint8_t* p_settings, uint32_t time_now)
+{
+    m_records[record].known = true;
+    m_records[record].seq = seq;
+    memcpy(m_records[record].settings, p_settings, CONFIG_SETTINGS_LEN);
+    record_apply(record, p_settings, time_now);
+
+    if (!m_beaconing)
+    {
+        m_beaconing = true;
+        m_beacon_timer.cb = beacon_tx;
+        m_beacon_timer.interval = RBC_MESH_CONFIG_INTERVAL_US;
+        APP_ERROR_CHECK(timer_sch_reschedule(&m_beacon_timer, time_now + RBC_MESH_CONFIG_INTERVAL_US));
+    }
+}
+
+static uint32_t record_push(uint8_t record, const uint8_t* p_settings)
+{
+    if (!m_key_set)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    event_handler_critical_section_begin();
+    uint16_t seq = m_records[record].known ? m_records[record].seq + 1 : 1;
+    record_store(record, seq, p_settings, timer_now());
+    m_tx_next = record; /* the change goes out first */
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_config_key_set(const uint8_t* p_key)
+{
+    if (p_key == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    event_handler_critical_section_begin();
+    memcpy(m_key, p_key, RBC_MESH_CONFIG_KEY_LEN);
+    m_key_set = true;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_config_interval_push(uint32_t interval_min_ms)
+{
+    if (!interval_is_valid(interval_min_ms))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    uint8_t settings[CONFIG_SETTINGS_LEN] = {0};
+    uint32_put(interval_min_ms, &settings[0]);
+    return record_push(CONFIG_RECORD_INTERVAL, settings);
+}
+
+uint32_t mesh_config_trickle_class_push(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy)
+{
+    if (trickle_class >= RBC_MESH_TRICKLE_CLASS_COUNT ||
+        !interval_is_valid(interval_min_ms) ||
+        interval_max_ms < interval_min_ms)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    uint8_t settings[CONFIG_SETTINGS_LEN];
+    settings[0] = (uint8_t) interval_min_ms;
+    settings[1] = (uint8_t) (interval_min_ms >> 8);
+    uint32_put(interval_max_ms, &settings[2]);
+    settings[6] = redundancy;
+    return record_push(CONFIG_RECORD_CLASS_FIRST + trickle_class, settings);
+}
+
+uint32_t mesh_config_radio_push(uint32_t access_address, uint8_t channel, uint32_t switch_delay_ms)
+{
+    uint32_t countdown = (switch_delay_ms + RBC_MESH_CONFIG_SWITCH_UNIT_MS - 1) / RBC_MESH_CONFIG_SWITCH_UNIT_MS;
+    if (channel >= 40 || countdown > CONFIG_SWITCH_UNITS_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    uint8_t settings[CONFIG_SETTINGS_LEN];
+    uint32_put(access_address, &settings[0]);
+    settings[4] = channel;
+    settings[5] = (uint8_t) countdown;
+    settings[6] = (uint8_t) (countdown >> 8);
+    return record_push(CONFIG_RECORD_RADIO, settings);
+}
+
+uint32_t mesh_config_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (!m_key_set)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_adv_data->adv_data_length != MESH_PACKET_ADV_OVERHEAD + RBC_MESH_CONFIG_PAYLOAD_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    const uint8_t* p_payload = p_adv_data->data;
+    uint8_t record = p_payload[0];
+    if (record >= CONFIG_RECORD_COUNT)
+    {
+        /* from a node with more Trickle classes */
+        return NRF_ERROR_INVALID_DATA;
+    }
+    uint16_t seq = (uint16_t) p_payload[1] | ((uint16_t) p_payload[2] << 8);
+    if (m_records[record].known && (int16_t) (uint16_t) (seq - m_records[record].seq) <= 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    uint8_t mic[CONFIG_MIC_LEN];
+    if (mic_get(p_payload, mic) != NRF_SUCCESS ||
+        memcmp(mic, &p_payload[CONFIG_SIGNED_LEN], CONFIG_MIC_LEN) != 0 ||
+        !settings_are_valid(record, &p_payload[3]))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    record_store(record, seq, &p_payload[3], timer_now());
+    return NRF_SUCCESS;
+}
+
+#endif /* RBC_MESH_CONFIG_PUSH */
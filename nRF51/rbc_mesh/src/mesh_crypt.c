@@ -0,0 +1,490 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_crypt.h"
+
+#ifdef RBC_MESH_ENCRYPTION
+
+#include "mesh_packet.h"
+#include "rand.h"
+#include "timer.h"
+#include "toolchain.h"
+#include "nrf.h"
+#include "nrf_error.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+/** Longest payload the CCM peripheral takes, before the MIC. */
+#define CCM_PAYLOAD_MAX_LEN             (27)
+/** Size of the CCM packet header: S0, length and S1. */
+#define CCM_HEADER_LEN                  (3)
+/** Size of the CCM scratch area, for the longest payload. */
+#define CCM_SCRATCH_LEN                 (16 + CCM_PAYLOAD_MAX_LEN)
+/** Size of the MIC appended by the CCM. */
+#define CCM_MIC_LEN                     (4)
+
+/** Length of the clear part of a mesh AD structure: handle, version and data. */
+#define CLEAR_LEN(adv_data_length)      ((adv_data_length) - (1 /* adv_type */ + 2 /* UUID */))
+
+/** Number of sequence numbers behind the highest one that are tracked per sender. */
+#define REPLAY_WINDOW_SIZE              (32)
+#define REPLAY_ENTRY_INVALID            (0xFF)
+#define REPLAY_INDEX_MASK               (RBC_MESH_REPLAY_INDEX_SIZE - 1)
+/** Multiplicative hash of the lower four address bytes. */
+#define REPLAY_INDEX_SLOT(p_addr)       (((replay_addr_key_get(p_addr) * 2654435761UL) >> 24) & REPLAY_INDEX_MASK)
+
+#if (RBC_MESH_VALUE_MAX_LEN + 4 + RBC_MESH_HOP_SCOPE_OVERHEAD + RBC_MESH_ORIGIN_TIME_OVERHEAD > CCM_PAYLOAD_MAX_LEN) || \
+    (MESH_PACKET_ADV_OVERHEAD + MESH_CRYPT_OVERHEAD + RBC_MESH_VALUE_MAX_LEN + 1 > BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
+#error "RBC_MESH_VALUE_MAX_LEN is too long for encrypted packets"
+#endif
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+/** Configuration structure of the CCM peripheral. */
+typedef __packed_armcc struct
+{
+    uint8_t key[MESH_CRYPT_KEY_LEN];
+    uint64_t counter;   /**< Only the lower 39 bits are used. */
+    uint8_t direction;
+    uint8_t iv[8];
+} __packed_gcc ccm_config_t;
+
+typedef __packed_armcc struct
+{
+    uint8_t     adv_data_length;
+    uint8_t     adv_data_type;
+    uint16_t    mesh_uuid;
+    uint32_t    seq;
+    uint8_t     data[];     /**< Encrypted handle, version and data, followed by the MIC. */
+} __packed_gcc mesh_crypt_adv_data_t;
+
+/** Sequence number window of a sender, kept in an LRU list like the handle cache. */
+typedef struct
+{
+    uint8_t     addr[BLE_GAP_ADDR_LEN];
+    uint8_t     index_prev;
+    uint8_t     index_next;
+    uint32_t    seq_top;    /**< Highest sequence number received. */
+    uint32_t    window;     /**< Bit n is set if seq_top - n has been received. */
+    timestamp_t last_rx;
+    bool        in_use;
+} replay_entry_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static ccm_config_t m_ccm_config;
+/* The CCM works on packets in RAM, in the same format as the radio. */
+static uint32_t     m_ccm_in[(CCM_HEADER_LEN + CCM_PAYLOAD_MAX_LEN + CCM_MIC_LEN + 3) / 4];
+static uint32_t     m_ccm_out[(CCM_HEADER_LEN + CCM_PAYLOAD_MAX_LEN + CCM_MIC_LEN + 3) / 4];
+static uint32_t     m_ccm_scratch[(CCM_SCRATCH_LEN + 3) / 4];
+static bool         m_key_set;
+static uint32_t     m_seq;
+static uint8_t      m_local_addr[BLE_GAP_ADDR_LEN];
+static uint8_t      m_local_addr_type;
+
+static replay_entry_t   m_replay_cache[RBC_MESH_REPLAY_CACHE_ENTRIES];
+static uint8_t          m_replay_index[RBC_MESH_REPLAY_INDEX_SIZE]; /**< Open addressing hash index into m_replay_cache. */
+static uint8_t          m_replay_head;
+static uint8_t          m_replay_tail;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static bool handle_is_protected(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_DELTA_UPDATES
+    if (handle == RBC_MESH_DELTA_HANDLE)
+    {
+        /* carries application data */
+        return true;
+    }
+#endif
+#ifdef RBC_MESH_NETWORK_CODING
+    if (handle == RBC_MESH_NETCODE_HANDLE)
+    {
+        /* carries application data */
+        return true;
+    }
+#endif
+    return (handle <= RBC_MESH_APP_MAX_HANDLE);
+}
+
+static void nonce_set(uint32_t seq, const uint8_t* p_addr)
+{
+    m_ccm_config.counter = seq;
+    m_ccm_config.direction = 0;
+    memcpy(m_ccm_config.iv, p_addr, BLE_GAP_ADDR_LEN);
+    m_ccm_config.iv[6] = 0;
+    m_ccm_config.iv[7] = 0;
+}
+
+static uint32_t replay_addr_key_get(const uint8_t* p_addr)
+{
+    return ((uint32_t) p_addr[0] | ((uint32_t) p_addr[1] << 8) | ((uint32_t) p_addr[2] << 16) | ((uint32_t) p_addr[3] << 24));
+}
+
+static void replay_cache_reset(void)
+{
+    memset(m_replay_index, REPLAY_ENTRY_INVALID, sizeof(m_replay_index));
+    for (uint32_t i = 0; i < RBC_MESH_REPLAY_CACHE_ENTRIES; ++i)
+    {
+        m_replay_cache[i].in_use = false;
+        m_replay_cache[i].index_prev = (i == 0 ? REPLAY_ENTRY_INVALID : i - 1);
+        m_replay_cache[i].index_next = (i == RBC_MESH_REPLAY_CACHE_ENTRIES - 1 ? REPLAY_ENTRY_INVALID : i + 1);
+    }
+    m_replay_head = 0;
+    m_replay_tail = RBC_MESH_REPLAY_CACHE_ENTRIES - 1;
+}
+
+static uint8_t replay_entry_find(const uint8_t* p_addr)
+{
+    /* the index is larger than the cache, there's always an empty slot to stop at */
+    for (uint32_t slot = REPLAY_INDEX_SLOT(p_addr);
+         m_replay_index[slot] != REPLAY_ENTRY_INVALID;
+         slot = (slot + 1) & REPLAY_INDEX_MASK)
+    {
+        if (memcmp(m_replay_cache[m_replay_index[slot]].addr, p_addr, BLE_GAP_ADDR_LEN) == 0)
+        {
+            return m_replay_index[slot];
+        }
+    }
+    return REPLAY_ENTRY_INVALID;
+}
+
+static void replay_index_add(uint8_t entry)
+{
+    uint32_t slot = REPLAY_INDEX_SLOT(m_replay_cache[entry].addr);
+    while (m_replay_index[slot] != REPLAY_ENTRY_INVALID)
+    {
+        slot = (slot + 1) & REPLAY_INDEX_MASK;
+    }
+    m_replay_index[slot] = entry;
+}
+
+static void replay_index_remove(uint8_t entry)
+{
+    uint32_t hole = REPLAY_INDEX_SLOT(m_replay_cache[entry].addr);
+    while (m_replay_index[hole] != entry)
+    {
+        hole = (hole + 1) & REPLAY_INDEX_MASK;
+    }
+
+    /* shift the following entries of the probe sequence back into the hole */
+    for (uint32_t slot = (hole + 1) & REPLAY_INDEX_MASK;
+         m_replay_index[slot] != REPLAY_ENTRY_INVALID;
+         slot = (slot + 1) & REPLAY_INDEX_MASK)
+    {
+        uint32_t home = REPLAY_INDEX_SLOT(m_replay_cache[m_replay_index[slot]].addr);
+        if (((slot - home) & REPLAY_INDEX_MASK) >= ((slot - hole) & REPLAY_INDEX_MASK))
+        {
+            m_replay_index[hole] = m_replay_index[slot];
+            hole = slot;
+        }
+    }
+    m_replay_index[hole] = REPLAY_ENTRY_INVALID;
+}
+
+static void replay_entry_to_head(uint8_t entry)
+{
+    if (entry == m_replay_head)
+    {
+        return;
+    }
+    replay_entry_t* p_entry = &m_replay_cache[entry];
+    m_replay_cache[p_entry->index_prev].index_next = p_entry->index_next;
+    if (entry == m_replay_tail)
+    {
+        m_replay_tail = p_entry->index_prev;
+    }
+    else
+    {
+        m_replay_cache[p_entry->index_next].index_prev = p_entry->index_prev;
+    }
+    p_entry->index_prev = REPLAY_ENTRY_INVALID;
+    p_entry->index_next = m_replay_head;
+    m_replay_cache[m_replay_head].index_prev = entry;
+    m_replay_head = entry;
+}
+
+/** Check the sequence number against the window of the sender, without changing it. */
+static bool replay_check(uint8_t entry, uint32_t seq)
+{
+    const replay_entry_t* p_entry = &m_replay_cache[entry];
+    int32_t ahead = (int32_t) (seq - p_entry->seq_top);
+    if (ahead > 0)
+    {
+        return true;
+    }
+    uint32_t behind = (uint32_t) -ahead;
+    return (behind < REPLAY_WINDOW_SIZE && (p_entry->window & (1UL << behind)) == 0);
+}
+
+/** Record an authenticated sequence number, taking over the oldest entry for
+  new senders. The window starts over if restart is set. */
+static void replay_update(uint8_t entry, bool restart, const uint8_t* p_addr, uint32_t seq, timestamp_t now)
+{
+    replay_entry_t* p_entry;
+    if (entry == REPLAY_ENTRY_INVALID)
+    {
+        entry = m_replay_tail;
+        p_entry = &m_replay_cache[entry];
+        if (p_entry->in_use)
+        {
+            replay_index_remove(entry);
+        }
+        memcpy(p_entry->addr, p_addr, BLE_GAP_ADDR_LEN);
+        p_entry->in_use = true;
+        replay_index_add(entry);
+        restart = true;
+    }
+    else
+    {
+        p_entry = &m_replay_cache[entry];
+    }
+
+    if (restart)
+    {
+        p_entry->seq_top = seq;
+        p_entry->window = 1;
+    }
+    else
+    {
+        int32_t ahead = (int32_t) (seq - p_entry->seq_top);
+        if (ahead > 0)
+        {
+            p_entry->window = (ahead < REPLAY_WINDOW_SIZE ? (p_entry->window << ahead) : 0) | 1;
+            p_entry->seq_top = seq;
+        }
+        else
+        {
+            p_entry->window |= (1UL << (uint32_t) -ahead);
+        }
+    }
+    p_entry->last_rx = now;
+    replay_entry_to_head(entry);
+}
+
+/** Run the CCM on m_ccm_in, and wait for the result in m_ccm_out. */
+static bool ccm_run(uint32_t mode)
+{
+    NRF_CCM->ENABLE = (CCM_ENABLE_ENABLE_Enabled << CCM_ENABLE_ENABLE_Pos);
+    NRF_CCM->MODE = (mode << CCM_MODE_MODE_Pos);
+    NRF_CCM->CNFPTR = (uint32_t) &m_ccm_config;
+    NRF_CCM->INPTR = (uint32_t) m_ccm_in;
+    NRF_CCM->OUTPTR = (uint32_t) m_ccm_out;
+    NRF_CCM->SCRATCHPTR = (uint32_t) m_ccm_scratch;
+    NRF_CCM->SHORTS = CCM_SHORTS_ENDKSGEN_CRYPT_Msk;
+    NRF_CCM->EVENTS_ENDKSGEN = 0;
+    NRF_CCM->EVENTS_ENDCRYPT = 0;
+    NRF_CCM->EVENTS_ERROR = 0;
+
+    NRF_CCM->TASKS_KSGEN = 1;
+    /* a couple of AES blocks, cheaper to wait than to take an interrupt */
+    while (NRF_CCM->EVENTS_ENDCRYPT == 0 && NRF_CCM->EVENTS_ERROR == 0);
+
+    bool success = (NRF_CCM->EVENTS_ERROR == 0);
+    if (mode == CCM_MODE_MODE_Decryption)
+    {
+        success = success && (NRF_CCM->MICSTATUS == CCM_MICSTATUS_MICSTATUS_CheckPassed);
+    }
+
+    NRF_CCM->SHORTS = 0;
+    NRF_CCM->ENABLE = (CCM_ENABLE_ENABLE_Disabled << CCM_ENABLE_ENABLE_Pos);
+    return success;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_crypt_key_set(const uint8_t* p_key)
+{
+    if (p_key == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    /* The address is read here, as the SoftDevice can't be called from the
+       radio interrupt where the packets are encrypted. */
+    mesh_packet_t addr_packet;
+    uint32_t error_code = mesh_packet_set_local_addr(&addr_packet);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    uint32_t seq;
+    error_code = rand_hw_rng_get((uint8_t*) &seq, sizeof(seq));
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    memcpy(m_ccm_config.key, p_key, MESH_CRYPT_KEY_LEN);
+    memcpy(m_local_addr, addr_packet.addr, BLE_GAP_ADDR_LEN);
+    m_local_addr_type = addr_packet.header.addr_type;
+    m_seq = seq;
+    replay_cache_reset();
+    m_key_set = true;
+    _ENABLE_IRQS(was_masked);
+
+    return NRF_SUCCESS;
+}
+
+bool mesh_crypt_key_is_set(void)
+{
+    return m_key_set;
+}
+
+bool mesh_crypt_packet_is_protected(mesh_packet_t* p_packet)
+{
+    for (mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+         p_adv_data != NULL;
+         p_adv_data = mesh_packet_adv_data_next_get(p_packet, p_adv_data))
+    {
+        if (handle_is_protected(p_adv_data->handle))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool mesh_crypt_encrypt(mesh_packet_t* p_packet, mesh_packet_t* p_out)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (!m_key_set ||
+        p_adv_data == NULL ||
+        !handle_is_protected(p_adv_data->handle) ||
+        CLEAR_LEN(p_adv_data->adv_data_length) > CCM_PAYLOAD_MAX_LEN)
+    {
+        return false;
+    }
+
+    uint8_t clear_len = CLEAR_LEN(p_adv_data->adv_data_length);
+    uint8_t* p_in = (uint8_t*) m_ccm_in;
+    p_in[0] = 0;
+    p_in[1] = clear_len;
+    p_in[2] = 0;
+    memcpy(&p_in[CCM_HEADER_LEN], &((uint8_t*) p_adv_data)[offsetof(mesh_adv_data_t, handle)], clear_len);
+
+    nonce_set(m_seq, m_local_addr);
+    if (!ccm_run(CCM_MODE_MODE_Encryption))
+    {
+        return false;
+    }
+
+    /* Relayed packets go out with the address of this node, so the nonces of
+       the original sender are never reused for other contents. */
+    p_out->header = p_packet->header;
+    p_out->header.addr_type = m_local_addr_type;
+    memcpy(p_out->addr, m_local_addr, BLE_GAP_ADDR_LEN);
+
+    mesh_crypt_adv_data_t* p_crypt_adv_data = (mesh_crypt_adv_data_t*) &p_out->payload[0];
+    p_crypt_adv_data->adv_data_length = 1 /* adv_type */ + 2 /* UUID */ + MESH_CRYPT_OVERHEAD + clear_len;
+    p_crypt_adv_data->adv_data_type = MESH_ADV_DATA_TYPE;
+    p_crypt_adv_data->mesh_uuid = MESH_UUID_ENCRYPTED;
+    p_crypt_adv_data->seq = m_seq;
+    memcpy(p_crypt_adv_data->data, &((uint8_t*) m_ccm_out)[CCM_HEADER_LEN], clear_len + CCM_MIC_LEN);
+    p_out->header.length = MESH_PACKET_BLE_OVERHEAD + 1 + p_crypt_adv_data->adv_data_length;
+
+    m_seq++;
+    return true;
+}
+
+uint32_t mesh_crypt_decrypt(mesh_packet_t* p_packet)
+{
+    mesh_crypt_adv_data_t* p_crypt_adv_data = (mesh_crypt_adv_data_t*) &p_packet->payload[0];
+    if (p_packet->header.length < MESH_PACKET_BLE_OVERHEAD + 2 ||
+        p_crypt_adv_data->adv_data_type != MESH_ADV_DATA_TYPE ||
+        p_crypt_adv_data->mesh_uuid != MESH_UUID_ENCRYPTED)
+    {
+        /* application values are never accepted in clear */
+        return (mesh_crypt_packet_is_protected(p_packet) ? NRF_ERROR_INVALID_DATA : NRF_SUCCESS);
+    }
+
+    if (!m_key_set)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    const uint8_t overhead = 1 /* adv_type */ + 2 /* UUID */ + MESH_CRYPT_OVERHEAD;
+    if (p_crypt_adv_data->adv_data_length < overhead + 4 /* handle, version */ + RBC_MESH_HOP_SCOPE_OVERHEAD + RBC_MESH_ORIGIN_TIME_OVERHEAD ||
+        p_crypt_adv_data->adv_data_length > overhead + CCM_PAYLOAD_MAX_LEN ||
+        p_packet->header.length < MESH_PACKET_BLE_OVERHEAD + 1 + p_crypt_adv_data->adv_data_length)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    /* replays are rejected before spending time on the CCM */
+    uint32_t seq = p_crypt_adv_data->seq;
+    timestamp_t now = timer_now();
+    uint8_t replay_entry = replay_entry_find(p_packet->addr);
+    /* a sender that has been quiet for a while may have restarted with a new
+       sequence number, and gets a new window */
+    bool replay_restart = (replay_entry == REPLAY_ENTRY_INVALID ||
+                           now - m_replay_cache[replay_entry].last_rx > RBC_MESH_REPLAY_STALE_US);
+    if (!replay_restart && !replay_check(replay_entry, seq))
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+
+    uint8_t clear_len = p_crypt_adv_data->adv_data_length - overhead;
+    uint8_t* p_in = (uint8_t*) m_ccm_in;
+    p_in[0] = 0;
+    p_in[1] = clear_len + CCM_MIC_LEN;
+    p_in[2] = 0;
+    memcpy(&p_in[CCM_HEADER_LEN], p_crypt_adv_data->data, clear_len + CCM_MIC_LEN);
+
+    nonce_set(seq, p_packet->addr);
+    if (!ccm_run(CCM_MODE_MODE_Decryption))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    replay_update(replay_entry, replay_restart, p_packet->addr, seq, now);
+
+    /* put the clear mesh AD structure in place of the encrypted one, anything
+       after it was never authenticated, and is dropped. */
+    mesh_adv_data_t* p_adv_data = (mesh_adv_data_t*) &p_packet->payload[0];
+    p_adv_data->adv_data_length = offsetof(mesh_adv_data_t, handle) - 1 /* length */ + clear_len;
+    p_adv_data->mesh_uuid = MESH_UUID;
+    memcpy(&p_packet->payload[offsetof(mesh_adv_data_t, handle)], &((uint8_t*) m_ccm_out)[CCM_HEADER_LEN], clear_len);
+    p_packet->header.length = MESH_PACKET_BLE_OVERHEAD + 1 + p_adv_data->adv_data_length;
+
+    return NRF_SUCCESS;
+}
+
+#endif /* RBC_MESH_ENCRYPTION */
@@ -38,6 +38,7 @@
 #include "nrf_flash.h"
 #include "nrf_error.h"
 #include "toolchain.h"
+#include "mesh_trace.h"
 #include "app_error.h"
 #include "dfu_util.h"
 
@@ -45,8 +46,13 @@
 * Local defines
 *****************************************************************************/
 
-/** Number of flash operations that can be queued at once. */
+/** Number of flash operations that can be queued at once, for each priority. */
 #define FLASH_OP_QUEUE_LEN					(8)
+/** Number of ended operations that may wait for their end to be reported. */
+#define FLASH_OP_USER_LOG_LEN               (2 * FLASH_OP_QUEUE_LEN)
+/** Number of high priority operations to run in a row while low priority
+ * operations are waiting, before giving one of them a turn. */
+#define FLASH_OP_HIGH_PRIORITY_BURST        (4)
 
 /** Maximum time spent after a flash operation for cleanup. */
 #define FLASH_OP_POST_PROCESS_TIME_US		(500)
@@ -73,19 +79,43 @@
 /*****************************************************************************
 * Local typedefs
 *****************************************************************************/
+/** Where the next flash operation comes from. */
+typedef enum
+{
+    OP_SOURCE_HIGH,     /**< High priority queue. */
+    OP_SOURCE_PARKED,   /**< Preempted low priority operation. */
+    OP_SOURCE_LOW,      /**< Low priority queue. */
+    OP_SOURCE_NONE
+} op_source_t;
+
 /** Single flash operation. */
 typedef struct
 {
     flash_op_type_t type;     /**< Type of flash operation. */
     flash_op_t operation;     /**< Operation parameters. */
+    mesh_flash_user_t user;   /**< User that pushed the operation. */
+    timestamp_t push_time;    /**< Time the operation was pushed. */
 } operation_t;
 
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
-static fifo_t				m_flash_op_fifo;                           /**< FIFO structure for the flash operations. */
-static operation_t			m_flash_op_fifo_queue[FLASH_OP_QUEUE_LEN]; /**< FIFO buffer for flash operations. */
-static mesh_flash_op_cb_t	mp_cb;                                     /**< Flash operation end callback pointer. Called when a flash operation ended. */
+/** Priority of each user's operations. Short, latency sensitive writes go first. */
+static const mesh_flash_priority_t m_user_priority[MESH_FLASH_USERS] =
+{
+    MESH_FLASH_PRIORITY_LOW,  /* MESH_FLASH_USER_DFU */
+    MESH_FLASH_PRIORITY_HIGH, /* MESH_FLASH_USER_VALUES */
+};
+
+static fifo_t				m_flash_op_fifo[MESH_FLASH_PRIORITIES];    /**< FIFO structures for the flash operations, for each priority. */
+static operation_t			m_flash_op_fifo_queue[MESH_FLASH_PRIORITIES][FLASH_OP_QUEUE_LEN]; /**< FIFO buffers for flash operations. */
+static operation_t          m_parked_op;                               /**< Low priority operation preempted by a high priority one. */
+static uint32_t             m_parked_addr;                             /**< Start address of the parked operation. */
+static uint32_t             m_high_burst;                              /**< High priority operations started in a row. */
+static mesh_flash_stats_t   m_stats[MESH_FLASH_PRIORITIES];            /**< Queue latency statistics. */
+static uint32_t             m_user_pending[MESH_FLASH_USERS];          /**< Operations pushed by each user that haven't been reported as ended. */
+static mesh_flash_op_cb_t	mp_cb[MESH_FLASH_USERS];                   /**< Flash operation end callback pointers for each user. Called when a flash operation ended. */
+static bool                 m_initialized;                             /**< The operation queue has been initialized. */
 static operation_t          m_curr_op;                                 /**< Current flash operation. */
 static uint32_t             m_op_addr;                                 /**< Start address of current operation. */
 static bool                 m_suspended;                               /**< Suspend flag, preventing flash operations while set. */
@@ -97,7 +127,11 @@ static bool                 m_suspended;                               /**< Susp
  * responsible for keeping track of this.
  */
 static uint32_t             m_operation_count;                         /**< Number of flash operations executed since bootup. */
+static uint32_t             m_operations_ended;                        /**< Number of flash operation end events sent since bootup. */
 static uint32_t             m_operations_reported;                     /**< Number of flash operations reported to app as ended since bootup. */
+/** Users of the ended operations that haven't been reported yet, indexed by end event count. The
+ * end events are reported in the order they were sent. */
+static mesh_flash_user_t    m_op_users[FLASH_OP_USER_LOG_LEN];
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
@@ -119,6 +153,7 @@ static timestamp_t operation_time(const operation_t* p_op)
 
 static void operation_execute(operation_t* p_op)
 {
+    TRACE_BEGIN(MESH_TRACE_POINT_FLASH_OP, p_op->type);
     switch (p_op->type)
     {
         case FLASH_OP_TYPE_ERASE:
@@ -132,6 +167,7 @@ static void operation_execute(operation_t* p_op)
         default:
             APP_ERROR_CHECK(NRF_ERROR_INVALID_DATA);
     }
+    TRACE_END(MESH_TRACE_POINT_FLASH_OP, p_op->type);
 }
 
 static void write_as_much_as_possible(flash_op_t* p_write_op, timestamp_t* p_available_time, uint32_t* p_bytes_written)
@@ -190,37 +226,85 @@ static void erase_as_much_as_possible(flash_op_t* p_erase_op, timestamp_t* p_ava
     *p_available_time -= operation_time(&temp_op);
 }
 
+static inline bool queues_empty(void)
+{
+    for (uint32_t i = 0; i < MESH_FLASH_PRIORITIES; ++i)
+    {
+        if (!fifo_is_empty(&m_flash_op_fifo[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 static inline bool all_operations_ended(void)
 {
-    return (fifo_is_empty(&m_flash_op_fifo) && (m_operations_reported == m_operation_count));
+    return (queues_empty() && (m_operations_reported == m_operation_count));
 }
 
-static void write_operation_ended(void* p_location)
+static void latency_register(const operation_t* p_op)
 {
-    mp_cb(FLASH_OP_TYPE_WRITE, p_location);
-    ++m_operations_reported;
-    if (all_operations_ended())
+    mesh_flash_stats_t* p_stats = &m_stats[m_user_priority[p_op->user]];
+    uint32_t latency = TIMER_DIFF(timer_now(), p_op->push_time);
+    if (p_stats->operations == 0)
+    {
+        p_stats->latency_avg_us = latency;
+    }
+    else
+    {
+        /* moving average over the last ~8 operations */
+        p_stats->latency_avg_us = p_stats->latency_avg_us - (p_stats->latency_avg_us >> 3) + (latency >> 3);
+    }
+    if (latency > p_stats->latency_max_us)
     {
-        mp_cb(FLASH_OP_TYPE_ALL, NULL);
+        p_stats->latency_max_us = latency;
     }
+    p_stats->operations++;
 }
 
-static void erase_operation_ended(void* p_source)
+static void operation_ended(flash_op_type_t type, void* p_location)
 {
-    mp_cb(FLASH_OP_TYPE_ERASE, p_source);
+    const mesh_flash_user_t user = m_op_users[m_operations_reported % FLASH_OP_USER_LOG_LEN];
+    mesh_flash_op_cb_t cb = mp_cb[user];
+    m_user_pending[user]--;
+    if (cb != NULL)
+    {
+        cb(type, p_location);
+    }
     ++m_operations_reported;
     if (all_operations_ended())
     {
-        mp_cb(FLASH_OP_TYPE_ALL, NULL);
+        for (uint32_t i = 0; i < MESH_FLASH_USERS; ++i)
+        {
+            if (mp_cb[i] != NULL)
+            {
+                mp_cb[i](FLASH_OP_TYPE_ALL, NULL);
+            }
+        }
     }
 }
 
+static void write_operation_ended(void* p_location)
+{
+    operation_ended(FLASH_OP_TYPE_WRITE, p_location);
+}
+
+static void erase_operation_ended(void* p_source)
+{
+    operation_ended(FLASH_OP_TYPE_ERASE, p_source);
+}
+
 static bool send_end_evt(void)
 {
     if (m_operation_count == 0 || m_curr_op.type == FLASH_OP_TYPE_NONE)
     {
         return true; /* no events to send */
     }
+    if (m_operations_ended - m_operations_reported >= FLASH_OP_USER_LOG_LEN)
+    {
+        return false;
+    }
     async_event_t end_evt;
     end_evt.type = EVENT_TYPE_GENERIC;
     if (m_curr_op.type == FLASH_OP_TYPE_ERASE)
@@ -237,20 +321,106 @@ static bool send_end_evt(void)
     {
         return false;
     }
+    m_op_users[m_operations_ended % FLASH_OP_USER_LOG_LEN] = m_curr_op.user;
+    m_operations_ended++;
+    m_curr_op.type = FLASH_OP_TYPE_NONE;
 
     return true;
 }
 
-static bool next_operation_get(void)
+/** Park the current low priority operation if a high priority one is waiting. */
+static bool preempt(void)
 {
-    /* Get next operation */
-    if (fifo_pop(&m_flash_op_fifo, &m_curr_op) != NRF_SUCCESS)
+    if (m_parked_op.type != FLASH_OP_TYPE_NONE ||
+        m_user_priority[m_curr_op.user] != MESH_FLASH_PRIORITY_LOW ||
+        fifo_is_empty(&m_flash_op_fifo[MESH_FLASH_PRIORITY_HIGH]))
+    {
+        return false;
+    }
+    memcpy(&m_parked_op, &m_curr_op, sizeof(operation_t));
+    m_parked_addr = m_op_addr;
+    m_high_burst = 0;
+    return true;
+}
+
+/** Get the source of the next operation. High priority first, but let the
+ * low priority operations have every FLASH_OP_HIGH_PRIORITY_BURST'th turn. */
+static op_source_t next_source_get(void)
+{
+    const bool high_waiting = !fifo_is_empty(&m_flash_op_fifo[MESH_FLASH_PRIORITY_HIGH]);
+    const bool low_waiting = (m_parked_op.type != FLASH_OP_TYPE_NONE ||
+                              !fifo_is_empty(&m_flash_op_fifo[MESH_FLASH_PRIORITY_LOW]));
+    if (high_waiting && (m_high_burst < FLASH_OP_HIGH_PRIORITY_BURST || !low_waiting))
+    {
+        return OP_SOURCE_HIGH;
+    }
+    if (m_parked_op.type != FLASH_OP_TYPE_NONE)
+    {
+        return OP_SOURCE_PARKED;
+    }
+    if (low_waiting)
+    {
+        return OP_SOURCE_LOW;
+    }
+    return OP_SOURCE_NONE;
+}
+
+/** Get the operation that will be executed next, without taking it. */
+static const operation_t* next_operation_peek(void)
+{
+    switch (next_source_get())
+    {
+        case OP_SOURCE_HIGH:
+            return fifo_elem_ref_at(&m_flash_op_fifo[MESH_FLASH_PRIORITY_HIGH], 0);
+        case OP_SOURCE_PARKED:
+            return &m_parked_op;
+        case OP_SOURCE_LOW:
+            return fifo_elem_ref_at(&m_flash_op_fifo[MESH_FLASH_PRIORITY_LOW], 0);
+        default:
+            return NULL;
+    }
+}
+
+/** Check whether the next write continues where the ended one stopped, and
+ * can follow it without the post processing time in between. */
+static bool write_chained(void)
+{
+    if (m_curr_op.type != FLASH_OP_TYPE_WRITE || operation_time(&m_curr_op) != 0)
     {
-        m_curr_op.type = FLASH_OP_TYPE_NONE;
         return false;
     }
+    const operation_t* p_next = next_operation_peek();
+    return (p_next != NULL &&
+            p_next->type == FLASH_OP_TYPE_WRITE &&
+            p_next->operation.write.start_addr == m_curr_op.operation.write.start_addr);
+}
+
+static bool next_operation_get(void)
+{
+    switch (next_source_get())
+    {
+        case OP_SOURCE_HIGH:
+            APP_ERROR_CHECK(fifo_pop(&m_flash_op_fifo[MESH_FLASH_PRIORITY_HIGH], &m_curr_op));
+            m_high_burst++;
+            break;
+        case OP_SOURCE_PARKED:
+            /* resume the preempted operation where it left off. */
+            memcpy(&m_curr_op, &m_parked_op, sizeof(operation_t));
+            m_op_addr = m_parked_addr;
+            m_parked_op.type = FLASH_OP_TYPE_NONE;
+            m_high_burst = 0;
+            return true;
+        case OP_SOURCE_LOW:
+            APP_ERROR_CHECK(fifo_pop(&m_flash_op_fifo[MESH_FLASH_PRIORITY_LOW], &m_curr_op));
+            m_high_burst = 0;
+            break;
+        default:
+            m_curr_op.type = FLASH_OP_TYPE_NONE;
+            return false;
+    }
     APP_ERROR_CHECK_BOOL(m_curr_op.type != FLASH_OP_TYPE_NONE);
 
+    latency_register(&m_curr_op);
     m_operation_count++;
     /* Save initial start address for the end-event */
     if (m_curr_op.type == FLASH_OP_TYPE_WRITE)
@@ -263,29 +433,61 @@ static bool next_operation_get(void)
     }
     return true;
 }
+/** Cancel the queued writes of the erase operation's user that the erase
+ * will wipe anyway. Their end is still reported, in order. Must be called
+ * with IRQs disabled, as the queue is popped from the timeslot. */
+static void writes_supersede(fifo_t* p_fifo, const operation_t* p_erase)
+{
+    const uint32_t erase_end = p_erase->operation.erase.start_addr + p_erase->operation.erase.length;
+    const uint32_t count = fifo_get_len(p_fifo) - 1; /* all but the erase */
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        operation_t* p_op = fifo_elem_ref_at(p_fifo, i);
+        if (p_op->type == FLASH_OP_TYPE_WRITE &&
+            p_op->user == p_erase->user &&
+            p_op->operation.write.start_addr >= p_erase->operation.erase.start_addr &&
+            p_op->operation.write.start_addr + p_op->operation.write.length <= erase_end)
+        {
+            p_op->operation.write.length = 0;
+        }
+    }
+}
+
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
 
-uint32_t mesh_flash_init(mesh_flash_op_cb_t cb)
+uint32_t mesh_flash_init(mesh_flash_user_t user, mesh_flash_op_cb_t cb)
 {
+    if (user >= MESH_FLASH_USERS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
     if (cb == NULL)
     {
         return NRF_ERROR_NULL;
     }
-    m_flash_op_fifo.elem_array = m_flash_op_fifo_queue;
-    m_flash_op_fifo.elem_size = sizeof(operation_t);
-    m_flash_op_fifo.array_len = FLASH_OP_QUEUE_LEN;
-    fifo_init(&m_flash_op_fifo);
-    mp_cb = cb;
-    m_curr_op.type = FLASH_OP_TYPE_NONE;
+    if (!m_initialized)
+    {
+        for (uint32_t i = 0; i < MESH_FLASH_PRIORITIES; ++i)
+        {
+            m_flash_op_fifo[i].elem_array = m_flash_op_fifo_queue[i];
+            m_flash_op_fifo[i].elem_size = sizeof(operation_t);
+            m_flash_op_fifo[i].array_len = FLASH_OP_QUEUE_LEN;
+            fifo_init(&m_flash_op_fifo[i]);
+        }
+        m_curr_op.type = FLASH_OP_TYPE_NONE;
+        m_parked_op.type = FLASH_OP_TYPE_NONE;
+        m_initialized = true;
+    }
+    mp_cb[user] = cb;
 
     return NRF_SUCCESS;
 }
 
-uint32_t mesh_flash_op_push(flash_op_type_t type, const flash_op_t* p_op)
+uint32_t mesh_flash_op_push(mesh_flash_user_t user, flash_op_type_t type, const flash_op_t* p_op)
 {
-    if (mp_cb == NULL)
+    if (user >= MESH_FLASH_USERS || mp_cb[user] == NULL)
     {
         return NRF_ERROR_INVALID_STATE;
     }
@@ -324,18 +526,62 @@ uint32_t mesh_flash_op_push(flash_op_type_t type, const flash_op_t* p_op)
 
     operation_t op;
     op.type = type;
+    op.user = user;
+    op.push_time = timer_now();
     memcpy(&op.operation, p_op, sizeof(flash_op_t));
-    return fifo_push(&m_flash_op_fifo, &op);
+
+    fifo_t* p_fifo = &m_flash_op_fifo[m_user_priority[user]];
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    uint32_t error_code = fifo_push(p_fifo, &op);
+    if (error_code == NRF_SUCCESS)
+    {
+        m_user_pending[user]++;
+        if (type == FLASH_OP_TYPE_ERASE)
+        {
+            writes_supersede(p_fifo, &op);
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+    return error_code;
 }
 
-uint32_t mesh_flash_op_available_slots(void)
+uint32_t mesh_flash_op_available_slots(mesh_flash_user_t user)
 {
-    return FLASH_OP_QUEUE_LEN - fifo_get_len(&m_flash_op_fifo);
+    if (user >= MESH_FLASH_USERS)
+    {
+        return 0;
+    }
+    return FLASH_OP_QUEUE_LEN - fifo_get_len(&m_flash_op_fifo[m_user_priority[user]]);
 }
 
 bool mesh_flash_in_progress(void)
 {
-    return (!fifo_is_empty(&m_flash_op_fifo) || m_curr_op.type != FLASH_OP_TYPE_NONE);
+    return (!queues_empty() ||
+            m_curr_op.type != FLASH_OP_TYPE_NONE ||
+            m_parked_op.type != FLASH_OP_TYPE_NONE);
+}
+
+bool mesh_flash_user_in_progress(mesh_flash_user_t user)
+{
+    return (user < MESH_FLASH_USERS && m_user_pending[user] > 0);
+}
+
+uint32_t mesh_flash_stats_get(mesh_flash_priority_t priority, mesh_flash_stats_t* p_stats)
+{
+    if (priority >= MESH_FLASH_PRIORITIES)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    memcpy(p_stats, &m_stats[priority], sizeof(mesh_flash_stats_t));
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
 }
 
 void mesh_flash_op_execute(timestamp_t available_time)
@@ -356,6 +602,14 @@ void mesh_flash_op_execute(timestamp_t available_time)
             {
                 return;
             }
+            if (operation_time(&m_curr_op) == 0)
+            {
+                continue; /* superseded, only the end is reported */
+            }
+        }
+        else if (preempt() && !next_operation_get())
+        {
+            return;
         }
 
         uint32_t byte_count = 0;
@@ -376,7 +630,10 @@ void mesh_flash_op_execute(timestamp_t available_time)
             return;
         }
 
-        available_time -= FLASH_OP_POST_PROCESS_TIME_US;
+        if (!write_chained())
+        {
+            available_time -= FLASH_OP_POST_PROCESS_TIME_US;
+        }
     }
 }
 
@@ -38,6 +38,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "transport_control.h"
 #include "app_error.h"
 #include "timer.h"
+#include "toolchain.h"
+#include "timeslot.h"
 
 #include "ble_gatts.h"
 #include "ble_err.h"
@@ -45,17 +47,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_event);
 
+#define CONN_INTERVAL_TO_US(interval)   ((uint32_t) (interval) * 1250) /* Connection intervals are given in 1.25ms units */
+
+#ifndef RBC_MESH_NO_GATT
+
 typedef struct
 {
     uint16_t service_handle;
-    bool notification_enabled;
     ble_gatts_char_handles_t ble_md_char_handles;
     ble_gatts_char_handles_t ble_val_char_handles;
+    ble_gatts_char_handles_t ble_bulk_char_handles;
 } mesh_srv_t;
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
-static mesh_srv_t m_mesh_service = {0, false, {0}, {0}};
+static mesh_srv_t m_mesh_service = {0, {0}, {0}, {0}};
 
 static const ble_uuid128_t m_mesh_base_uuid = {{0x1E, 0xCD, 0x00, 0x00,
                                             0x8C, 0xB9, 0xA8, 0x8B,
@@ -63,15 +69,21 @@ static const ble_uuid128_t m_mesh_base_uuid = {{0x1E, 0xCD, 0x00, 0x00,
                                             0xA1, 0x77, 0x1E, 0x2A}};
 static uint8_t m_mesh_base_uuid_type;
 
-static uint16_t m_active_conn_handle = CONN_HANDLE_INVALID;
-
 typedef enum
 {
     MESH_GATT_EVT_OPCODE_DATA = 0x00,
     MESH_GATT_EVT_OPCODE_FLAG_SET = 0x01,
     MESH_GATT_EVT_OPCODE_FLAG_REQ = 0x02,
+    MESH_GATT_EVT_OPCODE_STATS_REQ = 0x03,
+    MESH_GATT_EVT_OPCODE_SUBSCRIBE = 0x04,
+    MESH_GATT_EVT_OPCODE_DATA_UNACKED = 0x05,
     MESH_GATT_EVT_OPCODE_CMD_RSP  = 0x11,
     MESH_GATT_EVT_OPCODE_FLAG_RSP = 0x12,
+    MESH_GATT_EVT_OPCODE_STATS_RSP = 0x13,
+    MESH_GATT_EVT_OPCODE_UNACKED_STATUS = 0x14,
+    MESH_GATT_EVT_OPCODE_BULK_DATA = 0x20,
+    MESH_GATT_EVT_OPCODE_BULK_READ = 0x21,
+    MESH_GATT_EVT_OPCODE_BULK_RSP = 0x31,
 } mesh_gatt_evt_opcode_t;
 
 typedef enum
@@ -82,6 +94,7 @@ typedef enum
     MESH_GATT_RESULT_ERROR_INVALID_HANDLE = 0xF2,
     MESH_GATT_RESULT_ERROR_UNKNOWN_FLAG = 0xF3,
     MESH_GATT_RESULT_ERROR_INVALID_OPCODE = 0xF4,
+    MESH_GATT_RESULT_ERROR_INVALID_PARAM = 0xF5,
 } mesh_gatt_result_t;
 
 typedef enum
@@ -110,6 +123,93 @@ typedef __packed_armcc struct
     uint8_t result;
 } __packed_gcc gatt_evt_cmd_rsp_t;
 
+/** Max number of statistics bytes per notification, keeps the notification
+  within the default ATT MTU. */
+#define MESH_GATT_STATS_CHUNK_LEN   (17)
+
+typedef __packed_armcc struct
+{
+    uint8_t offset;     /**< Byte offset into the rbc_mesh_stats_t structure. */
+    uint8_t total_len;  /**< Size of the rbc_mesh_stats_t structure, only in responses. */
+    uint8_t data[MESH_GATT_STATS_CHUNK_LEN];
+} __packed_gcc gatt_evt_stats_t;
+
+typedef __packed_armcc struct
+{
+    rbc_mesh_value_handle_t handle_min;
+    rbc_mesh_value_handle_t handle_max;
+} __packed_gcc gatt_evt_subscribe_t;
+
+/** Failed unacknowledged value writes since the last status. */
+typedef __packed_armcc struct
+{
+    uint16_t fail_count;
+    uint8_t last_result;
+    rbc_mesh_value_handle_t last_handle;
+} __packed_gcc gatt_evt_unacked_status_t;
+
+/** Single value in a bulk characteristic write or notification. */
+typedef __packed_armcc struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t version;   /**< Ignored in writes. */
+    uint8_t data_len;
+    uint8_t data[];
+} __packed_gcc gatt_bulk_tuple_t;
+
+#define GATT_BULK_TUPLE_OVERHEAD    (sizeof(gatt_bulk_tuple_t))
+
+typedef __packed_armcc struct
+{
+    uint8_t opcode;
+    uint8_t cmd_opcode;
+    uint8_t result;
+    uint16_t count;     /**< Number of values written or read. */
+} __packed_gcc gatt_bulk_rsp_t;
+
+/** State of an ongoing bulk read. */
+typedef struct
+{
+    bool active;
+    uint32_t iterator;  /**< Handle storage iterator of the next value to send. */
+    uint16_t count;     /**< Number of values sent so far. */
+} bulk_read_t;
+
+
+/** Value waiting for a free TX buffer. */
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t data_len;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} notification_entry_t;
+
+/** FIFO of value notifications, at most one entry per handle. */
+typedef struct
+{
+    notification_entry_t entries[MESH_GATT_NOTIFICATION_QUEUE_LENGTH];
+    uint8_t head;
+    uint8_t count;
+    uint8_t head_seq; /**< Changed whenever the head entry is replaced or popped. */
+} notification_queue_t;
+
+/** State of a connected GATT client. */
+typedef struct
+{
+    uint16_t conn_handle;
+    bool notification_enabled;
+    bool bulk_notification_enabled;
+    uint16_t att_mtu;
+    uint32_t conn_interval_us;
+    rbc_mesh_value_handle_t handle_min; /**< Lowest handle notified to the client. */
+    rbc_mesh_value_handle_t handle_max; /**< Highest handle notified to the client. */
+    bulk_read_t bulk_read;
+    notification_queue_t notification_queue;
+    gatt_evt_unacked_status_t unacked_status; /**< Failed unacknowledged writes not yet reported. */
+} mesh_gatt_conn_t;
+
+static mesh_gatt_conn_t m_conns[MESH_GATT_CONN_COUNT_MAX];
+
 typedef __packed_armcc struct
 {
     uint8_t opcode;
@@ -117,20 +217,54 @@ typedef __packed_armcc struct
         gatt_evt_flag_update_t  flag_update;
         gatt_evt_data_update_t  data_update;
         gatt_evt_cmd_rsp_t      cmd_rsp;
+        gatt_evt_stats_t        stats;
+        gatt_evt_subscribe_t    subscribe;
+        gatt_evt_unacked_status_t unacked_status;
     } __packed_gcc param;
 } __packed_gcc mesh_gatt_evt_t;
 
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
-static uint32_t mesh_gatt_evt_push(mesh_gatt_evt_t* p_gatt_evt)
+static mesh_gatt_conn_t* conn_get(uint16_t conn_handle)
+{
+    if (conn_handle == CONN_HANDLE_INVALID)
+    {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < MESH_GATT_CONN_COUNT_MAX; ++i)
+    {
+        if (m_conns[i].conn_handle == conn_handle)
+        {
+            return &m_conns[i];
+        }
+    }
+    return NULL;
+}
+
+/** The mesh timeslots have to fit around the most frequent connection events. */
+static void conn_interval_update(void)
 {
-    if (m_active_conn_handle == CONN_HANDLE_INVALID)
+    uint32_t interval_us = 0;
+    for (uint32_t i = 0; i < MESH_GATT_CONN_COUNT_MAX; ++i)
+    {
+        if (m_conns[i].conn_handle != CONN_HANDLE_INVALID &&
+            (interval_us == 0 || m_conns[i].conn_interval_us < interval_us))
+        {
+            interval_us = m_conns[i].conn_interval_us;
+        }
+    }
+    timeslot_conn_interval_set(interval_us);
+}
+
+static uint32_t notification_send(mesh_gatt_conn_t* p_conn, uint16_t value_handle, bool enabled, uint8_t* p_data, uint16_t length)
+{
+    if (p_conn->conn_handle == CONN_HANDLE_INVALID)
     {
         return BLE_ERROR_INVALID_CONN_HANDLE;
     }
 
-    if (!m_mesh_service.notification_enabled)
+    if (!enabled)
     {
         return BLE_ERROR_NOT_ENABLED;
     }
@@ -139,7 +273,7 @@ static uint32_t mesh_gatt_evt_push(mesh_gatt_evt_t* p_gatt_evt)
     uint8_t err_code;
 
 #if (NORDIC_SDK_VERSION >= 11) 
-    err_code = sd_ble_tx_packet_count_get(m_active_conn_handle, &count);
+    err_code = sd_ble_tx_packet_count_get(p_conn->conn_handle, &count);
 #else
     err_code = sd_ble_tx_buffer_count_get(&count);
 #endif
@@ -157,15 +291,26 @@ static uint32_t mesh_gatt_evt_push(mesh_gatt_evt_t* p_gatt_evt)
     }
 
     ble_gatts_hvx_params_t hvx_params;
-    hvx_params.handle = m_mesh_service.ble_val_char_handles.value_handle;
+    hvx_params.handle = value_handle;
     hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
     hvx_params.offset = 0;
+    hvx_params.p_len = &length;
+    hvx_params.p_data = p_data;
+
+    return sd_ble_gatts_hvx(p_conn->conn_handle, &hvx_params);
+}
+
+static uint32_t mesh_gatt_evt_push(mesh_gatt_conn_t* p_conn, mesh_gatt_evt_t* p_gatt_evt)
+{
     uint16_t hvx_len;
     switch (p_gatt_evt->opcode)
     {
         case MESH_GATT_EVT_OPCODE_DATA:
             hvx_len = p_gatt_evt->param.data_update.data_len + 4;
             break;
+        case MESH_GATT_EVT_OPCODE_UNACKED_STATUS:
+            hvx_len = 1 + sizeof(gatt_evt_unacked_status_t);
+            break;
         case MESH_GATT_EVT_OPCODE_FLAG_SET:
         case MESH_GATT_EVT_OPCODE_FLAG_REQ:
         case MESH_GATT_EVT_OPCODE_FLAG_RSP:
@@ -174,22 +319,354 @@ static uint32_t mesh_gatt_evt_push(mesh_gatt_evt_t* p_gatt_evt)
         case MESH_GATT_EVT_OPCODE_CMD_RSP:
             hvx_len = 3;
             break;
+        case MESH_GATT_EVT_OPCODE_STATS_RSP:
+            hvx_len = p_gatt_evt->param.stats.total_len - p_gatt_evt->param.stats.offset;
+            if (hvx_len > MESH_GATT_STATS_CHUNK_LEN)
+            {
+                hvx_len = MESH_GATT_STATS_CHUNK_LEN;
+            }
+            hvx_len += 3;
+            break;
         default:
             hvx_len = 1;
     }
-    hvx_params.p_len = &hvx_len;
-    hvx_params.p_data = (uint8_t*) p_gatt_evt;
 
-    return sd_ble_gatts_hvx(m_active_conn_handle, &hvx_params);
+    return notification_send(p_conn, m_mesh_service.ble_val_char_handles.value_handle,
+            p_conn->notification_enabled,
+            (uint8_t*) p_gatt_evt,
+            hvx_len);
+}
+
+static void notification_queue_clear(notification_queue_t* p_queue)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    p_queue->count = 0;
+    p_queue->head_seq++;
+    _ENABLE_IRQS(was_masked);
+}
+
+static bool conn_is_subscribed(const mesh_gatt_conn_t* p_conn, rbc_mesh_value_handle_t handle)
+{
+    return (handle >= p_conn->handle_min && handle <= p_conn->handle_max);
 }
 
-static uint32_t mesh_gatt_cmd_rsp_push(mesh_gatt_evt_opcode_t opcode, mesh_gatt_result_t result)
+/**
+* Send queued value notifications until the SoftDevice runs out of TX buffers.
+* The SoftDevice can't be called with interrupts masked, so the head is copied
+* out and only popped if no new value replaced it while it was being sent.
+* Values the client unsubscribed from while they were queued are dropped.
+*/
+static void notification_queue_drain(mesh_gatt_conn_t* p_conn)
+{
+    notification_queue_t* p_queue = &p_conn->notification_queue;
+    while (true)
+    {
+        mesh_gatt_evt_t gatt_evt;
+        uint8_t seq;
+        uint32_t was_masked;
+        _DISABLE_IRQS(was_masked);
+        if (p_queue->count == 0)
+        {
+            _ENABLE_IRQS(was_masked);
+            return;
+        }
+        notification_entry_t* p_entry = &p_queue->entries[p_queue->head];
+        gatt_evt.opcode = MESH_GATT_EVT_OPCODE_DATA;
+        gatt_evt.param.data_update.handle = p_entry->handle;
+        gatt_evt.param.data_update.data_len = p_entry->data_len;
+        memcpy(gatt_evt.param.data_update.data, p_entry->data, p_entry->data_len);
+        seq = p_queue->head_seq;
+        _ENABLE_IRQS(was_masked);
+
+        if (conn_is_subscribed(p_conn, gatt_evt.param.data_update.handle))
+        {
+            uint32_t error_code = mesh_gatt_evt_push(p_conn, &gatt_evt);
+            if (error_code != NRF_SUCCESS)
+            {
+                if (error_code == BLE_ERROR_INVALID_CONN_HANDLE ||
+                    error_code == BLE_ERROR_NOT_ENABLED)
+                {
+                    notification_queue_clear(p_queue);
+                }
+                return; /* picked up again on TX complete */
+            }
+        }
+
+        _DISABLE_IRQS(was_masked);
+        if (seq == p_queue->head_seq)
+        {
+            p_queue->head = (p_queue->head + 1) % MESH_GATT_NOTIFICATION_QUEUE_LENGTH;
+            p_queue->count--;
+            p_queue->head_seq++;
+        }
+        _ENABLE_IRQS(was_masked);
+    }
+}
+
+static uint32_t notification_queue_push(notification_queue_t* p_queue, rbc_mesh_value_handle_t handle, uint8_t* p_data, uint8_t length)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    notification_entry_t* p_entry = NULL;
+    for (uint32_t i = 0; i < p_queue->count; ++i)
+    {
+        uint32_t index = (p_queue->head + i) % MESH_GATT_NOTIFICATION_QUEUE_LENGTH;
+        if (p_queue->entries[index].handle == handle)
+        {
+            /* coalesce, the client only needs the latest value. */
+            p_entry = &p_queue->entries[index];
+            if (i == 0)
+            {
+                p_queue->head_seq++;
+            }
+            break;
+        }
+    }
+
+    if (p_entry == NULL)
+    {
+        if (p_queue->count == MESH_GATT_NOTIFICATION_QUEUE_LENGTH)
+        {
+            _ENABLE_IRQS(was_masked);
+            return NRF_ERROR_NO_MEM;
+        }
+        p_entry = &p_queue->entries[(p_queue->head + p_queue->count) % MESH_GATT_NOTIFICATION_QUEUE_LENGTH];
+        p_queue->count++;
+    }
+
+    p_entry->handle = handle;
+    p_entry->data_len = length;
+    memcpy(p_entry->data, p_data, length);
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
+}
+
+static uint32_t mesh_gatt_cmd_rsp_push(mesh_gatt_conn_t* p_conn, mesh_gatt_evt_opcode_t opcode, mesh_gatt_result_t result)
 {
     mesh_gatt_evt_t rsp;
     rsp.opcode = MESH_GATT_EVT_OPCODE_CMD_RSP;
     rsp.param.cmd_rsp.opcode = opcode;
     rsp.param.cmd_rsp.result = result;
-    return mesh_gatt_evt_push(&rsp);
+    return mesh_gatt_evt_push(p_conn, &rsp);
+}
+
+static uint32_t mesh_gatt_bulk_rsp_push(mesh_gatt_conn_t* p_conn, mesh_gatt_evt_opcode_t opcode, mesh_gatt_result_t result, uint16_t count)
+{
+    gatt_bulk_rsp_t rsp;
+    rsp.opcode = MESH_GATT_EVT_OPCODE_BULK_RSP;
+    rsp.cmd_opcode = opcode;
+    rsp.result = result;
+    rsp.count = count;
+    return notification_send(p_conn, m_mesh_service.ble_bulk_char_handles.value_handle,
+            p_conn->bulk_notification_enabled,
+            (uint8_t*) &rsp,
+            sizeof(rsp));
+}
+
+/** Largest bulk notification the connection can carry. */
+static uint16_t bulk_payload_max_get(const mesh_gatt_conn_t* p_conn)
+{
+    uint16_t len = p_conn->att_mtu - 3;
+    if (len > MESH_GATT_BULK_MAX_LEN)
+    {
+        len = MESH_GATT_BULK_MAX_LEN;
+    }
+    return len;
+}
+
+/** Apply a value written by the GATT client, and notify the application. */
+static mesh_gatt_result_t value_local_update(rbc_mesh_value_handle_t handle, uint8_t* p_data, uint8_t length)
+{
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return MESH_GATT_RESULT_ERROR_INVALID_HANDLE;
+    }
+
+    if (vh_local_update(handle, p_data, length) != NRF_SUCCESS)
+    {
+        return MESH_GATT_RESULT_ERROR_BUSY;
+    }
+
+    rbc_mesh_event_t mesh_evt;
+    mesh_evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+    mesh_evt.params.rx.p_data        = p_data;
+    mesh_evt.params.rx.data_len      = length;
+    mesh_evt.params.rx.value_handle  = handle;
+    mesh_evt.params.rx.version_delta = 1;
+    mesh_evt.params.rx.version       = 0;
+    mesh_evt.params.rx.source        = RBC_MESH_EVENT_SOURCE_GATT;
+    mesh_evt.params.rx.timestamp_us  = timer_now();
+    if (rbc_mesh_event_push(&mesh_evt) != NRF_SUCCESS)
+    {
+        return MESH_GATT_RESULT_ERROR_BUSY;
+    }
+
+    return MESH_GATT_RESULT_SUCCESS;
+}
+
+/**
+* Report the unacknowledged writes that failed since the last report, in a
+* single notification. Kept for the next TX complete if the SoftDevice is out
+* of TX buffers, with later failures added to it.
+*/
+static void unacked_status_send(mesh_gatt_conn_t* p_conn)
+{
+    if (p_conn->unacked_status.fail_count == 0)
+    {
+        return;
+    }
+
+    mesh_gatt_evt_t status_evt;
+    status_evt.opcode = MESH_GATT_EVT_OPCODE_UNACKED_STATUS;
+    memcpy(&status_evt.param.unacked_status, &p_conn->unacked_status, sizeof(gatt_evt_unacked_status_t));
+    uint32_t error_code = mesh_gatt_evt_push(p_conn, &status_evt);
+    if (error_code == NRF_SUCCESS ||
+        error_code == BLE_ERROR_INVALID_CONN_HANDLE ||
+        error_code == BLE_ERROR_NOT_ENABLED)
+    {
+        p_conn->unacked_status.fail_count = 0;
+    }
+}
+
+static void unacked_write_handle(mesh_gatt_conn_t* p_conn, gatt_evt_data_update_t* p_data_update, uint16_t length)
+{
+    mesh_gatt_result_t result;
+    if (length < 4 || p_data_update->data_len > RBC_MESH_VALUE_MAX_LEN ||
+        length < 4 + p_data_update->data_len)
+    {
+        result = MESH_GATT_RESULT_ERROR_INVALID_PARAM;
+    }
+    else
+    {
+        result = value_local_update(p_data_update->handle, p_data_update->data, p_data_update->data_len);
+    }
+
+    if (result != MESH_GATT_RESULT_SUCCESS)
+    {
+        if (p_conn->unacked_status.fail_count < UINT16_MAX)
+        {
+            p_conn->unacked_status.fail_count++;
+        }
+        p_conn->unacked_status.last_result = result;
+        p_conn->unacked_status.last_handle = p_data_update->handle;
+        unacked_status_send(p_conn);
+    }
+}
+
+/** Apply all values in a bulk write, stops at the first failing value. */
+static void bulk_write_handle(mesh_gatt_conn_t* p_conn, uint8_t* p_data, uint16_t length)
+{
+    mesh_gatt_result_t result = MESH_GATT_RESULT_SUCCESS;
+    uint16_t count = 0;
+    uint16_t offset = 1; /* skip opcode */
+    while (offset < length)
+    {
+        gatt_bulk_tuple_t* p_tuple = (gatt_bulk_tuple_t*) &p_data[offset];
+        if (length - offset < GATT_BULK_TUPLE_OVERHEAD ||
+            p_tuple->data_len > RBC_MESH_VALUE_MAX_LEN ||
+            length - offset < GATT_BULK_TUPLE_OVERHEAD + p_tuple->data_len)
+        {
+            result = MESH_GATT_RESULT_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        result = value_local_update(p_tuple->handle, p_tuple->data, p_tuple->data_len);
+        if (result != MESH_GATT_RESULT_SUCCESS)
+        {
+            break;
+        }
+        count++;
+        offset += GATT_BULK_TUPLE_OVERHEAD + p_tuple->data_len;
+    }
+
+    mesh_gatt_bulk_rsp_push(p_conn, MESH_GATT_EVT_OPCODE_BULK_DATA, result, count);
+}
+
+/**
+* Stream the stored values to the client, packing as many values as the
+* connection allows into each notification. Stops when the SoftDevice runs out
+* of TX buffers, and picks up again on the next TX complete event.
+*/
+static void bulk_read_continue(mesh_gatt_conn_t* p_conn)
+{
+    uint8_t buffer[MESH_GATT_BULK_MAX_LEN];
+    const uint16_t payload_max = bulk_payload_max_get(p_conn);
+    bulk_read_t* p_bulk_read = &p_conn->bulk_read;
+
+    while (p_bulk_read->active)
+    {
+        uint32_t iterator = p_bulk_read->iterator;
+        uint16_t count = 0;
+        uint16_t length = 1;
+        buffer[0] = MESH_GATT_EVT_OPCODE_BULK_DATA;
+
+        while (true)
+        {
+            uint32_t next_iterator = iterator;
+            gatt_bulk_tuple_t* p_tuple = (gatt_bulk_tuple_t*) &buffer[length];
+            uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+            uint16_t data_len = RBC_MESH_VALUE_MAX_LEN;
+            rbc_mesh_value_handle_t handle;
+            uint16_t version;
+            uint32_t error_code = vh_value_next_get(&next_iterator, &handle, &version, data, &data_len);
+            if (error_code == NRF_ERROR_NOT_FOUND)
+            {
+                break;
+            }
+            if (error_code != NRF_SUCCESS ||
+                GATT_BULK_TUPLE_OVERHEAD + data_len > payload_max - 1)
+            {
+                /* can't ever be sent in a bulk notification, skip it. */
+                iterator = next_iterator;
+                continue;
+            }
+            if (length + GATT_BULK_TUPLE_OVERHEAD + data_len > payload_max)
+            {
+                break;
+            }
+
+            p_tuple->handle = handle;
+            p_tuple->version = version;
+            p_tuple->data_len = data_len;
+            memcpy(p_tuple->data, data, data_len);
+            length += GATT_BULK_TUPLE_OVERHEAD + data_len;
+            count++;
+            iterator = next_iterator;
+        }
+
+        if (count == 0)
+        {
+            /* no more values */
+            uint32_t error_code = mesh_gatt_bulk_rsp_push(p_conn, MESH_GATT_EVT_OPCODE_BULK_READ,
+                        MESH_GATT_RESULT_SUCCESS,
+                        p_bulk_read->count);
+            if (error_code == NRF_SUCCESS ||
+                error_code == BLE_ERROR_INVALID_CONN_HANDLE ||
+                error_code == BLE_ERROR_NOT_ENABLED)
+            {
+                p_bulk_read->active = false;
+            }
+            return;
+        }
+
+        uint32_t error_code = notification_send(p_conn, m_mesh_service.ble_bulk_char_handles.value_handle,
+                p_conn->bulk_notification_enabled,
+                buffer,
+                length);
+        if (error_code != NRF_SUCCESS)
+        {
+            if (error_code == BLE_ERROR_INVALID_CONN_HANDLE ||
+                error_code == BLE_ERROR_NOT_ENABLED)
+            {
+                p_bulk_read->active = false;
+            }
+            /* Rebuild the same notification on the next TX complete. */
+            return;
+        }
+        p_bulk_read->iterator = iterator;
+        p_bulk_read->count += count;
+    }
 }
 
 static uint32_t mesh_md_char_add(mesh_metadata_char_t* metadata)
@@ -342,12 +819,83 @@ static uint32_t mesh_value_char_add(void)
 
     return NRF_SUCCESS;
 }
+
+static uint32_t mesh_bulk_char_add(void)
+{
+    /* BLE GATT metadata */
+    ble_gatts_char_md_t ble_char_md;
+
+    memset(&ble_char_md, 0, sizeof(ble_char_md));
+
+    ble_char_md.char_props.write = 1;
+    ble_char_md.char_props.write_wo_resp = 1;
+    ble_char_md.char_props.notify = 1;
+
+    ble_char_md.p_cccd_md = NULL;
+    ble_char_md.p_sccd_md = NULL;
+    ble_char_md.p_char_user_desc = NULL;
+    ble_char_md.p_user_desc_md = NULL;
+
+    /* ATT metadata */
+
+    ble_gatts_attr_md_t ble_attr_md;
+
+    memset(&ble_attr_md, 0, sizeof(ble_attr_md));
+
+    /* No security is required */
+    ble_attr_md.write_perm.lv = 1;
+    ble_attr_md.write_perm.sm = 1;
+
+    ble_attr_md.vloc = BLE_GATTS_VLOC_STACK;
+    ble_attr_md.rd_auth = 0;
+    ble_attr_md.wr_auth = 0;
+    ble_attr_md.vlen = 1;
+
+    /* ble characteristic UUID */
+    ble_uuid_t ble_uuid;
+
+    ble_uuid.type = m_mesh_base_uuid_type;
+    ble_uuid.uuid = MESH_BULK_CHAR_UUID;
+
+    /* ble attribute */
+    ble_gatts_attr_t ble_attr;
+    uint8_t default_value = 0;
+
+    memset(&ble_attr, 0, sizeof(ble_attr));
+
+    ble_attr.init_len = 1;
+    ble_attr.init_offs = 0;
+    ble_attr.max_len = MESH_GATT_BULK_MAX_LEN;
+    ble_attr.p_attr_md = &ble_attr_md;
+    ble_attr.p_uuid = &ble_uuid;
+    ble_attr.p_value = &default_value;
+
+    /* add to service */
+    uint32_t error_code = sd_ble_gatts_characteristic_add(
+            m_mesh_service.service_handle,
+            &ble_char_md,
+            &ble_attr,
+            &m_mesh_service.ble_bulk_char_handles);
+
+    if (error_code != NRF_SUCCESS)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    return NRF_SUCCESS;
+}
+
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
 uint32_t mesh_gatt_init(uint32_t access_address, uint8_t channel, uint32_t interval_min_ms)
 {
     uint32_t error_code;
+    for (uint32_t i = 0; i < MESH_GATT_CONN_COUNT_MAX; ++i)
+    {
+        m_conns[i].conn_handle = CONN_HANDLE_INVALID;
+    }
+
     mesh_metadata_char_t md_char;
     md_char.mesh_access_addr = access_address;
     md_char.mesh_interval_min_ms = interval_min_ms;
@@ -382,6 +930,12 @@ uint32_t mesh_gatt_init(uint32_t access_address, uint8_t channel, uint32_t inter
         return error_code;
     }
 
+    error_code = mesh_bulk_char_add();
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
     return NRF_SUCCESS;
 }
 
@@ -391,67 +945,58 @@ uint32_t mesh_gatt_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint
     {
         return NRF_ERROR_INVALID_LENGTH;
     }
-    if (m_active_conn_handle != CONN_HANDLE_INVALID)
-    {
-        mesh_gatt_evt_t gatt_evt;
-        gatt_evt.opcode = MESH_GATT_EVT_OPCODE_DATA;
-        gatt_evt.param.data_update.handle = handle;
-        gatt_evt.param.data_update.data_len = length;
-        memcpy(gatt_evt.param.data_update.data, data, length);
 
-        return mesh_gatt_evt_push(&gatt_evt);
-    }
-    else
+    uint32_t status = BLE_ERROR_INVALID_CONN_HANDLE;
+    for (uint32_t i = 0; i < MESH_GATT_CONN_COUNT_MAX; ++i)
     {
-        return BLE_ERROR_INVALID_CONN_HANDLE;
+        mesh_gatt_conn_t* p_conn = &m_conns[i];
+        if (p_conn->conn_handle == CONN_HANDLE_INVALID)
+        {
+            continue;
+        }
+        if (!p_conn->notification_enabled || !conn_is_subscribed(p_conn, handle))
+        {
+            if (status == BLE_ERROR_INVALID_CONN_HANDLE)
+            {
+                status = BLE_ERROR_NOT_ENABLED;
+            }
+            continue;
+        }
+
+        if (notification_queue_push(&p_conn->notification_queue, handle, data, length) != NRF_SUCCESS)
+        {
+            status = NRF_ERROR_NO_MEM;
+            continue;
+        }
+        if (status != NRF_ERROR_NO_MEM)
+        {
+            status = NRF_SUCCESS;
+        }
+        notification_queue_drain(p_conn);
     }
+    return status;
 }
 
 void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
 {
     if (p_ble_evt->header.evt_id == BLE_GATTS_EVT_WRITE)
     {
+        mesh_gatt_conn_t* p_conn = conn_get(p_ble_evt->evt.gatts_evt.conn_handle);
+        if (p_conn == NULL)
+        {
+            return;
+        }
+
         if (p_ble_evt->evt.gatts_evt.params.write.handle == m_mesh_service.ble_val_char_handles.value_handle)
         {
             mesh_gatt_evt_t* p_gatt_evt = (mesh_gatt_evt_t*) p_ble_evt->evt.gatts_evt.params.write.data;
             switch ((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode)
             {
                 case MESH_GATT_EVT_OPCODE_DATA:
-                    {
-                        if (p_gatt_evt->param.data_update.handle == RBC_MESH_INVALID_HANDLE)
-                        {
-                            mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
-                            break;
-                        }
-                        uint32_t error_code = vh_local_update(
-                                p_gatt_evt->param.data_update.handle,
+                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode,
+                            value_local_update(p_gatt_evt->param.data_update.handle,
                                 p_gatt_evt->param.data_update.data,
-                                p_gatt_evt->param.data_update.data_len);
-
-                        if (error_code == NRF_SUCCESS)
-                        {
-                            rbc_mesh_event_t mesh_evt;
-                            mesh_evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
-                            mesh_evt.params.rx.p_data        = p_gatt_evt->param.data_update.data;
-                            mesh_evt.params.rx.data_len      = p_gatt_evt->param.data_update.data_len;
-                            mesh_evt.params.rx.value_handle  = p_gatt_evt->param.data_update.handle;
-                            mesh_evt.params.rx.version_delta = 1;
-                            mesh_evt.params.rx.timestamp_us  = timer_now();
-                            if (rbc_mesh_event_push(&mesh_evt) != NRF_SUCCESS)
-                            {
-                                mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_BUSY);
-                            }
-                            else
-                            {
-                                mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
-                            }
-                        }
-                        else
-                        {
-                            mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_BUSY);
-                        }
-
-                    }
+                                p_gatt_evt->param.data_update.data_len));
                     break;
 
                 case MESH_GATT_EVT_OPCODE_FLAG_SET:
@@ -462,10 +1007,10 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                         !!(p_gatt_evt->param.flag_update.value))
                                     != NRF_SUCCESS)
                             {
-                                mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
+                                mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
                                 break;
                             }
-                            mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
+                            mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
                             break;
 
                         case MESH_GATT_EVT_FLAG_DO_TX:
@@ -474,25 +1019,25 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                 if (vh_value_enable(p_gatt_evt->param.flag_update.handle)
                                         != NRF_SUCCESS)
                                 {
-                                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
+                                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
                                     break;
                                 }
-                                mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
+                                mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
                             }
                             else
                             {
                                 if (vh_value_disable(p_gatt_evt->param.flag_update.handle)
                                         != NRF_SUCCESS)
                                 {
-                                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
+                                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
                                     break;
                                 }
-                                mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
+                                mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
                             }
                             break;
 
                         default:
-                            mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_UNKNOWN_FLAG);
+                            mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_UNKNOWN_FLAG);
                     }
                     break;
 
@@ -503,7 +1048,7 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                             {
                                 if (p_gatt_evt->param.flag_update.handle == RBC_MESH_INVALID_HANDLE)
                                 {
-                                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
+                                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
                                     break;
                                 }
 
@@ -511,7 +1056,7 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                 if (vh_value_persistence_get(p_gatt_evt->param.flag_update.handle, &is_persistent)
                                         != NRF_SUCCESS)
                                 {
-                                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_NOT_FOUND);
+                                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_NOT_FOUND);
                                     break;
                                 }
 
@@ -520,7 +1065,7 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                 rsp_evt.param.flag_update.handle = p_gatt_evt->param.flag_update.handle;
                                 rsp_evt.param.flag_update.flag = p_gatt_evt->param.flag_update.flag;
                                 rsp_evt.param.flag_update.value = (uint8_t) is_persistent;
-                                mesh_gatt_evt_push(&rsp_evt);
+                                mesh_gatt_evt_push(p_conn, &rsp_evt);
                             }
                             break;
 
@@ -530,7 +1075,7 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                 if (vh_value_is_enabled(p_gatt_evt->param.flag_update.handle, &is_enabled)
                                         != NRF_SUCCESS)
                                 {
-                                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
+                                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_HANDLE);
                                     break;
                                 }
 
@@ -539,17 +1084,79 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
                                 rsp_evt.param.flag_update.handle = p_gatt_evt->param.flag_update.handle;
                                 rsp_evt.param.flag_update.flag = p_gatt_evt->param.flag_update.flag;
                                 rsp_evt.param.flag_update.value = (uint8_t) is_enabled;
-                                mesh_gatt_evt_push(&rsp_evt);
+                                mesh_gatt_evt_push(p_conn, &rsp_evt);
                             }
                             break;
 
                         default:
-                            mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_UNKNOWN_FLAG);
+                            mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_UNKNOWN_FLAG);
+                    }
+                    break;
+
+                case MESH_GATT_EVT_OPCODE_STATS_REQ:
+                    {
+                        rbc_mesh_stats_t stats;
+                        if (p_gatt_evt->param.stats.offset >= sizeof(rbc_mesh_stats_t) ||
+                            rbc_mesh_stats_get(&stats) != NRF_SUCCESS)
+                        {
+                            mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_PARAM);
+                            break;
+                        }
+
+                        mesh_gatt_evt_t rsp_evt;
+                        rsp_evt.opcode = MESH_GATT_EVT_OPCODE_STATS_RSP;
+                        rsp_evt.param.stats.offset = p_gatt_evt->param.stats.offset;
+                        rsp_evt.param.stats.total_len = sizeof(rbc_mesh_stats_t);
+                        uint32_t len = sizeof(rbc_mesh_stats_t) - rsp_evt.param.stats.offset;
+                        if (len > MESH_GATT_STATS_CHUNK_LEN)
+                        {
+                            len = MESH_GATT_STATS_CHUNK_LEN;
+                        }
+                        memcpy(rsp_evt.param.stats.data, ((uint8_t*) &stats) + rsp_evt.param.stats.offset, len);
+                        mesh_gatt_evt_push(p_conn, &rsp_evt);
+                    }
+                    break;
+
+                case MESH_GATT_EVT_OPCODE_DATA_UNACKED:
+                    unacked_write_handle(p_conn, &p_gatt_evt->param.data_update,
+                            p_ble_evt->evt.gatts_evt.params.write.len);
+                    break;
+
+                case MESH_GATT_EVT_OPCODE_SUBSCRIBE:
+                    if (p_gatt_evt->param.subscribe.handle_min > p_gatt_evt->param.subscribe.handle_max)
+                    {
+                        mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_PARAM);
+                        break;
                     }
+                    p_conn->handle_min = p_gatt_evt->param.subscribe.handle_min;
+                    p_conn->handle_max = p_gatt_evt->param.subscribe.handle_max;
+                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_SUCCESS);
                     break;
 
                 default:
-                    mesh_gatt_cmd_rsp_push((mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_OPCODE);
+                    mesh_gatt_cmd_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_gatt_evt->opcode, MESH_GATT_RESULT_ERROR_INVALID_OPCODE);
+            }
+        }
+        else if (p_ble_evt->evt.gatts_evt.params.write.handle == m_mesh_service.ble_bulk_char_handles.value_handle)
+        {
+            uint8_t* p_data = p_ble_evt->evt.gatts_evt.params.write.data;
+            uint16_t length = p_ble_evt->evt.gatts_evt.params.write.len;
+            switch ((mesh_gatt_evt_opcode_t) p_data[0])
+            {
+                case MESH_GATT_EVT_OPCODE_BULK_DATA:
+                    bulk_write_handle(p_conn, p_data, length);
+                    break;
+
+                case MESH_GATT_EVT_OPCODE_BULK_READ:
+                    /* a new read restarts any ongoing read */
+                    p_conn->bulk_read.active = true;
+                    p_conn->bulk_read.iterator = 0;
+                    p_conn->bulk_read.count = 0;
+                    bulk_read_continue(p_conn);
+                    break;
+
+                default:
+                    mesh_gatt_bulk_rsp_push(p_conn, (mesh_gatt_evt_opcode_t) p_data[0], MESH_GATT_RESULT_ERROR_INVALID_OPCODE, 0);
             }
         }
         else if (p_ble_evt->evt.gatts_evt.params.write.handle == m_mesh_service.ble_md_char_handles.value_handle)
@@ -560,19 +1167,123 @@ void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
         }
         else if (p_ble_evt->evt.gatts_evt.params.write.handle == m_mesh_service.ble_val_char_handles.cccd_handle)
         {
-            m_mesh_service.notification_enabled = (p_ble_evt->evt.gatts_evt.params.write.data[0] != 0);
+            p_conn->notification_enabled = (p_ble_evt->evt.gatts_evt.params.write.data[0] != 0);
+            if (!p_conn->notification_enabled)
+            {
+                notification_queue_clear(&p_conn->notification_queue);
+            }
+        }
+        else if (p_ble_evt->evt.gatts_evt.params.write.handle == m_mesh_service.ble_bulk_char_handles.cccd_handle)
+        {
+            p_conn->bulk_notification_enabled = (p_ble_evt->evt.gatts_evt.params.write.data[0] != 0);
         }
     }
+    else if (p_ble_evt->header.evt_id == BLE_EVT_TX_COMPLETE)
+    {
+        mesh_gatt_conn_t* p_conn = conn_get(p_ble_evt->evt.common_evt.conn_handle);
+        if (p_conn != NULL)
+        {
+            unacked_status_send(p_conn);
+            notification_queue_drain(p_conn);
+            bulk_read_continue(p_conn);
+        }
+    }
+#if (NORDIC_SDK_VERSION >= 12)
+    else if (p_ble_evt->header.evt_id == BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST)
+    {
+        mesh_gatt_conn_t* p_conn = conn_get(p_ble_evt->evt.gatts_evt.conn_handle);
+        uint16_t client_mtu = p_ble_evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu;
+        if (p_conn != NULL &&
+            sd_ble_gatts_exchange_mtu_reply(p_conn->conn_handle, MESH_GATT_BULK_ATT_MTU) == NRF_SUCCESS)
+        {
+            p_conn->att_mtu = (client_mtu < MESH_GATT_BULK_ATT_MTU) ? client_mtu : MESH_GATT_BULK_ATT_MTU;
+            if (p_conn->att_mtu < GATT_MTU_SIZE_DEFAULT)
+            {
+                p_conn->att_mtu = GATT_MTU_SIZE_DEFAULT;
+            }
+        }
+    }
+#endif
     else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
     {
-        m_active_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        /* The SoftDevice never has more links than it was enabled with, a
+           connection without a free slot is one the application enabled more
+           links for than MESH_GATT_CONN_COUNT_MAX. */
+        mesh_gatt_conn_t* p_conn = NULL;
+        for (uint32_t i = 0; i < MESH_GATT_CONN_COUNT_MAX; ++i)
+        {
+            if (m_conns[i].conn_handle == CONN_HANDLE_INVALID)
+            {
+                p_conn = &m_conns[i];
+                break;
+            }
+        }
+        if (p_conn == NULL)
+        {
+            return;
+        }
+        memset(p_conn, 0, sizeof(mesh_gatt_conn_t));
+        p_conn->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_conn->att_mtu = GATT_MTU_SIZE_DEFAULT;
+        p_conn->handle_min = 0;
+        p_conn->handle_max = RBC_MESH_INVALID_HANDLE; /* all handles */
+        p_conn->conn_interval_us = CONN_INTERVAL_TO_US(p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval);
+        conn_interval_update();
+    }
+    else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONN_PARAM_UPDATE)
+    {
+        mesh_gatt_conn_t* p_conn = conn_get(p_ble_evt->evt.gap_evt.conn_handle);
+        if (p_conn != NULL)
+        {
+            p_conn->conn_interval_us = CONN_INTERVAL_TO_US(p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval);
+            conn_interval_update();
+        }
     }
     else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
     {
-        m_active_conn_handle = CONN_HANDLE_INVALID;
+        mesh_gatt_conn_t* p_conn = conn_get(p_ble_evt->evt.gap_evt.conn_handle);
+        if (p_conn != NULL)
+        {
+            notification_queue_clear(&p_conn->notification_queue);
+            p_conn->bulk_read.active = false;
+            p_conn->conn_handle = CONN_HANDLE_INVALID;
+            conn_interval_update();
+        }
     }
 }
 
+#else /* RBC_MESH_NO_GATT */
+
+uint32_t mesh_gatt_init(uint32_t access_address, uint8_t channel, uint32_t interval_min_ms)
+{
+    /* no mesh service in the GATT server */
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_gatt_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length)
+{
+    return NRF_ERROR_NOT_SUPPORTED;
+}
+
+void mesh_gatt_sd_ble_event_handle(ble_evt_t* p_ble_evt)
+{
+    /* the timeslots still have to fit around the application's own connection */
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
+    {
+        timeslot_conn_interval_set(CONN_INTERVAL_TO_US(p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval));
+    }
+    else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONN_PARAM_UPDATE)
+    {
+        timeslot_conn_interval_set(CONN_INTERVAL_TO_US(p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval));
+    }
+    else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        timeslot_conn_interval_set(0);
+    }
+}
+
+#endif /* RBC_MESH_NO_GATT */
+
 #else /* SOFTDEVICE NOT PRESENT */
 
 uint32_t mesh_gatt_init(uint32_t access_address, uint8_t channel, uint32_t interval_min_ms)
@@ -0,0 +1,302 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_group.h"
+
+#ifdef RBC_MESH_VALUE_GROUPS
+
+#include "version_handler.h"
+#include "event_handler.h"
+#include "mesh_segment.h"
+#include "mesh_gatt.h"
+#include "nrf_error.h"
+
+#ifdef RBC_MESH_TIME_SERIES
+#include "mesh_series.h"
+#endif
+
+#include <string.h>
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t count;
+    rbc_mesh_value_handle_t components[RBC_MESH_GROUP_COMPONENTS_MAX];
+} value_group_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static value_group_t    m_groups[RBC_MESH_GROUPS_MAX];
+static uint8_t          m_group_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static value_group_t* group_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_group_count; ++i)
+    {
+        if (m_groups[i].handle == handle)
+        {
+            return &m_groups[i];
+        }
+    }
+    return NULL;
+}
+
+static value_group_t* component_group_get(rbc_mesh_value_handle_t handle, uint8_t* p_index)
+{
+    for (uint32_t i = 0; i < m_group_count; ++i)
+    {
+        for (uint8_t j = 0; j < m_groups[i].count; ++j)
+        {
+            if (m_groups[i].components[j] == handle)
+            {
+                if (p_index != NULL)
+                {
+                    *p_index = j;
+                }
+                return &m_groups[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/** Check that the handle can join a group. */
+static bool handle_is_free(rbc_mesh_value_handle_t handle)
+{
+    return (handle <= RBC_MESH_APP_MAX_HANDLE &&
+            !mesh_segment_is_segmented(handle) &&
+#ifdef RBC_MESH_TIME_SERIES
+            !mesh_series_is_series(handle) &&
+#endif
+            group_get(handle) == NULL &&
+            component_group_get(handle, NULL) == NULL);
+}
+
+static uint32_t group_unpack(const value_group_t* p_group,
+        const uint8_t* p_data,
+        uint16_t length,
+        const uint8_t** pp_data,
+        uint16_t* p_lengths)
+{
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < p_group->count; ++i)
+    {
+        if (offset >= length || offset + 1 + p_data[offset] > length)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        p_lengths[i] = p_data[offset];
+        pp_data[i] = &p_data[offset + 1];
+        offset += 1 + p_lengths[i];
+    }
+    return (offset == length ? NRF_SUCCESS : NRF_ERROR_INVALID_DATA);
+}
+
+/** Pack the components into a new version of the group. */
+static uint32_t group_apply(const value_group_t* p_group, const uint8_t* const* pp_data, const uint16_t* p_lengths)
+{
+    uint8_t value[RBC_MESH_VALUE_MAX_LEN];
+    uint16_t length = 0;
+    for (uint8_t i = 0; i < p_group->count; ++i)
+    {
+        if (length + 1 + p_lengths[i] > RBC_MESH_VALUE_MAX_LEN)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        value[length++] = p_lengths[i];
+        memcpy(&value[length], pp_data[i], p_lengths[i]);
+        length += p_lengths[i];
+    }
+
+    /* no critical errors if this call fails, ignore return */
+    mesh_gatt_value_set(p_group->handle, value, length);
+
+    /* applied in place, so the next component update sees this one */
+    uint8_t* p_value = value;
+    return vh_local_update_batch(&p_group->handle, &p_value, &length, 1);
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_group_add(rbc_mesh_value_handle_t group_handle, const rbc_mesh_value_handle_t* p_components, uint8_t count)
+{
+    if (p_components == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (count == 0 || count > RBC_MESH_GROUP_COMPONENTS_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!handle_is_free(group_handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (!handle_is_free(p_components[i]) || p_components[i] == group_handle)
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+        for (uint8_t j = 0; j < i; ++j)
+        {
+            if (p_components[j] == p_components[i])
+            {
+                return NRF_ERROR_INVALID_ADDR;
+            }
+        }
+    }
+    if (m_group_count >= RBC_MESH_GROUPS_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    value_group_t* p_group = &m_groups[m_group_count];
+    event_handler_critical_section_begin();
+    p_group->handle = group_handle;
+    p_group->count = count;
+    memcpy(p_group->components, p_components, count * sizeof(rbc_mesh_value_handle_t));
+    m_group_count++;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+bool mesh_group_is_group(rbc_mesh_value_handle_t handle)
+{
+    return (group_get(handle) != NULL);
+}
+
+bool mesh_group_is_component(rbc_mesh_value_handle_t handle)
+{
+    return (component_group_get(handle, NULL) != NULL);
+}
+
+uint32_t mesh_group_local_update(rbc_mesh_value_handle_t group_handle, uint8_t* const* pp_data, const uint16_t* p_lengths)
+{
+    const value_group_t* p_group = group_get(group_handle);
+    if (p_group == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    return group_apply(p_group, (const uint8_t* const*) pp_data, p_lengths);
+}
+
+uint32_t mesh_group_component_set(rbc_mesh_value_handle_t handle, const uint8_t* data, uint16_t length)
+{
+    uint8_t index;
+    const value_group_t* p_group = component_group_get(handle, &index);
+    if (p_group == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint8_t value[RBC_MESH_VALUE_MAX_LEN];
+    uint16_t value_length = sizeof(value);
+    const uint8_t* pp_data[RBC_MESH_GROUP_COMPONENTS_MAX];
+    uint16_t lengths[RBC_MESH_GROUP_COMPONENTS_MAX];
+
+    /* no received version may slip in between the read and the update */
+    event_handler_critical_section_begin();
+    if (vh_value_get(p_group->handle, value, &value_length) != NRF_SUCCESS ||
+        group_unpack(p_group, value, value_length, pp_data, lengths) != NRF_SUCCESS)
+    {
+        /* nothing to build on, the other components start out empty */
+        for (uint8_t i = 0; i < p_group->count; ++i)
+        {
+            pp_data[i] = value;
+            lengths[i] = 0;
+        }
+    }
+    pp_data[index] = data;
+    lengths[index] = length;
+    uint32_t error_code = group_apply(p_group, pp_data, lengths);
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+uint32_t mesh_group_component_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length)
+{
+    uint8_t index;
+    const value_group_t* p_group = component_group_get(handle, &index);
+    if (p_group == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint8_t value[RBC_MESH_VALUE_MAX_LEN];
+    uint16_t value_length = sizeof(value);
+    const uint8_t* pp_data[RBC_MESH_GROUP_COMPONENTS_MAX];
+    uint16_t lengths[RBC_MESH_GROUP_COMPONENTS_MAX];
+    if (vh_value_get(p_group->handle, value, &value_length) != NRF_SUCCESS ||
+        group_unpack(p_group, value, value_length, pp_data, lengths) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (lengths[index] > *p_length)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    memcpy(data, pp_data[index], lengths[index]);
+    *p_length = lengths[index];
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_group_unpack(rbc_mesh_value_handle_t group_handle,
+        const uint8_t* p_data,
+        uint16_t length,
+        const uint8_t** pp_data,
+        uint16_t* p_lengths,
+        uint8_t* p_count)
+{
+    if (p_data == NULL || pp_data == NULL || p_lengths == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    const value_group_t* p_group = group_get(group_handle);
+    if (p_group == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    uint32_t error_code = group_unpack(p_group, p_data, length, pp_data, p_lengths);
+    if (error_code == NRF_SUCCESS)
+    {
+        *p_count = p_group->count;
+    }
+    return error_code;
+}
+
+#endif /* RBC_MESH_VALUE_GROUPS */
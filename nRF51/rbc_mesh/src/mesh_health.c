@@ -0,0 +1,196 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_health.h"
+
+#ifdef RBC_MESH_HEALTH_MONITOR
+
+#include "version_handler.h"
+#include "event_handler.h"
+#include "mesh_gatt.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "app_error.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define HEALTH_INTERVAL_US          (RBC_MESH_HEALTH_INTERVAL_MS * 1000)
+
+/** Extern declaration of the hidden api function event_push. */
+extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_event);
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static timer_event_t            m_timer;
+static bool                     m_running;
+static uint16_t                 m_thresholds[RBC_MESH_HEALTH_METRIC_COUNT];
+static uint32_t                 m_counters_prev[RBC_MESH_HEALTH_METRIC_COUNT];
+static uint16_t                 m_alarms_reported;
+static rbc_mesh_value_handle_t  m_handle = RBC_MESH_INVALID_HANDLE;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+/** Get the cumulative counter behind each metric. */
+static void counters_get(uint32_t* p_counters)
+{
+    rbc_mesh_stats_t stats;
+    APP_ERROR_CHECK(rbc_mesh_stats_get(&stats));
+    p_counters[RBC_MESH_HEALTH_APP_QUEUE_DROP] = stats.app_queue_drop;
+    p_counters[RBC_MESH_HEALTH_INTERNAL_QUEUE_DROP] = stats.internal_queue_drop;
+    p_counters[RBC_MESH_HEALTH_RX_QUEUE_DROP] = stats.rx_queue_drop;
+    p_counters[RBC_MESH_HEALTH_TX_QUEUE_DROP] = stats.tx_queue_drop;
+    p_counters[RBC_MESH_HEALTH_POOL_EXHAUSTED] = stats.packet_pool.alloc_failures;
+    p_counters[RBC_MESH_HEALTH_TIMESLOT_DENIED] = stats.timeslot.denied;
+#ifdef RBC_MESH_ORIGIN_TIME
+    p_counters[RBC_MESH_HEALTH_LATE_VERSIONS] = vh_propagation_late_count_get();
+#else
+    p_counters[RBC_MESH_HEALTH_LATE_VERSIONS] = 0;
+#endif
+}
+
+static void report_publish(const rbc_mesh_event_t* p_evt)
+{
+    uint8_t report[RBC_MESH_HEALTH_REPORT_LEN];
+    report[0] = (uint8_t) p_evt->params.health.alarms;
+    report[1] = (uint8_t) (p_evt->params.health.alarms >> 8);
+    for (uint32_t i = 0; i < RBC_MESH_HEALTH_METRIC_COUNT; ++i)
+    {
+        report[2 + 2 * i] = (uint8_t) p_evt->params.health.counts[i];
+        report[3 + 2 * i] = (uint8_t) (p_evt->params.health.counts[i] >> 8);
+    }
+    if (vh_local_update(m_handle, report, RBC_MESH_HEALTH_REPORT_LEN) == NRF_SUCCESS)
+    {
+        /* no critical errors if this call fails, ignore return */
+        mesh_gatt_value_set(m_handle, report, RBC_MESH_HEALTH_REPORT_LEN);
+    }
+}
+
+static void health_timeout(timestamp_t timestamp, void* p_context)
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    uint32_t counters[RBC_MESH_HEALTH_METRIC_COUNT];
+    counters_get(counters);
+
+    rbc_mesh_event_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.type = RBC_MESH_EVENT_TYPE_HEALTH;
+    evt.params.health.timestamp_us = timestamp;
+    for (uint32_t i = 0; i < RBC_MESH_HEALTH_METRIC_COUNT; ++i)
+    {
+        uint32_t count = counters[i] - m_counters_prev[i];
+        m_counters_prev[i] = counters[i];
+        evt.params.health.counts[i] = (count > UINT16_MAX ? UINT16_MAX : (uint16_t) count);
+        if (m_thresholds[i] != 0 && count > m_thresholds[i])
+        {
+            evt.params.health.alarms |= (1 << i);
+        }
+    }
+
+    if (evt.params.health.alarms == m_alarms_reported)
+    {
+        return;
+    }
+    evt.params.health.raised = evt.params.health.alarms & ~m_alarms_reported;
+
+    if (m_handle != RBC_MESH_INVALID_HANDLE)
+    {
+        report_publish(&evt);
+    }
+    /* a dropped event is retried with the next check */
+    if (rbc_mesh_event_push(&evt) == NRF_SUCCESS)
+    {
+        m_alarms_reported = evt.params.health.alarms;
+    }
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_health_threshold_set(rbc_mesh_health_metric_t metric, uint16_t threshold)
+{
+    if (metric >= RBC_MESH_HEALTH_METRIC_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#ifndef RBC_MESH_ORIGIN_TIME
+    if (metric == RBC_MESH_HEALTH_LATE_VERSIONS)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+#endif
+
+    event_handler_critical_section_begin();
+    m_thresholds[metric] = threshold;
+    bool watching = false;
+    for (uint32_t i = 0; i < RBC_MESH_HEALTH_METRIC_COUNT; ++i)
+    {
+        watching = watching || (m_thresholds[i] != 0);
+    }
+
+    if (watching && !m_running)
+    {
+        m_running = true;
+        m_alarms_reported = 0;
+        counters_get(m_counters_prev);
+        m_timer.cb = health_timeout;
+        m_timer.interval = HEALTH_INTERVAL_US;
+        APP_ERROR_CHECK(timer_sch_reschedule(&m_timer, timer_now() + HEALTH_INTERVAL_US));
+    }
+    else if (!watching && m_running)
+    {
+        m_running = false;
+        (void) timer_sch_abort(&m_timer);
+    }
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_health_handle_set(rbc_mesh_value_handle_t handle)
+{
+    if (handle != RBC_MESH_INVALID_HANDLE && handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    event_handler_critical_section_begin();
+    m_handle = handle;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+#endif /* RBC_MESH_HEALTH_MONITOR */
@@ -0,0 +1,136 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+#include "mesh_log.h"
+
+#ifdef RBC_MESH_LOG
+
+#include "rbc_mesh.h"
+#include "timer.h"
+#include "fifo.h"
+#include "toolchain.h"
+#include "SEGGER_RTT.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static mesh_log_record_t m_log_queue_buffer[RBC_MESH_LOG_QUEUE_LENGTH];
+static fifo_t m_log_queue;
+static uint8_t m_log_rtt_buffer[RBC_MESH_LOG_BUFFER_SIZE];
+static uint32_t m_dropped_count;
+static uint32_t m_dropped_total;
+static bool m_is_initialized;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static bool record_push(uint32_t timestamp, uint16_t id, uint32_t arg0, uint32_t arg1)
+{
+    mesh_log_record_t record;
+    record.timestamp = timestamp;
+    record.id = id;
+    record.reserved = 0;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    return (fifo_push(&m_log_queue, &record) == NRF_SUCCESS);
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+void mesh_log_init(void)
+{
+    m_log_queue.elem_array = m_log_queue_buffer;
+    m_log_queue.elem_size = sizeof(mesh_log_record_t);
+    m_log_queue.array_len = RBC_MESH_LOG_QUEUE_LENGTH;
+    m_log_queue.memcpy_fptr = NULL;
+    fifo_init(&m_log_queue);
+    m_dropped_count = 0;
+    m_dropped_total = 0;
+    SEGGER_RTT_ConfigUpBuffer(RBC_MESH_LOG_RTT_CHANNEL, "MeshLog",
+            m_log_rtt_buffer, RBC_MESH_LOG_BUFFER_SIZE,
+            SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    m_is_initialized = true;
+}
+
+void mesh_log_event(uint16_t id, uint32_t arg0, uint32_t arg1)
+{
+    if (!m_is_initialized)
+    {
+        return;
+    }
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    uint32_t timestamp = timer_now();
+
+    /* report dropped records before any new ones, so the host knows where
+       the gap is */
+    if (m_dropped_count > 0 &&
+        record_push(timestamp, MESH_LOG_ID_DROPPED, m_dropped_count, 0))
+    {
+        m_dropped_count = 0;
+    }
+
+    if (m_dropped_count > 0 ||
+        !record_push(timestamp, id, arg0, arg1))
+    {
+        m_dropped_count++;
+        m_dropped_total++;
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+uint32_t mesh_log_flush(void)
+{
+    if (!m_is_initialized)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    mesh_log_record_t* p_record;
+    /* records are only popped once RTT has taken them, so a full RTT buffer
+       leaves them in the queue for the next flush. */
+    while ((p_record = fifo_elem_ref_at(&m_log_queue, 0)) != NULL &&
+           SEGGER_RTT_WriteSkipNoLock(RBC_MESH_LOG_RTT_CHANNEL, p_record, sizeof(mesh_log_record_t)) != 0)
+    {
+        (void) fifo_pop(&m_log_queue, NULL);
+        count++;
+    }
+    return count;
+}
+
+uint32_t mesh_log_dropped_count_get(void)
+{
+    return m_dropped_total;
+}
+
+#endif /* RBC_MESH_LOG */
@@ -0,0 +1,171 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_neighbor.h"
+
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+
+#include "event_handler.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+/** Fractional bits of the RSSI average. */
+#define RSSI_AVG_FRACTION_BITS      (4)
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    uint32_t last_rx;           /**< Timestamp of the last packet. */
+    uint32_t packet_count;
+    uint16_t rssi_avg;          /**< RSSI moving average in -dBm, with RSSI_AVG_FRACTION_BITS fractional bits. */
+    ble_gap_addr_t addr;
+} neighbor_entry_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static neighbor_entry_t m_neighbors[RBC_MESH_NEIGHBOR_TABLE_SIZE];
+static uint8_t          m_neighbor_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static neighbor_entry_t* neighbor_entry_get(const ble_gap_addr_t* p_addr, uint32_t timestamp)
+{
+    for (uint32_t i = 0; i < m_neighbor_count; ++i)
+    {
+        if (m_neighbors[i].addr.addr_type == p_addr->addr_type &&
+            memcmp(m_neighbors[i].addr.addr, p_addr->addr, BLE_GAP_ADDR_LEN) == 0)
+        {
+            return &m_neighbors[i];
+        }
+    }
+
+    neighbor_entry_t* p_entry;
+    if (m_neighbor_count < RBC_MESH_NEIGHBOR_TABLE_SIZE)
+    {
+        p_entry = &m_neighbors[m_neighbor_count++];
+    }
+    else
+    {
+        /* replace the neighbor that has been quiet for the longest */
+        p_entry = &m_neighbors[0];
+        for (uint32_t i = 1; i < m_neighbor_count; ++i)
+        {
+            if (timestamp - m_neighbors[i].last_rx > timestamp - p_entry->last_rx)
+            {
+                p_entry = &m_neighbors[i];
+            }
+        }
+    }
+    memcpy(&p_entry->addr, p_addr, sizeof(ble_gap_addr_t));
+    p_entry->packet_count = 0;
+    return p_entry;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_neighbor_rx(const ble_gap_addr_t* p_addr, uint8_t rssi, uint32_t timestamp)
+{
+    neighbor_entry_t* p_entry = neighbor_entry_get(p_addr, timestamp);
+    uint16_t sample = ((uint16_t) rssi) << RSSI_AVG_FRACTION_BITS;
+
+    if (p_entry->packet_count == 0)
+    {
+        p_entry->rssi_avg = sample;
+    }
+    else if (sample > p_entry->rssi_avg)
+    {
+        p_entry->rssi_avg += (sample - p_entry->rssi_avg) >> RBC_MESH_NEIGHBOR_RSSI_WEIGHT_SHIFT;
+    }
+    else
+    {
+        p_entry->rssi_avg -= (p_entry->rssi_avg - sample) >> RBC_MESH_NEIGHBOR_RSSI_WEIGHT_SHIFT;
+    }
+
+    if (p_entry->packet_count != UINT32_MAX)
+    {
+        p_entry->packet_count++;
+    }
+    p_entry->last_rx = timestamp;
+}
+
+uint32_t mesh_neighbor_get(uint8_t index, rbc_mesh_neighbor_t* p_neighbor)
+{
+    if (p_neighbor == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    event_handler_critical_section_begin();
+    if (index >= m_neighbor_count)
+    {
+        event_handler_critical_section_end();
+        return NRF_ERROR_NOT_FOUND;
+    }
+    neighbor_entry_t* p_entry = &m_neighbors[index];
+    memcpy(&p_neighbor->addr, &p_entry->addr, sizeof(ble_gap_addr_t));
+    p_neighbor->rssi = -((int8_t) ((p_entry->rssi_avg + (1 << (RSSI_AVG_FRACTION_BITS - 1))) >> RSSI_AVG_FRACTION_BITS));
+    p_neighbor->packet_count = p_entry->packet_count;
+    p_neighbor->last_rx_us = p_entry->last_rx;
+    event_handler_critical_section_end();
+
+    return NRF_SUCCESS;
+}
+
+uint8_t mesh_neighbor_count_get(uint32_t time_now, uint32_t max_age_us)
+{
+    uint8_t count = 0;
+    event_handler_critical_section_begin();
+    for (uint32_t i = 0; i < m_neighbor_count; ++i)
+    {
+        if (time_now - m_neighbors[i].last_rx <= max_age_us)
+        {
+            count++;
+        }
+    }
+    event_handler_critical_section_end();
+    return count;
+}
+
+void mesh_neighbor_table_clear(void)
+{
+    event_handler_critical_section_begin();
+    m_neighbor_count = 0;
+    event_handler_critical_section_end();
+}
+
+#endif /* RBC_MESH_NEIGHBOR_TABLE */
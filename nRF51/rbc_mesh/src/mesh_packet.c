@@ -29,50 +29,214 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 
 #include "mesh_packet.h"
+#include "rbc_mesh_common.h"
 #include "app_error.h"
 #include <string.h>
 
-#define PACKET_INDEX(p_packet) ((((uint32_t) p_packet) - ((uint32_t) &g_packet_pool[0])) / sizeof(mesh_packet_t))
+#define PACKET_INDEX(p_packet) (((uint32_t) (((uintptr_t) p_packet) - ((uintptr_t) &g_packet_pool[0]))) / sizeof(mesh_packet_t))
+#define PACKET_INDEX_INVALID   (g_packet_pool_size)
+/* AD cache entries hold the header length the offset was found for in the
+   upper byte. No packet of length 0 has adv data, so 0 is never a hit. */
+#define AD_CACHE_ENTRY(length, offset) ((uint16_t) (((length) << 8) | (offset)))
+#define AD_CACHE_NONE                  (0)
+
+/* The Cortex-M4 of the nRF52 has exclusive byte accesses, which lets the ref
+   counts be updated without masking interrupts. The M0 of the nRF51 doesn't. */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 0x03)
+#define PACKET_REFS_EXCLUSIVE
+#endif
 /******************************************************************************
 * Static globals
 ******************************************************************************/
-static mesh_packet_t g_packet_pool[RBC_MESH_PACKET_POOL_SIZE];
-static uint8_t g_packet_refs[RBC_MESH_PACKET_POOL_SIZE];
+static mesh_packet_t* g_packet_pool;
+static uint8_t* g_packet_refs;
+static uint16_t* g_packet_free_next; /**< Free list links, only valid for packets without references. */
+static uint16_t* g_packet_ad_cache; /**< Offset of the first mesh adv data in each packet, see AD_CACHE_ENTRY. */
+static uint16_t g_packet_free_head;
+static uint16_t g_packet_pool_size;
+#ifndef RBC_MESH_EXTERNAL_MEMORY
+static mesh_packet_t g_packet_pool_default[RBC_MESH_PACKET_POOL_SIZE];
+static uint8_t g_packet_refs_default[RBC_MESH_PACKET_POOL_SIZE];
+static uint16_t g_packet_free_next_default[RBC_MESH_PACKET_POOL_SIZE];
+static uint16_t g_packet_ad_cache_default[RBC_MESH_PACKET_POOL_SIZE];
+#endif
+static rbc_mesh_packet_pool_stats_t g_packet_pool_stats;
+static uint8_t g_payload_max_length = BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH;
+/******************************************************************************
+* Static functions
+******************************************************************************/
+/** Find the first mesh adv data structure at or after p_start in the packet
+  payload. Returns NULL if there's none, or if an AD structure runs past the end
+  of the packet. */
+static mesh_adv_data_t* mesh_adv_data_find(mesh_packet_t* p_packet, uint8_t* p_start)
+{
+    uint8_t* p_end = &p_packet->payload[0] + (p_packet->header.length - MESH_PACKET_BLE_OVERHEAD);
+    uint8_t* p_ad = p_start;
+
+    /* loop through all ad data structures */
+    while (p_ad + 1 < p_end)
+    {
+        mesh_adv_data_t* p_mesh_adv_data = (mesh_adv_data_t*) p_ad;
+        if (p_mesh_adv_data->adv_data_length == 0 ||
+            p_ad + p_mesh_adv_data->adv_data_length + 1 > p_end)
+        {
+            /* invalid ad length */
+            return NULL;
+        }
+        if (p_mesh_adv_data->adv_data_type == MESH_ADV_DATA_TYPE &&
+            p_mesh_adv_data->adv_data_length >= MESH_PACKET_ADV_OVERHEAD &&
+            p_mesh_adv_data->mesh_uuid == MESH_UUID)
+        {
+            /* The network packet overlaps with AD-data */
+            return p_mesh_adv_data;
+        }
+        p_ad += p_mesh_adv_data->adv_data_length + 1; /* length field in ad data is not considered */
+    }
+
+    return NULL;
+}
+
+/** Get the AD cache entry of the given packet, or NULL if it isn't the start
+  of a packet in the pool. */
+static uint16_t* ad_cache_entry_get(mesh_packet_t* p_packet)
+{
+    uint32_t index = PACKET_INDEX(p_packet);
+    if (index >= g_packet_pool_size || &g_packet_pool[index] != p_packet)
+    {
+        return NULL;
+    }
+    return &g_packet_ad_cache[index];
+}
+
+/** Take the first packet off the free list, with a single reference. Must be
+  called with interrupts masked, on a non-empty free list. */
+static mesh_packet_t* free_list_pop(void)
+{
+    uint16_t index = g_packet_free_head;
+    g_packet_free_head = g_packet_free_next[index];
+    g_packet_refs[index] = 1;
+    g_packet_ad_cache[index] = AD_CACHE_NONE;
+    if (++g_packet_pool_stats.in_use > g_packet_pool_stats.high_water_mark)
+    {
+        g_packet_pool_stats.high_water_mark = g_packet_pool_stats.in_use;
+    }
+    return &g_packet_pool[index];
+}
+
 /******************************************************************************
 * Interface functions
 ******************************************************************************/
-void mesh_packet_init(void)
+uint32_t mesh_packet_memory_size_get(uint16_t pool_size)
 {
-    for (uint32_t i = 0; i < RBC_MESH_PACKET_POOL_SIZE; ++i)
+    return MEMORY_WORD_ALIGN(sizeof(mesh_packet_t) * pool_size) +
+           MEMORY_WORD_ALIGN(sizeof(uint16_t) * pool_size) +
+           MEMORY_WORD_ALIGN(sizeof(uint16_t) * pool_size) +
+           MEMORY_WORD_ALIGN(sizeof(uint8_t) * pool_size);
+}
+
+uint32_t mesh_packet_init(void* p_memory, uint16_t pool_size)
+{
+    if (p_memory == NULL)
+    {
+#ifdef RBC_MESH_EXTERNAL_MEMORY
+        return NRF_ERROR_NULL;
+#else
+        g_packet_pool = g_packet_pool_default;
+        g_packet_refs = g_packet_refs_default;
+        g_packet_free_next = g_packet_free_next_default;
+        g_packet_ad_cache = g_packet_ad_cache_default;
+        g_packet_pool_size = RBC_MESH_PACKET_POOL_SIZE;
+#endif
+    }
+    else
+    {
+        if (((uintptr_t) p_memory) & 0x03)
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+        /* the pool size doubles as the invalid index */
+        if (pool_size == 0 || pool_size == UINT16_MAX)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        uint8_t* p_next = (uint8_t*) p_memory;
+        g_packet_pool = (mesh_packet_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(mesh_packet_t) * pool_size);
+        g_packet_free_next = (uint16_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(uint16_t) * pool_size);
+        g_packet_ad_cache = (uint16_t*) p_next;
+        p_next += MEMORY_WORD_ALIGN(sizeof(uint16_t) * pool_size);
+        g_packet_refs = p_next;
+        g_packet_pool_size = pool_size;
+    }
+
+    for (uint32_t i = 0; i < g_packet_pool_size; ++i)
     {
-        /* reset ref count field */
+        /* reset ref count field, and chain all packets in the free list */
         g_packet_refs[i] = 0;
+        g_packet_free_next[i] = i + 1;
+        g_packet_ad_cache[i] = AD_CACHE_NONE;
     }
+    g_packet_free_head = 0;
+
+    memset(&g_packet_pool_stats, 0, sizeof(g_packet_pool_stats));
+    g_packet_pool_stats.pool_size = g_packet_pool_size;
+    return NRF_SUCCESS;
 }
 
 bool mesh_packet_acquire(mesh_packet_t** pp_packet)
 {
     uint32_t was_masked;
-    for (uint32_t i = 0; i < RBC_MESH_PACKET_POOL_SIZE; ++i)
+    _DISABLE_IRQS(was_masked);
+    if (g_packet_free_head == PACKET_INDEX_INVALID)
     {
-        _DISABLE_IRQS(was_masked);
-        if (g_packet_refs[i] == 0) /* no refs, free to use */
-        {
-            g_packet_refs[i] = 1;
-            *pp_packet = &g_packet_pool[i];
-            _ENABLE_IRQS(was_masked);
-            return true;
-        }
+        g_packet_pool_stats.alloc_failures++;
+        _ENABLE_IRQS(was_masked);
+        APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+        return false;
+    }
+    *pp_packet = free_list_pop();
+    _ENABLE_IRQS(was_masked);
+    return true;
+}
+
+bool mesh_packet_acquire_rx(mesh_packet_t** pp_packet)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (g_packet_pool_size - g_packet_pool_stats.in_use <= RBC_MESH_PACKET_POOL_RX_RESERVE)
+    {
+        g_packet_pool_stats.rx_denied++;
         _ENABLE_IRQS(was_masked);
+        return false;
     }
-    APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
-    return false;
+    *pp_packet = free_list_pop();
+    _ENABLE_IRQS(was_masked);
+    return true;
+}
+
+void mesh_packet_pool_stats_get(rbc_mesh_packet_pool_stats_t* p_stats)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    memcpy(p_stats, &g_packet_pool_stats, sizeof(rbc_mesh_packet_pool_stats_t));
+    _ENABLE_IRQS(was_masked);
+}
+
+void mesh_packet_payload_max_set(uint8_t length)
+{
+    g_payload_max_length = length;
+}
+
+uint8_t mesh_packet_payload_max_get(void)
+{
+    return g_payload_max_length;
 }
 
 mesh_packet_t* mesh_packet_get_aligned(void* p_buf_pointer)
 {
     uint32_t index = PACKET_INDEX(p_buf_pointer);
-    if (index < RBC_MESH_PACKET_POOL_SIZE)
+    if (index < g_packet_pool_size)
     {
         return &g_packet_pool[index];
     }
@@ -86,30 +250,66 @@ bool mesh_packet_ref_count_inc(mesh_packet_t* p_packet)
 {
     /* the given pointer may not be aligned, have to force alignment with index */
     uint32_t index = PACKET_INDEX(p_packet);
-    if (index >= RBC_MESH_PACKET_POOL_SIZE)
+    if (index >= g_packet_pool_size)
     {
         return false;
     }
 
+#ifdef PACKET_REFS_EXCLUSIVE
+    uint8_t refs;
+    do
+    {
+        refs = __LDREXB(&g_packet_refs[index]);
+        if (refs == 0x00 || refs == 0xFF) /* check for rollover and 0-inc */
+        {
+            __CLREX();
+            APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+            return false; /* must not resurrect a packet in the free list */
+        }
+    } while (__STREXB(refs + 1, &g_packet_refs[index]) != 0);
+#else
     uint32_t was_masked;
     _DISABLE_IRQS(was_masked);
     if (g_packet_refs[index] == 0x00 || g_packet_refs[index] == 0xFF) /* check for rollover and 0-inc */
     {
+        _ENABLE_IRQS(was_masked);
         APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+        return false; /* must not resurrect a packet in the free list */
     }
     g_packet_refs[index]++;
     _ENABLE_IRQS(was_masked);
+#endif
     return true;
 }
 
 bool mesh_packet_ref_count_dec(mesh_packet_t* p_packet)
 {
     uint32_t index = PACKET_INDEX(p_packet);
-    if (index >= RBC_MESH_PACKET_POOL_SIZE)
+    if (index >= g_packet_pool_size)
     {
         return false;
     }
 
+#ifdef PACKET_REFS_EXCLUSIVE
+    /* Only the last reference has to touch the free list, which is still
+       protected by masking interrupts. Exception entry and return clear the
+       exclusive monitor, so an interrupted exclusive update of the same count
+       retries after the masked one. */
+    uint8_t refs;
+    do
+    {
+        refs = __LDREXB(&g_packet_refs[index]);
+        if (refs <= 1)
+        {
+            __CLREX();
+            break;
+        }
+    } while (__STREXB(refs - 1, &g_packet_refs[index]) != 0);
+    if (refs > 1)
+    {
+        return true;
+    }
+#endif
     uint32_t was_masked;
     _DISABLE_IRQS(was_masked);
     /* make sure that we aren't rolling over the ref count */
@@ -119,16 +319,23 @@ bool mesh_packet_ref_count_dec(mesh_packet_t* p_packet)
         _ENABLE_IRQS(was_masked);
         return false;
     }
-    g_packet_refs[index]--;
+    bool has_refs = (--g_packet_refs[index] > 0);
+    if (!has_refs)
+    {
+        /* return to the free list */
+        g_packet_free_next[index] = g_packet_free_head;
+        g_packet_free_head = index;
+        g_packet_pool_stats.in_use--;
+    }
     _ENABLE_IRQS(was_masked);
 
-    return (g_packet_refs[index] > 0);
+    return has_refs;
 }
 
 uint8_t mesh_packet_ref_count_get(mesh_packet_t* p_packet)
 {
     uint32_t index = PACKET_INDEX(p_packet);
-    if (index >= RBC_MESH_PACKET_POOL_SIZE)
+    if (index >= g_packet_pool_size)
     {
         return 0;
     }
@@ -190,11 +397,23 @@ uint32_t mesh_packet_build(mesh_packet_t* p_packet,
 
     p_mesh_adv_data->handle = handle;
     p_mesh_adv_data->version = version;
+#ifdef RBC_MESH_HOP_SCOPES
+    p_mesh_adv_data->hops_left = RBC_MESH_HOP_SCOPE_UNLIMITED;
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+    p_mesh_adv_data->origin_time = RBC_MESH_ORIGIN_TIME_NONE;
+#endif
     if (length > 0 && data != NULL && length <= RBC_MESH_VALUE_MAX_LEN)
     {
         memcpy(p_mesh_adv_data->data, data, length);
     }
 
+    uint16_t* p_ad_cache = ad_cache_entry_get(p_packet);
+    if (p_ad_cache != NULL)
+    {
+        *p_ad_cache = AD_CACHE_ENTRY(p_packet->header.length, 0);
+    }
+
     return NRF_SUCCESS;
 }
 
@@ -224,6 +443,12 @@ uint32_t mesh_packet_adv_data_sanitize(mesh_packet_t* p_packet)
         MESH_PACKET_ADV_OVERHEAD +
         p_mesh_adv_data->adv_data_length;
 
+    uint16_t* p_ad_cache = ad_cache_entry_get(p_packet);
+    if (p_ad_cache != NULL)
+    {
+        *p_ad_cache = AD_CACHE_ENTRY(p_packet->header.length, 0);
+    }
+
     return NRF_SUCCESS;
 }
 
@@ -234,28 +459,70 @@ mesh_adv_data_t* mesh_packet_adv_data_get(mesh_packet_t* p_packet)
         return NULL;
     }
 
-    mesh_adv_data_t* p_mesh_adv_data = (mesh_adv_data_t*) &p_packet->payload[0];
     if (p_packet->header.length <= MESH_PACKET_BLE_OVERHEAD ||
         p_packet->header.length > MESH_PACKET_BLE_OVERHEAD + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
     {
         return NULL;
     }
 
-    /* loop through all ad data structures */
-    while (p_mesh_adv_data->adv_data_type != MESH_ADV_DATA_TYPE ||
-           p_mesh_adv_data->mesh_uuid != MESH_UUID)
+    /* The entry is written in one halfword store, and is only trusted if the
+       packet length is unchanged and the structure it points to still fits and
+       is mesh adv data. Anything that rewrites a packet in place either
+       changes its length or keeps the adv data where it was. */
+    uint16_t* p_ad_cache = ad_cache_entry_get(p_packet);
+    if (p_ad_cache != NULL)
     {
-        if (p_mesh_adv_data->adv_data_length + ((uint32_t) p_mesh_adv_data - (uint32_t) (p_packet->payload))
-               > p_packet->header.length - MESH_PACKET_BLE_OVERHEAD)
+        uint16_t entry = *p_ad_cache;
+        if ((entry >> 8) == p_packet->header.length)
         {
-            /* invalid ad length */
-            return NULL;
+            mesh_adv_data_t* p_cached = (mesh_adv_data_t*) &p_packet->payload[entry & 0xFF];
+            if (p_cached->adv_data_type == MESH_ADV_DATA_TYPE &&
+                p_cached->mesh_uuid == MESH_UUID &&
+                p_cached->adv_data_length >= MESH_PACKET_ADV_OVERHEAD &&
+                (entry & 0xFF) + p_cached->adv_data_length + 1 <= p_packet->header.length - MESH_PACKET_BLE_OVERHEAD)
+            {
+                return p_cached;
+            }
         }
-        p_mesh_adv_data += p_mesh_adv_data->adv_data_length + 1; /* length field in ad data is not considered */
     }
 
-    /* The network packet overlaps with AD-data */
-    return (mesh_adv_data_t*) p_mesh_adv_data;
+    mesh_adv_data_t* p_adv_data = mesh_adv_data_find(p_packet, &p_packet->payload[0]);
+    if (p_adv_data != NULL && p_ad_cache != NULL)
+    {
+        *p_ad_cache = AD_CACHE_ENTRY(p_packet->header.length,
+                ((uint8_t*) p_adv_data) - &p_packet->payload[0]);
+    }
+    return p_adv_data;
+}
+
+mesh_adv_data_t* mesh_packet_adv_data_next_get(mesh_packet_t* p_packet, mesh_adv_data_t* p_adv_data)
+{
+    if (p_packet == NULL || p_adv_data == NULL)
+    {
+        return NULL;
+    }
+
+    return mesh_adv_data_find(p_packet,
+            ((uint8_t*) p_adv_data) + p_adv_data->adv_data_length + 1);
+}
+
+uint32_t mesh_packet_adv_data_append(mesh_packet_t* p_packet, const mesh_adv_data_t* p_adv_data)
+{
+    if (p_packet == NULL || p_adv_data == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    const uint8_t ad_length = p_adv_data->adv_data_length + 1;
+    const uint8_t payload_length = p_packet->header.length - MESH_PACKET_BLE_OVERHEAD;
+    if (payload_length + ad_length > g_payload_max_length)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memcpy(&p_packet->payload[payload_length], p_adv_data, ad_length);
+    p_packet->header.length += ad_length;
+
+    return NRF_SUCCESS;
 }
 
 rbc_mesh_value_handle_t mesh_packet_handle_get(mesh_packet_t* p_packet)
@@ -274,18 +541,17 @@ rbc_mesh_value_handle_t mesh_packet_handle_get(mesh_packet_t* p_packet)
 
 bool mesh_packet_has_additional_data(mesh_packet_t* p_packet)
 {
+    /* anything but a single mesh adv data structure at the start of the
+       payload counts, including additional mesh adv data structures. */
     mesh_adv_data_t* p_mesh_adv_data = (mesh_adv_data_t*) &p_packet->payload[0];
-    while (((uint8_t*) p_mesh_adv_data) < &p_packet->payload[0] + (p_packet->header.length - 7))
+    if (p_mesh_adv_data->adv_data_type != MESH_ADV_DATA_TYPE ||
+        p_mesh_adv_data->mesh_uuid != MESH_UUID)
     {
-        if (p_mesh_adv_data->adv_data_type != MESH_ADV_DATA_TYPE ||
-            p_mesh_adv_data->mesh_uuid != MESH_UUID)
-        {
-            return true;
-        }
-        p_mesh_adv_data += p_mesh_adv_data->adv_data_length + 1;
+        return true;
     }
 
-    return false;
+    return (p_packet->header.length !=
+            MESH_PACKET_BLE_OVERHEAD + p_mesh_adv_data->adv_data_length + 1);
 }
 
 void mesh_packet_take_ownership(mesh_packet_t* p_packet)
@@ -302,8 +568,8 @@ void mesh_packet_take_ownership(mesh_packet_t* p_packet)
 
 mesh_packet_t* mesh_packet_get_start_pointer(void* p_content)
 {
-    uint32_t index = ((((uint32_t) p_content) - ((uint32_t) &g_packet_pool[0])) / sizeof(mesh_packet_t));
-    if (index < RBC_MESH_PACKET_POOL_SIZE)
+    uint32_t index = ((uint32_t) (((uintptr_t) p_content) - ((uintptr_t) &g_packet_pool[0]))) / sizeof(mesh_packet_t);
+    if (index < g_packet_pool_size)
     {
         return &g_packet_pool[index];
     }
@@ -0,0 +1,260 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_schedule.h"
+
+#ifdef RBC_MESH_SCHEDULED_VALUES
+
+#include "mesh_packet.h"
+#include "event_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "app_error.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/* event push isn't present in the API header file. */
+extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    bool pending;
+    uint32_t activation_time;               /**< Mesh time the held event is raised at. */
+    mesh_packet_t* p_packet;                /**< Packet of the held value, referenced while pending. */
+    rbc_mesh_event_t evt;                   /**< Held event, without the activation time. */
+    timer_event_t timer;
+} schedule_entry_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static schedule_entry_t m_entries[RBC_MESH_SCHEDULED_HANDLES_MAX];
+static uint8_t          m_entry_count;
+/** The held events are pushed through the regular path, and must not be
+    taken again. */
+static bool             m_activating;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static schedule_entry_t* entry_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_entry_count; ++i)
+    {
+        if (m_entries[i].handle == handle)
+        {
+            return &m_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t le32_get(const uint8_t* p_data)
+{
+    return ((uint32_t) p_data[0] |
+            ((uint32_t) p_data[1] << 8) |
+            ((uint32_t) p_data[2] << 16) |
+            ((uint32_t) p_data[3] << 24));
+}
+
+static void pending_clear(schedule_entry_t* p_entry)
+{
+    if (p_entry->pending)
+    {
+        (void) timer_sch_abort(&p_entry->timer);
+        mesh_packet_ref_count_dec(p_entry->p_packet);
+        p_entry->pending = false;
+    }
+}
+
+static void event_raise(rbc_mesh_event_t* p_evt)
+{
+    m_activating = true;
+    (void) rbc_mesh_event_push(p_evt); /* counted as a queue drop if it fails */
+    m_activating = false;
+}
+
+static void activation_timeout(timestamp_t timestamp, void* p_context)
+{
+    schedule_entry_t* p_entry = (schedule_entry_t*) p_context;
+    if (!p_entry->pending)
+    {
+        return;
+    }
+
+    /* the mesh time may have been corrected since the timer was set */
+    int32_t remaining = (int32_t) (p_entry->activation_time - timer_mesh_time_get(timestamp));
+    if (remaining > 0)
+    {
+        APP_ERROR_CHECK(timer_sch_reschedule(&p_entry->timer, timestamp + remaining));
+        return;
+    }
+
+    p_entry->evt.params.rx.timestamp_us = timestamp;
+    event_raise(&p_entry->evt);
+    mesh_packet_ref_count_dec(p_entry->p_packet);
+    p_entry->pending = false;
+}
+
+/**
+* Hold the event for its activation time, or raise it right away if the time
+* has passed or is out of range. The event's data must be in a mesh packet.
+*/
+static void event_schedule(schedule_entry_t* p_entry, const rbc_mesh_event_t* p_evt)
+{
+    pending_clear(p_entry);
+
+    const uint32_t activation_time = le32_get(p_evt->params.rx.p_data);
+    rbc_mesh_event_t evt = *p_evt;
+    evt.params.rx.p_data += RBC_MESH_SCHEDULE_OVERHEAD;
+    evt.params.rx.data_len -= RBC_MESH_SCHEDULE_OVERHEAD;
+
+    const timestamp_t time_now = timer_now();
+    int32_t remaining = (int32_t) (activation_time - timer_mesh_time_get(time_now));
+    if (remaining <= 0 || remaining > RBC_MESH_SCHEDULE_MAX_AHEAD_US)
+    {
+        /* the nodes that got the value late catch up at once */
+        event_raise(&evt);
+        return;
+    }
+
+    p_entry->p_packet = mesh_packet_get_aligned(evt.params.rx.p_data);
+    mesh_packet_ref_count_inc(p_entry->p_packet);
+    p_entry->evt = evt;
+    p_entry->activation_time = activation_time;
+    p_entry->pending = true;
+    APP_ERROR_CHECK(timer_sch_reschedule(&p_entry->timer, time_now + remaining));
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_schedule_init(void)
+{
+    memset(m_entries, 0, sizeof(m_entries));
+    m_entry_count = 0;
+    m_activating = false;
+}
+
+uint32_t mesh_schedule_enable(rbc_mesh_value_handle_t handle)
+{
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    if (entry_get(handle) == NULL)
+    {
+        if (m_entry_count < RBC_MESH_SCHEDULED_HANDLES_MAX)
+        {
+            schedule_entry_t* p_entry = &m_entries[m_entry_count];
+            memset(p_entry, 0, sizeof(schedule_entry_t));
+            p_entry->handle = handle;
+            p_entry->timer.cb = activation_timeout;
+            p_entry->timer.p_context = p_entry;
+            m_entry_count++;
+        }
+        else
+        {
+            error_code = NRF_ERROR_NO_MEM;
+        }
+    }
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+bool mesh_schedule_is_scheduled(rbc_mesh_value_handle_t handle)
+{
+    return (entry_get(handle) != NULL);
+}
+
+bool mesh_schedule_event_handle(rbc_mesh_event_t* p_evt)
+{
+    if (m_activating ||
+        (p_evt->type != RBC_MESH_EVENT_TYPE_NEW_VAL &&
+         p_evt->type != RBC_MESH_EVENT_TYPE_UPDATE_VAL))
+    {
+        return false;
+    }
+
+    schedule_entry_t* p_entry = entry_get(p_evt->params.rx.value_handle);
+    if (p_entry == NULL ||
+        p_evt->params.rx.p_data == NULL ||
+        p_evt->params.rx.data_len < RBC_MESH_SCHEDULE_OVERHEAD)
+    {
+        /* not a scheduled value, deliver it as it is */
+        return false;
+    }
+
+    event_schedule(p_entry, p_evt);
+    return true;
+}
+
+uint32_t mesh_schedule_local(rbc_mesh_value_handle_t handle, uint8_t* p_data, uint8_t length)
+{
+    schedule_entry_t* p_entry = entry_get(handle);
+    if (p_entry == NULL || length < RBC_MESH_SCHEDULE_OVERHEAD)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    uint32_t error_code = mesh_packet_build(p_packet, handle, 0, p_data, length);
+    if (error_code == NRF_SUCCESS)
+    {
+        rbc_mesh_event_t evt;
+        memset(&evt, 0, sizeof(evt));
+        evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+        evt.params.rx.value_handle = handle;
+        evt.params.rx.p_data = mesh_packet_adv_data_get(p_packet)->data;
+        evt.params.rx.data_len = length;
+        evt.params.rx.version_delta = 1;
+        evt.params.rx.timestamp_us = timer_now();
+        evt.params.rx.source = RBC_MESH_EVENT_SOURCE_LOCAL;
+        evt.params.rx.ble_adv_addr.addr_type = p_packet->header.addr_type;
+        memcpy(evt.params.rx.ble_adv_addr.addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+#ifdef RBC_MESH_ORIGIN_TIME
+        evt.params.rx.propagation_ms = 0;
+#endif
+
+        event_handler_critical_section_begin();
+        event_schedule(p_entry, &evt);
+        event_handler_critical_section_end();
+    }
+    mesh_packet_ref_count_dec(p_packet);
+    return error_code;
+}
+
+#endif /* RBC_MESH_SCHEDULED_VALUES */
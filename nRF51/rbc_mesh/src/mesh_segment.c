@@ -0,0 +1,420 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_segment.h"
+#include "handle_storage.h"
+#include "version_handler.h"
+#include "event_handler.h"
+#include "timer.h"
+#include "app_error.h"
+#include "nrf_error.h"
+#include <string.h>
+
+/* event push isn't present in the API header file. */
+extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define SEGMENT_HEADER_INDEX(header)        ((header) & 0x0F)
+#define SEGMENT_HEADER_LAST(header)         ((header) >> 4)
+#define SEGMENT_HEADER(index, last)         ((uint8_t) (((last) << 4) | (index)))
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;     /**< Handle of the value, or RBC_MESH_INVALID_HANDLE if unused. */
+    uint16_t segment_mask;              /**< Bitmap of segments present in the data buffer. */
+    uint8_t segment_count;              /**< Number of segments in the current version, or 0 if unknown. */
+    uint8_t length;                     /**< Total length of the value, valid when the last segment is present. */
+    uint8_t tx_segment;                 /**< Next segment to transmit. */
+    bool complete;                      /**< All segments of the current version are present. */
+    rbc_mesh_event_type_t event_type;   /**< Event to report once the value is complete. */
+    int16_t version_delta;              /**< Version delta to report once the value is complete. */
+    uint8_t data[RBC_MESH_SEGMENTED_VALUE_MAX_LEN];
+} segment_entry_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+static segment_entry_t m_entries[RBC_MESH_SEGMENTED_VALUE_ENTRIES];
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static segment_entry_t* entry_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < RBC_MESH_SEGMENTED_VALUE_ENTRIES; ++i)
+    {
+        if (m_entries[i].handle == handle)
+        {
+            return &m_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static uint16_t full_mask(uint8_t segment_count)
+{
+    return (uint16_t) ((1UL << segment_count) - 1);
+}
+
+static uint8_t segment_length(const segment_entry_t* p_entry, uint8_t index)
+{
+    if (index + 1 < p_entry->segment_count)
+    {
+        return RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN;
+    }
+    return p_entry->length - index * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN;
+}
+
+static uint32_t segment_build(mesh_packet_t* p_packet, const segment_entry_t* p_entry, uint8_t index, uint16_t version)
+{
+    uint8_t segment[RBC_MESH_VALUE_MAX_LEN];
+    uint8_t length = segment_length(p_entry, index);
+
+    segment[0] = SEGMENT_HEADER(index, p_entry->segment_count - 1);
+    memcpy(&segment[1], &p_entry->data[index * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN], length);
+    return mesh_packet_build(p_packet, p_entry->handle, version, segment, length + 1);
+}
+
+static void segment_store(segment_entry_t* p_entry, uint8_t index, const uint8_t* p_data, uint8_t length)
+{
+    memcpy(&p_entry->data[index * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN], p_data, length);
+    if (index + 1 == p_entry->segment_count)
+    {
+        p_entry->length = index * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN + length;
+    }
+    p_entry->segment_mask |= (1 << index);
+}
+
+static void entry_reset(segment_entry_t* p_entry, uint8_t segment_count)
+{
+    p_entry->segment_mask = 0;
+    p_entry->segment_count = segment_count;
+    p_entry->length = 0;
+    p_entry->tx_segment = 0;
+    p_entry->complete = false;
+}
+#endif
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_segment_init(void)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    for (uint32_t i = 0; i < RBC_MESH_SEGMENTED_VALUE_ENTRIES; ++i)
+    {
+        m_entries[i].handle = RBC_MESH_INVALID_HANDLE;
+        entry_reset(&m_entries[i], 0);
+    }
+#endif
+}
+
+uint32_t mesh_segment_enable(rbc_mesh_value_handle_t handle)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    if (entry_get(handle) == NULL)
+    {
+        segment_entry_t* p_entry = entry_get(RBC_MESH_INVALID_HANDLE);
+        if (p_entry == NULL)
+        {
+            error_code = NRF_ERROR_NO_MEM;
+        }
+        else
+        {
+            entry_reset(p_entry, 0);
+            p_entry->handle = handle;
+        }
+    }
+    event_handler_critical_section_end();
+    return error_code;
+#else
+    return NRF_ERROR_NO_MEM;
+#endif
+}
+
+bool mesh_segment_is_segmented(rbc_mesh_value_handle_t handle)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    return (handle != RBC_MESH_INVALID_HANDLE && entry_get(handle) != NULL);
+#else
+    return false;
+#endif
+}
+
+uint32_t mesh_segment_local_update(rbc_mesh_value_handle_t handle, const uint8_t* data, uint16_t length)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    if (length > RBC_MESH_SEGMENTED_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    segment_entry_t* p_entry = entry_get(handle);
+    if (p_entry == NULL)
+    {
+        error_code = NRF_ERROR_NOT_FOUND;
+    }
+    else
+    {
+        uint8_t segment_count = (length + RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN - 1) / RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN;
+        if (segment_count == 0)
+        {
+            segment_count = 1;
+        }
+        entry_reset(p_entry, segment_count);
+        memcpy(p_entry->data, data, length);
+        p_entry->length = length;
+        p_entry->segment_mask = full_mask(segment_count);
+        p_entry->complete = true;
+
+        /* The first segment represents the value in the handle storage, the
+           version number will be overwritten with the next version. */
+        error_code = segment_build(p_packet, p_entry, 0, 1);
+    }
+    event_handler_critical_section_end();
+
+    if (error_code == NRF_SUCCESS)
+    {
+        error_code = handle_storage_local_packet_push(p_packet);
+        if (error_code == NRF_SUCCESS)
+        {
+            vh_order_update(timer_now()); /* will be executed after the packet push */
+        }
+    }
+
+    mesh_packet_ref_count_dec(p_packet);
+    return error_code;
+#else
+    return NRF_ERROR_NOT_FOUND;
+#endif
+}
+
+uint32_t mesh_segment_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    segment_entry_t* p_entry = entry_get(handle);
+    if (p_entry == NULL || !p_entry->complete)
+    {
+        error_code = NRF_ERROR_NOT_FOUND;
+    }
+    else
+    {
+        memcpy(data, p_entry->data, p_entry->length);
+        *p_length = p_entry->length;
+    }
+    event_handler_critical_section_end();
+    return error_code;
+#else
+    return NRF_ERROR_NOT_FOUND;
+#endif
+}
+
+uint32_t mesh_segment_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length < MESH_PACKET_ADV_OVERHEAD + 1)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    segment_entry_t* p_entry = entry_get(p_adv_data->handle);
+    if (p_entry == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint8_t index = SEGMENT_HEADER_INDEX(p_adv_data->data[0]);
+    uint8_t last = SEGMENT_HEADER_LAST(p_adv_data->data[0]);
+    uint8_t length = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD - 1;
+    if (last >= RBC_MESH_SEGMENT_COUNT_MAX ||
+        index > last ||
+        (index < last && length != RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN) ||
+        last * RBC_MESH_SEGMENT_PAYLOAD_MAX_LEN + length > RBC_MESH_SEGMENTED_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    handle_info_t info;
+    uint32_t error_code = handle_storage_info_get(p_adv_data->handle, &info);
+    int16_t delta = version_delta(info.version, p_adv_data->version);
+
+    if (error_code == NRF_ERROR_NOT_FOUND || delta > 0)
+    {
+        /* First allocate an element in the storage to ensure that we're not out of memory. */
+        uint32_t alloc_error = handle_storage_info_set(p_adv_data->handle, &info);
+        if (alloc_error != NRF_SUCCESS)
+        {
+            mesh_packet_ref_count_dec(info.p_packet);
+            return alloc_error;
+        }
+
+        /* The first segment we hear of a new version represents the value in
+           the handle storage, and restarts its Trickle instance. */
+        mesh_packet_take_ownership(p_packet);
+        handle_info_t new_info =
+        {
+            .p_packet = p_packet,
+            .version = p_adv_data->version
+        };
+        APP_ERROR_CHECK(handle_storage_info_set(p_adv_data->handle, &new_info));
+
+        entry_reset(p_entry, last + 1);
+        p_entry->event_type = (error_code == NRF_ERROR_NOT_FOUND) ? RBC_MESH_EVENT_TYPE_NEW_VAL : RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+        p_entry->version_delta = delta;
+        segment_store(p_entry, index, &p_adv_data->data[1], length);
+
+        vh_order_update(timestamp);
+    }
+    else if (delta < 0)
+    {
+        handle_storage_rx_inconsistent(p_adv_data->handle, timestamp);
+        vh_order_update(timestamp);
+    }
+    else if (p_entry->segment_mask & (1 << index))
+    {
+        handle_storage_rx_consistent(p_adv_data->handle, timestamp);
+    }
+    else
+    {
+        if (p_entry->segment_count == 0)
+        {
+            /* we know the version, but haven't received any segments
+               (e.g. after a restart) */
+            p_entry->segment_count = last + 1;
+            p_entry->event_type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+            p_entry->version_delta = 0;
+        }
+
+        if (p_entry->segment_count == last + 1)
+        {
+            segment_store(p_entry, index, &p_adv_data->data[1], length);
+        }
+    }
+
+    if (!p_entry->complete &&
+        p_entry->segment_count > 0 &&
+        p_entry->segment_mask == full_mask(p_entry->segment_count))
+    {
+        p_entry->complete = true;
+
+        rbc_mesh_event_t evt;
+        evt.type = p_entry->event_type;
+        evt.params.rx.version_delta = p_entry->version_delta;
+        evt.params.rx.version = p_adv_data->version;
+        evt.params.rx.source = RBC_MESH_EVENT_SOURCE_MESH;
+        evt.params.rx.ble_adv_addr.addr_type = p_packet->header.addr_type;
+        memcpy(evt.params.rx.ble_adv_addr.addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+        evt.params.rx.rssi = -((int8_t) rssi);
+        evt.params.rx.p_data = p_entry->data; /* not a packet, won't be reference counted */
+        evt.params.rx.data_len = p_entry->length;
+        evt.params.rx.value_handle = p_entry->handle;
+        evt.params.rx.timestamp_us = timestamp;
+        rbc_mesh_event_push(&evt);
+    }
+
+    mesh_packet_ref_count_dec(info.p_packet);
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_FOUND;
+#endif
+}
+
+uint32_t mesh_segment_tx(mesh_packet_t* p_packet, const tc_tx_config_t* p_tx_config)
+{
+#if (RBC_MESH_SEGMENTED_VALUE_ENTRIES > 0)
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    segment_entry_t* p_entry = entry_get(p_adv_data->handle);
+    if (p_entry == NULL || p_entry->segment_mask == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < p_entry->segment_count && sent < RBC_MESH_SEGMENTS_PER_TX; ++i)
+    {
+        uint8_t index = p_entry->tx_segment;
+        if (++p_entry->tx_segment >= p_entry->segment_count)
+        {
+            p_entry->tx_segment = 0;
+        }
+
+        if (!(p_entry->segment_mask & (1 << index)))
+        {
+            continue; /* haven't received this one */
+        }
+
+        mesh_packet_t* p_segment_packet = NULL;
+        if (!mesh_packet_acquire(&p_segment_packet))
+        {
+            break;
+        }
+        uint32_t error_code = segment_build(p_segment_packet, p_entry, index, p_adv_data->version);
+        if (error_code == NRF_SUCCESS)
+        {
+            error_code = tc_tx(p_segment_packet, p_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_segment_packet);
+
+        if (error_code != NRF_SUCCESS)
+        {
+            break;
+        }
+        sent++;
+    }
+
+    return (sent > 0) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+#else
+    return NRF_ERROR_NOT_FOUND;
+#endif
+}
@@ -0,0 +1,320 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_series.h"
+
+#ifdef RBC_MESH_TIME_SERIES
+
+#include "version_handler.h"
+#include "event_handler.h"
+#include "mesh_segment.h"
+#include "mesh_gatt.h"
+#include "nrf_error.h"
+
+#ifdef RBC_MESH_VALUE_GROUPS
+#include "mesh_group.h"
+#endif
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define VARINT_MAX_LEN      (5) /**< Longest LEB128 encoding of a 32 bit number. */
+#define SAMPLE_MAX_LEN      (3 * VARINT_MAX_LEN) /**< Longest encoding of a sample, the first in a batch. */
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t batch_count;
+    uint8_t count;                  /**< Samples in the pending batch. */
+    uint8_t length;                 /**< Encoded length of the pending batch. */
+    uint32_t first_index;           /**< Index of the first sample in the pending batch. */
+    uint32_t prev_timestamp_ms;
+    int32_t prev_value;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} series_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static series_t     m_series[RBC_MESH_SERIES_MAX];
+static uint8_t      m_series_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static series_t* series_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_series_count; ++i)
+    {
+        if (m_series[i].handle == handle)
+        {
+            return &m_series[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t varint_encode(uint32_t number, uint8_t* p_out)
+{
+    uint8_t length = 0;
+    while (number >= 0x80)
+    {
+        p_out[length++] = (uint8_t) (number | 0x80);
+        number >>= 7;
+    }
+    p_out[length++] = (uint8_t) number;
+    return length;
+}
+
+static uint32_t varint_decode(const uint8_t* p_data, uint16_t length, uint16_t* p_offset, uint32_t* p_number)
+{
+    uint32_t number = 0;
+    for (uint8_t i = 0; i < VARINT_MAX_LEN; ++i)
+    {
+        if (*p_offset >= length)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        uint8_t byte = p_data[(*p_offset)++];
+        number |= (uint32_t) (byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+        {
+            *p_number = number;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_INVALID_DATA;
+}
+
+/** Map signed numbers to unsigned ones with the small magnitudes first, so
+  small negative deltas get short varints too. */
+static uint32_t zigzag_encode(int32_t number)
+{
+    return ((uint32_t) number << 1) ^ (uint32_t) (number >> 31);
+}
+
+static int32_t zigzag_decode(uint32_t number)
+{
+    return (int32_t) ((number >> 1) ^ (0 - (number & 1)));
+}
+
+/** Encode a sample as it would follow the pending batch. */
+static uint8_t sample_encode(const series_t* p_series, uint32_t timestamp_ms, int32_t value, uint8_t* p_out)
+{
+    uint8_t length = 0;
+    if (p_series->count == 0)
+    {
+        length += varint_encode(p_series->first_index, &p_out[length]);
+        length += varint_encode(timestamp_ms, &p_out[length]);
+        length += varint_encode(zigzag_encode(value), &p_out[length]);
+    }
+    else
+    {
+        length += varint_encode(timestamp_ms - p_series->prev_timestamp_ms, &p_out[length]);
+        length += varint_encode(zigzag_encode((int32_t) ((uint32_t) value - (uint32_t) p_series->prev_value)), &p_out[length]);
+    }
+    return length;
+}
+
+static uint32_t series_publish(series_t* p_series)
+{
+    if (p_series->count == 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    uint16_t length = p_series->length;
+    uint32_t error_code = vh_local_update(p_series->handle, p_series->data, length);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    /* no critical errors if this call fails, ignore return */
+    mesh_gatt_value_set(p_series->handle, p_series->data, length);
+
+    p_series->first_index += p_series->count;
+    p_series->count = 0;
+    p_series->length = 0;
+    return NRF_SUCCESS;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t mesh_series_enable(rbc_mesh_value_handle_t handle, uint8_t batch_count)
+{
+    if (handle > RBC_MESH_APP_MAX_HANDLE ||
+        mesh_segment_is_segmented(handle) ||
+        series_get(handle) != NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_group(handle) || mesh_group_is_component(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+    if (m_series_count >= RBC_MESH_SERIES_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    series_t* p_series = &m_series[m_series_count];
+    memset(p_series, 0, sizeof(series_t));
+    p_series->handle = handle;
+    p_series->batch_count = batch_count;
+    event_handler_critical_section_begin();
+    m_series_count++;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+bool mesh_series_is_series(rbc_mesh_value_handle_t handle)
+{
+    return (series_get(handle) != NULL);
+}
+
+uint32_t mesh_series_sample_add(rbc_mesh_value_handle_t handle, uint32_t timestamp_ms, int32_t value)
+{
+    series_t* p_series = series_get(handle);
+    if (p_series == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint32_t error_code;
+    /* a full batch is left over when its publish failed */
+    if (p_series->batch_count != 0 && p_series->count >= p_series->batch_count)
+    {
+        error_code = series_publish(p_series);
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+    }
+
+    uint8_t sample[SAMPLE_MAX_LEN];
+    uint8_t length = sample_encode(p_series, timestamp_ms, value, sample);
+    if (p_series->length + length > RBC_MESH_VALUE_MAX_LEN)
+    {
+        error_code = series_publish(p_series);
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+        /* starts a new batch, with a header */
+        length = sample_encode(p_series, timestamp_ms, value, sample);
+        if (length > RBC_MESH_VALUE_MAX_LEN)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+    }
+
+    memcpy(&p_series->data[p_series->length], sample, length);
+    p_series->length += length;
+    p_series->count++;
+    p_series->prev_timestamp_ms = timestamp_ms;
+    p_series->prev_value = value;
+
+    if (p_series->count == p_series->batch_count)
+    {
+        /* retried with the next sample or flush if it fails */
+        (void) series_publish(p_series);
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t mesh_series_flush(rbc_mesh_value_handle_t handle)
+{
+    series_t* p_series = series_get(handle);
+    if (p_series == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    return series_publish(p_series);
+}
+
+uint32_t mesh_series_unpack(const uint8_t* p_data,
+        uint16_t length,
+        uint32_t* p_first_index,
+        rbc_mesh_series_sample_t* p_samples,
+        uint8_t* p_count)
+{
+    if (p_data == NULL || p_first_index == NULL || p_samples == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    uint16_t offset = 0;
+    uint32_t timestamp_ms;
+    uint32_t value;
+    if (varint_decode(p_data, length, &offset, p_first_index) != NRF_SUCCESS ||
+        varint_decode(p_data, length, &offset, &timestamp_ms) != NRF_SUCCESS ||
+        varint_decode(p_data, length, &offset, &value) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    value = (uint32_t) zigzag_decode(value);
+
+    uint8_t count = 0;
+    while (true)
+    {
+        if (count >= *p_count)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        p_samples[count].timestamp_ms = timestamp_ms;
+        p_samples[count].value = (int32_t) value;
+        count++;
+
+        if (offset == length)
+        {
+            break;
+        }
+        uint32_t timestamp_delta;
+        uint32_t value_delta;
+        if (varint_decode(p_data, length, &offset, &timestamp_delta) != NRF_SUCCESS ||
+            varint_decode(p_data, length, &offset, &value_delta) != NRF_SUCCESS)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        timestamp_ms += timestamp_delta;
+        value += (uint32_t) zigzag_decode(value_delta);
+    }
+    *p_count = count;
+    return NRF_SUCCESS;
+}
+
+#endif /* RBC_MESH_TIME_SERIES */
@@ -0,0 +1,203 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "mesh_shadow.h"
+
+#ifdef RBC_MESH_VALUE_SHADOW
+
+#include "version_handler.h"
+#include "event_handler.h"
+#include "rbc_mesh_common.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define SHADOW_LENGTH_NONE      (0xFF)
+#define SHADOW_READ_ATTEMPTS    (3)
+
+/* The writer may change the sequence number at any time, must force a fresh
+   read. */
+#define SHADOW_SEQ_READ(seq)    (*((volatile uint16_t*) &(seq)))
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint16_t seq;                           /**< Odd while the entry is being written. */
+    uint8_t length;                         /**< Length of the value, or SHADOW_LENGTH_NONE. */
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} shadow_entry_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static shadow_entry_t   m_entries[RBC_MESH_VALUE_SHADOW_ENTRIES];
+static uint8_t          m_entry_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static shadow_entry_t* entry_get(rbc_mesh_value_handle_t handle)
+{
+    /* entries are only ever added, and the count is raised once the new
+       entry is in place */
+    const uint32_t count = *((volatile uint8_t*) &m_entry_count);
+    __DMB();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (m_entries[i].handle == handle)
+        {
+            return &m_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void entry_write(shadow_entry_t* p_entry, const uint8_t* p_data, uint8_t length)
+{
+    SHADOW_SEQ_READ(p_entry->seq) = p_entry->seq + 1;
+    __DMB();
+    p_entry->length = length;
+    if (length != SHADOW_LENGTH_NONE)
+    {
+        memcpy(p_entry->data, p_data, length);
+    }
+    __DMB();
+    SHADOW_SEQ_READ(p_entry->seq) = p_entry->seq + 1;
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_shadow_init(void)
+{
+    m_entry_count = 0;
+}
+
+uint32_t mesh_shadow_add(rbc_mesh_value_handle_t handle)
+{
+    if (entry_get(handle) != NULL)
+    {
+        return NRF_SUCCESS;
+    }
+    if (m_entry_count >= RBC_MESH_VALUE_SHADOW_ENTRIES)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    /* no new value may come in between the read and the count update */
+    event_handler_critical_section_begin();
+    shadow_entry_t* p_entry = &m_entries[m_entry_count];
+    p_entry->handle = handle;
+    uint16_t length = sizeof(p_entry->data);
+    if (vh_value_get(handle, p_entry->data, &length) == NRF_SUCCESS)
+    {
+        p_entry->length = length;
+    }
+    else
+    {
+        p_entry->length = SHADOW_LENGTH_NONE;
+    }
+    __DMB();
+    m_entry_count++;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+
+void mesh_shadow_write(rbc_mesh_value_handle_t handle, const uint8_t* p_data, uint8_t length)
+{
+    shadow_entry_t* p_entry = entry_get(handle);
+    if (p_entry == NULL)
+    {
+        return;
+    }
+    if (length > RBC_MESH_VALUE_MAX_LEN)
+    {
+        length = SHADOW_LENGTH_NONE;
+    }
+    entry_write(p_entry, p_data, length);
+}
+
+void mesh_shadow_invalidate(rbc_mesh_value_handle_t handle)
+{
+    shadow_entry_t* p_entry = entry_get(handle);
+    if (p_entry != NULL)
+    {
+        entry_write(p_entry, NULL, SHADOW_LENGTH_NONE);
+    }
+}
+
+uint32_t mesh_shadow_read(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* p_length)
+{
+    const shadow_entry_t* p_entry = entry_get(handle);
+    if (p_entry == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    for (uint32_t attempt = 0; attempt < SHADOW_READ_ATTEMPTS; ++attempt)
+    {
+        const uint16_t seq = SHADOW_SEQ_READ(p_entry->seq);
+        if (seq & 0x01)
+        {
+            /* we interrupted the writer, it won't finish before we return */
+            return NRF_ERROR_BUSY;
+        }
+        __DMB();
+        const uint8_t length = p_entry->length;
+        if (length != SHADOW_LENGTH_NONE && length <= *p_length)
+        {
+            memcpy(data, p_entry->data, length);
+        }
+        __DMB();
+        if (SHADOW_SEQ_READ(p_entry->seq) != seq)
+        {
+            continue;
+        }
+
+        if (length == SHADOW_LENGTH_NONE)
+        {
+            return NRF_ERROR_NOT_FOUND;
+        }
+        if (length > *p_length)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        *p_length = length;
+        return NRF_SUCCESS;
+    }
+    return NRF_ERROR_BUSY;
+}
+
+#endif /* RBC_MESH_VALUE_SHADOW */
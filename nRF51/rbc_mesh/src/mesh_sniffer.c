@@ -0,0 +1,176 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_sniffer.h"
+
+#ifdef RBC_MESH_SNIFFER
+
+#include "rbc_mesh.h"
+#include "mesh_packet.h"
+#include "serial_handler.h"
+#include "serial_evt.h"
+#include "event_handler.h"
+#include "fifo.h"
+#include <string.h>
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+/** A captured packet, waiting for the serial queue. */
+typedef struct
+{
+    uint32_t timestamp;
+    uint8_t rssi;
+    uint8_t flags;
+    uint8_t channel;
+    uint8_t lost;
+    uint8_t pdu_len;
+    uint8_t pdu[SERIAL_EVT_SNIFFER_PDU_MAX_LEN];
+} capture_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static volatile bool    m_enabled;
+static volatile bool    m_flush_pending;
+static fifo_t           m_capture_fifo; /**< SPSC, radio callback -> event handler */
+static capture_t        m_capture_buffer[RBC_MESH_SNIFFER_QUEUE_LENGTH];
+static uint8_t          m_lost; /**< Packets lost since the last capture, only touched by the producer. */
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static void flush_cb(void* p_context)
+{
+    mesh_sniffer_flush();
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_sniffer_enable(bool enable)
+{
+    if (enable && !m_enabled)
+    {
+        m_capture_fifo.array_len = RBC_MESH_SNIFFER_QUEUE_LENGTH;
+        m_capture_fifo.elem_array = m_capture_buffer;
+        m_capture_fifo.elem_size = sizeof(capture_t);
+        m_capture_fifo.memcpy_fptr = NULL;
+        fifo_init(&m_capture_fifo);
+        m_lost = 0;
+        m_flush_pending = false;
+    }
+    m_enabled = enable;
+}
+
+bool mesh_sniffer_is_enabled(void)
+{
+    return m_enabled;
+}
+
+void mesh_sniffer_rx(const uint8_t* p_packet, bool crc_ok, uint8_t rssi, uint32_t timestamp, uint8_t channel)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    capture_t* p_capture;
+    if (fifo_reserve(&m_capture_fifo, (void**) &p_capture) != NRF_SUCCESS)
+    {
+        if (m_lost < UINT8_MAX)
+        {
+            m_lost++;
+        }
+        return;
+    }
+
+    const ble_packet_header_t* p_header = (const ble_packet_header_t*) p_packet;
+    uint8_t length = p_header->length;
+    if (length > SERIAL_EVT_SNIFFER_PDU_MAX_LEN - 2)
+    {
+        /* broken packets, or long packets that don't fit the event, keep
+           what fits */
+        length = SERIAL_EVT_SNIFFER_PDU_MAX_LEN - 2;
+    }
+
+    /* The on-air PDU header is the S0 and length bytes, the radio puts the
+       S1 padding between the header and the address. */
+    p_capture->pdu[0] = p_packet[0];
+    p_capture->pdu[1] = p_packet[1];
+    memcpy(&p_capture->pdu[2], ((const mesh_packet_t*) p_packet)->addr, length);
+    p_capture->pdu_len = 2 + length;
+    p_capture->timestamp = timestamp;
+    p_capture->rssi = rssi;
+    p_capture->flags = (crc_ok ? SERIAL_EVT_SNIFFER_FLAG_CRC_OK : 0);
+    p_capture->channel = channel;
+    p_capture->lost = m_lost;
+    m_lost = 0;
+    fifo_commit(&m_capture_fifo);
+
+    if (!m_flush_pending)
+    {
+        async_event_t evt;
+        evt.type = EVENT_TYPE_GENERIC;
+        evt.callback.generic.cb = flush_cb;
+        evt.callback.generic.p_context = NULL;
+        m_flush_pending = (event_handler_push(&evt) == NRF_SUCCESS);
+    }
+}
+
+void mesh_sniffer_flush(void)
+{
+    m_flush_pending = false;
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    serial_evt_t serial_evt;
+    capture_t* p_capture;
+    while (fifo_peek_ref(&m_capture_fifo, (void**) &p_capture) == NRF_SUCCESS)
+    {
+        serial_evt.opcode = SERIAL_EVT_OPCODE_EVENT_SNIFFER;
+        serial_evt.length = 1 + SERIAL_EVT_SNIFFER_OVERHEAD + p_capture->pdu_len;
+        serial_evt.params.event_sniffer.timestamp = p_capture->timestamp;
+        serial_evt.params.event_sniffer.rssi = -((int8_t) p_capture->rssi);
+        serial_evt.params.event_sniffer.flags = p_capture->flags;
+        serial_evt.params.event_sniffer.channel = p_capture->channel;
+        serial_evt.params.event_sniffer.lost = p_capture->lost;
+        memcpy(serial_evt.params.event_sniffer.pdu, p_capture->pdu, p_capture->pdu_len);
+        if (!serial_handler_event_send(&serial_evt))
+        {
+            /* picked up again in mesh_aci_event_flush() */
+            return;
+        }
+        fifo_release(&m_capture_fifo);
+    }
+}
+
+#endif /* RBC_MESH_SNIFFER */
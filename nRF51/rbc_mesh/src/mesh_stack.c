@@ -0,0 +1,83 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+#include "mesh_stack.h"
+
+#ifdef RBC_MESH_STACK_WATERMARK
+
+#include "nrf.h"
+
+#if defined(__CC_ARM)
+extern uint32_t STACK$$Base;
+extern uint32_t STACK$$Limit;
+#define STACK_LIMIT     (&STACK$$Base)
+#define STACK_TOP       (&STACK$$Limit)
+#elif defined(__GNUC__)
+extern uint32_t __StackLimit;
+extern uint32_t __StackTop;
+#define STACK_LIMIT     (&__StackLimit)
+#define STACK_TOP       (&__StackTop)
+#else
+#error "Unsupported toolchain"
+#endif
+
+/** Fill pattern of the unused stack. */
+#define STACK_PAINT     (0xA5A5A5A5)
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+void mesh_stack_paint(void)
+{
+    /* Everything below the stack pointer is free. Interrupts that come in
+       while painting are done with their part of it when they return. */
+    uint32_t* p_sp = (uint32_t*) __get_MSP();
+    for (uint32_t* p_word = STACK_LIMIT; p_word < p_sp; ++p_word)
+    {
+        *p_word = STACK_PAINT;
+    }
+}
+
+uint32_t mesh_stack_size_get(void)
+{
+    return (uint32_t) STACK_TOP - (uint32_t) STACK_LIMIT;
+}
+
+uint32_t mesh_stack_used_get(void)
+{
+    const uint32_t* p_word = STACK_LIMIT;
+    while (p_word < STACK_TOP && *p_word == STACK_PAINT)
+    {
+        p_word++;
+    }
+    return (uint32_t) STACK_TOP - (uint32_t) p_word;
+}
+
+#endif /* RBC_MESH_STACK_WATERMARK */
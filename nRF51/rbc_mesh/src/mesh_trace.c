@@ -0,0 +1,102 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+#include "mesh_trace.h"
+
+#ifdef RBC_MESH_TRACE
+
+#include "rbc_mesh.h"
+#include "timer.h"
+#include "toolchain.h"
+#include "SEGGER_RTT.h"
+#include <stdbool.h>
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static uint8_t m_trace_buffer[RBC_MESH_TRACE_BUFFER_SIZE];
+static uint16_t m_dropped_count;
+static bool m_is_initialized;
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+static bool record_write(uint32_t timestamp, uint8_t point, uint8_t type, uint16_t data)
+{
+    mesh_trace_record_t record;
+    record.timestamp = timestamp;
+    record.point = point;
+    record.type = type;
+    record.data = data;
+    return (SEGGER_RTT_WriteSkipNoLock(RBC_MESH_TRACE_RTT_CHANNEL, &record, sizeof(record)) != 0);
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+void mesh_trace_init(void)
+{
+    m_dropped_count = 0;
+    SEGGER_RTT_ConfigUpBuffer(RBC_MESH_TRACE_RTT_CHANNEL, "MeshTrace",
+            m_trace_buffer, RBC_MESH_TRACE_BUFFER_SIZE,
+            SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    m_is_initialized = true;
+}
+
+void mesh_trace_event(mesh_trace_point_t point, mesh_trace_type_t type, uint16_t data)
+{
+    if (!m_is_initialized)
+    {
+        return;
+    }
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    uint32_t timestamp = timer_now();
+
+    /* report dropped records before any new ones, so the host knows where
+       the gap is */
+    if (m_dropped_count > 0 &&
+        record_write(timestamp, MESH_TRACE_POINT_OVERFLOW, MESH_TRACE_TYPE_MARK, m_dropped_count))
+    {
+        m_dropped_count = 0;
+    }
+
+    if (m_dropped_count > 0 ||
+        !record_write(timestamp, (uint8_t) point, (uint8_t) type, data))
+    {
+        if (m_dropped_count < 0xFFFF)
+        {
+            m_dropped_count++;
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+#endif /* RBC_MESH_TRACE */
@@ -0,0 +1,142 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_trickle_tune.h"
+
+#ifdef RBC_MESH_TRICKLE_AUTO_TUNE
+
+#include "rbc_mesh.h"
+#include "mesh_neighbor.h"
+#include "trickle.h"
+#include "event_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "app_error.h"
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define TUNE_INTERVAL_US            (RBC_MESH_TRICKLE_AUTO_TUNE_INTERVAL_MS * 1000)
+/** Neighbors that haven't been heard for this long don't count. */
+#define NEIGHBOR_TIMEOUT_US         (3 * TUNE_INTERVAL_US)
+
+#define SPARSE                      (RBC_MESH_TRICKLE_AUTO_TUNE_SPARSE_NEIGHBORS)
+#define DENSE                       (RBC_MESH_TRICKLE_AUTO_TUNE_DENSE_NEIGHBORS)
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static timer_event_t    m_timer;
+static bool             m_enabled;
+static int8_t           m_i_max_shift;
+static uint32_t         m_rx_consistent_prev;
+static uint32_t         m_rx_inconsistent_prev;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint8_t k_get(uint8_t neighbors)
+{
+    if (neighbors <= SPARSE)
+    {
+        return RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX;
+    }
+    if (neighbors >= DENSE)
+    {
+        return 1;
+    }
+    /* linear between the two, rounded */
+    uint32_t span = DENSE - SPARSE;
+    uint32_t drop = ((RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX - 1) * (neighbors - SPARSE) + span / 2) / span;
+    return RBC_MESH_TRICKLE_AUTO_TUNE_K_MAX - drop;
+}
+
+static void tune_timeout(timestamp_t timestamp, void* p_context)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    uint8_t neighbors = mesh_neighbor_count_get(timestamp, NEIGHBOR_TIMEOUT_US);
+
+    uint32_t rx_consistent;
+    uint32_t rx_inconsistent;
+    trickle_rx_count_get(&rx_consistent, &rx_inconsistent);
+    uint32_t consistent = rx_consistent - m_rx_consistent_prev;
+    uint32_t inconsistent = rx_inconsistent - m_rx_inconsistent_prev;
+    uint32_t total = consistent + inconsistent;
+    m_rx_consistent_prev = rx_consistent;
+    m_rx_inconsistent_prev = rx_inconsistent;
+
+    if (neighbors <= SPARSE || inconsistent * 2 > total)
+    {
+        /* few nodes to repeat missed updates, or values are changing */
+        if (m_i_max_shift > -RBC_MESH_TRICKLE_AUTO_TUNE_I_MAX_SHIFT)
+        {
+            m_i_max_shift--;
+        }
+    }
+    else if (neighbors >= DENSE && total > 0 && inconsistent * 8 <= total)
+    {
+        /* at least 7/8 consistent, the neighborhood has converged */
+        if (m_i_max_shift < RBC_MESH_TRICKLE_AUTO_TUNE_I_MAX_SHIFT)
+        {
+            m_i_max_shift++;
+        }
+    }
+
+    trickle_tune_set(true, k_get(neighbors), m_i_max_shift);
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_trickle_tune_set(bool enable)
+{
+    event_handler_critical_section_begin();
+    if (enable && !m_enabled)
+    {
+        m_enabled = true;
+        m_i_max_shift = 0;
+        trickle_rx_count_get(&m_rx_consistent_prev, &m_rx_inconsistent_prev);
+        m_timer.cb = tune_timeout;
+        m_timer.interval = TUNE_INTERVAL_US;
+        APP_ERROR_CHECK(timer_sch_reschedule(&m_timer, timer_now() + TUNE_INTERVAL_US));
+    }
+    else if (!enable && m_enabled)
+    {
+        m_enabled = false;
+        (void) timer_sch_abort(&m_timer);
+        trickle_tune_set(false, 0, 0);
+    }
+    event_handler_critical_section_end();
+}
+
+#endif /* RBC_MESH_TRICKLE_AUTO_TUNE */
@@ -0,0 +1,217 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "mesh_tx_power.h"
+
+#ifdef RBC_MESH_TX_POWER_CONTROL
+
+#include "mesh_neighbor.h"
+#include "version_handler.h"
+#include "event_handler.h"
+#include "timer_scheduler.h"
+#include "timer.h"
+#include "app_error.h"
+#include "nrf_error.h"
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define CONTROL_INTERVAL_US         (RBC_MESH_TX_POWER_CONTROL_INTERVAL_MS * 1000)
+/** Neighbors that haven't been heard for this long don't count. */
+#define NEIGHBOR_TIMEOUT_US         (3 * CONTROL_INTERVAL_US)
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_txpower_t tx_power;
+    int8_t dbm;
+} tx_power_level_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+/** The TX power levels of the radio, from weakest to strongest. */
+static const tx_power_level_t m_levels[] =
+{
+    {RBC_MESH_TXPOWER_Neg30dBm, -30},
+    {RBC_MESH_TXPOWER_Neg20dBm, -20},
+    {RBC_MESH_TXPOWER_Neg16dBm, -16},
+    {RBC_MESH_TXPOWER_Neg12dBm, -12},
+    {RBC_MESH_TXPOWER_Neg8dBm,   -8},
+    {RBC_MESH_TXPOWER_Neg4dBm,   -4},
+    {RBC_MESH_TXPOWER_0dBm,       0},
+    {RBC_MESH_TXPOWER_Pos4dBm,    4},
+};
+
+static timer_event_t    m_timer;
+static bool             m_enabled;
+static uint8_t          m_level;        /**< Current power level. */
+static uint8_t          m_level_max;    /**< Highest power level the control may pick. */
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint8_t level_get(rbc_mesh_txpower_t tx_power)
+{
+    for (uint32_t i = 0; i < sizeof(m_levels) / sizeof(m_levels[0]); ++i)
+    {
+        if (m_levels[i].tx_power == tx_power)
+        {
+            return i;
+        }
+    }
+    /* not a radio level, the radio treats it as 0dBm */
+    return level_get(RBC_MESH_TXPOWER_0dBm);
+}
+
+/** Get the RSSI of the weakest of the strongest neighbors that count towards
+ * the redundancy. */
+static bool kth_strongest_rssi_get(timestamp_t time_now, int8_t* p_rssi)
+{
+    int8_t strongest[RBC_MESH_TX_POWER_CONTROL_NEIGHBORS];
+    uint32_t count = 0;
+    rbc_mesh_neighbor_t neighbor;
+
+    for (uint32_t i = 0; mesh_neighbor_get(i, &neighbor) == NRF_SUCCESS; ++i)
+    {
+        if (time_now - neighbor.last_rx_us > NEIGHBOR_TIMEOUT_US)
+        {
+            continue;
+        }
+        /* insertion sort, strongest first */
+        uint32_t pos = (count < RBC_MESH_TX_POWER_CONTROL_NEIGHBORS ? count++ : count);
+        while (pos > 0 && strongest[pos - 1] < neighbor.rssi)
+        {
+            if (pos < RBC_MESH_TX_POWER_CONTROL_NEIGHBORS)
+            {
+                strongest[pos] = strongest[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < RBC_MESH_TX_POWER_CONTROL_NEIGHBORS)
+        {
+            strongest[pos] = neighbor.rssi;
+        }
+    }
+
+    if (count < RBC_MESH_TX_POWER_CONTROL_NEIGHBORS)
+    {
+        return false;
+    }
+    *p_rssi = strongest[RBC_MESH_TX_POWER_CONTROL_NEIGHBORS - 1];
+    return true;
+}
+
+static void control_timeout(timestamp_t timestamp, void* p_context)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    uint8_t level = m_level;
+    int8_t rssi;
+    if (!kth_strongest_rssi_get(timestamp, &rssi))
+    {
+        /* too few neighbors in range */
+        if (level < m_level_max)
+        {
+            level++;
+        }
+    }
+    else
+    {
+        /* the neighbor is assumed to transmit at the highest power */
+        int32_t path_loss = m_levels[m_level_max].dbm - rssi;
+        /* raise right away, but lower one step at a time */
+        while (level < m_level_max &&
+               m_levels[level].dbm - path_loss < RBC_MESH_TX_POWER_CONTROL_RSSI_TARGET)
+        {
+            level++;
+        }
+        if (level == m_level && level > 0 &&
+            m_levels[level - 1].dbm - path_loss >= RBC_MESH_TX_POWER_CONTROL_RSSI_TARGET + RBC_MESH_TX_POWER_CONTROL_MARGIN_DB)
+        {
+            level--;
+        }
+    }
+
+    if (level != m_level)
+    {
+        m_level = level;
+        vh_tx_power_set(m_levels[m_level].tx_power);
+    }
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void mesh_tx_power_control_set(bool enable)
+{
+    event_handler_critical_section_begin();
+    if (enable && !m_enabled)
+    {
+        m_level_max = level_get(vh_tx_power_get());
+        m_level = m_level_max;
+        m_enabled = true;
+        m_timer.cb = control_timeout;
+        m_timer.interval = CONTROL_INTERVAL_US;
+        APP_ERROR_CHECK(timer_sch_reschedule(&m_timer, timer_now() + CONTROL_INTERVAL_US));
+    }
+    else if (!enable && m_enabled)
+    {
+        m_enabled = false;
+        (void) timer_sch_abort(&m_timer);
+        vh_tx_power_set(m_levels[m_level_max].tx_power);
+    }
+    event_handler_critical_section_end();
+}
+
+void mesh_tx_power_max_set(rbc_mesh_txpower_t tx_power)
+{
+    event_handler_critical_section_begin();
+    if (m_enabled)
+    {
+        m_level_max = level_get(tx_power);
+        if (m_level > m_level_max)
+        {
+            m_level = m_level_max;
+            vh_tx_power_set(tx_power);
+        }
+    }
+    else
+    {
+        vh_tx_power_set(tx_power);
+    }
+    event_handler_critical_section_end();
+}
+
+#endif /* RBC_MESH_TX_POWER_CONTROL */
@@ -30,6 +30,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "radio_control.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
+#include "isr_stats.h"
 #include "timeslot.h"
 #include "trickle.h"
 #include "fifo.h"
@@ -39,6 +41,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "toolchain.h"
 #include "rbc_mesh.h"
 #include "mesh_packet.h"
+#include "timer.h"
+#include "rand.h"
+#ifdef RBC_MESH_ENCRYPTION
+#include "mesh_crypt.h"
+#endif
 
 #include <stdbool.h>
 #include <string.h>
@@ -48,12 +55,64 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define LIGHTWEIGHT_RADIO               (1)
 
-#define RADIO_RX_TIMEOUT                (150 + 80)
+/** Longest PDU payload, the advertiser address and the advertisement data. */
+#define RADIO_PAYLOAD_MAX_LEN           (MESH_PACKET_BLE_OVERHEAD + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
+/** Time on air of a full length packet, from the preamble to the end of the
+    CRC. The 2 Mbit mode has a two byte preamble. */
+#define RADIO_PACKET_AIRTIME_1MBIT_US   ((1 + 4 + 2 + RADIO_PAYLOAD_MAX_LEN + 3) * 8)
+#define RADIO_PACKET_AIRTIME_2MBIT_US   ((2 + 4 + 2 + RADIO_PAYLOAD_MAX_LEN + 3) * 4)
+/** Radio ramp-up and processing around each packet, same in both modes. */
+#define RADIO_EVENT_OVERHEAD_US         (124)
+
+/* Not in the register headers of the older nRF52 SDKs. */
+#if defined(NRF52) && !defined(RADIO_MODE_MODE_Ble_2Mbit)
+#define RADIO_MODE_MODE_Ble_2Mbit       (4UL)
+#endif
+#if defined(NRF52) && !defined(RADIO_PCNF0_PLEN_Pos)
+#define RADIO_PCNF0_PLEN_Pos            (24UL)
+#define RADIO_PCNF0_PLEN_Msk            (0x1UL << RADIO_PCNF0_PLEN_Pos)
+#define RADIO_PCNF0_PLEN_16bit          (1UL)
+#endif
 
 #define RADIO_EVENT(evt)                (NRF_RADIO->evt == 1)
 
 #define PPI_CH_STOP_RX_ABORT            (TIMER_PPI_CH_START + 4)
 
+#ifndef BOOTLOADER
+/** Timestamp received packets at their address event. The bootloader runs
+    the radio without the timer module. */
+#define RADIO_RX_TIMESTAMP
+#endif
+
+#if defined(RBC_MESH_RADIO_TIME_STATS) && !defined(BOOTLOADER)
+/** Account the radio time by state, from the RXEN and TXEN tasks to the END
+    event, see rbc_mesh_radio_stats_t. */
+#define RADIO_TIME_STATS
+#endif
+
+#if defined(RBC_MESH_RX_DOUBLE_BUFFER) && !defined(BOOTLOADER)
+/** Restart the scan in a spare packet right after each reception, through
+    the DISABLED->RXEN short. */
+#define RADIO_RX_CHAIN
+#endif
+
+#if defined(RBC_MESH_RADIO_PRIORITY) && !defined(BOOTLOADER)
+/** Order the radio queue by event class, see radio_order(). The bootloader
+    leaves the priority of its events unset. */
+#define RADIO_PRIORITY
+#endif
+
+/** Time from the RXEN or TXEN task to the READY event. The nRF52 uses the
+    fast ramp-up. */
+#ifdef NRF52
+#define RADIO_RAMP_UP_US                (40)
+#else
+#define RADIO_RAMP_UP_US                (140)
+#endif
+
+/** Shortest backoff after a busy channel, enough for the radio to turn around. */
+#define RADIO_LBT_BACKOFF_MIN_US        (150)
+
 #define DEBUG_RADIO_SET_STATE(state) do {\
     DEBUG_RADIO_CLEAR_PIN(PIN_RADIO_STATE_TX);\
     DEBUG_RADIO_CLEAR_PIN(PIN_RADIO_STATE_RX);\
@@ -68,6 +127,7 @@ typedef enum
 {
     RADIO_STATE_RX,
     RADIO_STATE_TX,
+    RADIO_STATE_DISABLING,  /**< Waiting for the DISABLED event after aborting a preemptable RX. */
     RADIO_STATE_DISABLED,
     RADIO_STATE_NEVER_USED
 } radio_state_t;
@@ -85,9 +145,193 @@ static radio_idle_cb_t  m_idle_cb;
 static radio_rx_cb_t    m_rx_cb;
 static radio_tx_cb_t    m_tx_cb;
 static uint32_t         m_alt_aa = RADIO_DEFAULT_ADDRESS;
+/* The alternate address has always been sent with a zero prefix (AP1), keep
+   it that way to stay compatible with deployed nodes. AP2-AP7 belong to the
+   extra addresses of radio_aa_prefix_set(). */
+static uint32_t         m_prefix0 = ((RADIO_DEFAULT_ADDRESS >> 24) & 0x000000FF);
+static uint32_t         m_prefix1;
+static uint8_t          m_rx_addresses_extra; /**< RXADDRESSES bits of the extra addresses. */
+static bool             m_tx_chained; /**< The next TX event has been chained to the ongoing TX. */
+static radio_event_t    m_disabling_evt; /**< The aborted RX event, reported once the radio is disabled. */
+#ifdef RADIO_RX_CHAIN
+static uint8_t*         mp_rx_spare; /**< Second packet of the scan, received into once the current packet ends. */
+static bool             m_rx_chained; /**< The scan will go on in the spare packet after the ongoing RX. */
+#endif
+static uint32_t         m_tx_deferred_count;
+static radio_mode_t     m_radio_mode = RADIO_MODE_BLE_1MBIT;
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+static prng_t           m_lbt_prng;
+static bool             m_lbt_backoff; /**< A backoff timer is running for the next TX. */
+static uint8_t          m_lbt_deferrals; /**< Number of times the next TX has been deferred. */
+#endif
+#ifdef RBC_MESH_ENCRYPTION
+/* The radio reads the packet from RAM while it's on air, so a chained TX
+   needs its own buffer. */
+static uint32_t         m_tx_crypt_buf[2][(sizeof(mesh_packet_t) + 3) / 4];
+static uint8_t          m_tx_crypt_index;
+#endif
+#ifdef RADIO_TIME_STATS
+/** Accumulated radio time, in microseconds. */
+static struct
+{
+    uint64_t rx;
+    uint64_t tx;
+    uint64_t ramp_up;
+} m_radio_time;
+static timestamp_t      m_radio_on_time; /**< Time of the RXEN or TXEN task of the ongoing event. */
+static bool             m_radio_on; /**< The radio is on for an RX or TX event. */
+static bool             m_radio_on_tx;
+#endif
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+static void lbt_backoff_timeout(timestamp_t timestamp)
+{
+    m_lbt_backoff = false;
+    /* check the channel again */
+    NVIC_SetPendingIRQ(RADIO_IRQn);
+}
+
+/**
+* Check whether the channel is busy, by looking at the ongoing preemptable RX.
+* The channel can only be assessed if the RX is on the channel the TX is
+* going out on.
+*/
+static bool lbt_channel_busy(const radio_event_t* p_rx_evt, const radio_event_t* p_tx_evt)
+{
+    if (p_tx_evt->channel != p_rx_evt->channel ||
+        NRF_RADIO->STATE != RADIO_STATE_STATE_Rx)
+    {
+        return false;
+    }
+
+    if (NRF_RADIO->EVENTS_ADDRESS)
+    {
+        /* in the middle of receiving a packet */
+        return true;
+    }
+
+    NRF_RADIO->EVENTS_RSSIEND = 0;
+    NRF_RADIO->TASKS_RSSISTART = 1;
+    while (!NRF_RADIO->EVENTS_RSSIEND);
+    NRF_RADIO->EVENTS_RSSIEND = 0;
+
+    /* the sample is the magnitude of the negative dBm value */
+    return (NRF_RADIO->RSSISAMPLE < RBC_MESH_LBT_RSSI_THRESHOLD);
+}
+
+/**
+* Decide whether the preemptable RX should be kept running instead of giving
+* way to the TX behind it. The TX is retried when an incoming packet ends, or
+* after a random backoff.
+*/
+static bool lbt_tx_defer(const radio_event_t* p_rx_evt)
+{
+    if (m_lbt_backoff)
+    {
+        return true;
+    }
+
+    radio_event_t next_evt;
+    if (m_lbt_deferrals >= RBC_MESH_LBT_DEFERRALS_MAX ||
+        fifo_peek_at(&m_radio_fifo, &next_evt, 1) != NRF_SUCCESS ||
+        next_evt.event_type != RADIO_EVENT_TYPE_TX ||
+        !lbt_channel_busy(p_rx_evt, &next_evt))
+    {
+        return false;
+    }
+
+    if (!NRF_RADIO->EVENTS_ADDRESS)
+    {
+        timestamp_t backoff = RADIO_LBT_BACKOFF_MIN_US + rand_prng_get(&m_lbt_prng) % RBC_MESH_LBT_BACKOFF_MAX_US;
+        if (timer_virtual_order(TIMER_VIRTUAL_RADIO_LBT, timer_now() + backoff, lbt_backoff_timeout,
+                    (timer_attr_t) (TIMER_ATTR_SYNCHRONOUS | TIMER_ATTR_TIMESLOT_LOCAL)) != NRF_SUCCESS)
+        {
+            return false;
+        }
+        m_lbt_backoff = true;
+    }
+    m_lbt_deferrals++;
+    m_tx_deferred_count++;
+    return true;
+}
+#endif
+
+#ifdef RADIO_TIME_STATS
+static void radio_time_start(timestamp_t now, bool tx)
+{
+    m_radio_on_time = now;
+    m_radio_on_tx = tx;
+    m_radio_on = true;
+}
+
+static void radio_time_end(timestamp_t now)
+{
+    if (!m_radio_on)
+    {
+        return;
+    }
+    uint32_t on_time = TIMER_DIFF(now, m_radio_on_time);
+    uint32_t ramp_up = (on_time < RADIO_RAMP_UP_US) ? on_time : RADIO_RAMP_UP_US;
+    m_radio_time.ramp_up += ramp_up;
+    if (m_radio_on_tx)
+    {
+        m_radio_time.tx += on_time - ramp_up;
+    }
+    else
+    {
+        m_radio_time.rx += on_time - ramp_up;
+    }
+    m_radio_on = false;
+}
+#endif
+
+#ifdef RADIO_PRIORITY
+static uint8_t event_priority_get(const radio_event_t* p_evt)
+{
+    return (p_evt->event_type == RADIO_EVENT_TYPE_TX ? p_evt->priority : RADIO_PRIORITY_NORMAL);
+}
+
+/**
+* Move the event at the back of the queue ahead of the events of a lower
+* class. The ongoing event and the TX chained to it keep their place, and so
+* do the events that have been overtaken too many times already. A
+* preemptable RX is aborted by any event behind it, and may always be passed.
+*/
+static void queue_priority_insert(void)
+{
+    uint32_t first = (m_tx_chained ? 2 : 1);
+    uint32_t index = fifo_get_len(&m_radio_fifo) - 1;
+    radio_event_t* p_slot = fifo_elem_ref_at(&m_radio_fifo, index);
+    radio_event_t evt = *p_slot;
+    if (evt.event_type == RADIO_EVENT_TYPE_RX_PREEMPTABLE)
+    {
+        return;
+    }
+
+    uint8_t priority = event_priority_get(&evt);
+    evt.overtaken = 0;
+    while (index > first)
+    {
+        radio_event_t* p_prev = fifo_elem_ref_at(&m_radio_fifo, index - 1);
+        if (p_prev->event_type != RADIO_EVENT_TYPE_RX_PREEMPTABLE)
+        {
+            if (event_priority_get(p_prev) >= priority ||
+                p_prev->overtaken >= RBC_MESH_RADIO_OVERTAKE_MAX)
+            {
+                break;
+            }
+            p_prev->overtaken++;
+        }
+        *p_slot = *p_prev;
+        p_slot = p_prev;
+        --index;
+    }
+    *p_slot = evt;
+}
+#endif
+
 static void purge_preemptable(void)
 {
     uint32_t events_in_queue = fifo_get_len(&m_radio_fifo);
@@ -97,16 +341,32 @@ static void purge_preemptable(void)
         if (fifo_peek(&m_radio_fifo, &current_evt) == NRF_SUCCESS &&
             current_evt.event_type == RADIO_EVENT_TYPE_RX_PREEMPTABLE)
         {
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+            if (lbt_tx_defer(&current_evt))
+            {
+                break;
+            }
+#endif
             /* event is preemptable, stop it */
             fifo_pop(&m_radio_fifo, NULL);
-
-            radio_disable();
-            while (NRF_RADIO->STATE != RADIO_STATE_STATE_Disabled);
-            NRF_RADIO->EVENTS_END = 0;
-
-            /* propagate failed rx event */
-            m_rx_cb(current_evt.packet_ptr, false, 0xFFFFFFFF, 100);
             --events_in_queue;
+
+            if (m_radio_state == RADIO_STATE_RX)
+            {
+                /* The radio may write to the packet until it's disabled.
+                   Report the failed RX on the DISABLED event, instead of
+                   spinning on the radio state here. */
+                NRF_RADIO->EVENTS_DISABLED = 0;
+                radio_disable();
+                NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+                m_disabling_evt = current_evt;
+                m_radio_state = RADIO_STATE_DISABLING;
+            }
+            else
+            {
+                /* propagate failed rx event */
+                m_rx_cb(current_evt.packet_ptr, false, 0xFFFFFFFF, 100, 0, current_evt.channel);
+            }
         }
         else
         {
@@ -135,6 +395,116 @@ static void radio_channel_set(uint8_t ch)
 
 }
 
+/** Get the packet to put on air for the given TX event. */
+static uint32_t tx_packet_ptr_get(radio_event_t* p_evt)
+{
+#ifdef RBC_MESH_ENCRYPTION
+    mesh_packet_t* p_crypt_packet = (mesh_packet_t*) m_tx_crypt_buf[m_tx_crypt_index];
+    if (mesh_crypt_encrypt((mesh_packet_t*) p_evt->packet_ptr, p_crypt_packet))
+    {
+        m_tx_crypt_index ^= 1;
+        return (uint32_t) p_crypt_packet;
+    }
+#endif
+    return (uint32_t) p_evt->packet_ptr;
+}
+
+/**
+* Chain the next TX event in the queue to the ongoing transmission, if
+* possible. Called on the ADDRESS event of the ongoing TX, after the radio
+* has latched the current packet pointer. The radio will go straight back to
+* TX with the new packet pointer through the DISABLED->TXEN short, without
+* waiting for the CPU between the packets.
+*/
+static void tx_chain_setup(void)
+{
+    radio_event_t current_evt;
+    radio_event_t next_evt;
+    if (fifo_peek(&m_radio_fifo, &current_evt) == NRF_SUCCESS &&
+        fifo_peek_at(&m_radio_fifo, &next_evt, 1) == NRF_SUCCESS &&
+        next_evt.event_type == RADIO_EVENT_TYPE_TX &&
+        next_evt.channel == current_evt.channel &&
+        next_evt.access_address == current_evt.access_address &&
+        next_evt.tx_power == current_evt.tx_power)
+    {
+        NRF_RADIO->PACKETPTR = tx_packet_ptr_get(&next_evt);
+        NRF_RADIO->SHORTS |= RADIO_SHORTS_DISABLED_TXEN_Msk;
+        m_tx_chained = true;
+    }
+    else
+    {
+        NRF_RADIO->SHORTS &= ~RADIO_SHORTS_DISABLED_TXEN_Msk;
+        m_tx_chained = false;
+    }
+}
+
+#ifdef RADIO_RX_CHAIN
+static bool rx_spare_acquire(void)
+{
+    return (mp_rx_spare != NULL || mesh_packet_acquire_rx((mesh_packet_t**) &mp_rx_spare));
+}
+
+/**
+* Chain the scan to the ongoing RX, if nothing else is waiting for the radio.
+* Called on the ADDRESS event of the scan, after the radio has latched the
+* current packet pointer. Once the packet ends, the radio goes straight back
+* to RX in the spare packet through the DISABLED->RXEN short, without waiting
+* for the CPU to hand the received packet off.
+*/
+static void rx_chain_setup(void)
+{
+    radio_event_t current_evt;
+    if (fifo_get_len(&m_radio_fifo) == 1 &&
+        fifo_peek(&m_radio_fifo, &current_evt) == NRF_SUCCESS &&
+        current_evt.event_type == RADIO_EVENT_TYPE_RX_PREEMPTABLE &&
+        rx_spare_acquire())
+    {
+        NRF_RADIO->PACKETPTR = (uint32_t) mp_rx_spare;
+        NRF_RADIO->SHORTS |= RADIO_SHORTS_DISABLED_RXEN_Msk;
+        m_rx_chained = true;
+    }
+    else
+    {
+        NRF_RADIO->SHORTS &= ~RADIO_SHORTS_DISABLED_RXEN_Msk;
+        m_rx_chained = false;
+    }
+}
+
+/**
+* Called on the END event of a chained RX. Swaps the spare packet into the
+* scan, and gives the received one back in p_evt.
+*/
+static void rx_chain_swap(radio_event_t* p_evt)
+{
+    radio_event_t* p_scan_evt = fifo_elem_ref_at(&m_radio_fifo, 0);
+    *p_evt = *p_scan_evt;
+    p_scan_evt->packet_ptr = mp_rx_spare;
+    mp_rx_spare = NULL;
+}
+
+/**
+* Prepare the restarted scan for its next packet. Returns false if the radio
+* didn't restart.
+*/
+static bool rx_chain_restart(void)
+{
+    m_rx_chained = false;
+    while (NRF_RADIO->STATE == RADIO_STATE_STATE_RxDisable);
+    if (NRF_RADIO->STATE == RADIO_STATE_STATE_Disabled)
+    {
+        return false;
+    }
+    NRF_RADIO->EVENTS_ADDRESS = 0;
+#ifdef RADIO_RX_TIMESTAMP
+    timer_event_capture_order(&NRF_RADIO->EVENTS_ADDRESS);
+#endif
+    NRF_RADIO->INTENSET = RADIO_INTENSET_ADDRESS_Msk;
+    /* the next packet may come in right away, have the spare ready */
+    (void) rx_spare_acquire();
+    return true;
+}
+#endif
+
 static void setup_event(radio_event_t* p_evt)
 {
     NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_END_DISABLE_Msk | RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
@@ -142,31 +512,64 @@ static void setup_event(radio_event_t* p_evt)
     NRF_RADIO->PACKETPTR = (uint32_t) p_evt->packet_ptr;
     NRF_RADIO->INTENSET = RADIO_INTENSET_END_Msk;
     NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->PREFIX1	= ((m_alt_aa >> 24) & 0x000000FF);
+    NRF_RADIO->PREFIX0  = m_prefix0;
+    NRF_RADIO->PREFIX1  = m_prefix1;
     NRF_RADIO->BASE1    = ((m_alt_aa <<  8) & 0xFFFFFF00);
 
     if (p_evt->event_type == RADIO_EVENT_TYPE_TX)
     {
         DEBUG_RADIO_SET_STATE(PIN_RADIO_STATE_TX);
+        NRF_RADIO->PACKETPTR = tx_packet_ptr_get(p_evt);
         NRF_RADIO->TXADDRESS = p_evt->access_address;
         NRF_RADIO->TXPOWER  = p_evt->tx_power;
+        NRF_RADIO->EVENTS_ADDRESS = 0;
+        NRF_RADIO->INTENSET = RADIO_INTENSET_ADDRESS_Msk;
+        m_tx_chained = false;
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+        if (m_lbt_backoff)
+        {
+            (void) timer_virtual_abort(TIMER_VIRTUAL_RADIO_LBT);
+            m_lbt_backoff = false;
+        }
+        m_lbt_deferrals = 0;
+#endif
         NRF_RADIO->TASKS_TXEN = 1;
+#ifdef RADIO_TIME_STATS
+        radio_time_start(timer_now(), true);
+#endif
         m_radio_state = RADIO_STATE_TX;
         
     }
     else
     {
         DEBUG_RADIO_SET_STATE(PIN_RADIO_STATE_RX);
+        NRF_RADIO->INTENCLR = RADIO_INTENCLR_ADDRESS_Msk;
+        NRF_RADIO->EVENTS_ADDRESS = 0;
+#ifdef RADIO_RX_CHAIN
+        m_rx_chained = false;
+        if (p_evt->event_type == RADIO_EVENT_TYPE_RX_PREEMPTABLE &&
+            rx_spare_acquire())
+        {
+            /* chained on the address event */
+            NRF_RADIO->INTENSET = RADIO_INTENSET_ADDRESS_Msk;
+        }
+#endif
+#ifdef RADIO_RX_TIMESTAMP
+        timer_event_capture_order(&NRF_RADIO->EVENTS_ADDRESS);
+#endif
         if (m_alt_aa != RADIO_DEFAULT_ADDRESS)
         {
             /* only enable alt-addr if it's different */
-            NRF_RADIO->RXADDRESSES = 0x03;
+            NRF_RADIO->RXADDRESSES = 0x03 | m_rx_addresses_extra;
         }
         else
         {
-            NRF_RADIO->RXADDRESSES = 0x01;
+            NRF_RADIO->RXADDRESSES = 0x01 | m_rx_addresses_extra;
         }
         NRF_RADIO->TASKS_RXEN = 1;
+#ifdef RADIO_TIME_STATS
+        radio_time_start(timer_now(), false);
+#endif
         m_radio_state = RADIO_STATE_RX;
     }
 }
@@ -185,30 +588,58 @@ void radio_init(radio_idle_cb_t idle_cb,
 
     /* Set radio configuration parameters */
     NRF_RADIO->TXPOWER      = ((RADIO_TXPOWER_TXPOWER_0dBm << RADIO_TXPOWER_TXPOWER_Pos) & RADIO_TXPOWER_TXPOWER_Msk);
-    NRF_RADIO->MODE 	    = ((RADIO_MODE_MODE_Ble_1Mbit << RADIO_MODE_MODE_Pos) & RADIO_MODE_MODE_Msk);
+#ifdef NRF52
+    if (m_radio_mode == RADIO_MODE_BLE_2MBIT)
+    {
+        NRF_RADIO->MODE     = ((RADIO_MODE_MODE_Ble_2Mbit << RADIO_MODE_MODE_Pos) & RADIO_MODE_MODE_Msk);
+    }
+    else
+#endif
+    {
+        NRF_RADIO->MODE     = ((RADIO_MODE_MODE_Ble_1Mbit << RADIO_MODE_MODE_Pos) & RADIO_MODE_MODE_Msk);
+    }
 
     NRF_RADIO->FREQUENCY 	    = 2;					// Frequency bin 2, 2402MHz, channel 37.
     NRF_RADIO->DATAWHITEIV      = 37;					// NOTE: This value needs to correspond to the frequency being used
 
 
     /* Configure Access Address  */
-    NRF_RADIO->PREFIX0	= ((RADIO_DEFAULT_ADDRESS >> 24) & 0x000000FF);
+    NRF_RADIO->PREFIX0	= m_prefix0;
     NRF_RADIO->BASE0    = ((RADIO_DEFAULT_ADDRESS <<  8) & 0xFFFFFF00);
-    NRF_RADIO->PREFIX1	= ((m_alt_aa >> 24) & 0x000000FF);
+    NRF_RADIO->PREFIX1	= m_prefix1;
     NRF_RADIO->BASE1    = ((m_alt_aa <<  8) & 0xFFFFFF00);
     NRF_RADIO->TXADDRESS    = 0x00;			    // Use logical address 0 (prefix0 + base0) = 0x8E89BED6 when transmitting
     NRF_RADIO->RXADDRESSES  = 0x01;				// Enable reception on logical address 0 (PREFIX0 + BASE0)
 
     /* PCNF-> Packet Configuration. Now we need to configure the sizes S0, S1 and length field to match the datapacket format of the advertisement packets. */
+#ifdef RBC_MESH_LONG_PACKETS
+    /* Long packets need all 8 bits of the length byte, which leaves no S1
+       bits on air. Keep the S1 byte in RAM, to leave the packet layout as it
+       is. Legacy packets have their top length bits cleared, and look the
+       same either way. */
+    NRF_RADIO->PCNF0 =  (
+                          (((1UL) << RADIO_PCNF0_S0LEN_Pos) & RADIO_PCNF0_S0LEN_Msk)
+                        | (((8UL) << RADIO_PCNF0_LFLEN_Pos) & RADIO_PCNF0_LFLEN_Msk)
+                        | (((RADIO_PCNF0_S1INCL_Include) << RADIO_PCNF0_S1INCL_Pos) & RADIO_PCNF0_S1INCL_Msk)
+                      );
+#else
     NRF_RADIO->PCNF0 =  (
                           (((1UL) << RADIO_PCNF0_S0LEN_Pos) & RADIO_PCNF0_S0LEN_Msk)    // length of S0 field in bytes 0-1.
                         | (((2UL) << RADIO_PCNF0_S1LEN_Pos) & RADIO_PCNF0_S1LEN_Msk)    // length of S1 field in bits 0-8.
                         | (((6UL) << RADIO_PCNF0_LFLEN_Pos) & RADIO_PCNF0_LFLEN_Msk)    // length of length field in bits 0-8.
                       );
+#endif
+#ifdef NRF52
+    if (m_radio_mode == RADIO_MODE_BLE_2MBIT)
+    {
+        /* BLE requires a 16 bit preamble at 2 Mbit */
+        NRF_RADIO->PCNF0 |= ((RADIO_PCNF0_PLEN_16bit << RADIO_PCNF0_PLEN_Pos) & RADIO_PCNF0_PLEN_Msk);
+    }
+#endif
 
     /* Packet configuration */
     NRF_RADIO->PCNF1 =  (
-                          (((37UL)                          << RADIO_PCNF1_MAXLEN_Pos)  & RADIO_PCNF1_MAXLEN_Msk)   // maximum length of payload in bytes [0-255]
+                          (((RADIO_PAYLOAD_MAX_LEN)         << RADIO_PCNF1_MAXLEN_Pos)  & RADIO_PCNF1_MAXLEN_Msk)   // maximum length of payload in bytes [0-255]
                         | (((0UL)                           << RADIO_PCNF1_STATLEN_Pos) & RADIO_PCNF1_STATLEN_Msk)	// expand the payload with N bytes in addition to LENGTH [0-255]
                         | (((3UL)                           << RADIO_PCNF1_BALEN_Pos)   & RADIO_PCNF1_BALEN_Msk)    // base address length in number of bytes.
                         | (((RADIO_PCNF1_ENDIAN_Little)     << RADIO_PCNF1_ENDIAN_Pos)  & RADIO_PCNF1_ENDIAN_Msk)   // endianess of the S0, LENGTH, S1 and PAYLOAD fields.
@@ -223,6 +654,12 @@ void radio_init(radio_idle_cb_t idle_cb,
     NRF_RADIO->CRCINIT = ((0x555555 << RADIO_CRCINIT_CRCINIT_Pos) & RADIO_CRCINIT_CRCINIT_Msk);    // Initial value of CRC
     /* Lock interframe spacing, so that the radio won't send too soon / start RX too early */
     NRF_RADIO->TIFS = 148;
+#ifdef NRF52
+    /* Fast ramp-up, 40us instead of 140us from each TXEN/RXEN to READY. The
+       TIFS is still enforced between chained packets. */
+    NRF_RADIO->MODECNF0 = (NRF_RADIO->MODECNF0 & ~RADIO_MODECNF0_RU_Msk) |
+                          ((RADIO_MODECNF0_RU_Fast << RADIO_MODECNF0_RU_Pos) & RADIO_MODECNF0_RU_Msk);
+#endif
 
     /* init radio packet fifo */
     if (m_radio_state == RADIO_STATE_NEVER_USED)
@@ -233,10 +670,14 @@ void radio_init(radio_idle_cb_t idle_cb,
         m_radio_fifo.elem_size = sizeof(radio_event_t);
         m_radio_fifo.memcpy_fptr = NULL;
         fifo_init(&m_radio_fifo);
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+        rand_prng_seed(&m_lbt_prng);
+#endif
     }
 
     m_radio_state = RADIO_STATE_DISABLED;
     NRF_RADIO->EVENTS_END = 0;
+    NRF_RADIO->EVENTS_DISABLED = 0;
 
     NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
@@ -265,6 +706,35 @@ void radio_alt_aa_set(uint32_t access_address)
     m_alt_aa = access_address;
 }
 
+uint32_t radio_aa_prefix_set(uint8_t logical_address, uint8_t prefix)
+{
+    if (logical_address < 2 || logical_address > 7)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    /* AP0-AP3 are in PREFIX0, AP4-AP7 in PREFIX1, one byte each */
+    uint32_t shift = (logical_address & 0x03) * 8;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (logical_address < 4)
+    {
+        m_prefix0 = (m_prefix0 & ~(0xFFUL << shift)) | ((uint32_t) prefix << shift);
+    }
+    else
+    {
+        m_prefix1 = (m_prefix1 & ~(0xFFUL << shift)) | ((uint32_t) prefix << shift);
+    }
+    m_rx_addresses_extra |= (1 << logical_address);
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
+}
+
+uint8_t radio_rx_address_get(void)
+{
+    return (uint8_t) NRF_RADIO->RXMATCH;
+}
+
 uint32_t radio_order(radio_event_t* p_radio_event)
 {
     if (p_radio_event == NULL)
@@ -273,18 +743,23 @@ uint32_t radio_order(radio_event_t* p_radio_event)
     }
 
     if (p_radio_event->event_type == RADIO_EVENT_TYPE_TX &&
-        p_radio_event->access_address > 1)
+        p_radio_event->access_address > 7)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
 
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
     if (fifo_push(&m_radio_fifo, p_radio_event) != NRF_SUCCESS)
     {
+        _ENABLE_IRQS(was_masked);
         return NRF_ERROR_NO_MEM;
     }
+#ifdef RADIO_PRIORITY
+    /* the radio IRQ pops the queue, must be done with the push */
+    queue_priority_insert();
+#endif
 
-    uint32_t was_masked;
-    _DISABLE_IRQS(was_masked);
     if (timeslot_is_in_ts())
     {
         NVIC_SetPendingIRQ(RADIO_IRQn);
@@ -294,22 +769,114 @@ uint32_t radio_order(radio_event_t* p_radio_event)
     return NRF_SUCCESS;
 }
 
+void radio_mode_set(radio_mode_t mode)
+{
+    m_radio_mode = mode;
+}
+
+uint32_t radio_event_duration_get(void)
+{
+    if (m_radio_mode == RADIO_MODE_BLE_2MBIT)
+    {
+        return RADIO_EVENT_OVERHEAD_US + RADIO_PACKET_AIRTIME_2MBIT_US;
+    }
+    return RADIO_EVENT_OVERHEAD_US + RADIO_PACKET_AIRTIME_1MBIT_US;
+}
+
+uint32_t radio_queue_len_get(void)
+{
+    return fifo_get_len(&m_radio_fifo);
+}
+
+bool radio_queue_busy(void)
+{
+    radio_event_t evt;
+    return (fifo_peek(&m_radio_fifo, &evt) == NRF_SUCCESS &&
+            (evt.event_type != RADIO_EVENT_TYPE_RX_PREEMPTABLE ||
+             fifo_get_len(&m_radio_fifo) > 1));
+}
+
 void radio_disable(void)
 {
     NRF_RADIO->SHORTS = 0;
     NRF_RADIO->INTENCLR = 0xFFFFFFFF;
     NRF_RADIO->TASKS_DISABLE = 1;
+#ifdef RADIO_TIME_STATS
+    radio_time_end(timer_now());
+#endif
+    if (m_radio_state == RADIO_STATE_DISABLING)
+    {
+        /* disabled before the DISABLED event came in, report the aborted RX now */
+        m_radio_state = RADIO_STATE_DISABLED;
+        m_rx_cb(m_disabling_evt.packet_ptr, false, 0xFFFFFFFF, 100, 0, m_disabling_evt.channel);
+    }
     m_radio_state = RADIO_STATE_DISABLED;
+    m_tx_chained = false;
+#ifdef RADIO_RX_CHAIN
+    m_rx_chained = false;
+#endif
+#ifdef RBC_MESH_LISTEN_BEFORE_TALK
+    /* the backoff timer is local to the timeslot */
+    m_lbt_backoff = false;
+#endif
     DEBUG_RADIO_SET_STATE(PIN_RADIO_STATE_IDLE);
 }
 
+uint32_t radio_tx_deferred_count_get(void)
+{
+    return m_tx_deferred_count;
+}
+
+void radio_time_get(radio_time_t* p_time)
+{
+#ifdef RADIO_TIME_STATS
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    p_time->rx_us = m_radio_time.rx;
+    p_time->tx_us = m_radio_time.tx;
+    p_time->ramp_up_us = m_radio_time.ramp_up;
+    _ENABLE_IRQS(was_masked);
+#else
+    memset(p_time, 0, sizeof(radio_time_t));
+#endif
+}
+
+uint32_t radio_ram_size_get(void)
+{
+    return sizeof(m_radio_fifo_queue)
+#ifdef RBC_MESH_ENCRYPTION
+        + sizeof(m_tx_crypt_buf)
+#endif
+        ;
+}
+
 /**
 * IRQ handler for radio. Sends the radio around the state machine, ensuring secure radio state changes
 */
 void radio_event_handler(void)
 {
-    if (NRF_RADIO->EVENTS_END)
+    TRACE_BEGIN(MESH_TRACE_POINT_RADIO_IRQ, 0);
+    ISR_STATS_BEGIN(RBC_MESH_ISR_RADIO);
+    if (m_radio_state == RADIO_STATE_DISABLING)
     {
+        if (NRF_RADIO->EVENTS_DISABLED)
+        {
+            /* an aborted RX may have ended as it was disabled, drop it */
+            NRF_RADIO->EVENTS_DISABLED = 0;
+            NRF_RADIO->EVENTS_END = 0;
+            NRF_RADIO->INTENCLR = RADIO_INTENCLR_DISABLED_Msk;
+            m_radio_state = RADIO_STATE_DISABLED;
+
+            /* propagate failed rx event */
+            m_rx_cb(m_disabling_evt.packet_ptr, false, 0xFFFFFFFF, 100, 0, m_disabling_evt.channel);
+        }
+    }
+    else if (NRF_RADIO->EVENTS_END)
+    {
+#ifdef RADIO_TIME_STATS
+        timestamp_t end_time = timer_now();
+        radio_time_end(end_time);
+#endif
         bool crc_status = NRF_RADIO->CRCSTATUS;
         uint32_t crc = NRF_RADIO->RXCRC;
         uint8_t rssi = 100;
@@ -323,29 +890,106 @@ void radio_event_handler(void)
         radio_event_t prev_evt;
         NRF_RADIO->EVENTS_END = 0;
 
-        /* pop the event that just finished */
-        uint32_t error_code = fifo_pop(&m_radio_fifo, &prev_evt);
-        APP_ERROR_CHECK(error_code);
+#ifdef RADIO_RX_CHAIN
+        bool rx_chained = m_rx_chained;
+        if (rx_chained)
+        {
+            /* the scan goes on, only its packet is handed off */
+            rx_chain_swap(&prev_evt);
+        }
+        else
+#endif
+        {
+            /* pop the event that just finished */
+            uint32_t error_code = fifo_pop(&m_radio_fifo, &prev_evt);
+            APP_ERROR_CHECK(error_code);
+        }
 
         /* send to super space */
         if (prev_evt.event_type == RADIO_EVENT_TYPE_RX ||
             prev_evt.event_type == RADIO_EVENT_TYPE_RX_PREEMPTABLE)
         {
-            m_rx_cb(prev_evt.packet_ptr, crc_status, crc, rssi);
+            timestamp_t timestamp = 0;
+#ifdef RADIO_RX_TIMESTAMP
+            if (!timer_event_capture_get(&timestamp))
+            {
+                timestamp = timer_now();
+            }
+#endif
+#ifdef RADIO_RX_CHAIN
+            /* the scan may get its next packet before the callback returns */
+            if (rx_chained)
+            {
+                rx_chained = rx_chain_restart();
+            }
+#endif
+            m_rx_cb(prev_evt.packet_ptr, crc_status, crc, rssi, timestamp, prev_evt.channel);
         }
         else
         {
             m_tx_cb(prev_evt.packet_ptr);
         }
 
-        DEBUG_RADIO_SET_STATE(PIN_RADIO_STATE_IDLE);
-        m_radio_state = RADIO_STATE_DISABLED;
+        bool chained = false;
+#ifdef RADIO_RX_CHAIN
+        if (rx_chained)
+        {
+            chained = true;
+#ifdef RADIO_TIME_STATS
+            /* the short ramps up the receiver again right after the END event */
+            radio_time_start(end_time, false);
+#endif
+        }
+#endif
+        if (m_tx_chained)
+        {
+            m_tx_chained = false;
+            /* the short will restart TX as soon as the radio is disabled */
+            while (NRF_RADIO->STATE == RADIO_STATE_STATE_TxDisable);
+            chained = (NRF_RADIO->STATE != RADIO_STATE_STATE_Disabled);
+#ifdef RADIO_TIME_STATS
+            if (chained)
+            {
+                /* the short ramps up the transmitter again right after the END event */
+                radio_time_start(end_time, true);
+            }
+#endif
+        }
+
+        if (!chained)
+        {
+            DEBUG_RADIO_SET_STATE(PIN_RADIO_STATE_IDLE);
+            m_radio_state = RADIO_STATE_DISABLED;
+        }
+#ifdef RADIO_RX_CHAIN
+        else if (m_radio_state == RADIO_STATE_RX)
+        {
+            /* events ordered during the packet preempt the restarted scan */
+            purge_preemptable();
+        }
+#endif
     }
-    else
+    else if (!(m_radio_state == RADIO_STATE_TX && NRF_RADIO->EVENTS_ADDRESS))
     {
         purge_preemptable();
     }
 
+    if (m_radio_state == RADIO_STATE_TX && NRF_RADIO->EVENTS_ADDRESS)
+    {
+        NRF_RADIO->EVENTS_ADDRESS = 0;
+        tx_chain_setup();
+    }
+#ifdef RADIO_RX_CHAIN
+    else if (m_radio_state == RADIO_STATE_RX &&
+             NRF_RADIO->EVENTS_ADDRESS &&
+             (NRF_RADIO->INTENSET & RADIO_INTENSET_ADDRESS_Msk))
+    {
+        /* the event stays set for the timestamp capture and listen before talk */
+        NRF_RADIO->INTENCLR = RADIO_INTENCLR_ADDRESS_Msk;
+        rx_chain_setup();
+    }
+#endif
+
     if (m_radio_state == RADIO_STATE_DISABLED ||
         m_radio_state == RADIO_STATE_NEVER_USED)
     {
@@ -359,5 +1003,7 @@ void radio_event_handler(void)
             m_idle_cb();
         }
     }
+    ISR_STATS_END(RBC_MESH_ISR_RADIO);
+    TRACE_END(MESH_TRACE_POINT_RADIO_IRQ, 0);
 }
 
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rand.h"
 
 #include <nrf_error.h>
+#include <stdbool.h>
 
 #ifndef __linux__
 #include <nrf_soc.h>
@@ -43,6 +44,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *****************************************************************************/
 #define ROT(x,k) (((x)<<(k))|((x)>>(32-(k)))) /** PRNG cyclic leftshift */
 #define SMALL_PRNG_BASE_SEED    (0xf1ea5eed)  /** Base seed for PRNG, defined by the author of the generator. */
+#ifndef RAND_POOL_SIZE
+#define RAND_POOL_SIZE          (16)          /** Size of the interrupt driven pool of HW RNG bytes, only used without the Softdevice. */
+#endif
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+#if !defined(__linux__) && !defined(SOFTDEVICE_PRESENT)
+static uint8_t m_pool[RAND_POOL_SIZE];
+static volatile uint8_t m_pool_count;
+static bool m_pool_running;
+#endif
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
@@ -83,8 +96,91 @@ uint32_t rand_prng_get(prng_t* p_prng)
     return p_prng->d;
 }
 
+uint32_t rand_prng_reseed(prng_t* p_prng)
+{
+    uint32_t seed;
+    uint32_t error_code = rand_hw_rng_try_get((uint8_t*) &seed, 4);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    /* keep the current state, it has seen all earlier seeds */
+    p_prng->c ^= seed;
+    p_prng->d ^= seed;
+    for (uint32_t i = 0; i < 20; ++i)
+    {
+        (void)rand_prng_get(p_prng);
+    }
+
+    return NRF_SUCCESS;
+}
+
 #ifndef __linux__ /* TODO: Add Windows random generator for software testing on windows */
 
+#ifndef SOFTDEVICE_PRESENT
+/* The pool is only filled once something asks for bytes without waiting, so
+   that the blocking reads keep the RNG to themselves until then. */
+void RNG_IRQHandler(void)
+{
+    if (NRF_RNG->EVENTS_VALRDY)
+    {
+        NRF_RNG->EVENTS_VALRDY = 0;
+        if (m_pool_count < RAND_POOL_SIZE)
+        {
+            m_pool[m_pool_count++] = NRF_RNG->VALUE;
+        }
+        if (m_pool_count >= RAND_POOL_SIZE)
+        {
+            NRF_RNG->TASKS_STOP = 1;
+        }
+    }
+}
+#endif
+
+uint32_t rand_hw_rng_try_get(uint8_t* p_result, uint16_t len)
+{
+#ifdef SOFTDEVICE_PRESENT
+    uint8_t bytes_available = 0;
+    sd_rand_application_bytes_available_get(&bytes_available);
+    if (bytes_available < len)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (sd_rand_application_vector_get(p_result, len) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+    return NRF_SUCCESS;
+#else
+    if (!m_pool_running)
+    {
+        m_pool_running = true;
+        NRF_RNG->EVENTS_VALRDY = 0;
+        NRF_RNG->INTENSET = RNG_INTENSET_VALRDY_Msk;
+        NVIC_ClearPendingIRQ(RNG_IRQn);
+        NVIC_EnableIRQ(RNG_IRQn);
+        NRF_RNG->TASKS_START = 1;
+        return NRF_ERROR_BUSY;
+    }
+
+    uint32_t error_code = NRF_ERROR_BUSY;
+    NVIC_DisableIRQ(RNG_IRQn);
+    if (m_pool_count >= len)
+    {
+        m_pool_count -= len;
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            p_result[i] = m_pool[m_pool_count + i];
+        }
+        error_code = NRF_SUCCESS;
+    }
+    NRF_RNG->TASKS_START = 1; /* top the pool up again */
+    NVIC_EnableIRQ(RNG_IRQn);
+    return error_code;
+#endif
+}
+
 uint32_t rand_hw_rng_get(uint8_t* p_result, uint16_t len)
 {
 #ifdef SOFTDEVICE_PRESENT
@@ -114,6 +210,18 @@ uint32_t rand_hw_rng_get(uint8_t* p_result, uint16_t len)
         count += bytes_available;
     }
 #else
+    if (m_pool_running)
+    {
+        /* the RNG interrupt takes the bytes, wait for them in the pool */
+        while (len)
+        {
+            if (rand_hw_rng_try_get(&p_result[len - 1], 1) == NRF_SUCCESS)
+            {
+                len--;
+            }
+        }
+        return NRF_SUCCESS;
+    }
     NRF_RNG->TASKS_START = 1;
     while (len)
     {
@@ -127,6 +235,11 @@ uint32_t rand_hw_rng_get(uint8_t* p_result, uint16_t len)
 }
 
 #else
+uint32_t rand_hw_rng_try_get(uint8_t* p_result, uint16_t len)
+{
+    return rand_hw_rng_get(p_result, len);
+}
+
 uint32_t rand_hw_rng_get(uint8_t * p_result, uint16_t len)
 {
     int random_file = open("/dev/random", O_RDONLY);
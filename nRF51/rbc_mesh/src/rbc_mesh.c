@@ -35,16 +35,101 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "event_handler.h"
 #include "version_handler.h"
 #include "transport_control.h"
+#include "radio_control.h"
 #include "mesh_packet.h"
 #include "mesh_gatt.h"
+#include "mesh_segment.h"
 #include "dfu_app.h"
 #include "fifo.h"
+#include "trickle.h"
+#include "mesh_trace.h"
+#include "mesh_log.h"
+#include "isr_stats.h"
+#include "mesh_stack.h"
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+#include "value_flash.h"
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+#include "value_retain.h"
+#endif
+#ifdef RBC_MESH_ENCRYPTION
+#include "mesh_crypt.h"
+#endif
+#ifdef RBC_MESH_ACK
+#include "mesh_ack.h"
+#endif
+#ifdef RBC_MESH_BRIDGE
+#include "mesh_bridge.h"
+#endif
+#ifdef RBC_MESH_VALUE_GROUPS
+#include "mesh_group.h"
+#endif
+#ifdef RBC_MESH_TIME_SERIES
+#include "mesh_series.h"
+#endif
+#ifdef RBC_MESH_VALUE_SHADOW
+#include "mesh_shadow.h"
+#endif
+#ifdef RBC_MESH_SCHEDULED_VALUES
+#include "mesh_schedule.h"
+#endif
+#ifdef RBC_MESH_VALUE_HISTORY
+#include "value_history.h"
+#endif
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+#include "mesh_neighbor.h"
+#endif
+#ifdef RBC_MESH_TX_POWER_CONTROL
+#include "mesh_tx_power.h"
+#endif
+#ifdef RBC_MESH_TRICKLE_AUTO_TUNE
+#include "mesh_trickle_tune.h"
+#endif
+#ifdef RBC_MESH_HEALTH_MONITOR
+#include "mesh_health.h"
+#endif
+#ifdef RBC_MESH_CONFIG_PUSH
+#include "mesh_config.h"
+#endif
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+#include "mesh_app_cmd.h"
+#endif
+#ifdef RBC_MESH_SERIAL
+#include "serial_handler.h"
+#endif
 
 #include "app_error.h"
 #include "nrf_sdm.h"
 
 #include <string.h>
 
+/** Packet pool size needed for the given data cache and app event queue
+  sizes, matches the RBC_MESH_PACKET_POOL_SIZE default. */
+#define PACKET_POOL_SIZE(data_cache_entries, app_event_queue_length) \
+    (RBC_MESH_CACHE_PACKETS(data_cache_entries) + \
+     RBC_MESH_EVENT_PACKETS(app_event_queue_length) + \
+     RBC_MESH_RADIO_QUEUE_LENGTH + \
+     RBC_MESH_INTERNAL_EVENT_QUEUE_LENGTH + \
+     RBC_MESH_RX_QUEUE_LENGTH + \
+     RBC_MESH_RX_SPARE_PACKETS + \
+     3)
+
+/** Limited by the handle cache linked list indexes. */
+#define CACHE_ENTRIES_MAX       (0x7FFF)
+
+/*****************************************************************************
+* Local typedefs
+*****************************************************************************/
+/** Framework memory, carved out of an application supplied arena. */
+typedef struct
+{
+    rbc_mesh_event_t* p_app_event_queue;
+    uint16_t app_event_queue_length;
+    handle_storage_memory_t cache;
+    void* p_packet_pool;
+    uint16_t packet_pool_size;
+} memory_layout_t;
+
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
@@ -52,37 +137,137 @@ static rbc_mesh_state_t m_mesh_state;
 static uint32_t         m_access_addr;
 static uint8_t          m_channel;
 static uint32_t         m_interval_min_ms;
+static bool             m_relay_only;
+static uint8_t          m_event_source_mask = RBC_MESH_EVENT_SOURCE_MASK_ALL;
+static const rbc_mesh_handle_range_t* mp_subscriptions;
+static uint8_t          m_subscription_count;
 static fifo_t           m_rbc_event_fifo;
+#ifndef RBC_MESH_EXTERNAL_MEMORY
 static rbc_mesh_event_t m_rbc_event_buffer[RBC_MESH_APP_EVENT_QUEUE_LENGTH];
+#endif
+
+/** Application event counters, reported through rbc_mesh_stats_get(). */
+static struct
+{
+    uint32_t new_val;
+    uint32_t update_val;
+    uint32_t conflicting_val;
+    uint32_t tx;
+    uint32_t queue_drop;
+} m_app_event_stats;
 
 /*****************************************************************************
-* Static Functions
+* Static functions
 *****************************************************************************/
-#if defined(WITH_ACK_MASTER) 
-static uint32_t top_queue_counter[4] __attribute__((at(0x20002F98)))={0};
-static uint32_t top_queue_drop __attribute__((at(0x20002FA8))) =0;
-#endif
+/** Combine the radio time with the time spent in timeslots. */
+static void radio_stats_get(rbc_mesh_radio_stats_t* p_stats)
+{
+    uint64_t total_time = timeslot_total_time_get();
+    radio_time_t radio_time;
+    radio_time_get(&radio_time);
+
+    uint64_t on_time = radio_time.rx_us + radio_time.tx_us + radio_time.ramp_up_us;
+    p_stats->timeslot_ms = (uint32_t) (total_time / 1000);
+    p_stats->rx_ms = (uint32_t) (radio_time.rx_us / 1000);
+    p_stats->tx_ms = (uint32_t) (radio_time.tx_us / 1000);
+    p_stats->ramp_up_ms = (uint32_t) (radio_time.ramp_up_us / 1000);
+    if (on_time > 0 && total_time > on_time)
+    {
+        p_stats->idle_ms = (uint32_t) ((total_time - on_time) / 1000);
+        p_stats->rx_permille = (uint16_t) ((radio_time.rx_us * 1000) / total_time);
+        p_stats->tx_permille = (uint16_t) ((radio_time.tx_us * 1000) / total_time);
+    }
+}
 
-#if defined (WITHOUT_ACK_MASTER)
-static uint32_t top_queue_counter[4] __attribute__((at(0x200026B4))) ={0};
-static uint32_t top_queue_drop __attribute__((at(0x200026C4))) =0;
-#endif
+/** Split the application supplied arena between the app event queue, the
+  caches and the packet pool. Relays may leave out the app event queue. */
+static uint32_t memory_layout_get(const rbc_mesh_memory_t* p_memory, bool relay_only, memory_layout_t* p_layout)
+{
+    if (p_memory->p_arena == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (((uint32_t) p_memory->p_arena) & 0x03)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((p_memory->app_event_queue_length == 0 && !relay_only) ||
+        (p_memory->app_event_queue_length & (p_memory->app_event_queue_length - 1)) ||
+        p_memory->handle_cache_entries > CACHE_ENTRIES_MAX ||
+        p_memory->data_cache_entries > CACHE_ENTRIES_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
 
-#if defined(WITH_ACK_SLAVE)
-static uint32_t top_queue_counter[4] __attribute__((at(0x200026A0)))  ={0};
-static uint32_t top_queue_drop __attribute__((at(0x200026B0)))  =0;
-#endif
+    uint16_t data_cache_entries = p_memory->data_cache_entries;
+    if (data_cache_entries == 0)
+    {
+        /* fit as many data entries as the arena can hold */
+        uint16_t limit = (p_memory->handle_cache_entries == 0) ? CACHE_ENTRIES_MAX : p_memory->handle_cache_entries;
+        while (data_cache_entries < limit)
+        {
+            uint16_t next = data_cache_entries + 1;
+            uint16_t handles = (p_memory->handle_cache_entries == 0) ? next : p_memory->handle_cache_entries;
+            if (rbc_mesh_memory_size_get(handles, next, p_memory->app_event_queue_length) > p_memory->arena_size)
+            {
+                break;
+            }
+            data_cache_entries = next;
+        }
+        if (data_cache_entries == 0)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+
+    uint16_t handle_cache_entries = p_memory->handle_cache_entries;
+    if (handle_cache_entries == 0)
+    {
+        handle_cache_entries = data_cache_entries;
+    }
+    if (handle_cache_entries < data_cache_entries ||
+        p_memory->pinned_data_entries > data_cache_entries ||
+        PACKET_POOL_SIZE((uint32_t) data_cache_entries, p_memory->app_event_queue_length) >= UINT16_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (rbc_mesh_memory_size_get(handle_cache_entries, data_cache_entries, p_memory->app_event_queue_length) > p_memory->arena_size)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint8_t* p_next = (uint8_t*) p_memory->p_arena;
+    p_layout->p_app_event_queue = (rbc_mesh_event_t*) p_next;
+    p_layout->app_event_queue_length = p_memory->app_event_queue_length;
+    p_next += MEMORY_WORD_ALIGN(sizeof(rbc_mesh_event_t) * p_memory->app_event_queue_length);
+
+    p_layout->cache.p_memory = p_next;
+    p_layout->cache.handle_cache_entries = handle_cache_entries;
+    p_layout->cache.data_cache_entries = data_cache_entries;
+    p_layout->cache.pinned_data_entries = p_memory->pinned_data_entries;
+    p_next += handle_storage_memory_size_get(handle_cache_entries, data_cache_entries);
+
+    p_layout->p_packet_pool = p_next;
+    p_layout->packet_pool_size = PACKET_POOL_SIZE(data_cache_entries, p_memory->app_event_queue_length);
+    return NRF_SUCCESS;
+}
 
-#if defined(WITHOUT_ACK_SLAVE)
-static uint32_t top_queue_counter[4] __attribute__((at(0x200026A0)))  ={0};
-static uint32_t top_queue_drop __attribute__((at(0x200026B0))) =0;
-#endif
 /*****************************************************************************
 * Interface Functions
 *****************************************************************************/
 
+uint32_t rbc_mesh_memory_size_get(uint16_t handle_cache_entries,
+        uint16_t data_cache_entries,
+        uint16_t app_event_queue_length)
+{
+    return MEMORY_WORD_ALIGN(sizeof(rbc_mesh_event_t) * app_event_queue_length) +
+           handle_storage_memory_size_get(handle_cache_entries, data_cache_entries) +
+           mesh_packet_memory_size_get(PACKET_POOL_SIZE(data_cache_entries, app_event_queue_length));
+}
+
 uint32_t rbc_mesh_init(rbc_mesh_init_params_t init_params)
 {
+#ifndef RBC_MESH_STANDALONE
     uint8_t sd_is_enabled = 0;
     sd_softdevice_is_enabled(&sd_is_enabled);
 
@@ -90,41 +275,131 @@ uint32_t rbc_mesh_init(rbc_mesh_init_params_t init_params)
     {
         return NRF_ERROR_SOFTDEVICE_NOT_ENABLED;
     }
+#endif
 
     if (m_mesh_state != MESH_STATE_UNINITIALIZED)
     {
         return NRF_ERROR_INVALID_STATE;
     }
 
+#ifdef RBC_MESH_STACK_WATERMARK
+    mesh_stack_paint();
+#endif
+
     if (init_params.interval_min_ms < RBC_MESH_INTERVAL_MIN_MIN_MS ||
         init_params.interval_min_ms > RBC_MESH_INTERVAL_MIN_MAX_MS)
     {
         return NRF_ERROR_INVALID_PARAM;
     }
 
+    if (init_params.radio_mode > RBC_MESH_RADIO_MODE_BLE_2MBIT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#ifndef NRF52
+    if (init_params.radio_mode != RBC_MESH_RADIO_MODE_BLE_1MBIT)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+#endif
+
+    if (init_params.subscription_count > 0 && init_params.p_subscriptions == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    for (uint32_t i = 0; i < init_params.subscription_count; ++i)
+    {
+        if (init_params.p_subscriptions[i].first > init_params.p_subscriptions[i].last)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
+
+    uint32_t error_code;
+    memory_layout_t memory_layout;
+    if (init_params.p_memory != NULL)
+    {
+        error_code = memory_layout_get(init_params.p_memory, init_params.relay_only, &memory_layout);
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+    }
+    else
+    {
+#ifdef RBC_MESH_EXTERNAL_MEMORY
+        return NRF_ERROR_NULL;
+#else
+        memory_layout.p_app_event_queue = m_rbc_event_buffer;
+        memory_layout.app_event_queue_length = RBC_MESH_APP_EVENT_QUEUE_LENGTH;
+        memory_layout.p_packet_pool = NULL;
+        memory_layout.packet_pool_size = 0;
+#endif
+    }
+
     timer_sch_init();
+#ifdef RBC_MESH_TRACE
+    mesh_trace_init();
+#endif
+#ifdef RBC_MESH_LOG
+    mesh_log_init();
+#endif
     event_handler_init();
-    mesh_packet_init();
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+    mesh_app_cmd_init();
+#endif
+#ifdef RBC_MESH_VALUE_SHADOW
+    mesh_shadow_init();
+#endif
+#ifdef RBC_MESH_SCHEDULED_VALUES
+    mesh_schedule_init();
+#endif
+#ifdef RBC_MESH_VALUE_HISTORY
+    value_history_init();
+#endif
+    error_code = mesh_packet_init(memory_layout.p_packet_pool, memory_layout.packet_pool_size);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    radio_mode_set((radio_mode_t) init_params.radio_mode);
     tc_init(init_params.access_addr, init_params.channel);
 
-
-    uint32_t error_code;
     error_code = vh_init(init_params.interval_min_ms * 1000, /* ms -> us */
                          init_params.access_addr,
-                         init_params.channel, 
-                         init_params.tx_power);
+                         init_params.channel,
+                         init_params.tx_power,
+                         (init_params.p_memory != NULL) ? &memory_layout.cache : NULL);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    /* restore the persistent values before the first timeslot */
+    error_code = value_flash_init();
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+#endif
+#ifdef RBC_MESH_RETAINED_RAM
+    /* after the flash, the retained values are at least as new */
+    error_code = value_retain_init();
     if (error_code != NRF_SUCCESS)
     {
         return error_code;
     }
+#endif
 
+#ifndef RBC_MESH_STANDALONE
     ble_enable_params_t ble_enable;
     memset(&ble_enable, 0, sizeof(ble_enable));
     ble_enable.gatts_enable_params.attr_tab_size = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
     ble_enable.gatts_enable_params.service_changed = 0;
     
 #if(NORDIC_SDK_VERSION >= 11)
-    ble_enable.gap_enable_params.periph_conn_count = 1;
+    ble_enable.gap_enable_params.periph_conn_count = MESH_GATT_CONN_COUNT_MAX;
     uint32_t ram_base = RAM_R1_BASE;
     error_code = sd_ble_enable(&ble_enable, &ram_base);
 #else
@@ -141,20 +416,33 @@ uint32_t rbc_mesh_init(rbc_mesh_init_params_t init_params)
     {
         return error_code;
     }
+#endif
 
     timeslot_init(init_params.lfclksrc);
 
     m_access_addr = init_params.access_addr;
     m_channel = init_params.channel;
     m_interval_min_ms = init_params.interval_min_ms;
+    m_relay_only = init_params.relay_only;
+    mp_subscriptions = (init_params.subscription_count > 0) ? init_params.p_subscriptions : NULL;
+    m_subscription_count = init_params.subscription_count;
 
     m_mesh_state = MESH_STATE_RUNNING;
 
-    m_rbc_event_fifo.array_len = RBC_MESH_APP_EVENT_QUEUE_LENGTH;
-    m_rbc_event_fifo.elem_array = m_rbc_event_buffer;
+    m_rbc_event_fifo.array_len = memory_layout.app_event_queue_length;
+    m_rbc_event_fifo.elem_array = memory_layout.p_app_event_queue;
     m_rbc_event_fifo.elem_size = sizeof(rbc_mesh_event_t);
     m_rbc_event_fifo.memcpy_fptr = NULL;
-    fifo_init(&m_rbc_event_fifo);
+    if (m_rbc_event_fifo.array_len > 0)
+    {
+        fifo_init(&m_rbc_event_fifo);
+    }
+    else
+    {
+        /* relay without an app event queue, the fifo stays empty */
+        m_rbc_event_fifo.head = 0;
+        m_rbc_event_fifo.tail = 0;
+    }
     timeslot_resume();
 
 #ifdef MESH_DFU
@@ -242,6 +530,20 @@ uint32_t rbc_mesh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event)
     return vh_tx_event_set(handle, do_tx_event);
 }
 
+uint32_t rbc_mesh_urgent_flag_set(rbc_mesh_value_handle_t handle, bool urgent)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_urgent_flag_set(handle, urgent);
+}
+
 /****** Getters and setters ******/
 
 uint32_t rbc_mesh_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len)
@@ -254,6 +556,32 @@ uint32_t rbc_mesh_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint1
     {
         return NRF_ERROR_INVALID_ADDR;
     }
+    if (mesh_segment_is_segmented(handle))
+    {
+        return mesh_segment_local_update(handle, data, len);
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_component(handle))
+    {
+        return mesh_group_component_set(handle, data, len);
+    }
+    if (mesh_group_is_group(handle))
+    {
+        /* the group value is only built from its components */
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+#ifdef RBC_MESH_TIME_SERIES
+    if (mesh_series_is_series(handle))
+    {
+        /* the series value is only built from its samples */
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+    if (len > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
 
     /* no critical errors if this call fails, ignore return */
     mesh_gatt_value_set(handle, data, len);
@@ -261,15 +589,153 @@ uint32_t rbc_mesh_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint1
     return vh_local_update(handle, data, len);
 }
 
+uint32_t rbc_mesh_values_set(const rbc_mesh_value_handle_t* p_handles, uint8_t* const* pp_data, const uint16_t* p_lens, uint32_t count)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_handles == NULL || pp_data == NULL || p_lens == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    /* check the whole batch before setting anything */
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (p_handles[i] > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(p_handles[i]))
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+#ifdef RBC_MESH_VALUE_GROUPS
+        if (mesh_group_is_group(p_handles[i]) || mesh_group_is_component(p_handles[i]))
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+#endif
+#ifdef RBC_MESH_TIME_SERIES
+        if (mesh_series_is_series(p_handles[i]))
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+#endif
+        if (p_lens[i] > RBC_MESH_VALUE_MAX_LEN)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        /* no critical errors if this call fails, ignore return */
+        mesh_gatt_value_set(p_handles[i], pp_data[i], p_lens[i]);
+    }
+
+    return vh_local_update_batch(p_handles, pp_data, p_lens, count);
+}
+
 uint32_t rbc_mesh_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* len)
 {
     if (handle > RBC_MESH_APP_MAX_HANDLE)
     {
         return NRF_ERROR_INVALID_ADDR;
     }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_component(handle))
+    {
+        return mesh_group_component_get(handle, data, len);
+    }
+#endif
+#ifdef RBC_MESH_VALUE_SHADOW
+    if (len == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    uint32_t error_code = mesh_shadow_read(handle, data, len);
+    if (error_code != NRF_ERROR_NOT_FOUND && error_code != NRF_ERROR_BUSY)
+    {
+        return error_code;
+    }
+#endif
     return vh_value_get(handle, data, len);
 }
 
+uint32_t rbc_mesh_value_set_async(rbc_mesh_value_handle_t handle, const uint8_t* data, uint16_t len, rbc_mesh_future_t* p_future)
+{
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    return mesh_app_cmd_value_set(handle, data, len, p_future);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_get_async(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* len, rbc_mesh_future_t* p_future)
+{
+#ifdef RBC_MESH_APP_COMMAND_QUEUE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    return mesh_app_cmd_value_get(handle, data, len, p_future);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_set_notify(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len, uint8_t tx_count, rbc_mesh_future_t* p_future)
+{
+#ifdef RBC_MESH_TX_NOTIFY
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_future == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    /* built values don't get their version from this update */
+    if (handle > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_group(handle) || mesh_group_is_component(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+    if (len > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t error_code = tc_tx_notify_add(handle, tx_count, p_future);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    error_code = rbc_mesh_value_set(handle, data, len);
+    if (error_code != NRF_SUCCESS)
+    {
+        tc_tx_notify_cancel(p_future);
+    }
+    return error_code;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
 uint32_t rbc_mesh_access_address_get(uint32_t* access_address)
 {
     if (m_mesh_state == MESH_STATE_UNINITIALIZED)
@@ -324,156 +790,1533 @@ uint32_t rbc_mesh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* is_doi
     return vh_tx_event_flag_get(handle, is_doing_tx_event);
 }
 
-void rbc_mesh_tx_power_set(rbc_mesh_txpower_t tx_power)
+uint32_t rbc_mesh_urgent_flag_get(rbc_mesh_value_handle_t handle, bool* p_urgent)
 {
-    vh_tx_power_set(tx_power);
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    return vh_urgent_flag_get(handle, p_urgent);
+}
+
+uint32_t rbc_mesh_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context)
+{
+    return vh_handles_iterate(callback, p_context);
 }
 
+typedef struct
+{
+    rbc_mesh_handle_info_t* p_infos;
+    uint32_t max_count;
+    uint32_t count;
+} handles_snapshot_t;
 
-void rbc_mesh_ble_evt_handler(ble_evt_t* p_evt)
+static bool handles_snapshot_cb(const rbc_mesh_handle_info_t* p_info, void* p_context)
 {
-    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    handles_snapshot_t* p_snapshot = (handles_snapshot_t*) p_context;
+    if (p_snapshot->count == p_snapshot->max_count)
     {
-        return;
+        return false;
     }
+    p_snapshot->p_infos[p_snapshot->count] = *p_info;
+    p_snapshot->p_infos[p_snapshot->count].p_data = NULL;
+    p_snapshot->count++;
+    return true;
+}
 
-    mesh_gatt_sd_ble_event_handle(p_evt);
+uint32_t rbc_mesh_handles_snapshot(rbc_mesh_handle_info_t* p_infos, uint32_t* p_count)
+{
+    if (p_infos == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    handles_snapshot_t snapshot = {p_infos, *p_count, 0};
+    uint32_t error_code = vh_handles_iterate(handles_snapshot_cb, &snapshot);
+    *p_count = snapshot.count;
+    return error_code;
 }
 
-void rbc_mesh_sd_evt_handler(uint32_t sd_evt)
+uint32_t rbc_mesh_cache_compact(void)
 {
-    timeslot_sd_event_handler(sd_evt);
+    return vh_cache_compact();
 }
 
-/** Internal only function to push mesh events to application queue. */
-uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_event)
+uint32_t rbc_mesh_trickle_class_config(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy)
 {
     if (m_mesh_state == MESH_STATE_UNINITIALIZED)
     {
         return NRF_ERROR_INVALID_STATE;
     }
-    if (p_event == NULL)
+    if (interval_min_ms < RBC_MESH_INTERVAL_MIN_MIN_MS ||
+        interval_min_ms > RBC_MESH_INTERVAL_MIN_MAX_MS ||
+        interval_max_ms < interval_min_ms)
     {
-        return NRF_ERROR_NULL;
+        return NRF_ERROR_INVALID_PARAM;
     }
-    
-    uint32_t error_code = fifo_push(&m_rbc_event_fifo, p_event);
-    
-    #if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)|| defined (WITH_ACK_SLAVE)|| defined (WITHOUT_ACK_SLAVE)
-    
-    
-		
-		if (error_code != NRF_SUCCESS)
-			   top_queue_drop++;
-		
-		 switch (p_event->type)
-         {
-            case RBC_MESH_EVENT_TYPE_NEW_VAL:
-					top_queue_counter[0]++;
-				    break;
-						
-            case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
-					top_queue_counter[1]++;
-					break;
-            case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
-					top_queue_counter[2]++;
-				    break;
-			case RBC_MESH_EVENT_TYPE_TX:
-					top_queue_counter[3]++;
-					break;
-						
-			default:
-					break;
-		}
-         
-      #endif
-        
-    
 
-    if (error_code == NRF_SUCCESS && p_event->params.rx.p_data != NULL)
+    return vh_trickle_class_config(trickle_class,
+            interval_min_ms * 1000, /* ms -> us */
+            (interval_max_ms == RBC_MESH_INTERVAL_MAX_UNBOUNDED) ? TRICKLE_I_MAX_UNBOUNDED : interval_max_ms / interval_min_ms,
+            redundancy);
+}
+
+uint32_t rbc_mesh_trickle_class_set(rbc_mesh_value_handle_t handle, uint8_t trickle_class)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
     {
-        switch (p_event->type)
-        {
-            case RBC_MESH_EVENT_TYPE_NEW_VAL:
-            case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
-            case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
-                if (p_event->params.rx.p_data)
-                {
-                    mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.rx.p_data); /* will be aligned by packet manager */
-                }
-                break;
-            case RBC_MESH_EVENT_TYPE_TX:
-                if (p_event->params.tx.p_data)
-                {
-                    mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.tx.p_data); /* will be aligned by packet manager */
-                }
-                break;
-            default:
-                break;
-        }
+        return NRF_ERROR_INVALID_STATE;
     }
-    return error_code;
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_trickle_class_set(handle, trickle_class);
 }
 
-uint32_t rbc_mesh_event_get(rbc_mesh_event_t* p_evt)
+uint32_t rbc_mesh_trickle_class_get(rbc_mesh_value_handle_t handle, uint8_t* p_trickle_class)
 {
     if (m_mesh_state == MESH_STATE_UNINITIALIZED)
     {
         return NRF_ERROR_INVALID_STATE;
     }
-    if (fifo_pop(&m_rbc_event_fifo, p_evt) != NRF_SUCCESS)
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
     {
-        return NRF_ERROR_NOT_FOUND;
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_trickle_class_get(handle, p_trickle_class);
+}
+
+uint32_t rbc_mesh_trickle_auto_tune_set(bool enable)
+{
+#ifdef RBC_MESH_TRICKLE_AUTO_TUNE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
     }
 
+    mesh_trickle_tune_set(enable);
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
 
-uint32_t rbc_mesh_event_peek(rbc_mesh_event_t* p_evt)
+uint32_t rbc_mesh_health_threshold_set(rbc_mesh_health_metric_t metric, uint16_t threshold)
 {
+#ifdef RBC_MESH_HEALTH_MONITOR
     if (m_mesh_state == MESH_STATE_UNINITIALIZED)
     {
         return NRF_ERROR_INVALID_STATE;
     }
-    if (p_evt == NULL)
+
+    return mesh_health_threshold_set(metric, threshold);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_health_handle_set(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_HEALTH_MONITOR
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_health_handle_set(handle);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_config_key_set(const uint8_t* p_key)
+{
+#ifdef RBC_MESH_CONFIG_PUSH
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_config_key_set(p_key);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_config_interval_push(uint32_t interval_min_ms)
+{
+#ifdef RBC_MESH_CONFIG_PUSH
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_config_interval_push(interval_min_ms);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_config_trickle_class_push(uint8_t trickle_class,
+        uint32_t interval_min_ms,
+        uint32_t interval_max_ms,
+        uint8_t redundancy)
+{
+#ifdef RBC_MESH_CONFIG_PUSH
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_config_trickle_class_push(trickle_class, interval_min_ms, interval_max_ms, redundancy);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_config_radio_push(uint32_t access_address, uint8_t channel, uint32_t switch_delay_ms)
+{
+#ifdef RBC_MESH_CONFIG_PUSH
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_config_radio_push(access_address, channel, switch_delay_ms);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+#ifdef RBC_MESH_CONFIG_PUSH
+/** Internal only function to apply radio parameters from the mesh wide configuration. */
+void rbc_mesh_radio_params_apply(uint32_t access_addr, uint8_t channel)
+{
+    m_access_addr = access_addr;
+    m_channel = channel;
+    vh_radio_params_set(access_addr, channel);
+}
+
+/** Internal only function to apply a min-interval from the mesh wide configuration. */
+void rbc_mesh_interval_min_apply(uint32_t interval_min_ms)
+{
+    m_interval_min_ms = interval_min_ms;
+    (void) vh_min_interval_set(interval_min_ms * 1000); /* ms -> us */
+}
+#endif
+
+void rbc_mesh_tx_power_set(rbc_mesh_txpower_t tx_power)
+{
+#ifdef RBC_MESH_TX_POWER_CONTROL
+    mesh_tx_power_max_set(tx_power);
+#else
+    vh_tx_power_set(tx_power);
+#endif
+}
+
+uint32_t rbc_mesh_tx_power_get(rbc_mesh_txpower_t* p_tx_power)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_tx_power == NULL)
     {
         return NRF_ERROR_NULL;
     }
 
-    if (fifo_peek(&m_rbc_event_fifo, p_evt) != NRF_SUCCESS)
+    *p_tx_power = vh_tx_power_get();
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_tx_power_control_set(bool enable)
+{
+#ifdef RBC_MESH_TX_POWER_CONTROL
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
     {
-        return NRF_ERROR_NOT_FOUND;
+        return NRF_ERROR_INVALID_STATE;
     }
 
+    mesh_tx_power_control_set(enable);
     return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
 }
 
-void rbc_mesh_event_release(rbc_mesh_event_t* p_evt)
+uint32_t rbc_mesh_long_packets_set(bool enable)
+{
+#ifdef RBC_MESH_LONG_PACKETS
+    mesh_packet_payload_max_set(enable ?
+            BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH :
+            BLE_ADV_PACKET_LEGACY_PAYLOAD_MAX_LENGTH);
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_event_source_mask_set(uint8_t source_mask)
+{
+    if (source_mask & ~RBC_MESH_EVENT_SOURCE_MASK_ALL)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_event_source_mask = source_mask;
+    return NRF_SUCCESS;
+}
+
+void rbc_mesh_ble_evt_handler(ble_evt_t* p_evt)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return;
+    }
+
+    mesh_gatt_sd_ble_event_handle(p_evt);
+}
+
+void rbc_mesh_sd_evt_handler(uint32_t sd_evt)
+{
+    timeslot_sd_event_handler(sd_evt);
+}
+
+/** Whether the application has subscribed to value events for the given handle. */
+static bool handle_is_subscribed(rbc_mesh_value_handle_t handle)
+{
+    if (mp_subscriptions == NULL)
+    {
+        return true;
+    }
+    for (uint32_t i = 0; i < m_subscription_count; ++i)
+    {
+        if (handle >= mp_subscriptions[i].first &&
+            handle <= mp_subscriptions[i].last)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Get the data pointer of an event that carries a value or message short
+* enough to be copied into the event, along with its inline buffer and
+* length. NULL for all other events.
+*/
+static uint8_t** event_inline_data_get(rbc_mesh_event_t* p_evt, uint8_t** pp_inline, uint8_t* p_len)
 {
+#if (RBC_MESH_EVENT_INLINE_DATA_LEN > 0)
     switch (p_evt->type)
     {
         case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
         case RBC_MESH_EVENT_TYPE_NEW_VAL:
         case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
-            if (p_evt->params.rx.p_data != NULL)
+            if (p_evt->params.rx.p_data != NULL && p_evt->params.rx.data_len <= RBC_MESH_EVENT_INLINE_DATA_LEN)
             {
-                mesh_packet_ref_count_dec((mesh_packet_t*) p_evt->params.rx.p_data);
+                *pp_inline = p_evt->params.rx.inline_data;
+                *p_len = p_evt->params.rx.data_len;
+                return &p_evt->params.rx.p_data;
             }
             break;
         case RBC_MESH_EVENT_TYPE_TX:
-            if (p_evt->params.tx.p_data != NULL)
+            if (p_evt->params.tx.p_data != NULL && p_evt->params.tx.data_len <= RBC_MESH_EVENT_INLINE_DATA_LEN)
             {
-                mesh_packet_ref_count_dec((mesh_packet_t*) p_evt->params.tx.p_data);
+                *pp_inline = p_evt->params.tx.inline_data;
+                *p_len = p_evt->params.tx.data_len;
+                return &p_evt->params.tx.p_data;
+            }
+            break;
+        case RBC_MESH_EVENT_TYPE_ACK_MSG:
+            if (p_evt->params.ack.p_data != NULL && p_evt->params.ack.data_len <= RBC_MESH_EVENT_INLINE_DATA_LEN)
+            {
+                *pp_inline = p_evt->params.ack.inline_data;
+                *p_len = p_evt->params.ack.data_len;
+                return &p_evt->params.ack.p_data;
             }
             break;
-
         default:
             break;
     }
+#endif
+    return NULL;
 }
 
-void rbc_mesh_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb)
+/** Whether the event carries its data inline, rather than a packet reference. */
+static bool event_data_is_inline(rbc_mesh_event_t* p_evt)
 {
-    tc_packet_peek_cb_set(packet_peek_cb);
+    uint8_t* p_inline;
+    uint8_t len;
+    return (event_inline_data_get(p_evt, &p_inline, &len) != NULL);
+}
+
+/** Point the data of an event with an inline value at its own copy. The
+  copy moves with the event, so this is done every time an event is handed
+  out of the queue. */
+static void event_inline_data_fix(rbc_mesh_event_t* p_evt)
+{
+    uint8_t* p_inline;
+    uint8_t len;
+    uint8_t** pp_data = event_inline_data_get(p_evt, &p_inline, &len);
+    if (pp_data != NULL)
+    {
+        *pp_data = p_inline;
+    }
+}
+
+#ifdef RBC_MESH_EVENT_COALESCING
+/**
+* Replace a pending value event for the same handle in the app event queue with
+* the given event.
+*
+* @return Whether the event was merged into a pending event.
+*/
+static bool event_coalesce(rbc_mesh_event_t* p_event)
+{
+    if (p_event->type != RBC_MESH_EVENT_TYPE_NEW_VAL &&
+        p_event->type != RBC_MESH_EVENT_TYPE_UPDATE_VAL)
+    {
+        return false;
+    }
+
+    bool merged = false;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    /* The oldest event may be in use by the application, leave it be. */
+    for (uint32_t i = 1; i < fifo_get_len(&m_rbc_event_fifo); ++i)
+    {
+        rbc_mesh_event_t* p_pending = (rbc_mesh_event_t*) fifo_elem_ref_at(&m_rbc_event_fifo, i);
+        if ((p_pending->type == RBC_MESH_EVENT_TYPE_NEW_VAL ||
+             p_pending->type == RBC_MESH_EVENT_TYPE_UPDATE_VAL) &&
+            p_pending->params.rx.value_handle == p_event->params.rx.value_handle)
+        {
+            if (p_pending->params.rx.p_data != NULL && !event_data_is_inline(p_pending))
+            {
+                mesh_packet_ref_count_dec((mesh_packet_t*) p_pending->params.rx.p_data);
+            }
+            if (p_event->params.rx.p_data != NULL && !event_data_is_inline(p_event))
+            {
+                mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.rx.p_data); /* will be aligned by packet manager */
+            }
+            const rbc_mesh_event_type_t type = p_pending->type; /* a new value stays new */
+            const uint16_t version_delta = p_pending->params.rx.version_delta;
+            *p_pending = *p_event;
+            p_pending->type = type;
+            p_pending->params.rx.version_delta += version_delta;
+            merged = true;
+            break;
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+
+    return merged;
+}
+#endif
+
+#ifdef RBC_MESH_TX_EVENT_COALESCING
+/**
+* Replace a pending TX event for the same handle in the app event queue with
+* the given event, and add up their transmission counts.
+*
+* @return Whether the event was merged into a pending event.
+*/
+static bool tx_event_coalesce(rbc_mesh_event_t* p_event)
+{
+    if (p_event->type != RBC_MESH_EVENT_TYPE_TX)
+    {
+        return false;
+    }
+
+    bool merged = false;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    /* The oldest event may be in use by the application, leave it be. */
+    for (uint32_t i = 1; i < fifo_get_len(&m_rbc_event_fifo); ++i)
+    {
+        rbc_mesh_event_t* p_pending = (rbc_mesh_event_t*) fifo_elem_ref_at(&m_rbc_event_fifo, i);
+        if (p_pending->type == RBC_MESH_EVENT_TYPE_TX &&
+            p_pending->params.tx.value_handle == p_event->params.tx.value_handle)
+        {
+            if (p_pending->params.tx.p_data != NULL && !event_data_is_inline(p_pending))
+            {
+                mesh_packet_ref_count_dec((mesh_packet_t*) p_pending->params.tx.p_data);
+            }
+            if (p_event->params.tx.p_data != NULL && !event_data_is_inline(p_event))
+            {
+                mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.tx.p_data); /* will be aligned by packet manager */
+            }
+            uint32_t tx_count = (uint32_t) p_pending->params.tx.tx_count + p_event->params.tx.tx_count;
+            *p_pending = *p_event;
+            p_pending->params.tx.tx_count = (tx_count > UINT16_MAX ? UINT16_MAX : (uint16_t) tx_count);
+            merged = true;
+            break;
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+
+    return merged;
 }
+#endif
+
+/** Internal only function to push mesh events to application queue. */
+uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_event)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_event == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
 
+#ifdef RBC_MESH_BRIDGE
+    /* the bridge works in relay-only mode too */
+    mesh_bridge_event_handle(p_event);
+#endif
+
+    if (m_relay_only)
+    {
+        /* nobody listens, treat the event as delivered */
+        return NRF_SUCCESS;
+    }
+
+#ifdef RBC_MESH_ACK
+    if (mesh_ack_event_handle(p_event))
+    {
+        return NRF_SUCCESS;
+    }
+#endif
+
+    switch (p_event->type)
+    {
+        case RBC_MESH_EVENT_TYPE_NEW_VAL:
+        case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+        case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+        case RBC_MESH_EVENT_TYPE_VALUE_EXPIRED:
+            if (!handle_is_subscribed(p_event->params.rx.value_handle))
+            {
+                /* outside the subscriptions, the value is only relayed */
+                return NRF_SUCCESS;
+            }
+            if (p_event->type != RBC_MESH_EVENT_TYPE_VALUE_EXPIRED &&
+                !(m_event_source_mask & (1 << p_event->params.rx.source)))
+            {
+                /* the application already knows about the value */
+                return NRF_SUCCESS;
+            }
+            break;
+        default:
+            break;
+    }
+
+#ifdef RBC_MESH_SCHEDULED_VALUES
+    if (mesh_schedule_event_handle(p_event))
+    {
+        /* raised again at its activation time */
+        return NRF_SUCCESS;
+    }
+#endif
+
+    /* Short values are copied into the queued event, which doesn't take a
+       reference to their packet. The caller's event is left as it is. */
+    rbc_mesh_event_t inline_event;
+    uint8_t* p_inline;
+    uint8_t inline_len;
+    if (event_inline_data_get(p_event, &p_inline, &inline_len) != NULL)
+    {
+        inline_event = *p_event;
+        uint8_t** pp_data = event_inline_data_get(&inline_event, &p_inline, &inline_len);
+        memcpy(p_inline, *pp_data, inline_len);
+        *pp_data = p_inline;
+        p_event = &inline_event;
+    }
+
+#ifdef RBC_MESH_EVENT_COALESCING
+    if (event_coalesce(p_event))
+    {
+        return NRF_SUCCESS;
+    }
+#endif
+#ifdef RBC_MESH_TX_EVENT_COALESCING
+    if (tx_event_coalesce(p_event))
+    {
+        return NRF_SUCCESS;
+    }
+#endif
+
+    uint32_t error_code = fifo_push(&m_rbc_event_fifo, p_event);
+
+    if (error_code != NRF_SUCCESS)
+    {
+        m_app_event_stats.queue_drop++;
+    }
+    else
+    {
+        switch (p_event->type)
+        {
+            case RBC_MESH_EVENT_TYPE_NEW_VAL:
+                m_app_event_stats.new_val++;
+                break;
+            case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+                m_app_event_stats.update_val++;
+                break;
+            case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+                m_app_event_stats.conflicting_val++;
+                break;
+            case RBC_MESH_EVENT_TYPE_TX:
+                m_app_event_stats.tx++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (error_code == NRF_SUCCESS && !event_data_is_inline(p_event))
+    {
+        switch (p_event->type)
+        {
+            case RBC_MESH_EVENT_TYPE_NEW_VAL:
+            case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+            case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+                if (p_event->params.rx.p_data)
+                {
+                    mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.rx.p_data); /* will be aligned by packet manager */
+                }
+                break;
+            case RBC_MESH_EVENT_TYPE_TX:
+                if (p_event->params.tx.p_data)
+                {
+                    mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.tx.p_data); /* will be aligned by packet manager */
+                }
+                break;
+            case RBC_MESH_EVENT_TYPE_ACK_MSG:
+                if (p_event->params.ack.p_data)
+                {
+                    mesh_packet_ref_count_inc((mesh_packet_t*) p_event->params.ack.p_data); /* will be aligned by packet manager */
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return error_code;
+}
+
+uint32_t rbc_mesh_event_get(rbc_mesh_event_t* p_evt)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (fifo_pop(&m_rbc_event_fifo, p_evt) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    event_inline_data_fix(p_evt);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_event_peek(rbc_mesh_event_t* p_evt)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_evt == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (fifo_peek(&m_rbc_event_fifo, p_evt) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    event_inline_data_fix(p_evt);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_event_peek_ref(rbc_mesh_event_t** pp_evt)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (pp_evt == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (fifo_peek_ref(&m_rbc_event_fifo, (void**) pp_evt) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    event_inline_data_fix(*pp_evt);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_event_consume(void)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    rbc_mesh_event_t* p_evt;
+    if (fifo_peek_ref(&m_rbc_event_fifo, (void**) &p_evt) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    rbc_mesh_event_release(p_evt);
+    fifo_release(&m_rbc_event_fifo);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_events_get(rbc_mesh_event_t* p_evts, uint32_t* p_count)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_evts == NULL || p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    uint32_t count = 0;
+    rbc_mesh_event_t* p_evt;
+    while (count < *p_count &&
+           fifo_peek_ref(&m_rbc_event_fifo, (void**) &p_evt) == NRF_SUCCESS)
+    {
+        p_evts[count] = *p_evt;
+        event_inline_data_fix(&p_evts[count++]);
+        fifo_release(&m_rbc_event_fifo);
+    }
+    *p_count = count;
+
+    return (count > 0) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND;
+}
+
+void rbc_mesh_event_release(rbc_mesh_event_t* p_evt)
+{
+    if (event_data_is_inline(p_evt))
+    {
+        return;
+    }
+    switch (p_evt->type)
+    {
+        case RBC_MESH_EVENT_TYPE_UPDATE_VAL:
+        case RBC_MESH_EVENT_TYPE_NEW_VAL:
+        case RBC_MESH_EVENT_TYPE_CONFLICTING_VAL:
+            if (p_evt->params.rx.p_data != NULL)
+            {
+                mesh_packet_ref_count_dec((mesh_packet_t*) p_evt->params.rx.p_data);
+            }
+            break;
+        case RBC_MESH_EVENT_TYPE_TX:
+            if (p_evt->params.tx.p_data != NULL)
+            {
+                mesh_packet_ref_count_dec((mesh_packet_t*) p_evt->params.tx.p_data);
+            }
+            break;
+        case RBC_MESH_EVENT_TYPE_ACK_MSG:
+            if (p_evt->params.ack.p_data != NULL)
+            {
+                mesh_packet_ref_count_dec((mesh_packet_t*) p_evt->params.ack.p_data);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void rbc_mesh_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb)
+{
+    tc_packet_peek_cb_set(packet_peek_cb);
+}
+
+uint32_t rbc_mesh_rx_filter_set(rbc_mesh_rx_filter_mode_t mode,
+        const rbc_mesh_handle_range_t* p_ranges,
+        uint8_t range_count)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (mode != RBC_MESH_RX_FILTER_OFF)
+    {
+        if (mode > RBC_MESH_RX_FILTER_REJECT ||
+            range_count > RBC_MESH_RX_FILTER_RANGES_MAX)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        if (p_ranges == NULL && range_count > 0)
+        {
+            return NRF_ERROR_NULL;
+        }
+        for (uint32_t i = 0; i < range_count; ++i)
+        {
+            if (p_ranges[i].last < p_ranges[i].first)
+            {
+                return NRF_ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    tc_rx_filter_set(mode, p_ranges, range_count);
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_instance_add(const rbc_mesh_instance_params_t* p_params)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_params->trickle_class >= RBC_MESH_TRICKLE_CLASS_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    uint32_t error_code = tc_instance_add(p_params->access_addr, &p_params->handles);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    /* both tables have room for RBC_MESH_INSTANCES_MAX ranges */
+    error_code = handle_storage_class_range_add(&p_params->handles, p_params->trickle_class);
+    APP_ERROR_CHECK(error_code);
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_bridge_add(const rbc_mesh_bridge_entry_t* p_entry)
+{
+#ifdef RBC_MESH_BRIDGE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_bridge_add(p_entry);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_conflict_resolver_set(rbc_mesh_conflict_resolver_t resolver)
+{
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return vh_conflict_resolver_set(resolver);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_rx_hook_set(rbc_mesh_value_handle_t handle, rbc_mesh_rx_hook_t hook)
+{
+#ifdef RBC_MESH_RX_HOOKS
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_rx_hook_set(handle, hook);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_dfu_share_set(uint8_t percent)
+{
+#ifdef RBC_MESH_DFU_QOS
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return tc_dfu_share_set(percent);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_encryption_key_set(const uint8_t* p_key)
+{
+#ifdef RBC_MESH_ENCRYPTION
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_crypt_key_set(p_key);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_ack_init(const rbc_mesh_ack_params_t* p_params)
+{
+#ifdef RBC_MESH_ACK
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_ack_init(p_params);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_ack_send(uint16_t node_id, const uint8_t* p_data, uint8_t len)
+{
+#ifdef RBC_MESH_ACK
+    return mesh_ack_send(node_id, p_data, len);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_neighbor_get(uint8_t index, rbc_mesh_neighbor_t* p_neighbor)
+{
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_neighbor_get(index, p_neighbor);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_neighbor_table_clear(void)
+{
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    mesh_neighbor_table_clear();
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_scan_duty_cycle_set(uint32_t window_us, uint32_t interval_us)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (interval_us != 0 &&
+        (window_us < RBC_MESH_SCAN_WINDOW_MIN_US ||
+         window_us > interval_us ||
+         interval_us > RBC_MESH_SCAN_INTERVAL_MAX_US))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+#ifdef RBC_MESH_STANDALONE
+    /* the radio has nothing to share its time with */
+    return NRF_ERROR_NOT_SUPPORTED;
+#else
+    timeslot_scan_duty_cycle_set(window_us, interval_us);
+    return NRF_SUCCESS;
+#endif
+}
+
+uint32_t rbc_mesh_latency_mode_set(uint32_t period_us)
+{
+#if defined(RBC_MESH_TIMESLOT_LATENCY_MODE) && !defined(RBC_MESH_STANDALONE)
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (period_us != 0 &&
+        (period_us < RBC_MESH_LATENCY_PERIOD_MIN_US ||
+         period_us > RBC_MESH_SCAN_INTERVAL_MAX_US))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    timeslot_latency_mode_set(period_us);
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_packet_pool_stats_get(rbc_mesh_packet_pool_stats_t* p_stats)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    mesh_packet_pool_stats_get(p_stats);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_timeslot_stats_get(rbc_mesh_timeslot_stats_t* p_stats)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    timeslot_stats_get(p_stats);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_time_get(rbc_mesh_time_t* p_time)
+{
+#ifdef RBC_MESH_TIME_SYNC
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_time == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    vh_time_get(p_time);
+
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_probe_send(uint16_t target, uint8_t* p_seq)
+{
+#ifdef RBC_MESH_LATENCY_PROBE
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return vh_probe_send(target, p_seq);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_stats_get(rbc_mesh_stats_t* p_stats)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    memset(p_stats, 0, sizeof(rbc_mesh_stats_t));
+    tc_stats_get(p_stats);
+    event_handler_stats_get(p_stats);
+    p_stats->app_new_val = m_app_event_stats.new_val;
+    p_stats->app_update_val = m_app_event_stats.update_val;
+    p_stats->app_conflicting_val = m_app_event_stats.conflicting_val;
+    p_stats->app_tx = m_app_event_stats.tx;
+    p_stats->app_queue_drop = m_app_event_stats.queue_drop;
+    p_stats->trickle_resets = trickle_reset_count_get();
+    p_stats->rx_duplicates = vh_rx_duplicate_count_get();
+#ifdef RBC_MESH_NETWORK_CODING
+    vh_netcode_stats_get(p_stats);
+#endif
+#ifdef RBC_MESH_RX_HOOKS
+    vh_rx_hook_stats_get(p_stats);
+#endif
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+    p_stats->persistent_drop = value_flash_drop_count_get();
+#endif
+    p_stats->tx_deferred = radio_tx_deferred_count_get();
+    mesh_packet_pool_stats_get(&p_stats->packet_pool);
+    timeslot_stats_get(&p_stats->timeslot);
+    radio_stats_get(&p_stats->radio);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_handle_stats_get(rbc_mesh_value_handle_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset)
+{
+#ifdef RBC_MESH_HANDLE_STATS
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    return vh_handle_stats_get(handle, p_stats, reset);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_isr_stats_get(rbc_mesh_isr_t isr, rbc_mesh_isr_stats_t* p_stats, bool reset)
+{
+#ifdef RBC_MESH_ISR_STATS
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    return isr_stats_get(isr, p_stats, reset);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_ram_stats_get(rbc_mesh_ram_stats_t* p_stats)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    memset(p_stats, 0, sizeof(rbc_mesh_ram_stats_t));
+#ifdef RBC_MESH_STACK_WATERMARK
+    p_stats->stack_size = mesh_stack_size_get();
+    p_stats->stack_used = mesh_stack_used_get();
+#endif
+    handle_storage_ram_get(&p_stats->handle_cache, &p_stats->data_cache);
+    rbc_mesh_packet_pool_stats_t pool_stats;
+    mesh_packet_pool_stats_get(&pool_stats);
+    p_stats->packet_pool = mesh_packet_memory_size_get(pool_stats.pool_size);
+    p_stats->event_queues = event_handler_ram_size_get();
+    p_stats->app_event_queue = sizeof(rbc_mesh_event_t) * m_rbc_event_fifo.array_len;
+    p_stats->radio_queue = radio_ram_size_get();
+#ifdef RBC_MESH_SERIAL
+    p_stats->serial_buffers = serial_handler_ram_size_get();
+#endif
+    return NRF_SUCCESS;
+}
+
+uint32_t rbc_mesh_propagation_stats_get(rbc_mesh_propagation_stats_t* p_stats, bool reset)
+{
+#ifdef RBC_MESH_ORIGIN_TIME
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    vh_propagation_stats_get(p_stats, reset);
+
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_ttl_set(rbc_mesh_value_handle_t handle, uint32_t ttl_ms)
+{
+#ifdef RBC_MESH_VALUE_TTL
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint32_t ticks = ttl_ms / RBC_MESH_VALUE_TTL_TICK_MS + (ttl_ms % RBC_MESH_VALUE_TTL_TICK_MS != 0);
+    if (ticks > UINT16_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    return vh_value_ttl_set(handle, ticks);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_write_combine_set(rbc_mesh_value_handle_t handle, uint16_t window_ms)
+{
+#ifdef RBC_MESH_WRITE_COMBINING
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_write_combine_set(handle, window_ms);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_hop_scope_set(rbc_mesh_value_handle_t handle, uint8_t hops)
+{
+#ifdef RBC_MESH_HOP_SCOPES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return vh_hop_scope_set(handle, hops);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_segmented_value_enable(rbc_mesh_value_handle_t handle)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_group(handle) || mesh_group_is_component(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+#ifdef RBC_MESH_TIME_SERIES
+    if (mesh_series_is_series(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+
+    return mesh_segment_enable(handle);
+}
+
+uint32_t rbc_mesh_segmented_value_set(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_segment_local_update(handle, data, len);
+}
+
+uint32_t rbc_mesh_segmented_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* len)
+{
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_segment_value_get(handle, data, len);
+}
+
+uint32_t rbc_mesh_group_add(rbc_mesh_value_handle_t group_handle, const rbc_mesh_value_handle_t* p_components, uint8_t count)
+{
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_group_add(group_handle, p_components, count);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_group_set(rbc_mesh_value_handle_t group_handle, uint8_t* const* pp_data, const uint16_t* p_lens)
+{
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (pp_data == NULL || p_lens == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    return mesh_group_local_update(group_handle, pp_data, p_lens);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_group_unpack(rbc_mesh_value_handle_t group_handle,
+        const uint8_t* p_data,
+        uint16_t len,
+        const uint8_t** pp_data,
+        uint16_t* p_lens,
+        uint8_t* p_count)
+{
+#ifdef RBC_MESH_VALUE_GROUPS
+    return mesh_group_unpack(group_handle, p_data, len, pp_data, p_lens, p_count);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_series_enable(rbc_mesh_value_handle_t handle, uint8_t batch_count)
+{
+#ifdef RBC_MESH_TIME_SERIES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_series_enable(handle, batch_count);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_series_sample_add(rbc_mesh_value_handle_t handle, uint32_t timestamp_ms, int32_t value)
+{
+#ifdef RBC_MESH_TIME_SERIES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_series_sample_add(handle, timestamp_ms, value);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_series_flush(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_TIME_SERIES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return mesh_series_flush(handle);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_series_unpack(const uint8_t* p_data,
+        uint16_t len,
+        uint32_t* p_first_index,
+        rbc_mesh_series_sample_t* p_samples,
+        uint8_t* p_count)
+{
+#ifdef RBC_MESH_TIME_SERIES
+    return mesh_series_unpack(p_data, len, p_first_index, p_samples, p_count);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_shadow_add(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_VALUE_SHADOW
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return mesh_shadow_add(handle);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_channel_stats_get(uint8_t channel, rbc_mesh_channel_stats_t* p_stats)
+{
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    return tc_channel_stats_get(channel, p_stats);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_scheduled_value_enable(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_SCHEDULED_VALUES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_group(handle) || mesh_group_is_component(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+#ifdef RBC_MESH_TIME_SERIES
+    if (mesh_series_is_series(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+
+    return mesh_schedule_enable(handle);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_set_at(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t len, uint32_t activation_time_us)
+{
+#ifdef RBC_MESH_SCHEDULED_VALUES
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (!mesh_schedule_is_scheduled(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (len > RBC_MESH_VALUE_MAX_LEN - RBC_MESH_SCHEDULE_OVERHEAD)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (data == NULL && len > 0)
+    {
+        return NRF_ERROR_NULL;
+    }
+    rbc_mesh_time_t time;
+    vh_time_get(&time);
+    if ((int32_t) (activation_time_us - time.time_us) > RBC_MESH_SCHEDULE_MAX_AHEAD_US)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    uint8_t value[RBC_MESH_VALUE_MAX_LEN];
+    value[0] = (uint8_t) activation_time_us;
+    value[1] = (uint8_t) (activation_time_us >> 8);
+    value[2] = (uint8_t) (activation_time_us >> 16);
+    value[3] = (uint8_t) (activation_time_us >> 24);
+    if (len > 0)
+    {
+        memcpy(&value[RBC_MESH_SCHEDULE_OVERHEAD], data, len);
+    }
+    len += RBC_MESH_SCHEDULE_OVERHEAD;
+
+    uint32_t error_code = rbc_mesh_value_set(handle, value, len);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    return mesh_schedule_local(handle, value, len);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_history_enable(rbc_mesh_value_handle_t handle)
+{
+#ifdef RBC_MESH_VALUE_HISTORY
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handle > RBC_MESH_APP_MAX_HANDLE || mesh_segment_is_segmented(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#ifdef RBC_MESH_VALUE_GROUPS
+    if (mesh_group_is_group(handle) || mesh_group_is_component(handle))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+#endif
+
+    return value_history_enable(handle);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t rbc_mesh_value_history_get(rbc_mesh_value_handle_t handle, uint16_t after_version, rbc_mesh_history_entry_t* p_entry)
+{
+#ifdef RBC_MESH_VALUE_HISTORY
+    if (m_mesh_state == MESH_STATE_UNINITIALIZED)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_entry == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    return value_history_get(handle, after_version, p_entry);
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
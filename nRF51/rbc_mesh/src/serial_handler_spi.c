@@ -49,6 +49,19 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define SERIAL_QUEUE_SIZE       (4)
 
+/** @brief Max number of frames packed into a single SPI transaction, in each
+    direction. */
+#ifndef SERIAL_SPI_FRAMES_PER_XFER
+#define SERIAL_SPI_FRAMES_PER_XFER  (SERIAL_QUEUE_SIZE)
+#endif
+
+/** @brief Size of the SPI transaction buffers: status byte + frames. */
+#define SERIAL_SPI_XFER_LEN     (1 + SERIAL_SPI_FRAMES_PER_XFER * (SERIAL_DATA_MAX_LEN + 2))
+
+#if SERIAL_SPI_XFER_LEN > 255
+#error "SPIS transactions are limited to 255 bytes, reduce SERIAL_SPI_FRAMES_PER_XFER"
+#endif
+
 #define SERIAL_REQN_GPIOTE_CH   (0)
 
 /*****************************************************************************
@@ -73,13 +86,17 @@ static serial_data_t tx_fifo_buffer[SERIAL_QUEUE_SIZE];
 
 
 static uint8_t dummy_data = 0;
-static serial_data_t rx_buffer;
-static serial_data_t tx_buffer;
+static uint8_t rx_buffer[SERIAL_SPI_XFER_LEN];
+static uint8_t tx_buffer[SERIAL_SPI_XFER_LEN];
+static uint8_t tx_frame_count = 0; /**< Frames in tx_buffer, still at the head of tx_fifo. */
+static uint8_t rx_pos = 0; /**< Parse position in rx_buffer. */
+static uint8_t rx_len = 0; /**< Bytes received in the last transaction. */
 
 static serial_state_t serial_state;
 static bool has_pending_tx = false;
 static bool doing_tx = false;
 static bool suspend = false;
+static bool tx_blocked = false; /**< An event was rejected since the last transaction. */
 
 /*****************************************************************************
 * Static functions
@@ -89,6 +106,25 @@ static void mesh_aci_command_check_cb(void* p_context)
     mesh_aci_command_check();
 }
 
+static void mesh_aci_event_flush_cb(void* p_context)
+{
+    mesh_aci_event_flush();
+}
+
+/** @brief Let the ACI retry the events it couldn't queue, now that there's room. */
+static void tx_room_notify(void)
+{
+    if (tx_blocked)
+    {
+        tx_blocked = false;
+        async_event_t async_evt;
+        async_evt.type = EVENT_TYPE_GENERIC;
+        async_evt.callback.generic.cb = mesh_aci_event_flush_cb;
+        async_evt.callback.generic.p_context = NULL;
+        event_handler_push(&async_evt);
+    }
+}
+
 static void enable_pin_listener(bool enable)
 {
     if (enable)
@@ -106,20 +142,112 @@ static void prepare_rx(void)
 {
     uint32_t error_code;
     error_code = spi_slave_buffers_set(&dummy_data,
-                                      rx_buffer.buffer,
+                                      rx_buffer,
                                       1,
-                                      SERIAL_DATA_MAX_LEN - 2);
+                                      sizeof(rx_buffer));
     APP_ERROR_CHECK(error_code);
     has_pending_tx = false;
 }
 
+/**
+* @brief Pack as many queued events as will fit into the tx buffer, after the
+*   status byte. The events stay in the tx queue until the master has clocked
+*   them out.
+*
+* @return Length of the transaction, or 0 if there were no events to send.
+*/
+static uint32_t tx_xfer_pack(void)
+{
+    serial_data_t frame;
+    uint32_t tx_len = 1;
+    tx_buffer[0] = 0; /* status byte */
+    tx_frame_count = 0;
+
+    while (tx_frame_count < SERIAL_SPI_FRAMES_PER_XFER &&
+           fifo_peek_at(&tx_fifo, &frame, tx_frame_count) == NRF_SUCCESS)
+    {
+        uint32_t frame_len = frame.buffer[SERIAL_LENGTH_POS] + 1;
+        if (tx_len + frame_len > sizeof(tx_buffer))
+        {
+            break;
+        }
+        memcpy(&tx_buffer[tx_len], frame.buffer, frame_len);
+        tx_len += frame_len;
+        tx_frame_count++;
+    }
+
+    return (tx_frame_count > 0 ? tx_len : 0);
+}
+
+/**
+* @brief Release the events the master clocked out. Events it didn't get all
+*   of stay at the head of the queue, and go in the next transaction.
+*/
+static void tx_xfer_release(uint32_t tx_amount)
+{
+    uint32_t pos = 1;
+    for (uint32_t i = 0; i < tx_frame_count; ++i)
+    {
+        pos += tx_buffer[pos] + 1;
+        if (pos > tx_amount)
+        {
+            break;
+        }
+        fifo_pop(&tx_fifo, NULL);
+        tx_room_notify();
+    }
+    tx_frame_count = 0;
+}
+
+/**
+* @brief Push the commands from the last transaction to the rx queue. The
+*   master ends the command list with a 0-length byte, or by ending the
+*   transaction.
+*
+* @return Whether all commands in the transaction have been queued.
+*/
+static bool rx_xfer_process(void)
+{
+    bool pushed = false;
+    while (rx_pos < rx_len && !fifo_is_full(&rx_fifo))
+    {
+        uint8_t len = rx_buffer[rx_pos + SERIAL_LENGTH_POS];
+        if (len == 0 ||
+            len > SERIAL_DATA_MAX_LEN ||
+            rx_pos + len + 1 > rx_len)
+        {
+            /* end of command list, or truncated command */
+            rx_pos = rx_len;
+            break;
+        }
+
+        serial_data_t frame;
+        frame.status_byte = 0;
+        memcpy(frame.buffer, &rx_buffer[rx_pos], len + 1);
+        fifo_push(&rx_fifo, &frame);
+        rx_pos += len + 1;
+        pushed = true;
+    }
+
+    if (pushed)
+    {
+        /* notify ACI handler */
+        async_event_t async_evt;
+        memset(&async_evt, 0, sizeof(async_event_t));
+        async_evt.callback.generic.cb = mesh_aci_command_check_cb;
+        async_evt.type = EVENT_TYPE_GENERIC;
+        event_handler_push(&async_evt);
+    }
+
+    return (rx_pos >= rx_len);
+}
+
 /**
 * @brief Called when master requests send, or we want to notify master
 */
 static void do_transmit(void)
 {
-    uint8_t* tx_ptr = &dummy_data;
-    uint8_t tx_len = 0;
+    uint32_t tx_len;
     uint32_t error_code;
 
     serial_state = SERIAL_STATE_TRANSMIT;
@@ -130,13 +258,11 @@ static void do_transmit(void)
 
     bool ordered_buffer = false;
 
-    if (fifo_pop(&tx_fifo, &tx_buffer) == NRF_SUCCESS)
+    tx_len = tx_xfer_pack();
+    if (tx_len > 0)
     {
-        tx_len = tx_buffer.buffer[SERIAL_LENGTH_POS] + 2;
-        tx_ptr = (uint8_t*) &tx_buffer;
-        memset(rx_buffer.buffer, 0, SERIAL_DATA_MAX_LEN);
-        error_code = spi_slave_buffers_set(tx_ptr,
-                                          rx_buffer.buffer,
+        error_code = spi_slave_buffers_set(tx_buffer,
+                                          rx_buffer,
                                           tx_len,
                                           sizeof(rx_buffer));
         APP_ERROR_CHECK(error_code);
@@ -152,6 +278,35 @@ static void do_transmit(void)
     /* wait for SPI driver to finish buffer set operation */
 }
 
+/**
+* @brief Move on to the next transaction, once the commands in the previous
+*   one have made it to the rx queue.
+*/
+static void xfer_next(void)
+{
+    if (!rx_xfer_process())
+    {
+        /* the rx buffer still holds commands, can't re-arm it before the
+        application has made room for them in the rx queue. */
+        serial_state = SERIAL_STATE_WAIT_FOR_QUEUE;
+    }
+    else if (fifo_is_empty(&tx_fifo))
+    {
+        serial_state = SERIAL_STATE_IDLE;
+        prepare_rx();
+        enable_pin_listener(true);
+    }
+    else if (fifo_is_full(&rx_fifo))
+    {
+        prepare_rx();
+        serial_state = SERIAL_STATE_WAIT_FOR_QUEUE;
+    }
+    else
+    {
+        do_transmit();
+    }
+}
+
 static void gpiote_init(void)
 {
     NRF_GPIO->PIN_CNF[PIN_CSN] = (GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos)
@@ -219,50 +374,19 @@ void spi_event_handler(spi_slave_evt_t evt)
             if (doing_tx)
             {
                 doing_tx = false;
-                if (evt.tx_amount < tx_buffer.buffer[SERIAL_LENGTH_POS] + 2)
-                {
-                    /* master failed to receive our event. Re-send it. */
-                    serial_handler_event_send((serial_evt_t*)tx_buffer.buffer);
-                }
+                /* events the master didn't receive are re-sent in the next
+                transaction. */
+                tx_xfer_release(evt.tx_amount);
             }
             /* handle incoming */
-            if (rx_buffer.buffer[SERIAL_LENGTH_POS] > 0)
-            {
-                if (fifo_push(&rx_fifo, &rx_buffer) == NRF_SUCCESS)
-                {
-
-                    /* notify ACI handler */
-                    async_event_t async_evt;
-                    memset(&async_evt, 0, sizeof(async_event_t));
-                    async_evt.callback.generic.cb = mesh_aci_command_check_cb;
-                    async_evt.type = EVENT_TYPE_GENERIC;
-                    event_handler_push(&async_evt);
-                }
-                else
-                {
-                    APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
-                }
-            }
+            rx_pos = 0;
+            rx_len = evt.rx_amount;
             if (suspend)
             {
+                rx_xfer_process();
                 return;
             }
-            if (fifo_is_empty(&tx_fifo))
-            {
-                serial_state = SERIAL_STATE_IDLE;
-                prepare_rx();
-                enable_pin_listener(true);
-            }
-            else if (fifo_is_full(&rx_fifo))
-            {
-                prepare_rx();
-                serial_state = SERIAL_STATE_WAIT_FOR_QUEUE;
-            }
-            else
-            {
-                do_transmit();
-            }
-
+            xfer_next();
             break;
 
         default:
@@ -336,6 +460,7 @@ bool serial_handler_event_send(serial_evt_t* evt)
 {
     if (fifo_is_full(&tx_fifo))
     {
+        tx_blocked = true;
         return false;
     }
 
@@ -361,6 +486,18 @@ bool serial_handler_event_send(serial_evt_t* evt)
     return true;
 }
 
+uint32_t serial_handler_ram_size_get(void)
+{
+    return sizeof(rx_fifo_buffer) + sizeof(tx_fifo_buffer) +
+           sizeof(rx_buffer) + sizeof(tx_buffer);
+}
+
+uint32_t serial_handler_baudrate_set(uint32_t baudrate)
+{
+    /* the SPI clock is driven by the host */
+    return NRF_ERROR_NOT_SUPPORTED;
+}
+
 bool serial_handler_command_get(serial_cmd_t* cmd)
 {
     /* want to do this without being pre-empted, as there's a potential
@@ -384,7 +521,14 @@ bool serial_handler_command_get(serial_cmd_t* cmd)
     if (serial_state == SERIAL_STATE_WAIT_FOR_QUEUE)
     {
         /* would have race condition here with several irq contexts */
-        do_transmit();
+        if (rx_pos < rx_len)
+        {
+            xfer_next();
+        }
+        else
+        {
+            do_transmit();
+        }
     }
     else if (serial_state == SERIAL_STATE_IDLE)
     {
@@ -31,6 +31,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "event_handler.h"
 #include "rbc_mesh_common.h"
 #include "fifo.h"
+#include "isr_stats.h"
+#include "mesh_crc.h"
 
 #include "nrf_soc.h"
 #include "boards.h"
@@ -41,6 +43,23 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define SERIAL_QUEUE_SIZE       (4)
 
+#ifdef SERIAL_UART_FRAMED
+#define SLIP_END                (0xC0)
+#define SLIP_ESC                (0xDB)
+#define SLIP_ESC_END            (0xDC)
+#define SLIP_ESC_ESC            (0xDD)
+
+#define FRAME_TYPE_DATA         (0x00) /**< Carries a command or an event. */
+#define FRAME_TYPE_ACK          (0x01) /**< Reports the next expected sequence number. */
+#define FRAME_TYPE_NACK         (0x02) /**< Asks for the frame with the given sequence number. */
+#define FRAME_TYPE_SYNC         (0x03) /**< Starts the sequence numbers over from the given one. */
+#define FRAME_HEADER_LEN        (3) /**< Type, sequence number and ack. */
+#define FRAME_CRC_LEN           (2)
+#define FRAME_MAX_LEN           (FRAME_HEADER_LEN + SERIAL_DATA_MAX_LEN + 2 + FRAME_CRC_LEN)
+/** Frames a command can be ahead of the next expected one and still be kept. */
+#define FRAME_RX_WINDOW         (SERIAL_QUEUE_SIZE)
+#endif
+
 /*****************************************************************************
 * Static types
 *****************************************************************************/
@@ -53,16 +72,52 @@ typedef enum
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
-static fifo_t           m_rx_fifo;
+static fifo_t           m_rx_fifo; /**< SPSC, UART IRQ -> command handler */
 static fifo_t           m_tx_fifo;
 static serial_data_t    m_rx_fifo_buffer[SERIAL_QUEUE_SIZE];
 static serial_data_t    m_tx_fifo_buffer[SERIAL_QUEUE_SIZE];
 
 static serial_state_t   m_serial_state;
+#ifndef SERIAL_UART_FRAMED
 static serial_data_t    m_tx_buffer;
+#endif
 static uint32_t         m_tx_len;
 static uint8_t*         mp_tx_ptr;
 static bool             m_suspend;
+static uint32_t         m_pending_baudrate; /**< BAUDRATE register value to switch to, or 0. */
+static bool             m_tx_blocked; /**< An event was rejected since the last TX. */
+
+#ifdef SERIAL_UART_FRAMED
+static uint8_t          m_tx_frame[2 * FRAME_MAX_LEN + 2]; /**< SLIP encoded frame being sent. */
+static serial_data_t    m_tx_history[SERIAL_UART_RETX_COUNT]; /**< Sent events, with their sequence number in the status byte. */
+static uint8_t          m_tx_seq; /**< Sequence number of the next new event. */
+static uint32_t         m_retx_mask; /**< History slots the host asked for again. */
+static bool             m_ctrl_pending;
+static uint8_t          m_ctrl_type;
+static uint8_t          m_ctrl_seq;
+
+static uint8_t          m_rx_frame[FRAME_MAX_LEN + 1]; /**< Decoded frame being received, one byte too long to spot overruns. */
+static uint32_t         m_rx_frame_len;
+static bool             m_rx_escape;
+static uint8_t          m_rx_seq; /**< Sequence number of the next expected command. */
+static serial_data_t    m_rx_reorder; /**< Command received ahead of a lost one, with its sequence number in the status byte. */
+static bool             m_rx_reorder_valid;
+#endif
+
+/** Baudrates the host may switch to, all with hardware flow control. */
+static const struct
+{
+    uint32_t baudrate;
+    uint32_t reg_value;
+} m_baudrates[] =
+{
+    {115200,  UART_BAUDRATE_BAUDRATE_Baud115200},
+    {230400,  UART_BAUDRATE_BAUDRATE_Baud230400},
+    {250000,  UART_BAUDRATE_BAUDRATE_Baud250000},
+    {460800,  UART_BAUDRATE_BAUDRATE_Baud460800},
+    {921600,  UART_BAUDRATE_BAUDRATE_Baud921600},
+    {1000000, UART_BAUDRATE_BAUDRATE_Baud1M},
+};
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
@@ -77,20 +132,144 @@ static void mesh_aci_command_check_cb(void* p_context)
 {
     mesh_aci_command_check();
 }
+
+static void mesh_aci_event_flush_cb(void* p_context)
+{
+    mesh_aci_event_flush();
+}
+#endif
+
+
+#ifdef SERIAL_UART_FRAMED
+static uint32_t slip_put(uint8_t* p_dst, uint8_t c)
+{
+    if (c == SLIP_END || c == SLIP_ESC)
+    {
+        p_dst[0] = SLIP_ESC;
+        p_dst[1] = (c == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        return 2;
+    }
+    p_dst[0] = c;
+    return 1;
+}
+
+/** @brief SLIP encode a frame into the TX frame buffer, and point the UART at it. */
+static void frame_encode(uint8_t type, uint8_t seq, const uint8_t* p_payload, uint32_t payload_len)
+{
+    uint8_t header[FRAME_HEADER_LEN] = {type, seq, m_rx_seq};
+    uint16_t crc = mesh_crc16(header, FRAME_HEADER_LEN, 0xFFFF);
+    crc = mesh_crc16(p_payload, payload_len, crc);
+
+    uint8_t* p_dst = m_tx_frame;
+    /* the leading delimiter ends any line noise the host has picked up */
+    *(p_dst++) = SLIP_END;
+    for (uint32_t i = 0; i < FRAME_HEADER_LEN; ++i)
+    {
+        p_dst += slip_put(p_dst, header[i]);
+    }
+    for (uint32_t i = 0; i < payload_len; ++i)
+    {
+        p_dst += slip_put(p_dst, p_payload[i]);
+    }
+    p_dst += slip_put(p_dst, (uint8_t) (crc & 0xFF));
+    p_dst += slip_put(p_dst, (uint8_t) (crc >> 8));
+    *(p_dst++) = SLIP_END;
+
+    mp_tx_ptr = m_tx_frame;
+    m_tx_len = (uint32_t) (p_dst - m_tx_frame) - 1; /* the first byte is pushed right away */
+}
+
+/**
+* @brief Encode the next frame to send: a control frame, then the events the
+*   host asked for again, then new events.
+*
+* @return Whether there was anything to send.
+*/
+static bool frame_tx_prepare(void)
+{
+    bool found = true;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (m_ctrl_pending)
+    {
+        m_ctrl_pending = false;
+        frame_encode(m_ctrl_type, m_ctrl_seq, NULL, 0);
+    }
+    else if (m_retx_mask != 0)
+    {
+        uint32_t slot = 0;
+        while (!(m_retx_mask & (1 << slot)))
+        {
+            slot++;
+        }
+        m_retx_mask &= ~(1 << slot);
+        serial_data_t* p_data = &m_tx_history[slot];
+        frame_encode(FRAME_TYPE_DATA, p_data->status_byte, p_data->buffer, p_data->buffer[0] + 1);
+    }
+    else
+    {
+        uint32_t slot = m_tx_seq & (SERIAL_UART_RETX_COUNT - 1);
+        serial_data_t* p_data = &m_tx_history[slot];
+        if (fifo_pop(&m_tx_fifo, p_data) == NRF_SUCCESS)
+        {
+            p_data->status_byte = m_tx_seq++;
+            frame_encode(FRAME_TYPE_DATA, p_data->status_byte, p_data->buffer, p_data->buffer[0] + 1);
+        }
+        else
+        {
+            found = false;
+        }
+    }
+    _ENABLE_IRQS(was_masked);
+    return found;
+}
 #endif
 
+/** @brief Whether there's anything left to send. */
+static bool tx_pending(void)
+{
+#ifdef SERIAL_UART_FRAMED
+    if (m_ctrl_pending || m_retx_mask != 0)
+    {
+        return true;
+    }
+#endif
+    return !fifo_is_empty(&m_tx_fifo);
+}
 
 /** @brief Process packet queue, always done in the async context */
 static void do_transmit(void* p_context)
 {
+#ifdef SERIAL_UART_FRAMED
+    if (frame_tx_prepare())
+    {
+#else
     if (fifo_pop(&m_tx_fifo, &m_tx_buffer) == NRF_SUCCESS)
     {
         m_tx_len = ((serial_evt_t*) m_tx_buffer.buffer)->length; /* should be serial_evt_t->length+1, but will be decremented after the push below, so we don't bother */
         mp_tx_ptr = &m_tx_buffer.buffer[0];
+#endif
 
         NRF_UART0->EVENTS_TXDRDY = 0;
         NRF_UART0->TASKS_STARTTX = 1;
         NRF_UART0->TXD = *(mp_tx_ptr++);
+#ifndef BOOTLOADER
+        if (m_tx_blocked)
+        {
+            /* already in the async context */
+            m_tx_blocked = false;
+            mesh_aci_event_flush();
+        }
+#endif
+    }
+}
+
+static void pending_baudrate_apply(void)
+{
+    if (m_pending_baudrate != 0)
+    {
+        NRF_UART0->BAUDRATE = (m_pending_baudrate << UART_BAUDRATE_BAUDRATE_Pos);
+        m_pending_baudrate = 0;
     }
 }
 
@@ -115,46 +294,207 @@ static void schedule_transmit(void)
     }
 }
 
-static void char_rx(uint8_t c)
+/**
+* @brief Hand a complete command to the command handler, or reject it if it
+*   was received while the RX queue was full.
+*/
+static void command_rx_end(bool overflow, uint8_t opcode)
 {
-    static serial_data_t rx_buf = {0};
-    static uint8_t* pp = rx_buf.buffer;
+    if (overflow)
+    {
+        /* respond inline, queue was full */
+        serial_evt_t fail_evt;
+        fail_evt.length = 3;
+        fail_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
+        fail_evt.params.cmd_rsp.command_opcode = opcode;
+        fail_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_BUSY;
+        serial_handler_event_send(&fail_evt);
+    }
+    else
+    {
+        fifo_commit(&m_rx_fifo);
+#ifdef BOOTLOADER
+        NVIC_SetPendingIRQ(SWI2_IRQn);
+#else
+        async_event_t async_evt;
+        async_evt.type = EVENT_TYPE_GENERIC;
+        async_evt.callback.generic.cb = mesh_aci_command_check_cb;
+        async_evt.callback.generic.p_context = NULL;
+        event_handler_push(&async_evt);
+#endif
+    }
 
-    *(pp++) = c;
+    if (fifo_is_full(&m_rx_fifo))
+    {
+        m_serial_state = SERIAL_STATE_WAIT_FOR_QUEUE;
+        NRF_UART0->TASKS_STOPRX = 1;
+    }
+}
 
-    uint32_t len = (uint32_t)(pp - rx_buf.buffer);
-    if (len >= sizeof(rx_buf) || (len > 1 && len >= rx_buf.buffer[0] + 1)) /* end of command */
+#ifdef SERIAL_UART_FRAMED
+static void command_put(const uint8_t* p_cmd, uint32_t len)
+{
+    serial_data_t* p_rx_buf;
+    bool overflow = (fifo_reserve(&m_rx_fifo, (void**) &p_rx_buf) != NRF_SUCCESS);
+    if (!overflow)
     {
-        if (fifo_push(&m_rx_fifo, &rx_buf) != NRF_SUCCESS)
+        memcpy(p_rx_buf->buffer, p_cmd, len);
+    }
+    command_rx_end(overflow, ((serial_cmd_t*) p_cmd)->opcode);
+}
+
+static void ctrl_send(uint8_t type, uint8_t seq)
+{
+    /* only the newest control frame matters */
+    m_ctrl_type = type;
+    m_ctrl_seq = seq;
+    m_ctrl_pending = true;
+}
+
+static void retransmit_request(uint8_t seq)
+{
+    uint8_t age = m_tx_seq - seq;
+    if (age != 0 && age <= SERIAL_UART_RETX_COUNT)
+    {
+        m_retx_mask |= (1 << (seq & (SERIAL_UART_RETX_COUNT - 1)));
+    }
+}
+
+static void frame_rx(const uint8_t* p_frame, uint32_t len)
+{
+    if (len < FRAME_HEADER_LEN + FRAME_CRC_LEN || len > FRAME_MAX_LEN ||
+        mesh_crc16(p_frame, len - FRAME_CRC_LEN, 0xFFFF) != (p_frame[len - 2] | (p_frame[len - 1] << 8)))
+    {
+        /* the gap in the sequence numbers shows on the next frame */
+        return;
+    }
+
+    uint8_t seq = p_frame[1];
+    const uint8_t* p_cmd = &p_frame[FRAME_HEADER_LEN];
+    uint32_t cmd_len = len - FRAME_HEADER_LEN - FRAME_CRC_LEN;
+    switch (p_frame[0])
+    {
+        case FRAME_TYPE_NACK:
+            retransmit_request(seq);
+            break;
+
+        case FRAME_TYPE_ACK:
+            /* the host probes with an ack when it's waiting for a response,
+               resend everything it hasn't seen */
+            for (uint8_t missing = p_frame[2]; missing != m_tx_seq; ++missing)
+            {
+                retransmit_request(missing);
+            }
+            break;
+
+        case FRAME_TYPE_SYNC:
+            /* a host that (re)connects to a running device, take its
+               numbering and tell it ours */
+            m_rx_seq = seq;
+            m_rx_reorder_valid = false;
+            m_retx_mask = 0;
+            ctrl_send(FRAME_TYPE_SYNC, m_tx_seq);
+            break;
+
+        case FRAME_TYPE_DATA:
+            if (cmd_len < 2 || cmd_len != (uint32_t) p_cmd[0] + 1)
+            {
+                break;
+            }
+            if (seq == m_rx_seq)
+            {
+                command_put(p_cmd, cmd_len);
+                m_rx_seq++;
+                if (m_rx_reorder_valid && m_rx_reorder.status_byte == m_rx_seq)
+                {
+                    command_put(m_rx_reorder.buffer, m_rx_reorder.buffer[0] + 1);
+                    m_rx_reorder_valid = false;
+                    m_rx_seq++;
+                }
+            }
+            else if ((uint8_t) (seq - m_rx_seq) < FRAME_RX_WINDOW)
+            {
+                /* keep the first command after the gap, and ask for the missing one */
+                if (!m_rx_reorder_valid)
+                {
+                    memcpy(m_rx_reorder.buffer, p_cmd, cmd_len);
+                    m_rx_reorder.status_byte = seq;
+                    m_rx_reorder_valid = true;
+                }
+                ctrl_send(FRAME_TYPE_NACK, m_rx_seq);
+            }
+            else
+            {
+                /* a command we already have, the host missed our ack */
+                ctrl_send(FRAME_TYPE_ACK, seq);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (m_serial_state == SERIAL_STATE_IDLE && tx_pending())
+    {
+        schedule_transmit();
+    }
+}
+#endif
+
+static void char_rx(uint8_t c)
+{
+#ifdef SERIAL_UART_FRAMED
+    if (c == SLIP_END)
+    {
+        if (m_rx_frame_len > 0)
         {
-            /* respond inline, queue was full */
-            serial_evt_t fail_evt;
-            fail_evt.length = 3;
-            fail_evt.opcode = SERIAL_EVT_OPCODE_CMD_RSP;
-            fail_evt.params.cmd_rsp.command_opcode = ((serial_cmd_t*) rx_buf.buffer)->opcode;
-            fail_evt.params.cmd_rsp.status = ACI_STATUS_ERROR_BUSY;
-            serial_handler_event_send(&fail_evt);
+            frame_rx(m_rx_frame, m_rx_frame_len);
         }
-        else
-        {
-#ifdef BOOTLOADER
-            NVIC_SetPendingIRQ(SWI2_IRQn);
+        m_rx_frame_len = 0;
+        m_rx_escape = false;
+        return;
+    }
+    if (c == SLIP_ESC)
+    {
+        m_rx_escape = true;
+        return;
+    }
+    if (m_rx_escape)
+    {
+        /* a bad escape is left for the CRC to catch */
+        c = (c == SLIP_ESC_END) ? SLIP_END : ((c == SLIP_ESC_ESC) ? SLIP_ESC : c);
+        m_rx_escape = false;
+    }
+    if (m_rx_frame_len < sizeof(m_rx_frame))
+    {
+        m_rx_frame[m_rx_frame_len++] = c;
+    }
 #else
-            async_event_t async_evt;
-            async_evt.type = EVENT_TYPE_GENERIC;
-            async_evt.callback.generic.cb = mesh_aci_command_check_cb;
-            async_evt.callback.generic.p_context = NULL;
-            event_handler_push(&async_evt);
-#endif
-        }
-
-        if (fifo_is_full(&m_rx_fifo))
+    /* Commands are received directly into the RX queue slot. If the queue
+       is full, the command is received into the overflow buffer, and
+       rejected when complete. */
+    static serial_data_t overflow_buf;
+    static serial_data_t* p_rx_buf = NULL;
+    static uint8_t* pp = NULL;
+
+    if (p_rx_buf == NULL)
+    {
+        if (fifo_reserve(&m_rx_fifo, (void**) &p_rx_buf) != NRF_SUCCESS)
         {
-            m_serial_state = SERIAL_STATE_WAIT_FOR_QUEUE;
-            NRF_UART0->TASKS_STOPRX = 1;
+            p_rx_buf = &overflow_buf;
         }
-        pp = rx_buf.buffer;
+        pp = p_rx_buf->buffer;
+    }
+
+    *(pp++) = c;
+
+    uint32_t len = (uint32_t)(pp - p_rx_buf->buffer);
+    if (len >= sizeof(p_rx_buf->buffer) || (len > 1 && len >= p_rx_buf->buffer[0] + 1)) /* end of command */
+    {
+        command_rx_end(p_rx_buf == &overflow_buf, ((serial_cmd_t*) p_rx_buf->buffer)->opcode);
+        p_rx_buf = NULL;
     }
+#endif
 }
 
 /*****************************************************************************
@@ -162,6 +502,7 @@ static void char_rx(uint8_t c)
 *****************************************************************************/
 void UART0_IRQHandler(void)
 {
+    ISR_STATS_BEGIN(RBC_MESH_ISR_SERIAL);
     /* receive all pending bytes */
     while (NRF_UART0->EVENTS_RXDRDY)
     {
@@ -186,12 +527,17 @@ void UART0_IRQHandler(void)
                 m_serial_state = SERIAL_STATE_IDLE;
             }
 
-            if (!fifo_is_empty(&m_tx_fifo))
+            if (tx_pending())
             {
                 schedule_transmit();
             }
+            else
+            {
+                pending_baudrate_apply();
+            }
         }
     }
+    ISR_STATS_END(RBC_MESH_ISR_SERIAL);
 }
 
 /*****************************************************************************
@@ -260,6 +606,7 @@ bool serial_handler_event_send(serial_evt_t* evt)
 {
     if (fifo_is_full(&m_tx_fifo))
     {
+        m_tx_blocked = true;
         return false;
     }
 
@@ -276,22 +623,51 @@ bool serial_handler_event_send(serial_evt_t* evt)
     return true;
 }
 
+uint32_t serial_handler_ram_size_get(void)
+{
+#ifdef SERIAL_UART_FRAMED
+    return sizeof(m_rx_fifo_buffer) + sizeof(m_tx_fifo_buffer) + sizeof(m_tx_frame) +
+        sizeof(m_tx_history) + sizeof(m_rx_frame) + sizeof(m_rx_reorder);
+#else
+    return sizeof(m_rx_fifo_buffer) + sizeof(m_tx_fifo_buffer) + sizeof(m_tx_buffer);
+#endif
+}
+
+uint32_t serial_handler_baudrate_set(uint32_t baudrate)
+{
+    for (uint32_t i = 0; i < sizeof(m_baudrates) / sizeof(m_baudrates[0]); ++i)
+    {
+        if (m_baudrates[i].baudrate == baudrate)
+        {
+            m_pending_baudrate = m_baudrates[i].reg_value;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_INVALID_PARAM;
+}
+
 bool serial_handler_command_get(serial_cmd_t* cmd)
 {
-    serial_data_t temp;
-    if (fifo_pop(&m_rx_fifo, &temp) != NRF_SUCCESS)
+    serial_data_t* p_rx_buf;
+    if (fifo_peek_ref(&m_rx_fifo, (void**) &p_rx_buf) != NRF_SUCCESS)
     {
         return false;
     }
-    if (((serial_cmd_t*) temp.buffer)->length > 0)
+    if (((serial_cmd_t*) p_rx_buf->buffer)->length > 0)
     {
-        memcpy(cmd, temp.buffer, ((serial_cmd_t*) temp.buffer)->length + 1);
+        memcpy(cmd, p_rx_buf->buffer, ((serial_cmd_t*) p_rx_buf->buffer)->length + 1);
     }
+    fifo_release(&m_rx_fifo);
 
     if (m_serial_state == SERIAL_STATE_WAIT_FOR_QUEUE)
     {
         m_serial_state = SERIAL_STATE_IDLE;
         NRF_UART0->TASKS_STARTRX = 1;
+        /* events queued while the RX queue was full */
+        if (tx_pending())
+        {
+            schedule_transmit();
+        }
     }
     return true;
 }
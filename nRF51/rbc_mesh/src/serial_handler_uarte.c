@@ -0,0 +1,394 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+
+/**
+* @file UARTE (EasyDMA) implementation of the serial handler, for nRF52. Drop-in
+*   replacement for serial_handler_uart.c, with the same pins and framing.
+*
+* Instead of an interrupt per byte, each frame is received in two DMA
+* transfers straight into an RX queue slot: the length byte, then the rest of
+* the frame. Frames are transmitted in a single DMA transfer straight from
+* the TX queue slot. The serial frames are length prefixed, so there's no need
+* for idle line detection to find the end of a frame. Hardware flow control
+* holds the host back while the next transfer is being set up, or while the
+* RX queue is full.
+*/
+#include "serial_handler.h"
+#include "event_handler.h"
+#include "rbc_mesh_common.h"
+#include "fifo.h"
+#include "isr_stats.h"
+
+#include "nrf_soc.h"
+#include "boards.h"
+#include "nrf_gpio.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include <string.h>
+
+#ifndef NRF52
+#error "The UARTE serial handler requires an nRF52, use serial_handler_uart.c on nRF51"
+#endif
+
+#define SERIAL_QUEUE_SIZE       (4)
+
+#ifndef SERIAL_UARTE_BAUDRATE
+/** @brief UARTE baudrate, as a UARTE_BAUDRATE_BAUDRATE_* value. */
+#define SERIAL_UARTE_BAUDRATE   (UARTE_BAUDRATE_BAUDRATE_Baud115200)
+#endif
+
+/*****************************************************************************
+* Static types
+*****************************************************************************/
+typedef enum
+{
+    SERIAL_RX_STATE_STOPPED,    /**< Waiting for a free RX queue slot. */
+    SERIAL_RX_STATE_LENGTH,     /**< Receiving the length byte of a frame. */
+    SERIAL_RX_STATE_PAYLOAD     /**< Receiving the rest of the frame. */
+} serial_rx_state_t;
+
+typedef enum
+{
+    SERIAL_STATE_IDLE,
+    SERIAL_STATE_TRANSMIT
+} serial_state_t;
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static fifo_t               m_rx_fifo; /**< SPSC, UARTE IRQ -> command handler */
+static fifo_t               m_tx_fifo; /**< event senders -> UARTE IRQ */
+static serial_data_t        m_rx_fifo_buffer[SERIAL_QUEUE_SIZE];
+static serial_data_t        m_tx_fifo_buffer[SERIAL_QUEUE_SIZE];
+
+static serial_rx_state_t    m_rx_state;
+static serial_data_t*       mp_rx_buf;
+static volatile serial_state_t m_serial_state;
+static bool                 m_suspend;
+static bool                 m_tx_blocked; /**< An event was rejected since the last ENDTX. */
+static uint32_t             m_pending_baudrate; /**< BAUDRATE register value to switch to, or 0. */
+
+/** Baudrates the host may switch to, all with hardware flow control. */
+static const struct
+{
+    uint32_t baudrate;
+    uint32_t reg_value;
+} m_baudrates[] =
+{
+    {115200,  UARTE_BAUDRATE_BAUDRATE_Baud115200},
+    {230400,  UARTE_BAUDRATE_BAUDRATE_Baud230400},
+    {250000,  UARTE_BAUDRATE_BAUDRATE_Baud250000},
+    {460800,  UARTE_BAUDRATE_BAUDRATE_Baud460800},
+    {921600,  UARTE_BAUDRATE_BAUDRATE_Baud921600},
+    {1000000, UARTE_BAUDRATE_BAUDRATE_Baud1M},
+};
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+#ifndef BOOTLOADER
+static void mesh_aci_command_check_cb(void* p_context)
+{
+    mesh_aci_command_check();
+}
+
+static void mesh_aci_event_flush_cb(void* p_context)
+{
+    mesh_aci_event_flush();
+}
+#endif
+
+#ifndef BOOTLOADER
+/** @brief Let the ACI retry the events it couldn't queue, now that there's room. */
+static void tx_room_notify(void)
+{
+    if (m_tx_blocked)
+    {
+        m_tx_blocked = false;
+        async_event_t async_evt;
+        async_evt.type = EVENT_TYPE_GENERIC;
+        async_evt.callback.generic.cb = mesh_aci_event_flush_cb;
+        async_evt.callback.generic.p_context = NULL;
+        event_handler_push(&async_evt);
+    }
+}
+#endif
+
+static void rx_start(uint8_t* p_dst, uint32_t length)
+{
+    NRF_UARTE0->RXD.PTR = (uint32_t) p_dst;
+    NRF_UARTE0->RXD.MAXCNT = length;
+    NRF_UARTE0->TASKS_STARTRX = 1;
+}
+
+/** Start receiving the next frame, if there's room for it in the RX queue. */
+static void rx_frame_start(void)
+{
+    if (fifo_reserve(&m_rx_fifo, (void**) &mp_rx_buf) != NRF_SUCCESS)
+    {
+        /* The receiver stays on, but with no buffer, so the host is held
+           back by flow control until serial_handler_command_get() frees a
+           slot. */
+        m_rx_state = SERIAL_RX_STATE_STOPPED;
+        return;
+    }
+    m_rx_state = SERIAL_RX_STATE_LENGTH;
+    rx_start(&mp_rx_buf->buffer[0], 1);
+}
+
+static void rx_frame_commit(void)
+{
+    fifo_commit(&m_rx_fifo);
+#ifdef BOOTLOADER
+    NVIC_SetPendingIRQ(SWI2_IRQn);
+#else
+    async_event_t async_evt;
+    async_evt.type = EVENT_TYPE_GENERIC;
+    async_evt.callback.generic.cb = mesh_aci_command_check_cb;
+    async_evt.callback.generic.p_context = NULL;
+    event_handler_push(&async_evt);
+#endif
+}
+
+static void on_rx_end(void)
+{
+    switch (m_rx_state)
+    {
+        case SERIAL_RX_STATE_LENGTH:
+            {
+                uint32_t length = mp_rx_buf->buffer[0];
+                if (length == 0)
+                {
+                    /* nothing to receive, reuse the slot for the next frame */
+                    rx_start(&mp_rx_buf->buffer[0], 1);
+                    break;
+                }
+                if (length > sizeof(mp_rx_buf->buffer) - 1)
+                {
+                    length = sizeof(mp_rx_buf->buffer) - 1;
+                }
+                m_rx_state = SERIAL_RX_STATE_PAYLOAD;
+                rx_start(&mp_rx_buf->buffer[1], length);
+            }
+            break;
+
+        case SERIAL_RX_STATE_PAYLOAD:
+            rx_frame_commit();
+            rx_frame_start();
+            break;
+
+        default:
+            break;
+    }
+}
+
+/** Start transmitting the frame at the head of the TX queue. Only done in
+ * the UARTE IRQ, which is the only consumer of the TX queue. */
+static void tx_next(void)
+{
+    serial_data_t* p_tx_buf;
+    if (m_suspend || fifo_peek_ref(&m_tx_fifo, (void**) &p_tx_buf) != NRF_SUCCESS)
+    {
+        if (m_pending_baudrate != 0 && !m_suspend)
+        {
+            NRF_UARTE0->BAUDRATE = (m_pending_baudrate << UARTE_BAUDRATE_BAUDRATE_Pos);
+            m_pending_baudrate = 0;
+        }
+        m_serial_state = SERIAL_STATE_IDLE;
+        return;
+    }
+
+    m_serial_state = SERIAL_STATE_TRANSMIT;
+    NRF_UARTE0->TXD.PTR = (uint32_t) &p_tx_buf->buffer[0];
+    NRF_UARTE0->TXD.MAXCNT = ((serial_evt_t*) p_tx_buf->buffer)->length + 1;
+    NRF_UARTE0->TASKS_STARTTX = 1;
+}
+
+/*****************************************************************************
+* System callbacks
+*****************************************************************************/
+void UARTE0_UART0_IRQHandler(void)
+{
+    ISR_STATS_BEGIN(RBC_MESH_ISR_SERIAL);
+    if (NRF_UARTE0->EVENTS_ERROR)
+    {
+        NRF_UARTE0->EVENTS_ERROR = 0;
+        /* framing or overrun errors will show up as a corrupt command, which
+           the command handler rejects. */
+        NRF_UARTE0->ERRORSRC = NRF_UARTE0->ERRORSRC;
+    }
+
+    if (NRF_UARTE0->EVENTS_ENDRX)
+    {
+        NRF_UARTE0->EVENTS_ENDRX = 0;
+        (void) NRF_UARTE0->EVENTS_ENDRX;
+        on_rx_end();
+    }
+
+    if (NRF_UARTE0->EVENTS_ENDTX)
+    {
+        NRF_UARTE0->EVENTS_ENDTX = 0;
+        (void) NRF_UARTE0->EVENTS_ENDTX;
+        fifo_release(&m_tx_fifo);
+#ifndef BOOTLOADER
+        tx_room_notify();
+#endif
+        tx_next();
+    }
+    else if (m_serial_state == SERIAL_STATE_IDLE)
+    {
+        /* pended by serial_handler_event_send() */
+        tx_next();
+    }
+    ISR_STATS_END(RBC_MESH_ISR_SERIAL);
+}
+
+/*****************************************************************************
+* Interface functions
+*****************************************************************************/
+
+void serial_handler_init(void)
+{
+    /* init packet queues */
+    m_tx_fifo.array_len = SERIAL_QUEUE_SIZE;
+    m_tx_fifo.elem_array = m_tx_fifo_buffer;
+    m_tx_fifo.elem_size = sizeof(serial_data_t);
+    m_tx_fifo.memcpy_fptr = NULL;
+    fifo_init(&m_tx_fifo);
+    m_rx_fifo.array_len = SERIAL_QUEUE_SIZE;
+    m_rx_fifo.elem_array = m_rx_fifo_buffer;
+    m_rx_fifo.elem_size = sizeof(serial_data_t);
+    m_rx_fifo.memcpy_fptr = NULL;
+    fifo_init(&m_rx_fifo);
+
+    m_suspend = false;
+    m_serial_state = SERIAL_STATE_IDLE;
+
+    /* setup hw */
+    nrf_gpio_cfg_input(RX_PIN_NUMBER, NRF_GPIO_PIN_PULLUP);
+    NRF_GPIO->OUTSET = (1 << RTS_PIN_NUMBER) | (1 << TX_PIN_NUMBER);
+    nrf_gpio_cfg_output(RTS_PIN_NUMBER);
+    nrf_gpio_cfg_input(CTS_PIN_NUMBER, NRF_GPIO_PIN_PULLUP);
+    nrf_gpio_cfg_output(TX_PIN_NUMBER);
+
+    NRF_UARTE0->PSEL.TXD     = TX_PIN_NUMBER;
+    NRF_UARTE0->PSEL.RXD     = RX_PIN_NUMBER;
+    NRF_UARTE0->PSEL.CTS     = CTS_PIN_NUMBER;
+    NRF_UARTE0->PSEL.RTS     = RTS_PIN_NUMBER;
+    NRF_UARTE0->CONFIG       = (UARTE_CONFIG_HWFC_Enabled << UARTE_CONFIG_HWFC_Pos);
+    NRF_UARTE0->BAUDRATE     = (SERIAL_UARTE_BAUDRATE << UARTE_BAUDRATE_BAUDRATE_Pos);
+    NRF_UARTE0->ENABLE       = (UARTE_ENABLE_ENABLE_Enabled << UARTE_ENABLE_ENABLE_Pos);
+    NRF_UARTE0->INTENSET     = (UARTE_INTENSET_ENDRX_Msk |
+                                UARTE_INTENSET_ENDTX_Msk |
+                                UARTE_INTENSET_ERROR_Msk);
+
+    NRF_UARTE0->EVENTS_ENDRX = 0;
+    NRF_UARTE0->EVENTS_ENDTX = 0;
+    NRF_UARTE0->EVENTS_ERROR = 0;
+    rx_frame_start();
+    NVIC_SetPriority(UARTE0_UART0_IRQn, 3);
+    NVIC_EnableIRQ(UARTE0_UART0_IRQn);
+}
+
+uint32_t serial_handler_credit_available(void)
+{
+    return fifo_get_len(&m_rx_fifo);
+}
+
+void serial_wait_for_completion(void)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_suspend = true;
+    while (m_serial_state != SERIAL_STATE_IDLE)
+    {
+        UARTE0_UART0_IRQHandler();
+    }
+    m_suspend = false;
+    _ENABLE_IRQS(was_masked);
+}
+
+bool serial_handler_event_send(serial_evt_t* evt)
+{
+    if (fifo_is_full(&m_tx_fifo))
+    {
+        m_tx_blocked = true;
+        return false;
+    }
+
+    serial_data_t raw_data;
+    raw_data.status_byte = 0;
+    memcpy(raw_data.buffer, evt, evt->length + 1);
+    fifo_push(&m_tx_fifo, &raw_data);
+
+    /* Always let the IRQ handler check, it might be about to go idle. */
+    NVIC_SetPendingIRQ(UARTE0_UART0_IRQn);
+
+    return true;
+}
+
+uint32_t serial_handler_ram_size_get(void)
+{
+    return sizeof(m_rx_fifo_buffer) + sizeof(m_tx_fifo_buffer);
+}
+
+uint32_t serial_handler_baudrate_set(uint32_t baudrate)
+{
+    for (uint32_t i = 0; i < sizeof(m_baudrates) / sizeof(m_baudrates[0]); ++i)
+    {
+        if (m_baudrates[i].baudrate == baudrate)
+        {
+            m_pending_baudrate = m_baudrates[i].reg_value;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+bool serial_handler_command_get(serial_cmd_t* cmd)
+{
+    serial_data_t* p_rx_buf;
+    if (fifo_peek_ref(&m_rx_fifo, (void**) &p_rx_buf) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    if (((serial_cmd_t*) p_rx_buf->buffer)->length > 0)
+    {
+        memcpy(cmd, p_rx_buf->buffer, ((serial_cmd_t*) p_rx_buf->buffer)->length + 1);
+    }
+    fifo_release(&m_rx_fifo);
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (m_rx_state == SERIAL_RX_STATE_STOPPED)
+    {
+        rx_frame_start();
+    }
+    _ENABLE_IRQS(was_masked);
+    return true;
+}
@@ -33,14 +33,41 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "event_handler.h"
 #include "toolchain.h"
+#include "isr_stats.h"
+#include "isr_stats.h"
 #include "app_error.h"
 
 #include "nrf.h"
 
 #define TIMER_COMPARE_COUNT     (3)
+/** PPI channel capturing events into the timestamp register. */
+#define TIMER_PPI_CH_CAPTURE    (TIMER_PPI_CH_START + TIMER_INDEX_TIMESTAMP)
 
 /** Time from timeslot API starts the TIMER0 until we are sure we have had time to set all timeouts. */
 #define TIMER_TS_BEGIN_MARGIN_US    (120)
+
+/** Virtual timers this close to their timeout fire together with the earlier ones. Also the shortest time the compare register is set up ahead of the counter. */
+#define TIMER_VIRTUAL_MARGIN_US     (8)
+/** Hardware timer multiplexing the virtual timers. */
+#define TIMER_INDEX_VIRTUAL         (TIMER_INDEX_RADIO)
+
+#ifdef TIMER_SCH_RTC
+/** Mask of the 24 bit RTC counter. */
+#define TIMER_RTC_COUNTER_MASK      (0x00FFFFFF)
+/** Least number of ticks ahead of the counter the RTC compare event is guaranteed to trigger. */
+#define TIMER_RTC_MIN_TICKS         (2)
+/** Longest time the RTC is set up ahead, timeouts further away are set up again on the way. */
+#define TIMER_RTC_MAX_TICKS         (TIMER_RTC_COUNTER_MASK / 2)
+/** Duration of an RTC tick, rounded up to whole microseconds. */
+#define TIMER_RTC_TICK_US           (31)
+/** Convert RTC ticks to microseconds, the RTC runs at 32768Hz. */
+#define TIMER_RTC_TICKS_TO_US(ticks) ((timestamp_t) (((uint64_t) (ticks) * 1000000) >> 15))
+#endif
+
+/** Upper limit for the estimated rate difference to the mesh time root. */
+#define TIMER_MESH_DRIFT_MAX_PPM    (500)
+/** Shortest time between two mesh time alignments to estimate the rate difference over. */
+#define TIMER_MESH_DRIFT_MIN_US     (100000)
 /*****************************************************************************
 * Static globals
 *****************************************************************************/
@@ -60,18 +87,65 @@ static timestamp_t      m_ts_end_time;
 static bool             m_is_in_ts;
 /** Timer mutex. */
 static uint32_t         m_timer_mut;
+/** Callbacks of the virtual timers, NULL if not scheduled. */
+static timer_callback_t m_vt_callbacks[TIMER_VIRTUAL_COUNT];
+/** Timeouts of the virtual timers. */
+static timestamp_t      m_vt_timeouts[TIMER_VIRTUAL_COUNT];
+/** Attributes of the virtual timers. */
+static timer_attr_t     m_vt_attributes[TIMER_VIRTUAL_COUNT];
+/** Indexes of the scheduled virtual timers, earliest timeout first. */
+static uint8_t          m_vt_order[TIMER_VIRTUAL_COUNT];
+/** Number of scheduled virtual timers. */
+static uint8_t          m_vt_count;
+#ifdef TIMER_SCH_RTC
+/** Timestamp at m_rtc_ref_ticks, timer_now() is extrapolated from it outside the timeslots. */
+static timestamp_t      m_rtc_ref_time;
+/** RTC counter value at m_rtc_ref_time. */
+static uint32_t         m_rtc_ref_ticks;
+/** Whether the RTC has been started. */
+static bool             m_rtc_running;
+#endif
+/** Event captured into the timestamp register through PPI, or NULL. */
+static volatile uint32_t* mp_capture_event;
+/** Time of the captured event, valid if m_capture_saved. */
+static timestamp_t      m_capture_time;
+/** The captured event time has been moved out of the timestamp register. */
+static bool             m_capture_saved;
+#ifdef RBC_MESH_TIME_SYNC
+/** Local time at the last mesh time alignment. */
+static timestamp_t      m_mesh_ref_local_time;
+/** Mesh time at the last mesh time alignment. */
+static timestamp_t      m_mesh_ref_time;
+/** Estimated rate of the mesh time relative to the local clock, in ppm. */
+static int32_t          m_mesh_drift_ppm;
+/** The mesh time has been aligned with a reference since the last reset. */
+static bool             m_mesh_time_synced;
+#endif
 /*****************************************************************************
 * Static functions
 *****************************************************************************/
 static void timer_set(uint8_t timer, timestamp_t timeout)
 {
-    APP_ERROR_CHECK_BOOL(timer < 2);
+    APP_ERROR_CHECK_BOOL(timer < TIMER_COMPARE_COUNT);
     NRF_TIMER0->INTENSET  = (1 << (TIMER_INTENSET_COMPARE0_Pos + timer));
     NRF_TIMER0->CC[timer] = timeout;
     NRF_TIMER0->EVENTS_COMPARE[timer] = 0;
     (void)NRF_TIMER0->EVENTS_COMPARE[timer];
 }
 
+/** Move a captured event time out of the timestamp register before it's
+    reused. Must be called with the mutex locked. */
+static void capture_save(void)
+{
+    if (mp_capture_event != NULL && *mp_capture_event && !m_capture_saved)
+    {
+        /* if the event came in the middle of a timer_now() capture, the
+           register holds that one, a few cycles later */
+        m_capture_time = NRF_TIMER0->CC[TIMER_INDEX_TIMESTAMP] + m_reference_time;
+        m_capture_saved = true;
+    }
+}
+
 /** Implement mutex lock, the SD-mut is hidden behind SVC, and cannot be used in IRQ level <= 1.
     While the mutex is locked, the timer is unable to receive timer interrupts, and the
     timers may safely be changed */
@@ -85,40 +159,259 @@ static inline void timer_mut_unlock(void)
 {
     _ENABLE_IRQS(m_timer_mut);
 }
+
+#ifdef TIMER_SCH_RTC
+static timestamp_t rtc_time_get(void)
+{
+    return m_rtc_ref_time + TIMER_RTC_TICKS_TO_US((NRF_RTC1->COUNTER - m_rtc_ref_ticks) & TIMER_RTC_COUNTER_MASK);
+}
+
+/** Set up the RTC compare for the given timer outside the timeslot, if it's
+    an asynchronous callback that isn't local to the timeslot. Must be called
+    with the mutex locked. */
+static void rtc_update(uint8_t timer)
+{
+    NRF_RTC1->INTENCLR = (RTC_INTENCLR_COMPARE0_Msk << timer);
+    if (!m_rtc_running ||
+        m_callbacks[timer] == NULL ||
+        mp_ppi_tasks[timer] != NULL ||
+        m_attributes[timer] != TIMER_ATTR_NONE)
+    {
+        return;
+    }
+
+    uint32_t counter = NRF_RTC1->COUNTER;
+    timestamp_t time_now = m_rtc_ref_time + TIMER_RTC_TICKS_TO_US((counter - m_rtc_ref_ticks) & TIMER_RTC_COUNTER_MASK);
+    uint32_t ticks = TIMER_RTC_MIN_TICKS;
+    if (TIMER_OLDER_THAN(time_now, m_timeouts[timer]))
+    {
+        /* round up, to never fire before the timeout */
+        uint64_t ticks_to_timeout = (((uint64_t) (m_timeouts[timer] - time_now) << 15) + 999999) / 1000000;
+        if (ticks_to_timeout > TIMER_RTC_MAX_TICKS)
+        {
+            ticks = TIMER_RTC_MAX_TICKS;
+        }
+        else if (ticks_to_timeout > TIMER_RTC_MIN_TICKS)
+        {
+            ticks = ticks_to_timeout;
+        }
+    }
+    NRF_RTC1->CC[timer] = (counter + ticks) & TIMER_RTC_COUNTER_MASK;
+    NRF_RTC1->EVENTS_COMPARE[timer] = 0;
+    NRF_RTC1->INTENSET = (RTC_INTENSET_COMPARE0_Msk << timer);
+}
+
+/** RTC timeout, executed in the event handler, as the timeslot timer event
+    queue is only processed in the timeslot. */
+static void rtc_timeout(void* p_context)
+{
+    uint8_t timer = (uint8_t) ((uint32_t) p_context);
+    timer_callback_t cb = NULL;
+    timestamp_t time_now = 0;
+
+    timer_mut_lock();
+    /* timeouts are handled by the HF timer after a timeslot has started */
+    if (!m_is_in_ts && m_callbacks[timer] != NULL && m_attributes[timer] == TIMER_ATTR_NONE)
+    {
+        time_now = rtc_time_get();
+        if (TIMER_OLDER_THAN(m_timeouts[timer], time_now + TIMER_RTC_TICK_US))
+        {
+            cb = m_callbacks[timer];
+            m_callbacks[timer] = NULL;
+        }
+        else
+        {
+            /* the timeout was further away than the RTC was set up for */
+            rtc_update(timer);
+        }
+    }
+    timer_mut_unlock();
+
+    if (cb != NULL)
+    {
+        cb(time_now);
+    }
+}
+
+/** Start the RTC at the first timeslot end. */
+static void rtc_start(void)
+{
+    NRF_RTC1->PRESCALER = 0;
+    NRF_RTC1->INTENCLR = 0xFFFFFFFF;
+    NRF_RTC1->EVENTS_OVRFLW = 0;
+    NRF_RTC1->INTENSET = RTC_INTENSET_OVRFLW_Msk;
+#ifdef NRF51
+    NVIC_SetPriority(RTC1_IRQn, 3);
+#else
+    NVIC_SetPriority(RTC1_IRQn, 6);
+#endif
+    NVIC_EnableIRQ(RTC1_IRQn);
+    NRF_RTC1->TASKS_START = 1;
+    m_rtc_running = true;
+}
+
+void RTC1_IRQHandler(void)
+{
+    if (NRF_RTC1->EVENTS_OVRFLW)
+    {
+        NRF_RTC1->EVENTS_OVRFLW = 0;
+        (void) NRF_RTC1->EVENTS_OVRFLW;
+        /* move the reference up to keep the tick difference inside the counter range */
+        timer_mut_lock();
+        m_rtc_ref_time += TIMER_RTC_TICKS_TO_US((TIMER_RTC_COUNTER_MASK + 1) - m_rtc_ref_ticks);
+        m_rtc_ref_ticks = 0;
+        timer_mut_unlock();
+    }
+
+    for (uint32_t i = 0; i < TIMER_COMPARE_COUNT; ++i)
+    {
+        if (NRF_RTC1->EVENTS_COMPARE[i] &&
+            (NRF_RTC1->INTENSET & (RTC_INTENSET_COMPARE0_Msk << i)))
+        {
+            NRF_RTC1->EVENTS_COMPARE[i] = 0;
+            (void) NRF_RTC1->EVENTS_COMPARE[i];
+            NRF_RTC1->INTENCLR = (RTC_INTENCLR_COMPARE0_Msk << i);
+
+            async_event_t evt;
+            evt.type = EVENT_TYPE_GENERIC;
+            evt.callback.generic.cb = rtc_timeout;
+            evt.callback.generic.p_context = (void*) i;
+            /* if the queue is full, the timeout fires at the next timeslot start */
+            (void) event_handler_push(&evt);
+        }
+    }
+}
+#endif /* TIMER_SCH_RTC */
+
+/** Call the given timer callback, directly or through the event handler. */
+static void callback_execute(timer_callback_t cb, timer_attr_t attributes, timestamp_t timestamp)
+{
+    if (attributes & TIMER_ATTR_SYNCHRONOUS)
+    {
+        cb(timestamp);
+    }
+    else
+    {
+        async_event_t evt;
+        evt.type = EVENT_TYPE_TIMER;
+        evt.callback.timer.cb = cb;
+        evt.callback.timer.timestamp = timestamp;
+        event_handler_push(&evt);
+    }
+}
+
+/** Order a callback on a hardware timer. Must be called with the mutex locked. */
+static void order_cb_locked(uint8_t timer, timestamp_t time, timer_callback_t callback, timer_attr_t attributes)
+{
+    m_callbacks[timer] = callback;
+    m_timeouts[timer] = time;
+    m_attributes[timer] = attributes;
+    mp_ppi_tasks[timer] = NULL;
+
+    if (m_is_in_ts)
+    {
+        timer_set(timer, TIMER_DIFF(time, m_reference_time));
+    }
+#ifdef TIMER_SCH_RTC
+    else
+    {
+        rtc_update(timer);
+    }
+#endif
+}
+
+/** Take the given virtual timer out of the timeout order. Must be called with the mutex locked. */
+static void vt_remove(uint8_t timer)
+{
+    for (uint32_t i = 0; i < m_vt_count; ++i)
+    {
+        if (m_vt_order[i] == timer)
+        {
+            m_vt_count--;
+            for (; i < m_vt_count; ++i)
+            {
+                m_vt_order[i] = m_vt_order[i + 1];
+            }
+            break;
+        }
+    }
+    m_vt_callbacks[timer] = NULL;
+}
+
+static void vt_timeout(timestamp_t timestamp);
+
+/** Set up the hardware timer for the earliest virtual timer, no earlier than
+    the given time. Must be called with the mutex locked. */
+static void vt_arm(timestamp_t earliest)
+{
+    if (m_vt_count == 0)
+    {
+        m_callbacks[TIMER_INDEX_VIRTUAL] = NULL;
+        if (m_is_in_ts)
+        {
+            NRF_TIMER0->INTENCLR = (1 << (TIMER_INTENCLR_COMPARE0_Pos + TIMER_INDEX_VIRTUAL));
+            NRF_TIMER0->EVENTS_COMPARE[TIMER_INDEX_VIRTUAL] = 0;
+        }
+        return;
+    }
+
+    timestamp_t timeout = m_vt_timeouts[m_vt_order[0]];
+    if (TIMER_OLDER_THAN(timeout, earliest))
+    {
+        timeout = earliest;
+    }
+    order_cb_locked(TIMER_INDEX_VIRTUAL, timeout, vt_timeout, TIMER_ATTR_SYNCHRONOUS);
+}
+
+/** Hardware timer callback, calls the virtual timers that are due. */
+static void vt_timeout(timestamp_t timestamp)
+{
+    while (true)
+    {
+        timer_mut_lock();
+        if (m_vt_count == 0 ||
+            TIMER_OLDER_THAN(timestamp + TIMER_VIRTUAL_MARGIN_US, m_vt_timeouts[m_vt_order[0]]))
+        {
+            vt_arm(timestamp + TIMER_VIRTUAL_MARGIN_US);
+            timer_mut_unlock();
+            return;
+        }
+        uint8_t timer = m_vt_order[0];
+        timer_callback_t cb = m_vt_callbacks[timer];
+        timer_attr_t attributes = m_vt_attributes[timer];
+        vt_remove(timer);
+        timer_mut_unlock();
+
+        /* the callback may order new virtual timers */
+        callback_execute(cb, attributes, timestamp);
+    }
+}
 /*****************************************************************************
 * Interface functions
 *****************************************************************************/
 void timer_event_handler(void)
 {
+    ISR_STATS_BEGIN(RBC_MESH_ISR_TIMER);
     for (uint32_t i = 0; i < TIMER_COMPARE_COUNT; ++i)
     {
         if (NRF_TIMER0->EVENTS_COMPARE[i])
         {
+            ISR_STATS_LATENCY(RBC_MESH_ISR_TIMER, m_timeouts[i]);
             timer_callback_t cb = m_callbacks[i];
             APP_ERROR_CHECK_BOOL(cb != NULL);
             m_callbacks[i] = NULL;
             NRF_TIMER0->INTENCLR = (1 << (TIMER_INTENCLR_COMPARE0_Pos + i));
-            timestamp_t time_now = timer_now();
-            if (m_attributes[i] & TIMER_ATTR_SYNCHRONOUS)
-            {
-                cb(time_now);
-            }
-            else
-            {
-                async_event_t evt;
-                evt.type = EVENT_TYPE_TIMER;
-                evt.callback.timer.cb = cb;
-                evt.callback.timer.timestamp = time_now;
-                event_handler_push(&evt);
-            }
+            /* clear the event before the callback, which may set up the same timer again */
             NRF_TIMER0->EVENTS_COMPARE[i] = 0;
             (void) NRF_TIMER0->EVENTS_COMPARE[i];
+            callback_execute(cb, m_attributes[i], timer_now());
             if (i == 0)
             {
                 break;
             }
         }
     }
+    ISR_STATS_END(RBC_MESH_ISR_TIMER);
 }
 
 uint32_t timer_order_cb(uint8_t timer,
@@ -137,17 +430,7 @@ uint32_t timer_order_cb(uint8_t timer,
     }
 
     timer_mut_lock();
-
-    m_callbacks[timer] = callback;
-    m_timeouts[timer] = time;
-    m_attributes[timer] = attributes;
-    mp_ppi_tasks[timer] = NULL;
-
-    if (m_is_in_ts)
-    {
-        timer_set(timer, TIMER_DIFF(time, m_reference_time));
-    }
-
+    order_cb_locked(timer, time, callback, attributes);
     timer_mut_unlock();
 
     return NRF_SUCCESS;
@@ -184,6 +467,12 @@ uint32_t timer_order_cb_ppi(uint8_t timer,
         NRF_PPI->CH[TIMER_PPI_CH_START + timer].TEP   = (uint32_t) p_task;
         NRF_PPI->CHENSET 			                  = (1 << (TIMER_PPI_CH_START + timer));
     }
+#ifdef TIMER_SCH_RTC
+    else
+    {
+        rtc_update(timer);
+    }
+#endif
 
     timer_mut_unlock();
 
@@ -215,6 +504,12 @@ uint32_t timer_order_ppi(uint8_t timer, timestamp_t time, uint32_t* p_task, time
         NRF_PPI->CH[TIMER_PPI_CH_START + timer].TEP   = (uint32_t) p_task;
         NRF_PPI->CHENSET 			                  = (1 << (TIMER_PPI_CH_START + timer));
     }
+#ifdef TIMER_SCH_RTC
+    else
+    {
+        rtc_update(timer);
+    }
+#endif
 
     timer_mut_unlock();
 
@@ -243,6 +538,83 @@ uint32_t timer_abort(uint8_t timer)
             NRF_TIMER0->INTENCLR = (1 << (TIMER_INTENCLR_COMPARE0_Pos + timer));
             NRF_PPI->CHENCLR = (1 << (TIMER_PPI_CH_START + timer));
         }
+#ifdef TIMER_SCH_RTC
+        else
+        {
+            rtc_update(timer);
+        }
+#endif
+    }
+    timer_mut_unlock();
+
+    return NRF_SUCCESS;
+}
+
+uint32_t timer_virtual_order(uint8_t timer,
+                             timestamp_t time,
+                             timer_callback_t callback,
+                             timer_attr_t attributes)
+{
+    if (timer >= TIMER_VIRTUAL_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (callback == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((attributes & (TIMER_ATTR_SYNCHRONOUS | TIMER_ATTR_TIMESLOT_LOCAL)) != attributes)
+    {
+        return NRF_ERROR_INVALID_FLAGS;
+    }
+
+    /* never set the compare register behind the counter */
+    timestamp_t earliest = timer_now() + TIMER_VIRTUAL_MARGIN_US;
+
+    timer_mut_lock();
+    vt_remove(timer);
+
+    /* insertion into the timeout order, the array is short */
+    uint32_t pos = m_vt_count++;
+    while (pos > 0 && TIMER_OLDER_THAN(time, m_vt_timeouts[m_vt_order[pos - 1]]))
+    {
+        m_vt_order[pos] = m_vt_order[pos - 1];
+        pos--;
+    }
+    m_vt_order[pos] = timer;
+    m_vt_callbacks[timer] = callback;
+    m_vt_timeouts[timer] = time;
+    m_vt_attributes[timer] = attributes;
+
+    if (pos == 0)
+    {
+        vt_arm(earliest);
+    }
+    timer_mut_unlock();
+
+    return NRF_SUCCESS;
+}
+
+uint32_t timer_virtual_abort(uint8_t timer)
+{
+    if (timer >= TIMER_VIRTUAL_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    timestamp_t earliest = timer_now() + TIMER_VIRTUAL_MARGIN_US;
+
+    timer_mut_lock();
+    if (m_vt_callbacks[timer] == NULL)
+    {
+        timer_mut_unlock();
+        return NRF_ERROR_NOT_FOUND;
+    }
+    bool was_first = (m_vt_order[0] == timer);
+    vt_remove(timer);
+    if (was_first)
+    {
+        vt_arm(earliest);
     }
     timer_mut_unlock();
 
@@ -255,23 +627,60 @@ timestamp_t timer_now(void)
     timestamp_t time = 0;
     if (m_is_in_ts)
     {
+        capture_save();
         NRF_TIMER0->EVENTS_COMPARE[TIMER_INDEX_TIMESTAMP] = 0;
         NRF_TIMER0->TASKS_CAPTURE[TIMER_INDEX_TIMESTAMP] = 1;
         time = NRF_TIMER0->CC[TIMER_INDEX_TIMESTAMP] + m_reference_time;
     }
     else
     {
+#ifdef TIMER_SCH_RTC
+        time = (m_rtc_running ? rtc_time_get() : m_ts_end_time);
+#else
         /* return the end of the previous TS */
         time = m_ts_end_time;
+#endif
     }
     timer_mut_unlock();
     return time;
 }
 
+void timer_event_capture_order(volatile uint32_t* p_event)
+{
+    timer_mut_lock();
+    if (m_is_in_ts)
+    {
+        mp_capture_event = p_event;
+        m_capture_saved = false;
+        NRF_PPI->CH[TIMER_PPI_CH_CAPTURE].EEP = (uint32_t) p_event;
+        NRF_PPI->CH[TIMER_PPI_CH_CAPTURE].TEP = (uint32_t) &(NRF_TIMER0->TASKS_CAPTURE[TIMER_INDEX_TIMESTAMP]);
+        NRF_PPI->CHENSET                      = (1 << TIMER_PPI_CH_CAPTURE);
+    }
+    timer_mut_unlock();
+}
+
+bool timer_event_capture_get(timestamp_t* p_time)
+{
+    timer_mut_lock();
+    capture_save();
+    bool captured = m_capture_saved;
+    if (captured)
+    {
+        *p_time = m_capture_time;
+    }
+    timer_mut_unlock();
+    return captured;
+}
+
 void timer_on_ts_begin(timestamp_t timeslot_start_time)
 {
     /* executed in STACK_LOW */
 
+#ifdef TIMER_SCH_RTC
+    /* the HF timer takes over the timeouts */
+    NRF_RTC1->INTENCLR = (RTC_INTENCLR_COMPARE0_Msk | RTC_INTENCLR_COMPARE1_Msk | RTC_INTENCLR_COMPARE2_Msk);
+#endif
+
     for (uint32_t i = 0; i < TIMER_COMPARE_COUNT; ++i)
     {
         NRF_TIMER0->CC[i] = 0;
@@ -287,18 +696,7 @@ void timer_on_ts_begin(timestamp_t timeslot_start_time)
             {
                 timer_callback_t cb = m_callbacks[i];
                 m_callbacks[i] = NULL;
-                if (m_attributes[i] & TIMER_ATTR_SYNCHRONOUS)
-                {
-                    cb(timeslot_start_time);
-                }
-                else
-                {
-                    async_event_t evt;
-                    evt.type = EVENT_TYPE_TIMER;
-                    evt.callback.timer.cb = cb;
-                    evt.callback.timer.timestamp = timeslot_start_time;
-                    event_handler_push(&evt);
-                }
+                callback_execute(cb, m_attributes[i], timeslot_start_time);
             }
             if (mp_ppi_tasks[i] != NULL)
             {
@@ -327,6 +725,12 @@ void timer_on_ts_begin(timestamp_t timeslot_start_time)
 
     m_reference_time = timeslot_start_time;
     m_is_in_ts = true;
+
+    /* virtual timers that fired above may have set up the next one without the new reference */
+    if (m_callbacks[TIMER_INDEX_VIRTUAL] != NULL)
+    {
+        timer_set(TIMER_INDEX_VIRTUAL, TIMER_DIFF(m_timeouts[TIMER_INDEX_VIRTUAL], timeslot_start_time));
+    }
 }
 
 void timer_on_ts_end(timestamp_t timeslot_end_time)
@@ -342,7 +746,90 @@ void timer_on_ts_end(timestamp_t timeslot_end_time)
             mp_ppi_tasks[i] = NULL;
         }
     }
+    for (uint32_t i = 0; i < TIMER_VIRTUAL_COUNT; ++i)
+    {
+        if (m_vt_callbacks[i] != NULL && (m_vt_attributes[i] & TIMER_ATTR_TIMESLOT_LOCAL))
+        {
+            vt_remove(i);
+        }
+    }
+    /* the SoftDevice owns the radio and TIMER0 outside the timeslot */
+    NRF_PPI->CHENCLR = (1 << TIMER_PPI_CH_CAPTURE);
+    mp_capture_event = NULL;
+    m_capture_saved = false;
+
     m_ts_end_time = timeslot_end_time;
     m_is_in_ts = false;
+
+#ifdef TIMER_SCH_RTC
+    if (!m_rtc_running)
+    {
+        rtc_start();
+    }
+    m_rtc_ref_ticks = NRF_RTC1->COUNTER;
+    m_rtc_ref_time = timeslot_end_time;
+    for (uint32_t i = 0; i < TIMER_COMPARE_COUNT; ++i)
+    {
+        rtc_update(i);
+    }
+#endif
+
+    /* keep the earliest remaining virtual timer for the next timeslot */
+    vt_arm(timeslot_end_time);
+}
+
+#ifdef RBC_MESH_TIME_SYNC
+timestamp_t timer_mesh_time_get(timestamp_t local_time)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    int32_t elapsed = (int32_t) (local_time - m_mesh_ref_local_time);
+    timestamp_t mesh_time = m_mesh_ref_time + elapsed +
+        (timestamp_t) (((int64_t) elapsed * m_mesh_drift_ppm) / 1000000);
+    _ENABLE_IRQS(was_masked);
+    return mesh_time;
+}
+
+int32_t timer_mesh_time_sync(timestamp_t local_time, timestamp_t mesh_time)
+{
+    int32_t error = (int32_t) (mesh_time - timer_mesh_time_get(local_time));
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    int32_t elapsed = (int32_t) (local_time - m_mesh_ref_local_time);
+    if (m_mesh_time_synced && elapsed >= TIMER_MESH_DRIFT_MIN_US)
+    {
+        /* only apply half the measured rate error, to filter out the jitter in the references */
+        int32_t drift = m_mesh_drift_ppm + (int32_t) (((int64_t) error * 1000000) / elapsed) / 2;
+        if (drift > TIMER_MESH_DRIFT_MAX_PPM)
+        {
+            drift = TIMER_MESH_DRIFT_MAX_PPM;
+        }
+        else if (drift < -TIMER_MESH_DRIFT_MAX_PPM)
+        {
+            drift = -TIMER_MESH_DRIFT_MAX_PPM;
+        }
+        m_mesh_drift_ppm = drift;
+    }
+    m_mesh_ref_local_time = local_time;
+    m_mesh_ref_time = mesh_time;
+    m_mesh_time_synced = true;
+    _ENABLE_IRQS(was_masked);
+
+    return error;
 }
 
+void timer_mesh_time_reset(timestamp_t local_time)
+{
+    timestamp_t mesh_time = timer_mesh_time_get(local_time);
+
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_mesh_ref_local_time = local_time;
+    m_mesh_ref_time = mesh_time;
+    m_mesh_drift_ppm = 0;
+    m_mesh_time_synced = false;
+    _ENABLE_IRQS(was_masked);
+}
+#endif
+
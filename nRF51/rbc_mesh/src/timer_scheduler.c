@@ -28,6 +28,7 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 #include <stddef.h>
+#include <string.h>
 #include "timer_scheduler.h"
 #include "event_handler.h"
 #include "toolchain.h"
@@ -38,13 +39,43 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** Time in us to regard as immidiate when firing several timers at once */
 #define TIMER_MARGIN    (100)
 
+#ifdef TIMER_SCH_WHEEL
+
+#ifndef TIMER_SCH_WHEEL_SIZE
+/** Number of buckets in the timing wheel. Must be power of two. */
+#define TIMER_SCH_WHEEL_SIZE        (64)
+#endif
+
+#ifndef TIMER_SCH_WHEEL_TICK_SHIFT
+/** Bucket width in the timing wheel, as a power of two microseconds. */
+#define TIMER_SCH_WHEEL_TICK_SHIFT  (14)
+#endif
+
+#if (TIMER_SCH_WHEEL_SIZE & (TIMER_SCH_WHEEL_SIZE - 1))
+#error "TIMER_SCH_WHEEL_SIZE must be power of two"
+#endif
+
+#define WHEEL_MASK                  (TIMER_SCH_WHEEL_SIZE - 1)
+#define WHEEL_TICK_START(time)      ((time) & ~((1UL << TIMER_SCH_WHEEL_TICK_SHIFT) - 1))
+
+#endif /* TIMER_SCH_WHEEL */
+
 /*****************************************************************************
 * Local typedefs
 *****************************************************************************/
 typedef struct
 {
+#ifdef TIMER_SCH_WHEEL
+    timer_event_t* p_buckets[TIMER_SCH_WHEEL_SIZE]; /**< Unsorted event lists, hashed on timestamp. */
+    timestamp_t cursor;             /**< All events older than the cursor are regarded as due in the cursor bucket. */
+    timer_event_t* p_first;         /**< Cached earliest event. */
+    bool first_is_valid;            /**< Whether the cached earliest event is valid. */
+#else
     timer_event_t* p_head;
+#endif
     uint32_t pending_reschedules;
+    bool dispatch_pending;          /**< An event dispatching the expired timers is in the event queue. */
+    timer_sch_stats_t stats;
 } scheduler_t;
 
 /*****************************************************************************
@@ -56,6 +87,110 @@ static scheduler_t m_scheduler; /** Global scheduler instance */
 *****************************************************************************/
 static void timer_cb(timestamp_t timestamp);
 
+#ifdef TIMER_SCH_WHEEL
+
+/** Number of buckets between the cursor and the event's bucket. */
+static uint32_t wheel_offset(timestamp_t timestamp)
+{
+    timestamp_t cursor_start = WHEEL_TICK_START(m_scheduler.cursor);
+    if (TIMER_OLDER_THAN(timestamp, cursor_start))
+    {
+        return 0;
+    }
+    return (timestamp - cursor_start) >> TIMER_SCH_WHEEL_TICK_SHIFT;
+}
+
+static void remove_evt(timer_event_t* p_evt)
+{
+    if (p_evt->pp_prev == NULL)
+    {
+        return; /* not scheduled */
+    }
+    *p_evt->pp_prev = p_evt->p_next;
+    if (p_evt->p_next)
+    {
+        p_evt->p_next->pp_prev = p_evt->pp_prev;
+    }
+    p_evt->p_next = NULL;
+    p_evt->pp_prev = NULL;
+
+    if (p_evt == m_scheduler.p_first)
+    {
+        m_scheduler.first_is_valid = false;
+    }
+}
+
+static void add_evt(timer_event_t* p_evt)
+{
+    remove_evt(p_evt);
+
+    uint32_t bucket = ((WHEEL_TICK_START(m_scheduler.cursor) >> TIMER_SCH_WHEEL_TICK_SHIFT) +
+                       wheel_offset(p_evt->timestamp)) & WHEEL_MASK;
+
+    p_evt->p_next = m_scheduler.p_buckets[bucket];
+    p_evt->pp_prev = &m_scheduler.p_buckets[bucket];
+    if (p_evt->p_next)
+    {
+        p_evt->p_next->pp_prev = &p_evt->p_next;
+    }
+    m_scheduler.p_buckets[bucket] = p_evt;
+
+    if (m_scheduler.first_is_valid &&
+        (m_scheduler.p_first == NULL ||
+         TIMER_OLDER_THAN(p_evt->timestamp, m_scheduler.p_first->timestamp)))
+    {
+        m_scheduler.p_first = p_evt;
+    }
+}
+
+/** Find the earliest event in the wheel. Only looks through the buckets
+  until the first bucket with an event in the current revolution, and only
+  falls back to searching all events if there are none. */
+static timer_event_t* first_evt_get(void)
+{
+    if (m_scheduler.first_is_valid)
+    {
+        return m_scheduler.p_first;
+    }
+
+    timer_event_t* p_first = NULL;
+    uint32_t cursor_bucket = WHEEL_TICK_START(m_scheduler.cursor) >> TIMER_SCH_WHEEL_TICK_SHIFT;
+    for (uint32_t i = 0; i < TIMER_SCH_WHEEL_SIZE && p_first == NULL; ++i)
+    {
+        for (timer_event_t* p_evt = m_scheduler.p_buckets[(cursor_bucket + i) & WHEEL_MASK];
+             p_evt != NULL;
+             p_evt = p_evt->p_next)
+        {
+            if (wheel_offset(p_evt->timestamp) == i &&
+                (p_first == NULL || TIMER_OLDER_THAN(p_evt->timestamp, p_first->timestamp)))
+            {
+                p_first = p_evt;
+            }
+        }
+    }
+
+    if (p_first == NULL)
+    {
+        /* all events are more than one revolution away */
+        for (uint32_t i = 0; i < TIMER_SCH_WHEEL_SIZE; ++i)
+        {
+            for (timer_event_t* p_evt = m_scheduler.p_buckets[i]; p_evt != NULL; p_evt = p_evt->p_next)
+            {
+                if (p_first == NULL || TIMER_OLDER_THAN(p_evt->timestamp, p_first->timestamp))
+                {
+                    p_first = p_evt;
+                }
+            }
+        }
+    }
+
+    m_scheduler.p_first = p_first;
+    m_scheduler.first_is_valid = true;
+    return p_first;
+}
+
+#else
+
 static void add_evt(timer_event_t* p_evt)
 {
     if (m_scheduler.p_head == NULL ||
@@ -87,10 +222,9 @@ static uint32_t remove_evt(timer_event_t* p_evt)
     }
 
     timer_event_t* p_temp = m_scheduler.p_head;
-    while (p_temp &&
-           p_temp->p_next &&
-           !TIMER_OLDER_THAN(p_evt->timestamp, p_temp->p_next->timestamp)
-          )
+    /* Can't stop at the event's timestamp, as it may already have been
+       changed by a reschedule. */
+    while (p_temp && p_temp->p_next)
     {
         if (p_temp->p_next == p_evt)
         {
@@ -105,51 +239,102 @@ static uint32_t remove_evt(timer_event_t* p_evt)
     return NRF_ERROR_NOT_FOUND;
 }
 
-static void fire_timers(timestamp_t time_now)
+static timer_event_t* first_evt_get(void)
 {
-   if (m_scheduler.pending_reschedules)
-   {
-       return;
-   }
-
-   while (m_scheduler.p_head &&
-       TIMER_OLDER_THAN(m_scheduler.p_head->timestamp, time_now + TIMER_MARGIN))
-   {
-       timer_event_t* p_evt = m_scheduler.p_head;
-       async_event_t evt;
-       evt.type = EVENT_TYPE_TIMER_SCH;
-       evt.callback.timer_sch.cb = p_evt->cb;
-       evt.callback.timer_sch.p_context = p_evt->p_context;
-       evt.callback.timer_sch.timestamp = time_now;
-       if (event_handler_push(&evt) != NRF_SUCCESS)
-       {
-           /* event queue full */
-           return;
-       }
-
-        /* iterate */
-        m_scheduler.p_head = p_evt->p_next;
-        p_evt->p_next = NULL;
+    return m_scheduler.p_head;
+}
+
+#endif /* TIMER_SCH_WHEEL */
+
+static void setup_timeout(timestamp_t time_now);
+
+/** Dispatch all timers that are due, in a single event. */
+static void dispatch_expired(timestamp_t timestamp, void* p_context)
+{
+    m_scheduler.dispatch_pending = false;
+
+    timer_event_t* p_evt;
+    while (m_scheduler.pending_reschedules == 0 &&
+        (p_evt = first_evt_get()) != NULL &&
+        TIMER_OLDER_THAN(p_evt->timestamp, timestamp + TIMER_MARGIN))
+    {
+        if (TIMER_OLDER_THAN(p_evt->timestamp, timestamp))
+        {
+            timestamp_t latency = TIMER_DIFF(timestamp, p_evt->timestamp);
+            if (latency > m_scheduler.stats.max_latency)
+            {
+                m_scheduler.stats.max_latency = latency;
+            }
+        }
+        m_scheduler.stats.fired++;
+
+        remove_evt(p_evt);
 
         if (p_evt->interval != 0)
         {
             do
             {
                 p_evt->timestamp += p_evt->interval;
-            } while (TIMER_OLDER_THAN(p_evt->timestamp, time_now + TIMER_MARGIN));
+            } while (TIMER_OLDER_THAN(p_evt->timestamp, timestamp + TIMER_MARGIN));
 
             add_evt(p_evt);
         }
-   }
+
+        p_evt->cb(timestamp, p_evt->p_context);
+    }
+
+    if (m_scheduler.pending_reschedules)
+    {
+        /* the rescheduling will fire the remaining timers when it's done */
+        return;
+    }
+
+#ifdef TIMER_SCH_WHEEL
+    /* All due events have fired, no events are left behind the new cursor. */
+    m_scheduler.cursor = timestamp;
+#endif
+
+    setup_timeout(timer_now());
+}
+
+static void fire_timers(timestamp_t time_now)
+{
+    if (m_scheduler.pending_reschedules || m_scheduler.dispatch_pending)
+    {
+        return;
+    }
+
+    timer_event_t* p_evt = first_evt_get();
+    if (p_evt == NULL ||
+        !TIMER_OLDER_THAN(p_evt->timestamp, time_now + TIMER_MARGIN))
+    {
+        return;
+    }
+
+    async_event_t evt;
+    evt.type = EVENT_TYPE_TIMER_SCH;
+    evt.callback.timer_sch.cb = dispatch_expired;
+    evt.callback.timer_sch.p_context = NULL;
+    evt.callback.timer_sch.timestamp = time_now;
+    if (event_handler_push(&evt) == NRF_SUCCESS)
+    {
+        m_scheduler.dispatch_pending = true;
+    }
+    else
+    {
+        /* event queue full, the timeout will be retried by setup_timeout(). */
+        m_scheduler.stats.deferred++;
+    }
 }
 
 static void setup_timeout(timestamp_t time_now)
 {
-    if (m_scheduler.p_head)
+    timer_event_t* p_first = first_evt_get();
+    if (p_first)
     {
-        if (TIMER_OLDER_THAN(time_now, m_scheduler.p_head->timestamp))
+        if (TIMER_OLDER_THAN(time_now, p_first->timestamp))
         {
-            timer_order_cb(TIMER_INDEX_SCHEDULER, m_scheduler.p_head->timestamp, timer_cb, TIMER_ATTR_NONE);
+            timer_order_cb(TIMER_INDEX_SCHEDULER, p_first->timestamp, timer_cb, TIMER_ATTR_NONE);
         }
         else
         {
@@ -205,7 +390,20 @@ static void timer_cb(timestamp_t timestamp)
 *****************************************************************************/
 uint32_t timer_sch_init(void)
 {
+#ifdef TIMER_SCH_WHEEL
+    for (uint32_t i = 0; i < TIMER_SCH_WHEEL_SIZE; ++i)
+    {
+        m_scheduler.p_buckets[i] = NULL;
+    }
+    m_scheduler.cursor = timer_now();
+    m_scheduler.p_first = NULL;
+    m_scheduler.first_is_valid = true;
+#else
     m_scheduler.p_head = NULL;
+#endif
+    m_scheduler.pending_reschedules = 0;
+    m_scheduler.dispatch_pending = false;
+    memset(&m_scheduler.stats, 0, sizeof(m_scheduler.stats));
     return NRF_SUCCESS;
 }
 
@@ -215,7 +413,9 @@ uint32_t timer_sch_schedule(timer_event_t* p_timer_evt)
     {
         return NRF_ERROR_NULL;
     }
+#ifndef TIMER_SCH_WHEEL
     p_timer_evt->p_next = NULL; /* sanitize linked list pointer */
+#endif
     async_event_t evt;
     evt.type = EVENT_TYPE_GENERIC;
     evt.callback.generic.cb = async_schedule;
@@ -259,3 +459,11 @@ uint32_t timer_sch_reschedule(timer_event_t* p_timer_evt, timestamp_t new_timeou
     _ENABLE_IRQS(was_masked);
     return error_code;
 }
+
+void timer_sch_stats_get(timer_sch_stats_t* p_stats)
+{
+    if (p_stats != NULL)
+    {
+        memcpy(p_stats, &m_scheduler.stats, sizeof(timer_sch_stats_t));
+    }
+}
@@ -29,6 +29,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************************************************/
 #include "timeslot.h"
 
+#ifndef RBC_MESH_STANDALONE
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -37,11 +39,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "radio_control.h"
 #include "timer.h"
 #include "transport_control.h"
+#include "version_handler.h"
 #include "event_handler.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
 
 #ifdef MESH_DFU
 #include "dfu_app.h"
+#endif
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
 #include "mesh_flash.h"
 #endif
 
@@ -58,6 +64,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define TIMESLOT_MAX_LENGTH_US              (10000000UL)    /**< The upper limit for timeslot extensions. */
 #define TIMESLOT_MAX_LENGTH_FIRST_US        (10000UL)    /**< The upper limit for timeslot extensions for the first timeslot. */
 #define RTC_MAX_TIME_TICKS                  (0xFFFFFF)      /**< RTC-clock rollover time. */
+#define TIMESLOT_ADAPTIVE_MAX_LENGTH_US     (100000)        /**< The upper limit for adaptive timeslot requests and extensions. */
+#define TIMESLOT_ADAPTIVE_FLASH_OP_US       (25000)         /**< Time to reserve for pending flash operations, enough for a page erase. */
+#define TIMESLOT_SCAN_TX_LEAD_US            (1000)          /**< Time to start a duty-cycled timeslot ahead of a Trickle transmission. */
+#define TIMESLOT_SCAN_MIN_SLEEP_US          (2000)          /**< Shortest gap between duty-cycled timeslots worth requesting a scheduled timeslot for. */
+#define TIMESLOT_CONN_EVENT_RESERVE_US      (2500)          /**< Time left free for each connection event of an active GATT connection. */
+#define TIMESLOT_CONN_MIN_LENGTH_US         (1500)          /**< Shortest timeslot to request between connection events. */
+#define TIMESLOT_LATENCY_MIN_GAP_US         (500)           /**< Shortest time from the end of a timeslot to the start of a latency mode timeslot. */
 
 /*****************************************************************************
 * Local type definitions
@@ -93,6 +106,23 @@ static nrf_radio_request_t m_radio_request_earliest =
                     }
                 };
 
+/** Timeslot normal request, for duty-cycled scanning */
+static nrf_radio_request_t m_radio_request_normal =
+                {
+                    .request_type = NRF_RADIO_REQ_TYPE_NORMAL,
+                    .params.normal =
+                    {
+#if (NORDIC_SDK_VERSION >= 11)
+                        .hfclk = NRF_RADIO_HFCLK_CFG_XTAL_GUARANTEED,
+#else
+                        .hfclk = NRF_RADIO_HFCLK_CFG_DEFAULT,
+#endif
+                        .priority = NRF_RADIO_PRIORITY_NORMAL,
+                        .distance_us = 0,
+                        .length_us = TIMESLOT_SLOT_LENGTH_US
+                    }
+                };
+
 static nrf_radio_signal_callback_return_param_t m_ret_param; /** Return parameter for SD radio signal handler. */
 static timestamp_t          m_timeslot_length           = 0; /** Length of current timeslot (including extensions). */
 static timestamp_t          m_start_time                = 0; /** Start time for current timeslot. */
@@ -104,6 +134,24 @@ static bool                 m_end_timer_triggered       = false; /** The timeslo
 static ts_forced_command_t  m_timeslot_forced_command   = TS_FORCED_COMMAND_NONE; /** Forced command, checked in radio signal callback. */
 static uint32_t             m_lfclk_ppm                 = 250; /** The set drift accuracy for the LF clock source. */
 static uint32_t             m_timeslot_count            = 0;
+static rbc_mesh_timeslot_stats_t m_stats;                    /** Timeslot statistics, utilization is calculated on request. */
+static timestamp_t          m_first_start_time          = 0; /** Start time of the first timeslot. */
+static timestamp_t          m_last_end_time             = 0; /** End time of the previous timeslot. */
+static uint64_t             m_total_timeslot_time       = 0; /** Accumulated length of all ended timeslots. */
+static uint32_t             m_scan_window_us            = 0; /** Length of the duty-cycled timeslots. */
+static uint32_t             m_scan_interval_us          = 0; /** Time between the duty-cycled timeslots, or 0 to scan continuously. */
+static uint32_t             m_conn_interval_us          = 0; /** Interval of the active GATT connection, or 0 if not connected. */
+static uint32_t             m_conn_attempts             = 0; /** Number of timeslot requests and extensions resolved while connected. */
+static bool                 m_gap_measured              = false; /** The next timeslot was ordered to follow the current one back to back. */
+static uint64_t             m_total_gap_time            = 0; /** Accumulated time between back to back timeslots. */
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+static uint32_t             m_latency_period_us         = 0; /** Time between latency mode timeslot starts, or 0 if the mode is off. */
+static timestamp_t          m_latency_start             = 0; /** Ordered start of the last latency mode timeslot, the cadence continues from here. */
+static bool                 m_latency_start_valid       = false; /** A latency mode timeslot has been ordered since the mode was set. */
+static bool                 m_latency_pending           = false; /** The last latency mode timeslot hasn't started yet. */
+static uint32_t             m_latency_measured          = 0; /** Number of latency mode timeslots that have started. */
+static uint64_t             m_total_latency_jitter      = 0; /** Accumulated start time jitter of the latency mode timeslots. */
+#endif
 
 /*****************************************************************************
 * Static Functions
@@ -113,8 +161,110 @@ static uint32_t end_timer_margin(void)
     return (m_timeslot_length * m_lfclk_ppm) / 1000000 + TIMESLOT_END_SAFETY_MARGIN_US;
 }
 
+/**
+* Get the timeslot length needed to cover the expected activity after the
+* given time: the events in the radio queue, the next Trickle transmission,
+* and any pending flash operations. Never shorter than the base length.
+*/
+static timestamp_t adaptive_length_get(timestamp_t base_length_us, timestamp_t from)
+{
+    timestamp_t length = base_length_us + radio_queue_len_get() * radio_event_duration_get();
+
+    uint32_t next_tx_time;
+    if (vh_next_tx_time_get(&next_tx_time) &&
+        !TIMER_OLDER_THAN(next_tx_time, from) &&
+        TIMER_DIFF(next_tx_time, from) < TIMESLOT_ADAPTIVE_MAX_LENGTH_US)
+    {
+        /* Cover the transmission, instead of ending the timeslot right before it. */
+        timestamp_t tx_length = TIMER_DIFF(next_tx_time, from) + radio_event_duration_get();
+        if (tx_length > length)
+        {
+            length = tx_length;
+        }
+    }
+
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
+    if (mesh_flash_in_progress())
+    {
+        length += TIMESLOT_ADAPTIVE_FLASH_OP_US;
+    }
+#endif
+
+    if (length > TIMESLOT_ADAPTIVE_MAX_LENGTH_US)
+    {
+        length = TIMESLOT_ADAPTIVE_MAX_LENGTH_US;
+    }
+    return length;
+}
+
+/**
+* Get the longest timeslot that fits between two connection events of the
+* active GATT connection. The SoftDevice always prioritizes the connection,
+* so any longer timeslot or extension is guaranteed to be cut or canceled.
+*/
+static timestamp_t conn_gap_get(void)
+{
+    if (m_conn_interval_us < TIMESLOT_CONN_EVENT_RESERVE_US + TIMESLOT_CONN_MIN_LENGTH_US)
+    {
+        return TIMESLOT_CONN_MIN_LENGTH_US;
+    }
+    return m_conn_interval_us - TIMESLOT_CONN_EVENT_RESERVE_US;
+}
+
+static timestamp_t conn_length_clamp(timestamp_t length_us)
+{
+    if (m_conn_interval_us != 0 && length_us > conn_gap_get())
+    {
+        return conn_gap_get();
+    }
+    return length_us;
+}
+
+/** Account for a timeslot request or extension being denied. */
+static void ts_denied(void)
+{
+    m_stats.denied++;
+    if (m_conn_interval_us != 0)
+    {
+        m_stats.conn_collisions++;
+        m_conn_attempts++;
+    }
+}
+
+/** Account for a timeslot request or extension being granted. */
+static void ts_granted(void)
+{
+    if (m_conn_interval_us != 0)
+    {
+        m_conn_attempts++;
+    }
+}
+
+#ifdef RBC_MESH_TIMESLOT_WORK_AWARE
+/** Whether the radio or flash queues have a backlog. */
+static bool work_backlog(void)
+{
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
+    if (mesh_flash_in_progress())
+    {
+        return true;
+    }
+#endif
+    return radio_queue_busy();
+}
+
+/** Whether there's a backlog, or a Trickle transmission due before the given time. */
+static bool work_pending(timestamp_t before)
+{
+    uint32_t next_tx_time;
+    return (work_backlog() ||
+            (vh_next_tx_time_get(&next_tx_time) && TIMER_OLDER_THAN(next_tx_time, before)));
+}
+#endif
+
 static void ts_order_earliest(timestamp_t length_us)
 {
+    length_us = conn_length_clamp(length_us);
     if (m_is_in_callback)
     {
         m_radio_request_earliest.params.earliest.length_us = length_us;
@@ -126,6 +276,184 @@ static void ts_order_earliest(timestamp_t length_us)
         sd_radio_request(&m_radio_request_earliest);
     }
     m_timeslot_length = length_us;
+    m_gap_measured = true;
+}
+
+static void ts_order_normal(timestamp_t distance_us, timestamp_t length_us)
+{
+    /* Only valid as the way out of a timeslot, as the distance is relative to its start. */
+    length_us = conn_length_clamp(length_us);
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    m_radio_request_normal.params.normal.priority = NRF_RADIO_PRIORITY_NORMAL;
+#endif
+    m_radio_request_normal.params.normal.distance_us = distance_us;
+    m_radio_request_normal.params.normal.length_us = length_us;
+    m_ret_param.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_REQUEST_AND_END;
+    m_ret_param.params.request.p_next = &m_radio_request_normal;
+    m_timeslot_length = length_us;
+    m_gap_measured = false;
+}
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+/**
+* Order the next timeslot at high priority on the latency mode cadence, or
+* right before the next transmission of an urgent handle if that comes
+* first, which the cadence then continues from.
+*/
+static void ts_order_latency(void)
+{
+    timestamp_t earliest_start = timeslot_end_time_get() + TIMESLOT_LATENCY_MIN_GAP_US;
+    timestamp_t next_start = earliest_start;
+    if (m_latency_start_valid)
+    {
+        next_start = m_latency_start + m_latency_period_us;
+        if (TIMER_OLDER_THAN(next_start, earliest_start))
+        {
+            /* the timeslot was extended past the cadence, skip to the next point after it */
+            next_start += (TIMER_DIFF(earliest_start, next_start) / m_latency_period_us + 1) * m_latency_period_us;
+        }
+    }
+
+    uint32_t urgent_tx_time;
+    if (vh_urgent_tx_time_get(&urgent_tx_time) &&
+        TIMER_OLDER_THAN(urgent_tx_time - TIMESLOT_SCAN_TX_LEAD_US, next_start) &&
+        !TIMER_OLDER_THAN(urgent_tx_time - TIMESLOT_SCAN_TX_LEAD_US, earliest_start))
+    {
+        next_start = urgent_tx_time - TIMESLOT_SCAN_TX_LEAD_US;
+    }
+
+    timestamp_t length;
+    if (m_scan_interval_us == 0)
+    {
+        length = adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, next_start);
+    }
+    else
+    {
+        length = m_scan_window_us + radio_queue_len_get() * radio_event_duration_get();
+        if (length > m_latency_period_us - TIMESLOT_LATENCY_MIN_GAP_US)
+        {
+            length = m_latency_period_us - TIMESLOT_LATENCY_MIN_GAP_US;
+        }
+    }
+
+    ts_order_normal(TIMER_DIFF(next_start, m_start_time), length);
+    m_radio_request_normal.params.normal.priority = NRF_RADIO_PRIORITY_HIGH;
+    m_latency_start = next_start;
+    m_latency_start_valid = true;
+    m_latency_pending = true;
+    m_stats.latency_starts++;
+}
+
+/** Account for the difference between the ordered and the actual start of a latency mode timeslot. */
+static void latency_start_measure(void)
+{
+    uint32_t jitter = TIMER_OLDER_THAN(m_start_time, m_latency_start) ?
+        TIMER_DIFF(m_latency_start, m_start_time) :
+        TIMER_DIFF(m_start_time, m_latency_start);
+    if (jitter > m_stats.latency_jitter_max_us)
+    {
+        m_stats.latency_jitter_max_us = jitter;
+    }
+    m_total_latency_jitter += jitter;
+    m_latency_measured++;
+    m_latency_pending = false;
+}
+#endif
+
+/**
+* Order the timeslot following the current one. When scanning continuously,
+* this is as early as possible. When duty-cycled, the next timeslot starts at
+* the next scan interval, or right before the next Trickle transmission if
+* that comes first.
+*/
+static void ts_order_next(void)
+{
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    if (m_latency_period_us != 0)
+    {
+        ts_order_latency();
+        return;
+    }
+#endif
+    if (m_scan_interval_us == 0)
+    {
+#ifdef RBC_MESH_TIMESLOT_WORK_AWARE
+        timestamp_t sleep_end = timer_now() + RBC_MESH_TIMESLOT_IDLE_SLEEP_US;
+        if (!work_pending(sleep_end + TIMESLOT_SCAN_TX_LEAD_US))
+        {
+            /* nothing to do, let the radio sleep for a while */
+            ts_order_normal(TIMER_DIFF(sleep_end, m_start_time),
+                    adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, sleep_end));
+            return;
+        }
+#endif
+#ifdef RBC_MESH_TIMESLOT_CHAINING
+        if (m_conn_interval_us == 0)
+        {
+            /* A normal request can be placed right after the current
+               timeslot, an earliest request waits for the scheduler. */
+            timestamp_t time_now = timer_now();
+            ts_order_normal(TIMER_DIFF(time_now, m_start_time) + RBC_MESH_TIMESLOT_CHAIN_GAP_US,
+                    adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, time_now + RBC_MESH_TIMESLOT_CHAIN_GAP_US));
+            m_gap_measured = true;
+            m_stats.chained++;
+            return;
+        }
+#endif
+        ts_order_earliest(adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, timer_now()));
+        return;
+    }
+
+    timestamp_t next_start = m_start_time + m_scan_interval_us;
+    uint32_t next_tx_time;
+    if (vh_next_tx_time_get(&next_tx_time) &&
+        TIMER_OLDER_THAN(next_tx_time - TIMESLOT_SCAN_TX_LEAD_US, next_start))
+    {
+        next_start = next_tx_time - TIMESLOT_SCAN_TX_LEAD_US;
+    }
+
+    timestamp_t length = m_scan_window_us + radio_queue_len_get() * radio_event_duration_get();
+    if (radio_queue_busy() ||
+        TIMER_OLDER_THAN(next_start, timeslot_end_time_get() + TIMESLOT_SCAN_MIN_SLEEP_US))
+    {
+        /* Not worth going to sleep. */
+        ts_order_earliest(length);
+    }
+    else
+    {
+        ts_order_normal(TIMER_DIFF(next_start, m_start_time), length);
+    }
+}
+
+/**
+* Get the length to attempt to extend the current timeslot with. Duty-cycled
+* timeslots are only extended to finish the transmissions in the radio queue.
+*/
+static timestamp_t extend_length_get(void)
+{
+    if (m_scan_interval_us == 0)
+    {
+#ifdef RBC_MESH_TIMESLOT_WORK_AWARE
+        if (work_backlog())
+        {
+            /* fewer, longer extensions while working through a backlog */
+            return TIMESLOT_ADAPTIVE_MAX_LENGTH_US;
+        }
+        if (!work_pending(timeslot_end_time_get() + TIMESLOT_SLOT_EXTEND_LENGTH_US))
+        {
+            return 0;
+        }
+#endif
+        return adaptive_length_get(TIMESLOT_SLOT_EXTEND_LENGTH_US, timeslot_end_time_get());
+    }
+    else if (radio_queue_busy())
+    {
+        return radio_queue_len_get() * radio_event_duration_get() + TIMESLOT_END_SAFETY_MARGIN_US;
+    }
+    else
+    {
+        return 0;
+    }
 }
 
 static void ts_extend(timestamp_t extra_time_us)
@@ -136,6 +464,18 @@ static void ts_extend(timestamp_t extra_time_us)
         {
             extra_time_us = TIMESLOT_MAX_LENGTH_US - m_timeslot_length;
         }
+        if (m_conn_interval_us != 0)
+        {
+            /* Don't extend into the next connection event. */
+            if (m_timeslot_length + TIMESLOT_CONN_MIN_LENGTH_US > conn_gap_get())
+            {
+                return;
+            }
+            if (m_timeslot_length + extra_time_us > conn_gap_get())
+            {
+                extra_time_us = conn_gap_get() - m_timeslot_length;
+            }
+        }
         m_ret_param.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_EXTEND;
         m_ret_param.params.extend.length_us = extra_time_us;
     }
@@ -169,6 +509,10 @@ void start_time_update(void)
 
 static void timeslot_end(void)
 {
+    timestamp_t time_in_ts = TIMER_DIFF(timer_now(), m_start_time);
+    m_total_timeslot_time += time_in_ts;
+    m_last_end_time = m_start_time + time_in_ts;
+    TRACE_END(MESH_TRACE_POINT_TIMESLOT, 0);
     radio_disable();
     timer_on_ts_end(timeslot_end_time_get());
     m_is_in_timeslot = false;
@@ -206,7 +550,7 @@ void timeslot_sd_event_handler(uint32_t evt)
         case NRF_EVT_RADIO_SESSION_IDLE:
             if (m_timeslot_forced_command != TS_FORCED_COMMAND_STOP)
             {
-                ts_order_earliest(TIMESLOT_SLOT_LENGTH_US);
+                ts_order_earliest(adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, timer_now()));
             }
             break;
 
@@ -214,6 +558,14 @@ void timeslot_sd_event_handler(uint32_t evt)
             break;
 
         case NRF_EVT_RADIO_BLOCKED:
+            ts_denied();
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+            if (m_latency_pending)
+            {
+                /* measured when the earliest request starts */
+                m_stats.latency_missed++;
+            }
+#endif
             /* Something in the softdevice is blocking our requests,
                go into emergency mode, where slots are short, in order to
                avoid complete lockout. */
@@ -225,7 +577,14 @@ void timeslot_sd_event_handler(uint32_t evt)
             break;
 
         case NRF_EVT_RADIO_CANCELED:
-            ts_order_earliest(TIMESLOT_SLOT_LENGTH_US);
+            ts_denied();
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+            if (m_latency_pending)
+            {
+                m_stats.latency_missed++;
+            }
+#endif
+            ts_order_earliest(adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, timer_now()));
             break;
         default:
             break;
@@ -246,6 +605,7 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
     static uint32_t requested_extend_time = 0;
     static uint32_t successful_extensions = 0;
     SET_PIN(PIN_IN_CB);
+    TRACE_BEGIN(MESH_TRACE_POINT_TS_SIGNAL, sig);
     m_is_in_callback = true;
 
     switch (m_timeslot_forced_command)
@@ -254,12 +614,14 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
             m_ret_param.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_END;
             m_timeslot_count = 0;
             timeslot_end();
+            TRACE_END(MESH_TRACE_POINT_TS_SIGNAL, sig);
             return &m_ret_param;
 
         case TS_FORCED_COMMAND_RESTART:
-            ts_order_earliest(TIMESLOT_SLOT_LENGTH_US);
+            ts_order_earliest(adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, timer_now()));
             timeslot_end();
             m_timeslot_forced_command = TS_FORCED_COMMAND_NONE;
+            TRACE_END(MESH_TRACE_POINT_TS_SIGNAL, sig);
             return &m_ret_param;
 
         default:
@@ -277,19 +639,38 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
             successful_extensions = 0;
 
             start_time_update();
+            ts_granted();
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+            if (m_latency_pending)
+            {
+                latency_start_measure();
+            }
+#endif
+            if (m_stats.granted++ == 0)
+            {
+                m_first_start_time = m_start_time;
+            }
+            else if (m_timeslot_count != 0 && m_gap_measured)
+            {
+                m_total_gap_time += TIMER_DIFF(m_start_time, m_last_end_time);
+            }
 
             /* notify other modules */
             event_handler_on_ts_begin();
             timer_on_ts_begin(m_start_time);
+            TRACE_BEGIN(MESH_TRACE_POINT_TIMESLOT, 0);
             tc_on_ts_begin();
 
-            m_negotiate_timeslot_length = TIMESLOT_SLOT_EXTEND_LENGTH_US;
+            m_negotiate_timeslot_length = extend_length_get();
 
             timer_order_cb(TIMER_INDEX_TS_END, timeslot_start_time_get() + m_timeslot_length - end_timer_margin(),
                     end_timer_handler, (timer_attr_t) (TIMER_ATTR_SYNCHRONOUS | TIMER_ATTR_TIMESLOT_LOCAL));
 
             /* attempt to extend our time right away */
-            ts_extend(m_negotiate_timeslot_length);
+            if (m_negotiate_timeslot_length > 0)
+            {
+                ts_extend(m_negotiate_timeslot_length);
+            }
 
             /* increase timeslot-count, but skip =0 on rollover */
             if (!++m_timeslot_count)
@@ -313,6 +694,8 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
             m_timeslot_length += requested_extend_time;
             requested_extend_time = 0;
             ++successful_extensions;
+            m_stats.extended++;
+            ts_granted();
 
             timer_abort(TIMER_INDEX_TS_END);
 
@@ -321,7 +704,12 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
 
             m_ret_param.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_NONE;
 
-            if (m_timeslot_count == 1)
+            m_negotiate_timeslot_length = extend_length_get();
+            if (m_negotiate_timeslot_length == 0)
+            {
+                /* Nothing to extend for. */
+            }
+            else if (m_timeslot_count == 1)
             {
                 if (m_timeslot_length + m_negotiate_timeslot_length < TIMESLOT_MAX_LENGTH_FIRST_US)
                 {
@@ -339,6 +727,7 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
             break;
 
         case NRF_RADIO_CALLBACK_SIGNAL_TYPE_EXTEND_FAILED:
+            ts_denied();
             m_negotiate_timeslot_length >>= 1;
             if (m_negotiate_timeslot_length > 1000)
             {
@@ -352,7 +741,7 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
 
     if (m_end_timer_triggered)
     {
-        ts_order_earliest(TIMESLOT_SLOT_LENGTH_US);
+        ts_order_next();
         timeslot_end();
     }
     else if (m_ret_param.callback_action == NRF_RADIO_SIGNAL_CALLBACK_ACTION_EXTEND)
@@ -361,7 +750,7 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
     }
     else
     {
-#ifdef MESH_DFU
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
         mesh_flash_op_execute(timeslot_remaining_time_get());
 #endif
         requested_extend_time = 0;
@@ -369,6 +758,7 @@ static nrf_radio_signal_callback_return_param_t* radio_signal_callback(uint8_t s
 
     m_is_in_callback = false;
     CLEAR_PIN(PIN_IN_CB);
+    TRACE_END(MESH_TRACE_POINT_TS_SIGNAL, sig);
     return &m_ret_param;
 }
 
@@ -496,7 +886,12 @@ uint32_t timeslot_resume(void)
     {
         return NRF_ERROR_INVALID_STATE;
     }
-    ts_order_earliest(TIMESLOT_SLOT_LENGTH_US);
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    /* the start time restarts with the session, so does the cadence */
+    m_latency_start_valid = false;
+    m_latency_pending = false;
+#endif
+    ts_order_earliest(adaptive_length_get(TIMESLOT_SLOT_LENGTH_US, timer_now()));
     return NRF_SUCCESS;
 }
 
@@ -529,3 +924,67 @@ bool timeslot_is_in_ts(void)
     return m_is_in_timeslot;
 }
 
+uint32_t timeslot_end_margin_get(void)
+{
+    return end_timer_margin();
+}
+
+void timeslot_stats_get(rbc_mesh_timeslot_stats_t* p_stats)
+{
+    memcpy(p_stats, &m_stats, sizeof(rbc_mesh_timeslot_stats_t));
+
+    uint64_t total_time = timeslot_total_time_get();
+    timestamp_t elapsed;
+    if (m_is_in_timeslot)
+    {
+        elapsed = timer_now() - m_first_start_time;
+    }
+    else
+    {
+        elapsed = m_last_end_time - m_first_start_time;
+    }
+    p_stats->utilization_permille = (elapsed == 0 || total_time >= elapsed) ? 1000 : (uint16_t) ((total_time * 1000) / elapsed);
+    p_stats->utilization = (uint8_t) (p_stats->utilization_permille / 10);
+    p_stats->conn_collision_permille = (m_conn_attempts == 0) ? 0 : (uint16_t) (((uint64_t) m_stats.conn_collisions * 1000) / m_conn_attempts);
+    p_stats->rx_gap_ms_per_hour = (elapsed == 0) ? 0 : (uint32_t) ((m_total_gap_time * 3600000) / elapsed);
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    p_stats->latency_jitter_avg_us = (m_latency_measured == 0) ? 0 : (uint32_t) (m_total_latency_jitter / m_latency_measured);
+#endif
+}
+
+uint64_t timeslot_total_time_get(void)
+{
+    if (m_is_in_timeslot)
+    {
+        return m_total_timeslot_time + TIMER_DIFF(timer_now(), m_start_time);
+    }
+    return m_total_timeslot_time;
+}
+
+void timeslot_conn_interval_set(uint32_t interval_us)
+{
+    /* Takes effect from the next request or extension. */
+    m_conn_interval_us = interval_us;
+}
+
+void timeslot_scan_duty_cycle_set(uint32_t window_us, uint32_t interval_us)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_scan_window_us = window_us;
+    m_scan_interval_us = interval_us;
+    _ENABLE_IRQS(was_masked);
+}
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+void timeslot_latency_mode_set(uint32_t period_us)
+{
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_latency_period_us = period_us;
+    m_latency_start_valid = false;
+    _ENABLE_IRQS(was_masked);
+}
+#endif
+
+#endif /* RBC_MESH_STANDALONE */
@@ -0,0 +1,365 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "timeslot.h"
+
+#ifdef RBC_MESH_STANDALONE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "radio_control.h"
+#include "timer.h"
+#include "transport_control.h"
+#include "event_handler.h"
+#include "rbc_mesh_common.h"
+#include "mesh_trace.h"
+
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
+#include "mesh_flash.h"
+#endif
+
+#include "app_error.h"
+#include "nrf.h"
+
+/* The standalone radio mode replaces the Softdevice timeslot API, and can't
+   share the radio with a Softdevice. */
+
+#define TIMESLOT_STANDALONE_FLASH_OP_US     (25000)         /**< Time given to pending flash operations on each radio or timer interrupt, enough for a page erase. */
+#define TIMESLOT_STANDALONE_IRQ_PRIORITY    (0)             /**< Priority of the radio and timer interrupts, same as the Softdevice signal callback. */
+
+/*****************************************************************************
+* Local type definitions
+*****************************************************************************/
+/**
+ * Types of forced command sent to the radio interrupt handler.
+ */
+typedef enum
+{
+    TS_FORCED_COMMAND_NONE,     /** No command for the interrupt handler. */
+    TS_FORCED_COMMAND_STOP,     /** Stop the radio, and don't start it again. */
+    TS_FORCED_COMMAND_RESTART,  /** Stop the radio, and start it again right away. */
+} ts_forced_command_t;
+
+/*****************************************************************************
+* Static globals
+*****************************************************************************/
+static timestamp_t          m_start_time                = 0; /** Start time of the current radio session. */
+static bool                 m_is_in_timeslot            = false; /** The framework currently owns the radio. */
+static bool                 m_framework_initialized     = false; /** The timeslot_init function has been called. */
+static volatile ts_forced_command_t m_timeslot_forced_command = TS_FORCED_COMMAND_NONE; /** Forced command, checked in the radio interrupt handler. */
+static rbc_mesh_timeslot_stats_t m_stats;                    /** Timeslot statistics, there's only ever one timeslot per session. */
+static uint64_t             m_total_time                = 0; /** Accumulated length of all ended radio sessions. */
+
+/*****************************************************************************
+* Static functions
+*****************************************************************************/
+/**
+ * Start a radio session. TIMER0 is restarted at the session start time,
+ *   exactly like the Softdevice does at the beginning of a timeslot.
+ */
+static void standalone_ts_begin(void)
+{
+    /* continue from the end of the previous session */
+    m_start_time = timer_now();
+
+    NRF_TIMER0->TASKS_STOP = 1;
+    NRF_TIMER0->TASKS_CLEAR = 1;
+    NRF_TIMER0->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER0->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    NRF_TIMER0->PRESCALER = 4; /* 1MHz */
+    NRF_TIMER0->INTENCLR = 0xFFFFFFFF;
+    NRF_TIMER0->TASKS_START = 1;
+
+    m_is_in_timeslot = true;
+    if (m_stats.granted++ == 0)
+    {
+        m_stats.utilization = 100;
+        m_stats.utilization_permille = 1000;
+    }
+
+    /* notify other modules */
+    event_handler_on_ts_begin();
+    timer_on_ts_begin(m_start_time);
+    TRACE_BEGIN(MESH_TRACE_POINT_TIMESLOT, 0);
+    tc_on_ts_begin();
+}
+
+static void standalone_ts_end(void)
+{
+    timestamp_t end_time = timer_now();
+    TRACE_END(MESH_TRACE_POINT_TIMESLOT, 0);
+    radio_disable();
+    m_total_time += TIMER_DIFF(end_time, m_start_time);
+    timer_on_ts_end(end_time);
+    m_is_in_timeslot = false;
+
+    NRF_TIMER0->INTENCLR = 0xFFFFFFFF;
+    NRF_TIMER0->TASKS_STOP = 1;
+    NVIC_ClearPendingIRQ(TIMER0_IRQn);
+}
+
+/** Execute a forced command from the radio interrupt handler. */
+static bool forced_command_execute(void)
+{
+    switch (m_timeslot_forced_command)
+    {
+        case TS_FORCED_COMMAND_STOP:
+            m_timeslot_forced_command = TS_FORCED_COMMAND_NONE;
+            if (m_is_in_timeslot)
+            {
+                standalone_ts_end();
+            }
+            return true;
+
+        case TS_FORCED_COMMAND_RESTART:
+            m_timeslot_forced_command = TS_FORCED_COMMAND_NONE;
+            if (m_is_in_timeslot)
+            {
+                standalone_ts_end();
+                standalone_ts_begin();
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static void flash_op_execute(void)
+{
+#if defined(MESH_DFU) || defined(RBC_MESH_PERSISTENT_STORAGE)
+    if (m_is_in_timeslot)
+    {
+        mesh_flash_op_execute(TIMESLOT_STANDALONE_FLASH_OP_US);
+    }
+#endif
+}
+
+/*****************************************************************************
+* IRQ handlers
+*****************************************************************************/
+void RADIO_IRQHandler(void)
+{
+    if (forced_command_execute())
+    {
+        return;
+    }
+    if (m_is_in_timeslot)
+    {
+        radio_event_handler();
+        flash_op_execute();
+    }
+}
+
+void TIMER0_IRQHandler(void)
+{
+    if (m_is_in_timeslot)
+    {
+        timer_event_handler();
+        flash_op_execute();
+    }
+}
+
+/*****************************************************************************
+* Interface Functions
+*****************************************************************************/
+void timeslot_sd_event_handler(uint32_t evt)
+{
+    /* No Softdevice, no timeslot events. */
+}
+
+#if (NORDIC_SDK_VERSION >= 11)
+uint32_t timeslot_init(nrf_clock_lf_cfg_t lfclksrc)
+#else
+uint32_t timeslot_init(nrf_clock_lfclksrc_t lfclksrc)
+#endif
+{
+    if (m_framework_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    /* The radio needs the HF crystal, which the Softdevice would otherwise
+       have started for each timeslot. */
+    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+    NRF_CLOCK->TASKS_HFCLKSTART = 1;
+    while (!NRF_CLOCK->EVENTS_HFCLKSTARTED);
+
+    /* The LF clock drives the RTC timers. */
+#if (NORDIC_SDK_VERSION >= 11)
+    /* The Softdevice clock source enum matches the register. */
+    uint32_t lfclk_src = lfclksrc.source;
+#else
+    uint32_t lfclk_src;
+    switch (lfclksrc)
+    {
+        case NRF_CLOCK_LFCLKSRC_SYNTH_250_PPM:
+            lfclk_src = CLOCK_LFCLKSRC_SRC_Synth;
+            break;
+        case NRF_CLOCK_LFCLKSRC_XTAL_100_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_150_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_20_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_250_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_30_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_500_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_50_PPM:
+        case NRF_CLOCK_LFCLKSRC_XTAL_75_PPM:
+            lfclk_src = CLOCK_LFCLKSRC_SRC_Xtal;
+            break;
+        default: /* RC-sources, calibration is left to the application */
+            lfclk_src = CLOCK_LFCLKSRC_SRC_RC;
+    }
+#endif
+    NRF_CLOCK->LFCLKSRC = (lfclk_src << CLOCK_LFCLKSRC_SRC_Pos);
+    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
+    NRF_CLOCK->TASKS_LFCLKSTART = 1;
+    while (!NRF_CLOCK->EVENTS_LFCLKSTARTED);
+
+    NVIC_SetPriority(RADIO_IRQn, TIMESLOT_STANDALONE_IRQ_PRIORITY);
+    NVIC_SetPriority(TIMER0_IRQn, TIMESLOT_STANDALONE_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(RADIO_IRQn);
+    NVIC_EnableIRQ(RADIO_IRQn);
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_framework_initialized = true;
+
+    return NRF_SUCCESS;
+}
+
+void timeslot_stop(void)
+{
+    m_timeslot_forced_command = TS_FORCED_COMMAND_STOP;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (m_is_in_timeslot)
+    {
+        NVIC_SetPendingIRQ(RADIO_IRQn);
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+void timeslot_restart(void)
+{
+    m_timeslot_forced_command = TS_FORCED_COMMAND_RESTART;
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    if (m_is_in_timeslot)
+    {
+        NVIC_SetPendingIRQ(RADIO_IRQn);
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+uint32_t timeslot_resume(void)
+{
+    m_timeslot_forced_command = TS_FORCED_COMMAND_NONE;
+
+    if (timeslot_is_in_ts())
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    /* can't be interrupted by the radio, like the Softdevice START signal */
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    standalone_ts_begin();
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
+}
+
+timestamp_t timeslot_start_time_get(void)
+{
+    return m_start_time;
+}
+
+timestamp_t timeslot_end_time_get(void)
+{
+    if (!m_is_in_timeslot)
+    {
+        return 0;
+    }
+
+    /* the session never ends on its own, keep the end out of reach */
+    return timer_now() + timeslot_remaining_time_get();
+}
+
+timestamp_t timeslot_remaining_time_get(void)
+{
+    if (!m_is_in_timeslot)
+    {
+        return 0;
+    }
+    return (UINT32_MAX / 4);
+}
+
+bool timeslot_is_in_ts(void)
+{
+    return m_is_in_timeslot;
+}
+
+uint32_t timeslot_end_margin_get(void)
+{
+    /* the session never ends on its own */
+    return UINT32_MAX;
+}
+
+void timeslot_stats_get(rbc_mesh_timeslot_stats_t* p_stats)
+{
+    memcpy(p_stats, &m_stats, sizeof(rbc_mesh_timeslot_stats_t));
+}
+
+uint64_t timeslot_total_time_get(void)
+{
+    if (m_is_in_timeslot)
+    {
+        return m_total_time + TIMER_DIFF(timer_now(), m_start_time);
+    }
+    return m_total_time;
+}
+
+void timeslot_conn_interval_set(uint32_t interval_us)
+{
+    /* No GATT connections without a Softdevice. */
+}
+
+void timeslot_scan_duty_cycle_set(uint32_t window_us, uint32_t interval_us)
+{
+    /* The radio is always available, scan continuously. */
+}
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+void timeslot_latency_mode_set(uint32_t period_us)
+{
+    /* The radio is always available, there's nothing to order. */
+}
+#endif
+
+#endif /* RBC_MESH_STANDALONE */
@@ -39,29 +39,34 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "timeslot.h"
 #include "timer_scheduler.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
 #include "version_handler.h"
 #include "mesh_aci.h"
+#include "fifo.h"
 #include "app_error.h"
 
-#if defined(WITH_ACK_MASTER) || defined (WITHOUT_ACK_MASTER)|| defined (WITH_ACK_SLAVE)
-
-#include "SEGGER_RTT.h"
-#include "nrf_gpio.h"
-#include "boards.h"
-#include <stdio.h>
-
-#endif
-
-#if defined(WITH_ACK_SLAVE)
-#include <handle.h>
-#endif
-
-
-
 #ifdef MESH_DFU
 #include "dfu_types_mesh.h"
 #include "dfu_app.h"
 #endif
+#if defined(RBC_MESH_DFU_QOS) && !defined(MESH_DFU)
+#error "RBC_MESH_DFU_QOS requires MESH_DFU"
+#endif
+#ifdef RBC_MESH_ENCRYPTION
+#include "mesh_crypt.h"
+#endif
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+#include "mesh_neighbor.h"
+#endif
+#ifdef RBC_MESH_SNIFFER
+#include "mesh_sniffer.h"
+#endif
+#ifdef RBC_MESH_CONFIG_PUSH
+#include "mesh_config.h"
+#endif
+#if defined(RBC_MESH_RADIO_PRIORITY) || defined(RBC_MESH_TX_NOTIFY)
+#include "handle_storage.h"
+#endif
 /* event push isn't present in the API header file. */
 extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
 
@@ -73,80 +78,202 @@ typedef struct
     uint32_t access_address;
     uint8_t channel;
     bool queue_saturation; /* flag indicating a full processing queue */
+#ifdef RBC_MESH_MULTICHANNEL
+    uint8_t tx_channel_index; /* advertisement channel to use for the next transmission */
+    uint8_t scan_index; /* position in the scan pattern */
+#endif
 } tc_state_t;
 
+/** Received packet waiting for processing in the event handler. */
+typedef struct
+{
+    mesh_packet_t* p_packet;
+    uint32_t crc;
+    uint32_t timestamp;
+    uint8_t rssi;
+} tc_rx_packet_t;
+
+#ifdef RBC_MESH_TX_NOTIFY
+/** Local update waiting for its transmissions, see tc_tx_notify_add(). The
+  slot is free when p_future is NULL. */
+typedef struct
+{
+    rbc_mesh_future_t* p_future;
+    rbc_mesh_value_handle_t handle; /* RBC_MESH_INVALID_HANDLE once cancelled */
+    uint16_t version;               /* version before the update */
+    uint8_t tx_left;
+    bool armed;                     /* the version has been taken */
+    bool any_version;               /* the handle had no version before the update */
+} tc_tx_notify_t;
+#endif
+
 /******************************************************************************
 * Static globals
 ******************************************************************************/
 static tc_state_t m_state;
 static rbc_mesh_packet_peek_cb_t mp_packet_peek_cb;
+static fifo_t m_rx_fifo;
+static tc_rx_packet_t m_rx_fifo_buffer[RBC_MESH_RX_QUEUE_LENGTH];
+#ifdef RBC_MESH_MULTICHANNEL
+static const uint8_t m_scan_pattern[] = RBC_MESH_SCAN_PATTERN;
+#endif
 
-/* STATS */
-#ifdef PACKET_STATS
-
-
-#if defined (WITH_ACK_MASTER) 
-static struct
-{
-    uint32_t queue_drop;
-    uint32_t queue_ok;
-    uint32_t crc_fail;
-} m_packet_stats __attribute__((at(0x20003030)))  = {0};
-
+#ifdef RBC_MESH_CHANNEL_QUALITY
+#define TC_ADV_CHANNEL_FIRST    (37)
+#define TC_ADV_CHANNEL_COUNT    (3)
+#define TC_CHANNEL_MAP_ALL      ((1 << TC_ADV_CHANNEL_COUNT) - 1)
+#define TC_RSSI_NONE            (100) /* reported by the radio when it didn't sample the RSSI */
 
-#elif defined(WITHOUT_ACK_MASTER) 
+/** Reception counters for each advertisement channel. */
 static struct
 {
-    uint32_t queue_drop;
-    uint32_t queue_ok;
-    uint32_t crc_fail;
-} m_packet_stats __attribute__((at(0x2000273C))) = {0};
-
-
+    uint32_t rx_ok;
+    uint32_t rx_crc_fail;
+    uint32_t period_rx_ok;      /* rx_ok at the start of the period */
+    uint32_t period_crc_fail;   /* rx_crc_fail at the start of the period */
+    uint8_t crc_fail_percent;
+    uint8_t crc_fail_rssi;      /* moving average, in -dBm */
+} m_channel_stats[TC_ADV_CHANNEL_COUNT];
+static uint8_t m_channel_map; /**< Advertisement channels in use, never empty. */
+#endif
 
-#elif defined(WITH_ACK_SLAVE)
+/** Handle filter applied in the radio callback. */
 static struct
 {
-    uint32_t queue_drop;
-    uint32_t queue_ok;
-    uint32_t crc_fail;
-} m_packet_stats __attribute__((at(0x20002750))) = {0};
-
-#elif defined(WITHOUT_ACK_SLAVE)
+    rbc_mesh_rx_filter_mode_t mode;
+    uint8_t range_count;
+    rbc_mesh_handle_range_t ranges[RBC_MESH_RX_FILTER_RANGES_MAX];
+} m_rx_filter;
+
+/** Extra mesh instances, see tc_instance_add(). Instance i uses radio logical
+  address TC_INSTANCE_LOGICAL_ADDRESS_BASE + i. */
+#define TC_INSTANCE_LOGICAL_ADDRESS_BASE    (2)
+static rbc_mesh_handle_range_t m_instance_handles[RBC_MESH_INSTANCES_MAX];
+static uint8_t m_instance_prefixes[RBC_MESH_INSTANCES_MAX];
+static uint8_t m_instance_count;
+
+/** Packet counters, reported through tc_stats_get(). */
 static struct
 {
-    uint32_t queue_drop;
-    uint32_t queue_ok;
-    uint32_t crc_fail;
-} m_packet_stats __attribute__((at(0x20002738))) = {0};
-
-#else
+    uint32_t rx_ok;
+    uint32_t rx_crc_fail;
+    uint32_t rx_queue_drop;
+    uint32_t rx_filtered;
+    uint32_t rx_auth_fail;
+    uint32_t rx_replayed;
+    uint32_t rx_foreign;
+    uint32_t tx_ok;
+    uint32_t tx_queue_drop;
+    uint32_t tx_dfu_held;
+} m_packet_stats;
+
+#ifdef RBC_MESH_DFU_QOS
+/** Airtime used by each kind of packet in the current window, in us. */
 static struct
 {
-    uint32_t queue_drop;
-    uint32_t queue_ok;
-    uint32_t crc_fail;
-} m_packet_stats = {0};
+    uint32_t window_start;
+    uint32_t dfu_us;
+    uint32_t value_us;
+    uint32_t value_us_prev; /* value traffic in the last window */
+    uint8_t share_percent;
+} m_dfu_qos;
+#endif
 
+#ifdef RBC_MESH_TX_NOTIFY
+static tc_tx_notify_t m_tx_notify[RBC_MESH_TX_NOTIFY_MAX];
 #endif
 
+#ifdef RBC_MESH_TX_BACKPRESSURE
+static tc_tx_ready_cb_t m_tx_ready_cb; /**< Called when a transmission is done, or NULL. */
 #endif
+
 /******************************************************************************
 * Static functions
 ******************************************************************************/
-static void rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi);
+static void rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi, uint32_t timestamp, uint8_t channel);
 static void tx_cb(uint8_t* p_data);
 
+#ifdef RBC_MESH_CHANNEL_QUALITY
+/** Check whether the given channel is in the channel map. Only the
+  advertisement channels can be left out. */
+static bool channel_is_used(uint8_t channel)
+{
+    return (channel < TC_ADV_CHANNEL_FIRST ||
+            channel >= TC_ADV_CHANNEL_FIRST + TC_ADV_CHANNEL_COUNT ||
+            (m_channel_map & (1 << (channel - TC_ADV_CHANNEL_FIRST))));
+}
+
+static void channel_quality_rx(uint8_t channel, bool success, uint32_t crc, uint8_t rssi)
+{
+    if (channel < TC_ADV_CHANNEL_FIRST || channel >= TC_ADV_CHANNEL_FIRST + TC_ADV_CHANNEL_COUNT)
+    {
+        return;
+    }
+    if (success)
+    {
+        m_channel_stats[channel - TC_ADV_CHANNEL_FIRST].rx_ok++;
+    }
+    else if (crc < 0x1000000) /* don't want to trigger on artifical crc values */
+    {
+        m_channel_stats[channel - TC_ADV_CHANNEL_FIRST].rx_crc_fail++;
+        if (rssi != TC_RSSI_NONE)
+        {
+            uint8_t* p_rssi = &m_channel_stats[channel - TC_ADV_CHANNEL_FIRST].crc_fail_rssi;
+            *p_rssi = (*p_rssi == 0) ? rssi : (uint8_t) ((*p_rssi * 7UL + rssi) / 8);
+        }
+    }
+}
+#endif
+
+#ifdef RBC_MESH_MULTICHANNEL
+/** Get the advertisement channel for the next single channel transmission. */
+static uint8_t tx_channel_next(void)
+{
+    uint8_t channel;
+    do
+    {
+        channel = 37 + m_state.tx_channel_index;
+        if (++m_state.tx_channel_index >= 3)
+        {
+            m_state.tx_channel_index = 0;
+        }
+    }
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    while (!channel_is_used(channel)); /* the map is never empty */
+#else
+    while (false);
+#endif
+    return channel;
+}
+#endif
+
 static void order_search(void)
 {
     radio_event_t evt;
 
     evt.event_type = RADIO_EVENT_TYPE_RX_PREEMPTABLE;
+#ifdef RBC_MESH_MULTICHANNEL
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    /* skip the channels out of use, unless the pattern has nothing else */
+    for (uint32_t i = 0; i < sizeof(m_scan_pattern) && !channel_is_used(m_scan_pattern[m_state.scan_index]); ++i)
+    {
+        if (++m_state.scan_index >= sizeof(m_scan_pattern))
+        {
+            m_state.scan_index = 0;
+        }
+    }
+#endif
+    evt.channel = m_scan_pattern[m_state.scan_index];
+#else
     evt.channel = m_state.channel;
+#endif
 
-    if (!mesh_packet_acquire((mesh_packet_t**) &evt.packet_ptr))
+    if (!mesh_packet_acquire_rx((mesh_packet_t**) &evt.packet_ptr))
     {
-        return; /* something is hogging all the packets */
+        /* something is hogging the packets, stop listening and leave the
+           reserve to the rest of the framework. The next transmission or
+           timeslot makes the radio idle again, and retries. */
+        return;
     }
 
     if (radio_order(&evt) != NRF_SUCCESS)
@@ -154,41 +281,166 @@ static void order_search(void)
         /* couldn't queue the packet for reception, immediately free its only ref */
         mesh_packet_ref_count_dec((mesh_packet_t*) evt.packet_ptr);
     }
+#ifdef RBC_MESH_MULTICHANNEL
+    else if (++m_state.scan_index >= sizeof(m_scan_pattern))
+    {
+        m_state.scan_index = 0;
+    }
+#endif
 }
 
 
+/** Check whether the RX filter lets the given packet through. Passes non-mesh
+  packets, and mesh packets with at least one framework or accepted handle. */
+static bool rx_filter_pass(mesh_packet_t* p_packet)
+{
+    if (m_rx_filter.mode == RBC_MESH_RX_FILTER_OFF)
+    {
+        return true;
+    }
+
+    bool is_mesh_packet = false;
+    for (mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+         p_adv_data != NULL;
+         p_adv_data = mesh_packet_adv_data_next_get(p_packet, p_adv_data))
+    {
+        is_mesh_packet = true;
+        if (p_adv_data->handle > RBC_MESH_APP_MAX_HANDLE)
+        {
+            return true;
+        }
+
+        bool in_range = false;
+        for (uint32_t i = 0; i < m_rx_filter.range_count; ++i)
+        {
+            if (p_adv_data->handle >= m_rx_filter.ranges[i].first &&
+                p_adv_data->handle <= m_rx_filter.ranges[i].last)
+            {
+                in_range = true;
+                break;
+            }
+        }
+        if (in_range == (m_rx_filter.mode == RBC_MESH_RX_FILTER_ACCEPT))
+        {
+            return true;
+        }
+    }
+    return !is_mesh_packet;
+}
+
+/** Get the radio logical address of the instance the handle belongs to, or
+  TC_INSTANCE_NONE for the primary mesh. */
+static uint8_t instance_logical_address_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_instance_count; ++i)
+    {
+        if (handle >= m_instance_handles[i].first &&
+            handle <= m_instance_handles[i].last)
+        {
+            return TC_INSTANCE_LOGICAL_ADDRESS_BASE + i;
+        }
+    }
+    return TC_INSTANCE_NONE;
+}
+
+/** Check that the application values in the packet belong to the instance of
+  the address the packet came in on. */
+static bool rx_instance_pass(mesh_packet_t* p_packet)
+{
+    if (m_instance_count == 0)
+    {
+        return true;
+    }
+
+    uint8_t rx_address = radio_rx_address_get();
+    if (rx_address < TC_INSTANCE_LOGICAL_ADDRESS_BASE)
+    {
+        rx_address = TC_INSTANCE_NONE;
+    }
+
+    for (mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+         p_adv_data != NULL;
+         p_adv_data = mesh_packet_adv_data_next_get(p_packet, p_adv_data))
+    {
+        if (p_adv_data->handle <= RBC_MESH_APP_MAX_HANDLE &&
+            instance_logical_address_get(p_adv_data->handle) != rx_address)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 /* immediate radio callback, executed in STACK_LOW */
-static void rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi)
+static void rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi, uint32_t timestamp, uint8_t channel)
 {
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    channel_quality_rx(channel, success, crc, rssi);
+#endif
+#ifdef RBC_MESH_SNIFFER
+    /* capture before decryption, leave out RX events that were preempted
+       before a packet came in */
+    if (success || crc <= 0xFFFFFF)
+    {
+        mesh_sniffer_rx(p_data, success, rssi, timestamp, channel);
+    }
+#endif
     if (success && ((mesh_packet_t*) p_data)->header.length <= MESH_PACKET_BLE_OVERHEAD + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
     {
-        async_event_t evt;
-        evt.type = EVENT_TYPE_PACKET;
-        evt.callback.packet.payload = p_data;
-        evt.callback.packet.crc = crc;
-        evt.callback.packet.timestamp = timer_now();
-        evt.callback.packet.rssi = rssi;
-        if (event_handler_push(&evt) != NRF_SUCCESS)
+        /* The radio is the only producer on the RX queue, and the event
+           handler the only consumer, fill the slot in place. */
+        tc_rx_packet_t* p_rx_packet;
+#ifdef RBC_MESH_ENCRYPTION
+        /* decrypt in place, everything after this sees the clear packet */
+        uint32_t crypt_status = mesh_crypt_decrypt((mesh_packet_t*) p_data);
+        if (crypt_status == NRF_ERROR_FORBIDDEN)
         {
-            m_state.queue_saturation = true;
-#ifdef PACKET_STATS
-            m_packet_stats.queue_drop++;
+            m_packet_stats.rx_replayed++;
+        }
+        else if (crypt_status != NRF_SUCCESS)
+        {
+            m_packet_stats.rx_auth_fail++;
+        }
+        else
 #endif
+        if (mp_packet_peek_cb == NULL &&
+            mesh_packet_adv_data_get((mesh_packet_t*) p_data) == NULL)
+        {
+            /* Other advertisers share the channel when the mesh runs on the
+               BLE advertising address. Drop their packets here, rather than
+               queuing them just to find that out in the event handler. The
+               packet peek callback gets every packet, so they're kept when
+               it's set. */
+            m_packet_stats.rx_foreign++;
+        }
+        else if (!rx_filter_pass((mesh_packet_t*) p_data) ||
+            !rx_instance_pass((mesh_packet_t*) p_data))
+        {
+            m_packet_stats.rx_filtered++;
+        }
+        else if (fifo_reserve(&m_rx_fifo, (void**) &p_rx_packet) != NRF_SUCCESS)
+        {
+            m_state.queue_saturation = true;
+            m_packet_stats.rx_queue_drop++;
         }
         else
         {
+            p_rx_packet->p_packet = (mesh_packet_t*) p_data;
+            p_rx_packet->crc = crc;
+            p_rx_packet->timestamp = timestamp;
+            p_rx_packet->rssi = rssi;
             mesh_packet_ref_count_inc((mesh_packet_t*) p_data); /* event handler has a ref */
+            fifo_commit(&m_rx_fifo);
 
-#ifdef PACKET_STATS
-            m_packet_stats.queue_ok++;
-#endif
+            /* the whole RX queue is processed in one event handler run */
+            event_handler_rx_signal();
+
+            m_packet_stats.rx_ok++;
         }
     }
     else if (crc < 0x1000000) /* don't want to trigger on artifical crc values */
     {
-#ifdef PACKET_STATS
-        m_packet_stats.crc_fail++;
-#endif
+        m_packet_stats.rx_crc_fail++;
     }
 
     /* no longer needed in this context */
@@ -200,34 +452,109 @@ static void rx_cb(uint8_t* p_data, bool success, uint32_t crc, uint8_t rssi)
 
 
 
+#ifdef RBC_MESH_TX_NOTIFY
+static void tx_notify_complete(tc_tx_notify_t* p_notify)
+{
+    rbc_mesh_future_t* p_future = p_notify->p_future;
+    p_notify->p_future = NULL;
+
+    /* the application may reuse the future as soon as it's done */
+    rbc_mesh_future_cb_t callback = p_future->callback;
+    void* p_context = p_future->p_context;
+    p_future->error_code = NRF_SUCCESS;
+    p_future->done = true;
+    if (callback != NULL)
+    {
+        callback(NRF_SUCCESS, p_context);
+    }
+}
+
+/** Take the version of the handle before its update. Queued right before the
+  update, so every earlier update of the handle has been applied. */
+static void tx_notify_arm(void* p_context)
+{
+    tc_tx_notify_t* p_notify = (tc_tx_notify_t*) p_context;
+    if (p_notify->handle == RBC_MESH_INVALID_HANDLE)
+    {
+        /* cancelled while the event was queued */
+        p_notify->p_future = NULL;
+        return;
+    }
+    handle_info_t info;
+    p_notify->any_version = (handle_storage_info_get(p_notify->handle, &info) != NRF_SUCCESS);
+    if (info.p_packet != NULL)
+    {
+        mesh_packet_ref_count_dec(info.p_packet);
+    }
+    p_notify->version = info.version;
+    p_notify->armed = true;
+}
+
+static void tx_notify_on_tx(const mesh_adv_data_t* p_adv_data)
+{
+    for (uint32_t i = 0; i < RBC_MESH_TX_NOTIFY_MAX; ++i)
+    {
+        tc_tx_notify_t* p_notify = &m_tx_notify[i];
+        if (p_notify->p_future != NULL &&
+            p_notify->armed &&
+            p_notify->handle == p_adv_data->handle &&
+            (p_notify->any_version || version_delta(p_notify->version, p_adv_data->version) > 0) &&
+            --p_notify->tx_left == 0)
+        {
+            tx_notify_complete(p_notify);
+        }
+    }
+}
+#endif
+
 /* radio tx cb, executed in APP_LOW */
 static void async_tx_cb(void* p_context)
 {
     mesh_packet_t* p_packet = (mesh_packet_t*) p_context;
     rbc_mesh_event_t tx_event;
-    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
-    bool doing_tx_event = false;
-    if (p_adv_data != NULL &&
-        vh_tx_event_flag_get(p_adv_data->handle, &doing_tx_event) == NRF_SUCCESS
-        && doing_tx_event)
-    {
-        tx_event.type = RBC_MESH_EVENT_TYPE_TX;
-        tx_event.params.tx.value_handle  = p_adv_data->handle;
-        tx_event.params.tx.p_data        = p_adv_data->data;
-        tx_event.params.tx.data_len      = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
-        tx_event.params.tx.timestamp_us  = timer_now();
-
-        rbc_mesh_event_push(&tx_event); /* will take care of the reference counting itself. */
+    /* aggregated packets may carry several values */
+    for (mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+         p_adv_data != NULL;
+         p_adv_data = mesh_packet_adv_data_next_get(p_packet, p_adv_data))
+    {
+        bool doing_tx_event = false;
+        if (vh_tx_event_flag_get(p_adv_data->handle, &doing_tx_event) == NRF_SUCCESS
+            && doing_tx_event)
+        {
+            tx_event.type = RBC_MESH_EVENT_TYPE_TX;
+            tx_event.params.tx.value_handle  = p_adv_data->handle;
+            tx_event.params.tx.p_data        = p_adv_data->data;
+            tx_event.params.tx.data_len      = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+            tx_event.params.tx.tx_count      = 1;
+            tx_event.params.tx.timestamp_us  = timer_now();
+
+            rbc_mesh_event_push(&tx_event); /* will take care of the reference counting itself. */
 #ifdef RBC_MESH_SERIAL
-        mesh_aci_rbc_event_handler(&tx_event);
+            mesh_aci_rbc_event_handler(&tx_event);
+#endif
+        }
+#ifdef RBC_MESH_TX_NOTIFY
+        tx_notify_on_tx(p_adv_data);
 #endif
     }
     mesh_packet_ref_count_dec(p_packet); /* event-handler reference popped. */
+
+#ifdef RBC_MESH_TX_BACKPRESSURE
+    /* the transmission has left a radio queue slot */
+    tc_tx_ready_cb_t ready_cb = m_tx_ready_cb;
+    if (ready_cb != NULL)
+    {
+        m_tx_ready_cb = NULL;
+        ready_cb();
+    }
+#endif
 }
 
 /* radio callback, executed in STACK_LOW */
 static void tx_cb(uint8_t* p_data)
 {
+    m_packet_stats.tx_ok++;
+
     /* have to defer tx-event handling to async context to avoid race
        conditions in the handle_storage */
     async_event_t tx_cb_evt =
@@ -254,8 +581,123 @@ static void radio_idle_callback(void)
         order_search();
 }
 
+#ifdef RBC_MESH_RADIO_PRIORITY
+/** Get the radio queue class of a packet. */
+static radio_priority_t tx_priority_get(mesh_packet_t* p_packet)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL)
+    {
+        return RADIO_PRIORITY_NORMAL;
+    }
+#ifdef MESH_DFU
+    switch (p_adv_data->handle)
+    {
+        case DFU_PACKET_TYPE_DATA:
+        case DFU_PACKET_TYPE_DATA_COPY:
+        case DFU_PACKET_TYPE_DATA_PARITY:
+        case DFU_PACKET_TYPE_DATA_RSP:
+            return RADIO_PRIORITY_BULK;
+        default:
+            if (p_adv_data->handle >= DFU_PACKET_TYPE_PROGRESS)
+            {
+                return RADIO_PRIORITY_HIGH;
+            }
+            break;
+    }
+#endif
+    bool urgent;
+    if (p_adv_data->handle <= RBC_MESH_APP_MAX_HANDLE &&
+        handle_storage_flag_get(p_adv_data->handle, HANDLE_FLAG_URGENT, &urgent) == NRF_SUCCESS &&
+        urgent)
+    {
+        return RADIO_PRIORITY_HIGH;
+    }
+    return RADIO_PRIORITY_NORMAL;
+}
+#endif
+
+#ifdef RBC_MESH_DFU_QOS
+static bool packet_is_dfu(mesh_packet_t* p_packet)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    return (p_adv_data != NULL && p_adv_data->handle >= DFU_PACKET_TYPE_PROGRESS);
+}
+
+static void dfu_qos_window_update(void)
+{
+    uint32_t now = timer_now();
+    uint32_t elapsed = TIMER_DIFF(now, m_dfu_qos.window_start);
+    if (elapsed >= RBC_MESH_DFU_QOS_WINDOW_US)
+    {
+        /* a longer gap means there was no traffic in the last window */
+        m_dfu_qos.value_us_prev = (elapsed >= 2 * RBC_MESH_DFU_QOS_WINDOW_US ? 0 : m_dfu_qos.value_us);
+        m_dfu_qos.value_us = 0;
+        m_dfu_qos.dfu_us = 0;
+        m_dfu_qos.window_start = now;
+    }
+}
+
+/** Whether a DFU packet taking the given airtime fits in the budget. DFU may
+  take all the air as long as no values are sent, but its share is capped
+  once they are. */
+static bool dfu_qos_allow(uint32_t airtime_us, uint32_t channels)
+{
+    if (radio_queue_len_get() + channels > RBC_MESH_RADIO_QUEUE_LENGTH - RBC_MESH_DFU_QOS_RADIO_RESERVE)
+    {
+        return false;
+    }
+    uint32_t value_demand_us = m_dfu_qos.value_us;
+    if (m_dfu_qos.value_us_prev > value_demand_us)
+    {
+        value_demand_us = m_dfu_qos.value_us_prev;
+    }
+    if (value_demand_us == 0 || m_dfu_qos.share_percent >= 100)
+    {
+        return true;
+    }
+    uint32_t dfu_us = m_dfu_qos.dfu_us + airtime_us;
+    return (dfu_us * 100 <= m_dfu_qos.share_percent * (dfu_us + value_demand_us));
+}
+#endif
+
 static void mesh_framework_packet_handle(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
 {
+#ifdef RBC_MESH_SUMMARY_BEACON
+    if (p_adv_data->handle == RBC_MESH_SUMMARY_HANDLE)
+    {
+        (void) vh_summary_rx(p_adv_data, timestamp);
+        return;
+    }
+#endif
+#ifdef RBC_MESH_VERSION_REPAIR
+    if (p_adv_data->handle == RBC_MESH_REPAIR_HANDLE)
+    {
+        (void) vh_repair_rx(p_adv_data, timestamp);
+        return;
+    }
+#endif
+#ifdef RBC_MESH_TIME_SYNC
+    if (p_adv_data->handle == RBC_MESH_TIME_SYNC_HANDLE)
+    {
+        (void) vh_time_sync_rx(p_adv_data, timestamp);
+        return;
+    }
+#endif
+#ifdef RBC_MESH_LATENCY_PROBE
+    if (p_adv_data->handle == RBC_MESH_PROBE_HANDLE)
+    {
+        (void) vh_probe_rx(p_adv_data, timestamp);
+        return;
+    }
+#endif
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    if (p_adv_data->handle == RBC_MESH_CHANNEL_MAP_HANDLE)
+    {
+        (void) vh_channel_map_rx(p_adv_data, timestamp);
+        return;
+    }
+#endif
 #ifdef MESH_DFU
     mesh_dfu_adv_data_t* p_dfu = (mesh_dfu_adv_data_t*) p_adv_data;
     /* Tell the shared BL about the packet */
@@ -273,6 +715,34 @@ static void mesh_framework_packet_handle(mesh_adv_data_t* p_adv_data, uint32_t t
 void tc_init(uint32_t access_address, uint8_t channel)
 {
     mp_packet_peek_cb = NULL;
+    m_rx_filter.mode = RBC_MESH_RX_FILTER_OFF;
+    m_rx_filter.range_count = 0;
+
+    m_rx_fifo.array_len = RBC_MESH_RX_QUEUE_LENGTH;
+    m_rx_fifo.elem_array = m_rx_fifo_buffer;
+    m_rx_fifo.elem_size = sizeof(tc_rx_packet_t);
+    m_rx_fifo.memcpy_fptr = NULL;
+    fifo_init(&m_rx_fifo);
+
+#ifdef RBC_MESH_MULTICHANNEL
+    m_state.tx_channel_index = 0;
+    m_state.scan_index = 0;
+#endif
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    memset(m_channel_stats, 0, sizeof(m_channel_stats));
+    m_channel_map = TC_CHANNEL_MAP_ALL;
+#endif
+#ifdef RBC_MESH_TX_BACKPRESSURE
+    m_tx_ready_cb = NULL;
+#endif
+#ifdef RBC_MESH_DFU_QOS
+    memset(&m_dfu_qos, 0, sizeof(m_dfu_qos));
+    m_dfu_qos.window_start = timer_now();
+    m_dfu_qos.share_percent = RBC_MESH_DFU_SHARE_PERCENT;
+#endif
+#ifdef RBC_MESH_TX_NOTIFY
+    memset(m_tx_notify, 0, sizeof(m_tx_notify));
+#endif
     tc_radio_params_set(access_address, channel);
 }
 
@@ -304,21 +774,74 @@ uint32_t tc_tx(mesh_packet_t* p_packet, const tc_tx_config_t* p_config)
     p_packet->header._rfu2 = 0;
     p_packet->header._rfu3 = 0;
 
+#ifdef RBC_MESH_ENCRYPTION
+    /* the radio encrypts the packet on its way out, but can't without a key */
+    if (!mesh_crypt_key_is_set() && mesh_crypt_packet_is_protected(p_packet))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+#endif
+
+#ifdef RBC_MESH_DFU_QOS
+    /* each channel in the map is a separate transmission */
+    uint32_t channels = 0;
+    for (uint32_t map = p_config->channel_map; map != 0; map >>= 1)
+    {
+        channels += (map & 1);
+    }
+    uint32_t airtime_us = channels * radio_event_duration_get();
+    bool is_dfu = packet_is_dfu(p_packet);
+    dfu_qos_window_update();
+    if (is_dfu && !dfu_qos_allow(airtime_us, channels))
+    {
+        m_packet_stats.tx_dfu_held++;
+        return NRF_ERROR_BUSY;
+    }
+#endif
+
     event.packet_ptr = (uint8_t*) p_packet;
     event.access_address = p_config->alt_access_address;
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data != NULL)
+    {
+        uint8_t instance_address = instance_logical_address_get(p_adv_data->handle);
+        if (instance_address != TC_INSTANCE_NONE)
+        {
+            event.access_address = instance_address;
+        }
+    }
     event.channel = p_config->first_channel;
     event.event_type = RADIO_EVENT_TYPE_TX;
+
+#ifdef RBC_MESH_MULTICHANNEL
+    if (p_config->channel_map == 1)
+    {
+        /* single channel transmissions rotate across the adv channels */
+        event.channel = tx_channel_next();
+    }
+#endif
     event.tx_power = (uint8_t) p_config->tx_power;
+#ifdef RBC_MESH_RADIO_PRIORITY
+    event.priority = (uint8_t) tx_priority_get(p_packet);
+#else
+    event.priority = RADIO_PRIORITY_NORMAL;
+#endif
 
     /* send packet on each channel in the channel map */
     for (uint32_t i = 0; i < 32; ++i)
     {
+#ifdef RBC_MESH_CHANNEL_QUALITY
+        if ((p_config->channel_map & (1 << i)) &&
+            (p_config->channel_map == 1 || channel_is_used(event.channel)))
+#else
         if (p_config->channel_map & (1 << i))
+#endif
         {
             mesh_packet_ref_count_inc(p_packet); /* queue will have a reference until tx_cb */
             if (radio_order(&event) != NRF_SUCCESS)
             {
                 mesh_packet_ref_count_dec(p_packet); /* queue couldn't hold the ref */
+                m_packet_stats.tx_queue_drop++;
                 return NRF_ERROR_NO_MEM;
             }
         }
@@ -330,20 +853,54 @@ uint32_t tc_tx(mesh_packet_t* p_packet, const tc_tx_config_t* p_config)
         event.channel++;
     }
 
+#ifdef RBC_MESH_DFU_QOS
+    if (is_dfu)
+    {
+        m_dfu_qos.dfu_us += airtime_us;
+    }
+    else
+    {
+        m_dfu_qos.value_us += airtime_us;
+    }
+#endif
     return NRF_SUCCESS;
 }
 
+#ifdef RBC_MESH_TX_BACKPRESSURE
+uint32_t tc_tx_slots_get(const tc_tx_config_t* p_tx_config)
+{
+    uint32_t channels = 0;
+    for (uint32_t map = p_tx_config->channel_map; map != 0; map >>= 1)
+    {
+        channels += (map & 1);
+    }
+    uint32_t queue_len = radio_queue_len_get();
+    if (channels == 0 || queue_len >= RBC_MESH_RADIO_QUEUE_LENGTH)
+    {
+        return 0;
+    }
+    return (RBC_MESH_RADIO_QUEUE_LENGTH - queue_len) / channels;
+}
+
+void tc_tx_ready_wait(tc_tx_ready_cb_t callback)
+{
+    m_tx_ready_cb = callback;
+}
+#endif
+
 /* packet processing, executed in APP_LOW */
 void tc_packet_handler(uint8_t* data, uint32_t crc, uint32_t timestamp, uint8_t rssi)
 {
     APP_ERROR_CHECK_BOOL(data != NULL);
     SET_PIN(PIN_RX);
+    TRACE_BEGIN(MESH_TRACE_POINT_RX_PACKET, 0);
     mesh_packet_t* p_packet = (mesh_packet_t*) data;
 
     if (p_packet->header.length > BLE_GAP_ADDR_LEN + BLE_ADV_PACKET_PAYLOAD_MAX_LENGTH)
     {
         /* invalid packet, ignore */
         CLEAR_PIN(PIN_RX);
+        TRACE_END(MESH_TRACE_POINT_RX_PACKET, 0);
         mesh_packet_ref_count_dec(p_packet); /* from rx_cb */
 
         return;
@@ -372,13 +929,47 @@ void tc_packet_handler(uint8_t* data, uint32_t crc, uint32_t timestamp, uint8_t
 
     if (p_mesh_adv_data != NULL)
     {
+#ifdef RBC_MESH_NEIGHBOR_TABLE
+        mesh_neighbor_rx(&addr, rssi, timestamp);
+#endif
         /* filter mesh packets on handle range */
         if (p_mesh_adv_data->handle <= RBC_MESH_APP_MAX_HANDLE)
         {
-            vh_rx(p_packet, timestamp, rssi);
+            vh_rx(p_packet, crc, timestamp, rssi);
+        }
+#ifdef RBC_MESH_DELTA_UPDATES
+        else if (p_mesh_adv_data->handle == RBC_MESH_DELTA_HANDLE)
+        {
+            vh_delta_rx(p_packet, timestamp, rssi);
+        }
+#endif
+#ifdef RBC_MESH_NETWORK_CODING
+        else if (p_mesh_adv_data->handle == RBC_MESH_NETCODE_HANDLE)
+        {
+            (void) vh_netcode_rx(p_packet, timestamp, rssi);
         }
+#endif
+#ifdef RBC_MESH_BOOTSTRAP
+        else if (p_mesh_adv_data->handle == RBC_MESH_BOOTSTRAP_HANDLE)
+        {
+            (void) vh_bootstrap_rx(p_packet, timestamp);
+        }
+#endif
+#ifdef RBC_MESH_CONFIG_PUSH
+        else if (p_mesh_adv_data->handle == RBC_MESH_CONFIG_HANDLE)
+        {
+            (void) mesh_config_rx(p_mesh_adv_data, timestamp);
+        }
+#endif
         else
         {
+#ifdef RBC_MESH_BOOTSTRAP
+            if (p_mesh_adv_data->handle == RBC_MESH_SUMMARY_HANDLE)
+            {
+                /* summary beacons come straight from the neighbors, they aren't relayed */
+                vh_bootstrap_neighbor_rx(p_packet->addr, rssi);
+            }
+#endif
             mesh_framework_packet_handle(p_mesh_adv_data, timestamp);
         }
     }
@@ -393,9 +984,236 @@ void tc_packet_handler(uint8_t* data, uint32_t crc, uint32_t timestamp, uint8_t
     }
 
     CLEAR_PIN(PIN_RX);
+    TRACE_END(MESH_TRACE_POINT_RX_PACKET, 0);
+}
+
+uint32_t tc_rx_queue_process(uint32_t max_count)
+{
+    uint32_t count = 0;
+    tc_rx_packet_t rx_packet;
+    while (count < max_count && fifo_spsc_pop(&m_rx_fifo, &rx_packet) == NRF_SUCCESS)
+    {
+        tc_packet_handler((uint8_t*) rx_packet.p_packet,
+                          rx_packet.crc,
+                          rx_packet.timestamp,
+                          rx_packet.rssi);
+        count++;
+    }
+    return count;
+}
+
+uint32_t tc_rx_queue_length(void)
+{
+    return fifo_get_len(&m_rx_fifo);
 }
 
 void tc_packet_peek_cb_set(rbc_mesh_packet_peek_cb_t packet_peek_cb)
 {
     mp_packet_peek_cb = packet_peek_cb;
 }
+
+void tc_rx_filter_set(rbc_mesh_rx_filter_mode_t mode,
+        const rbc_mesh_handle_range_t* p_ranges,
+        uint8_t range_count)
+{
+    /* the filter is read in the radio callback, update it in one go */
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_rx_filter.mode = mode;
+    m_rx_filter.range_count = (mode == RBC_MESH_RX_FILTER_OFF) ? 0 : range_count;
+    if (m_rx_filter.range_count > 0)
+    {
+        memcpy(m_rx_filter.ranges, p_ranges, sizeof(rbc_mesh_handle_range_t) * range_count);
+    }
+    _ENABLE_IRQS(was_masked);
+}
+
+uint32_t tc_instance_add(uint32_t access_address, const rbc_mesh_handle_range_t* p_handles)
+{
+    uint8_t prefix = (uint8_t) (access_address >> 24);
+    if ((access_address & 0x00FFFFFF) != (m_state.access_address & 0x00FFFFFF) ||
+        access_address == RBC_MESH_ACCESS_ADDRESS_BLE_ADV ||
+        prefix == 0)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_handles->last < p_handles->first ||
+        p_handles->last > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    for (uint32_t i = 0; i < m_instance_count; ++i)
+    {
+        if (m_instance_prefixes[i] == prefix ||
+            (p_handles->first <= m_instance_handles[i].last &&
+             p_handles->last >= m_instance_handles[i].first))
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+    }
+    if (m_instance_count >= RBC_MESH_INSTANCES_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint32_t error_code = radio_aa_prefix_set(TC_INSTANCE_LOGICAL_ADDRESS_BASE + m_instance_count, prefix);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    /* the instances are read in the radio callback */
+    uint32_t was_masked;
+    _DISABLE_IRQS(was_masked);
+    m_instance_handles[m_instance_count] = *p_handles;
+    m_instance_prefixes[m_instance_count] = prefix;
+    m_instance_count++;
+    _ENABLE_IRQS(was_masked);
+    return NRF_SUCCESS;
+}
+
+uint8_t tc_instance_get(rbc_mesh_value_handle_t handle)
+{
+    return instance_logical_address_get(handle);
+}
+
+void tc_stats_get(rbc_mesh_stats_t* p_stats)
+{
+    p_stats->rx_ok = m_packet_stats.rx_ok;
+    p_stats->rx_crc_fail = m_packet_stats.rx_crc_fail;
+    p_stats->rx_queue_drop = m_packet_stats.rx_queue_drop;
+    p_stats->rx_filtered = m_packet_stats.rx_filtered;
+    p_stats->rx_auth_fail = m_packet_stats.rx_auth_fail;
+    p_stats->rx_replayed = m_packet_stats.rx_replayed;
+    p_stats->rx_foreign = m_packet_stats.rx_foreign;
+    p_stats->tx_ok = m_packet_stats.tx_ok;
+    p_stats->tx_queue_drop = m_packet_stats.tx_queue_drop;
+    p_stats->tx_dfu_held = m_packet_stats.tx_dfu_held;
+}
+
+#ifdef RBC_MESH_CHANNEL_QUALITY
+uint8_t tc_channel_quality_update(void)
+{
+    uint8_t bad_channels = 0;
+    for (uint32_t i = 0; i < TC_ADV_CHANNEL_COUNT; ++i)
+    {
+        uint32_t ok = m_channel_stats[i].rx_ok - m_channel_stats[i].period_rx_ok;
+        uint32_t failed = m_channel_stats[i].rx_crc_fail - m_channel_stats[i].period_crc_fail;
+        m_channel_stats[i].period_rx_ok += ok;
+        m_channel_stats[i].period_crc_fail += failed;
+
+        /* quiet channels keep their last verdict */
+        if (ok + failed >= RBC_MESH_CHANNEL_QUALITY_MIN_SAMPLES)
+        {
+            m_channel_stats[i].crc_fail_percent = (failed * 100) / (ok + failed);
+        }
+        if ((m_channel_map & (1 << i)) &&
+            m_channel_stats[i].crc_fail_percent >= RBC_MESH_CHANNEL_BLACKLIST_PERCENT)
+        {
+            bad_channels |= (1 << i);
+        }
+    }
+    return bad_channels;
+}
+
+void tc_channel_map_set(uint8_t channel_map)
+{
+    channel_map &= TC_CHANNEL_MAP_ALL;
+    if (channel_map != 0)
+    {
+        m_channel_map = channel_map;
+    }
+}
+
+uint8_t tc_channel_map_get(void)
+{
+    return m_channel_map;
+}
+
+uint32_t tc_channel_stats_get(uint8_t channel, rbc_mesh_channel_stats_t* p_stats)
+{
+    if (channel < TC_ADV_CHANNEL_FIRST || channel >= TC_ADV_CHANNEL_FIRST + TC_ADV_CHANNEL_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    uint32_t i = channel - TC_ADV_CHANNEL_FIRST;
+    p_stats->rx_ok = m_channel_stats[i].rx_ok;
+    p_stats->rx_crc_fail = m_channel_stats[i].rx_crc_fail;
+    p_stats->crc_fail_percent = m_channel_stats[i].crc_fail_percent;
+    p_stats->crc_fail_rssi = -((int8_t) m_channel_stats[i].crc_fail_rssi);
+    p_stats->in_use = channel_is_used(channel);
+    return NRF_SUCCESS;
+}
+#endif
+
+uint32_t tc_dfu_share_set(uint8_t percent)
+{
+#ifdef RBC_MESH_DFU_QOS
+    if (percent < 1 || percent > 100)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_dfu_qos.share_percent = percent;
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+#ifdef RBC_MESH_TX_NOTIFY
+uint32_t tc_tx_notify_add(rbc_mesh_value_handle_t handle, uint8_t tx_count, rbc_mesh_future_t* p_future)
+{
+    tc_tx_notify_t* p_notify = NULL;
+    event_handler_critical_section_begin();
+    for (uint32_t i = 0; i < RBC_MESH_TX_NOTIFY_MAX; ++i)
+    {
+        if (m_tx_notify[i].p_future == NULL)
+        {
+            p_notify = &m_tx_notify[i];
+            p_notify->handle = handle;
+            p_notify->tx_left = (tx_count == 0) ? 1 : tx_count;
+            p_notify->armed = false;
+            p_notify->p_future = p_future;
+            break;
+        }
+    }
+    event_handler_critical_section_end();
+    if (p_notify == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_future->done = false;
+    async_event_t arm_evt;
+    arm_evt.type = EVENT_TYPE_GENERIC;
+    arm_evt.callback.generic.cb = tx_notify_arm;
+    arm_evt.callback.generic.p_context = p_notify;
+    uint32_t error_code = event_handler_push(&arm_evt);
+    if (error_code != NRF_SUCCESS)
+    {
+        p_notify->p_future = NULL;
+    }
+    return error_code;
+}
+
+void tc_tx_notify_cancel(rbc_mesh_future_t* p_future)
+{
+    event_handler_critical_section_begin();
+    for (uint32_t i = 0; i < RBC_MESH_TX_NOTIFY_MAX; ++i)
+    {
+        if (m_tx_notify[i].p_future == p_future)
+        {
+            if (m_tx_notify[i].armed)
+            {
+                m_tx_notify[i].p_future = NULL;
+            }
+            else
+            {
+                /* freed by the queued arm event */
+                m_tx_notify[i].handle = RBC_MESH_INVALID_HANDLE;
+            }
+        }
+    }
+    event_handler_critical_section_end();
+}
+#endif
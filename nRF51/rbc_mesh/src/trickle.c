@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "trickle.h"
 #include "rbc_mesh_common.h"
 #include "app_error.h"
+#include "nrf_error.h"
 #include "rand.h"
 #include "timer.h"
 
@@ -43,29 +44,147 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 
 #define TIME_MARGIN (1000)
+
+#ifdef RBC_MESH_COMPACT_TRICKLE
+#define TICKS_GET(time_us)          ((uint16_t) ((time_us) >> RBC_MESH_TRICKLE_TICK_SHIFT))
+/** Longest interval, a quarter of the tick range. t is set up to two
+  intervals ahead, which keeps it within half the range. */
+#define COMPACT_INTERVAL_MAX        ((uint32_t) (0x10000 / 4) << RBC_MESH_TRICKLE_TICK_SHIFT)
+#define TIME_GET(ticks, time_ref)   ticks_to_time(ticks, time_ref)
+#define TIME_SET(time_us)           TICKS_GET(time_us)
+#define INTERVAL_LIMIT              (COMPACT_INTERVAL_MAX)
+#else
+#define TIME_GET(time, time_ref)    (time)
+#define TIME_SET(time_us)           (time_us)
+/** Longest interval, a quarter of the timer range for the same reason. */
+#define INTERVAL_LIMIT              ((uint32_t) 1 << 29)
+#endif
 /*****************************************************************************
 * Static Globals
 *****************************************************************************/
 
-/*global parameters for trickle behavior, set in trickle_setup() */
-static uint32_t g_i_min, g_i_max;
-static uint8_t g_k;
+/** Parameters for one trickle class */
+typedef struct
+{
+    uint32_t i_min;
+    uint32_t i_max;
+    uint8_t k;
+    bool configured; /**< Explicitly configured, not overwritten by trickle_setup() */
+} trickle_params_t;
+
+/*global parameters for trickle behavior, set in trickle_setup() and trickle_class_setup() */
+static trickle_params_t g_params[RBC_MESH_TRICKLE_CLASS_COUNT];
+
+/** Number of PRNG draws between each attempt to mix in fresh HW entropy. */
+#define TRICKLE_RESEED_INTERVAL (256)
 
 static prng_t g_rand;
+static uint32_t g_rand_draws;
+
+static uint32_t g_reset_count;
+static uint32_t g_rx_consistent_count;
+static uint32_t g_rx_inconsistent_count;
+
+/** Run time adjustment of the parameters that weren't explicitly configured, see trickle_tune_set(). */
+static struct
+{
+    bool active;
+    uint8_t k;
+    int8_t i_max_shift;
+} g_tune;
 
 /*****************************************************************************
 * Static Functions
 *****************************************************************************/
+static uint32_t params_i_max_get(const trickle_params_t* p_params)
+{
+    if (!g_tune.active || p_params->configured)
+    {
+        return p_params->i_max;
+    }
+    if (g_tune.i_max_shift < 0)
+    {
+        uint32_t i_max = p_params->i_max >> (-g_tune.i_max_shift);
+        return (i_max > 0 ? i_max : 1);
+    }
+    /* keep the interval within half the timer range */
+    uint32_t i_max = p_params->i_max;
+    for (int8_t i = 0; i < g_tune.i_max_shift && i_max <= (UINT32_MAX / 4) / p_params->i_min; ++i)
+    {
+        i_max <<= 1;
+    }
+    return i_max;
+}
+
+/** Get the longest interval of a class in us. */
+static uint32_t interval_max_get(const trickle_params_t* p_params)
+{
+    uint32_t i_max = params_i_max_get(p_params);
+    if (i_max > INTERVAL_LIMIT / p_params->i_min)
+    {
+        /* also where unbounded classes end up */
+        return (p_params->i_min < INTERVAL_LIMIT) ? INTERVAL_LIMIT : p_params->i_min;
+    }
+    return i_max * p_params->i_min;
+}
+
+static uint8_t params_k_get(const trickle_params_t* p_params)
+{
+    if (!g_tune.active || p_params->configured)
+    {
+        return p_params->k;
+    }
+    return g_tune.k;
+}
+
+/** Draw from the Trickle PRNG, reseeding it at regular intervals. The reseed
+  doesn't wait for the HW RNG, and is tried again on the next draw if it has
+  nothing ready. */
+static uint32_t trickle_rand_get(void)
+{
+    if (++g_rand_draws >= TRICKLE_RESEED_INTERVAL &&
+        rand_prng_reseed(&g_rand) == NRF_SUCCESS)
+    {
+        g_rand_draws = 0;
+    }
+    return rand_prng_get(&g_rand);
+}
+
+#ifdef RBC_MESH_COMPACT_TRICKLE
+/** Get the time of a tick value, taking the one closest to the reference time. */
+static uint32_t ticks_to_time(uint16_t ticks, uint32_t time_ref)
+{
+    int16_t diff = (int16_t) (ticks - TICKS_GET(time_ref));
+    return ((time_ref >> RBC_MESH_TRICKLE_TICK_SHIFT) + diff) << RBC_MESH_TRICKLE_TICK_SHIFT;
+}
+#endif
+
+/** Get the length of the current interval, the i value in IETF RFC6206. */
+static uint32_t interval_get(const trickle_t* trickle)
+{
+#ifdef RBC_MESH_COMPACT_TRICKLE
+    const trickle_params_t* p_params = &g_params[trickle->param_class];
+    uint32_t i_max = interval_max_get(p_params);
+    if ((i_max >> trickle->i_exp) >= p_params->i_min)
+    {
+        return p_params->i_min << trickle->i_exp;
+    }
+    return i_max;
+#else
+    return trickle->i_relative;
+#endif
+}
+
 /**
 * @brief Do calculations for beginning of a trickle interval. Is called from
 *   trickle_step function.
 */
-static void trickle_interval_begin(trickle_t* trickle)
+static void trickle_interval_begin(trickle_t* trickle, uint32_t time_now)
 {
     if (trickle_is_enabled(trickle))
     {
         trickle->c = 0;
-        trickle->i += trickle->i_relative;
+        trickle->i = TIME_SET(TIME_GET(trickle->i, time_now) + interval_get(trickle));
     }
 }
 
@@ -78,24 +197,30 @@ static void refresh_t(trickle_t* trickle, uint32_t time_now)
     }
     time_prev = time_now;
 
-    uint32_t rand_number = rand_prng_get(&g_rand);
+    uint32_t rand_number = trickle_rand_get();
 
-    uint32_t i_half = trickle->i_relative >> 1;
+    uint32_t i_half = interval_get(trickle) >> 1;
 
-    trickle->t = trickle->i + i_half + (rand_number % i_half);
+    trickle->t = TIME_SET(TIME_GET(trickle->i, time_now) + i_half + (rand_number % i_half));
 }
 
 static void check_interval(trickle_t* trickle, uint32_t time_now)
 {
-    if (!TIMER_OLDER_THAN(time_now, trickle->i) && trickle_is_enabled(trickle))
+    if (!TIMER_OLDER_THAN(time_now, TIME_GET(trickle->i, time_now)) && trickle_is_enabled(trickle))
     {
-        if (trickle->i_relative < g_i_max * g_i_min)
+        uint32_t i_max = interval_max_get(&g_params[trickle->param_class]);
+#ifdef RBC_MESH_COMPACT_TRICKLE
+        if (interval_get(trickle) < i_max && trickle->i_exp < 31)
+            trickle->i_exp++;
+#else
+        if (trickle->i_relative < i_max)
             trickle->i_relative <<= 1;
-        else
-            trickle->i_relative = g_i_max * g_i_min;
+        if (trickle->i_relative > i_max)
+            trickle->i_relative = i_max;
+#endif
         /* we've started a new interval since we last touched this trickle */
         trickle->c = 0;
-        trickle->i = trickle->i_relative + time_now;
+        trickle->i = TIME_SET(interval_get(trickle) + time_now);
     }
 }
 
@@ -104,11 +229,61 @@ static void check_interval(trickle_t* trickle, uint32_t time_now)
 *****************************************************************************/
 void trickle_setup(uint32_t i_min, uint32_t i_max, uint8_t k)
 {
-    g_i_min = i_min;
-    g_i_max = i_max;
-    g_k = k;
+    for (uint32_t i = 0; i < RBC_MESH_TRICKLE_CLASS_COUNT; ++i)
+    {
+        if (i == RBC_MESH_TRICKLE_CLASS_DEFAULT || !g_params[i].configured)
+        {
+            g_params[i].i_min = i_min;
+            g_params[i].i_max = i_max;
+            g_params[i].k = k;
+        }
+    }
 
     rand_prng_seed(&g_rand);
+    g_rand_draws = 0;
+}
+
+uint32_t trickle_class_setup(uint8_t param_class, uint32_t i_min, uint32_t i_max, uint8_t k)
+{
+    if (param_class >= RBC_MESH_TRICKLE_CLASS_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (i_min == 0 || i_max == 0 || k == 0 || k >= TRICKLE_C_DISABLED)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#ifdef RBC_MESH_COMPACT_TRICKLE
+    if (i_min > COMPACT_INTERVAL_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_params[param_class].i_min = i_min;
+    g_params[param_class].i_max = i_max;
+    g_params[param_class].k = k;
+    g_params[param_class].configured = (param_class != RBC_MESH_TRICKLE_CLASS_DEFAULT);
+    return NRF_SUCCESS;
+}
+
+void trickle_class_set(trickle_t* trickle, uint8_t param_class, uint32_t time_now)
+{
+    if (param_class < RBC_MESH_TRICKLE_CLASS_COUNT &&
+        param_class != trickle->param_class)
+    {
+        trickle->param_class = param_class;
+        if (trickle_is_enabled(trickle))
+        {
+            /* start over with the new parameters */
+            trickle_timer_reset(trickle, time_now);
+        }
+    }
+}
+
+uint8_t trickle_class_get(trickle_t* trickle)
+{
+    return trickle->param_class;
 }
 
 void trickle_rx_consistent(trickle_t* trickle, uint32_t time_now)
@@ -116,6 +291,7 @@ void trickle_rx_consistent(trickle_t* trickle, uint32_t time_now)
     if (trickle_is_enabled(trickle))
     {
         TICK_PIN(PIN_CONSISTENT);
+        g_rx_consistent_count++;
         check_interval(trickle, time_now);
         if (trickle->c + 1 != TRICKLE_C_DISABLED)
         {
@@ -124,10 +300,26 @@ void trickle_rx_consistent(trickle_t* trickle, uint32_t time_now)
     }
 }
 
+void trickle_rx_summary_consistent(trickle_t* trickle, uint32_t time_now)
+{
+    trickle_rx_consistent(trickle, time_now);
+    const trickle_params_t* p_params = &g_params[trickle->param_class];
+    if (trickle_is_enabled(trickle) && p_params->i_max == TRICKLE_I_MAX_UNBOUNDED)
+    {
+        /* static values are verified by the summary alone */
+        uint8_t k = params_k_get(p_params);
+        if (trickle->c < k)
+        {
+            trickle->c = k;
+        }
+    }
+}
+
 void trickle_rx_inconsistent(trickle_t* trickle, uint32_t time_now)
 {
     TICK_PIN(PIN_INCONSISTENT);
-    if (trickle->i_relative > g_i_min)
+    g_rx_inconsistent_count++;
+    if (interval_get(trickle) > g_params[trickle->param_class].i_min)
     {
         trickle_timer_reset(trickle, time_now);
     }
@@ -135,18 +327,29 @@ void trickle_rx_inconsistent(trickle_t* trickle, uint32_t time_now)
 
 void trickle_timer_reset(trickle_t* trickle, uint32_t time_now)
 {
-    trickle->i = time_now;
-    trickle->i_relative = g_i_min;
+    g_reset_count++;
+#ifdef RBC_MESH_HANDLE_STATS
+    if (trickle->reset_count != 0xFFFF)
+    {
+        trickle->reset_count++;
+    }
+#endif
+    trickle->i = TIME_SET(time_now);
+#ifdef RBC_MESH_COMPACT_TRICKLE
+    trickle->i_exp = 0;
+#else
+    trickle->i_relative = g_params[trickle->param_class].i_min;
+#endif
 
     refresh_t(trickle, time_now);
-    trickle_interval_begin(trickle);
+    trickle_interval_begin(trickle, time_now);
 }
 
 void trickle_tx_register(trickle_t* trickle, uint32_t time_now)
 {
-    if (TIMER_OLDER_THAN(trickle->i, time_now))
+    if (TIMER_OLDER_THAN(TIME_GET(trickle->i, time_now), time_now))
     {
-        trickle->i = time_now;
+        trickle->i = TIME_SET(time_now);
     }
     refresh_t(trickle, time_now); /* order next t */
 }
@@ -159,7 +362,7 @@ void trickle_tx_timeout(trickle_t* trickle, bool* out_do_tx, uint32_t time_now)
     }
     else
     {
-        *out_do_tx = (trickle->c < g_k);
+        *out_do_tx = (trickle->c < params_k_get(&g_params[trickle->param_class]));
         check_interval(trickle, time_now);
         if (!(*out_do_tx))
         {
@@ -169,6 +372,27 @@ void trickle_tx_timeout(trickle_t* trickle, bool* out_do_tx, uint32_t time_now)
     }
 }
 
+void trickle_tx_order(trickle_t* trickle, uint32_t time_now, uint32_t max_delay_us)
+{
+    if (max_delay_us > 0)
+    {
+        time_now += trickle_rand_get() % max_delay_us;
+    }
+    trickle->t = TIME_SET(time_now);
+}
+
+#ifdef RBC_MESH_COMPACT_TRICKLE
+uint32_t trickle_tx_time_get(const trickle_t* trickle, uint32_t time_ref)
+{
+    return ticks_to_time(trickle->t, time_ref);
+}
+
+bool trickle_tx_is_earlier(const trickle_t* trickle, const trickle_t* ref)
+{
+    return ((int16_t) (trickle->t - ref->t) < 0);
+}
+#endif
+
 void trickle_disable(trickle_t* trickle)
 {
     trickle->c = TRICKLE_C_DISABLED;
@@ -179,7 +403,12 @@ void trickle_enable(trickle_t* trickle)
     if (trickle->c == TRICKLE_C_DISABLED)
     {
         trickle->c = 0;
+#ifdef RBC_MESH_COMPACT_TRICKLE
+        /* the times are only kept relative to the current time */
+        trickle_timer_reset(trickle, timer_now());
+#else
         trickle_timer_reset(trickle, 0);
+#endif
     }
 }
 
@@ -187,3 +416,21 @@ bool trickle_is_enabled(trickle_t* trickle)
 {
     return (trickle->c != TRICKLE_C_DISABLED);
 }
+
+uint32_t trickle_reset_count_get(void)
+{
+    return g_reset_count;
+}
+
+void trickle_rx_count_get(uint32_t* p_consistent, uint32_t* p_inconsistent)
+{
+    *p_consistent = g_rx_consistent_count;
+    *p_inconsistent = g_rx_inconsistent_count;
+}
+
+void trickle_tune_set(bool active, uint8_t k, int8_t i_max_shift)
+{
+    g_tune.active = active;
+    g_tune.k = k;
+    g_tune.i_max_shift = i_max_shift;
+}
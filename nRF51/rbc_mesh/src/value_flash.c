@@ -0,0 +1,603 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "value_flash.h"
+
+#ifdef RBC_MESH_PERSISTENT_STORAGE
+
+#include <stddef.h>
+#include <string.h>
+#include "mesh_flash.h"
+#include "handle_storage.h"
+#include "mesh_packet.h"
+#include "dfu_types_mesh.h"
+#include "dfu_util.h"
+#include "toolchain.h"
+#include "nrf_error.h"
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+/** Upper half of the first word of a valid log page. The lower half holds the
+  page sequence number, the page with the highest sequence number is active. */
+#define PAGE_MAGIC                      (0x5AFE0000)
+#define PAGE_MAGIC_MASK                 (0xFFFF0000)
+#define PAGE_SEQUENCE_MASK              (0x0000FFFF)
+
+#define PAGE_ADDR(page)                 (RBC_MESH_PERSISTENT_FLASH_ADDR + (page) * PAGE_SIZE)
+/** The log moves on to the next page at each compaction, to spread the erases over all pages. */
+#define PAGE_NEXT(page)                 (((page) + 1) % RBC_MESH_PERSISTENT_FLASH_PAGES)
+
+/** Handle of the erased flash at the end of the log. */
+#define RECORD_HANDLE_END               (0xFFFF)
+/** Record length marking that the handle is no longer persistent. */
+#define RECORD_LENGTH_REMOVED           (0xFF)
+#define RECORD_HEADER_SIZE              (offsetof(record_t, data))
+#define RECORD_WORDS_MAX                ((sizeof(record_t) + WORD_SIZE - 1) / WORD_SIZE)
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+/** Value record in the log, padded to a whole number of flash words. */
+typedef __packed_armcc struct
+{
+    uint16_t handle;
+    uint16_t version;
+    uint8_t length;                     /**< Payload length, or RECORD_LENGTH_REMOVED. */
+    uint8_t checksum;                   /**< Inverted sum of the other header bytes and the payload. */
+    uint16_t _reserved;
+    uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+} __packed_gcc record_t;
+
+/** Word aligned record buffer for the flash writes. */
+typedef union
+{
+    record_t record;
+    uint32_t words[RECORD_WORDS_MAX];
+} record_buffer_t;
+
+typedef enum
+{
+    SLOT_STATE_FREE,
+    SLOT_STATE_QUEUED,                  /**< Waiting for room in the flash queue. */
+    SLOT_STATE_WRITING                  /**< Pushed to the flash queue, can't be changed. */
+} slot_state_t;
+
+typedef struct
+{
+    record_buffer_t buffer;
+    slot_state_t state;
+} record_slot_t;
+
+typedef enum
+{
+    COMPACT_STATE_IDLE,
+    COMPACT_STATE_ERASE,                /**< Erasing the next page. */
+    COMPACT_STATE_COPY,                 /**< Copying the persistent values from the handle cache. */
+    COMPACT_STATE_HEADER                /**< Marking the new page active. */
+} compact_state_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static record_slot_t    m_slots[RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH];
+static record_buffer_t  m_copy_buffer;          /**< Record being copied during compaction. */
+static uint32_t         m_header_word;          /**< Header of the page being compacted into. */
+static uint32_t         m_active_page;
+static uint16_t         m_sequence;             /**< Sequence number of the active page. */
+static uint32_t         m_write_offset;         /**< Offset of the next record in the active page. */
+static compact_state_t  m_compact_state;
+static bool             m_compact_op_pending;   /**< A compaction operation is in the flash queue. */
+static bool             m_copy_ready;           /**< The copy buffer holds a record that isn't written yet. */
+static uint32_t         m_copy_iterator;        /**< Persistent handle iterator for the copy. */
+static uint32_t         m_copy_offset;          /**< Offset of the next copied record in the new page. */
+static bool             m_appended;             /**< Records were appended since the last compaction. */
+static uint32_t         m_compacted_offset;     /**< End of the records copied by the last compaction. */
+static bool             m_next_erased;          /**< The next page has been erased ahead of the compaction. */
+static bool             m_next_erase_pending;   /**< The erase of the next page is in the flash queue. */
+static bool             m_resync;               /**< Updates were lost, the log must be rewritten. */
+static bool             m_restoring;            /**< Restoring the log to the handle cache. */
+static uint32_t         m_drop_count;           /**< Persistent values left out of the log for lack of space. */
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint8_t record_payload_length(const record_t* p_record)
+{
+    return (p_record->length == RECORD_LENGTH_REMOVED) ? 0 : p_record->length;
+}
+
+static uint32_t record_size(uint8_t payload_length)
+{
+    return WORD_SIZE * ((RECORD_HEADER_SIZE + payload_length + WORD_SIZE - 1) / WORD_SIZE);
+}
+
+static uint8_t record_checksum(const record_t* p_record)
+{
+    const uint8_t* p_header = (const uint8_t*) p_record;
+    const uint8_t length = record_payload_length(p_record);
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < offsetof(record_t, checksum); ++i)
+    {
+        sum += p_header[i];
+    }
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        sum += p_record->data[i];
+    }
+    return (uint8_t) ~sum;
+}
+
+static void record_build(record_buffer_t* p_buffer, uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length)
+{
+    memset(p_buffer->words, 0xFF, sizeof(p_buffer->words));
+    p_buffer->record.handle = handle;
+    p_buffer->record.version = version;
+    p_buffer->record.length = length;
+    if (length != RECORD_LENGTH_REMOVED)
+    {
+        memcpy(p_buffer->record.data, p_data, length);
+    }
+    p_buffer->record.checksum = record_checksum(&p_buffer->record);
+}
+
+static void record_restore(const record_t* p_record)
+{
+    if (p_record->length == RECORD_LENGTH_REMOVED)
+    {
+        (void) handle_storage_flag_set(p_record->handle, HANDLE_FLAG_PERSISTENT, false);
+        return;
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return;
+    }
+    if (mesh_packet_build(p_packet,
+                p_record->handle,
+                p_record->version,
+                (uint8_t*) p_record->data,
+                p_record->length) == NRF_SUCCESS &&
+        handle_storage_flag_set(p_record->handle, HANDLE_FLAG_PERSISTENT, true) == NRF_SUCCESS)
+    {
+        handle_info_t info =
+        {
+            .version = p_record->version,
+            .p_packet = p_packet
+        };
+        (void) handle_storage_info_set(p_record->handle, &info);
+    }
+    mesh_packet_ref_count_dec(p_packet);
+}
+
+/** Restore all records of the active page, and find the end of the log. */
+static void log_restore(void)
+{
+    const uint32_t page_addr = PAGE_ADDR(m_active_page);
+    uint32_t offset = WORD_SIZE;
+
+    m_restoring = true;
+    while (offset + RECORD_HEADER_SIZE <= PAGE_SIZE)
+    {
+        const record_t* p_record = (const record_t*) (page_addr + offset);
+        if (p_record->handle == RECORD_HANDLE_END)
+        {
+            break;
+        }
+        const uint8_t length = record_payload_length(p_record);
+        if (length > RBC_MESH_VALUE_MAX_LEN ||
+            offset + record_size(length) > PAGE_SIZE ||
+            record_checksum(p_record) != p_record->checksum)
+        {
+            /* torn or corrupted record, rewrite the log without it. */
+            m_resync = true;
+            break;
+        }
+        record_restore(p_record);
+        offset += record_size(length);
+    }
+    m_write_offset = offset;
+    m_restoring = false;
+}
+
+/** Get a slot for a record of the given handle, reusing a queued one. */
+static record_slot_t* slot_get(uint16_t handle)
+{
+    record_slot_t* p_free = NULL;
+    for (uint32_t i = 0; i < RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH; ++i)
+    {
+        if (m_slots[i].state == SLOT_STATE_QUEUED &&
+            m_slots[i].buffer.record.handle == handle)
+        {
+            return &m_slots[i];
+        }
+        if (m_slots[i].state == SLOT_STATE_FREE && p_free == NULL)
+        {
+            p_free = &m_slots[i];
+        }
+    }
+    return p_free;
+}
+
+/** Fill the copy buffer with the next persistent value that fits the new page. */
+static bool copy_buffer_fill(void)
+{
+    uint16_t handle;
+    handle_info_t info;
+    while (handle_storage_persistent_get(&m_copy_iterator, &handle, &info) == NRF_SUCCESS)
+    {
+        mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(info.p_packet);
+        if (p_adv != NULL)
+        {
+            const uint8_t length = p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+            if (m_copy_offset + record_size(length) <= PAGE_SIZE)
+            {
+                record_build(&m_copy_buffer, handle, info.version, p_adv->data, length);
+                m_copy_ready = true;
+            }
+            else
+            {
+                /* a resync would only drop it again, the page is as full as it gets */
+                m_drop_count++;
+            }
+        }
+        mesh_packet_ref_count_dec(info.p_packet);
+        if (m_copy_ready)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Push the next compaction operation, if the previous one has ended. */
+static void compaction_continue(void)
+{
+    const uint32_t page_addr = PAGE_ADDR(PAGE_NEXT(m_active_page));
+    while (!m_compact_op_pending)
+    {
+        flash_op_t op;
+        flash_op_type_t type = FLASH_OP_TYPE_WRITE;
+        switch (m_compact_state)
+        {
+            case COMPACT_STATE_ERASE:
+                type = FLASH_OP_TYPE_ERASE;
+                op.erase.start_addr = page_addr;
+                op.erase.length = PAGE_SIZE;
+                break;
+            case COMPACT_STATE_COPY:
+                if (!m_copy_ready && !copy_buffer_fill())
+                {
+                    m_compact_state = COMPACT_STATE_HEADER;
+                    continue;
+                }
+                op.write.start_addr = page_addr + m_copy_offset;
+                op.write.p_data = (uint8_t*) m_copy_buffer.words;
+                op.write.length = record_size(m_copy_buffer.record.length);
+                break;
+            case COMPACT_STATE_HEADER:
+                /* written last, the old page stays active until the copy is complete. */
+                m_header_word = PAGE_MAGIC | (uint16_t) (m_sequence + 1);
+                op.write.start_addr = page_addr;
+                op.write.p_data = (uint8_t*) &m_header_word;
+                op.write.length = WORD_SIZE;
+                break;
+            default:
+                return;
+        }
+
+        if (mesh_flash_op_push(MESH_FLASH_USER_VALUES, type, &op) != NRF_SUCCESS)
+        {
+            return; /* retried when the flash queue has room */
+        }
+        if (m_compact_state == COMPACT_STATE_COPY)
+        {
+            m_copy_offset += op.write.length;
+        }
+        m_compact_op_pending = true;
+    }
+}
+
+/** Check whether the given page is erased. */
+static bool page_is_blank(uint32_t page)
+{
+    const uint32_t* p_word = (const uint32_t*) PAGE_ADDR(page);
+    for (uint32_t i = 0; i < PAGE_SIZE / WORD_SIZE; ++i)
+    {
+        if (p_word[i] != 0xFFFFFFFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Erase the next page ahead of the compaction, while the flash is idle. */
+static void next_page_erase(void)
+{
+    flash_op_t op;
+    op.erase.start_addr = PAGE_ADDR(PAGE_NEXT(m_active_page));
+    op.erase.length = PAGE_SIZE;
+    if (mesh_flash_op_push(MESH_FLASH_USER_VALUES, FLASH_OP_TYPE_ERASE, &op) == NRF_SUCCESS)
+    {
+        m_next_erase_pending = true;
+    }
+}
+
+/** Check whether the appends since the last compaction have used up enough
+  of the page to compact it in the background, before it runs full. */
+static bool compaction_due(void)
+{
+    const uint32_t free_space = PAGE_SIZE - m_compacted_offset;
+    return (m_appended &&
+            (m_write_offset - m_compacted_offset) * 100 >= free_space * RBC_MESH_PERSISTENT_COMPACT_THRESHOLD);
+}
+
+/** Rewrite the current persistent values from the handle cache to the next page. */
+static void compaction_start(void)
+{
+    /* the queued values are in the handle cache, and will be copied with the rest */
+    for (uint32_t i = 0; i < RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH; ++i)
+    {
+        if (m_slots[i].state == SLOT_STATE_QUEUED)
+        {
+            m_slots[i].state = SLOT_STATE_FREE;
+        }
+    }
+    m_resync = false;
+    m_copy_ready = false;
+    m_copy_iterator = 0;
+    m_copy_offset = WORD_SIZE;
+    if (m_next_erased)
+    {
+        m_next_erased = false;
+        m_compact_state = COMPACT_STATE_COPY;
+    }
+    else
+    {
+        m_compact_state = COMPACT_STATE_ERASE;
+        /* wait for the erase that's already queued */
+        m_compact_op_pending = m_next_erase_pending;
+    }
+    compaction_continue();
+}
+
+bool value_flash_is_compacting(void)
+{
+    return (m_compact_state != COMPACT_STATE_IDLE);
+}
+
+uint32_t value_flash_drop_count_get(void)
+{
+    return m_drop_count;
+}
+
+/** Push the queued records, or continue the compaction. */
+static void log_process(void)
+{
+    if (m_compact_state != COMPACT_STATE_IDLE)
+    {
+        compaction_continue();
+        return;
+    }
+    if (m_resync)
+    {
+        compaction_start();
+        return;
+    }
+
+    for (uint32_t i = 0; i < RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH; ++i)
+    {
+        record_slot_t* p_slot = &m_slots[i];
+        if (p_slot->state != SLOT_STATE_QUEUED)
+        {
+            continue;
+        }
+        const uint32_t size = record_size(record_payload_length(&p_slot->buffer.record));
+        if (m_write_offset + size > PAGE_SIZE)
+        {
+            if (m_appended)
+            {
+                compaction_start();
+                return;
+            }
+            /* the persistent values fill a whole page on their own. */
+            p_slot->state = SLOT_STATE_FREE;
+            m_drop_count++;
+            continue;
+        }
+
+        flash_op_t op;
+        op.write.start_addr = PAGE_ADDR(m_active_page) + m_write_offset;
+        op.write.p_data = (uint8_t*) p_slot->buffer.words;
+        op.write.length = size;
+        if (mesh_flash_op_push(MESH_FLASH_USER_VALUES, FLASH_OP_TYPE_WRITE, &op) != NRF_SUCCESS)
+        {
+            return; /* retried when the flash queue has room */
+        }
+        m_write_offset += size;
+        m_appended = true;
+        p_slot->state = SLOT_STATE_WRITING;
+    }
+
+    /* housekeeping is left for when the flash is otherwise idle */
+    if (!mesh_flash_in_progress())
+    {
+        if (!m_next_erased && !m_next_erase_pending)
+        {
+            next_page_erase();
+        }
+        else if (m_next_erased && compaction_due())
+        {
+            compaction_start();
+        }
+    }
+}
+
+static void record_queue(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length)
+{
+    if (m_restoring)
+    {
+        return;
+    }
+    record_slot_t* p_slot = slot_get(handle);
+    if (p_slot == NULL)
+    {
+        m_resync = true;
+    }
+    else
+    {
+        record_build(&p_slot->buffer, handle, version, p_data, length);
+        p_slot->state = SLOT_STATE_QUEUED;
+    }
+    log_process();
+}
+
+static void flash_op_end(flash_op_type_t type, void* p_location)
+{
+    if (type == FLASH_OP_TYPE_ERASE)
+    {
+        if ((uint32_t) p_location == PAGE_ADDR(PAGE_NEXT(m_active_page)))
+        {
+            m_next_erase_pending = false;
+            if (m_compact_state == COMPACT_STATE_ERASE)
+            {
+                m_compact_op_pending = false;
+                m_compact_state = COMPACT_STATE_COPY;
+            }
+            else
+            {
+                m_next_erased = true;
+            }
+        }
+    }
+    else if (type == FLASH_OP_TYPE_WRITE)
+    {
+        if (p_location == m_copy_buffer.words)
+        {
+            m_compact_op_pending = false;
+            m_copy_ready = false;
+        }
+        else if (p_location == &m_header_word)
+        {
+            m_compact_op_pending = false;
+            m_compact_state = COMPACT_STATE_IDLE;
+            m_active_page = PAGE_NEXT(m_active_page);
+            m_sequence++;
+            m_write_offset = m_copy_offset;
+            m_compacted_offset = m_copy_offset;
+            m_appended = false;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < RBC_MESH_PERSISTENT_WRITE_QUEUE_LENGTH; ++i)
+            {
+                if (p_location == m_slots[i].buffer.words)
+                {
+                    m_slots[i].state = SLOT_STATE_FREE;
+                    break;
+                }
+            }
+        }
+    }
+    log_process();
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t value_flash_init(void)
+{
+    if (!IS_PAGE_ALIGNED(RBC_MESH_PERSISTENT_FLASH_ADDR))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    uint32_t error_code = mesh_flash_init(MESH_FLASH_USER_VALUES, flash_op_end);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    memset(m_slots, 0, sizeof(m_slots));
+    m_compact_state = COMPACT_STATE_IDLE;
+    m_compact_op_pending = false;
+    m_next_erase_pending = false;
+    m_appended = false;
+    m_resync = false;
+    m_drop_count = 0;
+    m_compacted_offset = WORD_SIZE;
+
+    /* the active page is the valid one with the highest sequence number */
+    bool found = false;
+    for (uint32_t i = 0; i < RBC_MESH_PERSISTENT_FLASH_PAGES; ++i)
+    {
+        const uint32_t header = *((const uint32_t*) PAGE_ADDR(i));
+        const uint16_t sequence = (uint16_t) (header & PAGE_SEQUENCE_MASK);
+        if ((header & PAGE_MAGIC_MASK) == PAGE_MAGIC &&
+            (!found || (int16_t) (sequence - m_sequence) > 0))
+        {
+            m_active_page = i;
+            m_sequence = sequence;
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        /* no log yet, start one in the first page. */
+        m_active_page = RBC_MESH_PERSISTENT_FLASH_PAGES - 1;
+        m_sequence = 0;
+        m_write_offset = PAGE_SIZE;
+        m_next_erased = false;
+        compaction_start();
+        return NRF_SUCCESS;
+    }
+    m_next_erased = page_is_blank(PAGE_NEXT(m_active_page));
+
+    log_restore();
+    log_process();
+    return NRF_SUCCESS;
+}
+
+void value_flash_store(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length)
+{
+    if (length > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return;
+    }
+    record_queue(handle, version, p_data, length);
+}
+
+void value_flash_remove(uint16_t handle)
+{
+    record_queue(handle, 0, NULL, RECORD_LENGTH_REMOVED);
+}
+
+#endif /* RBC_MESH_PERSISTENT_STORAGE */
@@ -0,0 +1,170 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "value_history.h"
+
+#ifdef RBC_MESH_VALUE_HISTORY
+
+#include "version_handler.h"
+#include "event_handler.h"
+#include "nrf_error.h"
+
+#include <string.h>
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    uint8_t oldest;                 /**< Index of the oldest entry in the ring. */
+    uint8_t count;                  /**< Number of entries in the ring. */
+    rbc_mesh_history_entry_t entries[RBC_MESH_VALUE_HISTORY_DEPTH];
+} history_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+static history_t m_histories[RBC_MESH_VALUE_HISTORY_HANDLES_MAX];
+static uint8_t   m_history_count;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static history_t* history_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < m_history_count; ++i)
+    {
+        if (m_histories[i].handle == handle)
+        {
+            return &m_histories[i];
+        }
+    }
+    return NULL;
+}
+
+static inline rbc_mesh_history_entry_t* entry_get(history_t* p_history, uint32_t age)
+{
+    return &p_history->entries[(p_history->oldest + age) % RBC_MESH_VALUE_HISTORY_DEPTH];
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+void value_history_init(void)
+{
+    memset(m_histories, 0, sizeof(m_histories));
+    m_history_count = 0;
+}
+
+uint32_t value_history_enable(rbc_mesh_value_handle_t handle)
+{
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    if (history_get(handle) == NULL)
+    {
+        if (m_history_count < RBC_MESH_VALUE_HISTORY_HANDLES_MAX)
+        {
+            history_t* p_history = &m_histories[m_history_count];
+            memset(p_history, 0, sizeof(history_t));
+            p_history->handle = handle;
+            m_history_count++;
+        }
+        else
+        {
+            error_code = NRF_ERROR_NO_MEM;
+        }
+    }
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+void value_history_put(rbc_mesh_value_handle_t handle, uint16_t version, const uint8_t* p_data, uint8_t length, uint32_t timestamp)
+{
+    history_t* p_history = history_get(handle);
+    if (p_history == NULL || length > RBC_MESH_VALUE_MAX_LEN)
+    {
+        return;
+    }
+
+    rbc_mesh_history_entry_t* p_entry;
+    rbc_mesh_history_entry_t* p_newest = (p_history->count > 0) ? entry_get(p_history, p_history->count - 1) : NULL;
+    if (p_newest != NULL && p_newest->version == version)
+    {
+        if (p_newest->data_len == length && memcmp(p_newest->data, p_data, length) == 0)
+        {
+            /* stored again as it was */
+            return;
+        }
+        /* a won conflict, the version keeps its place */
+        p_entry = p_newest;
+    }
+    else if (p_history->count < RBC_MESH_VALUE_HISTORY_DEPTH)
+    {
+        p_entry = entry_get(p_history, p_history->count++);
+    }
+    else
+    {
+        p_entry = entry_get(p_history, 0);
+        p_history->oldest = (p_history->oldest + 1) % RBC_MESH_VALUE_HISTORY_DEPTH;
+    }
+
+    p_entry->version = version;
+    p_entry->data_len = length;
+    p_entry->timestamp_us = timestamp;
+    memcpy(p_entry->data, p_data, length);
+}
+
+uint32_t value_history_get(rbc_mesh_value_handle_t handle, uint16_t after_version, rbc_mesh_history_entry_t* p_entry)
+{
+    uint32_t error_code = NRF_ERROR_NOT_FOUND;
+    event_handler_critical_section_begin();
+    history_t* p_history = history_get(handle);
+    if (p_history == NULL)
+    {
+        error_code = NRF_ERROR_INVALID_ADDR;
+    }
+    else
+    {
+        for (uint32_t age = 0; age < p_history->count; ++age)
+        {
+            rbc_mesh_history_entry_t* p_stored = entry_get(p_history, age);
+            if (version_delta(after_version, p_stored->version) > 0)
+            {
+                memcpy(p_entry, p_stored, sizeof(rbc_mesh_history_entry_t));
+                error_code = NRF_SUCCESS;
+                break;
+            }
+        }
+    }
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+#endif /* RBC_MESH_VALUE_HISTORY */
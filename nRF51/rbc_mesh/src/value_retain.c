@@ -0,0 +1,262 @@
+/***********************************************************************************
+Copyright (c) Nordic Semiconductor ASA
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+************************************************************************************/
+#include "value_retain.h"
+
+#ifdef RBC_MESH_RETAINED_RAM
+
+#include <stddef.h>
+#include <string.h>
+#include "handle_storage.h"
+#include "mesh_crc.h"
+#include "mesh_packet.h"
+#include "nrf_error.h"
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define RETAIN_MAGIC                    (0x52414D31) /* "RAM1" */
+/** Handle of a slot without a value. */
+#define RETAIN_HANDLE_FREE              (RBC_MESH_INVALID_HANDLE)
+
+#define RETAIN_HEADER_SIZE              (12)
+#define RETAIN_SLOT_SIZE                (8 + ((RBC_MESH_RETAINED_VALUE_MAX_LEN + 1) & ~1))
+#define RETAIN_SLOT_COUNT               ((RBC_MESH_RETAINED_RAM_SIZE - RETAIN_HEADER_SIZE) / RETAIN_SLOT_SIZE)
+
+#if (RBC_MESH_RETAINED_RAM_SIZE < RETAIN_HEADER_SIZE + RETAIN_SLOT_SIZE)
+    #error "RBC_MESH_RETAINED_RAM_SIZE must fit the header and at least one value"
+#endif
+
+#define RETAIN_HEADER                   ((retain_header_t*) RBC_MESH_RETAINED_RAM_ADDR)
+#define RETAIN_SLOTS                    ((retain_slot_t*) (RBC_MESH_RETAINED_RAM_ADDR + RETAIN_HEADER_SIZE))
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+/** Start of the retained area. The CRC covers the layout, so a firmware with
+  a different one starts the area over. */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t slot_count;
+    uint8_t slot_data_len;
+    uint8_t _reserved;
+    uint16_t _reserved2;
+    uint16_t crc;
+} retain_header_t;
+
+typedef struct
+{
+    uint16_t handle;                    /**< Handle of the value, or RETAIN_HANDLE_FREE. */
+    uint16_t version;
+    uint8_t length;
+    uint8_t _reserved;
+    uint16_t crc;                       /**< CRC of the fields above and the payload. */
+    uint8_t data[RBC_MESH_RETAINED_VALUE_MAX_LEN];
+} retain_slot_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+/** The area is only written once it has been restored from. */
+static bool m_ready;
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint16_t header_crc(const retain_header_t* p_header)
+{
+    return mesh_crc16((const uint8_t*) p_header, offsetof(retain_header_t, crc), 0xFFFF);
+}
+
+static uint16_t slot_crc(const retain_slot_t* p_slot)
+{
+    uint16_t crc = mesh_crc16((const uint8_t*) p_slot, offsetof(retain_slot_t, crc), 0xFFFF);
+    return mesh_crc16(p_slot->data, p_slot->length, crc);
+}
+
+static bool header_is_valid(void)
+{
+    const retain_header_t* p_header = RETAIN_HEADER;
+    return (p_header->magic == RETAIN_MAGIC &&
+            p_header->slot_count == RETAIN_SLOT_COUNT &&
+            p_header->slot_data_len == RBC_MESH_RETAINED_VALUE_MAX_LEN &&
+            p_header->crc == header_crc(p_header));
+}
+
+static bool slot_is_valid(const retain_slot_t* p_slot)
+{
+    return (p_slot->handle <= RBC_MESH_APP_MAX_HANDLE &&
+            p_slot->length <= RBC_MESH_RETAINED_VALUE_MAX_LEN &&
+            p_slot->crc == slot_crc(p_slot));
+}
+
+static void slot_restore(const retain_slot_t* p_slot)
+{
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return;
+    }
+    if (mesh_packet_build(p_packet,
+                p_slot->handle,
+                p_slot->version,
+                (uint8_t*) p_slot->data,
+                p_slot->length) == NRF_SUCCESS)
+    {
+        handle_info_t info =
+        {
+            .version = p_slot->version,
+            .p_packet = p_packet
+        };
+        (void) handle_storage_info_set(p_slot->handle, &info);
+    }
+    mesh_packet_ref_count_dec(p_packet);
+}
+
+static void area_reset(void)
+{
+    retain_header_t* p_header = RETAIN_HEADER;
+    memset(p_header, 0, RETAIN_HEADER_SIZE);
+    p_header->magic = RETAIN_MAGIC;
+    p_header->slot_count = RETAIN_SLOT_COUNT;
+    p_header->slot_data_len = RBC_MESH_RETAINED_VALUE_MAX_LEN;
+    p_header->crc = header_crc(p_header);
+
+    retain_slot_t* p_slots = RETAIN_SLOTS;
+    for (uint32_t i = 0; i < RETAIN_SLOT_COUNT; ++i)
+    {
+        p_slots[i].handle = RETAIN_HANDLE_FREE;
+    }
+}
+
+static retain_slot_t* slot_get(uint16_t handle, bool allocate)
+{
+    retain_slot_t* p_slots = RETAIN_SLOTS;
+    retain_slot_t* p_free = NULL;
+    for (uint32_t i = 0; i < RETAIN_SLOT_COUNT; ++i)
+    {
+        if (p_slots[i].handle == handle)
+        {
+            return &p_slots[i];
+        }
+        if (p_slots[i].handle == RETAIN_HANDLE_FREE && p_free == NULL)
+        {
+            p_free = &p_slots[i];
+        }
+    }
+    return (allocate ? p_free : NULL);
+}
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t value_retain_init(void)
+{
+    if ((RBC_MESH_RETAINED_RAM_ADDR & 0x03) != 0)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    m_ready = false;
+
+    if (header_is_valid())
+    {
+        /* the slots are read where they are, the restore doesn't write to
+           the area before it's started over */
+        const retain_slot_t* p_slots = RETAIN_SLOTS;
+        for (uint32_t i = 0; i < RETAIN_SLOT_COUNT; ++i)
+        {
+            if (slot_is_valid(&p_slots[i]))
+            {
+                slot_restore(&p_slots[i]);
+            }
+        }
+    }
+
+    /* start over with the cache contents, which adds the values restored
+       from flash and leaves out the ones that didn't fit */
+    area_reset();
+    m_ready = true;
+
+    uint32_t iterator = 0;
+    uint16_t handle;
+    handle_info_t info;
+    while (handle_storage_value_next_get(&iterator, &handle, &info) == NRF_SUCCESS)
+    {
+        mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(info.p_packet);
+        if (p_adv != NULL)
+        {
+            value_retain_store(handle, info.version, p_adv->data, p_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+        }
+        mesh_packet_ref_count_dec(info.p_packet);
+    }
+    return NRF_SUCCESS;
+}
+
+void value_retain_store(uint16_t handle, uint16_t version, const uint8_t* p_data, uint8_t length)
+{
+    if (!m_ready || handle > RBC_MESH_APP_MAX_HANDLE)
+    {
+        return;
+    }
+    if (length > RBC_MESH_RETAINED_VALUE_MAX_LEN)
+    {
+        /* an older, shorter version must not come back after a reset */
+        value_retain_remove(handle);
+        return;
+    }
+
+    retain_slot_t* p_slot = slot_get(handle, true);
+    if (p_slot == NULL)
+    {
+        /* full, the value is relearned from the neighbors after a reset */
+        return;
+    }
+    p_slot->handle = handle;
+    p_slot->version = version;
+    p_slot->length = length;
+    p_slot->_reserved = 0;
+    memcpy(p_slot->data, p_data, length);
+    p_slot->crc = slot_crc(p_slot);
+}
+
+void value_retain_remove(uint16_t handle)
+{
+    if (!m_ready)
+    {
+        return;
+    }
+    retain_slot_t* p_slot = slot_get(handle, false);
+    if (p_slot != NULL)
+    {
+        p_slot->handle = RETAIN_HANDLE_FREE;
+    }
+}
+
+#endif /* RBC_MESH_RETAINED_RAM */
@@ -0,0 +1,208 @@
+/***********************************************************************************
+  Copyright (c) Nordic Semiconductor ASA
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+
+  3. Neither the name of Nordic Semiconductor ASA nor the names of other
+  contributors to this software may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************/
+#include "value_store.h"
+#include "nrf_error.h"
+#include <stddef.h>
+
+/******************************************************************************
+* Local defines
+******************************************************************************/
+#define SLAB_CLASS_NONE                 (0xFF)
+
+#define REF_PAGE(ref)                   ((ref) >> 5)
+#define REF_SLOT(ref)                   ((ref) & 0x1F)
+#define REF(page, slot)                 ((uint16_t) (((page) << 5) | (slot)))
+
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+typedef struct
+{
+    uint32_t free_mask;                 /**< Bitmap of the free slots in the page. */
+    uint8_t slab_class;                 /**< Slab class the page is handed to, or SLAB_CLASS_NONE. */
+    uint8_t data[VALUE_STORE_PAGE_SIZE];
+} value_page_t;
+
+/******************************************************************************
+* Static globals
+******************************************************************************/
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+/** Slot size of each slab class. The largest class must fit RBC_MESH_VALUE_MAX_LEN. */
+static const uint8_t m_slot_size[VALUE_STORE_SLAB_CLASSES] = {4, 8, 12, 24};
+
+#if (RBC_MESH_VALUE_MAX_LEN > 24)
+    #error "The largest value store slab class must fit RBC_MESH_VALUE_MAX_LEN"
+#endif
+
+static value_page_t*    m_pages;
+static uint16_t         m_page_count;
+
+#ifndef RBC_MESH_EXTERNAL_MEMORY
+static value_page_t     m_pages_default[VALUE_STORE_PAGE_COUNT(RBC_MESH_DATA_CACHE_ENTRIES)];
+#endif
+
+/******************************************************************************
+* Static functions
+******************************************************************************/
+static uint32_t slots_per_page(uint8_t slab_class)
+{
+    return VALUE_STORE_PAGE_SIZE / m_slot_size[slab_class];
+}
+
+static uint32_t full_mask(uint8_t slab_class)
+{
+    return (1UL << slots_per_page(slab_class)) - 1;
+}
+#endif
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t value_store_memory_size_get(uint16_t page_count)
+{
+    return sizeof(value_page_t) * page_count;
+}
+
+uint32_t value_store_init(void* p_memory, uint16_t page_count)
+{
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    if (p_memory == NULL)
+    {
+#ifdef RBC_MESH_EXTERNAL_MEMORY
+        return NRF_ERROR_NULL;
+#else
+        p_memory = m_pages_default;
+        page_count = VALUE_STORE_PAGE_COUNT(RBC_MESH_DATA_CACHE_ENTRIES);
+#endif
+    }
+    if (page_count == 0 || page_count > VALUE_STORE_PAGES_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_pages = (value_page_t*) p_memory;
+    m_page_count = page_count;
+    for (uint32_t i = 0; i < m_page_count; ++i)
+    {
+        m_pages[i].free_mask = 0;
+        m_pages[i].slab_class = SLAB_CLASS_NONE;
+    }
+#endif
+    return NRF_SUCCESS;
+}
+
+bool value_store_alloc(uint8_t length, uint16_t* p_ref)
+{
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    if (length == 0)
+    {
+        *p_ref = VALUE_STORE_REF_NONE;
+        return true;
+    }
+
+    uint8_t slab_class = 0;
+    while (m_slot_size[slab_class] < length)
+    {
+        if (++slab_class == VALUE_STORE_SLAB_CLASSES)
+        {
+            return false;
+        }
+    }
+
+    /* prefer a partially filled page of the class, to keep the unused pages
+       available for the other classes. */
+    uint32_t page = m_page_count;
+    for (uint32_t i = 0; i < m_page_count; ++i)
+    {
+        if (m_pages[i].slab_class == slab_class && m_pages[i].free_mask != 0)
+        {
+            page = i;
+            break;
+        }
+        if (m_pages[i].slab_class == SLAB_CLASS_NONE && page == m_page_count)
+        {
+            page = i;
+        }
+    }
+    if (page == m_page_count)
+    {
+        return false;
+    }
+
+    if (m_pages[page].slab_class == SLAB_CLASS_NONE)
+    {
+        m_pages[page].slab_class = slab_class;
+        m_pages[page].free_mask = full_mask(slab_class);
+    }
+
+    uint32_t slot = 0;
+    while ((m_pages[page].free_mask & (1UL << slot)) == 0)
+    {
+        slot++;
+    }
+    m_pages[page].free_mask &= ~(1UL << slot);
+    *p_ref = REF(page, slot);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void value_store_free(uint16_t ref)
+{
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    if (ref == VALUE_STORE_REF_NONE || REF_PAGE(ref) >= m_page_count)
+    {
+        return;
+    }
+    value_page_t* p_page = &m_pages[REF_PAGE(ref)];
+    p_page->free_mask |= (1UL << REF_SLOT(ref));
+    if (p_page->free_mask == full_mask(p_page->slab_class))
+    {
+        /* give the page back, any class may take it */
+        p_page->slab_class = SLAB_CLASS_NONE;
+        p_page->free_mask = 0;
+    }
+#endif
+}
+
+uint8_t* value_store_data_get(uint16_t ref)
+{
+#ifdef RBC_MESH_COMPACT_VALUE_STORE
+    if (ref == VALUE_STORE_REF_NONE || REF_PAGE(ref) >= m_page_count)
+    {
+        return NULL;
+    }
+    value_page_t* p_page = &m_pages[REF_PAGE(ref)];
+    return &p_page->data[REF_SLOT(ref) * m_slot_size[p_page->slab_class]];
+#else
+    return NULL;
+#endif
+}
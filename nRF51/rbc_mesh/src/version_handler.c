@@ -36,13 +36,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "timer_scheduler.h"
 #include "event_handler.h"
 #include "rbc_mesh_common.h"
+#include "mesh_trace.h"
 #include "toolchain.h"
 #include "trickle.h"
 #include "rbc_mesh.h"
 #include "mesh_packet.h"
 #include "mesh_gatt.h"
 #include "mesh_aci.h"
+#include "mesh_segment.h"
 
+#include "nrf.h"
 #include "nrf_error.h"
 #include "app_error.h"
 #include "fifo.h"
@@ -53,54 +56,263 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define TIMESLOT_STARTUP_DELAY_US       (100)
 
+/** Time from a time sync beacon is stamped until the receiver stamps it at
+    the address event: radio ramp-up, preamble and access address. */
+#define TIME_SYNC_TX_DELAY_US           (140 + (1 + 4) * 8)
+
+#define VERSION_RING_SIZE               (0x10000 - MESH_VALUE_LOLLIPOP_LIMIT) /**< Number of versions in the circular part of the version space. */
+
 /* event push isn't present in the API header file. */
 extern uint32_t rbc_mesh_event_push(rbc_mesh_event_t* p_evt);
 
 
+/******************************************************************************
+* Local typedefs
+******************************************************************************/
+#ifdef RBC_MESH_DELTA_UPDATES
+/** Payload of a delta update packet. The packet's own version field holds the
+  version the patch produces. */
+typedef __packed_armcc struct
+{
+    rbc_mesh_value_handle_t handle;         /**< Handle of the value the patch applies to. */
+    uint16_t                base_version;   /**< Version the patch applies to. */
+    uint8_t                 length;         /**< Length of the full value. */
+    uint8_t                 offset;         /**< Offset of the patched bytes in the value. */
+    uint8_t                 patch[];        /**< Bytes replacing the value bytes at offset. */
+} __packed_gcc delta_payload_t;
+
+/** Delta packet to transmit in place of the full value. */
+typedef struct
+{
+    mesh_packet_t*  p_packet;
+    uint8_t         tx_remaining;
+} delta_entry_t;
+#endif
+
+#ifdef RBC_MESH_NETWORK_CODING
+/** Payload of a coded packet. The packet's own version field holds the
+  version of the second value. */
+typedef __packed_armcc struct
+{
+    rbc_mesh_value_handle_t handle_a;       /**< Handle of the first value. */
+    uint16_t                version_a;      /**< Version of the first value. */
+    rbc_mesh_value_handle_t handle_b;       /**< Handle of the second value. */
+    uint8_t                 length_a;       /**< Length of the first value. */
+    uint8_t                 length_b;       /**< Length of the second value. */
+    uint8_t                 coded[];        /**< Both values XOR-ed, the shorter one padded with zeros. */
+} __packed_gcc netcode_payload_t;
+
+/** Received value, along with the neighbor it came from. */
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;         /**< Handle of the value, or RBC_MESH_INVALID_HANDLE if unused. */
+    uint16_t                version;
+    uint8_t                 addr[BLE_GAP_ADDR_LEN]; /**< Device address of the neighbor the value came from. */
+    uint8_t                 tx_remaining;   /**< Transmissions of the value that may still go out coded. */
+} netcode_entry_t;
+#endif
+
+#ifdef RBC_MESH_TIME_SYNC
+/** Payload of a time sync beacon. */
+typedef __packed_armcc struct
+{
+    uint32_t    root_id;    /**< ID of the node the mesh time is taken from. */
+    uint32_t    mesh_time;  /**< Mesh time when the beacon was built. */
+    uint8_t     hops;       /**< Number of hops between the sender and the root. */
+    uint8_t     seq;        /**< Beacon sequence number, only incremented by the root. */
+} __packed_gcc time_sync_payload_t;
+#endif
+
+#ifdef RBC_MESH_BOOTSTRAP
+/** Progress of a node through its own bootstrap. */
+typedef enum
+{
+    BOOTSTRAP_STATE_CHECK,      /**< Not yet known whether the node starts out empty. */
+    BOOTSTRAP_STATE_LISTEN,     /**< Listening for the strongest neighbor. */
+    BOOTSTRAP_STATE_REQUESTED,  /**< Waiting for the neighbor's values. */
+    BOOTSTRAP_STATE_IDLE        /**< Done, or never needed. */
+} bootstrap_state_t;
+
+typedef enum
+{
+    BOOTSTRAP_TYPE_REQUEST,     /**< Ask the addressed node for its values, starting at the handle. */
+    BOOTSTRAP_TYPE_PROGRESS     /**< A batch went out to the addressed node, the next starts at the handle. */
+} bootstrap_type_t;
+
+/** Payload of a bootstrap message. */
+typedef __packed_armcc struct
+{
+    uint8_t     type;                   /**< bootstrap_type_t */
+    uint8_t     addr[BLE_GAP_ADDR_LEN]; /**< Device address of the node the message is for. */
+    uint16_t    handle;                 /**< First handle to send, RBC_MESH_INVALID_HANDLE after the last batch. */
+} __packed_gcc bootstrap_payload_t;
+#endif
+
+#ifdef RBC_MESH_LATENCY_PROBE
+#define PROBE_FLAG_REPLY                (1 << 0) /**< The probe is on its way back from the target. */
+
+/** Payload of a latency probe. */
+typedef __packed_armcc struct
+{
+    uint16_t                origin;         /**< Node ID of the node that sent the probe. */
+    uint16_t                target;         /**< Node ID of the node the probe was sent to. */
+    uint8_t                 seq;            /**< Sequence number of the probe. */
+    uint8_t                 flags;          /**< PROBE_FLAG_* */
+    uint8_t                 hops;           /**< Number of relays the probe has passed through. */
+    uint32_t                origin_time;    /**< Time the origin sent the probe, in mesh time with RBC_MESH_TIME_SYNC. */
+    rbc_mesh_probe_hop_t    hop[];          /**< The first relays on the path. */
+} __packed_gcc probe_payload_t;
+
+/** Recently seen latency probe. */
+typedef struct
+{
+    uint16_t    origin;
+    uint8_t     seq;
+    uint8_t     flags;
+    bool        valid;
+} probe_cache_entry_t;
+#endif
+
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+/** Recently received single value packet, keyed on its radio CRC. */
+typedef struct
+{
+    uint32_t                crc;
+    rbc_mesh_value_handle_t handle;     /**< Handle of the value, or RBC_MESH_INVALID_HANDLE if unused. */
+    uint16_t                version;
+    uint8_t                 length;     /**< Length of the packet, guards against CRC collisions. */
+} rx_duplicate_entry_t;
+#endif
+
+#ifdef RBC_MESH_RX_HOOKS
+typedef struct
+{
+    rbc_mesh_value_handle_t handle;
+    rbc_mesh_rx_hook_t hook;            /**< NULL if the entry is unused. */
+} rx_hook_entry_t;
+#endif
+
 /******************************************************************************
 * Static globals
 ******************************************************************************/
 static bool             m_is_initialized = false;
 static timer_event_t    m_tx_timer_evt;
+static volatile bool    m_next_tx_valid = false;
+static volatile uint32_t m_next_tx_time;
+#ifdef RBC_MESH_TX_BACKPRESSURE
+static bool             m_tx_blocked = false; /**< The last TX round left due values behind on a full radio queue. */
+#endif
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+static volatile bool    m_next_urgent_tx_valid = false;
+static volatile uint32_t m_next_urgent_tx_time;
+#endif
 static tc_tx_config_t   m_tx_config;
+#ifdef RBC_MESH_DELTA_UPDATES
+static delta_entry_t    m_delta_entries[RBC_MESH_DELTA_ENTRIES];
+static uint32_t         m_delta_entry_next;
+#endif
+#ifdef RBC_MESH_NETWORK_CODING
+static netcode_entry_t  m_netcode_entries[RBC_MESH_NETCODE_ENTRIES];
+static uint32_t         m_netcode_entry_next;
+static uint32_t         m_netcode_tx_count;
+static uint32_t         m_netcode_decode_count;
+#endif
+#ifdef RBC_MESH_SUMMARY_BEACON
+static timer_event_t    m_summary_timer_evt;
+static bool             m_summary_scheduled = false;
+#endif
+#ifdef RBC_MESH_VERSION_REPAIR
+static timer_event_t    m_repair_timer_evt;
+static bool             m_repair_active = false;
+static uint16_t         m_repair_cursor; /**< First handle of the next version page. */
+static uint32_t         m_repair_budget_start;
+static uint32_t         m_repair_budget; /**< Repair transmissions left in the current repair interval. */
+#endif
+#ifdef RBC_MESH_VALUE_TTL
+static timer_event_t    m_ttl_timer_evt;
+static bool             m_ttl_scheduled = false;
+#endif
+#ifdef RBC_MESH_TIME_SYNC
+static timer_event_t    m_time_sync_timer_evt;
+static bool             m_time_sync_scheduled = false;
+static uint32_t         m_time_root_id;
+static uint8_t          m_time_hops;
+static uint32_t         m_time_last_sync;
+static uint8_t          m_time_seq; /**< Newest beacon sequence number of the root. */
+static uint32_t         m_time_lost_root_id; /**< Root we took over from, its old beacons are ignored for a timeout. */
+static uint8_t          m_time_lost_seq;
+static uint32_t         m_time_lost_time;
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+static rbc_mesh_propagation_stats_t m_propagation_stats;
+#ifdef RBC_MESH_HEALTH_MONITOR
+static uint32_t         m_propagation_late_count;
+#endif
+#endif
+#ifdef RBC_MESH_CHANNEL_QUALITY
+static timer_event_t    m_channel_map_timer_evt;
+static bool             m_channel_map_scheduled = false;
+static bool             m_channel_map_known; /**< Whether a map has been taken from a beacon or made here. */
+static uint8_t          m_channel_map_seq;
+static uint32_t         m_channel_map_changed; /**< Time the channels in use last changed. */
+static uint32_t         m_channel_quality_elapsed_us; /**< Time since the last channel quality period ended. */
+#endif
+#ifdef RBC_MESH_BOOTSTRAP
+static uint8_t          m_local_addr[BLE_GAP_ADDR_LEN];
+static timer_event_t    m_bootstrap_timer_evt;
+static bootstrap_state_t m_bootstrap_state;
+static bool             m_bootstrap_peer_valid;
+static uint8_t          m_bootstrap_peer[BLE_GAP_ADDR_LEN]; /**< Neighbor the values are asked from. */
+static uint8_t          m_bootstrap_peer_rssi;
+static uint16_t         m_bootstrap_cursor; /**< First handle the neighbor hasn't sent yet. */
+static uint8_t          m_bootstrap_retries;
+static timer_event_t    m_bootstrap_serve_timer_evt;
+static bool             m_bootstrap_serving = false;
+static uint8_t          m_bootstrap_client[BLE_GAP_ADDR_LEN]; /**< Node the values are sent to. */
+static uint16_t         m_bootstrap_serve_cursor;
+#endif
+#ifdef RBC_MESH_LATENCY_PROBE
+static probe_cache_entry_t m_probe_cache[RBC_MESH_PROBE_CACHE_SIZE];
+static uint32_t         m_probe_cache_next;
+static uint8_t          m_probe_seq;
+#endif
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+static rx_duplicate_entry_t m_rx_duplicates[RBC_MESH_RX_DUPLICATE_CACHE_SIZE];
+static uint32_t         m_rx_duplicate_next;
+#endif
+static uint32_t         m_rx_duplicate_count;
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+static rbc_mesh_conflict_resolver_t m_conflict_resolver; /**< NULL for the built-in payload order. */
+#endif
+#ifdef RBC_MESH_RX_HOOKS
+static rx_hook_entry_t  m_rx_hooks[RBC_MESH_RX_HOOKS_MAX];
+static uint32_t         m_rx_hook_calls;
+static uint32_t         m_rx_hook_overruns;
+#endif
 /******************************************************************************
 * Static functions
 ******************************************************************************/
 int16_t version_delta(uint16_t old_version, uint16_t new_version)
 {
-    /* utility function */
-    if (old_version < MESH_VALUE_LOLLIPOP_LIMIT)
+    /* Versions below the lollipop limit are the stem, the rest form a ring
+       that wraps back to the limit. Stem distances saturate, ring distances
+       go the shorter way around. */
+    int32_t delta = (int32_t) new_version - (int32_t) old_version;
+    if (old_version >= MESH_VALUE_LOLLIPOP_LIMIT && new_version >= MESH_VALUE_LOLLIPOP_LIMIT)
     {
-        return (((int32_t)old_version + INT16_MAX) > ((int32_t)new_version)) ?
-            (new_version - old_version) :
-            (INT16_MAX);
+        delta -= (delta > INT16_MAX) * VERSION_RING_SIZE;
+        delta += (delta < -INT16_MAX) * VERSION_RING_SIZE;
+        return (int16_t) delta;
     }
-    else if (new_version < MESH_VALUE_LOLLIPOP_LIMIT)
+    if (delta >= INT16_MAX)
     {
-        return (((int32_t)new_version + INT16_MAX) > ((int32_t)old_version)) ?
-            (new_version - old_version) :
-            (INT16_MIN);
+        return INT16_MAX;
     }
-    else
+    if (delta <= -INT16_MAX)
     {
-        const uint32_t separation = (new_version >= old_version)?
-            (new_version - old_version) :
-            (old_version - new_version);
-
-        if (separation > INT16_MAX)
-        {
-            if (old_version > new_version)
-            {
-                old_version += MESH_VALUE_LOLLIPOP_LIMIT;
-            }
-            else
-            {
-                new_version += MESH_VALUE_LOLLIPOP_LIMIT;
-            }
-        }
-
-        return (new_version - old_version);
+        return INT16_MIN;
     }
+    return (int16_t) delta;
 }
 
 /** compare payloads, assuming version number is equal */
@@ -117,211 +329,628 @@ static bool payload_has_conflict(mesh_adv_data_t* p_old_adv, mesh_adv_data_t* p_
     return (memcmp(p_old_adv->data, p_new_adv->data, p_old_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD) != 0);
 }
 
-
-static void transmit_all_instances(uint32_t timestamp, void* p_context);
-
-static void order_next_transmission(uint32_t time_now)
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+/**
+* Decide whether a received payload replaces a conflicting stored payload of
+* the same version. Every node must reach the same verdict for the mesh to
+* settle, so the built-in order only looks at the payloads: the longer one
+* wins, then the one that compares higher.
+*/
+static bool conflict_is_won(mesh_adv_data_t* p_stored_adv, mesh_adv_data_t* p_new_adv)
 {
-    bool found_value;
-    uint32_t timeout = handle_storage_next_timeout_get(&found_value);
-    if (!found_value)
+    uint8_t stored_len = p_stored_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    uint8_t new_len = p_new_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+
+    if (m_conflict_resolver != NULL)
     {
-        return;
+        return m_conflict_resolver(p_new_adv->handle,
+                p_stored_adv->data, stored_len,
+                p_new_adv->data, new_len);
     }
-    if (timeout < time_now + 1000)
+
+    if (new_len != stored_len)
     {
-        vh_order_update(timeout);
+        return (new_len > stored_len);
     }
-    else
+    return (memcmp(p_new_adv->data, p_stored_adv->data, new_len) > 0);
+}
+#endif
+
+
+/**
+* Get the number of consistent receptions a packet counts as in the Trickle
+* algorithm, given the RSSI it was received at.
+*/
+static uint32_t rx_weight_get(uint8_t rssi)
+{
+#ifdef RBC_MESH_RSSI_RELAY_SUPPRESSION
+    /* the RSSI is the magnitude of a negative dBm value */
+    if (rssi < RBC_MESH_RSSI_SUPPRESS_THRESHOLD)
     {
-        if (timer_sch_reschedule(&m_tx_timer_evt, timeout) != NRF_SUCCESS)
-        {
-            vh_order_update(timeout);
-        }
+        return RBC_MESH_RSSI_SUPPRESS_WEIGHT;
     }
+#endif
+
+    return 1;
 }
 
-static void transmit_all_instances(uint32_t timestamp, void* p_context)
+/** Process a single value received in the mesh */
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+/**
+* Short-circuit a packet identical to a recently processed one. Packets with
+* the same CRC, length, handle and version carry the same payload, and if the
+* handle storage still holds that version, a full processing would only end
+* up registering a consistent reception. Returns whether the packet was
+* handled.
+*/
+static bool rx_duplicate_filter(mesh_packet_t* p_packet, mesh_adv_data_t* p_adv_data, uint32_t crc, uint32_t timestamp, uint8_t rssi)
 {
-    SET_PIN(8);
-    mesh_packet_t* pp_tx_packets[RBC_MESH_RADIO_QUEUE_LENGTH - 1];
-    uint32_t count = RBC_MESH_RADIO_QUEUE_LENGTH - 1;
-
-    uint32_t error_code = handle_storage_tx_packets_get(timestamp, pp_tx_packets, &count);
-    if (error_code == NRF_SUCCESS)
+    for (uint32_t i = 0; i < RBC_MESH_RX_DUPLICATE_CACHE_SIZE; ++i)
     {
-        for (uint32_t i = 0; i < count; ++i)
+        rx_duplicate_entry_t* p_entry = &m_rx_duplicates[i];
+        if (p_entry->crc == crc &&
+            p_entry->handle == p_adv_data->handle &&
+            p_entry->version == p_adv_data->version &&
+            p_entry->length == p_packet->header.length)
         {
-            error_code = tc_tx(pp_tx_packets[i], &m_tx_config);
-            if (error_code == NRF_SUCCESS)
+            if (handle_storage_rx_duplicate(p_entry->handle, p_entry->version, timestamp) == NRF_SUCCESS)
             {
-                mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(pp_tx_packets[i]);
-                if (p_adv)
-                {
-                    PIN_OUT(p_adv->handle, 8);
-                    APP_ERROR_CHECK(handle_storage_transmitted(p_adv->handle, timestamp));
-                }
-                else
+                for (uint32_t j = 1; j < rx_weight_get(rssi); ++j)
                 {
-                    APP_ERROR_CHECK(NRF_ERROR_INVALID_DATA);
+                    (void) handle_storage_rx_consistent(p_entry->handle, timestamp);
                 }
+                m_rx_duplicate_count++;
+                return true;
             }
-            mesh_packet_ref_count_dec(pp_tx_packets[i]);
+            /* the stored value has moved on, forget the packet */
+            p_entry->handle = RBC_MESH_INVALID_HANDLE;
+            return false;
         }
     }
-    CLEAR_PIN(8);
-    order_next_transmission(timestamp);
+    return false;
 }
 
-/******************************************************************************
-* Interface functions
-******************************************************************************/
-uint32_t vh_init(uint32_t min_interval_us,
-                 uint32_t access_address,
-                 uint8_t channel,
-                 rbc_mesh_txpower_t tx_power)
+static void rx_duplicate_add(mesh_packet_t* p_packet, mesh_adv_data_t* p_adv_data, uint32_t crc)
 {
-    uint32_t error_code = handle_storage_init(min_interval_us);
-    if (error_code != NRF_SUCCESS)
+    rx_duplicate_entry_t* p_entry = &m_rx_duplicates[m_rx_duplicate_next];
+    p_entry->crc = crc;
+    p_entry->handle = p_adv_data->handle;
+    p_entry->version = p_adv_data->version;
+    p_entry->length = p_packet->header.length;
+    if (++m_rx_duplicate_next == RBC_MESH_RX_DUPLICATE_CACHE_SIZE)
     {
-        return error_code;
+        m_rx_duplicate_next = 0;
     }
-
-    m_tx_timer_evt.p_next = NULL;
-    m_tx_timer_evt.cb = transmit_all_instances;
-    m_tx_timer_evt.interval = 0;
-    m_tx_timer_evt.p_context = NULL;
-
-    m_tx_config.alt_access_address = (access_address != RBC_MESH_ACCESS_ADDRESS_BLE_ADV);
-    m_tx_config.first_channel = channel;
-    m_tx_config.channel_map = 1; /* Only the first channel */
-    m_tx_config.tx_power = tx_power;
-
-    m_is_initialized = true;
-    return NRF_SUCCESS;
 }
+#endif
 
-uint32_t vh_min_interval_set(uint32_t min_interval_us)
+#ifdef RBC_MESH_VERSION_REPAIR
+/** Order a single transmission of the given value, within the repair rate limit. */
+static void repair_request(rbc_mesh_value_handle_t handle, uint32_t timestamp)
 {
-    return handle_storage_min_interval_set(min_interval_us);
+    if (!TIMER_OLDER_THAN(timestamp, m_repair_budget_start + RBC_MESH_REPAIR_INTERVAL_US))
+    {
+        m_repair_budget_start = timestamp;
+        m_repair_budget = RBC_MESH_REPAIR_TX_MAX;
+    }
+    if (m_repair_budget > 0 &&
+        handle_storage_repair_order(handle, timestamp, RBC_MESH_REPAIR_INTERVAL_US) == NRF_SUCCESS)
+    {
+        m_repair_budget--;
+    }
 }
+#endif
 
-void vh_tx_power_set(rbc_mesh_txpower_t tx_power)
+#ifdef RBC_MESH_ORIGIN_TIME
+/** Origin time stamp of the given local time. */
+static uint16_t origin_time_get(uint32_t local_time)
 {
-    m_tx_config.tx_power = tx_power;
+    uint16_t origin_time = (uint16_t) (timer_mesh_time_get(local_time) / RBC_MESH_ORIGIN_TIME_UNIT_US);
+    /* one unit off is better than losing the stamp */
+    return (origin_time == RBC_MESH_ORIGIN_TIME_NONE ? origin_time - 1 : origin_time);
 }
 
-uint32_t vh_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi)
+/** Time from the given origin time to the given local time, in milliseconds. */
+static uint16_t propagation_ms_get(uint16_t origin_time, uint32_t local_time)
 {
-    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
-    if (p_adv_data == NULL)
+    if (origin_time == RBC_MESH_ORIGIN_TIME_NONE)
     {
-        return NRF_ERROR_INVALID_DATA;
+        return RBC_MESH_ORIGIN_TIME_NONE;
     }
-
-    handle_info_t info;
-    uint32_t error_code = handle_storage_info_get(p_adv_data->handle, &info);
-
-    int16_t delta = version_delta(info.version, p_adv_data->version);
-
-    /* prepare app event */
-    rbc_mesh_event_t evt;
-    evt.params.rx.version_delta = delta;
-    evt.params.rx.ble_adv_addr.addr_type = p_packet->header.addr_type;
-    memcpy(evt.params.rx.ble_adv_addr.addr, p_packet->addr, BLE_GAP_ADDR_LEN);
-    evt.params.rx.rssi = -((int8_t) rssi);
-    evt.params.rx.p_data = p_adv_data->data;
-    evt.params.rx.data_len = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
-    evt.params.rx.value_handle = p_adv_data->handle;
-    evt.params.rx.timestamp_us = timestamp;
-
-    if (error_code == NRF_ERROR_NOT_FOUND)
+    uint16_t delay = origin_time_get(local_time) - origin_time;
+    if (delay >= 0x8000)
     {
-        /* couldn't find the handle in the handle storage */
-        evt.type = RBC_MESH_EVENT_TYPE_NEW_VAL;
-        evt.params.rx.version_delta = delta;
+        /* the origin is ahead of this node, by no more than the sync error */
+        return 0;
+    }
+    return (uint16_t) (((uint32_t) delay * RBC_MESH_ORIGIN_TIME_UNIT_US) / 1000);
+}
 
-        /* First allocate an element in the storage to ensure that we're not out of memory. */
-        error_code = handle_storage_info_set(p_adv_data->handle, &info);
-        if (error_code != NRF_SUCCESS)
+static void propagation_record(uint16_t propagation_ms)
+{
+    if (propagation_ms == RBC_MESH_ORIGIN_TIME_NONE)
+    {
+        if (m_propagation_stats.unstamped < UINT16_MAX)
         {
-            mesh_packet_ref_count_dec(info.p_packet);
-            return error_code;
+            m_propagation_stats.unstamped++;
         }
+        return;
+    }
 
-        mesh_packet_take_ownership(p_packet);
-        handle_info_t new_info =
-        {
-            .p_packet = p_packet,
-            .version = p_adv_data->version
-        };
+    m_propagation_stats.count++;
+#ifdef RBC_MESH_HEALTH_MONITOR
+    if (propagation_ms > RBC_MESH_HEALTH_LATENCY_SLO_MS)
+    {
+        m_propagation_late_count++;
+    }
+#endif
+    if (propagation_ms > m_propagation_stats.max_ms)
+    {
+        m_propagation_stats.max_ms = propagation_ms;
+    }
+    uint32_t bucket = 0;
+    uint32_t limit = RBC_MESH_PROPAGATION_HIST_FIRST_MS;
+    while (bucket < RBC_MESH_PROPAGATION_HIST_BUCKETS - 1 && propagation_ms > limit)
+    {
+        bucket++;
+        limit <<= 1;
+    }
+    if (m_propagation_stats.hist[bucket] < UINT16_MAX)
+    {
+        m_propagation_stats.hist[bucket]++;
+    }
+}
+#endif
 
-        if (rbc_mesh_event_push(&evt) == NRF_SUCCESS)
+#ifdef RBC_MESH_NETWORK_CODING
+static netcode_entry_t* netcode_entry_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < RBC_MESH_NETCODE_ENTRIES; ++i)
+    {
+        if (m_netcode_entries[i].handle == handle)
         {
-            /* assert if this doesn't work. The empty allocation above should have prevented any errors this time. */
-            APP_ERROR_CHECK(handle_storage_info_set(p_adv_data->handle, &new_info));
-
-            mesh_gatt_value_set(p_adv_data->handle,
-                p_adv_data->data,
-                p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+            return &m_netcode_entries[i];
         }
+    }
+    return NULL;
+}
 
-        vh_order_update(timestamp);
+/** Remember the neighbor a version of a value came from, the first one to
+  send it wins. */
+static void netcode_heard(rbc_mesh_value_handle_t handle, uint16_t version, const uint8_t* p_addr)
+{
+    netcode_entry_t* p_entry = netcode_entry_get(handle);
+    if (p_entry != NULL && p_entry->version == version)
+    {
+        return;
+    }
+    if (p_entry == NULL)
+    {
+        p_entry = &m_netcode_entries[m_netcode_entry_next];
+        m_netcode_entry_next = (m_netcode_entry_next + 1) % RBC_MESH_NETCODE_ENTRIES;
+    }
+    p_entry->handle = handle;
+    p_entry->version = version;
+    memcpy(p_entry->addr, p_addr, BLE_GAP_ADDR_LEN);
+    p_entry->tx_remaining = RBC_MESH_NETCODE_TX_COUNT;
+}
 
-#ifdef RBC_MESH_SERIAL
-        mesh_aci_rbc_event_handler(&evt);
-#endif
+/** Get the entry of a value that may go out coded in this transmission. */
+static netcode_entry_t* netcode_candidate_get(mesh_adv_data_t* p_adv)
+{
+    if (p_adv == NULL || mesh_segment_is_segmented(p_adv->handle))
+    {
+        return NULL;
     }
-    else if (delta < 0)
+#ifdef RBC_MESH_HOP_SCOPES
+    if (p_adv->hops_left != RBC_MESH_HOP_SCOPE_UNLIMITED)
     {
-        handle_storage_rx_inconsistent(p_adv_data->handle, timestamp);
-        vh_order_update(timestamp);
+        /* the coded packet has no room for the hop count */
+        return NULL;
     }
-    else if (delta == 0)
+#endif
+    netcode_entry_t* p_entry = netcode_entry_get(p_adv->handle);
+    if (p_entry == NULL ||
+        p_entry->version != p_adv->version ||
+        p_entry->tx_remaining == 0)
     {
-        mesh_adv_data_t* p_stored_adv_data = NULL;
-        if (info.p_packet)
-        {
-            p_stored_adv_data = mesh_packet_adv_data_get(info.p_packet);
-        }
+        return NULL;
+    }
+    return p_entry;
+}
 
-        if (p_stored_adv_data &&
-            payload_has_conflict(p_stored_adv_data, p_adv_data))
-        {
-            evt.type = RBC_MESH_EVENT_TYPE_CONFLICTING_VAL;
-            rbc_mesh_event_push(&evt); /* not really important whether this succeeds. */
+/** Send a pair of values as a coded packet. Returns whether it went out. */
+static bool netcode_pair_tx(mesh_adv_data_t* p_adv_a, mesh_adv_data_t* p_adv_b)
+{
+    const uint8_t length_a = p_adv_a->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    const uint8_t length_b = p_adv_b->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    const uint8_t coded_length = (length_a > length_b ? length_a : length_b);
 
-#ifdef RBC_MESH_SERIAL
-            mesh_aci_rbc_event_handler(&evt);
-#endif
-        }
+    mesh_packet_t* p_coded_packet = NULL;
+    if (RBC_MESH_NETCODE_OVERHEAD + coded_length > RBC_MESH_VALUE_MAX_LEN ||
+        !mesh_packet_acquire(&p_coded_packet))
+    {
+        return false;
+    }
 
-        handle_storage_rx_consistent(p_adv_data->handle, timestamp);
+    uint8_t payload[RBC_MESH_VALUE_MAX_LEN];
+    netcode_payload_t* p_netcode = (netcode_payload_t*) payload;
+    p_netcode->handle_a = p_adv_a->handle;
+    p_netcode->version_a = p_adv_a->version;
+    p_netcode->handle_b = p_adv_b->handle;
+    p_netcode->length_a = length_a;
+    p_netcode->length_b = length_b;
+    for (uint8_t i = 0; i < coded_length; ++i)
+    {
+        p_netcode->coded[i] = (i < length_a ? p_adv_a->data[i] : 0) ^
+                              (i < length_b ? p_adv_b->data[i] : 0);
     }
-    else /* delta > 0 */
+
+    bool sent = (mesh_packet_build(p_coded_packet,
+                    RBC_MESH_NETCODE_HANDLE,
+                    p_adv_b->version,
+                    payload,
+                    RBC_MESH_NETCODE_OVERHEAD + coded_length) == NRF_SUCCESS &&
+                 tc_tx(p_coded_packet, &m_tx_config) == NRF_SUCCESS);
+    if (sent)
     {
-        evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
-        evt.params.rx.version_delta = delta;
+        m_netcode_tx_count++;
+    }
+    mesh_packet_ref_count_dec(p_coded_packet);
+    return sent;
+}
 
-        /* First allocate an element in the storage to ensure that we're not out of memory. */
-        error_code = handle_storage_info_set(p_adv_data->handle, &info);
-        if (error_code != NRF_SUCCESS)
+/** Check whether two values may be coded together. */
+static bool netcode_pair_fits(mesh_adv_data_t* p_adv_a, const netcode_entry_t* p_entry_a,
+        mesh_adv_data_t* p_adv_b, const netcode_entry_t* p_entry_b)
+{
+    /* each of the senders must have one of the values, and a coded packet
+       goes out on a single access address */
+    return (p_entry_b != NULL &&
+            p_adv_a->handle != p_adv_b->handle &&
+            memcmp(p_entry_a->addr, p_entry_b->addr, BLE_GAP_ADDR_LEN) != 0 &&
+            tc_instance_get(p_adv_a->handle) == tc_instance_get(p_adv_b->handle));
+}
+
+static bool netcode_in_batch(rbc_mesh_value_handle_t handle, mesh_packet_t** pp_tx_packets, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (pp_tx_packets[i] != NULL &&
+            mesh_packet_adv_data_get(pp_tx_packets[i])->handle == handle)
         {
-            mesh_packet_ref_count_dec(info.p_packet);
-            return error_code;
+            return true;
         }
+    }
+    return false;
+}
 
-        mesh_packet_take_ownership(p_packet);
-        handle_info_t new_info =
+/**
+* Send a value that is due for transmission in a coded packet with a received
+* value that isn't due yet. The early value counts as a consistent reception,
+* which holds back its own transmission in the current interval.
+*/
+static bool netcode_early_tx(mesh_adv_data_t* p_adv_a, netcode_entry_t* p_entry_a,
+        mesh_packet_t** pp_tx_packets, uint32_t count, uint32_t timestamp)
+{
+    for (uint32_t i = 0; i < RBC_MESH_NETCODE_ENTRIES; ++i)
+    {
+        netcode_entry_t* p_entry_b = &m_netcode_entries[i];
+        handle_info_t info;
+        if (p_entry_b == p_entry_a ||
+            p_entry_b->handle == RBC_MESH_INVALID_HANDLE ||
+            p_entry_b->tx_remaining == 0 ||
+            netcode_in_batch(p_entry_b->handle, pp_tx_packets, count) ||
+            handle_storage_info_get(p_entry_b->handle, &info) != NRF_SUCCESS)
         {
-            .p_packet = p_packet,
-            .version = p_adv_data->version
-        };
-
-        if (rbc_mesh_event_push(&evt) == NRF_SUCCESS)
+            continue;
+        }
+        mesh_adv_data_t* p_adv_b = mesh_packet_adv_data_get(info.p_packet);
+        bool sent = (netcode_candidate_get(p_adv_b) == p_entry_b &&
+                     netcode_pair_fits(p_adv_a, p_entry_a, p_adv_b, p_entry_b) &&
+                     netcode_pair_tx(p_adv_a, p_adv_b));
+        mesh_packet_ref_count_dec(info.p_packet);
+        if (sent)
         {
-            /* assert if this doesn't work. The empty allocation above should have prevented any errors this time. */
+            PIN_OUT(p_adv_a->handle, 8);
+            APP_ERROR_CHECK(handle_storage_transmitted(p_adv_a->handle, timestamp));
+            (void) handle_storage_rx_consistent(p_entry_b->handle, timestamp);
+            p_entry_a->tx_remaining--;
+            p_entry_b->tx_remaining--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Send the received values in the TX batch as coded pairs, and take them out
+* of the batch. Values are paired with each other first, and the rest with
+* received values that are due later.
+*/
+static void netcode_tx(mesh_packet_t** pp_tx_packets, uint32_t* p_count, uint32_t timestamp)
+{
+    for (uint32_t i = 0; i < *p_count; ++i)
+    {
+        if (pp_tx_packets[i] == NULL)
+        {
+            continue;
+        }
+        mesh_adv_data_t* p_adv_a = mesh_packet_adv_data_get(pp_tx_packets[i]);
+        netcode_entry_t* p_entry_a = netcode_candidate_get(p_adv_a);
+        for (uint32_t j = i + 1; pp_tx_packets[i] != NULL && p_entry_a != NULL && j < *p_count; ++j)
+        {
+            if (pp_tx_packets[j] == NULL)
+            {
+                continue;
+            }
+            mesh_adv_data_t* p_adv_b = mesh_packet_adv_data_get(pp_tx_packets[j]);
+            netcode_entry_t* p_entry_b = netcode_candidate_get(p_adv_b);
+            if (netcode_pair_fits(p_adv_a, p_entry_a, p_adv_b, p_entry_b) &&
+                netcode_pair_tx(p_adv_a, p_adv_b))
+            {
+                PIN_OUT(p_adv_a->handle, 8);
+                APP_ERROR_CHECK(handle_storage_transmitted(p_adv_a->handle, timestamp));
+                PIN_OUT(p_adv_b->handle, 8);
+                APP_ERROR_CHECK(handle_storage_transmitted(p_adv_b->handle, timestamp));
+                p_entry_a->tx_remaining--;
+                p_entry_b->tx_remaining--;
+                mesh_packet_ref_count_dec(pp_tx_packets[i]);
+                mesh_packet_ref_count_dec(pp_tx_packets[j]);
+                pp_tx_packets[i] = NULL;
+                pp_tx_packets[j] = NULL;
+            }
+        }
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < *p_count; ++i)
+    {
+        if (pp_tx_packets[i] == NULL)
+        {
+            continue;
+        }
+        mesh_adv_data_t* p_adv_a = mesh_packet_adv_data_get(pp_tx_packets[i]);
+        netcode_entry_t* p_entry_a = netcode_candidate_get(p_adv_a);
+        if (p_entry_a != NULL && netcode_early_tx(p_adv_a, p_entry_a, pp_tx_packets, *p_count, timestamp))
+        {
+            mesh_packet_ref_count_dec(pp_tx_packets[i]);
+            pp_tx_packets[i] = NULL;
+            continue;
+        }
+        pp_tx_packets[kept++] = pp_tx_packets[i];
+    }
+    *p_count = kept;
+}
+#endif
+
+#ifdef RBC_MESH_RX_HOOKS
+/** Call the hook of a newly stored value, and remove it if it overran its budget. */
+static void rx_hook_call(const mesh_adv_data_t* p_adv_data)
+{
+    for (uint32_t i = 0; i < RBC_MESH_RX_HOOKS_MAX; ++i)
+    {
+        if (m_rx_hooks[i].hook != NULL && m_rx_hooks[i].handle == p_adv_data->handle)
+        {
+            uint32_t start = timer_now();
+            m_rx_hooks[i].hook(p_adv_data->handle,
+                    p_adv_data->data,
+                    p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+            m_rx_hook_calls++;
+            if (TIMER_DIFF(timer_now(), start) > RBC_MESH_RX_HOOK_BUDGET_US)
+            {
+                m_rx_hooks[i].hook = NULL;
+                m_rx_hook_overruns++;
+            }
+            return;
+        }
+    }
+}
+#endif
+
+static uint32_t rx_single(mesh_packet_t* p_packet, mesh_adv_data_t* p_adv_data, uint32_t timestamp, uint8_t rssi)
+{
+    if (mesh_segment_is_segmented(p_adv_data->handle))
+    {
+        return mesh_segment_rx(p_packet, timestamp, rssi);
+    }
+
+#ifdef RBC_MESH_HOP_SCOPES
+    /* the hop to this node is spent, the stored copy is relayed with the rest */
+    if (p_adv_data->hops_left != RBC_MESH_HOP_SCOPE_UNLIMITED &&
+        p_adv_data->hops_left > 0)
+    {
+        p_adv_data->hops_left--;
+    }
+#endif
+
+    handle_info_t info;
+    uint32_t error_code = handle_storage_info_get(p_adv_data->handle, &info);
+
+    int16_t delta = version_delta(info.version, p_adv_data->version);
+
+    mesh_adv_data_t* p_stored_adv_data = NULL;
+    if (error_code == NRF_SUCCESS && info.p_packet)
+    {
+        p_stored_adv_data = mesh_packet_adv_data_get(info.p_packet);
+    }
+
+    bool conflict = (delta == 0 &&
+            p_stored_adv_data != NULL &&
+            payload_has_conflict(p_stored_adv_data, p_adv_data));
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+    /* the winner of a conflict is taken like a newer version */
+    bool conflict_won = (conflict && conflict_is_won(p_stored_adv_data, p_adv_data));
+#else
+    bool conflict_won = false;
+#endif
+#ifdef RBC_MESH_VALUE_FINGERPRINT
+    bool fingerprint_match;
+    if (delta == 0 &&
+        p_stored_adv_data == NULL &&
+        error_code == NRF_SUCCESS &&
+        handle_storage_fingerprint_check(p_adv_data->handle,
+            p_adv_data->version,
+            p_adv_data->data,
+            p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD,
+            &fingerprint_match) == NRF_SUCCESS &&
+        !fingerprint_match)
+    {
+        conflict = true;
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+        /* Without our payload there's nothing to compare with, so the copy is
+           taken. If it loses, the nodes holding the winner send it again. */
+        conflict_won = true;
+#endif
+    }
+#endif
+#ifdef RBC_MESH_NETWORK_CODING
+    if (!conflict && (error_code == NRF_ERROR_NOT_FOUND || delta >= 0))
+    {
+        /* read before the packet's address is overwritten by take_ownership */
+        netcode_heard(p_adv_data->handle, p_adv_data->version, p_packet->addr);
+    }
+#endif
+
+    /* prepare app event */
+    rbc_mesh_event_t evt;
+    evt.params.rx.version_delta = delta;
+    evt.params.rx.ble_adv_addr.addr_type = p_packet->header.addr_type;
+    memcpy(evt.params.rx.ble_adv_addr.addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+    evt.params.rx.rssi = -((int8_t) rssi);
+    evt.params.rx.p_data = p_adv_data->data;
+    evt.params.rx.data_len = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    evt.params.rx.value_handle = p_adv_data->handle;
+    evt.params.rx.version = p_adv_data->version;
+    evt.params.rx.source = RBC_MESH_EVENT_SOURCE_MESH;
+    evt.params.rx.timestamp_us = timestamp;
+#ifdef RBC_MESH_ORIGIN_TIME
+    evt.params.rx.propagation_ms = propagation_ms_get(p_adv_data->origin_time, timestamp);
+#endif
+
+    if (error_code == NRF_ERROR_NOT_FOUND)
+    {
+        /* couldn't find the handle in the handle storage */
+        evt.type = RBC_MESH_EVENT_TYPE_NEW_VAL;
+        evt.params.rx.version_delta = delta;
+
+        /* First allocate an element in the storage to ensure that we're not out of memory. */
+        error_code = handle_storage_info_set(p_adv_data->handle, &info);
+        if (error_code != NRF_SUCCESS)
+        {
+            mesh_packet_ref_count_dec(info.p_packet);
+            return error_code;
+        }
+
+        mesh_packet_take_ownership(p_packet);
+        handle_info_t new_info =
+        {
+            .p_packet = p_packet,
+            .version = p_adv_data->version
+        };
+
+        if (rbc_mesh_event_push(&evt) == NRF_SUCCESS)
+        {
+            /* assert if this doesn't work. The empty allocation above should have prevented any errors this time. */
+            APP_ERROR_CHECK(handle_storage_info_set(p_adv_data->handle, &new_info));
+#ifdef RBC_MESH_RX_HOOKS
+            rx_hook_call(p_adv_data);
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+            propagation_record(evt.params.rx.propagation_ms);
+#endif
+            /* the sender transmitted the value we now have */
+            for (uint32_t i = 1; i < rx_weight_get(rssi); ++i)
+            {
+                (void) handle_storage_rx_consistent(p_adv_data->handle, timestamp);
+            }
+
+            mesh_gatt_value_set(p_adv_data->handle,
+                p_adv_data->data,
+                p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD);
+        }
+
+        vh_order_update(timestamp);
+
+#ifdef RBC_MESH_SERIAL
+        mesh_aci_rbc_event_handler(&evt);
+#endif
+    }
+    else if (delta < 0)
+    {
+#ifdef RBC_MESH_VERSION_REPAIR
+        /* Answer with a single transmission rather than restarting the
+           interval, the version pages pick up what the rate limit drops. */
+        repair_request(p_adv_data->handle, timestamp);
+#else
+        handle_storage_rx_inconsistent(p_adv_data->handle, timestamp);
+#endif
+        vh_order_update(timestamp);
+    }
+    else if (delta == 0 && !conflict_won)
+    {
+        if (conflict)
+        {
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+            /* our copy wins, restart the interval to spread it to the sender */
+            handle_storage_rx_inconsistent(p_adv_data->handle, timestamp);
+            vh_order_update(timestamp);
+            mesh_packet_ref_count_dec(info.p_packet);
+            return NRF_SUCCESS;
+#else
+            evt.type = RBC_MESH_EVENT_TYPE_CONFLICTING_VAL;
+            rbc_mesh_event_push(&evt); /* not really important whether this succeeds. */
+
+#ifdef RBC_MESH_SERIAL
+            mesh_aci_rbc_event_handler(&evt);
+#endif
+#endif
+        }
+
+        for (uint32_t i = 0; i < rx_weight_get(rssi); ++i)
+        {
+            handle_storage_rx_consistent(p_adv_data->handle, timestamp);
+        }
+#ifdef RBC_MESH_HOP_SCOPES
+        /* a copy from closer to the source takes the value further */
+        (void) handle_storage_hops_left_raise(p_adv_data->handle, p_adv_data->version, p_adv_data->hops_left);
+#endif
+    }
+    else /* delta > 0, or a won conflict */
+    {
+        evt.type = RBC_MESH_EVENT_TYPE_UPDATE_VAL;
+        evt.params.rx.version_delta = delta;
+
+        /* First allocate an element in the storage to ensure that we're not out of memory. */
+        error_code = handle_storage_info_set(p_adv_data->handle, &info);
+        if (error_code != NRF_SUCCESS)
+        {
+            mesh_packet_ref_count_dec(info.p_packet);
+            return error_code;
+        }
+
+        mesh_packet_take_ownership(p_packet);
+        handle_info_t new_info =
+        {
+            .p_packet = p_packet,
+            .version = p_adv_data->version
+        };
+
+        if (rbc_mesh_event_push(&evt) == NRF_SUCCESS)
+        {
+            /* assert if this doesn't work. The empty allocation above should have prevented any errors this time. */
             APP_ERROR_CHECK(handle_storage_info_set(p_adv_data->handle, &new_info));
+#ifdef RBC_MESH_RX_HOOKS
+            rx_hook_call(p_adv_data);
+#endif
+#ifdef RBC_MESH_ORIGIN_TIME
+            propagation_record(evt.params.rx.propagation_ms);
+#endif
+            /* the sender transmitted the value we now have */
+            for (uint32_t i = 1; i < rx_weight_get(rssi); ++i)
+            {
+                (void) handle_storage_rx_consistent(p_adv_data->handle, timestamp);
+            }
 
             mesh_gatt_value_set(p_adv_data->handle,
                 p_adv_data->data,
@@ -339,6 +968,1621 @@ uint32_t vh_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi)
     return NRF_SUCCESS;
 }
 
+
+#ifdef RBC_MESH_DELTA_UPDATES
+static delta_payload_t* delta_payload_get(mesh_packet_t* p_packet)
+{
+    mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_packet);
+    if (p_adv == NULL ||
+        p_adv->handle != RBC_MESH_DELTA_HANDLE ||
+        p_adv->adv_data_length <= MESH_PACKET_ADV_OVERHEAD + RBC_MESH_DELTA_OVERHEAD)
+    {
+        return NULL;
+    }
+    return (delta_payload_t*) p_adv->data;
+}
+
+static delta_entry_t* delta_entry_get(rbc_mesh_value_handle_t handle)
+{
+    for (uint32_t i = 0; i < RBC_MESH_DELTA_ENTRIES; ++i)
+    {
+        delta_payload_t* p_delta = delta_payload_get(m_delta_entries[i].p_packet);
+        if (p_delta && p_delta->handle == handle)
+        {
+            return &m_delta_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void delta_entry_free(delta_entry_t* p_entry)
+{
+    if (p_entry->p_packet != NULL)
+    {
+        mesh_packet_ref_count_dec(p_entry->p_packet);
+        p_entry->p_packet = NULL;
+    }
+    p_entry->tx_remaining = 0;
+}
+
+/** Store a delta packet for transmission, replacing any previous delta for the
+  same handle, or the oldest entry. */
+static void delta_entry_set(mesh_packet_t* p_packet)
+{
+    delta_entry_t* p_entry = delta_entry_get(delta_payload_get(p_packet)->handle);
+    if (p_entry == NULL)
+    {
+        p_entry = &m_delta_entries[m_delta_entry_next];
+        m_delta_entry_next = (m_delta_entry_next + 1) % RBC_MESH_DELTA_ENTRIES;
+    }
+    delta_entry_free(p_entry);
+
+    mesh_packet_ref_count_inc(p_packet);
+    p_entry->p_packet = p_packet;
+    p_entry->tx_remaining = RBC_MESH_DELTA_TX_COUNT;
+}
+
+/** Get the delta packet to transmit in place of the given value, if any. */
+static mesh_packet_t* delta_tx_packet_get(mesh_adv_data_t* p_adv)
+{
+    delta_entry_t* p_entry = delta_entry_get(p_adv->handle);
+    if (p_entry == NULL)
+    {
+        return NULL;
+    }
+
+    mesh_adv_data_t* p_delta_adv = mesh_packet_adv_data_get(p_entry->p_packet);
+    if (p_delta_adv->version != p_adv->version || p_entry->tx_remaining == 0)
+    {
+        /* the value has moved on, or the delta has been sent enough times */
+        delta_entry_free(p_entry);
+        return NULL;
+    }
+
+    p_entry->tx_remaining--;
+    return p_entry->p_packet;
+}
+
+/**
+* Build a delta packet from the previous and current value of a handle, if the
+* delta turns out shorter than the full value. Executed in event handler
+* context after the local update has been pushed to the handle storage.
+*/
+static void delta_prepare(void* p_context)
+{
+    mesh_packet_t* p_old_packet = (mesh_packet_t*) p_context;
+    mesh_adv_data_t* p_old_adv = mesh_packet_adv_data_get(p_old_packet);
+    handle_info_t info;
+
+    if (p_old_adv != NULL &&
+        handle_storage_info_get(p_old_adv->handle, &info) == NRF_SUCCESS)
+    {
+        mesh_adv_data_t* p_new_adv = mesh_packet_adv_data_get(info.p_packet);
+        if (p_new_adv != NULL &&
+            p_new_adv->adv_data_length == p_old_adv->adv_data_length &&
+            version_delta(p_old_adv->version, p_new_adv->version) > 0)
+        {
+            const uint8_t length = p_new_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+            uint8_t first = 0;
+            uint8_t last = length;
+            while (first < length && p_old_adv->data[first] == p_new_adv->data[first])
+            {
+                first++;
+            }
+            while (last > first && p_old_adv->data[last - 1] == p_new_adv->data[last - 1])
+            {
+                last--;
+            }
+
+            mesh_packet_t* p_delta_packet = NULL;
+            if (last > first &&
+                RBC_MESH_DELTA_OVERHEAD + (last - first) < length &&
+                mesh_packet_acquire(&p_delta_packet))
+            {
+                uint8_t payload[RBC_MESH_VALUE_MAX_LEN];
+                delta_payload_t* p_delta = (delta_payload_t*) payload;
+                p_delta->handle = p_new_adv->handle;
+                p_delta->base_version = p_old_adv->version;
+                p_delta->length = length;
+                p_delta->offset = first;
+                memcpy(p_delta->patch, &p_new_adv->data[first], last - first);
+
+                if (mesh_packet_build(p_delta_packet,
+                            RBC_MESH_DELTA_HANDLE,
+                            p_new_adv->version,
+                            payload,
+                            RBC_MESH_DELTA_OVERHEAD + (last - first)) == NRF_SUCCESS)
+                {
+                    delta_entry_set(p_delta_packet);
+                }
+                mesh_packet_ref_count_dec(p_delta_packet);
+            }
+        }
+        mesh_packet_ref_count_dec(info.p_packet);
+    }
+    mesh_packet_ref_count_dec(p_old_packet);
+}
+#endif
+
+#ifdef RBC_MESH_VALUE_TTL
+static void value_expired(rbc_mesh_value_handle_t handle)
+{
+    rbc_mesh_event_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.type = RBC_MESH_EVENT_TYPE_VALUE_EXPIRED;
+    evt.params.rx.value_handle = handle;
+    (void) rbc_mesh_event_push(&evt);
+}
+
+static void ttl_tick(uint32_t timestamp, void* p_context)
+{
+    if (handle_storage_ttl_tick(value_expired) > 0)
+    {
+        vh_order_update(timestamp);
+    }
+}
+#endif
+
+static void transmit_all_instances(uint32_t timestamp, void* p_context);
+
+#ifdef RBC_MESH_TX_BACKPRESSURE
+static void tx_ready(void)
+{
+    vh_order_update(timer_now());
+}
+
+/** There's room for another packet in the radio queue. Values that don't get
+  a slot aren't reported as transmitted, and stay due for the next round. */
+static bool tx_slot_free(void)
+{
+    return (tc_tx_slots_get(&m_tx_config) > 0);
+}
+#else
+#define tx_slot_free()  (true)
+#endif
+
+static void order_next_transmission(uint32_t time_now)
+{
+    bool found_value;
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+    /* cached for the timeslot module, which orders timeslots from the radio callback */
+    bool found_urgent;
+    uint32_t urgent_timeout = handle_storage_urgent_timeout_get(&found_urgent);
+    m_next_urgent_tx_valid = false;
+    m_next_urgent_tx_time = urgent_timeout;
+    m_next_urgent_tx_valid = found_urgent;
+#endif
+    uint32_t timeout = handle_storage_next_timeout_get(&found_value);
+    m_next_tx_valid = found_value;
+    if (!found_value)
+    {
+        return;
+    }
+    m_next_tx_time = timeout;
+#ifdef RBC_MESH_TX_BACKPRESSURE
+    if (m_tx_blocked && timeout < time_now + 1000)
+    {
+        /* The due values are waiting for the radio queue, go again as soon
+           as it has room. The timer covers a lost notification. */
+        tc_tx_ready_wait(tx_ready);
+        if (timer_sch_reschedule(&m_tx_timer_evt, time_now + RBC_MESH_TX_BACKPRESSURE_RETRY_US) != NRF_SUCCESS)
+        {
+            vh_order_update(time_now);
+        }
+        return;
+    }
+#endif
+    if (timeout < time_now + 1000)
+    {
+        vh_order_update(timeout);
+    }
+    else
+    {
+        if (timer_sch_reschedule(&m_tx_timer_evt, timeout) != NRF_SUCCESS)
+        {
+            vh_order_update(timeout);
+        }
+    }
+}
+
+#ifdef RBC_MESH_AGGREGATED_TX
+/** Transmit the aggregate packet, and mark all values in it as transmitted. */
+static void aggregate_tx(mesh_packet_t* p_aggregate, uint32_t timestamp)
+{
+    if (tx_slot_free() && tc_tx(p_aggregate, &m_tx_config) == NRF_SUCCESS)
+    {
+        for (mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(p_aggregate);
+             p_adv != NULL;
+             p_adv = mesh_packet_adv_data_next_get(p_aggregate, p_adv))
+        {
+            PIN_OUT(p_adv->handle, 8);
+            APP_ERROR_CHECK(handle_storage_transmitted(p_adv->handle, timestamp));
+        }
+    }
+    mesh_packet_ref_count_dec(p_aggregate);
+}
+
+/**
+* Add the value in the given packet to the aggregate packet, transmitting the
+* current aggregate first if the value doesn't fit.
+*
+* @return NRF_SUCCESS if the value was added to an aggregate packet.
+*/
+static uint32_t aggregate_add(mesh_packet_t** pp_aggregate, mesh_adv_data_t* p_adv, uint32_t timestamp)
+{
+    /* an aggregate goes out on a single access address */
+    mesh_adv_data_t* p_first = (*pp_aggregate == NULL ? NULL : mesh_packet_adv_data_get(*pp_aggregate));
+    if (*pp_aggregate != NULL &&
+        (p_first == NULL || tc_instance_get(p_first->handle) == tc_instance_get(p_adv->handle)) &&
+        mesh_packet_adv_data_append(*pp_aggregate, p_adv) == NRF_SUCCESS)
+    {
+        return NRF_SUCCESS;
+    }
+
+    if (*pp_aggregate != NULL)
+    {
+        aggregate_tx(*pp_aggregate, timestamp);
+        *pp_aggregate = NULL;
+    }
+
+    if (!mesh_packet_acquire(pp_aggregate))
+    {
+        *pp_aggregate = NULL;
+        return NRF_ERROR_NO_MEM;
+    }
+    mesh_packet_set_local_addr(*pp_aggregate);
+    (*pp_aggregate)->header.type = BLE_PACKET_TYPE_ADV_NONCONN_IND;
+    (*pp_aggregate)->header.length = MESH_PACKET_BLE_OVERHEAD;
+
+    return mesh_packet_adv_data_append(*pp_aggregate, p_adv);
+}
+#endif
+
+static void transmit_all_instances(uint32_t timestamp, void* p_context)
+{
+    SET_PIN(8);
+    TRACE_BEGIN(MESH_TRACE_POINT_TX, 0);
+    mesh_packet_t* pp_tx_packets[RBC_MESH_RADIO_QUEUE_LENGTH - 1];
+    uint32_t count = RBC_MESH_RADIO_QUEUE_LENGTH - 1;
+#ifdef RBC_MESH_AGGREGATED_TX
+    mesh_packet_t* p_aggregate = NULL;
+#endif
+#if defined(RBC_MESH_TX_BACKPRESSURE) && !defined(RBC_MESH_AGGREGATED_TX)
+    /* each value takes at least a packet, don't evaluate more than can fit.
+       Aggregated values share packets, and are only held back per packet. */
+    uint32_t slots = tc_tx_slots_get(&m_tx_config);
+    if (slots < count)
+    {
+        count = slots;
+    }
+#endif
+
+    uint32_t error_code = (count > 0) ? handle_storage_tx_packets_get(timestamp, pp_tx_packets, &count) : NRF_SUCCESS;
+    if (error_code == NRF_SUCCESS)
+    {
+#ifdef RBC_MESH_NETWORK_CODING
+        netcode_tx(pp_tx_packets, &count, timestamp);
+#endif
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mesh_adv_data_t* p_adv = mesh_packet_adv_data_get(pp_tx_packets[i]);
+#ifdef RBC_MESH_DELTA_UPDATES
+            mesh_packet_t* p_delta_packet;
+#endif
+            if (!tx_slot_free())
+            {
+                /* the radio queue filled up, keep the value due */
+                error_code = NRF_ERROR_BUSY;
+            }
+            else if (p_adv && mesh_segment_is_segmented(p_adv->handle))
+            {
+                error_code = mesh_segment_tx(pp_tx_packets[i], &m_tx_config);
+            }
+#ifdef RBC_MESH_DELTA_UPDATES
+            else if (p_adv && (p_delta_packet = delta_tx_packet_get(p_adv)) != NULL)
+            {
+                error_code = tc_tx(p_delta_packet, &m_tx_config);
+            }
+#endif
+#ifdef RBC_MESH_AGGREGATED_TX
+            else if (p_adv &&
+                     aggregate_add(&p_aggregate, p_adv, timestamp) == NRF_SUCCESS)
+            {
+                /* transmitted with the aggregate packet */
+                mesh_packet_ref_count_dec(pp_tx_packets[i]);
+                continue;
+            }
+#endif
+            else
+            {
+                error_code = tc_tx(pp_tx_packets[i], &m_tx_config);
+            }
+            if (error_code == NRF_SUCCESS)
+            {
+                if (p_adv)
+                {
+                    PIN_OUT(p_adv->handle, 8);
+                    APP_ERROR_CHECK(handle_storage_transmitted(p_adv->handle, timestamp));
+                }
+                else
+                {
+                    APP_ERROR_CHECK(NRF_ERROR_INVALID_DATA);
+                }
+            }
+            mesh_packet_ref_count_dec(pp_tx_packets[i]);
+        }
+    }
+#ifdef RBC_MESH_AGGREGATED_TX
+    if (p_aggregate != NULL)
+    {
+        aggregate_tx(p_aggregate, timestamp);
+    }
+#endif
+#ifdef RBC_MESH_TX_BACKPRESSURE
+    /* only wait for the radio queue if values were actually left behind on it */
+    bool found_value;
+    uint32_t next_timeout = handle_storage_next_timeout_get(&found_value);
+    m_tx_blocked = (found_value &&
+                    !TIMER_OLDER_THAN(timestamp, next_timeout) &&
+                    !tx_slot_free());
+#endif
+    CLEAR_PIN(8);
+    TRACE_END(MESH_TRACE_POINT_TX, 0);
+    order_next_transmission(timestamp);
+}
+
+#ifdef RBC_MESH_SUMMARY_BEACON
+/** Build the summary beacon payload from the current handle storage state.
+  Returns the number of values covered by it. */
+static uint16_t summary_payload_get(uint8_t* p_payload)
+{
+    uint32_t digest;
+    uint16_t count;
+    APP_ERROR_CHECK(handle_storage_summary_get(&digest, &count));
+    memcpy(&p_payload[0], &digest, sizeof(digest));
+    memcpy(&p_payload[sizeof(digest)], &count, sizeof(count));
+    return count;
+}
+
+static void summary_tx(uint32_t timestamp, void* p_context)
+{
+    uint8_t payload[RBC_MESH_SUMMARY_PAYLOAD_LEN];
+    if (summary_payload_get(payload) == 0)
+    {
+        /* nothing to summarize */
+        return;
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_SUMMARY_HANDLE,
+                    0,
+                    payload,
+                    RBC_MESH_SUMMARY_PAYLOAD_LEN) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &m_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+#endif
+
+#ifdef RBC_MESH_VERSION_REPAIR
+/** Broadcast the next page of handle/version pairs, ending the round after
+  the page that covers the rest of the handle space. */
+static void repair_page_tx(uint32_t timestamp, void* p_context)
+{
+    uint16_t handles[RBC_MESH_REPAIR_PAGE_ENTRIES];
+    uint16_t versions[RBC_MESH_REPAIR_PAGE_ENTRIES];
+    uint32_t count = RBC_MESH_REPAIR_PAGE_ENTRIES;
+    APP_ERROR_CHECK(handle_storage_versions_get(m_repair_cursor, handles, versions, &count));
+
+    uint16_t last = (count == RBC_MESH_REPAIR_PAGE_ENTRIES) ? handles[count - 1] : (RBC_MESH_INVALID_HANDLE - 1);
+    uint8_t payload[RBC_MESH_REPAIR_PAGE_OVERHEAD + 4 * RBC_MESH_REPAIR_PAGE_ENTRIES];
+    memcpy(&payload[0], &m_repair_cursor, sizeof(uint16_t));
+    memcpy(&payload[2], &last, sizeof(uint16_t));
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        memcpy(&payload[RBC_MESH_REPAIR_PAGE_OVERHEAD + 4 * i], &handles[i], sizeof(uint16_t));
+        memcpy(&payload[RBC_MESH_REPAIR_PAGE_OVERHEAD + 4 * i + 2], &versions[i], sizeof(uint16_t));
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_REPAIR_HANDLE,
+                    0,
+                    payload,
+                    RBC_MESH_REPAIR_PAGE_OVERHEAD + 4 * count) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &m_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+
+    if (last == RBC_MESH_INVALID_HANDLE - 1)
+    {
+        m_repair_active = false;
+        (void) timer_sch_abort(&m_repair_timer_evt);
+    }
+    else
+    {
+        m_repair_cursor = last + 1;
+    }
+}
+#endif
+
+#ifdef RBC_MESH_BOOTSTRAP
+static void bootstrap_tx(bootstrap_type_t type, const uint8_t* p_addr, uint16_t handle)
+{
+    bootstrap_payload_t payload;
+    payload.type = type;
+    memcpy(payload.addr, p_addr, BLE_GAP_ADDR_LEN);
+    payload.handle = handle;
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_BOOTSTRAP_HANDLE,
+                    0,
+                    (uint8_t*) &payload,
+                    RBC_MESH_BOOTSTRAP_PAYLOAD_LEN) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &m_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+
+/** Step the node's own bootstrap along when nothing was heard in time. */
+static void bootstrap_timeout(uint32_t timestamp, void* p_context)
+{
+    uint32_t digest;
+    uint16_t count;
+    switch (m_bootstrap_state)
+    {
+        case BOOTSTRAP_STATE_LISTEN:
+            if (!m_bootstrap_peer_valid)
+            {
+                APP_ERROR_CHECK(handle_storage_summary_get(&digest, &count));
+                if (count > 0)
+                {
+                    /* the application set values of its own before anyone showed up */
+                    m_bootstrap_state = BOOTSTRAP_STATE_IDLE;
+                }
+                else
+                {
+                    APP_ERROR_CHECK(timer_sch_reschedule(&m_bootstrap_timer_evt, timestamp + RBC_MESH_BOOTSTRAP_LISTEN_US));
+                }
+                break;
+            }
+            m_bootstrap_cursor = 0;
+            m_bootstrap_retries = RBC_MESH_BOOTSTRAP_RETRIES;
+            m_bootstrap_state = BOOTSTRAP_STATE_REQUESTED;
+            bootstrap_tx(BOOTSTRAP_TYPE_REQUEST, m_bootstrap_peer, m_bootstrap_cursor);
+            APP_ERROR_CHECK(timer_sch_reschedule(&m_bootstrap_timer_evt, timestamp + RBC_MESH_BOOTSTRAP_TIMEOUT_US));
+            break;
+        case BOOTSTRAP_STATE_REQUESTED:
+            if (m_bootstrap_retries == 0)
+            {
+                /* leave the rest to Trickle */
+                m_bootstrap_state = BOOTSTRAP_STATE_IDLE;
+                break;
+            }
+            m_bootstrap_retries--;
+            bootstrap_tx(BOOTSTRAP_TYPE_REQUEST, m_bootstrap_peer, m_bootstrap_cursor);
+            APP_ERROR_CHECK(timer_sch_reschedule(&m_bootstrap_timer_evt, timestamp + RBC_MESH_BOOTSTRAP_TIMEOUT_US));
+            break;
+        default:
+            break;
+    }
+}
+
+/** Order the next batch of values for the node being bootstrapped, followed
+  by a progress message. The values are all due at once, and go out together
+  in aggregated packets. */
+static void bootstrap_serve_tx(uint32_t timestamp, void* p_context)
+{
+    uint16_t handles[RBC_MESH_BOOTSTRAP_BATCH];
+    uint16_t versions[RBC_MESH_BOOTSTRAP_BATCH];
+    uint32_t count = RBC_MESH_BOOTSTRAP_BATCH;
+    APP_ERROR_CHECK(handle_storage_versions_get(m_bootstrap_serve_cursor, handles, versions, &count));
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        (void) handle_storage_repair_order(handles[i], timestamp, 0);
+    }
+    vh_order_update(timestamp);
+
+    uint16_t next = (count == RBC_MESH_BOOTSTRAP_BATCH) ? handles[count - 1] + 1 : RBC_MESH_INVALID_HANDLE;
+    bootstrap_tx(BOOTSTRAP_TYPE_PROGRESS, m_bootstrap_client, next);
+    if (next == RBC_MESH_INVALID_HANDLE)
+    {
+        m_bootstrap_serving = false;
+        (void) timer_sch_abort(&m_bootstrap_serve_timer_evt);
+    }
+    else
+    {
+        m_bootstrap_serve_cursor = next;
+    }
+}
+#endif
+
+#ifdef RBC_MESH_TIME_SYNC
+/** Become the time root, continuing from the current mesh time. */
+static void time_sync_root_take(uint32_t time_now)
+{
+    timer_mesh_time_reset(time_now);
+    m_time_root_id = NRF_FICR->DEVICEADDR[0];
+    m_time_hops = 0;
+}
+
+static void time_sync_tx(uint32_t timestamp, void* p_context)
+{
+    uint32_t time_now = timer_now();
+    if (m_time_hops > 0 &&
+        TIMER_DIFF(time_now, m_time_last_sync) > RBC_MESH_TIME_SYNC_TIMEOUT_US)
+    {
+        /* lost the root, its last beacon may still circulate */
+        m_time_lost_root_id = m_time_root_id;
+        m_time_lost_seq = m_time_seq;
+        m_time_lost_time = time_now;
+        time_sync_root_take(time_now);
+    }
+    if (m_time_hops == 0)
+    {
+        m_time_seq++;
+    }
+
+    time_sync_payload_t payload;
+    payload.root_id = m_time_root_id;
+    payload.hops = m_time_hops;
+    payload.seq = m_time_seq;
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        payload.mesh_time = timer_mesh_time_get(timer_now());
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_TIME_SYNC_HANDLE,
+                    0,
+                    (uint8_t*) &payload,
+                    RBC_MESH_TIME_SYNC_PAYLOAD_LEN) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &m_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+#endif
+
+#ifdef RBC_MESH_CHANNEL_QUALITY
+static uint32_t channel_count(uint8_t channel_map)
+{
+    uint32_t count = 0;
+    for (; channel_map != 0; channel_map >>= 1)
+    {
+        count += (channel_map & 0x01);
+    }
+    return count;
+}
+
+static void channel_map_adopt(uint8_t channel_map, uint8_t seq, uint32_t time_now)
+{
+    if (channel_map != tc_channel_map_get())
+    {
+        m_channel_map_changed = time_now;
+    }
+    tc_channel_map_set(channel_map);
+    m_channel_map_seq = seq;
+    m_channel_map_known = true;
+}
+
+/** Judge the channels at the end of every quality period, and beacon the
+  channel map as soon as there is one. */
+static void channel_map_tx(uint32_t timestamp, void* p_context)
+{
+    uint32_t time_now = timer_now();
+    m_channel_quality_elapsed_us += RBC_MESH_CHANNEL_MAP_INTERVAL_US;
+    if (m_channel_quality_elapsed_us >= RBC_MESH_CHANNEL_QUALITY_PERIOD_US)
+    {
+        m_channel_quality_elapsed_us = 0;
+        uint8_t channel_map = tc_channel_map_get();
+        uint8_t bad_channels = tc_channel_quality_update();
+        uint8_t new_map = channel_map;
+        if (channel_count(channel_map) < 3 &&
+            TIMER_DIFF(time_now, m_channel_map_changed) > RBC_MESH_CHANNEL_BLACKLIST_TIME_US)
+        {
+            /* the interference may have moved on */
+            new_map = (1 << 3) - 1;
+        }
+        else if (bad_channels != 0 && channel_count(channel_map) > 1)
+        {
+            /* one channel at a time, as the others' share of the traffic
+               goes up when one is taken out */
+            new_map = channel_map & ~(bad_channels & -bad_channels);
+        }
+        if (new_map != channel_map)
+        {
+            channel_map_adopt(new_map, m_channel_map_seq + 1, time_now);
+        }
+    }
+
+    if (!m_channel_map_known)
+    {
+        /* all nodes start out with all channels */
+        return;
+    }
+
+    uint8_t payload[RBC_MESH_CHANNEL_MAP_PAYLOAD_LEN];
+    payload[0] = tc_channel_map_get();
+    payload[1] = m_channel_map_seq;
+
+    mesh_packet_t* p_packet = NULL;
+    if (mesh_packet_acquire(&p_packet))
+    {
+        if (mesh_packet_build(p_packet,
+                    RBC_MESH_CHANNEL_MAP_HANDLE,
+                    0,
+                    payload,
+                    RBC_MESH_CHANNEL_MAP_PAYLOAD_LEN) == NRF_SUCCESS)
+        {
+            (void) tc_tx(p_packet, &m_tx_config);
+        }
+        mesh_packet_ref_count_dec(p_packet);
+    }
+}
+#endif
+
+#ifdef RBC_MESH_LATENCY_PROBE
+static uint16_t probe_node_id_get(void)
+{
+    return (uint16_t) NRF_FICR->DEVICEADDR[0];
+}
+
+/** Clock the probe timestamps are taken from, the mesh time if there is one. */
+static uint32_t probe_time_get(uint32_t local_time)
+{
+#ifdef RBC_MESH_TIME_SYNC
+    return timer_mesh_time_get(local_time);
+#else
+    return local_time;
+#endif
+}
+
+/** Remember the given probe. Returns false if it has been seen before. */
+static bool probe_cache_add(const probe_payload_t* p_probe)
+{
+    for (uint32_t i = 0; i < RBC_MESH_PROBE_CACHE_SIZE; ++i)
+    {
+        if (m_probe_cache[i].valid &&
+            m_probe_cache[i].origin == p_probe->origin &&
+            m_probe_cache[i].seq == p_probe->seq &&
+            m_probe_cache[i].flags == p_probe->flags)
+        {
+            return false;
+        }
+    }
+    probe_cache_entry_t* p_entry = &m_probe_cache[m_probe_cache_next];
+    p_entry->origin = p_probe->origin;
+    p_entry->seq = p_probe->seq;
+    p_entry->flags = p_probe->flags;
+    p_entry->valid = true;
+    if (++m_probe_cache_next == RBC_MESH_PROBE_CACHE_SIZE)
+    {
+        m_probe_cache_next = 0;
+    }
+    return true;
+}
+
+static uint32_t probe_tx(probe_payload_t* p_probe, uint8_t hop_entries)
+{
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    uint32_t error_code = mesh_packet_build(p_packet,
+            RBC_MESH_PROBE_HANDLE,
+            0,
+            (uint8_t*) p_probe,
+            RBC_MESH_PROBE_OVERHEAD + hop_entries * sizeof(rbc_mesh_probe_hop_t));
+    if (error_code == NRF_SUCCESS)
+    {
+        error_code = tc_tx(p_packet, &m_tx_config);
+    }
+    mesh_packet_ref_count_dec(p_packet);
+    return error_code;
+}
+
+/** Report a probe that has reached its destination to the application. */
+static void probe_event_push(const probe_payload_t* p_probe, uint8_t hop_entries, uint32_t timestamp)
+{
+    rbc_mesh_event_t evt;
+    evt.type = RBC_MESH_EVENT_TYPE_PROBE;
+    evt.params.probe.origin = p_probe->origin;
+    evt.params.probe.target = p_probe->target;
+    evt.params.probe.seq = p_probe->seq;
+    evt.params.probe.is_reply = (p_probe->flags & PROBE_FLAG_REPLY);
+    evt.params.probe.hop_count = p_probe->hops;
+    evt.params.probe.hop_entries = hop_entries;
+    memcpy(evt.params.probe.hops, p_probe->hop, hop_entries * sizeof(rbc_mesh_probe_hop_t));
+    evt.params.probe.timestamp_us = timestamp;
+    evt.params.probe.latency_us = probe_time_get(timestamp) - p_probe->origin_time;
+#ifndef RBC_MESH_TIME_SYNC
+    if (!evt.params.probe.is_reply)
+    {
+        /* the clocks of the origin and target aren't related */
+        evt.params.probe.latency_us = 0;
+    }
+#endif
+    (void) rbc_mesh_event_push(&evt);
+}
+#endif
+
+/******************************************************************************
+* Interface functions
+******************************************************************************/
+uint32_t vh_init(uint32_t min_interval_us,
+                 uint32_t access_address,
+                 uint8_t channel,
+                 rbc_mesh_txpower_t tx_power,
+                 const handle_storage_memory_t* p_cache_memory)
+{
+    uint32_t error_code = handle_storage_init(min_interval_us, p_cache_memory);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+
+    mesh_segment_init();
+
+    m_tx_timer_evt.p_next = NULL;
+    m_tx_timer_evt.cb = transmit_all_instances;
+    m_tx_timer_evt.interval = 0;
+    m_tx_timer_evt.p_context = NULL;
+
+#ifdef RBC_MESH_DELTA_UPDATES
+    for (uint32_t i = 0; i < RBC_MESH_DELTA_ENTRIES; ++i)
+    {
+        delta_entry_free(&m_delta_entries[i]);
+    }
+    m_delta_entry_next = 0;
+#endif
+
+#ifdef RBC_MESH_NETWORK_CODING
+    for (uint32_t i = 0; i < RBC_MESH_NETCODE_ENTRIES; ++i)
+    {
+        m_netcode_entries[i].handle = RBC_MESH_INVALID_HANDLE;
+    }
+    m_netcode_entry_next = 0;
+    m_netcode_tx_count = 0;
+    m_netcode_decode_count = 0;
+#endif
+
+#ifdef RBC_MESH_BOOTSTRAP
+    /* The address is read here, as the bootstrap messages are handled in
+       the radio event context. */
+    mesh_packet_t addr_packet;
+    error_code = mesh_packet_set_local_addr(&addr_packet);
+    if (error_code != NRF_SUCCESS)
+    {
+        return error_code;
+    }
+    memcpy(m_local_addr, addr_packet.addr, BLE_GAP_ADDR_LEN);
+    memset(&m_bootstrap_timer_evt, 0, sizeof(m_bootstrap_timer_evt));
+    m_bootstrap_timer_evt.cb = bootstrap_timeout;
+    m_bootstrap_state = BOOTSTRAP_STATE_CHECK;
+    m_bootstrap_peer_valid = false;
+    memset(&m_bootstrap_serve_timer_evt, 0, sizeof(m_bootstrap_serve_timer_evt));
+    m_bootstrap_serve_timer_evt.cb = bootstrap_serve_tx;
+    m_bootstrap_serve_timer_evt.interval = RBC_MESH_BOOTSTRAP_INTERVAL_US;
+    m_bootstrap_serving = false;
+#endif
+
+#ifdef RBC_MESH_SUMMARY_BEACON
+    memset(&m_summary_timer_evt, 0, sizeof(m_summary_timer_evt));
+    m_summary_timer_evt.cb = summary_tx;
+    m_summary_timer_evt.interval = RBC_MESH_SUMMARY_INTERVAL_US;
+    m_summary_scheduled = false;
+#endif
+
+#ifdef RBC_MESH_VERSION_REPAIR
+    memset(&m_repair_timer_evt, 0, sizeof(m_repair_timer_evt));
+    m_repair_timer_evt.cb = repair_page_tx;
+    m_repair_timer_evt.interval = RBC_MESH_REPAIR_INTERVAL_US;
+    m_repair_active = false;
+    m_repair_budget_start = 0;
+    m_repair_budget = RBC_MESH_REPAIR_TX_MAX;
+#endif
+
+#ifdef RBC_MESH_VALUE_TTL
+    memset(&m_ttl_timer_evt, 0, sizeof(m_ttl_timer_evt));
+    m_ttl_timer_evt.cb = ttl_tick;
+    m_ttl_timer_evt.interval = RBC_MESH_VALUE_TTL_TICK_MS * 1000;
+    m_ttl_scheduled = false;
+#endif
+
+#ifdef RBC_MESH_TIME_SYNC
+    memset(&m_time_sync_timer_evt, 0, sizeof(m_time_sync_timer_evt));
+    m_time_sync_timer_evt.cb = time_sync_tx;
+    m_time_sync_timer_evt.interval = RBC_MESH_TIME_SYNC_INTERVAL_US;
+    m_time_sync_scheduled = false;
+    m_time_last_sync = 0;
+    m_time_seq = 0;
+    time_sync_root_take(timer_now());
+    /* no root lost yet, our own ID never comes back as a new root */
+    m_time_lost_root_id = m_time_root_id;
+    m_time_lost_seq = 0;
+    m_time_lost_time = 0;
+#endif
+
+#ifdef RBC_MESH_ORIGIN_TIME
+    memset(&m_propagation_stats, 0, sizeof(m_propagation_stats));
+#endif
+
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    memset(&m_channel_map_timer_evt, 0, sizeof(m_channel_map_timer_evt));
+    m_channel_map_timer_evt.cb = channel_map_tx;
+    m_channel_map_timer_evt.interval = RBC_MESH_CHANNEL_MAP_INTERVAL_US;
+    m_channel_map_scheduled = false;
+    m_channel_map_known = false;
+    m_channel_map_seq = 0;
+    m_channel_map_changed = timer_now();
+    m_channel_quality_elapsed_us = 0;
+#endif
+
+#ifdef RBC_MESH_LATENCY_PROBE
+    memset(m_probe_cache, 0, sizeof(m_probe_cache));
+    m_probe_cache_next = 0;
+    m_probe_seq = 0;
+#endif
+
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+    for (uint32_t i = 0; i < RBC_MESH_RX_DUPLICATE_CACHE_SIZE; ++i)
+    {
+        m_rx_duplicates[i].handle = RBC_MESH_INVALID_HANDLE;
+    }
+    m_rx_duplicate_next = 0;
+#endif
+    m_rx_duplicate_count = 0;
+
+    m_tx_config.alt_access_address = (access_address != RBC_MESH_ACCESS_ADDRESS_BLE_ADV);
+    m_tx_config.first_channel = channel;
+    m_tx_config.channel_map = 1; /* Only the first channel */
+    m_tx_config.tx_power = tx_power;
+
+    m_is_initialized = true;
+    return NRF_SUCCESS;
+}
+
+#ifdef RBC_MESH_DELTA_UPDATES
+uint32_t vh_delta_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi)
+{
+    delta_payload_t* p_delta = delta_payload_get(p_packet);
+    if (p_delta == NULL ||
+        p_delta->handle > RBC_MESH_APP_MAX_HANDLE ||
+        mesh_segment_is_segmented(p_delta->handle))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    mesh_adv_data_t* p_delta_adv = mesh_packet_adv_data_get(p_packet);
+    const uint8_t patch_length = p_delta_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD - RBC_MESH_DELTA_OVERHEAD;
+    if (p_delta->length > RBC_MESH_VALUE_MAX_LEN ||
+        p_delta->offset + patch_length > p_delta->length)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    handle_info_t info;
+    uint32_t error_code = handle_storage_info_get(p_delta->handle, &info);
+    if (error_code != NRF_SUCCESS)
+    {
+        /* we don't have the base value, wait for the full value. */
+        return error_code;
+    }
+
+    mesh_adv_data_t* p_stored_adv = mesh_packet_adv_data_get(info.p_packet);
+    int16_t delta = version_delta(info.version, p_delta_adv->version);
+    if (delta == 0)
+    {
+        handle_storage_rx_consistent(p_delta->handle, timestamp);
+    }
+    else if (delta > 0 &&
+             p_stored_adv != NULL &&
+             info.version == p_delta->base_version &&
+             p_stored_adv->adv_data_length == MESH_PACKET_ADV_OVERHEAD + p_delta->length)
+    {
+        /* apply the patch, and treat the result as a received full value */
+        mesh_packet_t* p_full_packet = NULL;
+        if (mesh_packet_acquire(&p_full_packet))
+        {
+            uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+            memcpy(data, p_stored_adv->data, p_delta->length);
+            memcpy(&data[p_delta->offset], p_delta->patch, patch_length);
+
+            error_code = mesh_packet_build(p_full_packet,
+                    p_delta->handle,
+                    p_delta_adv->version,
+                    data,
+                    p_delta->length);
+            if (error_code == NRF_SUCCESS)
+            {
+                p_full_packet->header.addr_type = p_packet->header.addr_type;
+                memcpy(p_full_packet->addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+                error_code = rx_single(p_full_packet, mesh_packet_adv_data_get(p_full_packet), timestamp, rssi);
+            }
+            if (error_code == NRF_SUCCESS)
+            {
+                /* relay the delta to our own neighbors */
+                mesh_packet_take_ownership(p_packet);
+                delta_entry_set(p_packet);
+            }
+            mesh_packet_ref_count_dec(p_full_packet);
+        }
+        else
+        {
+            error_code = NRF_ERROR_NO_MEM;
+        }
+    }
+    /* deltas we can't apply are left for the full value to resolve */
+
+    mesh_packet_ref_count_dec(info.p_packet);
+    return error_code;
+}
+#endif
+
+#ifdef RBC_MESH_NETWORK_CODING
+uint32_t vh_netcode_rx(mesh_packet_t* p_packet, uint32_t timestamp, uint8_t rssi)
+{
+    mesh_adv_data_t* p_coded_adv = mesh_packet_adv_data_get(p_packet);
+    if (p_coded_adv == NULL ||
+        p_coded_adv->adv_data_length < MESH_PACKET_ADV_OVERHEAD + RBC_MESH_NETCODE_OVERHEAD)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    netcode_payload_t* p_netcode = (netcode_payload_t*) p_coded_adv->data;
+    const uint8_t coded_length = p_coded_adv->adv_data_length - MESH_PACKET_ADV_OVERHEAD - RBC_MESH_NETCODE_OVERHEAD;
+    if (p_netcode->handle_a > RBC_MESH_APP_MAX_HANDLE ||
+        p_netcode->handle_b > RBC_MESH_APP_MAX_HANDLE ||
+        p_netcode->handle_a == p_netcode->handle_b ||
+        mesh_segment_is_segmented(p_netcode->handle_a) ||
+        mesh_segment_is_segmented(p_netcode->handle_b))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    if (coded_length != (p_netcode->length_a > p_netcode->length_b ? p_netcode->length_a : p_netcode->length_b))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    const rbc_mesh_value_handle_t handles[2] = {p_netcode->handle_a, p_netcode->handle_b};
+    const uint16_t versions[2] = {p_netcode->version_a, p_coded_adv->version};
+    const uint8_t lengths[2] = {p_netcode->length_a, p_netcode->length_b};
+    handle_info_t infos[2];
+    bool known[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        known[i] = false;
+        if (handle_storage_info_get(handles[i], &infos[i]) != NRF_SUCCESS)
+        {
+            infos[i].p_packet = NULL;
+            continue;
+        }
+        mesh_adv_data_t* p_stored_adv = mesh_packet_adv_data_get(infos[i].p_packet);
+        known[i] = (p_stored_adv != NULL &&
+                    infos[i].version == versions[i] &&
+                    p_stored_adv->adv_data_length == MESH_PACKET_ADV_OVERHEAD + lengths[i]);
+    }
+
+    uint32_t error_code = NRF_SUCCESS;
+    if (known[0] && known[1])
+    {
+        /* the sender has what we have */
+        handle_storage_rx_consistent(handles[0], timestamp);
+        handle_storage_rx_consistent(handles[1], timestamp);
+    }
+    else if (known[0] || known[1])
+    {
+        /* decode the missing value with the one we have, and treat it as received */
+        const uint32_t have = (known[0] ? 0 : 1);
+        const uint32_t want = 1 - have;
+        mesh_adv_data_t* p_stored_adv = mesh_packet_adv_data_get(infos[have].p_packet);
+        mesh_packet_t* p_decoded_packet = NULL;
+        if (mesh_packet_acquire(&p_decoded_packet))
+        {
+            uint8_t data[RBC_MESH_VALUE_MAX_LEN];
+            for (uint8_t i = 0; i < lengths[want]; ++i)
+            {
+                data[i] = p_netcode->coded[i] ^ (i < lengths[have] ? p_stored_adv->data[i] : 0);
+            }
+
+            error_code = mesh_packet_build(p_decoded_packet,
+                    handles[want],
+                    versions[want],
+                    data,
+                    lengths[want]);
+            if (error_code == NRF_SUCCESS)
+            {
+                p_decoded_packet->header.addr_type = p_packet->header.addr_type;
+                memcpy(p_decoded_packet->addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+                handle_storage_rx_consistent(handles[have], timestamp);
+                m_netcode_decode_count++;
+                error_code = rx_single(p_decoded_packet, mesh_packet_adv_data_get(p_decoded_packet), timestamp, rssi);
+            }
+            mesh_packet_ref_count_dec(p_decoded_packet);
+        }
+        else
+        {
+            error_code = NRF_ERROR_NO_MEM;
+        }
+    }
+    /* packets we can't decode are left for the plain values to resolve */
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        if (infos[i].p_packet != NULL)
+        {
+            mesh_packet_ref_count_dec(infos[i].p_packet);
+        }
+    }
+    return error_code;
+}
+
+void vh_netcode_stats_get(rbc_mesh_stats_t* p_stats)
+{
+    p_stats->tx_coded = m_netcode_tx_count;
+    p_stats->rx_decoded = m_netcode_decode_count;
+}
+#endif
+
+#ifdef RBC_MESH_SUMMARY_BEACON
+uint32_t vh_summary_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length != MESH_PACKET_ADV_OVERHEAD + RBC_MESH_SUMMARY_PAYLOAD_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint8_t payload[RBC_MESH_SUMMARY_PAYLOAD_LEN];
+    (void) summary_payload_get(payload);
+    if (memcmp(payload, p_adv_data->data, RBC_MESH_SUMMARY_PAYLOAD_LEN) == 0)
+    {
+        /* The neighbor has the same values as us, count it as a consistent
+           reception for all of them to suppress their transmissions. */
+        handle_storage_rx_consistent_all(timestamp);
+    }
+#ifdef RBC_MESH_VERSION_REPAIR
+    else if (!m_repair_active)
+    {
+        /* The neighbor's values differ from ours, go through them page by page. */
+        m_repair_cursor = 0;
+        m_repair_timer_evt.timestamp = timestamp + RBC_MESH_REPAIR_INTERVAL_US;
+        m_repair_active = (timer_sch_schedule(&m_repair_timer_evt) == NRF_SUCCESS);
+    }
+#endif
+
+    return NRF_SUCCESS;
+}
+#endif
+
+#ifdef RBC_MESH_VERSION_REPAIR
+uint32_t vh_repair_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length < MESH_PACKET_ADV_OVERHEAD + RBC_MESH_REPAIR_PAGE_OVERHEAD ||
+        p_adv_data->adv_data_length > MESH_PACKET_ADV_OVERHEAD + RBC_MESH_VALUE_MAX_LEN ||
+        (p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD - RBC_MESH_REPAIR_PAGE_OVERHEAD) % 4 != 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint16_t first;
+    uint16_t last;
+    memcpy(&first, &p_adv_data->data[0], sizeof(uint16_t));
+    memcpy(&last, &p_adv_data->data[2], sizeof(uint16_t));
+    const uint8_t* p_pairs = &p_adv_data->data[RBC_MESH_REPAIR_PAGE_OVERHEAD];
+    const uint32_t pair_count = (p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD - RBC_MESH_REPAIR_PAGE_OVERHEAD) / 4;
+
+    /* Walk our own values in the page's range alongside the neighbor's, both
+       in ascending handle order. Values the neighbor doesn't have, or has an
+       older version of, are sent again. The neighbor does the same for us
+       with its own pages. */
+    uint16_t handles[RBC_MESH_REPAIR_PAGE_ENTRIES];
+    uint16_t versions[RBC_MESH_REPAIR_PAGE_ENTRIES];
+    uint32_t pair = 0;
+    uint32_t count = RBC_MESH_REPAIR_PAGE_ENTRIES;
+    uint16_t cursor = first;
+    while (count == RBC_MESH_REPAIR_PAGE_ENTRIES)
+    {
+        APP_ERROR_CHECK(handle_storage_versions_get(cursor, handles, versions, &count));
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (handles[i] > last)
+            {
+                count = 0;
+                break;
+            }
+
+            uint16_t pair_handle = 0;
+            uint16_t pair_version = 0;
+            while (pair < pair_count)
+            {
+                memcpy(&pair_handle, &p_pairs[4 * pair], sizeof(uint16_t));
+                memcpy(&pair_version, &p_pairs[4 * pair + 2], sizeof(uint16_t));
+                if (pair_handle >= handles[i])
+                {
+                    break;
+                }
+                pair++;
+            }
+
+            if (pair == pair_count ||
+                pair_handle != handles[i] ||
+                version_delta(pair_version, versions[i]) > 0)
+            {
+                repair_request(handles[i], timestamp);
+            }
+        }
+        if (count > 0)
+        {
+            cursor = handles[count - 1] + 1;
+        }
+    }
+
+    vh_order_update(timestamp);
+    return NRF_SUCCESS;
+}
+#endif
+
+#ifdef RBC_MESH_BOOTSTRAP
+void vh_bootstrap_neighbor_rx(const uint8_t* p_addr, uint8_t rssi)
+{
+    /* the RSSI is the magnitude of a negative dBm value */
+    if (m_bootstrap_state == BOOTSTRAP_STATE_LISTEN &&
+        (!m_bootstrap_peer_valid || rssi < m_bootstrap_peer_rssi))
+    {
+        memcpy(m_bootstrap_peer, p_addr, BLE_GAP_ADDR_LEN);
+        m_bootstrap_peer_rssi = rssi;
+        m_bootstrap_peer_valid = true;
+    }
+}
+
+uint32_t vh_bootstrap_rx(mesh_packet_t* p_packet, uint32_t timestamp)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length != MESH_PACKET_ADV_OVERHEAD + RBC_MESH_BOOTSTRAP_PAYLOAD_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    bootstrap_payload_t payload;
+    memcpy(&payload, p_adv_data->data, RBC_MESH_BOOTSTRAP_PAYLOAD_LEN);
+    if (memcmp(payload.addr, m_local_addr, BLE_GAP_ADDR_LEN) != 0)
+    {
+        /* for another node */
+        return NRF_SUCCESS;
+    }
+
+    switch (payload.type)
+    {
+        case BOOTSTRAP_TYPE_REQUEST:
+            if (m_bootstrap_serving)
+            {
+                /* the node being served can ask again from where it got to,
+                   others have to wait their turn */
+                if (memcmp(p_packet->addr, m_bootstrap_client, BLE_GAP_ADDR_LEN) != 0)
+                {
+                    return NRF_ERROR_BUSY;
+                }
+                m_bootstrap_serve_cursor = payload.handle;
+                return NRF_SUCCESS;
+            }
+            memcpy(m_bootstrap_client, p_packet->addr, BLE_GAP_ADDR_LEN);
+            m_bootstrap_serve_cursor = payload.handle;
+            m_bootstrap_serve_timer_evt.timestamp = timestamp + RBC_MESH_BOOTSTRAP_INTERVAL_US;
+            m_bootstrap_serving = (timer_sch_schedule(&m_bootstrap_serve_timer_evt) == NRF_SUCCESS);
+            return NRF_SUCCESS;
+        case BOOTSTRAP_TYPE_PROGRESS:
+            if (m_bootstrap_state != BOOTSTRAP_STATE_REQUESTED)
+            {
+                return NRF_SUCCESS;
+            }
+            if (payload.handle == RBC_MESH_INVALID_HANDLE)
+            {
+                m_bootstrap_state = BOOTSTRAP_STATE_IDLE;
+                (void) timer_sch_abort(&m_bootstrap_timer_evt);
+                return NRF_SUCCESS;
+            }
+            m_bootstrap_cursor = payload.handle;
+            m_bootstrap_retries = RBC_MESH_BOOTSTRAP_RETRIES;
+            return timer_sch_reschedule(&m_bootstrap_timer_evt, timestamp + RBC_MESH_BOOTSTRAP_TIMEOUT_US);
+        default:
+            return NRF_ERROR_INVALID_DATA;
+    }
+}
+#endif
+
+#ifdef RBC_MESH_TIME_SYNC
+uint32_t vh_time_sync_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length != MESH_PACKET_ADV_OVERHEAD + RBC_MESH_TIME_SYNC_PAYLOAD_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    time_sync_payload_t payload;
+    memcpy(&payload, p_adv_data->data, RBC_MESH_TIME_SYNC_PAYLOAD_LEN);
+
+    /* Follow the lowest root ID, through the neighbor closest to it. */
+    if (payload.hops == UINT8_MAX ||
+        payload.root_id > m_time_root_id)
+    {
+        return NRF_SUCCESS;
+    }
+
+    if (payload.root_id == m_time_root_id)
+    {
+        /* only the root makes beacons newer, a relayed old one is no sign of life */
+        int8_t age = (int8_t) (payload.seq - m_time_seq);
+        if (age < 0 || (age == 0 && payload.hops >= m_time_hops))
+        {
+            return NRF_SUCCESS;
+        }
+    }
+    else
+    {
+        /* neighbors that haven't timed out yet keep relaying the root we
+           took over from, until they do */
+        if (payload.root_id == m_time_lost_root_id &&
+            (int8_t) (payload.seq - m_time_lost_seq) <= 0 &&
+            TIMER_DIFF(timestamp, m_time_lost_time) < RBC_MESH_TIME_SYNC_TIMEOUT_US)
+        {
+            return NRF_SUCCESS;
+        }
+        /* the rate difference to the old root says nothing about the new one */
+        timer_mesh_time_reset(timestamp);
+    }
+    (void) timer_mesh_time_sync(timestamp, payload.mesh_time + TIME_SYNC_TX_DELAY_US);
+    m_time_root_id = payload.root_id;
+    m_time_hops = payload.hops + 1;
+    m_time_seq = payload.seq;
+    m_time_last_sync = timestamp;
+
+    return NRF_SUCCESS;
+}
+
+void vh_time_get(rbc_mesh_time_t* p_time)
+{
+    p_time->time_us = timer_mesh_time_get(timer_now());
+    p_time->root_id = m_time_root_id;
+    p_time->hops = m_time_hops;
+}
+#endif
+
+#ifdef RBC_MESH_CHANNEL_QUALITY
+uint32_t vh_channel_map_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length != MESH_PACKET_ADV_OVERHEAD + RBC_MESH_CHANNEL_MAP_PAYLOAD_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint8_t channel_map = p_adv_data->data[0] & ((1 << 3) - 1);
+    uint8_t seq = p_adv_data->data[1];
+    if (channel_map == 0)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    /* Follow the newest map. Maps made at the same time are ordered by the
+       number of channels, then by the map itself, so all nodes settle on
+       the same one. */
+    uint8_t own_map = tc_channel_map_get();
+    int8_t seq_delta = (int8_t) (seq - m_channel_map_seq);
+    if (!m_channel_map_known ||
+        seq_delta > 0 ||
+        (seq_delta == 0 &&
+         (channel_count(channel_map) > channel_count(own_map) ||
+          (channel_count(channel_map) == channel_count(own_map) && channel_map > own_map))))
+    {
+        channel_map_adopt(channel_map, seq, timestamp);
+    }
+    return NRF_SUCCESS;
+}
+#endif
+
+#ifdef RBC_MESH_ORIGIN_TIME
+void vh_propagation_stats_get(rbc_mesh_propagation_stats_t* p_stats, bool reset)
+{
+    event_handler_critical_section_begin();
+    *p_stats = m_propagation_stats;
+    if (reset)
+    {
+        memset(&m_propagation_stats, 0, sizeof(m_propagation_stats));
+    }
+    event_handler_critical_section_end();
+}
+
+#ifdef RBC_MESH_HEALTH_MONITOR
+uint32_t vh_propagation_late_count_get(void)
+{
+    return m_propagation_late_count;
+}
+#endif
+#endif
+
+#ifdef RBC_MESH_LATENCY_PROBE
+uint32_t vh_probe_rx(mesh_adv_data_t* p_adv_data, uint32_t timestamp)
+{
+    if (p_adv_data == NULL ||
+        p_adv_data->adv_data_length < MESH_PACKET_ADV_OVERHEAD + RBC_MESH_PROBE_OVERHEAD ||
+        p_adv_data->adv_data_length > MESH_PACKET_ADV_OVERHEAD + RBC_MESH_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t payload[(RBC_MESH_VALUE_MAX_LEN + 3) / 4];
+    probe_payload_t* p_probe = (probe_payload_t*) payload;
+    uint8_t length = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    memcpy(p_probe, p_adv_data->data, length);
+    uint8_t hop_entries = (length - RBC_MESH_PROBE_OVERHEAD) / sizeof(rbc_mesh_probe_hop_t);
+
+    if (!probe_cache_add(p_probe))
+    {
+        return NRF_SUCCESS;
+    }
+
+    uint16_t node_id = probe_node_id_get();
+    uint16_t destination = (p_probe->flags & PROBE_FLAG_REPLY) ? p_probe->origin : p_probe->target;
+    if (destination == node_id)
+    {
+        probe_event_push(p_probe, hop_entries, timestamp);
+        if (p_probe->flags & PROBE_FLAG_REPLY)
+        {
+            return NRF_SUCCESS;
+        }
+
+        /* send it back, keeping the origin timestamp for the round trip */
+        p_probe->flags |= PROBE_FLAG_REPLY;
+        p_probe->hops = 0;
+        (void) probe_cache_add(p_probe);
+        return probe_tx(p_probe, 0);
+    }
+
+    if (p_probe->hops >= RBC_MESH_PROBE_TTL)
+    {
+        return NRF_SUCCESS;
+    }
+    p_probe->hops++;
+    if (hop_entries < RBC_MESH_PROBE_HOPS_MAX)
+    {
+        uint32_t delay = TIMER_DIFF(timer_now(), timestamp) / RBC_MESH_PROBE_DELAY_UNIT_US;
+        rbc_mesh_probe_hop_t hop;
+        hop.node_id = node_id;
+        hop.delay = (delay > UINT16_MAX) ? UINT16_MAX : delay;
+        memcpy(&p_probe->hop[hop_entries++], &hop, sizeof(hop));
+    }
+    return probe_tx(p_probe, hop_entries);
+}
+
+uint32_t vh_probe_send(uint16_t target, uint8_t* p_seq)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    uint16_t node_id = probe_node_id_get();
+    if (target == node_id)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    uint32_t payload[(RBC_MESH_PROBE_OVERHEAD + 3) / 4];
+    probe_payload_t* p_probe = (probe_payload_t*) payload;
+
+    event_handler_critical_section_begin();
+    p_probe->origin = node_id;
+    p_probe->target = target;
+    p_probe->seq = m_probe_seq++;
+    p_probe->flags = 0;
+    p_probe->hops = 0;
+    p_probe->origin_time = probe_time_get(timer_now());
+    (void) probe_cache_add(p_probe);
+    uint32_t error_code = probe_tx(p_probe, 0);
+    event_handler_critical_section_end();
+
+    if (error_code == NRF_SUCCESS && p_seq != NULL)
+    {
+        *p_seq = p_probe->seq;
+    }
+    return error_code;
+}
+#endif
+
+uint32_t vh_min_interval_set(uint32_t min_interval_us)
+{
+    return handle_storage_min_interval_set(min_interval_us);
+}
+
+void vh_radio_params_set(uint32_t access_address, uint8_t channel)
+{
+    event_handler_critical_section_begin();
+    m_tx_config.alt_access_address = (access_address != RBC_MESH_ACCESS_ADDRESS_BLE_ADV);
+    m_tx_config.first_channel = channel;
+    event_handler_critical_section_end();
+    tc_radio_params_set(access_address, channel);
+}
+
+void vh_tx_power_set(rbc_mesh_txpower_t tx_power)
+{
+    m_tx_config.tx_power = tx_power;
+}
+
+rbc_mesh_txpower_t vh_tx_power_get(void)
+{
+    return m_tx_config.tx_power;
+}
+
+uint32_t vh_rx(mesh_packet_t* p_packet, uint32_t crc, uint32_t timestamp, uint8_t rssi)
+{
+    mesh_adv_data_t* p_adv_data = mesh_packet_adv_data_get(p_packet);
+    if (p_adv_data == NULL)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+    /* Only plain single value packets are cached. Segments and aggregates
+       take the full path. */
+    bool cacheable = (mesh_packet_adv_data_next_get(p_packet, p_adv_data) == NULL &&
+                      !mesh_segment_is_segmented(p_adv_data->handle));
+    if (cacheable && rx_duplicate_filter(p_packet, p_adv_data, crc, timestamp, rssi))
+    {
+        return NRF_SUCCESS;
+    }
+#endif
+
+    /* Aggregated packets carry several values. The handle storage keeps one
+       value per packet, so every value but the first is copied out to a packet
+       of its own. The first value is processed last, as taking ownership of
+       the original packet strips the rest of it. */
+    for (mesh_adv_data_t* p_next = mesh_packet_adv_data_next_get(p_packet, p_adv_data);
+         p_next != NULL;
+         p_next = mesh_packet_adv_data_next_get(p_packet, p_next))
+    {
+        mesh_packet_t* p_single = NULL;
+        if (p_next->handle > RBC_MESH_APP_MAX_HANDLE ||
+            !mesh_packet_acquire(&p_single))
+        {
+            continue;
+        }
+        p_single->header = p_packet->header;
+        p_single->header.length = MESH_PACKET_BLE_OVERHEAD;
+        memcpy(p_single->addr, p_packet->addr, BLE_GAP_ADDR_LEN);
+        if (mesh_packet_adv_data_append(p_single, p_next) == NRF_SUCCESS)
+        {
+            (void) rx_single(p_single, mesh_packet_adv_data_get(p_single), timestamp, rssi);
+        }
+        mesh_packet_ref_count_dec(p_single);
+    }
+
+#if (RBC_MESH_RX_DUPLICATE_CACHE_SIZE > 0)
+    if (cacheable)
+    {
+        /* the fields are read before rx_single, as it may take ownership of the packet */
+        rx_duplicate_add(p_packet, p_adv_data, crc);
+    }
+#endif
+    return rx_single(p_packet, p_adv_data, timestamp, rssi);
+}
+
+#ifdef RBC_MESH_CONFLICT_RESOLUTION
+uint32_t vh_conflict_resolver_set(rbc_mesh_conflict_resolver_t resolver)
+{
+    event_handler_critical_section_begin();
+    m_conflict_resolver = resolver;
+    event_handler_critical_section_end();
+    return NRF_SUCCESS;
+}
+#endif
+
+#ifdef RBC_MESH_RX_HOOKS
+uint32_t vh_rx_hook_set(rbc_mesh_value_handle_t handle, rbc_mesh_rx_hook_t hook)
+{
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    rx_hook_entry_t* p_free = NULL;
+    rx_hook_entry_t* p_entry = NULL;
+    for (uint32_t i = 0; i < RBC_MESH_RX_HOOKS_MAX; ++i)
+    {
+        if (m_rx_hooks[i].hook == NULL)
+        {
+            if (p_free == NULL)
+            {
+                p_free = &m_rx_hooks[i];
+            }
+        }
+        else if (m_rx_hooks[i].handle == handle)
+        {
+            p_entry = &m_rx_hooks[i];
+        }
+    }
+
+    if (p_entry != NULL)
+    {
+        p_entry->hook = hook;
+    }
+    else if (hook == NULL)
+    {
+        /* nothing to remove */
+    }
+    else if (p_free != NULL)
+    {
+        p_free->handle = handle;
+        p_free->hook = hook;
+    }
+    else
+    {
+        error_code = NRF_ERROR_NO_MEM;
+    }
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+void vh_rx_hook_stats_get(rbc_mesh_stats_t* p_stats)
+{
+    p_stats->rx_hook_calls = m_rx_hook_calls;
+    p_stats->rx_hook_overruns = m_rx_hook_overruns;
+}
+#endif
+
+uint32_t vh_rx_duplicate_count_get(void)
+{
+    return m_rx_duplicate_count;
+}
+
+/** Build a packet for a local update of the given value, with a reference
+  for the caller. */
+static uint32_t local_packet_build(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length, mesh_packet_t** pp_packet)
+{
+    if (1 + MESH_PACKET_ADV_OVERHEAD + length > mesh_packet_payload_max_get())
+    {
+        /* too long for the nodes that only take legacy packets */
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    mesh_packet_t* p_packet = NULL;
+    if (!mesh_packet_acquire(&p_packet))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint32_t error_code = mesh_packet_build(p_packet,
+            handle,
+            1, /* Will be overwritten if handle storage knows the current version */
+            data,
+            length);
+    if (error_code != NRF_SUCCESS)
+    {
+        mesh_packet_ref_count_dec(p_packet);
+        return error_code;
+    }
+#ifdef RBC_MESH_ORIGIN_TIME
+    mesh_packet_adv_data_get(p_packet)->origin_time = origin_time_get(timer_now());
+#endif
+    *pp_packet = p_packet;
+    return NRF_SUCCESS;
+}
+
 uint32_t vh_local_update(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t length)
 {
     if (!m_is_initialized)
@@ -346,37 +2590,129 @@ uint32_t vh_local_update(rbc_mesh_value_handle_t handle, uint8_t* data, uint8_t
         return NRF_ERROR_INVALID_STATE;
     }
 
-    uint32_t error_code;
     mesh_packet_t* p_packet = NULL;
-
-    if (!mesh_packet_acquire(&p_packet))
+    uint32_t error_code = local_packet_build(handle, data, length, &p_packet);
+    if (error_code != NRF_SUCCESS)
     {
-        return NRF_ERROR_NO_MEM;
+        return error_code;
     }
 
-    error_code = mesh_packet_build(p_packet,
-            handle,
-            1, /* Will be overwritten if handle storage knows the current version */
-            data,
-            length);
-    if (error_code != NRF_SUCCESS)
+#ifdef RBC_MESH_DELTA_UPDATES
+    handle_info_t old_info;
+    if (handle_storage_info_get(handle, &old_info) != NRF_SUCCESS)
     {
-        mesh_packet_ref_count_dec(p_packet);
-        return error_code;
+        old_info.p_packet = NULL;
     }
+#endif
 
     error_code = handle_storage_local_packet_push(p_packet);
     if (error_code == NRF_SUCCESS)
     {
+#ifdef RBC_MESH_DELTA_UPDATES
+        if (old_info.p_packet != NULL)
+        {
+            /* compare with the new value once it has been pushed */
+            async_event_t delta_evt;
+            delta_evt.type = EVENT_TYPE_GENERIC;
+            delta_evt.callback.generic.cb = delta_prepare;
+            delta_evt.callback.generic.p_context = old_info.p_packet;
+            if (event_handler_push(&delta_evt) == NRF_SUCCESS)
+            {
+                old_info.p_packet = NULL; /* the event owns the reference */
+            }
+        }
+#endif
         vh_order_update(timer_now()); /* will be executed after the packet push */
     }
+#ifdef RBC_MESH_DELTA_UPDATES
+    if (old_info.p_packet != NULL)
+    {
+        mesh_packet_ref_count_dec(old_info.p_packet);
+    }
+#endif
 
     mesh_packet_ref_count_dec(p_packet);
     return error_code;
 }
 
+uint32_t vh_local_update_batch(const rbc_mesh_value_handle_t* p_handles, uint8_t* const* pp_data, const uint16_t* p_lengths, uint32_t count)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    /* The values are applied in place rather than through an event each,
+       which would overflow the event queue for larger batches. */
+    uint32_t error_code = NRF_SUCCESS;
+    event_handler_critical_section_begin();
+    for (uint32_t i = 0; i < count && error_code == NRF_SUCCESS; ++i)
+    {
+        mesh_packet_t* p_packet = NULL;
+        error_code = local_packet_build(p_handles[i], pp_data[i], p_lengths[i], &p_packet);
+        if (error_code == NRF_SUCCESS)
+        {
+            handle_storage_local_packet_apply(p_packet);
+            mesh_packet_ref_count_dec(p_packet);
+        }
+    }
+    event_handler_critical_section_end();
+
+    /* one transmit order for the whole batch */
+    uint32_t order_error_code = vh_order_update(timer_now());
+    return (error_code == NRF_SUCCESS ? order_error_code : error_code);
+}
+
 uint32_t vh_on_timeslot_begin(void)
 {
+#ifdef RBC_MESH_TIME_SYNC
+    if (!m_time_sync_scheduled)
+    {
+        m_time_sync_timer_evt.timestamp = timer_now() + RBC_MESH_TIME_SYNC_INTERVAL_US;
+        if (timer_sch_schedule(&m_time_sync_timer_evt) == NRF_SUCCESS)
+        {
+            m_time_sync_scheduled = true;
+        }
+    }
+#endif
+#ifdef RBC_MESH_SUMMARY_BEACON
+    if (!m_summary_scheduled)
+    {
+        m_summary_timer_evt.timestamp = timer_now() + RBC_MESH_SUMMARY_INTERVAL_US;
+        if (timer_sch_schedule(&m_summary_timer_evt) == NRF_SUCCESS)
+        {
+            m_summary_scheduled = true;
+        }
+    }
+#endif
+#ifdef RBC_MESH_BOOTSTRAP
+    if (m_bootstrap_state == BOOTSTRAP_STATE_CHECK)
+    {
+        /* values restored from flash or retained RAM are in place by now */
+        uint32_t digest;
+        uint16_t count;
+        APP_ERROR_CHECK(handle_storage_summary_get(&digest, &count));
+        m_bootstrap_state = BOOTSTRAP_STATE_IDLE;
+        if (count == 0)
+        {
+            m_bootstrap_timer_evt.timestamp = timer_now() + RBC_MESH_BOOTSTRAP_LISTEN_US;
+            if (timer_sch_schedule(&m_bootstrap_timer_evt) == NRF_SUCCESS)
+            {
+                m_bootstrap_state = BOOTSTRAP_STATE_LISTEN;
+            }
+        }
+    }
+#endif
+#ifdef RBC_MESH_CHANNEL_QUALITY
+    if (!m_channel_map_scheduled)
+    {
+        m_channel_map_timer_evt.timestamp = timer_now() + RBC_MESH_CHANNEL_MAP_INTERVAL_US;
+        if (timer_sch_schedule(&m_channel_map_timer_evt) == NRF_SUCCESS)
+        {
+            m_channel_map_scheduled = true;
+        }
+    }
+#endif
     return vh_order_update(timer_now());
 }
 
@@ -391,6 +2727,28 @@ uint32_t vh_order_update(uint32_t time_now)
     return event_handler_push(&tx_event);
 }
 
+bool vh_next_tx_time_get(uint32_t* p_time)
+{
+    if (!m_next_tx_valid)
+    {
+        return false;
+    }
+    *p_time = m_next_tx_time;
+    return true;
+}
+
+#ifdef RBC_MESH_TIMESLOT_LATENCY_MODE
+bool vh_urgent_tx_time_get(uint32_t* p_time)
+{
+    if (!m_next_urgent_tx_valid)
+    {
+        return false;
+    }
+    *p_time = m_next_urgent_tx_time;
+    return true;
+}
+#endif
+
 uint32_t vh_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* length)
 {
     if (!m_is_initialized)
@@ -431,6 +2789,48 @@ uint32_t vh_value_get(rbc_mesh_value_handle_t handle, uint8_t* data, uint16_t* l
     return NRF_SUCCESS;
 }
 
+uint32_t vh_value_next_get(uint32_t* p_iterator,
+        rbc_mesh_value_handle_t* p_handle,
+        uint16_t* p_version,
+        uint8_t* data,
+        uint16_t* length)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    handle_info_t info;
+    mesh_adv_data_t* p_adv_data = NULL;
+    while (p_adv_data == NULL)
+    {
+        uint32_t error_code = handle_storage_value_next_get(p_iterator, p_handle, &info);
+        if (error_code != NRF_SUCCESS)
+        {
+            return error_code;
+        }
+
+        p_adv_data = mesh_packet_adv_data_get(info.p_packet);
+        if (p_adv_data == NULL)
+        {
+            mesh_packet_ref_count_dec(info.p_packet);
+        }
+    }
+
+    uint16_t data_length = p_adv_data->adv_data_length - MESH_PACKET_ADV_OVERHEAD;
+    if (data_length > *length)
+    {
+        mesh_packet_ref_count_dec(info.p_packet);
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    memcpy(data, p_adv_data->data, data_length);
+    *length = data_length;
+    *p_version = info.version;
+
+    mesh_packet_ref_count_dec(info.p_packet);
+    return NRF_SUCCESS;
+}
+
 uint32_t vh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event)
 {
     if (!m_is_initialized)
@@ -451,6 +2851,26 @@ uint32_t vh_tx_event_set(rbc_mesh_value_handle_t handle, bool do_tx_event)
     return error_code;
 }
 
+uint32_t vh_handles_iterate(rbc_mesh_handle_iterate_cb_t callback, void* p_context)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return handle_storage_handles_iterate(callback, p_context);
+}
+
+uint32_t vh_cache_compact(void)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return handle_storage_compact();
+}
+
 uint32_t vh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* p_is_doing_tx_event)
 {
     if (!m_is_initialized)
@@ -471,6 +2891,46 @@ uint32_t vh_tx_event_flag_get(rbc_mesh_value_handle_t handle, bool* p_is_doing_t
     return error_code;
 }
 
+uint32_t vh_urgent_flag_set(rbc_mesh_value_handle_t handle, bool urgent)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+
+    uint32_t error_code = handle_storage_flag_set_async(handle, HANDLE_FLAG_URGENT, urgent);
+
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+uint32_t vh_urgent_flag_get(rbc_mesh_value_handle_t handle, bool* p_urgent)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+
+    uint32_t error_code = handle_storage_flag_get(handle, HANDLE_FLAG_URGENT, p_urgent);
+
+    event_handler_critical_section_end();
+    return error_code;
+}
+
 
 uint32_t vh_value_enable(rbc_mesh_value_handle_t handle)
 {
@@ -564,3 +3024,132 @@ uint32_t vh_value_persistence_get(rbc_mesh_value_handle_t handle, bool* p_persis
     event_handler_critical_section_end();
     return error_code;
 }
+
+uint32_t vh_trickle_class_config(uint8_t trickle_class, uint32_t i_min_us, uint32_t i_max, uint8_t k)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    event_handler_critical_section_begin();
+    uint32_t error_code = trickle_class_setup(trickle_class, i_min_us, i_max, k);
+    event_handler_critical_section_end();
+
+    return error_code;
+}
+
+uint32_t vh_trickle_class_set(rbc_mesh_value_handle_t handle, uint8_t trickle_class)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    /* the handle storage must not be modified by the event handler meanwhile */
+    event_handler_critical_section_begin();
+    uint32_t error_code = handle_storage_trickle_class_set(handle, trickle_class);
+    event_handler_critical_section_end();
+
+    if (error_code == NRF_SUCCESS)
+    {
+        /* the value's timeout has been reset */
+        vh_order_update(timer_now());
+    }
+    return error_code;
+}
+
+uint32_t vh_trickle_class_get(rbc_mesh_value_handle_t handle, uint8_t* p_trickle_class)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    return handle_storage_trickle_class_get(handle, p_trickle_class);
+}
+
+uint32_t vh_handle_stats_get(rbc_mesh_value_handle_t handle, rbc_mesh_handle_stats_t* p_stats, bool reset)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return handle_storage_stats_get(handle, p_stats, reset);
+}
+
+uint32_t vh_value_ttl_set(rbc_mesh_value_handle_t handle, uint16_t ttl_ticks)
+{
+#ifdef RBC_MESH_VALUE_TTL
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+    uint32_t error_code = handle_storage_ttl_set(handle, ttl_ticks);
+    if (error_code == NRF_SUCCESS && ttl_ticks != 0 && !m_ttl_scheduled)
+    {
+        /* the tick runs from the first time-to-live on */
+        m_ttl_timer_evt.timestamp = timer_now() + RBC_MESH_VALUE_TTL_TICK_MS * 1000;
+        error_code = timer_sch_schedule(&m_ttl_timer_evt);
+        m_ttl_scheduled = (error_code == NRF_SUCCESS);
+    }
+    event_handler_critical_section_end();
+    return error_code;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t vh_write_combine_set(rbc_mesh_value_handle_t handle, uint16_t window_ms)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+    uint32_t error_code = handle_storage_write_combine_set(handle, window_ms);
+    event_handler_critical_section_end();
+    return error_code;
+}
+
+uint32_t vh_hop_scope_set(rbc_mesh_value_handle_t handle, uint8_t hops)
+{
+    if (!m_is_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (handle == RBC_MESH_INVALID_HANDLE)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    event_handler_critical_section_begin();
+    uint32_t error_code = handle_storage_hop_scope_set(handle, hops);
+    event_handler_critical_section_end();
+    return error_code;
+}